@@ -0,0 +1,15 @@
+in vec4 v_Color;
+in float v_Time;
+
+// Start and end of the time window drawn
+uniform vec2 window;
+
+out vec4 v_FragColor;
+
+void main()
+{
+    if (v_Time < window.x || v_Time > window.y)
+        discard;
+
+    v_FragColor = v_Color;
+}
@@ -0,0 +1,20 @@
+// Position relative to the center of the path, and time relative to its
+// first sample
+in vec4 in_Position;
+
+uniform vec4 color;
+// Start of the fade and its rate, zero to disable fading
+uniform vec2 fade;
+
+out vec4 v_Color;
+out float v_Time;
+
+void main()
+{
+    v_Color = color;
+    if (fade.y != 0.0)
+        v_Color.a *= clamp((in_Position.w - fade.x) * fade.y, 0.0, 1.0);
+    v_Time = in_Position.w;
+
+    set_vp(vec4(in_Position.xyz, 1.0));
+}
@@ -0,0 +1,11 @@
+attribute vec2 in_Position;
+
+uniform vec2 scale;
+
+varying vec2 position;
+
+void main(void)
+{
+    gl_Position = vec4(in_Position.xy, 0.0, 1.0);
+    position = in_Position.xy * scale;
+}
@@ -0,0 +1,35 @@
+in vec4 in_Position;
+in float in_Size;
+in float in_ColorIndex;
+in float in_Brightness;
+
+// Per instance: the rows of the model matrix, and the galaxy size,
+// brightness, minimum feature size and number of points to draw.
+in vec4 in_ModelRow0;
+in vec4 in_ModelRow1;
+in vec4 in_ModelRow2;
+in vec4 in_Instance;
+
+uniform sampler2D colorTex;
+
+out Vertex
+{
+    vec3  color;
+    float size;
+    float brightness;
+    float minimumFeatureSize;
+} vertex;
+
+void main()
+{
+    gl_Position = vec4(dot(in_ModelRow0, in_Position),
+                       dot(in_ModelRow1, in_Position),
+                       dot(in_ModelRow2, in_Position),
+                       1.0);
+    // Points past the point count of the instance are dropped by the
+    // geometry shader
+    vertex.size = float(gl_VertexID) < in_Instance.w ? in_Instance.x * in_Size : -1.0;
+    vertex.brightness = in_Brightness * in_Instance.y;
+    vertex.minimumFeatureSize = in_Instance.z;
+    vertex.color = texture(colorTex, vec2(in_ColorIndex, 0.0)).rgb;
+}
@@ -0,0 +1,34 @@
+in vec4 in_Position;
+
+// Per instance: the center and semi-axes of the ellipse in camera space,
+// the eccentric anomalies at the start and end of the path and the
+// eccentricity, and the color.
+in vec3 in_Center;
+in vec3 in_MajorAxis;
+in vec3 in_MinorAxis;
+in vec3 in_Anomaly;
+in vec4 in_Color;
+
+// Fraction of the path over which it fades in, zero to disable fading
+uniform float fadeFraction;
+
+out vec4 v_Color;
+
+void main()
+{
+    float E = mix(in_Anomaly.x, in_Anomaly.y, in_Position.x);
+    vec3 position = in_Center + cos(E) * in_MajorAxis + sin(E) * in_MinorAxis;
+
+    v_Color = in_Color;
+    if (fadeFraction > 0.0)
+    {
+        // Kepler's equation gives the mean anomaly, which grows evenly with time
+        float e = in_Anomaly.z;
+        float M0 = in_Anomaly.x - e * sin(in_Anomaly.x);
+        float M1 = in_Anomaly.y - e * sin(in_Anomaly.y);
+        float M = E - e * sin(E);
+        v_Color.a *= clamp((M - M0) / ((M1 - M0) * fadeFraction), 0.0, 1.0);
+    }
+
+    set_vp(vec4(position, 1.0));
+}
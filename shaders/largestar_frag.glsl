@@ -1,7 +1,7 @@
 uniform sampler2D starTex;
-uniform vec4 color;
 
 varying vec2 texCoord;
+varying vec4 color;
 
 void main(void)
 {
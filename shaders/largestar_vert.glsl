@@ -1,16 +1,20 @@
-attribute vec2 in_Position;
+attribute vec3 in_Position;
 attribute vec2 in_TexCoord0;
+attribute float in_PointSize;
+attribute vec4 in_Color;
 
-uniform float pointWidth;
-uniform float pointHeight;
-uniform vec3 center;
+// Size of a pixel in normalized device coordinates
+uniform vec2 viewportScale;
 
 varying vec2 texCoord;
+varying vec4 color;
 
 void main(void)
 {
     texCoord = in_TexCoord0.st;
-    set_vp(vec4(center, 1.0));
-    vec2 transformed = vec2(in_Position.x * pointWidth, in_Position.y * pointHeight);
-    gl_Position.xy += transformed * gl_Position.w;
+    color = in_Color;
+    set_vp(vec4(in_Position, 1.0));
+    // The corner of the billboard follows from its texture coordinates
+    vec2 offset = vec2(in_TexCoord0.x - 0.5, 0.5 - in_TexCoord0.y) * in_PointSize;
+    gl_Position.xy += offset * viewportScale * gl_Position.w;
 }
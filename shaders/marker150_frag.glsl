@@ -0,0 +1,8 @@
+in vec4 v_Color;
+
+out vec4 v_FragColor;
+
+void main()
+{
+    v_FragColor = v_Color;
+}
@@ -0,0 +1,16 @@
+in vec4 in_Position;
+
+// Per instance: the center of the marker in pixels, with the normalized
+// device depth as z, the scale from symbol units to pixels, and the color.
+in vec3 in_Center;
+in float in_Scale;
+in vec4 in_Color;
+
+out vec4 v_Color;
+
+void main()
+{
+    v_Color = in_Color;
+    // The depth is already projected, so this bypasses set_vp
+    gl_Position = MVPMatrix * vec4(in_Center.xy + in_Position.xy * in_Scale, in_Center.z, 1.0);
+}
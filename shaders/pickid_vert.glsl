@@ -0,0 +1,12 @@
+attribute vec4 in_Position;
+
+// Inner and outer radius of rings; one for everything else
+uniform vec2 radii;
+
+void main(void)
+{
+    // The w coordinate of the ring vertices is 0 on the inner edge and 1 on
+    // the outer edge; other vertices have w = 1
+    float r = mix(radii.x, radii.y, in_Position.w);
+    set_vp(vec4(in_Position.xyz * r, 1.0));
+}
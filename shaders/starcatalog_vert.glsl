@@ -0,0 +1,81 @@
+attribute vec3 in_Position;
+attribute vec4 in_Color;
+attribute float in_AbsMag;
+attribute float in_Extinction;
+
+uniform vec3 obsPos;
+uniform float faintestMag;
+uniform float limitingMag;
+uniform float brightnessScale;
+uniform float brightnessBias;
+uniform float satPoint;
+uniform float baseSize;
+uniform float minDistance;
+uniform float maxDistance;
+uniform int scaledDiscs;
+uniform int glare;
+
+varying vec4 color;
+
+const float LY_PER_PARSEC = 3.26167;
+const float LOG10_2 = 0.30103;
+const float MaxScaledDiscStarSize = 8.0;
+const float GlareOpacity = 0.65;
+
+void cull(void)
+{
+    // Points outside of the clip volume are dropped before rasterization
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    gl_PointSize = 1.0;
+    color = vec4(0.0);
+}
+
+void main(void)
+{
+    vec3 relPos = in_Position - obsPos;
+    float distance = length(relPos);
+    float appMag = in_AbsMag - 5.0 + 5.0 * LOG10_2 * log2(distance / LY_PER_PARSEC) + in_Extinction * distance;
+    if (distance < minDistance || distance > maxDistance || appMag >= limitingMag)
+    {
+        cull();
+        return;
+    }
+
+    // See Renderer::calculatePointSize
+    float alpha = max(0.0, (faintestMag - appMag) * brightnessScale + brightnessBias);
+    float discSize = baseSize;
+    float glareSize = 0.0;
+    float glareAlpha = 0.0;
+    if (alpha > 1.0)
+    {
+        if (scaledDiscs != 0)
+        {
+            float discScale = min(MaxScaledDiscStarSize, exp2(0.3 * (satPoint - appMag)));
+            discSize *= max(1.0, discScale);
+            glareAlpha = min(0.5, discScale / 4.0);
+            glareSize = discSize * 3.0;
+        }
+        else
+        {
+            float discScale = min(100.0, satPoint - appMag + 2.0);
+            glareAlpha = min(GlareOpacity, (discScale - 2.0) / 4.0);
+            glareSize = 2.0 * discScale * baseSize;
+        }
+        alpha = 1.0;
+    }
+
+    if (glare != 0)
+    {
+        if (glareSize == 0.0)
+        {
+            cull();
+            return;
+        }
+        discSize = glareSize;
+        alpha = glareAlpha;
+    }
+
+    gl_PointSize = discSize;
+    color = vec4(in_Color.rgb, alpha);
+    set_vp(vec4(relPos, 1.0));
+}
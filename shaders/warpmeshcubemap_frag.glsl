@@ -0,0 +1,21 @@
+varying vec2 position;
+varying float intensity;
+
+uniform samplerCube tex;
+
+const float HALF_PI = 1.5707963;
+
+void main(void)
+{
+    // Equidistant fisheye, 90 degrees from the view direction at the rim
+    float r = length(position);
+    if (r > 1.0)
+    {
+        gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    float phi = r * HALF_PI;
+    vec2 dir = r > 0.0 ? position / r : vec2(0.0);
+    gl_FragColor = vec4(textureCube(tex, vec3(dir * sin(phi), -cos(phi))).rgb * intensity, 1.0);
+}
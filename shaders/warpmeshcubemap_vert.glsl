@@ -0,0 +1,19 @@
+attribute vec2 in_Position;
+attribute vec2 in_TexCoord0;
+attribute float in_Intensity;
+
+varying vec2 position;
+varying float intensity;
+
+uniform float screenRatio;
+
+void main(void)
+{
+    float offset = 0.5 - screenRatio * 0.5;
+    gl_Position = vec4(in_Position.x * screenRatio, in_Position.y, 0.0, 1.0);
+    // The position in the fisheye which warpmesh would sample from the
+    // image drawn by fisheyecubemap
+    vec2 texCoord = vec2(in_TexCoord0.x * screenRatio + offset, in_TexCoord0.y);
+    position = (texCoord * 2.0 - 1.0) * vec2(1.0 / screenRatio, 1.0);
+    intensity = in_Intensity;
+}
@@ -489,7 +489,7 @@ bool processTriangleMeshChunk(std::istream& in, M3DChunkType chunkType, std::int
 }
 
 
-bool processModelChunk(std::istream& in, M3DChunkType chunkType, std::int32_t contentSize, M3DModel& model)
+bool processModelChunk(std::istream& in, M3DChunkType chunkType, std::int32_t contentSize, M3DSceneHandler& handler)
 {
     if (chunkType != M3DChunkType::TriangleMesh)
     {
@@ -499,8 +499,7 @@ bool processModelChunk(std::istream& in, M3DChunkType chunkType, std::int32_t co
     GetLogger()->debug("Processing TriangleMesh chunk\n");
     M3DTriangleMesh triMesh;
     if (!readChunks(in, contentSize, triMesh, processTriangleMeshChunk)) { return false; }
-    model.addTriMesh(std::move(triMesh));
-    return true;
+    return handler.triangleMesh(std::move(triMesh));
 }
 
 
@@ -710,51 +709,48 @@ bool processMaterialChunk(std::istream& in, M3DChunkType chunkType, std::int32_t
 }
 
 
-bool readNamedObject(std::istream& in, std::int32_t contentSize, M3DScene& scene)
+bool readNamedObject(std::istream& in, std::int32_t contentSize, M3DSceneHandler& handler)
 {
     std::string name;
     if (!readString(in, contentSize, name)) { return false; }
-    M3DModel model;
-    model.setName(std::move(name));
-    if (!readChunks(in, contentSize, model, processModelChunk)) { return false; }
-    scene.addModel(std::move(model));
-    return true;
+    if (!handler.beginObject(std::move(name))) { return false; }
+    if (!readChunks(in, contentSize, handler, processModelChunk)) { return false; }
+    return handler.endObject();
 }
 
 
-bool readMaterialEntry(std::istream& in, std::int32_t contentSize, M3DScene& scene)
+bool readMaterialEntry(std::istream& in, std::int32_t contentSize, M3DSceneHandler& handler)
 {
     M3DMaterial material;
     if (!readChunks(in, contentSize, material, processMaterialChunk)) { return false; }
-    scene.addMaterial(std::move(material));
-    return true;
+    return handler.material(std::move(material));
 }
 
 
-bool readBackgroundColor(std::istream& in, std::int32_t contentSize, M3DScene& scene)
+bool readBackgroundColor(std::istream& in, std::int32_t contentSize, M3DSceneHandler& handler)
 {
     M3DColor color;
     if (!readChunks(in, contentSize, color, processColorChunk)) { return false; }
-    scene.setBackgroundColor(color);
+    handler.backgroundColor(color);
     return true;
 }
 
 
-bool processMeshdataChunk(std::istream& in, M3DChunkType chunkType, std::int32_t contentSize, M3DScene& scene)
+bool processMeshdataChunk(std::istream& in, M3DChunkType chunkType, std::int32_t contentSize, M3DSceneHandler& handler)
 {
     switch (chunkType)
     {
     case M3DChunkType::NamedObject:
         GetLogger()->debug("Processing NamedObject chunk\n");
-        return readNamedObject(in, contentSize, scene);
+        return readNamedObject(in, contentSize, handler);
 
     case M3DChunkType::MaterialEntry:
         GetLogger()->debug("Processing MaterialEntry chunk\n");
-        return readMaterialEntry(in, contentSize, scene);
+        return readMaterialEntry(in, contentSize, handler);
 
     case M3DChunkType::BackgroundColor:
         GetLogger()->debug("Processing BackgroundColor chunk\n");
-        return readBackgroundColor(in, contentSize, scene);
+        return readBackgroundColor(in, contentSize, handler);
 
     default:
         return skipChunk(in, chunkType, contentSize);
@@ -762,7 +758,7 @@ bool processMeshdataChunk(std::istream& in, M3DChunkType chunkType, std::int32_t
 }
 
 
-bool processTopLevelChunk(std::istream& in, M3DChunkType chunkType, std::int32_t contentSize, M3DScene& scene)
+bool processTopLevelChunk(std::istream& in, M3DChunkType chunkType, std::int32_t contentSize, M3DSceneHandler& handler)
 {
     if (chunkType != M3DChunkType::Meshdata)
     {
@@ -770,31 +766,93 @@ bool processTopLevelChunk(std::istream& in, M3DChunkType chunkType, std::int32_t
     }
 
     GetLogger()->debug("Processing Meshdata chunk\n");
-    return readChunks(in, contentSize, scene, processMeshdataChunk);
+    return readChunks(in, contentSize, handler, processMeshdataChunk);
 }
 
+
+// Collects everything into an M3DScene
+class SceneBuilder : public M3DSceneHandler
+{
+ public:
+    explicit SceneBuilder(M3DScene& _scene) : scene(_scene) {}
+
+    bool material(M3DMaterial&& material) override
+    {
+        scene.addMaterial(std::move(material));
+        return true;
+    }
+
+    bool beginObject(std::string&& name) override
+    {
+        model = M3DModel();
+        model.setName(std::move(name));
+        return true;
+    }
+
+    bool triangleMesh(M3DTriangleMesh&& mesh) override
+    {
+        model.addTriMesh(std::move(mesh));
+        return true;
+    }
+
+    bool endObject() override
+    {
+        scene.addModel(std::move(model));
+        return true;
+    }
+
+    void backgroundColor(const M3DColor& color) override
+    {
+        scene.setBackgroundColor(color);
+    }
+
+ private:
+    M3DScene& scene;
+    M3DModel model;
+};
+
 } // end unnamed namespace
 
 
-std::unique_ptr<M3DScene> Read3DSFile(std::istream& in)
+bool Read3DSFile(std::istream& in, M3DSceneHandler& handler)
 {
     if (M3DChunkType chunkType; !readChunkType(in, chunkType) || chunkType != M3DChunkType::Magic)
     {
         GetLogger()->error("Read3DSFile: Wrong magic number in header\n");
-        return nullptr;
+        return false;
     }
 
     std::int32_t chunkSize;
     if (!util::readLE<std::int32_t>(in, chunkSize) || chunkSize < chunkHeaderSize)
     {
         GetLogger()->error("Read3DSFile: Error reading 3DS file top level chunk size\n");
-        return nullptr;
+        return false;
     }
 
     GetLogger()->verbose("3DS file, {} bytes\n", chunkSize + chunkHeaderSize);
 
+    return readChunks(in, chunkSize - chunkHeaderSize, handler, processTopLevelChunk);
+}
+
+
+bool Read3DSFile(const fs::path& filename, M3DSceneHandler& handler)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.good())
+    {
+        GetLogger()->error("Read3DSFile: Error opening {}\n", filename);
+        return false;
+    }
+
+    return Read3DSFile(in, handler);
+}
+
+
+std::unique_ptr<M3DScene> Read3DSFile(std::istream& in)
+{
     auto scene = std::make_unique<M3DScene>();
-    if (!readChunks(in, chunkSize - chunkHeaderSize, *scene, processTopLevelChunk))
+    SceneBuilder builder(*scene);
+    if (!Read3DSFile(in, builder))
     {
         return nullptr;
     }
@@ -805,14 +863,12 @@ std::unique_ptr<M3DScene> Read3DSFile(std::istream& in)
 
 std::unique_ptr<M3DScene> Read3DSFile(const fs::path& filename)
 {
-    std::ifstream in(filename, std::ios::in | std::ios::binary);
-    if (!in.good())
+    auto scene = std::make_unique<M3DScene>();
+    SceneBuilder builder(*scene);
+    if (!Read3DSFile(filename, builder))
     {
-        GetLogger()->error("Read3DSFile: Error opening {}\n", filename);
         return nullptr;
     }
 
-    std::unique_ptr<M3DScene> scene = Read3DSFile(in);
-    in.close();
     return scene;
 }
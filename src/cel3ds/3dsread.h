@@ -11,9 +11,32 @@
 
 #include <iosfwd>
 #include <memory>
+#include <string>
 #include <celcompat/filesystem.h>
 
+class M3DColor;
+class M3DMaterial;
 class M3DScene;
+class M3DTriangleMesh;
+
+// Receives the contents of a 3DS file in the order they are read, so that
+// each triangle mesh can be converted and released before the next one is
+// read instead of keeping the whole scene in memory. Returning false from
+// a callback stops reading.
+class M3DSceneHandler
+{
+ public:
+    virtual ~M3DSceneHandler() = default;
+
+    virtual bool material(M3DMaterial&& material) = 0;
+    virtual bool beginObject(std::string&& /* name */) { return true; }
+    virtual bool triangleMesh(M3DTriangleMesh&& mesh) = 0;
+    virtual bool endObject() { return true; }
+    virtual void backgroundColor(const M3DColor& /* color */) {}
+};
+
+bool Read3DSFile(std::istream& in, M3DSceneHandler& handler);
+bool Read3DSFile(const fs::path& filename, M3DSceneHandler& handler);
 
 std::unique_ptr<M3DScene> Read3DSFile(std::istream& in);
 std::unique_ptr<M3DScene> Read3DSFile(const fs::path& filename);
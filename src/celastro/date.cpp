@@ -11,10 +11,12 @@
 #include "date.h"
 
 #include <array>
+#include <atomic>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <ctime>
+#include <limits>
 #include <locale>
 #include <memory>
 #include <string_view>
@@ -82,6 +84,40 @@ constexpr std::array<LeapSecondRecord, 28> LeapSeconds
 
 celestia::util::array_view<LeapSecondRecord> g_leapSeconds = LeapSeconds; //NOSONAR
 
+// Index of the leap second record found by the last search. It is only a
+// hint, so threads racing on it cost at most a longer search.
+std::atomic<std::size_t> g_lastLeapSecond{ 0 }; //NOSONAR
+
+// Returns the index of the last leap second record i > 0 for which
+// passed(i) holds, or 0 if there is none. passed must hold for the records
+// up to some index and not after it. Conversions are usually for times
+// close to the previous one, so the record found last is tried first,
+// before a binary search.
+template<typename F>
+std::size_t
+findLeapSecond(F passed)
+{
+    std::size_t count = g_leapSeconds.size();
+    std::size_t hint = g_lastLeapSecond.load(std::memory_order_relaxed);
+    if (hint < count && (hint == 0 || passed(hint)) && (hint + 1 == count || !passed(hint + 1)))
+        return hint;
+
+    std::size_t low = 1;
+    std::size_t high = count;
+    while (low < high)
+    {
+        std::size_t mid = low + (high - low) / 2;
+        if (passed(mid))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    g_lastLeapSecond.store(low - 1, std::memory_order_relaxed);
+    return low - 1;
+}
+
+
 #if !(defined(__GNUC__) && !defined(_WIN32))
 class MonthAbbreviations
 {
@@ -133,6 +169,7 @@ void
 setLeapSeconds(celestia::util::array_view<LeapSecondRecord> leapSeconds)
 {
     g_leapSeconds = leapSeconds;
+    g_lastLeapSecond.store(0, std::memory_order_relaxed);
 }
 
 Date::Date(int Y, int M, int D) :
@@ -340,23 +377,17 @@ parseDate(const std::string& s, Date& date)
 Date
 TAItoUTC(double tai)
 {
-    int dAT = g_leapSeconds[0].seconds;
-    int extraSecs = 0;
-
-    for (std::size_t i = g_leapSeconds.size() - 1; i > 0; i--) //NOSONAR
+    // Within a leap second, the time is only past the insertion when the
+    // previous offset is subtracted
+    std::size_t record = findLeapSecond([tai](std::size_t i)
     {
-        if (tai - secsToDays(g_leapSeconds[i].seconds) >= g_leapSeconds[i].t)
-        {
-            dAT = g_leapSeconds[i].seconds;
-            break;
-        }
-        if (tai - secsToDays(g_leapSeconds[i - 1].seconds) >= g_leapSeconds[i].t)
-        {
-            dAT = g_leapSeconds[i].seconds;
-            extraSecs = g_leapSeconds[i].seconds - g_leapSeconds[i - 1].seconds;
-            break;
-        }
-    }
+        return tai - secsToDays(g_leapSeconds[i - 1].seconds) >= g_leapSeconds[i].t;
+    });
+
+    int dAT = g_leapSeconds[record].seconds;
+    int extraSecs = 0;
+    if (record > 0 && tai - secsToDays(dAT) < g_leapSeconds[record].t)
+        extraSecs = dAT - g_leapSeconds[record - 1].seconds;
 
     Date utcDate(tai - secsToDays(dAT));
     utcDate.seconds += extraSecs;
@@ -368,17 +399,9 @@ TAItoUTC(double tai)
 double
 UTCtoTAI(const Date& utc)
 {
-    double dAT = g_leapSeconds[0].seconds;
     auto utcjd = (double) Date(utc.year, utc.month, utc.day);
-
-    for (std::size_t i = g_leapSeconds.size() - 1; i > 0; i--)
-    {
-        if (utcjd >= g_leapSeconds[i].t)
-        {
-            dAT = g_leapSeconds[i].seconds;
-            break;
-        }
-    }
+    std::size_t record = findLeapSecond([utcjd](std::size_t i) { return utcjd >= g_leapSeconds[i].t; });
+    double dAT = g_leapSeconds[record].seconds;
 
     double tai = utcjd + secsToDays(utc.hour * 3600.0 + utc.minute * 60.0 + utc.seconds + dAT);
 
@@ -399,9 +422,21 @@ TAItoTT(double tai)
     return tai + secsToDays(dTA);
 }
 
-// Input is a TDB Julian Date; result is in seconds
+namespace
+{
+
+// The TDB correction over one day, interpolated linearly from its values
+// at the start and end of the day, which is within 1e-7 seconds of the
+// series. Each thread keeps the day it used last.
+struct TDBCorrectionSegment
+{
+    double start{ std::numeric_limits<double>::quiet_NaN() };
+    double correction{ 0.0 };
+    double rate{ 0.0 };
+};
+
 double
-TDBcorrection(double tdb)
+computeTDBCorrection(double tdb)
 {
     // Correction for converting from Terrestrial Time to Barycentric Dynamical
     // Time. Constants and algorithm from "Time Routines in CSPICE",
@@ -423,6 +458,29 @@ TDBcorrection(double tdb)
     return K * std::sin(E);
 }
 
+} // end unnamed namespace
+
+// Input is a TDB Julian Date; result is in seconds
+double
+TDBcorrection(double tdb)
+{
+    thread_local TDBCorrectionSegment segment;
+
+    double start = std::floor(tdb);
+    if (start != segment.start)
+    {
+        // Outside the range where days are resolved, evaluate directly
+        if (!(std::abs(start) < 1.0e9))
+            return computeTDBCorrection(tdb);
+
+        segment.start = start;
+        segment.correction = computeTDBCorrection(start);
+        segment.rate = computeTDBCorrection(start + 1.0) - segment.correction;
+    }
+
+    return segment.correction + segment.rate * (tdb - start);
+}
+
 // Convert from Terrestrial Time to Barycentric Dynamical Time
 double
 TTtoTDB(double tt)
@@ -502,16 +560,8 @@ UTCtoTDB(const Date& utc)
 double
 JDUTCtoTAI(double utc)
 {
-    double dAT = g_leapSeconds[0].seconds;
-
-    for (std::size_t i = g_leapSeconds.size() - 1; i > 0; i--)
-    {
-        if (utc > g_leapSeconds[i].t)
-        {
-            dAT = g_leapSeconds[i].seconds;
-            break;
-        }
-    }
+    std::size_t record = findLeapSecond([utc](std::size_t i) { return utc > g_leapSeconds[i].t; });
+    double dAT = g_leapSeconds[record].seconds;
 
     return utc + secsToDays(dAT);
 }
@@ -520,16 +570,11 @@ JDUTCtoTAI(double utc)
 double
 TAItoJDUTC(double tai)
 {
-    double dAT = g_leapSeconds[0].seconds;
-
-    for (std::size_t i = g_leapSeconds.size() - 1; i > 0; i--)
+    std::size_t record = findLeapSecond([tai](std::size_t i)
     {
-        if (tai - secsToDays(g_leapSeconds[i - 1].seconds) > g_leapSeconds[i].t)
-        {
-            dAT = g_leapSeconds[i].seconds;
-            break;
-        }
-    }
+        return tai - secsToDays(g_leapSeconds[i - 1].seconds) > g_leapSeconds[i].t;
+    });
+    double dAT = g_leapSeconds[record].seconds;
 
     return tai - secsToDays(dAT);
 }
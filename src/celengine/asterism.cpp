@@ -27,8 +27,7 @@ namespace
 
 bool
 readChain(Tokenizer& tokenizer,
-          Asterism::Chain& chain,
-          const StarDatabase& starDB,
+          std::vector<std::string>& chain,
           std::string_view astName)
 {
     for (;;)
@@ -43,14 +42,7 @@ readChain(Tokenizer& tokenizer,
             return false;
         }
 
-        const Star* star = starDB.find(*starName, false);
-        if (!star)
-            star = starDB.find(ReplaceGreekLetterAbbr(*starName), false);
-
-        if (star)
-            chain.push_back(star->getPosition());
-        else
-            GetLogger()->warn("Error loading star \"{}\" for asterism \"{}\"\n", *starName, astName);
+        chain.emplace_back(*starName);
     }
 
     return true;
@@ -58,8 +50,7 @@ readChain(Tokenizer& tokenizer,
 
 bool
 readChains(Tokenizer& tokenizer,
-           std::vector<Asterism::Chain>& chains,
-           const StarDatabase& starDB,
+           std::vector<std::vector<std::string>>& chains,
            std::string_view astName)
 {
     if (tokenizer.nextToken() != Tokenizer::TokenBeginArray)
@@ -80,15 +71,8 @@ readChains(Tokenizer& tokenizer,
             return false;
         }
 
-        Asterism::Chain chain;
-        if (!readChain(tokenizer, chain, starDB, astName))
+        if (!readChain(tokenizer, chains.emplace_back(), astName))
             return false;
-
-        // skip empty (without or only with a single star) chains - no lines can be drawn for these
-        if (chain.size() > 1)
-            chains.push_back(std::move(chain));
-        else
-            GetLogger()->warn("Empty or single-element chain found in asterism \"{}\"\n", astName);
     }
 
     return true;
@@ -199,7 +183,14 @@ Asterism::averagePosition() const
 std::unique_ptr<AsterismList>
 ReadAsterismList(std::istream& in, const StarDatabase& starDB)
 {
-    auto asterisms = std::make_unique<AsterismList>();
+    std::vector<AsterismDefinition> definitions;
+    ParseAsterismList(in, definitions);
+    return ResolveAsterismList(definitions, starDB);
+}
+
+bool
+ParseAsterismList(std::istream& in, std::vector<AsterismDefinition>& definitions)
+{
     Tokenizer tokenizer(&in);
 
     while (tokenizer.nextToken() != Tokenizer::TokenEnd)
@@ -208,18 +199,53 @@ ReadAsterismList(std::istream& in, const StarDatabase& starDB)
         if (!tokenValue.has_value())
         {
             GetLogger()->error("Error parsing asterism file: expected string\n");
-            return asterisms;
+            return false;
         }
 
-        std::string astName(*tokenValue);
+        AsterismDefinition definition;
+        definition.name = *tokenValue;
+        if (!readChains(tokenizer, definition.chains, definition.name))
+            return false;
+
+        definitions.push_back(std::move(definition));
+    }
+
+    return true;
+}
+
+std::unique_ptr<AsterismList>
+ResolveAsterismList(const std::vector<AsterismDefinition>& definitions, const StarDatabase& starDB)
+{
+    auto asterisms = std::make_unique<AsterismList>();
+    for (const AsterismDefinition& definition : definitions)
+    {
         std::vector<Asterism::Chain> chains;
-        if (!readChains(tokenizer, chains, starDB, astName))
-            return asterisms;
+        for (const auto& starNames : definition.chains)
+        {
+            Asterism::Chain chain;
+            for (const std::string& starName : starNames)
+            {
+                const Star* star = starDB.find(starName, false);
+                if (!star)
+                    star = starDB.find(ReplaceGreekLetterAbbr(starName), false);
+
+                if (star)
+                    chain.push_back(star->getPosition());
+                else
+                    GetLogger()->warn("Error loading star \"{}\" for asterism \"{}\"\n", starName, definition.name);
+            }
+
+            // skip empty (without or only with a single star) chains - no lines can be drawn for these
+            if (chain.size() > 1)
+                chains.push_back(std::move(chain));
+            else
+                GetLogger()->warn("Empty or single-element chain found in asterism \"{}\"\n", definition.name);
+        }
 
         if (chains.empty())
-            GetLogger()->warn("No valid chains found for asterism \"{}\"\n", astName);
+            GetLogger()->warn("No valid chains found for asterism \"{}\"\n", definition.name);
         else
-            asterisms->emplace_back(std::move(astName), std::move(chains));
+            asterisms->emplace_back(std::string(definition.name), std::move(chains));
     }
 
     return asterisms;
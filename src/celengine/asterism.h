@@ -63,4 +63,17 @@ private:
 
 using AsterismList = std::vector<Asterism>;
 
+// An asterism as read from a file, before its stars are looked up
+struct AsterismDefinition
+{
+    std::string name;
+    std::vector<std::vector<std::string>> chains;
+};
+
 std::unique_ptr<AsterismList> ReadAsterismList(std::istream&, const StarDatabase&);
+
+// Reads the definitions of an asterism file without a star database, so
+// that it can be done on another thread. Returns false on syntax errors,
+// keeping the asterisms before the error.
+bool ParseAsterismList(std::istream&, std::vector<AsterismDefinition>&);
+std::unique_ptr<AsterismList> ResolveAsterismList(const std::vector<AsterismDefinition>&, const StarDatabase&);
@@ -13,6 +13,8 @@
 #include <celcompat/numbers.h>
 #include <celmath/mathlib.h>
 #include <celutil/gettext.h>
+#include <celutil/memoryusage.h>
+#include <celutil/objectpool.h>
 #include <celutil/utf8.h>
 #include "geometry.h"
 #include "meshmanager.h"
@@ -39,6 +41,14 @@ namespace
 
 const Color defaultCometTailColor(0.5f, 0.5f, 0.75f);
 
+// Never destroyed, since bodies may outlive other static objects
+util::ObjectPool<Body>&
+bodyPool()
+{
+    static auto* pool = new util::ObjectPool<Body>();
+    return *pool;
+}
+
 constexpr auto CLASSES_VISIBLE_AS_POINT = ~(BodyClassification::Invisible      |
                                             BodyClassification::SurfaceFeature |
                                             BodyClassification::Component      |
@@ -69,6 +79,29 @@ Body::~Body()
 }
 
 
+void* Body::operator new(std::size_t size)
+{
+    if (size != sizeof(Body))
+        return ::operator new(size);
+    return bodyPool().allocate();
+}
+
+
+void Body::operator delete(void* p, std::size_t size) noexcept
+{
+    if (size != sizeof(Body))
+        ::operator delete(p);
+    else
+        bodyPool().deallocate(p);
+}
+
+
+std::size_t Body::getPoolMemoryUsage()
+{
+    return bodyPool().memoryUsage();
+}
+
+
 /*! Reset body attributes to their default values. The object hierarchy is left untouched,
  *  i.e. child objects are not removed. Alternate surfaces and locations are not removed
  *  either.
@@ -238,6 +271,20 @@ void Body::markChanged()
 {
     if (timeline)
         timeline->markChanged();
+    invalidateStateCaches();
+}
+
+
+std::uint64_t Body::stateGeneration = 1;
+
+void Body::invalidateStateCaches()
+{
+    ++stateGeneration;
+}
+
+std::uint64_t Body::getStateGeneration()
+{
+    return stateGeneration;
 }
 
 
@@ -560,22 +607,26 @@ PlanetarySystem* Body::getOrCreateSatellites()
  */
 UniversalCoord Body::getPosition(double tdb) const
 {
-    Vector3d position = Vector3d::Zero();
-
-    const TimelinePhase* phase = timeline->findPhase(tdb).get();
-    Vector3d p = phase->orbit()->positionAtTime(tdb);
-    const ReferenceFrame* frame = phase->orbitFrame().get();
-
-    while (frame->getCenter().getType() == SelectionType::Body)
+    if (stateCache.positionGeneration != stateGeneration || stateCache.positionTime != tdb)
     {
-        phase = frame->getCenter().body()->timeline->findPhase(tdb).get();
-        position += frame->getOrientation(tdb).conjugate() * p;
-        p = phase->orbit()->positionAtTime(tdb);
-        frame = phase->orbitFrame().get();
+        stateCache.position = computePosition(tdb);
+        stateCache.positionGeneration = stateGeneration;
+        stateCache.positionTime = tdb;
     }
 
-    position += frame->getOrientation(tdb).conjugate() * p;
+    return stateCache.position;
+}
+
 
+UniversalCoord Body::computePosition(double tdb) const
+{
+    const TimelinePhase* phase = timeline->findPhase(tdb).get();
+    const ReferenceFrame* frame = phase->orbitFrame().get();
+    Vector3d position = frame->getOrientation(tdb).conjugate() * phase->orbit()->positionAtTime(tdb);
+
+    // Frame centers are taken from their own caches instead of walking the
+    // whole chain of frames for every body, so each center and frame in the
+    // frame tree is evaluated once per tick, parents before their children.
     if (frame->getCenter().star())
         return frame->getCenter().star()->getPosition(tdb).offsetKm(position);
     else
@@ -586,6 +637,19 @@ UniversalCoord Body::getPosition(double tdb) const
 /*! Get the orientation of the body in the universal coordinate system.
  */
 Quaterniond Body::getOrientation(double tdb) const
+{
+    if (stateCache.orientationGeneration != stateGeneration || stateCache.orientationTime != tdb)
+    {
+        stateCache.orientation = computeOrientation(tdb);
+        stateCache.orientationGeneration = stateGeneration;
+        stateCache.orientationTime = tdb;
+    }
+
+    return stateCache.orientation;
+}
+
+
+Quaterniond Body::computeOrientation(double tdb) const
 {
     const TimelinePhase* phase = timeline->findPhase(tdb).get();
     return phase->rotationModel()->orientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
@@ -656,6 +720,57 @@ Vector3d Body::getAstrocentricPosition(double tdb) const
 }
 
 
+/*! Get the astrocentric positions at the count evenly spaced times
+ *  startTime + i * step. Orbits that support it evaluate all the times of
+ *  a timeline phase at once, which is much faster than calling
+ *  getAstrocentricPosition() for each.
+ */
+void Body::getAstrocentricPositions(double startTime, double step, Vector3d* positions, std::size_t count) const
+{
+    std::size_t first = 0;
+    while (first < count)
+    {
+        double t = startTime + static_cast<double>(first) * step;
+        const TimelinePhase* phase = timeline->findPhase(t).get();
+
+        std::size_t last = first + 1;
+        while (last < count && timeline->findPhase(startTime + static_cast<double>(last) * step).get() == phase)
+            ++last;
+
+        phase->orbit()->positionsAtTimes(t, step, positions + first, last - first);
+        phase->orbitFrame()->convertToAstrocentric(positions + first, t, step, last - first);
+        first = last;
+    }
+}
+
+
+/*! Get the orientations in the universal frame at the count evenly spaced
+ *  times startTime + i * step, as with getAstrocentricPositions().
+ */
+void Body::getOrientations(double startTime, double step, Quaterniond* orientations, std::size_t count) const
+{
+    std::vector<Quaterniond> frames;
+    std::size_t first = 0;
+    while (first < count)
+    {
+        double t = startTime + static_cast<double>(first) * step;
+        const TimelinePhase* phase = timeline->findPhase(t).get();
+
+        std::size_t last = first + 1;
+        while (last < count && timeline->findPhase(startTime + static_cast<double>(last) * step).get() == phase)
+            ++last;
+
+        std::size_t n = last - first;
+        frames.resize(n);
+        phase->rotationModel()->orientationsAtTimes(t, step, orientations + first, n);
+        phase->bodyFrame()->getOrientations(t, step, frames.data(), n);
+        for (std::size_t i = 0; i < n; ++i)
+            orientations[first + i] = orientations[first + i] * frames[i];
+        first = last;
+    }
+}
+
+
 /*! Get a rotation that converts from the ecliptic frame to the body frame.
  */
 Quaterniond Body::getEclipticToFrame(double tdb) const
@@ -680,8 +795,8 @@ Quaterniond Body::getEclipticToEquatorial(double tdb) const
  */
 Quaterniond Body::getEclipticToBodyFixed(double tdb) const
 {
-    const TimelinePhase* phase = timeline->findPhase(tdb).get();
-    return phase->rotationModel()->orientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
+    // Same rotation as the universal orientation
+    return getOrientation(tdb);
 }
 
 
@@ -1020,21 +1135,35 @@ PlanetarySystem::PlanetarySystem(Body* _primary) :
         star = primary->getSystem()->getStar();
 }
 
+std::uint64_t PlanetarySystem::nameIndexGeneration = 1;
+
 PlanetarySystem::PlanetarySystem(Star* _star) :
-    star(_star)
+    star(_star),
+    deepIndex(std::make_unique<DeepIndex>())
 {
 }
 
+PlanetarySystem*
+PlanetarySystem::getRootSystem()
+{
+    PlanetarySystem* root = this;
+    while (root->primary != nullptr && root->primary->getSystem() != nullptr)
+        root = root->primary->getSystem();
+    return root;
+}
+
 /*! Add a new alias for an object. If an object with the specified
- *  alias already exists in the planetary system, the old entry will
- *  be replaced.
+ *  alias already exists in the planetary system, the old entry is kept.
  */
 void
 PlanetarySystem::addAlias(Body* body, const string& alias)
 {
     assert(body->getSystem() == this);
 
-    objectIndex.try_emplace(alias, body);
+    const std::vector<std::string>& names = body->getNames();
+    auto it = std::find(names.begin(), names.end(), alias);
+    if (it != names.end())
+        addName(body, static_cast<std::size_t>(it - names.begin()));
 }
 
 Body*
@@ -1059,28 +1188,70 @@ PlanetarySystem::removeBody(const Body* body)
     satellites.erase(iter);
 }
 
+void
+PlanetarySystem::addName(Body* body, std::size_t nameIndex)
+{
+    std::string key = UTF8NormalizeString(body->getNames()[nameIndex]);
+    if (PlanetarySystem* root = getRootSystem(); root->deepIndex != nullptr)
+        root->deepIndex->names.try_emplace(key, IndexEntry{ body, nameIndex });
+    objectIndex.try_emplace(std::move(key), IndexEntry{ body, nameIndex });
+    sortedNamesValid = false;
+}
+
 // Add all aliases for the body to the name index
 void
 PlanetarySystem::addBodyToNameIndex(Body* body)
 {
-    const std::vector<std::string>& names = body->getNames();
-    for (const auto& name : names)
-    {
-        objectIndex.try_emplace(name, body);
-    }
+    for (std::size_t i = 0; i < body->getNames().size(); ++i)
+        addName(body, i);
+
+    if (PlanetarySystem* root = getRootSystem(); root->deepIndex != nullptr && body->hasLocalizedName())
+        root->deepIndex->localizedNames.try_emplace(UTF8NormalizeString(body->getLocalizedName()), body);
 }
 
 void
 PlanetarySystem::removeBodyFromNameIndex(const Body* body)
 {
-    const std::vector<std::string>& names = body->getNames();
-    for (const auto& name : names)
+    ++nameIndexGeneration;
+
+    for (const auto& name : body->getNames())
     {
-        auto iter = objectIndex.find(name);
-        if (iter == objectIndex.end() || iter->second != body)
+        auto iter = objectIndex.find(UTF8NormalizeString(name));
+        if (iter == objectIndex.end() || iter->second.body != body)
             continue;
         objectIndex.erase(iter);
     }
+
+    sortedNamesValid = false;
+    getRootSystem()->removeFromDeepIndex(body);
+}
+
+// Remove the body and the bodies orbiting it from the deep index
+void
+PlanetarySystem::removeFromDeepIndex(const Body* body)
+{
+    if (deepIndex == nullptr)
+        return;
+
+    for (const auto& name : body->getNames())
+    {
+        auto iter = deepIndex->names.find(UTF8NormalizeString(name));
+        if (iter != deepIndex->names.end() && iter->second.body == body)
+            deepIndex->names.erase(iter);
+    }
+
+    if (body->hasLocalizedName())
+    {
+        auto iter = deepIndex->localizedNames.find(UTF8NormalizeString(body->getLocalizedName()));
+        if (iter != deepIndex->localizedNames.end() && iter->second == body)
+            deepIndex->localizedNames.erase(iter);
+    }
+
+    if (const PlanetarySystem* satelliteSystem = body->getSatellites(); satelliteSystem != nullptr)
+    {
+        for (const auto& sat : satelliteSystem->satellites)
+            removeFromDeepIndex(sat.get());
+    }
 }
 
 /*! Find a body with the specified name within a planetary system.
@@ -1094,9 +1265,10 @@ PlanetarySystem::removeBodyFromNameIndex(const Body* body)
 Body*
 PlanetarySystem::find(std::string_view _name, bool deepSearch, bool i18n) const
 {
-    if (auto firstMatch = objectIndex.find(_name); firstMatch != objectIndex.end())
+    std::string key = UTF8NormalizeString(_name);
+    if (auto firstMatch = objectIndex.find(key); firstMatch != objectIndex.end())
     {
-        Body* matchedBody = firstMatch->second;
+        Body* matchedBody = firstMatch->second.body;
 
         if (i18n)
             return matchedBody;
@@ -1105,36 +1277,74 @@ PlanetarySystem::find(std::string_view _name, bool deepSearch, bool i18n) const
             return matchedBody;
     }
 
-    if (deepSearch)
+    if (!deepSearch)
+        return nullptr;
+
+    // The system of a star indexes the names of all of its bodies
+    if (deepIndex != nullptr)
+        return findDeep(_name, key, i18n);
+
+    for (const auto& satellite : satellites)
     {
-        for (const auto& satellite : satellites)
+        Body* sat = satellite.get();
+        if (!UTF8StringCompare(sat->getName(false), _name))
+            return sat;
+        if (i18n && !UTF8StringCompare(sat->getName(true), _name))
+            return sat;
+        if (sat->getSatellites())
         {
-            Body* sat = satellite.get();
-            if (!UTF8StringCompare(sat->getName(false), _name))
-                return sat;
-            if (i18n && !UTF8StringCompare(sat->getName(true), _name))
-                return sat;
-            if (sat->getSatellites())
-            {
-                Body* body = sat->getSatellites()->find(_name, deepSearch, i18n);
-                if (body)
-                    return body;
-            }
+            Body* body = sat->getSatellites()->find(_name, deepSearch, i18n);
+            if (body)
+                return body;
         }
     }
 
     return nullptr;
 }
 
+Body*
+PlanetarySystem::findDeep(std::string_view name, const std::string& key, bool i18n) const
+{
+    if (auto it = deepIndex->names.find(key); it != deepIndex->names.end())
+    {
+        Body* matchedBody = it->second.body;
+        if (i18n || !matchedBody->hasLocalizedName() || name != matchedBody->getLocalizedName())
+            return matchedBody;
+    }
+
+    if (i18n)
+    {
+        if (auto it = deepIndex->localizedNames.find(key); it != deepIndex->localizedNames.end())
+            return it->second;
+    }
+
+    return nullptr;
+}
+
 void
 PlanetarySystem::getCompletion(std::vector<std::string>& completion,
                                std::string_view _name,
                                bool deepSearch) const
 {
+    if (!sortedNamesValid)
+    {
+        sortedNames.clear();
+        sortedNames.reserve(objectIndex.size());
+        for (const auto& [key, entry] : objectIndex)
+            sortedNames.push_back(entry);
+        std::sort(sortedNames.begin(), sortedNames.end(),
+                  [](const IndexEntry& lhs, const IndexEntry& rhs)
+                  {
+                      return UTF8StringCompare(lhs.body->getNames()[lhs.nameIndex],
+                                               rhs.body->getNames()[rhs.nameIndex]) < 0;
+                  });
+        sortedNamesValid = true;
+    }
+
     // Search through all names in this planetary system.
-    for (const auto& index : objectIndex)
+    for (const IndexEntry& entry : sortedNames)
     {
-        const string& alias = index.first;
+        const string& alias = entry.body->getNames()[entry.nameIndex];
 
         if (UTF8StartsWith(alias, _name))
         {
@@ -1160,6 +1370,58 @@ PlanetarySystem::getCompletion(std::vector<std::string>& completion,
     }
 }
 
+std::vector<Body*>
+PlanetarySystem::getBodies(BodyClassification mask, bool byName) const
+{
+    std::vector<Body*> bodies;
+    for (const auto& sat : satellites)
+    {
+        if (util::is_set(sat->getClassification(), mask))
+            bodies.push_back(sat.get());
+    }
+
+    if (byName)
+    {
+        std::stable_sort(bodies.begin(), bodies.end(),
+                         [](const Body* a, const Body* b)
+                         {
+                             return UTF8StringCompare(a->getName(true), b->getName(true)) < 0;
+                         });
+    }
+
+    return bodies;
+}
+
+std::size_t
+PlanetarySystem::getMemoryUsage() const
+{
+    using celestia::util::MemoryUsage;
+
+    std::size_t size = sizeof(*this) + MemoryUsage(satellites) + MemoryUsage(sortedNames);
+    // Hash nodes hold the entry and the link, plus one bucket pointer each
+    for (const auto& index : objectIndex)
+        size += sizeof(index) + 2 * sizeof(void*) + MemoryUsage(index.first);
+    if (deepIndex != nullptr)
+    {
+        for (const auto& index : deepIndex->names)
+            size += sizeof(index) + 2 * sizeof(void*) + MemoryUsage(index.first);
+        for (const auto& index : deepIndex->localizedNames)
+            size += sizeof(index) + 2 * sizeof(void*) + MemoryUsage(index.first);
+    }
+
+    for (const auto& sat : satellites)
+    {
+        size += sizeof(Body) + MemoryUsage(sat->getNames()) + MemoryUsage(sat->getInfoURL());
+        for (const std::string& name : sat->getNames())
+            size += MemoryUsage(name);
+
+        if (const PlanetarySystem* satelliteSystem = sat->getSatellites(); satelliteSystem != nullptr)
+            size += satelliteSystem->getMemoryUsage();
+    }
+
+    return size;
+}
+
 RingSystem*
 BodyFeaturesManager::getRings(const Body* body) const
 {
@@ -1338,6 +1600,7 @@ BodyFeaturesManager::addLocation(Body* body, std::unique_ptr<Location>&& loc)
     auto& bodyLocations = locations[body];
     loc->setParentBody(body);
     bodyLocations.locations.push_back(std::move(loc));
+    bodyLocations.labels.clear();
     body->features |= BodyFeatures::Locations;
 }
 
@@ -1368,6 +1631,54 @@ BodyFeaturesManager::hasLocations(const Body* body) const
     return util::is_set(body->features, BodyFeatures::Locations);
 }
 
+void
+LocationLabelData::clear()
+{
+    labelSizes.clear();
+    featureTypes.clear();
+    positions.clear();
+    locations.clear();
+}
+
+// Get the locations of a body ordered by decreasing label size, i.e. the
+// importance of the location or its size when no importance is set. Lets
+// the renderer stop at the first location too small to be labeled.
+const LocationLabelData&
+BodyFeaturesManager::getLocationLabels(const Body* body)
+{
+    assert(util::is_set(body->features, BodyFeatures::Locations));
+
+    auto it = locations.find(body);
+    assert(it != locations.end());
+
+    auto& bodyLocations = it->second;
+    auto& labels = bodyLocations.labels;
+    if (labels.size() != bodyLocations.locations.size())
+    {
+        std::vector<const Location*> sorted;
+        sorted.reserve(bodyLocations.locations.size());
+        for (const auto& loc : bodyLocations.locations)
+            sorted.push_back(loc.get());
+
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const Location* a, const Location* b) { return a->getLabelSize() > b->getLabelSize(); });
+
+        labels.clear();
+        labels.labelSizes.reserve(sorted.size());
+        labels.featureTypes.reserve(sorted.size());
+        labels.positions.reserve(sorted.size());
+        for (const Location* loc : sorted)
+        {
+            labels.labelSizes.push_back(loc->getLabelSize());
+            labels.featureTypes.push_back(loc->getFeatureType());
+            labels.positions.push_back(loc->getPosition());
+        }
+        labels.locations = std::move(sorted);
+    }
+
+    return labels;
+}
+
 // Compute the positions of locations on an irregular object using ray-mesh
 // intersections.  This is not automatically done when a location is added
 // because it would force the loading of all meshes for objects with
@@ -1386,14 +1697,23 @@ BodyFeaturesManager::computeLocations(const Body* body)
     if (bodyLocations.locationsComputed)
         return;
 
-    bodyLocations.locationsComputed = true;
-
     // No work to do if there's no mesh, or if the mesh cannot be loaded
     auto geometry = body->getGeometry();
     if (geometry == InvalidResource)
+    {
+        bodyLocations.locationsComputed = true;
         return;
+    }
 
-    const Geometry* g = engine::GetGeometryManager()->find(geometry);
+    // Try again on a later call while the mesh loads in the background
+    const Geometry* g = engine::GetGeometryManager()->request(geometry);
+    if (g == nullptr &&
+        engine::GetGeometryManager()->getState(geometry) != ResourceState::LoadingFailed)
+    {
+        return;
+    }
+
+    bodyLocations.locationsComputed = true;
     if (g == nullptr)
         return;
 
@@ -1420,6 +1740,9 @@ BodyFeaturesManager::computeLocations(const Body* body)
             loc->setPosition(v);
         }
     }
+
+    // The label positions are copies
+    bodyLocations.labels.clear();
 }
 
 bool
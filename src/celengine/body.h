@@ -22,6 +22,8 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -40,6 +42,7 @@ class FrameTree;
 class ReferenceMark;
 class Atmosphere;
 class StarDatabase;
+enum class BodyClassification : std::uint32_t;
 
 class PlanetarySystem
 {
@@ -66,16 +69,59 @@ public:
     Body* find(std::string_view, bool deepSearch = false, bool i18n = false) const;
     void getCompletion(std::vector<std::string>& completion, std::string_view _name, bool rec = true) const;
 
+    // The bodies of the system whose classification is one of those in
+    // mask, in the order they were added or, if byName is set, ordered by
+    // their localized names. Used by the frontends' solar system browsers,
+    // which only build items for the bodies they show.
+    std::vector<Body*> getBodies(BodyClassification mask, bool byName = false) const;
+
+    // Bytes of memory used by the bodies of the system and their satellites,
+    // not including the body features, orbits and frames
+    std::size_t getMemoryUsage() const;
+
+    // Incremented whenever a name is removed from the index of any
+    // planetary system, i.e. when resolved object paths may be stale
+    static std::uint64_t getNameIndexGeneration() { return nameIndexGeneration; }
+
 private:
+    // A name of a body, as the position in Body::getNames()
+    struct IndexEntry
+    {
+        Body* body;
+        std::size_t nameIndex;
+    };
+
+    // Keyed by names normalized with UTF8NormalizeString()
+    using ObjectIndex = std::unordered_map<std::string, IndexEntry>;
+
+    // Names of the bodies of a star's system and all of their satellite
+    // systems, for deep searches
+    struct DeepIndex
+    {
+        ObjectIndex names;
+        std::unordered_map<std::string, Body*> localizedNames;
+    };
+
+    PlanetarySystem* getRootSystem();
+    void addName(Body* body, std::size_t nameIndex);
     void addBodyToNameIndex(Body* body);
     void removeBodyFromNameIndex(const Body* body);
-
-    using ObjectIndex = std::map<std::string, Body*, UTF8StringOrderingPredicate>;
+    void removeFromDeepIndex(const Body* body);
+    Body* findDeep(std::string_view name, const std::string& key, bool i18n) const;
 
     Star* star;
     Body* primary{nullptr};
     std::vector<std::unique_ptr<Body>> satellites;
     ObjectIndex objectIndex;  // index of bodies by name
+    // Only the system of a star has one
+    std::unique_ptr<DeepIndex> deepIndex;
+
+    // The names of objectIndex in UTF-8 order for completion, built on
+    // first use after a change
+    mutable std::vector<IndexEntry> sortedNames;
+    mutable bool sortedNamesValid{ false };
+
+    static std::uint64_t nameIndexGeneration;
 };
 
 class RingSystem
@@ -188,6 +234,13 @@ public:
      Body(PlanetarySystem*, const std::string& name);
      ~Body();
 
+    // Catalogs of minor bodies create bodies by the hundred thousand, so
+    // they are allocated from a pool rather than one by one
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size) noexcept;
+    // Bytes held by the pool, including free slots
+    static std::size_t getPoolMemoryUsage();
+
     enum VisibilityPolicy
     {
         NeverVisible       = 0,
@@ -288,6 +341,8 @@ public:
 
     Eigen::Matrix4d getLocalToAstrocentric(double) const;
     Eigen::Vector3d getAstrocentricPosition(double) const;
+    void getAstrocentricPositions(double startTime, double step, Eigen::Vector3d* positions, std::size_t count) const;
+    void getOrientations(double startTime, double step, Eigen::Quaterniond* orientations, std::size_t count) const;
     Eigen::Quaterniond getEquatorialToBodyFixed(double) const;
     Eigen::Quaterniond getEclipticToFrame(double) const;
     Eigen::Quaterniond getEclipticToEquatorial(double) const;
@@ -333,9 +388,35 @@ public:
     void markUpdated();
     void recomputeCullingRadius();
 
+    // Drop the cached positions and orientations of all bodies; called when
+    // the simulation advances and whenever a body changes
+    static void invalidateStateCaches();
+    // Incremented by invalidateStateCaches(); other caches of per-tick state
+    // compare against it
+    static std::uint64_t getStateGeneration();
+
 private:
     void setName(const std::string& name);
 
+    UniversalCoord computePosition(double tdb) const;
+    Eigen::Quaterniond computeOrientation(double tdb) const;
+
+    // The renderer, picking, the HUD and scripts all ask for the positions
+    // of the same bodies at the same time during a frame, so the last
+    // results are kept. Entries from an older generation are stale.
+    struct StateCache
+    {
+        std::uint64_t positionGeneration{ 0 };
+        double positionTime{ 0.0 };
+        UniversalCoord position;
+        std::uint64_t orientationGeneration{ 0 };
+        double orientationTime{ 0.0 };
+        Eigen::Quaterniond orientation{ Eigen::Quaterniond::Identity() };
+    };
+
+    static std::uint64_t stateGeneration;
+    mutable StateCache stateCache;
+
     std::vector<std::string> names{ 1 };
     std::string localizedName;
 
@@ -380,9 +461,26 @@ private:
     friend class BodyFeaturesManager;
 };
 
+// The data needed to cull the labels of a body's locations, ordered by
+// decreasing label size and packed in separate arrays, so that the
+// renderer can find the locations large enough to be labeled with a
+// binary search and test them without following the location pointers.
+struct LocationLabelData
+{
+    std::vector<float> labelSizes;
+    std::vector<Location::FeatureType> featureTypes;
+    std::vector<Eigen::Vector3f> positions;
+    std::vector<const Location*> locations;
+
+    std::size_t size() const { return locations.size(); }
+    void clear();
+};
+
 struct BodyLocations
 {
     std::vector<std::unique_ptr<Location>> locations;
+    // Built on first use
+    LocationLabelData labels;
     bool locationsComputed;
 };
 
@@ -439,6 +537,7 @@ public:
     Location* findLocation(const Body*, std::string_view, bool i18n = false) const;
     bool hasLocations(const Body*) const;
     void computeLocations(const Body*);
+    const LocationLabelData& getLocationLabels(const Body*);
 
     auto getLocations(const Body* body) const
     {
@@ -0,0 +1,97 @@
+// bodypositions.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "bodypositions.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celephem/orbit.h>
+#include <celutil/threadpool.h>
+#include "body.h"
+#include "frame.h"
+#include "star.h"
+#include "timeline.h"
+#include "timelinephase.h"
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+// Number of orbit evaluations handed to a worker at a time
+constexpr std::size_t OrbitSamplesPerTask = 64;
+
+} // end unnamed namespace
+
+void
+GetBodyPositions(const Body& body,
+                 const std::vector<double>& times,
+                 std::vector<UniversalCoord>& positions)
+{
+    struct OrbitSample
+    {
+        std::size_t index;
+        const ephem::Orbit* orbit;
+        Eigen::Quaterniond orientation;
+        Eigen::Vector3d position;
+    };
+
+    std::vector<Eigen::Vector3d> offsets(times.size(), Eigen::Vector3d::Zero());
+    std::vector<OrbitSample> orbitSamples;
+    positions.resize(times.size());
+    for (std::size_t i = 0; i < times.size(); ++i)
+    {
+        double t = times[i];
+        const Body* child = &body;
+        const ReferenceFrame* frame;
+        for (;;)
+        {
+            const TimelinePhase* phase = child->getTimeline()->findPhase(t).get();
+            frame = phase->orbitFrame().get();
+            Eigen::Quaterniond orientation = frame->getOrientation(t).conjugate();
+            if (phase->orbit()->isThreadSafe())
+                orbitSamples.push_back({ i, phase->orbit().get(), orientation, Eigen::Vector3d::Zero() });
+            else
+                offsets[i] += orientation * phase->orbit()->positionAtTime(t);
+
+            if (frame->getCenter().getType() != SelectionType::Body)
+                break;
+            child = frame->getCenter().body();
+        }
+
+        if (frame->getCenter().star())
+            positions[i] = frame->getCenter().star()->getPosition(t);
+        else
+            positions[i] = frame->getCenter().getPosition(t);
+    }
+
+    std::size_t nTasks = (orbitSamples.size() + OrbitSamplesPerTask - 1) / OrbitSamplesPerTask;
+    util::ThreadPool::shared().parallelFor(nTasks,
+        [&](std::size_t task, unsigned int /* worker */)
+        {
+            std::size_t end = std::min(orbitSamples.size(), (task + 1) * OrbitSamplesPerTask);
+            for (std::size_t j = task * OrbitSamplesPerTask; j < end; ++j)
+            {
+                OrbitSample& sample = orbitSamples[j];
+                sample.position = sample.orbit->positionAtTime(times[sample.index]);
+            }
+        });
+
+    for (const OrbitSample& sample : orbitSamples)
+        offsets[sample.index] += sample.orientation * sample.position;
+    for (std::size_t i = 0; i < times.size(); ++i)
+        positions[i] = positions[i].offsetKm(offsets[i]);
+}
+
+} // end namespace celestia::engine
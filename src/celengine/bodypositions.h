@@ -0,0 +1,32 @@
+// bodypositions.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Positions of a body at many times at once.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <vector>
+
+#include <celengine/univcoord.h>
+
+class Body;
+
+namespace celestia::engine
+{
+
+// Computes the positions of a body at each of times. As in
+// Body::computePosition(), the position is the sum of the orbit positions
+// of the body and the bodies its frames are centered on. Frames cache their
+// orientation and are evaluated on this thread; the orbits are evaluated on
+// the shared thread pool when they allow it.
+void GetBodyPositions(const Body& body,
+                      const std::vector<double>& times,
+                      std::vector<UniversalCoord>& positions);
+
+} // end namespace celestia::engine
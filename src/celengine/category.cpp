@@ -1,7 +1,7 @@
 #include "category.h"
 
 #include <algorithm>
-#include <initializer_list>
+#include <iterator>
 #include <utility>
 
 #include <celutil/gettext.h>
@@ -56,20 +56,8 @@ UserCategoryManager::destroy(UserCategoryId category)
         return false;
 
     // remove all members
-    for (const Selection& sel : entry->m_members)
-    {
-        auto it = m_objectMap.find(sel);
-        if (it == m_objectMap.end())
-            continue;
-
-        auto& categories = it->second;
-        if (auto item = std::find(categories.begin(), categories.end(), category); item != categories.end())
-        {
-            categories.erase(item);
-            if (categories.empty())
-                m_objectMap.erase(it);
-        }
-    }
+    for (ObjectId objectId : entry->m_memberIds)
+        removeCategoryFromObject(objectId, category);
 
     m_active.erase(category);
     if (entry->m_parent == UserCategoryId::Invalid)
@@ -148,81 +136,200 @@ UserCategoryManager::createNew(UserCategoryId id,
 bool
 UserCategoryManager::addObject(Selection selection, UserCategoryId category)
 {
-    auto categoryIndex = static_cast<std::size_t>(category);
-    if (categoryIndex >= m_categories.size())
+    UserCategory* entry = getCategory(category);
+    if (entry == nullptr)
         return false;
 
-    if (!m_categories[categoryIndex]->m_members.emplace(selection).second)
+    auto objectId = findObject(selection);
+    if (!objectId.has_value())
+        objectId = addObjectEntry(selection);
+
+    // New objects get the highest ID, so this usually appends
+    auto& memberIds = entry->m_memberIds;
+    auto it = std::lower_bound(memberIds.begin(), memberIds.end(), *objectId);
+    if (it != memberIds.end() && *it == *objectId)
         return false;
 
-    if (auto it = m_objectMap.find(selection); it == m_objectMap.end())
-        m_objectMap.try_emplace(selection, std::initializer_list<UserCategoryId> { category });
-    else
-        it->second.push_back(category);
+    entry->m_members.insert(entry->m_members.begin() + (it - memberIds.begin()), selection);
+    memberIds.insert(it, *objectId);
+    m_objects[*objectId].categories.push_back(category);
     return true;
 }
 
 bool
 UserCategoryManager::removeObject(Selection selection, UserCategoryId category)
 {
-    auto categoryIndex = static_cast<std::size_t>(category);
-    if (categoryIndex >= m_categories.size())
+    UserCategory* entry = getCategory(category);
+    if (entry == nullptr)
         return false;
 
-    if (m_categories[categoryIndex]->m_members.erase(selection) == 0)
+    auto objectId = findObject(selection);
+    if (!objectId.has_value())
         return false;
 
-    auto it = m_objectMap.find(selection);
-    if (it == m_objectMap.end())
-    {
-        assert(false);
-        return true;
-    }
-
-    auto& categories = it->second;
-    if (auto item = std::find(categories.begin(), categories.end(), category); item != categories.end())
-    {
-        categories.erase(item);
-        if (categories.empty())
-            m_objectMap.erase(it);
-    }
+    auto& memberIds = entry->m_memberIds;
+    auto it = std::lower_bound(memberIds.begin(), memberIds.end(), *objectId);
+    if (it == memberIds.end() || *it != *objectId)
+        return false;
 
+    entry->m_members.erase(entry->m_members.begin() + (it - memberIds.begin()));
+    memberIds.erase(it);
+    removeCategoryFromObject(*objectId, category);
     return true;
 }
 
 void
 UserCategoryManager::clearCategories(Selection selection)
 {
-    auto iter = m_objectMap.find(selection);
-    if (iter == m_objectMap.end())
+    auto objectId = findObject(selection);
+    if (!objectId.has_value())
         return;
 
-    for (UserCategoryId category : iter->second)
-    {
-        m_categories[static_cast<std::size_t>(category)]->m_members.erase(selection);
-    }
-
-    m_objectMap.erase(selection);
+    // Take a copy, removing the last category releases the object entry
+    std::vector<UserCategoryId> categories = m_objects[*objectId].categories;
+    for (UserCategoryId category : categories)
+        removeObject(selection, category);
 }
 
 bool
 UserCategoryManager::isInCategory(Selection selection, UserCategoryId category) const
 {
-    auto categoryIndex = static_cast<std::size_t>(category);
-    if (categoryIndex >= m_categories.size())
+    const UserCategory* entry = getCategory(category);
+    if (entry == nullptr)
         return false;
 
-    const auto& members = m_categories[categoryIndex]->m_members;
-    return members.find(selection) != members.end();
+    auto objectId = findObject(selection);
+    return objectId.has_value() &&
+           std::binary_search(entry->m_memberIds.begin(), entry->m_memberIds.end(), *objectId);
 }
 
 const std::vector<UserCategoryId>*
 UserCategoryManager::getCategories(Selection selection) const
 {
-    auto it = m_objectMap.find(selection);
-    return it == m_objectMap.end()
-        ? nullptr
-        : &it->second;
+    auto objectId = findObject(selection);
+    return objectId.has_value()
+        ? &m_objects[*objectId].categories
+        : nullptr;
+}
+
+std::vector<Selection>
+UserCategoryManager::objectsInAll(celestia::util::array_view<UserCategoryId> categories) const
+{
+    if (categories.empty())
+        return {};
+
+    // Start from the smallest category to keep the intermediate results small
+    std::vector<const UserCategory*> entries;
+    entries.reserve(categories.size());
+    for (UserCategoryId category : categories)
+    {
+        const UserCategory* entry = getCategory(category);
+        if (entry == nullptr)
+            return {};
+        entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const UserCategory* a, const UserCategory* b) { return a->m_memberIds.size() < b->m_memberIds.size(); });
+
+    std::vector<ObjectId> result = entries.front()->m_memberIds;
+    std::vector<ObjectId> scratch;
+    for (auto it = entries.begin() + 1; it != entries.end() && !result.empty(); ++it)
+    {
+        scratch.clear();
+        std::set_intersection(result.begin(), result.end(),
+                              (*it)->m_memberIds.begin(), (*it)->m_memberIds.end(),
+                              std::back_inserter(scratch));
+        result.swap(scratch);
+    }
+
+    return toSelections(result);
+}
+
+std::vector<Selection>
+UserCategoryManager::objectsInAny(celestia::util::array_view<UserCategoryId> categories) const
+{
+    std::vector<ObjectId> result;
+    std::vector<ObjectId> scratch;
+    for (UserCategoryId category : categories)
+    {
+        const UserCategory* entry = getCategory(category);
+        if (entry == nullptr)
+            continue;
+
+        scratch.clear();
+        std::set_union(result.begin(), result.end(),
+                       entry->m_memberIds.begin(), entry->m_memberIds.end(),
+                       std::back_inserter(scratch));
+        result.swap(scratch);
+    }
+
+    return toSelections(result);
+}
+
+UserCategory*
+UserCategoryManager::getCategory(UserCategoryId category) const
+{
+    auto categoryIndex = static_cast<std::size_t>(category);
+    return categoryIndex < m_categories.size()
+        ? m_categories[categoryIndex].get()
+        : nullptr;
+}
+
+std::optional<UserCategoryManager::ObjectId>
+UserCategoryManager::findObject(Selection selection) const
+{
+    auto it = m_objectIds.find(selection);
+    if (it == m_objectIds.end())
+        return std::nullopt;
+    return it->second;
+}
+
+UserCategoryManager::ObjectId
+UserCategoryManager::addObjectEntry(Selection selection)
+{
+    ObjectId objectId;
+    if (m_availableObjects.empty())
+    {
+        objectId = static_cast<ObjectId>(m_objects.size());
+        m_objects.emplace_back();
+    }
+    else
+    {
+        objectId = m_availableObjects.back();
+        m_availableObjects.pop_back();
+    }
+
+    m_objects[objectId].selection = selection;
+    m_objectIds.try_emplace(selection, objectId);
+    return objectId;
+}
+
+void
+UserCategoryManager::removeCategoryFromObject(ObjectId objectId, UserCategoryId category)
+{
+    auto& object = m_objects[objectId];
+    auto& categories = object.categories;
+    if (auto item = std::find(categories.begin(), categories.end(), category); item != categories.end())
+        categories.erase(item);
+
+    if (!categories.empty())
+        return;
+
+    // The object is no longer in any category, release its ID
+    m_objectIds.erase(object.selection);
+    object.selection = Selection();
+    m_availableObjects.push_back(objectId);
+}
+
+std::vector<Selection>
+UserCategoryManager::toSelections(const std::vector<ObjectId>& objectIds) const
+{
+    std::vector<Selection> selections;
+    selections.reserve(objectIds.size());
+    for (ObjectId objectId : objectIds)
+        selections.push_back(m_objects[objectId].selection);
+    return selections;
 }
 
 UserCategory::UserCategory(UserCategoryManager::ConstructorToken,
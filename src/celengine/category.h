@@ -5,6 +5,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -55,20 +56,41 @@ public:
     bool isInCategory(Selection, UserCategoryId) const;
     const std::vector<UserCategoryId>* getCategories(Selection) const;
 
+    std::vector<Selection> objectsInAll(celestia::util::array_view<UserCategoryId>) const;
+    std::vector<Selection> objectsInAny(celestia::util::array_view<UserCategoryId>) const;
+
 private:
     struct ConstructorToken {};
 
+    // Objects that are in at least one category are given a dense ID,
+    // which is what category membership is stored as
+    using ObjectId = std::uint32_t;
+
+    struct ObjectEntry
+    {
+        Selection selection;
+        std::vector<UserCategoryId> categories;
+    };
+
     UserCategoryId createNew(UserCategoryId,
                              const std::string&,
                              UserCategoryId,
                              const std::string&);
 
+    UserCategory* getCategory(UserCategoryId) const;
+    std::optional<ObjectId> findObject(Selection) const;
+    ObjectId addObjectEntry(Selection);
+    void removeCategoryFromObject(ObjectId, UserCategoryId);
+    std::vector<Selection> toSelections(const std::vector<ObjectId>&) const;
+
     std::vector<std::unique_ptr<UserCategory>> m_categories;
     std::vector<UserCategoryId> m_available;
     std::unordered_set<UserCategoryId> m_active;
     std::unordered_set<UserCategoryId> m_roots;
     std::map<std::string, UserCategoryId, std::less<>> m_categoryMap;
-    std::unordered_map<Selection, std::vector<UserCategoryId>> m_objectMap;
+    std::unordered_map<Selection, ObjectId> m_objectIds;
+    std::vector<ObjectEntry> m_objects;
+    std::vector<ObjectId> m_availableObjects;
     friend class UserCategory;
 };
 
@@ -85,7 +107,7 @@ public:
     UserCategoryId parent() const { return m_parent; }
     const std::string& getName(bool i18n = false) const;
     celestia::util::array_view<UserCategoryId> children() const { return m_children; }
-    const std::unordered_set<Selection>& members() const { return m_members; }
+    const std::vector<Selection>& members() const { return m_members; }
     bool hasChild(UserCategoryId child) const;
 
     static const std::unordered_set<UserCategoryId>& active();
@@ -103,6 +125,8 @@ public:
     static bool addObject(Selection selection, UserCategoryId category);
     static bool removeObject(Selection selection, UserCategoryId category);
     static const std::vector<UserCategoryId>* getCategories(Selection selection);
+    static std::vector<Selection> objectsInAll(celestia::util::array_view<UserCategoryId> categories);
+    static std::vector<Selection> objectsInAny(celestia::util::array_view<UserCategoryId> categories);
 
     static void loadCategories(Selection selection,
                                const AssociativeArray& hash,
@@ -116,7 +140,10 @@ private:
     std::string m_name;
     std::string m_i18nName;
     std::vector<UserCategoryId> m_children{};
-    std::unordered_set<Selection> m_members{};
+    // Member object IDs in ascending order, and the members themselves in
+    // the same order
+    std::vector<UserCategoryManager::ObjectId> m_memberIds{};
+    std::vector<Selection> m_members{};
 
     friend class UserCategoryManager;
 };
@@ -183,3 +210,17 @@ UserCategory::getCategories(Selection selection)
 {
     return manager.getCategories(selection);
 }
+
+
+inline std::vector<Selection>
+UserCategory::objectsInAll(celestia::util::array_view<UserCategoryId> categories)
+{
+    return manager.objectsInAll(categories);
+}
+
+
+inline std::vector<Selection>
+UserCategory::objectsInAny(celestia::util::array_view<UserCategoryId> categories)
+{
+    return manager.objectsInAny(categories);
+}
@@ -40,6 +40,7 @@ Console::Console(Renderer& _renderer, int _nRows, int _nColumns) :
 {
     sbuf.setConsole(this);
     text.resize((nColumns + 1) * nRows, u'\0');
+    lines.resize(nRows);
 }
 
 
@@ -51,10 +52,12 @@ Console::Console(Renderer& _renderer, int _nRows, int _nColumns) :
  */
 bool Console::setRowCount(int _nRows)
 {
+    std::scoped_lock lock(mutex);
     if (_nRows == nRows)
         return true;
 
     text.resize((nColumns + 1) * _nRows, u'\0');
+    lines.resize(_nRows);
     nRows = _nRows;
 
     return true;
@@ -89,6 +92,7 @@ void Console::render(int rowHeight)
 
     font->bind();
     font->setMVPMatrices(projection);
+    std::scoped_lock lock(mutex);
     savePos();
     for (int i = 0; i < rowHeight; i++)
     {
@@ -98,7 +102,8 @@ void Console::render(int rowHeight)
         if (auto endpos = line.find(u'\0'); endpos != std::u16string_view::npos)
             line = line.substr(0, endpos);
 
-        font->render(line, global.x, global.y);
+        lines[r].setText(line);
+        font->render(lines[r], global.x, global.y);
 
         // advance to the next line
         restorePos();
@@ -229,6 +234,7 @@ void Console::restorePos()
 
 void Console::scroll(int lines)
 {
+    std::scoped_lock lock(mutex);
     int topRow = getWindowRow();
     int height = getHeight();
 
@@ -263,10 +269,23 @@ int ConsoleStreamBuf::overflow(int c)
     if (traits_type::eq_int_type(c, traits_type::eof()))
         return traits_type::eof();
 
+    std::scoped_lock lock(console->mutex);
+    put(c);
+    return traits_type::not_eof(c);
+}
+
+std::streamsize ConsoleStreamBuf::xsputn(const char* s, std::streamsize n)
+{
+    std::scoped_lock lock(console->mutex);
+    for (std::streamsize i = 0; i < n; ++i)
+        put(traits_type::to_int_type(s[i]));
+    return n;
+}
+
+void ConsoleStreamBuf::put(int c)
+{
     // for now we don't implement non-BMP characters in the console
     if (auto result = validator.check(static_cast<unsigned char>(c));
         result >= 0 && result < 0x10000)
         console->print(static_cast<char16_t>(result));
-
-    return traits_type::not_eof(c);
 }
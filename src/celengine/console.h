@@ -10,6 +10,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <streambuf>
 #include <string>
@@ -17,14 +18,15 @@
 
 #include <Eigen/Core>
 
+#include <celttf/truetypefont.h>
 #include <celutil/utf8.h>
 
 class Color;
 class Console;
-class TextureFont;
 
 // Custom streambuf class to support C++ operator style output.  The
-// output is completely unbuffered.
+// output is completely unbuffered. It may be written to from several
+// threads, e.g. by the logger's writer thread.
 class ConsoleStreamBuf : public std::streambuf
 {
  public:
@@ -33,8 +35,11 @@ class ConsoleStreamBuf : public std::streambuf
     void setConsole(Console*);
 
     int overflow(int c = EOF) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
 
  private:
+    void put(int c);
+
     enum class UTF8DecodeState
     {
         Start     = 0,
@@ -82,7 +87,13 @@ class Console : public std::ostream
     int getHeight() const;
     int getWidth() const;
 
+    // Guards the text and the cursor, which are written to by the stream
+    // and read while rendering
+    mutable std::mutex mutex;
     std::u16string text{ };
+    // The rows laid out for rendering, so that a row is only laid out
+    // again after it has changed
+    std::vector<TextLine> lines{ };
     int nRows;
     int nColumns;
     int row{ 0 };
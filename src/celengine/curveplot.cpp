@@ -29,11 +29,15 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <memory>
 #include <vector>
 #include <celrender/linerenderer.h>
+#include <celrender/gl/buffer.h>
+#include <celrender/gl/vertexobject.h>
 
 #include "curveplot.h"
+#include "glsupport.h"
 #include "render.h"
 #include "shadermanager.h"
 
@@ -46,6 +50,37 @@ constexpr unsigned int SubdivisionFactor = 8;
 constexpr double InvSubdivisionFactor = 1.0 / static_cast<double>(SubdivisionFactor);
 constexpr float OrbitThickness = 1.0f;
 
+// Rounding error of positions in single precision, relative to their size
+constexpr double FloatError = 2.0e-7;
+// Largest rounding error of plots drawn from GPU buffers, as a fraction of
+// the subdivision threshold; Renderer::renderOrbit passes 40 pixels
+constexpr double GPURoundingTolerance = 1.0 / 40.0;
+
+float
+lineWidth(const Renderer& renderer)
+{
+    float width = OrbitThickness * renderer.getScaleFactor();
+    if ((renderer.getRenderFlags() & Renderer::ShowSmoothLines) != 0)
+        width *= 1.5f;
+    return width;
+}
+
+bool
+isGPUPathSupported(const Renderer& renderer)
+{
+#ifdef GL_ES
+    if (!celestia::gl::checkVersion(celestia::gl::GLES_3_2))
+        return false;
+#else
+    if (!celestia::gl::checkVersion(celestia::gl::GL_3_2))
+        return false;
+#endif
+
+    // Lines too wide to rasterize are left to the line renderer, which
+    // turns them into triangles
+    return lineWidth(renderer) <= celestia::gl::maxLineWidth;
+}
+
 // Convert a 3-vector to a 4-vector by adding a zero
 inline Eigen::Vector4d
 zeroExtend(const Eigen::Vector3d& v)
@@ -114,6 +149,99 @@ cubicHermiteCoefficients(const Eigen::Vector4d& p0,
     return coeff;
 }
 
+// No point on the segment is further from the start point than its
+// bounding radius
+double
+segmentBoundingRadius(const CurvePlotSample& s0, const CurvePlotSample& s1)
+{
+    double dt = s1.t - s0.t;
+    Eigen::Matrix4d coeff = cubicHermiteCoefficients(zeroExtend(s0.position),
+                                                     zeroExtend(s1.position),
+                                                     zeroExtend(s0.velocity * dt),
+                                                     zeroExtend(s1.velocity * dt));
+    Eigen::Vector4d extents = coeff.cwiseAbs() * Eigen::Vector4d(0.0, 1.0, 1.0, 1.0);
+    return extents.norm();
+}
+
+// Don't split segments shorter than this fraction of the plot duration
+constexpr double MinRefineFraction = 1.0e-7;
+
+// Limit on the depth of subdivision of a segment in one call to refine()
+constexpr int MaxRefineDepth = 16;
+
+class CurveRefiner
+{
+public:
+    CurveRefiner(const Eigen::Affine3d& modelview,
+                 double angularTolerance,
+                 double minStep,
+                 unsigned int maxSamples,
+                 const CurvePlot::SampleFunction& sampleFunction) :
+        m_modelview(modelview),
+        m_angularTolerance(angularTolerance),
+        m_minStep(minStep),
+        m_maxSamples(maxSamples),
+        m_sampleFunction(sampleFunction)
+    {
+    }
+
+    unsigned int sampleCount() const { return m_sampleCount; }
+
+    /*! Refine the segment from s0 to s1, measuring its error if needed.
+     *  Return false if it is kept as is; otherwise, the samples after s0
+     *  up to and including s1 are appended to output.
+     */
+    bool refine(const CurvePlotSample& s0, CurvePlotSample& s1,
+                std::deque<CurvePlotSample>& output, int depth = 0)
+    {
+        Eigen::Vector3d p0 = m_modelview * s0.position;
+
+        // Segments behind the camera can wait until they come into view
+        if (p0.z() - s1.boundingRadius > 0.0)
+            return false;
+
+        double distance = std::max(p0.norm() - s1.boundingRadius, 0.0);
+        double tolerance = m_angularTolerance * distance;
+        double dt = s1.t - s0.t;
+        if (s1.boundingRadius <= tolerance ||
+            (s1.error >= 0.0 && s1.error <= tolerance) ||
+            dt <= m_minStep || depth >= MaxRefineDepth ||
+            m_sampleCount >= m_maxSamples)
+        {
+            return false;
+        }
+
+        CurvePlotSample mid;
+        mid.t = s0.t + dt * 0.5;
+        m_sampleFunction(mid.t, mid.position, mid.velocity);
+        ++m_sampleCount;
+
+        Eigen::Vector3d interpolated = (s0.position + s1.position) * 0.5 + (s0.velocity - s1.velocity) * (dt * 0.125);
+        s1.error = (interpolated - mid.position).norm();
+        if (s1.error <= tolerance)
+            return false;
+
+        mid.boundingRadius = segmentBoundingRadius(s0, mid);
+        CurvePlotSample end = s1;
+        end.boundingRadius = segmentBoundingRadius(mid, end);
+        end.error = -1.0;
+
+        if (!refine(s0, mid, output, depth + 1))
+            output.push_back(mid);
+        if (!refine(output.back(), end, output, depth + 1))
+            output.push_back(end);
+        return true;
+    }
+
+private:
+    const Eigen::Affine3d& m_modelview;
+    double m_angularTolerance;
+    double m_minStep;
+    unsigned int m_maxSamples;
+    unsigned int m_sampleCount{ 0 };
+    const CurvePlot::SampleFunction& m_sampleFunction;
+};
+
 const Eigen::Matrix4f ModelViewMatrix(Eigen::Matrix4f::Identity());
 
 class HighPrec_VertexBuffer
@@ -338,11 +466,147 @@ HighPrec_VertexBuffer vbuf;
 } // end unnamed namespace
 
 
+struct CurvePlot::GPUPath
+{
+    GPUPath()
+    {
+        vo.addVertexBuffer(buffer, CelestiaGLProgram::VertexCoordAttributeIndex, 4,
+                           celestia::gl::VertexObject::DataType::Float);
+    }
+
+    void update(const std::deque<CurvePlotSample>& samples);
+
+    celestia::gl::Buffer buffer;
+    celestia::gl::VertexObject vo{ celestia::gl::VertexObject::Primitive::LineStrip };
+    bool dirty{ true };
+
+    // Sphere containing the samples, and the largest bounding radius of the
+    // segments between them
+    Eigen::Vector3d center{ Eigen::Vector3d::Zero() };
+    double radius{ 0.0 };
+    double maxSegmentRadius{ 0.0 };
+    // Time of the first sample, which the times in the buffer are relative to
+    double baseTime{ 0.0 };
+};
+
+
+void
+CurvePlot::GPUPath::update(const std::deque<CurvePlotSample>& samples)
+{
+    Eigen::AlignedBox3d bounds;
+    for (const CurvePlotSample& sample : samples)
+        bounds.extend(sample.position);
+
+    center = bounds.center();
+    radius = 0.0;
+    maxSegmentRadius = 0.0;
+    baseTime = samples.front().t;
+
+    // Positions relative to the center keep the precision of single floats
+    // for the size of the plot rather than its distance from the origin
+    std::vector<Eigen::Vector4f> vertices;
+    vertices.reserve(samples.size());
+    for (std::size_t i = 0; i < samples.size(); ++i)
+    {
+        const CurvePlotSample& sample = samples[i];
+        Eigen::Vector3d position = sample.position - center;
+        radius = std::max(radius, position.norm());
+        if (i > 0)
+            maxSegmentRadius = std::max(maxSegmentRadius, sample.boundingRadius);
+        vertices.emplace_back(static_cast<float>(position.x()),
+                              static_cast<float>(position.y()),
+                              static_cast<float>(position.z()),
+                              static_cast<float>(sample.t - baseTime));
+    }
+
+    buffer.setData(vertices, celestia::gl::Buffer::BufferUsage::StaticDraw);
+    dirty = false;
+}
+
+
 CurvePlot::CurvePlot(const Renderer &renderer) :
     m_renderer(renderer)
 {
 }
 
+CurvePlot::~CurvePlot() = default;
+
+void
+CurvePlot::invalidateGPUPath()
+{
+    if (m_gpuPath != nullptr)
+        m_gpuPath->dirty = true;
+}
+
+/** Draw the samples from startTime to endTime as a line strip kept in a GPU
+  * buffer, transformed by the shader. This is only done when no segment of
+  * the plot needs to be subdivided or culled, which is the case for plots
+  * seen from afar. Return false if the plot has to be drawn on the CPU.
+  */
+bool
+CurvePlot::renderGPU(const Eigen::Affine3d& modelview,
+                     double farZ,
+                     double subdivisionThreshold,
+                     double startTime,
+                     double endTime,
+                     const Eigen::Vector4f& color,
+                     double fadeStartTime,
+                     double fadeRate) const
+{
+    if (m_samples.size() < 2 || !isGPUPathSupported(m_renderer))
+        return false;
+
+    CelestiaGLProgram* prog = m_renderer.getShaderManager().getShaderGL3("curveplot150");
+    if (prog == nullptr)
+        return false;
+
+    if (m_gpuPath == nullptr)
+        m_gpuPath = std::make_unique<GPUPath>();
+    if (m_gpuPath->dirty)
+        m_gpuPath->update(m_samples);
+    const GPUPath& path = *m_gpuPath;
+
+    // Every segment starts within radius of the center and stays within
+    // maxSegmentRadius of its start, which bounds the distances tested by
+    // render() for all segments at once.
+    Eigen::Vector3d center = modelview * path.center;
+    double distance = std::abs(center.z()) - path.radius - path.maxSegmentRadius;
+    if (distance <= 0.0 ||
+        path.maxSegmentRadius >= subdivisionThreshold * distance ||
+        center.z() - path.radius < farZ ||
+        FloatError * (center.norm() + path.radius) > subdivisionThreshold * distance * GPURoundingTolerance)
+    {
+        return false;
+    }
+
+    // Draw from the last sample at or before startTime to the first at or
+    // after endTime; the fragment shader cuts off the rest of the window
+    auto first = std::upper_bound(m_samples.begin(), m_samples.end(), startTime,
+                                  [](double t, const CurvePlotSample& s) { return t < s.t; });
+    if (first != m_samples.begin())
+        --first;
+    auto last = std::lower_bound(m_samples.begin(), m_samples.end(), endTime,
+                                 [](const CurvePlotSample& s, double t) { return s.t < t; });
+    if (last == m_samples.end())
+        --last;
+    if (last <= first)
+        return true;
+
+    glLineWidth(lineWidth(m_renderer));
+
+    Eigen::Affine3d pathModelview = modelview * Eigen::Translation3d(path.center);
+    prog->use();
+    prog->setMVPMatrices(m_renderer.getCurrentProjectionMatrix(), pathModelview.matrix().cast<float>());
+    prog->vec4Param("color") = color;
+    prog->vec2Param("window") = Eigen::Vector2f(static_cast<float>(std::max(startTime - path.baseTime, -1.0e30)),
+                                                static_cast<float>(std::min(endTime - path.baseTime, 1.0e30)));
+    prog->vec2Param("fade") = Eigen::Vector2f(static_cast<float>(fadeStartTime - path.baseTime),
+                                              static_cast<float>(fadeRate));
+
+    m_gpuPath->vo.draw(static_cast<int>(last - first) + 1, static_cast<int>(first - m_samples.begin()));
+    return true;
+}
+
 void
 CurvePlot::deinit()
 {
@@ -377,6 +641,7 @@ CurvePlot::addSample(const CurvePlotSample& sample)
         m_samples.push_back(sample);
     else
         m_samples.push_front(sample);
+    invalidateGPUPath();
 
     if (m_samples.size() > 1)
     {
@@ -384,29 +649,69 @@ CurvePlot::addSample(const CurvePlotSample& sample)
         // be further from the start point than the bounding radius.
         if (addToBack)
         {
-            const CurvePlotSample& lastSample = m_samples[m_samples.size() - 2];
-            double dt = sample.t - lastSample.t;
-            Eigen::Matrix4d coeff = cubicHermiteCoefficients(
-                zeroExtend(lastSample.position),
-                zeroExtend(sample.position),
-                zeroExtend(lastSample.velocity * dt),
-                zeroExtend(sample.velocity * dt));
-            Eigen::Vector4d extents = coeff.cwiseAbs() * Eigen::Vector4d(0.0, 1.0, 1.0, 1.0);
-            m_samples[m_samples.size() - 1].boundingRadius = extents.norm();
+            m_samples.back().boundingRadius = segmentBoundingRadius(m_samples[m_samples.size() - 2],
+                                                                    m_samples.back());
+        }
+        else
+        {
+            m_samples[1].boundingRadius = segmentBoundingRadius(m_samples[0], m_samples[1]);
+            // The error of the following segment starting at the new sample
+            // is unknown
+            m_samples[1].error = -1.0;
+        }
+    }
+}
+
+
+/** Insert samples where the plot deviates visibly from the curve. The
+  * deviation of each segment is measured halfway through it and kept, so
+  * segments are only measured again when the camera gets closer to them.
+  */
+unsigned int
+CurvePlot::refine(const Eigen::Affine3d& modelview,
+                  double angularTolerance,
+                  unsigned int maxSamples,
+                  const SampleFunction& sampleFunction)
+{
+    if (m_samples.size() < 2 || maxSamples == 0)
+        return 0;
+
+    double minStep = (endTime() - startTime()) * MinRefineFraction;
+    CurveRefiner refiner(modelview, angularTolerance, minStep, maxSamples, sampleFunction);
+
+    // Only copy the samples once a segment is split
+    std::deque<CurvePlotSample> refined;
+    bool split = false;
+    for (std::size_t i = 1; i < m_samples.size(); ++i)
+    {
+        const CurvePlotSample& s0 = split ? refined.back() : m_samples[i - 1];
+        if (CurvePlotSample s1 = m_samples[i]; refiner.refine(s0, s1, refined))
+        {
+            if (!split)
+            {
+                refined.insert(refined.begin(), m_samples.begin(), m_samples.begin() + i);
+                split = true;
+            }
         }
         else
         {
-            const CurvePlotSample& nextSample = m_samples[1];
-            double dt = nextSample.t - sample.t;
-            Eigen::Matrix4d coeff = cubicHermiteCoefficients(
-                zeroExtend(sample.position),
-                zeroExtend(nextSample.position),
-                zeroExtend(sample.velocity * dt),
-                zeroExtend(nextSample.velocity * dt));
-            Eigen::Vector4d extents = coeff.cwiseAbs() * Eigen::Vector4d(0.0, 1.0, 1.0, 1.0);
-            m_samples[1].boundingRadius = extents.norm();
+            // Keep the measured error
+            m_samples[i].error = s1.error;
+            if (split)
+                refined.push_back(m_samples[i]);
         }
+
+        if (refiner.sampleCount() >= maxSamples && !split)
+            break;
     }
+
+    if (split)
+    {
+        m_samples = std::move(refined);
+        invalidateGPUPath();
+    }
+
+    return refiner.sampleCount();
 }
 
 
@@ -418,6 +723,7 @@ CurvePlot::removeSamplesBefore(double t)
     while (!m_samples.empty() && m_samples.front().t < t)
     {
         m_samples.pop_front();
+        invalidateGPUPath();
     }
 }
 
@@ -430,6 +736,7 @@ CurvePlot::removeSamplesAfter(double t)
     while (!m_samples.empty() && m_samples.back().t > t)
     {
         m_samples.pop_back();
+        invalidateGPUPath();
     }
 }
 
@@ -460,6 +767,13 @@ CurvePlot::render(const Eigen::Affine3d& modelview,
                   double subdivisionThreshold,
                   const Eigen::Vector4f& color) const
 {
+    if (renderGPU(modelview, farZ, subdivisionThreshold,
+                  -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(),
+                  color, 0.0, 0.0))
+    {
+        return;
+    }
+
     // Flag to indicate whether we need to issue a glBegin()
     bool restartCurve = true;
 
@@ -587,6 +901,9 @@ CurvePlot::render(const Eigen::Affine3d& modelview,
     if (m_samples.empty() || endTime <= m_samples.front().t || startTime >= m_samples.back().t)
         return;
 
+    if (renderGPU(modelview, farZ, subdivisionThreshold, startTime, endTime, color, 0.0, 0.0))
+        return;
+
     // Linear search for the first sample
     unsigned int startSample = 0;
     while (startSample < m_samples.size() - 1 && startTime > m_samples[startSample].t)
@@ -764,6 +1081,9 @@ CurvePlot::renderFaded(const Eigen::Affine3d& modelview,
     double fadeDuration = fadeEndTime - fadeStartTime;
     double fadeRate = 1.0 / fadeDuration;
 
+    if (renderGPU(modelview, farZ, subdivisionThreshold, startTime, endTime, color, fadeStartTime, fadeRate))
+        return;
+
     const Eigen::Vector3d& p0_ = m_samples[startSample].position;
     const Eigen::Vector3d& v0_ = m_samples[startSample].velocity;
     Eigen::Vector4d p0 = modelview * Eigen::Vector4d(p0_.x(), p0_.y(), p0_.z(), 1.0);
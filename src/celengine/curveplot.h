@@ -29,7 +29,10 @@
 
 #pragma once
 
+#include <cstddef>
 #include <deque>
+#include <functional>
+#include <memory>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -46,6 +49,9 @@ public:
     double t;
     Eigen::Vector3d velocity;
     double boundingRadius { 0.0 };
+    // Distance between the curve and the segment ending at this sample
+    // halfway through it, negative until measured by CurvePlot::refine()
+    double error { -1.0 };
 };
 
 
@@ -53,6 +59,7 @@ class CurvePlot
 {
  public:
     explicit CurvePlot(const Renderer &renderer);
+    ~CurvePlot();
 
     double duration() const { return m_duration; }
     void setDuration(double duration);
@@ -99,16 +106,46 @@ class CurvePlot
     void removeSamplesBefore(double t);
     void removeSamplesAfter(double t);
 
+    // Compute the position and velocity of the curve at time t
+    using SampleFunction = std::function<void(double t, Eigen::Vector3d& position, Eigen::Vector3d& velocity)>;
+
+    // Split segments in front of the camera that may deviate from the curve
+    // by more than angularTolerance as seen from the camera. At most
+    // maxSamples new points are computed, so that the plot is refined over
+    // several frames. Return the number of points computed.
+    unsigned int refine(const Eigen::Affine3d& modelview,
+                        double angularTolerance,
+                        unsigned int maxSamples,
+                        const SampleFunction& sampleFunction);
+
     bool empty() const { return m_samples.empty(); }
 
     unsigned int sampleCount() const { return static_cast<unsigned int>(m_samples.size()); }
 
+    // Estimated heap memory taken by the samples
+    std::size_t memoryUsage() const { return m_samples.size() * sizeof(CurvePlotSample); }
+
     static void deinit();
 
  private:
+    struct GPUPath;
+
+    bool renderGPU(const Eigen::Affine3d& modelview,
+                   double farZ,
+                   double subdivisionThreshold,
+                   double startTime,
+                   double endTime,
+                   const Eigen::Vector4f& color,
+                   double fadeStartTime,
+                   double fadeRate) const;
+    void invalidateGPUPath();
+
     std::deque<CurvePlotSample>     m_samples;
     const Renderer                 &m_renderer;
     double                          m_duration      { 0.0 };
     unsigned int                    m_lastUsed      { 0   };
+    // The samples kept in a GPU buffer, for plots far enough from the camera
+    // to be drawn without subdividing them
+    mutable std::unique_ptr<GPUPath> m_gpuPath;
 };
 
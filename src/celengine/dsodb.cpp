@@ -11,12 +11,19 @@
 //
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstddef>
+#include <sstream>
 #include <utility>
 
+#include <fmt/format.h>
+
 #include <celcompat/numbers.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/memoryusage.h>
+#include <celutil/threadpool.h>
 #include <celutil/tokenizer.h>
 #include "category.h"
 #include "galaxy.h"
@@ -25,9 +32,11 @@
 #include "dsodb.h"
 #include "nebula.h"
 #include "opencluster.h"
+#include "parseobject.h"
 #include "value.h"
 
 using celestia::util::GetLogger;
+namespace util = celestia::util;
 
 namespace astro = celestia::astro;
 
@@ -40,6 +49,98 @@ constexpr const float DSO_OCTREE_MAGNITUDE   = 8.0f;
 
 //constexpr char FILE_HEADER[]                 = "CEL_DSOs";
 
+// Catalogs at least this large are parsed on multiple threads
+constexpr std::size_t ParallelLoadThreshold = 1024 * 1024;
+// Number of chunks handed to each worker when parsing in parallel
+constexpr std::size_t ChunksPerWorker = 4;
+
+enum class EntryStatus
+{
+    Ok,
+    End,
+    BadType,
+    BadName,
+    BadParams,
+};
+
+struct CatalogEntry
+{
+    std::string type;
+    std::string name;
+    Value       params;
+};
+
+EntryStatus
+readEntry(Tokenizer& tokenizer, Parser& parser, CatalogEntry& entry)
+{
+    if (tokenizer.nextToken() == Tokenizer::TokenEnd)
+        return EntryStatus::End;
+
+    if (auto tokenValue = tokenizer.getNameValue(); tokenValue.has_value())
+        entry.type = *tokenValue;
+    else
+        return EntryStatus::BadType;
+
+    tokenizer.nextToken();
+    if (auto tokenValue = tokenizer.getStringValue(); tokenValue.has_value())
+        entry.name = *tokenValue;
+    else
+        return EntryStatus::BadName;
+
+    entry.params = parser.readValue();
+    if (entry.params.getHash() == nullptr)
+        return EntryStatus::BadParams;
+
+    return EntryStatus::Ok;
+}
+
+void
+logEntryError(EntryStatus status, const CatalogEntry& entry)
+{
+    switch (status)
+    {
+    case EntryStatus::BadType:
+        GetLogger()->error("Error parsing deep sky catalog file.\n");
+        break;
+    case EntryStatus::BadName:
+        GetLogger()->error("Error parsing deep sky catalog file: bad name.\n");
+        break;
+    case EntryStatus::BadParams:
+        GetLogger()->error("Error parsing deep sky catalog entry {}\n", entry.name);
+        break;
+    default:
+        break;
+    }
+}
+
+// Entries of a catalog or a chunk of it, up to the first error
+struct ParseResult
+{
+    std::vector<CatalogEntry> entries;
+    EntryStatus status{ EntryStatus::End };
+    CatalogEntry failedEntry;
+};
+
+void
+readEntries(std::string_view text, ParseResult& result)
+{
+    std::istringstream textStream{ std::string(text) };
+    Tokenizer tokenizer(&textStream);
+    Parser    parser(&tokenizer);
+
+    for (;;)
+    {
+        CatalogEntry entry;
+        result.status = readEntry(tokenizer, parser, entry);
+        if (result.status != EntryStatus::Ok)
+        {
+            result.failedEntry = std::move(entry);
+            return;
+        }
+        result.entries.push_back(std::move(entry));
+    }
+}
+
 } // end unnamed namespace
 
 DSODatabase::~DSODatabase()
@@ -94,20 +195,20 @@ DSODatabase::getDSOName(const DeepSkyObject* dso, [[maybe_unused]] bool i18n) co
 
     AstroCatalog::IndexNumber catalogNumber = dso->getIndex();
 
-    auto iter = namesDB->getFirstNameIter(catalogNumber);
-    if (iter == namesDB->getFinalNameIter())
+    auto names = namesDB->getNames(catalogNumber);
+    if (names.empty())
         return {};
 
 #ifdef ENABLE_NLS
     if (i18n)
     {
-        const char* local = D_(iter->second.c_str());
-        if (iter->second != local)
+        const char* local = D_(names.front().data());
+        if (names.front() != local)
             return local;
     }
 #endif
 
-    return iter->second;
+    return std::string(names.front());
 }
 
 std::string
@@ -115,17 +216,15 @@ DSODatabase::getDSONameList(const DeepSkyObject* dso, const unsigned int maxName
 {
     std::string dsoNames;
 
-    auto catalogNumber = dso->getIndex();
-    auto iter = namesDB->getFirstNameIter(catalogNumber);
-
     unsigned int count = 0;
-    while (iter != namesDB->getFinalNameIter() && iter->first == catalogNumber && count < maxNames)
+    for (std::string_view name : namesDB->getNames(dso->getIndex()))
     {
+        if (count == maxNames)
+            break;
         if (count != 0)
             dsoNames.append(" / ");
 
-        dsoNames.append(D_(iter->second.c_str()));
-        ++iter;
+        dsoNames.append(D_(name.data()));
         ++count;
     }
 
@@ -161,11 +260,11 @@ DSODatabase::findVisibleDSOs(DSOHandler& dsoHandler,
         frustumPlanes[i]   = Eigen::Hyperplane<double, 3>(planeNormals[i], obsPos);
     }
 
-    octreeRoot->processVisibleObjects(dsoHandler,
-                                      obsPos,
-                                      frustumPlanes,
-                                      limitingMag,
-                                      DSO_OCTREE_ROOT_SIZE);
+    octreeNodes.front().processVisibleObjects(dsoHandler,
+                                              obsPos,
+                                              frustumPlanes,
+                                              limitingMag,
+                                              DSO_OCTREE_ROOT_SIZE);
 }
 
 void
@@ -173,10 +272,83 @@ DSODatabase::findCloseDSOs(DSOHandler& dsoHandler,
                            const Eigen::Vector3d& obsPos,
                            float radius) const
 {
-    octreeRoot->processCloseObjects(dsoHandler,
-                                    obsPos,
-                                    radius,
-                                    DSO_OCTREE_ROOT_SIZE);
+    auto start = std::chrono::steady_clock::now();
+
+    // Large radii touch too many grid cells, the octree handles those
+    if (!grid.processCloseObjects(dsoHandler, obsPos, radius))
+    {
+        octreeNodes.front().processCloseObjects(dsoHandler,
+                                                obsPos,
+                                                radius,
+                                                DSO_OCTREE_ROOT_SIZE);
+    }
+
+    countQuery(start);
+}
+
+void
+DSODatabase::findDSOsAlongRay(DSOHandler& dsoHandler,
+                              const Eigen::Vector3d& origin,
+                              const Eigen::Vector3d& direction,
+                              double maxDistance) const
+{
+    auto start = std::chrono::steady_clock::now();
+    grid.processRay(dsoHandler, origin, direction, maxDistance);
+    countQuery(start);
+}
+
+void
+DSODatabase::countQuery(std::chrono::steady_clock::time_point start) const
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    nQueries.fetch_add(1, std::memory_order_relaxed);
+    queryNanoseconds.fetch_add(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+}
+
+void
+DSODatabase::getInfo(std::map<std::string, std::string>& info) const
+{
+    std::uint64_t queries = nQueries.load(std::memory_order_relaxed);
+    std::uint64_t nanoseconds = queryNanoseconds.load(std::memory_order_relaxed);
+    info["DSOQueries"] = std::to_string(queries);
+    info["DSOQueryLatency"] = fmt::format("{:.1f} us", queries == 0
+        ? 0.0
+        : static_cast<double>(nanoseconds) / static_cast<double>(queries) * 1.0e-3);
+}
+
+std::size_t
+DSODatabase::getMemoryUsage() const
+{
+    std::size_t size = 0;
+    for (int i = 0; i < nDSOs; ++i)
+    {
+        const DeepSkyObject* dso = DSOs[i];
+        switch (dso->getObjType())
+        {
+        case DeepSkyObjectType::Galaxy:
+            size += sizeof(Galaxy);
+            break;
+        case DeepSkyObjectType::Globular:
+            size += sizeof(Globular);
+            break;
+        case DeepSkyObjectType::Nebula:
+            size += sizeof(Nebula);
+            break;
+        case DeepSkyObjectType::OpenCluster:
+            size += sizeof(OpenCluster);
+            break;
+        }
+
+        size += celestia::util::MemoryUsage(dso->getInfoURL());
+    }
+
+    // The array is reallocated to the number of objects by buildOctree()
+    size += static_cast<std::size_t>(octreeNodes.empty() ? capacity : nDSOs) * sizeof(DeepSkyObject*);
+    if (catalogNumberIndex != nullptr)
+        size += static_cast<std::size_t>(nDSOs) * sizeof(DeepSkyObject*);
+    size += celestia::util::MemoryUsage(octreeNodes);
+    size += grid.memoryUsage();
+    return size;
 }
 
 NameDatabase*
@@ -191,125 +363,173 @@ DSODatabase::setNameDatabase(std::unique_ptr<NameDatabase>&& _namesDB)
     namesDB = std::move(_namesDB);
 }
 
-bool
-DSODatabase::load(std::istream& in, const fs::path& resourcePath)
+class DSODatabase::Staged : public celestia::engine::StagedCatalog
 {
-    Tokenizer tokenizer(&in);
-    Parser    parser(&tokenizer);
+public:
+    Staged(DSODatabase* _db, const fs::path& _resourcePath) :
+        db(_db), resourcePath(_resourcePath)
+    {
+    }
+
+    bool commit() override;
+
+    // One result for each chunk of the catalog, in file order
+    std::vector<ParseResult> results;
+
+private:
+    DSODatabase* db;
+    fs::path resourcePath;
+};
 
+bool
+DSODatabase::Staged::commit()
+{
 #ifdef ENABLE_NLS
     std::string s = resourcePath.string();
     const char *d = s.c_str();
     bindtextdomain(d, d); // domain name is the same as resource path
 #endif
 
-    while (tokenizer.nextToken() != Tokenizer::TokenEnd)
+    // Creating the objects may load shared resources such as custom galaxy
+    // templates, so unlike parsing this is done on the loading thread.
+    for (const ParseResult& result : results)
     {
-        std::string objType;
-        if (auto tokenValue = tokenizer.getNameValue(); tokenValue.has_value())
+        for (const CatalogEntry& entry : result.entries)
         {
-            objType = *tokenValue;
+            if (!db->addObject(entry.type, entry.name, entry.params.getHash(), resourcePath))
+                return false;
         }
-        else
+
+        if (result.status != EntryStatus::End)
         {
-            GetLogger()->error("Error parsing deep sky catalog file.\n");
+            // Entries with a type consume a catalog number even if they fail
+            if (result.status != EntryStatus::BadType)
+                --db->nextAutoCatalogNumber;
+            logEntryError(result.status, result.failedEntry);
             return false;
         }
+    }
 
-        AstroCatalog::IndexNumber objCatalogNumber = nextAutoCatalogNumber--;
+    return true;
+}
 
-        tokenizer.nextToken();
-        std::string objName;
-        if (auto tokenValue = tokenizer.getStringValue(); tokenValue.has_value())
-        {
-            objName = *tokenValue;
-        }
-        else
-        {
-            GetLogger()->error("Error parsing deep sky catalog file: bad name.\n");
-            return false;
-        }
+bool
+DSODatabase::load(std::istream& in, const fs::path& resourcePath)
+{
+    return stage(in, resourcePath)->commit();
+}
 
-        const Value objParamsValue = parser.readValue();
-        const Hash* objParams = objParamsValue.getHash();
-        if (objParams == nullptr)
-        {
-            GetLogger()->error("Error parsing deep sky catalog entry {}\n", objName.c_str());
-            return false;
-        }
+std::unique_ptr<celestia::engine::StagedCatalog>
+DSODatabase::stage(std::istream& in, const fs::path& resourcePath)
+{
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = std::move(buffer).str();
 
-        DeepSkyObject* obj = nullptr;
-        if (compareIgnoringCase(objType, "Galaxy") == 0)
-            obj = new Galaxy();
-        else if (compareIgnoringCase(objType, "Globular") == 0)
-            obj = new Globular();
-        else if (compareIgnoringCase(objType, "Nebula") == 0)
-            obj = new Nebula();
-        else if (compareIgnoringCase(objType, "OpenCluster") == 0)
-            obj = new OpenCluster();
-
-        if (obj != nullptr && obj->load(objParams, resourcePath))
-        {
-            UserCategory::loadCategories(obj, *objParams, DataDisposition::Add, resourcePath.string());
+    auto staged = std::make_unique<Staged>(this, resourcePath);
 
-            // Ensure that the DSO array is large enough
-            if (nDSOs == capacity)
-            {
-                // Grow the array by 5%--this may be too little, but the
-                // assumption here is that there will be small numbers of
-                // DSOs in text files added to a big collection loaded from
-                // a binary file.
-                capacity = static_cast<int>(capacity * 1.05);
-
-                // 100 DSOs seems like a reasonable minimum
-                if (capacity < 100)
-                    capacity = 100;
-
-                DeepSkyObject** newDSOs = new DeepSkyObject*[capacity];
-
-                if (DSOs != nullptr)
-                {
-                    std::copy(DSOs, DSOs + nDSOs, newDSOs);
-                    delete[] DSOs;
-                }
-                DSOs = newDSOs;
-            }
+    std::vector<std::string_view> chunks;
+    std::unique_ptr<util::ThreadPool> pool;
+    if (text.size() >= ParallelLoadThreshold)
+    {
+        pool = std::make_unique<util::ThreadPool>();
+        chunks = SplitCatalog(text, text.size() / (pool->concurrency() * ChunksPerWorker) + 1);
+    }
+
+    if (chunks.size() <= 1)
+    {
+        readEntries(text, staged->results.emplace_back());
+        return staged;
+    }
 
-            DSOs[nDSOs++] = obj;
+    staged->results.resize(chunks.size());
+    pool->parallelFor(chunks.size(),
+                      [&](std::size_t task, unsigned int /* worker */)
+                      {
+                          readEntries(chunks[task], staged->results[task]);
+                      });
 
-            obj->setIndex(objCatalogNumber);
+    return staged;
+}
 
-            if (namesDB != nullptr && !objName.empty())
-            {
-                // List of names will replace any that already exist for
-                // this DSO.
-                namesDB->erase(objCatalogNumber);
-
-                // Iterate through the string for names delimited
-                // by ':', and insert them into the DSO database.
-                // Note that db->add() will skip empty names.
-                std::string::size_type startPos = 0;
-                while (startPos != std::string::npos)
-                {
-                    std::string::size_type next    = objName.find(':', startPos);
-                    std::string::size_type length  = std::string::npos;
-                    if (next != std::string::npos)
-                    {
-                        length = next - startPos;
-                        ++next;
-                    }
-                    std::string DSOName = objName.substr(startPos, length);
-                    namesDB->add(objCatalogNumber, DSOName);
-                    startPos   = next;
-                }
-            }
+bool
+DSODatabase::addObject(const std::string& objType,
+                       const std::string& objName,
+                       const AssociativeArray* objParams,
+                       const fs::path& resourcePath)
+{
+    AstroCatalog::IndexNumber objCatalogNumber = nextAutoCatalogNumber--;
+
+    DeepSkyObject* obj = nullptr;
+    if (compareIgnoringCase(objType, "Galaxy") == 0)
+        obj = new Galaxy();
+    else if (compareIgnoringCase(objType, "Globular") == 0)
+        obj = new Globular();
+    else if (compareIgnoringCase(objType, "Nebula") == 0)
+        obj = new Nebula();
+    else if (compareIgnoringCase(objType, "OpenCluster") == 0)
+        obj = new OpenCluster();
+
+    if (obj == nullptr || !obj->load(objParams, resourcePath))
+    {
+        GetLogger()->warn("Bad Deep Sky Object definition--will continue parsing file.\n");
+        return false;
+    }
+
+    UserCategory::loadCategories(obj, *objParams, DataDisposition::Add, resourcePath.string());
+
+    // Ensure that the DSO array is large enough
+    if (nDSOs == capacity)
+    {
+        // Grow the array by 5%--this may be too little, but the
+        // assumption here is that there will be small numbers of
+        // DSOs in text files added to a big collection loaded from
+        // a binary file.
+        capacity = static_cast<int>(capacity * 1.05);
+
+        // 100 DSOs seems like a reasonable minimum
+        if (capacity < 100)
+            capacity = 100;
+
+        DeepSkyObject** newDSOs = new DeepSkyObject*[capacity];
+
+        if (DSOs != nullptr)
+        {
+            std::copy(DSOs, DSOs + nDSOs, newDSOs);
+            delete[] DSOs;
         }
-        else
+        DSOs = newDSOs;
+    }
+
+    DSOs[nDSOs++] = obj;
+
+    obj->setIndex(objCatalogNumber);
+
+    if (namesDB != nullptr && !objName.empty())
+    {
+        // List of names will replace any that already exist for
+        // this DSO.
+        namesDB->erase(objCatalogNumber);
+
+        // Iterate through the string for names delimited
+        // by ':', and insert them into the DSO database.
+        // Note that db->add() will skip empty names.
+        std::string::size_type startPos = 0;
+        while (startPos != std::string::npos)
         {
-            GetLogger()->warn("Bad Deep Sky Object definition--will continue parsing file.\n");
-            return false;
+            std::string::size_type next    = objName.find(':', startPos);
+            std::string::size_type length  = std::string::npos;
+            if (next != std::string::npos)
+            {
+                length = next - startPos;
+                ++next;
+            }
+            std::string DSOName = objName.substr(startPos, length);
+            namesDB->add(objCatalogNumber, DSOName);
+            startPos   = next;
         }
     }
+
     return true;
 }
 
@@ -318,6 +538,9 @@ DSODatabase::finish()
 {
     buildOctree();
     buildIndexes();
+    if (namesDB != nullptr)
+        namesDB->finish();
+    grid.build(DSOs, static_cast<std::size_t>(nDSOs));
     calcAvgAbsMag();
     /*
     // Put AbsMag = avgAbsMag for Add-ons without AbsMag entry
@@ -351,12 +574,12 @@ DSODatabase::buildOctree()
 
     // The spatial sorting part is useless for DSOs since we
     // are storing pointers to objects and not the objects themselves:
-    root->rebuildAndSort(octreeRoot, firstDSO);
+    root->rebuildAndSort(octreeNodes, firstDSO);
 
     GetLogger()->debug("{} DSOs total.\nOctree has {} nodes and {} DSOs.\n",
                        static_cast<int>(firstDSO - sortedDSOs),
-                       1 + octreeRoot->countChildren(),
-                       octreeRoot->countObjects());
+                       octreeNodes.size(),
+                       octreeNodes.front().countObjects());
 
     // Clean up . . .
     delete[] DSOs;
@@ -12,8 +12,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <iosfwd>
+#include <map>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -23,8 +27,12 @@
 #include <Eigen/Geometry>
 
 #include <celcompat/filesystem.h>
+#include <celengine/dsogrid.h>
 #include <celengine/dsooctree.h>
 #include <celengine/name.h>
+#include <celengine/stagedcatalog.h>
+
+class AssociativeArray;
 
 constexpr inline unsigned int MAX_DSO_NAMES = 10;
 
@@ -57,6 +65,13 @@ class DSODatabase
                        const Eigen::Vector3d& obsPosition,
                        float radius) const;
 
+    // Finds the objects that may be hit by a pick ray, with a center
+    // closer than maxDistance to the ray origin.
+    void findDSOsAlongRay(DSOHandler& dsoHandler,
+                          const Eigen::Vector3d& origin,
+                          const Eigen::Vector3d& direction,
+                          double maxDistance) const;
+
     std::string getDSOName    (const DeepSkyObject*, bool i18n = false) const;
     std::string getDSONameList(const DeepSkyObject*, const unsigned int maxNames = MAX_DSO_NAMES) const;
 
@@ -64,12 +79,31 @@ class DSODatabase
     void setNameDatabase(std::unique_ptr<NameDatabase>&&);
 
     bool load(std::istream&, const fs::path& resourcePath = fs::path());
+    // Reads a catalog without changing the database, so that it can be
+    // called from any thread; committing the result adds the objects.
+    std::unique_ptr<celestia::engine::StagedCatalog> stage(std::istream&,
+                                                           const fs::path& resourcePath = fs::path());
     void finish();
 
     float getAverageAbsoluteMagnitude() const;
 
+    // Adds the number and mean latency of close object and pick ray queries
+    void getInfo(std::map<std::string, std::string>& info) const;
+
+    // Bytes of memory used by the objects and their indexes, not including
+    // the name database
+    std::size_t getMemoryUsage() const;
+
 private:
+    class Staged;
+
+    bool addObject(const std::string& objType,
+                   const std::string& objName,
+                   const AssociativeArray* objParams,
+                   const fs::path& resourcePath);
+
     void buildIndexes();
+    void countQuery(std::chrono::steady_clock::time_point start) const;
     void buildOctree();
     void calcAvgAbsMag();
 
@@ -78,10 +112,14 @@ private:
     DeepSkyObject**  DSOs{ nullptr };
     std::unique_ptr<NameDatabase> namesDB;
     DeepSkyObject**  catalogNumberIndex{ nullptr };
-    DSOOctree*       octreeRoot{ nullptr };
+    std::vector<DSOOctree> octreeNodes; // root first
+    DSOGrid          grid;
     AstroCatalog::IndexNumber nextAutoCatalogNumber{ 0xfffffffe };
 
     float            avgAbsMag{ 0.0f };
+
+    mutable std::atomic<std::uint64_t> nQueries{ 0 };
+    mutable std::atomic<std::uint64_t> queryNanoseconds{ 0 };
 };
 
 inline DeepSkyObject*
@@ -0,0 +1,308 @@
+// dsogrid.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "dsogrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+
+// Cells per axis relative to the cube root of the object count, which
+// keeps the number of cells crossed by a ray close to the number of
+// objects near it
+constexpr double CellsPerAxisFactor = 2.0;
+constexpr std::int64_t MaxCellsPerAxis = 256;
+
+// Objects spanning more cells than this along any axis go to the list of
+// large objects instead of the grid
+constexpr std::int64_t MaxObjectCellsPerAxis = 4;
+
+// Galaxy and globular picking uses shapes slightly larger than the
+// bounding sphere, so objects are entered with some margin
+constexpr double PickRadiusMargin = 1.1;
+
+double
+pickRadius(const DeepSkyObject* dso)
+{
+    return static_cast<double>(std::max(dso->getBoundingSphereRadius(), dso->getRadius())) * PickRadiusMargin;
+}
+
+} // end unnamed namespace
+
+void
+DSOGrid::build(DeepSkyObject* const* dsos, std::size_t nDSOs)
+{
+    m_cells.clear();
+    m_cellObjects.clear();
+    m_largeObjects.clear();
+    m_nObjects = nDSOs;
+    if (nDSOs == 0)
+        return;
+
+    m_cellsPerAxis = std::clamp(static_cast<std::int64_t>(std::cbrt(static_cast<double>(nDSOs)) * CellsPerAxisFactor),
+                                std::int64_t(1), MaxCellsPerAxis);
+
+    // Size the cells from the object centers first to find the large
+    // objects, then grow the grid to enclose the bounding spheres of the
+    // others. Growing the cells can't make a small object large.
+    Eigen::Vector3d lower = dsos[0]->getPosition();
+    Eigen::Vector3d upper = lower;
+    for (std::size_t i = 1; i < nDSOs; ++i)
+    {
+        lower = lower.cwiseMin(dsos[i]->getPosition());
+        upper = upper.cwiseMax(dsos[i]->getPosition());
+    }
+
+    double centerCellSize = std::max((upper - lower).maxCoeff(), 1.0) / static_cast<double>(m_cellsPerAxis);
+    double maxSmallRadius = 0.5 * static_cast<double>(MaxObjectCellsPerAxis - 1) * centerCellSize;
+
+    for (std::size_t i = 0; i < nDSOs; ++i)
+    {
+        double r = pickRadius(dsos[i]);
+        if (r > maxSmallRadius)
+            continue;
+        lower = lower.cwiseMin((dsos[i]->getPosition().array() - r).matrix());
+        upper = upper.cwiseMax((dsos[i]->getPosition().array() + r).matrix());
+    }
+
+    m_origin = lower;
+    m_cellSize = std::max((upper - lower).maxCoeff(), 1.0) / static_cast<double>(m_cellsPerAxis);
+
+    std::vector<std::pair<std::uint64_t, DeepSkyObject*>> entries;
+    entries.reserve(nDSOs * 2);
+    for (std::size_t i = 0; i < nDSOs; ++i)
+    {
+        double r = pickRadius(dsos[i]);
+        if (r > maxSmallRadius)
+        {
+            m_largeObjects.push_back(dsos[i]);
+            continue;
+        }
+
+        Eigen::Vector3d lo = (dsos[i]->getPosition().array() - r - m_origin.array()) / m_cellSize;
+        Eigen::Vector3d hi = (dsos[i]->getPosition().array() + r - m_origin.array()) / m_cellSize;
+        Eigen::Array<std::int64_t, 3, 1> cellLo, cellHi;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            cellLo[axis] = std::clamp(static_cast<std::int64_t>(std::floor(lo[axis])), std::int64_t(0), m_cellsPerAxis - 1);
+            cellHi[axis] = std::clamp(static_cast<std::int64_t>(std::floor(hi[axis])), std::int64_t(0), m_cellsPerAxis - 1);
+        }
+
+        for (std::int64_t z = cellLo.z(); z <= cellHi.z(); ++z)
+        {
+            for (std::int64_t y = cellLo.y(); y <= cellHi.y(); ++y)
+            {
+                for (std::int64_t x = cellLo.x(); x <= cellHi.x(); ++x)
+                    entries.emplace_back(cellKey(x, y, z), dsos[i]);
+            }
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const auto& e0, const auto& e1) { return e0.first < e1.first; });
+
+    m_cellObjects.reserve(entries.size());
+    for (std::size_t i = 0; i < entries.size();)
+    {
+        auto begin = static_cast<std::uint32_t>(m_cellObjects.size());
+        std::uint64_t key = entries[i].first;
+        for (; i < entries.size() && entries[i].first == key; ++i)
+            m_cellObjects.push_back(entries[i].second);
+        m_cells.try_emplace(key, begin, static_cast<std::uint32_t>(m_cellObjects.size()));
+    }
+}
+
+void
+DSOGrid::processRay(DSOHandler& processor,
+                    const Eigen::Vector3d& origin,
+                    const Eigen::Vector3d& direction,
+                    double maxDistance) const
+{
+    if (empty())
+        return;
+
+    std::vector<DeepSkyObject*> candidates(m_largeObjects.begin(), m_largeObjects.end());
+
+    double length = direction.norm();
+    if (length > 0.0)
+    {
+        Eigen::Vector3d dir = direction / length;
+
+        // Clip the ray against the grid bounds
+        double gridSize = m_cellSize * static_cast<double>(m_cellsPerAxis);
+        double tEnter = 0.0;
+        double tExit = std::numeric_limits<double>::infinity();
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            double lo = m_origin[axis] - origin[axis];
+            double hi = lo + gridSize;
+            if (dir[axis] == 0.0)
+            {
+                if (lo > 0.0 || hi < 0.0)
+                    tExit = -1.0;
+                continue;
+            }
+
+            double t0 = lo / dir[axis];
+            double t1 = hi / dir[axis];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            tEnter = std::max(tEnter, t0);
+            tExit = std::min(tExit, t1);
+        }
+
+        if (tEnter <= tExit)
+        {
+            // Walk the cells crossed by the ray (Amanatides & Woo)
+            Eigen::Vector3d start = (origin + dir * tEnter - m_origin) / m_cellSize;
+            std::int64_t cell[3];
+            std::int64_t step[3];
+            double tMax[3];
+            double tDelta[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                cell[axis] = std::clamp(static_cast<std::int64_t>(std::floor(start[axis])), std::int64_t(0), m_cellsPerAxis - 1);
+                if (dir[axis] > 0.0)
+                {
+                    step[axis] = 1;
+                    tDelta[axis] = m_cellSize / dir[axis];
+                    tMax[axis] = tEnter + (static_cast<double>(cell[axis] + 1) - start[axis]) * tDelta[axis];
+                }
+                else if (dir[axis] < 0.0)
+                {
+                    step[axis] = -1;
+                    tDelta[axis] = -m_cellSize / dir[axis];
+                    tMax[axis] = tEnter + (start[axis] - static_cast<double>(cell[axis])) * tDelta[axis];
+                }
+                else
+                {
+                    step[axis] = 0;
+                    tDelta[axis] = std::numeric_limits<double>::infinity();
+                    tMax[axis] = std::numeric_limits<double>::infinity();
+                }
+            }
+
+            for (;;)
+            {
+                addCellObjects(cellKey(cell[0], cell[1], cell[2]), candidates);
+
+                int axis = 0;
+                if (tMax[1] < tMax[axis])
+                    axis = 1;
+                if (tMax[2] < tMax[axis])
+                    axis = 2;
+                if (tMax[axis] > tExit)
+                    break;
+
+                cell[axis] += step[axis];
+                if (cell[axis] < 0 || cell[axis] >= m_cellsPerAxis)
+                    break;
+                tMax[axis] += tDelta[axis];
+            }
+        }
+    }
+
+    processCandidates(processor, candidates, origin, maxDistance);
+}
+
+bool
+DSOGrid::processCloseObjects(DSOHandler& processor,
+                             const Eigen::Vector3d& position,
+                             double radius) const
+{
+    if (empty())
+        return true;
+
+    Eigen::Vector3d lo = (position.array() - radius - m_origin.array()) / m_cellSize;
+    Eigen::Vector3d hi = (position.array() + radius - m_origin.array()) / m_cellSize;
+    auto gridSize = static_cast<double>(m_cellsPerAxis);
+
+    std::vector<DeepSkyObject*> candidates(m_largeObjects.begin(), m_largeObjects.end());
+    if ((hi.array() >= 0.0).all() && (lo.array() < gridSize).all())
+    {
+        std::int64_t cellLo[3];
+        std::int64_t cellHi[3];
+        std::int64_t nCells = 1;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            cellLo[axis] = static_cast<std::int64_t>(std::max(std::floor(lo[axis]), 0.0));
+            cellHi[axis] = static_cast<std::int64_t>(std::min(std::floor(hi[axis]), gridSize - 1.0));
+            nCells *= cellHi[axis] - cellLo[axis] + 1;
+        }
+
+        if (nCells > MaxQueryCells)
+            return false;
+
+        for (std::int64_t z = cellLo[2]; z <= cellHi[2]; ++z)
+        {
+            for (std::int64_t y = cellLo[1]; y <= cellHi[1]; ++y)
+            {
+                for (std::int64_t x = cellLo[0]; x <= cellHi[0]; ++x)
+                    addCellObjects(cellKey(x, y, z), candidates);
+            }
+        }
+    }
+
+    processCandidates(processor, candidates, position, radius);
+    return true;
+}
+
+std::uint64_t
+DSOGrid::cellKey(std::int64_t x, std::int64_t y, std::int64_t z) const
+{
+    return static_cast<std::uint64_t>(x + m_cellsPerAxis * (y + m_cellsPerAxis * z));
+}
+
+void
+DSOGrid::addCellObjects(std::uint64_t key, std::vector<DeepSkyObject*>& candidates) const
+{
+    auto it = m_cells.find(key);
+    if (it == m_cells.end())
+        return;
+
+    candidates.insert(candidates.end(),
+                      m_cellObjects.begin() + it->second.first,
+                      m_cellObjects.begin() + it->second.second);
+}
+
+void
+DSOGrid::processCandidates(DSOHandler& processor,
+                           std::vector<DeepSkyObject*>& candidates,
+                           const Eigen::Vector3d& position,
+                           double radius) const
+{
+    // Objects overlapping several cells are collected more than once
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    double radiusSquared = radius * radius;
+    for (DeepSkyObject* dso : candidates)
+    {
+        double distanceSquared = (position - dso->getPosition()).squaredNorm();
+        if (distanceSquared < radiusSquared)
+        {
+            double distance = std::sqrt(distanceSquared) - dso->getBoundingSphereRadius();
+            processor.process(dso, distance, dso->getAbsoluteMagnitude());
+        }
+    }
+}
+
+std::size_t
+DSOGrid::memoryUsage() const
+{
+    // Hash nodes hold the entry and the link, plus one bucket pointer each
+    std::size_t size = m_cells.size() * (sizeof(decltype(m_cells)::value_type) + sizeof(void*));
+    size += m_cells.bucket_count() * sizeof(void*);
+    size += m_cellObjects.capacity() * sizeof(DeepSkyObject*);
+    size += m_largeObjects.capacity() * sizeof(DeepSkyObject*);
+    return size;
+}
@@ -0,0 +1,75 @@
+// dsogrid.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Loose uniform grid over deep sky object bounding spheres, used to answer
+// picking and proximity queries without walking the DSO octree.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/dsooctree.h>
+
+class DSOGrid
+{
+public:
+    // Sorts the objects into grid cells. Objects whose bounding sphere
+    // covers too many cells are kept in a separate list that every query
+    // visits.
+    void build(DeepSkyObject* const* dsos, std::size_t nDSOs);
+
+    bool empty() const { return m_nObjects == 0; }
+
+    // Bytes of heap memory used by the cells and object lists
+    std::size_t memoryUsage() const;
+
+    // Calls processor for each object with a bounding sphere that may
+    // intersect the ray and with a center closer than maxDistance to the
+    // origin. The distance passed to the processor is measured to the
+    // object's bounding sphere, as in DSOOctree::processCloseObjects.
+    void processRay(DSOHandler& processor,
+                    const Eigen::Vector3d& origin,
+                    const Eigen::Vector3d& direction,
+                    double maxDistance) const;
+
+    // Calls processor for each object with a center closer than radius to
+    // position. Returns false without processing anything if the query
+    // would touch more than MaxQueryCells cells; the octree handles those
+    // better.
+    bool processCloseObjects(DSOHandler& processor,
+                             const Eigen::Vector3d& position,
+                             double radius) const;
+
+private:
+    using CellRange = std::pair<std::uint32_t, std::uint32_t>;
+
+    static constexpr std::int64_t MaxQueryCells = 4096;
+
+    std::uint64_t cellKey(std::int64_t x, std::int64_t y, std::int64_t z) const;
+    void addCellObjects(std::uint64_t key, std::vector<DeepSkyObject*>& candidates) const;
+    void processCandidates(DSOHandler& processor,
+                           std::vector<DeepSkyObject*>& candidates,
+                           const Eigen::Vector3d& position,
+                           double radius) const;
+
+    Eigen::Vector3d m_origin{ Eigen::Vector3d::Zero() };
+    double m_cellSize{ 1.0 };
+    std::int64_t m_cellsPerAxis{ 0 };
+    std::size_t m_nObjects{ 0 };
+
+    std::unordered_map<std::uint64_t, CellRange> m_cells;
+    std::vector<DeepSkyObject*> m_cellObjects;
+    std::vector<DeepSkyObject*> m_largeObjects;
+};
@@ -10,6 +10,8 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <vector>
+
 #include <celengine/dsooctree.h>
 
 using namespace Eigen;
@@ -44,7 +46,7 @@ double dsoAbsoluteMagnitudeDecayFunction(const double excludingFactor)
 
 
 template <>
-DynamicDSOOctree* DynamicDSOOctree::getChild(DeepSkyObject* const & _obj, const PointType& cellCenterPos)
+int DynamicDSOOctree::getChildIndex(DeepSkyObject* const & _obj, const PointType& cellCenterPos)
 {
     PointType objPos = _obj->getPosition();
 
@@ -53,7 +55,7 @@ DynamicDSOOctree* DynamicDSOOctree::getChild(DeepSkyObject* const & _obj, const
     child     |= objPos.y() < cellCenterPos.y() ? 0 : YPos;
     child     |= objPos.z() < cellCenterPos.z() ? 0 : ZPos;
 
-    return _children[child];
+    return child;
 }
 
 
@@ -67,6 +69,13 @@ template<> DynamicDSOOctree::ExclusionFactorDecayFunction*
 
 
 // total specialization of the StaticOctree template process*() methods for DSOs:
+
+// The node tests of the visibility traversal run in single precision,
+// relative to the observer. Each node center is subtracted from the observer
+// position in double precision before it is rounded, so the error of a
+// node's relative position is proportional to its distance rather than to
+// the size of the catalog, and the tests are padded by that error. The
+// children of a node are tested together, eight lanes at a time.
 template<>
 void DSOOctree::processVisibleObjects(DSOHandler&    processor,
                                       const PointType& obsPosition,
@@ -74,56 +83,102 @@ void DSOOctree::processVisibleObjects(DSOHandler&    processor,
                                       float          limitingFactor,
                                       double         scale) const
 {
-    // See if this node lies within the view frustum
-
-    // Test the cubic octree node against each one of the five
-    // planes that define the infinite view frustum.
-    for (unsigned int i = 0; i < 5; ++i)
+    constexpr int nPlanes = 5;
+    // Relative rounding error allowed for a node position, a few ulps
+    constexpr float RoundingMargin = 1.0e-6f;
+
+    Matrix<float, 3, nPlanes> normals;
+    Array<float, nPlanes, 1> offsets;
+    Array<float, nPlanes, 1> extents;
+    for (int i = 0; i < nPlanes; ++i)
     {
-        const Hyperplane<double, 3>& plane = frustumPlanes[i];
+        normals.col(i) = frustumPlanes[i].normal().cast<float>();
+        offsets[i] = static_cast<float>(frustumPlanes[i].signedDistance(obsPosition));
+        extents[i] = normals.col(i).cwiseAbs().sum();
+    }
 
-        double r = scale * plane.normal().cwiseAbs().sum();
-        if (plane.signedDistance(cellCenterPos) < -r)
+    struct PendingNode
+    {
+        const DSOOctree* node;
+        double           scale;
+        Vector3f         relCenter;
+    };
+
+    // Test the root against each one of the five planes that define the
+    // infinite view frustum.
+    Vector3f rootCenter = (cellCenterPos - obsPosition).cast<float>();
+    float rootMargin = RoundingMargin * rootCenter.cwiseAbs().sum();
+    for (int i = 0; i < nPlanes; ++i)
+    {
+        float r = static_cast<float>(scale) * extents[i] + rootMargin;
+        if (normals.col(i).dot(rootCenter) + offsets[i] < -r)
             return;
     }
 
-    // Compute the distance to node; this is equal to the distance to
-    // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
-    double minDistance = (obsPosition - cellCenterPos).norm() - scale * DSOOctree::SQRT3;
-
-    // Process the objects in this node
-    double dimmest = minDistance > 0.0 ? astro::appToAbsMag((double) limitingFactor, minDistance) : 1000.0;
+    std::vector<PendingNode> pending;
+    pending.reserve(64);
+    pending.push_back({ this, scale, rootCenter });
 
-    for (unsigned int i=0; i<nObjects; ++i)
+    while (!pending.empty())
     {
-        DeepSkyObject* _obj = _firstObject[i];
-        float  absMag      = _obj->getAbsoluteMagnitude();
-        if (absMag < dimmest)
-        {
-            double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
-            float appMag = (float) ((distance >= 32.6167) ? astro::absToAppMag((double) absMag, distance) : absMag);
+        PendingNode current = pending.back();
+        pending.pop_back();
+        const DSOOctree* node = current.node;
 
-            if (appMag < limitingFactor)
-                processor.process(_obj, distance, absMag);
-        }
-    }
+        // Compute the distance to node; this is equal to the distance to
+        // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
+        double minDistance = static_cast<double>(current.relCenter.norm()) - current.scale * DSOOctree::SQRT3;
 
-    // See if any of the objects in child nodes are potentially included
-    // that we need to recurse deeper.
-    if (minDistance <= 0.0 || astro::absToAppMag((double) exclusionFactor, minDistance) <= limitingFactor)
-    {
-        // Recurse into the child nodes
-        if (_children != nullptr)
+        // Process the objects in this node
+        double dimmest = minDistance > 0.0 ? astro::appToAbsMag((double) limitingFactor, minDistance) : 1000.0;
+
+        for (unsigned int i=0; i<node->nObjects; ++i)
         {
-            for (int i = 0; i < 8; ++i)
+            DeepSkyObject* _obj = node->_firstObject[i];
+            float  absMag      = _obj->getAbsoluteMagnitude();
+            if (absMag < dimmest)
             {
-                _children[i]->processVisibleObjects(processor,
-                                                    obsPosition,
-                                                    frustumPlanes,
-                                                    limitingFactor,
-                                                    scale * 0.5f);
+                double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
+                float appMag = (float) ((distance >= 32.6167) ? astro::absToAppMag((double) absMag, distance) : absMag);
+
+                if (appMag < limitingFactor)
+                    processor.process(_obj, distance, absMag);
             }
         }
+
+        // See if any of the objects in child nodes are potentially included
+        // that we need to recurse deeper.
+        if (!node->hasChildren()
+            || (minDistance > 0.0 && astro::absToAppMag((double) node->exclusionFactor, minDistance) > limitingFactor))
+        {
+            continue;
+        }
+
+        double childScale = current.scale * 0.5;
+        Array<float, 8, 1> x, y, z;
+        for (int i = 0; i < 8; ++i)
+        {
+            Vector3f relCenter = (node->child(i)->cellCenterPos - obsPosition).cast<float>();
+            x[i] = relCenter.x();
+            y[i] = relCenter.y();
+            z[i] = relCenter.z();
+        }
+
+        Array<float, 8, 1> margin = RoundingMargin * (x.abs() + y.abs() + z.abs());
+        Array<bool, 8, 1> visible = Array<bool, 8, 1>::Constant(true);
+        for (int i = 0; i < nPlanes; ++i)
+        {
+            Array<float, 8, 1> distance = normals(0, i) * x + normals(1, i) * y + normals(2, i) * z + offsets[i];
+            visible = visible && (distance >= -(static_cast<float>(childScale) * extents[i] + margin));
+        }
+
+        // Push in reverse so that the children are visited in order, as in
+        // a recursive traversal
+        for (int i = 7; i >= 0; --i)
+        {
+            if (visible[i])
+                pending.push_back({ node->child(i), childScale, Vector3f(x[i], y[i], z[i]) });
+        }
     }
 }
 
@@ -163,14 +218,14 @@ void DSOOctree::processCloseObjects(DSOHandler&    processor,
     }
 
     // Recurse into the child nodes
-    if (_children != nullptr)
+    if (hasChildren())
     {
         for (int i = 0; i < 8; ++i)
         {
-            _children[i]->processCloseObjects(processor,
-                                              obsPosition,
-                                              boundingRadius,
-                                              scale * 0.5f);
+            child(i)->processCloseObjects(processor,
+                                          obsPosition,
+                                          boundingRadius,
+                                          scale * 0.5f);
         }
     }
 }
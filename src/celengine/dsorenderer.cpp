@@ -55,6 +55,28 @@ brightness(float avgAbsMag, float absMag, float appMag, float brightnessCorr, fl
 
 } // anonymous namespace
 
+void DSORenderer::submit(const DSODrawCandidate& c) const
+{
+    switch (c.dso->getObjType())
+    {
+    case DeepSkyObjectType::Galaxy:
+        galaxyRenderer->add(static_cast<const Galaxy*>(c.dso), c.relPos, c.brightness, c.nearZ, c.farZ);
+        break;
+    case DeepSkyObjectType::Globular:
+        globularRenderer->add(static_cast<const Globular*>(c.dso), c.relPos, c.brightness, c.nearZ, c.farZ);
+        break;
+    case DeepSkyObjectType::Nebula:
+        nebulaRenderer->add(static_cast<const Nebula*>(c.dso), c.relPos, c.brightness, c.nearZ, c.farZ);
+        break;
+    case DeepSkyObjectType::OpenCluster:
+        openClusterRenderer->add(static_cast<const OpenCluster*>(c.dso), c.relPos, c.brightness, c.nearZ, c.farZ);
+        break;
+    default:
+        // Unsupported DSO
+        break;
+    }
+}
+
 DSORenderer::DSORenderer() :
     ObjectRenderer<DeepSkyObject*, double>(DSO_OCTREE_ROOT_SIZE)
 {
@@ -111,25 +133,21 @@ void DSORenderer::process(DeepSkyObject* const &dso,
         case DeepSkyObjectType::Galaxy:
             // -19.04f == average over 10937 galaxies in galaxies.dsc.
             b = brightness(-19.04f, absMag, appMag, b, faintestMag);
-            galaxyRenderer->add(static_cast<const Galaxy*>(dso), relPos, b, nearZ, farZ);
             break;
         case DeepSkyObjectType::Globular:
             // -6.86f == average over 150 globulars in globulars.dsc.
             b = brightness(-6.86f, absMag, appMag, b, faintestMag);
-            globularRenderer->add(static_cast<const Globular*>(dso), relPos, b, nearZ, farZ);
-            break;
-        case DeepSkyObjectType::Nebula:
-            b = brightness(avgAbsMag, absMag, appMag, b, faintestMag);
-            nebulaRenderer->add(static_cast<const Nebula*>(dso), relPos, b, nearZ, farZ);
-            break;
-        case DeepSkyObjectType::OpenCluster:
-            b = brightness(avgAbsMag, absMag, appMag, b, faintestMag);
-            openClusterRenderer->add(static_cast<const OpenCluster*>(dso), relPos, b, nearZ, farZ);
             break;
         default:
-            // Unsupported DSO
+            b = brightness(avgAbsMag, absMag, appMag, b, faintestMag);
             break;
         }
+
+        DSODrawCandidate candidate{ dso, relPos, b, appMag, nearZ, farZ };
+        if (candidates != nullptr)
+            candidates->push_back(candidate);
+        else
+            submit(candidate);
     } // renderFlags check
 
     // Only render those labels that are in front of the camera:
@@ -193,7 +211,8 @@ void DSORenderer::process(DeepSkyObject* const &dso,
                                               relPos,
                                               Renderer::LabelHorizontalAlignment::Start,
                                               Renderer::LabelVerticalAlignment::Center,
-                                              symbolSize);
+                                              symbolSize,
+                                              -appMagEff);
         }
     }     // labels enabled
 }
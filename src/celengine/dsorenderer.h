@@ -11,6 +11,7 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
 #include <Eigen/Core>
 
@@ -23,6 +24,19 @@
 class DeepSkyObject;
 class DSODatabase;
 
+// A deep sky object selected for drawing. Candidates are collected for the
+// whole frame so that the faintest ones can be dropped when there are more
+// than the frame budget allows.
+struct DSODrawCandidate
+{
+    const DeepSkyObject* dso;
+    Eigen::Vector3f      relPos;
+    float                brightness;
+    float                appMag;
+    float                nearZ;
+    float                farZ;
+};
+
 class DSORenderer : public ObjectRenderer<DeepSkyObject *, double>
 {
 public:
@@ -30,6 +44,9 @@ public:
 
     void process(DeepSkyObject *const &, double, float) override;
 
+    // Hands a candidate to the renderer for its object type
+    void submit(const DSODrawCandidate&) const;
+
     celestia::math::InfiniteFrustum frustum{ celestia::math::degToRad(celestia::engine::standardFOV),
                                              1.0f,
                                              1.0f };
@@ -45,4 +62,7 @@ public:
     celestia::render::GlobularRenderer    *globularRenderer{ nullptr };
     celestia::render::NebulaRenderer      *nebulaRenderer{ nullptr };
     celestia::render::OpenClusterRenderer *openClusterRenderer{ nullptr };
+
+    // If set, objects to draw are appended here instead of being submitted
+    std::vector<DSODrawCandidate> *candidates{ nullptr };
 };
@@ -0,0 +1,285 @@
+// fisheyecubemap.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "fisheyecubemap.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include <Eigen/Core>
+
+#include <celcompat/numbers.h>
+#include <celrender/gl/binder.h>
+#include <celutil/logger.h>
+#include "framebuffer.h"
+#include "perspectiveprojectionmode.h"
+#include "render.h"
+#include "shadermanager.h"
+
+namespace gl = celestia::gl;
+namespace util = celestia::util;
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+// Perspective projection with the 90 degree field of view of a cube face,
+// whatever the zoom of the observer
+class CubeFaceProjectionMode : public PerspectiveProjectionMode
+{
+public:
+    CubeFaceProjectionMode(float size, int screenDpi) :
+        PerspectiveProjectionMode(size, size, 0, screenDpi)
+    {
+    }
+
+    float getFOV(float /*zoom*/) const override
+    {
+        return celestia::numbers::pi_v<float> / 2.0f;
+    }
+
+    float getZoom(float /*fov*/) const override
+    {
+        return 1.0f;
+    }
+};
+
+struct CubeFace
+{
+    GLenum target;
+    // View direction and up vector in the camera space of the observer,
+    // following the orientation of the cube map faces
+    Eigen::Vector3d forward;
+    Eigen::Vector3d up;
+    // Part of the face inside the hemisphere in front of the observer, in
+    // halves of the face size
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// The observer looks down -z, which is the front face drawn in full. Of the
+// side faces only the half towards -z is needed, the +z face is skipped.
+const std::array<CubeFace, 5> cubeFaces
+{
+    CubeFace{ GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, -Eigen::Vector3d::UnitZ(), -Eigen::Vector3d::UnitY(), 0, 0, 2, 2 },
+    CubeFace{ GL_TEXTURE_CUBE_MAP_POSITIVE_X,  Eigen::Vector3d::UnitX(), -Eigen::Vector3d::UnitY(), 1, 0, 1, 2 },
+    CubeFace{ GL_TEXTURE_CUBE_MAP_NEGATIVE_X, -Eigen::Vector3d::UnitX(), -Eigen::Vector3d::UnitY(), 0, 0, 1, 2 },
+    CubeFace{ GL_TEXTURE_CUBE_MAP_POSITIVE_Y,  Eigen::Vector3d::UnitY(),  Eigen::Vector3d::UnitZ(), 0, 0, 2, 1 },
+    CubeFace{ GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, -Eigen::Vector3d::UnitY(), -Eigen::Vector3d::UnitZ(), 0, 1, 2, 1 },
+};
+
+// Rotation from the camera space of the observer to the camera space of a
+// face, looking down -z with +y up
+Eigen::Matrix3d
+faceRotation(const CubeFace& face)
+{
+    Eigen::Matrix3d m;
+    m.row(0) = face.forward.cross(face.up);
+    m.row(1) = face.up;
+    m.row(2) = -face.forward;
+    return m;
+}
+
+const Renderer::PipelineState ps;
+
+} // end unnamed namespace
+
+FisheyeCubeMap::FisheyeCubeMap() = default;
+
+FisheyeCubeMap::~FisheyeCubeMap()
+{
+    cleanup();
+}
+
+bool
+FisheyeCubeMap::render(Renderer& renderer,
+                       int x, int y, int width, int height,
+                       bool withScissor,
+                       const std::function<void()>& renderScene)
+{
+    if (renderer.getShaderManager().getShader("fisheyecubemap") == nullptr)
+        return false;
+
+    if (!renderFaces(renderer, height, renderScene))
+        return false;
+
+    renderer.setRenderRegion(x, y, width, height, withScissor);
+    return resample(renderer, width, height);
+}
+
+bool
+FisheyeCubeMap::renderFaces(Renderer& renderer,
+                            int height,
+                            const std::function<void()>& renderScene)
+{
+    // The fisheye has the diameter of the viewport height and covers 180
+    // degrees; the faces get the pixel density of its center
+    int faceSize = std::max(static_cast<int>(std::lround(2.0 * static_cast<double>(height) / celestia::numbers::pi)), 16);
+    if (!initialize(faceSize, renderer.getScreenDpi()))
+        return false;
+
+    GLint oldFboId = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+    if (!m_fbo->bind())
+        return false;
+
+    auto mainProjection = renderer.getProjectionMode();
+    Eigen::Matrix3d cameraTransform = renderer.getCameraTransform();
+    renderer.setProjectionMode(m_faceProjection);
+
+    int half = m_faceSize / 2;
+    gl::Binder::get().bindTexture(GL_TEXTURE_CUBE_MAP, m_cubeTexture);
+    for (const CubeFace& face : cubeFaces)
+    {
+        // One pixel more than the half faces for filtering across the edge
+        int faceX = face.x * half;
+        int faceY = face.y * half;
+        int faceWidth = std::min(face.width * half + 1, m_faceSize - faceX);
+        int faceHeight = std::min(face.height * half + 1, m_faceSize - faceY);
+        if (face.x > 0)
+        {
+            faceX -= 1;
+            faceWidth += 1;
+        }
+        if (face.y > 0)
+        {
+            faceY -= 1;
+            faceHeight += 1;
+        }
+
+        renderer.setCameraTransform(faceRotation(face) * cameraTransform);
+        renderer.setRenderRegion(0, 0, m_faceSize, m_faceSize);
+        renderer.setScissor(faceX, faceY, faceWidth, faceHeight);
+        renderScene();
+
+        gl::Binder::get().bindTexture(GL_TEXTURE_CUBE_MAP, m_cubeTexture);
+        glCopyTexSubImage2D(face.target, 0, faceX, faceY, faceX, faceY, faceWidth, faceHeight);
+    }
+
+    renderer.setCameraTransform(cameraTransform);
+    renderer.setProjectionMode(mainProjection);
+    // The shaders keep being built without the fisheye projection
+    renderer.getShaderManager().setFisheyeEnabled(false);
+
+    m_fbo->unbind(oldFboId);
+    return true;
+}
+
+bool
+FisheyeCubeMap::resample(Renderer& renderer, int width, int height)
+{
+    auto *prog = renderer.getShaderManager().getShader("fisheyecubemap");
+    if (prog == nullptr)
+        return false;
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    prog->use();
+    prog->samplerParam("tex") = 0;
+    gl::Binder::get().bindTexture(GL_TEXTURE_CUBE_MAP, m_cubeTexture);
+    // Scales the viewport so that the fisheye circle has a radius of one
+    prog->vec2Param("scale") = Eigen::Vector2f(static_cast<float>(width) / static_cast<float>(height), 1.0f);
+    renderer.setPipelineState(ps);
+    m_vo.draw();
+    gl::Binder::get().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    return true;
+}
+
+bool
+FisheyeCubeMap::initialize(int faceSize, int screenDpi)
+{
+    if (m_initialized && faceSize == m_requestedSize)
+        return m_fbo != nullptr;
+
+    if (!m_initialized)
+    {
+        m_initialized = true;
+
+        static std::array quadVertices = {
+            -1.0f,  1.0f,
+            -1.0f, -1.0f,
+             1.0f, -1.0f,
+
+            -1.0f,  1.0f,
+             1.0f, -1.0f,
+             1.0f,  1.0f,
+        };
+
+        m_vo = gl::VertexObject();
+        m_bo = gl::Buffer(gl::Buffer::TargetHint::Array, quadVertices, gl::Buffer::BufferUsage::StaticDraw);
+
+        m_vo.setCount(6);
+        m_vo.addVertexBuffer(
+            m_bo,
+            CelestiaGLProgram::VertexCoordAttributeIndex,
+            2,
+            gl::VertexObject::DataType::Float,
+            false,
+            2 * sizeof(float),
+            0);
+    }
+
+    cleanup();
+    m_requestedSize = faceSize;
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_CUBE_MAP_TEXTURE_SIZE, &maxSize);
+    if (faceSize > maxSize)
+    {
+        util::GetLogger()->warn("Fisheye cube map faces of {} pixels exceed the limit of {}.\n", faceSize, maxSize);
+        faceSize = maxSize;
+    }
+    m_faceSize = faceSize;
+
+    m_fbo = std::make_unique<FramebufferObject>(static_cast<GLuint>(faceSize), static_cast<GLuint>(faceSize),
+                                                FramebufferObject::ColorAttachment | FramebufferObject::DepthAttachment);
+    if (!m_fbo->isValid())
+    {
+        util::GetLogger()->error("Error creating fisheye cube map FBO.\n");
+        m_fbo = nullptr;
+        return false;
+    }
+
+    glGenTextures(1, &m_cubeTexture);
+    gl::Binder::get().bindTexture(GL_TEXTURE_CUBE_MAP, m_cubeTexture);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    for (int i = 0; i < 6; ++i)
+    {
+        glTexImage2D(static_cast<GLenum>(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i), 0, GL_RGBA,
+                     faceSize, faceSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    gl::Binder::get().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    m_faceProjection = std::make_shared<CubeFaceProjectionMode>(static_cast<float>(faceSize), screenDpi);
+    return true;
+}
+
+void
+FisheyeCubeMap::cleanup()
+{
+    m_fbo = nullptr;
+    if (m_cubeTexture != 0)
+    {
+        gl::Binder::get().forgetTexture(m_cubeTexture);
+        glDeleteTextures(1, &m_cubeTexture);
+        m_cubeTexture = 0;
+    }
+}
+
+} // end namespace celestia::engine
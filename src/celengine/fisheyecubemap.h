@@ -0,0 +1,84 @@
+// fisheyecubemap.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Fisheye rendering by resampling a cube map.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <celrender/gl/buffer.h>
+#include <celrender/gl/vertexobject.h>
+#include "glsupport.h"
+
+class FramebufferObject;
+class Renderer;
+
+namespace celestia::engine
+{
+
+class ProjectionMode;
+
+// Renders the hemisphere in front of the observer into the faces of a cube
+// map with an ordinary perspective projection and resamples it to a fisheye
+// image, instead of projecting every vertex to the fisheye in the shaders.
+// Only the front face and the halves of the four side faces which fall into
+// the hemisphere are drawn; the back face is never visible. The faces are
+// sized so that the center of the fisheye keeps the resolution of the
+// viewport.
+//
+// The projection mode of the renderer has to be a FisheyeProjectionMode,
+// which is used for picking and the field of view, but the shaders have to
+// be built without the fisheye projection.
+class FisheyeCubeMap
+{
+public:
+    FisheyeCubeMap();
+    ~FisheyeCubeMap();
+
+    FisheyeCubeMap(const FisheyeCubeMap&) = delete;
+    FisheyeCubeMap& operator=(const FisheyeCubeMap&) = delete;
+
+    // Draws the scene through renderScene, once for each cube face, then
+    // the fisheye into the given region of the current framebuffer.
+    // Returns false if the cube map can't be used, in which case nothing
+    // is drawn.
+    bool render(Renderer& renderer,
+                int x, int y, int width, int height,
+                bool withScissor,
+                const std::function<void()>& renderScene);
+
+    // The two steps of render(), for viewport effects which sample the
+    // cube map themselves: renderFaces draws the faces for a fisheye of the
+    // given height, resample draws the fisheye into the render region of
+    // the renderer
+    bool renderFaces(Renderer& renderer,
+                     int height,
+                     const std::function<void()>& renderScene);
+    bool resample(Renderer& renderer, int width, int height);
+
+    GLuint cubeTexture() const { return m_cubeTexture; }
+
+private:
+    bool initialize(int faceSize, int screenDpi);
+    void cleanup();
+
+    std::unique_ptr<FramebufferObject> m_fbo;
+    std::shared_ptr<ProjectionMode> m_faceProjection;
+    GLuint m_cubeTexture{ 0 };
+    int m_requestedSize{ 0 };
+    int m_faceSize{ 0 };
+    bool m_initialized{ false };
+
+    celestia::gl::VertexObject m_vo{ celestia::util::NoCreateT{} };
+    celestia::gl::Buffer m_bo{ celestia::util::NoCreateT{} };
+};
+
+} // end namespace celestia::engine
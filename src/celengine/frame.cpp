@@ -10,7 +10,9 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cassert>
+#include <vector>
 #include <celastro/astro.h>
 #include <celastro/date.h>
 #include <celengine/star.h>
@@ -141,6 +143,33 @@ ReferenceFrame::convertToAstrocentric(const Vector3d& p, double tjd) const
 }
 
 
+void
+ReferenceFrame::convertToAstrocentric(Vector3d* positions, double startTime, double step, std::size_t count) const
+{
+    if (centerObject.getType() == SelectionType::Body)
+    {
+        // Compute the positions of the center together too
+        std::vector<Vector3d> centers(count);
+        centerObject.body()->getAstrocentricPositions(startTime, step, centers.data(), count);
+        std::vector<Quaterniond> orientations(count);
+        getOrientations(startTime, step, orientations.data(), count);
+        for (std::size_t i = 0; i < count; ++i)
+            positions[i] = centers[i] + orientations[i].conjugate() * positions[i];
+    }
+    else if (centerObject.getType() == SelectionType::Star)
+    {
+        std::vector<Quaterniond> orientations(count);
+        getOrientations(startTime, step, orientations.data(), count);
+        for (std::size_t i = 0; i < count; ++i)
+            positions[i] = orientations[i].conjugate() * positions[i];
+    }
+    else
+    {
+        std::fill_n(positions, count, Vector3d::Zero());
+    }
+}
+
+
 /*! Return the object that is the defined origin of the reference frame.
  */
 Selection
@@ -150,6 +179,14 @@ ReferenceFrame::getCenter() const
 }
 
 
+void
+ReferenceFrame::getOrientations(double startTime, double step, Quaterniond* orientations, std::size_t count) const
+{
+    for (std::size_t i = 0; i < count; ++i)
+        orientations[i] = getOrientation(startTime + static_cast<double>(i) * step);
+}
+
+
 Vector3d
 ReferenceFrame::getAngularVelocity(double tjd) const
 {
@@ -296,6 +333,35 @@ BodyFixedFrame::getOrientation(double tjd) const
 }
 
 
+void
+BodyFixedFrame::getOrientations(double startTime, double step, Quaterniond* orientations, std::size_t count) const
+{
+    const Body* body = nullptr;
+    switch (fixObject.getType())
+    {
+    case SelectionType::Body:
+        body = fixObject.body();
+        break;
+    case SelectionType::Location:
+        body = fixObject.location()->getParentBody();
+        break;
+    default:
+        break;
+    }
+
+    if (body == nullptr)
+    {
+        ReferenceFrame::getOrientations(startTime, step, orientations, count);
+        return;
+    }
+
+    Quaterniond yrot180(0.0, 0.0, 1.0, 0.0);
+    body->getOrientations(startTime, step, orientations, count);
+    for (std::size_t i = 0; i < count; ++i)
+        orientations[i] = yrot180 * orientations[i];
+}
+
+
 Vector3d
 BodyFixedFrame::getAngularVelocity(double tjd) const
 {
@@ -450,6 +516,7 @@ BodyMeanEquatorFrame::nestingDepth(unsigned int depth,
 
 CachingFrame::CachingFrame(Selection _center) :
     ReferenceFrame(_center),
+    lastGeneration(0),
     lastTime(-1.0e50),
     lastOrientation(Quaterniond::Identity()),
     lastAngularVelocity(0.0, 0.0, 0.0),
@@ -459,17 +526,25 @@ CachingFrame::CachingFrame(Selection _center) :
 }
 
 
-Quaterniond
-CachingFrame::getOrientation(double tjd) const
+void
+CachingFrame::updateCacheTime(double tjd) const
 {
-    if (tjd != lastTime)
+    std::uint64_t generation = Body::getStateGeneration();
+    if (tjd != lastTime || generation != lastGeneration)
     {
         lastTime = tjd;
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
+        lastGeneration = generation;
+        orientationCacheValid = false;
         angularVelocityCacheValid = false;
     }
-    else if (!orientationCacheValid)
+}
+
+
+Quaterniond
+CachingFrame::getOrientation(double tjd) const
+{
+    updateCacheTime(tjd);
+    if (!orientationCacheValid)
     {
         lastOrientation = computeOrientation(tjd);
         orientationCacheValid = true;
@@ -481,14 +556,8 @@ CachingFrame::getOrientation(double tjd) const
 
 Vector3d CachingFrame::getAngularVelocity(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        orientationCacheValid = false;
-        angularVelocityCacheValid = true;
-    }
-    else if (!angularVelocityCacheValid)
+    updateCacheTime(tjd);
+    if (!angularVelocityCacheValid)
     {
         lastAngularVelocity = computeAngularVelocity(tjd);
         angularVelocityCacheValid = true;
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <celengine/selection.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -36,10 +38,15 @@ class ReferenceFrame
 
     Eigen::Vector3d convertFromAstrocentric(const Eigen::Vector3d& p, double tjd) const;
     Eigen::Vector3d convertToAstrocentric(const Eigen::Vector3d& p, double tjd) const;
+    // Converts positions at the count times startTime + i * step in place
+    void convertToAstrocentric(Eigen::Vector3d* positions, double startTime, double step, std::size_t count) const;
 
     Selection getCenter() const;
 
     virtual Eigen::Quaterniond getOrientation(double tjd) const = 0;
+    // Orientations at the count times startTime + i * step; the default
+    // calls getOrientation() for each
+    virtual void getOrientations(double startTime, double step, Eigen::Quaterniond* orientations, std::size_t count) const;
     virtual Eigen::Vector3d getAngularVelocity(double tdb) const;
 
     virtual bool isInertial() const = 0;
@@ -62,7 +69,10 @@ class ReferenceFrame
 
 
 /*! Base class for complex frames where there may be some benefit
- *  to caching the last calculated orientation.
+ *  to caching the last calculated orientation. The cached values are
+ *  dropped whenever the simulation advances or a body changes (see
+ *  Body::invalidateStateCaches()), so they are computed at most once
+ *  per tick for any one time.
  */
 class CachingFrame : public ReferenceFrame
 {
@@ -78,6 +88,9 @@ class CachingFrame : public ReferenceFrame
     virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
 
  private:
+    void updateCacheTime(double tjd) const;
+
+    mutable std::uint64_t lastGeneration;
     mutable double lastTime;
     mutable Eigen::Quaterniond lastOrientation;
     mutable Eigen::Vector3d lastAngularVelocity;
@@ -138,6 +151,7 @@ class BodyFixedFrame : public ReferenceFrame
     BodyFixedFrame(Selection center, Selection obj);
     ~BodyFixedFrame() override = default;
     Eigen::Quaterniond getOrientation(double tjd) const override;
+    void getOrientations(double startTime, double step, Eigen::Quaterniond* orientations, std::size_t count) const override;
     Eigen::Vector3d getAngularVelocity(double tjd) const override;
     bool isInertial() const override;
     unsigned int nestingDepth(unsigned int depth,
@@ -8,8 +8,11 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <celrender/gl/binder.h>
 #include "framebuffer.h"
 
+namespace gl = celestia::gl;
+
 FramebufferObject::FramebufferObject(GLuint width, GLuint height, unsigned int attachments) :
     m_width(width),
     m_height(height),
@@ -78,7 +81,7 @@ FramebufferObject::generateColorTexture()
 {
     // Create and bind the texture
     glGenTextures(1, &m_colorTexId);
-    glBindTexture(GL_TEXTURE_2D, m_colorTexId);
+    gl::Binder::get().bindTexture(GL_TEXTURE_2D, m_colorTexId);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -96,7 +99,7 @@ FramebufferObject::generateColorTexture()
 #endif
 
     // Unbind the texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl::Binder::get().bindTexture(GL_TEXTURE_2D, 0);
 }
 
 #ifdef GL_ES
@@ -110,7 +113,7 @@ FramebufferObject::generateDepthTexture()
 {
     // Create and bind the texture
     glGenTextures(1, &m_depthTexId);
-    glBindTexture(GL_TEXTURE_2D, m_depthTexId);
+    gl::Binder::get().bindTexture(GL_TEXTURE_2D, m_depthTexId);
 
 #ifndef GL_ES
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
@@ -132,7 +135,7 @@ FramebufferObject::generateDepthTexture()
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, m_width, m_height, 0, GL_DEPTH_COMPONENT, CEL_DEPTH_FORMAT, nullptr);
 
     // Unbind the texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl::Binder::get().bindTexture(GL_TEXTURE_2D, 0);
 }
 
 void
@@ -200,11 +203,13 @@ FramebufferObject::cleanup()
 
     if (m_colorTexId != 0)
     {
+        gl::Binder::get().forgetTexture(m_colorTexId);
         glDeleteTextures(1, &m_colorTexId);
     }
 
     if (m_depthTexId != 0)
     {
+        gl::Binder::get().forgetTexture(m_depthTexId);
         glDeleteTextures(1, &m_depthTexId);
     }
 }
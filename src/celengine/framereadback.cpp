@@ -0,0 +1,118 @@
+// framereadback.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Asynchronous readback of rendered frames through pixel pack buffers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "framereadback.h"
+
+#include <cstring>
+
+#include <celrender/gl/fence.h>
+
+using celestia::engine::PixelFormat;
+
+FrameReadback::FrameReadback(int width, int height, PixelFormat format) :
+    m_width(width),
+    m_height(height),
+    m_format(format)
+{
+    std::size_t pixelSize = format == PixelFormat::RGB ? 3 : 4;
+    m_rowStride = (static_cast<std::size_t>(width) * pixelSize + 3) & ~static_cast<std::size_t>(3);
+
+#ifndef GL_ES
+    glGenBuffers(BufferCount, m_buffers.data());
+    for (GLuint buffer : m_buffers)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(frameSize()), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+#endif
+}
+
+FrameReadback::~FrameReadback()
+{
+#ifndef GL_ES
+    for (GLsync fence : m_fences)
+    {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+    }
+    glDeleteBuffers(BufferCount, m_buffers.data());
+#endif
+}
+
+std::unique_ptr<FrameReadback>
+FrameReadback::create(int width, int height, PixelFormat format)
+{
+#ifdef GL_ES
+    // OpenGL ES 2.0 has neither pixel pack buffers nor fences
+    return nullptr;
+#else
+    if (!celestia::gl::checkVersion(celestia::gl::GL_3_2))
+        return nullptr;
+
+    return std::unique_ptr<FrameReadback>(new FrameReadback(width, height, format));
+#endif
+}
+
+bool
+FrameReadback::read(int x, int y)
+{
+#ifdef GL_ES
+    return false;
+#else
+    if (m_pending == BufferCount)
+        return false;
+
+    int index = (m_first + m_pending) % BufferCount;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[index]);
+    glReadPixels(x, y, m_width, m_height, static_cast<GLenum>(m_format), GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    m_fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++m_pending;
+    return true;
+#endif
+}
+
+bool
+FrameReadback::take(std::uint8_t* data, bool wait)
+{
+#ifdef GL_ES
+    return false;
+#else
+    if (m_pending == 0)
+        return false;
+
+    GLsync& fence = m_fences[m_first];
+    if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        if (!wait)
+            return false;
+        celestia::gl::waitForFence(fence);
+    }
+
+    glDeleteSync(fence);
+    fence = nullptr;
+
+    auto size = static_cast<GLsizeiptr>(frameSize());
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[m_first]);
+    const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (mapped != nullptr)
+    {
+        std::memcpy(data, mapped, frameSize());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_first = (m_first + 1) % BufferCount;
+    --m_pending;
+    return mapped != nullptr;
+#endif
+}
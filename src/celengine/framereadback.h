@@ -0,0 +1,69 @@
+// framereadback.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Asynchronous readback of rendered frames through pixel pack buffers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <celimage/pixelformat.h>
+#include "glsupport.h"
+
+// Reads frames into a ring of GL_PIXEL_PACK_BUFFERs, so that glReadPixels
+// returns right away and the transfer overlaps rendering the next frames.
+// A fence placed after each read tells when its pixels can be mapped.
+//
+// Rows are stored as glReadPixels writes them, bottom row first unless the
+// renderer packs them inverted, with each row padded to four bytes. All
+// functions need the GL context.
+class FrameReadback
+{
+public:
+    static constexpr int BufferCount = 3;
+
+    ~FrameReadback();
+
+    FrameReadback(const FrameReadback&) = delete;
+    FrameReadback& operator=(const FrameReadback&) = delete;
+
+    // Returns nullptr if fences aren't supported
+    static std::unique_ptr<FrameReadback> create(int width, int height,
+                                                 celestia::engine::PixelFormat format);
+
+    // Starts reading the rectangle at x, y of the current framebuffer.
+    // Returns false if every buffer holds a frame not taken yet.
+    bool read(int x, int y);
+
+    // Copies the oldest frame read into data, which must hold frameSize()
+    // bytes, and frees its buffer. If wait is false, returns false when the
+    // GPU isn't done with the frame yet.
+    bool take(std::uint8_t* data, bool wait);
+
+    int pendingCount() const { return m_pending; }
+    std::size_t rowStride() const { return m_rowStride; }
+    std::size_t frameSize() const { return m_rowStride * static_cast<std::size_t>(m_height); }
+
+private:
+    FrameReadback(int width, int height, celestia::engine::PixelFormat format);
+
+    int m_width;
+    int m_height;
+    celestia::engine::PixelFormat m_format;
+    std::size_t m_rowStride;
+
+    std::array<GLuint, BufferCount> m_buffers{};
+    std::array<GLsync, BufferCount> m_fences{};
+    // Index of the oldest frame read and the number of frames not taken
+    int m_first{ 0 };
+    int m_pending{ 0 };
+};
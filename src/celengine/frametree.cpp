@@ -42,6 +42,59 @@
 
 using namespace std;
 
+namespace
+{
+
+// Trees with fewer active children are traversed without clusters
+constexpr std::size_t MinClusteredChildren = 256;
+
+// Children per cluster
+constexpr std::size_t ClusterSize = 32;
+
+// Clusters are kept while the fastest child moves by at most this fraction
+// of the tree's bounding sphere radius, within the limits below (in days)
+constexpr double ClusterDriftFraction = 0.01;
+constexpr double MinClusterLifetime = 1.0 / 1440.0;
+constexpr double MaxClusterLifetime = 30.0;
+
+struct ClusterChild
+{
+    unsigned int index;
+    Eigen::Vector3d position;
+    // Radius of the child and its subtree plus the distance it may move
+    double radius;
+};
+
+void
+splitClusters(std::vector<ClusterChild>::iterator begin,
+              std::vector<ClusterChild>::iterator end,
+              std::vector<std::pair<std::size_t, std::size_t>>& ranges,
+              std::size_t offset)
+{
+    auto count = static_cast<std::size_t>(end - begin);
+    if (count <= ClusterSize)
+    {
+        ranges.emplace_back(offset, count);
+        return;
+    }
+
+    // Split at the median along the longest axis of the bounding box
+    Eigen::AlignedBox3d box;
+    for (auto iter = begin; iter != end; ++iter)
+        box.extend(iter->position);
+
+    Eigen::Index axis;
+    box.sizes().maxCoeff(&axis);
+    auto middle = begin + count / 2;
+    nth_element(begin, middle, end,
+                [axis](const ClusterChild& a, const ClusterChild& b) { return a.position[axis] < b.position[axis]; });
+
+    splitClusters(begin, middle, ranges, offset);
+    splitClusters(middle, end, ranges, offset + count / 2);
+}
+
+} // end unnamed namespace
+
 /*! Create a frame tree associated with a star.
  */
 FrameTree::FrameTree(Star* star) :
@@ -83,6 +136,7 @@ FrameTree::getDefaultReferenceFrame() const
 void
 FrameTree::markChanged()
 {
+    m_clusterEnd = -numeric_limits<double>::infinity();
     if (!m_changed)
     {
         m_changed = true;
@@ -154,6 +208,7 @@ void
 FrameTree::addChild(const TimelinePhase::SharedConstPtr &phase)
 {
     children.push_back(phase);
+    m_activeStart = numeric_limits<double>::infinity();
     markChanged();
 }
 
@@ -168,6 +223,7 @@ FrameTree::removeChild(const TimelinePhase::SharedConstPtr &phase)
     if (iter != children.end())
     {
         children.erase(iter);
+        m_activeStart = numeric_limits<double>::infinity();
         markChanged();
     }
 }
@@ -187,3 +243,136 @@ FrameTree::childCount() const
 {
     return children.size();
 }
+
+
+/*! Get the children whose phases include time t. Each child is tested only
+ *  when t crosses the start or end of one of the phases, so traversals of
+ *  trees with many phases spend no time on the inactive ones. The list is
+ *  valid until the next call.
+ */
+const std::vector<const TimelinePhase*>&
+FrameTree::activeChildren(double t) const
+{
+    if (m_activeStart <= t && t < m_activeEnd)
+        return m_activeChildren;
+
+    m_activeChildren.clear();
+    m_clusterEnd = -numeric_limits<double>::infinity();
+    m_activeStart = -numeric_limits<double>::infinity();
+    m_activeEnd = numeric_limits<double>::infinity();
+    for (const auto &child : children)
+    {
+        if (child->includes(t))
+        {
+            m_activeChildren.push_back(child.get());
+            m_activeStart = max(m_activeStart, child->startTime());
+            m_activeEnd = min(m_activeEnd, child->endTime());
+        }
+        else if (t < child->startTime())
+        {
+            m_activeEnd = min(m_activeEnd, child->startTime());
+        }
+        else
+        {
+            m_activeStart = max(m_activeStart, child->endTime());
+        }
+    }
+
+    return m_activeChildren;
+}
+
+
+/*! Get clusters of the children active at time t, or nullptr if the tree
+ *  is too small to benefit from them. Each cluster's sphere contains its
+ *  children and their subtrees for as long as the clusters are kept, so
+ *  they are only rebuilt every so often rather than on every frame.
+ *  Children whose orbits have no known speed limit, or whose frames
+ *  rotate, go into a cluster that isn't bounded.
+ */
+const std::vector<FrameTreeCluster>*
+FrameTree::childClusters(double t) const
+{
+    // The radii of the children are only up to date after the bounding
+    // sphere has been recomputed.
+    const std::vector<const TimelinePhase*>& active = activeChildren(t);
+    if (active.size() < MinClusteredChildren || m_changed)
+        return nullptr;
+
+    if (m_clusterStart <= t && t < m_clusterEnd)
+        return &m_clusters;
+
+    m_clusters.clear();
+
+    FrameTreeCluster unbounded;
+    unbounded.bounded = false;
+
+    std::vector<ClusterChild> bounded;
+    std::vector<double> speeds;
+    bounded.reserve(active.size());
+    speeds.reserve(active.size());
+    double maxSpeed = 0.0;
+    for (unsigned int i = 0; i < active.size(); i++)
+    {
+        const TimelinePhase* phase = active[i];
+        double speed = 0.0;
+        if (!phase->orbitFrame()->isInertial() || !phase->orbit()->getMaximumSpeed(speed))
+        {
+            unbounded.children.push_back(i);
+            continue;
+        }
+
+        const Body* body = phase->body();
+        double radius = body->getCullingRadius();
+        if (const FrameTree* tree = body->getFrameTree(); tree != nullptr)
+            radius += tree->boundingSphereRadius();
+
+        Eigen::Vector3d position = phase->orbitFrame()->getOrientation(t).conjugate() * phase->orbit()->positionAtTime(t);
+        bounded.push_back(ClusterChild{ i, position, radius });
+        speeds.push_back(speed);
+        maxSpeed = max(maxSpeed, speed);
+    }
+
+    double lifetime = MaxClusterLifetime;
+    if (maxSpeed > 0.0)
+        lifetime = clamp(ClusterDriftFraction * m_boundingSphereRadius / maxSpeed, MinClusterLifetime, MaxClusterLifetime);
+
+    m_clusterStart = max(t - lifetime, m_activeStart);
+    m_clusterEnd = min(t + lifetime, m_activeEnd);
+    double drift = max(t - m_clusterStart, m_clusterEnd - t);
+    for (std::size_t i = 0; i < bounded.size(); i++)
+        bounded[i].radius += speeds[i] * drift;
+
+    std::vector<std::pair<std::size_t, std::size_t>> ranges;
+    splitClusters(bounded.begin(), bounded.end(), ranges, 0);
+    m_clusters.reserve(ranges.size() + 1);
+    for (const auto& [first, count] : ranges)
+    {
+        Eigen::AlignedBox3d box;
+        for (std::size_t i = first; i < first + count; i++)
+            box.extend(bounded[i].position);
+
+        FrameTreeCluster& cluster = m_clusters.emplace_back();
+        cluster.center = box.center();
+        cluster.children.reserve(count);
+        for (std::size_t i = first; i < first + count; i++)
+        {
+            const ClusterChild& child = bounded[i];
+            const Body* body = active[child.index]->body();
+            cluster.radius = max(cluster.radius, (child.position - cluster.center).norm() + child.radius);
+            cluster.maxChildRadius = max(cluster.maxChildRadius, (double) body->getCullingRadius());
+            cluster.orbitClassMask |= body->getOrbitClassification();
+            cluster.containsSecondaryIlluminators = cluster.containsSecondaryIlluminators || body->isSecondaryIlluminator();
+            if (const FrameTree* tree = body->getFrameTree(); tree != nullptr)
+            {
+                cluster.maxChildRadius = max(cluster.maxChildRadius, tree->maxChildRadius());
+                cluster.containsSecondaryIlluminators = cluster.containsSecondaryIlluminators || tree->containsSecondaryIlluminators();
+            }
+            cluster.children.push_back(child.index);
+        }
+    }
+
+    if (!unbounded.children.empty())
+        m_clusters.push_back(std::move(unbounded));
+
+    return &m_clusters;
+}
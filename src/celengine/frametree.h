@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <limits>
 #include <memory>
 #include <vector>
 #include <cstddef>
@@ -21,6 +22,26 @@
 
 class Star;
 
+/*! A group of nearby children of a frame tree, with a sphere containing
+ *  them and their subtrees over an interval of time. Clusters let the
+ *  renderer cull large systems without visiting every child.
+ */
+struct FrameTreeCluster
+{
+    // Center relative to the center of the frame tree
+    Eigen::Vector3d center{ Eigen::Vector3d::Zero() };
+    double radius{ 0.0 };
+    // Largest culling radius of the children and their subtrees
+    double maxChildRadius{ 0.0 };
+    BodyClassification orbitClassMask{ BodyClassification::EmptyMask };
+    bool containsSecondaryIlluminators{ false };
+    // False for the cluster of children whose motion can't be bounded,
+    // which must always be visited
+    bool bounded{ true };
+    // Indices into FrameTree::activeChildren()
+    std::vector<unsigned int> children;
+};
+
 class FrameTree
 {
 public:
@@ -42,6 +63,8 @@ public:
     void removeChild(const TimelinePhase::SharedConstPtr &phase);
     const TimelinePhase* getChild(unsigned int n) const;
     unsigned int childCount() const;
+    const std::vector<const TimelinePhase*>& activeChildren(double t) const;
+    const std::vector<FrameTreeCluster>* childClusters(double t) const;
 
     void markChanged();
     void markUpdated();
@@ -99,5 +122,17 @@ private:
     bool m_changed{ false };
     BodyClassification m_childClassMask{ BodyClassification::EmptyMask };
 
+    // Children active over [m_activeStart, m_activeEnd), an interval during
+    // which none of the children's phases begin or end. The initial empty
+    // interval forces the list to be built on first use.
+    mutable std::vector<const TimelinePhase*> m_activeChildren;
+    mutable double m_activeStart{ std::numeric_limits<double>::infinity() };
+    mutable double m_activeEnd{ -std::numeric_limits<double>::infinity() };
+
+    // Clusters of the active children, valid over [m_clusterStart, m_clusterEnd)
+    mutable std::vector<FrameTreeCluster> m_clusters;
+    mutable double m_clusterStart{ std::numeric_limits<double>::infinity() };
+    mutable double m_clusterEnd{ -std::numeric_limits<double>::infinity() };
+
     ReferenceFrame::SharedConstPtr defaultFrame;
 };
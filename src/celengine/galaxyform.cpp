@@ -8,47 +8,213 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
 #include <memory>
+#include <random>
+#include <string_view>
+#include <system_error>
 
 #include <celimage/image.h>
 #include <celmath/randutils.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
 #include <celutil/logger.h>
+#include <celutil/mappedfile.h>
 #include "render.h"
 #include "texture.h"
 #include "galaxy.h"
 #include "galaxyform.h"
 
+using namespace std::string_view_literals;
+
 namespace celestia::engine
 {
 namespace
 {
 constexpr unsigned int kIrrGalaxyPoints = 3500u;
 
-std::optional<celestia::engine::GalacticForm>
-buildGalacticForm(const fs::path& filename)
+// Blob clouds built from a template image are cached in a file next to the
+// template. The cache is only used if it was built from a template with the
+// same modification time, size and contents, and by the same version of
+// buildBlobs(); bump kBlobCacheVersion whenever the generated points change.
+constexpr std::string_view kBlobCacheMagic = "CELGXYBL"sv;
+constexpr std::uint16_t kBlobCacheVersion = 1;
+constexpr std::uint16_t kBlobCacheSpherical = 0x1;
+
+#pragma pack(push, 1)
+struct BlobCacheHeader
+{
+    char          magic[8]; //NOSONAR
+    std::uint16_t version;
+    std::uint16_t flags;
+    std::uint32_t nBlobs;
+    std::int64_t  templateTime;
+    std::uint64_t templateSize;
+    std::uint64_t templateHash;
+};
+
+struct BlobCacheRecord
+{
+    float         x;
+    float         y;
+    float         z;
+    std::uint8_t  colorIndex;
+    std::uint8_t  brightness;
+};
+#pragma pack(pop)
+
+static_assert(std::is_standard_layout_v<BlobCacheHeader>);
+static_assert(std::is_standard_layout_v<BlobCacheRecord>);
+
+// Identifies the template image a cached blob cloud was built from
+struct TemplateKey
+{
+    std::int64_t  time{ 0 };
+    std::uint64_t size{ 0 };
+    std::uint64_t hash{ 0 };
+};
+
+std::optional<TemplateKey>
+getTemplateKey(const fs::path& filename)
+{
+    std::error_code ec;
+    auto time = fs::last_write_time(filename, ec);
+    if (ec)
+        return std::nullopt;
+
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return std::nullopt;
+
+    // 64-bit FNV-1a over the file contents
+    TemplateKey key;
+    key.time = static_cast<std::int64_t>(time.time_since_epoch().count());
+    key.hash = UINT64_C(0xcbf29ce484222325);
+    for (auto it = std::istreambuf_iterator<char>(in); it != std::istreambuf_iterator<char>(); ++it)
+    {
+        key.hash = (key.hash ^ static_cast<std::uint8_t>(*it)) * UINT64_C(0x100000001b3);
+        ++key.size;
+    }
+
+    return key;
+}
+
+fs::path
+getBlobCachePath(const fs::path& filename)
+{
+    fs::path cachePath = filename;
+    cachePath += ".blobs";
+    return cachePath;
+}
+
+std::optional<GalacticForm::BlobVector>
+loadBlobCache(const fs::path& cachePath, const TemplateKey& key, std::uint16_t flags)
+{
+    auto file = util::MappedFile::open(cachePath);
+    if (file == nullptr || file->size() < sizeof(BlobCacheHeader))
+        return std::nullopt;
+
+    const char* data = file->data();
+    if (std::memcmp(data, kBlobCacheMagic.data(), kBlobCacheMagic.size()) != 0 ||
+        util::fromMemoryLE<std::uint16_t>(data + offsetof(BlobCacheHeader, version)) != kBlobCacheVersion ||
+        util::fromMemoryLE<std::uint16_t>(data + offsetof(BlobCacheHeader, flags)) != flags ||
+        util::fromMemoryLE<std::int64_t>(data + offsetof(BlobCacheHeader, templateTime)) != key.time ||
+        util::fromMemoryLE<std::uint64_t>(data + offsetof(BlobCacheHeader, templateSize)) != key.size ||
+        util::fromMemoryLE<std::uint64_t>(data + offsetof(BlobCacheHeader, templateHash)) != key.hash)
+    {
+        return std::nullopt;
+    }
+
+    auto nBlobs = util::fromMemoryLE<std::uint32_t>(data + offsetof(BlobCacheHeader, nBlobs));
+    if ((file->size() - sizeof(BlobCacheHeader)) / sizeof(BlobCacheRecord) != nBlobs)
+        return std::nullopt;
+
+    GalacticForm::BlobVector blobs(nBlobs);
+    const char* ptr = data + sizeof(BlobCacheHeader);
+    for (GalacticForm::Blob& blob : blobs)
+    {
+        blob.position = Eigen::Vector3f(util::fromMemoryLE<float>(ptr + offsetof(BlobCacheRecord, x)),
+                                        util::fromMemoryLE<float>(ptr + offsetof(BlobCacheRecord, y)),
+                                        util::fromMemoryLE<float>(ptr + offsetof(BlobCacheRecord, z)));
+        blob.colorIndex = static_cast<std::uint8_t>(ptr[offsetof(BlobCacheRecord, colorIndex)]);
+        blob.brightness = static_cast<std::uint8_t>(ptr[offsetof(BlobCacheRecord, brightness)]);
+        ptr += sizeof(BlobCacheRecord);
+    }
+
+    return blobs;
+}
+
+bool
+writeBlobCache(const fs::path& cachePath,
+               const TemplateKey& key,
+               std::uint16_t flags,
+               const GalacticForm::BlobVector& blobs)
+{
+    // Write to a temporary file first so that a concurrent reader never
+    // sees a partial cache.
+    fs::path tempPath = cachePath;
+    tempPath += ".tmp";
+
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.good())
+            return false;
+
+        out.write(kBlobCacheMagic.data(), kBlobCacheMagic.size());
+        bool ok = util::writeLE<std::uint16_t>(out, kBlobCacheVersion) &&
+                  util::writeLE<std::uint16_t>(out, flags) &&
+                  util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(blobs.size())) &&
+                  util::writeLE<std::int64_t>(out, key.time) &&
+                  util::writeLE<std::uint64_t>(out, key.size) &&
+                  util::writeLE<std::uint64_t>(out, key.hash);
+
+        for (auto it = blobs.begin(); ok && it != blobs.end(); ++it)
+        {
+            ok = util::writeLE<float>(out, it->position.x()) &&
+                 util::writeLE<float>(out, it->position.y()) &&
+                 util::writeLE<float>(out, it->position.z()) &&
+                 util::writeLE<std::uint8_t>(out, it->colorIndex) &&
+                 util::writeLE<std::uint8_t>(out, it->brightness);
+        }
+
+        if (!ok || !out.flush().good())
+            return false;
+    }
+
+    std::error_code ec;
+    fs::rename(tempPath, cachePath, ec);
+    if (ec)
+    {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    return true;
+}
+
+GalacticForm::BlobVector
+buildBlobs(const Image& image, bool spherical)
 {
     GalacticForm::Blob b;
     GalacticForm::BlobVector galacticPoints;
 
-    // Load templates in standard .png format
     int kmin = 9;
     float h = 0.75f;
-    std::unique_ptr<Image> img = Image::load(filename);
-    if (img == nullptr)
-    {
-        celestia::util::GetLogger()->error("The galaxy template *** {} *** could not be loaded!\n", filename);
-        return std::nullopt;
-    }
-    int width  = img->getWidth();
-    int height = img->getHeight();
-    int rgb    = img->getComponents();
+    int width  = image.getWidth();
+    int height = image.getHeight();
+    int rgb    = image.getComponents();
 
-    auto& rng = math::getRNG();
-    rng.seed(1312);
+    // A private generator keeps the result independent of whether other
+    // forms were loaded from the cache.
+    std::mt19937 rng(1312);
     for (int i = 0; i < width * height; i++)
     {
-        std::uint8_t value = img->getPixels()[rgb * i];
+        std::uint8_t value = image.getPixels()[rgb * i];
         if (value > 10)
         {
             auto idxf = static_cast<float>(i);
@@ -62,7 +228,7 @@ buildGalacticForm(const fs::path& filename)
             float r2 = x * x + z * z;
 
             float y;
-            if (filename != "models/E0.png")
+            if (!spherical)
             {
                 float y0 = 0.5f * Galaxy::kMaxSpiralThickness * std::sqrt(static_cast<float>(value)/256.0f) * std::exp(- 5.0f * r2);
                 float B = (r2 > 0.35f) ? 1.0f: 0.75f; // the darkness of the "dust lane", 0 < B < 1
@@ -106,12 +272,47 @@ buildGalacticForm(const fs::path& filename)
 
     // reshuffle the galaxy points randomly...except the first kmin+1 in the center!
     // the higher that number the stronger the central "glow"
-    std::shuffle(galacticPoints.begin() + kmin, galacticPoints.end(), math::getRNG());
+    std::shuffle(galacticPoints.begin() + kmin, galacticPoints.end(), rng);
+
+    return galacticPoints;
+}
+
+std::optional<celestia::engine::GalacticForm>
+buildGalacticForm(const fs::path& filename)
+{
+    // The elliptical template generates a spherically symmetric cloud
+    bool spherical = filename == "models/E0.png";
+    std::uint16_t flags = spherical ? kBlobCacheSpherical : 0;
 
     std::optional<celestia::engine::GalacticForm> galacticForm(std::in_place);
-    galacticForm->blobs = std::move(galacticPoints);
     galacticForm->scale = Eigen::Vector3f::Ones();
 
+    auto key = getTemplateKey(filename);
+    fs::path cachePath = getBlobCachePath(filename);
+    if (key.has_value())
+    {
+        if (auto blobs = loadBlobCache(cachePath, *key, flags); blobs.has_value())
+        {
+            galacticForm->blobs = std::move(*blobs);
+            return galacticForm;
+        }
+    }
+
+    // Load templates in standard .png format
+    std::unique_ptr<Image> img = Image::load(filename);
+    if (img == nullptr)
+    {
+        celestia::util::GetLogger()->error("The galaxy template *** {} *** could not be loaded!\n", filename);
+        return std::nullopt;
+    }
+
+    galacticForm->blobs = buildBlobs(*img, spherical);
+
+    // The template directory may well be read-only, in which case the
+    // cloud is simply built again on the next start.
+    if (key.has_value() && !writeBlobCache(cachePath, *key, flags, galacticForm->blobs))
+        celestia::util::GetLogger()->debug("Could not write galaxy template cache {}\n", cachePath);
+
     return galacticForm;
 }
 
@@ -203,13 +404,14 @@ GalacticFormManager::initializeStandardForms()
     // To save space: generate spherical E0 template from S0 disk
     // via rescaling by (1.0f, 3.8f, 1.0f).
 
+    auto e0Form = buildGalacticForm("models/E0.png");
     for (unsigned int eform = 0; eform <= 7; ++eform)
     {
         float ell = 1.0f - static_cast<float>(eform) / 8.0f;
 
         // note the correct x,y-alignment of 'ell' scaling!!
         // build all elliptical templates from rescaling E0
-        auto ellipticalForm = buildGalacticForm("models/E0.png");
+        auto ellipticalForm = e0Form;
         if (ellipticalForm.has_value())
         {
             ellipticalForm->scale = Eigen::Vector3f(ell, ell, 1.0f);
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <cstddef>
+
 #include <Eigen/Geometry>
 
 #include <celmodel/material.h>
@@ -47,6 +49,22 @@ public:
         return false;
     }
 
+    /*! Return true if several copies of the geometry can be drawn at once
+     *  by passing instances to the render context.
+     */
+    virtual bool supportsInstancing() const
+    {
+        return false;
+    }
+
+    /*! Return the estimated memory taken by the geometry, in bytes,
+     *  not counting textures.
+     */
+    virtual std::size_t getMemorySize() const
+    {
+        return 0;
+    }
+
     /*! Load all textures used by the model. */
     virtual void loadTextures()
     {
@@ -10,6 +10,7 @@
 
 #include <array>
 #include <cstddef>
+#include <optional>
 
 #include <celcompat/numbers.h>
 #include <celmath/frustum.h>
@@ -18,8 +19,10 @@
 #include <celrender/gl/buffer.h>
 #include <celrender/gl/vertexobject.h>
 #include <celrender/linerenderer.h>
+#include "glsupport.h"
 #include "marker.h"
 #include "render.h"
+#include "shadermanager.h"
 
 
 using namespace celestia;
@@ -51,6 +54,67 @@ initialize(LineRenderer &lr, gl::VertexObject &vo, gl::Buffer &bo)
         lr.addVertex(HollowMarkersData[i], HollowMarkersData[i+1]);
 }
 
+struct MarkerRange
+{
+    bool filled;
+    gl::VertexObject::Primitive primitive;
+    int count;
+    int first;
+};
+
+// Vertex ranges of the symbols in FilledMarkersData and HollowMarkersData,
+// the same as those drawn by RenderFilledMarker and RenderHollowMarker
+constexpr std::array<MarkerRange, 14> MarkerRanges
+{
+    MarkerRange{ true,  gl::VertexObject::Primitive::TriangleFan,  4,   0 }, // FilledSquare
+    MarkerRange{ true,  gl::VertexObject::Primitive::Triangles,    9,   4 }, // RightArrow
+    MarkerRange{ true,  gl::VertexObject::Primitive::Triangles,    9,  13 }, // LeftArrow
+    MarkerRange{ true,  gl::VertexObject::Primitive::Triangles,    9,  22 }, // UpArrow
+    MarkerRange{ true,  gl::VertexObject::Primitive::Triangles,    9,  31 }, // DownArrow
+    MarkerRange{ true,  gl::VertexObject::Primitive::TriangleFan, 10,  46 }, // Disk
+    MarkerRange{ true,  gl::VertexObject::Primitive::TriangleFan, 60,  56 }, // LargeDisk
+    MarkerRange{ false, gl::VertexObject::Primitive::Lines,        8,   0 }, // Square
+    MarkerRange{ false, gl::VertexObject::Primitive::Lines,        6,   8 }, // Triangle
+    MarkerRange{ false, gl::VertexObject::Primitive::Lines,        8,  14 }, // Diamond
+    MarkerRange{ false, gl::VertexObject::Primitive::Lines,        4,  22 }, // Plus
+    MarkerRange{ false, gl::VertexObject::Primitive::Lines,        4,  26 }, // X
+    MarkerRange{ false, gl::VertexObject::Primitive::Lines,       20,  30 }, // Circle
+    MarkerRange{ false, gl::VertexObject::Primitive::Lines,      120,  50 }, // LargeCircle
+};
+
+std::optional<std::size_t>
+markerRangeIndex(MarkerRepresentation::Symbol symbol, float size)
+{
+    // TODO: the size above which the finer outlines are used should be
+    // configurable, see markers.inc
+    bool large = size > 40.0f;
+    switch (symbol)
+    {
+    case MarkerRepresentation::FilledSquare: return 0;
+    case MarkerRepresentation::RightArrow:   return 1;
+    case MarkerRepresentation::LeftArrow:    return 2;
+    case MarkerRepresentation::UpArrow:      return 3;
+    case MarkerRepresentation::DownArrow:    return 4;
+    case MarkerRepresentation::Disk:         return large ? 6 : 5;
+    case MarkerRepresentation::Square:       return 7;
+    case MarkerRepresentation::Triangle:     return 8;
+    case MarkerRepresentation::Diamond:      return 9;
+    case MarkerRepresentation::Plus:         return 10;
+    case MarkerRepresentation::X:            return 11;
+    case MarkerRepresentation::Circle:       return large ? 13 : 12;
+    default:                                 return std::nullopt;
+    }
+}
+
+float
+markerLineWidth(const Renderer &renderer)
+{
+    float width = renderer.getScaleFactor();
+    if ((renderer.getRenderFlags() & Renderer::ShowSmoothLines) != 0)
+        width *= 1.5f;
+    return width;
+}
+
 }
 
 void
@@ -93,6 +157,109 @@ Renderer::renderMarker(MarkerRepresentation::Symbol symbol,
     }
 }
 
+/*! Queue a marker symbol to be drawn by the next renderQueuedMarkers()
+ *  call, all markers with the same symbol in one instanced draw call.
+ *  position is in the pixel coordinates of the annotation projection, with
+ *  the normalized device depth as z. Returns false without queueing the
+ *  marker if the symbol has to be drawn by renderMarker().
+ */
+bool
+Renderer::queueMarker(MarkerRepresentation::Symbol symbol,
+                      float size,
+                      const Color &color,
+                      const Eigen::Vector3f &position)
+{
+#ifdef GL_ES
+    if (!gl::checkVersion(gl::GLES_3_2))
+        return false;
+#else
+    if (!gl::checkVersion(gl::GL_3_2) || !gl::hasInstancedArrays())
+        return false;
+#endif
+
+    auto rangeIndex = markerRangeIndex(symbol, size);
+    if (!rangeIndex.has_value())
+        return false;
+
+    // Outlines too wide to rasterize are left to the line renderer
+    if (!MarkerRanges[*rangeIndex].filled && markerLineWidth(*this) > gl::maxLineWidth)
+        return false;
+
+    if (m_markerBatches.empty())
+        m_markerBatches.resize(MarkerRanges.size());
+
+    auto &instance = m_markerBatches[*rangeIndex].emplace_back();
+    instance.position = position;
+    instance.scale = size / 2.0f * getScaleFactor();
+    instance.color = color.toVector4();
+    return true;
+}
+
+void
+Renderer::renderQueuedMarkers(const Matrices &m)
+{
+    if (m_markerBatches.empty())
+        return;
+
+    auto *prog = shaderManager->getShaderGL3("marker150");
+    if (prog == nullptr)
+    {
+        for (auto &batch : m_markerBatches)
+            batch.clear();
+        return;
+    }
+
+    if (m_markerInstanceBO == nullptr)
+    {
+        if (!m_markerDataInitialized)
+        {
+            initialize(*m_hollowMarkerRenderer, *m_markerVO, *m_markerBO);
+            m_markerDataInitialized = true;
+        }
+
+        m_markerInstanceBO = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array);
+        m_hollowMarkerBO = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array, HollowMarkersData);
+        m_filledMarkerInstanceVO = std::make_unique<gl::VertexObject>();
+        m_hollowMarkerInstanceVO = std::make_unique<gl::VertexObject>();
+
+        for (auto [vo, bo] : { std::pair(m_filledMarkerInstanceVO.get(), m_markerBO.get()),
+                               std::pair(m_hollowMarkerInstanceVO.get(), m_hollowMarkerBO.get()) })
+        {
+            vo->addVertexBuffer(
+                *bo, CelestiaGLProgram::VertexCoordAttributeIndex, 2, gl::VertexObject::DataType::Float);
+            vo->addVertexBuffer(
+                *m_markerInstanceBO, prog->attribIndex("in_Center"), 3, gl::VertexObject::DataType::Float,
+                false, sizeof(MarkerInstance), offsetof(MarkerInstance, position), 1);
+            vo->addVertexBuffer(
+                *m_markerInstanceBO, prog->attribIndex("in_Scale"), 1, gl::VertexObject::DataType::Float,
+                false, sizeof(MarkerInstance), offsetof(MarkerInstance, scale), 1);
+            vo->addVertexBuffer(
+                *m_markerInstanceBO, prog->attribIndex("in_Color"), 4, gl::VertexObject::DataType::Float,
+                false, sizeof(MarkerInstance), offsetof(MarkerInstance, color), 1);
+        }
+    }
+
+    prog->use();
+    prog->setMVPMatrices(*m.projection, *m.modelview);
+    glLineWidth(markerLineWidth(*this));
+
+    for (std::size_t i = 0; i < MarkerRanges.size(); ++i)
+    {
+        auto &batch = m_markerBatches[i];
+        if (batch.empty())
+            continue;
+
+        // Respecifying the whole buffer lets the driver orphan the storage
+        // still in use by the previous batch
+        m_markerInstanceBO->setData(batch, gl::Buffer::BufferUsage::StreamDraw);
+
+        const MarkerRange &range = MarkerRanges[i];
+        auto &vo = range.filled ? *m_filledMarkerInstanceVO : *m_hollowMarkerInstanceVO;
+        vo.drawInstanced(range.primitive, range.count, static_cast<int>(batch.size()), range.first);
+        batch.clear();
+    }
+}
+
 /*! Draw an arrow at the view border pointing to an offscreen selection. This method
  *  should only be called when the selection lies outside the view frustum.
  */
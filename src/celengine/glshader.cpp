@@ -7,6 +7,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <celrender/gl/binder.h>
 #include <celutil/logger.h>
 #include "glshader.h"
 
@@ -76,7 +77,7 @@ GLShader::getID() const
 
 
 GLShaderStatus
-GLShader::compile(const std::vector<std::string>& source)
+GLShader::compile(const std::vector<std::string>& source, bool checkStatus)
 {
     if (source.empty())
         return GLShaderStatus::EmptyProgram;
@@ -92,6 +93,8 @@ GLShader::compile(const std::vector<std::string>& source)
 
     // Actually compile the shader
     glCompileShader(id);
+    if (!checkStatus)
+        return GLShaderStatus::OK;
 
     GLint compileSuccess;
     glGetShaderiv(id, GL_COMPILE_STATUS, &compileSuccess);
@@ -219,6 +222,7 @@ GLProgram::GLProgram(GLuint _id) :
 
 GLProgram::~GLProgram()
 {
+    celestia::gl::Binder::get().forget(id);
     glDeleteProgram(id);
 }
 
@@ -226,7 +230,7 @@ GLProgram::~GLProgram()
 void
 GLProgram::use() const
 {
-    glUseProgram(id);
+    celestia::gl::Binder::get().use(id);
 }
 
 
@@ -239,9 +243,34 @@ GLProgram::attach(const GLShader& shader)
 
 GLShaderStatus
 GLProgram::link()
+{
+    startLink();
+    return getLinkStatus();
+}
+
+
+void
+GLProgram::startLink()
 {
     glLinkProgram(id);
+}
+
+
+bool
+GLProgram::isLinkComplete() const
+{
+    if (!celestia::gl::KHR_parallel_shader_compile)
+        return true;
+
+    GLint complete = GL_FALSE;
+    glGetProgramiv(id, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
 
+
+GLShaderStatus
+GLProgram::getLinkStatus() const
+{
     GLint linkSuccess;
     glGetProgramiv(id, GL_LINK_STATUS, &linkSuccess);
     if (linkSuccess != GL_TRUE)
@@ -506,3 +535,49 @@ GLShaderLoader::CreateProgram(const std::string& vsSource,
 
     return CreateProgram(vsSourceVec, gsSourceVec, fsSourceVec, progOut);
 }
+
+
+GLShaderStatus
+GLShaderLoader::CreateDeferredProgram(const std::string& vsSource,
+                                      const std::string& fsSource,
+                                      GLProgram** progOut)
+{
+    GLVertexShader vs(glCreateShader(GL_VERTEX_SHADER));
+    GLFragmentShader fs(glCreateShader(GL_FRAGMENT_SHADER));
+    vs.compile({ vsSource }, false);
+    fs.compile({ fsSource }, false);
+
+    auto* prog = new GLProgram(glCreateProgram());
+
+    // The shaders stay alive as long as they're attached
+    prog->attach(vs);
+    prog->attach(fs);
+
+    *progOut = prog;
+
+    return GLShaderStatus::OK;
+}
+
+
+GLShaderStatus
+GLShaderLoader::CreateProgram(GLenum binaryFormat,
+                              const void* binary,
+                              GLsizei length,
+                              GLProgram** progOut)
+{
+    GLuint progid = glCreateProgram();
+    glProgramBinary(progid, binaryFormat, binary, length);
+
+    // Drivers reject binaries they can't use, e.g. after an update
+    GLint linkSuccess;
+    glGetProgramiv(progid, GL_LINK_STATUS, &linkSuccess);
+    if (linkSuccess != GL_TRUE)
+    {
+        glDeleteProgram(progid);
+        return GLShaderStatus::LinkError;
+    }
+
+    *progOut = new GLProgram(progid);
+
+    return GLShaderStatus::OK;
+}
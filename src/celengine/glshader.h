@@ -40,7 +40,7 @@ class GLShader
  private:
     GLuint id;
 
-    GLShaderStatus compile(const std::vector<std::string>& source);
+    GLShaderStatus compile(const std::vector<std::string>& source, bool checkStatus = true);
 
     friend class GLShaderLoader;
 };
@@ -85,6 +85,13 @@ class GLProgram
 
     GLShaderStatus link();
 
+    // Split link() for programs built in the background: startLink() returns
+    // immediately, and with GL_KHR_parallel_shader_compile isLinkComplete()
+    // tells when getLinkStatus() can be called without blocking
+    void startLink();
+    bool isLinkComplete() const;
+    GLShaderStatus getLinkStatus() const;
+
     void use() const;
     GLuint getID() const { return id; }
 
@@ -222,6 +229,16 @@ class GLShaderLoader
                                         const std::string& fsSource,
                                         const std::string& gsSource,
                                         GLProgram**);
+    // Like CreateProgram, but doesn't wait for the shaders to compile.
+    // Compile errors are reported by GLProgram::getLinkStatus().
+    static GLShaderStatus CreateDeferredProgram(const std::string& vsSource,
+                                                const std::string& fsSource,
+                                                GLProgram**);
+    // Create a program from a binary retrieved with glGetProgramBinary
+    static GLShaderStatus CreateProgram(GLenum binaryFormat,
+                                        const void* binary,
+                                        GLsizei length,
+                                        GLProgram**);
 };
 
 
@@ -14,11 +14,19 @@ CELAPI bool OES_geometry_shader            = false;
 #else
 CELAPI bool ARB_vertex_array_object        = false;
 CELAPI bool ARB_framebuffer_object         = false;
+CELAPI bool ARB_instanced_arrays           = false;
+CELAPI bool ARB_timer_query                = false;
+CELAPI bool ARB_buffer_storage             = false;
+CELAPI bool ARB_get_program_binary         = false;
+CELAPI bool ARB_ES3_compatibility          = false;
 #endif
 CELAPI bool ARB_shader_texture_lod         = false;
 CELAPI bool EXT_texture_compression_s3tc   = false;
+CELAPI bool ARB_texture_compression_bptc   = false;
+CELAPI bool KHR_texture_compression_astc_ldr = false;
 CELAPI bool EXT_texture_filter_anisotropic = false;
 CELAPI bool MESA_pack_invert               = false;
+CELAPI bool KHR_parallel_shader_compile    = false;
 CELAPI GLint maxPointSize                  = 0;
 CELAPI GLint maxTextureSize                = 0;
 CELAPI GLfloat maxLineWidth                = 0.0f;
@@ -83,6 +91,11 @@ bool init(util::array_view<std::string> ignore) noexcept
     OES_geometry_shader            = check_extension(ignore, "GL_OES_geometry_shader") || check_extension(ignore, "GL_EXT_geometry_shader");
 #else
     ARB_vertex_array_object        = check_extension(ignore, "GL_ARB_vertex_array_object");
+    ARB_instanced_arrays           = check_extension(ignore, "GL_ARB_instanced_arrays");
+    ARB_timer_query                = check_extension(ignore, "GL_ARB_timer_query");
+    ARB_buffer_storage             = check_extension(ignore, "GL_ARB_buffer_storage");
+    ARB_get_program_binary         = check_extension(ignore, "GL_ARB_get_program_binary");
+    ARB_ES3_compatibility          = check_extension(ignore, "GL_ARB_ES3_compatibility");
     if (!has_extension("GL_ARB_framebuffer_object"))
     {
         fmt::print(_("Mandatory extension GL_ARB_framebuffer_object is missing!\n"));
@@ -91,8 +104,11 @@ bool init(util::array_view<std::string> ignore) noexcept
 #endif
     ARB_shader_texture_lod         = check_extension(ignore, "GL_ARB_shader_texture_lod");
     EXT_texture_compression_s3tc   = check_extension(ignore, "GL_EXT_texture_compression_s3tc");
+    ARB_texture_compression_bptc   = check_extension(ignore, "GL_ARB_texture_compression_bptc") || check_extension(ignore, "GL_EXT_texture_compression_bptc");
+    KHR_texture_compression_astc_ldr = check_extension(ignore, "GL_KHR_texture_compression_astc_ldr");
     EXT_texture_filter_anisotropic = check_extension(ignore, "GL_EXT_texture_filter_anisotropic") || check_extension(ignore, "GL_ARB_texture_filter_anisotropic");
     MESA_pack_invert               = check_extension(ignore, "GL_MESA_pack_invert");
+    KHR_parallel_shader_compile    = check_extension(ignore, "GL_KHR_parallel_shader_compile");
 
     GLint pointSizeRange[2];
     GLfloat lineWidthRange[2];
@@ -111,6 +127,10 @@ bool init(util::array_view<std::string> ignore) noexcept
     if (gl::EXT_texture_filter_anisotropic)
         glGetIntegerv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxTextureAnisotropy);
 
+    // Let the driver pick the number of compiler threads
+    if (KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xffffffffU);
+
     enable_workarounds();
 
     return true;
@@ -133,6 +153,62 @@ bool hasGeomShader() noexcept
 #endif
 }
 
+bool hasInstancedArrays() noexcept
+{
+#ifdef GL_ES
+    return checkVersion(celestia::gl::GLES_3_0);
+#else
+    return checkVersion(celestia::gl::GL_3_3) || ARB_instanced_arrays;
+#endif
+}
+
+bool hasBufferStorage() noexcept
+{
+#ifdef GL_ES
+    return false;
+#else
+    // Persistent mappings are only safe to reuse with fences (GL 3.2)
+    return ARB_buffer_storage && checkVersion(celestia::gl::GL_3_2);
+#endif
+}
+
+bool hasProgramBinary() noexcept
+{
+#ifdef GL_ES
+    return checkVersion(celestia::gl::GLES_3_0);
+#else
+    return ARB_get_program_binary;
+#endif
+}
+
+// Half float and 2_10_10_10 vertex attributes
+bool hasPackedVertexFormats() noexcept
+{
+#ifdef GL_ES
+    return checkVersion(celestia::gl::GLES_3_0);
+#else
+    return checkVersion(celestia::gl::GL_3_3);
+#endif
+}
+
+bool hasBPTCCompression() noexcept
+{
+#ifdef GL_ES
+    return ARB_texture_compression_bptc;
+#else
+    return ARB_texture_compression_bptc || checkVersion(celestia::gl::GL_4_2);
+#endif
+}
+
+bool hasETC2Compression() noexcept
+{
+#ifdef GL_ES
+    return checkVersion(celestia::gl::GLES_3_0);
+#else
+    return ARB_ES3_compatibility || checkVersion(celestia::gl::GL_4_3);
+#endif
+}
+
 void enableGeomShaders() noexcept
 {
     EnableGeomShaders = true;
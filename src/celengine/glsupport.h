@@ -31,6 +31,8 @@ enum Version
     GL_3_1   = 31,
     GL_3_2   = 32,
     GL_3_3   = 33,
+    GL_4_2   = 42,
+    GL_4_3   = 43,
     GLES_2   = 20,
     GLES_2_0 = 20,
     GLES_3   = 30,
@@ -41,14 +43,22 @@ enum Version
 
 extern CELAPI bool ARB_shader_texture_lod; //NOSONAR
 extern CELAPI bool EXT_texture_compression_s3tc; //NOSONAR
+extern CELAPI bool ARB_texture_compression_bptc; //NOSONAR
+extern CELAPI bool KHR_texture_compression_astc_ldr; //NOSONAR
 extern CELAPI bool EXT_texture_filter_anisotropic; //NOSONAR
 extern CELAPI bool MESA_pack_invert; //NOSONAR
+extern CELAPI bool KHR_parallel_shader_compile; //NOSONAR
 #ifdef GL_ES
 extern CELAPI bool OES_vertex_array_object; //NOSONAR
 extern CELAPI bool OES_texture_border_clamp; //NOSONAR
 extern CELAPI bool OES_geometry_shader; //NOSONAR
 #else
 extern CELAPI bool ARB_vertex_array_object; //NOSONAR
+extern CELAPI bool ARB_instanced_arrays; //NOSONAR
+extern CELAPI bool ARB_timer_query; //NOSONAR
+extern CELAPI bool ARB_buffer_storage; //NOSONAR
+extern CELAPI bool ARB_get_program_binary; //NOSONAR
+extern CELAPI bool ARB_ES3_compatibility; //NOSONAR
 #endif
 extern CELAPI GLint maxPointSize; //NOSONAR
 extern CELAPI GLint maxTextureSize; //NOSONAR
@@ -58,6 +68,12 @@ extern CELAPI GLint maxTextureAnisotropy; //NOSONAR
 bool init(util::array_view<std::string> = {}) noexcept;
 bool checkVersion(int) noexcept;
 bool hasGeomShader() noexcept;
+bool hasInstancedArrays() noexcept;
+bool hasBufferStorage() noexcept;
+bool hasProgramBinary() noexcept;
+bool hasPackedVertexFormats() noexcept;
+bool hasBPTCCompression() noexcept;
+bool hasETC2Compression() noexcept;
 void enableGeomShaders() noexcept;
 void disableGeomShaders() noexcept;
 
@@ -8,6 +8,8 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+
 #include <celastro/units.h>
 #include <celmath/mathlib.h>
 #include <celutil/color.h>
@@ -25,19 +27,38 @@ AssociativeArray::~AssociativeArray() = default;
 
 const Value* AssociativeArray::getValue(std::string_view key) const
 {
-    auto iter = assoc.find(key);
-    if (iter == assoc.end())
+    auto iter = std::lower_bound(keys.begin(), keys.end(), key);
+    if (iter == keys.end() || *iter != key)
         return nullptr;
 
-    return &values[iter->second];
+    return &values[static_cast<std::size_t>(iter - keys.begin())];
 }
 
 
 void AssociativeArray::addValue(std::string&& key, Value&& val)
 {
-    std::size_t index = values.size();
-    if (assoc.try_emplace(std::move(key), index).second)
+    // The parser adds keys in sorted order, so appending is the usual case
+    if (keys.empty() || keys.back() < key)
+    {
+        keys.emplace_back(std::move(key));
         values.emplace_back(std::move(val));
+        return;
+    }
+
+    auto iter = std::lower_bound(keys.begin(), keys.end(), key);
+    if (*iter == key)
+        return;
+
+    auto index = iter - keys.begin();
+    keys.emplace(iter, std::move(key));
+    values.emplace(values.begin() + index, std::move(val));
+}
+
+
+void AssociativeArray::reserve(std::size_t count)
+{
+    keys.reserve(count);
+    values.reserve(count);
 }
 
 
@@ -12,7 +12,6 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <map>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -29,11 +28,12 @@
 class Color;
 class Value;
 
+// Keys and values are kept in two vectors sorted by key. Catalog hashes
+// hold a few dozen entries at most, so a binary search over contiguous
+// keys is faster to build and to query than a tree of nodes.
 class AssociativeArray
 {
  public:
-    using AssocType = std::map<std::string, std::size_t, std::less<>>;
-
     AssociativeArray() = default;
     ~AssociativeArray();
     AssociativeArray(AssociativeArray&&) = delete;
@@ -42,7 +42,9 @@ class AssociativeArray
     AssociativeArray& operator=(AssociativeArray&) = delete;
 
     const Value* getValue(std::string_view) const;
+    // If the key is already present the first value is kept
     void addValue(std::string&&, Value&&);
+    void reserve(std::size_t);
 
     template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
     std::optional<T> getNumber(std::string_view key) const
@@ -139,17 +141,17 @@ class AssociativeArray
     template<typename T>
     void for_all(T action) const
     {
-        for (const auto& [key, value] : assoc)
+        for (std::size_t i = 0; i < keys.size(); ++i)
         {
-            action(key, values[value]);
+            action(keys[i], values[i]);
         }
     }
 
  private:
     // At this point, Value is an incomplete type. C++17 allows us to store
-    // this in a vector but not a map, so use the map to store vector indices
+    // this in a vector but not in a pair, so keep keys and values apart
+    std::vector<std::string> keys;
     std::vector<Value> values;
-    AssocType assoc;
 
     std::optional<double> getNumberImpl(std::string_view) const;
     std::optional<Eigen::Vector3d> getVector3Impl(std::string_view) const;
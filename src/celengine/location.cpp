@@ -16,6 +16,7 @@
 
 #include <celengine/body.h>
 #include <celutil/gettext.h>
+#include <celutil/objectpool.h>
 
 // size_t and strncmp are used by the gperf output code
 using std::size_t;
@@ -27,8 +28,33 @@ namespace
 // lookup table generated by gperf (location.gperf)
 #include "location.inc"
 
+// Never destroyed, since locations may outlive other static objects
+celestia::util::ObjectPool<Location>&
+locationPool()
+{
+    static auto* pool = new celestia::util::ObjectPool<Location>();
+    return *pool;
+}
+
 } // end unnamed namespace
 
+void*
+Location::operator new(std::size_t size)
+{
+    if (size != sizeof(Location))
+        return ::operator new(size);
+    return locationPool().allocate();
+}
+
+void
+Location::operator delete(void* p, std::size_t size) noexcept
+{
+    if (size != sizeof(Location))
+        ::operator delete(p);
+    else
+        locationPool().deallocate(p);
+}
+
 const std::string&
 Location::getName(bool i18n) const
 {
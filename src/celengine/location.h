@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <string_view>
@@ -23,6 +24,11 @@ class StarDatabase;
 class Location
 {
 public:
+    // Planetary nomenclature files define tens of thousands of locations,
+    // so they are allocated from a pool rather than one by one
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size) noexcept;
+
     const std::string& getName(bool i18n = false) const;
     void setName(const std::string&);
 
@@ -37,6 +43,9 @@ public:
     float getImportance() const;
     void setImportance(float);
 
+    // Size used to decide whether the location is labeled
+    float getLabelSize() const { return importance < 0.0f ? size : importance; }
+
     const std::string& getInfoURL() const;
 
     bool isLabelColorOverridden() const { return overrideLabelColor; }
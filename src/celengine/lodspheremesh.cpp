@@ -23,10 +23,12 @@
 #include <celengine/texture.h>
 #include <celmath/frustum.h>
 #include <celmath/mathlib.h>
+#include <celrender/gl/binder.h>
 
 #define PTR(p) (reinterpret_cast<const void*>(static_cast<std::uintptr_t>(p)))
 
 namespace math = celestia::math;
+namespace gl = celestia::gl;
 
 namespace
 {
@@ -247,7 +249,7 @@ createVertices(std::vector<float>& vertices,
                int phi0, int phi1,
                int theta0, int theta1,
                int step,
-               const TextureCoords& tc)
+               bool hasTexCoords)
 {
     for (int phi = phi0; phi <= phi1; phi += step)
     {
@@ -271,7 +273,9 @@ createVertices(std::vector<float>& vertices,
                 vertices.push_back(-ctheta);
             }
 
-            if (tc.nTexturesUsed > 0)
+            // The texture coordinates are transformed in the shader, see
+            // texCoordTransforms, so they don't depend on the texture tiles
+            if (hasTexCoords)
             {
                 vertices.push_back(static_cast<float>(theta));
                 vertices.push_back(static_cast<float>(phi));
@@ -286,7 +290,8 @@ createVertices(std::vector<float>& vertices,
 
 LODSphereMesh::~LODSphereMesh()
 {
-    glDeleteBuffers(vertexBuffers.size(), vertexBuffers.data());
+    for (const auto& [key, buffer] : sectionBuffers)
+        glDeleteBuffers(1, &buffer.vbo);
     glDeleteBuffers(1, &indexBuffer);
 }
 
@@ -361,20 +366,7 @@ void LODSphereMesh::render(unsigned int attributes,
 
     // If one of the textures is split into subtextures, we may have to
     // use extra patches, since there can be at most one subtexture per patch.
-    int minSplit = 1;
-    for (int i = 0; i < nTextures; i++)
-    {
-        double pixelsPerTexel = pixWidth * 2.0f /
-            (static_cast<float>(tex[i]->getWidth()) / 2.0f);
-        double l = std::log2(pixelsPerTexel);
-
-        // replacing below with std::clamp will fail if l < 0
-        ri.texLOD[i] = std::max(std::min(tex[i]->getLODCount() - 1, static_cast<int>(l)), 0);
-        if (tex[i]->getUTileCount(ri.texLOD[i]) > minSplit)
-            minSplit = tex[i]->getUTileCount(ri.texLOD[i]);
-        if (tex[i]->getVTileCount(ri.texLOD[i]) > minSplit)
-            minSplit = tex[i]->getVTileCount(ri.texLOD[i]);
-    }
+    int minSplit = computeTextureLODs(pixWidth, tex, nTextures, ri);
 
     if (split < minSplit)
     {
@@ -393,75 +385,60 @@ void LODSphereMesh::render(unsigned int attributes,
         textures[i] = tex[i];
         subtextures[i] = 0;
         if (nTextures > 1)
-            glActiveTexture(GL_TEXTURE0 + i);
+            gl::Binder::get().activeTexture(i);
     }
 
-    if (!vertexBuffersInitialized)
+    if (indexBuffer == 0)
     {
         // TODO: assumes that the same context is used every time we
         // render.  Valid now, but not necessarily in the future.  Still,
         // would only cause problems if we rendered in two different contexts
         // and only one had vertex buffer objects.
         while(glGetError() != GL_NO_ERROR);
-        glGenBuffers(vertexBuffers.size(), vertexBuffers.data());
-        if (glGetError() != GL_NO_ERROR)
-            return;
-        vertexBuffersInitialized = true;
-        for (auto vertexBuffer : vertexBuffers)
-        {
-            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-            glBufferData(GL_ARRAY_BUFFER,
-                         maxVertices * MaxVertexSize * sizeof(float),
-                         nullptr,
-                         GL_STREAM_DRAW);
-        }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
         glGenBuffers(1, &indexBuffer);
         if (glGetError() != GL_NO_ERROR)
             return;
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                     nIndices * sizeof(unsigned short),
-                     nullptr,
-                     GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
 
-    currentVB = 0;
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[currentVB]);
+    ++renderCount;
 
-    // Set up the mesh vertices
+    // Set up the mesh indices, which are the same for every section
     int nRings = phiExtent / ri.step;
     int nSlices = thetaExtent / ri.step;
 
-    indices.clear();
-    int expectedIndices = 2 * (nRings * (nSlices + 1) + std::max(nRings - 1, 0));
-    indices.reserve(expectedIndices);
-    for (int i = 0; i < nRings; i++)
+    gl::Binder::get().bind(gl::Buffer::TargetHint::ElementArray, indexBuffer);
+    if (nRings != indexRings || nSlices != indexSlices)
     {
-        if (i > 0)
+        indices.clear();
+        int expectedIndices = 2 * (nRings * (nSlices + 1) + std::max(nRings - 1, 0));
+        assert(expectedIndices <= nIndices);
+        indices.reserve(expectedIndices);
+        for (int i = 0; i < nRings; i++)
         {
-            indices.push_back(static_cast<unsigned short>(i * (nSlices + 1) + 0));
-        }
-        for (int j = 0; j <= nSlices; j++)
-        {
-            indices.push_back(static_cast<unsigned short>(i * (nSlices + 1) + j));
-            indices.push_back(static_cast<unsigned short>((i + 1) * (nSlices + 1) + j));
-        }
-        if (i < nRings - 1)
-        {
-            indices.push_back(static_cast<unsigned short>((i + 1) * (nSlices + 1) + nSlices));
+            if (i > 0)
+            {
+                indices.push_back(static_cast<unsigned short>(i * (nSlices + 1) + 0));
+            }
+            for (int j = 0; j <= nSlices; j++)
+            {
+                indices.push_back(static_cast<unsigned short>(i * (nSlices + 1) + j));
+                indices.push_back(static_cast<unsigned short>((i + 1) * (nSlices + 1) + j));
+            }
+            if (i < nRings - 1)
+            {
+                indices.push_back(static_cast<unsigned short>((i + 1) * (nSlices + 1) + nSlices));
+            }
         }
-    }
 
-    assert(expectedIndices == indices.size());
+        assert(expectedIndices == indices.size());
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 indices.size() * sizeof(unsigned short),
-                 indices.data(),
-                 GL_DYNAMIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                     indices.size() * sizeof(unsigned short),
+                     indices.data(),
+                     GL_STATIC_DRAW);
+        indexRings = nRings;
+        indexSlices = nSlices;
+    }
 
     // Compute the size of a vertex
     vertexSize = 3;
@@ -489,33 +466,7 @@ void LODSphereMesh::render(unsigned int attributes,
     else
     {
         // Render the sphere section by section.
-        //
-        // Compute the vertices of the view frustum.  These will be used for
-        // culling patches.
-        ri.fp[0] = intersect3(frustum.plane(math::FrustumPlane::Near),
-                              frustum.plane(math::FrustumPlane::Top),
-                              frustum.plane(math::FrustumPlane::Left));
-        ri.fp[1] = intersect3(frustum.plane(math::FrustumPlane::Near),
-                              frustum.plane(math::FrustumPlane::Top),
-                              frustum.plane(math::FrustumPlane::Right));
-        ri.fp[2] = intersect3(frustum.plane(math::FrustumPlane::Near),
-                              frustum.plane(math::FrustumPlane::Bottom),
-                              frustum.plane(math::FrustumPlane::Left));
-        ri.fp[3] = intersect3(frustum.plane(math::FrustumPlane::Near),
-                              frustum.plane(math::FrustumPlane::Bottom),
-                              frustum.plane(math::FrustumPlane::Right));
-        ri.fp[4] = intersect3(frustum.plane(math::FrustumPlane::Far),
-                              frustum.plane(math::FrustumPlane::Top),
-                              frustum.plane(math::FrustumPlane::Left));
-        ri.fp[5] = intersect3(frustum.plane(math::FrustumPlane::Far),
-                              frustum.plane(math::FrustumPlane::Top),
-                              frustum.plane(math::FrustumPlane::Right));
-        ri.fp[6] = intersect3(frustum.plane(math::FrustumPlane::Far),
-                              frustum.plane(math::FrustumPlane::Bottom),
-                              frustum.plane(math::FrustumPlane::Left));
-        ri.fp[7] = intersect3(frustum.plane(math::FrustumPlane::Far),
-                              frustum.plane(math::FrustumPlane::Bottom),
-                              frustum.plane(math::FrustumPlane::Right));
+        computeFrustumPoints(ri);
 
         const int extent = maxDivisions / 2;
         for (int i = 0; i < 2; i++)
@@ -543,20 +494,171 @@ void LODSphereMesh::render(unsigned int attributes,
 
     if (nTextures > 1)
     {
-        glActiveTexture(GL_TEXTURE0);
+        gl::Binder::get().activeTexture(0);
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gl::Binder::get()
+        .unbind(gl::Buffer::TargetHint::Array)
+        .unbind(gl::Buffer::TargetHint::ElementArray);
+
+    trimSectionBuffers();
+}
+
+
+bool
+LODSphereMesh::bindSectionBuffer(int phi0, int theta0, int extent, const RenderInfo& ri)
+{
+    auto [it, inserted] = sectionBuffers.try_emplace(SectionKey{ phi0, theta0, extent, ri.step, vertexSize });
+    SectionBuffer& buffer = it->second;
+    buffer.lastUsed = renderCount;
+    if (!inserted)
+    {
+        gl::Binder::get().bind(gl::Buffer::TargetHint::Array, buffer.vbo);
+        return true;
+    }
+
+    glGenBuffers(1, &buffer.vbo);
+    if (buffer.vbo == 0)
+    {
+        sectionBuffers.erase(it);
+        return false;
+    }
+
+    int theta1 = theta0 + extent;
+    int phi1 = phi0 + extent / 2;
+
+    vertices.clear();
+    int expectedVertices = ((phi1 - phi0) / ri.step + 1) * ((theta1 - theta0) / ri.step + 1) * vertexSize;
+    assert(expectedVertices <= maxVertices * MaxVertexSize);
+    vertices.reserve(expectedVertices);
+    if ((ri.attributes & Tangents) == 0)
+        createVertices<false>(vertices, phi0, phi1, theta0, theta1, ri.step, nTexturesUsed > 0);
+    else
+        createVertices<true>(vertices, phi0, phi1, theta0, theta1, ri.step, nTexturesUsed > 0);
+
+    assert(expectedVertices == vertices.size());
+
+    buffer.size = vertices.size() * sizeof(float);
+    sectionBufferBytes += buffer.size;
+    gl::Binder::get().bind(gl::Buffer::TargetHint::Array, buffer.vbo);
+    glBufferData(GL_ARRAY_BUFFER, buffer.size, vertices.data(), GL_STATIC_DRAW);
+    return true;
 }
 
 
 void
-LODSphereMesh::renderPatches(int phi0, int theta0,
-                             int extent,
-                             int level,
-                             const RenderInfo& ri,
-                             CelestiaGLProgram *program)
+LODSphereMesh::trimSectionBuffers()
+{
+    if (sectionBufferBytes <= MAX_SECTION_BUFFER_BYTES)
+        return;
+
+    std::vector<decltype(sectionBuffers)::iterator> unused;
+    for (auto it = sectionBuffers.begin(); it != sectionBuffers.end(); ++it)
+    {
+        if (it->second.lastUsed != renderCount)
+            unused.push_back(it);
+    }
+
+    std::sort(unused.begin(), unused.end(),
+              [](const auto& it0, const auto& it1) { return it0->second.lastUsed < it1->second.lastUsed; });
+
+    for (auto it : unused)
+    {
+        if (sectionBufferBytes <= MAX_SECTION_BUFFER_BYTES)
+            break;
+
+        glDeleteBuffers(1, &it->second.vbo);
+        sectionBufferBytes -= it->second.size;
+        sectionBuffers.erase(it);
+    }
+}
+
+
+void
+LODSphereMesh::prefetch(const math::Frustum& frustum,
+                        float pixWidth,
+                        Texture** tex,
+                        int nTextures) const
+{
+    RenderInfo ri(minStep, 0, frustum);
+
+    // Leaf patches match the tiles of the texture with the most of them;
+    // a sphere drawn in one piece uses no tiles worth prefetching
+    int split = computeTextureLODs(pixWidth, tex, nTextures, ri);
+    if (split <= 1)
+        return;
+
+    computeFrustumPoints(ri);
+
+    const int extent = maxDivisions / 2;
+    for (int i = 0; i < 2; i++)
+    {
+        for (int j = 0; j < 2; j++)
+        {
+            prefetchPatches(i * extent / 2, j * extent,
+                            extent, split / 2, ri, tex, nTextures);
+        }
+    }
+}
+
+
+int
+LODSphereMesh::computeTextureLODs(float pixWidth, Texture** tex, int nTextures, RenderInfo& ri)
+{
+    int minSplit = 1;
+    for (int i = 0; i < nTextures; i++)
+    {
+        double pixelsPerTexel = pixWidth * 2.0f /
+            (static_cast<float>(tex[i]->getWidth()) / 2.0f);
+        double l = std::log2(pixelsPerTexel);
+
+        // replacing below with std::clamp will fail if l < 0
+        ri.texLOD[i] = std::max(std::min(tex[i]->getLODCount() - 1, static_cast<int>(l)), 0);
+        if (tex[i]->getUTileCount(ri.texLOD[i]) > minSplit)
+            minSplit = tex[i]->getUTileCount(ri.texLOD[i]);
+        if (tex[i]->getVTileCount(ri.texLOD[i]) > minSplit)
+            minSplit = tex[i]->getVTileCount(ri.texLOD[i]);
+    }
+
+    return minSplit;
+}
+
+
+// Compute the vertices of the view frustum. These are used for culling
+// patches.
+void
+LODSphereMesh::computeFrustumPoints(RenderInfo& ri)
+{
+    const math::Frustum& frustum = ri.frustum;
+    ri.fp[0] = intersect3(frustum.plane(math::FrustumPlane::Near),
+                          frustum.plane(math::FrustumPlane::Top),
+                          frustum.plane(math::FrustumPlane::Left));
+    ri.fp[1] = intersect3(frustum.plane(math::FrustumPlane::Near),
+                          frustum.plane(math::FrustumPlane::Top),
+                          frustum.plane(math::FrustumPlane::Right));
+    ri.fp[2] = intersect3(frustum.plane(math::FrustumPlane::Near),
+                          frustum.plane(math::FrustumPlane::Bottom),
+                          frustum.plane(math::FrustumPlane::Left));
+    ri.fp[3] = intersect3(frustum.plane(math::FrustumPlane::Near),
+                          frustum.plane(math::FrustumPlane::Bottom),
+                          frustum.plane(math::FrustumPlane::Right));
+    ri.fp[4] = intersect3(frustum.plane(math::FrustumPlane::Far),
+                          frustum.plane(math::FrustumPlane::Top),
+                          frustum.plane(math::FrustumPlane::Left));
+    ri.fp[5] = intersect3(frustum.plane(math::FrustumPlane::Far),
+                          frustum.plane(math::FrustumPlane::Top),
+                          frustum.plane(math::FrustumPlane::Right));
+    ri.fp[6] = intersect3(frustum.plane(math::FrustumPlane::Far),
+                          frustum.plane(math::FrustumPlane::Bottom),
+                          frustum.plane(math::FrustumPlane::Left));
+    ri.fp[7] = intersect3(frustum.plane(math::FrustumPlane::Far),
+                          frustum.plane(math::FrustumPlane::Bottom),
+                          frustum.plane(math::FrustumPlane::Right));
+}
+
+
+bool
+LODSphereMesh::isPatchVisible(int phi0, int theta0, int extent, const RenderInfo& ri)
 {
     int thetaExtent = extent;
     int phiExtent = extent / 2;
@@ -590,7 +692,7 @@ LODSphereMesh::renderPatches(int phi0, int theta0,
         {
             // If this patch is outside the view frustum,
             // so are all of its subpatches
-            return;
+            return false;
         }
     }
 
@@ -604,11 +706,25 @@ LODSphereMesh::renderPatches(int phi0, int theta0,
     Eigen::Vector3f patchCenter = (p0 + p1 + p2 + p3) * 0.25f;
 #endif
 
-    if (float boundingRadius = std::max({(patchCenter - p0).norm(),
+    float boundingRadius = std::max({(patchCenter - p0).norm(),
                                      (patchCenter - p1).norm(),
                                      (patchCenter - p2).norm(),
                                      (patchCenter - p3).norm()});
-        ri.frustum.testSphere(patchCenter, boundingRadius) == math::FrustumAspect::Outside)
+    return ri.frustum.testSphere(patchCenter, boundingRadius) != math::FrustumAspect::Outside;
+}
+
+
+void
+LODSphereMesh::renderPatches(int phi0, int theta0,
+                             int extent,
+                             int level,
+                             const RenderInfo& ri,
+                             CelestiaGLProgram *program)
+{
+    int thetaExtent = extent;
+    int phiExtent = extent / 2;
+
+    if (!isPatchVisible(phi0, theta0, extent, ri))
         return;
 
     if (level == 1)
@@ -632,11 +748,57 @@ LODSphereMesh::renderPatches(int phi0, int theta0,
 }
 
 
+void
+LODSphereMesh::prefetchPatches(int phi0, int theta0,
+                               int extent,
+                               int level,
+                               const RenderInfo& ri,
+                               Texture** tex, int nTextures)
+{
+    int thetaExtent = extent;
+    int phiExtent = extent / 2;
+
+    if (!isPatchVisible(phi0, theta0, extent, ri))
+        return;
+
+    if (level > 1)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            for (int j = 0; j < 2; j++)
+            {
+                prefetchPatches(phi0 + phiExtent / 2 * i,
+                                theta0 + thetaExtent / 2 * j,
+                                extent / 2,
+                                level / 2,
+                                ri,
+                                tex, nTextures);
+            }
+        }
+        return;
+    }
+
+    // Same tile selection as renderPatches()
+    int patchSplit = maxDivisions / extent;
+    for (int i = 0; i < nTextures; i++)
+    {
+        int uTexSplit = tex[i]->getUTileCount(ri.texLOD[i]);
+        int vTexSplit = tex[i]->getVTileCount(ri.texLOD[i]);
+        int u = theta0 / thetaExtent / (patchSplit / uTexSplit);
+        int v = phi0 / phiExtent / (patchSplit / vTexSplit);
+        tex[i]->prefetchTile(ri.texLOD[i], uTexSplit - u - 1, vTexSplit - v - 1);
+    }
+}
+
+
 void
 LODSphereMesh::renderSection(int phi0, int theta0, int extent,
                              const RenderInfo& ri, CelestiaGLProgram *program)
 
 {
+    if (!bindSectionBuffer(phi0, theta0, extent, ri))
+        return;
+
     auto stride = static_cast<GLsizei>(vertexSize * sizeof(float));
     int texCoordOffset = ((ri.attributes & Tangents) != 0) ? 6 : 3;
 
@@ -670,8 +832,6 @@ LODSphereMesh::renderSection(int phi0, int theta0, int extent,
     // assert(isPow2(extent));
     int thetaExtent = extent;
     int phiExtent = extent / 2;
-    int theta1 = theta0 + thetaExtent;
-    int phi1 = phi0 + phiExtent;
 
     TextureCoords tc{ nTexturesUsed };
 
@@ -709,7 +869,7 @@ LODSphereMesh::renderSection(int phi0, int theta0, int extent,
             v /= patchesPerVSubtex;
 
             if (nTexturesUsed > 1)
-                glActiveTexture(GL_TEXTURE0 + tex);
+                gl::Binder::get().activeTexture(tex);
             TextureTile tile = textures[tex]->getTile(ri.texLOD[tex],
                                                       uTexSplit - u - 1,
                                                       vTexSplit - v - 1);
@@ -725,38 +885,16 @@ LODSphereMesh::renderSection(int phi0, int theta0, int extent,
             // texture state changes.
             if (tile.texID != subtextures[tex])
             {
-                glBindTexture(GL_TEXTURE_2D, tile.texID);
+                gl::Binder::get().bindTexture(GL_TEXTURE_2D, tile.texID);
                 subtextures[tex] = tile.texID;
             }
         }
     }
 
-    vertices.clear();
-    int perVertexFloats = (ri.attributes & Tangents) == 0 ? 3 : 6;
-    int expectedVertices = ((phi1 - phi0) / ri.step + 1) *
-                           ((theta1 - theta0) / ri.step + 1) * (perVertexFloats + (nTexturesUsed > 0 ? 2 : 0));
-    assert(expectedVertices <= maxVertices * MaxVertexSize);
-    vertices.reserve(expectedVertices);
-    if ((ri.attributes & Tangents) == 0)
-        createVertices<false>(vertices, phi0, phi1, theta0, theta1, ri.step, tc);
-    else
-        createVertices<true>(vertices, phi0, phi1, theta0, theta1, ri.step, tc);
-
-    assert(expectedVertices == vertices.size());
-
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), nullptr, GL_STREAM_DRAW);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STREAM_DRAW);
-
     int nRings = phiExtent / ri.step;
     int nSlices = thetaExtent / ri.step;
     glDrawElements(GL_TRIANGLE_STRIP,
                    nRings * (nSlices + 2) * 2 - 2,
                    GL_UNSIGNED_SHORT,
                    nullptr);
-
-    // Cycle through the vertex buffers
-    currentVB++;
-    if (currentVB == NUM_SPHERE_VERTEX_BUFFERS)
-        currentVB = 0;
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[currentVB]);
 }
@@ -12,6 +12,8 @@
 
 #include <array>
 #include <cstddef>
+#include <map>
+#include <tuple>
 #include <vector>
 
 #include <Eigen/Core>
@@ -31,7 +33,8 @@ class LODSphereMesh
 {
 public:
     static constexpr std::size_t MAX_SPHERE_MESH_TEXTURES = 6;
-    static constexpr std::size_t NUM_SPHERE_VERTEX_BUFFERS = 2;
+    // Size of the section vertex buffers kept from earlier frames
+    static constexpr std::size_t MAX_SECTION_BUFFER_BYTES = 32 * 1024 * 1024;
 
     LODSphereMesh() = default;
     ~LODSphereMesh();
@@ -49,6 +52,11 @@ public:
     void render(const celestia::math::Frustum&, float pixWidth,
                 Texture** tex, int nTextures, CelestiaGLProgram *);
 
+    // Asks the textures for the tiles that rendering the sphere with the
+    // given frustum and size would use, without drawing anything
+    void prefetch(const celestia::math::Frustum&, float pixWidth,
+                  Texture** tex, int nTextures) const;
+
     enum
     {
         Normals    = 0x01,
@@ -73,14 +81,57 @@ public:
         std::array<int, MAX_SPHERE_MESH_TEXTURES> texLOD{};
     };
 
+    // Sets ri.texLOD and returns the number of patches across the sphere
+    // needed so that no patch spans more than one tile
+    static int computeTextureLODs(float pixWidth, Texture** tex, int nTextures, RenderInfo& ri);
+    static void computeFrustumPoints(RenderInfo& ri);
+    static bool isPatchVisible(int phi0, int theta0, int extent, const RenderInfo&);
+
     void renderPatches(int phi0, int theta0,
                        int extent,
                        int level,
                        const RenderInfo&,
                        CelestiaGLProgram *);
 
+    static void prefetchPatches(int phi0, int theta0,
+                                int extent,
+                                int level,
+                                const RenderInfo&,
+                                Texture** tex, int nTextures);
+
     void renderSection(int phi0, int theta0, int extent, const RenderInfo&, CelestiaGLProgram *);
 
+    // The vertices of a section only depend on its position, step and
+    // vertex format, not on the textures, so each one is generated once and
+    // kept in its own buffer for as long as it is drawn.
+    struct SectionKey
+    {
+        int phi0;
+        int theta0;
+        int extent;
+        int step;
+        int vertexSize;
+
+        bool operator<(const SectionKey& other) const
+        {
+            return std::tie(phi0, theta0, extent, step, vertexSize) <
+                   std::tie(other.phi0, other.theta0, other.extent, other.step, other.vertexSize);
+        }
+    };
+
+    struct SectionBuffer
+    {
+        GLuint vbo{ 0 };
+        std::size_t size{ 0 };
+        unsigned int lastUsed{ 0 };
+    };
+
+    // Binds the vertex buffer of the section, creating it if needed
+    bool bindSectionBuffer(int phi0, int theta0, int extent, const RenderInfo&);
+    // Deletes the least recently used section buffers not used by the
+    // current render call until they fit in MAX_SECTION_BUFFER_BYTES
+    void trimSectionBuffers();
+
     int vertexSize{ 0 };
 
     std::vector<float> vertices{};
@@ -90,8 +141,13 @@ public:
     std::array<Texture*, MAX_SPHERE_MESH_TEXTURES> textures{};
     std::array<unsigned int, MAX_SPHERE_MESH_TEXTURES> subtextures{};
 
-    bool vertexBuffersInitialized{ false };
-    GLuint currentVB{ 0 };
-    std::array<GLuint, NUM_SPHERE_VERTEX_BUFFERS> vertexBuffers{};
+    std::map<SectionKey, SectionBuffer> sectionBuffers;
+    std::size_t sectionBufferBytes{ 0 };
+    unsigned int renderCount{ 0 };
+
+    // The index buffer is shared by all sections of a render call and only
+    // rewritten when their number of rings or slices changes
     GLuint indexBuffer{ 0 };
+    int indexRings{ 0 };
+    int indexSlices{ 0 };
 };
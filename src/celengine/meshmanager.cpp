@@ -10,10 +10,14 @@
 
 #include "meshmanager.h"
 
+#include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <ios>
+#include <map>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -93,9 +97,33 @@ LoadCelestiaMesh(const fs::path& filename)
     return model;
 }
 
+// Converts the meshes of a 3DS file one at a time as they are read, so
+// that the 3DS meshes never need to be held in memory all together.
+class Model3DSBuilder : public M3DSceneHandler
+{
+public:
+    explicit Model3DSBuilder(const fs::path& _texPath) : texPath(_texPath) {}
+
+    bool material(M3DMaterial&& material) override;
+    bool triangleMesh(M3DTriangleMesh&& mesh) override;
+
+    std::unique_ptr<cmod::Model> finish();
+
+private:
+    std::uint32_t getMaterialIndex(const std::string& name);
+    cmod::Mesh convertTriangleMesh(const M3DTriangleMesh& mesh);
+
+    fs::path texPath;
+    std::unique_ptr<cmod::Model> model{ std::make_unique<cmod::Model>() };
+    // Meshes may refer to materials that are defined later in the file, so
+    // the materials are only added to the model once the file is read.
+    std::vector<cmod::Material> materials;
+    std::vector<bool> materialDefined;
+    std::map<std::string, std::uint32_t, std::less<>> materialIndices;
+};
+
 cmod::Mesh
-ConvertTriangleMesh(const M3DTriangleMesh& mesh,
-                    const M3DScene& scene)
+Model3DSBuilder::convertTriangleMesh(const M3DTriangleMesh& mesh)
 {
     int nFaces     = mesh.getFaceCount();
     int nVertices  = mesh.getVertexCount();
@@ -276,93 +304,102 @@ ConvertTriangleMesh(const M3DTriangleMesh& mesh,
             indices.push_back(faceIndex * 3 + 2);
         }
 
-        // Lookup the material index
-        std::uint32_t materialIndex = 0;
-        for (std::uint32_t j = 0; j < scene.getMaterialCount(); ++j)
-        {
-            if (matGroup->materialName == scene.getMaterial(j)->getName())
-            {
-                materialIndex = j;
-                break;
-            }
-        }
-
-        newMesh.addGroup(cmod::PrimitiveGroupType::TriList, materialIndex, std::move(indices));
+        newMesh.addGroup(cmod::PrimitiveGroupType::TriList,
+                         getMaterialIndex(matGroup->materialName),
+                         std::move(indices));
     }
 
     return newMesh;
 }
 
-std::unique_ptr<cmod::Model>
-Convert3DSModel(const M3DScene& scene, const fs::path& texPath)
+std::uint32_t
+Model3DSBuilder::getMaterialIndex(const std::string& name)
 {
-    auto model = std::make_unique<cmod::Model>();
-
-    // Convert the materials
-    for (std::uint32_t i = 0; i < scene.getMaterialCount(); i++)
-    {
-        const M3DMaterial* material = scene.getMaterial(i);
-        cmod::Material newMaterial;
+    if (auto it = materialIndices.find(name); it != materialIndices.end())
+        return it->second;
+
+    // Reserve the material until its definition is read; if it never is,
+    // the default material is used.
+    auto index = static_cast<std::uint32_t>(materials.size());
+    materialIndices.try_emplace(name, index);
+    materials.emplace_back();
+    materialDefined.push_back(false);
+    return index;
+}
 
-        M3DColor diffuse = material->getDiffuseColor();
-        newMaterial.diffuse = cmod::Color(diffuse.red, diffuse.green, diffuse.blue);
-        newMaterial.opacity = material->getOpacity();
+bool
+Model3DSBuilder::material(M3DMaterial&& material)
+{
+    cmod::Material newMaterial;
 
-        M3DColor specular = material->getSpecularColor();
-        newMaterial.specular = cmod::Color(specular.red, specular.green, specular.blue);
+    M3DColor diffuse = material.getDiffuseColor();
+    newMaterial.diffuse = cmod::Color(diffuse.red, diffuse.green, diffuse.blue);
+    newMaterial.opacity = material.getOpacity();
 
-        float shininess = material->getShininess();
+    M3DColor specular = material.getSpecularColor();
+    newMaterial.specular = cmod::Color(specular.red, specular.green, specular.blue);
 
-        // Map the 3DS file's shininess from percentage (0-100) to
-        // range that OpenGL uses for the specular exponent. The
-        // current equation is just a guess at the mapping that
-        // 3DS actually uses.
-        newMaterial.specularPower = std::pow(2.0f, 1.0f + 0.1f * shininess);
-        if (newMaterial.specularPower > 128.0f)
-            newMaterial.specularPower = 128.0f;
+    float shininess = material.getShininess();
 
-        if (!material->getTextureMap().empty())
-        {
-            ResourceHandle tex = GetTextureManager()->getHandle(TextureInfo(material->getTextureMap(), texPath, TextureInfo::WrapTexture));
-            newMaterial.setMap(cmod::TextureSemantic::DiffuseMap, tex);
-        }
+    // Map the 3DS file's shininess from percentage (0-100) to
+    // range that OpenGL uses for the specular exponent. The
+    // current equation is just a guess at the mapping that
+    // 3DS actually uses.
+    newMaterial.specularPower = std::pow(2.0f, 1.0f + 0.1f * shininess);
+    if (newMaterial.specularPower > 128.0f)
+        newMaterial.specularPower = 128.0f;
 
-        model->addMaterial(std::move(newMaterial));
+    if (!material.getTextureMap().empty())
+    {
+        ResourceHandle tex = GetTextureManager()->getHandle(TextureInfo(material.getTextureMap(), texPath, TextureInfo::WrapTexture));
+        newMaterial.setMap(cmod::TextureSemantic::DiffuseMap, tex);
     }
 
-    // Convert all models in the scene. Some confusing terminology: a 3ds 'scene' is the same
-    // as a Celestia model, and a 3ds 'model' is the same as a Celestia mesh.
-    for (std::uint32_t i = 0; i < scene.getModelCount(); i++)
+    // Meshes refer to the first material with their material's name
+    std::string name = material.getName();
+    if (auto it = materialIndices.find(name); it != materialIndices.end() && !materialDefined[it->second])
     {
-        const M3DModel* model3ds = scene.getModel(i);
-        if (model3ds)
-        {
-            for (unsigned int j = 0; j < model3ds->getTriMeshCount(); j++)
-            {
-                const M3DTriangleMesh* mesh = model3ds->getTriMesh(j);
-                if (mesh)
-                {
-                    cmod::Mesh cmodmesh = ConvertTriangleMesh(*mesh, scene);
-                    if (cmodmesh.getGroupCount() > 0)
-                        model->addMesh(std::move(cmodmesh));
-                    else
-                        GetLogger()->warn("Skipping mesh with 0 primitive groups!\n");
-                }
-            }
-        }
+        materials[it->second] = std::move(newMaterial);
+        materialDefined[it->second] = true;
+        return true;
     }
 
-    return model;
+    materialIndices.try_emplace(std::move(name), static_cast<std::uint32_t>(materials.size()));
+    materials.push_back(std::move(newMaterial));
+    materialDefined.push_back(true);
+    return true;
+}
+
+// Some confusing terminology: a 3ds 'scene' is the same as a Celestia
+// model, and a 3ds 'model' is the same as a Celestia mesh.
+bool
+Model3DSBuilder::triangleMesh(M3DTriangleMesh&& mesh)
+{
+    cmod::Mesh cmodmesh = convertTriangleMesh(mesh);
+    if (cmodmesh.getGroupCount() > 0)
+        model->addMesh(std::move(cmodmesh));
+    else
+        GetLogger()->warn("Skipping mesh with 0 primitive groups!\n");
+    return true;
+}
+
+std::unique_ptr<cmod::Model>
+Model3DSBuilder::finish()
+{
+    for (auto& material : materials)
+        model->addMaterial(std::move(material));
+    materials.clear();
+    return std::move(model);
 }
 
 std::unique_ptr<cmod::Model>
 Load3DSModel(const GeometryInfo::ResourceKey& key, const fs::path& path)
 {
-    std::unique_ptr<M3DScene> scene = Read3DSFile(key.resolvedPath);
-    if (scene == nullptr)
+    Model3DSBuilder builder(key.resolvedToPath ? path : fs::path());
+    if (!Read3DSFile(key.resolvedPath, builder))
         return nullptr;
 
-    std::unique_ptr<cmod::Model> model = Convert3DSModel(*scene, key.resolvedToPath ? path : fs::path());
+    std::unique_ptr<cmod::Model> model = builder.finish();
 
     if (key.isNormalized)
         model->normalize(key.center);
@@ -499,4 +536,11 @@ GetGeometryManager()
     return geometryManager;
 }
 
+ResourceHandle
+GetEmptyGeometryHandle()
+{
+    static const ResourceHandle emptyGeometry = GetGeometryManager()->getHandle(GeometryInfo({}));
+    return emptyGeometry;
+}
+
 } // end namespace celestia::engine
@@ -27,6 +27,14 @@ class GeometryInfo
 public:
     using ResourceType = Geometry;
 
+    // Models are loaded without touching GL; their buffers are created the
+    // first time they are rendered
+    static constexpr bool BackgroundLoading = true;
+
+    // Parsing models and generating their normals and tangents share no
+    // state, so several models may load at once
+    static constexpr unsigned int LoaderThreads = 4;
+
     // Ensure that models with different centers get resolved to different objects by
     // encoding the center, scale and normalization state in the key.
     struct ResourceKey
@@ -101,4 +109,7 @@ using GeometryManager = ResourceManager<GeometryInfo>;
 
 GeometryManager* GetGeometryManager();
 
+// Handle of the empty geometry, which add-ons use to hide the body
+ResourceHandle GetEmptyGeometryHandle();
+
 } // end namespace celestia::engine
@@ -9,8 +9,11 @@
 // of the License, or (at your option) any later version.
 
 #include <algorithm>
+#include <cassert>
+#include <cstddef>
 #include <vector>
 #include <utility>
+#include <celmodel/vertexformat.h>
 #include <celrender/gl/buffer.h>
 #include <celrender/gl/vertexobject.h>
 #include <celutil/gettext.h>
@@ -26,6 +29,9 @@ namespace util = celestia::util;
 namespace
 {
 
+// Largest error of a level of detail that may be drawn, in pixels
+constexpr float MaxLevelOfDetailError = 1.0f;
+
 constexpr gl::VertexObject::DataType GLComponentTypes[static_cast<std::size_t>(cmod::VertexAttributeFormat::FormatMax)] =
 {
      gl::VertexObject::DataType::Float,         // Float1
@@ -33,6 +39,9 @@ constexpr gl::VertexObject::DataType GLComponentTypes[static_cast<std::size_t>(c
      gl::VertexObject::DataType::Float,         // Float3
      gl::VertexObject::DataType::Float,         // Float4,
      gl::VertexObject::DataType::UnsignedByte,  // UByte4
+     gl::VertexObject::DataType::Half,          // Half2
+     gl::VertexObject::DataType::Short,         // Short4
+     gl::VertexObject::DataType::Int2101010Rev, // Int1010102
 };
 
 constexpr int GLComponentCounts[static_cast<std::size_t>(cmod::VertexAttributeFormat::FormatMax)] =
@@ -42,6 +51,9 @@ constexpr int GLComponentCounts[static_cast<std::size_t>(cmod::VertexAttributeFo
      3,  // Float3
      4,  // Float4,
      4,  // UByte4
+     2,  // Half2
+     4,  // Short4
+     4,  // Int1010102
 };
 
 constexpr bool GLComponentNormalized[static_cast<std::size_t>(cmod::VertexAttributeFormat::FormatMax)] =
@@ -51,6 +63,9 @@ constexpr bool GLComponentNormalized[static_cast<std::size_t>(cmod::VertexAttrib
      false,  // Float3
      false,  // Float4,
      true,  // UByte4
+     false, // Half2
+     true,  // Short4
+     true,  // Int1010102
 };
 
 constexpr int
@@ -95,6 +110,70 @@ setVertexArrays(gl::VertexObject &vao, const gl::Buffer &vbo, const cmod::Vertex
     }
 }
 
+void
+setInstanceArrays(gl::VertexObject &vao, const gl::Buffer &instances)
+{
+    constexpr std::ptrdiff_t rowOffsets[3] =
+    {
+        offsetof(ModelInstance, modelView0),
+        offsetof(ModelInstance, modelView1),
+        offsetof(ModelInstance, modelView2),
+    };
+    for (int row = 0; row < 3; ++row)
+    {
+        vao.addVertexBuffer(
+            instances, CelestiaGLProgram::InstanceTransformAttributeIndex + row, 4,
+            gl::VertexObject::DataType::Float, false, sizeof(ModelInstance), rowOffsets[row], 1);
+    }
+    vao.addVertexBuffer(
+        instances, CelestiaGLProgram::InstanceLightAttributeIndex, 4,
+        gl::VertexObject::DataType::Float, false, sizeof(ModelInstance), offsetof(ModelInstance, light), 1);
+}
+
+// Instanced programs are only built for meshes lit through their normals
+bool
+canDrawInstanced(const cmod::Mesh& mesh)
+{
+    if (mesh.getVertexDescription().getAttribute(cmod::VertexAttributeSemantic::Normal).format
+        == cmod::VertexAttributeFormat::InvalidFormat)
+    {
+        return false;
+    }
+
+    for (unsigned int groupIndex = 0; groupIndex < mesh.getGroupCount(); ++groupIndex)
+    {
+        cmod::PrimitiveGroupType prim = mesh.getGroup(groupIndex)->prim;
+        if (prim == cmod::PrimitiveGroupType::PointList || prim == cmod::PrimitiveGroupType::SpriteList)
+            return false;
+    }
+
+    return true;
+}
+
+// Return the primitive groups of the coarsest level of detail of the mesh
+// whose error stays below MaxLevelOfDetailError
+const std::vector<cmod::PrimitiveGroup>*
+selectLevelOfDetail(const cmod::Mesh& mesh, float pixelScale)
+{
+    if (pixelScale <= 0.0f)
+        return nullptr;
+
+    const std::vector<cmod::PrimitiveGroup>* groups = nullptr;
+    float maxError = MaxLevelOfDetailError / pixelScale;
+    float selectedError = 0.0f;
+    for (unsigned int i = 0; i < mesh.getLevelOfDetailCount(); ++i)
+    {
+        const cmod::LevelOfDetail* level = mesh.getLevelOfDetail(i);
+        if (level->error <= maxError && level->error >= selectedError)
+        {
+            groups = &level->groups;
+            selectedError = level->error;
+        }
+    }
+
+    return groups;
+}
+
 } // anonymous namespace
 
 
@@ -104,6 +183,9 @@ public:
     std::vector<gl::Buffer> vbos; // vertex buffer objects
     std::vector<gl::Buffer> vios; // vertex index objects
     std::vector<gl::VertexObject> vaos; // vertex attributes
+    std::vector<cmod::VertexDescription> vertexDescs; // layout of the vertex buffer objects
+    gl::Buffer instanceBuffer{ util::NoCreateT{} }; // instances of the last instanced draw
+    std::vector<gl::VertexObject> instancedVaos; // vertex and instance attributes
 };
 
 
@@ -114,6 +196,9 @@ ModelGeometry::ModelGeometry(std::unique_ptr<cmod::Model>&& model) :
     m_model(std::move(model)),
     m_glData(std::make_unique<ModelOpenGLData>())
 {
+    m_supportsInstancing = true;
+    for (unsigned int i = 0; i < m_model->getMeshCount() && m_supportsInstancing; ++i)
+        m_supportsInstancing = canDrawInstanced(*m_model->getMesh(i));
 }
 
 
@@ -121,6 +206,31 @@ ModelGeometry::ModelGeometry(std::unique_ptr<cmod::Model>&& model) :
 ModelGeometry::~ModelGeometry() = default;
 
 
+// The vertices and indices are kept both in the model and in the buffers
+std::size_t
+ModelGeometry::getMemorySize() const
+{
+    std::size_t size = 0;
+    for (unsigned int i = 0; i < m_model->getMeshCount(); ++i)
+    {
+        const cmod::Mesh* mesh = m_model->getMesh(i);
+        std::size_t indexCount = 0;
+        for (unsigned int groupIndex = 0; groupIndex < mesh->getGroupCount(); ++groupIndex)
+            indexCount += mesh->getGroup(groupIndex)->indices.size();
+        for (unsigned int levelIndex = 0; levelIndex < mesh->getLevelOfDetailCount(); ++levelIndex)
+        {
+            for (const auto& group : mesh->getLevelOfDetail(levelIndex)->groups)
+                indexCount += group.indices.size();
+        }
+
+        size += static_cast<std::size_t>(mesh->getVertexCount()) * mesh->getVertexStrideWords() * sizeof(cmod::VWord);
+        size += indexCount * sizeof(cmod::Index32);
+    }
+
+    return 2 * size;
+}
+
+
 bool
 ModelGeometry::pick(const Eigen::ParametrizedLine<double, 3>& r, double& distance) const
 {
@@ -134,13 +244,10 @@ ModelGeometry::pick(const Eigen::ParametrizedLine<double, 3>& r, double& distanc
 void
 ModelGeometry::render(RenderContext& rc, double /* t */)
 {
-    // The first time the mesh is rendered, we will try and place the
-    // vertex data in a vertex buffer object and potentially get a huge
-    // rendering performance boost.  This can consume a great deal of
-    // memory, since we're duplicating the vertex data.  TODO: investigate
-    // the possibility of deleting the original data.  We can always map
-    // read-only later on for things like picking, but this could be a low
-    // performance path.
+    // The first time the mesh is rendered, we place the vertex data in a
+    // vertex buffer object. Afterwards only picking needs the vertices,
+    // so all attributes but the positions are dropped to avoid keeping
+    // two copies of large models.
     if (!m_vbInitialized)
     {
         m_vbInitialized = true;
@@ -148,7 +255,9 @@ ModelGeometry::render(RenderContext& rc, double /* t */)
         std::vector<cmod::Index32> indices;
         for (unsigned int i = 0; i < m_model->getMeshCount(); ++i)
         {
-            const cmod::Mesh* mesh = m_model->getMesh(i);
+            cmod::Mesh* mesh = m_model->getMesh(i);
+            if (!gl::hasPackedVertexFormats())
+                cmod::UnpackVertexAttributes(*mesh);
             const cmod::VertexDescription& vertexDesc = mesh->getVertexDescription();
 
             m_glData->vbos.emplace_back(
@@ -163,6 +272,11 @@ ModelGeometry::render(RenderContext& rc, double /* t */)
                 const auto* group = mesh->getGroup(groupIndex);
                 std::copy(group->indices.begin(), group->indices.end(), std::back_inserter(indices));
             }
+            for (unsigned int levelIndex = 0; levelIndex < mesh->getLevelOfDetailCount(); ++levelIndex)
+            {
+                for (const auto& group : mesh->getLevelOfDetail(levelIndex)->groups)
+                    std::copy(group.indices.begin(), group.indices.end(), std::back_inserter(indices));
+            }
             m_glData->vios.emplace_back(gl::Buffer::TargetHint::ElementArray, indices);
             indices.clear();
 
@@ -170,11 +284,26 @@ ModelGeometry::render(RenderContext& rc, double /* t */)
             setVertexArrays(vao, m_glData->vbos.back(), mesh->getVertexDescription());
             vao.setIndexBuffer(m_glData->vios.back(), 0, gl::VertexObject::IndexType::UnsignedInt);
             m_glData->vaos.emplace_back(std::move(vao));
+
+            m_glData->vertexDescs.push_back(vertexDesc.clone());
+            mesh->discardNonPositionAttributes();
         }
     }
 
+    std::vector<gl::VertexObject>* vaos = &m_glData->vaos;
+    if (const std::vector<ModelInstance>* instances = rc.getInstances(); instances != nullptr)
+    {
+        assert(supportsInstancing());
+        initializeInstancing();
+        // Respecifying the whole buffer lets the driver orphan the storage
+        // still in use by the previous instanced draw.
+        m_glData->instanceBuffer.setData(*instances, gl::Buffer::BufferUsage::StreamDraw);
+        vaos = &m_glData->instancedVaos;
+    }
+
     unsigned int lastMaterial = ~0u;
     unsigned int materialCount = m_model->getMaterialCount();
+    float pixelScale = rc.getPixelScale();
 
     // Iterate over all meshes in the model
     for (unsigned int meshIndex = 0; meshIndex < m_model->getMeshCount(); ++meshIndex)
@@ -187,11 +316,18 @@ ModelGeometry::render(RenderContext& rc, double /* t */)
             return;
         }
 
-        // Iterate over all primitive groups in the mesh
-        for (unsigned int groupIndex = 0; groupIndex < mesh->getGroupCount(); ++groupIndex)
+        // Iterate over all primitive groups in the mesh, or in the level of
+        // detail that's indistinguishable from it at this size
+        const std::vector<cmod::PrimitiveGroup>* levelGroups = selectLevelOfDetail(*mesh, pixelScale);
+        unsigned int groupCount = levelGroups == nullptr
+            ? mesh->getGroupCount()
+            : static_cast<unsigned int>(levelGroups->size());
+        for (unsigned int groupIndex = 0; groupIndex < groupCount; ++groupIndex)
         {
-            const cmod::PrimitiveGroup* group = mesh->getGroup(groupIndex);
-            rc.updateShader(mesh->getVertexDescription(), group->prim);
+            const cmod::PrimitiveGroup* group = levelGroups == nullptr
+                ? mesh->getGroup(groupIndex)
+                : &(*levelGroups)[groupIndex];
+            rc.updateShader(m_glData->vertexDescs[meshIndex], group->prim);
 
             // Set up the material
             const cmod::Material* material = nullptr;
@@ -202,12 +338,32 @@ ModelGeometry::render(RenderContext& rc, double /* t */)
             }
 
             rc.setMaterial(material);
-            rc.drawGroup(m_glData->vaos[meshIndex], *group);
+            rc.drawGroup((*vaos)[meshIndex], *group);
         }
     }
 }
 
 
+// The instanced vertex objects share the vertex and index buffers of the
+// meshes and add the attributes of the instance buffer
+void
+ModelGeometry::initializeInstancing()
+{
+    if (!m_glData->instancedVaos.empty())
+        return;
+
+    m_glData->instanceBuffer = gl::Buffer(gl::Buffer::TargetHint::Array);
+    for (std::size_t meshIndex = 0; meshIndex < m_glData->vbos.size(); ++meshIndex)
+    {
+        gl::VertexObject vao;
+        setVertexArrays(vao, m_glData->vbos[meshIndex], m_glData->vertexDescs[meshIndex]);
+        setInstanceArrays(vao, m_glData->instanceBuffer);
+        vao.setIndexBuffer(m_glData->vios[meshIndex], 0, gl::VertexObject::IndexType::UnsignedInt);
+        m_glData->instancedVaos.emplace_back(std::move(vao));
+    }
+}
+
+
 bool
 ModelGeometry::isOpaque() const
 {
@@ -222,6 +378,13 @@ ModelGeometry::isNormalized() const
 }
 
 
+bool
+ModelGeometry::supportsInstancing() const
+{
+    return m_supportsInstancing && gl::hasInstancedArrays();
+}
+
+
 bool
 ModelGeometry::usesTextureType(cmod::TextureSemantic t) const
 {
@@ -40,11 +40,16 @@ public:
     bool usesTextureType(cmod::TextureSemantic) const override;
     bool isOpaque() const override;
     bool isNormalized() const override;
+    bool supportsInstancing() const override;
+    std::size_t getMemorySize() const override;
 
     void loadTextures() override;
 
 private:
+    void initializeInstancing();
+
     std::unique_ptr<cmod::Model> m_model;
     std::unique_ptr<ModelOpenGLData> m_glData;
     bool m_vbInitialized{ false };
+    bool m_supportsInstancing{ false };
 };
@@ -65,10 +65,24 @@ Texture* MultiResTexture::find(unsigned int resolution)
 {
     TextureManager* texMan = GetTextureManager();
 
-    Texture* res = texMan->find(tex[resolution]);
+    Texture* res = texMan->request(tex[resolution]);
     if (res != nullptr)
         return res;
 
+    // While the texture is loaded in the background, show whichever other
+    // resolution is loaded already, or nothing.
+    if (texMan->getState(tex[resolution]) == ResourceState::Loading)
+    {
+        for (unsigned int i = 0; i < kTextureResolution; ++i)
+        {
+            if (i == resolution || tex[i] == tex[resolution])
+                continue;
+            if (texMan->getState(tex[i]) == ResourceState::Loaded)
+                return texMan->request(tex[i]);
+        }
+        return nullptr;
+    }
+
     // Preferred resolution isn't available; try the second choice
     // Set these to some defaults to avoid GCC complaints
     // about possible uninitialized variable usage:
@@ -91,13 +105,13 @@ Texture* MultiResTexture::find(unsigned int resolution)
     }
 
     tex[resolution] = tex[secondChoice];
-    res = texMan->find(tex[resolution]);
-    if (res != nullptr)
+    res = texMan->request(tex[resolution]);
+    if (res != nullptr || texMan->getState(tex[resolution]) != ResourceState::LoadingFailed)
         return res;
 
     tex[resolution] = tex[lastResort];
 
-    return texMan->find(tex[resolution]);
+    return texMan->request(tex[resolution]);
 }
 
 
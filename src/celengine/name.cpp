@@ -1,5 +1,6 @@
 #include "name.h"
 
+#include <algorithm>
 #include <utility>
 
 #ifdef DEBUG
@@ -7,8 +8,61 @@
 #endif
 #include <celutil/gettext.h>
 #include <celutil/greek.h>
+#include <celutil/memoryusage.h>
 #include <celutil/utf8.h>
 
+namespace
+{
+
+// Lookups scan up to this many unmerged names before merging them
+constexpr std::size_t MaxUnsortedNames = 64;
+
+// Appends str with each character case folded. The characters are encoded
+// like UTF-8, but without rejecting any values, so that folded names compare
+// in the order of their characters and a folded prefix of a name is a prefix
+// of the folded name. As in UTF8StartsWith, the string ends at the first
+// invalid sequence; false is returned in that case.
+bool
+appendFolded(std::string& dest, std::string_view str)
+{
+    auto length = static_cast<std::int32_t>(str.size());
+    std::int32_t pos = 0;
+    while (pos < length)
+    {
+        std::int32_t ch;
+        if (!UTF8Decode(str, pos, ch))
+            return false;
+
+        auto folded = static_cast<std::uint32_t>(UTF8FoldCase(ch));
+        if (folded < 0x80)
+        {
+            dest.push_back(static_cast<char>(folded));
+        }
+        else if (folded < 0x800)
+        {
+            dest.push_back(static_cast<char>(0xc0 | (folded >> 6)));
+            dest.push_back(static_cast<char>(0x80 | (folded & 0x3f)));
+        }
+        else if (folded < 0x10000)
+        {
+            dest.push_back(static_cast<char>(0xe0 | (folded >> 12)));
+            dest.push_back(static_cast<char>(0x80 | ((folded >> 6) & 0x3f)));
+            dest.push_back(static_cast<char>(0x80 | (folded & 0x3f)));
+        }
+        else
+        {
+            dest.push_back(static_cast<char>(0xf0 | ((folded >> 18) & 0x07)));
+            dest.push_back(static_cast<char>(0x80 | ((folded >> 12) & 0x3f)));
+            dest.push_back(static_cast<char>(0x80 | ((folded >> 6) & 0x3f)));
+            dest.push_back(static_cast<char>(0x80 | (folded & 0x3f)));
+        }
+    }
+
+    return true;
+}
+
+} // end unnamed namespace
+
 void
 NameDatabase::add(const AstroCatalog::IndexNumber catalogNumber, std::string_view name)
 {
@@ -20,34 +74,34 @@ NameDatabase::add(const AstroCatalog::IndexNumber catalogNumber, std::string_vie
         celestia::util::GetLogger()->debug("Duplicated name '{}' on object with catalog numbers: {} and {}\n", name, tmp, catalogNumber);
 #endif
 
-    std::string fname = ReplaceGreekLetterAbbr(name);
-    nameIndex[fname] = catalogNumber;
+    std::string_view fname = arena.add(ReplaceGreekLetterAbbr(name));
+    nameIndex.add(fname, catalogNumber);
 
 #ifdef ENABLE_NLS
-    std::string_view lname = D_(fname.c_str());
+    std::string_view lname = D_(fname.data());
     if (lname != fname)
-        localizedNameIndex[std::string(lname)] = catalogNumber;
+        localizedNameIndex.add(arena.add(lname), catalogNumber);
 #endif
 
-    numberIndex.emplace(catalogNumber, std::move(fname));
+    pendingNumbers.push_back({ catalogNumber, fname });
 }
 
 void NameDatabase::erase(const AstroCatalog::IndexNumber catalogNumber)
 {
-    numberIndex.erase(catalogNumber);
+    pendingNumbers.push_back({ catalogNumber, {} });
 }
 
 AstroCatalog::IndexNumber
 NameDatabase::getCatalogNumberByName(std::string_view name, [[maybe_unused]] bool i18n) const
 {
-    if (auto iter = nameIndex.find(name); iter != nameIndex.end())
-        return iter->second;
+    if (auto catalogNumber = nameIndex.find(name); catalogNumber != AstroCatalog::InvalidIndex)
+        return catalogNumber;
 
 #if ENABLE_NLS
     if (i18n)
     {
-        if (auto iter = localizedNameIndex.find(name); iter != localizedNameIndex.end())
-            return iter->second;
+        if (auto catalogNumber = localizedNameIndex.find(name); catalogNumber != AstroCatalog::InvalidIndex)
+            return catalogNumber;
     }
 #endif
 
@@ -57,45 +111,253 @@ NameDatabase::getCatalogNumberByName(std::string_view name, [[maybe_unused]] boo
     return AstroCatalog::InvalidIndex;
 }
 
-// Return the first name matching the catalog number or end()
-// if there are no matching names.  The first name *should* be the
-// proper name of the OBJ, if one exists. This requires the
-// OBJ name database file to have the proper names listed before
-// other designations.  Also, the STL implementation must
-// preserve this order when inserting the names into the multimap
-// (not certain whether or not this behavior is in the STL spec.
-// but it works on the implementations I've tried so far.)
-NameDatabase::NumberIndex::const_iterator
-NameDatabase::getFirstNameIter(const AstroCatalog::IndexNumber catalogNumber) const
+// Return the names matching the catalog number. The first name *should* be
+// the proper name of the OBJ, if one exists. This requires the OBJ name
+// database file to have the proper names listed before other designations.
+NameDatabase::NameList
+NameDatabase::getNames(const AstroCatalog::IndexNumber catalogNumber) const
 {
-    auto iter = numberIndex.lower_bound(catalogNumber);
-    if (iter == numberIndex.end() || iter->first != catalogNumber)
-        return getFinalNameIter();
+    mergeNumbers();
 
-    return iter;
+    auto [first, last] = std::equal_range(numbers.cbegin(), numbers.cend(), catalogNumber);
+    return { numberNames.data() + (first - numbers.cbegin()), static_cast<std::size_t>(last - first) };
 }
 
-NameDatabase::NumberIndex::const_iterator
-NameDatabase::getFinalNameIter() const
+void
+NameDatabase::getCompletion(std::vector<std::string>& completion, std::string_view name) const
 {
-    return numberIndex.end();
+    std::string name2 = ReplaceGreekLetter(name);
+
+    nameIndex.getCompletion(completion, name2);
+#ifdef ENABLE_NLS
+    localizedNameIndex.getCompletion(completion, name2);
+#endif
 }
 
 void
-NameDatabase::getCompletion(std::vector<std::string>& completion, std::string_view name) const
+NameDatabase::finish()
 {
-    std::string name2 = ReplaceGreekLetter(name);
-    for (const auto &[n, _] : nameIndex)
+    nameIndex.finish();
+#ifdef ENABLE_NLS
+    localizedNameIndex.finish();
+#endif
+
+    mergeNumbers();
+    numbers.shrink_to_fit();
+    numberNames.shrink_to_fit();
+    pendingNumbers.shrink_to_fit();
+}
+
+std::size_t
+NameDatabase::getMemoryUsage() const
+{
+    std::size_t size = arena.capacity() + nameIndex.getMemoryUsage();
+#ifdef ENABLE_NLS
+    size += localizedNameIndex.getMemoryUsage();
+#endif
+    size += celestia::util::MemoryUsage(numbers);
+    size += celestia::util::MemoryUsage(numberNames);
+    size += celestia::util::MemoryUsage(pendingNumbers);
+    return size;
+}
+
+void
+NameDatabase::mergeNumbers() const
+{
+    if (pendingNumbers.empty())
+        return;
+
+    std::stable_sort(pendingNumbers.begin(), pendingNumbers.end(),
+                     [](const NumberEntry& e0, const NumberEntry& e1) { return e0.catalogNumber < e1.catalogNumber; });
+
+    std::vector<AstroCatalog::IndexNumber> mergedNumbers;
+    std::vector<std::string_view> mergedNames;
+    mergedNumbers.reserve(numbers.size() + pendingNumbers.size());
+    mergedNames.reserve(numbers.size() + pendingNumbers.size());
+
+    std::size_t sortedIdx = 0;
+    auto pendingIt = pendingNumbers.cbegin();
+    while (sortedIdx < numbers.size() || pendingIt != pendingNumbers.cend())
     {
-        if (UTF8StartsWith(n, name2, true))
-            completion.push_back(n);
+        AstroCatalog::IndexNumber catalogNumber;
+        if (pendingIt == pendingNumbers.cend()
+            || (sortedIdx < numbers.size() && numbers[sortedIdx] <= pendingIt->catalogNumber))
+            catalogNumber = numbers[sortedIdx];
+        else
+            catalogNumber = pendingIt->catalogNumber;
+
+        std::size_t first = mergedNumbers.size();
+        for (; sortedIdx < numbers.size() && numbers[sortedIdx] == catalogNumber; ++sortedIdx)
+        {
+            mergedNumbers.push_back(catalogNumber);
+            mergedNames.push_back(numberNames[sortedIdx]);
+        }
+
+        for (; pendingIt != pendingNumbers.cend() && pendingIt->catalogNumber == catalogNumber; ++pendingIt)
+        {
+            if (pendingIt->name.empty())
+            {
+                mergedNumbers.resize(first);
+                mergedNames.resize(first);
+            }
+            else
+            {
+                mergedNumbers.push_back(catalogNumber);
+                mergedNames.push_back(pendingIt->name);
+            }
+        }
     }
 
-#ifdef ENABLE_NLS
-    for (const auto &[n, _] : localizedNameIndex)
+    numbers = std::move(mergedNumbers);
+    numberNames = std::move(mergedNames);
+    pendingNumbers.clear();
+}
+
+void
+NameDatabase::NameIndex::add(std::string_view name, AstroCatalog::IndexNumber catalogNumber)
+{
+    pending.push_back({ name, catalogNumber });
+}
+
+AstroCatalog::IndexNumber
+NameDatabase::NameIndex::find(std::string_view name)
+{
+    if (pending.size() > MaxUnsortedNames)
+        merge();
+
+    // Later additions replace earlier ones
+    for (auto it = pending.crbegin(); it != pending.crend(); ++it)
     {
-        if (UTF8StartsWith(n, name2, true))
-            completion.push_back(n);
+        if (compareIgnoringCase(it->name, name) == 0)
+            return it->catalogNumber;
     }
-#endif
+
+    auto it = std::lower_bound(sorted.cbegin(), sorted.cend(), name,
+                               [](const NameEntry& entry, std::string_view n) { return compareIgnoringCase(entry.name, n) < 0; });
+    if (it != sorted.cend() && compareIgnoringCase(it->name, name) == 0)
+        return it->catalogNumber;
+
+    return AstroCatalog::InvalidIndex;
+}
+
+// Appends the names starting with prefix, ignoring case, in the order of
+// the sorted index
+void
+NameDatabase::NameIndex::getCompletion(std::vector<std::string>& completion, std::string_view prefix)
+{
+    merge();
+    if (prefix.empty())
+    {
+        for (const auto& entry : sorted)
+            completion.emplace_back(entry.name);
+        return;
+    }
+
+    std::string key;
+    if (!appendFolded(key, prefix))
+        return;
+
+    buildFolded();
+
+    auto foldedName = [this](const FoldedEntry& entry)
+    {
+        return std::string_view(foldedNames).substr(entry.offset, entry.length);
+    };
+
+    auto it = std::lower_bound(folded.cbegin(), folded.cend(), key,
+                               [&foldedName](const FoldedEntry& entry, std::string_view k) { return foldedName(entry) < k; });
+
+    std::vector<std::uint32_t> positions;
+    for (; it != folded.cend() && foldedName(*it).substr(0, key.size()) == key; ++it)
+        positions.push_back(it->position);
+
+    std::sort(positions.begin(), positions.end());
+    for (std::uint32_t position : positions)
+        completion.emplace_back(sorted[position].name);
+}
+
+void
+NameDatabase::NameIndex::buildFolded()
+{
+    if (foldedValid)
+        return;
+
+    foldedNames.clear();
+    folded.clear();
+    folded.reserve(sorted.size());
+    for (std::size_t i = 0; i < sorted.size(); ++i)
+    {
+        auto offset = static_cast<std::uint32_t>(foldedNames.size());
+        appendFolded(foldedNames, sorted[i].name);
+        folded.push_back({ offset,
+                           static_cast<std::uint32_t>(foldedNames.size() - offset),
+                           static_cast<std::uint32_t>(i) });
+    }
+
+    std::string_view names = foldedNames;
+    std::sort(folded.begin(), folded.end(),
+              [names](const FoldedEntry& e0, const FoldedEntry& e1)
+              {
+                  return names.substr(e0.offset, e0.length) < names.substr(e1.offset, e1.length);
+              });
+
+    foldedValid = true;
+}
+
+void
+NameDatabase::NameIndex::merge()
+{
+    if (pending.empty())
+        return;
+
+    foldedValid = false;
+
+    auto less = [](const NameEntry& e0, const NameEntry& e1) { return compareIgnoringCase(e0.name, e1.name) < 0; };
+    std::stable_sort(pending.begin(), pending.end(), less);
+
+    std::vector<NameEntry> merged;
+    merged.reserve(sorted.size() + pending.size());
+
+    // A name that is added again keeps its original spelling but refers to
+    // the most recently added object
+    auto append = [&merged](const NameEntry& entry)
+    {
+        if (!merged.empty() && compareIgnoringCase(merged.back().name, entry.name) == 0)
+            merged.back().catalogNumber = entry.catalogNumber;
+        else
+            merged.push_back(entry);
+    };
+
+    auto sortedIt = sorted.cbegin();
+    auto pendingIt = pending.cbegin();
+    while (sortedIt != sorted.cend() || pendingIt != pending.cend())
+    {
+        if (pendingIt == pending.cend() || (sortedIt != sorted.cend() && !less(*pendingIt, *sortedIt)))
+            append(*sortedIt++);
+        else
+            append(*pendingIt++);
+    }
+
+    sorted = std::move(merged);
+    pending.clear();
+}
+
+void
+NameDatabase::NameIndex::finish()
+{
+    merge();
+    buildFolded();
+    sorted.shrink_to_fit();
+    pending.shrink_to_fit();
+    foldedNames.shrink_to_fit();
+    folded.shrink_to_fit();
+}
+
+std::size_t
+NameDatabase::NameIndex::getMemoryUsage() const
+{
+    return celestia::util::MemoryUsage(sorted) +
+           celestia::util::MemoryUsage(pending) +
+           celestia::util::MemoryUsage(foldedNames) +
+           celestia::util::MemoryUsage(folded);
 }
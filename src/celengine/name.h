@@ -12,22 +12,31 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <map>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include <celengine/astroobj.h>
+#include <celutil/array_view.h>
+#include <celutil/stringarena.h>
 #include <celutil/stringutils.h>
 
+// Names are copied into a string arena and indexed by sorted arrays of views,
+// which need far fewer allocations than maps of strings. Names added since
+// the last lookup are held unsorted and merged into the arrays by the next
+// lookup that needs them, so lookups must not run concurrently until finish()
+// has been called after loading. Completion uses a second array sorted by
+// case-folded names, so the names matching a prefix are found by a binary
+// search rather than by comparing a prefix with every name.
+//
 // TODO: this can be "detemplatized" by creating e.g. a global-scope enum InvalidCatalogNumber since there
 // lies the one and only need for type genericity.
 class NameDatabase
 {
 public:
-    using NameIndex = std::map<std::string, AstroCatalog::IndexNumber, CompareIgnoringCasePredicate>;
-    using NumberIndex = std::multimap<AstroCatalog::IndexNumber, std::string>;
+    using NameList = celestia::util::array_view<std::string_view>;
 
     void add(AstroCatalog::IndexNumber, std::string_view);
 
@@ -36,15 +45,73 @@ public:
 
     AstroCatalog::IndexNumber getCatalogNumberByName(std::string_view, bool i18n) const;
 
-    NumberIndex::const_iterator getFirstNameIter(AstroCatalog::IndexNumber catalogNumber) const;
-    NumberIndex::const_iterator getFinalNameIter() const;
+    // Names of the object in the order they were added. The views are
+    // null-terminated and valid until the next call to a non-const method.
+    NameList getNames(AstroCatalog::IndexNumber catalogNumber) const;
 
     void getCompletion(std::vector<std::string>& completion, std::string_view name) const;
 
+    // Merge and compact the indexes once all names have been added
+    void finish();
+
+    // Bytes of heap memory used by the names and indexes
+    std::size_t getMemoryUsage() const;
+
 private:
-    NameIndex   nameIndex;
+    struct NameEntry
+    {
+        std::string_view name;
+        AstroCatalog::IndexNumber catalogNumber;
+    };
+
+    // Name with each character folded as by UTF8StartsWith ignoring case,
+    // and the position of the name in NameIndex::sorted
+    struct FoldedEntry
+    {
+        std::uint32_t offset;
+        std::uint32_t length;
+        std::uint32_t position;
+    };
+
+    // Case-insensitive index from names to catalog numbers
+    struct NameIndex
+    {
+        void add(std::string_view, AstroCatalog::IndexNumber);
+        AstroCatalog::IndexNumber find(std::string_view);
+        void getCompletion(std::vector<std::string>&, std::string_view);
+        void merge();
+        void buildFolded();
+        void finish();
+        std::size_t getMemoryUsage() const;
+
+        std::vector<NameEntry> sorted;
+        std::vector<NameEntry> pending;
+
+        // Sorted by folded name, built by the first completion after a merge
+        std::string foldedNames;
+        std::vector<FoldedEntry> folded;
+        bool foldedValid{ false };
+    };
+
+    // An entry without a name erases the names added before it
+    struct NumberEntry
+    {
+        AstroCatalog::IndexNumber catalogNumber;
+        std::string_view name;
+    };
+
+    void mergeNumbers() const;
+
+    celestia::util::StringArena arena;
+
+    mutable NameIndex   nameIndex;
 #ifdef ENABLE_NLS
-    NameIndex   localizedNameIndex;
+    mutable NameIndex   localizedNameIndex;
 #endif
-    NumberIndex numberIndex;
+
+    // Sorted by catalog number, names of an object are in the order they
+    // were added
+    mutable std::vector<AstroCatalog::IndexNumber> numbers;
+    mutable std::vector<std::string_view>          numberNames;
+    mutable std::vector<NumberEntry>               pendingNumbers;
 };
@@ -301,125 +301,153 @@ double Observer::getArrivalTime() const
 }
 
 
-/*! Tick the simulation by dt seconds. Update the observer position
- *  and orientation due to an active goto command or non-zero velocity
- *  or angular velocity.
+/*! Position of the observer in its reference frame at fraction t of the
+ *  journey in progress.
  */
-void Observer::update(double dt, double timeScale)
+UniversalCoord Observer::getJourneyPosition(double t) const
 {
-    realTime += dt;
-    simTime += (dt / 86400.0) * timeScale;
+    Vector3d jv = journey.to.offsetFromKm(journey.from);
+    UniversalCoord p;
 
-    simTime = std::clamp(simTime, minimumSimTime, maximumSimTime);
-
-    if (observerMode == Travelling)
+    // Another interpolation method . . . accelerate exponentially,
+    // maintain a constant velocity for a period of time, then
+    // decelerate.  The portion of the trip spent accelerating is
+    // controlled by the parameter journey.accelTime; a value of 1 means
+    // that the entire first half of the trip will be spent accelerating
+    // and there will be no coasting at constant velocity.
     {
-        // Compute the fraction of the trip that has elapsed; handle zero
-        // durations correctly by skipping directly to the destination.
-        double t = 1.0;
-        if (journey.duration > 0)
-            t = std::clamp((realTime - journey.startTime) / journey.duration, 0.0, 1.0);
-
-        Vector3d jv = journey.to.offsetFromKm(journey.from);
-        UniversalCoord p;
+        double u = t < 0.5 ? t * 2.0 : (1.0 - t) * 2.0;
+        double x;
+        if (u < journey.accelTime)
+        {
+            x = std::expm1(journey.expFactor * u); // expm1 == exp - 1
+        }
+        else
+        {
+            x = exp(journey.expFactor * journey.accelTime) *
+                (journey.expFactor * (u - journey.accelTime) + 1.0) - 1.0;
+        }
 
-        // Another interpolation method . . . accelerate exponentially,
-        // maintain a constant velocity for a period of time, then
-        // decelerate.  The portion of the trip spent accelerating is
-        // controlled by the parameter journey.accelTime; a value of 1 means
-        // that the entire first half of the trip will be spent accelerating
-        // and there will be no coasting at constant velocity.
+        if (journey.traj == Linear)
         {
-            double u = t < 0.5 ? t * 2.0 : (1.0 - t) * 2.0;
-            double x;
-            if (u < journey.accelTime)
+            Vector3d v = jv;
+            if (v.norm() == 0.0)
             {
-                x = std::expm1(journey.expFactor * u); // expm1 == exp - 1
+                p = journey.from;
             }
             else
             {
-                x = exp(journey.expFactor * journey.accelTime) *
-                    (journey.expFactor * (u - journey.accelTime) + 1.0) - 1.0;
+                v.normalize();
+                if (t < 0.5)
+                    p = journey.from.offsetKm(v * x);
+                else
+                    p = journey.to.offsetKm(-v * x);
             }
-
-            if (journey.traj == Linear)
+        }
+        else if (journey.traj == GreatCircle)
+        {
+            Selection centerObj = frame->getRefObject();
+            if (centerObj.body() != nullptr)
             {
-                Vector3d v = jv;
-                if (v.norm() == 0.0)
-                {
-                    p = journey.from;
-                }
-                else
+                const Body* body = centerObj.body();
+                if (body->getSystem())
                 {
-                    v.normalize();
-                    if (t < 0.5)
-                        p = journey.from.offsetKm(v * x);
+                    if (body->getSystem()->getPrimaryBody() != nullptr)
+                        centerObj = Selection(body->getSystem()->getPrimaryBody());
                     else
-                        p = journey.to.offsetKm(-v * x);
+                        centerObj = Selection(body->getSystem()->getStar());
                 }
             }
-            else if (journey.traj == GreatCircle)
-            {
-                Selection centerObj = frame->getRefObject();
-                if (centerObj.body() != nullptr)
-                {
-                    const Body* body = centerObj.body();
-                    if (body->getSystem())
-                    {
-                        if (body->getSystem()->getPrimaryBody() != nullptr)
-                            centerObj = Selection(body->getSystem()->getPrimaryBody());
-                        else
-                            centerObj = Selection(body->getSystem()->getStar());
-                    }
-                }
 
-                UniversalCoord ufrom  = frame->convertToUniversal(journey.from, simTime);
-                UniversalCoord uto    = frame->convertToUniversal(journey.to, simTime);
-                UniversalCoord origin = centerObj.getPosition(simTime);
-                Vector3d v0 = ufrom.offsetFromKm(origin);
-                Vector3d v1 = uto.offsetFromKm(origin);
+            UniversalCoord ufrom  = frame->convertToUniversal(journey.from, simTime);
+            UniversalCoord uto    = frame->convertToUniversal(journey.to, simTime);
+            UniversalCoord origin = centerObj.getPosition(simTime);
+            Vector3d v0 = ufrom.offsetFromKm(origin);
+            Vector3d v1 = uto.offsetFromKm(origin);
 
-                if (jv.norm() == 0.0)
-                {
-                    p = journey.from;
-                }
-                else
-                {
-                    x /= jv.norm();
-                    Vector3d v;
+            if (jv.norm() == 0.0)
+            {
+                p = journey.from;
+            }
+            else
+            {
+                x /= jv.norm();
+                Vector3d v;
 
-                    if (t < 0.5)
-                        v = slerp(x, v0, v1);
-                    else
-                        v = slerp(x, v1, v0);
+                if (t < 0.5)
+                    v = slerp(x, v0, v1);
+                else
+                    v = slerp(x, v1, v0);
 
-                    p = frame->convertFromUniversal(origin.offsetKm(v), simTime);
-                }
+                p = frame->convertFromUniversal(origin.offsetKm(v), simTime);
             }
-            else if (journey.traj == CircularOrbit)
-            {
-                Selection centerObj = frame->getRefObject();
+        }
+        else if (journey.traj == CircularOrbit)
+        {
+            Selection centerObj = frame->getRefObject();
 
-                UniversalCoord ufrom = frame->convertToUniversal(journey.from, simTime);
-                //UniversalCoord uto   = frame->convertToUniversal(journey.to, simTime);
-                UniversalCoord origin = centerObj.getPosition(simTime);
+            UniversalCoord ufrom = frame->convertToUniversal(journey.from, simTime);
+            //UniversalCoord uto   = frame->convertToUniversal(journey.to, simTime);
+            UniversalCoord origin = centerObj.getPosition(simTime);
 
-                Vector3d v0 = ufrom.offsetFromKm(origin);
-                //Vector3d v1 = uto.offsetFromKm(origin);
+            Vector3d v0 = ufrom.offsetFromKm(origin);
+            //Vector3d v1 = uto.offsetFromKm(origin);
 
-                if (jv.norm() == 0.0)
-                {
-                    p = journey.from;
-                }
-                else
-                {
-                    Quaterniond q0(Quaterniond::Identity());
-                    Quaterniond q1 = journey.rotation1;
-                    p = origin.offsetKm(q0.slerp(t, q1).conjugate() * v0);
-                    p = frame->convertFromUniversal(p, simTime);
-                }
+            if (jv.norm() == 0.0)
+            {
+                p = journey.from;
+            }
+            else
+            {
+                Quaterniond q0(Quaterniond::Identity());
+                Quaterniond q1 = journey.rotation1;
+                p = origin.offsetKm(q0.slerp(t, q1).conjugate() * v0);
+                p = frame->convertFromUniversal(p, simTime);
             }
         }
+    }
+
+    return p;
+}
+
+
+/*! Estimate where the observer will be dt seconds of real time from now,
+ *  following the journey in progress or the current velocity.
+ */
+UniversalCoord Observer::predictPosition(double dt) const
+{
+    if (observerMode == Travelling)
+    {
+        double t = 1.0;
+        if (journey.duration > 0)
+            t = std::clamp((realTime + dt - journey.startTime) / journey.duration, 0.0, 1.0);
+        return frame->convertToUniversal(getJourneyPosition(t), simTime);
+    }
+
+    return frame->convertToUniversal(position.offsetKm(getVelocity() * dt), simTime);
+}
+
+
+/*! Tick the simulation by dt seconds. Update the observer position
+ *  and orientation due to an active goto command or non-zero velocity
+ *  or angular velocity.
+ */
+void Observer::update(double dt, double timeScale)
+{
+    realTime += dt;
+    simTime += (dt / 86400.0) * timeScale;
+
+    simTime = std::clamp(simTime, minimumSimTime, maximumSimTime);
+
+    if (observerMode == Travelling)
+    {
+        // Compute the fraction of the trip that has elapsed; handle zero
+        // durations correctly by skipping directly to the destination.
+        double t = 1.0;
+        if (journey.duration > 0)
+            t = std::clamp((realTime - journey.startTime) / journey.duration, 0.0, 1.0);
+
+        UniversalCoord p = getJourneyPosition(t);
 
         // Spherically interpolate the orientation over the first half
         // of the journey.
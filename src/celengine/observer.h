@@ -134,6 +134,7 @@ public:
 
     Eigen::Vector3d getVelocity() const;
     void          setVelocity(const Eigen::Vector3d&);
+    UniversalCoord predictPosition(double dt) const;
     Eigen::Vector3d getAngularVelocity() const;
     void          setAngularVelocity(const Eigen::Vector3d&);
 
@@ -288,6 +289,7 @@ public:
                                    JourneyParams &jparams,
                                    double centerTime);
 
+    UniversalCoord getJourneyPosition(double t) const;
     void setOriginalOrientation(const Eigen::Quaternionf&);
     void setOriginalOrientation(const Eigen::Quaterniond&);
     void updateUniversal();
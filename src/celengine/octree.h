@@ -15,6 +15,10 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <celengine/observer.h>
+#include <celutil/threadpool.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 // The DynamicOctree and StaticOctree template arguments are:
@@ -24,6 +28,11 @@
 // OBJ's limiting property defined by the octree particular specialization: ie. we use [absolute magnitude] for star octrees, etc.
 // For details, see notes below.
 
+// Summary of all the objects in an octree node and its children, used to
+// treat a distant node as a single object. Only defined for octree types
+// which support it.
+template <class OBJ, class PREC> struct OctreeNodeAggregate;
+
 template <class OBJ, class PREC> class OctreeProcessor
 {
  public:
@@ -31,6 +40,15 @@ template <class OBJ, class PREC> class OctreeProcessor
     virtual ~OctreeProcessor() {};
 
     virtual void process(const OBJ& obj, PREC distance, float appMag) = 0;
+
+    // Traversals that have node aggregates available pass a node to
+    // processAggregate() instead of visiting its contents when the ratio of
+    // the node's bounding radius to its distance is below this value. The
+    // default of zero never aggregates.
+    virtual PREC aggregateThreshold() const { return 0; }
+    virtual void processAggregate(const OctreeNodeAggregate<OBJ, PREC>& /*aggregate*/,
+                                  PREC /*distance*/,
+                                  float /*appMag*/) {};
 };
 
 
@@ -44,6 +62,19 @@ struct OctreeLevelStatistics
 
 
 template <class OBJ, class PREC> class StaticOctree;
+
+// Packed copies of the object properties read during culling, stored in the
+// same order as the sorted object array so that the objects of each node form
+// a contiguous range that can be tested several objects at a time. Only
+// defined for octree types which provide a vectorized traversal.
+template <class OBJ, class PREC> struct OctreeCullingData;
+
+// Traversals of the static tree templated on the processor type, so that
+// processors whose type is known at compile time are not called through
+// OctreeProcessor's virtual functions. Only defined for octree types which
+// provide them.
+template <class OBJ, class PREC> struct OctreeTraversal;
+
 template <class OBJ, class PREC> class DynamicOctree
 {
 public:
@@ -63,7 +94,18 @@ private:
     ~DynamicOctree();
 
     void insertObject  (const OBJ&, const PREC);
-    void rebuildAndSort(StaticOctree<OBJ, PREC>*&, OBJ*&);
+    // Builds the static tree into nodes, which is cleared first; the root
+    // ends up as nodes.front().
+    void rebuildAndSort(std::vector<StaticOctree<OBJ, PREC>>& nodes, OBJ*& sortedObjects);
+    // Builds the same static tree and object order as inserting objects one
+    // after the other into this empty node with the given scale and calling
+    // rebuildAndSort, without creating the dynamic nodes: the objects are
+    // partitioned top-down and subtrees are built on the shared thread pool.
+    // objects is reordered; sortedObjects must have room for all of them.
+    void buildAndSort(std::vector<const OBJ*>&              objects,
+                      PREC                                  scale,
+                      std::vector<StaticOctree<OBJ, PREC>>& nodes,
+                      OBJ*                                  sortedObjects) const;
 
  private:
    static unsigned int SPLIT_THRESHOLD;
@@ -76,7 +118,35 @@ private:
     void           add  (const OBJ&);
     void           split(const PREC);
     void           sortIntoChildNodes();
-    DynamicOctree* getChild(const OBJ&, const Eigen::Matrix<PREC, 3, 1>&);
+    DynamicOctree* getChild(const OBJ& obj, const Eigen::Matrix<PREC, 3, 1>& center) { return _children[getChildIndex(obj, center)]; }
+    void           rebuildNode(std::vector<StaticOctree<OBJ, PREC>>&, std::size_t, OBJ*&) const;
+
+    static int     getChildIndex(const OBJ&, const Eigen::Matrix<PREC, 3, 1>&);
+
+    // A node of the tree built by buildAndSort, which owns the range
+    // [first, first + count) of the object list for itself and its
+    // descendants. The first bulkCount objects were moved into it when its
+    // parent was split, so they didn't go through the split test.
+    struct BuildNode
+    {
+        PointType   cellCenterPos;
+        PREC        exclusionFactor;
+        PREC        scale;
+        std::size_t first;
+        std::size_t count;
+        std::size_t bulkCount;
+    };
+
+    struct BuildState
+    {
+        const OBJ**   objects;
+        const OBJ**   scratch;
+        std::uint8_t* groups;
+        OBJ*          sortedObjects;
+    };
+
+    static bool        partitionNode(const BuildState&, const BuildNode&, std::size_t&, BuildNode*);
+    static std::size_t buildSubtree(const BuildState&, const BuildNode&, std::vector<StaticOctree<OBJ, PREC>>&);
 
     DynamicOctree**            _children;
     Eigen::Matrix<PREC, 3, 1>  cellCenterPos;
@@ -100,16 +170,52 @@ template<> unsigned int DynamicOctree<DeepSkyObject*, double>::SPLIT_THRESHOLD;
 template <class OBJ, class PREC> class StaticOctree
 {
  friend class DynamicOctree<OBJ, PREC>;
+ friend struct OctreeCullingData<OBJ, PREC>;
+ friend struct OctreeTraversal<OBJ, PREC>;
 
  public:
     typedef Eigen::Matrix<PREC, 3, 1> PointType;
 
+    // A node together with its scale, used to hand off parts of a traversal.
+    struct Subtree
+    {
+        const StaticOctree* node;
+        PREC                scale;
+    };
+
+    // A range of the sorted object array, as an offset and a count.
+    struct ObjectRange
+    {
+        std::uint32_t first;
+        std::uint32_t count;
+    };
+
+    // A node of a pre-order node list together with its scale; end is the
+    // index in the list one past the last descendant of the node.
+    struct NodeListEntry
+    {
+        const StaticOctree* node;
+        PREC                scale;
+        std::uint32_t       end;
+    };
+
+    // Node description used to store the tree in a file. Nodes are listed in
+    // the same order as in the node array, with objects referred to by their
+    // index in the sorted object array.
+    struct FlatNode
+    {
+        PointType     cellCenterPos;
+        float         exclusionFactor;
+        std::uint32_t firstObject;
+        std::uint32_t nObjects;
+        std::uint32_t childOffset;
+    };
+
  public:
     StaticOctree(const PointType&    cellCenterPos,
                  const float         exclusionFactor,
                  OBJ*                _firstObject,
                  unsigned int        nObjects);
-    ~StaticOctree();
 
     // These methods are only declared at the template level; we'll implement them as
     // full specializations, allowing for different traversal strategies depending on the
@@ -128,25 +234,112 @@ template <class OBJ, class PREC> class StaticOctree
                                float                             limitingFactor,
                                PREC                              scale) const;
 
+    // Same as above, but only the first maxDepth levels of the tree are
+    // traversed. The visible nodes at depth maxDepth are appended to
+    // subtrees rather than processed, so that the caller can traverse them
+    // independently, e.g. on multiple threads. If cullingData is not null,
+    // it must describe the object array and node array this octree was
+    // sorted into. It is used to test the objects of each node in batches
+    // and to provide node aggregates, see OctreeProcessor.
+    void processVisibleObjects(OctreeProcessor<OBJ, PREC>&         processor,
+                               const PointType&                    obsPosition,
+                               const Eigen::Hyperplane<PREC, 3>*   frustumPlanes,
+                               float                               limitingFactor,
+                               PREC                                scale,
+                               unsigned int                        maxDepth,
+                               std::vector<Subtree>&               subtrees,
+                               const OctreeCullingData<OBJ, PREC>* cullingData) const;
+
     void processCloseObjects(OctreeProcessor<OBJ, PREC>&        processor,
                              const PointType&                   obsPosition,
                              PREC                               boundingRadius,
                              PREC                               scale) const;
 
+    // Performs the node level tests of processVisibleObjects but leaves the
+    // objects themselves untested: the objects of every node that is reached
+    // are appended to ranges, as offsets from firstObject. Ranges of nodes
+    // stored next to each other are merged.
+    void processVisibleNodes(std::vector<ObjectRange>&          ranges,
+                             const OBJ*                         firstObject,
+                             const PointType&                   obsPosition,
+                             const Eigen::Hyperplane<PREC, 3>*  frustumPlanes,
+                             float                              limitingFactor,
+                             PREC                               scale) const;
+
+    // Appends the nodes which processVisibleObjects may reach to nodes, in
+    // pre-order. The test is conservative: the observer may be up to
+    // distanceMargin away from obsPosition, objects on the boundary of the
+    // frustum are kept and nodes are never treated as aggregates. Only the
+    // first four frustum planes are used, so they may be widened to cover
+    // a range of view directions.
+    void collectVisibleNodes(std::vector<NodeListEntry>&       nodes,
+                             const PointType&                  obsPosition,
+                             const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                             float                             limitingFactor,
+                             PREC                              scale,
+                             PREC                              distanceMargin) const;
+
+    // Processes the objects of this node alone, as processVisibleObjects
+    // would. Returns true if the children of the node need to be visited.
+    bool processNodeObjects(OctreeProcessor<OBJ, PREC>&         processor,
+                            const PointType&                    obsPosition,
+                            const Eigen::Hyperplane<PREC, 3>*   frustumPlanes,
+                            float                               limitingFactor,
+                            PREC                                scale,
+                            const OctreeCullingData<OBJ, PREC>* cullingData) const;
+
     int countChildren() const;
     int countObjects()  const;
 
     void computeStatistics(std::vector<OctreeLevelStatistics>& stats, unsigned int level = 0);
 
+    bool hasChildren() const { return childOffset != 0; }
+    // The objects stored in this node itself, not counting its children, as
+    // an offset from firstObject.
+    ObjectRange objectRange(const OBJ* firstObject) const
+    {
+        return { static_cast<std::uint32_t>(_firstObject - firstObject), nObjects };
+    }
+
+    // Distance by which the objects of the subtree may lie outside the cell
+    // of this node, because they have moved since the tree was built. It is
+    // added to the bounding radius of the node by the traversals, so it must
+    // be at least as large as the margin of any child. Only the star octree
+    // traversals use it.
+    PREC getBoundsMargin() const { return boundsMargin; }
+    void setBoundsMargin(PREC margin) { boundsMargin = margin; }
+
+    // The eight children of a node are stored next to each other in the node
+    // array, childOffset entries after the node itself.
+    const StaticOctree* child(int i) const { return this + childOffset + i; }
+    StaticOctree* child(int i) { return this + childOffset + i; }
+
+    // Converts a node array built by DynamicOctree::rebuildAndSort into the
+    // file representation, see FlatNode.
+    static void flatten(const std::vector<StaticOctree>& nodes,
+                        const OBJ*                       firstObject,
+                        std::vector<FlatNode>&           flatNodes);
+
+    // Recreates a node array from the output of flatten(). The objects must
+    // already be sorted and stored at firstObject. Returns false if a node
+    // refers to children outside of the list, or to objects outside of
+    // [0, nObjectsTotal).
+    static bool unflatten(const FlatNode*            flatNodes,
+                          std::size_t                nFlatNodes,
+                          OBJ*                       firstObject,
+                          std::uint32_t              nObjectsTotal,
+                          std::vector<StaticOctree>& nodes);
+
  private:
     static const PREC SQRT3;
 
  private:
-    StaticOctree** _children;
+    std::uint32_t  childOffset;
     Eigen::Matrix<PREC, 3, 1>   cellCenterPos;
     float          exclusionFactor;
     OBJ*           _firstObject;
     unsigned int   nObjects;
+    PREC           boundsMargin{ 0 };
 };
 
 
@@ -299,7 +492,21 @@ inline void DynamicOctree<OBJ, PREC>::sortIntoChildNodes()
 
 
 template <class OBJ, class PREC>
-inline void DynamicOctree<OBJ, PREC>::rebuildAndSort(StaticOctree<OBJ, PREC>*& _staticNode, OBJ*& _sortedObjects)
+inline void DynamicOctree<OBJ, PREC>::rebuildAndSort(std::vector<StaticOctree<OBJ, PREC>>& nodes, OBJ*& _sortedObjects)
+{
+    nodes.clear();
+    nodes.emplace_back(cellCenterPos, exclusionFactor, _sortedObjects, 0);
+    rebuildNode(nodes, 0, _sortedObjects);
+}
+
+
+// The children of a node are allocated as one block before descending into
+// them, so sibling blocks are laid out in depth-first order. Nodes are
+// addressed by index as the array grows while the tree is built.
+template <class OBJ, class PREC>
+inline void DynamicOctree<OBJ, PREC>::rebuildNode(std::vector<StaticOctree<OBJ, PREC>>& nodes,
+                                                  std::size_t index,
+                                                  OBJ*& _sortedObjects) const
 {
     OBJ* _firstObject = _sortedObjects;
 
@@ -309,15 +516,236 @@ inline void DynamicOctree<OBJ, PREC>::rebuildAndSort(StaticOctree<OBJ, PREC>*& _
             *_sortedObjects++ = **iter;
         }
 
-    unsigned int nObjects  = (unsigned int) (_sortedObjects - _firstObject);
-    _staticNode            = new StaticOctree<OBJ, PREC>(cellCenterPos, exclusionFactor, _firstObject, nObjects);
+    nodes[index]._firstObject = _firstObject;
+    nodes[index].nObjects     = (unsigned int) (_sortedObjects - _firstObject);
 
     if (_children != nullptr)
     {
-        _staticNode->_children    = new StaticOctree<OBJ, PREC>*[8];
+        std::size_t childIndex   = nodes.size();
+        nodes[index].childOffset = static_cast<std::uint32_t>(childIndex - index);
+
+        for (int i=0; i<8; ++i)
+            nodes.emplace_back(_children[i]->cellCenterPos, _children[i]->exclusionFactor, nullptr, 0);
 
         for (int i=0; i<8; ++i)
-            _children[i]->rebuildAndSort(_staticNode->_children[i], _sortedObjects);
+            _children[i]->rebuildNode(nodes, childIndex + i, _sortedObjects);
+    }
+}
+
+
+// Insertion only ever splits a node when an object that fits into a child
+// arrives at it with at least SPLIT_THRESHOLD objects already there, which
+// moves those that fit into a child below it at once. So a node is split iff
+// such an object is found at an index of at least SPLIT_THRESHOLD among the
+// ones it received, not counting those moved in by its parent's split. The
+// objects kept in the node are followed by those of each child, all in
+// insertion order, which is also the order rebuildNode sorts them in.
+template <class OBJ, class PREC>
+inline bool DynamicOctree<OBJ, PREC>::partitionNode(const BuildState& state,
+                                                    const BuildNode&  node,
+                                                    std::size_t&      nKept,
+                                                    BuildNode*        children)
+{
+    constexpr std::uint8_t Kept = 8;
+
+    const OBJ** objects   = state.objects + node.first;
+    std::uint8_t* groups  = state.groups + node.first;
+    std::size_t splitIndex = node.count;
+    std::size_t counts[9] = {};
+    std::size_t bulkCounts[8] = {};
+
+    for (std::size_t i = 0; i < node.count; ++i)
+    {
+        const OBJ& obj = *objects[i];
+        std::uint8_t group = Kept;
+        if (!limitingFactorPredicate(obj, node.exclusionFactor) &&
+            !straddlingPredicate(node.cellCenterPos, obj, node.exclusionFactor))
+        {
+            group = static_cast<std::uint8_t>(getChildIndex(obj, node.cellCenterPos));
+            if (splitIndex == node.count && i >= node.bulkCount && i >= SPLIT_THRESHOLD)
+            {
+                splitIndex = i;
+                std::copy(counts, counts + 8, bulkCounts);
+            }
+        }
+
+        groups[i] = group;
+        ++counts[group];
+    }
+
+    if (splitIndex == node.count)
+        return false;
+
+    std::size_t offsets[9];
+    offsets[Kept] = 0;
+    for (int i = 0; i < 8; ++i)
+        offsets[i] = (i == 0 ? counts[Kept] : offsets[i - 1] + counts[i - 1]);
+
+    nKept = counts[Kept];
+    const PREC childScale = node.scale * 0.5f;
+    const PREC childExclusionFactor = static_cast<float>(decayFunction(node.exclusionFactor));
+    for (int i = 0; i < 8; ++i)
+    {
+        PointType centerPos = node.cellCenterPos;
+        centerPos += PointType(((i & XPos) != 0) ? childScale : -childScale,
+                               ((i & YPos) != 0) ? childScale : -childScale,
+                               ((i & ZPos) != 0) ? childScale : -childScale);
+        children[i] = { centerPos, childExclusionFactor, childScale,
+                        node.first + offsets[i], counts[i], bulkCounts[i] };
+    }
+
+    const OBJ** scratch = state.scratch + node.first;
+    for (std::size_t i = 0; i < node.count; ++i)
+        scratch[offsets[groups[i]]++] = objects[i];
+    std::copy(scratch, scratch + node.count, objects);
+
+    return true;
+}
+
+
+// Appends the nodes below node to nodes in the order rebuildNode creates
+// them in, with offsets relative to the start of nodes. Returns the number
+// of objects kept in node itself.
+template <class OBJ, class PREC>
+inline std::size_t DynamicOctree<OBJ, PREC>::buildSubtree(const BuildState&                     state,
+                                                          const BuildNode&                      node,
+                                                          std::vector<StaticOctree<OBJ, PREC>>& nodes)
+{
+    std::size_t nKept;
+    BuildNode children[8];
+    if (!partitionNode(state, node, nKept, children))
+        return node.count;
+
+    std::size_t childIndex = nodes.size();
+    for (const BuildNode& child : children)
+        nodes.emplace_back(child.cellCenterPos, child.exclusionFactor, state.sortedObjects + child.first, 0);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        std::size_t start = nodes.size();
+        std::size_t nChildObjects = buildSubtree(state, children[i], nodes);
+        nodes[childIndex + i].nObjects = static_cast<unsigned int>(nChildObjects);
+        if (nodes.size() != start)
+            nodes[childIndex + i].childOffset = static_cast<std::uint32_t>(start - (childIndex + i));
+    }
+
+    return nKept;
+}
+
+
+// The top of the tree is partitioned on the calling thread until the nodes
+// are small enough to be handed to tasks. Every task builds the nodes below
+// its subtree into a list of its own, and the lists are then spliced into
+// the node array where rebuildNode would have placed them.
+template <class OBJ, class PREC>
+void DynamicOctree<OBJ, PREC>::buildAndSort(std::vector<const OBJ*>&              objects,
+                                            PREC                                  scale,
+                                            std::vector<StaticOctree<OBJ, PREC>>& nodes,
+                                            OBJ*                                  sortedObjects) const
+{
+    constexpr std::size_t NoIndex = ~static_cast<std::size_t>(0);
+
+    struct TopNode
+    {
+        BuildNode   node;
+        std::size_t nObjects;
+        std::size_t firstChild;
+        std::size_t task;
+    };
+
+    struct TaskResult
+    {
+        std::size_t                          nObjects;
+        std::vector<StaticOctree<OBJ, PREC>> nodes;
+    };
+
+    std::vector<const OBJ*> scratch(objects.size());
+    std::vector<std::uint8_t> groups(objects.size());
+    const BuildState state{ objects.data(), scratch.data(), groups.data(), sortedObjects };
+
+    auto& threadPool = celestia::util::ThreadPool::shared();
+    const std::size_t taskSize = std::max(objects.size() / (threadPool.concurrency() * 16),
+                                          static_cast<std::size_t>(4096));
+
+    std::vector<TopNode> topNodes;
+    topNodes.push_back({ { cellCenterPos, exclusionFactor, scale, 0, objects.size(), 0 }, 0, NoIndex, NoIndex });
+    std::vector<std::size_t> tasks;
+    for (std::size_t i = 0; i < topNodes.size(); ++i)
+    {
+        if (topNodes[i].node.count <= taskSize)
+        {
+            topNodes[i].task = tasks.size();
+            tasks.push_back(i);
+            continue;
+        }
+
+        std::size_t nKept;
+        BuildNode children[8];
+        if (!partitionNode(state, topNodes[i].node, nKept, children))
+        {
+            topNodes[i].nObjects = topNodes[i].node.count;
+            continue;
+        }
+
+        topNodes[i].nObjects = nKept;
+        topNodes[i].firstChild = topNodes.size();
+        for (const BuildNode& child : children)
+            topNodes.push_back({ child, 0, NoIndex, NoIndex });
+    }
+
+    std::vector<TaskResult> results(tasks.size());
+    threadPool.parallelFor(tasks.size(), [&](std::size_t task, unsigned int)
+    {
+        results[task].nObjects = buildSubtree(state, topNodes[tasks[task]].node, results[task].nodes);
+    });
+
+    // The object list is now in its final order
+    constexpr std::size_t CopyBlockSize = 65536;
+    threadPool.parallelFor((objects.size() + CopyBlockSize - 1) / CopyBlockSize, [&](std::size_t block, unsigned int)
+    {
+        std::size_t end = std::min(objects.size(), (block + 1) * CopyBlockSize);
+        for (std::size_t i = block * CopyBlockSize; i < end; ++i)
+            sortedObjects[i] = *objects[i];
+    });
+
+    nodes.clear();
+    nodes.emplace_back(cellCenterPos, exclusionFactor, sortedObjects, 0);
+
+    // Depth-first over the top nodes, each paired with its slot in nodes
+    std::vector<std::pair<std::size_t, std::size_t>> stack{ { 0, 0 } };
+    while (!stack.empty())
+    {
+        auto [topIndex, index] = stack.back();
+        stack.pop_back();
+        const TopNode& topNode = topNodes[topIndex];
+
+        if (topNode.task != NoIndex)
+        {
+            TaskResult& result = results[topNode.task];
+            nodes[index].nObjects = static_cast<unsigned int>(result.nObjects);
+            if (!result.nodes.empty())
+            {
+                nodes[index].childOffset = static_cast<std::uint32_t>(nodes.size() - index);
+                nodes.insert(nodes.end(), result.nodes.begin(), result.nodes.end());
+                result.nodes = {};
+            }
+            continue;
+        }
+
+        nodes[index].nObjects = static_cast<unsigned int>(topNode.nObjects);
+        if (topNode.firstChild == NoIndex)
+            continue;
+
+        std::size_t childIndex = nodes.size();
+        nodes[index].childOffset = static_cast<std::uint32_t>(childIndex - index);
+        for (int i = 0; i < 8; ++i)
+        {
+            const BuildNode& child = topNodes[topNode.firstChild + i].node;
+            nodes.emplace_back(child.cellCenterPos, child.exclusionFactor, sortedObjects + child.first, 0);
+        }
+
+        for (int i = 7; i >= 0; --i)
+            stack.emplace_back(topNode.firstChild + i, childIndex + i);
     }
 }
 
@@ -332,7 +760,7 @@ inline StaticOctree<OBJ, PREC>::StaticOctree(const Eigen::Matrix<PREC, 3, 1>& ce
                                              const float         exclusionFactor,
                                              OBJ*                _firstObject,
                                              unsigned int        nObjects):
-    _children      (nullptr),
+    childOffset    (0),
     cellCenterPos  (cellCenterPos),
     exclusionFactor(exclusionFactor),
     _firstObject   (_firstObject),
@@ -341,26 +769,13 @@ inline StaticOctree<OBJ, PREC>::StaticOctree(const Eigen::Matrix<PREC, 3, 1>& ce
 }
 
 
-template <class OBJ, class PREC>
-inline StaticOctree<OBJ, PREC>::~StaticOctree()
-{
-    if (_children != nullptr)
-    {
-        for (int i = 0; i < 8; ++i)
-            delete _children[i];
-
-        delete[] _children;
-    }
-}
-
-
 template <class OBJ, class PREC>
 inline int StaticOctree<OBJ, PREC>::countChildren() const
 {
     int count    = 0;
 
     for (int i = 0; i < 8; ++i)
-        count    += _children != nullptr ? 1 + _children[i]->countChildren() : 0;
+        count    += hasChildren() ? 1 + child(i)->countChildren() : 0;
 
     return count;
 }
@@ -371,9 +786,9 @@ inline int StaticOctree<OBJ, PREC>::countObjects() const
 {
     int count    = nObjects;
 
-    if (_children != nullptr)
+    if (hasChildren())
         for (int i = 0; i < 8; ++i)
-            count    += _children[i]->countObjects();
+            count    += child(i)->countObjects();
 
     return count;
 }
@@ -398,9 +813,60 @@ void StaticOctree<OBJ, PREC>::computeStatistics(std::vector<OctreeLevelStatistic
     stats[level].objectCount += nObjects;
     stats[level].size = 0.0;
 
-    if (_children != nullptr)
+    if (hasChildren())
     {
         for (int i = 0; i < 8; i++)
-            _children[i]->computeStatistics(stats, level + 1);
+            child(i)->computeStatistics(stats, level + 1);
     }
 }
+
+
+template <class OBJ, class PREC>
+void StaticOctree<OBJ, PREC>::flatten(const std::vector<StaticOctree>& nodes,
+                                      const OBJ*                       firstObject,
+                                      std::vector<FlatNode>&           flatNodes)
+{
+    flatNodes.reserve(flatNodes.size() + nodes.size());
+    for (const StaticOctree& node : nodes)
+    {
+        flatNodes.push_back({ node.cellCenterPos,
+                              node.exclusionFactor,
+                              static_cast<std::uint32_t>(node._firstObject - firstObject),
+                              node.nObjects,
+                              node.childOffset });
+    }
+}
+
+
+template <class OBJ, class PREC>
+bool
+StaticOctree<OBJ, PREC>::unflatten(const FlatNode*            flatNodes,
+                                   std::size_t                nFlatNodes,
+                                   OBJ*                       firstObject,
+                                   std::uint32_t              nObjectsTotal,
+                                   std::vector<StaticOctree>& nodes)
+{
+    nodes.clear();
+    if (nFlatNodes == 0)
+        return false;
+
+    nodes.reserve(nFlatNodes);
+    for (std::size_t i = 0; i < nFlatNodes; ++i)
+    {
+        const FlatNode& flatNode = flatNodes[i];
+        if (flatNode.firstObject > nObjectsTotal || flatNode.nObjects > nObjectsTotal - flatNode.firstObject)
+            return false;
+
+        // Children always follow their parent, so traversals cannot loop
+        if (flatNode.childOffset != 0 && (flatNode.childOffset > nFlatNodes - i || nFlatNodes - i - flatNode.childOffset < 8))
+            return false;
+
+        StaticOctree& node = nodes.emplace_back(flatNode.cellCenterPos,
+                                                flatNode.exclusionFactor,
+                                                firstObject + flatNode.firstObject,
+                                                flatNode.nObjects);
+        node.childOffset = flatNode.childOffset;
+    }
+
+    return true;
+}
@@ -0,0 +1,89 @@
+// orbitpathcache.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "orbitpathcache.h"
+
+#include <utility>
+
+#include "curveplot.h"
+
+namespace celestia::engine
+{
+
+OrbitPathCache::OrbitPathCache(std::size_t budget) :
+    m_budget(budget)
+{
+}
+
+OrbitPathCache::~OrbitPathCache() = default;
+
+CurvePlot*
+OrbitPathCache::find(const ephem::Orbit* orbit, std::uint32_t frame)
+{
+    auto it = m_index.find(orbit);
+    if (it == m_index.end())
+        return nullptr;
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    CurvePlot* path = it->second->path.get();
+    path->setLastUsed(frame);
+    return path;
+}
+
+CurvePlot*
+OrbitPathCache::insert(const ephem::Orbit* orbit, std::unique_ptr<CurvePlot>&& path, std::uint32_t frame)
+{
+    path->setLastUsed(frame);
+    if (auto it = m_index.find(orbit); it != m_index.end())
+    {
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        it->second->path = std::move(path);
+        return it->second->path.get();
+    }
+
+    m_entries.push_front({ orbit, std::move(path) });
+    m_index.try_emplace(orbit, m_entries.begin());
+    return m_entries.front().path.get();
+}
+
+void
+OrbitPathCache::trim(std::uint32_t keepSince)
+{
+    // Paths change size as they are resampled and refined, so the total is
+    // recomputed each time
+    std::size_t total = memoryUsage();
+    while (total > m_budget && !m_entries.empty())
+    {
+        const Entry& oldest = m_entries.back();
+        if (oldest.path->lastUsed() >= keepSince)
+            break;
+
+        total -= oldest.path->memoryUsage();
+        m_index.erase(oldest.orbit);
+        m_entries.pop_back();
+    }
+}
+
+void
+OrbitPathCache::clear()
+{
+    m_index.clear();
+    m_entries.clear();
+}
+
+std::size_t
+OrbitPathCache::memoryUsage() const
+{
+    std::size_t total = 0;
+    for (const Entry& entry : m_entries)
+        total += entry.path->memoryUsage();
+    return total;
+}
+
+} // end namespace celestia::engine
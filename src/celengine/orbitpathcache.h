@@ -0,0 +1,73 @@
+// orbitpathcache.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Cache of the sampled paths of orbits.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+class CurvePlot;
+
+namespace celestia::ephem
+{
+class Orbit;
+}
+
+namespace celestia::engine
+{
+
+// The paths drawn for orbits that aren't drawn as ellipses, kept between
+// frames since sampling them is expensive. When the samples take more
+// memory than the budget, the least recently used paths are dropped, but
+// never those drawn in the last frames, so that a view with more orbits
+// than fit into the budget doesn't resample them every frame.
+class OrbitPathCache
+{
+public:
+    static constexpr std::size_t DefaultBudget = 32 * 1024 * 1024;
+
+    explicit OrbitPathCache(std::size_t budget = DefaultBudget);
+    ~OrbitPathCache();
+
+    OrbitPathCache(const OrbitPathCache&) = delete;
+    OrbitPathCache& operator=(const OrbitPathCache&) = delete;
+
+    // Returns the path of orbit, marked as used in frame, or nullptr if
+    // there is none
+    CurvePlot* find(const ephem::Orbit* orbit, std::uint32_t frame);
+    CurvePlot* insert(const ephem::Orbit* orbit, std::unique_ptr<CurvePlot>&& path, std::uint32_t frame);
+
+    // Drops the least recently used paths that weren't used since the frame
+    // keepSince until the cache fits into the budget
+    void trim(std::uint32_t keepSince);
+    void clear();
+
+    std::size_t memoryUsage() const;
+
+private:
+    struct Entry
+    {
+        const ephem::Orbit* orbit;
+        std::unique_ptr<CurvePlot> path;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    std::size_t m_budget;
+    // Most recently used first
+    EntryList m_entries;
+    std::unordered_map<const ephem::Orbit*, EntryList::iterator> m_index;
+};
+
+} // end namespace celestia::engine
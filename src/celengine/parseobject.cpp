@@ -240,10 +240,13 @@ CreateKeplerianOrbit(const Hash* orbitData,
  *     Source <string>
  *     Interpolation "Cubic" | "Linear"
  *     DoublePrecision <boolean>
+ *     CompressionTolerance <km>
  * } \endcode
  *
  * Source is the only required field. Interpolation defaults to cubic, and
- * DoublePrecision defaults to true.
+ * DoublePrecision defaults to true. A positive CompressionTolerance stores
+ * the positions of an xyz file compressed, within that distance of the
+ * file; DoublePrecision is then ignored.
  */
 std::shared_ptr<const ephem::Orbit>
 CreateSampledTrajectory(const Hash* trajData, const fs::path& path)
@@ -279,8 +282,15 @@ CreateSampledTrajectory(const Hash* trajData, const fs::path& path)
     bool useDoublePrecision = trajData->getBoolean("DoublePrecision").value_or(true);
     TrajectoryPrecision precision = useDoublePrecision ? TrajectoryPrecision::Double : TrajectoryPrecision::Single;
 
+    double tolerance = trajData->getLength<double>("CompressionTolerance").value_or(0.0);
+    if (tolerance < 0.0)
+    {
+        GetLogger()->warn("Negative CompressionTolerance for SampledTrajectory, ignoring it\n");
+        tolerance = 0.0;
+    }
+
     GetLogger()->verbose("Attempting to load sampled trajectory from source '{}'\n", *source);
-    auto orbit = engine::GetTrajectoryManager()->find(*sourceFile, path, interpolation, precision);
+    auto orbit = engine::GetTrajectoryManager()->find(*sourceFile, path, interpolation, precision, tolerance);
     if (orbit == nullptr)
         GetLogger()->error("Could not load sampled trajectory from '{}'\n", *source);
 
@@ -1814,3 +1824,50 @@ ReferenceFrame::SharedConstPtr CreateReferenceFrame(const Universe& universe,
 
     return CreateComplexFrame(universe, frameData, defaultCenter, defaultObserver);
 }
+
+std::vector<std::string_view>
+SplitCatalog(std::string_view text, std::size_t targetSize)
+{
+    std::vector<std::string_view> chunks;
+    std::size_t chunkStart = 0;
+    int depth = 0;
+    for (std::size_t i = 0; i < text.size(); ++i)
+    {
+        switch (text[i])
+        {
+        case '#':
+            i = text.find('\n', i);
+            if (i == std::string_view::npos)
+                i = text.size();
+            break;
+        case '"':
+            for (++i; i < text.size() && text[i] != '"'; ++i)
+            {
+                if (text[i] == '\\')
+                    ++i;
+            }
+            break;
+        case '{':
+            ++depth;
+            break;
+        case '}':
+            if (--depth < 0)
+                return {};
+            if (depth == 0 && i + 1 - chunkStart >= targetSize)
+            {
+                chunks.push_back(text.substr(chunkStart, i + 1 - chunkStart));
+                chunkStart = i + 1;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (depth != 0)
+        return {};
+
+    if (chunkStart < text.size())
+        chunks.push_back(text.substr(chunkStart));
+    return chunks;
+}
@@ -12,8 +12,10 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <string_view>
+#include <vector>
 
 #include <celcompat/filesystem.h>
 #include "frame.h"
@@ -40,6 +42,14 @@ enum class DataDisposition
 bool
 ParseDate(const AssociativeArray* hash, std::string_view name, double& jd);
 
+// Splits a catalog into chunks of roughly targetSize bytes, each holding
+// whole top-level objects. The scan follows the tokenizer's rules for
+// strings and comments closely enough to find the closing brace of each
+// object. Returns an empty list if the braces don't balance, in which case
+// the catalog is parsed serially to get the usual error messages.
+std::vector<std::string_view>
+SplitCatalog(std::string_view text, std::size_t targetSize);
+
 std::shared_ptr<const celestia::ephem::Orbit>
 CreateOrbit(const Selection& centralObject,
             const AssociativeArray* planetData,
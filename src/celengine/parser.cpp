@@ -7,6 +7,9 @@
 // modify it under the terms of the GNU General Public License
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
 #include <map>
 #include <string_view>
 #include <utility>
@@ -47,41 +50,37 @@ private:
 
 MeasurementUnit parseUnit(std::string_view name)
 {
-    static const std::map<std::string_view, MeasurementUnit>* unitMap = nullptr;
-
-    if (!unitMap)
+    // Initialized on first use; catalogs may be parsed on several threads
+    static const auto* unitMap = new std::map<std::string_view, MeasurementUnit>
     {
-        unitMap = new std::map<std::string_view, MeasurementUnit>
-        {
-            { "km"sv, astro::LengthUnit::Kilometer },
-            { "m"sv, astro::LengthUnit::Meter },
-            { "rE"sv, astro::LengthUnit::EarthRadius },
-            { "rJ"sv, astro::LengthUnit::JupiterRadius },
-            { "rS"sv, astro::LengthUnit::SolarRadius },
-            { "AU"sv, astro::LengthUnit::AstronomicalUnit },
-            { "ly"sv, astro::LengthUnit::LightYear },
-            { "pc"sv, astro::LengthUnit::Parsec },
-            { "kpc"sv, astro::LengthUnit::Kiloparsec },
-            { "Mpc"sv, astro::LengthUnit::Megaparsec },
-
-            { "s"sv, astro::TimeUnit::Second },
-            { "min"sv, astro::TimeUnit::Minute },
-            { "h"sv, astro::TimeUnit::Hour },
-            { "d"sv, astro::TimeUnit::Day },
-            { "y"sv, astro::TimeUnit::JulianYear },
-
-            { "mas"sv, astro::AngleUnit::Milliarcsecond },
-            { "arcsec"sv, astro::AngleUnit::Arcsecond },
-            { "arcmin"sv, astro::AngleUnit::Arcminute },
-            { "deg"sv, astro::AngleUnit::Degree },
-            { "hRA"sv, astro::AngleUnit::Hour },
-            { "rad"sv, astro::AngleUnit::Radian },
-
-            { "kg"sv, astro::MassUnit::Kilogram },
-            { "mE"sv, astro::MassUnit::EarthMass },
-            { "mJ"sv, astro::MassUnit::JupiterMass },
-        };
-    }
+        { "km"sv, astro::LengthUnit::Kilometer },
+        { "m"sv, astro::LengthUnit::Meter },
+        { "rE"sv, astro::LengthUnit::EarthRadius },
+        { "rJ"sv, astro::LengthUnit::JupiterRadius },
+        { "rS"sv, astro::LengthUnit::SolarRadius },
+        { "AU"sv, astro::LengthUnit::AstronomicalUnit },
+        { "ly"sv, astro::LengthUnit::LightYear },
+        { "pc"sv, astro::LengthUnit::Parsec },
+        { "kpc"sv, astro::LengthUnit::Kiloparsec },
+        { "Mpc"sv, astro::LengthUnit::Megaparsec },
+
+        { "s"sv, astro::TimeUnit::Second },
+        { "min"sv, astro::TimeUnit::Minute },
+        { "h"sv, astro::TimeUnit::Hour },
+        { "d"sv, astro::TimeUnit::Day },
+        { "y"sv, astro::TimeUnit::JulianYear },
+
+        { "mas"sv, astro::AngleUnit::Milliarcsecond },
+        { "arcsec"sv, astro::AngleUnit::Arcsecond },
+        { "arcmin"sv, astro::AngleUnit::Arcminute },
+        { "deg"sv, astro::AngleUnit::Degree },
+        { "hRA"sv, astro::AngleUnit::Hour },
+        { "rad"sv, astro::AngleUnit::Radian },
+
+        { "kg"sv, astro::MassUnit::Kilogram },
+        { "mE"sv, astro::MassUnit::EarthMass },
+        { "mJ"sv, astro::MassUnit::JupiterMass },
+    };
 
     auto it = unitMap->find(name);
     return it == unitMap->end()
@@ -134,12 +133,12 @@ std::unique_ptr<ValueArray> Parser::readArray()
         return nullptr;
     }
 
-    auto array = std::make_unique<ValueArray>();
+    const std::size_t base = arrayStack.size();
 
     Value v = readValue();
     while (!v.isNull())
     {
-        array->push_back(std::move(v));
+        arrayStack.push_back(std::move(v));
         v = readValue();
     }
 
@@ -147,9 +146,14 @@ std::unique_ptr<ValueArray> Parser::readArray()
     if (tok != Tokenizer::TokenEndArray)
     {
         tokenizer->pushBack();
+        arrayStack.resize(base);
         return nullptr;
     }
 
+    auto first = arrayStack.begin() + static_cast<std::ptrdiff_t>(base);
+    auto array = std::make_unique<ValueArray>(std::make_move_iterator(first),
+                                              std::make_move_iterator(arrayStack.end()));
+    arrayStack.erase(first, arrayStack.end());
     return array;
 }
 
@@ -163,7 +167,7 @@ std::unique_ptr<Hash> Parser::readHash()
         return nullptr;
     }
 
-    auto hash = std::make_unique<Hash>();
+    const std::size_t base = hashStack.size();
 
     tok = tokenizer->nextToken();
     while (tok != Tokenizer::TokenEndGroup)
@@ -176,6 +180,7 @@ std::unique_ptr<Hash> Parser::readHash()
         else
         {
             tokenizer->pushBack();
+            hashStack.resize(base);
             return nullptr;
         }
 
@@ -184,15 +189,29 @@ std::unique_ptr<Hash> Parser::readHash()
         Value value = readValue();
         if (value.isNull())
         {
+            hashStack.resize(base);
             return nullptr;
         }
 
         value.setUnits(units);
-        hash->addValue(std::move(name), std::move(value));
+        hashStack.push_back({ std::move(name), std::move(value) });
 
         tok = tokenizer->nextToken();
     }
 
+    // Stable insertion sort, so that the first of duplicate keys is kept as
+    // before; std::stable_sort would allocate a buffer for every hash.
+    auto first = hashStack.begin() + static_cast<std::ptrdiff_t>(base);
+    auto byKey = [](const HashItem& a, const HashItem& b) { return a.key < b.key; };
+    for (auto it = first; it != hashStack.end(); ++it)
+        std::rotate(std::upper_bound(first, it, *it, byKey), it, std::next(it));
+
+    auto hash = std::make_unique<Hash>();
+    hash->reserve(static_cast<std::size_t>(hashStack.end() - first));
+    for (auto it = first; it != hashStack.end(); ++it)
+        hash->addValue(std::move(it->key), std::move(it->value));
+
+    hashStack.erase(first, hashStack.end());
     return hash;
 }
 
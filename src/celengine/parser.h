@@ -11,6 +11,8 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "hash.h"
 #include "value.h"
@@ -26,8 +28,20 @@ class Parser
     Value readValue();
 
  private:
+    struct HashItem
+    {
+        std::string key;
+        Value value;
+    };
+
     Tokenizer* tokenizer;
 
+    // Items of the arrays and hashes being read, innermost last. They are
+    // collected here so that each array or hash is allocated once at its
+    // final size, and the storage is reused for all objects of a file.
+    std::vector<Value> arrayStack;
+    std::vector<HashItem> hashStack;
+
     std::unique_ptr<ValueArray> readArray();
     std::unique_ptr<Hash> readHash();
 };
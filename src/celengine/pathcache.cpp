@@ -0,0 +1,105 @@
+// pathcache.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "pathcache.h"
+
+#include <functional>
+#include <utility>
+
+namespace celestia::engine
+{
+
+bool
+PathCache::Key::operator==(const Key& other) const
+{
+    return i18n == other.i18n && path == other.path && contexts == other.contexts;
+}
+
+std::size_t
+PathCache::KeyHash::operator()(const Key& key) const
+{
+    std::size_t h = std::hash<std::string>()(key.path) ^ static_cast<std::size_t>(key.i18n);
+    for (const Selection& sel : key.contexts)
+        h = h * 31 + std::hash<Selection>()(sel);
+    return h;
+}
+
+PathCache::PathCache(std::size_t capacity) :
+    m_capacity(capacity)
+{
+}
+
+PathCache::Key
+PathCache::makeKey(std::string_view path,
+                   util::array_view<const Selection> contexts,
+                   bool i18n)
+{
+    return Key{ std::string(path), std::vector<Selection>(contexts.begin(), contexts.end()), i18n };
+}
+
+bool
+PathCache::find(std::string_view path,
+                util::array_view<const Selection> contexts,
+                bool i18n,
+                Selection& sel)
+{
+    auto iter = m_index.find(makeKey(path, contexts, i18n));
+    if (iter == m_index.end())
+    {
+        ++m_misses;
+        return false;
+    }
+
+    ++m_hits;
+    m_entries.splice(m_entries.begin(), m_entries, iter->second);
+    sel = iter->second->sel;
+    return true;
+}
+
+void
+PathCache::insert(std::string_view path,
+                  util::array_view<const Selection> contexts,
+                  bool i18n,
+                  const Selection& sel)
+{
+    if (m_capacity == 0)
+        return;
+
+    Key key = makeKey(path, contexts, i18n);
+    if (auto iter = m_index.find(key); iter != m_index.end())
+    {
+        iter->second->sel = sel;
+        m_entries.splice(m_entries.begin(), m_entries, iter->second);
+        return;
+    }
+
+    if (m_entries.size() >= m_capacity)
+    {
+        m_index.erase(m_entries.back().key);
+        m_entries.pop_back();
+    }
+
+    m_entries.push_front(Entry{ key, sel });
+    m_index.try_emplace(std::move(key), m_entries.begin());
+}
+
+void
+PathCache::clear()
+{
+    m_index.clear();
+    m_entries.clear();
+}
+
+PathCacheStats
+PathCache::getStats() const
+{
+    return PathCacheStats{ m_hits, m_misses, m_entries.size() };
+}
+
+} // end namespace celestia::engine
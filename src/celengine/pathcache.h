@@ -0,0 +1,94 @@
+// pathcache.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Cache of object paths resolved by the universe.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <celengine/selection.h>
+#include <celutil/array_view.h>
+
+namespace celestia::engine
+{
+
+struct PathCacheStats
+{
+    std::uint64_t hits{ 0 };
+    std::uint64_t misses{ 0 };
+    std::size_t size{ 0 };
+};
+
+// Scripts look up the same object paths over and over, often every frame,
+// and every lookup walks the star and deep sky name indexes before the
+// solar systems. The selections found are kept for each path and list of
+// contexts, dropping the least recently used entries once the cache is
+// full. Failed lookups are not cached, so that objects added later are
+// found. The cache has to be cleared whenever a catalogue is replaced or
+// a name is removed.
+class PathCache
+{
+public:
+    static constexpr std::size_t DefaultCapacity = 1024;
+
+    explicit PathCache(std::size_t capacity = DefaultCapacity);
+
+    bool find(std::string_view path,
+              util::array_view<const Selection> contexts,
+              bool i18n,
+              Selection& sel);
+    void insert(std::string_view path,
+                util::array_view<const Selection> contexts,
+                bool i18n,
+                const Selection& sel);
+    void clear();
+
+    PathCacheStats getStats() const;
+
+private:
+    struct Key
+    {
+        std::string path;
+        std::vector<Selection> contexts;
+        bool i18n;
+
+        bool operator==(const Key&) const;
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key&) const;
+    };
+
+    struct Entry
+    {
+        Key key;
+        Selection sel;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    static Key makeKey(std::string_view, util::array_view<const Selection>, bool);
+
+    std::size_t m_capacity;
+    // Most recently used first
+    EntryList m_entries;
+    std::unordered_map<Key, EntryList::iterator, KeyHash> m_index;
+    std::uint64_t m_hits{ 0 };
+    std::uint64_t m_misses{ 0 };
+};
+
+} // end namespace celestia::engine
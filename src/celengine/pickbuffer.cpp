@@ -0,0 +1,338 @@
+// pickbuffer.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "pickbuffer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+#include <Eigen/Geometry>
+
+#include <celastro/date.h>
+#include <celcompat/numbers.h>
+#include <celmath/geomutil.h>
+#include <celmath/mathlib.h>
+#include <celutil/logger.h>
+#include "body.h"
+#include "framebuffer.h"
+#include "framereadback.h"
+#include "geometry.h"
+#include "meshmanager.h"
+#include "observer.h"
+#include "rendcontext.h"
+#include "render.h"
+#include "renderlistentry.h"
+#include "shadermanager.h"
+#include "star.h"
+
+namespace gl = celestia::gl;
+namespace math = celestia::math;
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+constexpr int SphereSlices = 32;
+constexpr int SphereStacks = 16;
+constexpr int RingSections = 128;
+
+// Largest ratio of the far and near plane, so that the depth test still
+// works within an object the observer is close to
+constexpr float MaxDepthRatio = 1.0e6f;
+
+// Triangles of a unit sphere. The w coordinate selects the outer of the
+// two radii given to the shader, which are both one for the sphere.
+std::vector<Eigen::Vector4f>
+sphereVertices()
+{
+    std::vector<Eigen::Vector4f> grid;
+    grid.reserve((SphereStacks + 1) * (SphereSlices + 1));
+    for (int i = 0; i <= SphereStacks; ++i)
+    {
+        float phi = numbers::pi_v<float> * static_cast<float>(i) / static_cast<float>(SphereStacks);
+        for (int j = 0; j <= SphereSlices; ++j)
+        {
+            float theta = 2.0f * numbers::pi_v<float> * static_cast<float>(j) / static_cast<float>(SphereSlices);
+            grid.emplace_back(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta), 1.0f);
+        }
+    }
+
+    std::vector<Eigen::Vector4f> vertices;
+    vertices.reserve(SphereStacks * SphereSlices * 6);
+    for (int i = 0; i < SphereStacks; ++i)
+    {
+        for (int j = 0; j < SphereSlices; ++j)
+        {
+            auto v0 = static_cast<std::size_t>(i * (SphereSlices + 1) + j);
+            auto v1 = v0 + SphereSlices + 1;
+            vertices.insert(vertices.end(), { grid[v0], grid[v1], grid[v0 + 1], grid[v0 + 1], grid[v1], grid[v1 + 1] });
+        }
+    }
+
+    return vertices;
+}
+
+// Triangles of an annulus in the xz plane; w is 0 on the inner edge and 1
+// on the outer edge, which the shader scales to the radii of the rings
+std::vector<Eigen::Vector4f>
+ringVertices()
+{
+    std::vector<Eigen::Vector4f> vertices;
+    vertices.reserve(RingSections * 6);
+    for (int i = 0; i < RingSections; ++i)
+    {
+        float theta0 = 2.0f * numbers::pi_v<float> * static_cast<float>(i) / static_cast<float>(RingSections);
+        float theta1 = 2.0f * numbers::pi_v<float> * static_cast<float>(i + 1) / static_cast<float>(RingSections);
+        Eigen::Vector4f inner0(std::cos(theta0), 0.0f, std::sin(theta0), 0.0f);
+        Eigen::Vector4f inner1(std::cos(theta1), 0.0f, std::sin(theta1), 0.0f);
+        Eigen::Vector4f outer0(std::cos(theta0), 0.0f, std::sin(theta0), 1.0f);
+        Eigen::Vector4f outer1(std::cos(theta1), 0.0f, std::sin(theta1), 1.0f);
+        vertices.insert(vertices.end(), { inner0, outer0, inner1, inner1, outer0, outer1 });
+    }
+
+    return vertices;
+}
+
+void
+setUpVertexObject(gl::VertexObject& vo, gl::Buffer& bo, const std::vector<Eigen::Vector4f>& vertices)
+{
+    vo = gl::VertexObject();
+    bo = gl::Buffer(gl::Buffer::TargetHint::Array, vertices, gl::Buffer::BufferUsage::StaticDraw);
+    vo.setCount(static_cast<int>(vertices.size()));
+    vo.addVertexBuffer(bo,
+                       CelestiaGLProgram::VertexCoordAttributeIndex,
+                       4,
+                       gl::VertexObject::DataType::Float,
+                       false,
+                       sizeof(Eigen::Vector4f),
+                       0);
+    bo.unbind();
+}
+
+// Ids are stored in the red, green and blue channels; zero is the
+// background
+Eigen::Vector4f
+idColor(std::uint32_t id)
+{
+    return Eigen::Vector4f(static_cast<float>(id & 0xff) / 255.0f,
+                           static_cast<float>((id >> 8) & 0xff) / 255.0f,
+                           static_cast<float>((id >> 16) & 0xff) / 255.0f,
+                           1.0f);
+}
+
+std::uint32_t
+decodeId(const std::uint8_t* pixel)
+{
+    return static_cast<std::uint32_t>(pixel[0]) |
+           (static_cast<std::uint32_t>(pixel[1]) << 8) |
+           (static_cast<std::uint32_t>(pixel[2]) << 16);
+}
+
+} // end unnamed namespace
+
+PickBuffer::PickBuffer() = default;
+
+PickBuffer::~PickBuffer() = default;
+
+bool
+PickBuffer::initialize()
+{
+    if (m_initialized)
+        return m_fbo != nullptr;
+    m_initialized = true;
+
+    m_fbo = std::make_unique<FramebufferObject>(1, 1, FramebufferObject::ColorAttachment | FramebufferObject::DepthAttachment);
+    if (!m_fbo->isValid())
+    {
+        util::GetLogger()->error("Error creating pick buffer FBO.\n");
+        m_fbo = nullptr;
+        return false;
+    }
+
+    // Without pixel pack buffers the pixel is read right away
+    m_readback = FrameReadback::create(1, 1, PixelFormat::RGBA);
+
+    setUpVertexObject(m_sphereVO, m_sphereBO, sphereVertices());
+    setUpVertexObject(m_ringVO, m_ringBO, ringVertices());
+    return true;
+}
+
+bool
+PickBuffer::render(Renderer& renderer,
+                   const Observer& observer,
+                   const Eigen::Vector3f& direction,
+                   float pixelAngle)
+{
+    auto* prog = renderer.getShaderManager().getShader("pickid");
+    if (prog == nullptr || !initialize())
+        return false;
+
+    // Results of earlier passes that were never taken are dropped
+    while (m_readback != nullptr && m_readback->pendingCount() > 0)
+    {
+        std::array<std::uint8_t, 4> pixel;
+        m_readback->take(pixel.data(), true);
+    }
+    m_pixel = std::nullopt;
+
+    double now = observer.getTime();
+    double tsec = astro::daysToSecs(now - astro::J2000);
+
+    // A camera looking down the pick ray, covering one pixel
+    Eigen::Matrix4f view = Eigen::Matrix4f::Identity();
+    view.topLeftCorner<3, 3>() = Eigen::Quaternionf::FromTwoVectors(direction, -Eigen::Vector3f::UnitZ()).toRotationMatrix();
+    Eigen::Vector3d dir = direction.cast<double>();
+
+    // Draw the objects from back to front, clearing the depth buffer in
+    // between, so that each gets a depth range of its own like the depth
+    // partitions of the renderer
+    struct Item
+    {
+        const RenderListEntry* rle;
+        float distance;
+    };
+    std::vector<Item> items;
+    for (const RenderListEntry& rle : renderer.getRenderList())
+    {
+        if (rle.renderableType == RenderListEntry::RenderableBody
+            ? !rle.body->isClickable()
+            : rle.renderableType != RenderListEntry::RenderableStar)
+        {
+            continue;
+        }
+
+        // Skip the objects that the ray passes at a distance
+        Eigen::Vector3d position = rle.position.cast<double>();
+        double along = position.dot(dir);
+        if (along + rle.radius <= 0.0 ||
+            (position - along * dir).norm() > static_cast<double>(rle.radius) + std::abs(along) * pixelAngle)
+        {
+            continue;
+        }
+
+        items.push_back({ &rle, rle.distance });
+    }
+    std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.distance > b.distance; });
+
+    GLint oldFboId = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+    if (!m_fbo->bind())
+        return false;
+
+    std::array<int, 4> viewport;
+    renderer.getViewport(viewport);
+    renderer.setViewport(0, 0, 1, 1);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    Renderer::PipelineState ps;
+    ps.depthTest = true;
+    ps.depthMask = true;
+    renderer.setPipelineState(ps);
+    prog->use();
+
+    Shadow_RenderContext rc(&renderer);
+    float fov = math::radToDeg(pixelAngle);
+    m_objects.clear();
+    for (const Item& item : items)
+    {
+        const RenderListEntry& rle = *item.rle;
+        float nearZ = std::max(item.distance - rle.radius, (item.distance + rle.radius) / MaxDepthRatio);
+        float farZ = item.distance + rle.radius;
+        Eigen::Matrix4f projection = math::Perspective(fov, 1.0f, nearZ, farZ);
+
+        glClear(GL_DEPTH_BUFFER_BIT);
+        m_objects.emplace_back();
+        prog->vec4Param("color") = idColor(static_cast<std::uint32_t>(m_objects.size()));
+        prog->vec2Param("radii") = Eigen::Vector2f::Ones();
+
+        Eigen::Affine3f transform(Eigen::Translation3f(rle.position));
+        if (rle.renderableType == RenderListEntry::RenderableStar)
+        {
+            m_objects.back() = Selection(const_cast<Star*>(rle.star)); //NOSONAR
+            Eigen::Matrix4f modelView = view * (transform * Eigen::Scaling(rle.star->getRadius())).matrix();
+            prog->setMVPMatrices(projection, modelView);
+            m_sphereVO.draw();
+            continue;
+        }
+
+        Body& body = *rle.body;
+        m_objects.back() = Selection(&body);
+        Eigen::Quaternionf orientation = body.getGeometryOrientation() * body.getOrientation(now).cast<float>();
+        transform = transform * orientation.conjugate();
+
+        // Models are drawn once loaded, the ellipsoid until then
+        const Geometry* geometry = nullptr;
+        if (body.getGeometry() != InvalidResource)
+            geometry = GetGeometryManager()->find(body.getGeometry());
+
+        Eigen::Vector3f scale = body.getSemiAxes();
+        if (geometry != nullptr && !geometry->isNormalized())
+            scale = Eigen::Vector3f::Constant(body.getGeometryScale());
+
+        Eigen::Matrix4f modelView = view * (transform * Eigen::Scaling(scale)).matrix();
+        prog->setMVPMatrices(projection, modelView);
+        if (geometry != nullptr)
+            const_cast<Geometry*>(geometry)->render(rc, tsec); //NOSONAR
+        else if (body.getGeometry() != GetEmptyGeometryHandle())
+            m_sphereVO.draw();
+
+        if (const RingSystem* rings = GetBodyFeaturesManager()->getRings(&body);
+            rings != nullptr && (renderer.getRenderFlags() & Renderer::ShowPlanetRings) != 0)
+        {
+            prog->use();
+            prog->setMVPMatrices(projection, (view * transform.matrix()).eval());
+            prog->vec2Param("radii") = Eigen::Vector2f(rings->innerRadius, rings->outerRadius);
+            m_ringVO.draw();
+        }
+    }
+
+    if (m_readback == nullptr || !m_readback->read(0, 0))
+    {
+        std::array<std::uint8_t, 4> pixel;
+        glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel.data());
+        m_pixel = decodeId(pixel.data());
+    }
+
+    m_fbo->unbind(oldFboId);
+    renderer.setViewport(viewport);
+    return true;
+}
+
+std::optional<Selection>
+PickBuffer::takeResult(bool wait)
+{
+    std::uint32_t id = 0;
+    if (m_pixel.has_value())
+    {
+        id = *m_pixel;
+        m_pixel = std::nullopt;
+    }
+    else
+    {
+        // A row of one pixel padded to four bytes
+        std::array<std::uint8_t, 4> pixel;
+        if (m_readback == nullptr || m_readback->pendingCount() == 0)
+            return Selection();
+        if (!m_readback->take(pixel.data(), wait))
+            return wait ? std::optional<Selection>(Selection()) : std::nullopt;
+        id = decodeId(pixel.data());
+    }
+
+    if (id == 0 || id > m_objects.size())
+        return Selection();
+    return m_objects[id - 1];
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,83 @@
+// pickbuffer.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Picking by drawing object ids around the cursor.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celrender/gl/buffer.h>
+#include <celrender/gl/vertexobject.h>
+#include "selection.h"
+
+class FramebufferObject;
+class FrameReadback;
+class Observer;
+class Renderer;
+
+namespace celestia::engine
+{
+
+// Finds the object under the cursor by drawing the bodies and stars of the
+// render list of the last frame, with their models, ellipsoids and rings,
+// into a one pixel framebuffer, each in a color that encodes its index.
+// The pixel is read back asynchronously, so that the result is normally
+// available when the next frame is drawn. Unlike the ray tests of
+// Universe::pick this is exact for models and rings, and its cost doesn't
+// depend on the complexity of the models.
+//
+// Objects smaller than a pixel are usually missed, so an empty result
+// should be followed by an ordinary pick.
+class PickBuffer
+{
+public:
+    PickBuffer();
+    ~PickBuffer();
+
+    PickBuffer(const PickBuffer&) = delete;
+    PickBuffer& operator=(const PickBuffer&) = delete;
+
+    // Draws the ids of the objects in the renderer's render list seen from
+    // the observer in direction, which is in universal coordinates, into a
+    // pixel pixelAngle radians wide, and starts reading it back. Returns
+    // false if the pass can't be drawn.
+    bool render(Renderer& renderer,
+                const Observer& observer,
+                const Eigen::Vector3f& direction,
+                float pixelAngle);
+
+    // Returns the object drawn at the pixel, which is empty if there was
+    // none, or nullopt if the GPU isn't done yet and wait is false
+    std::optional<Selection> takeResult(bool wait);
+
+private:
+    bool initialize();
+
+    std::unique_ptr<FramebufferObject> m_fbo;
+    std::unique_ptr<FrameReadback> m_readback;
+    bool m_initialized{ false };
+
+    // The objects of the last pass, by their id minus one
+    std::vector<Selection> m_objects;
+    // The pixel read without a pixel pack buffer
+    std::optional<std::uint32_t> m_pixel;
+
+    celestia::gl::VertexObject m_sphereVO{ celestia::util::NoCreateT{} };
+    celestia::gl::Buffer m_sphereBO{ celestia::util::NoCreateT{} };
+    celestia::gl::VertexObject m_ringVO{ celestia::util::NoCreateT{} };
+    celestia::gl::Buffer m_ringBO{ celestia::util::NoCreateT{} };
+};
+
+} // end namespace celestia::engine
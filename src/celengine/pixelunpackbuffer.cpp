@@ -0,0 +1,198 @@
+// pixelunpackbuffer.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Mapped pixel unpack buffer that texture images are decoded into.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "pixelunpackbuffer.h"
+
+#include <atomic>
+#include <iterator>
+
+namespace
+{
+
+// Large enough for a 4k x 4k RGBA image, or an 8k x 8k DXT5 one with mipmaps
+constexpr std::size_t UnpackBufferSize = 64 * 1024 * 1024;
+
+// Offsets passed to glTexImage2D must be multiples of the pixel size
+constexpr std::size_t BlockAlignment = 256;
+
+std::atomic<PixelUnpackBuffer*> unpackBuffer{ nullptr };
+
+} // end unnamed namespace
+
+PixelUnpackBuffer::PixelUnpackBuffer(GLuint buffer, std::uint8_t* mapped, std::size_t size) :
+    m_buffer(buffer),
+    m_mapped(mapped),
+    m_size(size)
+{
+    m_free.try_emplace(0, size);
+}
+
+PixelUnpackBuffer::~PixelUnpackBuffer()
+{
+    for (const FencedBlocks& blocks : m_fenced)
+        glDeleteSync(blocks.fence);
+    // Deleting the buffer also unmaps it
+    glDeleteBuffers(1, &m_buffer);
+}
+
+std::unique_ptr<PixelUnpackBuffer>
+PixelUnpackBuffer::create(std::size_t size)
+{
+#ifdef GL_ES
+    return nullptr;
+#else
+    if (!celestia::gl::hasBufferStorage())
+        return nullptr;
+
+    // Decoded images are read back too, e.g. height maps to compute normal
+    // maps, so the mapping must be readable
+    constexpr GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, flags);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(size), flags);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (mapped == nullptr)
+    {
+        glDeleteBuffers(1, &buffer);
+        return nullptr;
+    }
+
+    return std::unique_ptr<PixelUnpackBuffer>(new PixelUnpackBuffer(buffer, static_cast<std::uint8_t*>(mapped), size));
+#endif
+}
+
+std::uint8_t*
+PixelUnpackBuffer::allocate(std::size_t size)
+{
+    size = (size + BlockAlignment - 1) / BlockAlignment * BlockAlignment;
+
+    std::scoped_lock lock(m_mutex);
+    for (auto it = m_free.begin(); it != m_free.end(); ++it)
+    {
+        if (it->second < size)
+            continue;
+
+        std::size_t offset = it->first;
+        std::size_t remaining = it->second - size;
+        m_free.erase(it);
+        if (remaining > 0)
+            m_free.try_emplace(offset + size, remaining);
+
+        m_allocated.try_emplace(offset, size);
+        return m_mapped + offset;
+    }
+
+    return nullptr;
+}
+
+void
+PixelUnpackBuffer::release(std::uint8_t* data)
+{
+    std::scoped_lock lock(m_mutex);
+    m_released.push_back(static_cast<std::size_t>(data - m_mapped));
+}
+
+void
+PixelUnpackBuffer::reclaim()
+{
+    std::scoped_lock lock(m_mutex);
+
+    // Uploads from released blocks have all been issued already, so one
+    // fence placed now covers them
+    if (!m_released.empty())
+    {
+        m_fenced.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(m_released) });
+        m_released.clear();
+    }
+
+    auto done = m_fenced.begin();
+    for (; done != m_fenced.end(); ++done)
+    {
+        if (glClientWaitSync(done->fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            break;
+
+        glDeleteSync(done->fence);
+        for (std::size_t offset : done->offsets)
+        {
+            auto it = m_allocated.find(offset);
+            free(offset, it->second);
+            m_allocated.erase(it);
+        }
+    }
+    m_fenced.erase(m_fenced.begin(), done);
+}
+
+void
+PixelUnpackBuffer::free(std::size_t offset, std::size_t size)
+{
+    auto next = m_free.lower_bound(offset);
+    if (next != m_free.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = m_free.erase(next);
+    }
+
+    if (next != m_free.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            prev->second += size;
+            return;
+        }
+    }
+
+    m_free.try_emplace(offset, size);
+}
+
+bool
+PixelUnpackBuffer::contains(const std::uint8_t* data) const
+{
+    return data >= m_mapped && data < m_mapped + m_size;
+}
+
+const void*
+PixelUnpackBuffer::bind(const std::uint8_t* data) const
+{
+    if (!contains(data))
+        return data;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+    return reinterpret_cast<const void*>(static_cast<std::uintptr_t>(data - m_mapped)); //NOSONAR
+}
+
+void
+PixelUnpackBuffer::unbind()
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+PixelUnpackBuffer*
+GetPixelUnpackBuffer()
+{
+    return unpackBuffer.load(std::memory_order_acquire);
+}
+
+void
+InitPixelUnpackBuffer()
+{
+    static bool initialized = false;
+    if (initialized)
+        return;
+    initialized = true;
+
+    // Never destroyed, images may still be decoded into it at exit
+    unpackBuffer.store(PixelUnpackBuffer::create(UnpackBufferSize).release(), std::memory_order_release); //NOSONAR
+}
@@ -0,0 +1,87 @@
+// pixelunpackbuffer.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Mapped pixel unpack buffer that texture images are decoded into.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <celimage/image.h>
+#include "glsupport.h"
+
+// A persistently mapped GL_PIXEL_UNPACK_BUFFER that image loaders decode
+// straight into, on whichever thread they run. Textures are then uploaded
+// from the buffer, so the pixels aren't copied a second time and the driver
+// can transfer them asynchronously. Images that don't fit in the free space
+// fall back to the heap.
+//
+// Memory released by an image is fenced the next time reclaim() is called
+// and reused once the GPU is done reading from it. create(), reclaim() and
+// the pointer functions need the GL context, allocate() and release() may
+// be called from any thread.
+class PixelUnpackBuffer : public celestia::engine::PixelAllocator
+{
+public:
+    ~PixelUnpackBuffer() override;
+
+    PixelUnpackBuffer(const PixelUnpackBuffer&) = delete;
+    PixelUnpackBuffer& operator=(const PixelUnpackBuffer&) = delete;
+
+    // Returns nullptr if persistent mappings aren't supported
+    static std::unique_ptr<PixelUnpackBuffer> create(std::size_t size);
+
+    std::uint8_t* allocate(std::size_t size) override;
+    void release(std::uint8_t* data) override;
+
+    // Frees released memory the GPU no longer reads from
+    void reclaim();
+
+    // Binds the buffer when data lies within it and returns the pointer to
+    // pass to glTexImage2D, which is an offset into the bound buffer then
+    const void* bind(const std::uint8_t* data) const;
+    static void unbind();
+
+private:
+    PixelUnpackBuffer(GLuint buffer, std::uint8_t* mapped, std::size_t size);
+
+    bool contains(const std::uint8_t* data) const;
+    void free(std::size_t offset, std::size_t size);
+
+    struct FencedBlocks
+    {
+        GLsync fence;
+        std::vector<std::size_t> offsets;
+    };
+
+    GLuint m_buffer;
+    std::uint8_t* m_mapped;
+    std::size_t m_size;
+
+    std::mutex m_mutex;
+    // Offset and size of each free and allocated block
+    std::map<std::size_t, std::size_t> m_free;
+    std::map<std::size_t, std::size_t> m_allocated;
+    // Released blocks not fenced yet, and fenced ones in fence order
+    std::vector<std::size_t> m_released;
+    std::vector<FencedBlocks> m_fenced;
+};
+
+// Returns the buffer texture images should be decoded into, or nullptr if
+// it isn't created yet or not supported. Safe to call from any thread.
+PixelUnpackBuffer* GetPixelUnpackBuffer();
+
+// Creates the buffer on first use; must be called with the GL context
+// current.
+void InitPixelUnpackBuffer();
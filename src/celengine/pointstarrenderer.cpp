@@ -95,19 +95,8 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
         // planets.
         if (distance > SolarSystemMaxDistance)
         {
-            float pointSize, alpha, glareSize, glareAlpha;
-            float size = BaseStarDiscSize * static_cast<float>(renderer->getScreenDpi()) / 96.0f;
-            renderer->calculatePointSize(appMag,
-                                         size,
-                                         pointSize,
-                                         alpha,
-                                         glareSize,
-                                         glareAlpha);
-
-            if (glareSize != 0.0f)
-                glareVertexBuffer->addStar(relPos, Color(starColor, glareAlpha), glareSize);
-            if (pointSize != 0.0f)
-                starVertexBuffer->addStar(relPos, Color(starColor, alpha), pointSize);
+            if (drawDistantStars)
+                addPoint(relPos, starColor, appMag);
 
             // Place labels for stars brighter than the specified label threshold brightness
             if (((labelMode & Renderer::StarLabels) != 0) && appMag < labelThresholdMag)
@@ -120,11 +109,15 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
                     renderer->addBackgroundAnnotation(nullptr,
                                                       starDB->getStarName(star, true),
                                                       color,
-                                                      relPos);
+                                                      relPos,
+                                                      Renderer::LabelHorizontalAlignment::Start,
+                                                      Renderer::LabelVerticalAlignment::Bottom,
+                                                      0.0f,
+                                                      -appMag);
                 }
             }
         }
-        else
+        else if (addCloseStars)
         {
             Matrix3f viewMat = renderer->getCameraOrientationf().toRotationMatrix();
             Vector3f viewMatZ = viewMat.row(2);
@@ -156,8 +149,91 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
                 renderer->addSortedAnnotation(nullptr,
                                               starDB->getStarName(star, true),
                                               Renderer::StarLabelColor,
-                                              pos);
+                                              pos,
+                                              Renderer::LabelHorizontalAlignment::Start,
+                                              Renderer::LabelVerticalAlignment::Bottom,
+                                              0.0f,
+                                              -appMag);
             }
         }
     }
 }
+
+float PointStarRenderer::aggregateThreshold() const
+{
+    return pixelSize;
+}
+
+void PointStarRenderer::processAggregate(const StarNodeAggregate& aggregate, float distance, float appMag)
+{
+    if (distance > distanceLimit || !drawDistantStars)
+        return;
+
+    Vector3f relPos = (aggregate.centroid.cast<double>() - obsPos).cast<float>();
+    if (relPos.dot(viewNormal) <= 0.0f)
+        return;
+
+    // Aggregated nodes are always far away, so this is the distant star case
+    // of process() without the labels.
+    addPoint(relPos, colorTemp->lookupColor(aggregate.temperature), appMag);
+}
+
+void PointStarRenderer::addPoint(const Vector3f& relPos, const Color& starColor, float appMag) const
+{
+    // Most stars are too faint to saturate: their opacity is all that
+    // depends on the magnitude, and they get no glare. Only the brighter
+    // ones need the full calculation.
+    float alpha = (faintestMag - appMag) * brightnessScale + brightnessBias;
+    if (alpha <= 0.0f)
+        return;
+    if (alpha <= 1.0f)
+    {
+        starVertexBuffer->addStar(relPos, Color(starColor, alpha), discSize);
+        return;
+    }
+
+    float pointSize, glareSize, glareAlpha;
+    renderer->calculatePointSize(appMag,
+                                 discSize,
+                                 pointSize,
+                                 alpha,
+                                 glareSize,
+                                 glareAlpha);
+
+    if (glareSize != 0.0f)
+        glareVertexBuffer->addStar(relPos, Color(starColor, glareAlpha), glareSize);
+    if (pointSize != 0.0f)
+        starVertexBuffer->addStar(relPos, Color(starColor, alpha), pointSize);
+}
+
+void PointStarCollector::process(const Star& star, float distance, float appMag)
+{
+    stars.push_back({ &star, distance, appMag });
+}
+
+float PointStarCollector::aggregateThreshold() const
+{
+    return threshold;
+}
+
+void PointStarCollector::processAggregate(const StarNodeAggregate& aggregate, float distance, float appMag)
+{
+    aggregates.push_back({ &aggregate, distance, appMag });
+}
+
+void PointStarCollector::flush(StarHandler& handler)
+{
+    for (const VisibleStar& visibleStar : stars)
+        handler.process(*visibleStar.star, visibleStar.distance, visibleStar.appMag);
+    stars.clear();
+
+    for (const VisibleAggregate& visibleAggregate : aggregates)
+        handler.processAggregate(*visibleAggregate.aggregate, visibleAggregate.distance, visibleAggregate.appMag);
+    aggregates.clear();
+}
+
+void PointStarCollector::clear()
+{
+    stars.clear();
+    aggregates.clear();
+}
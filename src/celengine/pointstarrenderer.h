@@ -14,7 +14,9 @@
 #include <vector>
 #include "objectrenderer.h"
 #include "renderlistentry.h"
+#include "staroctree.h"
 
+class Color;
 class ColorTemperatureTable;
 class PointStarVertexBuffer;
 class Star;
@@ -28,7 +30,7 @@ constexpr inline float BaseStarDiscSize      = 5.0f;
 constexpr inline float MaxScaledDiscStarSize = 8.0f;
 constexpr inline float GlareOpacity          = 0.65f;
 
-class PointStarRenderer : public ObjectRenderer<Star, float>
+class PointStarRenderer final : public ObjectRenderer<Star, float>
 {
  public:
 #if 0
@@ -42,6 +44,11 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
     PointStarRenderer();
     void process(const Star &star, float distance, float appMag) override;
 
+    // Octree nodes smaller than a pixel are drawn as a single point with the
+    // combined brightness of their stars.
+    float aggregateThreshold() const override;
+    void processAggregate(const StarNodeAggregate &aggregate, float distance, float appMag) override;
+
     Eigen::Vector3d obsPos;
     Eigen::Vector3f viewNormal;
     std::vector<RenderListEntry>* renderList    { nullptr };
@@ -50,5 +57,53 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
     const StarDatabase* starDB                  { nullptr };
     const ColorTemperatureTable* colorTemp      { nullptr };
     float SolarSystemMaxDistance                { 1.0f };
+    // Disc size in pixels and the mapping from apparent magnitude to
+    // opacity, as used by Renderer::calculatePointSize
+    float discSize                              { BaseStarDiscSize };
+    float brightnessScale                       { 1.0f };
+    float brightnessBias                        { 0.0f };
     float cosFOV                                { 1.0f };
+    // When the distant stars are drawn elsewhere, e.g. on the GPU, only
+    // their labels are produced here.
+    bool drawDistantStars                       { true };
+    // Whether stars closer than SolarSystemMaxDistance are added to the
+    // render list.
+    bool addCloseStars                          { true };
+
+ private:
+    void addPoint(const Eigen::Vector3f &relPos, const Color &starColor, float appMag) const;
+};
+
+// PointStarCollector records the stars found by one thread of a parallel
+// star octree traversal. PointStarRenderer is not thread safe, so the
+// collected stars are passed on to it afterwards on the render thread.
+class PointStarCollector final : public StarHandler
+{
+ public:
+    void process(const Star &star, float distance, float appMag) override;
+    float aggregateThreshold() const override;
+    void processAggregate(const StarNodeAggregate &aggregate, float distance, float appMag) override;
+    void flush(StarHandler &handler);
+    void clear();
+
+    // Copied from the handler the stars are flushed to.
+    float threshold { 0.0f };
+
+ private:
+    struct VisibleStar
+    {
+        const Star* star;
+        float distance;
+        float appMag;
+    };
+
+    struct VisibleAggregate
+    {
+        const StarNodeAggregate* aggregate;
+        float distance;
+        float appMag;
+    };
+
+    std::vector<VisibleStar> stars;
+    std::vector<VisibleAggregate> aggregates;
 };
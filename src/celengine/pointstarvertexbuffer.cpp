@@ -8,7 +8,9 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
-#include <celrender/gl/buffer.h>
+#include <algorithm>
+
+#include <celrender/gl/streambuffer.h>
 #include <celrender/gl/vertexobject.h>
 #include <celutil/color.h>
 #include "glsupport.h"
@@ -55,14 +57,19 @@ void PointStarVertexBuffer::render()
         if (m_texture != nullptr)
             m_texture->bind();
 
-        m_bo->invalidateData().setData(
-            util::array_view(m_vertices.get(), m_nStars),
-            gl::Buffer::BufferUsage::StreamDraw);
-
-        if (m_pointSizeFromVertex)
-            m_vo1->draw(m_nStars);
-        else
-            m_vo2->draw(m_nStars);
+        gl::StreamBuffer& stream = m_renderer.getStreamBuffer();
+        gl::VertexObject& vo = m_pointSizeFromVertex ? *m_vo1 : *m_vo2;
+
+        // The vertex objects read from the stream buffer, so draws start at
+        // the vertex the batch was written to
+        auto maxStars = static_cast<capacity_t>(stream.maxWriteSize() / sizeof(StarVertex));
+        for (capacity_t first = 0; first < m_nStars; first += maxStars)
+        {
+            capacity_t count = std::min(m_nStars - first, maxStars);
+            GLintptr offset = stream.write(util::array_view(m_vertices.get() + first, count),
+                                           sizeof(StarVertex));
+            vo.draw(static_cast<int>(count), static_cast<int>(offset / sizeof(StarVertex)));
+        }
         m_nStars = 0;
     }
 }
@@ -97,12 +104,12 @@ void PointStarVertexBuffer::setupVertexArrayObject()
     {
         m_initialized = true;
 
-        m_bo = std::make_unique<gl::Buffer>();
+        const gl::Buffer& bo = m_renderer.getStreamBuffer().buffer();
         m_vo1 = std::make_unique<gl::VertexObject>(gl::VertexObject::Primitive::Points);
         m_vo2 = std::make_unique<gl::VertexObject>(gl::VertexObject::Primitive::Points);
 
         m_vo1->addVertexBuffer(
-            *m_bo,
+            bo,
             CelestiaGLProgram::VertexCoordAttributeIndex,
             3,
             gl::VertexObject::DataType::Float,
@@ -111,7 +118,7 @@ void PointStarVertexBuffer::setupVertexArrayObject()
             offsetof(StarVertex, position));
 
         m_vo1->addVertexBuffer(
-            *m_bo,
+            bo,
             CelestiaGLProgram::ColorAttributeIndex,
             4,
             gl::VertexObject::DataType::UnsignedByte,
@@ -120,7 +127,7 @@ void PointStarVertexBuffer::setupVertexArrayObject()
             offsetof(StarVertex, color));
 
         m_vo1->addVertexBuffer(
-            *m_bo,
+            bo,
             CelestiaGLProgram::PointSizeAttributeIndex,
             1,
             gl::VertexObject::DataType::Float,
@@ -129,7 +136,7 @@ void PointStarVertexBuffer::setupVertexArrayObject()
             offsetof(StarVertex, size));
 
         m_vo2->addVertexBuffer(
-            *m_bo,
+            bo,
             CelestiaGLProgram::VertexCoordAttributeIndex,
             3,
             gl::VertexObject::DataType::Float,
@@ -138,7 +145,7 @@ void PointStarVertexBuffer::setupVertexArrayObject()
             offsetof(StarVertex, position));
 
         m_vo2->addVertexBuffer(
-            *m_bo,
+            bo,
             CelestiaGLProgram::ColorAttributeIndex,
             4,
             gl::VertexObject::DataType::UnsignedByte,
@@ -20,7 +20,6 @@ class CelestiaGLProgram;
 
 namespace celestia::gl
 {
-class Buffer;
 class VertexObject;
 }
 
@@ -66,7 +65,6 @@ private:
     float                           m_pointScale            { 1.0f };
     CelestiaGLProgram              *m_prog                  { nullptr };
 
-    std::unique_ptr<celestia::gl::Buffer>        m_bo;
     std::unique_ptr<celestia::gl::VertexObject>  m_vo1;
     std::unique_ptr<celestia::gl::VertexObject>  m_vo2;
     bool m_initialized{ false };
@@ -11,6 +11,7 @@
 #include <algorithm>
 #include <cstddef>
 
+#include <celrender/gl/binder.h>
 #include <celrender/gl/vertexobject.h>
 #include <celutil/color.h>
 #include <celutil/flag.h>
@@ -117,6 +118,20 @@ RenderContext::getPointScale() const
 }
 
 
+void
+RenderContext::setPixelScale(float _pixelScale)
+{
+    pixelScale = _pixelScale;
+}
+
+
+float
+RenderContext::getPixelScale() const
+{
+    return pixelScale;
+}
+
+
 void
 RenderContext::setCameraOrientation(const Eigen::Quaternionf& q)
 {
@@ -131,6 +146,20 @@ RenderContext::getCameraOrientation() const
 }
 
 
+void
+RenderContext::setInstances(const std::vector<ModelInstance>* _instances)
+{
+    instances = _instances;
+}
+
+
+const std::vector<ModelInstance>*
+RenderContext::getInstances() const
+{
+    return instances;
+}
+
+
 void
 RenderContext::drawGroup(gl::VertexObject &vao, const cmod::PrimitiveGroup& group)
 {
@@ -155,10 +184,18 @@ RenderContext::drawGroup(gl::VertexObject &vao, const cmod::PrimitiveGroup& grou
         glEnable(GL_POINT_SPRITE);
         glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
 #endif
-        glActiveTexture(GL_TEXTURE0);
+        gl::Binder::get().activeTexture(0);
     }
 
-    vao.draw(convert(group.prim), group.indicesCount, group.indicesOffset);
+    if (instances != nullptr)
+    {
+        vao.drawInstanced(convert(group.prim), group.indicesCount,
+                          static_cast<int>(instances->size()), group.indicesOffset);
+    }
+    else
+    {
+        vao.draw(convert(group.prim), group.indicesCount, group.indicesOffset);
+    }
 
 #ifndef GL_ES
     if (drawPoints)
@@ -179,8 +216,10 @@ RenderContext::updateShader(const cmod::VertexDescription& desc, cmod::Primitive
     // or disappear in the new set of vertex arrays.
     bool usePointSizeNow = (desc.getAttribute(cmod::VertexAttributeSemantic::PointSize).format
                             == cmod::VertexAttributeFormat::Float1);
-    bool useNormalsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Normal).format
-                          == cmod::VertexAttributeFormat::Float3);
+    cmod::VertexAttributeFormat normalFormat = desc.getAttribute(cmod::VertexAttributeSemantic::Normal).format;
+    bool useNormalsNow = (normalFormat == cmod::VertexAttributeFormat::Float3 ||
+                          normalFormat == cmod::VertexAttributeFormat::Short4 ||
+                          normalFormat == cmod::VertexAttributeFormat::Int1010102);
     bool useColorsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Color0).format
                          != cmod::VertexAttributeFormat::InvalidFormat);
     bool useTexCoordsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Texture0).format
@@ -358,7 +397,7 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
         Texture* ringsTex = lightingState.shadowingRingSystem->texture.find(medres);
         if (ringsTex != nullptr)
         {
-            glActiveTexture(GL_TEXTURE0 + nTextures);
+            gl::Binder::get().activeTexture(nTextures);
             ringsTex->bind();
             textures[nTextures++] = ringsTex;
 
@@ -380,7 +419,7 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
 #ifdef GL_ES
             }
 #endif
-            glActiveTexture(GL_TEXTURE0);
+            gl::Binder::get().activeTexture(0);
 
             shaderProps.texUsage |= TexUsage::RingShadowTexture;
             for (unsigned int lightIndex = 0; lightIndex < lightingState.nLights; lightIndex++)
@@ -417,6 +456,9 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
     if (hasShadowMap)
         shaderProps.texUsage |= TexUsage::ShadowMapTexture;
 
+    if (getInstances() != nullptr)
+        shaderProps.texUsage |= TexUsage::InstancedTransform;
+
     // Get a shader for the current rendering configuration
     assert(renderer != nullptr);
     CelestiaGLProgram* prog = renderer->getShaderManager().getShader(shaderProps);
@@ -428,14 +470,14 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
 
     for (unsigned int i = 0; i < nTextures; i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
+        gl::Binder::get().activeTexture(i);
         textures[i]->bind();
     }
 
     if (hasShadowMap)
     {
-        glActiveTexture(GL_TEXTURE0 + nTextures);
-        glBindTexture(GL_TEXTURE_2D, shadowMap);
+        gl::Binder::get().activeTexture(nTextures);
+        gl::Binder::get().bindTexture(GL_TEXTURE_2D, shadowMap);
 #if GL_ONLY_SHADOWS
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
 #endif
@@ -635,7 +677,7 @@ GLSLUnlit_RenderContext::makeCurrent(const cmod::Material& m)
 
     for (unsigned int i = 0; i < nTextures; i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
+        gl::Binder::get().activeTexture(i);
         textures[i]->bind();
     }
 
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
@@ -30,6 +32,18 @@ namespace celestia::gl
 class VertexObject;
 }
 
+// Placement and light of one copy of a model drawn by an instanced draw,
+// laid out as the instance attributes of the shaders
+struct ModelInstance
+{
+    // First three rows of the model view matrix, which includes the scale
+    Eigen::Vector4f modelView0;
+    Eigen::Vector4f modelView1;
+    Eigen::Vector4f modelView2;
+    // Direction of the light in model space; w scales the light color
+    Eigen::Vector4f light;
+};
+
 class RenderContext
 {
  public:
@@ -59,9 +73,19 @@ class RenderContext
     void setPointScale(float);
     float getPointScale() const;
 
+    // Size in pixels of one model unit where the model is closest to the
+    // viewer, used to pick levels of detail; zero draws the full detail
+    void setPixelScale(float);
+    float getPixelScale() const;
+
     void setCameraOrientation(const Eigen::Quaternionf& q);
     Eigen::Quaternionf getCameraOrientation() const;
 
+    // Copies of the model to draw with each group, or nullptr to draw it
+    // once with the model view matrix of the context
+    void setInstances(const std::vector<ModelInstance>*);
+    const std::vector<ModelInstance>* getInstances() const;
+
  protected:
     Renderer* renderer { nullptr };
     bool usePointSize{ false };
@@ -75,7 +99,9 @@ class RenderContext
     bool locked{ false };
     RenderPass renderPass{ PrimaryPass };
     float pointScale{ 1.0f };
+    float pixelScale{ 0.0f };
     Eigen::Quaternionf cameraOrientation;  // required for drawing billboards
+    const std::vector<ModelInstance>* instances{ nullptr };
 };
 
 
@@ -28,6 +28,7 @@
 #include "lodspheremesh.h"
 #include "geometry.h"
 #include "texmanager.h"
+#include "textureresidency.h"
 #include "meshmanager.h"
 #include "renderinfo.h"
 #include "renderglsl.h"
@@ -43,6 +44,7 @@
 #include "planetgrid.h"
 #include "pointstarvertexbuffer.h"
 #include "pointstarrenderer.h"
+#include "staroctreetraversal.h"
 #include "orbitsampler.h"
 #include "rendcontext.h"
 #include "textlayout.h"
@@ -50,6 +52,7 @@
 #include <celastro/date.h>
 #include <celcompat/numbers.h>
 #include <celengine/observer.h>
+#include <celephem/samporbit.h>
 #include <celmath/frustum.h>
 #include <celmath/distance.h>
 #include <celmath/intersect.h>
@@ -64,23 +67,32 @@
 #include <celrender/linerenderer.h>
 #include <celrender/galaxyrenderer.h>
 #include <celrender/globularrenderer.h>
+#include <celrender/gpustarrenderer.h>
+#include <celrender/keplerorbitrenderer.h>
 #include <celrender/nebularenderer.h>
 #include <celrender/openclusterrenderer.h>
+#include <celrender/renderprofiler.h>
 #include <celrender/ringrenderer.h>
 #include <celrender/skygridrenderer.h>
+#include <celrender/gl/binder.h>
 #include <celrender/gl/buffer.h>
+#include <celrender/gl/streambuffer.h>
 #include <celrender/gl/vertexobject.h>
 #include <celutil/logger.h>
+#include <celutil/threadpool.h>
 #include <celutil/utf8.h>
 #include <celutil/timer.h>
+#include <celutil/trace.h>
 #include <celttf/truetypefont.h>
 #include "glsupport.h"
 #include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <cassert>
 #include <sstream>
 #include <iomanip>
 #include <numeric>
+#include <tuple>
 #ifdef _MSC_VER
 #include <malloc.h>
 #ifndef alloca
@@ -126,6 +138,10 @@ static const float MinOrbitSizeForLabel = 20.0f;
 // a label for it.
 static const float MinFeatureSizeForLabel = 20.0f;
 
+// Magnitude by which each step of detail reduction lowers the faintest
+// visible stars
+static const float DetailReductionMagStep = 0.5f;
+
 /* The maximum distance of the observer to the origin of coordinates before
    asterism lines and labels start to linearly fade out (in light years) */
 static const float MaxAsterismLabelsConstDist  = 6.0f;
@@ -148,10 +164,38 @@ static Texture* gaussianGlareTex = nullptr;
 
 static const float CoronaHeight = 0.2f;
 
-// Size at which the orbit cache will be flushed of old orbit paths
-static const unsigned int OrbitCacheCullThreshold = 200;
-// Age in frames at which unused orbit paths may be eliminated from the cache
-static const uint32_t OrbitCacheRetireAge = 16;
+// Time per frame spent sampling new orbit paths and moving the window of
+// existing ones; the others are sampled in later frames, and until then
+// paths are drawn from the samples they have
+static constexpr auto OrbitSampleFrameBudget = std::chrono::milliseconds(4);
+
+// Orbit paths are refined until they are within this many pixels of the
+// orbit, computing at most OrbitRefineSamples new points per frame
+static const double OrbitRefineTolerance = 0.5;
+static const unsigned int OrbitRefineSamples = 32;
+
+// Star catalogs at least this large are culled on multiple threads
+static const std::uint32_t ParallelStarCullingThreshold = 1000000;
+
+// Frame tree levels with at least this many children have their orbits
+// evaluated on the worker pool, in tasks of OrbitsPerTask orbits
+static const unsigned int ParallelOrbitThreshold = 256;
+static const std::size_t OrbitsPerTask = 64;
+
+// Size of each of the three sections of the shared vertex stream buffer.
+// Uploads larger than this fall back to the renderer's own buffers.
+static const GLsizeiptr StreamBufferSectionSize = 1024 * 1024;
+
+// Occlusion culling only considers the bodies with the largest apparent size,
+// and only if they're big enough to hide anything
+static const float MinOccluderSizeInPixels = 32.0f;
+static const std::size_t MaxOccluders = 8;
+
+// Virtual texture tiles are prefetched for where the camera will be this many
+// seconds ahead, provided that it moves by at least the given fraction of its
+// altitude in that time
+static const double PrefetchTime = 0.5;
+static const float MinPrefetchMotion = 0.05f;
 
 Color Renderer::StarLabelColor          (0.471f, 0.356f, 0.682f);
 Color Renderer::PlanetLabelColor        (0.407f, 0.333f, 0.964f);
@@ -256,7 +300,9 @@ Renderer::Renderer() :
     m_eclipticLineRenderer(std::make_unique<EclipticLineRenderer>(*this)),
     m_galaxyRenderer(std::make_unique<GalaxyRenderer>(*this)),
     m_globularRenderer(std::make_unique<GlobularRenderer>(*this)),
+    m_keplerOrbitRenderer(std::make_unique<KeplerOrbitRenderer>(*this)),
     m_largeStarRenderer(std::make_unique<LargeStarRenderer>(*this)),
+    m_largeGlareRenderer(std::make_unique<LargeStarRenderer>(*this)),
     m_hollowMarkerRenderer(std::make_unique<LineRenderer>(*this, 1.0f, LineRenderer::PrimType::Lines, LineRenderer::StorageType::Static)),
     m_nebulaRenderer(std::make_unique<NebulaRenderer>(*this)),
     m_openClusterRenderer(std::make_unique<OpenClusterRenderer>(*this)),
@@ -271,6 +317,7 @@ Renderer::Renderer() :
         fonts[i] = nullptr;
     }
     shaderManager = new ShaderManager();
+    m_modelBatch = std::make_unique<ModelBatch>();
 }
 
 
@@ -526,12 +573,18 @@ bool Renderer::init(int winWidth, int winHeight, const DetailOptions& _detailOpt
 {
     detailOptions = _detailOptions;
 
+    // Must be set before any shaders are built
+    shaderManager->setLogarithmicDepthEnabled(detailOptions.logarithmicDepth);
+
+    GetTextureResidencyManager().setBudget(static_cast<std::uint64_t>(detailOptions.virtualTextureMemory) << 20);
+
     m_atmosphereRenderer->initGL();
     if (!m_cometRenderer->initGL())
         return false;
 
     m_markerVO = std::make_unique<celestia::gl::VertexObject>();
     m_markerBO = std::make_unique<celestia::gl::Buffer>();
+    m_streamBuffer = std::make_unique<celestia::gl::StreamBuffer>(StreamBufferSectionSize);
 
     // Initialize static meshes and textures common to all instances of Renderer
     if (!commonDataInitialized)
@@ -799,6 +852,19 @@ void Renderer::setMinimumFeatureSize(float pixels)
 }
 
 
+unsigned int Renderer::getDetailReduction() const
+{
+    return detailReduction;
+}
+
+
+// Not a setting, so it doesn't mark the settings changed
+void Renderer::setDetailReduction(unsigned int steps)
+{
+    detailReduction = std::min(steps, MaxDetailReduction);
+}
+
+
 float Renderer::getMinimumOrbitSize() const
 {
     return minOrbitSize;
@@ -870,7 +936,8 @@ void Renderer::addAnnotation(vector<Annotation>& annotations,
                              LabelHorizontalAlignment halign,
                              LabelVerticalAlignment valign,
                              float size,
-                             bool special)
+                             bool special,
+                             float priority)
 {
     std::array<int, 4> view{ 0, 0, windowWidth, windowHeight };
     Vector3f win;
@@ -897,6 +964,7 @@ void Renderer::addAnnotation(vector<Annotation>& annotations,
         a.halign = halign;
         a.valign = valign;
         a.size = size;
+        a.priority = priority;
         annotations.push_back(a);
     }
 }
@@ -908,9 +976,10 @@ void Renderer::addForegroundAnnotation(const celestia::MarkerRepresentation* mar
                                        const Vector3f& pos,
                                        LabelHorizontalAlignment halign,
                                        LabelVerticalAlignment valign,
-                                       float size)
+                                       float size,
+                                       float priority)
 {
-    addAnnotation(foregroundAnnotations, markerRep, labelText, color, pos, halign, valign, size);
+    addAnnotation(foregroundAnnotations, markerRep, labelText, color, pos, halign, valign, size, false, priority);
 }
 
 
@@ -920,9 +989,10 @@ void Renderer::addBackgroundAnnotation(const celestia::MarkerRepresentation* mar
                                        const Vector3f& pos,
                                        LabelHorizontalAlignment halign,
                                        LabelVerticalAlignment valign,
-                                       float size)
+                                       float size,
+                                       float priority)
 {
-    addAnnotation(backgroundAnnotations, markerRep, labelText, color, pos, halign, valign, size);
+    addAnnotation(backgroundAnnotations, markerRep, labelText, color, pos, halign, valign, size, false, priority);
 }
 
 
@@ -932,9 +1002,94 @@ void Renderer::addSortedAnnotation(const celestia::MarkerRepresentation* markerR
                                    const Vector3f& pos,
                                    LabelHorizontalAlignment halign,
                                    LabelVerticalAlignment valign,
-                                   float size)
+                                   float size,
+                                   float priority)
+{
+    addAnnotation(depthSortedAnnotations, markerRep, labelText, color, pos, halign, valign, size, true, priority);
+}
+
+
+// Screen-space decluttering: labels are placed from the highest priority
+// down on a grid of cells about half a line high, and a label covering a
+// cell taken by an earlier one is dropped, keeping its marker. Overlaps are
+// only approximated, but this takes a single pass over the labels.
+void Renderer::declutterAnnotations(vector<Annotation>& annotations, FontStyle fs)
 {
-    addAnnotation(depthSortedAnnotations, markerRep, labelText, color, pos, halign, valign, size, true);
+    if (!detailOptions.labelDecluttering)
+        return;
+
+    auto font = getFont(fs);
+    if (font == nullptr)
+        return;
+
+    labelOrder.clear();
+    for (std::size_t i = 0; i < annotations.size(); ++i)
+    {
+        if (!annotations[i].labelText.empty())
+            labelOrder.push_back(i);
+    }
+    if (labelOrder.size() < 2)
+        return;
+
+    std::stable_sort(labelOrder.begin(), labelOrder.end(),
+                     [&annotations](std::size_t a, std::size_t b)
+                     {
+                         return annotations[a].priority > annotations[b].priority;
+                     });
+
+    const int cellSize = std::max(font->getHeight() / 2, 4);
+    const int columns = windowWidth / cellSize + 1;
+    const int rows = windowHeight / cellSize + 1;
+    labelGrid.assign(static_cast<std::size_t>(columns) * static_cast<std::size_t>(rows), 0);
+
+    for (std::size_t index : labelOrder)
+    {
+        Annotation& a = annotations[index];
+
+        TextLayout::HorizontalAlignment alignment = TextLayout::HorizontalAlignment::Left;
+        float hOffset = 0.0f;
+        float vOffset = 0.0f;
+        getLabelAlignmentInfo(a, font.get(), alignment, hOffset, vOffset);
+
+        auto width = static_cast<float>(TextLayout::getTextWidth(a.labelText, font.get()));
+        float left = std::trunc(a.position.x()) + hOffset;
+        if (alignment == TextLayout::HorizontalAlignment::Center)
+            left -= width / 2.0f;
+        else if (alignment == TextLayout::HorizontalAlignment::Right)
+            left -= width;
+
+        auto lines = static_cast<float>(std::count(a.labelText.begin(), a.labelText.end(), '\n'));
+        float baseline = std::trunc(a.position.y()) + vOffset;
+        float top = baseline + static_cast<float>(font->getMaxAscent());
+        float bottom = baseline - static_cast<float>(font->getMaxDescent()) - lines * static_cast<float>(font->getHeight());
+
+        // Labels off the screen are left to the renderer to cull
+        int x0 = std::max(static_cast<int>(std::floor(left / static_cast<float>(cellSize))), 0);
+        int x1 = std::min(static_cast<int>(std::floor((left + width) / static_cast<float>(cellSize))), columns - 1);
+        int y0 = std::max(static_cast<int>(std::floor(bottom / static_cast<float>(cellSize))), 0);
+        int y1 = std::min(static_cast<int>(std::floor(top / static_cast<float>(cellSize))), rows - 1);
+        if (x0 > x1 || y0 > y1)
+            continue;
+
+        bool overlaps = false;
+        for (int y = y0; y <= y1 && !overlaps; ++y)
+        {
+            const std::uint8_t* row = labelGrid.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(columns);
+            overlaps = std::any_of(row + x0, row + x1 + 1, [](std::uint8_t cell) { return cell != 0; });
+        }
+
+        if (overlaps)
+        {
+            a.labelText.clear();
+            continue;
+        }
+
+        for (int y = y0; y <= y1; ++y)
+        {
+            std::uint8_t* row = labelGrid.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(columns);
+            std::fill(row + x0, row + x1 + 1, 1);
+        }
+    }
 }
 
 
@@ -1079,16 +1234,54 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
 
     const auto* orbit = body != nullptr ? body->getOrbit(t) : orbitPath.star->getOrbit();
 
-    CurvePlot* cachedOrbit = nullptr;
-    if (auto cached = orbitCache.find(orbit); cached != orbitCache.end())
+    // We perform vertex tranformations on the CPU because double precision is necessary to
+    // render orbits properly. Start by computing the modelview matrix, to transform orbit
+    // vertices into camera space.
+    Affine3d modelview;
+    {
+        auto orientation = body == nullptr ? Quaterniond::Identity() : body->getOrbitFrame(t)->getOrientation(t);
+        modelview = cameraOrientation * Translation3d(orbitPath.origin) * orientation.conjugate();
+    }
+
+    bool highlight = body != nullptr ? highlightObject.body() == body : highlightObject.star() == orbitPath.star;
+    Vector4f orbitColor = renderOrbitColor(body, highlight, orbitPath.opacity);
+
+    // Keplerian orbits don't need to be sampled: unless the camera is close
+    // enough to see the difference from a fixed set of points, their paths
+    // are queued and drawn together once all orbits of the depth interval
+    // have been visited.
+    if (orbit->isPeriodic() && m_keplerOrbitRenderer->isSupported())
+    {
+        double period = orbit->getPeriod();
+        double windowEnd = t + period * detailOptions.orbitWindowEnd;
+        double windowStart = windowEnd - period * detailOptions.orbitPeriodsShown;
+
+        ephem::EllipsePath path;
+        if (orbit->getEllipsePath(windowStart, windowEnd, path) &&
+            m_keplerOrbitRenderer->add(path, modelview, pixelSize * OrbitRefineTolerance, orbitColor))
+        {
+            return;
+        }
+    }
+
+    if (lastOrbitCacheFlush != frameCount)
     {
-        cachedOrbit = cached->second;
-        cachedOrbit->setLastUsed(frameCount);
+        // Paths drawn in the last frame are kept even when the cache is
+        // over its budget, so that they aren't resampled every frame
+        orbitCache.trim(frameCount - 1);
+        orbitSampleTime = std::chrono::steady_clock::duration::zero();
+        lastOrbitCacheFlush = frameCount;
     }
 
+    CurvePlot* cachedOrbit = orbitCache.find(orbit, frameCount);
+
     // If it's not in the cache already
     if (cachedOrbit == nullptr)
     {
+        if (orbitSampleTime >= OrbitSampleFrameBudget)
+            return;
+
+        auto sampleStart = std::chrono::steady_clock::now();
         double startTime = t;
 
         // Adjust the number of samples used for aperiodic orbits--these aren't
@@ -1110,35 +1303,16 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
             }
         }
 
-        cachedOrbit = new CurvePlot(*this);
-        cachedOrbit->setLastUsed(frameCount);
+        auto path = std::make_unique<CurvePlot>(*this);
 
         OrbitSampler sampler;
         orbit->sample(startTime,
                       startTime + orbit->getPeriod(),
                       sampler);
-        sampler.insertForward(cachedOrbit);
-
-        // If the orbit cache is full, first try and eliminate some old orbits
-        if (orbitCache.size() > OrbitCacheCullThreshold)
-        {
-            // Check for old orbits at most once per frame
-            if (lastOrbitCacheFlush != frameCount)
-            {
-                for (auto iter = orbitCache.begin(); iter != orbitCache.end();)
-                {
-                    // Tricky code to eliminate a node in the orbit cache without screwing
-                    // up the iterator. Should work in all STL implementations.
-                    if (frameCount - iter->second->lastUsed() > OrbitCacheRetireAge)
-                        orbitCache.erase(iter++);
-                    else
-                        ++iter;
-                }
-                lastOrbitCacheFlush = frameCount;
-            }
-        }
+        sampler.insertForward(path.get());
 
-        orbitCache[orbit] = cachedOrbit;
+        cachedOrbit = orbitCache.insert(orbit, std::move(path), frameCount);
+        orbitSampleTime += std::chrono::steady_clock::now() - sampleStart;
     }
 
     if (cachedOrbit->empty())
@@ -1171,8 +1345,11 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
     // 'Periodic' orbits are generally not strictly periodic because of perturbations
     // from other bodies. Here we update the trajectory samples to make sure that the
     // orbit covers a time range centered at the current time and covering a full revolution.
-    if (orbit->isPeriodic())
+    // Once the frame's sampling time is used up, the path is drawn from the
+    // samples it has until a later frame moves its window.
+    if (orbit->isPeriodic() && orbitSampleTime < OrbitSampleFrameBudget)
     {
+        auto sampleStart = std::chrono::steady_clock::now();
         double period = orbit->getPeriod();
         double endTime = t + period * OrbitWindowEnd;
         double startTime = endTime - period * OrbitPeriodsShown;
@@ -1214,19 +1391,18 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
             clog << "new sample count: " << cachedOrbit->sampleCount() << endl;
 #endif
         }
-    }
 
-    // We perform vertex tranformations on the CPU because double precision is necessary to
-    // render orbits properly. Start by computing the modelview matrix, to transform orbit
-    // vertices into camera space.
-    Affine3d modelview;
-    {
-        auto orientation = body == nullptr ? Quaterniond::Identity() : body->getOrbitFrame(t)->getOrientation(t);
-        modelview = cameraOrientation * Translation3d(orbitPath.origin) * orientation.conjugate();
+        orbitSampleTime += std::chrono::steady_clock::now() - sampleStart;
     }
 
-    bool highlight = body != nullptr ? highlightObject.body() == body : highlightObject.star() == orbitPath.star;
-    Vector4f orbitColor = renderOrbitColor(body, highlight, orbitPath.opacity);
+    // The samples are only accurate enough for a distant view of the whole
+    // orbit; add points where the camera is close enough to see the error
+    cachedOrbit->refine(modelview, pixelSize * OrbitRefineTolerance, OrbitRefineSamples,
+                        [orbit](double jd, Vector3d& position, Vector3d& velocity)
+                        {
+                            position = orbit->positionAtTime(jd);
+                            velocity = orbit->velocityAtTime(jd);
+                        });
 
 #ifdef STIPPLED_LINES
     glLineStipple(3, 0x5555);
@@ -1476,11 +1652,76 @@ void Renderer::renderItem(const RenderListEntry& rle,
 }
 
 
+static void
+collectShaderProperties(const PlanetarySystem& system,
+                        unsigned int textureRes,
+                        std::uint64_t renderFlags,
+                        std::vector<ShaderProperties>& props)
+{
+    const BodyFeaturesManager* bodyFeaturesManager = GetBodyFeaturesManager();
+    const Body* primary = system.getPrimaryBody();
+    bool primaryHasRings = primary != nullptr && bodyFeaturesManager->getRings(primary) != nullptr;
+
+    for (int i = 0; i < system.getSystemSize(); i++)
+    {
+        const Body* body = system.getBody(i);
+        const PlanetarySystem* satellites = body->getSatellites();
+
+        // Only lit ellipsoids use generated shaders that depend solely on
+        // the body's definition
+        const Surface& surface = body->getSurface();
+        if (body->hasVisibleGeometry() &&
+            body->getGeometry() == InvalidResource &&
+            (surface.appearanceFlags & Surface::Emissive) == 0)
+        {
+            // Moons are eclipsed by their planet, planets by their moons
+            bool eclipseShadows = primary != nullptr || (satellites != nullptr && satellites->getSystemSize() > 0);
+            bool ringShadows = primaryHasRings || bodyFeaturesManager->getRings(body) != nullptr;
+            addEllipsoidShaderProperties(surface,
+                                         bodyFeaturesManager->getAtmosphere(body),
+                                         eclipseShadows,
+                                         ringShadows,
+                                         textureRes,
+                                         renderFlags,
+                                         props);
+        }
+
+        if (satellites != nullptr)
+            collectShaderProperties(*satellites, textureRes, renderFlags, props);
+    }
+}
+
+void Renderer::precompileShaders(const Universe& universe)
+{
+    const SolarSystemCatalog* solarSystems = universe.getSolarSystemCatalog();
+    if (solarSystems == nullptr)
+        return;
+
+    std::vector<ShaderProperties> props;
+    for (const auto& [index, solarSystem] : *solarSystems)
+    {
+        if (const PlanetarySystem* planets = solarSystem->getPlanets(); planets != nullptr)
+            collectShaderProperties(*planets, textureResolution, renderFlags, props);
+    }
+
+    // Many bodies share a configuration
+    std::sort(props.begin(), props.end());
+    auto last = std::unique(props.begin(), props.end(),
+                            [](const ShaderProperties& p0, const ShaderProperties& p1) { return !(p0 < p1) && !(p1 < p0); });
+    props.erase(last, props.end());
+
+    GetLogger()->verbose("Precompiling {} shaders\n", props.size());
+    for (const ShaderProperties& p : props)
+        shaderManager->precompile(p);
+}
+
 void Renderer::render(const Observer& observer,
                       const Universe& universe,
                       float faintestMagNight,
                       const Selection& sel)
 {
+    util::TraceScope trace("Renderer::render");
+
     // Get the observer's time
     double now = observer.getTime();
     realTime = observer.getRealTime();
@@ -1488,6 +1729,27 @@ void Renderer::render(const Observer& observer,
     frameCount++;
     settingsChanged = false;
 
+    // The frontend may have changed the bindings since the last frame
+    gl::Binder::get().invalidate();
+
+    if (m_profilingEnabled != (m_profiler != nullptr))
+        m_profiler = m_profilingEnabled ? std::make_unique<RenderProfiler>() : nullptr;
+    if (m_profiler != nullptr)
+        m_profiler->beginFrame();
+
+    // Render settings are usually restored after init(), so wait for the
+    // first frame to find out which shaders the bodies need
+    if (!m_shadersPrecompiled)
+    {
+        precompileShaders(universe);
+        m_shadersPrecompiled = true;
+    }
+    shaderManager->updatePrecompilation();
+    GetTextureResidencyManager().beginFrame();
+    unloadUnusedResources();
+
+    m_prefetchOffset = observer.predictPosition(PrefetchTime).offsetFromKm(observer.getPosition()).cast<float>();
+
     // Compute the size of a pixel
     float zoom = observer.getZoom();
     setFieldOfView(math::radToDeg(getProjectionMode()->getFOV(zoom)));
@@ -1528,6 +1790,7 @@ void Renderer::render(const Observer& observer,
     // large enough to have discernible surface detail are also placed in
     // renderList.
     renderList.clear();
+    renderListObserver = &observer;
     orbitPathList.clear();
     lightSourceList.clear();
     secondaryIlluminators.clear();
@@ -1544,6 +1807,8 @@ void Renderer::render(const Observer& observer,
         saturationMag = saturationMagNight;
     }
 
+    faintestMag -= DetailReductionMagStep * static_cast<float>(detailReduction);
+
     faintestPlanetMag = faintestMag;
     if ((renderFlags & (ShowSolarSystemObjects | ShowOrbits)) != 0)
     {
@@ -1591,12 +1856,14 @@ void Renderer::render(const Observer& observer,
     // Render deep sky objects
     if ((renderFlags & ShowDeepSpaceObjects) != 0 && universe.getDSOCatalog() != nullptr)
     {
+        RenderProfiler::Scope scope(m_profiler.get(), RenderPass::DeepSkyObjects);
         renderDeepSkyObjects(universe, observer, faintestMag);
     }
 
     // Render stars
     if ((renderFlags & ShowStars) != 0 && universe.getStarCatalog() != nullptr)
     {
+        RenderProfiler::Scope scope(m_profiler.get(), RenderPass::Stars);
         renderPointStars(*universe.getStarCatalog(), faintestMag, observer);
     }
 
@@ -1644,6 +1911,7 @@ void Renderer::render(const Observer& observer,
 
     // Sort the annotations
     sort(depthSortedAnnotations.begin(), depthSortedAnnotations.end());
+    declutterAnnotations(depthSortedAnnotations, FontNormal);
 
     // Sort the orbit paths
     sort(orbitPathList.begin(), orbitPathList.end());
@@ -1653,7 +1921,10 @@ void Renderer::render(const Observer& observer,
 #endif
 
     int nIntervals = buildDepthPartitions();
-    renderSolarSystemObjects(observer, nIntervals, now);
+    {
+        RenderProfiler::Scope scope(m_profiler.get(), RenderPass::SolarSystem);
+        renderSolarSystemObjects(observer, nIntervals, now);
+    }
 
     renderForegroundAnnotations(FontNormal);
 
@@ -1665,6 +1936,9 @@ void Renderer::render(const Observer& observer,
 #ifndef GL_ES
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 #endif
+
+    if (m_profiler != nullptr)
+        m_profiler->endFrame();
 }
 
 static Eigen::Vector3f
@@ -1738,8 +2012,7 @@ void Renderer::renderObjectAsPoint(const Vector3f& position,
                                    float discSizeInPixels,
                                    const Color &color,
                                    bool useHalos,
-                                   bool emissive,
-                                   const Matrices &mvp)
+                                   bool emissive)
 {
     const bool useScaledDiscs = starStyle == ScaledDiscStars;
     float maxDiscSize = useScaledDiscs ? MaxScaledDiscStarSize : 1.0f;
@@ -1768,17 +2041,9 @@ void Renderer::renderObjectAsPoint(const Vector3f& position,
         if (glareSize != 0.0f)
             glareSize = std::max(glareSize, pointSize * discSizeInPixels / scale * 3.0f);
 
-        Renderer::PipelineState ps;
-        ps.blending = true;
-        ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
-        ps.depthTest = true;
-        setPipelineState(ps);
-
-        if (starStyle != PointStars)
-            gaussianDiscTex->bind();
-
+        // The points are drawn at the end of the depth interval
         if (pointSize > gl::maxPointSize)
-            m_largeStarRenderer->render(position, {color, alpha}, pointSize, mvp);
+            m_largeStarRenderer->addStar(position, {color, alpha}, pointSize);
         else
             pointStarVertexBuffer->addStar(position, {color, alpha}, pointSize);
 
@@ -1791,9 +2056,8 @@ void Renderer::renderObjectAsPoint(const Vector3f& position,
         if (useHalos && glareAlpha > 0.0f)
         {
             Eigen::Vector3f center = calculateQuadCenter(getCameraOrientationf(), position, radius);
-            gaussianGlareTex->bind();
             if (glareSize > gl::maxPointSize)
-                m_largeStarRenderer->render(center, {color, glareAlpha}, glareSize, mvp);
+                m_largeGlareRenderer->addStar(center, {color, glareAlpha}, glareSize);
             else
                 glareVertexBuffer->addStar(center, {color, glareAlpha}, glareSize);
         }
@@ -1883,7 +2147,7 @@ Renderer::locationsToAnnotations(const Body& body,
                                  const Quaterniond& bodyOrientation)
 {
     assert(GetBodyFeaturesManager()->hasLocations(&body));
-    auto locations = GetBodyFeaturesManager()->getLocations(&body);
+    const LocationLabelData& labels = GetBodyFeaturesManager()->getLocationLabels(&body);
 
     Vector3f semiAxes = body.getSemiAxes();
 
@@ -1901,14 +2165,26 @@ Renderer::locationsToAnnotations(const Body& body,
 
     Matrix3d bodyMatrix = bodyOrientation.conjugate().toRotationMatrix();
 
-    for (const auto location : *locations)
+    // No location is closer than the surface of the bounding sphere, so
+    // below this label size the remaining locations are all too small.
+    double minDist = bodyCenter.norm() - std::max(boundingRadius, static_cast<double>(body.getBoundingRadius()));
+    float featureSize = minFeatureSize * static_cast<float>(1u << detailReduction);
+    auto minLabelSize = static_cast<float>(std::max(minDist, 0.0) * pixelSize * featureSize * 0.999);
+
+    auto labelCount = static_cast<std::size_t>(std::lower_bound(labels.labelSizes.begin(), labels.labelSizes.end(),
+                                                                minLabelSize, std::greater<float>()) -
+                                               labels.labelSizes.begin());
+    for (std::size_t i = 0; i < labelCount; ++i)
     {
-        auto featureType = location->getFeatureType();
+        auto featureType = labels.featureTypes[i];
         if ((featureType & locationFilter) == 0)
             continue;
 
+        float effSize = labels.labelSizes[i];
+        const Location* location = labels.locations[i];
+
         // Get the position of the location with respect to the planet center
-        Vector3f ppos = location->getPosition();
+        Vector3f ppos = labels.positions[i];
 
         // Compute the bodycentric position of the location
         Vector3d locPos = ppos.cast<double>();
@@ -1920,12 +2196,8 @@ Renderer::locationsToAnnotations(const Body& body,
         // Get the camera space label position
         Vector3d labelPos = bodyCenter + bodyMatrix * locPos;
 
-        float effSize = location->getImportance();
-        if (effSize < 0.0f)
-            effSize = location->getSize();
-
         if (float pixSize = effSize / (float) (labelPos.norm() * pixelSize);
-            pixSize <= minFeatureSize || labelPos.dot(viewNormal) <= 0.0)
+            pixSize <= featureSize || labelPos.dot(viewNormal) <= 0.0)
         {
             continue;
         }
@@ -2048,10 +2320,12 @@ setupObjectLighting(const vector<LightSource>& suns,
     if (nLights == 0)
         return;
 
+    Vector3d objpos = objPosition_eye.cast<double>();
+
     unsigned int i;
     for (i = 0; i < nLights; i++)
     {
-        Vector3d dir = suns[i].position - objPosition_eye.cast<double>();
+        Vector3d dir = suns[i].position - objpos;
 
         ls.lights[i].direction_eye = dir.cast<float>();
         float distance = ls.lights[i].direction_eye.norm();
@@ -2072,7 +2346,6 @@ setupObjectLighting(const vector<LightSource>& suns,
     {
         float maxIrr = 0.0f;
         unsigned int maxIrrSource = 0, counter = 0;
-        Vector3d objpos = objPosition_eye.cast<double>();
 
         // Only account for light from the brightest secondary source
         for (auto& illuminator : secondaryIlluminators)
@@ -2222,7 +2495,7 @@ void Renderer::renderObject(const Vector3f& pos,
     if (obj.geometry != InvalidResource)
     {
         // This is a model loaded from a file
-        geometry = engine::GetGeometryManager()->find(obj.geometry);
+        geometry = engine::GetGeometryManager()->request(obj.geometry);
     }
 
     // Get the textures . . .
@@ -2283,7 +2556,8 @@ void Renderer::renderObject(const Vector3f& pos,
 
     ri.orientation = getCameraOrientationf() * obj.orientation.conjugate();
 
-    ri.pixWidth = discSizeInPixels;
+    ri.pixWidth = discSizeInPixels / static_cast<float>(1u << detailReduction);
+    ri.pixelScale = scaleFactors.maxCoeff() / (max(nearPlaneDistance, altitude) * pixelSize);
 
     // Set up the colors
     if (ri.baseTex == nullptr ||
@@ -2374,6 +2648,14 @@ void Renderer::renderObject(const Vector3f& pos,
 
     if (obj.geometry == InvalidResource)
     {
+        // Cloud textures scroll, so only the surface is prefetched
+        std::array<Texture*, 5> surfaceTextures{ ri.baseTex, ri.bumpTex, ri.nightTex, ri.glossTex, ri.overlayTex };
+        auto endTextures = std::remove(surfaceTextures.begin(), surfaceTextures.end(), nullptr);
+        prefetchSurfaceTiles(pos, obj, scaleFactors,
+                             nearPlaneDistance, farPlaneDistance, observer.getZoom(),
+                             surfaceTextures.data(),
+                             static_cast<int>(endTextures - surfaceTextures.begin()));
+
         // A null model indicates that this body is a sphere
         if (lit)
         {
@@ -2399,16 +2681,21 @@ void Renderer::renderObject(const Vector3f& pos,
 
             if (lit)
             {
-                renderGeometry_GLSL(geometry,
-                                    ri,
-                                    texOverride,
-                                    ls,
-                                    obj.atmosphere,
-                                    geometryScale,
-                                    renderFlags,
-                                    obj.orientation,
-                                    astro::daysToSecs(now - astro::J2000),
-                                    planetMVP, this);
+                double tsec = astro::daysToSecs(now - astro::J2000);
+                if (!batchModel(geometry, texOverride, ri, ls, geometryScale, obj.orientation,
+                                planetMV, *m.projection, tsec))
+                {
+                    renderGeometry_GLSL(geometry,
+                                        ri,
+                                        texOverride,
+                                        ls,
+                                        obj.atmosphere,
+                                        geometryScale,
+                                        renderFlags,
+                                        obj.orientation,
+                                        tsec,
+                                        planetMVP, this);
+                }
             }
             else
             {
@@ -2421,7 +2708,7 @@ void Renderer::renderObject(const Vector3f& pos,
                                           astro::daysToSecs(now - astro::J2000),
                                           planetMVP, this);
             }
-            glActiveTexture(GL_TEXTURE0);
+            gl::Binder::get().activeTexture(0);
         }
     }
 
@@ -2432,6 +2719,7 @@ void Renderer::renderObject(const Vector3f& pos,
         segmentSizeInPixels = 2.0f * obj.rings->outerRadius / (max(nearPlaneDistance, altitude) * pixelSize);
         if (distance <= obj.rings->innerRadius)
         {
+            RenderProfiler::Scope scope(m_profiler.get(), RenderPass::Rings);
             m_ringRenderer->renderRings(*obj.rings, ri, ls,
                                         radius, 1.0f - obj.semiAxes.y(),
                                         (renderFlags & ShowRingShadows) != 0 && lit,
@@ -2461,6 +2749,8 @@ void Renderer::renderObject(const Vector3f& pos,
 
         if (fade > 0 && (renderFlags & ShowAtmospheres) != 0 && atmosphere->height > 0.0f)
         {
+            RenderProfiler::Scope scope(m_profiler.get(), RenderPass::Atmospheres);
+
             // Only use new atmosphere code in OpenGL 2.0 path when new style parameters are defined.
             // TODO: convert old style atmopshere parameters
             if (atmosphere->mieScaleHeight > 0.0f)
@@ -2552,6 +2842,7 @@ void Renderer::renderObject(const Vector3f& pos,
 
         if (distance > obj.rings->innerRadius)
         {
+            RenderProfiler::Scope scope(m_profiler.get(), RenderPass::Rings);
             m_ringRenderer->renderRings(*obj.rings, ri, ls,
                                         radius, 1.0f - obj.semiAxes.y(),
                                         (renderFlags & ShowRingShadows) != 0 && lit,
@@ -2562,148 +2853,192 @@ void Renderer::renderObject(const Vector3f& pos,
 }
 
 
+// Look up the eclipse caster record of a body, evaluating its position the
+// first time it's needed in a frame. Returns nullptr for bodies that can't
+// cast shadows.
+const Renderer::EclipseCaster*
+Renderer::getEclipseCaster(const Body& body, double now)
+{
+    if (eclipseCasterFrame != frameCount)
+    {
+        eclipseCasterCache.clear();
+        eclipseCasterFrame = frameCount;
+    }
+
+    auto [it, inserted] = eclipseCasterCache.try_emplace(&body);
+    if (inserted)
+    {
+        // Ignore eclipses where the caster is not an ellipsoid, since we
+        // can't generate correct shadows in this case.
+        if (body.hasVisibleGeometry() &&
+            util::is_set(body.getClassification(), bodyVisibilityMask) &&
+            body.extant(now) &&
+            body.isEllipsoid())
+        {
+            it->second = EclipseCaster{ &body,
+                                        body.getAstrocentricPosition(now),
+                                        body.getRadius(),
+                                        GetBodyFeaturesManager()->getRings(&body) };
+        }
+    }
+
+    return it->second.has_value() ? &*it->second : nullptr;
+}
+
+
+void Renderer::addEclipseCaster(const Body& receiver, const Body& caster, double now)
+{
+    // Ignore situations where the shadow casting body is much smaller than
+    // the receiver, as these shadows aren't likely to be relevant.
+    if (caster.getRadius() < receiver.getRadius() * MinRelativeOccluderRadius)
+        return;
+
+    if (const EclipseCaster* record = getEclipseCaster(caster, now); record != nullptr)
+        eclipseCasters.push_back(record);
+}
+
+
 bool Renderer::testEclipse(const Body& receiver,
-                           const Body& caster,
+                           const Vector3d& posReceiver,
+                           const EclipseCaster& eclipseCaster,
                            LightingState& lightingState,
                            unsigned int lightIndex,
                            double now)
 {
     bool isReceiverShadowed = false;
+    const Body& caster = *eclipseCaster.body;
+
+    const DirectionalLight& light = lightingState.lights[lightIndex];
+    LightingState::EclipseShadowVector& shadows = *lightingState.shadows[lightIndex];
+
+    // All of the eclipse related code assumes that both the caster
+    // and receiver are spherical.  Irregular receivers will work more
+    // or less correctly, but casters that are sufficiently non-spherical
+    // will produce obviously incorrect shadows.  Another assumption we
+    // make is that the distance between the caster and receiver is much
+    // less than the distance between the sun and the receiver.  This
+    // approximation works everywhere in the solar system, and is likely
+    // valid for any orbitally stable pair of objects orbiting a star.
+    const Vector3d& posCaster = eclipseCaster.position;
+
+    //const Star* sun = receiver.getSystem()->getStar();
+    //assert(sun != nullptr);
+    //double distToSun = posReceiver.distanceFromOrigin();
+    //float appSunRadius = (float) (sun->getRadius() / distToSun);
+    float appSunRadius = light.apparentSize;
+
+    Vector3d dir = posCaster - posReceiver;
+
+    // Broadphase rejection: the caster must lie on the sunward side of
+    // the receiver, with the receiver no farther from the shadow axis
+    // than the shadow (or ring shadow) could reach.
+    double reach = receiver.getRadius() + eclipseCaster.radius;
+    if (eclipseCaster.rings != nullptr)
+        reach = std::max(reach, static_cast<double>(receiver.getRadius() + eclipseCaster.rings->outerRadius));
+    if (dir.dot(light.position) <= -reach * light.position.norm())
+        return false;
 
-    // Ignore situations where the shadow casting body is much smaller than
-    // the receiver, as these shadows aren't likely to be relevant.  Also,
-    // ignore eclipses where the caster is not an ellipsoid, since we can't
-    // generate correct shadows in this case.
-    if (caster.getRadius() >= receiver.getRadius() * MinRelativeOccluderRadius &&
-        caster.hasVisibleGeometry() &&
-        util::is_set(caster.getClassification(), bodyVisibilityMask) &&
-        caster.extant(now) &&
-        caster.isEllipsoid())
-    {
-        const DirectionalLight& light = lightingState.lights[lightIndex];
-        LightingState::EclipseShadowVector& shadows = *lightingState.shadows[lightIndex];
-
-        // All of the eclipse related code assumes that both the caster
-        // and receiver are spherical.  Irregular receivers will work more
-        // or less correctly, but casters that are sufficiently non-spherical
-        // will produce obviously incorrect shadows.  Another assumption we
-        // make is that the distance between the caster and receiver is much
-        // less than the distance between the sun and the receiver.  This
-        // approximation works everywhere in the solar system, and is likely
-        // valid for any orbitally stable pair of objects orbiting a star.
-        Vector3d posReceiver = receiver.getAstrocentricPosition(now);
-        Vector3d posCaster = caster.getAstrocentricPosition(now);
-
-        //const Star* sun = receiver.getSystem()->getStar();
-        //assert(sun != nullptr);
-        //double distToSun = posReceiver.distanceFromOrigin();
-        //float appSunRadius = (float) (sun->getRadius() / distToSun);
-        float appSunRadius = light.apparentSize;
-
-        Vector3d dir = posCaster - posReceiver;
-        double distToCaster = dir.norm() - receiver.getRadius();
-        float appOccluderRadius = (float) (caster.getRadius() / distToCaster);
-
-        // The shadow radius is the radius of the occluder plus some additional
-        // amount that depends upon the apparent radius of the sun.  For
-        // a sun that's distant/small and effectively a point, the shadow
-        // radius will be the same as the radius of the occluder.
-        float shadowRadius = (1 + appSunRadius / appOccluderRadius) *
-            caster.getRadius();
-
-        // Test whether a shadow is cast on the receiver.  We want to know
-        // if the receiver lies within the shadow volume of the caster.  Since
-        // we're assuming that everything is a sphere and the sun is far
-        // away relative to the caster, the shadow volume is a
-        // cylinder capped at one end.  Testing for the intersection of a
-        // singly capped cylinder is as simple as checking the distance
-        // from the center of the receiver to the axis of the shadow cylinder.
-        // If the distance is less than the sum of the caster's and receiver's
-        // radii, then we have an eclipse. We also need to verify that the
-        // receiver is behind the caster when seen from the light source.
-        float R = receiver.getRadius() + shadowRadius;
-
-        // The stored light position is receiver-relative; thus the caster-to-light
-        // direction is casterPos - (receiverPos + lightPos)
-        Vector3d lightPosition = posReceiver + light.position;
-        Vector3d lightToCasterDir = posCaster - lightPosition;
-        Vector3d receiverToCasterDir = posReceiver - posCaster;
-
-        double dist = math::distance(posReceiver,
-                                     Eigen::ParametrizedLine<double, 3>(posCaster, lightToCasterDir));
-        if (dist < R && lightToCasterDir.dot(receiverToCasterDir) > 0.0)
-        {
-            Vector3d sunDir = lightToCasterDir.normalized();
-
-            EclipseShadow shadow;
-            shadow.origin = dir.cast<float>();
-            shadow.direction = sunDir.cast<float>();
-            shadow.penumbraRadius = shadowRadius;
-
-            // The umbra radius will be positive if the apparent size of the occluder
-            // is greater than the apparent size of the sun, zero if they're equal,
-            // and negative when the eclipse is partial. The absolute value of the
-            // umbra radius is the radius of the shadow region with constant depth:
-            // for total eclipses, this area is actually the umbra, with a depth of
-            // 1. For annular eclipses and transits, it is less than 1.
-            shadow.umbraRadius = caster.getRadius() *
-                (appOccluderRadius - appSunRadius) / appOccluderRadius;
-            shadow.maxDepth = std::min(1.0f, math::square(appOccluderRadius / appSunRadius));
-            shadow.caster = &caster;
-
-            // Ignore transits that don't produce a visible shadow.
-            if (shadow.maxDepth > 1.0f / 256.0f)
-                shadows.push_back(shadow);
-
-            isReceiverShadowed = true;
-        }
+    double distToCaster = dir.norm() - receiver.getRadius();
+    float appOccluderRadius = (float) (caster.getRadius() / distToCaster);
+
+    // The shadow radius is the radius of the occluder plus some additional
+    // amount that depends upon the apparent radius of the sun.  For
+    // a sun that's distant/small and effectively a point, the shadow
+    // radius will be the same as the radius of the occluder.
+    float shadowRadius = (1 + appSunRadius / appOccluderRadius) *
+        caster.getRadius();
+
+    // Test whether a shadow is cast on the receiver.  We want to know
+    // if the receiver lies within the shadow volume of the caster.  Since
+    // we're assuming that everything is a sphere and the sun is far
+    // away relative to the caster, the shadow volume is a
+    // cylinder capped at one end.  Testing for the intersection of a
+    // singly capped cylinder is as simple as checking the distance
+    // from the center of the receiver to the axis of the shadow cylinder.
+    // If the distance is less than the sum of the caster's and receiver's
+    // radii, then we have an eclipse. We also need to verify that the
+    // receiver is behind the caster when seen from the light source.
+    float R = receiver.getRadius() + shadowRadius;
+
+    // The stored light position is receiver-relative; thus the caster-to-light
+    // direction is casterPos - (receiverPos + lightPos)
+    Vector3d lightPosition = posReceiver + light.position;
+    Vector3d lightToCasterDir = posCaster - lightPosition;
+    Vector3d receiverToCasterDir = posReceiver - posCaster;
+
+    double dist = math::distance(posReceiver,
+                                 Eigen::ParametrizedLine<double, 3>(posCaster, lightToCasterDir));
+    if (dist < R && lightToCasterDir.dot(receiverToCasterDir) > 0.0)
+    {
+        Vector3d sunDir = lightToCasterDir.normalized();
+
+        EclipseShadow shadow;
+        shadow.origin = dir.cast<float>();
+        shadow.direction = sunDir.cast<float>();
+        shadow.penumbraRadius = shadowRadius;
+
+        // The umbra radius will be positive if the apparent size of the occluder
+        // is greater than the apparent size of the sun, zero if they're equal,
+        // and negative when the eclipse is partial. The absolute value of the
+        // umbra radius is the radius of the shadow region with constant depth:
+        // for total eclipses, this area is actually the umbra, with a depth of
+        // 1. For annular eclipses and transits, it is less than 1.
+        shadow.umbraRadius = caster.getRadius() *
+            (appOccluderRadius - appSunRadius) / appOccluderRadius;
+        shadow.maxDepth = std::min(1.0f, math::square(appOccluderRadius / appSunRadius));
+        shadow.caster = &caster;
+
+        // Ignore transits that don't produce a visible shadow.
+        if (shadow.maxDepth > 1.0f / 256.0f)
+            shadows.push_back(shadow);
+
+        isReceiverShadowed = true;
+    }
 
-        // If the caster has a ring system, see if it casts a shadow on the receiver.
-        // Ring shadows are only supported in the OpenGL 2.0 path.
-        const BodyFeaturesManager* bodyFeaturesManager = GetBodyFeaturesManager();
-        if (auto rings = bodyFeaturesManager->getRings(&caster); rings != nullptr)
-        {
-            bool shadowed = false;
+    // If the caster has a ring system, see if it casts a shadow on the receiver.
+    // Ring shadows are only supported in the OpenGL 2.0 path.
+    if (auto rings = eclipseCaster.rings; rings != nullptr)
+    {
+        bool shadowed = false;
 
-            // The shadow volume of the rings is an oblique circular cylinder
-            if (dist < rings->outerRadius + receiver.getRadius())
+        // The shadow volume of the rings is an oblique circular cylinder
+        if (dist < rings->outerRadius + receiver.getRadius())
+        {
+            // Possible intersection, but it depends on the orientation of the
+            // rings.
+            Quaterniond casterOrientation = caster.getOrientation(now);
+            Vector3d ringPlaneNormal = casterOrientation * Vector3d::UnitY();
+            Vector3d shadowDirection = lightToCasterDir.normalized();
+            Vector3d v = ringPlaneNormal.cross(shadowDirection);
+            if (v.squaredNorm() < 1.0e-6)
             {
-                // Possible intersection, but it depends on the orientation of the
-                // rings.
-                Quaterniond casterOrientation = caster.getOrientation(now);
-                Vector3d ringPlaneNormal = casterOrientation * Vector3d::UnitY();
-                Vector3d shadowDirection = lightToCasterDir.normalized();
-                Vector3d v = ringPlaneNormal.cross(shadowDirection);
-                if (v.squaredNorm() < 1.0e-6)
-                {
-                    // Shadow direction is nearly coincident with ring plane normal, so
-                    // the shadow cross section is close to circular. No additional test
-                    // is required.
-                    shadowed = true;
-                }
-                else
+                // Shadow direction is nearly coincident with ring plane normal, so
+                // the shadow cross section is close to circular. No additional test
+                // is required.
+                shadowed = true;
+            }
+            else
+            {
+                // minDistance is the cross section of the ring shadows in the plane
+                // perpendicular to the ring plane and containing the light direction.
+                Vector3d shadowPlaneNormal = v.normalized().cross(shadowDirection);
+                Hyperplane<double, 3> shadowPlane(shadowPlaneNormal, posCaster - posReceiver);
+                double minDistance = receiver.getRadius() +
+                    rings->outerRadius * ringPlaneNormal.dot(shadowDirection);
+                if (abs(shadowPlane.signedDistance(Vector3d::Zero())) < minDistance)
                 {
-                    // minDistance is the cross section of the ring shadows in the plane
-                    // perpendicular to the ring plane and containing the light direction.
-                    Vector3d shadowPlaneNormal = v.normalized().cross(shadowDirection);
-                    Hyperplane<double, 3> shadowPlane(shadowPlaneNormal, posCaster - posReceiver);
-                    double minDistance = receiver.getRadius() +
-                        rings->outerRadius * ringPlaneNormal.dot(shadowDirection);
-                    if (abs(shadowPlane.signedDistance(Vector3d::Zero())) < minDistance)
-                    {
-                        // TODO: Implement this test and only set shadowed to true if it passes
-                    }
-                    shadowed = true;
+                    // TODO: Implement this test and only set shadowed to true if it passes
                 }
+                shadowed = true;
+            }
 
-                if (shadowed)
-                {
-                    RingShadow& shadow = lightingState.ringShadows[lightIndex];
-                    shadow.origin = dir.cast<float>();
-                    shadow.direction = shadowDirection.cast<float>();
-                    shadow.ringSystem = rings;
-                    shadow.casterOrientation = casterOrientation.cast<float>();
-                }
+            if (shadowed)
+            {
+                RingShadow& shadow = lightingState.ringShadows[lightIndex];
+                shadow.origin = dir.cast<float>();
+                shadow.direction = shadowDirection.cast<float>();
+                shadow.ringSystem = rings;
+                shadow.casterOrientation = casterOrientation.cast<float>();
             }
         }
     }
@@ -2712,6 +3047,48 @@ bool Renderer::testEclipse(const Body& receiver,
 }
 
 
+// Ask the virtual textures of an ellipsoid for the tiles that will be needed
+// once the camera has moved to its predicted position. The camera is assumed
+// to keep its orientation.
+void Renderer::prefetchSurfaceTiles(const Vector3f& pos,
+                                    const RenderProperties& obj,
+                                    const Vector3f& scaleFactors,
+                                    float nearPlaneDistance,
+                                    float farPlaneDistance,
+                                    float zoom,
+                                    Texture** textures,
+                                    int nTextures)
+{
+    if (nTextures == 0)
+        return;
+
+    float radius = obj.radius;
+    float altitude = max(nearPlaneDistance, pos.norm() - radius);
+    if (m_prefetchOffset.norm() < altitude * MinPrefetchMotion)
+        return;
+
+    Vector3f predictedPos = pos - m_prefetchOffset;
+    float predictedAltitude = predictedPos.norm() - radius;
+    float discSizeInPixels = radius / (max(nearPlaneDistance, predictedAltitude) * pixelSize);
+
+    // Same far plane as renderObject() uses
+    float d = predictedPos.norm();
+    float eradius = scaleFactors.minCoeff();
+    float frustumFarPlane = d > eradius
+        ? std::sqrt(math::square(d) - math::square(eradius)) * 1.1f
+        : farPlaneDistance;
+
+    Affine3f invModelView = obj.orientation *
+                            Translation3f(-predictedPos / radius) *
+                            getCameraOrientationf().conjugate();
+    auto viewFrustum = projectionMode->getFrustum(nearPlaneDistance / radius, frustumFarPlane / radius, zoom);
+    viewFrustum.transform(invModelView.matrix());
+
+    g_lodSphere->prefetch(viewFrustum, discSizeInPixels / static_cast<float>(1u << detailReduction),
+                          textures, nTextures);
+}
+
+
 void Renderer::renderPlanet(Body& body,
                             const Vector3f& pos,
                             float distance,
@@ -2749,8 +3126,8 @@ void Renderer::renderPlanet(Body& body,
         rp.semiAxes = body.getSemiAxes() * (1.0f / rp.radius);
         rp.geometryScale = body.getGeometryScale();
 
-        Quaterniond q = body.getRotationModel(now)->spin(now) *
-                        body.getEclipticToEquatorial(now);
+        // Same as spin * ecliptic to equatorial, but from the body's cache
+        Quaterniond q = body.getOrientation(now);
 
         rp.orientation = body.getGeometryOrientation() * q.cast<float>();
 
@@ -2759,9 +3136,20 @@ void Renderer::renderPlanet(Body& body,
 
         Vector3f scaleFactors;
         bool isNormalized = false;
+        // Models are loaded in the background; draw the ellipsoid until the
+        // model is ready
         const Geometry* geometry = nullptr;
         if (rp.geometry != InvalidResource)
-            geometry = engine::GetGeometryManager()->find(rp.geometry);
+        {
+            engine::GeometryManager* geometryManager = engine::GetGeometryManager();
+            geometry = geometryManager->request(rp.geometry);
+            if (geometry == nullptr &&
+                rp.geometry != engine::GetEmptyGeometryHandle() &&
+                geometryManager->getState(rp.geometry) != ResourceState::LoadingFailed)
+            {
+                rp.geometry = InvalidResource;
+            }
+        }
         if (geometry == nullptr || geometry->isNormalized())
         {
             scaleFactors = rp.semiAxes * rp.radius;
@@ -2809,6 +3197,9 @@ void Renderer::renderPlanet(Body& body,
         // Calculate eclipse circumstances
         if ((renderFlags & ShowEclipseShadows) != 0 && body.getSystem() != nullptr)
         {
+            // Gather the potential casters once for all lights; their
+            // positions are shared with the other receivers drawn this frame.
+            eclipseCasters.clear();
             if (const auto *system = body.getSystem(); system->getPrimaryBody() == nullptr)
             {
                 // The body is a planet.  Check for eclipse shadows
@@ -2816,48 +3207,45 @@ void Renderer::renderPlanet(Body& body,
                 if (const auto *satellites = body.getSatellites(); satellites != nullptr)
                 {
                     int nSatellites = satellites->getSystemSize();
-                    for (unsigned int li = 0; li < lights.nLights; li++)
-                    {
-                        if (lights.lights[li].castsShadows)
-                        {
-                            for (int i = 0; i < nSatellites; i++)
-                            {
-                                testEclipse(body, *satellites->getBody(i), lights, li, now);
-                            }
-                        }
-                    }
+                    for (int i = 0; i < nSatellites; i++)
+                        addEclipseCaster(body, *satellites->getBody(i), now);
                 }
             }
             else
             {
+                // The body is a moon.  Check for eclipse shadows from
+                // the parent planet and all satellites in the system.
+                // Traverse up the hierarchy so that any parent objects
+                // of the parent are also considered (TODO: their child
+                // objects will not be checked for shadows.)
+                const Body* planet = system->getPrimaryBody();
+                while (planet != nullptr)
+                {
+                    addEclipseCaster(body, *planet, now);
+                    if (planet->getSystem() != nullptr)
+                        planet = planet->getSystem()->getPrimaryBody();
+                    else
+                        planet = nullptr;
+                }
+
+                int nSatellites = system->getSystemSize();
+                for (int i = 0; i < nSatellites; i++)
+                {
+                    if (system->getBody(i) != &body)
+                        addEclipseCaster(body, *system->getBody(i), now);
+                }
+            }
+
+            if (!eclipseCasters.empty())
+            {
+                Vector3d posReceiver = body.getAstrocentricPosition(now);
                 for (unsigned int li = 0; li < lights.nLights; li++)
                 {
-                    if (lights.lights[li].castsShadows)
-                    {
-                        // The body is a moon.  Check for eclipse shadows from
-                        // the parent planet and all satellites in the system.
-                        // Traverse up the hierarchy so that any parent objects
-                        // of the parent are also considered (TODO: their child
-                        // objects will not be checked for shadows.)
-                        const Body* planet = system->getPrimaryBody();
-                        while (planet != nullptr)
-                        {
-                            testEclipse(body, *planet, lights, li, now);
-                            if (planet->getSystem() != nullptr)
-                                planet = planet->getSystem()->getPrimaryBody();
-                            else
-                                planet = nullptr;
-                        }
-
-                        int nSatellites = system->getSystemSize();
-                        for (int i = 0; i < nSatellites; i++)
-                        {
-                            if (system->getBody(i) != &body)
-                            {
-                                testEclipse(body, *system->getBody(i), lights, li, now);
-                            }
-                        }
-                    }
+                    if (!lights.lights[li].castsShadows)
+                        continue;
+
+                    for (const EclipseCaster* caster : eclipseCasters)
+                        testEclipse(body, posReceiver, *caster, lights, li, now);
                 }
             }
         }
@@ -2973,7 +3361,7 @@ void Renderer::renderPlanet(Body& body,
                                 appMag,
                                 discSizeInPixels,
                                 body.getSurface().color * (1.0f / maxCoeff), // normalize point color; 'darkness' is handled by size of point determined by GeomAlbedo.
-                                false, false, m);
+                                false, false);
         }
     }
 }
@@ -3050,8 +3438,7 @@ void Renderer::renderStar(const Star& star,
                         appMag,
                         discSizeInPixels,
                         color,
-                        star.hasCorona(), true,
-                        m);
+                        star.hasCorona(), true);
 }
 
 
@@ -3232,7 +3619,7 @@ void Renderer::addRenderListEntries(RenderListEntry& rle,
 
         if (body.getGeometry() != InvalidResource && rle.discSizeInPixels > 1)
         {
-            const Geometry* geometry = engine::GetGeometryManager()->find(body.getGeometry());
+            const Geometry* geometry = engine::GetGeometryManager()->request(body.getGeometry());
             if (geometry == nullptr)
                 rle.isOpaque = true;
             else
@@ -3290,23 +3677,49 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
     double invCosViewAngle = 1.0 / cosViewConeAngle;
     double sinViewAngle = sqrt(1.0 - math::square(cosViewConeAngle));
 
-    unsigned int nChildren = tree != nullptr ? tree->childCount() : 0;
-    for (unsigned int i = 0; i < nChildren; i++)
+    if (tree == nullptr)
+        return;
+
+    // Only the phases active now need anything done, and in large systems
+    // only those in clusters that may be visible
+    const std::vector<const TimelinePhase*>* activePhases = &tree->activeChildren(now);
+    std::vector<const TimelinePhase*> unculledPhases;
+    if (const std::vector<FrameTreeCluster>* clusters = tree->childClusters(now); clusters != nullptr)
     {
-        const TimelinePhase* phase = tree->getChild(i);
+        cullChildClusters(*clusters, *activePhases, astrocentricObserverPos, viewPlaneNormal, frameCenter,
+                          labelClassMask, unculledPhases);
+        activePhases = &unculledPhases;
+    }
 
-        // No need to do anything if the phase isn't active now
-        if (!phase->includes(now))
-            continue;
+    const std::vector<const TimelinePhase*>& phases = *activePhases;
+    auto nChildren = static_cast<unsigned int>(phases.size());
 
+    // Evaluate the orbits of large systems up front so that they can be
+    // computed in parallel; the rest stays serial to keep the render list
+    // order unchanged.
+    std::vector<Vector3d> positions;
+    if (nChildren >= ParallelOrbitThreshold)
+        computeOrbitPositions(positions, frameCenter, phases, now);
+
+    for (unsigned int i = 0; i < nChildren; i++)
+    {
+        const TimelinePhase* phase = phases[i];
         Body* body = phase->body();
 
         // pos_s: sun-relative position of object
         // pos_v: viewer-relative position of object
 
         // Get the position of the body relative to the sun.
-        Vector3d p = phase->orbit()->positionAtTime(now);
-        Vector3d pos_s = frameCenter + phase->orbitFrame()->getOrientation(now).conjugate() * p;
+        Vector3d pos_s;
+        if (positions.empty())
+        {
+            Vector3d p = phase->orbit()->positionAtTime(now);
+            pos_s = frameCenter + phase->orbitFrame()->getOrientation(now).conjugate() * p;
+        }
+        else
+        {
+            pos_s = positions[i];
+        }
 
         // We now have the positions of the observer and the planet relative
         // to the sun.  From these, compute the position of the body
@@ -3500,38 +3913,131 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
 }
 
 
-void Renderer::buildOrbitLists(const Vector3d& astrocentricObserverPos,
-                               const Quaterniond& observerOrientation,
-                               const math::InfiniteFrustum& viewFrustum,
-                               const FrameTree* tree,
-                               double now)
+// Collect the phases of the clusters that may contribute to the render
+// lists, using the same tests as for subtrees in buildRenderLists. The
+// phases are kept in their original order.
+void Renderer::cullChildClusters(const std::vector<FrameTreeCluster>& clusters,
+                                 const std::vector<const TimelinePhase*>& phases,
+                                 const Vector3d& astrocentricObserverPos,
+                                 const Vector3d& viewPlaneNormal,
+                                 const Vector3d& frameCenter,
+                                 BodyClassification labelClassMask,
+                                 std::vector<const TimelinePhase*>& unculledPhases) const
 {
-    Matrix3d viewMat = observerOrientation.toRotationMatrix();
-    Vector3d viewMatZ = viewMat.row(2);
+    double invCosViewAngle = 1.0 / cosViewConeAngle;
+    double sinViewAngle = sqrt(1.0 - math::square(cosViewConeAngle));
 
-    unsigned int nChildren = tree != nullptr ? tree->childCount() : 0;
-    for (unsigned int i = 0; i < nChildren; i++)
+    std::vector<unsigned int> unculled;
+    for (const FrameTreeCluster& cluster : clusters)
     {
-        const TimelinePhase* phase = tree->getChild(i);
+        if (cluster.bounded && !cluster.containsSecondaryIlluminators)
+        {
+            Vector3d pos_v = frameCenter + cluster.center - astrocentricObserverPos;
 
-        // No need to do anything if the phase isn't active now
-        if (!phase->includes(now))
-            continue;
+            // Labeled objects are shown whatever their size and brightness
+            auto minPossibleDistance = (float) (pos_v.norm() - cluster.radius);
+            if (minPossibleDistance > 1.0f && !util::is_set(cluster.orbitClassMask, labelClassMask))
+            {
+                float lum = 0.0f;
+                for (const auto &lightSource : lightSourceList)
+                {
+                    Eigen::Vector3d sunPos = pos_v - lightSource.position;
+                    lum += luminosityAtOpposition(lightSource.luminosity, (float) sunPos.norm(), (float) cluster.maxChildRadius);
+                }
+                float brightestPossible = astro::lumToAppMag(lum, astro::kilometersToLightYears(minPossibleDistance));
+                float largestPossible = (float) cluster.maxChildRadius / minPossibleDistance / pixelSize;
+                if (brightestPossible >= faintestPlanetMag && largestPossible <= 1.0f)
+                    continue;
+            }
 
-        Body* body = phase->body();
+            // View cone test, as for the bodies themselves
+            double dist_vn = viewPlaneNormal.dot(pos_v);
+            if (dist_vn <= -cluster.radius)
+                continue;
 
-        // pos_s: sun-relative position of object
-        // pos_v: viewer-relative position of object
+            double maxPerpDist = (cluster.radius + dist_vn * sinViewAngle) * invCosViewAngle;
+            if ((pos_v - dist_vn * viewPlaneNormal).squaredNorm() >= maxPerpDist * maxPerpDist)
+                continue;
+        }
 
-        // Get the position of the body relative to the sun.
-        Vector3d pos_s = body->getAstrocentricPosition(now);
+        unculled.insert(unculled.end(), cluster.children.begin(), cluster.children.end());
+    }
 
-        // We now have the positions of the observer and the planet relative
-        // to the sun.  From these, compute the position of the body
-        // relative to the observer.
-        Vector3d pos_v = pos_s - astrocentricObserverPos;
+    std::sort(unculled.begin(), unculled.end());
+    unculledPhases.reserve(unculled.size());
+    for (unsigned int i : unculled)
+        unculledPhases.push_back(phases[i]);
+}
 
-        // Only show orbits for major bodies or selected objects.
+
+// Compute the frame center relative positions of the active phases of a
+// frame tree. Frames are shared between many bodies and cache their orientation,
+// so they are evaluated first on this thread; orbits are evaluated on the
+// worker pool when they allow it.
+void Renderer::computeOrbitPositions(std::vector<Vector3d>& positions,
+                                     const Vector3d& frameCenter,
+                                     const std::vector<const TimelinePhase*>& phases,
+                                     double now)
+{
+    auto nChildren = static_cast<unsigned int>(phases.size());
+    positions.resize(nChildren);
+
+    std::vector<std::pair<unsigned int, Quaterniond>> parallelOrbits;
+    parallelOrbits.reserve(nChildren);
+    for (unsigned int i = 0; i < nChildren; i++)
+    {
+        const TimelinePhase* phase = phases[i];
+        Quaterniond orientation = phase->orbitFrame()->getOrientation(now).conjugate();
+        if (phase->orbit()->isThreadSafe())
+            parallelOrbits.emplace_back(i, orientation);
+        else
+            positions[i] = frameCenter + orientation * phase->orbit()->positionAtTime(now);
+    }
+
+    std::size_t nTasks = (parallelOrbits.size() + OrbitsPerTask - 1) / OrbitsPerTask;
+    getWorkerPool().parallelFor(nTasks,
+                                [&](std::size_t task, unsigned int /* worker */)
+                                {
+                                    std::size_t end = std::min(parallelOrbits.size(), (task + 1) * OrbitsPerTask);
+                                    for (std::size_t j = task * OrbitsPerTask; j < end; ++j)
+                                    {
+                                        const auto& [i, orientation] = parallelOrbits[j];
+                                        Vector3d p = phases[i]->orbit()->positionAtTime(now);
+                                        positions[i] = frameCenter + orientation * p;
+                                    }
+                                });
+}
+
+
+void Renderer::buildOrbitLists(const Vector3d& astrocentricObserverPos,
+                               const Quaterniond& observerOrientation,
+                               const math::InfiniteFrustum& viewFrustum,
+                               const FrameTree* tree,
+                               double now)
+{
+    Matrix3d viewMat = observerOrientation.toRotationMatrix();
+    Vector3d viewMatZ = viewMat.row(2);
+
+    if (tree == nullptr)
+        return;
+
+    // Only the phases active now need anything done
+    for (const TimelinePhase* phase : tree->activeChildren(now))
+    {
+        Body* body = phase->body();
+
+        // pos_s: sun-relative position of object
+        // pos_v: viewer-relative position of object
+
+        // Get the position of the body relative to the sun.
+        Vector3d pos_s = body->getAstrocentricPosition(now);
+
+        // We now have the positions of the observer and the planet relative
+        // to the sun.  From these, compute the position of the body
+        // relative to the observer.
+        Vector3d pos_v = pos_s - astrocentricObserverPos;
+
+        // Only show orbits for major bodies or selected objects.
         Body::VisibilityPolicy orbitVis = body->getOrbitVisibility();
 
         if (body->isVisible() &&
@@ -3739,7 +4245,9 @@ void Renderer::buildLabelLists(const math::InfiniteFrustum& viewFrustum,
         Color labelColor = getBodyLabelColor(ri.body->getOrbitClassification());
         float opacity = sizeFade(boundingRadiusSize, minOrbitSize, 2.0f);
         labelColor.alpha(opacity * labelColor.alpha());
-        addSortedAnnotation(nullptr, body->getName(true), labelColor, pos);
+        addSortedAnnotation(nullptr, body->getName(true), labelColor, pos,
+                            LabelHorizontalAlignment::Start, LabelVerticalAlignment::Bottom,
+                            0.0f, -ri.appMag);
     } // for each render list entry
 }
 
@@ -3798,6 +4306,8 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
                                 float faintestMagNight,
                                 const Observer& observer)
 {
+    util::TraceScope trace("Renderer::renderPointStars");
+
 #ifndef GL_ES
     // Disable multisample rendering when drawing point stars
     bool toggleAA = (starStyle == Renderer::PointStars && isMSAAEnabled());
@@ -3830,6 +4340,9 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
     starRenderer.labelThresholdMag = 1.2f * max(1.0f, (faintestMag - 4.0f) * (1.0f - 0.5f * std::log10(effDistanceToScreen)));
 
     starRenderer.colorTemp = &starColors;
+    starRenderer.discSize = BaseStarDiscSize * static_cast<float>(screenDpi) / 96.0f;
+    starRenderer.brightnessScale = brightnessScale;
+    starRenderer.brightnessBias = brightnessBias;
 
     gaussianDiscTex->bind();
     starRenderer.starVertexBuffer->setTexture(gaussianDiscTex);
@@ -3849,12 +4362,53 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
     setPipelineState(ps);
 
-    starDB.findVisibleStars(starRenderer,
-                            obsPos.cast<float>(),
-                            getCameraOrientationf(),
-                            math::degToRad(fov),
-                            getAspectRatio(),
-                            faintestMagNight);
+    if (m_gpuStarRenderer != nullptr && starStyle != PointStars &&
+        renderPointStarsGPU(starDB, faintestMagNight, starRenderer))
+    {
+        // Only the close stars and the labels are left to starRenderer
+    }
+    else if (PointStarCollector* precull = takeStarPrecull(obsPos.cast<float>(),
+                                                           faintestMagNight,
+                                                           starRenderer.aggregateThreshold());
+             precull != nullptr)
+    {
+        precull->flush(starRenderer);
+    }
+    else if (starDB.size() < ParallelStarCullingThreshold)
+    {
+        starDB.processVisibleStars(starRenderer,
+                                   &m_starVisibilityCache,
+                                   obsPos.cast<float>(),
+                                   getCameraOrientationf(),
+                                   math::degToRad(fov),
+                                   getAspectRatio(),
+                                   faintestMagNight);
+    }
+    else
+    {
+        util::ThreadPool& pool = getWorkerPool();
+        if (m_starCollectors.size() != pool.concurrency())
+            m_starCollectors.resize(pool.concurrency());
+
+        std::vector<StarHandler*> starHandlers;
+        starHandlers.reserve(m_starCollectors.size());
+        for (PointStarCollector& collector : m_starCollectors)
+        {
+            collector.threshold = starRenderer.aggregateThreshold();
+            starHandlers.push_back(&collector);
+        }
+
+        starDB.findVisibleStars(pool,
+                                starHandlers,
+                                obsPos.cast<float>(),
+                                getCameraOrientationf(),
+                                math::degToRad(fov),
+                                getAspectRatio(),
+                                faintestMagNight);
+
+        for (PointStarCollector& collector : m_starCollectors)
+            collector.flush(starRenderer);
+    }
 
     starRenderer.starVertexBuffer->finish();
     starRenderer.glareVertexBuffer->finish();
@@ -3866,10 +4420,200 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
 #endif
 }
 
+void Renderer::precullStars(const StarDatabase& starDB,
+                            const std::vector<PrecullView>& views,
+                            float faintestMagNight)
+{
+    discardPrecull();
+
+    // Catalogs above the threshold are already culled by all workers for
+    // each view, and the GPU star renderer leaves little to cull.
+    if ((renderFlags & ShowStars) == 0 ||
+        starDB.size() >= ParallelStarCullingThreshold ||
+        (m_gpuStarRenderer != nullptr && starStyle != PointStars))
+    {
+        return;
+    }
+
+    // Compute the culling parameters the same way render() does, so that
+    // takeStarPrecull() finds them again
+    int savedWidth = windowWidth;
+    int savedHeight = windowHeight;
+    m_starPreculls.resize(views.size());
+    if (m_precullStars.size() < views.size())
+        m_precullStars.resize(views.size());
+
+    // Each group of views is culled by one task sharing a visibility cache
+    std::vector<std::vector<std::size_t>> groups;
+    for (std::size_t i = 0; i < views.size(); ++i)
+    {
+        const PrecullView& view = views[i];
+        resize(view.width, view.height);
+
+        float zoom = view.observer->getZoom();
+        StarPrecull& precull = m_starPreculls[i];
+        precull.position = view.observer->getPosition().toLy().cast<float>();
+        precull.orientation = (Quaterniond(m_cameraTransform) * view.observer->getOrientation()).cast<float>();
+        precull.fovY = math::degToRad(math::radToDeg(projectionMode->getFOV(zoom)));
+        precull.aspectRatio = getAspectRatio();
+        if ((renderFlags & ShowAutoMag) != 0)
+            precull.limitingMag = faintestAutoMag45deg * std::sqrt(projectionMode->getFieldCorrection(zoom));
+        else
+            precull.limitingMag = faintestMagNight;
+        precull.threshold = projectionMode->getPixelSize(zoom);
+        precull.used = false;
+        m_precullStars[i].threshold = precull.threshold;
+
+        auto group = std::find_if(groups.begin(), groups.end(),
+                                  [&](const std::vector<std::size_t>& g)
+                                  {
+                                      const StarPrecull& first = m_starPreculls[g.front()];
+                                      return first.fovY == precull.fovY &&
+                                             first.aspectRatio == precull.aspectRatio &&
+                                             first.limitingMag == precull.limitingMag &&
+                                             (first.position - precull.position).norm() <= StarVisibilityCache::PositionTolerance &&
+                                             first.orientation.angularDistance(precull.orientation) <= StarVisibilityCache::AngleTolerance;
+                                  });
+        if (group == groups.end())
+            groups.emplace_back(1, i);
+        else
+            group->push_back(i);
+    }
+    resize(savedWidth, savedHeight);
+
+    if (m_precullCaches.size() < groups.size())
+        m_precullCaches.resize(groups.size());
+
+    getWorkerPool().parallelFor(groups.size(),
+                                [&](std::size_t task, unsigned int /* worker */)
+                                {
+                                    for (std::size_t i : groups[task])
+                                    {
+                                        const StarPrecull& precull = m_starPreculls[i];
+                                        starDB.processVisibleStars(m_precullStars[i],
+                                                                   &m_precullCaches[task],
+                                                                   precull.position,
+                                                                   precull.orientation,
+                                                                   precull.fovY,
+                                                                   precull.aspectRatio,
+                                                                   precull.limitingMag);
+                                    }
+                                });
+}
+
+void Renderer::discardPrecull()
+{
+    for (std::size_t i = 0; i < m_starPreculls.size(); ++i)
+    {
+        if (!m_starPreculls[i].used)
+            m_precullStars[i].clear();
+    }
+    m_starPreculls.clear();
+}
+
+// Returns the stars found by precullStars() for the view being drawn, or
+// nullptr if it was not preculled or has changed since.
+PointStarCollector* Renderer::takeStarPrecull(const Eigen::Vector3f& obsPosition,
+                                              float limitingMag,
+                                              float threshold)
+{
+    Quaternionf orientation = getCameraOrientationf();
+    float fovY = math::degToRad(fov);
+    float aspectRatio = getAspectRatio();
+    for (std::size_t i = 0; i < m_starPreculls.size(); ++i)
+    {
+        StarPrecull& precull = m_starPreculls[i];
+        if (!precull.used &&
+            precull.position == obsPosition &&
+            precull.orientation.coeffs() == orientation.coeffs() &&
+            precull.fovY == fovY &&
+            precull.aspectRatio == aspectRatio &&
+            precull.limitingMag == limitingMag &&
+            precull.threshold == threshold)
+        {
+            precull.used = true;
+            return &m_precullStars[i];
+        }
+    }
+
+    return nullptr;
+}
+
+bool Renderer::renderPointStarsGPU(const StarDatabase& starDB,
+                                   float faintestMagNight,
+                                   PointStarRenderer& starRenderer)
+{
+    Vector3f obsPos = starRenderer.obsPos.cast<float>();
+
+    starDB.findVisibleStarRanges(m_gpuStarRanges,
+                                 obsPos,
+                                 getCameraOrientationf(),
+                                 math::degToRad(fov),
+                                 getAspectRatio(),
+                                 faintestMagNight);
+
+    // Draw the pending stars, the vertex buffers assume that their shader
+    // stays bound between batches.
+    starRenderer.starVertexBuffer->finish();
+    starRenderer.glareVertexBuffer->finish();
+
+    GPUStarRenderer::Parameters params;
+    params.obsPosition = obsPos;
+    params.faintestMag = faintestMag;
+    params.limitingMag = faintestMagNight;
+    params.brightnessScale = brightnessScale;
+    params.brightnessBias = brightnessBias;
+    params.saturationMag = satPoint;
+    params.baseSize = BaseStarDiscSize * static_cast<float>(getScreenDpi()) / 96.0f;
+    params.minDistance = SolarSystemMaxDistance;
+    params.maxDistance = distanceLimit;
+    params.scaledDiscs = starStyle == ScaledDiscStars;
+    if (!m_gpuStarRenderer->render(starDB, starColors, m_gpuStarRanges, params, gaussianDiscTex, gaussianGlareTex))
+        return false;
+
+    starRenderer.drawDistantStars = false;
+    starDB.processCloseStars(starRenderer, obsPos, SolarSystemMaxDistance);
+
+    if ((labelMode & StarLabels) != 0)
+    {
+        starRenderer.addCloseStars = false;
+        starDB.processVisibleStars(starRenderer,
+                                   nullptr,
+                                   obsPos,
+                                   getCameraOrientationf(),
+                                   math::degToRad(fov),
+                                   getAspectRatio(),
+                                   starRenderer.labelThresholdMag);
+    }
+
+    return true;
+}
+
+// Adjusts the deep sky object limit so that drawing them fits into the
+// frame time budget: the limit drops in proportion to the overshoot, and
+// recovers by a quarter per frame while drawing is well under budget.
+void Renderer::updateDSOLimit(float elapsedMs, std::size_t nDrawn)
+{
+    constexpr std::size_t MinAdaptiveDSOs = 64;
+
+    float budget = detailOptions.dsoFrameTimeBudget;
+    if (elapsedMs > budget)
+    {
+        auto target = static_cast<std::size_t>(static_cast<float>(nDrawn) * budget / elapsedMs);
+        m_dsoAdaptiveLimit = std::max(target, MinAdaptiveDSOs);
+    }
+    else if (nDrawn >= m_dsoAdaptiveLimit && elapsedMs < 0.75f * budget)
+    {
+        m_dsoAdaptiveLimit += m_dsoAdaptiveLimit / 4 + 1;
+    }
+}
+
 void Renderer::renderDeepSkyObjects(const Universe& universe,
                                     const Observer& observer,
                                     const float     faintestMagNight)
 {
+    util::TraceScope trace("Renderer::renderDeepSkyObjects");
+
     DSORenderer dsoRenderer;
 
     auto cameraOrientation = getCameraOrientationf();
@@ -3915,6 +4659,9 @@ void Renderer::renderDeepSkyObjects(const Universe& universe,
     openClusterRep = MarkerRepresentation(MarkerRepresentation::Circle,   8.0f, OpenClusterLabelColor);
     globularRep    = MarkerRepresentation(MarkerRepresentation::Circle,   8.0f, GlobularLabelColor);
 
+    m_dsoCandidates.clear();
+    dsoRenderer.candidates = &m_dsoCandidates;
+
     dsoDB->findVisibleDSOs(dsoRenderer,
                            obsPos,
                            cameraOrientation,
@@ -3922,11 +4669,33 @@ void Renderer::renderDeepSkyObjects(const Universe& universe,
                            getAspectRatio(),
                            2 * faintestMagNight);
 
+    auto startTime = std::chrono::steady_clock::now();
+
+    // Over budget, keep only the brightest objects
+    std::size_t limit = m_dsoAdaptiveLimit;
+    if (detailOptions.maxDSOsPerFrame != 0)
+        limit = std::min(limit, static_cast<std::size_t>(detailOptions.maxDSOsPerFrame));
+    if (m_dsoCandidates.size() > limit)
+    {
+        std::nth_element(m_dsoCandidates.begin(), m_dsoCandidates.begin() + limit, m_dsoCandidates.end(),
+                         [](const auto& c0, const auto& c1) { return c0.appMag < c1.appMag; });
+        m_dsoCandidates.resize(limit);
+    }
+
+    for (const auto& candidate : m_dsoCandidates)
+        dsoRenderer.submit(candidate);
+
     m_galaxyRenderer->render();
     m_globularRenderer->render();
     m_nebulaRenderer->render();
     m_openClusterRenderer->render();
 
+    if (detailOptions.dsoFrameTimeBudget > 0.0f)
+    {
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        updateDSOLimit(elapsed.count(), m_dsoCandidates.size());
+    }
+
     // clog << "DSOs processed: " << dsoRenderer.dsosProcessed << endl;
 }
 
@@ -4070,15 +4839,21 @@ Renderer::renderAnnotationMarker(const Annotation &a,
     const celestia::MarkerRepresentation& markerRep = *a.markerRep;
     float size = a.size > 0.0f ? a.size : markerRep.size();
 
-    glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, a.color);
-
-    Matrix4f mv = math::translate(*m.modelview, (float)(int)a.position.x(), (float)(int)a.position.y(), depth);
+    Vector3f center((float)(int)a.position.x(), (float)(int)a.position.y(), depth);
+    Matrix4f mv = math::translate(*m.modelview, center);
     Matrices mm = { m.projection, &mv };
 
+    // Symbols are drawn in batches by renderQueuedMarkers when possible
     if (markerRep.symbol() == celestia::MarkerRepresentation::Crosshair)
+    {
+        glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, a.color);
         renderCrosshair(size, realTime, a.color, mm);
-    else
+    }
+    else if (!queueMarker(markerRep.symbol(), size, a.color, center))
+    {
+        glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, a.color);
         markerRep.render(*this, size, mm);
+    }
 
     if (!markerRep.label().empty())
     {
@@ -4095,25 +4870,24 @@ Renderer::renderAnnotationMarker(const Annotation &a,
     }
 }
 
+// Adds a label to the batch of the font, between TextLayout::begin() and
+// TextureFont::endBatch()
 void
 Renderer::renderAnnotationLabel(const Annotation &a,
                                 TextLayout &layout,
+                                TextureFont &font,
                                 float hOffset,
                                 float vOffset,
-                                float depth,
-                                const Matrices &m)
+                                float depth)
 {
-    glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, a.color);
+    font.setBatchOrigin(Vector3f(std::trunc(a.position.x()) + hOffset + PixelOffset,
+                                 std::trunc(a.position.y()) + vOffset + PixelOffset,
+                                 depth),
+                        a.color);
 
-    Matrix4f mv = math::translate(*m.modelview,
-                                     std::trunc(a.position.x()) + hOffset + PixelOffset,
-                                     std::trunc(a.position.y()) + vOffset + PixelOffset,
-                                     depth);
-
-    layout.begin(*m.projection, mv);
     layout.moveAbsolute(0.0f, 0.0f);
     layout.render(a.labelText);
-    layout.end();
+    layout.flush();
 }
 
 // stars and constellations. DSOs
@@ -4136,7 +4910,14 @@ void Renderer::renderAnnotations(const vector<Annotation>& annotations,
         {
             renderAnnotationMarker(annotation, layout, 0.0f, m);
         }
+    }
+    renderQueuedMarkers(m);
 
+    // The labels are drawn after the markers, all in one batch
+    layout.begin(m_orthoProjMatrix, mv);
+    font->beginBatch();
+    for (const auto &annotation : annotations)
+    {
         if (!annotation.labelText.empty())
         {
             TextLayout::HorizontalAlignment alignment = TextLayout::HorizontalAlignment::Left;
@@ -4146,15 +4927,19 @@ void Renderer::renderAnnotations(const vector<Annotation>& annotations,
             getLabelAlignmentInfo(annotation, font.get(), alignment, hOffset, vOffset);
 
             layout.setHorizontalAlignment(alignment);
-            renderAnnotationLabel(annotation, layout, hOffset, vOffset, 0.0f, m);
+            renderAnnotationLabel(annotation, layout, *font, hOffset, vOffset, 0.0f);
         }
     }
+    font->endBatch();
+    layout.end();
 }
 
 
 void
 Renderer::renderBackgroundAnnotations(FontStyle fs)
 {
+    RenderProfiler::Scope scope(m_profiler.get(), RenderPass::Annotations);
+
     Renderer::PipelineState ps;
     ps.blending = true;
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
@@ -4162,6 +4947,7 @@ Renderer::renderBackgroundAnnotations(FontStyle fs)
     ps.smoothLines = true;
     setPipelineState(ps);
 
+    declutterAnnotations(backgroundAnnotations, fs);
     renderAnnotations(backgroundAnnotations, fs);
     backgroundAnnotations.clear();
 }
@@ -4170,6 +4956,8 @@ Renderer::renderBackgroundAnnotations(FontStyle fs)
 void
 Renderer::renderForegroundAnnotations(FontStyle fs)
 {
+    RenderProfiler::Scope scope(m_profiler.get(), RenderPass::Annotations);
+
     Renderer::PipelineState ps;
     ps.blending = true;
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
@@ -4189,6 +4977,8 @@ Renderer::renderSortedAnnotations(vector<Annotation>::iterator iter,
                                   float farDist,
                                   FontStyle fs)
 {
+    RenderProfiler::Scope scope(m_profiler.get(), RenderPass::Annotations);
+
     Renderer::PipelineState ps;
     ps.blending = true;
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
@@ -4224,30 +5014,45 @@ Renderer::renderAnnotations(vector<Annotation>::iterator startIter,
     // projection matrix in order to get the label text position exactly right but need to mimic
     // the depth coordinate generation of a projection.
 
-    vector<Annotation>::iterator iter = startIter;
-    for (; iter != endIter && iter->position.z() > nearDist; ++iter)
+    auto getDepth = [&](const Annotation &a)
     {
         // Compute normalized device z
-        float z = getProjectionMode()->getNormalizedDeviceZ(nearDist, farDist, iter->position.z());
-        float ndc_z = std::clamp(z, -1.0f, 1.0f);
+        float z = detailOptions.logarithmicDepth
+            ? LogDepthNormalizedDeviceZ(-a.position.z())
+            : getProjectionMode()->getNormalizedDeviceZ(nearDist, farDist, a.position.z());
+        return std::clamp(z, -1.0f, 1.0f);
+    };
 
+    vector<Annotation>::iterator iter = startIter;
+    for (; iter != endIter && iter->position.z() > nearDist; ++iter)
+    {
         if (iter->markerRep != nullptr)
         {
-            renderAnnotationMarker(*iter, layout, ndc_z, m);
+            renderAnnotationMarker(*iter, layout, getDepth(*iter), m);
         }
+    }
+    renderQueuedMarkers(m);
 
-        if (!iter->labelText.empty())
+    // The labels are drawn after the markers, all in one batch; they are
+    // depth tested, so their order within the batch doesn't matter
+    layout.begin(m_orthoProjMatrix, mv);
+    font->beginBatch();
+    for (auto labelIter = startIter; labelIter != iter; ++labelIter)
+    {
+        if (!labelIter->labelText.empty())
         {
             TextLayout::HorizontalAlignment alignment = TextLayout::HorizontalAlignment::Left;
             float labelHOffset = 0.0f;
             float labelVOffset = 0.0f;
 
-            getLabelAlignmentInfo(*iter, font.get(), alignment, labelHOffset, labelVOffset);
+            getLabelAlignmentInfo(*labelIter, font.get(), alignment, labelHOffset, labelVOffset);
 
             layout.setHorizontalAlignment(alignment);
-            renderAnnotationLabel(*iter, layout, labelHOffset, labelVOffset, ndc_z, m);
+            renderAnnotationLabel(*labelIter, layout, *font, labelHOffset, labelVOffset, getDepth(*labelIter));
         }
     }
+    font->endBatch();
+    layout.end();
 
     return iter;
 }
@@ -4322,40 +5127,63 @@ Renderer::StarStyle Renderer::getStarStyle() const
 
 void Renderer::loadTextures(Body* body)
 {
-    Surface& surface = body->getSurface();
+    PreloadProgress progress;
+    preload(body, progress);
+}
+
+
+void Renderer::preload(Body* body, PreloadProgress& progress)
+{
+    TextureManager* textureManager = GetTextureManager();
+    auto addTexture = [&](MultiResTexture& texture)
+    {
+        if (texture.tex[textureResolution] == InvalidResource)
+            return;
+
+        ++progress.total;
+        // Requests the texture, and falls back to another resolution if
+        // this one is missing
+        texture.find(textureResolution);
+        if (ResourceState state = textureManager->getState(texture.tex[textureResolution]);
+            state == ResourceState::Loaded || state == ResourceState::LoadingFailed)
+        {
+            ++progress.ready;
+        }
+    };
 
-    if (surface.baseTexture.tex[textureResolution] != InvalidResource)
-        surface.baseTexture.find(textureResolution);
-    if ((surface.appearanceFlags & Surface::ApplyBumpMap) != 0 &&
-        surface.bumpTexture.tex[textureResolution] != InvalidResource)
-        surface.bumpTexture.find(textureResolution);
+    Surface& surface = body->getSurface();
+    addTexture(surface.baseTexture);
+    if ((surface.appearanceFlags & Surface::ApplyBumpMap) != 0)
+        addTexture(surface.bumpTexture);
     if ((surface.appearanceFlags & Surface::ApplyNightMap) != 0 &&
         (renderFlags & ShowNightMaps) != 0)
-        surface.nightTexture.find(textureResolution);
-    if ((surface.appearanceFlags & Surface::SeparateSpecularMap) != 0 &&
-        surface.specularTexture.tex[textureResolution] != InvalidResource)
-        surface.specularTexture.find(textureResolution);
+        addTexture(surface.nightTexture);
+    if ((surface.appearanceFlags & Surface::SeparateSpecularMap) != 0)
+        addTexture(surface.specularTexture);
 
     const BodyFeaturesManager* bodyFeaturesManager = GetBodyFeaturesManager();
     if ((renderFlags & ShowCloudMaps) != 0)
     {
-        Atmosphere* atmosphere = bodyFeaturesManager->getAtmosphere(body);
-        if (atmosphere != nullptr && atmosphere->cloudTexture.tex[textureResolution] != InvalidResource)
-            atmosphere->cloudTexture.find(textureResolution);
+        if (Atmosphere* atmosphere = bodyFeaturesManager->getAtmosphere(body); atmosphere != nullptr)
+            addTexture(atmosphere->cloudTexture);
     }
 
-    if (auto rings = bodyFeaturesManager->getRings(body);
-        rings != nullptr && rings->texture.tex[textureResolution] != InvalidResource)
-    {
-        rings->texture.find(textureResolution);
-    }
+    if (auto rings = bodyFeaturesManager->getRings(body); rings != nullptr)
+        addTexture(rings->texture);
 
     if (body->getGeometry() != InvalidResource)
     {
-        Geometry* geometry = engine::GetGeometryManager()->find(body->getGeometry());
+        ++progress.total;
+        auto geometryManager = engine::GetGeometryManager();
+        Geometry* geometry = geometryManager->request(body->getGeometry());
         if (geometry != nullptr)
         {
             geometry->loadTextures();
+            ++progress.ready;
+        }
+        else if (geometryManager->getState(body->getGeometry()) == ResourceState::LoadingFailed)
+        {
+            ++progress.ready;
         }
     }
 }
@@ -4434,6 +5262,15 @@ void Renderer::setSolarSystemMaxDistance(float t)
 }
 
 
+void Renderer::setGPUStarRendering(bool enable)
+{
+    if (!enable)
+        m_gpuStarRenderer = nullptr;
+    else if (m_gpuStarRenderer == nullptr)
+        m_gpuStarRenderer = std::make_unique<GPUStarRenderer>(*this);
+}
+
+
 void Renderer::getViewport(int* x, int* y, int* w, int* h) const
 {
     if (x != nullptr)
@@ -4533,6 +5370,16 @@ Renderer::getPreferredCaptureFormat() const noexcept
 #endif
 }
 
+bool
+Renderer::packsRowsInverted() const noexcept
+{
+#ifdef GL_ES
+    return false;
+#else
+    return detailOptions.useMesaPackInvert;
+#endif
+}
+
 bool Renderer::captureFrame(int x, int y, int w, int h, PixelFormat format, unsigned char* buffer) const
 {
     glReadPixels(x, y, w, h, toGLFormat(format), GL_UNSIGNED_BYTE, (void*) buffer);
@@ -4623,7 +5470,7 @@ static void draw_rectangle_solid(const Renderer &renderer,
     if (vbo == 0u)
         glGenBuffers(1, &vbo);
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    gl::Binder::get().bind(gl::Buffer::TargetHint::Array, vbo);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(RectVtx), vertices.data(), GL_STREAM_DRAW);
 
     glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
@@ -4654,7 +5501,7 @@ static void draw_rectangle_solid(const Renderer &renderer,
         glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
     if (r.hasColors)
         glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl::Binder::get().unbind(gl::Buffer::TargetHint::Array);
 }
 
 void Renderer::drawRectangle(const celestia::Rect &r,
@@ -4775,36 +5622,137 @@ bool Renderer::getInfo(map<string, string>& info) const
     if (s != nullptr)
         info["Extensions"] = s;
 
+    // Pass times in milliseconds, e.g. "CPUTimeStars" and "GPUTimeStars"
+    if (m_profiler != nullptr)
+    {
+        for (unsigned int i = 0; i < static_cast<unsigned int>(RenderPass::Count); ++i)
+        {
+            auto pass = static_cast<RenderPass>(i);
+            const char* name = RenderProfiler::getPassName(pass);
+            info[fmt::format("CPUTime{}", name)] = fmt::format("{:.3f}", m_profiler->getCPUTime(pass));
+            if (m_profiler->hasGPUTimes())
+                info[fmt::format("GPUTime{}", name)] = fmt::format("{:.3f}", m_profiler->getGPUTime(pass));
+        }
+    }
+
+    // Virtual texture tiles; memory in bytes, the budget is zero if unlimited
+    const TextureResidencyManager& residency = GetTextureResidencyManager();
+    info["VirtualTextureTiles"] = to_string(residency.getResidentTiles());
+    info["VirtualTextureMemory"] = to_string(residency.getResidentBytes());
+    info["VirtualTextureBudget"] = to_string(residency.getBudget());
+    info["VirtualTextureEvictions"] = to_string(residency.getEvictedTiles());
+
+    // Estimated memory of the loaded models, textures, vertex buffers and
+    // trajectory samples, in bytes
+    info["ModelMemory"] = to_string(engine::GetGeometryManager()->getLoadedSize());
+    info["TextureMemory"] = to_string(GetTextureManager()->getLoadedSize());
+    info["BufferMemory"] = to_string(gl::Buffer::totalSize());
+    info["TrajectoryMemory"] = to_string(ephem::GetLoadedTrajectorySize());
+
     return true;
 }
 
+void
+Renderer::setProfilingEnabled(bool enabled)
+{
+    m_profilingEnabled = enabled;
+}
+
+bool
+Renderer::isProfilingEnabled() const
+{
+    return m_profilingEnabled;
+}
+
+const RenderProfiler*
+Renderer::getProfiler() const
+{
+    return m_profiler.get();
+}
+
+RenderProfiler*
+Renderer::getProfiler()
+{
+    return m_profiler.get();
+}
+
+bool
+Renderer::hasShadowFBO() const
+{
+    return !m_shadowMaps.empty();
+}
+
 FramebufferObject*
-Renderer::getShadowFBO(int index) const
+Renderer::getShadowFBO(const Geometry* geometry, Eigen::Vector3f& lightDirection, bool& render)
 {
-    return index == 0 ? m_shadowFBO.get() : nullptr;
+    if (m_shadowMaps.empty())
+        return nullptr;
+
+    ++m_shadowMapUseCount;
+
+    // The maps are drawn in object space, so they stay valid as long as the
+    // light doesn't move relative to the geometry
+    static const float minCosAngle = std::cos(ShadowMapReuseAngle);
+    for (CachedShadowMap& map : m_shadowMaps)
+    {
+        if (map.geometry == geometry && map.lightDirection.dot(lightDirection) >= minCosAngle)
+        {
+            map.lastUsed = m_shadowMapUseCount;
+            lightDirection = map.lightDirection;
+            render = false;
+            return map.fbo.get();
+        }
+    }
+
+    CachedShadowMap* map = nullptr;
+    if (m_shadowMaps.size() < MaxCachedShadowMaps)
+    {
+        auto fbo = std::make_unique<FramebufferObject>(m_shadowMapSize,
+                                                       m_shadowMapSize,
+                                                       FramebufferObject::DepthAttachment);
+        if (fbo->isValid())
+            map = &m_shadowMaps.emplace_back(CachedShadowMap{ std::move(fbo) });
+    }
+
+    if (map == nullptr)
+    {
+        map = &*std::min_element(m_shadowMaps.begin(), m_shadowMaps.end(),
+                                 [](const CachedShadowMap& m0, const CachedShadowMap& m1) { return m0.lastUsed < m1.lastUsed; });
+    }
+
+    map->geometry = geometry;
+    map->lightDirection = lightDirection;
+    map->lastUsed = m_shadowMapUseCount;
+    render = true;
+    return map->fbo.get();
 }
 
 void
 Renderer::createShadowFBO()
 {
-    m_shadowFBO = std::make_unique<FramebufferObject>(m_shadowMapSize,
-                                                      m_shadowMapSize,
-                                                      FramebufferObject::DepthAttachment);
-    if (!m_shadowFBO->isValid())
+    // The first map is created here to check that shadow maps are
+    // supported; the others are created as needed by getShadowFBO()
+    m_shadowMaps.clear();
+    auto fbo = std::make_unique<FramebufferObject>(m_shadowMapSize,
+                                                   m_shadowMapSize,
+                                                   FramebufferObject::DepthAttachment);
+    if (!fbo->isValid())
     {
         GetLogger()->warn("Error creating shadow FBO.\n");
-        m_shadowFBO = nullptr;
+        return;
     }
+
+    m_shadowMaps.push_back(CachedShadowMap{ std::move(fbo) });
 }
 
 void
 Renderer::setShadowMapSize(unsigned size)
 {
     m_shadowMapSize = std::min(size, static_cast<unsigned>(gl::maxTextureSize));
-    if (m_shadowFBO != nullptr && m_shadowMapSize == m_shadowFBO->width())
+    if (!m_shadowMaps.empty() && m_shadowMapSize == m_shadowMaps.front().fbo->width())
         return;
     if (m_shadowMapSize == 0)
-        m_shadowFBO = nullptr;
+        m_shadowMaps.clear();
     else
         createShadowFBO();
 }
@@ -4921,6 +5869,8 @@ Renderer::removeInvisibleItems(const math::InfiniteFrustum &frustum)
 
     renderList.resize(notCulled - renderList.begin());
 
+    removeOccludedItems();
+
     // The calls to buildRenderLists/renderStars filled renderList
     // with visible bodies.  Sort it front to back, then
     // render each entry in reverse order (TODO: convenient, but not
@@ -4930,6 +5880,91 @@ Renderer::removeInvisibleItems(const math::InfiniteFrustum &frustum)
     sort(renderList.begin(), renderList.end());
 }
 
+// Remove bodies hidden behind the ellipsoidal bodies that cover most of the
+// view. The test is analytic and conservative: a body is dropped only if its
+// whole bounding sphere, including rings and atmosphere, lies inside the cone
+// tangent to the occluder's inscribed sphere and farther away than the
+// occluder's center, which is beyond every point of the visible hemisphere.
+void
+Renderer::removeOccludedItems()
+{
+    struct Occluder
+    {
+        Vector3f direction;
+        float distance;
+        float angularRadius;
+    };
+
+    const BodyFeaturesManager* bodyFeaturesManager = GetBodyFeaturesManager();
+
+    boost::container::static_vector<Occluder, MaxOccluders> occluders;
+    for (const auto& ri : renderList)
+    {
+        if (ri.renderableType != RenderListEntry::RenderableBody ||
+            !ri.body->hasVisibleGeometry() ||
+            !ri.body->isEllipsoid() ||
+            ri.discSizeInPixels < MinOccluderSizeInPixels)
+        {
+            continue;
+        }
+
+        float distance = ri.position.norm();
+        float radius = ri.body->getSemiAxes().minCoeff();
+        if (distance <= radius)
+            continue;
+
+        Occluder occluder{ ri.position / distance, distance, std::asin(radius / distance) };
+        if (occluders.size() < MaxOccluders)
+        {
+            occluders.push_back(occluder);
+            continue;
+        }
+
+        // Keep the occluders that cover the largest part of the sky
+        auto smallest = std::min_element(occluders.begin(), occluders.end(),
+                                         [](const Occluder& a, const Occluder& b) { return a.angularRadius < b.angularRadius; });
+        if (smallest->angularRadius < occluder.angularRadius)
+            *smallest = occluder;
+    }
+
+    if (occluders.empty())
+        return;
+
+    auto notOccluded = renderList.begin();
+    for (const auto& ri : renderList)
+    {
+        bool occluded = false;
+        if (ri.renderableType == RenderListEntry::RenderableBody)
+        {
+            float radius = ri.body->getBoundingRadius();
+            if (const RingSystem* rings = bodyFeaturesManager->getRings(ri.body); rings != nullptr)
+                radius = max(radius, rings->outerRadius);
+            if (const Atmosphere* atmosphere = bodyFeaturesManager->getAtmosphere(ri.body); atmosphere != nullptr)
+                radius += max(atmosphere->height, atmosphere->cloudHeight);
+
+            float distance = ri.position.norm();
+            if (distance > radius)
+            {
+                Vector3f direction = ri.position / distance;
+                float angularRadius = std::asin(radius / distance);
+                occluded = std::any_of(occluders.cbegin(), occluders.cend(),
+                                       [&](const Occluder& occluder)
+                                       {
+                                           if (distance - radius <= occluder.distance)
+                                               return false;
+                                           float angle = std::acos(std::clamp(direction.dot(occluder.direction), -1.0f, 1.0f));
+                                           return angle + angularRadius <= occluder.angularRadius;
+                                       });
+            }
+        }
+
+        if (!occluded)
+            *notOccluded++ = ri;
+    }
+
+    renderList.resize(notOccluded - renderList.begin());
+}
+
 bool
 Renderer::selectionToAnnotation(const Selection &sel,
                                 const Observer &observer,
@@ -5031,6 +6066,8 @@ Renderer::buildNearSystemsLists(const Universe &universe,
                                 const math::InfiniteFrustum &xfrustum,
                                 double now)
 {
+    util::TraceScope trace("Renderer::buildNearSystemsLists");
+
     UniversalCoord observerPos = observer.getPosition();
     Eigen::Quaterniond observerOrient = getCameraOrientation();
 
@@ -5225,17 +6262,184 @@ Renderer::buildDepthPartitions()
                                       orbitPathList.back().centerZ - orbitPathList.back().radius);
     }
 
+    // Logarithmic depth has enough precision for everything in one interval,
+    // from the front of the nearest one to the back of the farthest.
+    if (detailOptions.logarithmicDepth && nIntervals > 1)
+    {
+        depthPartitions.front().nearZ = depthPartitions.back().nearZ;
+        depthPartitions.resize(1);
+        nIntervals = 1;
+    }
+
     // We want to avoid overpartitioning the depth buffer. In this stage, we
     // coalesce partitions that have small spans in the depth buffer.
     // TODO: Implement this step!
     return nIntervals;
 }
 
+// Get the state an opaque body is drawn with. Returns false for items that
+// have translucent parts and have to be drawn in depth order.
+bool
+Renderer::getStateSortKey(const RenderListEntry& rle, StateSortedItem& item) const
+{
+    if (rle.renderableType != RenderListEntry::RenderableBody)
+        return false;
+
+    const BodyFeaturesManager* bodyFeaturesManager = GetBodyFeaturesManager();
+    if (bodyFeaturesManager->getAtmosphere(rle.body) != nullptr ||
+        bodyFeaturesManager->getRings(rle.body) != nullptr)
+    {
+        return false;
+    }
+
+    // The appearance flags determine which textures are bound, and with them
+    // most of the shader properties
+    const Surface& surface = rle.body->getSurface();
+    item.appearanceFlags = surface.appearanceFlags;
+    item.texture = surface.baseTexture.tex[textureResolution];
+    item.geometry = rle.body->getGeometry();
+    return true;
+}
+
+struct Renderer::ModelBatch
+{
+    // Only set while drawing the state sorted items
+    bool enabled{ false };
+
+    // The first model of the batch; the others only differ by their
+    // transforms and the direction and intensity of their light
+    Geometry* geometry{ nullptr };
+    ResourceHandle texOverride{ InvalidResource };
+    RenderInfo ri;
+    LightingState ls;
+    float geometryScale{ 1.0f };
+    Eigen::Quaternionf orientation;
+    Eigen::Matrix4f modelView;
+    const Eigen::Matrix4f* projection{ nullptr };
+    double tsec{ 0.0 };
+    float photometricNormFactor{ 1.0f };
+
+    std::vector<ModelInstance> instances;
+};
+
+namespace
+{
+
+// Matches the normalization done by CelestiaGLProgram::setLightParameters
+// for the Lommel-Seeliger photometric model
+float
+photometricNormFactor(const LightingState& ls)
+{
+    return std::max(1.0f, 1.0f + ls.lights[0].direction_obj.dot(ls.eyeDir_obj) * 0.5f);
+}
+
+} // end unnamed namespace
+
+// Queue a lit model for an instanced draw with other bodies using the same
+// model and material. Returns false when the model has to be drawn now
+// because it is shadowed, lit by several lights, or can't be instanced.
+bool
+Renderer::batchModel(Geometry* geometry,
+                     ResourceHandle texOverride,
+                     const RenderInfo& ri,
+                     const LightingState& ls,
+                     float geometryScale,
+                     const Eigen::Quaternionf& orientation,
+                     const Eigen::Matrix4f& modelView,
+                     const Eigen::Matrix4f& projection,
+                     double tsec)
+{
+    ModelBatch& batch = *m_modelBatch;
+    if (!batch.enabled || ls.nLights != 1 || ls.shadowingRingSystem != nullptr ||
+        (ls.shadows[0] != nullptr && !ls.shadows[0]->empty()) ||
+        !geometry->supportsInstancing())
+    {
+        return false;
+    }
+
+    if (hasShadowFBO())
+        return false;
+
+    if (!batch.instances.empty() &&
+        (geometry != batch.geometry ||
+         texOverride != batch.texOverride ||
+         ri.color != batch.ri.color ||
+         ri.specularColor != batch.ri.specularColor ||
+         ri.specularPower != batch.ri.specularPower ||
+         ri.lunarLambert != batch.ri.lunarLambert ||
+         ls.lights[0].color != batch.ls.lights[0].color ||
+         ls.ambientColor != batch.ls.ambientColor))
+    {
+        flushModelBatch();
+    }
+
+    if (batch.instances.empty())
+    {
+        batch.geometry = geometry;
+        batch.texOverride = texOverride;
+        batch.ri = ri;
+        batch.ls = ls;
+        // The eclipse shadow lists are reused by the next bodies
+        std::fill(std::begin(batch.ls.shadows), std::end(batch.ls.shadows), nullptr);
+        batch.geometryScale = geometryScale;
+        batch.orientation = orientation;
+        batch.modelView = modelView;
+        batch.projection = &projection;
+        batch.tsec = tsec;
+        batch.photometricNormFactor = photometricNormFactor(ls);
+    }
+    else
+    {
+        // Use the detail needed by the largest copy for all of them
+        batch.ri.pixelScale = std::max(batch.ri.pixelScale, ri.pixelScale);
+    }
+
+    // The light is relative to the one of the first model, which sets the
+    // light uniforms
+    const DirectionalLight& light = ls.lights[0];
+    float photometricScale = photometricNormFactor(ls) / batch.photometricNormFactor;
+    ModelInstance& instance = batch.instances.emplace_back();
+    instance.modelView0 = modelView.row(0);
+    instance.modelView1 = modelView.row(1);
+    instance.modelView2 = modelView.row(2);
+    instance.light << light.direction_obj * photometricScale,
+                      light.irradiance / batch.ls.lights[0].irradiance;
+
+    return true;
+}
+
+void
+Renderer::flushModelBatch()
+{
+    ModelBatch& batch = *m_modelBatch;
+    if (batch.instances.empty())
+        return;
+
+    if (batch.instances.size() == 1)
+    {
+        Matrices mvp = { batch.projection, &batch.modelView };
+        renderGeometry_GLSL(batch.geometry, batch.ri, batch.texOverride, batch.ls,
+                            nullptr, batch.geometryScale, renderFlags, batch.orientation,
+                            batch.tsec, mvp, this);
+    }
+    else
+    {
+        renderGeometryInstanced_GLSL(batch.geometry, batch.ri, batch.texOverride, batch.ls,
+                                     batch.instances, batch.geometryScale, batch.orientation,
+                                     batch.tsec, *batch.projection, this);
+    }
+    gl::Binder::get().activeTexture(0);
+
+    batch.instances.clear();
+}
+
 void
 Renderer::renderSolarSystemObjects(const Observer &observer,
                                    int nIntervals,
                                    double now)
 {
+    util::TraceScope trace("Renderer::renderSolarSystemObjects");
+
     // Render everything that wasn't culled.
     auto annotation = depthSortedAnnotations.begin();
     float intervalSize = 1.0f / static_cast<float>(max(1, nIntervals));
@@ -5264,6 +6468,8 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
         int firstInInterval = i;
 
         // Render just the opaque objects in the first pass
+        stateSortedItems.clear();
+        depthOrderedItems.clear();
         while (i >= 0 && renderList[i].farZ < depthPartitions[interval].nearZ)
         {
             // This interval should completely contain the item
@@ -5273,14 +6479,45 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
             // Treat objects that are smaller than one pixel as transparent and
             // render them in the second pass.
             if (renderList[i].isOpaque && renderList[i].discSizeInPixels > 1.0f)
-                renderItem(renderList[i], observer, nearPlaneDistance, farPlaneDistance, m);
+            {
+                if (StateSortedItem item; getStateSortKey(renderList[i], item))
+                {
+                    item.index = i;
+                    stateSortedItems.push_back(item);
+                }
+                else
+                {
+                    depthOrderedItems.push_back(i);
+                }
+            }
 
             i--;
         }
 
+        // Bodies without translucent parts may be drawn in any order, so group
+        // them by the program, textures and geometry they use. They are drawn
+        // first so that the atmospheres and rings of the remaining bodies,
+        // which stay back to front, blend over them. Within a group they go
+        // front to back (the render list is sorted near to far), so that
+        // hidden fragments fail the depth test before they are shaded.
+        std::sort(stateSortedItems.begin(), stateSortedItems.end(),
+                  [](const StateSortedItem& a, const StateSortedItem& b)
+                  {
+                      return std::tie(a.appearanceFlags, a.texture, a.geometry, a.index)
+                           < std::tie(b.appearanceFlags, b.texture, b.geometry, b.index);
+                  });
+        m_modelBatch->enabled = true;
+        for (const StateSortedItem& item : stateSortedItems)
+            renderItem(renderList[item.index], observer, nearPlaneDistance, farPlaneDistance, m);
+        flushModelBatch();
+        m_modelBatch->enabled = false;
+        for (int index : depthOrderedItems)
+            renderItem(renderList[index], observer, nearPlaneDistance, farPlaneDistance, m);
+
         // Render orbit paths
         if (!orbitPathList.empty())
         {
+            RenderProfiler::Scope scope(m_profiler.get(), RenderPass::Orbits);
             math::Frustum intervalFrustum = projectionMode->getFrustum(nearPlaneDistance, farPlaneDistance, observer.getZoom());
 
             // Scan through the list of orbits and render any that overlap this interval
@@ -5301,6 +6538,10 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
                                 farPlaneDistance);
                 }
             }
+
+            // Draw the Keplerian orbits queued by renderOrbit
+            bool fadeOrbits = (renderFlags & ShowFadingOrbits) != 0;
+            m_keplerOrbitRenderer->render(fadeOrbits ? static_cast<float>(detailOptions.linearFadeFraction) : 0.0f);
         }
 
         // Render transparent objects in the second pass
@@ -5320,6 +6561,8 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
         setPipelineState(ps);
 
         PointStarVertexBuffer::enable();
+        glareVertexBuffer->setTexture(gaussianGlareTex);
+        pointStarVertexBuffer->setTexture(gaussianDiscTex);
         glareVertexBuffer->startSprites();
         glareVertexBuffer->render();
         glareVertexBuffer->finish();
@@ -5331,6 +6574,9 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
         pointStarVertexBuffer->finish();
         PointStarVertexBuffer::disable();
 
+        m_largeGlareRenderer->render(gaussianGlareTex, m);
+        m_largeStarRenderer->render(gaussianDiscTex, m);
+
         // Render annotations in this interval
         annotation = renderSortedAnnotations(annotation,
                                              nearPlaneDistance,
@@ -5344,6 +6590,13 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
     setDefaultProjectionMatrix();
 }
 
+util::ThreadPool&
+Renderer::getWorkerPool()
+{
+    // Loops started by the renderer run before those of catalog loading
+    return util::ThreadPool::shared();
+}
+
 void
 Renderer::setPipelineState(const Renderer::PipelineState &ps) noexcept
 {
@@ -5389,3 +6642,30 @@ void Renderer::buildProjectionMatrix(Eigen::Matrix4f &mat, float nearZ, float fa
 {
     mat = projectionMode->getProjectionMatrix(nearZ, farZ, zoom);
 }
+
+
+// Called between frames, when no model or texture pointers are held. Going
+// through all the resources once a second is often enough.
+void
+Renderer::unloadUnusedResources()
+{
+    if (detailOptions.modelMemory == 0 &&
+        detailOptions.textureMemory == 0 &&
+        detailOptions.resourceIdleTime <= 0.0f)
+    {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastResourceUnload < std::chrono::seconds(1))
+        return;
+    m_lastResourceUnload = now;
+
+    auto maxIdle = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<float, std::ratio<60>>(std::max(detailOptions.resourceIdleTime, 0.0f)));
+    std::size_t models = engine::GetGeometryManager()->unloadUnused(maxIdle, static_cast<std::size_t>(detailOptions.modelMemory) << 20);
+    std::size_t textures = GetTextureManager()->unloadUnused(maxIdle, static_cast<std::size_t>(detailOptions.textureMemory) << 20);
+    if (models > 0 || textures > 0)
+        GetLogger()->debug("Unloaded {} unused models and {} textures\n", models, textures);
+}
+
@@ -10,16 +10,22 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <limits>
 #include <list>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <Eigen/Core>
 
 #include <celengine/body.h>
 #include <celengine/lightenv.h>
+#include <celengine/orbitpathcache.h>
 #include <celengine/universe.h>
 #include <celengine/selection.h>
 #include <celengine/shadermanager.h>
@@ -32,13 +38,20 @@
 
 class RendererWatcher;
 class FrameTree;
+struct FrameTreeCluster;
+class TimelinePhase;
 class ReferenceMark;
 class CurvePlot;
 class PointStarVertexBuffer;
+class PointStarCollector;
+class PointStarRenderer;
 class Observer;
 class Surface;
 class TextureFont;
 class FramebufferObject;
+class Geometry;
+struct DSODrawCandidate;
+struct RenderInfo;
 
 namespace celestia
 {
@@ -47,6 +60,7 @@ class Rect;
 namespace gl
 {
 class Buffer;
+class StreamBuffer;
 class VertexObject;
 }
 
@@ -55,6 +69,11 @@ namespace math
 class Frustum;
 class InfiniteFrustum;
 }
+
+namespace util
+{
+class ThreadPool;
+}
 }
 
 struct Matrices
@@ -119,6 +138,29 @@ class Renderer
         double orbitWindowEnd{ 0.5 };
         double orbitPeriodsShown{ 1.0 };
         double linearFadeFraction{ 0.0 };
+        // Most deep sky objects drawn per frame, the brightest are kept;
+        // zero for no limit
+        unsigned int maxDSOsPerFrame{ 0 };
+        // Milliseconds per frame to spend drawing deep sky objects; when
+        // exceeded, the object limit is lowered until the time fits. Zero
+        // for no limit.
+        float dsoFrameTimeBudget{ 0.0f };
+        // Use a logarithmic depth buffer that covers the solar system in a
+        // single depth range instead of partitioning the depth buffer
+        bool logarithmicDepth{ false };
+        // Memory in MiB for the tiles of all virtual textures; the least
+        // recently used tiles are evicted beyond it. Zero for no limit.
+        unsigned int virtualTextureMemory{ 0 };
+        // Memory in MiB for loaded models and for loaded textures; the
+        // least recently used ones are unloaded beyond it. Zero for no limit.
+        unsigned int modelMemory{ 0 };
+        unsigned int textureMemory{ 0 };
+        // Minutes after which models and textures that haven't been drawn
+        // are unloaded. Zero to keep them.
+        float resourceIdleTime{ 0.0f };
+        // Drop the star, deep sky object and body labels that overlap a
+        // brighter object's label
+        bool labelDecluttering{ false };
 #ifndef GL_ES
         bool useMesaPackInvert{ true };
 #endif
@@ -141,8 +183,37 @@ class Renderer
                 float faintestVisible,
                 const Selection& sel);
 
+    // A view which will be drawn later in the frame, see precullStars()
+    struct PrecullView
+    {
+        const Observer* observer;
+        int width;
+        int height;
+    };
+
+    // Finds the stars visible in each of the views on the worker threads
+    // before any of them is drawn. When render() draws one of the views
+    // unchanged it takes the stars found here instead of culling the
+    // catalog itself. Views whose observers are close together share
+    // their octree traversal, see StarVisibilityCache.
+    void precullStars(const StarDatabase&, const std::vector<PrecullView>&, float faintestVisible);
+    // Drops the stars of the views that precullStars() found but that
+    // were not drawn.
+    void discardPrecull();
+
     bool getInfo(std::map<std::string, std::string>& info) const;
 
+    // Queue the shaders the ellipsoid bodies of the loaded solar systems
+    // need for background compilation, see ShaderManager::precompile()
+    void precompileShaders(const Universe&);
+
+    // Per-pass CPU and GPU timing. The profiler is created and destroyed at
+    // the start of the next rendered frame, while the GL context is current.
+    void setProfilingEnabled(bool);
+    bool isProfilingEnabled() const;
+    const celestia::render::RenderProfiler* getProfiler() const;
+    celestia::render::RenderProfiler* getProfiler();
+
     enum
     {
         NoLabels            = 0x000,
@@ -254,6 +325,16 @@ class Renderer
     void setMinimumOrbitSize(float);
     float getMinimumFeatureSize() const;
     void setMinimumFeatureSize(float);
+
+    // Lowers the level of detail below the settings by up to
+    // MaxDetailReduction steps to keep up the frame rate. Each step lowers
+    // the faintest magnitude drawn by half a magnitude, doubles the size
+    // below which surface features aren't labelled and halves the
+    // resolution of the sphere meshes.
+    static constexpr unsigned int MaxDetailReduction = 3;
+    unsigned int getDetailReduction() const;
+    void setDetailReduction(unsigned int);
+
     float getDistanceLimit() const;
     void setDistanceLimit(float);
     BodyClassification getOrbitMask() const;
@@ -295,8 +376,14 @@ class Renderer
     [[deprecated]] void setVideoSync(bool);
     void setSolarSystemMaxDistance(float);
     void setShadowMapSize(unsigned);
+    // Keep the star catalog in GPU memory and leave the per-star culling of
+    // distant stars to the vertex shader.
+    void setGPUStarRendering(bool);
 
     bool captureFrame(int, int, int, int, celestia::engine::PixelFormat format, unsigned char*) const;
+    // Whether glReadPixels returns the top row first, so that captured
+    // frames don't need to be flipped
+    bool packsRowsInverted() const noexcept;
 
     void renderMarker(celestia::MarkerRepresentation::Symbol symbol,
                       float size,
@@ -308,6 +395,21 @@ class Renderer
         return nearStars;
     }
 
+    // The entries of the last frame that survived culling and occlusion:
+    // bodies and stars drawn larger than a point, or labeled, comet tails
+    // and reference marks
+    celestia::util::array_view<RenderListEntry> getRenderList() const
+    {
+        return renderList;
+    }
+
+    // The observer of the last frame, from which the positions in the
+    // render list are measured
+    const Observer* getRenderListObserver() const
+    {
+        return renderListObserver;
+    }
+
     const Eigen::Matrix4f& getModelViewMatrix() const
     {
         return m_modelMatrix;
@@ -364,6 +466,19 @@ class Renderer
 
     void loadTextures(Body*);
 
+    // Counts of the resources queued by preload()
+    struct PreloadProgress
+    {
+        unsigned int ready{ 0 };
+        unsigned int total{ 0 };
+    };
+
+    // Queues the textures and the model of body for loading in the
+    // background, as loadTextures() does, and adds them to progress, those
+    // that are loaded or failed to load as ready. Can be called repeatedly
+    // to follow the loading without waiting for it.
+    void preload(Body*, PreloadProgress& progress);
+
     // Label related methods
     enum class LabelHorizontalAlignment : std::uint8_t
     {
@@ -388,33 +503,43 @@ class Renderer
         LabelHorizontalAlignment halign : 3;
         LabelVerticalAlignment valign : 3;
         float size;
+        // Labels that overlap a label of higher priority are dropped when
+        // decluttering; objects use minus their apparent magnitude
+        float priority;
 
         bool operator<(const Annotation&) const;
     };
 
+    static constexpr float MaxLabelPriority = std::numeric_limits<float>::infinity();
+
     void addForegroundAnnotation(const celestia::MarkerRepresentation* markerRep,
                                  std::string_view labelText,
                                  Color color,
                                  const Eigen::Vector3f& position,
                                  LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
                                  LabelVerticalAlignment valign = LabelVerticalAlignment::Bottom,
-                                 float size = 0.0f);
+                                 float size = 0.0f,
+                                 float priority = MaxLabelPriority);
     void addBackgroundAnnotation(const celestia::MarkerRepresentation* markerRep,
                                  std::string_view labelText,
                                  Color color,
                                  const Eigen::Vector3f& position,
                                  LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
                                  LabelVerticalAlignment valign = LabelVerticalAlignment::Bottom,
-                                 float size = 0.0f);
+                                 float size = 0.0f,
+                                 float priority = MaxLabelPriority);
     void addSortedAnnotation(const celestia::MarkerRepresentation* markerRep,
                              std::string_view labelText,
                              Color color,
                              const Eigen::Vector3f& position,
                              LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
                              LabelVerticalAlignment valign = LabelVerticalAlignment::Bottom,
-                             float size = 0.0f);
+                             float size = 0.0f,
+                             float priority = MaxLabelPriority);
 
     ShaderManager& getShaderManager() const { return *shaderManager; }
+    // Shared ring buffer for vertex data uploaded every frame
+    celestia::gl::StreamBuffer& getStreamBuffer() const { return *m_streamBuffer; }
 
     // Callbacks for renderables; these belong in a special renderer interface
     // only visible in object's render methods.
@@ -434,6 +559,7 @@ class Renderer
     float getNearPlaneDistance() const;
 
     void invalidateOrbitCache();
+    std::size_t getOrbitCacheMemoryUsage() const { return orbitCache.memoryUsage(); }
 
     struct OrbitPathListEntry
     {
@@ -464,7 +590,14 @@ class Renderer
     void removeWatcher(RendererWatcher*);
     void notifyWatchers() const;
 
-    FramebufferObject* getShadowFBO(int) const;
+    // Returns a shadow map for the geometry lit from lightDirection, which
+    // is in object space, or nullptr if shadows are disabled. The maps of
+    // the last few geometries drawn are kept. If one of them was drawn from
+    // within ShadowMapReuseAngle of lightDirection, lightDirection is set to
+    // the direction it was drawn from; otherwise render is set and the
+    // returned map has to be drawn again.
+    FramebufferObject* getShadowFBO(const Geometry* geometry, Eigen::Vector3f& lightDirection, bool& render);
+    bool hasShadowFBO() const;
 
  public:
     struct RenderProperties
@@ -492,9 +625,16 @@ class Renderer
     void renderPointStars(const StarDatabase& starDB,
                           float faintestVisible,
                           const Observer& observer);
+    bool renderPointStarsGPU(const StarDatabase& starDB,
+                             float faintestVisible,
+                             PointStarRenderer& starRenderer);
+    PointStarCollector* takeStarPrecull(const Eigen::Vector3f& obsPosition,
+                                        float limitingMag,
+                                        float threshold);
     void renderDeepSkyObjects(const Universe&,
                               const Observer&,
                               float faintestMagNight);
+    void updateDSOLimit(float elapsedMs, std::size_t nDrawn);
     void renderSkyGrids(const Observer& observer);
     void renderSelectionPointer(const Observer& observer,
                                 double now,
@@ -517,6 +657,18 @@ class Renderer
                           const FrameTree* tree,
                           const Observer& observer,
                           double now);
+    void cullChildClusters(const std::vector<FrameTreeCluster>& clusters,
+                           const std::vector<const TimelinePhase*>& phases,
+                           const Eigen::Vector3d& astrocentricObserverPos,
+                           const Eigen::Vector3d& viewPlaneNormal,
+                           const Eigen::Vector3d& frameCenter,
+                           BodyClassification labelClassMask,
+                           std::vector<const TimelinePhase*>& unculledPhases) const;
+    void computeOrbitPositions(std::vector<Eigen::Vector3d>& positions,
+                               const Eigen::Vector3d& frameCenter,
+                               const std::vector<const TimelinePhase*>& phases,
+                               double now);
+    celestia::util::ThreadPool& getWorkerPool();
     void buildOrbitLists(const Eigen::Vector3d& astrocentricObserverPos,
                          const Eigen::Quaterniond& observerOrientation,
                          const celestia::math::InfiniteFrustum& viewFrustum,
@@ -536,6 +688,7 @@ class Renderer
                                   double now);
 
     void removeInvisibleItems(const celestia::math::InfiniteFrustum &frustum);
+    void removeOccludedItems();
 
     void renderObject(const Eigen::Vector3f& pos,
                       float distance,
@@ -546,6 +699,15 @@ class Renderer
                       const LightingState&,
                       const Matrices&);
 
+    void prefetchSurfaceTiles(const Eigen::Vector3f& pos,
+                              const RenderProperties& obj,
+                              const Eigen::Vector3f& scaleFactors,
+                              float nearPlaneDistance,
+                              float farPlaneDistance,
+                              float zoom,
+                              Texture** textures,
+                              int nTextures);
+
     void renderPlanet(Body& body,
                       const Eigen::Vector3f& pos,
                       float distance,
@@ -589,8 +751,7 @@ class Renderer
                              float discSizeInPixels,
                              const Color& color,
                              bool useHalos,
-                             bool emissive,
-                             const Matrices&);
+                             bool emissive);
 
     void locationsToAnnotations(const Body& body,
                                 const Eigen::Vector3d& bodyPosition,
@@ -603,8 +764,20 @@ class Renderer
                     float farPlaneDistance,
                     const Matrices&);
 
+    // Per-frame record of a body that may cast eclipse shadows
+    struct EclipseCaster
+    {
+        const Body* body;
+        Eigen::Vector3d position; // astrocentric
+        float radius;
+        RingSystem* rings;
+    };
+
+    const EclipseCaster* getEclipseCaster(const Body& body, double now);
+    void addEclipseCaster(const Body& receiver, const Body& caster, double now);
     bool testEclipse(const Body& receiver,
-                     const Body& caster,
+                     const Eigen::Vector3d& posReceiver,
+                     const EclipseCaster& caster,
                      LightingState& lightingState,
                      unsigned int lightIndex,
                      double now);
@@ -622,17 +795,24 @@ class Renderer
                        LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
                        LabelVerticalAlignment = LabelVerticalAlignment::Bottom,
                        float size = 0.0f,
-                       bool special = false);
+                       bool special = false,
+                       float priority = MaxLabelPriority);
+    void declutterAnnotations(std::vector<Annotation>&, FontStyle fs);
     void renderAnnotationMarker(const Annotation &a,
                                 celestia::engine::TextLayout &layout,
                                 float depth,
                                 const Matrices&);
+    bool queueMarker(celestia::MarkerRepresentation::Symbol symbol,
+                     float size,
+                     const Color &color,
+                     const Eigen::Vector3f &position);
+    void renderQueuedMarkers(const Matrices&);
     void renderAnnotationLabel(const Annotation &a,
                                celestia::engine::TextLayout &layout,
+                               TextureFont &font,
                                float hOffset,
                                float vOffset,
-                               float depth,
-                               const Matrices&);
+                               float depth);
     void renderAnnotations(const std::vector<Annotation>&,
                            FontStyle fs);
     void renderBackgroundAnnotations(FontStyle fs);
@@ -686,6 +866,7 @@ class Renderer
     float corrFac;
     float pixelSize{ 1.0f };
     float faintestAutoMag45deg;
+    unsigned int detailReduction{ 0 };
     std::vector<std::shared_ptr<TextureFont>> fonts{FontCount, nullptr};
 
     std::shared_ptr<celestia::engine::ProjectionMode> projectionMode{ nullptr };
@@ -715,14 +896,54 @@ class Renderer
     PointStarVertexBuffer* pointStarVertexBuffer;
     PointStarVertexBuffer* glareVertexBuffer;
     std::vector<RenderListEntry> renderList;
+    const Observer* renderListObserver{ nullptr };
+
+    // Opaque items of a depth partition, split into those drawn in render
+    // state order and those kept in depth order
+    struct StateSortedItem
+    {
+        std::uint32_t appearanceFlags;
+        ResourceHandle texture;
+        ResourceHandle geometry;
+        int index;
+    };
+    std::vector<StateSortedItem> stateSortedItems;
+    std::vector<int> depthOrderedItems;
+    bool getStateSortKey(const RenderListEntry&, StateSortedItem&) const;
+
+    // Lit models of state sorted bodies waiting for an instanced draw
+    struct ModelBatch;
+    std::unique_ptr<ModelBatch> m_modelBatch;
+    bool batchModel(Geometry*,
+                    ResourceHandle texOverride,
+                    const RenderInfo&,
+                    const LightingState&,
+                    float geometryScale,
+                    const Eigen::Quaternionf& orientation,
+                    const Eigen::Matrix4f& modelView,
+                    const Eigen::Matrix4f& projection,
+                    double tsec);
+    void flushModelBatch();
+
+    void unloadUnusedResources();
+
     std::vector<SecondaryIlluminator> secondaryIlluminators;
     std::vector<DepthBufferPartition> depthPartitions;
     std::vector<Annotation> backgroundAnnotations;
     std::vector<Annotation> foregroundAnnotations;
     std::vector<Annotation> depthSortedAnnotations;
     std::vector<Annotation> objectAnnotations;
+    // Scratch space of declutterAnnotations()
+    std::vector<std::size_t> labelOrder;
+    std::vector<std::uint8_t> labelGrid;
     std::vector<OrbitPathListEntry> orbitPathList;
     LightingState::EclipseShadowVector eclipseShadows[MaxLights];
+    // Eclipse casters evaluated this frame; a null entry marks a body that
+    // can't cast shadows
+    std::unordered_map<const Body*, std::optional<EclipseCaster>> eclipseCasterCache;
+    std::uint32_t eclipseCasterFrame{ 0 };
+    // Scratch space for the casters tested against a receiver
+    std::vector<const EclipseCaster*> eclipseCasters;
     std::vector<const Star*> nearStars;
 
     std::vector<LightSource> lightSourceList;
@@ -746,9 +967,10 @@ class Renderer
 
     std::array<int, 4> m_viewport { 0, 0, 0, 0 };
 
-    typedef std::map<const celestia::ephem::Orbit*, CurvePlot*> OrbitCache;
-    OrbitCache orbitCache;
+    celestia::engine::OrbitPathCache orbitCache;
     uint32_t lastOrbitCacheFlush;
+    // Time spent sampling orbit paths in the current frame
+    std::chrono::steady_clock::duration orbitSampleTime{ 0 };
 
     float minOrbitSize;
     float distanceLimit;
@@ -774,12 +996,42 @@ class Renderer
 
     // Size of a texture used in shadow mapping
     unsigned m_shadowMapSize { 0 };
-    std::unique_ptr<FramebufferObject> m_shadowFBO;
+
+    struct CachedShadowMap
+    {
+        std::unique_ptr<FramebufferObject> fbo;
+        const Geometry* geometry{ nullptr };
+        Eigen::Vector3f lightDirection{ Eigen::Vector3f::Zero() };
+        std::uint32_t lastUsed{ 0 };
+    };
+
+    static constexpr std::size_t MaxCachedShadowMaps = 4;
+    // Largest change of the light direction for which a shadow map is reused
+    static constexpr float ShadowMapReuseAngle = 0.002f; // radians
+
+    std::vector<CachedShadowMap> m_shadowMaps;
+    std::uint32_t m_shadowMapUseCount{ 0 };
 
     std::unique_ptr<celestia::gl::VertexObject> m_markerVO;
     std::unique_ptr<celestia::gl::Buffer> m_markerBO;
+    std::unique_ptr<celestia::gl::StreamBuffer> m_streamBuffer;
     bool m_markerDataInitialized{ false };
 
+    struct MarkerInstance
+    {
+        Eigen::Vector3f position;
+        float scale;
+        Eigen::Vector4f color;
+    };
+
+    // Marker symbols queued by renderAnnotationMarker, one batch for each
+    // draw range of the marker geometry
+    std::vector<std::vector<MarkerInstance>> m_markerBatches;
+    std::unique_ptr<celestia::gl::Buffer> m_markerInstanceBO;
+    std::unique_ptr<celestia::gl::Buffer> m_hollowMarkerBO;
+    std::unique_ptr<celestia::gl::VertexObject> m_filledMarkerInstanceVO;
+    std::unique_ptr<celestia::gl::VertexObject> m_hollowMarkerInstanceVO;
+
     // Saturation magnitude used to calculate a point star size
     float satPoint;
 
@@ -790,13 +1042,51 @@ class Renderer
     std::unique_ptr<celestia::render::EclipticLineRenderer> m_eclipticLineRenderer;
     std::unique_ptr<celestia::render::GalaxyRenderer> m_galaxyRenderer;
     std::unique_ptr<celestia::render::GlobularRenderer> m_globularRenderer;
+    std::unique_ptr<celestia::render::GPUStarRenderer> m_gpuStarRenderer;
+    std::unique_ptr<celestia::render::KeplerOrbitRenderer> m_keplerOrbitRenderer;
     std::unique_ptr<celestia::render::LargeStarRenderer> m_largeStarRenderer;
+    std::unique_ptr<celestia::render::LargeStarRenderer> m_largeGlareRenderer;
     std::unique_ptr<celestia::render::LineRenderer> m_hollowMarkerRenderer;
     std::unique_ptr<celestia::render::NebulaRenderer> m_nebulaRenderer;
     std::unique_ptr<celestia::render::OpenClusterRenderer> m_openClusterRenderer;
     std::unique_ptr<celestia::render::RingRenderer> m_ringRenderer;
     std::unique_ptr<celestia::render::SkyGridRenderer> m_skyGridRenderer;
 
+    bool m_profilingEnabled{ false };
+    bool m_shadersPrecompiled{ false };
+    std::chrono::steady_clock::time_point m_lastResourceUnload{ };
+    // Distance the camera is predicted to move before virtual texture tiles
+    // requested now arrive, in km
+    Eigen::Vector3f m_prefetchOffset{ Eigen::Vector3f::Zero() };
+    std::unique_ptr<celestia::render::RenderProfiler> m_profiler;
+
+    // One star list per worker for parallel star culling
+    std::vector<PointStarCollector> m_starCollectors;
+    // Visible star octree nodes reused by the serial star culling
+    StarVisibilityCache m_starVisibilityCache;
+
+    // The view a list of m_precullStars was found for
+    struct StarPrecull
+    {
+        Eigen::Vector3f position;
+        Eigen::Quaternionf orientation;
+        float fovY;
+        float aspectRatio;
+        float limitingMag;
+        float threshold;
+        bool used;
+    };
+    std::vector<StarPrecull> m_starPreculls;
+    std::vector<PointStarCollector> m_precullStars;
+    // One per group of nearby views in precullStars()
+    std::vector<StarVisibilityCache> m_precullCaches;
+    // Star ranges passed to m_gpuStarRenderer, kept to reuse the allocation
+    std::vector<StarOctree::ObjectRange> m_gpuStarRanges;
+    // Deep sky objects selected for drawing in the current frame
+    std::vector<DSODrawCandidate> m_dsoCandidates;
+    // Object limit derived from detailOptions.dsoFrameTimeBudget
+    std::size_t m_dsoAdaptiveLimit{ std::numeric_limits<std::size_t>::max() };
+
     // Location markers
  public:
     celestia::MarkerRepresentation mountainRep;
@@ -23,8 +23,10 @@
 #include <celmath/geomutil.h>
 #include <celmath/mathlib.h>
 #include <celmodel/material.h>
+#include <celrender/gl/binder.h>
 #include <celrender/gl/buffer.h>
 #include <celrender/gl/vertexobject.h>
+#include <celrender/renderprofiler.h>
 #include <celutil/color.h>
 #include <celutil/flag.h>
 #include "atmosphere.h"
@@ -63,14 +65,21 @@ Eigen::Matrix4f directionalLightMatrix(const Eigen::Vector3f& lightDirection)
 }
 
 
+// Projection used for shadow maps; normalized models fit in the unit cube.
+Eigen::Matrix4f shadowProjectionMatrix()
+{
+    return math::Ortho(-1.f, 1.f, -1.f, 1.f, -1.f, 1.f);
+}
+
+
 /*! Render a mesh object
  *  Parameters:
+ *    lightDirection : direction of the light in object space
  *    tsec : animation clock time in seconds
  */
 void renderGeometryShadow_GLSL(Geometry* geometry,
                                FramebufferObject* shadowFbo,
-                               const LightingState& ls,
-                               int lightIndex,
+                               const Eigen::Vector3f& lightDirection,
                                double tsec,
                                Renderer* renderer,
                                Eigen::Matrix4f *lightMatrix)
@@ -103,8 +112,8 @@ void renderGeometryShadow_GLSL(Geometry* geometry,
     glEnable(GL_POLYGON_OFFSET_FILL);
     glPolygonOffset(.001f, .001f);
 
-    Eigen::Matrix4f projMat = math::Ortho(-1.f, 1.f, -1.f, 1.f, -1.f, 1.f);
-    Eigen::Matrix4f modelViewMat = directionalLightMatrix(ls.lights[lightIndex].direction_obj);
+    Eigen::Matrix4f projMat = shadowProjectionMatrix();
+    Eigen::Matrix4f modelViewMat = directionalLightMatrix(lightDirection);
     *lightMatrix = projMat * modelViewMat;
     prog->setMVPMatrices(projMat, modelViewMat);
     geometry->render(rc, tsec);
@@ -224,9 +233,9 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
             {
                 shadprop.texUsage |= TexUsage::CloudShadowTexture;
                 textures.push_back(cloudTex);
-                glActiveTexture(GL_TEXTURE0 + textures.size());
+                gl::Binder::get().activeTexture(textures.size());
                 cloudTex->bind();
-                glActiveTexture(GL_TEXTURE0);
+                gl::Binder::get().activeTexture(0);
 
                 for (unsigned int lightIndex = 0; lightIndex < ls.nLights; lightIndex++)
                 {
@@ -255,7 +264,7 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
         Texture* ringsTex = ls.shadowingRingSystem->texture.find(textureRes);
         if (ringsTex != nullptr)
         {
-            glActiveTexture(GL_TEXTURE0 + textures.size());
+            gl::Binder::get().activeTexture(textures.size());
             ringsTex->bind();
 
 #ifdef GL_ES
@@ -273,7 +282,7 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
                 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER_OES);
 #endif
             }
-            glActiveTexture(GL_TEXTURE0);
+            gl::Binder::get().activeTexture(0);
 
             shadprop.texUsage |= TexUsage::RingShadowTexture;
 
@@ -372,10 +381,14 @@ void renderGeometry_GLSL(Geometry* geometry,
                          const Matrices &m,
                          Renderer* renderer)
 {
-    auto *shadowBuffer = renderer->getShadowFBO(0);
-    Eigen::Matrix4f lightMatrix(Eigen::Matrix4f::Identity());
-
-    if (shadowBuffer != nullptr && shadowBuffer->isValid())
+    // Shadow maps are reused while the light stays (nearly) fixed relative
+    // to the model
+    Eigen::Vector3f shadowLightDirection = ls.lights[0].direction_obj;
+    bool renderShadow = false;
+    auto *shadowBuffer = renderer->getShadowFBO(geometry, shadowLightDirection, renderShadow);
+    Eigen::Matrix4f lightMatrix = shadowProjectionMatrix() * directionalLightMatrix(shadowLightDirection);
+
+    if (renderShadow && shadowBuffer->isValid())
     {
         std::array<int, 4> viewport;
         renderer->getViewport(viewport);
@@ -394,8 +407,11 @@ void renderGeometry_GLSL(Geometry* geometry,
         fmt::printf("bias: %f bits: %f clear: %f range: %f - %f, scale:%f\n", bias, bits, clear, range[0], range[1], scale);
 #endif
 
-        renderGeometryShadow_GLSL(geometry, shadowBuffer, ls, 0,
-                                  tsec, renderer, &lightMatrix);
+        {
+            render::RenderProfiler::Scope scope(renderer->getProfiler(), render::RenderPass::Shadows);
+            renderGeometryShadow_GLSL(geometry, shadowBuffer, shadowLightDirection,
+                                      tsec, renderer, &lightMatrix);
+        }
         renderer->setViewport(viewport);
 #ifdef DEPTH_BUFFER_DEBUG
         glDisable(GL_DEPTH_TEST);
@@ -405,12 +421,12 @@ void renderGeometry_GLSL(Geometry* geometry,
         glMatrixMode(GL_MODELVIEW);
         glPushMatrix();
         glLoadIdentity();
-        glUseProgram(0);
+        gl::Binder::get().use(0);
         glColor4f(1, 1, 1, 1);
 
-        glActiveTexture(GL_TEXTURE0);
+        gl::Binder::get().activeTexture(0);
         glEnable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, shadowBuffer->depthTexture());
+        gl::Binder::get().bindTexture(GL_TEXTURE_2D, shadowBuffer->depthTexture());
 #if GL_ONLY_SHADOWS
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
 #endif
@@ -431,7 +447,7 @@ void renderGeometry_GLSL(Geometry* geometry,
         glPopMatrix();
         glMatrixMode(GL_PROJECTION);
         glPopMatrix();
-        glBindTexture(GL_TEXTURE_2D, 0);
+        gl::Binder::get().bindTexture(GL_TEXTURE_2D, 0);
         glDisable(GL_TEXTURE_2D);
         glEnable(GL_DEPTH_TEST);
 #endif
@@ -452,6 +468,64 @@ void renderGeometry_GLSL(Geometry* geometry,
 
     rc.setCameraOrientation(ri.orientation);
     rc.setPointScale(ri.pointScale);
+    rc.setPixelScale(ri.pixelScale);
+
+    // Handle extended material attributes (per model only, not per submesh)
+    rc.setLunarLambert(ri.lunarLambert);
+
+    Renderer::PipelineState ps;
+    ps.depthMask = true;
+    ps.depthTest = true;
+    renderer->setPipelineState(ps);
+
+    // Handle material override; a texture specified in an ssc file will
+    // override all materials specified in the geometry file.
+    if (texOverride != InvalidResource)
+    {
+        cmod::Material m;
+        m.diffuse = cmod::Color(ri.color);
+        m.specular = cmod::Color(ri.specularColor);
+        m.specularPower = ri.specularPower;
+
+        m.setMap(cmod::TextureSemantic::DiffuseMap, texOverride);
+        rc.setMaterial(&m);
+        rc.lock();
+        geometry->render(rc, tsec);
+    }
+    else
+    {
+        geometry->render(rc, tsec);
+    }
+}
+
+
+/*! Render copies of a mesh object with a single draw call per primitive
+ *  group. The instances provide the model view matrix and the light of
+ *  each copy; the lighting state and render info of the first copy set
+ *  everything else, so the copies must only differ by these. Shadows
+ *  aren't supported.
+ *  Parameters:
+ *    tsec : animation clock time in seconds
+ */
+void renderGeometryInstanced_GLSL(Geometry* geometry,
+                                  const RenderInfo& ri,
+                                  ResourceHandle texOverride,
+                                  const LightingState& ls,
+                                  const std::vector<ModelInstance>& instances,
+                                  float geometryScale,
+                                  const Eigen::Quaternionf& planetOrientation,
+                                  double tsec,
+                                  const Eigen::Matrix4f& projection,
+                                  Renderer* renderer)
+{
+    // The model view matrices are applied per instance
+    Eigen::Matrix4f modelView = Eigen::Matrix4f::Identity();
+    GLSL_RenderContext rc(renderer, ls, geometryScale, planetOrientation, &modelView, &projection);
+    rc.setInstances(&instances);
+
+    rc.setCameraOrientation(ri.orientation);
+    rc.setPointScale(ri.pointScale);
+    rc.setPixelScale(ri.pixelScale);
 
     // Handle extended material attributes (per model only, not per submesh)
     rc.setLunarLambert(ri.lunarLambert);
@@ -498,6 +572,7 @@ void renderGeometry_GLSL_Unlit(Geometry* geometry,
 {
     GLSLUnlit_RenderContext rc(renderer, geometryScale, m.modelview, m.projection);
     rc.setPointScale(ri.pointScale);
+    rc.setPixelScale(ri.pixelScale);
 
     Renderer::PipelineState ps;
     ps.depthMask = true;
@@ -638,3 +713,95 @@ void renderClouds_GLSL(const RenderInfo& ri,
 
     prog->textureOffset = 0.0f;
 }
+
+// Collect the programs renderEllipsoid_GLSL() and renderClouds_GLSL() will
+// request for a body lit by a single star, so that they can be compiled
+// before the body comes into view. This has to follow the property setup in
+// those functions. Formats of textures that aren't loaded yet are unknown,
+// so compressed normal maps aren't accounted for.
+void addEllipsoidShaderProperties(const Surface& surface,
+                                  const Atmosphere* atmosphere,
+                                  bool eclipseShadows,
+                                  bool ringShadows,
+                                  unsigned int textureRes,
+                                  std::uint64_t renderFlags,
+                                  std::vector<ShaderProperties>& props)
+{
+    auto hasTexture = [textureRes](const MultiResTexture& tex) { return tex.tex[textureRes] != InvalidResource; };
+
+    ShaderProperties surfaceProps;
+    surfaceProps.texUsage = TexUsage::TextureCoordTransform;
+    surfaceProps.nLights = 1;
+
+    if (hasTexture(surface.baseTexture))
+        surfaceProps.texUsage |= TexUsage::DiffuseTexture;
+    if ((surface.appearanceFlags & Surface::ApplyBumpMap) != 0 && hasTexture(surface.bumpTexture))
+        surfaceProps.texUsage |= TexUsage::NormalTexture;
+
+    if (surface.specularColor != Color::Black)
+    {
+        surfaceProps.lightModel = LightingModel::PerPixelSpecularModel;
+        if ((surface.appearanceFlags & Surface::SeparateSpecularMap) != 0 && hasTexture(surface.specularTexture))
+            surfaceProps.texUsage |= TexUsage::SpecularTexture;
+        else
+            surfaceProps.texUsage |= TexUsage::SpecularInDiffuseAlpha;
+    }
+    if (surface.lunarLambert != 0.0f)
+        surfaceProps.lightModel |= LightingModel::LunarLambertModel;
+
+    if ((surface.appearanceFlags & Surface::ApplyNightMap) != 0 &&
+        (renderFlags & Renderer::ShowNightMaps) != 0 &&
+        hasTexture(surface.nightTexture))
+    {
+        surfaceProps.texUsage |= TexUsage::NightTexture;
+    }
+    if ((surface.appearanceFlags & Surface::ApplyOverlay) != 0 && hasTexture(surface.overlayTexture))
+        surfaceProps.texUsage |= TexUsage::OverlayTexture;
+
+    ShaderProperties cloudProps;
+    bool hasClouds = false;
+    if (atmosphere != nullptr)
+    {
+        bool scattering = (renderFlags & Renderer::ShowAtmospheres) != 0 && atmosphere->mieScaleHeight > 0.0f;
+        if (scattering)
+            surfaceProps.texUsage |= TexUsage::Scattering;
+
+        if ((renderFlags & Renderer::ShowCloudMaps) != 0 && hasTexture(atmosphere->cloudTexture))
+        {
+            hasClouds = true;
+            cloudProps.texUsage = TexUsage::TextureCoordTransform | TexUsage::DiffuseTexture;
+            cloudProps.nLights = 1;
+            if (hasTexture(atmosphere->cloudNormalMap))
+                cloudProps.texUsage |= TexUsage::NormalTexture;
+            if (scattering)
+                cloudProps.texUsage |= TexUsage::Scattering;
+
+            if ((renderFlags & Renderer::ShowCloudShadows) != 0 && atmosphere->cloudShadowDepth > 0.0f)
+            {
+                surfaceProps.texUsage |= TexUsage::CloudShadowTexture;
+                surfaceProps.setCloudShadowForLight(0, true);
+            }
+        }
+    }
+
+    for (unsigned int shadows = 0; shadows <= (eclipseShadows ? 1u : 0u); ++shadows)
+    {
+        ShaderProperties p = surfaceProps;
+        p.setEclipseShadowCountForLight(0, shadows);
+        props.push_back(p);
+
+        if (ringShadows)
+        {
+            p.texUsage |= TexUsage::RingShadowTexture;
+            p.setRingShadowForLight(0, true);
+            props.push_back(p);
+        }
+
+        if (hasClouds)
+        {
+            p = cloudProps;
+            p.setEclipseShadowCountForLight(0, shadows);
+            props.push_back(p);
+        }
+    }
+}
@@ -13,6 +13,7 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -23,8 +24,11 @@ class Atmosphere;
 class Geometry;
 class LightingState;
 struct Matrices;
+struct ModelInstance;
 class Renderer;
 struct RenderInfo;
+class ShaderProperties;
+class Surface;
 class Texture;
 
 namespace celestia::math
@@ -56,6 +60,17 @@ void renderGeometry_GLSL(Geometry* geometry,
                          const Matrices &m,
                          Renderer* renderer);
 
+void renderGeometryInstanced_GLSL(Geometry* geometry,
+                                  const RenderInfo& ri,
+                                  ResourceHandle texOverride,
+                                  const LightingState& ls,
+                                  const std::vector<ModelInstance>& instances,
+                                  float geometryScale,
+                                  const Eigen::Quaternionf& planetOrientation,
+                                  double tsec,
+                                  const Eigen::Matrix4f& projection,
+                                  Renderer* renderer);
+
 void renderClouds_GLSL(const RenderInfo& ri,
                        const LightingState& ls,
                        Atmosphere* atmosphere,
@@ -79,3 +94,11 @@ void renderGeometry_GLSL_Unlit(Geometry* geometry,
                                double tsec,
                                const Matrices &m,
                                Renderer* renderer);
+
+void addEllipsoidShaderProperties(const Surface& surface,
+                                  const Atmosphere* atmosphere,
+                                  bool eclipseShadows,
+                                  bool ringShadows,
+                                  unsigned int textureRes,
+                                  std::uint64_t renderFlags,
+                                  std::vector<ShaderProperties>& props);
@@ -39,6 +39,7 @@ struct RenderInfo
     Eigen::Quaternionf orientation{ Eigen::Quaternionf::Identity() };
     float pixWidth{ 1.0f };
     float pointScale{ 1.0f };
+    float pixelScale{ 0.0f };   // pixels per model unit at the nearest point
 };
 
 extern LODSphereMesh* g_lodSphere;
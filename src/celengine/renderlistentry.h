@@ -33,6 +33,9 @@ struct RenderListEntry
         const ReferenceMark* refMark;
     };
 
+    // Camera relative position in kilometers. It's computed once in double
+    // precision, relative to the observer, when the render lists are built,
+    // so the drawing code never needs the universal position again.
     Eigen::Vector3f position;
     Eigen::Vector3f sun;
     float distance;
@@ -10,7 +10,11 @@
 
 #include "selection.h"
 
+#include <algorithm>
 #include <cassert>
+#include <istream>
+#include <iterator>
+#include <ostream>
 
 #include <fmt/format.h>
 
@@ -18,8 +22,11 @@
 #include <celengine/body.h>
 #include <celengine/location.h>
 #include <celengine/deepskyobj.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
 
 namespace astro = celestia::astro;
+namespace util = celestia::util;
 
 namespace
 {
@@ -37,8 +44,114 @@ UniversalCoord locationPosition(const Location* location, double t)
     return UniversalCoord::Zero();
 }
 
+// Sets the root star and the path of a body. Returns false if the body is
+// not in a star's planetary systems or is nested too deeply.
+bool bodyPath(const Body* body, SelectionId& id)
+{
+    std::array<std::uint32_t, SelectionId::MaxDepth> path;
+    std::size_t depth = 0;
+    for (const PlanetarySystem* system = body->getSystem(); system != nullptr;)
+    {
+        int index = 0;
+        while (index < system->getSystemSize() && system->getBody(index) != body)
+            ++index;
+        if (index == system->getSystemSize() || depth == SelectionId::MaxDepth)
+            return false;
+        path[depth++] = static_cast<std::uint32_t>(index);
+
+        body = system->getPrimaryBody();
+        if (body == nullptr)
+        {
+            const Star* star = system->getStar();
+            if (star == nullptr)
+                return false;
+
+            id.catalogNumber = star->getIndex();
+            id.depth = static_cast<std::uint8_t>(depth);
+            std::reverse_copy(path.begin(), path.begin() + depth, id.path.begin());
+            return true;
+        }
+        system = body->getSystem();
+    }
+
+    return false;
+}
+
 } // end unnamed namespace
 
+bool
+operator==(const SelectionId& id0, const SelectionId& id1)
+{
+    return id0.type == id1.type &&
+           id0.catalogNumber == id1.catalogNumber &&
+           id0.depth == id1.depth &&
+           std::equal(id0.path.begin(), id0.path.begin() + id0.depth, id1.path.begin()) &&
+           id0.location == id1.location;
+}
+
+bool
+writeSelectionId(std::ostream& out, const SelectionId& id)
+{
+    if (!util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(id.type)))
+        return false;
+
+    switch (id.type)
+    {
+    case SelectionType::None:
+        return true;
+    case SelectionType::Star:
+    case SelectionType::DeepSky:
+        return util::writeLE<std::uint32_t>(out, id.catalogNumber);
+    case SelectionType::Body:
+    case SelectionType::Location:
+        if (!util::writeLE<std::uint32_t>(out, id.catalogNumber) ||
+            !util::writeLE<std::uint8_t>(out, id.depth))
+            return false;
+        for (std::uint8_t i = 0; i < id.depth; ++i)
+        {
+            if (!util::writeLE<std::uint32_t>(out, id.path[i]))
+                return false;
+        }
+        return id.type == SelectionType::Body || util::writeLE<std::uint32_t>(out, id.location);
+    default:
+        return false;
+    }
+}
+
+bool
+readSelectionId(std::istream& in, SelectionId& id)
+{
+    id = SelectionId();
+
+    std::uint8_t type;
+    if (!util::readLE<std::uint8_t>(in, type))
+        return false;
+
+    id.type = static_cast<SelectionType>(type);
+    switch (id.type)
+    {
+    case SelectionType::None:
+        return true;
+    case SelectionType::Star:
+    case SelectionType::DeepSky:
+        return util::readLE<std::uint32_t>(in, id.catalogNumber);
+    case SelectionType::Body:
+    case SelectionType::Location:
+        if (!util::readLE<std::uint32_t>(in, id.catalogNumber) ||
+            !util::readLE<std::uint8_t>(in, id.depth) ||
+            id.depth == 0 || id.depth > SelectionId::MaxDepth)
+            return false;
+        for (std::uint8_t i = 0; i < id.depth; ++i)
+        {
+            if (!util::readLE<std::uint32_t>(in, id.path[i]))
+                return false;
+        }
+        return id.type == SelectionType::Body || util::readLE<std::uint32_t>(in, id.location);
+    default:
+        return false;
+    }
+}
+
 double
 Selection::radius() const
 {
@@ -143,6 +256,47 @@ Selection::parent() const
     }
 }
 
+SelectionId
+Selection::id() const
+{
+    SelectionId id;
+    switch (type)
+    {
+    case SelectionType::Star:
+        id.catalogNumber = static_cast<const Star*>(obj)->getIndex();
+        break;
+    case SelectionType::DeepSky:
+        id.catalogNumber = static_cast<const DeepSkyObject*>(obj)->getIndex();
+        break;
+    case SelectionType::Body:
+        if (!bodyPath(static_cast<const Body*>(obj), id))
+            return SelectionId();
+        break;
+    case SelectionType::Location:
+        {
+            auto location = static_cast<const Location*>(obj);
+            const Body* body = location->getParentBody();
+            if (body == nullptr || !bodyPath(body, id))
+                return SelectionId();
+
+            auto locations = GetBodyFeaturesManager()->getLocations(body);
+            if (!locations.has_value())
+                return SelectionId();
+
+            auto it = std::find(locations->begin(), locations->end(), location);
+            if (it == locations->end())
+                return SelectionId();
+            id.location = static_cast<std::uint32_t>(std::distance(locations->begin(), it));
+        }
+        break;
+    default:
+        return SelectionId();
+    }
+
+    id.type = type;
+    return id;
+}
+
 /*! Return true if the selection's visibility flag is set. */
 bool
 Selection::isVisible() const
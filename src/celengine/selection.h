@@ -9,8 +9,11 @@
 
 #pragma once
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <iosfwd>
 #include <string>
 #include <celengine/univcoord.h>
 #include <Eigen/Core>
@@ -29,6 +32,45 @@ enum class SelectionType
     Location,
 };
 
+// Identifies an object by its place in the catalogs rather than by its
+// address, so that it can be sent to another process or kept while the
+// catalogs are loaded again. Stars and deep sky objects are identified by
+// their catalog number. Bodies are identified by the catalog number of the
+// star at the root of their planetary systems and their index in each
+// planetary system from the star's down to their own; locations also by
+// their index on their body.
+struct SelectionId
+{
+    // Deepest nesting of planetary systems that can be identified
+    static constexpr std::size_t MaxDepth = 16;
+
+    SelectionType type{ SelectionType::None };
+    // Catalog number of the star or deep sky object, or of the star at the
+    // root of the planetary systems of a body or location
+    std::uint32_t catalogNumber{ 0 };
+    // Number of entries of path used by a body or location
+    std::uint8_t depth{ 0 };
+    std::array<std::uint32_t, MaxDepth> path{};
+    // Index of a location on its body
+    std::uint32_t location{ 0 };
+
+    bool empty() const { return type == SelectionType::None; }
+};
+
+bool operator==(const SelectionId& id0, const SelectionId& id1);
+
+inline bool operator!=(const SelectionId& id0, const SelectionId& id1)
+{
+    return !(id0 == id1);
+}
+
+// Binary form of an ID used by state snapshots, cluster frames and remote
+// control messages: the type as a byte, the catalog number, and for bodies
+// and locations the depth as a byte, the path and the location index, all
+// little-endian. readSelectionId returns false if the data is malformed.
+bool writeSelectionId(std::ostream& out, const SelectionId& id);
+bool readSelectionId(std::istream& in, SelectionId& id);
+
 class Selection
 {
  public:
@@ -74,6 +116,13 @@ class Selection
 
     inline SelectionType getType() const { return type; }
 
+    // The object's place in the catalogs, see SelectionId. Empty for an
+    // empty selection and for bodies which are not in a star's planetary
+    // systems or are nested deeper than SelectionId::MaxDepth. For bodies
+    // and locations this searches each planetary system on the way up, so
+    // it is meant for saving and sending selections, not for use as a key.
+    SelectionId id() const;
+
  private:
     SelectionType type { SelectionType::None };
     void* obj { nullptr };
@@ -103,7 +152,14 @@ struct hash<Selection>
 {
     std::size_t operator()(const Selection& sel) const noexcept
     {
-        return hash<const void*>()(sel.obj);
+        // Objects are allocated with at least 8 byte alignment, so the low
+        // bits of the pointer are always zero; mix them in with the
+        // splitmix64 finalizer so that tables with power of two bucket
+        // counts don't cluster
+        auto x = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(sel.obj));
+        x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+        x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+        return static_cast<std::size_t>(x ^ (x >> 31));
     }
 };
 }
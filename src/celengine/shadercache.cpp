@@ -0,0 +1,277 @@
+// shadercache.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// On-disk cache of linked shader program binaries.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "shadercache.h"
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#include <fmt/format.h>
+
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/logger.h>
+#include <celutil/mappedfile.h>
+#include "glshader.h"
+
+using namespace std::string_view_literals;
+using celestia::util::GetLogger;
+
+namespace celestia::engine
+{
+namespace
+{
+
+// Bump kProgramCacheVersion whenever the file layout changes
+constexpr std::string_view kProgramCacheMagic = "CELSHPRG"sv;
+constexpr std::uint16_t kProgramCacheVersion = 1;
+
+// Records the driver the cached binaries were built with
+constexpr std::string_view kDriverStampName = "driver.txt"sv;
+constexpr std::string_view kProgramExtension = ".bin"sv;
+
+#pragma pack(push, 1)
+struct ProgramCacheHeader
+{
+    char          magic[8]; //NOSONAR
+    std::uint16_t version;
+    std::uint16_t reserved;
+    std::uint32_t format;
+    std::uint64_t driverHash;
+    std::uint64_t sourceHash;
+    std::uint32_t length;
+};
+#pragma pack(pop)
+
+static_assert(std::is_standard_layout_v<ProgramCacheHeader>);
+
+constexpr std::uint64_t kFNVOffsetBasis = UINT64_C(0xcbf29ce484222325);
+
+// 64-bit FNV-1a
+std::uint64_t
+hashString(std::uint64_t hash, std::string_view s)
+{
+    for (char c : s)
+        hash = (hash ^ static_cast<std::uint8_t>(c)) * UINT64_C(0x100000001b3);
+    // Terminate each part so that moving text between parts changes the hash
+    return hash * UINT64_C(0x100000001b3);
+}
+
+std::string
+getGLString(GLenum name)
+{
+    const auto* s = reinterpret_cast<const char*>(glGetString(name));
+    return s == nullptr ? std::string() : std::string(s);
+}
+
+bool
+supportsProgramBinary()
+{
+    if (!gl::hasProgramBinary())
+        return false;
+
+    // Some drivers expose the entry points but no binary formats
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+std::string
+readDriverStamp(const fs::path& path)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return {};
+
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Delete all cached programs, leaving other files alone
+void
+clearPrograms(const fs::path& directory)
+{
+    std::error_code ec;
+    std::vector<fs::path> programs;
+    for (auto it = fs::directory_iterator(directory, ec); !ec && it != fs::directory_iterator(); it.increment(ec))
+    {
+        if (it->path().extension() == kProgramExtension)
+            programs.push_back(it->path());
+    }
+
+    for (const fs::path& path : programs)
+        fs::remove(path, ec);
+}
+
+} // end unnamed namespace
+
+ShaderCache::ShaderCache(const fs::path& directory) :
+    m_directory(directory)
+{
+}
+
+bool
+ShaderCache::isEnabled()
+{
+    if (!m_opened)
+        open();
+    return m_enabled;
+}
+
+std::uint64_t
+ShaderCache::hashSources(std::string_view vs, std::string_view gs, std::string_view fs)
+{
+    std::uint64_t hash = kFNVOffsetBasis;
+    hash = hashString(hash, vs);
+    hash = hashString(hash, gs);
+    return hashString(hash, fs);
+}
+
+void
+ShaderCache::open()
+{
+    m_opened = true;
+    if (m_directory.empty() || !supportsProgramBinary())
+        return;
+
+    std::error_code ec;
+    fs::create_directories(m_directory, ec);
+    if (ec)
+    {
+        GetLogger()->warn("Failed to create shader cache directory {}. Shader cache disabled.\n", m_directory);
+        return;
+    }
+
+    std::string driver = fmt::format("{}\n{}\n{}\n",
+                                     getGLString(GL_VENDOR),
+                                     getGLString(GL_RENDERER),
+                                     getGLString(GL_VERSION));
+    m_driverHash = hashString(kFNVOffsetBasis, driver);
+
+    // Binaries from another driver would only be rejected one by one, so get
+    // rid of all of them at once
+    fs::path stampPath = m_directory / kDriverStampName;
+    if (readDriverStamp(stampPath) != driver)
+    {
+        clearPrograms(m_directory);
+
+        std::ofstream out(stampPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write(driver.data(), static_cast<std::streamsize>(driver.size()));
+        if (!out.flush().good())
+        {
+            GetLogger()->warn("Failed to write {}. Shader cache disabled.\n", stampPath);
+            return;
+        }
+    }
+
+    m_enabled = true;
+}
+
+fs::path
+ShaderCache::getPath(std::uint64_t key) const
+{
+    return m_directory / fmt::format("{:016x}{}", key, kProgramExtension);
+}
+
+std::optional<ShaderCache::ProgramBinary>
+ShaderCache::load(std::uint64_t key) const
+{
+    if (!m_enabled)
+        return std::nullopt;
+
+    auto file = util::MappedFile::open(getPath(key));
+    if (file == nullptr || file->size() < sizeof(ProgramCacheHeader))
+        return std::nullopt;
+
+    const char* data = file->data();
+    if (std::memcmp(data, kProgramCacheMagic.data(), kProgramCacheMagic.size()) != 0 ||
+        util::fromMemoryLE<std::uint16_t>(data + offsetof(ProgramCacheHeader, version)) != kProgramCacheVersion ||
+        util::fromMemoryLE<std::uint64_t>(data + offsetof(ProgramCacheHeader, driverHash)) != m_driverHash ||
+        util::fromMemoryLE<std::uint64_t>(data + offsetof(ProgramCacheHeader, sourceHash)) != key)
+    {
+        return std::nullopt;
+    }
+
+    auto length = util::fromMemoryLE<std::uint32_t>(data + offsetof(ProgramCacheHeader, length));
+    if (file->size() - sizeof(ProgramCacheHeader) != length)
+        return std::nullopt;
+
+    ProgramBinary binary;
+    binary.format = static_cast<GLenum>(util::fromMemoryLE<std::uint32_t>(data + offsetof(ProgramCacheHeader, format)));
+    binary.data.assign(data + sizeof(ProgramCacheHeader), data + file->size());
+    return binary;
+}
+
+bool
+ShaderCache::store(std::uint64_t key, const GLProgram& program) const
+{
+    if (!m_enabled)
+        return false;
+
+    GLint length = 0;
+    glGetProgramiv(program.getID(), GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+
+    std::vector<char> data(static_cast<std::size_t>(length));
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program.getID(), length, &written, &format, data.data());
+    if (written <= 0)
+        return false;
+
+    // Write to a temporary file first so that another instance never loads
+    // a partial binary.
+    fs::path cachePath = getPath(key);
+    fs::path tempPath = cachePath;
+    tempPath += ".tmp";
+
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.good())
+            return false;
+
+        out.write(kProgramCacheMagic.data(), kProgramCacheMagic.size());
+        bool ok = util::writeLE<std::uint16_t>(out, kProgramCacheVersion) &&
+                  util::writeLE<std::uint16_t>(out, 0) &&
+                  util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(format)) &&
+                  util::writeLE<std::uint64_t>(out, m_driverHash) &&
+                  util::writeLE<std::uint64_t>(out, key) &&
+                  util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(written));
+
+        if (!ok || !out.write(data.data(), written).flush().good())
+            return false;
+    }
+
+    std::error_code ec;
+    fs::rename(tempPath, cachePath, ec);
+    if (ec)
+    {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    return true;
+}
+
+void
+ShaderCache::remove(std::uint64_t key) const
+{
+    if (!m_enabled)
+        return;
+
+    std::error_code ec;
+    fs::remove(getPath(key), ec);
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,69 @@
+// shadercache.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// On-disk cache of linked shader program binaries.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include "glsupport.h"
+
+class GLProgram;
+
+namespace celestia::engine
+{
+
+// Stores the binaries of linked programs so that later runs can skip
+// compiling and linking them. Each program is kept in its own file named by
+// a hash of its sources, so changed sources simply miss the cache. Binaries
+// are only valid for the driver that produced them: every file records a
+// hash of the GL vendor, renderer and version strings, and the whole cache
+// is discarded when these change.
+//
+// The cache is opened on first use since querying the driver requires a
+// current GL context. It stays disabled if the driver doesn't support
+// program binaries or the directory can't be created.
+class ShaderCache
+{
+public:
+    struct ProgramBinary
+    {
+        GLenum format;
+        std::vector<char> data;
+    };
+
+    explicit ShaderCache(const fs::path& directory);
+
+    bool isEnabled();
+
+    // Key of a program built from the given sources; pass an empty view for
+    // a missing geometry shader
+    static std::uint64_t hashSources(std::string_view vs, std::string_view gs, std::string_view fs);
+
+    std::optional<ProgramBinary> load(std::uint64_t key) const;
+    bool store(std::uint64_t key, const GLProgram& program) const;
+    void remove(std::uint64_t key) const;
+
+private:
+    void open();
+    fs::path getPath(std::uint64_t key) const;
+
+    fs::path m_directory;
+    std::uint64_t m_driverHash{ 0 };
+    bool m_opened{ false };
+    bool m_enabled{ false };
+};
+
+} // end namespace celestia::engine
@@ -12,6 +12,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <cmath>
 #include <fstream>
@@ -32,6 +33,7 @@
 #include "atmosphere.h"
 #include "glsupport.h"
 #include "lightenv.h"
+#include "shadercache.h"
 
 
 using celestia::util::GetLogger;
@@ -114,7 +116,7 @@ vec4 calc_vp(vec4 in_Position)
         float lensR = phi / PID2;
         inPos.xy *= (lensR / l);
     }
-    return ProjectionMatrix * inPos;
+    return depth_vp(ProjectionMatrix * inPos);
 }
 void set_vp(vec4 in_Position)
 {
@@ -125,7 +127,7 @@ void set_vp(vec4 in_Position)
 constexpr std::string_view VPFunctionUsual = R"glsl(
 vec4 calc_vp(vec4 in_Position)
 {
-    return MVPMatrix * in_Position;
+    return depth_vp(MVPMatrix * in_Position);
 }
 void set_vp(vec4 in_Position)
 {
@@ -133,10 +135,34 @@ void set_vp(vec4 in_Position)
 }
 )glsl"sv;
 
-constexpr std::string_view
-VPFunction(bool enabled)
+constexpr std::string_view DepthFunctionLinear = R"glsl(
+vec4 depth_vp(vec4 p)
+{
+    return p;
+}
+)glsl"sv;
+
+// Depth is written per vertex, which is accurate enough as long as
+// triangles are small compared to their distance from the camera
+constexpr std::string_view DepthFunctionLogarithmic = R"glsl(
+uniform float logDepthCoefficient;
+vec4 depth_vp(vec4 p)
+{
+    if (logDepthCoefficient > 0.0)
+        p.z = (log2(max(1.0e-6, 1.0 + p.w)) * logDepthCoefficient - 1.0) * p.w;
+    return p;
+}
+)glsl"sv;
+
+// Maps log2(1 + distance) for distances up to LogDepthFarDistance to [0, 2]
+const float LogDepthCoefficient = 2.0f / std::log2(1.0f + LogDepthFarDistance);
+
+std::string
+VPFunction(bool fisheye, bool logDepth)
 {
-    return enabled ? VPFunctionFishEye : VPFunctionUsual;
+    return fmt::format("{}{}",
+                       logDepth ? DepthFunctionLogarithmic : DepthFunctionLinear,
+                       fisheye ? VPFunctionFishEye : VPFunctionUsual);
 }
 
 constexpr std::string_view NormalVertexPosition = R"glsl(
@@ -153,12 +179,60 @@ constexpr std::string_view LineVertexPosition = R"glsl(
     gl_Position = vec4((thisPos.xy + transform) * thisPos.w, thisPos.zw);
 )glsl"sv;
 
+// Wide lines drawn as one instanced quad per segment; the instance holds
+// both ends of the segment and the corner selects the end and the side.
+constexpr std::string_view LineQuadVertexPosition = R"glsl(
+    vec4 thisPos = calc_vp(mix(in_Position, in_PositionNext, in_LineCorner.x));
+    vec4 nextPos = calc_vp(mix(in_PositionNext, in_Position, in_LineCorner.x));
+    thisPos.xy /= thisPos.w;
+    nextPos.xy /= nextPos.w;
+    vec2 transform = normalize(nextPos.xy - thisPos.xy);
+    transform = vec2(transform.y * lineWidthX, -transform.x * lineWidthY) * in_LineCorner.y;
+    gl_Position = vec4((thisPos.xy + transform) * thisPos.w, thisPos.zw);
+)glsl"sv;
+
+constexpr std::string_view InstancedVertexPosition = R"glsl(
+    set_vp(instancePosition);
+)glsl"sv;
+
 std::string_view
 VertexPosition(const ShaderProperties& props)
 {
+    if (props.isInstanced())
+        return InstancedVertexPosition;
+    if (util::is_set(props.texUsage, TexUsage::LineQuadInstances))
+        return LineQuadVertexPosition;
     return util::is_set(props.texUsage, TexUsage::LineAsTriangles) ? LineVertexPosition : NormalVertexPosition;
 }
 
+// Per instance model view matrix, stored as its first three rows, and
+// light. The xyz components of the light are its direction in model space,
+// w scales its color.
+constexpr std::string_view InstanceDeclarations = R"glsl(
+attribute vec4 in_InstanceRow0;
+attribute vec4 in_InstanceRow1;
+attribute vec4 in_InstanceRow2;
+attribute vec4 in_InstanceLight;
+varying vec4 instanceLight;
+varying vec3 eyePosition;
+)glsl"sv;
+
+// The model view matrix already applies to the vertex, so the
+// MVPMatrix uniform holds just the projection. The eye position in model
+// space comes from inverting the matrix with cross products.
+constexpr std::string_view InstanceTransform = R"glsl(
+vec4 instancePosition = vec4(dot(in_InstanceRow0, in_Position),
+                             dot(in_InstanceRow1, in_Position),
+                             dot(in_InstanceRow2, in_Position),
+                             1.0);
+vec3 c0 = cross(in_InstanceRow1.xyz, in_InstanceRow2.xyz);
+vec3 c1 = cross(in_InstanceRow2.xyz, in_InstanceRow0.xyz);
+vec3 c2 = cross(in_InstanceRow0.xyz, in_InstanceRow1.xyz);
+eyePosition = -(in_InstanceRow0.w * c0 + in_InstanceRow1.w * c1 + in_InstanceRow2.w * c2) /
+              dot(in_InstanceRow0.xyz, c0);
+instanceLight = in_InstanceLight;
+)glsl"sv;
+
 constexpr std::string_view FragmentHeader = ""sv;
 
 constexpr std::string_view CommonAttribs = R"glsl(
@@ -402,6 +476,67 @@ DeclareLights(const ShaderProperties& props)
 }
 
 
+// Instanced draws support a single light. Its color is the uniform scaled
+// by the instance, and the shader computes the remaining light properties
+// from the direction the instance provides, so they are plain variables
+// under the same names as for other programs.
+std::string
+DeclareInstancedLights(const ShaderProperties& props)
+{
+    std::ostringstream stream;
+    stream << DeclareUniform("instanceLight0_diffuse", Shader_Vector3);
+    if (props.hasSpecular())
+        stream << DeclareUniform("instanceLight0_specular", Shader_Vector3);
+    if (util::is_set(props.texUsage, TexUsage::NightTexture))
+        stream << DeclareUniform("instanceLight0_brightness", Shader_Float);
+    stream << DeclareInput("instanceLight", Shader_Vector4);
+
+#ifdef USE_GLSL_STRUCTS
+    stream << "struct {\n";
+    stream << "   vec3 direction;\n";
+    stream << "   vec3 diffuse;\n";
+    stream << "   vec3 specular;\n";
+    stream << "   vec3 halfVector;\n";
+    if (util::is_set(props.texUsage, TexUsage::NightTexture))
+        stream << "   float brightness;\n";
+    stream << "} lights[1];\n";
+#else
+    stream << DeclareLocal(LightProperty(0, "direction"), Shader_Vector3);
+    stream << DeclareLocal(LightProperty(0, "diffuse"), Shader_Vector3);
+    if (props.hasSpecular())
+    {
+        stream << DeclareLocal(LightProperty(0, "specular"), Shader_Vector3);
+        stream << DeclareLocal(LightProperty(0, "halfVector"), Shader_Vector3);
+    }
+    if (util::is_set(props.texUsage, TexUsage::NightTexture))
+        stream << DeclareLocal(LightProperty(0, "brightness"), Shader_Float);
+#endif
+
+    return stream.str();
+}
+
+std::string
+InstancedLightSetup(const ShaderProperties& props)
+{
+    std::string source;
+    source += "float lightScale = instanceLight.w;\n";
+    // The length of the direction holds the change of the photometric
+    // normalization factor
+    if (util::is_set(props.lightModel, LightingModel::LunarLambertModel))
+        source += "lightScale *= length(instanceLight.xyz);\n";
+    source += LightProperty(0, "direction") + " = normalize(instanceLight.xyz);\n";
+    source += LightProperty(0, "diffuse") + " = instanceLight0_diffuse * lightScale;\n";
+    if (props.hasSpecular())
+    {
+        source += LightProperty(0, "specular") + " = instanceLight0_specular * lightScale;\n";
+        source += LightProperty(0, "halfVector") + " = normalize(normalize(eyePosition) + " + LightProperty(0, "direction") + ");\n";
+    }
+    if (util::is_set(props.texUsage, TexUsage::NightTexture))
+        source += LightProperty(0, "brightness") + " = instanceLight0_brightness * lightScale;\n";
+    return source;
+}
+
+
 std::string
 SeparateDiffuse(unsigned int i)
 {
@@ -996,11 +1131,14 @@ StaticPointSize()
 }
 
 static std::string
-LineDeclaration()
+LineDeclaration(const ShaderProperties& props)
 {
     std::string source;
     source += DeclareAttribute("in_PositionNext", Shader_Vector4);
-    source += DeclareAttribute("in_ScaleFactor", Shader_Float);
+    if (util::is_set(props.texUsage, TexUsage::LineQuadInstances))
+        source += DeclareAttribute("in_LineCorner", Shader_Vector2);
+    else
+        source += DeclareAttribute("in_ScaleFactor", Shader_Float);
     source += DeclareUniform("lineWidthX", Shader_Float);
     source += DeclareUniform("lineWidthY", Shader_Float);
     return source;
@@ -1062,8 +1200,13 @@ BindAttribLocations(const GLProgram *prog)
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::IntensityAttributeIndex,     "in_Intensity");
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::NextVCoordAttributeIndex,    "in_PositionNext");
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::ScaleFactorAttributeIndex,   "in_ScaleFactor");
+    glBindAttribLocation(prog->getID(), CelestiaGLProgram::LineCornerAttributeIndex,    "in_LineCorner");
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::TangentAttributeIndex,       "in_Tangent");
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::PointSizeAttributeIndex,     "in_PointSize");
+    glBindAttribLocation(prog->getID(), CelestiaGLProgram::InstanceTransformAttributeIndex,     "in_InstanceRow0");
+    glBindAttribLocation(prog->getID(), CelestiaGLProgram::InstanceTransformAttributeIndex + 1, "in_InstanceRow1");
+    glBindAttribLocation(prog->getID(), CelestiaGLProgram::InstanceTransformAttributeIndex + 2, "in_InstanceRow2");
+    glBindAttribLocation(prog->getID(), CelestiaGLProgram::InstanceLightAttributeIndex,         "in_InstanceLight");
 }
 
 std::optional<std::string>
@@ -1096,7 +1239,7 @@ ReadShaderFile(const fs::path &path)
 GLShaderStatus
 CreateErrorShader(GLProgram **prog, bool fisheyeEnabled)
 {
-    std::string _vs = fmt::format("{}{}{}{}{}\n", VersionHeader, CommonHeader, VertexHeader, VPFunction(fisheyeEnabled), errorVertexShaderSource);
+    std::string _vs = fmt::format("{}{}{}{}{}\n", VersionHeader, CommonHeader, VertexHeader, VPFunction(fisheyeEnabled, false), errorVertexShaderSource);
     std::string _fs = fmt::format("{}{}{}{}\n", VersionHeader, CommonHeader, FragmentHeader, errorFragmentShaderSource);
 
     auto status = GLShaderLoader::CreateProgram(_vs, _fs, prog);
@@ -1155,6 +1298,12 @@ OutPrimitive(GLint prim)
 
 } // end unnamed namespace
 
+float
+LogDepthNormalizedDeviceZ(float distance)
+{
+    return std::log2(std::max(1.0e-6f, 1.0f + distance)) * LogDepthCoefficient - 1.0f;
+}
+
 bool
 ShaderProperties::usesShadows() const
 {
@@ -1298,6 +1447,12 @@ ShaderProperties::hasTextureCoordTransform() const
     return util::is_set(texUsage, TexUsage::TextureCoordTransform);
 }
 
+bool
+ShaderProperties::isInstanced() const
+{
+    return util::is_set(texUsage, TexUsage::InstancedTransform);
+}
+
 bool
 ShaderProperties::hasSpecular() const
 {
@@ -1371,6 +1526,9 @@ ShaderManager::~ShaderManager()
 
     dynamicShaders.clear();
 
+    for (const auto& pending : pendingPrograms)
+        delete pending.second.program;
+
     for(const auto& shader : staticShaders)
         delete shader.second;
 
@@ -1386,6 +1544,15 @@ ShaderManager::getShader(const ShaderProperties& props)
         // Shader already exists
         return iter->second;
     }
+    else if (auto pending = pendingPrograms.find(props); pending != pendingPrograms.end())
+    {
+        // Still being precompiled, wait for it
+        CelestiaGLProgram* prog = finishProgram(props, pending->second);
+        pendingPrograms.erase(pending);
+        dynamicShaders[props] = prog;
+
+        return prog;
+    }
     else
     {
         // Create a new shader and add it to the table of created shaders
@@ -1498,7 +1665,7 @@ ShaderManager::getShaderGL3(std::string_view name, std::string_view vs, std::str
 }
 
 
-GLVertexShader*
+std::string
 ShaderManager::buildVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -1534,7 +1701,12 @@ R"glsl(
     if (props.hasTextureCoordTransform())
         source += TextureTransformUniforms;
 
-    source += DeclareLights(props);
+    // Only shadows use the lights in the vertex shader, and instanced
+    // programs have none
+    if (props.isInstanced())
+        source += InstanceDeclarations;
+    else
+        source += DeclareLights(props);
     source += TextureCoordDeclarations(props, Shader_Out);
     source += DeclareUniform("textureOffset", Shader_Float);
 
@@ -1581,12 +1753,15 @@ R"glsl(
         source += DeclareUniform("ShadowMatrix0", Shader_Matrix4);
 
     if (util::is_set(props.texUsage, TexUsage::LineAsTriangles))
-        source += LineDeclaration();
+        source += LineDeclaration(props);
 
-    source += VPFunction(props.fishEyeOverride != FisheyeOverrideMode::Disabled && fisheyeEnabled);
+    source += VPFunction(props.fishEyeOverride != FisheyeOverrideMode::Disabled && fisheyeEnabled, logDepthEnabled);
 
     // Begin main() function
     source += "\nvoid main(void)\n{\n";
+    if (props.isInstanced())
+        source += InstanceTransform;
+
     if (props.lightModel != LightingModel::ParticleDiffuseModel)
         source += "normal = in_Normal;\n";
 
@@ -1737,13 +1912,11 @@ R"glsl(
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == GLShaderStatus::OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -1772,7 +1945,10 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
     if (props.hasScattering())
         source += ScatteringConstantDeclarations(props);
 
-    source += DeclareUniform("eyePosition", Shader_Vector3);
+    if (props.isInstanced())
+        source += DeclareInput("eyePosition", Shader_Vector3);
+    else
+        source += DeclareUniform("eyePosition", Shader_Vector3);
 
     if (util::is_set(props.lightModel, LightingModel::LunarLambertModel))
         source += DeclareUniform("lunarLambert", Shader_Float);
@@ -1843,9 +2019,14 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
         source += CalculateShadow();
     }
 
-    source += DeclareLights(props);
+    if (props.isInstanced())
+        source += DeclareInstancedLights(props);
+    else
+        source += DeclareLights(props);
 
     source += "\nvoid main(void)\n{\n";
+    if (props.isInstanced())
+        source += InstancedLightSetup(props);
     source += "vec4 color;\n";
 
     if (props.lightModel != LightingModel::ParticleDiffuseModel)
@@ -2097,12 +2278,10 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == GLShaderStatus::OK ? fs : nullptr;
+    return source;
 }
 
-GLVertexShader*
+std::string
 ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2124,7 +2303,7 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
     if (util::is_set(props.texUsage, TexUsage::DiffuseTexture))
         source += DeclareOutput("diffTexCoord", Shader_Vector2);
 
-    source += VPFunction(props.fishEyeOverride != FisheyeOverrideMode::Disabled && fisheyeEnabled);
+    source += VPFunction(props.fishEyeOverride != FisheyeOverrideMode::Disabled && fisheyeEnabled, logDepthEnabled);
 
     source += "\nvoid main(void)\n{\n";
 
@@ -2146,13 +2325,11 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == GLShaderStatus::OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2251,13 +2428,11 @@ ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == GLShaderStatus::OK ? fs : nullptr;
+    return source;
 }
 
 
-GLVertexShader*
+std::string
 ShaderManager::buildAtmosphereVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2273,7 +2448,7 @@ ShaderManager::buildAtmosphereVertexShader(const ShaderProperties& props)
     source += DeclareOutput("position", Shader_Vector3);
     source += DeclareOutput("normal", Shader_Vector3);
 
-    source += VPFunction(props.fishEyeOverride != FisheyeOverrideMode::Disabled && fisheyeEnabled);
+    source += VPFunction(props.fishEyeOverride != FisheyeOverrideMode::Disabled && fisheyeEnabled, logDepthEnabled);
 
     // Begin main() function
     source += "\nvoid main(void)\n{\n";
@@ -2284,13 +2459,11 @@ ShaderManager::buildAtmosphereVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == GLShaderStatus::OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildAtmosphereFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2338,15 +2511,13 @@ ShaderManager::buildAtmosphereFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == GLShaderStatus::OK ? fs : nullptr;
+    return source;
 }
 
 
 // The emissive shader ignores all lighting and uses the diffuse color
 // as the final fragment color.
-GLVertexShader*
+std::string
 ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2375,7 +2546,7 @@ ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
     source += DeclareOutput("v_Color", Shader_Vector4);
     source += DeclareOutput("v_TexCoord0", Shader_Vector2);
 
-    source += VPFunction(props.fishEyeOverride != FisheyeOverrideMode::Disabled && fisheyeEnabled);
+    source += VPFunction(props.fishEyeOverride != FisheyeOverrideMode::Disabled && fisheyeEnabled, logDepthEnabled);
 
     // Begin main() function
     source += "\nvoid main(void)\n{\n";
@@ -2404,13 +2575,11 @@ ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == GLShaderStatus::OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildEmissiveFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2455,14 +2624,12 @@ ShaderManager::buildEmissiveFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == GLShaderStatus::OK ? fs : nullptr;
+    return source;
 }
 
 
 // Build the vertex shader used for rendering particle systems.
-GLVertexShader*
+std::string
 ShaderManager::buildParticleVertexShader(const ShaderProperties& props)
 {
     std::ostringstream source;
@@ -2491,7 +2658,7 @@ ShaderManager::buildParticleVertexShader(const ShaderProperties& props)
     if (props.usesShadows())
         source << DeclareOutput("position", Shader_Vector3);
 
-    source << VPFunction(props.fishEyeOverride != FisheyeOverrideMode::Disabled && fisheyeEnabled);
+    source << VPFunction(props.fishEyeOverride != FisheyeOverrideMode::Disabled && fisheyeEnabled, logDepthEnabled);
 
     // Begin main() function
     source << "\nvoid main(void)\n{\n";
@@ -2531,13 +2698,11 @@ ShaderManager::buildParticleVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source.str(), &vs);
-    return status == GLShaderStatus::OK ? vs : nullptr;
+    return source.str();
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildParticleFragmentShader(const ShaderProperties& props)
 {
     std::ostringstream source;
@@ -2586,20 +2751,12 @@ ShaderManager::buildParticleFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source.str(), &fs);
-    return status == GLShaderStatus::OK ? fs : nullptr;
+    return source.str();
 }
 
-CelestiaGLProgram*
-ShaderManager::buildProgram(const ShaderProperties& props)
+void
+ShaderManager::buildSources(const ShaderProperties& props, std::string& vs, std::string& fs)
 {
-    GLProgram* prog = nullptr;
-    GLShaderStatus status;
-
-    GLVertexShader* vs = nullptr;
-    GLFragmentShader* fs = nullptr;
-
     if (props.lightModel == LightingModel::RingIllumModel)
     {
         vs = buildRingsVertexShader(props);
@@ -2625,25 +2782,17 @@ ShaderManager::buildProgram(const ShaderProperties& props)
         vs = buildVertexShader(props);
         fs = buildFragmentShader(props);
     }
+}
 
-    if (vs != nullptr && fs != nullptr)
-    {
-        status = GLShaderLoader::CreateProgram(*vs, *fs, &prog);
-        if (status == GLShaderStatus::OK)
-        {
-            BindAttribLocations(prog);
-            status = prog->link();
-        }
-    }
-    else
-    {
-        status = GLShaderStatus::CompileError;
-    }
-
-    delete vs;
-    delete fs;
+CelestiaGLProgram*
+ShaderManager::buildProgram(const ShaderProperties& props)
+{
+    std::string vs;
+    std::string fs;
+    buildSources(props, vs, fs);
 
-    if (status != GLShaderStatus::OK)
+    GLProgram* prog = createProgram(vs, {}, fs);
+    if (prog == nullptr)
     {
         // If the shader creation failed for some reason, substitute the
         // error shader.
@@ -2657,22 +2806,14 @@ ShaderManager::buildProgram(const ShaderProperties& props)
 CelestiaGLProgram*
 ShaderManager::buildProgram(std::string_view vs, std::string_view fs)
 {
-    GLProgram* prog = nullptr;
-    GLShaderStatus status;
-    std::string _vs = fmt::format("{}{}{}{}{}\n", VersionHeader, CommonHeader, VertexHeader, VPFunction(fisheyeEnabled), vs);
+    std::string _vs = fmt::format("{}{}{}{}{}\n", VersionHeader, CommonHeader, VertexHeader, VPFunction(fisheyeEnabled, logDepthEnabled), vs);
     std::string _fs = fmt::format("{}{}{}{}\n", VersionHeader, CommonHeader, FragmentHeader, fs);
 
     DumpVSSource(_vs);
     DumpFSSource(_fs);
 
-    status = GLShaderLoader::CreateProgram(_vs, _fs, &prog);
-    if (status == GLShaderStatus::OK)
-    {
-        BindAttribLocations(prog);
-        status = prog->link();
-    }
-
-    if (status != GLShaderStatus::OK)
+    GLProgram* prog = createProgram(_vs, {}, _fs);
+    if (prog == nullptr)
     {
         // If the shader creation failed for some reason, substitute the
         // error shader.
@@ -2686,22 +2827,14 @@ ShaderManager::buildProgram(std::string_view vs, std::string_view fs)
 CelestiaGLProgram*
 ShaderManager::buildProgramGL3(std::string_view vs, std::string_view fs)
 {
-    GLProgram* prog = nullptr;
-    GLShaderStatus status;
-    std::string _vs = fmt::format("{}{}{}{}{}\n", VersionHeaderGL3, CommonHeader, VertexHeader, VPFunction(fisheyeEnabled), vs);
+    std::string _vs = fmt::format("{}{}{}{}{}\n", VersionHeaderGL3, CommonHeader, VertexHeader, VPFunction(fisheyeEnabled, logDepthEnabled), vs);
     std::string _fs = fmt::format("{}{}{}{}\n", VersionHeaderGL3, CommonHeader, FragmentHeader, fs);
 
     DumpVSSource(_vs);
     DumpFSSource(_fs);
 
-    status = GLShaderLoader::CreateProgram(_vs, _fs, &prog);
-    if (status == GLShaderStatus::OK)
-    {
-        BindAttribLocations(prog);
-        status = prog->link();
-    }
-
-    if (status != GLShaderStatus::OK)
+    GLProgram* prog = createProgram(_vs, {}, _fs);
+    if (prog == nullptr)
     {
         // If the shader creation failed for some reason, substitute the
         // error shader.
@@ -2724,32 +2857,195 @@ ShaderManager::buildProgramGL3(std::string_view vs, std::string_view gs, std::st
                              params->nOutVertices);
     }
 
-    GLProgram* prog = nullptr;
-    GLShaderStatus status;
     auto _vs = fmt::format("{}{}{}{}\n", VersionHeaderGL3, CommonHeader, VertexHeader, vs);
-    auto _gs = fmt::format("{}{}{}{}{}{}\n", VersionHeaderGL3, CommonHeader, layout, GeomHeaderGL3, VPFunction(fisheyeEnabled), gs);
+    auto _gs = fmt::format("{}{}{}{}{}{}\n", VersionHeaderGL3, CommonHeader, layout, GeomHeaderGL3, VPFunction(fisheyeEnabled, logDepthEnabled), gs);
     auto _fs = fmt::format("{}{}{}{}\n", VersionHeaderGL3, CommonHeader, FragmentHeader, fs);
 
     DumpVSSource(_vs);
     DumpGSSource(_gs);
     DumpFSSource(_fs);
 
-    status = GLShaderLoader::CreateProgram(_vs, _gs, _fs, &prog);
-    if (status == GLShaderStatus::OK)
+    GLProgram* prog = createProgram(_vs, _gs, _fs);
+    if (prog == nullptr)
     {
-        BindAttribLocations(prog);
-        status = prog->link();
+        // If the shader creation failed for some reason, substitute the
+        // error shader.
+        if (CreateErrorShader(&prog, fisheyeEnabled) != GLShaderStatus::OK)
+            return nullptr;
     }
 
+    return new CelestiaGLProgram(*prog);
+}
+
+// Compile and link a program from complete sources, or load it from the
+// program cache. An empty gs means there is no geometry shader.
+GLProgram*
+ShaderManager::createProgram(const std::string& vs, const std::string& gs, const std::string& fs)
+{
+    bool useCache = programCache != nullptr && programCache->isEnabled();
+    std::uint64_t key = 0;
+    if (useCache)
+    {
+        key = celestia::engine::ShaderCache::hashSources(vs, gs, fs);
+        if (GLProgram* prog = loadCachedProgram(key); prog != nullptr)
+            return prog;
+    }
+
+    GLProgram* prog = nullptr;
+    GLShaderStatus status = gs.empty()
+        ? GLShaderLoader::CreateProgram(vs, fs, &prog)
+        : GLShaderLoader::CreateProgram(vs, gs, fs, &prog);
     if (status != GLShaderStatus::OK)
+        return nullptr;
+
+    BindAttribLocations(prog);
+    if (useCache)
+        glProgramParameteri(prog->getID(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    if (prog->link() != GLShaderStatus::OK)
     {
-        // If the shader creation failed for some reason, substitute the
-        // error shader.
+        delete prog;
+        return nullptr;
+    }
+
+    if (useCache)
+        programCache->store(key, *prog);
+
+    return prog;
+}
+
+GLProgram*
+ShaderManager::loadCachedProgram(std::uint64_t key)
+{
+    auto binary = programCache->load(key);
+    if (!binary.has_value())
+        return nullptr;
+
+    GLProgram* prog = nullptr;
+    if (GLShaderLoader::CreateProgram(binary->format,
+                                      binary->data.data(),
+                                      static_cast<GLsizei>(binary->data.size()),
+                                      &prog) == GLShaderStatus::OK)
+    {
+        return prog;
+    }
+
+    // The driver rejected the binary, rebuild it from the sources
+    programCache->remove(key);
+    return nullptr;
+}
+
+void
+ShaderManager::precompile(const ShaderProperties& props)
+{
+    if (dynamicShaders.find(props) == dynamicShaders.end() &&
+        pendingPrograms.find(props) == pendingPrograms.end())
+    {
+        precompileQueue.push_back(props);
+    }
+}
+
+void
+ShaderManager::updatePrecompilation()
+{
+    // Pick up programs that finished linking in the background
+    for (auto it = pendingPrograms.begin(); it != pendingPrograms.end();)
+    {
+        if (it->second.program->isLinkComplete())
+        {
+            dynamicShaders[it->first] = finishProgram(it->first, it->second);
+            it = pendingPrograms.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // Generating the sources and submitting them takes CPU time even if the
+    // driver compiles in the background, so only spend a bit of each frame
+    auto start = std::chrono::steady_clock::now();
+    while (!precompileQueue.empty() && pendingPrograms.size() < MaxPendingPrograms)
+    {
+        ShaderProperties props = precompileQueue.front();
+        precompileQueue.pop_front();
+
+        // The program may have been needed before it was precompiled, or
+        // queued twice
+        if (dynamicShaders.find(props) == dynamicShaders.end() &&
+            pendingPrograms.find(props) == pendingPrograms.end())
+        {
+            startProgram(props);
+        }
+
+        if (std::chrono::steady_clock::now() - start > PrecompileFrameBudget)
+            break;
+    }
+}
+
+void
+ShaderManager::startProgram(const ShaderProperties& props)
+{
+    std::string vs;
+    std::string fs;
+    buildSources(props, vs, fs);
+
+    bool useCache = programCache != nullptr && programCache->isEnabled();
+    std::uint64_t key = 0;
+    if (useCache)
+    {
+        key = celestia::engine::ShaderCache::hashSources(vs, {}, fs);
+        if (GLProgram* prog = loadCachedProgram(key); prog != nullptr)
+        {
+            dynamicShaders[props] = new CelestiaGLProgram(*prog, props);
+            return;
+        }
+    }
+
+    // Without parallel compilation, this is no different from building the
+    // program on demand, just earlier
+    if (!gl::KHR_parallel_shader_compile)
+    {
+        dynamicShaders[props] = buildProgram(props);
+        return;
+    }
+
+    GLProgram* prog = nullptr;
+    GLShaderLoader::CreateDeferredProgram(vs, fs, &prog);
+    BindAttribLocations(prog);
+    if (useCache)
+        glProgramParameteri(prog->getID(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    prog->startLink();
+    pendingPrograms.try_emplace(props, PendingProgram{ prog, useCache, key });
+}
+
+CelestiaGLProgram*
+ShaderManager::finishProgram(const ShaderProperties& props, const PendingProgram& pending)
+{
+    GLProgram* prog = pending.program;
+    if (prog->getLinkStatus() == GLShaderStatus::OK)
+    {
+        if (pending.useCache)
+            programCache->store(pending.cacheKey, *prog);
+    }
+    else
+    {
+        delete prog;
         if (CreateErrorShader(&prog, fisheyeEnabled) != GLShaderStatus::OK)
             return nullptr;
     }
 
-    return new CelestiaGLProgram(*prog);
+    return new CelestiaGLProgram(*prog, props);
+}
+
+void
+ShaderManager::setCacheDirectory(const fs::path& directory)
+{
+    if (directory.empty())
+        programCache = nullptr;
+    else
+        programCache = std::make_unique<celestia::engine::ShaderCache>(directory);
 }
 
 void ShaderManager::setFisheyeEnabled(bool enabled)
@@ -2757,6 +3053,11 @@ void ShaderManager::setFisheyeEnabled(bool enabled)
     fisheyeEnabled = enabled;
 }
 
+void ShaderManager::setLogarithmicDepthEnabled(bool enabled)
+{
+    logDepthEnabled = enabled;
+}
+
 CelestiaGLProgram::CelestiaGLProgram(GLProgram& _program,
                                      const ShaderProperties& _props) :
     program(&_program),
@@ -2846,6 +3147,7 @@ CelestiaGLProgram::initCommonParameters()
     ModelViewMatrix = mat4Param("ModelViewMatrix");
     ProjectionMatrix = mat4Param("ProjectionMatrix");
     MVPMatrix = mat4Param("MVPMatrix");
+    logDepthCoefficient = floatParam("logDepthCoefficient");
     lineWidthX = floatParam("lineWidthX");
     lineWidthY = floatParam("lineWidthY");
 }
@@ -2865,6 +3167,16 @@ CelestiaGLProgram::initParameters()
         if (props.lightModel == LightingModel::AtmosphereModel || props.hasScattering())
             lights[i].color = vec3Param(LightProperty(i, "color").c_str());
 
+        if (props.isInstanced())
+        {
+            // The direction and half vector come from the instances, and
+            // their color scales these uniforms
+            lights[i].diffuse    = vec3Param("instanceLight0_diffuse");
+            lights[i].specular   = vec3Param("instanceLight0_specular");
+            if (util::is_set(props.texUsage, TexUsage::NightTexture))
+                lights[i].brightness = floatParam("instanceLight0_brightness");
+        }
+
         if (props.hasRingShadowForLight(i))
             ringShadowLOD[i] = floatParam(IndexedParameter("ringShadowLOD", i).c_str());
         for (unsigned int j = 0; j < props.getEclipseShadowCountForLight(i); j++)
@@ -2894,7 +3206,7 @@ CelestiaGLProgram::initParameters()
         shininess            = floatParam("shininess");
     }
 
-    if (props.isViewDependent() || props.hasScattering())
+    if ((props.isViewDependent() || props.hasScattering()) && !props.isInstanced())
     {
         eyePosition          = vec3Param("eyePosition");
     }
@@ -3191,4 +3503,5 @@ CelestiaGLProgram::setMVPMatrices(const Eigen::Matrix4f& p, const Eigen::Matrix4
     ProjectionMatrix = p;
     ModelViewMatrix = m;
     MVPMatrix = p * m;
+    logDepthCoefficient = p(3, 3) == 0.0f ? LogDepthCoefficient : 0.0f;
 }
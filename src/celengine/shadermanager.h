@@ -10,13 +10,18 @@
 #pragma once
 
 #include <array>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <map>
+#include <memory>
 #include <string>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
+#include <celcompat/filesystem.h>
 #include <celutil/color.h>
 #include <celutil/flag.h>
 #include <celengine/glshader.h>
@@ -24,6 +29,19 @@
 class Atmosphere;
 class LightingState;
 
+namespace celestia::engine
+{
+class ShaderCache;
+}
+
+// Logarithmic depth maps camera distances up to this many kilometers into
+// the depth buffer with constant relative precision
+constexpr float LogDepthFarDistance = 1.0e18f;
+
+// Normalized device z of a point at distance in front of the camera when
+// logarithmic depth is enabled
+float LogDepthNormalizedDeviceZ(float distance);
+
 enum class TexUsage : std::uint32_t
 {
     None                    =       0,
@@ -46,6 +64,8 @@ enum class TexUsage : std::uint32_t
     StaticPointSize         = 0x10000,
     LineAsTriangles         = 0x20000,
     TextureCoordTransform   = 0x40000,
+    InstancedTransform      = 0x80000,
+    LineQuadInstances       = 0x100000,
 };
 
 ENUM_CLASS_BITWISE_OPS(TexUsage);
@@ -107,6 +127,7 @@ class ShaderProperties
     bool hasShadowsForLight(unsigned int) const;
     bool hasSharedTextureCoords() const;
     bool hasTextureCoordTransform() const;
+    bool isInstanced() const;
     bool hasSpecular() const;
     bool hasScattering() const;
     bool isViewDependent() const;
@@ -150,6 +171,8 @@ public:
 constexpr inline unsigned int MaxShaderLights = 4;
 constexpr inline unsigned int MaxShaderEclipseShadows = 3;
 
+bool operator<(const ShaderProperties&, const ShaderProperties&);
+
 struct CelestiaGLProgramLight
 {
     Vec3ShaderParameter direction;
@@ -209,6 +232,11 @@ public:
         IntensityAttributeIndex     = 9,
         NextVCoordAttributeIndex    = 10,
         ScaleFactorAttributeIndex   = 11,
+        // Replaces the scale factor in wide lines drawn as instanced quads
+        LineCornerAttributeIndex    = 11,
+        // Rows of the per instance model view matrix take three locations
+        InstanceTransformAttributeIndex = 12,
+        InstanceLightAttributeIndex     = 15,
     };
 
     CelestiaGLProgramLight lights[MaxShaderLights];
@@ -295,6 +323,10 @@ public:
     Mat4ShaderParameter ProjectionMatrix;
     Mat4ShaderParameter MVPMatrix;
 
+    // Scale for logarithmic depth, set by setMVPMatrices; zero for
+    // orthographic projections, which keep linear depth
+    FloatShaderParameter logDepthCoefficient;
+
     int attribIndex(const char*) const;
 
 private:
@@ -326,6 +358,18 @@ public:
     CelestiaGLProgram* getShaderGL3(std::string_view, std::string_view, std::string_view, std::string_view);
 
     void setFisheyeEnabled(bool enabled);
+    void setLogarithmicDepthEnabled(bool enabled);
+
+    // Cache linked program binaries in this directory, an empty path
+    // disables the cache
+    void setCacheDirectory(const fs::path& directory);
+
+    // Queue a program to be built ahead of its first use. The queue is
+    // worked off by updatePrecompilation(), which the renderer calls once
+    // per frame; with GL_KHR_parallel_shader_compile the driver compiles the
+    // programs on its own threads.
+    void precompile(const ShaderProperties&);
+    void updatePrecompilation();
 
 private:
     CelestiaGLProgram* buildProgram(const ShaderProperties&);
@@ -333,23 +377,47 @@ private:
     CelestiaGLProgram* buildProgramGL3(std::string_view, std::string_view);
     CelestiaGLProgram* buildProgramGL3(std::string_view, std::string_view, std::string_view, const GeomShaderParams* = nullptr);
 
-    GLVertexShader* buildVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildFragmentShader(const ShaderProperties&);
+    struct PendingProgram
+    {
+        GLProgram* program;
+        bool useCache;
+        std::uint64_t cacheKey;
+    };
+
+    // Limits on the number of programs linked in the background at once and
+    // on the time spent submitting them each frame
+    static constexpr std::size_t MaxPendingPrograms = 16;
+    static constexpr std::chrono::milliseconds PrecompileFrameBudget{ 2 };
+
+    void buildSources(const ShaderProperties&, std::string&, std::string&);
+    GLProgram* createProgram(const std::string&, const std::string&, const std::string&);
+    GLProgram* loadCachedProgram(std::uint64_t);
+    void startProgram(const ShaderProperties&);
+    CelestiaGLProgram* finishProgram(const ShaderProperties&, const PendingProgram&);
 
-    GLVertexShader* buildRingsVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildRingsFragmentShader(const ShaderProperties&);
+    std::string buildVertexShader(const ShaderProperties&);
+    std::string buildFragmentShader(const ShaderProperties&);
 
-    GLVertexShader* buildAtmosphereVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildAtmosphereFragmentShader(const ShaderProperties&);
+    std::string buildRingsVertexShader(const ShaderProperties&);
+    std::string buildRingsFragmentShader(const ShaderProperties&);
 
-    GLVertexShader* buildEmissiveVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildEmissiveFragmentShader(const ShaderProperties&);
+    std::string buildAtmosphereVertexShader(const ShaderProperties&);
+    std::string buildAtmosphereFragmentShader(const ShaderProperties&);
 
-    GLVertexShader* buildParticleVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildParticleFragmentShader(const ShaderProperties&);
+    std::string buildEmissiveVertexShader(const ShaderProperties&);
+    std::string buildEmissiveFragmentShader(const ShaderProperties&);
+
+    std::string buildParticleVertexShader(const ShaderProperties&);
+    std::string buildParticleFragmentShader(const ShaderProperties&);
 
     std::map<ShaderProperties, CelestiaGLProgram*> dynamicShaders;
     std::map<std::string_view, CelestiaGLProgram*> staticShaders;
 
+    std::deque<ShaderProperties> precompileQueue;
+    std::map<ShaderProperties, PendingProgram> pendingPrograms;
+
     bool fisheyeEnabled { false };
+    bool logDepthEnabled { false };
+
+    std::unique_ptr<celestia::engine::ShaderCache> programCache;
 };
@@ -16,6 +16,7 @@
 #include <cstddef>
 
 #include <celutil/strnatcmp.h>
+#include <celutil/trace.h>
 #include "body.h"
 #include "location.h"
 #include "render.h"
@@ -106,13 +107,21 @@ double Simulation::getArrivalTime() const
 // Tick the simulation by dt seconds
 void Simulation::update(double dt)
 {
+    celestia::util::TraceScope trace("Simulation::update");
+
     realTime += dt;
 
+    // Scripts and the previous frame may have moved things around
+    Body::invalidateStateCaches();
+
     for (const auto observer : observers)
     {
         observer->update(dt, timeScale);
     }
 
+    if (StarDatabase* stardb = universe->getStarCatalog(); stardb != nullptr)
+        stardb->updateStarMotion(getTime());
+
     // Reset nearest solar system
     closestSolarSystem = std::nullopt;
 }
@@ -144,10 +153,21 @@ void Simulation::setTrackedObject(const Selection& sel)
 
 Selection Simulation::pickObject(const Eigen::Vector3f& pickRay,
                                  std::uint64_t renderFlags,
-                                 float tolerance)
+                                 float tolerance,
+                                 celestia::util::array_view<RenderListEntry> rendered)
 {
+    Eigen::Vector3f direction = activeObserver->getOrientationf().conjugate() * pickRay;
+    if (!rendered.empty())
+    {
+        if (Selection sel = universe->pickRendered(rendered, direction, activeObserver->getTime(), tolerance);
+            !sel.empty())
+        {
+            return sel;
+        }
+    }
+
     return universe->pick(activeObserver->getPosition(),
-                          activeObserver->getOrientationf().conjugate() * pickRay,
+                          direction,
                           activeObserver->getTime(),
                           renderFlags,
                           faintestVisible,
@@ -46,7 +46,12 @@ class Simulation
     void render(Renderer&);
     void render(Renderer&, Observer&);
 
-    Selection pickObject(const Eigen::Vector3f& pickRay, std::uint64_t renderFlags, float tolerance = 0.0f);
+    // The objects of the active observer's last frame, in its render list,
+    // are tested first, the catalogs only if the ray misses all of them
+    Selection pickObject(const Eigen::Vector3f& pickRay,
+                         std::uint64_t renderFlags,
+                         float tolerance = 0.0f,
+                         celestia::util::array_view<RenderListEntry> rendered = {});
 
     Universe* getUniverse() const;
 
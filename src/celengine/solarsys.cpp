@@ -13,6 +13,7 @@
 #include <cassert>
 #include <cstddef>
 #include <cstring>
+#include <fstream>
 #include <istream>
 #include <limits>
 #include <memory>
@@ -42,6 +43,8 @@
 #include "parseobject.h"
 #include "parser.h"
 #include "solarsys.h"
+#include "ssccache.h"
+#include "stagedcatalog.h"
 #include "surface.h"
 #include "texmanager.h"
 #include "universe.h"
@@ -52,6 +55,8 @@ using std::size_t;
 using std::strncmp;
 using namespace std::string_view_literals;
 
+using celestia::engine::SolarSystemCache;
+using celestia::engine::SolarSystemEntry;
 using celestia::util::GetLogger;
 namespace engine = celestia::engine;
 namespace ephem = celestia::ephem;
@@ -103,11 +108,17 @@ enum BodyType
   The name and parent name are both mandatory.
 */
 
-void sscError(const Tokenizer& tok,
+void sscError(int lineNumber,
               const std::string& msg)
 {
     GetLogger()->error(_("Error in .ssc file (line {}): {}\n"),
-                      tok.getLineNumber(), msg);
+                      lineNumber, msg);
+}
+
+void sscError(const Tokenizer& tok,
+              const std::string& msg)
+{
+    sscError(tok.getLineNumber(), msg);
 }
 
 // Object class properties
@@ -686,7 +697,7 @@ ReadMesh(const Hash& planetData, Body& body, const fs::path& path)
         // Some add-ons appear to be using Mesh "" to switch off the geometry
         if (!mesh->empty())
             GetLogger()->error("Invalid filename in Mesh\n");
-        geometryHandle = GetGeometryManager()->getHandle(GeometryInfo({}));
+        geometryHandle = engine::GetEmptyGeometryHandle();
     }
 
     body.setGeometry(geometryHandle);
@@ -1102,196 +1113,248 @@ Body* CreateReferencePoint(const std::string& name,
 
     return body;
 }
-} // end unnamed namespace
 
-bool LoadSolarSystemObjects(std::istream& in,
-                            Universe& universe,
-                            const fs::path& directory)
-{
-    Tokenizer tokenizer(&in);
-    Parser parser(&tokenizer);
-
-#ifdef ENABLE_NLS
-    std::string s = directory.string();
-    const char* d = s.c_str();
-    bindtextdomain(d, d); // domain name is the same as resource path
-#endif
 
-    while (tokenizer.nextToken() != Tokenizer::TokenEnd)
+// Reads the next object definition, with the tokenizer on its first token
+bool ReadSolarSystemEntry(Tokenizer& tokenizer, Parser& parser, SolarSystemEntry& entry)
+{
+    // Read the disposition; if none is specified, the default is Add.
+    entry.disposition = DataDisposition::Add;
+    if (auto tokenValue = tokenizer.getNameValue(); tokenValue.has_value())
     {
-        // Read the disposition; if none is specified, the default is Add.
-        DataDisposition disposition = DataDisposition::Add;
-        if (auto tokenValue = tokenizer.getNameValue(); tokenValue.has_value())
+        if (*tokenValue == "Add")
         {
-            if (*tokenValue == "Add")
-            {
-                disposition = DataDisposition::Add;
-                tokenizer.nextToken();
-            }
-            else if (*tokenValue == "Replace")
-            {
-                disposition = DataDisposition::Replace;
-                tokenizer.nextToken();
-            }
-            else if (*tokenValue == "Modify")
-            {
-                disposition = DataDisposition::Modify;
-                tokenizer.nextToken();
-            }
-        }
-
-        // Read the item type; if none is specified the default is Body
-        std::string itemType("Body");
-        if (auto tokenValue = tokenizer.getNameValue(); tokenValue.has_value())
-        {
-            itemType = *tokenValue;
+            entry.disposition = DataDisposition::Add;
             tokenizer.nextToken();
         }
-
-        // The name list is a string with zero more names. Multiple names are
-        // delimited by colons.
-        std::string nameList;
-        if (auto tokenValue = tokenizer.getStringValue(); tokenValue.has_value())
+        else if (*tokenValue == "Replace")
         {
-            nameList = *tokenValue;
+            entry.disposition = DataDisposition::Replace;
+            tokenizer.nextToken();
         }
-        else
+        else if (*tokenValue == "Modify")
         {
-            sscError(tokenizer, "object name expected");
-            return false;
+            entry.disposition = DataDisposition::Modify;
+            tokenizer.nextToken();
         }
+    }
 
+    // Read the item type; if none is specified the default is Body
+    entry.itemType = "Body";
+    if (auto tokenValue = tokenizer.getNameValue(); tokenValue.has_value())
+    {
+        entry.itemType = *tokenValue;
         tokenizer.nextToken();
-        std::string parentName;
-        if (auto tokenValue = tokenizer.getStringValue(); tokenValue.has_value())
-        {
-            parentName = *tokenValue;
-        }
-        else
-        {
-            sscError(tokenizer, "bad parent object name");
-            return false;
-        }
+    }
+
+    // The name list is a string with zero more names. Multiple names are
+    // delimited by colons.
+    if (auto tokenValue = tokenizer.getStringValue(); tokenValue.has_value())
+    {
+        entry.nameList = *tokenValue;
+    }
+    else
+    {
+        sscError(tokenizer, "object name expected");
+        return false;
+    }
+
+    tokenizer.nextToken();
+    if (auto tokenValue = tokenizer.getStringValue(); tokenValue.has_value())
+    {
+        entry.parentName = *tokenValue;
+    }
+    else
+    {
+        sscError(tokenizer, "bad parent object name");
+        return false;
+    }
+
+    entry.objectData = parser.readValue();
+    if (entry.objectData.getHash() == nullptr)
+    {
+        sscError(tokenizer, "{ expected");
+        return false;
+    }
 
-        const Value objectDataValue = parser.readValue();
-        const Hash* objectData = objectDataValue.getHash();
-        if (objectData == nullptr)
+    entry.lineNumber = tokenizer.getLineNumber();
+    return true;
+}
+
+void AddSolarSystemEntry(const SolarSystemEntry& entry,
+                         Universe& universe,
+                         const fs::path& directory)
+{
+    const std::string& itemType = entry.itemType;
+    const std::string& nameList = entry.nameList;
+    const std::string& parentName = entry.parentName;
+    DataDisposition disposition = entry.disposition;
+    const Hash* objectData = entry.objectData.getHash();
+
+    Selection parent = universe.findPath(parentName, {});
+    PlanetarySystem* parentSystem = nullptr;
+
+    std::vector<std::string> names;
+    // Iterate through the string for names delimited
+    // by ':', and insert them into the name list.
+    if (nameList.empty())
+    {
+        names.push_back("");
+    }
+    else
+    {
+        std::string::size_type startPos   = 0;
+        while (startPos != std::string::npos)
         {
-            sscError(tokenizer, "{ expected");
-            return false;
+            std::string::size_type next   = nameList.find(':', startPos);
+            std::string::size_type length = std::string::npos;
+            if (next != std::string::npos)
+            {
+                length = next - startPos;
+                ++next;
+            }
+            names.push_back(nameList.substr(startPos, length));
+            startPos   = next;
         }
+    }
+    std::string primaryName = names.front();
 
-        Selection parent = universe.findPath(parentName, {});
-        PlanetarySystem* parentSystem = nullptr;
+    BodyType bodyType = UnknownBodyType;
+    if (itemType == "Body")
+        bodyType = NormalBody;
+    else if (itemType == "ReferencePoint")
+        bodyType = ReferencePoint;
+    else if (itemType == "SurfaceObject")
+        bodyType = SurfaceObject;
 
-        std::vector<std::string> names;
-        // Iterate through the string for names delimited
-        // by ':', and insert them into the name list.
-        if (nameList.empty())
+    if (bodyType != UnknownBodyType)
+    {
+        //bool orbitsPlanet = false;
+        if (parent.star() != nullptr)
+        {
+            const SolarSystem* solarSystem = universe.getOrCreateSolarSystem(parent.star());
+            parentSystem = solarSystem->getPlanets();
+        }
+        else if (parent.body() != nullptr)
         {
-            names.push_back("");
+            // Parent is a planet or moon
+            parentSystem = parent.body()->getOrCreateSatellites();
         }
         else
         {
-            std::string::size_type startPos   = 0;
-            while (startPos != std::string::npos)
-            {
-                std::string::size_type next   = nameList.find(':', startPos);
-                std::string::size_type length = std::string::npos;
-                if (next != std::string::npos)
-                {
-                    length = next - startPos;
-                    ++next;
-                }
-                names.push_back(nameList.substr(startPos, length));
-                startPos   = next;
-            }
+            sscError(entry.lineNumber, fmt::sprintf(_("parent body '%s' of '%s' not found.\n"), parentName, primaryName));
         }
-        std::string primaryName = names.front();
 
-        BodyType bodyType = UnknownBodyType;
-        if (itemType == "Body")
-            bodyType = NormalBody;
-        else if (itemType == "ReferencePoint")
-            bodyType = ReferencePoint;
-        else if (itemType == "SurfaceObject")
-            bodyType = SurfaceObject;
-
-        if (bodyType != UnknownBodyType)
+        if (parentSystem != nullptr)
         {
-            //bool orbitsPlanet = false;
-            if (parent.star() != nullptr)
+            Body* existingBody = parentSystem->find(primaryName);
+            if (existingBody)
             {
-                const SolarSystem* solarSystem = universe.getOrCreateSolarSystem(parent.star());
-                parentSystem = solarSystem->getPlanets();
-            }
-            else if (parent.body() != nullptr)
-            {
-                // Parent is a planet or moon
-                parentSystem = parent.body()->getOrCreateSatellites();
+                if (disposition == DataDisposition::Add)
+                    sscError(entry.lineNumber, fmt::sprintf(_("warning duplicate definition of %s %s\n"), parentName, primaryName));
+                else if (disposition == DataDisposition::Replace)
+                    existingBody->setDefaultProperties();
             }
+
+            Body* body;
+            if (bodyType == ReferencePoint)
+                body = CreateReferencePoint(primaryName, parentSystem, universe, existingBody, objectData, directory, disposition);
             else
-            {
-                sscError(tokenizer, fmt::sprintf(_("parent body '%s' of '%s' not found.\n"), parentName, primaryName));
-            }
+                body = CreateBody(primaryName, parentSystem, universe, existingBody, objectData, directory, disposition, bodyType);
 
-            if (parentSystem != nullptr)
+            if (body != nullptr)
             {
-                Body* existingBody = parentSystem->find(primaryName);
-                if (existingBody)
-                {
-                    if (disposition == DataDisposition::Add)
-                        sscError(tokenizer, fmt::sprintf(_("warning duplicate definition of %s %s\n"), parentName, primaryName));
-                    else if (disposition == DataDisposition::Replace)
-                        existingBody->setDefaultProperties();
-                }
-
-                Body* body;
-                if (bodyType == ReferencePoint)
-                    body = CreateReferencePoint(primaryName, parentSystem, universe, existingBody, objectData, directory, disposition);
-                else
-                    body = CreateBody(primaryName, parentSystem, universe, existingBody, objectData, directory, disposition, bodyType);
-
-                if (body != nullptr)
-                {
-                    UserCategory::loadCategories(body, *objectData, disposition, directory.string());
-                    if (disposition == DataDisposition::Add)
-                        for (const auto& name : names)
-                            body->addAlias(name);
-                }
+                UserCategory::loadCategories(body, *objectData, disposition, directory.string());
+                if (disposition == DataDisposition::Add)
+                    for (const auto& name : names)
+                        body->addAlias(name);
             }
         }
-        else if (itemType == "AltSurface")
-        {
-            auto surface = std::make_unique<Surface>();
-            surface->color = Color(1.0f, 1.0f, 1.0f);
-            FillinSurface(objectData, surface.get(), directory);
-            if (parent.body() != nullptr)
-                GetBodyFeaturesManager()->addAlternateSurface(parent.body(), primaryName, std::move(surface));
-            else
-                sscError(tokenizer, _("bad alternate surface"));
-        }
-        else if (itemType == "Location")
+    }
+    else if (itemType == "AltSurface")
+    {
+        auto surface = std::make_unique<Surface>();
+        surface->color = Color(1.0f, 1.0f, 1.0f);
+        FillinSurface(objectData, surface.get(), directory);
+        if (parent.body() != nullptr)
+            GetBodyFeaturesManager()->addAlternateSurface(parent.body(), primaryName, std::move(surface));
+        else
+            sscError(entry.lineNumber, _("bad alternate surface"));
+    }
+    else if (itemType == "Location")
+    {
+        if (parent.body() != nullptr)
         {
-            if (parent.body() != nullptr)
+            std::unique_ptr<Location> location = CreateLocation(objectData, parent.body());
+            if (location != nullptr)
             {
-                std::unique_ptr<Location> location = CreateLocation(objectData, parent.body());
-                if (location != nullptr)
-                {
-                    UserCategory::loadCategories(location.get(), *objectData, disposition, directory.string());
-                    location->setName(primaryName);
-                    GetBodyFeaturesManager()->addLocation(parent.body(), std::move(location));
-                }
-                else
-                {
-                    sscError(tokenizer, _("bad location"));
-                }
+                UserCategory::loadCategories(location.get(), *objectData, disposition, directory.string());
+                location->setName(primaryName);
+                GetBodyFeaturesManager()->addLocation(parent.body(), std::move(location));
             }
             else
             {
-                sscError(tokenizer, fmt::sprintf(_("parent body '%s' of '%s' not found.\n"), parentName, primaryName));
+                sscError(entry.lineNumber, _("bad location"));
             }
         }
+        else
+        {
+            sscError(entry.lineNumber, fmt::sprintf(_("parent body '%s' of '%s' not found.\n"), parentName, primaryName));
+        }
+    }
+}
+
+void BindCatalogTextDomain([[maybe_unused]] const fs::path& directory)
+{
+#ifdef ENABLE_NLS
+    std::string s = directory.string();
+    const char* d = s.c_str();
+    bindtextdomain(d, d); // domain name is the same as resource path
+#endif
+}
+
+class StagedSolarSystemCatalog : public engine::StagedCatalog
+{
+public:
+    StagedSolarSystemCatalog(Universe& _universe, const fs::path& _directory) :
+        universe(_universe), directory(_directory)
+    {
+    }
+
+    bool commit() override
+    {
+        BindCatalogTextDomain(directory);
+        for (const SolarSystemEntry& entry : entries)
+            AddSolarSystemEntry(entry, universe, directory);
+        return !failed;
+    }
+
+    std::vector<SolarSystemEntry> entries;
+    bool failed{ false };
+
+private:
+    Universe& universe;
+    fs::path directory;
+};
+
+} // end unnamed namespace
+
+
+bool LoadSolarSystemObjects(std::istream& in,
+                            Universe& universe,
+                            const fs::path& directory)
+{
+    Tokenizer tokenizer(&in);
+    Parser parser(&tokenizer);
+
+    BindCatalogTextDomain(directory);
+
+    while (tokenizer.nextToken() != Tokenizer::TokenEnd)
+    {
+        SolarSystemEntry entry;
+        if (!ReadSolarSystemEntry(tokenizer, parser, entry))
+            return false;
+        AddSolarSystemEntry(entry, universe, directory);
     }
 
     // TODO: Return some notification if there's an error parsing the file
@@ -1299,6 +1362,53 @@ bool LoadSolarSystemObjects(std::istream& in,
 }
 
 
+std::unique_ptr<engine::StagedCatalog>
+StageSolarSystemObjects(const fs::path& filename,
+                        Universe& universe,
+                        const fs::path& directory,
+                        const SolarSystemCache* cache)
+{
+    auto staged = std::make_unique<StagedSolarSystemCatalog>(universe, directory);
+    if (cache != nullptr && cache->load(filename, staged->entries))
+    {
+        GetLogger()->verbose("Using cached definitions of {}\n", filename);
+        return staged;
+    }
+
+    std::ifstream in(filename);
+    if (!in.good())
+        return nullptr;
+
+    Tokenizer tokenizer(&in);
+    Parser parser(&tokenizer);
+
+    while (tokenizer.nextToken() != Tokenizer::TokenEnd)
+    {
+        // Like a direct load, an error only loses the objects that follow
+        if (!ReadSolarSystemEntry(tokenizer, parser, staged->entries.emplace_back()))
+        {
+            staged->entries.pop_back();
+            staged->failed = true;
+            return staged;
+        }
+    }
+
+    if (cache != nullptr)
+        cache->store(filename, staged->entries);
+    return staged;
+}
+
+
+bool LoadSolarSystemObjects(const fs::path& filename,
+                            Universe& universe,
+                            const fs::path& directory,
+                            const SolarSystemCache* cache)
+{
+    auto staged = StageSolarSystemObjects(filename, universe, directory, cache);
+    return staged != nullptr && staged->commit();
+}
+
+
 SolarSystem::SolarSystem(Star* _star) :
     star(_star)
 {
@@ -1331,3 +1441,16 @@ FrameTree* SolarSystem::getFrameTree() const
 {
     return frameTree.get();
 }
+
+std::size_t
+GetMemoryUsage(const SolarSystemCatalog& catalog)
+{
+    std::size_t size = 0;
+    for (const auto& [starIndex, solarSystem] : catalog)
+    {
+        size += sizeof(SolarSystem) + 4 * sizeof(void*);
+        size += solarSystem->getPlanets()->getMemoryUsage();
+    }
+
+    return size;
+}
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <iosfwd>
 #include <map>
@@ -24,6 +25,12 @@ class PlanetarySystem;
 class Star;
 class Universe;
 
+namespace celestia::engine
+{
+class SolarSystemCache;
+class StagedCatalog;
+}
+
 class SolarSystem
 {
  public:
@@ -43,6 +50,26 @@ class SolarSystem
 
 using SolarSystemCatalog = std::map<std::uint32_t, std::unique_ptr<SolarSystem>>;
 
+// Bytes of memory used by the solar systems and their bodies, see
+// PlanetarySystem::getMemoryUsage()
+std::size_t GetMemoryUsage(const SolarSystemCatalog&);
+
 bool LoadSolarSystemObjects(std::istream& in,
                             Universe& universe,
                             const fs::path& dir = fs::path());
+
+// Loads the catalog from the cache if it has an up to date copy, otherwise
+// parses the file and stores the result in the cache; cache may be nullptr.
+bool LoadSolarSystemObjects(const fs::path& filename,
+                            Universe& universe,
+                            const fs::path& dir,
+                            const celestia::engine::SolarSystemCache* cache);
+
+// Reads the catalog as LoadSolarSystemObjects does, without changing the
+// universe until the result is committed. Returns nullptr if the file
+// can't be opened.
+std::unique_ptr<celestia::engine::StagedCatalog>
+StageSolarSystemObjects(const fs::path& filename,
+                        Universe& universe,
+                        const fs::path& dir,
+                        const celestia::engine::SolarSystemCache* cache);
@@ -0,0 +1,429 @@
+// ssccache.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// On-disk cache of parsed solar system catalogs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "ssccache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/logger.h>
+#include <celutil/mappedfile.h>
+#include "hash.h"
+
+using namespace std::string_view_literals;
+using celestia::util::GetLogger;
+
+namespace celestia::engine
+{
+namespace
+{
+
+// Bump kCacheVersion whenever the file layout or the parser changes
+constexpr std::string_view kCacheMagic = "CELSSC\0\0"sv;
+constexpr std::uint16_t kCacheVersion = 1;
+
+constexpr std::string_view kCacheExtension = ".sscbin"sv;
+
+// Deeper nesting than any catalog uses means the file is damaged
+constexpr int kMaxDepth = 64;
+
+#pragma pack(push, 1)
+struct CacheHeader
+{
+    char          magic[8]; //NOSONAR
+    std::uint16_t version;
+    std::uint16_t reserved;
+    std::uint32_t entryCount;
+    std::uint64_t sourceSize;
+    std::int64_t  sourceTime;
+    std::uint64_t sourceHash;
+};
+#pragma pack(pop)
+
+static_assert(std::is_standard_layout_v<CacheHeader>);
+
+constexpr std::uint64_t kFNVOffsetBasis = UINT64_C(0xcbf29ce484222325);
+
+// 64-bit FNV-1a
+std::uint64_t
+hashBytes(std::uint64_t hash, std::string_view s)
+{
+    for (char c : s)
+        hash = (hash ^ static_cast<std::uint8_t>(c)) * UINT64_C(0x100000001b3);
+    return hash;
+}
+
+struct SourceStamp
+{
+    std::uint64_t size{ 0 };
+    std::int64_t time{ 0 };
+    std::uint64_t hash{ 0 };
+};
+
+bool
+getSourceStamp(const fs::path& source, SourceStamp& stamp)
+{
+    std::error_code ec;
+    auto time = fs::last_write_time(source, ec);
+    if (ec)
+        return false;
+
+    auto file = util::MappedFile::open(source);
+    if (file == nullptr)
+        return false;
+
+    stamp.size = file->size();
+    stamp.time = static_cast<std::int64_t>(time.time_since_epoch().count());
+    stamp.hash = hashBytes(kFNVOffsetBasis, std::string_view(file->data(), file->size()));
+    return true;
+}
+
+// Reads a cache file, failing on anything that runs past its end
+class CacheReader
+{
+public:
+    CacheReader(const char* data, std::size_t size) : m_ptr(data), m_end(data + size) {}
+
+    template<typename T>
+    bool read(T& value)
+    {
+        if (static_cast<std::size_t>(m_end - m_ptr) < sizeof(T))
+            return false;
+        value = util::fromMemoryLE<T>(m_ptr);
+        m_ptr += sizeof(T);
+        return true;
+    }
+
+    bool read(std::string& value)
+    {
+        std::uint32_t length;
+        if (!read(length) || static_cast<std::size_t>(m_end - m_ptr) < length)
+            return false;
+        value.assign(m_ptr, length);
+        m_ptr += length;
+        return true;
+    }
+
+    bool read(Value& value, int depth = 0);
+
+private:
+    const char* m_ptr;
+    const char* m_end;
+};
+
+bool
+CacheReader::read(Value& value, int depth)
+{
+    std::uint8_t type;
+    std::uint8_t length;
+    std::uint8_t time;
+    std::uint8_t angle;
+    std::uint8_t mass;
+    if (depth > kMaxDepth || !read(type) || !read(length) || !read(time) || !read(angle) || !read(mass))
+        return false;
+
+    Value::Units units;
+    units.length = static_cast<astro::LengthUnit>(length);
+    units.time = static_cast<astro::TimeUnit>(time);
+    units.angle = static_cast<astro::AngleUnit>(angle);
+    units.mass = static_cast<astro::MassUnit>(mass);
+
+    switch (static_cast<ValueType>(type))
+    {
+    case ValueType::NullType:
+        value = Value();
+        break;
+
+    case ValueType::NumberType:
+        {
+            double d;
+            if (!read(d))
+                return false;
+            value = Value(d);
+        }
+        break;
+
+    case ValueType::StringType:
+        {
+            std::string s;
+            if (!read(s))
+                return false;
+            value = Value(std::move(s));
+        }
+        break;
+
+    case ValueType::BooleanType:
+        {
+            std::uint8_t b;
+            if (!read(b))
+                return false;
+            value = Value(b != 0);
+        }
+        break;
+
+    case ValueType::ArrayType:
+        {
+            std::uint32_t count;
+            if (!read(count) || count > static_cast<std::size_t>(m_end - m_ptr))
+                return false;
+            auto array = std::make_unique<ValueArray>();
+            array->reserve(count);
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                if (!read(array->emplace_back(), depth + 1))
+                    return false;
+            }
+            value = Value(std::move(array));
+        }
+        break;
+
+    case ValueType::HashType:
+        {
+            std::uint32_t count;
+            if (!read(count))
+                return false;
+            auto hash = std::make_unique<Hash>();
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                std::string key;
+                Value item;
+                if (!read(key) || !read(item, depth + 1))
+                    return false;
+                hash->addValue(std::move(key), std::move(item));
+            }
+            value = Value(std::move(hash));
+        }
+        break;
+
+    default:
+        return false;
+    }
+
+    value.setUnits(units);
+    return true;
+}
+
+bool
+writeString(std::ostream& out, const std::string& s)
+{
+    return util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(s.size())) &&
+           out.write(s.data(), static_cast<std::streamsize>(s.size())).good();
+}
+
+bool
+writeValue(std::ostream& out, const Value& value)
+{
+    bool ok = util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(value.getType())) &&
+              util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(value.getLengthUnit())) &&
+              util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(value.getTimeUnit())) &&
+              util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(value.getAngleUnit())) &&
+              util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(value.getMassUnit()));
+    if (!ok)
+        return false;
+
+    switch (value.getType())
+    {
+    case ValueType::NullType:
+        return true;
+
+    case ValueType::NumberType:
+        return util::writeLE<double>(out, *value.getNumber());
+
+    case ValueType::StringType:
+        return writeString(out, *value.getString());
+
+    case ValueType::BooleanType:
+        return util::writeLE<std::uint8_t>(out, *value.getBoolean() ? 1 : 0);
+
+    case ValueType::ArrayType:
+        {
+            const ValueArray* array = value.getArray();
+            if (!util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(array->size())))
+                return false;
+            for (const Value& item : *array)
+            {
+                if (!writeValue(out, item))
+                    return false;
+            }
+            return true;
+        }
+
+    case ValueType::HashType:
+        {
+            const Hash* hash = value.getHash();
+            std::uint32_t count = 0;
+            hash->for_all([&count](const std::string&, const Value&) { ++count; });
+            ok = util::writeLE<std::uint32_t>(out, count);
+            hash->for_all([&](const std::string& key, const Value& item)
+            {
+                ok = ok && writeString(out, key) && writeValue(out, item);
+            });
+            return ok;
+        }
+
+    default:
+        return false;
+    }
+}
+
+} // end unnamed namespace
+
+SolarSystemCache::SolarSystemCache(const fs::path& directory) :
+    m_directory(directory)
+{
+    if (m_directory.empty())
+        return;
+
+    std::error_code ec;
+    fs::create_directories(m_directory, ec);
+    if (ec)
+    {
+        GetLogger()->warn("Failed to create catalog cache directory {}. Catalog cache disabled.\n", m_directory);
+        return;
+    }
+
+    m_enabled = true;
+}
+
+fs::path
+SolarSystemCache::getPath(const fs::path& source) const
+{
+    std::error_code ec;
+    fs::path absolute = fs::absolute(source, ec);
+    std::uint64_t key = hashBytes(kFNVOffsetBasis, (ec ? source : absolute).string());
+    return m_directory / fmt::format("{:016x}{}", key, kCacheExtension);
+}
+
+bool
+SolarSystemCache::load(const fs::path& source, std::vector<SolarSystemEntry>& entries) const
+{
+    if (!m_enabled)
+        return false;
+
+    auto file = util::MappedFile::open(getPath(source));
+    if (file == nullptr || file->size() < sizeof(CacheHeader))
+        return false;
+
+    SourceStamp stamp;
+    const char* data = file->data();
+    if (std::memcmp(data, kCacheMagic.data(), kCacheMagic.size()) != 0 ||
+        util::fromMemoryLE<std::uint16_t>(data + offsetof(CacheHeader, version)) != kCacheVersion ||
+        !getSourceStamp(source, stamp) ||
+        util::fromMemoryLE<std::uint64_t>(data + offsetof(CacheHeader, sourceSize)) != stamp.size ||
+        util::fromMemoryLE<std::int64_t>(data + offsetof(CacheHeader, sourceTime)) != stamp.time ||
+        util::fromMemoryLE<std::uint64_t>(data + offsetof(CacheHeader, sourceHash)) != stamp.hash)
+    {
+        return false;
+    }
+
+    auto entryCount = util::fromMemoryLE<std::uint32_t>(data + offsetof(CacheHeader, entryCount));
+    CacheReader reader(data + sizeof(CacheHeader), file->size() - sizeof(CacheHeader));
+
+    std::vector<SolarSystemEntry> newEntries;
+    newEntries.reserve(std::min<std::size_t>(entryCount, file->size() / 16));
+    for (std::uint32_t i = 0; i < entryCount; ++i)
+    {
+        SolarSystemEntry& entry = newEntries.emplace_back();
+        std::uint8_t disposition;
+        std::int32_t lineNumber;
+        if (!reader.read(disposition) ||
+            disposition > static_cast<std::uint8_t>(DataDisposition::Replace) ||
+            !reader.read(entry.itemType) ||
+            !reader.read(entry.nameList) ||
+            !reader.read(entry.parentName) ||
+            !reader.read(lineNumber) ||
+            !reader.read(entry.objectData) ||
+            entry.objectData.getHash() == nullptr)
+        {
+            GetLogger()->warn("Damaged catalog cache for {}\n", source);
+            return false;
+        }
+
+        entry.disposition = static_cast<DataDisposition>(disposition);
+        entry.lineNumber = lineNumber;
+    }
+
+    entries = std::move(newEntries);
+    return true;
+}
+
+bool
+SolarSystemCache::store(const fs::path& source, const std::vector<SolarSystemEntry>& entries) const
+{
+    if (!m_enabled)
+        return false;
+
+    SourceStamp stamp;
+    if (!getSourceStamp(source, stamp))
+        return false;
+
+    // Write to a temporary file first so that another instance never loads
+    // a partial cache.
+    fs::path cachePath = getPath(source);
+    fs::path tempPath = cachePath;
+    tempPath += ".tmp";
+
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.good())
+            return false;
+
+        out.write(kCacheMagic.data(), kCacheMagic.size());
+        bool ok = util::writeLE<std::uint16_t>(out, kCacheVersion) &&
+                  util::writeLE<std::uint16_t>(out, 0) &&
+                  util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(entries.size())) &&
+                  util::writeLE<std::uint64_t>(out, stamp.size) &&
+                  util::writeLE<std::int64_t>(out, stamp.time) &&
+                  util::writeLE<std::uint64_t>(out, stamp.hash);
+
+        for (const SolarSystemEntry& entry : entries)
+        {
+            ok = ok &&
+                 util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(entry.disposition)) &&
+                 writeString(out, entry.itemType) &&
+                 writeString(out, entry.nameList) &&
+                 writeString(out, entry.parentName) &&
+                 util::writeLE<std::int32_t>(out, static_cast<std::int32_t>(entry.lineNumber)) &&
+                 writeValue(out, entry.objectData);
+        }
+
+        if (!ok || !out.flush().good())
+        {
+            out.close();
+            std::error_code ec;
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tempPath, cachePath, ec);
+    if (ec)
+    {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    return true;
+}
+
+} // end namespace celestia::engine
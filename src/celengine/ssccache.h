@@ -0,0 +1,58 @@
+// ssccache.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// On-disk cache of parsed solar system catalogs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include "parseobject.h"
+#include "value.h"
+
+namespace celestia::engine
+{
+
+// An object definition of an .ssc file as parsed, before it is added to
+// the universe
+struct SolarSystemEntry
+{
+    DataDisposition disposition{ DataDisposition::Add };
+    std::string itemType;
+    std::string nameList;
+    std::string parentName;
+    Value objectData;
+    // Line of the definition for error messages
+    int lineNumber{ 0 };
+};
+
+// Stores the parsed definitions of solar system catalogs so that later
+// runs can skip tokenizing and parsing them. Each catalog is kept in its
+// own file named by a hash of its path. A cached catalog is only used
+// while the source file has the recorded size, modification time and
+// contents hash; otherwise it is parsed again and the cache rewritten.
+class SolarSystemCache
+{
+public:
+    explicit SolarSystemCache(const fs::path& directory);
+
+    bool load(const fs::path& source, std::vector<SolarSystemEntry>& entries) const;
+    bool store(const fs::path& source, const std::vector<SolarSystemEntry>& entries) const;
+
+private:
+    fs::path getPath(const fs::path& source) const;
+
+    fs::path m_directory;
+    bool m_enabled{ false };
+};
+
+} // end namespace celestia::engine
@@ -0,0 +1,32 @@
+// stagedcatalog.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Catalog file read ahead of being added to its database.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+namespace celestia::engine
+{
+
+// The objects of a catalog file, read without touching the database they
+// belong to so that several files can be read at once. They have to be
+// committed in the order the files are loaded in, since later definitions
+// may modify or replace earlier ones.
+class StagedCatalog
+{
+public:
+    virtual ~StagedCatalog() = default;
+
+    // Adds the objects to the database. Returns false if the file had an
+    // error; as when loading it directly, the objects before the error are
+    // added anyway.
+    virtual bool commit() = 0;
+};
+
+} // end namespace celestia::engine
@@ -15,6 +15,9 @@
 #include <cmath>
 #include <cstddef>
 #include <cstring>
+#include <functional>
+#include <iterator>
+#include <string_view>
 
 #include <fmt/format.h>
 
@@ -1071,6 +1074,95 @@ StarDetails::shared() const
     return isShared;
 }
 
+double
+StarDetailsPool::Statistics::hitRatio() const
+{
+    return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+}
+
+void
+StarDetailsPool::intern(boost::intrusive_ptr<StarDetails>& details)
+{
+    if (details == nullptr || details->shared() || details->orbitingStars != nullptr)
+        return;
+
+    ++stats.lookups;
+    std::size_t key = hash(*details);
+    auto [first, last] = entries.equal_range(key);
+    for (auto it = first; it != last; ++it)
+    {
+        if (equal(*it->second, *details))
+        {
+            ++stats.hits;
+            stats.bytesSaved += memoryUsage(*details);
+            details = it->second;
+            return;
+        }
+    }
+
+    details->isShared = true;
+    entries.emplace(key, details);
+    ++stats.entries;
+    stats.bytes += memoryUsage(*details);
+}
+
+std::size_t
+StarDetailsPool::hash(const StarDetails& details)
+{
+    // Based on documentation of boost::hash_combine
+    constexpr std::size_t phi = sizeof(std::size_t) == sizeof(std::uint32_t)
+        ? static_cast<std::size_t>(0x9e3779b9) //NOSONAR
+        : static_cast<std::size_t>(0x9e3779b97f4a7c15); //NOSONAR
+
+    std::size_t seed = std::hash<std::string_view>{}(details.spectralType.data());
+    auto combine = [&seed](std::size_t value) { seed ^= value + phi + (seed << 6) + (seed >> 2); };
+
+    combine(std::hash<float>{}(details.radius));
+    combine(std::hash<float>{}(details.temperature));
+    combine(std::hash<float>{}(details.bolometricCorrection));
+    for (ResourceHandle handle : details.texture.tex)
+        combine(std::hash<ResourceHandle>{}(handle));
+    combine(std::hash<ResourceHandle>{}(details.geometry));
+    combine(std::hash<const ephem::Orbit*>{}(details.orbit.get()));
+    combine(std::hash<const ephem::RotationModel*>{}(details.rotationModel.get()));
+    combine(std::hash<const Star*>{}(details.barycenter));
+    combine(std::hash<std::string>{}(details.infoURL));
+    return seed;
+}
+
+bool
+StarDetailsPool::equal(const StarDetails& a, const StarDetails& b)
+{
+    // Orbits and rotation models are compared by identity, which catches the
+    // common case of several stars using the same cached trajectory.
+    return a.radius == b.radius &&
+           a.temperature == b.temperature &&
+           a.bolometricCorrection == b.bolometricCorrection &&
+           a.knowledge == b.knowledge &&
+           a.visible == b.visible &&
+           a.spectralType == b.spectralType &&
+           std::equal(std::begin(a.texture.tex), std::end(a.texture.tex), std::begin(b.texture.tex)) &&
+           a.geometry == b.geometry &&
+           a.orbit == b.orbit &&
+           a.orbitalRadius == b.orbitalRadius &&
+           a.barycenter == b.barycenter &&
+           a.rotationModel == b.rotationModel &&
+           a.semiAxes == b.semiAxes &&
+           a.infoURL == b.infoURL &&
+           a.orbitingStars == nullptr && b.orbitingStars == nullptr;
+}
+
+std::size_t
+StarDetailsPool::memoryUsage(const StarDetails& details)
+{
+    std::size_t size = sizeof(StarDetails);
+    // Strings short enough for the small buffer optimization use no memory
+    // of their own.
+    if (details.infoURL.capacity() > std::string().capacity())
+        size += details.infoURL.capacity() + 1;
+    return size;
+}
+
 Star::Star(AstroCatalog::IndexNumber _indexNumber, const boost::intrusive_ptr<StarDetails>& _details) :
     indexNumber(_indexNumber),
     details(_details)
@@ -17,6 +17,7 @@
 #include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/smart_ptr/intrusive_ptr.hpp>
@@ -42,6 +43,7 @@ class RotationModel;
 }
 
 class StarDetailsManager;
+class StarDetailsPool;
 
 class StarDetails
 {
@@ -153,10 +155,46 @@ private:
     bool isShared{ true };
 
     friend class StarDetailsManager;
+    friend class StarDetailsPool;
 };
 
 ENUM_CLASS_BITWISE_OPS(StarDetails::Knowledge);
 
+// Deduplicates custom star details with identical contents. Interned details
+// are marked as shared, so modifying them later through the StarDetails
+// setters makes a private copy as for the standard details. Details with
+// orbiting stars are specific to their barycenter and are left alone.
+class StarDetailsPool
+{
+public:
+    struct Statistics
+    {
+        std::size_t lookups{ 0 };
+        std::size_t hits{ 0 };
+        // Number and approximate size of the distinct details in the pool
+        std::size_t entries{ 0 };
+        std::size_t bytes{ 0 };
+        // Approximate size of the duplicates which were released
+        std::size_t bytesSaved{ 0 };
+
+        double hitRatio() const;
+    };
+
+    // Replaces details with an identical object from the pool, or adds it
+    // to the pool if there is none.
+    void intern(boost::intrusive_ptr<StarDetails>& details);
+
+    const Statistics& getStatistics() const { return stats; }
+
+private:
+    static std::size_t hash(const StarDetails&);
+    static bool equal(const StarDetails&, const StarDetails&);
+    static std::size_t memoryUsage(const StarDetails&);
+
+    std::unordered_multimap<std::size_t, boost::intrusive_ptr<StarDetails>> entries;
+    Statistics stats;
+};
+
 inline float
 StarDetails::getRadius() const
 {
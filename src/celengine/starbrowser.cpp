@@ -17,9 +17,15 @@
 #include "starbrowser.h"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
 
+#include <Eigen/Geometry>
+
+#include <celcompat/numbers.h>
+#include <celutil/threadpool.h>
 #include "star.h"
 #include "stardb.h"
 #include "univcoord.h"
@@ -239,57 +245,47 @@ StarFilter::operator()(const Star* star) const
         : true;
 }
 
-template<typename C>
-void populateRecords(std::vector<StarBrowserRecord>& records,
-                     const C& comparison,
-                     const StarFilter& filter,
-                     std::uint32_t size,
-                     const StarDatabase& stardb)
+// Number of stars handled by one task of the parallel scan
+constexpr std::uint32_t ScanChunkSize = 65536;
+
+// Search radii of the nearest star query, in light years. Each try covers
+// four times the radius of the one before; beyond the last one the whole
+// database is scanned instead.
+constexpr float InitialSearchRadius = 10.0f;
+constexpr float MaxSearchRadius = 200000.0f;
+
+// Limiting magnitudes of the brightest star query
+constexpr float InitialSearchMagnitude = 6.0f;
+constexpr float SearchMagnitudeStep = 4.0f;
+constexpr float MaxSearchMagnitude = 30.0f;
+
+// Keeps the size best records of the stars getStar(index) returns for
+// index in [begin, end) which pass the filter, in heap order.
+template<typename C, typename F>
+void selectRecords(std::vector<StarBrowserRecord>& records,
+                   const C& comparison,
+                   const StarFilter& filter,
+                   std::uint32_t size,
+                   std::uint32_t begin,
+                   std::uint32_t end,
+                   F getStar)
 {
-    records.clear();
-    if (size == 0)
-        return;
-
-    records.reserve(size);
-
-    std::uint32_t totalStars = stardb.size();
-    if (totalStars == 0)
-        return;
-
-    records.reserve(size);
-    std::uint32_t index = 0;
+    std::uint32_t index = begin;
 
     // Add all stars that match the filter until we fill up the list
-    for (;;)
+    for (; index < end && records.size() < size; ++index)
     {
-        if (index == totalStars)
-        {
-            std::sort(records.begin(), records.end(), comparison);
-            for (StarBrowserRecord& record : records)
-            {
-                comparison.finalizeRecord(record);
-            }
-            return;
-        }
-
-        if (const Star* star = stardb.getStar(index); filter(star))
-        {
-            if (records.size() == size)
-                break;
-
+        if (const Star* star = getStar(index); filter(star))
             records.push_back(comparison.createRecord(star));
-        }
-
-        ++index;
     }
 
     // We have filled up the number of requested stars, so only add stars that
     // are better than the worst star in the list according to the predicate.
     std::make_heap(records.begin(), records.end(), comparison);
 
-    for (; index < totalStars; ++index)
+    for (; index < end; ++index)
     {
-        const Star* star = stardb.getStar(index);
+        const Star* star = getStar(index);
         if (!filter(star))
             continue;
 
@@ -301,14 +297,184 @@ void populateRecords(std::vector<StarBrowserRecord>& records,
             std::push_heap(records.begin(), records.end(), comparison);
         }
     }
+}
+
+template<typename C>
+void finishRecords(std::vector<StarBrowserRecord>& records,
+                   const C& comparison,
+                   std::uint32_t size)
+{
+    if (records.size() > size)
+    {
+        std::partial_sort(records.begin(), records.begin() + size, records.end(), comparison);
+        records.erase(records.begin() + size, records.end());
+    }
+    else
+    {
+        std::sort(records.begin(), records.end(), comparison);
+    }
 
-    std::sort_heap(records.begin(), records.end(), comparison);
     for (StarBrowserRecord& record : records)
     {
         comparison.finalizeRecord(record);
     }
 }
 
+// Scans the whole database. The stars are split into chunks which are
+// searched in parallel, each keeping its own best records, which are merged
+// at the end.
+template<typename C>
+void populateRecords(std::vector<StarBrowserRecord>& records,
+                     const C& comparison,
+                     const StarFilter& filter,
+                     std::uint32_t size,
+                     const StarDatabase& stardb)
+{
+    records.clear();
+    std::uint32_t totalStars = stardb.size();
+    if (size == 0 || totalStars == 0)
+        return;
+
+    auto getStar = [&stardb](std::uint32_t index) { return stardb.getStar(index); };
+    std::uint32_t nChunks = (totalStars + ScanChunkSize - 1) / ScanChunkSize;
+    if (nChunks == 1)
+    {
+        records.reserve(size);
+        selectRecords(records, comparison, filter, size, 0, totalStars, getStar);
+        finishRecords(records, comparison, size);
+        return;
+    }
+
+    std::vector<std::vector<StarBrowserRecord>> chunkRecords(nChunks);
+    util::ThreadPool::shared().parallelFor(nChunks,
+                                           [&](std::size_t chunk, unsigned int /* worker */)
+                                           {
+                                               auto begin = static_cast<std::uint32_t>(chunk) * ScanChunkSize;
+                                               auto end = std::min(begin + ScanChunkSize, totalStars);
+                                               chunkRecords[chunk].reserve(size);
+                                               selectRecords(chunkRecords[chunk], comparison, filter,
+                                                             size, begin, end, getStar);
+                                           });
+
+    records.reserve(static_cast<std::size_t>(nChunks) * size);
+    for (const auto& chunk : chunkRecords)
+        records.insert(records.end(), chunk.begin(), chunk.end());
+    finishRecords(records, comparison, size);
+}
+
+// Collects the stars found by an octree query
+class StarCollector : public StarHandler
+{
+public:
+    void process(const Star& star, float /* distance */, float /* appMag */) override
+    {
+        stars.push_back(&star);
+    }
+
+    // Stars on the boundary of several queries are found more than once
+    void removeDuplicates()
+    {
+        std::sort(stars.begin(), stars.end());
+        stars.erase(std::unique(stars.begin(), stars.end()), stars.end());
+    }
+
+    std::vector<const Star*> stars;
+};
+
+template<typename C>
+void selectCollected(std::vector<StarBrowserRecord>& records,
+                     const C& comparison,
+                     const StarFilter& filter,
+                     std::uint32_t size,
+                     const StarCollector& collector)
+{
+    records.clear();
+    selectRecords(records, comparison, filter, size,
+                  0, static_cast<std::uint32_t>(collector.stars.size()),
+                  [&collector](std::uint32_t index) { return collector.stars[index]; });
+}
+
+// Finds the nearest stars with queries of the octree for the stars in a
+// sphere around the position, growing the sphere until it contains enough
+// stars which pass the filter. Returns false if the largest sphere isn't
+// enough.
+bool
+populateNearest(std::vector<StarBrowserRecord>& records,
+                const DistanceComparison& comparison,
+                const StarFilter& filter,
+                std::uint32_t size,
+                const StarDatabase& stardb,
+                const Eigen::Vector3f& pos)
+{
+    StarCollector collector;
+    for (float radius = InitialSearchRadius; radius <= MaxSearchRadius; radius *= 4.0f)
+    {
+        collector.stars.clear();
+        stardb.findCloseStars(collector, pos, radius);
+        selectCollected(records, comparison, filter, size, collector);
+
+        // Any star outside the sphere is further away than the worst star
+        // in the list
+        if (records.size() == size && records.front().distance < radius * radius)
+        {
+            finishRecords(records, comparison, size);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Finds the brightest stars with queries of the octree for the stars
+// brighter than a limiting magnitude in all directions, raising the limit
+// until enough stars which pass the filter are found. The nodes of the
+// octree are skipped using the magnitude of their brightest stars. Returns
+// false if the faintest limit isn't enough.
+bool
+populateBrightest(std::vector<StarBrowserRecord>& records,
+                  const AppMagComparison& comparison,
+                  const StarFilter& filter,
+                  std::uint32_t size,
+                  const StarDatabase& stardb,
+                  const Eigen::Vector3f& pos)
+{
+    // Views along the six axes, which with a field of 90 degrees and a
+    // square aspect ratio cover the whole sky
+    const std::array<Eigen::Quaternionf, 6> directions
+    {
+        Eigen::Quaternionf::Identity(),
+        Eigen::Quaternionf(Eigen::AngleAxisf(0.5f * celestia::numbers::pi_v<float>, Eigen::Vector3f::UnitY())),
+        Eigen::Quaternionf(Eigen::AngleAxisf(celestia::numbers::pi_v<float>, Eigen::Vector3f::UnitY())),
+        Eigen::Quaternionf(Eigen::AngleAxisf(-0.5f * celestia::numbers::pi_v<float>, Eigen::Vector3f::UnitY())),
+        Eigen::Quaternionf(Eigen::AngleAxisf(0.5f * celestia::numbers::pi_v<float>, Eigen::Vector3f::UnitX())),
+        Eigen::Quaternionf(Eigen::AngleAxisf(-0.5f * celestia::numbers::pi_v<float>, Eigen::Vector3f::UnitX())),
+    };
+
+    StarCollector collector;
+    for (float limitingMag = InitialSearchMagnitude;
+         limitingMag <= MaxSearchMagnitude;
+         limitingMag += SearchMagnitudeStep)
+    {
+        collector.stars.clear();
+        for (const Eigen::Quaternionf& direction : directions)
+        {
+            stardb.findVisibleStars(collector, pos, direction,
+                                    0.5f * celestia::numbers::pi_v<float>, 1.0f, limitingMag);
+        }
+        collector.removeDuplicates();
+        selectCollected(records, comparison, filter, size, collector);
+
+        // Every star brighter than the limit has been found
+        if (records.size() == size && records.front().appMag < limitingMag)
+        {
+            finishRecords(records, comparison, size);
+            return true;
+        }
+    }
+
+    return false;
+}
+
 } // end unnamed namespace
 
 StarBrowser::StarBrowser(const Universe* universe,
@@ -363,10 +529,18 @@ StarBrowser::populate(std::vector<StarBrowserRecord>& records) const
     switch (m_comparison)
     {
     case Comparison::Nearest:
-        populateRecords(records, DistanceComparison(m_jd, m_pos, m_ucPos), filter, m_size, *stardb);
+        if (DistanceComparison comparison(m_jd, m_pos, m_ucPos);
+            !populateNearest(records, comparison, filter, m_size, *stardb, m_pos))
+        {
+            populateRecords(records, comparison, filter, m_size, *stardb);
+        }
         return;
     case Comparison::ApparentMagnitude:
-        populateRecords(records, AppMagComparison(m_jd, m_pos, m_ucPos), filter, m_size, *stardb);
+        if (AppMagComparison comparison(m_jd, m_pos, m_ucPos);
+            !populateBrightest(records, comparison, filter, m_size, *stardb, m_pos))
+        {
+            populateRecords(records, comparison, filter, m_size, *stardb);
+        }
         return;
     case Comparison::AbsoluteMagnitude:
         populateRecords(records, AbsMagComparison(m_jd, m_pos, m_ucPos), filter, m_size, *stardb);
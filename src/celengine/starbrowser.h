@@ -89,7 +89,8 @@ public:
     // Currently this is only used by the Qt front-end, whose implementation
     // relies on Qt's regular expression classes. For now, we allow this to be
     // supplied as a function, in future we may want to implement a more
-    // specialized version to enable queries like "B5-F5"
+    // specialized version to enable queries like "B5-F5". The filter is
+    // called from several threads at once, so it must be thread safe.
     void setSpectralTypeFilter(const std::function<bool(const char*)>& filter) { m_spectralTypeFilter = filter; }
 
     const UniversalCoord& position() const { return m_ucPos; }
@@ -97,6 +98,8 @@ public:
     double time() const { return m_jd; }
     inline void setTime(double jd) { m_jd = jd; }
 
+    // The nearest and brightest stars are found with queries of the star
+    // octree, other lists with a parallel scan of all stars.
     void populate(std::vector<StarBrowserRecord>&) const;
 
 private:
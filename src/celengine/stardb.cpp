@@ -9,18 +9,27 @@
 // of the License, or (at your option) any later version.
 
 #include "stardb.h"
+#include "staroctreetraversal.h"
 
 #include <algorithm>
+#include <array>
+#include <cassert>
 #include <cmath>
+#include <limits>
 #include <set>
 
 #include <fmt/format.h>
 
+#include <celastro/astro.h>
 #include <celutil/gettext.h>
+#include <celutil/memoryusage.h>
+#include <celutil/threadpool.h>
 
 using namespace std::string_view_literals;
 
 namespace compat = celestia::compat;
+namespace astro = celestia::astro;
+namespace util = celestia::util;
 
 namespace
 {
@@ -43,28 +52,198 @@ catalogNumberToString(AstroCatalog::IndexNumber catalogNumber)
     }
 }
 
+// Compute the bounding planes of an infinite view frustum
+std::array<Eigen::Hyperplane<float, 3>, 5>
+computeFrustumPlanes(const Eigen::Vector3f& position,
+                     const Eigen::Quaternionf& orientation,
+                     float fovY,
+                     float aspectRatio)
+{
+    Eigen::Matrix3f rot = orientation.toRotationMatrix();
+    float h = std::tan(fovY * 0.5f);
+    float w = h * aspectRatio;
+    std::array<Eigen::Vector3f, 5> planeNormals
+    {
+        Eigen::Vector3f(0.0f, 1.0f, -h),
+        Eigen::Vector3f(0.0f, -1.0f, -h),
+        Eigen::Vector3f(1.0f, 0.0f, -w),
+        Eigen::Vector3f(-1.0f, 0.0f, -w),
+        Eigen::Vector3f(0.0f, 0.0f, -1.0f),
+    };
+
+    std::array<Eigen::Hyperplane<float, 3>, 5> frustumPlanes;
+    for (unsigned int i = 0U; i < 5U; ++i)
+    {
+        planeNormals[i] = rot.transpose() * planeNormals[i].normalized();
+        frustumPlanes[i] = Eigen::Hyperplane<float, 3>(planeNormals[i], position);
+    }
+
+    return frustumPlanes;
+}
+
+// Half angle of the frustum, in radians, beyond which the view is too wide
+// to be widened for StarVisibilityCache.
+constexpr float MaxCachedHalfAngle = 1.5f;
+
+// Compute the bounding planes of a frustum containing every frustum with the
+// same apex rotated by up to angle. Returns false if the result would no
+// longer be a proper frustum.
+bool
+computeWidenedFrustumPlanes(const Eigen::Vector3f& position,
+                            const Eigen::Quaternionf& orientation,
+                            float fovY,
+                            float aspectRatio,
+                            float angle,
+                            std::array<Eigen::Hyperplane<float, 3>, 5>& frustumPlanes)
+{
+    // A rotation by angle moves a direction at most angle away from each
+    // side plane, measured perpendicular to the plane. Tilting a side plane
+    // about its intersection with the opposite one must achieve that
+    // distance at the corners of the frustum, which are closest to the
+    // tilt axis.
+    float h = std::tan(fovY * 0.5f);
+    float w = h * aspectRatio;
+    float diagonal = std::sqrt(1.0f + h * h + w * w);
+    float sinAngle = std::sin(angle);
+    float tiltY = std::asin(std::min(1.0f, sinAngle * diagonal / std::sqrt(1.0f + h * h)));
+    float tiltX = std::asin(std::min(1.0f, sinAngle * diagonal / std::sqrt(1.0f + w * w)));
+
+    float halfAngleY = std::atan(h) + tiltY;
+    float halfAngleX = std::atan(w) + tiltX;
+    if (halfAngleY >= MaxCachedHalfAngle || halfAngleX >= MaxCachedHalfAngle)
+        return false;
+
+    frustumPlanes = computeFrustumPlanes(position,
+                                         orientation,
+                                         halfAngleY * 2.0f,
+                                         std::tan(halfAngleX) / std::tan(halfAngleY));
+    return true;
+}
+
 } // end unnamed namespace
 
+void
+StarVisibilityCache::invalidate()
+{
+    database = nullptr;
+    hasNodes = false;
+    nodes.clear();
+}
+
+bool
+StarVisibilityCache::matches(const StarDatabase* db,
+                             const Eigen::Vector3f& obsPosition,
+                             const Eigen::Quaternionf& obsOrientation,
+                             float obsFovY,
+                             float obsAspectRatio,
+                             float obsLimitingMag) const
+{
+    return db == database &&
+           obsFovY == fovY &&
+           obsAspectRatio == aspectRatio &&
+           obsLimitingMag <= limitingMag + MagnitudeTolerance &&
+           (obsPosition - position).norm() <= PositionTolerance &&
+           obsOrientation.angularDistance(orientation) <= AngleTolerance;
+}
+
 StarDatabase::~StarDatabase() = default;
 
 Star*
 StarDatabase::find(AstroCatalog::IndexNumber catalogNumber) const
 {
-    auto it = std::lower_bound(catalogNumberIndex.begin(), catalogNumberIndex.end(),
-                               catalogNumber,
-                               [this](std::uint32_t idx, AstroCatalog::IndexNumber catNum)
-                               {
-                                   return stars.get()[idx].getIndex() < catNum;
-                               });
+    if (!catalogNumberHash.empty())
+    {
+        if (std::uint32_t pos = catalogNumberHash.find(catalogNumber);
+            pos != celestia::util::PerfectHashIndex::NotFound)
+        {
+            return stars.get() + catalogNumberIndex[pos];
+        }
+    }
+    else if (auto it = std::lower_bound(catalogNumberIndex.begin(), catalogNumberIndex.end(),
+                                        catalogNumber,
+                                        [this](std::uint32_t idx, AstroCatalog::IndexNumber catNum)
+                                        {
+                                            return stars.get()[idx].getIndex() < catNum;
+                                        });
+             it != catalogNumberIndex.end() && stars.get()[*it].getIndex() == catalogNumber)
+    {
+        // False positive in cppcheck: stars.get() does NOT return a void pointer
+        return stars.get() + *it; // cppcheck-suppress arithOperationsOnVoidPointer
+    }
 
-    if (it == catalogNumberIndex.end())
-        return nullptr;
+    return nullptr;
+}
+
+void
+StarDatabase::updateStarMotion(double jd)
+{
+    if (starMotions.empty() || std::abs(jd - starMotionEpoch) < STAR_MOTION_UPDATE_INTERVAL)
+        return;
 
-    // False positive in cppcheck: stars.get() does NOT return a void pointer
-    Star* star = stars.get() + *it; // cppcheck-suppress arithOperationsOnVoidPointer
-    return star->getIndex() == catalogNumber
-        ? star
-        : nullptr;
+    starMotionEpoch = jd;
+    auto years = static_cast<float>((jd - astro::J2000) / astro::DAYS_PER_YEAR);
+
+    // The motions are in star order, so the stars of each node are updated
+    // together, along with their copies in the culling data
+    for (const StarMotion& motion : starMotions)
+    {
+        Eigen::Vector3f position = motion.position + motion.velocity * years;
+        stars[motion.starIndex].setPosition(position);
+        cullingData.x[motion.starIndex] = position.x();
+        cullingData.y[motion.starIndex] = position.y();
+        cullingData.z[motion.starIndex] = position.z();
+    }
+
+    // The node aggregates are left at the catalog positions: nodes are only
+    // aggregated when they are small compared to their distance.
+    for (std::size_t i = 0; i < octreeNodes.size(); ++i)
+        octreeNodes[i].setBoundsMargin(maxSubtreeSpeeds[i] * std::abs(years));
+}
+
+StarOctree::ObjectRange
+StarDatabase::getMovingStarRange() const
+{
+    if (starMotions.empty())
+        return { 0, 0 };
+
+    std::uint32_t first = starMotions.front().starIndex;
+    return { first, starMotions.back().starIndex - first + 1 };
+}
+
+void
+StarDatabase::buildStarMotion(std::vector<StarMotion>&& motions)
+{
+    starMotions = std::move(motions);
+    maxSubtreeSpeeds.clear();
+    starMotionEpoch = astro::J2000;
+    if (starMotions.empty())
+        return;
+
+    std::sort(starMotions.begin(), starMotions.end(),
+              [](const StarMotion& m0, const StarMotion& m1) { return m0.starIndex < m1.starIndex; });
+
+    // Children are always stored after their parent, so visiting the nodes
+    // backwards completes each subtree before it is added to its parent.
+    maxSubtreeSpeeds.assign(octreeNodes.size(), 0.0f);
+    for (std::size_t n = octreeNodes.size(); n-- > 0;)
+    {
+        const StarOctree& node = octreeNodes[n];
+        auto range = node.objectRange(stars.get());
+        auto it = std::lower_bound(starMotions.begin(), starMotions.end(), range.first,
+                                   [](const StarMotion& m, std::uint32_t idx) { return m.starIndex < idx; });
+        float maxSpeed = 0.0f;
+        for (; it != starMotions.end() && it->starIndex < range.first + range.count; ++it)
+            maxSpeed = std::max(maxSpeed, it->velocity.norm());
+
+        if (node.hasChildren())
+        {
+            auto firstChild = n + static_cast<std::size_t>(node.child(0) - &node);
+            for (std::size_t i = 0; i < 8; ++i)
+                maxSpeed = std::max(maxSpeed, maxSubtreeSpeeds[firstChild + i]);
+        }
+
+        maxSubtreeSpeeds[n] = maxSpeed;
+    }
 }
 
 Star*
@@ -115,17 +294,17 @@ StarDatabase::getStarName(const Star& star, [[maybe_unused]] bool i18n) const
     if (namesDB == nullptr)
         return catalogNumberToString(catalogNumber);
 
-    if (auto iter = namesDB->getFirstNameIter(catalogNumber); iter != namesDB->getFinalNameIter())
+    if (auto names = namesDB->getNames(catalogNumber); !names.empty())
     {
 #ifdef ENABLE_NLS
         if (i18n)
         {
-            const char * local = D_(iter->second.c_str());
-            if (iter->second != local)
+            const char * local = D_(names.front().data());
+            if (names.front() != local)
                 return local;
         }
 #endif
-        return iter->second;
+        return std::string(names.front());
     }
 
     /*
@@ -161,11 +340,9 @@ StarDatabase::getStarNameList(const Star& star, unsigned int maxNames) const
 
     if (namesDB != nullptr)
     {
-        for (auto iter = namesDB->getFirstNameIter(catalogNumber), end = namesDB->getFinalNameIter();
-             iter != end && iter->first == catalogNumber;
-             ++iter)
+        for (std::string_view name : namesDB->getNames(catalogNumber))
         {
-            append(D_(iter->second.c_str()));
+            append(D_(name.data()));
             if (nameSet.size() == maxNames)
                 return starNames;
         }
@@ -204,31 +381,142 @@ StarDatabase::findVisibleStars(StarHandler& starHandler,
                                float aspectRatio,
                                float limitingMag) const
 {
-    // Compute the bounding planes of an infinite view frustum
-    Eigen::Matrix3f rot = orientation.toRotationMatrix();
-    float h = std::tan(fovY * 0.5f);
-    float w = h * aspectRatio;
-    std::array<Eigen::Vector3f, 5> planeNormals
+    processVisibleStars(starHandler, nullptr, position, orientation, fovY, aspectRatio, limitingMag);
+}
+
+void
+StarDatabase::findVisibleStars(StarHandler& starHandler,
+                               StarVisibilityCache& cache,
+                               const Eigen::Vector3f& position,
+                               const Eigen::Quaternionf& orientation,
+                               float fovY,
+                               float aspectRatio,
+                               float limitingMag) const
+{
+    processVisibleStars(starHandler, &cache, position, orientation, fovY, aspectRatio, limitingMag);
+}
+
+bool
+StarDatabase::prepareVisibleStars(StarVisibilityCache* cache,
+                                  const Eigen::Vector3f& position,
+                                  const Eigen::Quaternionf& orientation,
+                                  float fovY,
+                                  float aspectRatio,
+                                  float limitingMag,
+                                  std::array<Eigen::Hyperplane<float, 3>, 5>& frustumPlanes) const
+{
+    frustumPlanes = computeFrustumPlanes(position, orientation, fovY, aspectRatio);
+    if (cache == nullptr)
+        return false;
+
+    if (!cache->matches(this, position, orientation, fovY, aspectRatio, limitingMag) ||
+        cache->starMotionEpoch != starMotionEpoch)
     {
-        Eigen::Vector3f(0.0f, 1.0f, -h),
-        Eigen::Vector3f(0.0f, -1.0f, -h),
-        Eigen::Vector3f(1.0f, 0.0f, -w),
-        Eigen::Vector3f(-1.0f, 0.0f, -w),
-        Eigen::Vector3f(0.0f, 0.0f, -1.0f),
-    };
+        // Remember the view, the node list is built if the next one is close
+        cache->invalidate();
+        cache->database = this;
+        cache->position = position;
+        cache->orientation = orientation;
+        cache->fovY = fovY;
+        cache->aspectRatio = aspectRatio;
+        cache->limitingMag = limitingMag;
+        cache->starMotionEpoch = starMotionEpoch;
+        return false;
+    }
 
-    std::array<Eigen::Hyperplane<float, 3>, 5> frustumPlanes;
-    for (unsigned int i = 0U; i < 5U; ++i)
+    if (!cache->hasNodes)
     {
-        planeNormals[i] = rot.transpose() * planeNormals[i].normalized();
-        frustumPlanes[i] = Eigen::Hyperplane<float, 3>(planeNormals[i], position);
+        std::array<Eigen::Hyperplane<float, 3>, 5> widenedPlanes;
+        if (!computeWidenedFrustumPlanes(position, orientation, fovY, aspectRatio,
+                                         StarVisibilityCache::AngleTolerance, widenedPlanes))
+        {
+            return false;
+        }
+
+        cache->position = position;
+        cache->orientation = orientation;
+        cache->limitingMag = limitingMag;
+        octreeNodes.front().collectVisibleNodes(cache->nodes,
+                                                position,
+                                                widenedPlanes.data(),
+                                                limitingMag + StarVisibilityCache::MagnitudeTolerance,
+                                                STAR_OCTREE_ROOT_SIZE,
+                                                StarVisibilityCache::PositionTolerance);
+        cache->hasNodes = true;
     }
 
-    octreeRoot->processVisibleObjects(starHandler,
-                                      position,
-                                      frustumPlanes.data(),
-                                      limitingMag,
-                                      STAR_OCTREE_ROOT_SIZE);
+    return true;
+}
+
+void
+StarDatabase::findVisibleStars(util::ThreadPool& pool,
+                               util::array_view<StarHandler*> starHandlers,
+                               const Eigen::Vector3f& position,
+                               const Eigen::Quaternionf& orientation,
+                               float fovY,
+                               float aspectRatio,
+                               float limitingMag) const
+{
+    assert(starHandlers.size() >= pool.concurrency());
+
+    auto frustumPlanes = computeFrustumPlanes(position, orientation, fovY, aspectRatio);
+
+    // Expand the tree breadth-first on this thread until there are enough
+    // independent subtrees to keep all the workers busy. Most of the stars
+    // are concentrated in a few nodes close to the origin, so a fixed depth
+    // would not produce a useful split.
+    const std::size_t targetTasks = static_cast<std::size_t>(pool.concurrency()) * TasksPerWorker;
+    std::vector<StarOctree::Subtree> subtrees{ { &octreeNodes.front(), STAR_OCTREE_ROOT_SIZE } };
+    std::vector<StarOctree::Subtree> expanded;
+    for (unsigned int level = 0; level < MaxSerialLevels && !subtrees.empty() && subtrees.size() < targetTasks; ++level)
+    {
+        expanded.clear();
+        for (const auto& subtree : subtrees)
+        {
+            subtree.node->processVisibleObjects(*starHandlers[0],
+                                                position,
+                                                frustumPlanes.data(),
+                                                limitingMag,
+                                                subtree.scale,
+                                                1,
+                                                expanded,
+                                                &cullingData);
+        }
+        subtrees.swap(expanded);
+    }
+
+    pool.parallelFor(subtrees.size(),
+                     [&](std::size_t task, unsigned int worker)
+                     {
+                         const auto& subtree = subtrees[task];
+                         std::vector<StarOctree::Subtree> unused;
+                         subtree.node->processVisibleObjects(*starHandlers[worker],
+                                                             position,
+                                                             frustumPlanes.data(),
+                                                             limitingMag,
+                                                             subtree.scale,
+                                                             std::numeric_limits<unsigned int>::max(),
+                                                             unused,
+                                                             &cullingData);
+                     });
+}
+
+void
+StarDatabase::findVisibleStarRanges(std::vector<StarOctree::ObjectRange>& ranges,
+                                    const Eigen::Vector3f& position,
+                                    const Eigen::Quaternionf& orientation,
+                                    float fovY,
+                                    float aspectRatio,
+                                    float limitingMag) const
+{
+    auto frustumPlanes = computeFrustumPlanes(position, orientation, fovY, aspectRatio);
+    ranges.clear();
+    octreeNodes.front().processVisibleNodes(ranges,
+                                            stars.get(),
+                                            position,
+                                            frustumPlanes.data(),
+                                            limitingMag,
+                                            STAR_OCTREE_ROOT_SIZE);
 }
 
 void
@@ -236,10 +524,7 @@ StarDatabase::findCloseStars(StarHandler& starHandler,
                              const Eigen::Vector3f& position,
                              float radius) const
 {
-    octreeRoot->processCloseObjects(starHandler,
-                                    position,
-                                    radius,
-                                    STAR_OCTREE_ROOT_SIZE);
+    processCloseStars(starHandler, position, radius);
 }
 
 const StarNameDatabase*
@@ -247,3 +532,26 @@ StarDatabase::getNameDatabase() const
 {
     return namesDB.get();
 }
+
+StarNameDatabase*
+StarDatabase::getNameDatabase()
+{
+    return namesDB.get();
+}
+
+std::size_t
+StarDatabase::getMemoryUsage() const
+{
+    using celestia::util::MemoryUsage;
+
+    std::size_t size = static_cast<std::size_t>(nStars) * sizeof(Star);
+    size += MemoryUsage(catalogNumberIndex);
+    size += catalogNumberHash.memoryUsage();
+    size += MemoryUsage(octreeNodes);
+    size += MemoryUsage(cullingData.x) + MemoryUsage(cullingData.y) + MemoryUsage(cullingData.z);
+    size += MemoryUsage(cullingData.absMag) + MemoryUsage(cullingData.extinction);
+    size += MemoryUsage(cullingData.aggregates);
+    size += MemoryUsage(starMotions);
+    size += MemoryUsage(maxSubtreeSpeeds);
+    return size;
+}
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -19,13 +21,58 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
+#include <celastro/date.h>
+#include <celutil/array_view.h>
+#include <celutil/perfecthash.h>
 #include "astroobj.h"
 #include "starname.h"
 #include "staroctree.h"
 
 class Star;
+class StarDatabase;
 class StarDatabaseBuilder;
 
+namespace celestia::util
+{
+class ThreadPool;
+}
+
+// Keeps the list of star octree nodes which may be visible from a range of
+// views around the one it was built for. Consecutive frames with little
+// camera movement then only walk the list instead of the whole tree. The
+// list is only built once the view has stayed within the tolerances for two
+// queries in a row, so a continuously moving camera does not pay for it.
+class StarVisibilityCache
+{
+public:
+    // Largest change of the view which still uses the cached node list
+    static constexpr float PositionTolerance = 0.01f;  // light years
+    static constexpr float AngleTolerance = 0.0175f;   // radians
+    static constexpr float MagnitudeTolerance = 0.1f;
+
+    void invalidate();
+
+private:
+    bool matches(const StarDatabase* db,
+                 const Eigen::Vector3f& obsPosition,
+                 const Eigen::Quaternionf& obsOrientation,
+                 float fovY,
+                 float aspectRatio,
+                 float limitingMag) const;
+
+    const StarDatabase* database{ nullptr };
+    Eigen::Vector3f position{ Eigen::Vector3f::Zero() };
+    Eigen::Quaternionf orientation{ Eigen::Quaternionf::Identity() };
+    float fovY{ 0.0f };
+    float aspectRatio{ 0.0f };
+    float limitingMag{ 0.0f };
+    double starMotionEpoch{ 0.0 };
+    bool hasNodes{ false };
+    std::vector<StarOctree::NodeListEntry> nodes;
+
+    friend class StarDatabase;
+};
+
 class StarDatabase
 {
 public:
@@ -37,6 +84,10 @@ public:
     // investigated.
     static constexpr float STAR_OCTREE_ROOT_SIZE = 1000000000.0f;
 
+    // Time in days the simulation has to move away from the epoch of the
+    // star positions before updateStarMotion() recomputes them.
+    static constexpr double STAR_MOTION_UPDATE_INTERVAL = celestia::astro::DAYS_PER_YEAR;
+
     // Not exact, but any star with a catalog number greater than this is assumed to not be
     // a HIPPARCOS stars.
     static constexpr AstroCatalog::IndexNumber MAX_HIPPARCOS_NUMBER = 999999;
@@ -52,6 +103,21 @@ public:
     Star* find(AstroCatalog::IndexNumber catalogNumber) const;
     Star* find(std::string_view, bool i18n) const;
 
+    // Moves the stars with a proper motion or radial velocity to their
+    // positions at Julian date jd, if it is more than
+    // STAR_MOTION_UPDATE_INTERVAL away from the current epoch of the
+    // positions. Stars move in straight lines from their catalog positions
+    // at J2000, and the octree nodes are grown to keep them in bounds
+    // instead of re-sorting them. Must not be called during a query.
+    void updateStarMotion(double jd);
+
+    // Julian date of the current star positions; changes whenever
+    // updateStarMotion() moves the stars.
+    inline double getStarMotionEpoch() const;
+    // Smallest range of star indices containing every moving star, empty if
+    // no star moves. Only the positions of these stars change with the epoch.
+    StarOctree::ObjectRange getMovingStarRange() const;
+
     void getCompletion(std::vector<std::string>&, std::string_view) const;
 
     void findVisibleStars(StarHandler& starHandler,
@@ -61,23 +127,118 @@ public:
                           float aspectRatio,
                           float limitingMag) const;
 
+    // Same as above, reusing the nodes found by an earlier call with a
+    // similar view, see StarVisibilityCache. The stars passed to the handler
+    // are the same as without the cache.
+    void findVisibleStars(StarHandler& starHandler,
+                          StarVisibilityCache& cache,
+                          const Eigen::Vector3f& obsPosition,
+                          const Eigen::Quaternionf& obsOrientation,
+                          float fovY,
+                          float aspectRatio,
+                          float limitingMag) const;
+
+    // Parallel version of findVisibleStars. The octree is split into
+    // subtrees which are traversed by the threads of the pool. Each thread
+    // only calls the handler at its own worker index, so the handlers need
+    // not be thread safe, but there must be at least pool.concurrency() of
+    // them; merging their results is up to the caller.
+    void findVisibleStars(celestia::util::ThreadPool& pool,
+                          celestia::util::array_view<StarHandler*> starHandlers,
+                          const Eigen::Vector3f& obsPosition,
+                          const Eigen::Quaternionf& obsOrientation,
+                          float fovY,
+                          float aspectRatio,
+                          float limitingMag) const;
+
+    // Collects the ranges of star indices, as used by getStar(), of the
+    // octree nodes which may contain visible stars, leaving the per-star
+    // tests to the caller.
+    void findVisibleStarRanges(std::vector<StarOctree::ObjectRange>& ranges,
+                               const Eigen::Vector3f& obsPosition,
+                               const Eigen::Quaternionf& obsOrientation,
+                               float fovY,
+                               float aspectRatio,
+                               float limitingMag) const;
+
     void findCloseStars(StarHandler& starHandler,
                         const Eigen::Vector3f& obsPosition,
                         float radius) const;
 
+    // Same as findVisibleStars, with an optional cache, and findCloseStars,
+    // but with the type of the handler known at compile time so that the
+    // calls for each star are not virtual if the handler class is final.
+    // Defined in staroctreetraversal.h.
+    template<typename Handler>
+    void processVisibleStars(Handler& starHandler,
+                             StarVisibilityCache* cache,
+                             const Eigen::Vector3f& obsPosition,
+                             const Eigen::Quaternionf& obsOrientation,
+                             float fovY,
+                             float aspectRatio,
+                             float limitingMag) const;
+
+    template<typename Handler>
+    void processCloseStars(Handler& starHandler,
+                           const Eigen::Vector3f& obsPosition,
+                           float radius) const;
+
     std::string getStarName(const Star&, bool i18n = false) const;
     std::string getStarNameList(const Star&, unsigned int maxNames = MAX_STAR_NAMES) const;
 
     const StarNameDatabase* getNameDatabase() const;
+    StarNameDatabase* getNameDatabase();
+
+    // Bytes of memory used by the stars and their indexes, not including
+    // the name database and the shared star details
+    std::size_t getMemoryUsage() const;
 
 private:
+    // Computes the frustum planes of the view and, if a cache is given,
+    // updates it. Returns true if the cached node list is to be traversed
+    // rather than the whole tree.
+    bool prepareVisibleStars(StarVisibilityCache* cache,
+                             const Eigen::Vector3f& obsPosition,
+                             const Eigen::Quaternionf& obsOrientation,
+                             float fovY,
+                             float aspectRatio,
+                             float limitingMag,
+                             std::array<Eigen::Hyperplane<float, 3>, 5>& frustumPlanes) const;
+
+    // Number of octree subtrees handed to each worker in the parallel
+    // traversal; more tasks than workers evens out the load.
+    static constexpr std::size_t TasksPerWorker = 4;
+    // Maximum number of octree levels expanded by the calling thread before
+    // the parallel traversal starts.
+    static constexpr unsigned int MaxSerialLevels = 32;
+
+    // Linear motion of a star, in the star coordinate system
+    struct StarMotion
+    {
+        std::uint32_t starIndex;
+        Eigen::Vector3f position; // at J2000, light years
+        Eigen::Vector3f velocity; // light years per Julian year
+    };
+
     Star* searchCrossIndex(StarCatalog, AstroCatalog::IndexNumber number) const;
+    void buildStarMotion(std::vector<StarMotion>&&);
 
     std::uint32_t nStars{ 0 };
     std::unique_ptr<Star[]>           stars; //NOSONAR
     std::unique_ptr<StarNameDatabase> namesDB;
     std::vector<std::uint32_t>        catalogNumberIndex;
-    StarOctree*                       octreeRoot;
+    // Position in catalogNumberIndex by catalog number
+    celestia::util::PerfectHashIndex  catalogNumberHash;
+    std::vector<StarOctree>           octreeNodes; // root first
+    StarCullingData                   cullingData;
+
+    // Moving stars sorted by star index, i.e. in octree node order, and the
+    // largest speed of any star in the subtree of each node. Both are empty
+    // if no star moves.
+    std::vector<StarMotion>           starMotions;
+    std::vector<float>                maxSubtreeSpeeds;
+    // Julian date of the current star positions
+    double                            starMotionEpoch{ celestia::astro::J2000 };
 
     friend class StarDatabaseBuilder;
 };
@@ -93,3 +254,9 @@ StarDatabase::size() const
 {
     return nStars;
 }
+
+inline double
+StarDatabase::getStarMotionEpoch() const
+{
+    return starMotionEpoch;
+}
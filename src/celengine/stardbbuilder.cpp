@@ -16,6 +16,8 @@
 #include <cmath>
 #include <cstdint>
 #include <istream>
+#include <sstream>
+#include <ostream>
 #include <iterator>
 #include <string_view>
 #include <type_traits>
@@ -28,12 +30,15 @@
 #include <fmt/format.h>
 
 #include <celastro/astro.h>
+#include <celastro/date.h>
 #include <celmath/geomutil.h>
 #include <celmath/mathlib.h>
 #include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
 #include <celutil/fsutils.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/threadpool.h>
 #include <celutil/timer.h>
 #include <celutil/tokenizer.h>
 #include "hash.h"
@@ -53,6 +58,16 @@ namespace util = celestia::util;
 
 using util::GetLogger;
 
+namespace
+{
+
+// Catalogs at least this large are parsed on multiple threads
+constexpr std::size_t ParallelLoadThreshold = 1024 * 1024;
+// Number of chunks handed to each worker when parsing in parallel
+constexpr std::size_t ChunksPerWorker = 4;
+
+} // end unnamed namespace
+
 struct StarDatabaseBuilder::StcHeader
 {
     explicit StcHeader(const fs::path&);
@@ -98,6 +113,13 @@ constexpr float VALID_APPMAG_DISTANCE_THRESHOLD = 1e-5f;
 
 constexpr std::string_view STARSDAT_MAGIC = "CELSTARS"sv;
 constexpr std::uint16_t StarDBVersion     = 0x0100;
+// Version 2 files hold the stars in octree order, followed by the octree
+// nodes and the catalog number index.
+constexpr std::uint16_t StarDBVersion2    = 0x0200;
+// The motion versions of both formats are followed by a list of star
+// motions, see StarsDatMotionRecord.
+constexpr std::uint16_t StarDBVersionMotion  = 0x0101;
+constexpr std::uint16_t StarDBVersion2Motion = 0x0201;
 
 #pragma pack(push, 1)
 
@@ -122,13 +144,113 @@ struct StarsDatRecord
     std::uint16_t spectralType;
 };
 
+// stars.dat version 2 header structure
+struct StarsDatHeaderV2
+{
+    StarsDatHeaderV2() = delete;
+    char magic[8]; //NOSONAR
+    std::uint16_t version;
+    std::uint32_t counter;
+    std::uint32_t nodeCounter;
+};
+
+// stars.dat version 2 octree node structure
+struct StarsDatNode
+{
+    StarsDatNode() = delete;
+    float x;
+    float y;
+    float z;
+    float exclusionFactor;
+    std::uint32_t firstStar;
+    std::uint32_t nStars;
+    std::uint32_t childOffset;
+};
+
+// stars.dat motion record, preceded by the number of records. Stars without
+// a record don't move.
+struct StarsDatMotionRecord
+{
+    StarsDatMotionRecord() = delete;
+    AstroCatalog::IndexNumber catNo;
+    float pmRA;           // mas/yr, including the cos(dec) factor
+    float pmDec;          // mas/yr
+    float radialVelocity; // km/s
+};
+
 #pragma pack(pop)
 
 static_assert(std::is_standard_layout_v<StarsDatHeader>);
 static_assert(std::is_standard_layout_v<StarsDatRecord>);
+static_assert(std::is_standard_layout_v<StarsDatHeaderV2>);
+static_assert(std::is_standard_layout_v<StarsDatNode>);
+static_assert(std::is_standard_layout_v<StarsDatMotionRecord>);
+
+// Converts a proper motion and radial velocity to a velocity in the star
+// coordinate system, in light years per Julian year.
+Eigen::Vector3f
+computeStarVelocity(const Eigen::Vector3f& position, float pmRA, float pmDec, float radialVelocity)
+{
+    // Equatorial axes in the star coordinate system, y pointing to the
+    // north celestial pole, see astro::equatorialToCelestialCart
+    Eigen::Matrix3d axes;
+    axes.col(0) = astro::equatorialToCelestialCart(0.0, 0.0, 1.0);
+    axes.col(1) = astro::equatorialToCelestialCart(0.0, 90.0, 1.0);
+    axes.col(2) = -astro::equatorialToCelestialCart(6.0, 0.0, 1.0);
+
+    Eigen::Vector3d q = axes.transpose() * position.cast<double>();
+    double distance = q.norm();
+    if (distance == 0.0)
+        return Eigen::Vector3f::Zero();
+
+    double ra = std::atan2(-q.z(), q.x());
+    double dec = std::asin(std::clamp(q.y() / distance, -1.0, 1.0));
+    double sinRA;
+    double cosRA;
+    math::sincos(ra, sinRA, cosRA);
+    double sinDec;
+    double cosDec;
+    math::sincos(dec, sinDec, cosDec);
+
+    Eigen::Vector3d raAxis(-sinRA, 0.0, -cosRA);
+    Eigen::Vector3d decAxis(-sinDec * cosRA, cosDec, sinDec * sinRA);
+
+    constexpr double radPerMas = math::degToRad(1.0 / (astro::SECONDS_PER_DEG * 1000.0));
+    constexpr double lyPerYearPerKmS = astro::SECONDS_PER_DAY * astro::DAYS_PER_YEAR / astro::KM_PER_LY<double>;
+    Eigen::Vector3d velocity = distance * radPerMas * (static_cast<double>(pmRA) * raAxis +
+                                                       static_cast<double>(pmDec) * decAxis)
+                             + lyPerYearPerKmS * static_cast<double>(radialVelocity) * (q / distance);
+    return (axes * velocity).cast<float>();
+}
 
 bool
-parseStarsDatHeader(std::istream& in, std::uint32_t& nStarsInFile)
+parseStarsDatRecord(const char* ptr, Star& star)
+{
+    auto catNo = util::fromMemoryLE<AstroCatalog::IndexNumber>(ptr + offsetof(StarsDatRecord, catNo));
+    Eigen::Vector3f position(util::fromMemoryLE<float>(ptr + offsetof(StarsDatRecord, x)),
+                             util::fromMemoryLE<float>(ptr + offsetof(StarsDatRecord, y)),
+                             util::fromMemoryLE<float>(ptr + offsetof(StarsDatRecord, z)));
+    auto absMag = util::fromMemoryLE<std::int16_t>(ptr + offsetof(StarsDatRecord, absMag));
+    auto spectralType = util::fromMemoryLE<std::uint16_t>(ptr + offsetof(StarsDatRecord, spectralType));
+
+    boost::intrusive_ptr<StarDetails> details = nullptr;
+    if (StellarClass sc; sc.unpackV1(spectralType))
+        details = StarDetails::GetStarDetails(sc);
+
+    if (details == nullptr)
+    {
+        GetLogger()->error(_("Bad spectral type in star database, star #{}\n"), catNo);
+        return false;
+    }
+
+    star = Star(catNo, details);
+    star.setPosition(position);
+    star.setAbsoluteMagnitude(static_cast<float>(absMag) / 256.0f);
+    return true;
+}
+
+bool
+parseStarsDatHeader(std::istream& in, std::uint32_t& nStarsInFile, bool& hasMotion)
 {
     std::array<char, sizeof(StarsDatHeader)> header;
     if (!in.read(header.data(), header.size()).good()) /* Flawfinder: ignore */
@@ -142,11 +264,11 @@ parseStarsDatHeader(std::istream& in, std::uint32_t& nStarsInFile)
     }
 
     // Verify the version
-    if (auto version = util::fromMemoryLE<std::uint16_t>(header.data() + offsetof(StarsDatHeader, version));
-        version != StarDBVersion)
-    {
+    auto version = util::fromMemoryLE<std::uint16_t>(header.data() + offsetof(StarsDatHeader, version));
+    if (version != StarDBVersion && version != StarDBVersionMotion)
         return false;
-    }
+
+    hasMotion = version == StarDBVersionMotion;
 
     // Read the star count
     nStarsInFile = util::fromMemoryLE<std::uint32_t>(header.data() + offsetof(StarsDatHeader, counter));
@@ -166,9 +288,9 @@ stcWarn(const StarDatabaseBuilder::StcHeader& header, std::string_view msg)
 }
 
 bool
-parseStcHeader(Tokenizer& tokenizer, StarDatabaseBuilder::StcHeader& header)
+parseStcHeader(Tokenizer& tokenizer, StarDatabaseBuilder::StcHeader& header, int lineOffset)
 {
-    header.lineNumber = tokenizer.getLineNumber();
+    header.lineNumber = tokenizer.getLineNumber() + lineOffset;
 
     header.isStar = true;
 
@@ -251,6 +373,31 @@ parseStcHeader(Tokenizer& tokenizer, StarDatabaseBuilder::StcHeader& header)
     return true;
 }
 
+// Reads the header and the definition of the next star, with the tokenizer
+// on the first token of the header. lineOffset is added to the line numbers
+// of the tokenizer, which may be reading only part of the file.
+bool
+readStcEntry(Tokenizer& tokenizer,
+             Parser& parser,
+             StarDatabaseBuilder::StcHeader& header,
+             Value& starData,
+             int lineOffset)
+{
+    if (!parseStcHeader(tokenizer, header, lineOffset))
+        return false;
+
+    // now goes the star definition
+    tokenizer.pushBack();
+    starData = parser.readValue();
+    if (starData.getHash() == nullptr)
+    {
+        GetLogger()->error(_("Bad star definition at line {}.\n"), tokenizer.getLineNumber() + lineOffset);
+        return false;
+    }
+
+    return true;
+}
+
 bool
 checkSpectralType(const StarDatabaseBuilder::StcHeader& header,
                   const AssociativeArray* starData,
@@ -538,7 +685,8 @@ StarDatabaseBuilder::loadBinary(std::istream& in)
 {
     Timer timer;
     std::uint32_t nStarsInFile;
-    if (!parseStarsDatHeader(in, nStarsInFile))
+    bool hasMotion;
+    if (!parseStarsDatHeader(in, nStarsInFile, hasMotion))
         return false;
 
     constexpr std::uint32_t BUFFER_RECORDS = UINT32_C(4096) / sizeof(StarsDatRecord);
@@ -553,26 +701,8 @@ StarDatabaseBuilder::loadBinary(std::istream& in)
         const char* ptr = buffer.data();
         for (std::uint32_t i = 0; i < recordsToRead; ++i)
         {
-            auto catNo = util::fromMemoryLE<AstroCatalog::IndexNumber>(ptr + offsetof(StarsDatRecord, catNo));
-            Eigen::Vector3f position(util::fromMemoryLE<float>(ptr + offsetof(StarsDatRecord, x)),
-                                     util::fromMemoryLE<float>(ptr + offsetof(StarsDatRecord, y)),
-                                     util::fromMemoryLE<float>(ptr + offsetof(StarsDatRecord, z)));
-            auto absMag = util::fromMemoryLE<std::int16_t>(ptr + offsetof(StarsDatRecord, absMag));
-            auto spectralType = util::fromMemoryLE<std::uint16_t>(ptr + offsetof(StarsDatRecord, spectralType));
-
-            boost::intrusive_ptr<StarDetails> details = nullptr;
-            if (StellarClass sc; sc.unpackV1(spectralType))
-                details = StarDetails::GetStarDetails(sc);
-
-            if (details == nullptr)
-            {
-                GetLogger()->error(_("Bad spectral type in star database, star #{}\n"), catNo);
-                continue;
-            }
-
-            Star& star = unsortedStars.emplace_back(catNo, details);
-            star.setPosition(position);
-            star.setAbsoluteMagnitude(static_cast<float>(absMag) / 256.0f);
+            if (Star star; parseStarsDatRecord(ptr, star))
+                unsortedStars.push_back(std::move(star));
 
             ptr += sizeof(StarsDatRecord);
         }
@@ -599,9 +729,254 @@ StarDatabaseBuilder::loadBinary(std::istream& in)
     std::sort(binFileCatalogNumberIndex.begin(), binFileCatalogNumberIndex.end(),
                 [](const Star* star0, const Star* star1) { return star0->getIndex() < star1->getIndex(); });
 
+    if (!hasMotion)
+        return true;
+
+    std::array<char, sizeof(std::uint32_t)> countBuffer;
+    if (!in.read(countBuffer.data(), countBuffer.size()).good()) /* Flawfinder: ignore */
+        return false;
+
+    auto nMotionsRemaining = util::fromMemoryLE<std::uint32_t>(countBuffer.data());
+    buffer.resize(sizeof(StarsDatMotionRecord) * BUFFER_RECORDS);
+    while (nMotionsRemaining > 0)
+    {
+        std::uint32_t recordsToRead = std::min(BUFFER_RECORDS, nMotionsRemaining);
+        if (!in.read(buffer.data(), sizeof(StarsDatMotionRecord) * recordsToRead).good()) /* Flawfinder: ignore */
+            return false;
+
+        addStarMotions(buffer.data(), recordsToRead);
+        nMotionsRemaining -= recordsToRead;
+    }
+
+    GetLogger()->info(_("{} moving stars in binary database\n"), starVelocities.size());
+    return !in.bad();
+}
+
+void
+StarDatabaseBuilder::addStarMotions(const char* ptr, std::uint32_t nRecords)
+{
+    for (std::uint32_t i = 0; i < nRecords; ++i, ptr += sizeof(StarsDatMotionRecord))
+    {
+        auto catNo = util::fromMemoryLE<AstroCatalog::IndexNumber>(ptr + offsetof(StarsDatMotionRecord, catNo));
+        const Star* star = findWhileLoading(catNo);
+        if (star == nullptr)
+            continue;
+
+        Eigen::Vector3f velocity = computeStarVelocity(star->getPosition(),
+                                                       util::fromMemoryLE<float>(ptr + offsetof(StarsDatMotionRecord, pmRA)),
+                                                       util::fromMemoryLE<float>(ptr + offsetof(StarsDatMotionRecord, pmDec)),
+                                                       util::fromMemoryLE<float>(ptr + offsetof(StarsDatMotionRecord, radialVelocity)));
+        if (velocity.allFinite() && !velocity.isZero(0.0f))
+            starVelocities.emplace_back(catNo, velocity);
+    }
+}
+
+bool
+StarDatabaseBuilder::isSortedBinary(const char* data, std::size_t size)
+{
+    if (size < sizeof(StarsDatHeaderV2) ||
+        std::string_view(data + offsetof(StarsDatHeaderV2, magic), STARSDAT_MAGIC.size()) != STARSDAT_MAGIC)
+    {
+        return false;
+    }
+
+    auto version = util::fromMemoryLE<std::uint16_t>(data + offsetof(StarsDatHeaderV2, version));
+    return version == StarDBVersion2 || version == StarDBVersion2Motion;
+}
+
+/*! Load a version 2 star database, i.e. one written by sortstardb. The stars
+ *  are stored in octree order together with the octree and the catalog number
+ *  index, so neither needs to be rebuilt as long as no stc file adds or
+ *  modifies stars.
+ */
+bool
+StarDatabaseBuilder::loadSortedBinary(const char* data, std::size_t size)
+{
+    Timer timer;
+    if (!isSortedBinary(data, size))
+        return false;
+
+    auto nStarsInFile = util::fromMemoryLE<std::uint32_t>(data + offsetof(StarsDatHeaderV2, counter));
+    auto nNodesInFile = util::fromMemoryLE<std::uint32_t>(data + offsetof(StarsDatHeaderV2, nodeCounter));
+    bool hasMotion = util::fromMemoryLE<std::uint16_t>(data + offsetof(StarsDatHeaderV2, version)) == StarDBVersion2Motion;
+    std::size_t starsSize = sizeof(StarsDatHeaderV2)
+                          + std::size_t(nStarsInFile) * (sizeof(StarsDatRecord) + sizeof(std::uint32_t))
+                          + std::size_t(nNodesInFile) * sizeof(StarsDatNode);
+    std::uint32_t nMotionsInFile = 0;
+    if (hasMotion)
+    {
+        if (size < starsSize + sizeof(std::uint32_t))
+            return false;
+        nMotionsInFile = util::fromMemoryLE<std::uint32_t>(data + starsSize);
+        starsSize += sizeof(std::uint32_t) + std::size_t(nMotionsInFile) * sizeof(StarsDatMotionRecord);
+    }
+
+    if (nNodesInFile == 0 || size != starsSize)
+        return false;
+
+    // Stars can't be skipped here as the octree refers to them by index
+    const char* ptr = data + sizeof(StarsDatHeaderV2);
+    auto stars = std::make_unique<Star[]>(nStarsInFile);
+    for (std::uint32_t i = 0; i < nStarsInFile; ++i, ptr += sizeof(StarsDatRecord))
+    {
+        if (!parseStarsDatRecord(ptr, stars[i]))
+            return false;
+    }
+
+    std::vector<StarOctree::FlatNode> nodes;
+    nodes.reserve(nNodesInFile);
+    for (std::uint32_t i = 0; i < nNodesInFile; ++i, ptr += sizeof(StarsDatNode))
+    {
+        Eigen::Vector3f center(util::fromMemoryLE<float>(ptr + offsetof(StarsDatNode, x)),
+                               util::fromMemoryLE<float>(ptr + offsetof(StarsDatNode, y)),
+                               util::fromMemoryLE<float>(ptr + offsetof(StarsDatNode, z)));
+        nodes.push_back({ center,
+                          util::fromMemoryLE<float>(ptr + offsetof(StarsDatNode, exclusionFactor)),
+                          util::fromMemoryLE<std::uint32_t>(ptr + offsetof(StarsDatNode, firstStar)),
+                          util::fromMemoryLE<std::uint32_t>(ptr + offsetof(StarsDatNode, nStars)),
+                          util::fromMemoryLE<std::uint32_t>(ptr + offsetof(StarsDatNode, childOffset)) });
+    }
+
+    std::vector<StarOctree> octreeNodes;
+    if (!StarOctree::unflatten(nodes.data(), nodes.size(), stars.get(), nStarsInFile, octreeNodes))
+        return false;
+
+    std::vector<std::uint32_t> catalogNumberIndex;
+    catalogNumberIndex.reserve(nStarsInFile);
+    for (std::uint32_t i = 0; i < nStarsInFile; ++i, ptr += sizeof(std::uint32_t))
+    {
+        auto idx = util::fromMemoryLE<std::uint32_t>(ptr);
+        if (idx >= nStarsInFile)
+            return false;
+        catalogNumberIndex.push_back(idx);
+    }
+
+    // The index is already sorted by catalog number, so it can be used for
+    // lookups while the stc files are loaded.
+    binFileCatalogNumberIndex.reserve(binFileCatalogNumberIndex.size() + nStarsInFile);
+    for (std::uint32_t idx : catalogNumberIndex)
+        binFileCatalogNumberIndex.push_back(&stars[idx]);
+
+    if (hasMotion)
+        addStarMotions(ptr + sizeof(std::uint32_t), nMotionsInFile);
+
+    nPresortedStars = nStarsInFile;
+    presortedStars = std::move(stars);
+    presortedOctree = std::move(octreeNodes);
+    presortedIndex = std::move(catalogNumberIndex);
+
+    GetLogger()->debug("StarDatabase::read: nStars = {}, nodes = {}, time = {} ms\n",
+                       nStarsInFile, nNodesInFile, timer.getTime());
+    GetLogger()->info(_("{} stars in binary database\n"), nStarsInFile);
     return true;
 }
 
+/*! Convert a version 1 star database to version 2, which can be loaded with
+ *  loadSortedBinary().
+ */
+bool
+StarDatabaseBuilder::writeSortedBinary(std::istream& in, std::ostream& out)
+{
+    std::uint32_t nStarsInFile;
+    bool hasMotion;
+    if (!parseStarsDatHeader(in, nStarsInFile, hasMotion))
+        return false;
+
+    std::vector<char> records(std::size_t(nStarsInFile) * sizeof(StarsDatRecord));
+    if (!in.read(records.data(), records.size()).good()) /* Flawfinder: ignore */
+        return false;
+
+    // The motion records refer to stars by catalog number, so they are
+    // copied unchanged
+    std::vector<char> motionRecords;
+    if (hasMotion)
+    {
+        std::array<char, sizeof(std::uint32_t)> countBuffer;
+        if (!in.read(countBuffer.data(), countBuffer.size()).good()) /* Flawfinder: ignore */
+            return false;
+
+        motionRecords.resize(std::size_t(util::fromMemoryLE<std::uint32_t>(countBuffer.data()))
+                             * sizeof(StarsDatMotionRecord));
+        if (!in.read(motionRecords.data(), motionRecords.size()).good()) /* Flawfinder: ignore */
+            return false;
+    }
+
+    StarDatabaseBuilder builder;
+    builder.setNameDatabase(std::make_unique<StarNameDatabase>());
+
+    // The stars only keep the unpacked spectral type, so the original
+    // records are looked up by catalog number when writing the output.
+    std::vector<const char*> recordIndex;
+    recordIndex.reserve(nStarsInFile);
+    for (const char* ptr = records.data(); ptr != records.data() + records.size(); ptr += sizeof(StarsDatRecord))
+    {
+        if (Star star; parseStarsDatRecord(ptr, star))
+        {
+            builder.unsortedStars.push_back(std::move(star));
+            recordIndex.push_back(ptr);
+        }
+    }
+
+    auto recordCatNo = [](const char* ptr)
+    {
+        return util::fromMemoryLE<AstroCatalog::IndexNumber>(ptr + offsetof(StarsDatRecord, catNo));
+    };
+    std::stable_sort(recordIndex.begin(), recordIndex.end(),
+                     [&](const char* r0, const char* r1) { return recordCatNo(r0) < recordCatNo(r1); });
+
+    std::unique_ptr<StarDatabase> db = builder.finish();
+
+    std::vector<StarOctree::FlatNode> nodes;
+    StarOctree::flatten(db->octreeNodes, db->stars.get(), nodes);
+
+    out.write(STARSDAT_MAGIC.data(), STARSDAT_MAGIC.size());
+    if (!util::writeLE<std::uint16_t>(out, hasMotion ? StarDBVersion2Motion : StarDBVersion2) ||
+        !util::writeLE<std::uint32_t>(out, db->nStars) ||
+        !util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(nodes.size())))
+    {
+        return false;
+    }
+
+    for (std::uint32_t i = 0; i < db->nStars; ++i)
+    {
+        AstroCatalog::IndexNumber catNo = db->stars[i].getIndex();
+        auto it = std::lower_bound(recordIndex.begin(), recordIndex.end(), catNo,
+                                   [&](const char* r, AstroCatalog::IndexNumber n) { return recordCatNo(r) < n; });
+        assert(it != recordIndex.end());
+        out.write(*it, sizeof(StarsDatRecord));
+    }
+
+    for (const auto& node : nodes)
+    {
+        if (!util::writeLE<float>(out, node.cellCenterPos.x()) ||
+            !util::writeLE<float>(out, node.cellCenterPos.y()) ||
+            !util::writeLE<float>(out, node.cellCenterPos.z()) ||
+            !util::writeLE<float>(out, node.exclusionFactor) ||
+            !util::writeLE<std::uint32_t>(out, node.firstObject) ||
+            !util::writeLE<std::uint32_t>(out, node.nObjects) ||
+            !util::writeLE<std::uint32_t>(out, node.childOffset))
+        {
+            return false;
+        }
+    }
+
+    for (std::uint32_t idx : db->catalogNumberIndex)
+    {
+        if (!util::writeLE<std::uint32_t>(out, idx))
+            return false;
+    }
+
+    if (hasMotion)
+    {
+        auto nMotions = static_cast<std::uint32_t>(motionRecords.size() / sizeof(StarsDatMotionRecord));
+        if (!util::writeLE<std::uint32_t>(out, nMotions))
+            return false;
+        out.write(motionRecords.data(), motionRecords.size());
+    }
+
+    return out.good();
+}
+
 /*! Load an STC file with star definitions. Each definition has the form:
  *
  *  [disposition] [object type] [catalog number] [name]
@@ -638,9 +1013,46 @@ StarDatabaseBuilder::loadBinary(std::istream& in)
 bool
 StarDatabaseBuilder::load(std::istream& in, const fs::path& resourcePath)
 {
-    Tokenizer tokenizer(&in);
-    Parser parser(&tokenizer);
+    return stage(in, resourcePath)->commit();
+}
+
+class StarDatabaseBuilder::Staged : public celestia::engine::StagedCatalog
+{
+public:
+    struct Entry
+    {
+        explicit Entry(const fs::path& path) : header(path) {}
+
+        StcHeader header;
+        Value starData;
+    };
+
+    Staged(StarDatabaseBuilder* _builder, const fs::path& _resourcePath) :
+        resourcePath(_resourcePath), builder(_builder)
+    {
+    }
+
+    // Entries of a catalog or a chunk of it, up to the first error
+    struct Chunk
+    {
+        std::vector<Entry> entries;
+        bool failed{ false };
+    };
+
+    bool commit() override;
+    void read(std::string_view text, int lineOffset, Chunk& chunk) const;
+
+    // The headers of the entries refer to this path
+    const fs::path resourcePath;
+    std::vector<Chunk> chunks;
 
+private:
+    StarDatabaseBuilder* builder;
+};
+
+bool
+StarDatabaseBuilder::Staged::commit()
+{
 #ifdef ENABLE_NLS
     std::string domain = resourcePath.string();
     const char *d = domain.c_str();
@@ -649,55 +1061,114 @@ StarDatabaseBuilder::load(std::istream& in, const fs::path& resourcePath)
     std::string domain;
 #endif
 
-    StcHeader header(resourcePath);
-    while (tokenizer.nextToken() != Tokenizer::TokenEnd)
+    for (Chunk& chunk : chunks)
     {
-        if (!parseStcHeader(tokenizer, header))
+        for (Entry& entry : chunk.entries)
+            builder->addStcEntry(entry.header, entry.starData.getHash(), domain);
+
+        // The chunks after an error are not used
+        if (chunk.failed)
             return false;
+    }
 
-        // now goes the star definition
-        tokenizer.pushBack();
-        const Value starDataValue = parser.readValue();
-        const Hash* starData = starDataValue.getHash();
-        if (starData == nullptr)
+    return true;
+}
+
+void
+StarDatabaseBuilder::Staged::read(std::string_view text, int lineOffset, Chunk& chunk) const
+{
+    std::istringstream textStream{ std::string(text) };
+    Tokenizer tokenizer(&textStream);
+    Parser parser(&tokenizer);
+
+    while (tokenizer.nextToken() != Tokenizer::TokenEnd)
+    {
+        Entry& entry = chunk.entries.emplace_back(resourcePath);
+        if (!readStcEntry(tokenizer, parser, entry.header, entry.starData, lineOffset))
         {
-            GetLogger()->error(_("Bad star definition at line {}.\n"), tokenizer.getLineNumber());
-            return false;
+            chunk.entries.pop_back();
+            chunk.failed = true;
+            break;
         }
+    }
+}
 
-        if (header.disposition != DataDisposition::Add && header.catalogNumber == AstroCatalog::InvalidIndex)
-            header.catalogNumber = starDB->namesDB->findCatalogNumberByName(header.names.front(), false);
+std::unique_ptr<celestia::engine::StagedCatalog>
+StarDatabaseBuilder::stage(std::istream& in, const fs::path& resourcePath)
+{
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = std::move(buffer).str();
 
-        Star* star = findWhileLoading(header.catalogNumber);
-        if (star == nullptr)
-        {
-            if (header.disposition == DataDisposition::Modify)
-            {
-                GetLogger()->error(_("Modify requested for nonexistent star.\n"));
-                continue;
-            }
+    auto staged = std::make_unique<Staged>(this, resourcePath);
 
-            if (header.catalogNumber == AstroCatalog::InvalidIndex)
-            {
-                header.catalogNumber = nextAutoCatalogNumber;
-                --nextAutoCatalogNumber;
-            }
-        }
+    std::vector<std::string_view> chunks;
+    std::unique_ptr<util::ThreadPool> pool;
+    if (text.size() >= ParallelLoadThreshold)
+    {
+        pool = std::make_unique<util::ThreadPool>();
+        chunks = SplitCatalog(text, text.size() / (pool->concurrency() * ChunksPerWorker) + 1);
+    }
+
+    if (chunks.size() <= 1)
+    {
+        staged->read(text, 0, staged->chunks.emplace_back());
+        return staged;
+    }
+
+    // Line numbers in messages are counted from the start of the file
+    std::vector<int> lineOffsets;
+    lineOffsets.reserve(chunks.size());
+    int lineOffset = 0;
+    for (std::string_view chunk : chunks)
+    {
+        lineOffsets.push_back(lineOffset);
+        lineOffset += static_cast<int>(std::count(chunk.begin(), chunk.end(), '\n'));
+    }
+
+    staged->chunks.resize(chunks.size());
+    pool->parallelFor(chunks.size(),
+                      [&](std::size_t task, unsigned int /* worker */)
+                      {
+                          staged->read(chunks[task], lineOffsets[task], staged->chunks[task]);
+                      });
+
+    return staged;
+}
 
-        if (createOrUpdateStar(header, starData, star))
+void
+StarDatabaseBuilder::addStcEntry(StcHeader& header, const AssociativeArray* starData, const std::string& domain)
+{
+    if (header.disposition != DataDisposition::Add && header.catalogNumber == AstroCatalog::InvalidIndex)
+        header.catalogNumber = starDB->namesDB->findCatalogNumberByName(header.names.front(), false);
+
+    Star* star = findWhileLoading(header.catalogNumber);
+    if (star == nullptr)
+    {
+        if (header.disposition == DataDisposition::Modify)
         {
-            loadCategories(header, starData, domain);
+            GetLogger()->error(_("Modify requested for nonexistent star.\n"));
+            return;
+        }
 
-            if (!header.names.empty())
-            {
-                starDB->namesDB->erase(header.catalogNumber);
-                for (const auto& name : header.names)
-                    starDB->namesDB->add(header.catalogNumber, name);
-            }
+        if (header.catalogNumber == AstroCatalog::InvalidIndex)
+        {
+            header.catalogNumber = nextAutoCatalogNumber;
+            --nextAutoCatalogNumber;
         }
     }
 
-    return true;
+    if (createOrUpdateStar(header, starData, star))
+    {
+        loadCategories(header, starData, domain);
+
+        if (!header.names.empty())
+        {
+            starDB->namesDB->erase(header.catalogNumber);
+            for (const auto& name : header.names)
+                starDB->namesDB->add(header.catalogNumber, name);
+        }
+    }
 }
 
 void
@@ -709,10 +1180,47 @@ StarDatabaseBuilder::setNameDatabase(std::unique_ptr<StarNameDatabase>&& nameDB)
 std::unique_ptr<StarDatabase>
 StarDatabaseBuilder::finish()
 {
-    GetLogger()->info(_("Total star count: {}\n"), unsortedStars.size());
+    if (presortedStars != nullptr && !presortedModified && unsortedStars.empty())
+    {
+        GetLogger()->info(_("Total star count: {}\n"), nPresortedStars);
+        starDB->nStars = nPresortedStars;
+        starDB->stars = std::move(presortedStars);
+        starDB->octreeNodes = std::move(presortedOctree);
+        starDB->catalogNumberIndex = std::move(presortedIndex);
+        starDB->cullingData.build(starDB->stars.get(), starDB->nStars, starDB->octreeNodes);
+    }
+    else
+    {
+        // The presorted octree no longer matches the stars, so start over
+        if (presortedStars != nullptr)
+        {
+            for (std::uint32_t i = 0; i < nPresortedStars; ++i)
+                unsortedStars.push_back(std::move(presortedStars[i]));
+            presortedStars.reset();
+            presortedOctree.clear();
+            presortedIndex.clear();
+        }
+
+        GetLogger()->info(_("Total star count: {}\n"), unsortedStars.size());
+
+        buildOctree();
+        buildIndexes();
+    }
+
+    // Lookups by catalog number are frequent enough (names, cross indices,
+    // scripts and the barycenters below) to replace the binary search of
+    // the index by a hash, falling back to the search if it can't be built
+    {
+        std::vector<std::uint32_t> keys;
+        keys.reserve(starDB->catalogNumberIndex.size());
+        for (std::uint32_t idx : starDB->catalogNumberIndex)
+            keys.push_back(starDB->stars[idx].getIndex());
+        if (!starDB->catalogNumberHash.build(keys))
+            GetLogger()->warn("Could not build the star catalog number hash\n");
+    }
 
-    buildOctree();
-    buildIndexes();
+    if (starDB->namesDB != nullptr)
+        starDB->namesDB->finish();
 
     // Resolve all barycenters; this can't be done before star sorting. There's
     // still a bug here: final orbital radii aren't available until after
@@ -732,12 +1240,27 @@ StarDatabaseBuilder::finish()
         }
     }
 
+    buildStarMotion();
+
     for (const auto& [catalogNumber, category] : categories)
     {
         Star* star = starDB->find(catalogNumber);
         UserCategory::addObject(star, category);
     }
 
+    // Custom details are complete now, so identical ones can be shared
+    StarDetailsPool detailsPool;
+    for (std::uint32_t i = 0; i < starDB->nStars; ++i)
+        detailsPool.intern(starDB->stars[i].details);
+
+    if (const auto& stats = detailsPool.getStatistics(); stats.lookups > 0)
+    {
+        GetLogger()->debug("Custom star details: {} distinct of {} ({:.1f}% shared), "
+                           "{} bytes in use, {} bytes saved\n",
+                           stats.entries, stats.lookups, stats.hitRatio() * 100.0,
+                           stats.bytes, stats.bytesSaved);
+    }
+
     return std::move(starDB);
 }
 
@@ -808,6 +1331,7 @@ StarDatabaseBuilder::createOrUpdateStar(const StcHeader& header,
         StarDetails::setOrbit(star->details, orbit);
 
     applyCustomDetails(header, starData, star->details);
+    presortedModified = true;
     return true;
 }
 
@@ -1016,25 +1540,88 @@ StarDatabaseBuilder::buildOctree()
     GetLogger()->debug("Sorting stars into octree . . .\n");
     float absMag = astro::appToAbsMag(STAR_OCTREE_MAGNITUDE,
                                       StarDatabase::STAR_OCTREE_ROOT_SIZE * celestia::numbers::sqrt3_v<float>);
-    auto root = std::make_unique<DynamicStarOctree>(Eigen::Vector3f(1000.0f, 1000.0f, 1000.0f),
-                                                    absMag);
+    DynamicStarOctree root(Eigen::Vector3f(1000.0f, 1000.0f, 1000.0f), absMag);
+    std::vector<const Star*> stars;
+    stars.reserve(unsortedStars.size());
     for (const Star& star : unsortedStars)
-        root->insertObject(star, StarDatabase::STAR_OCTREE_ROOT_SIZE);
+        stars.push_back(&star);
 
-    GetLogger()->debug("Spatially sorting stars for improved locality of reference . . .\n");
     auto sortedStars = std::make_unique<Star[]>(unsortedStars.size());
-    Star* firstStar = sortedStars.get();
-    root->rebuildAndSort(starDB->octreeRoot, firstStar);
+    root.buildAndSort(stars,
+                      StarDatabase::STAR_OCTREE_ROOT_SIZE,
+                      starDB->octreeNodes,
+                      sortedStars.get());
 
     GetLogger()->debug("{} stars total\nOctree has {} nodes and {} stars.\n",
-                       firstStar - sortedStars.get(),
-                       1 + starDB->octreeRoot->countChildren(), starDB->octreeRoot->countObjects());
+                       stars.size(),
+                       starDB->octreeNodes.size(), starDB->octreeNodes.front().countObjects());
 
     starDB->nStars = static_cast<std::uint32_t>(unsortedStars.size());
     starDB->stars = std::move(sortedStars);
+    starDB->cullingData.build(starDB->stars.get(), starDB->nStars, starDB->octreeNodes);
     unsortedStars.clear();
 }
 
+void
+StarDatabaseBuilder::buildStarMotion()
+{
+    // Must be called after the barycenters are resolved
+    if (starVelocities.empty())
+        return;
+
+    const Star* stars = starDB->stars.get();
+    std::vector<StarDatabase::StarMotion> motions;
+    motions.reserve(starVelocities.size());
+    for (const auto& [catalogNumber, velocity] : starVelocities)
+    {
+        if (const Star* star = starDB->find(catalogNumber); star != nullptr && star < stars + starDB->nStars)
+        {
+            motions.push_back({ static_cast<std::uint32_t>(star - stars), star->getPosition(), velocity });
+        }
+    }
+
+    starVelocities.clear();
+    starVelocities.shrink_to_fit();
+
+    // Stars in orbits are placed at the root barycenter of their system, so
+    // they move with it, whatever their own motion.
+    std::sort(motions.begin(), motions.end(),
+              [](const auto& m0, const auto& m1) { return m0.starIndex < m1.starIndex; });
+    auto findMotion = [&motions](std::uint32_t starIndex) -> const Eigen::Vector3f*
+    {
+        auto it = std::lower_bound(motions.begin(), motions.end(), starIndex,
+                                   [](const auto& m, std::uint32_t idx) { return m.starIndex < idx; });
+        return it != motions.end() && it->starIndex == starIndex ? &it->velocity : nullptr;
+    };
+
+    std::vector<StarDatabase::StarMotion> orbitingMotions;
+    for (std::uint32_t i = 0; i < starDB->nStars; ++i)
+    {
+        const Star* root = stars[i].getOrbitBarycenter();
+        if (root == nullptr)
+            continue;
+        while (root->getOrbitBarycenter() != nullptr)
+            root = root->getOrbitBarycenter();
+
+        if (root < stars || root >= stars + starDB->nStars)
+            continue;
+        if (const Eigen::Vector3f* velocity = findMotion(static_cast<std::uint32_t>(root - stars)); velocity != nullptr)
+            orbitingMotions.push_back({ i, stars[i].getPosition(), *velocity });
+    }
+
+    for (const auto& motion : orbitingMotions)
+    {
+        auto it = std::lower_bound(motions.begin(), motions.end(), motion.starIndex,
+                                   [](const auto& m, std::uint32_t idx) { return m.starIndex < idx; });
+        if (it != motions.end() && it->starIndex == motion.starIndex)
+            it->velocity = motion.velocity;
+        else
+            motions.insert(it, motion);
+    }
+
+    starDB->buildStarMotion(std::move(motions));
+}
+
 void
 StarDatabaseBuilder::buildIndexes()
 {
@@ -10,11 +10,14 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <iosfwd>
 #include <map>
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <Eigen/Core>
@@ -25,8 +28,10 @@
 #include "category.h"
 #include "parseobject.h"
 #include "star.h"
+#include "stagedcatalog.h"
 #include "stardb.h"
 #include "starname.h"
+#include "staroctree.h"
 
 class AssociativeArray;
 class StarDatabase;
@@ -48,7 +53,15 @@ public:
     StarDatabaseBuilder& operator=(StarDatabaseBuilder&&) noexcept = delete;
 
     bool load(std::istream&, const fs::path& resourcePath = fs::path());
+    // Reads an stc file without changing the database, so that it can be
+    // called from any thread; committing the result adds the stars.
+    std::unique_ptr<celestia::engine::StagedCatalog> stage(std::istream&,
+                                                           const fs::path& resourcePath = fs::path());
     bool loadBinary(std::istream&);
+    bool loadSortedBinary(const char* data, std::size_t size);
+
+    static bool isSortedBinary(const char* data, std::size_t size);
+    static bool writeSortedBinary(std::istream& in, std::ostream& out);
 
     void setNameDatabase(std::unique_ptr<StarNameDatabase>&&);
 
@@ -57,6 +70,9 @@ public:
     struct StcHeader;
 
 private:
+    class Staged;
+
+    void addStcEntry(StcHeader&, const AssociativeArray*, const std::string&);
     bool createOrUpdateStar(const StcHeader&, const AssociativeArray*, Star*);
     bool checkStcPosition(const StcHeader&,
                           const AssociativeArray*,
@@ -76,19 +92,33 @@ private:
                      const std::string& name,
                      const std::string& domain);
 
+    void addStarMotions(const char* records, std::uint32_t nRecords);
+
     void buildOctree();
     void buildIndexes();
+    void buildStarMotion();
     Star* findWhileLoading(AstroCatalog::IndexNumber catalogNumber) const;
 
     std::unique_ptr<StarDatabase> starDB{ std::make_unique<StarDatabase>() };
 
     AstroCatalog::IndexNumber nextAutoCatalogNumber{ 0xfffffffe };
 
+    // Stars, octree and catalog number index read from a presorted star
+    // database. They are only used as they are if no stc file changes them.
+    std::unique_ptr<Star[]> presortedStars;
+    std::uint32_t nPresortedStars{ 0 };
+    std::vector<StarOctree> presortedOctree;
+    std::vector<std::uint32_t> presortedIndex;
+    bool presortedModified{ false };
+
     BlockArray<Star> unsortedStars;
     // List of stars loaded from binary file, sorted by catalog number
     std::vector<Star*> binFileCatalogNumberIndex;
     // Catalog number -> star mapping for stars loaded from stc files
     std::map<AstroCatalog::IndexNumber, Star*> stcFileCatalogNumberIndex;
     std::map<AstroCatalog::IndexNumber, AstroCatalog::IndexNumber> barycenters;
+    // Velocities of the stars in the binary database that move, in light
+    // years per Julian year
+    std::vector<std::pair<AstroCatalog::IndexNumber, Eigen::Vector3f>> starVelocities;
     std::multimap<AstroCatalog::IndexNumber, UserCategoryId> categories;
 };
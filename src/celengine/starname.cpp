@@ -30,6 +30,7 @@
 #include <celutil/gettext.h>
 #include <celutil/greek.h>
 #include <celutil/logger.h>
+#include <celutil/memoryusage.h>
 #include <celutil/timer.h>
 #include "astroobj.h"
 #include "constellation.h"
@@ -331,6 +332,14 @@ StarNameDatabase::searchCrossIndexForCatalogNumber(StarCatalog catalog, AstroCat
         return AstroCatalog::InvalidIndex;
 
     const CrossIndex& xindex = crossIndices[catalogIndex];
+    if (const auto& hash = catalogNumberHashes[catalogIndex]; !hash.empty())
+    {
+        std::uint32_t pos = hash.find(number);
+        return pos == celestia::util::PerfectHashIndex::NotFound
+            ? AstroCatalog::InvalidIndex
+            : xindex[pos].celCatalogNumber;
+    }
+
     auto iter = std::lower_bound(xindex.begin(), xindex.end(), number,
                                  [](const CrossIndexEntry& ent, AstroCatalog::IndexNumber n) { return ent.catalogNumber < n; });
     return iter == xindex.end() || iter->catalogNumber != number
@@ -346,9 +355,15 @@ StarNameDatabase::crossIndex(StarCatalog catalog, AstroCatalog::IndexNumber celC
         return AstroCatalog::InvalidIndex;
 
     const CrossIndex& xindex = crossIndices[catalogIndex];
+    if (const auto& hash = celCatalogNumberHashes[catalogIndex]; !hash.empty())
+    {
+        std::uint32_t pos = hash.find(celCatalogNumber);
+        return pos == celestia::util::PerfectHashIndex::NotFound
+            ? AstroCatalog::InvalidIndex
+            : xindex[pos].catalogNumber;
+    }
 
-    // A simple linear search.  We could store cross indices sorted by
-    // both catalog numbers and trade memory for speed
+    // Only reached if the hash couldn't be built
     auto iter = std::find_if(xindex.begin(), xindex.end(),
                              [celCatalogNumber](const CrossIndexEntry& o) { return celCatalogNumber == o.celCatalogNumber; });
     return iter == xindex.end()
@@ -507,11 +522,21 @@ StarNameDatabase::findWithComponentSuffix(std::string_view name, bool i18n) cons
 
 std::unique_ptr<StarNameDatabase>
 StarNameDatabase::readNames(std::istream& in)
+{
+    auto db = std::make_unique<StarNameDatabase>();
+    if (!parseNames(in, [&db](AstroCatalog::IndexNumber catalogNumber, std::string_view name) { db->add(catalogNumber, name); }))
+        return nullptr;
+
+    return db;
+}
+
+bool
+StarNameDatabase::parseNames(std::istream& in,
+                             const std::function<void(AstroCatalog::IndexNumber, std::string_view)>& addName)
 {
     using compat::from_chars;
 
     constexpr std::size_t maxLength = 1024;
-    auto db = std::make_unique<StarNameDatabase>();
     std::string buffer(maxLength, '\0');
     while (!in.eof())
     {
@@ -524,7 +549,7 @@ StarNameDatabase::readNames(std::istream& in)
         else if (in.eof())
             lineLength = static_cast<std::size_t>(in.gcount());
         else
-            return nullptr;
+            return false;
 
         auto line = static_cast<std::string_view>(buffer).substr(0, lineLength);
 
@@ -533,13 +558,13 @@ StarNameDatabase::readNames(std::istream& in)
 
         auto pos = line.find(':');
         if (pos == std::string_view::npos)
-            return nullptr;
+            return false;
 
         auto catalogNumber = AstroCatalog::InvalidIndex;
         if (auto [ptr, ec] = from_chars(line.data(), line.data() + pos, catalogNumber);
             ec != std::errc{} || ptr != line.data() + pos)
         {
-            return nullptr;
+            return false;
         }
 
         // Iterate through the string for names delimited
@@ -550,30 +575,88 @@ StarNameDatabase::readNames(std::istream& in)
         {
             pos = line.find(':');
             std::string_view name = line.substr(0, pos);
-            db->add(catalogNumber, name);
+            addName(catalogNumber, name);
             if (pos == std::string_view::npos)
                 break;
             line = line.substr(pos + 1);
         }
     }
 
-    return db;
+    return true;
 }
 
 bool
 StarNameDatabase::loadCrossIndex(StarCatalog catalog, std::istream& in)
 {
-    Timer timer{};
-
     auto catalogIndex = static_cast<std::size_t>(catalog);
     if (catalogIndex >= crossIndices.size())
         return false;
 
-    if (!checkCrossIndexHeader(in))
-        return false;
+    bool result = readCrossIndex(in, crossIndices[catalogIndex]);
+    buildCrossIndexHashes(catalogIndex);
+    return result;
+}
+
+void
+StarNameDatabase::setCrossIndex(StarCatalog catalog, CrossIndex&& xindex)
+{
+    auto catalogIndex = static_cast<std::size_t>(catalog);
+    if (catalogIndex >= crossIndices.size())
+        return;
+
+    crossIndices[catalogIndex] = std::move(xindex);
+    buildCrossIndexHashes(catalogIndex);
+}
+
+std::size_t
+StarNameDatabase::getMemoryUsage() const
+{
+    std::size_t size = NameDatabase::getMemoryUsage();
+    for (std::size_t i = 0; i < NumCatalogs; ++i)
+    {
+        size += celestia::util::MemoryUsage(crossIndices[i]);
+        size += catalogNumberHashes[i].memoryUsage();
+        size += celCatalogNumberHashes[i].memoryUsage();
+    }
+
+    return size;
+}
+
+// Both directions of a cross index are looked up by hash; where a number
+// occurs more than once, the first entry in catalog number order is used as
+// with the searches. If either hash fails, both searches are used instead.
+void
+StarNameDatabase::buildCrossIndexHashes(std::size_t catalogIndex)
+{
+    const CrossIndex& xindex = crossIndices[catalogIndex];
+    std::vector<std::uint32_t> keys;
+    keys.reserve(xindex.size());
+
+    for (const CrossIndexEntry& entry : xindex)
+        keys.push_back(entry.catalogNumber);
+    bool built = catalogNumberHashes[catalogIndex].build(keys);
+
+    keys.clear();
+    for (const CrossIndexEntry& entry : xindex)
+        keys.push_back(entry.celCatalogNumber);
+    built = celCatalogNumberHashes[catalogIndex].build(keys) && built;
+
+    if (!built)
+    {
+        GetLogger()->error("Could not build the hash of a cross index\n");
+        catalogNumberHashes[catalogIndex].clear();
+        celCatalogNumberHashes[catalogIndex].clear();
+    }
+}
+
+bool
+StarNameDatabase::readCrossIndex(std::istream& in, CrossIndex& xindex)
+{
+    Timer timer{};
 
-    CrossIndex& xindex = crossIndices[catalogIndex];
     xindex = {};
+    if (!checkCrossIndexHeader(in))
+        return false;
 
     constexpr std::uint32_t BUFFER_RECORDS = UINT32_C(4096) / sizeof(CrossIndexRecord);
     std::vector<char> buffer(sizeof(CrossIndexRecord) * BUFFER_RECORDS);
@@ -15,11 +15,13 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <iosfwd>
 #include <memory>
 #include <string_view>
 
 #include <celengine/name.h>
+#include <celutil/perfecthash.h>
 
 enum class StarCatalog : unsigned int
 {
@@ -39,10 +41,10 @@ public:
     using NameDatabase::add;
     using NameDatabase::erase;
 
-    using NameDatabase::getFirstNameIter;
-    using NameDatabase::getFinalNameIter;
+    using NameDatabase::getNames;
 
     using NameDatabase::getCompletion;
+    using NameDatabase::finish;
 
     // We don't want users to access the getCatalogMethodByName method on the
     // NameDatabase base class, so use private inheritance to enforce usage of
@@ -52,12 +54,6 @@ public:
     AstroCatalog::IndexNumber searchCrossIndexForCatalogNumber(StarCatalog, AstroCatalog::IndexNumber number) const;
     AstroCatalog::IndexNumber crossIndex(StarCatalog, AstroCatalog::IndexNumber number) const;
 
-    bool loadCrossIndex(StarCatalog, std::istream&);
-    static std::unique_ptr<StarNameDatabase> readNames(std::istream&);
-
-private:
-    static constexpr auto NumCatalogs = static_cast<std::size_t>(StarCatalog::_CatalogCount);
-
     struct CrossIndexEntry
     {
         AstroCatalog::IndexNumber catalogNumber;
@@ -66,6 +62,24 @@ private:
 
     using CrossIndex = std::vector<CrossIndexEntry>;
 
+    bool loadCrossIndex(StarCatalog, std::istream&);
+    // Reads a cross index file without a database, so that it can be done
+    // on another thread and installed with setCrossIndex afterwards. The
+    // index is left empty on errors.
+    static bool readCrossIndex(std::istream&, CrossIndex&);
+    void setCrossIndex(StarCatalog, CrossIndex&&);
+
+    // Bytes of heap memory used by the names and cross indices
+    std::size_t getMemoryUsage() const;
+    static std::unique_ptr<StarNameDatabase> readNames(std::istream&);
+    // Reads a star names file without building a database, passing each
+    // name to addName in the order of the file. Returns false on errors.
+    static bool parseNames(std::istream&,
+                           const std::function<void(AstroCatalog::IndexNumber, std::string_view)>& addName);
+
+private:
+    static constexpr auto NumCatalogs = static_cast<std::size_t>(StarCatalog::_CatalogCount);
+
     AstroCatalog::IndexNumber findByName(std::string_view, bool) const;
     AstroCatalog::IndexNumber findFlamsteedOrVariable(std::string_view, std::string_view, bool) const;
     AstroCatalog::IndexNumber findBayer(std::string_view, std::string_view, bool) const;
@@ -79,6 +93,10 @@ private:
                                                   std::string_view,
                                                   bool) const;
     AstroCatalog::IndexNumber findWithComponentSuffix(std::string_view, bool) const;
+    void buildCrossIndexHashes(std::size_t catalogIndex);
 
     std::array<CrossIndex, NumCatalogs> crossIndices;
+    // Positions of the cross index entries by either catalog number
+    std::array<celestia::util::PerfectHashIndex, NumCatalogs> catalogNumberHashes;
+    std::array<celestia::util::PerfectHashIndex, NumCatalogs> celCatalogNumberHashes;
 };
@@ -11,20 +11,105 @@
 // of the License, or (at your option) any later version.
 
 #include <celengine/staroctree.h>
+#include <celengine/staroctreetraversal.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include <celcompat/numbers.h>
 
 using namespace Eigen;
 
 namespace astro = celestia::astro;
 
-// Maximum permitted orbital radius for stars, in light years. Orbital
-// radii larger than this value are not guaranteed to give correct
-// results. The problem case is extremely faint stars (such as brown
-// dwarfs.) The distance from the viewer to star's barycenter is used
-// rough estimate of the brightness for the purpose of culling. When the
-// star is very faint, this estimate may not work when the star is
-// far from the barycenter. Thus, the star octree traversal will always
-// render stars with orbits that are closer than MAX_STAR_ORBIT_RADIUS.
-static const float MAX_STAR_ORBIT_RADIUS = 1.0f;
+void
+StarCullingData::build(const Star* stars, std::uint32_t nStars, const std::vector<StarOctree>& nodes)
+{
+    // The padding can never pass the magnitude test, and lets the culling
+    // loop read whole blocks at the end of the arrays.
+    constexpr std::size_t padding = StarOctreeTraversal::CullingBlockSize - 1;
+
+    firstStar = stars;
+    x.assign(nStars + padding, 0.0f);
+    y.assign(nStars + padding, 0.0f);
+    z.assign(nStars + padding, 0.0f);
+    absMag.assign(nStars + padding, std::numeric_limits<float>::infinity());
+
+    bool hasExtinction = false;
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        const Vector3f& position = stars[i].getPosition();
+        x[i] = position.x();
+        y[i] = position.y();
+        z[i] = position.z();
+        absMag[i] = stars[i].getAbsoluteMagnitude();
+        hasExtinction = hasExtinction || stars[i].getExtinction() != 0.0f;
+    }
+
+    // Only stars from .stc files may have an extinction, so the array is
+    // usually left out.
+    extinction.clear();
+    extinction.shrink_to_fit();
+    if (hasExtinction)
+    {
+        extinction.assign(nStars + padding, 0.0f);
+        for (std::uint32_t i = 0; i < nStars; ++i)
+            extinction[i] = stars[i].getExtinction();
+    }
+
+    struct Sums
+    {
+        double luminosity{ 0.0 };
+        Vector3d position{ Vector3d::Zero() };
+        double temperature{ 0.0 };
+    };
+
+    // Children are always stored after their parent, so visiting the nodes
+    // backwards completes each subtree before it is added to its parent.
+    std::vector<Sums> sums(nodes.size());
+    firstNode = nodes.data();
+    aggregates.resize(nodes.size());
+    for (std::size_t n = nodes.size(); n-- > 0;)
+    {
+        const StarOctree& node = nodes[n];
+        Sums& nodeSums = sums[n];
+        for (unsigned int i = 0; i < node.nObjects; ++i)
+        {
+            const Star& star = node._firstObject[i];
+            double lum = astro::absMagToLum(star.getAbsoluteMagnitude());
+            nodeSums.luminosity += lum;
+            nodeSums.position += lum * star.getPosition().cast<double>();
+            nodeSums.temperature += lum * star.getTemperature();
+        }
+
+        if (node.hasChildren())
+        {
+            for (unsigned int i = 0; i < 8; ++i)
+            {
+                const Sums& childSums = sums[n + node.childOffset + i];
+                nodeSums.luminosity += childSums.luminosity;
+                nodeSums.position += childSums.position;
+                nodeSums.temperature += childSums.temperature;
+            }
+        }
+
+        StarNodeAggregate& aggregate = aggregates[n];
+        if (nodeSums.luminosity > 0.0)
+        {
+            aggregate.centroid = (nodeSums.position / nodeSums.luminosity).cast<float>();
+            aggregate.temperature = static_cast<float>(nodeSums.temperature / nodeSums.luminosity);
+            aggregate.absMag = astro::lumToAbsMag(static_cast<float>(nodeSums.luminosity));
+        }
+        else
+        {
+            aggregate.centroid = node.cellCenterPos;
+            aggregate.temperature = 0.0f;
+            aggregate.absMag = std::numeric_limits<float>::infinity();
+        }
+    }
+}
 
 
 // The octree node into which a star is placed is dependent on two properties:
@@ -59,8 +144,8 @@ float starAbsoluteMagnitudeDecayFunction(const float excludingFactor)
 
 
 template<>
-DynamicStarOctree* DynamicStarOctree::getChild(const Star&          obj,
-                                               const Vector3f& cellCenterPos)
+int DynamicStarOctree::getChildIndex(const Star&     obj,
+                                     const Vector3f& cellCenterPos)
 {
     Vector3f objPos    = obj.getPosition();
 
@@ -69,7 +154,7 @@ DynamicStarOctree* DynamicStarOctree::getChild(const Star&          obj,
     child     |= objPos.y() < cellCenterPos.y() ? 0 : YPos;
     child     |= objPos.z() < cellCenterPos.z() ? 0 : ZPos;
 
-    return _children[child];
+    return child;
 }
 
 
@@ -87,62 +172,89 @@ template<> DynamicStarOctree::ExclusionFactorDecayFunction*
 
 // total specialization of the StaticOctree template process*() methods for stars:
 template<>
-void StarOctree::processVisibleObjects(StarHandler&    processor,
-                                       const Vector3f& obsPosition,
-                                       const Hyperplane<float, 3>*   frustumPlanes,
-                                       float           limitingFactor,
-                                       float           scale) const
+bool StarOctree::processNodeObjects(StarHandler&    processor,
+                                    const Vector3f& obsPosition,
+                                    const Hyperplane<float, 3>*   frustumPlanes,
+                                    float           limitingFactor,
+                                    float           scale,
+                                    const StarCullingData* cullingData) const
 {
-    // See if this node lies within the view frustum
+    return StarOctreeTraversal::processNodeObjects(*this, processor, obsPosition, frustumPlanes,
+                                                   limitingFactor, scale, cullingData);
+}
+
 
-    // Test the cubic octree node against each one of the five
-    // planes that define the infinite view frustum.
-    for (unsigned int i = 0; i < 5; ++i)
+template<>
+void StarOctree::collectVisibleNodes(std::vector<NodeListEntry>&  nodes,
+                                     const Vector3f&              obsPosition,
+                                     const Hyperplane<float, 3>*  frustumPlanes,
+                                     float                        limitingFactor,
+                                     float                        scale,
+                                     float                        distanceMargin) const
+{
+    for (unsigned int i = 0; i < 4; ++i)
     {
         const Hyperplane<float, 3>& plane = frustumPlanes[i];
-        float r = scale * plane.normal().cwiseAbs().sum();
+        float r = scale * plane.normal().cwiseAbs().sum() + boundsMargin + distanceMargin;
         if (plane.signedDistance(cellCenterPos) < -r)
             return;
     }
 
-    // Compute the distance to node; this is equal to the distance to
-    // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
-    float minDistance = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3;
+    auto index = nodes.size();
+    nodes.push_back({ this, scale, 0 });
 
-    // Process the objects in this node
-    float dimmest = minDistance > 0 ? astro::appToAbsMag(limitingFactor, minDistance) : 1000;
-
-    for (unsigned int i=0; i<nObjects; ++i)
+    float minDistance = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3
+                      - boundsMargin - distanceMargin;
+    if (hasChildren() &&
+        (minDistance <= 0 || astro::absToAppMag(exclusionFactor, minDistance) <= limitingFactor))
     {
-        const Star& obj = _firstObject[i];
-
-        if (obj.getAbsoluteMagnitude() < dimmest)
+        for (int i=0; i<8; ++i)
         {
-            float distance    = (obsPosition - obj.getPosition()).norm();
-            float appMag      = obj.getApparentMagnitude(distance);
-
-            if (appMag < limitingFactor || (distance < MAX_STAR_ORBIT_RADIUS && obj.getOrbit()))
-                processor.process(obj, distance, appMag);
+            child(i)->collectVisibleNodes(nodes,
+                                          obsPosition,
+                                          frustumPlanes,
+                                          limitingFactor,
+                                          scale * 0.5f,
+                                          distanceMargin);
         }
     }
 
-    // See if any of the objects in child nodes are potentially included
-    // that we need to recurse deeper.
-    if (minDistance <= 0 || astro::absToAppMag(exclusionFactor, minDistance) <= limitingFactor)
-    {
-        // Recurse into the child nodes
-        if (_children != nullptr)
-        {
-            for (int i=0; i<8; ++i)
-            {
-                _children[i]->processVisibleObjects(processor,
-                                                    obsPosition,
-                                                    frustumPlanes,
-                                                    limitingFactor,
-                                                    scale * 0.5f);
-            }
-        }
-    }
+    nodes[index].end = static_cast<std::uint32_t>(nodes.size());
+}
+
+
+template<>
+void StarOctree::processVisibleObjects(StarHandler&    processor,
+                                       const Vector3f& obsPosition,
+                                       const Hyperplane<float, 3>*   frustumPlanes,
+                                       float           limitingFactor,
+                                       float           scale,
+                                       unsigned int    maxDepth,
+                                       std::vector<Subtree>& subtrees,
+                                       const StarCullingData* cullingData) const
+{
+    StarOctreeTraversal::processVisibleObjects(*this, processor, obsPosition, frustumPlanes,
+                                               limitingFactor, scale, maxDepth, subtrees, cullingData);
+}
+
+
+template<>
+void StarOctree::processVisibleObjects(StarHandler&    processor,
+                                       const Vector3f& obsPosition,
+                                       const Hyperplane<float, 3>*   frustumPlanes,
+                                       float           limitingFactor,
+                                       float           scale) const
+{
+    // With an unlimited depth no subtrees are ever handed back.
+    std::vector<Subtree> subtrees;
+    processVisibleObjects(processor,
+                          obsPosition,
+                          frustumPlanes,
+                          limitingFactor,
+                          scale,
+                          std::numeric_limits<unsigned int>::max(),
+                          subtrees,
+                          nullptr);
 }
 
 
@@ -152,43 +264,42 @@ void StarOctree::processCloseObjects(StarHandler&    processor,
                                      float           boundingRadius,
                                      float           scale) const
 {
-    // Compute the distance to node; this is equal to the distance to
-    // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
-    float nodeDistance    = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3;
-
-    if (nodeDistance > boundingRadius)
-        return;
+    StarOctreeTraversal::processCloseObjects(*this, processor, obsPosition, boundingRadius, scale);
+}
 
-    // At this point, we've determined that the cellCenterPos of the node is
-    // close enough that we must check individual objects for proximity.
 
-    // Compute distance squared to avoid having to sqrt for distance
-    // comparison.
-    float radiusSquared    = boundingRadius * boundingRadius;
+template<>
+void StarOctree::processVisibleNodes(std::vector<ObjectRange>&    ranges,
+                                     const Star*                  firstObject,
+                                     const Vector3f&              obsPosition,
+                                     const Hyperplane<float, 3>*  frustumPlanes,
+                                     float                        limitingFactor,
+                                     float                        scale) const
+{
+    if (!StarOctreeTraversal::isInFrustum(frustumPlanes, cellCenterPos, scale, boundsMargin))
+        return;
 
-    // Check all the objects in the node.
-    for (unsigned int i = 0; i < nObjects; ++i)
+    if (nObjects != 0)
     {
-        Star& obj = _firstObject[i];
-
-        if ((obsPosition - obj.getPosition()).squaredNorm() < radiusSquared)
-        {
-            float distance    = (obsPosition - obj.getPosition()).norm();
-            float appMag      = obj.getApparentMagnitude(distance);
-
-            processor.process(obj, distance, appMag);
-        }
+        auto first = static_cast<std::uint32_t>(_firstObject - firstObject);
+        if (!ranges.empty() && ranges.back().first + ranges.back().count == first)
+            ranges.back().count += nObjects;
+        else
+            ranges.push_back({ first, nObjects });
     }
 
-    // Recurse into the child nodes
-    if (_children != nullptr)
+    float minDistance = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3 - boundsMargin;
+    if (hasChildren() &&
+        (minDistance <= 0 || astro::absToAppMag(exclusionFactor, minDistance) <= limitingFactor))
     {
         for (int i = 0; i < 8; ++i)
         {
-            _children[i]->processCloseObjects(processor,
-                                              obsPosition,
-                                              boundingRadius,
-                                              scale * 0.5f);
+            child(i)->processVisibleNodes(ranges,
+                                          firstObject,
+                                          obsPosition,
+                                          frustumPlanes,
+                                          limitingFactor,
+                                          scale * 0.5f);
         }
     }
 }
@@ -12,6 +12,9 @@
 
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #include <celengine/star.h>
 #include <celengine/octree.h>
 
@@ -19,3 +22,38 @@
 typedef DynamicOctree  <Star, float> DynamicStarOctree;
 typedef StaticOctree   <Star, float> StarOctree;
 typedef OctreeProcessor<Star, float> StarHandler;
+
+template<>
+struct OctreeNodeAggregate<Star, float>
+{
+    // Luminosity weighted mean position and temperature of the stars.
+    Eigen::Vector3f centroid;
+    float temperature;
+    // Absolute magnitude of the combined luminosity of the stars.
+    float absMag;
+};
+
+typedef OctreeNodeAggregate<Star, float> StarNodeAggregate;
+
+template<>
+struct OctreeCullingData<Star, float>
+{
+    void build(const Star* stars, std::uint32_t nStars, const std::vector<StarOctree>& nodes);
+
+    // Hot star fields in sorted star order, padded at the end so that the
+    // culling loop can read blocks past the last star. extinction is empty
+    // if no star has any.
+    const Star* firstStar{ nullptr };
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> absMag;
+    std::vector<float> extinction;
+
+    // Aggregates of the subtree rooted at each node, in node array order.
+    // Empty subtrees have an infinite absolute magnitude.
+    const StarOctree* firstNode{ nullptr };
+    std::vector<StarNodeAggregate> aggregates;
+};
+
+typedef OctreeCullingData<Star, float> StarCullingData;
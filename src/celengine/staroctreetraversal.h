@@ -0,0 +1,381 @@
+// staroctreetraversal.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Star octree traversals with the handler type known at compile time.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celastro/astro.h>
+#include <celcompat/numbers.h>
+#include <celengine/stardb.h>
+#include <celengine/staroctree.h>
+
+// The star octree traversals, written once for any handler type. The
+// StarOctree member functions instantiate them with StarHandler, so every
+// star goes through a virtual call; callers which know the concrete class
+// of their handler, and declare it final, can instantiate them with it
+// instead so that the per-star calls are direct.
+template<>
+struct OctreeTraversal<Star, float>
+{
+    // Maximum permitted orbital radius for stars, in light years. Orbital
+    // radii larger than this value are not guaranteed to give correct
+    // results. The problem case is extremely faint stars (such as brown
+    // dwarfs.) The distance from the viewer to star's barycenter is used
+    // rough estimate of the brightness for the purpose of culling. When the
+    // star is very faint, this estimate may not work when the star is
+    // far from the barycenter. Thus, the star octree traversal will always
+    // render stars with orbits that are closer than MaxStarOrbitRadius.
+    static constexpr float MaxStarOrbitRadius = 1.0f;
+
+    // Number of stars tested at once by the vectorized culling loop.
+    static constexpr unsigned int CullingBlockSize = 16;
+    using CullingBlock = Eigen::Array<float, CullingBlockSize, 1>;
+
+    // Test the cubic octree node, grown by margin, against each one of the
+    // five planes that define the infinite view frustum.
+    static bool isInFrustum(const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                            const Eigen::Vector3f&             cellCenterPos,
+                            float                              scale,
+                            float                              margin)
+    {
+        for (unsigned int i = 0; i < 5; ++i)
+        {
+            const Eigen::Hyperplane<float, 3>& plane = frustumPlanes[i];
+            float r = scale * plane.normal().cwiseAbs().sum() + margin;
+            if (plane.signedDistance(cellCenterPos) < -r)
+                return false;
+        }
+
+        return true;
+    }
+
+    // Test a block of up to CullingBlockSize consecutive stars from the
+    // packed culling data. This is equivalent to the per-star test in
+    // processNodeObjects, except that distances and apparent magnitudes are
+    // computed for all the stars of the block, which the compiler can do
+    // several at a time. The arrays are padded so that a block may always be
+    // read in full; only the first count stars are passed on.
+    template<typename Handler>
+    static void processVisibleBlock(Handler&               processor,
+                                    const StarCullingData& cullingData,
+                                    std::size_t            first,
+                                    unsigned int           count,
+                                    const Eigen::Vector3f& obsPosition,
+                                    float                  dimmest,
+                                    float                  limitingFactor);
+
+    template<typename Handler>
+    static bool processNodeObjects(const StarOctree&                  node,
+                                   Handler&                           processor,
+                                   const Eigen::Vector3f&             obsPosition,
+                                   const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                                   float                              limitingFactor,
+                                   float                              scale,
+                                   const StarCullingData*             cullingData);
+
+    template<typename Handler>
+    static void processVisibleObjects(const StarOctree&                  node,
+                                      Handler&                           processor,
+                                      const Eigen::Vector3f&             obsPosition,
+                                      const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                                      float                              limitingFactor,
+                                      float                              scale,
+                                      unsigned int                       maxDepth,
+                                      std::vector<StarOctree::Subtree>&  subtrees,
+                                      const StarCullingData*             cullingData);
+
+    template<typename Handler>
+    static void processCloseObjects(const StarOctree&      node,
+                                    Handler&               processor,
+                                    const Eigen::Vector3f& obsPosition,
+                                    float                  boundingRadius,
+                                    float                  scale);
+};
+
+using StarOctreeTraversal = OctreeTraversal<Star, float>;
+
+
+template<typename Handler>
+void
+StarOctreeTraversal::processVisibleBlock(Handler&               processor,
+                                         const StarCullingData& cullingData,
+                                         std::size_t            first,
+                                         unsigned int           count,
+                                         const Eigen::Vector3f& obsPosition,
+                                         float                  dimmest,
+                                         float                  limitingFactor)
+{
+    Eigen::Map<const CullingBlock> absMag(cullingData.absMag.data() + first);
+    if ((absMag >= dimmest).all())
+        return;
+
+    Eigen::Map<const CullingBlock> x(cullingData.x.data() + first);
+    Eigen::Map<const CullingBlock> y(cullingData.y.data() + first);
+    Eigen::Map<const CullingBlock> z(cullingData.z.data() + first);
+
+    CullingBlock distance = ((x - obsPosition.x()).square() +
+                             (y - obsPosition.y()).square() +
+                             (z - obsPosition.z()).square()).sqrt();
+
+    // astro::absToAppMag, using the natural logarithm, which unlike log10 is
+    // vectorized by Eigen.
+    constexpr float magScale = 5.0f / celestia::numbers::ln10_v<float>;
+    CullingBlock appMag = absMag - 5.0f
+                        + magScale * (distance * (1.0f / celestia::astro::LY_PER_PARSEC<float>)).log();
+    if (!cullingData.extinction.empty())
+        appMag += Eigen::Map<const CullingBlock>(cullingData.extinction.data() + first) * distance;
+
+    Eigen::Array<bool, CullingBlockSize, 1> candidates = (absMag < dimmest) &&
+                                                         (appMag < limitingFactor || distance < MaxStarOrbitRadius);
+    if (count < CullingBlockSize)
+        candidates = candidates && (CullingBlock::LinSpaced(0.0f, CullingBlockSize - 1.0f) < static_cast<float>(count));
+    if (!candidates.any())
+        return;
+
+    for (unsigned int j = 0; j < CullingBlockSize; ++j)
+    {
+        if (!candidates.coeff(j))
+            continue;
+
+        const Star& obj = cullingData.firstStar[first + j];
+        if (appMag.coeff(j) < limitingFactor || obj.getOrbit())
+            processor.process(obj, distance.coeff(j), appMag.coeff(j));
+    }
+}
+
+
+template<typename Handler>
+bool
+StarOctreeTraversal::processNodeObjects(const StarOctree&                  node,
+                                        Handler&                           processor,
+                                        const Eigen::Vector3f&             obsPosition,
+                                        const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                                        float                              limitingFactor,
+                                        float                              scale,
+                                        const StarCullingData*             cullingData)
+{
+    namespace astro = celestia::astro;
+
+    // See if this node lies within the view frustum
+    if (!isInFrustum(frustumPlanes, node.cellCenterPos, scale, node.boundsMargin))
+        return false;
+
+    // Compute the distance to node; this is equal to the distance to
+    // the cellCenterPos of the node minus the boundingRadius of the node,
+    // scale * SQRT3 plus the margin for star motion.
+    float boundingRadius = scale * StarOctree::SQRT3 + node.boundsMargin;
+    float minDistance = (obsPosition - node.cellCenterPos).norm() - boundingRadius;
+
+    // Nodes too small to make out individual stars are passed on whole.
+    if (cullingData != nullptr && minDistance > 0 &&
+        boundingRadius < processor.aggregateThreshold() * minDistance)
+    {
+        const StarNodeAggregate& aggregate = cullingData->aggregates[&node - cullingData->firstNode];
+        float distance = (obsPosition - aggregate.centroid).norm();
+        float appMag = astro::absToAppMag(aggregate.absMag, distance);
+        if (appMag < limitingFactor)
+            processor.processAggregate(aggregate, distance, appMag);
+        return false;
+    }
+
+    // Process the objects in this node
+    float dimmest = minDistance > 0 ? astro::appToAbsMag(limitingFactor, minDistance) : 1000;
+
+    if (cullingData != nullptr)
+    {
+        auto first = static_cast<std::size_t>(node._firstObject - cullingData->firstStar);
+        for (unsigned int i = 0; i < node.nObjects; i += CullingBlockSize)
+        {
+            processVisibleBlock(processor, *cullingData, first + i,
+                                std::min(node.nObjects - i, CullingBlockSize),
+                                obsPosition, dimmest, limitingFactor);
+        }
+    }
+    else
+    {
+        for (unsigned int i = 0; i < node.nObjects; ++i)
+        {
+            const Star& obj = node._firstObject[i];
+
+            if (obj.getAbsoluteMagnitude() < dimmest)
+            {
+                float distance    = (obsPosition - obj.getPosition()).norm();
+                float appMag      = obj.getApparentMagnitude(distance);
+
+                if (appMag < limitingFactor || (distance < MaxStarOrbitRadius && obj.getOrbit()))
+                    processor.process(obj, distance, appMag);
+            }
+        }
+    }
+
+    // See if any of the objects in child nodes are potentially included
+    // that we need to recurse deeper.
+    return node.hasChildren() &&
+           (minDistance <= 0 || astro::absToAppMag(node.exclusionFactor, minDistance) <= limitingFactor);
+}
+
+
+template<typename Handler>
+void
+StarOctreeTraversal::processVisibleObjects(const StarOctree&                  node,
+                                           Handler&                           processor,
+                                           const Eigen::Vector3f&             obsPosition,
+                                           const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                                           float                              limitingFactor,
+                                           float                              scale,
+                                           unsigned int                       maxDepth,
+                                           std::vector<StarOctree::Subtree>&  subtrees,
+                                           const StarCullingData*             cullingData)
+{
+    if (maxDepth == 0)
+    {
+        if (isInFrustum(frustumPlanes, node.cellCenterPos, scale, node.boundsMargin))
+            subtrees.push_back({ &node, scale });
+        return;
+    }
+
+    if (!processNodeObjects(node, processor, obsPosition, frustumPlanes, limitingFactor, scale, cullingData))
+        return;
+
+    // Recurse into the child nodes
+    for (int i = 0; i < 8; ++i)
+    {
+        processVisibleObjects(*node.child(i),
+                              processor,
+                              obsPosition,
+                              frustumPlanes,
+                              limitingFactor,
+                              scale * 0.5f,
+                              maxDepth - 1,
+                              subtrees,
+                              cullingData);
+    }
+}
+
+
+template<typename Handler>
+void
+StarOctreeTraversal::processCloseObjects(const StarOctree&      node,
+                                         Handler&               processor,
+                                         const Eigen::Vector3f& obsPosition,
+                                         float                  boundingRadius,
+                                         float                  scale)
+{
+    // Compute the distance to node; this is equal to the distance to
+    // the cellCenterPos of the node minus the boundingRadius of the node,
+    // scale * SQRT3 plus the margin for star motion.
+    float nodeDistance = (obsPosition - node.cellCenterPos).norm() - scale * StarOctree::SQRT3 - node.boundsMargin;
+
+    if (nodeDistance > boundingRadius)
+        return;
+
+    // At this point, we've determined that the cellCenterPos of the node is
+    // close enough that we must check individual objects for proximity.
+
+    // Compute distance squared to avoid having to sqrt for distance
+    // comparison.
+    float radiusSquared = boundingRadius * boundingRadius;
+
+    // Check all the objects in the node.
+    for (unsigned int i = 0; i < node.nObjects; ++i)
+    {
+        const Star& obj = node._firstObject[i];
+
+        if ((obsPosition - obj.getPosition()).squaredNorm() < radiusSquared)
+        {
+            float distance    = (obsPosition - obj.getPosition()).norm();
+            float appMag      = obj.getApparentMagnitude(distance);
+
+            processor.process(obj, distance, appMag);
+        }
+    }
+
+    // Recurse into the child nodes
+    if (node.hasChildren())
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            processCloseObjects(*node.child(i),
+                                processor,
+                                obsPosition,
+                                boundingRadius,
+                                scale * 0.5f);
+        }
+    }
+}
+
+
+template<typename Handler>
+void
+StarDatabase::processVisibleStars(Handler& starHandler,
+                                  StarVisibilityCache* cache,
+                                  const Eigen::Vector3f& position,
+                                  const Eigen::Quaternionf& orientation,
+                                  float fovY,
+                                  float aspectRatio,
+                                  float limitingMag) const
+{
+    std::array<Eigen::Hyperplane<float, 3>, 5> frustumPlanes;
+    if (prepareVisibleStars(cache, position, orientation, fovY, aspectRatio, limitingMag, frustumPlanes))
+    {
+        const auto nNodes = static_cast<std::uint32_t>(cache->nodes.size());
+        for (std::uint32_t i = 0; i < nNodes;)
+        {
+            const auto& entry = cache->nodes[i];
+            if (StarOctreeTraversal::processNodeObjects(*entry.node,
+                                                        starHandler,
+                                                        position,
+                                                        frustumPlanes.data(),
+                                                        limitingMag,
+                                                        entry.scale,
+                                                        &cullingData))
+                ++i;
+            else
+                i = entry.end;
+        }
+    }
+    else
+    {
+        std::vector<StarOctree::Subtree> subtrees;
+        StarOctreeTraversal::processVisibleObjects(octreeNodes.front(),
+                                                   starHandler,
+                                                   position,
+                                                   frustumPlanes.data(),
+                                                   limitingMag,
+                                                   STAR_OCTREE_ROOT_SIZE,
+                                                   std::numeric_limits<unsigned int>::max(),
+                                                   subtrees,
+                                                   &cullingData);
+    }
+}
+
+
+template<typename Handler>
+void
+StarDatabase::processCloseStars(Handler& starHandler,
+                                const Eigen::Vector3f& position,
+                                float radius) const
+{
+    StarOctreeTraversal::processCloseObjects(octreeNodes.front(),
+                                             starHandler,
+                                             position,
+                                             radius,
+                                             STAR_OCTREE_ROOT_SIZE);
+}
@@ -0,0 +1,515 @@
+// starpack.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "starpack.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/logger.h>
+#include <celutil/mappedfile.h>
+
+using namespace std::string_view_literals;
+using celestia::util::GetLogger;
+
+namespace celestia::engine
+{
+namespace
+{
+
+// Bump kPackVersion whenever the layout of a section changes
+constexpr std::string_view kPackMagic = "CELPACK\0"sv;
+constexpr std::uint16_t kPackVersion = 1;
+
+// magic, version, section count, reserved
+constexpr std::size_t kHeaderSize = 16;
+// type, reserved, offset, size, source size, source hash
+constexpr std::size_t kSectionEntrySize = 40;
+
+constexpr std::uint64_t kFNVOffsetBasis = UINT64_C(0xcbf29ce484222325);
+
+// 64-bit FNV-1a
+std::uint64_t
+hashBytes(std::string_view s)
+{
+    std::uint64_t hash = kFNVOffsetBasis;
+    for (char c : s)
+        hash = (hash ^ static_cast<std::uint8_t>(c)) * UINT64_C(0x100000001b3);
+    return hash;
+}
+
+bool
+getSourceStamp(const fs::path& source, std::uint64_t& size, std::uint64_t& hash)
+{
+    auto file = util::MappedFile::open(source);
+    if (file == nullptr)
+        return false;
+
+    size = file->size();
+    hash = hashBytes(std::string_view(file->data(), file->size()));
+    return true;
+}
+
+// Reads a section, failing on anything that runs past its end
+class PackReader
+{
+public:
+    explicit PackReader(std::string_view data) : m_ptr(data.data()), m_end(data.data() + data.size()) {}
+
+    template<typename T>
+    bool read(T& value)
+    {
+        if (remaining() < sizeof(T))
+            return false;
+        value = util::fromMemoryLE<T>(m_ptr);
+        m_ptr += sizeof(T);
+        return true;
+    }
+
+    bool read(std::string& value)
+    {
+        std::uint32_t length;
+        if (!read(length) || remaining() < length)
+            return false;
+        value.assign(m_ptr, length);
+        m_ptr += length;
+        return true;
+    }
+
+    // Reads a count of items taking at least itemSize bytes each
+    bool readCount(std::uint32_t& count, std::size_t itemSize)
+    {
+        return read(count) && count <= remaining() / itemSize;
+    }
+
+    const char* position() const { return m_ptr; }
+    std::size_t remaining() const { return static_cast<std::size_t>(m_end - m_ptr); }
+
+private:
+    const char* m_ptr;
+    const char* m_end;
+};
+
+bool
+writeString(std::ostream& out, std::string_view s)
+{
+    return util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(s.size())) &&
+           out.write(s.data(), static_cast<std::streamsize>(s.size())).good();
+}
+
+bool
+buildNamesSection(std::istream& in, std::ostream& out)
+{
+    // Names are written to a string table following the records
+    std::vector<AstroCatalog::IndexNumber> catalogNumbers;
+    std::vector<std::size_t> offsets;
+    std::string strings;
+    if (!StarNameDatabase::parseNames(in,
+                                      [&](AstroCatalog::IndexNumber catalogNumber, std::string_view name)
+                                      {
+                                          catalogNumbers.push_back(catalogNumber);
+                                          offsets.push_back(strings.size());
+                                          strings.append(name);
+                                      }))
+    {
+        return false;
+    }
+
+    bool ok = util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(catalogNumbers.size()));
+    for (std::size_t i = 0; i < catalogNumbers.size(); ++i)
+    {
+        std::size_t end = i + 1 < catalogNumbers.size() ? offsets[i + 1] : strings.size();
+        ok = ok &&
+             util::writeLE<std::uint32_t>(out, catalogNumbers[i]) &&
+             util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(offsets[i])) &&
+             util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(end - offsets[i]));
+    }
+
+    return ok && out.write(strings.data(), static_cast<std::streamsize>(strings.size())).good();
+}
+
+bool
+buildCrossIndexSection(std::istream& in, std::ostream& out)
+{
+    StarNameDatabase::CrossIndex xindex;
+    if (!StarNameDatabase::readCrossIndex(in, xindex))
+        return false;
+
+    bool ok = util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(xindex.size()));
+    for (const auto& entry : xindex)
+    {
+        ok = ok &&
+             util::writeLE<std::uint32_t>(out, entry.catalogNumber) &&
+             util::writeLE<std::uint32_t>(out, entry.celCatalogNumber);
+    }
+
+    return ok;
+}
+
+bool
+buildAsterismsSection(std::istream& in, std::ostream& out)
+{
+    std::vector<AsterismDefinition> definitions;
+    if (!ParseAsterismList(in, definitions))
+        return false;
+
+    bool ok = util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(definitions.size()));
+    for (const auto& definition : definitions)
+    {
+        ok = ok &&
+             writeString(out, definition.name) &&
+             util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(definition.chains.size()));
+        for (const auto& chain : definition.chains)
+        {
+            ok = ok && util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(chain.size()));
+            for (const std::string& starName : chain)
+                ok = ok && writeString(out, starName);
+        }
+    }
+
+    return ok;
+}
+
+bool
+buildBoundariesSection(std::istream& in, std::ostream& out)
+{
+    auto boundaries = ReadBoundaries(in);
+    const auto& chains = boundaries->getChains();
+
+    bool ok = util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(chains.size()));
+    for (const auto& chain : chains)
+    {
+        ok = ok && util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(chain.size()));
+        for (const Eigen::Vector3f& point : chain)
+        {
+            ok = ok &&
+                 util::writeLE<float>(out, point.x()) &&
+                 util::writeLE<float>(out, point.y()) &&
+                 util::writeLE<float>(out, point.z());
+        }
+    }
+
+    return ok;
+}
+
+} // end unnamed namespace
+
+StarDataPack::~StarDataPack() = default;
+
+std::unique_ptr<StarDataPack>
+StarDataPack::open(const fs::path& path)
+{
+    auto file = util::MappedFile::open(path);
+    if (file == nullptr || file->size() < kHeaderSize)
+        return nullptr;
+
+    const char* data = file->data();
+    if (std::memcmp(data, kPackMagic.data(), kPackMagic.size()) != 0 ||
+        util::fromMemoryLE<std::uint16_t>(data + 8) != kPackVersion)
+    {
+        GetLogger()->warn("{} is not a star data pack of this version\n", path);
+        return nullptr;
+    }
+
+    auto sectionCount = util::fromMemoryLE<std::uint16_t>(data + 10);
+    if (file->size() < kHeaderSize + sectionCount * kSectionEntrySize)
+        return nullptr;
+
+    std::unique_ptr<StarDataPack> pack(new StarDataPack());
+    for (std::uint16_t i = 0; i < sectionCount; ++i)
+    {
+        const char* entryData = data + kHeaderSize + i * kSectionEntrySize;
+        auto type = util::fromMemoryLE<std::uint32_t>(entryData);
+        // Sections added by later versions are ignored
+        if (type >= SectionCount)
+            continue;
+
+        SectionEntry& entry = pack->m_sections[type];
+        entry.offset = util::fromMemoryLE<std::uint64_t>(entryData + 8);
+        entry.size = util::fromMemoryLE<std::uint64_t>(entryData + 16);
+        entry.sourceSize = util::fromMemoryLE<std::uint64_t>(entryData + 24);
+        entry.sourceHash = util::fromMemoryLE<std::uint64_t>(entryData + 32);
+        entry.present = entry.offset <= file->size() && entry.size <= file->size() - entry.offset;
+    }
+
+    pack->m_file = std::move(file);
+    return pack;
+}
+
+std::string_view
+StarDataPack::getSection(Section section, const fs::path& source) const
+{
+    const SectionEntry& entry = m_sections[static_cast<std::size_t>(section)];
+    if (!entry.present || source.empty())
+        return {};
+
+    std::uint64_t sourceSize;
+    std::uint64_t sourceHash;
+    if (!getSourceStamp(source, sourceSize, sourceHash) ||
+        sourceSize != entry.sourceSize ||
+        sourceHash != entry.sourceHash)
+    {
+        GetLogger()->info("Star data pack is out of date for {}\n", source);
+        return {};
+    }
+
+    return std::string_view(m_file->data() + entry.offset, static_cast<std::size_t>(entry.size));
+}
+
+std::unique_ptr<StarNameDatabase>
+StarDataPack::readNames(const fs::path& source) const
+{
+    std::string_view data = getSection(Section::StarNames, source);
+    if (data.empty())
+        return nullptr;
+
+    constexpr std::size_t RecordSize = 12;
+    PackReader reader(data);
+    std::uint32_t count;
+    if (!reader.readCount(count, RecordSize))
+        return nullptr;
+
+    const char* records = reader.position();
+    std::string_view strings = data.substr(sizeof(std::uint32_t) + count * RecordSize);
+
+    auto db = std::make_unique<StarNameDatabase>();
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        const char* record = records + i * RecordSize;
+        auto catalogNumber = util::fromMemoryLE<std::uint32_t>(record);
+        auto offset = util::fromMemoryLE<std::uint32_t>(record + 4);
+        auto length = util::fromMemoryLE<std::uint32_t>(record + 8);
+        if (offset > strings.size() || length > strings.size() - offset)
+        {
+            GetLogger()->warn("Damaged star names in star data pack\n");
+            return nullptr;
+        }
+
+        db->add(catalogNumber, strings.substr(offset, length));
+    }
+
+    return db;
+}
+
+bool
+StarDataPack::readCrossIndex(StarCatalog catalog, const fs::path& source, StarNameDatabase::CrossIndex& xindex) const
+{
+    Section section;
+    switch (catalog)
+    {
+    case StarCatalog::HenryDraper:
+        section = Section::HDCrossIndex;
+        break;
+    case StarCatalog::SAO:
+        section = Section::SAOCrossIndex;
+        break;
+    default:
+        return false;
+    }
+
+    std::string_view data = getSection(section, source);
+    if (data.empty())
+        return false;
+
+    PackReader reader(data);
+    std::uint32_t count;
+    if (!reader.readCount(count, 8))
+        return false;
+
+    StarNameDatabase::CrossIndex entries;
+    entries.reserve(count);
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        auto& entry = entries.emplace_back();
+        reader.read(entry.catalogNumber);
+        reader.read(entry.celCatalogNumber);
+        // Lookups rely on the order the pack was written in
+        if (i > 0 && entry.catalogNumber < entries[i - 1].catalogNumber)
+        {
+            GetLogger()->warn("Damaged cross index in star data pack\n");
+            return false;
+        }
+    }
+
+    xindex = std::move(entries);
+    return true;
+}
+
+bool
+StarDataPack::readAsterisms(const fs::path& source, std::vector<AsterismDefinition>& definitions) const
+{
+    std::string_view data = getSection(Section::Asterisms, source);
+    if (data.empty())
+        return false;
+
+    PackReader reader(data);
+    std::uint32_t count;
+    if (!reader.readCount(count, 8))
+        return false;
+
+    std::vector<AsterismDefinition> result(count);
+    for (AsterismDefinition& definition : result)
+    {
+        std::uint32_t chainCount;
+        if (!reader.read(definition.name) || !reader.readCount(chainCount, 4))
+            return false;
+
+        definition.chains.resize(chainCount);
+        for (auto& chain : definition.chains)
+        {
+            std::uint32_t starCount;
+            if (!reader.readCount(starCount, 4))
+                return false;
+
+            chain.resize(starCount);
+            for (std::string& starName : chain)
+            {
+                if (!reader.read(starName))
+                    return false;
+            }
+        }
+    }
+
+    definitions = std::move(result);
+    return true;
+}
+
+std::unique_ptr<ConstellationBoundaries>
+StarDataPack::readBoundaries(const fs::path& source) const
+{
+    std::string_view data = getSection(Section::Boundaries, source);
+    if (data.empty())
+        return nullptr;
+
+    PackReader reader(data);
+    std::uint32_t count;
+    if (!reader.readCount(count, 4))
+        return nullptr;
+
+    std::vector<ConstellationBoundaries::Chain> chains(count);
+    for (auto& chain : chains)
+    {
+        std::uint32_t pointCount;
+        if (!reader.readCount(pointCount, 3 * sizeof(float)))
+            return nullptr;
+
+        chain.resize(pointCount);
+        for (Eigen::Vector3f& point : chain)
+        {
+            reader.read(point.x());
+            reader.read(point.y());
+            reader.read(point.z());
+        }
+    }
+
+    return std::make_unique<ConstellationBoundaries>(std::move(chains));
+}
+
+bool
+StarDataPack::write(const fs::path& path, const Sources& sources)
+{
+    using BuildFunction = bool (*)(std::istream&, std::ostream&);
+    struct SectionSource
+    {
+        Section section;
+        const fs::path* path;
+        BuildFunction build;
+    };
+
+    const std::array<SectionSource, SectionCount> sectionSources
+    {
+        SectionSource{ Section::StarNames, &sources.starNames, &buildNamesSection },
+        SectionSource{ Section::HDCrossIndex, &sources.hdCrossIndex, &buildCrossIndexSection },
+        SectionSource{ Section::SAOCrossIndex, &sources.saoCrossIndex, &buildCrossIndexSection },
+        SectionSource{ Section::Asterisms, &sources.asterisms, &buildAsterismsSection },
+        SectionSource{ Section::Boundaries, &sources.boundaries, &buildBoundariesSection },
+    };
+
+    std::vector<std::pair<Section, SectionEntry>> entries;
+    std::string body;
+    for (const SectionSource& sectionSource : sectionSources)
+    {
+        const fs::path& source = *sectionSource.path;
+        if (source.empty())
+            continue;
+
+        SectionEntry entry;
+        std::ifstream in(source, std::ios::in | std::ios::binary);
+        if (!in.good() || !getSourceStamp(source, entry.sourceSize, entry.sourceHash))
+        {
+            GetLogger()->error("Error opening {}\n", source);
+            return false;
+        }
+
+        std::ostringstream out(std::ios::out | std::ios::binary);
+        if (!sectionSource.build(in, out))
+        {
+            GetLogger()->error("Error reading {}\n", source);
+            return false;
+        }
+
+        entry.offset = body.size();
+        body += std::move(out).str();
+        entry.size = body.size() - entry.offset;
+        entries.emplace_back(sectionSource.section, entry);
+    }
+
+    // Write to a temporary file first so that a running instance never
+    // maps a partial pack
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.good())
+            return false;
+
+        const std::uint64_t bodyOffset = kHeaderSize + entries.size() * kSectionEntrySize;
+        out.write(kPackMagic.data(), kPackMagic.size());
+        bool ok = util::writeLE<std::uint16_t>(out, kPackVersion) &&
+                  util::writeLE<std::uint16_t>(out, static_cast<std::uint16_t>(entries.size())) &&
+                  util::writeLE<std::uint32_t>(out, 0);
+        for (const auto& [section, entry] : entries)
+        {
+            ok = ok &&
+                 util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(section)) &&
+                 util::writeLE<std::uint32_t>(out, 0) &&
+                 util::writeLE<std::uint64_t>(out, bodyOffset + entry.offset) &&
+                 util::writeLE<std::uint64_t>(out, entry.size) &&
+                 util::writeLE<std::uint64_t>(out, entry.sourceSize) &&
+                 util::writeLE<std::uint64_t>(out, entry.sourceHash);
+        }
+
+        ok = ok && out.write(body.data(), static_cast<std::streamsize>(body.size())).good();
+        if (!ok || !out.flush().good())
+        {
+            out.close();
+            std::error_code ec;
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tempPath, path, ec);
+    if (ec)
+    {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    return true;
+}
+
+} // end namespace celestia::engine
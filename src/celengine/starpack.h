@@ -0,0 +1,101 @@
+// starpack.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Bundle of the star names, cross indices, asterisms and boundaries.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include "asterism.h"
+#include "boundaries.h"
+#include "starname.h"
+
+namespace celestia::util
+{
+class MappedFile;
+}
+
+namespace celestia::engine
+{
+
+// Holds the star names, the cross indices, the asterisms and the
+// constellation boundaries in a binary layout that is read from a file
+// mapping without parsing. The pack is written by makestarpack from the
+// source files. Each section records the size and contents hash of the
+// file it was made from and is only used while that file is unchanged, so
+// a stale pack falls back to the source files section by section.
+class StarDataPack
+{
+public:
+    enum class Section : std::uint32_t
+    {
+        StarNames     = 0,
+        HDCrossIndex  = 1,
+        SAOCrossIndex = 2,
+        Asterisms     = 3,
+        Boundaries    = 4,
+    };
+
+    // Source files of the sections; sections with an empty path are left out
+    struct Sources
+    {
+        fs::path starNames;
+        fs::path hdCrossIndex;
+        fs::path saoCrossIndex;
+        fs::path asterisms;
+        fs::path boundaries;
+    };
+
+    ~StarDataPack();
+
+    StarDataPack(const StarDataPack&) = delete;
+    StarDataPack& operator=(const StarDataPack&) = delete;
+    StarDataPack(StarDataPack&&) = delete;
+    StarDataPack& operator=(StarDataPack&&) = delete;
+
+    // Returns nullptr if the file is missing or not a pack
+    static std::unique_ptr<StarDataPack> open(const fs::path&);
+    static bool write(const fs::path&, const Sources&);
+
+    // Each of these fails if the pack has no section made from source as it
+    // is now, in which case source has to be read instead. They don't
+    // modify the pack and may be called from any thread.
+    std::unique_ptr<StarNameDatabase> readNames(const fs::path& source) const;
+    bool readCrossIndex(StarCatalog, const fs::path& source, StarNameDatabase::CrossIndex&) const;
+    bool readAsterisms(const fs::path& source, std::vector<AsterismDefinition>&) const;
+    std::unique_ptr<ConstellationBoundaries> readBoundaries(const fs::path& source) const;
+
+private:
+    static constexpr std::size_t SectionCount = 5;
+
+    struct SectionEntry
+    {
+        std::uint64_t offset{ 0 };
+        std::uint64_t size{ 0 };
+        std::uint64_t sourceSize{ 0 };
+        std::uint64_t sourceHash{ 0 };
+        bool present{ false };
+    };
+
+    StarDataPack() = default;
+
+    std::string_view getSection(Section, const fs::path& source) const;
+
+    std::unique_ptr<util::MappedFile> m_file;
+    std::array<SectionEntry, SectionCount> m_sections;
+};
+
+} // end namespace celestia::engine
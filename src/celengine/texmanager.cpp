@@ -14,7 +14,9 @@
 #include <cstddef>
 #include <fstream>
 #include <string_view>
+#include <system_error>
 
+#include <celutil/filetype.h>
 #include <celutil/fsutils.h>
 #include <celutil/logger.h>
 
@@ -44,6 +46,44 @@ constexpr std::array extensions =
     "ctx"sv,
 };
 
+// Preprocessed copies are DXTc compressed, which only makes sense for
+// formats that are decoded to uncompressed images
+bool
+hasPreprocessedCopy(const fs::path& filename)
+{
+    switch (DetermineFileType(filename))
+    {
+    case ContentType::JPEG:
+    case ContentType::BMP:
+    case ContentType::PNG:
+#ifdef USE_LIBAVIF
+    case ContentType::AVIF:
+#endif
+        return true;
+    default:
+        return false;
+    }
+}
+
+fs::path
+preferPreprocessed(const fs::path& filename)
+{
+    if (!hasPreprocessedCopy(filename))
+        return filename;
+
+    fs::path preprocessed = GetPreprocessedTexturePath(filename);
+    std::error_code ec;
+    auto preprocessedTime = fs::last_write_time(preprocessed, ec);
+    if (ec)
+        return filename;
+
+    auto sourceTime = fs::last_write_time(filename, ec);
+    if (ec || preprocessedTime < sourceTime)
+        return filename;
+
+    return preprocessed;
+}
+
 } // end unnamed namespace
 
 TextureManager*
@@ -53,8 +93,25 @@ GetTextureManager()
     return textureManager;
 }
 
+fs::path
+GetPreprocessedTexturePath(const fs::path& source)
+{
+    fs::path preprocessed = source;
+    preprocessed += ".dds";
+    return preprocessed;
+}
+
 fs::path
 TextureInfo::resolve(const fs::path& baseDir) const
+{
+    fs::path filename = resolveSource(baseDir);
+
+    // Height maps are converted to normal maps, which needs the source image
+    return bumpHeight == 0.0f ? preferPreprocessed(filename) : filename;
+}
+
+fs::path
+TextureInfo::resolveSource(const fs::path& baseDir) const
 {
     bool wildcard = source.extension() == ".*";
 
@@ -88,8 +145,8 @@ TextureInfo::resolve(const fs::path& baseDir) const
 }
 
 
-std::unique_ptr<Texture>
-TextureInfo::load(const fs::path& name) const
+std::tuple<Texture::AddressMode, Texture::MipMapMode, Texture::Colorspace>
+TextureInfo::getModes() const
 {
     Texture::AddressMode addressMode = Texture::EdgeClamp;
     Texture::MipMapMode  mipMode     = Texture::DefaultMipMaps;
@@ -106,6 +163,15 @@ TextureInfo::load(const fs::path& name) const
     if (flags & LinearColorspace)
         colorspace = Texture::LinearColorspace;
 
+    return { addressMode, mipMode, colorspace };
+}
+
+
+std::unique_ptr<Texture>
+TextureInfo::load(const fs::path& name) const
+{
+    auto [addressMode, mipMode, colorspace] = getModes();
+
     if (bumpHeight == 0.0f)
     {
         GetLogger()->debug("Loading texture: {}\n", name);
@@ -115,3 +181,43 @@ TextureInfo::load(const fs::path& name) const
     GetLogger()->debug("Loading bump map: {}\n", name);
     return LoadHeightMapFromFile(name, bumpHeight, addressMode);
 }
+
+
+std::unique_ptr<TextureInfo::PreparedType>
+TextureInfo::prepare(const fs::path& name) const
+{
+    auto [addressMode, mipMode, colorspace] = getModes();
+
+    auto prepared = std::make_unique<PreparedType>();
+    if (bumpHeight == 0.0f)
+    {
+        if (DetermineFileType(name) == ContentType::CelestiaTexture)
+            return prepared;
+
+        GetLogger()->debug("Loading texture: {}\n", name);
+        prepared->image = LoadTextureImage(name, colorspace);
+    }
+    else
+    {
+        GetLogger()->debug("Loading bump map: {}\n", name);
+        prepared->image = LoadHeightMapImage(name, bumpHeight, addressMode);
+    }
+
+    return prepared->image == nullptr ? nullptr : std::move(prepared);
+}
+
+
+std::unique_ptr<Texture>
+TextureInfo::create(const fs::path& name, PreparedType& prepared) const
+{
+    auto [addressMode, mipMode, colorspace] = getModes();
+
+    if (prepared.image == nullptr)
+        return LoadTextureFromFile(name, addressMode, mipMode, colorspace);
+
+    // Normal maps computed from height maps always get mipmaps
+    if (bumpHeight != 0.0f)
+        return CreateTextureFromFileImage(name, *prepared.image, addressMode, Texture::DefaultMipMaps);
+
+    return CreateTextureFromFileImage(name, *prepared.image, addressMode, mipMode);
+}
@@ -14,6 +14,7 @@
 #include <tuple>
 
 #include <celcompat/filesystem.h>
+#include <celimage/image.h>
 #include <celutil/resmanager.h>
 #include "multitexture.h"
 #include "texture.h"
@@ -33,6 +34,13 @@ public:
     using ResourceType = Texture;
     using ResourceKey = fs::path;
 
+    // Image decoded on the loader thread. It is null for virtual textures,
+    // create() then loads the whole texture.
+    struct PreparedType
+    {
+        std::unique_ptr<celestia::engine::Image> image;
+    };
+
     enum
     {
         WrapTexture      = 0x1,
@@ -76,6 +84,12 @@ public:
 
     fs::path resolve(const fs::path&) const;
     std::unique_ptr<Texture> load(const fs::path&) const;
+    std::unique_ptr<PreparedType> prepare(const fs::path&) const;
+    std::unique_ptr<Texture> create(const fs::path&, PreparedType&) const;
+
+private:
+    fs::path resolveSource(const fs::path&) const;
+    std::tuple<Texture::AddressMode, Texture::MipMapMode, Texture::Colorspace> getModes() const;
 };
 
 inline bool operator<(const TextureInfo& ti0, const TextureInfo& ti1)
@@ -87,3 +101,7 @@ inline bool operator<(const TextureInfo& ti0, const TextureInfo& ti1)
 using TextureManager = ResourceManager<TextureInfo>;
 
 TextureManager* GetTextureManager();
+
+// Path of the compressed and mipmapped copy of a texture written by texprep.
+// It is loaded instead of the source when it is at least as new.
+fs::path GetPreprocessedTexturePath(const fs::path& source);
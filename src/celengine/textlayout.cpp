@@ -10,6 +10,9 @@
 #include "textlayout.h"
 
 #include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 #ifdef USE_ICU
 #include <celutil/flag.h>
@@ -22,6 +25,65 @@
 namespace celestia::engine
 {
 
+namespace
+{
+
+// Converting and shaping strings is expensive, in particular with ICU, and
+// mostly the same labels and HUD lines are laid out for every frame, so the
+// lines of the most recently used strings are kept. The string is all the
+// key needs, as the line widths are cached by the fonts.
+class LineCache
+{
+public:
+    using Lines = std::shared_ptr<const std::vector<std::u16string>>;
+
+    static constexpr std::size_t Capacity = 4096;
+
+    Lines find(std::string_view text)
+    {
+        std::scoped_lock lock(m_mutex);
+        auto it = m_index.find(text);
+        if (it == m_index.end())
+            return nullptr;
+
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return it->second->lines;
+    }
+
+    void insert(std::string_view text, const Lines& lines)
+    {
+        std::scoped_lock lock(m_mutex);
+        if (m_index.find(text) != m_index.end())
+            return;
+
+        if (m_entries.size() >= Capacity)
+        {
+            m_index.erase(m_entries.back().text);
+            m_entries.pop_back();
+        }
+
+        m_entries.push_front({ std::string(text), lines });
+        // The key views the string of the entry, which list nodes keep in place
+        m_index.try_emplace(m_entries.front().text, m_entries.begin());
+    }
+
+private:
+    struct Entry
+    {
+        std::string text;
+        Lines lines;
+    };
+
+    // Most recently used first
+    std::list<Entry> m_entries;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> m_index;
+    std::mutex m_mutex;
+};
+
+LineCache lineCache;
+
+} // end unnamed namespace
+
 TextLayout::TextLayout(int screenDpi, HorizontalAlignment halign) : screenDpi(static_cast<float>(screenDpi)), horizontalAlignment(halign)
 {
 }
@@ -131,10 +193,11 @@ void TextLayout::render(std::string_view text)
     if (!began)
         return;
 
-    std::vector<std::u16string> lines;
-    if (!processString(text, lines) || lines.empty())
+    auto processed = getLines(text);
+    if (processed == nullptr || processed->empty())
         return;
 
+    const std::vector<std::u16string>& lines = *processed;
     for (std::size_t i = 0; i < lines.size(); i += 1)
     {
         auto lineToRender = lines[i];
@@ -201,12 +264,15 @@ int TextLayout::getLineHeight() const
 
 int TextLayout::getTextWidth(std::string_view text, const TextureFont *font)
 {
-    std::vector<std::u16string> lines;
-    if (font == nullptr || !processString(text, lines))
+    if (font == nullptr)
+        return 0;
+
+    auto lines = getLines(text);
+    if (lines == nullptr)
         return 0;
 
     int maxLineWidth = 0;
-    for (const auto& line : lines)
+    for (const auto& line : *lines)
         maxLineWidth = std::max(maxLineWidth, font->getWidth(line));
     return maxLineWidth;
 }
@@ -259,6 +325,19 @@ void TextLayout::flushInternal(bool flushFont)
         font->flush();
 }
 
+std::shared_ptr<const std::vector<std::u16string>> TextLayout::getLines(std::string_view text)
+{
+    if (auto lines = lineCache.find(text); lines != nullptr)
+        return lines;
+
+    auto lines = std::make_shared<std::vector<std::u16string>>();
+    if (!processString(text, *lines))
+        return nullptr;
+
+    lineCache.insert(text, lines);
+    return lines;
+}
+
 bool TextLayout::processString(std::string_view input, std::vector<std::u16string> &output)
 {
 #ifdef USE_ICU
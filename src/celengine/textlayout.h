@@ -131,6 +131,9 @@ class TextLayout
     void renderLine(std::u16string_view line);
     void flushInternal(bool flushFont);
 
+    /// Returns the lines of the string converted to UTF-16 and shaped, from a
+    /// cache shared by all layouts, or nullptr if the string is invalid
+    static std::shared_ptr<const std::vector<std::u16string>> getLines(std::string_view text);
     static bool processString(std::string_view input, std::vector<std::u16string> &output);
 };
 
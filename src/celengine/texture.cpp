@@ -18,8 +18,10 @@
 
 #include <celutil/filetype.h>
 #include <celutil/gettext.h>
+#include <celrender/gl/binder.h>
 #include <celutil/logger.h>
 #include "framebuffer.h"
+#include "pixelunpackbuffer.h"
 #include "texture.h"
 #include "virtualtex.h"
 
@@ -75,6 +77,10 @@ getInternalFormat(PixelFormat format)
     case PixelFormat::DXT1:
     case PixelFormat::DXT3:
     case PixelFormat::DXT5:
+    case PixelFormat::BC7:
+    case PixelFormat::ETC2_RGB8:
+    case PixelFormat::ETC2_RGBA8:
+    case PixelFormat::ASTC_4x4:
         return static_cast<GLenum>(format);
     default:
         return GL_NONE;
@@ -99,6 +105,14 @@ getInternalFormat(PixelFormat format)
     case PixelFormat::DXT1_sRGBA:
     case PixelFormat::DXT3_sRGBA:
     case PixelFormat::DXT5_sRGBA:
+    case PixelFormat::BC7:
+    case PixelFormat::BC7_sRGBA:
+    case PixelFormat::ETC2_RGB8:
+    case PixelFormat::ETC2_sRGB8:
+    case PixelFormat::ETC2_RGBA8:
+    case PixelFormat::ETC2_sRGBA8:
+    case PixelFormat::ASTC_4x4:
+    case PixelFormat::ASTC_4x4_sRGBA:
         return static_cast<GLenum>(format);
     default:
         return GL_NONE;
@@ -186,6 +200,8 @@ getCompressedBlockSize(PixelFormat format)
     {
     case PixelFormat::DXT1:
     case PixelFormat::DXT1_sRGBA:
+    case PixelFormat::ETC2_RGB8:
+    case PixelFormat::ETC2_sRGB8:
         return 8;
     default:
         return 16;
@@ -226,12 +242,27 @@ SetBorderColor(Color borderColor, GLenum target)
 #endif
 }
 
+// Returns the unpack buffer if the pixels of img were decoded into it
+const PixelUnpackBuffer*
+GetUnpackBuffer(const Image& img)
+{
+    const PixelUnpackBuffer* unpack = GetPixelUnpackBuffer();
+    return unpack != nullptr && img.getAllocator() == unpack ? unpack : nullptr;
+}
+
+const void*
+GetUnpackPointer(const PixelUnpackBuffer* unpack, const std::uint8_t* data)
+{
+    return unpack == nullptr ? data : unpack->bind(data);
+}
+
 // Load a prebuilt set of mipmaps; assumes that the image contains
 // a complete set of mipmap levels.
 void
 LoadMipmapSet(const Image& img, GLenum target)
 {
     int internalFormat = getInternalFormat(img.getFormat());
+    const PixelUnpackBuffer* unpack = GetUnpackBuffer(img);
 #ifndef GL_ES
     glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, img.getMipLevelCount()-1);
 #endif
@@ -249,7 +280,7 @@ LoadMipmapSet(const Image& img, GLenum target)
                                    mipWidth, mipHeight,
                                    0,
                                    img.getMipLevelSize(mip),
-                                   img.getMipLevel(mip));
+                                   GetUnpackPointer(unpack, img.getMipLevel(mip)));
         }
         else
         {
@@ -260,9 +291,12 @@ LoadMipmapSet(const Image& img, GLenum target)
                          0,
                          getExternalFormat(img.getFormat()),
                          GL_UNSIGNED_BYTE,
-                         img.getMipLevel(mip));
+                         GetUnpackPointer(unpack, img.getMipLevel(mip)));
         }
     }
+
+    if (unpack != nullptr)
+        PixelUnpackBuffer::unbind();
 }
 
 // Load a texture without any mipmaps
@@ -270,6 +304,7 @@ void
 LoadMiplessTexture(const Image& img, GLenum target)
 {
     int internalFormat = getInternalFormat(img.getFormat());
+    const PixelUnpackBuffer* unpack = GetUnpackBuffer(img);
 
     if (img.isCompressed())
     {
@@ -279,7 +314,7 @@ LoadMiplessTexture(const Image& img, GLenum target)
                                img.getWidth(), img.getHeight(),
                                0,
                                img.getMipLevelSize(0),
-                               img.getMipLevel(0));
+                               GetUnpackPointer(unpack, img.getMipLevel(0)));
     }
     else
     {
@@ -290,8 +325,11 @@ LoadMiplessTexture(const Image& img, GLenum target)
                      0,
                      getExternalFormat(img.getFormat()),
                      GL_UNSIGNED_BYTE,
-                     img.getMipLevel(0));
+                     GetUnpackPointer(unpack, img.getMipLevel(0)));
     }
+
+    if (unpack != nullptr)
+        PixelUnpackBuffer::unbind();
 }
 
 
@@ -315,6 +353,17 @@ CalcMipLevelCount(int w, int h)
     return std::max(ilog2(w), ilog2(h)) + 1;
 }
 
+// Mipmaps generated by the driver add about a third to the base level
+std::size_t
+CalcMemorySize(const Image& img, bool mipmap, bool precomputedMipMaps)
+{
+    if (mipmap && precomputedMipMaps)
+        return static_cast<std::size_t>(img.getSize());
+
+    auto size = static_cast<std::size_t>(img.getMipLevelSize(0));
+    return mipmap ? size + size / 3 : size;
+}
+
 // Helper function for CreateProceduralCubeMap; return the normalized
 // vector pointing to (s, t) on the specified face.
 Eigen::Vector3f
@@ -356,6 +405,12 @@ CreateTextureFromImage(const Image& img,
 {
     std::unique_ptr<Texture> tex = nullptr;
 
+    // Creating textures is a good moment to recycle memory of images that
+    // have been uploaded before
+    InitPixelUnpackBuffer();
+    if (PixelUnpackBuffer* unpack = GetPixelUnpackBuffer(); unpack != nullptr)
+        unpack->reclaim();
+
     const int maxDim = gl::maxTextureSize;
     if ((img.getWidth() > maxDim || img.getHeight() > maxDim))
     {
@@ -452,7 +507,7 @@ ImageTexture::ImageTexture(const Image& img,
     glName(0)
 {
     glGenTextures(1, &glName);
-    glBindTexture(GL_TEXTURE_2D, glName);
+    gl::Binder::get().bindTexture(GL_TEXTURE_2D, glName);
 
     bool mipmap = mipMapMode != NoMipMaps;
     bool precomputedMipMaps = false;
@@ -512,19 +567,23 @@ ImageTexture::ImageTexture(const Image& img,
 
     alpha = img.hasAlpha();
     compressed = img.isCompressed();
+    memorySize = CalcMemorySize(img, mipmap, precomputedMipMaps);
 }
 
 
 ImageTexture::~ImageTexture()
 {
     if (glName != 0)
+    {
+        gl::Binder::get().forgetTexture(glName);
         glDeleteTextures(1, &glName);
+    }
 }
 
 
 void ImageTexture::bind()
 {
-    glBindTexture(GL_TEXTURE_2D, glName);
+    gl::Binder::get().bindTexture(GL_TEXTURE_2D, glName);
 }
 
 
@@ -550,6 +609,138 @@ void ImageTexture::setBorderColor(Color borderColor)
 }
 
 
+std::unique_ptr<TextureAtlas>
+TextureAtlas::create(const Image& tile)
+{
+    // Larger atlases gain little and make allocation harder for the driver
+    constexpr int MaxAtlasSize = 4096;
+
+    if (getInternalFormat(tile.getFormat()) == GL_NONE)
+        return nullptr;
+
+    int atlasSize = std::min(MaxAtlasSize, static_cast<int>(gl::maxTextureSize));
+    int uTiles = atlasSize / tile.getWidth();
+    int vTiles = atlasSize / tile.getHeight();
+    if (uTiles * vTiles < 2)
+        return nullptr;
+
+    return std::make_unique<TextureAtlas>(tile, uTiles, vTiles);
+}
+
+
+TextureAtlas::TextureAtlas(const Image& tile, int _uTiles, int _vTiles) :
+    tileWidth(tile.getWidth()),
+    tileHeight(tile.getHeight()),
+    format(tile.getFormat()),
+    compressed(tile.isCompressed()),
+    uTiles(_uTiles),
+    slotCount(static_cast<std::size_t>(_uTiles * _vTiles))
+{
+    // Hand out the first slots first
+    freeSlots.reserve(slotCount);
+    for (int i = static_cast<int>(slotCount) - 1; i >= 0; i--)
+        freeSlots.push_back(i);
+
+    glGenTextures(1, &glName);
+    gl::Binder::get().bindTexture(GL_TEXTURE_2D, glName);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+#ifndef GL_ES
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+#endif
+
+    if (gl::EXT_texture_filter_anisotropic && GetTextureCaps().preferredAnisotropy > 1)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, GetTextureCaps().preferredAnisotropy);
+    }
+
+    int width = tileWidth * uTiles;
+    int height = tileHeight * _vTiles;
+    GLenum internalFormat = getInternalFormat(format);
+    if (compressed)
+    {
+        // Compressed formats are stored in blocks of 4x4 texels
+        GLsizei size = ((width + 3) / 4) * ((height + 3) / 4) * getCompressedBlockSize(format);
+        std::vector<std::uint8_t> blank(static_cast<std::size_t>(size));
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, size, blank.data());
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0,
+                     getExternalFormat(format), GL_UNSIGNED_BYTE, nullptr);
+    }
+}
+
+
+TextureAtlas::~TextureAtlas()
+{
+    if (glName != 0)
+    {
+        gl::Binder::get().forgetTexture(glName);
+        glDeleteTextures(1, &glName);
+    }
+}
+
+
+bool
+TextureAtlas::matches(const Image& img) const
+{
+    return img.getWidth() == tileWidth && img.getHeight() == tileHeight && img.getFormat() == format;
+}
+
+
+int
+TextureAtlas::addTile(const Image& img)
+{
+    assert(matches(img));
+    if (freeSlots.empty())
+        return -1;
+
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+
+    int x = (slot % uTiles) * tileWidth;
+    int y = (slot / uTiles) * tileHeight;
+    gl::Binder::get().bindTexture(GL_TEXTURE_2D, glName);
+    if (img.isCompressed())
+    {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, tileWidth, tileHeight,
+                                  getInternalFormat(format),
+                                  img.getMipLevelSize(0), img.getMipLevel(0));
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, tileWidth, tileHeight,
+                        getExternalFormat(format), GL_UNSIGNED_BYTE, img.getMipLevel(0));
+    }
+
+    return slot;
+}
+
+
+void
+TextureAtlas::removeTile(int slot)
+{
+    assert(slot >= 0 && static_cast<std::size_t>(slot) < slotCount);
+    freeSlots.push_back(slot);
+}
+
+
+TextureTile
+TextureAtlas::getTile(int slot) const
+{
+    auto width = static_cast<float>(tileWidth * uTiles);
+    auto height = static_cast<float>(tileHeight * static_cast<int>(slotCount / uTiles));
+    float u = (static_cast<float>((slot % uTiles) * tileWidth) + 0.5f) / width;
+    float v = (static_cast<float>((slot / uTiles) * tileHeight) + 0.5f) / height;
+    float du = static_cast<float>(tileWidth - 1) / width;
+    float dv = static_cast<float>(tileHeight - 1) / height;
+    return TextureTile(glName, u, v, du, dv);
+}
+
+
 TiledTexture::TiledTexture(const Image& img,
                            int _uSplit, int _vSplit,
                            MipMapMode mipMapMode) :
@@ -584,6 +775,8 @@ TiledTexture::TiledTexture(const Image& img,
     if (!precomputedMipMaps && img.isCompressed())
         mipmap = false;
 
+    memorySize = CalcMemorySize(img, mipmap, precomputedMipMaps);
+
     GLenum texAddress = GetGLTexAddressMode(EdgeClamp);
     int components = img.getComponents();
 
@@ -601,7 +794,7 @@ TiledTexture::TiledTexture(const Image& img,
         {
             // Create the texture and set up sampling and addressing
             glGenTextures(1, &glNames[v * uSplit + u]);
-            glBindTexture(GL_TEXTURE_2D, glNames[v * uSplit + u]);
+            gl::Binder::get().bindTexture(GL_TEXTURE_2D, glNames[v * uSplit + u]);
 
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texAddress);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texAddress);
@@ -703,7 +896,10 @@ TiledTexture::~TiledTexture()
         for (int i = 0; i < uSplit * vSplit; i++)
         {
             if (glNames[i] != 0)
+            {
+                gl::Binder::get().forgetTexture(glNames[i]);
                 glDeleteTextures(1, &glNames[i]);
+            }
         }
         delete[] glNames;
     }
@@ -721,7 +917,7 @@ void TiledTexture::setBorderColor(Color borderColor)
     {
         for (int j = 0; j < uSplit; j++)
         {
-            glBindTexture(GL_TEXTURE_2D, glNames[i * uSplit + j]);
+            gl::Binder::get().bindTexture(GL_TEXTURE_2D, glNames[i * uSplit + j]);
             SetBorderColor(borderColor, GL_TEXTURE_2D);
         }
     }
@@ -780,7 +976,7 @@ CubeMap::CubeMap(celestia::util::array_view<const Image*> faces) :
         mipmap = false;
 
     glGenTextures(1, &glName);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, glName);
+    gl::Binder::get().bindTexture(GL_TEXTURE_CUBE_MAP, glName);
 
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -802,19 +998,24 @@ CubeMap::CubeMap(celestia::util::array_view<const Image*> faces) :
     }
     if (genMipmaps)
         glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    memorySize = 6 * CalcMemorySize(*faces[0], mipmap, precomputedMipMaps);
 }
 
 
 CubeMap::~CubeMap()
 {
     if (glName != 0)
+    {
+        gl::Binder::get().forgetTexture(glName);
         glDeleteTextures(1, &glName);
+    }
 }
 
 
 void CubeMap::bind()
 {
-    glBindTexture(GL_TEXTURE_CUBE_MAP, glName);
+    gl::Binder::get().bindTexture(GL_TEXTURE_CUBE_MAP, glName);
 }
 
 
@@ -928,22 +1129,44 @@ LoadTextureFromFile(const fs::path& filename,
 
     // All other texture types are handled by first loading an image, then
     // creating a texture from that image.
-    std::unique_ptr<Image> img = Image::load(filename);
+    std::unique_ptr<Image> img = LoadTextureImage(filename, colorspace);
     if (img == nullptr)
         return nullptr;
 
-    if (colorspace == Texture::LinearColorspace)
+    return CreateTextureFromFileImage(filename, *img, addressMode, mipMode);
+}
+
+
+std::unique_ptr<Image>
+LoadTextureImage(const fs::path& filename, Texture::Colorspace colorspace)
+{
+    if (DetermineFileType(filename) == ContentType::CelestiaTexture)
+        return nullptr;
+
+    // Decode straight into the buffer the texture is uploaded from
+    std::unique_ptr<Image> img = Image::load(filename, GetPixelUnpackBuffer());
+    if (img != nullptr && colorspace == Texture::LinearColorspace)
         img->forceLinear();
 
-    std::unique_ptr<Texture> tex = CreateTextureFromImage(*img, addressMode, mipMode);
+    return img;
+}
+
+
+std::unique_ptr<Texture>
+CreateTextureFromFileImage(const fs::path& filename,
+                           const Image& img,
+                           Texture::AddressMode addressMode,
+                           Texture::MipMapMode mipMode)
+{
+    std::unique_ptr<Texture> tex = CreateTextureFromImage(img, addressMode, mipMode);
 
-    if (contentType == ContentType::DXT5NormalMap)
+    if (DetermineFileType(filename) == ContentType::DXT5NormalMap)
     {
         // If the texture came from a .dxt5nm file then mark it as a dxt5
         // compressed normal map. There's no separate OpenGL format for dxt5
         // normal maps, so the file extension is the only thing that
         // distinguishes it from a plain old dxt5 texture.
-        if (img->getFormat() == PixelFormat::DXT5)
+        if (img.getFormat() == PixelFormat::DXT5)
         {
             tex->setFormatOptions(Texture::DXT5NormalMap);
         }
@@ -958,6 +1181,19 @@ std::unique_ptr<Texture>
 LoadHeightMapFromFile(const fs::path& filename,
                       float height,
                       Texture::AddressMode addressMode)
+{
+    auto normalMap = LoadHeightMapImage(filename, height, addressMode);
+    if (normalMap == nullptr)
+        return nullptr;
+
+    return CreateTextureFromImage(*normalMap, addressMode, Texture::DefaultMipMaps);
+}
+
+
+std::unique_ptr<Image>
+LoadHeightMapImage(const fs::path& filename,
+                   float height,
+                   Texture::AddressMode addressMode)
 {
     auto img = Image::load(filename);
     if (img == nullptr)
@@ -968,6 +1204,10 @@ LoadHeightMapFromFile(const fs::path& filename,
     auto normalMap = img->computeNormalMap(height, addressMode == Texture::Wrap);
     if (normalMap == nullptr)
         return nullptr;
+    img.reset();
 
-    return CreateTextureFromImage(*normalMap, addressMode, Texture::DefaultMipMaps);
+    // Compute the mipmaps here rather than with glGenerateMipmap, so that
+    // they are built along with the normal map on the loader thread
+    auto mipmapped = normalMap->computeMipMaps();
+    return mipmapped == nullptr ? std::move(normalMap) : std::move(mipmapped);
 }
@@ -10,9 +10,11 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <celcompat/filesystem.h>
 #include <celimage/image.h>
@@ -66,6 +68,9 @@ class Texture
     // is implemented.
     virtual void beginUsage() {};
     virtual void endUsage() {};
+    // Asks for a tile that is likely to be drawn soon to be loaded ahead of
+    // time
+    virtual void prefetchTile(int /* lod */, int /* u */, int /* v */) {};
 
     virtual void setBorderColor(Color);
 
@@ -76,6 +81,9 @@ class Texture
     bool hasAlpha() const { return alpha; }
     bool isCompressed() const { return compressed; }
 
+    //! Estimated size of the texture in video memory, in bytes
+    std::size_t getMemorySize() const { return memorySize; }
+
     /*! Identical formats may need to be treated in slightly different
      *  fashions. One (and currently the only) example is the DXT5 compressed
      *  normal map format, which is an ordinary DXT5 texture but requires some
@@ -115,6 +123,7 @@ class Texture
  protected:
     bool alpha{ false };
     bool compressed{ false };
+    std::size_t memorySize{ 0 };
 
  private:
     int width;
@@ -142,6 +151,48 @@ class ImageTexture : public Texture
 };
 
 
+// A large texture holding equally sized tiles of one pixel format side by
+// side, so that drawing neighbouring tiles needs no texture changes. Tiles
+// have no mipmaps; the subrects returned by getTile() are inset by half a
+// texel so that filtering doesn't pick up the neighbouring tiles.
+class TextureAtlas
+{
+ public:
+    // Returns nullptr if the tiles are too large to fit more than one into
+    // a texture, or the format isn't supported.
+    static std::unique_ptr<TextureAtlas> create(const celestia::engine::Image& tile);
+
+    // Creates an atlas of uTiles x vTiles tiles shaped like the given one
+    TextureAtlas(const celestia::engine::Image& tile, int uTiles, int vTiles);
+    ~TextureAtlas();
+
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    // Whether the image has the size and format of the tiles
+    bool matches(const celestia::engine::Image& img) const;
+    bool isFull() const { return freeSlots.empty(); }
+    bool isEmpty() const { return freeSlots.size() == slotCount; }
+
+    // Copies the first level of a matching image into a free slot and
+    // returns the slot, or -1 if the atlas is full.
+    int addTile(const celestia::engine::Image& img);
+    void removeTile(int slot);
+
+    TextureTile getTile(int slot) const;
+
+ private:
+    unsigned int glName{ 0 };
+    int tileWidth;
+    int tileHeight;
+    celestia::engine::PixelFormat format;
+    bool compressed;
+    int uTiles;
+    std::size_t slotCount;
+    std::vector<int> freeSlots;
+};
+
+
 class TiledTexture : public Texture
 {
  public:
@@ -205,3 +256,21 @@ std::unique_ptr<Texture>
 LoadHeightMapFromFile(const fs::path& filename,
                       float height,
                       Texture::AddressMode addressMode = Texture::EdgeClamp);
+
+// The two functions above split into the part that doesn't need GL, which
+// can run on a background thread, and creating the texture from the image.
+// No image is loaded for virtual textures, they need LoadTextureFromFile.
+std::unique_ptr<celestia::engine::Image>
+LoadTextureImage(const fs::path& filename,
+                 Texture::Colorspace colorspace = Texture::DefaultColorspace);
+
+std::unique_ptr<celestia::engine::Image>
+LoadHeightMapImage(const fs::path& filename,
+                   float height,
+                   Texture::AddressMode addressMode = Texture::EdgeClamp);
+
+std::unique_ptr<Texture>
+CreateTextureFromFileImage(const fs::path& filename,
+                           const celestia::engine::Image& img,
+                           Texture::AddressMode addressMode = Texture::EdgeClamp,
+                           Texture::MipMapMode mipMode = Texture::DefaultMipMaps);
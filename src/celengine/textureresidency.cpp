@@ -0,0 +1,103 @@
+// textureresidency.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Keeps the tiles of all virtual textures within a memory budget.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "textureresidency.h"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+
+#include "virtualtex.h"
+
+namespace
+{
+
+// Eviction frees memory down to this fraction of the budget, so that it
+// doesn't run again as soon as the next tile is loaded
+constexpr std::uint64_t EvictionTargetPercent = 90;
+
+} // end unnamed namespace
+
+void
+TextureResidencyManager::beginFrame()
+{
+    ++m_frame;
+    if (m_budget > 0 && m_residentBytes > m_budget && m_residentBytes > m_blockedBytes)
+        evict();
+}
+
+void
+TextureResidencyManager::addTexture(VirtualTexture* texture)
+{
+    m_textures.push_back(texture);
+}
+
+void
+TextureResidencyManager::removeTexture(VirtualTexture* texture)
+{
+    m_textures.erase(std::remove(m_textures.begin(), m_textures.end(), texture), m_textures.end());
+}
+
+void
+TextureResidencyManager::tileLoaded(std::uint64_t size)
+{
+    ++m_residentTiles;
+    m_residentBytes += size;
+}
+
+void
+TextureResidencyManager::tileUnloaded(std::uint64_t size)
+{
+    assert(m_residentTiles > 0 && m_residentBytes >= size);
+    --m_residentTiles;
+    m_residentBytes -= size;
+}
+
+void
+TextureResidencyManager::evict()
+{
+    m_candidates.clear();
+    for (const VirtualTexture* texture : m_textures)
+        texture->getEvictableTiles(m_candidates, m_frame - 1);
+
+    std::sort(m_candidates.begin(), m_candidates.end(),
+              [](const ResidentTile& a, const ResidentTile& b) { return a.lastUsed < b.lastUsed; });
+
+    // Find the oldest frame whose tiles can stay. All tiles last used before
+    // it are evicted, which may free a little more than needed.
+    std::uint64_t target = m_budget / 100 * EvictionTargetPercent;
+    std::uint64_t resident = m_residentBytes;
+    std::uint32_t cutoff = 0;
+    for (const ResidentTile& tile : m_candidates)
+    {
+        if (resident <= target && tile.lastUsed >= cutoff)
+            break;
+        resident -= tile.size;
+        cutoff = tile.lastUsed + 1;
+    }
+
+    if (cutoff > 0)
+    {
+        std::uint64_t residentTiles = m_residentTiles;
+        for (VirtualTexture* texture : m_textures)
+            texture->evictTiles(cutoff);
+        m_evictedTiles += residentTiles - m_residentTiles;
+    }
+
+    m_blockedBytes = m_residentBytes > m_budget ? m_residentBytes : 0;
+}
+
+TextureResidencyManager&
+GetTextureResidencyManager()
+{
+    static TextureResidencyManager* const manager = std::make_unique<TextureResidencyManager>().release(); //NOSONAR
+    return *manager;
+}
@@ -0,0 +1,75 @@
+// textureresidency.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Keeps the tiles of all virtual textures within a memory budget.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class VirtualTexture;
+
+// Tracks the memory used by resident virtual texture tiles and, when it
+// exceeds the budget, evicts the tiles that have gone unused the longest,
+// whichever texture they belong to. Tiles are stamped with the frame number
+// when they are used; tiles used in the current or the previous frame are
+// never evicted, and neither are the coarsest tiles of a texture, which are
+// drawn while finer ones stream in.
+//
+// Only used from the render thread.
+class TextureResidencyManager
+{
+public:
+    struct ResidentTile
+    {
+        std::uint32_t lastUsed;
+        std::uint64_t size;
+    };
+
+    TextureResidencyManager() = default;
+    ~TextureResidencyManager() = default;
+
+    TextureResidencyManager(const TextureResidencyManager&) = delete;
+    TextureResidencyManager& operator=(const TextureResidencyManager&) = delete;
+
+    // Budget in bytes, zero for no limit
+    void setBudget(std::uint64_t budget) { m_budget = budget; }
+    std::uint64_t getBudget() const { return m_budget; }
+
+    // Advances the frame number and evicts tiles if over budget
+    void beginFrame();
+    std::uint32_t getFrame() const { return m_frame; }
+
+    void addTexture(VirtualTexture*);
+    void removeTexture(VirtualTexture*);
+
+    void tileLoaded(std::uint64_t size);
+    void tileUnloaded(std::uint64_t size);
+
+    std::uint64_t getResidentTiles() const { return m_residentTiles; }
+    std::uint64_t getResidentBytes() const { return m_residentBytes; }
+    std::uint64_t getEvictedTiles() const { return m_evictedTiles; }
+
+private:
+    void evict();
+
+    std::vector<VirtualTexture*> m_textures;
+    std::vector<ResidentTile> m_candidates;
+    std::uint64_t m_budget{ 0 };
+    std::uint64_t m_residentTiles{ 0 };
+    std::uint64_t m_residentBytes{ 0 };
+    std::uint64_t m_evictedTiles{ 0 };
+    // Resident bytes when eviction last failed to get under the budget; no
+    // new attempt is made until more memory is used
+    std::uint64_t m_blockedBytes{ 0 };
+    std::uint32_t m_frame{ 1 };
+};
+
+TextureResidencyManager& GetTextureResidencyManager();
@@ -0,0 +1,121 @@
+// tiledprojectionmode.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "tiledprojectionmode.h"
+
+#include <cmath>
+
+#include <celmath/frustum.h>
+#include <celmath/geomutil.h>
+
+namespace celestia::engine
+{
+
+TiledProjectionMode::TiledProjectionMode(float width, float height, int distanceToScreen, int screenDpi, const DisplayTile& tile) :
+    PerspectiveProjectionMode(width, height, distanceToScreen, screenDpi),
+    tile(tile)
+{
+}
+
+Eigen::Matrix4f TiledProjectionMode::getProjectionMatrix(float nearZ, float farZ, float zoom) const
+{
+    float left;
+    float right;
+    float top;
+    float bottom;
+    getTileEdges(zoom, left, right, top, bottom);
+
+    // Off-axis perspective as with glFrustum, with the edges at unit distance
+    Eigen::Matrix4f m = Eigen::Matrix4f::Zero();
+    m(0, 0) = 2.0f / (right - left);
+    m(0, 2) = (right + left) / (right - left);
+    m(1, 1) = 2.0f / (top - bottom);
+    m(1, 2) = (top + bottom) / (top - bottom);
+    m(2, 2) = -(farZ + nearZ) / (farZ - nearZ);
+    m(2, 3) = -2.0f * farZ * nearZ / (farZ - nearZ);
+    m(3, 2) = -1.0f;
+    return m;
+}
+
+float TiledProjectionMode::getFOV(float zoom) const
+{
+    return math::PerspectiveFOV(getWallHeight(), screenDpi, distanceToScreen) / zoom;
+}
+
+float TiledProjectionMode::getZoom(float fov) const
+{
+    return math::PerspectiveFOV(getWallHeight(), screenDpi, distanceToScreen) / fov;
+}
+
+float TiledProjectionMode::getPixelSize(float zoom) const
+{
+    return 2.0f * std::tan(getFOV(zoom) * 0.5f) / getWallHeight();
+}
+
+math::Frustum
+TiledProjectionMode::getFrustum(float nearZ, float farZ, float zoom) const
+{
+    float left;
+    float right;
+    float top;
+    float bottom;
+    getTileEdges(zoom, left, right, top, bottom);
+    return math::Frustum(left * nearZ, right * nearZ, top * nearZ, bottom * nearZ, nearZ, farZ);
+}
+
+math::InfiniteFrustum
+TiledProjectionMode::getInfiniteFrustum(float nearZ, float zoom) const
+{
+    return math::InfiniteFrustum(getFOV(zoom), getWallWidth() / getWallHeight(), nearZ);
+}
+
+double TiledProjectionMode::getViewConeAngleMax(float zoom) const
+{
+    double h = std::tan(static_cast<double>(getFOV(zoom)) / 2.0);
+    double w = h * static_cast<double>(getWallWidth()) / static_cast<double>(getWallHeight());
+    double diag = std::sqrt(1.0 + h * h + w * w);
+    return 1.0 / diag;
+}
+
+Eigen::Vector3f TiledProjectionMode::getPickRay(float x, float y, float zoom) const
+{
+    // x and y are relative to the tile center in units of the tile height,
+    // convert them to the wall
+    float tileX = x * height / width + 0.5f;
+    float tileY = 0.5f - y;
+    float wallX = (tile.x + tileX * tile.width - 0.5f) * getWallWidth() / getWallHeight();
+    float wallY = 0.5f - (tile.y + tileY * tile.height);
+
+    float s = 2.0f * std::tan(getFOV(zoom) / 2.0f);
+    Eigen::Vector3f pickDirection(wallX * s, wallY * s, -1.0f);
+
+    return pickDirection.normalized();
+}
+
+float TiledProjectionMode::getWallWidth() const
+{
+    return width / tile.width;
+}
+
+float TiledProjectionMode::getWallHeight() const
+{
+    return height / tile.height;
+}
+
+void TiledProjectionMode::getTileEdges(float zoom, float& left, float& right, float& top, float& bottom) const
+{
+    float h = std::tan(getFOV(zoom) * 0.5f);
+    float w = h * getWallWidth() / getWallHeight();
+    left = -w + 2.0f * w * tile.x;
+    right = left + 2.0f * w * tile.width;
+    top = h - 2.0f * h * tile.y;
+    bottom = top - 2.0f * h * tile.height;
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,61 @@
+// tiledprojectionmode.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Perspective projection of one tile of a larger display.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <Eigen/Core>
+
+#include <celengine/perspectiveprojectionmode.h>
+
+namespace celestia::engine
+{
+
+// Part of a display covered by a tile, in fractions of the display width
+// and height measured from its top left corner
+struct DisplayTile
+{
+    float x{ 0.0f };
+    float y{ 0.0f };
+    float width{ 1.0f };
+    float height{ 1.0f };
+};
+
+// Renders one tile of a video wall as an off-axis part of the perspective
+// projection of the whole wall. The field of view, the pixel size and the
+// zoom refer to the wall, whose size in pixels follows from the size of
+// the tile, so that all tiles of a wall show the same scene. Culling uses
+// the frustum of the tile where the renderer allows an asymmetric frustum
+// and that of the whole wall otherwise.
+class TiledProjectionMode : public PerspectiveProjectionMode
+{
+public:
+    TiledProjectionMode(float width, float height, int distanceToScreen, int screenDpi, const DisplayTile& tile);
+
+    Eigen::Matrix4f getProjectionMatrix(float nearZ, float farZ, float zoom) const override;
+    float getFOV(float zoom) const override;
+    float getZoom(float fov) const override;
+    float getPixelSize(float zoom) const override;
+    math::Frustum getFrustum(float nearZ, float farZ, float zoom) const override;
+    math::InfiniteFrustum getInfiniteFrustum(float nearZ, float zoom) const override;
+    double getViewConeAngleMax(float zoom) const override;
+
+    Eigen::Vector3f getPickRay(float x, float y, float zoom) const override;
+
+private:
+    float getWallWidth() const;
+    float getWallHeight() const;
+    // Edges of the tile at unit distance
+    void getTileEdges(float zoom, float& left, float& right, float& top, float& bottom) const;
+
+    DisplayTile tile;
+};
+
+} // end namespace celestia::engine
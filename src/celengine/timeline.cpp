@@ -10,6 +10,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include "celengine/timeline.h"
 #include "celengine/timelinephase.h"
 #include "celengine/frametree.h"
@@ -45,6 +46,7 @@ Timeline::appendPhase(TimelinePhase::SharedConstPtr &phase)
     }
 
     phases.push_back(phase);
+    endTimes.push_back(phase->endTime());
 
     return true;
 }
@@ -54,23 +56,26 @@ const TimelinePhase::SharedConstPtr&
 Timeline::findPhase(double t) const
 {
     // Find the phase containing time t. The overwhelming common case is
-    // nPhases = 1, so we special case that. Otherwise, we do a simple linear search,
-    // as the number of phases in a timeline should always be quite small.
+    // nPhases = 1, so we special case that.
     if (phases.size() == 1)
-    {
         return phases[0];
-    }
-    else
+
+    // Successive lookups are nearly always for the same or nearby times, so
+    // check the phase found last before searching. Times before the first
+    // phase belong to the first one, and times after the last phase to the
+    // last one.
+    std::size_t last = lastPhase.load(std::memory_order_relaxed);
+    if ((last == 0 || phases[last]->startTime() <= t) &&
+        (last + 1 == phases.size() || t < endTimes[last]))
     {
-        for (const auto& phase : phases)
-        {
-            if (t < phase->endTime())
-                return phase;
-        }
-
-        // Time is greater than the end time of the final phase. Just return the final phase.
-        return phases.back();
+        return phases[last];
     }
+
+    auto iter = std::upper_bound(endTimes.begin(), endTimes.end(), t);
+    std::size_t index = std::min(static_cast<std::size_t>(iter - endTimes.begin()), phases.size() - 1);
+    lastPhase.store(index, std::memory_order_relaxed);
+
+    return phases[index];
 }
 
 
@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <vector>
 #include "timelinephase.h"
@@ -35,4 +37,9 @@ public:
 
 private:
     std::vector<TimelinePhase::SharedConstPtr> phases;
+    // End times of the phases, which are sorted since phases don't overlap
+    std::vector<double> endTimes;
+    // Index of the phase found by the last lookup; atomic as scripts may
+    // look up phases from threads of their own
+    mutable std::atomic<std::size_t> lastPhase{ 0 };
 };
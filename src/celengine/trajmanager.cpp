@@ -20,17 +20,18 @@ std::shared_ptr<const ephem::Orbit>
 TrajectoryManager::find(const fs::path& source,
                         const fs::path& path,
                         ephem::TrajectoryInterpolation interpolation,
-                        ephem::TrajectoryPrecision precision)
+                        ephem::TrajectoryPrecision precision,
+                        double tolerance)
 {
     auto filename = path.empty()
         ? "data" / source
         : path / "data" / source;
 
-    auto it = orbits.try_emplace(Key { std::move(filename), interpolation, precision }).first;
+    auto it = orbits.try_emplace(Key { std::move(filename), interpolation, precision, tolerance }).first;
     if (auto cachedOrbit = it->second.lock(); cachedOrbit != nullptr)
         return cachedOrbit;
 
-    auto orbit = ephem::LoadSampledTrajectory(it->first.path, interpolation, precision);
+    auto orbit = ephem::LoadSampledTrajectory(it->first.path, interpolation, precision, tolerance);
     if (orbit == nullptr)
     {
         orbits.erase(it);
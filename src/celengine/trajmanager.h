@@ -33,7 +33,8 @@ public:
     std::shared_ptr<const ephem::Orbit> find(const fs::path& source,
                                              const fs::path& path,
                                              ephem::TrajectoryInterpolation interpolation,
-                                             ephem::TrajectoryPrecision precision);
+                                             ephem::TrajectoryPrecision precision,
+                                             double tolerance = 0.0);
 
 private:
     struct Key
@@ -41,10 +42,12 @@ private:
         fs::path path;
         ephem::TrajectoryInterpolation interpolation;
         ephem::TrajectoryPrecision precision;
+        double tolerance;
 
         friend bool operator==(const Key& lhs, const Key& rhs) noexcept
         {
-            return lhs.path == rhs.path && lhs.interpolation == rhs.interpolation && lhs.precision == rhs.precision;
+            return lhs.path == rhs.path && lhs.interpolation == rhs.interpolation && lhs.precision == rhs.precision &&
+                   lhs.tolerance == rhs.tolerance;
         }
 
         friend bool operator!=(const Key& lhs, const Key& rhs) noexcept
@@ -69,6 +72,7 @@ private:
             auto seed = fs::hash_value(key.path);
             seed ^= std::hash<ephem::TrajectoryInterpolation>{}(key.interpolation) + phi + (seed << 6) + (seed >> 2);
             seed ^= std::hash<ephem::TrajectoryPrecision>{}(key.precision) + phi + (seed << 6) + (seed >> 2);
+            seed ^= std::hash<double>{}(key.tolerance) + phi + (seed << 6) + (seed >> 2);
             return seed;
         }
     };
@@ -32,12 +32,14 @@ class UniversalCoord
     }
 
     UniversalCoord(double _x, double _y, double _z) :
-        x(_x), y(_y), z(_z)
+        x(celestia::util::fromDouble(_x)),
+        y(celestia::util::fromDouble(_y)),
+        z(celestia::util::fromDouble(_z))
     {
     }
 
     explicit UniversalCoord(const Eigen::Vector3d& v) :
-        x(v.x()), y(v.y()), z(v.z())
+        UniversalCoord(v.x(), v.y(), v.z())
     {
     }
 
@@ -47,7 +49,7 @@ class UniversalCoord
     /** Compute a universal coordinate that is the sum of this coordinate and
       * an offset in kilometers.
       */
-    UniversalCoord offsetKm(const Eigen::Vector3d& v)
+    UniversalCoord offsetKm(const Eigen::Vector3d& v) const
     {
         Eigen::Vector3d vUly = v * celestia::astro::kilometersToMicroLightYears(1.0);
         return *this + UniversalCoord(vUly);
@@ -60,7 +62,7 @@ class UniversalCoord
       * necessary to use it in new code, where the use of the rather the rather
       * obscure unit micro-light year isn't necessary.
       */
-    UniversalCoord offsetUly(const Eigen::Vector3d& vUly)
+    UniversalCoord offsetUly(const Eigen::Vector3d& vUly) const
     {
         return *this + UniversalCoord(vUly);
     }
@@ -71,9 +73,7 @@ class UniversalCoord
       */
     Eigen::Vector3d offsetFromKm(const UniversalCoord& uc) const
     {
-        return Eigen::Vector3d(static_cast<double>(x - uc.x),
-                               static_cast<double>(y - uc.y),
-                               static_cast<double>(z - uc.z)) * celestia::astro::microLightYearsToKilometers(1.0);
+        return offsetFromUly(uc) * celestia::astro::microLightYearsToKilometers(1.0);
     }
 
     /** Get the offset in light years of this coordinate from a point (also with
@@ -83,9 +83,9 @@ class UniversalCoord
     Eigen::Vector3f offsetFromLy(const Eigen::Vector3f& v) const
     {
         Eigen::Vector3f vUly = v * 1.0e6f;
-        Eigen::Vector3f offsetUly(static_cast<float>(static_cast<double>(x - R128(vUly.x()))),
-                                  static_cast<float>(static_cast<double>(y - R128(vUly.y()))),
-                                  static_cast<float>(static_cast<double>(z - R128(vUly.z()))));
+        Eigen::Vector3f offsetUly(static_cast<float>(difference(x, vUly.x())),
+                                  static_cast<float>(difference(y, vUly.y())),
+                                  static_cast<float>(difference(z, vUly.z())));
         return offsetUly * 1.0e-6f;
     }
 
@@ -99,9 +99,9 @@ class UniversalCoord
       */
     Eigen::Vector3d offsetFromUly(const UniversalCoord& uc) const
     {
-        return Eigen::Vector3d(static_cast<double>(x - uc.x),
-                               static_cast<double>(y - uc.y),
-                               static_cast<double>(z - uc.z));
+        return Eigen::Vector3d(difference(x, uc.x),
+                               difference(y, uc.y),
+                               difference(z, uc.z));
     }
 
     /** Get the value of the coordinate in light years. The result is truncated to
@@ -109,9 +109,9 @@ class UniversalCoord
       */
     Eigen::Vector3d toLy() const
     {
-        return Eigen::Vector3d(static_cast<double>(x),
-                               static_cast<double>(y),
-                               static_cast<double>(z)) * 1.0e-6;
+        return Eigen::Vector3d(celestia::util::toDouble(x),
+                               celestia::util::toDouble(y),
+                               celestia::util::toDouble(z)) * 1.0e-6;
     }
 
     double distanceFromKm(const UniversalCoord& uc) const
@@ -164,19 +164,32 @@ class UniversalCoord
         return isOutOfBounds(x) || isOutOfBounds(y) || isOutOfBounds(z);
     }
 
+private:
+    static double difference(const R128& a, const R128& b)
+    {
+        return celestia::util::toDouble(celestia::util::subR128(a, b));
+    }
+
+    static double difference(const R128& a, double b)
+    {
+        return difference(a, celestia::util::fromDouble(b));
+    }
+
 public:
-    R128 x { 0 };
-    R128 y { 0 };
-    R128 z { 0 };
+    R128 x { 0, 0 };
+    R128 y { 0, 0 };
+    R128 z { 0, 0 };
 
 };
 
 inline UniversalCoord operator+(const UniversalCoord& uc0, const UniversalCoord& uc1)
 {
-    return UniversalCoord(uc0.x + uc1.x, uc0.y + uc1.y, uc0.z + uc1.z);
+    using celestia::util::addR128;
+    return UniversalCoord(addR128(uc0.x, uc1.x), addR128(uc0.y, uc1.y), addR128(uc0.z, uc1.z));
 }
 
 inline UniversalCoord operator-(const UniversalCoord& uc0, const UniversalCoord& uc1)
 {
-    return UniversalCoord(uc0.x - uc1.x, uc0.y - uc1.y, uc0.z - uc1.z);
+    using celestia::util::subR128;
+    return UniversalCoord(subR128(uc0.x, uc1.x), subR128(uc0.y, uc1.y), subR128(uc0.z, uc1.z));
 }
@@ -30,6 +30,7 @@
 #include "location.h"
 #include "meshmanager.h"
 #include "render.h"
+#include "staroctreetraversal.h"
 #include "timelinephase.h"
 
 namespace engine = celestia::engine;
@@ -42,7 +43,7 @@ namespace
 constexpr double ANGULAR_RES = 3.5e-6;
 
 
-class ClosestStarFinder : public StarHandler
+class ClosestStarFinder final : public StarHandler
 {
 public:
     ClosestStarFinder(float _maxDistance, const Universe* _universe);
@@ -81,7 +82,7 @@ ClosestStarFinder::process(const Star& star, float distance, float /*unused*/)
 }
 
 
-class NearStarFinder : public StarHandler
+class NearStarFinder final : public StarHandler
 {
 public:
     NearStarFinder(float _maxDistance, std::vector<const Star*>& nearStars);
@@ -154,32 +155,31 @@ ApproxPlanetPickTraversal(Body* body, PlanetPickInfo& pickInfo)
 }
 
 
-// Perform an intersection test between the pick ray and a body
-bool
-ExactPlanetPickTraversal(Body* body, PlanetPickInfo& pickInfo)
+// Perform an intersection test between a ray, relative to the center of a
+// body, and the body's ellipsoid or mesh. Returns the distance along the
+// ray to the intersection, or a negative value if there is none.
+double
+IntersectBody(const Body& body, const Eigen::ParametrizedLine<double, 3>& ray, double jd)
 {
-    Eigen::Vector3d bpos = body->getAstrocentricPosition(pickInfo.jd);
-    float radius = body->getRadius();
+    float radius = body.getRadius();
     double distance = -1.0;
 
     // Test for intersection with the bounding sphere
-    if (!body->isVisible() || !body->extant(pickInfo.jd) || !body->isClickable() ||
-        !math::testIntersection(pickInfo.pickRay, math::Sphered(bpos, radius), distance))
-        return true;
+    if (!math::testIntersection(ray, math::Sphered(Eigen::Vector3d::Zero(), radius), distance))
+        return -1.0;
 
-    if (body->getGeometry() == InvalidResource)
+    if (body.getGeometry() == InvalidResource)
     {
         // There's no mesh, so the object is an ellipsoid.  If it's
         // spherical, we've already done all the work we need to. Otherwise,
         // we need to perform a ray-ellipsoid intersection test.
-        if (!body->isSphere())
+        if (!body.isSphere())
         {
-            Eigen::Vector3d ellipsoidAxes = body->getSemiAxes().cast<double>();
+            Eigen::Vector3d ellipsoidAxes = body.getSemiAxes().cast<double>();
 
             // Transform rotate the pick ray into object coordinates
-            Eigen::Matrix3d m = body->getEclipticToEquatorial(pickInfo.jd).toRotationMatrix();
-            Eigen::ParametrizedLine<double, 3> r(pickInfo.pickRay.origin() - bpos, pickInfo.pickRay.direction());
-            r = math::transformRay(r, m);
+            Eigen::Matrix3d m = body.getEclipticToEquatorial(jd).toRotationMatrix();
+            Eigen::ParametrizedLine<double, 3> r = math::transformRay(ray, m);
             if (!math::testIntersection(r, math::Ellipsoidd(ellipsoidAxes), distance))
                 distance = -1.0;
         }
@@ -187,13 +187,12 @@ ExactPlanetPickTraversal(Body* body, PlanetPickInfo& pickInfo)
     else
     {
         // Transform rotate the pick ray into object coordinates
-        Eigen::Quaterniond qd = body->getGeometryOrientation().cast<double>();
-        Eigen::Matrix3d m = (qd * body->getEclipticToBodyFixed(pickInfo.jd)).toRotationMatrix();
-        Eigen::ParametrizedLine<double, 3> r(pickInfo.pickRay.origin() - bpos, pickInfo.pickRay.direction());
-        r = math::transformRay(r, m);
+        Eigen::Quaterniond qd = body.getGeometryOrientation().cast<double>();
+        Eigen::Matrix3d m = (qd * body.getEclipticToBodyFixed(jd)).toRotationMatrix();
+        Eigen::ParametrizedLine<double, 3> r = math::transformRay(ray, m);
 
-        const Geometry* geometry = engine::GetGeometryManager()->find(body->getGeometry());
-        float scaleFactor = body->getGeometryScale();
+        const Geometry* geometry = engine::GetGeometryManager()->find(body.getGeometry());
+        float scaleFactor = body.getGeometryScale();
         if (geometry != nullptr && geometry->isNormalized())
             scaleFactor = radius;
 
@@ -207,6 +206,22 @@ ExactPlanetPickTraversal(Body* body, PlanetPickInfo& pickInfo)
         if (geometry != nullptr && !geometry->pick(r, distance))
             distance = -1.0;
     }
+
+    return distance;
+}
+
+
+// Perform an intersection test between the pick ray and a body
+bool
+ExactPlanetPickTraversal(Body* body, PlanetPickInfo& pickInfo)
+{
+    if (!body->isVisible() || !body->extant(pickInfo.jd) || !body->isClickable())
+        return true;
+
+    Eigen::Vector3d bpos = body->getAstrocentricPosition(pickInfo.jd);
+    Eigen::ParametrizedLine<double, 3> ray(pickInfo.pickRay.origin() - bpos, pickInfo.pickRay.direction());
+    double distance = IntersectBody(*body, ray, pickInfo.jd);
+
     // Make also sure that the pickRay does not intersect the body in the
     // opposite hemisphere! Hence, need again the "bodyMiss" angle
 
@@ -239,12 +254,8 @@ traverseFrameTree(const FrameTree* frameTree,
                   F func,
                   PlanetPickInfo& info)
 {
-    for (unsigned int i = 0; i < frameTree->childCount(); i++)
+    for (const TimelinePhase* phase : frameTree->activeChildren(tdb))
     {
-        const TimelinePhase* phase = frameTree->getChild(i);
-        if (!phase->includes(tdb))
-            continue;
-
         Body* body = phase->body();
         if (!func(body, info))
             return false;
@@ -260,8 +271,8 @@ traverseFrameTree(const FrameTree* frameTree,
 }
 
 
-// StarPicker is a callback class for StarDatabase::findVisibleStars
-class StarPicker : public StarHandler
+// StarPicker is a callback class for StarDatabase::processVisibleStars
+class StarPicker final : public StarHandler
 {
 public:
     StarPicker(const Eigen::Vector3f&, const Eigen::Vector3f&, double, float);
@@ -330,7 +341,7 @@ StarPicker::process(const Star& star, float /*unused*/, float /*unused*/)
 }
 
 
-class CloseStarPicker : public StarHandler
+class CloseStarPicker final : public StarHandler
 {
 public:
     CloseStarPicker(const UniversalCoord& pos,
@@ -581,6 +592,7 @@ void
 Universe::setStarCatalog(std::unique_ptr<StarDatabase>&& catalog)
 {
     starCatalog = std::move(catalog);
+    pathCache.clear();
 }
 
 
@@ -594,6 +606,7 @@ void
 Universe::setSolarSystemCatalog(std::unique_ptr<SolarSystemCatalog>&& catalog)
 {
     solarSystemCatalog = std::move(catalog);
+    pathCache.clear();
 }
 
 
@@ -608,6 +621,7 @@ void
 Universe::setDSOCatalog(std::unique_ptr<DSODatabase>&& catalog)
 {
     dsoCatalog = std::move(catalog);
+    pathCache.clear();
 }
 
 
@@ -716,33 +730,44 @@ Universe::markObject(const Selection& sel,
                      bool occludable,
                      celestia::MarkerSizing sizing)
 {
-    if (auto iter = std::find_if(markers.begin(), markers.end(),
-                                 [&sel](const auto& m) { return m.object() == sel; });
-        iter != markers.end())
+    celestia::Marker* marker;
+    if (auto [iter, inserted] = markerIndex.try_emplace(sel, markers.size()); inserted)
+    {
+        marker = &markers.emplace_back(sel);
+    }
+    else
     {
         // Handle the case when the object is already marked.  If the
         // priority is higher or equal to the existing marker, replace it.
         // Otherwise, do nothing.
-        if (priority < iter->priority())
+        marker = &markers[iter->second];
+        if (priority < marker->priority())
             return;
-        markers.erase(iter);
     }
 
-    celestia::Marker& marker = markers.emplace_back(sel);
-    marker.setRepresentation(rep);
-    marker.setPriority(priority);
-    marker.setOccludable(occludable);
-    marker.setSizing(sizing);
+    marker->setRepresentation(rep);
+    marker->setPriority(priority);
+    marker->setOccludable(occludable);
+    marker->setSizing(sizing);
 }
 
 
 void
 Universe::unmarkObject(const Selection& sel, int priority)
 {
-    auto iter = std::find_if(markers.begin(), markers.end(),
-                             [&sel](const auto& m) { return m.object() == sel; });
-    if (iter != markers.end() && priority >= iter->priority())
-        markers.erase(iter);
+    auto iter = markerIndex.find(sel);
+    if (iter == markerIndex.end() || priority < markers[iter->second].priority())
+        return;
+
+    // Move the last marker into the place of the removed one
+    std::size_t index = iter->second;
+    markerIndex.erase(iter);
+    if (index != markers.size() - 1)
+    {
+        markers[index] = std::move(markers.back());
+        markerIndex[markers[index].object()] = index;
+    }
+    markers.pop_back();
 }
 
 
@@ -750,15 +775,15 @@ void
 Universe::unmarkAll()
 {
     markers.clear();
+    markerIndex.clear();
 }
 
 
 bool
 Universe::isMarked(const Selection& sel, int priority) const
 {
-    auto iter = std::find_if(markers.begin(), markers.end(),
-                             [&sel](const auto& m) { return m.object() == sel; });
-    return iter != markers.end() && iter->priority() >= priority;
+    auto iter = markerIndex.find(sel);
+    return iter != markerIndex.end() && markers[iter->second].priority() >= priority;
 }
 
 
@@ -845,7 +870,7 @@ Universe::pickStar(const UniversalCoord& origin,
     // precision test isn't nearly fast enough to use on our database of
     // over 100k stars.
     CloseStarPicker closePicker(origin, direction, when, 1.0f, tolerance);
-    starCatalog->findCloseStars(closePicker, o, 1.0f);
+    starCatalog->processCloseStars(closePicker, o, 1.0f);
     if (closePicker.closestStar != nullptr)
         return Selection(const_cast<Star*>(closePicker.closestStar));
 
@@ -856,11 +881,12 @@ Universe::pickStar(const UniversalCoord& origin,
     rotation.setFromTwoVectors(-Eigen::Vector3f::UnitZ(), direction);
 
     StarPicker picker(o, direction, when, tolerance);
-    starCatalog->findVisibleStars(picker,
-                                  o,
-                                  rotation.conjugate(),
-                                  tolerance, 1.0f,
-                                  faintestMag);
+    starCatalog->processVisibleStars(picker,
+                                     nullptr,
+                                     o,
+                                     rotation.conjugate(),
+                                     tolerance, 1.0f,
+                                     faintestMag);
     if (picker.pickedStar != nullptr)
         return Selection(const_cast<Star*>(picker.pickedStar));
     else
@@ -880,7 +906,7 @@ Universe::pickDeepSkyObject(const UniversalCoord& origin,
 
     CloseDSOPicker closePicker(orig, dir, renderFlags, 1e9, tolerance);
 
-    dsoCatalog->findCloseDSOs(closePicker, orig, 1e9);
+    dsoCatalog->findDSOsAlongRay(closePicker, orig, dir, 1e9);
     if (closePicker.closestDSO != nullptr)
     {
         return Selection(const_cast<DeepSkyObject*>(closePicker.closestDSO));
@@ -903,6 +929,103 @@ Universe::pickDeepSkyObject(const UniversalCoord& origin,
 }
 
 
+Selection
+Universe::pickRendered(util::array_view<RenderListEntry> renderList,
+                       const Eigen::Vector3f& direction,
+                       double when,
+                       float tolerance) const
+{
+    // The same tests as pickPlanet, with the positions the renderer has
+    // already computed instead of a traversal of the frame trees
+    double sinTol2 = std::max(std::sin(tolerance / 2.0), ANGULAR_RES);
+    double atanTolerance = std::max(static_cast<double>(std::atan(tolerance)), ANGULAR_RES);
+    Eigen::Vector3d dir = direction.cast<double>();
+
+    Body* hitBody = nullptr;
+    double hitDistance = 1.0e50;
+    Body* closestBody = nullptr;
+    double closestSinAngle2 = 1.0;
+    double closestDistance = 1.0e50;
+    const Star* hitStar = nullptr;
+    double hitStarDistance = 1.0e50;
+    const Star* closestStar = nullptr;
+    double closestStarSinAngle2 = 1.0;
+
+    for (const RenderListEntry& rle : renderList)
+    {
+        Eigen::Vector3d position = rle.position.cast<double>();
+        double distance = position.norm();
+        if (distance <= 0.0)
+            continue;
+
+        double sinAngle2 = (position / distance - dir).norm() / 2.0;
+        Eigen::ParametrizedLine<double, 3> ray(-position, dir);
+
+        if (rle.renderableType == RenderListEntry::RenderableStar)
+        {
+            double hit;
+            if (math::testIntersection(ray, math::Sphered(Eigen::Vector3d::Zero(), rle.star->getRadius()), hit) &&
+                hit > 0.0 && hit < hitStarDistance)
+            {
+                hitStarDistance = hit;
+                hitStar = rle.star;
+            }
+            if (sinAngle2 < closestStarSinAngle2)
+            {
+                closestStarSinAngle2 = sinAngle2;
+                closestStar = rle.star;
+            }
+            continue;
+        }
+
+        if (rle.renderableType != RenderListEntry::RenderableBody || !rle.body->isClickable())
+            continue;
+
+        Body* body = rle.body;
+        if (sinAngle2 < (celestia::numbers::sqrt2 * 0.5))
+        {
+            if (double hit = IntersectBody(*body, ray, when); hit > 0.0 && hit <= hitDistance)
+            {
+                hitDistance = hit;
+                hitBody = body;
+            }
+        }
+
+        // Prefer a planet to its satellites when its system looks small
+        if (atanTolerance > body->getOrbit(when)->getBoundingRadius() / distance)
+            continue;
+
+        if (sinAngle2 <= closestSinAngle2)
+        {
+            closestSinAngle2 = std::max(sinAngle2, ANGULAR_RES);
+            closestBody = body;
+            closestDistance = distance;
+        }
+    }
+
+    if (hitBody != nullptr)
+    {
+        // A satellite close to the ray in front of the body hit is taken
+        // instead
+        if (closestBody != hitBody && closestSinAngle2 <= sinTol2 && hitDistance > closestDistance)
+            return Selection(closestBody);
+        return Selection(hitBody);
+    }
+
+    if (closestBody != nullptr && closestSinAngle2 <= sinTol2)
+        return Selection(closestBody);
+
+    // Stars are in the render list when they are large enough to show
+    // their surface
+    if (hitStar != nullptr)
+        return Selection(const_cast<Star*>(hitStar));
+    if (closestStar != nullptr && closestStarSinAngle2 <= sinTol2)
+        return Selection(const_cast<Star*>(closestStar));
+
+    return Selection();
+}
+
+
 Selection
 Universe::pick(const UniversalCoord& origin,
                const Eigen::Vector3f& direction,
@@ -1079,6 +1202,51 @@ Universe::find(std::string_view s,
 }
 
 
+Selection
+Universe::find(const SelectionId& id) const
+{
+    switch (id.type)
+    {
+    case SelectionType::Star:
+        return starCatalog == nullptr ? Selection() : Selection(starCatalog->find(id.catalogNumber));
+    case SelectionType::DeepSky:
+        return dsoCatalog == nullptr ? Selection() : Selection(dsoCatalog->find(id.catalogNumber));
+    case SelectionType::Body:
+    case SelectionType::Location:
+        break;
+    default:
+        return Selection();
+    }
+
+    const Star* star = starCatalog == nullptr ? nullptr : starCatalog->find(id.catalogNumber);
+    const SolarSystem* solarSystem = star == nullptr ? nullptr : getSolarSystem(star);
+    const PlanetarySystem* system = solarSystem == nullptr ? nullptr : solarSystem->getPlanets();
+    Body* body = nullptr;
+    for (std::uint8_t i = 0; i < id.depth; ++i)
+    {
+        if (system == nullptr || id.path[i] >= static_cast<std::uint32_t>(system->getSystemSize()))
+            return Selection();
+        body = system->getBody(static_cast<int>(id.path[i]));
+        system = body->getSatellites();
+    }
+
+    if (body == nullptr || id.type == SelectionType::Body)
+        return Selection(body);
+
+    auto locations = GetBodyFeaturesManager()->getLocations(body);
+    if (!locations.has_value())
+        return Selection();
+
+    std::uint32_t index = id.location;
+    for (Location* location : *locations)
+    {
+        if (index-- == 0)
+            return Selection(location);
+    }
+
+    return Selection();
+}
+
 // Find an object from a path, for example Sol/Earth/Moon or Upsilon And/b
 // Currently, 'absolute' paths starting with a / are not supported nor are
 // paths that contain galaxies.  The caller may pass in a list of solar systems
@@ -1089,6 +1257,35 @@ Selection
 Universe::findPath(std::string_view s,
                    util::array_view<const Selection> contexts,
                    bool i18n) const
+{
+    if (auto generation = PlanetarySystem::getNameIndexGeneration(); generation != pathCacheGeneration)
+    {
+        pathCache.clear();
+        pathCacheGeneration = generation;
+    }
+
+    Selection sel;
+    if (pathCache.find(s, contexts, i18n, sel))
+        return sel;
+
+    sel = findUncachedPath(s, contexts, i18n);
+    if (!sel.empty())
+        pathCache.insert(s, contexts, i18n, sel);
+    return sel;
+}
+
+
+engine::PathCacheStats
+Universe::getPathCacheStats() const
+{
+    return pathCache.getStats();
+}
+
+
+Selection
+Universe::findUncachedPath(std::string_view s,
+                           util::array_view<const Selection> contexts,
+                           bool i18n) const
 {
     std::string_view::size_type pos = s.find('/', 0);
 
@@ -1211,7 +1408,7 @@ Universe::getNearestSolarSystem(const UniversalCoord& position) const
     Eigen::Vector3f pos = position.toLy().cast<float>();
     ClosestStarFinder closestFinder(1.0f, this);
     closestFinder.withPlanets = true;
-    starCatalog->findCloseStars(closestFinder, pos, 1.0f);
+    starCatalog->processCloseStars(closestFinder, pos, 1.0f);
     return getSolarSystem(closestFinder.closestStar);
 }
 
@@ -1223,5 +1420,5 @@ Universe::getNearStars(const UniversalCoord& position,
 {
     Eigen::Vector3f pos = position.toLy().cast<float>();
     NearStarFinder finder(maxDistance, nearStars);
-    starCatalog->findCloseStars(finder, pos, maxDistance);
+    starCatalog->processCloseStars(finder, pos, maxDistance);
 }
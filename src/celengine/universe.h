@@ -10,10 +10,12 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <celengine/boundaries.h>
@@ -23,6 +25,8 @@
 #include <celengine/solarsys.h>
 #include <celengine/deepskyobj.h>
 #include <celengine/marker.h>
+#include <celengine/pathcache.h>
+#include <celengine/renderlistentry.h>
 #include <celengine/selection.h>
 #include <celengine/asterism.h>
 #include <celutil/array_view.h>
@@ -56,6 +60,15 @@ class Universe
                    float faintestMag,
                    float tolerance = 0.0f);
 
+    // Picks among the bodies and stars in the render list of a frame drawn
+    // from the observer at the origin of the ray. This is much cheaper than
+    // pick(), but finds only the objects that were drawn; an empty
+    // selection is returned if the ray misses all of them.
+    Selection pickRendered(celestia::util::array_view<RenderListEntry> renderList,
+                           const Eigen::Vector3f& direction,
+                           double when,
+                           float tolerance = 0.0f) const;
+
 
     Selection find(std::string_view s,
                    celestia::util::array_view<const Selection> contexts,
@@ -64,6 +77,12 @@ class Universe
                        celestia::util::array_view<const Selection> contexts,
                        bool i18n = false) const;
 
+    // Resolves an ID built by Selection::id(); the selection is empty if
+    // the object is not in the catalogs.
+    Selection find(const SelectionId& id) const;
+
+    celestia::engine::PathCacheStats getPathCacheStats() const;
+
     void getCompletionPath(std::vector<std::string>& completion,
                            std::string_view s,
                            celestia::util::array_view<const Selection> contexts,
@@ -95,6 +114,10 @@ class Universe
                        celestia::util::array_view<const Selection> contexts,
                        bool withLocations = false) const;
 
+    Selection findUncachedPath(std::string_view s,
+                               celestia::util::array_view<const Selection> contexts,
+                               bool i18n) const;
+
     Selection findChildObject(const Selection& sel,
                               std::string_view name,
                               bool i18n = false) const;
@@ -128,6 +151,11 @@ class Universe
     std::unique_ptr<AsterismList> asterisms{nullptr};
     std::unique_ptr<ConstellationBoundaries> boundaries{nullptr};
 
+    mutable celestia::engine::PathCache pathCache{ };
+    mutable std::uint64_t pathCacheGeneration{ 0 };
+
     celestia::MarkerList markers{ };
+    // Position of each marked object in markers
+    std::unordered_map<Selection, std::size_t> markerIndex{ };
     std::vector<const Star*> closeStars{ };
 };
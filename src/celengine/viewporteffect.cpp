@@ -9,7 +9,9 @@
 // of the License, or (at your option) any later version.
 
 #include <array>
+#include <celrender/gl/binder.h>
 #include "viewporteffect.h"
+#include "fisheyecubemap.h"
 #include "framebuffer.h"
 #include "render.h"
 #include "shadermanager.h"
@@ -56,14 +58,19 @@ bool PassthroughViewportEffect::render(Renderer* renderer, FramebufferObject* fb
 
     prog->use();
     prog->samplerParam("tex") = 0;
-    glBindTexture(GL_TEXTURE_2D, fbo->colorTexture());
+    gl::Binder::get().bindTexture(GL_TEXTURE_2D, fbo->colorTexture());
     renderer->setPipelineState(ps);
     vo.draw();
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl::Binder::get().bindTexture(GL_TEXTURE_2D, 0);
 
     return true;
 }
 
+bool PassthroughViewportEffect::renderCubeMap(Renderer* renderer, celestia::engine::FisheyeCubeMap& cubeMap, int width, int height)
+{
+    return cubeMap.resample(*renderer, width, height);
+}
+
 void PassthroughViewportEffect::initialize()
 {
     if (initialized)
@@ -128,10 +135,35 @@ bool WarpMeshViewportEffect::render(Renderer* renderer, FramebufferObject* fbo,
     prog->use();
     prog->samplerParam("tex") = 0;
     prog->floatParam("screenRatio") = (float)height / width;
-    glBindTexture(GL_TEXTURE_2D, fbo->colorTexture());
+    gl::Binder::get().bindTexture(GL_TEXTURE_2D, fbo->colorTexture());
+    renderer->setPipelineState(ps);
+    vo.draw();
+    gl::Binder::get().bindTexture(GL_TEXTURE_2D, 0);
+
+    return true;
+}
+
+bool WarpMeshViewportEffect::renderCubeMap(Renderer* renderer, celestia::engine::FisheyeCubeMap& cubeMap, int width, int height)
+{
+    if (mesh == nullptr)
+        return false;
+
+    auto *prog = renderer->getShaderManager().getShader("warpmeshcubemap");
+    if (prog == nullptr)
+        return false;
+
+    initialize();
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    prog->use();
+    prog->samplerParam("tex") = 0;
+    prog->floatParam("screenRatio") = (float)height / width;
+    gl::Binder::get().bindTexture(GL_TEXTURE_CUBE_MAP, cubeMap.cubeTexture());
     renderer->setPipelineState(ps);
     vo.draw();
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl::Binder::get().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
     return true;
 }
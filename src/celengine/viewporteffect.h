@@ -18,6 +18,11 @@ class Renderer;
 class CelestiaGLProgram;
 class WarpMesh;
 
+namespace celestia::engine
+{
+class FisheyeCubeMap;
+}
+
 class ViewportEffect
 {
 public:
@@ -26,6 +31,10 @@ public:
     virtual bool preprocess(Renderer*, FramebufferObject*);
     virtual bool prerender(Renderer*, FramebufferObject*);
     virtual bool render(Renderer*, FramebufferObject*, int width, int height) = 0;
+    // Draws the effect straight from the faces of a fisheye cube map into
+    // the render region, which saves the pass that resamples the fisheye
+    // into the framebuffer object
+    virtual bool renderCubeMap(Renderer*, celestia::engine::FisheyeCubeMap&, int width, int height) = 0;
     virtual bool distortXY(float& x, float& y);
 
 private:
@@ -39,6 +48,7 @@ public:
     ~PassthroughViewportEffect() override = default;
 
     bool render(Renderer*, FramebufferObject*, int width, int height) override;
+    bool renderCubeMap(Renderer*, celestia::engine::FisheyeCubeMap&, int width, int height) override;
 
 private:
     celestia::gl::VertexObject vo{ celestia::util::NoCreateT{} };
@@ -57,6 +67,7 @@ public:
 
     bool prerender(Renderer*, FramebufferObject* fbo) override;
     bool render(Renderer*, FramebufferObject*, int width, int height) override;
+    bool renderCubeMap(Renderer*, celestia::engine::FisheyeCubeMap&, int width, int height) override;
     bool distortXY(float& x, float& y) override;
 
 private:
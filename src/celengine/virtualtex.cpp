@@ -10,9 +10,12 @@
 
 #include "virtualtex.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdio>
 #include <fstream>
+#include <iterator>
 #include <optional>
 #include <system_error>
 #include <utility>
@@ -22,10 +25,16 @@
 #include <celengine/parser.h>
 #include <celutil/filetype.h>
 #include <celutil/logger.h>
+#include <celutil/pendingloads.h>
+#include <celutil/threadpool.h>
 #include <celutil/tokenizer.h>
+#include <celutil/trace.h>
 
 
+using celestia::util::BeginPendingLoads;
+using celestia::util::EndPendingLoads;
 using celestia::util::GetLogger;
+using celestia::util::ThreadPool;
 using celestia::engine::Image;
 
 namespace
@@ -33,6 +42,16 @@ namespace
 
 constexpr int MaxResolutionLevels = 13;
 
+// Jobs decoding tiles for each virtual texture at once
+constexpr unsigned int MaxLoaders = 2;
+
+// Requests for tiles that haven't been asked for during this many frames
+// are dropped before they are decoded
+constexpr std::uint32_t StaleRequestFrames = 8;
+
+// Time spent creating textures from decoded tiles per usage
+constexpr std::chrono::microseconds UploadTimeBudget{ 2000 };
+
 
 constexpr bool
 isPow2(int x)
@@ -155,6 +174,26 @@ VirtualTexture::VirtualTexture(const fs::path& _tilePath,
 
     if (DetermineFileType(tileExt, true) == ContentType::DXT5NormalMap)
         setFormatOptions(Texture::DXT5NormalMap);
+
+    GetTextureResidencyManager().addTexture(this);
+}
+
+
+VirtualTexture::~VirtualTexture()
+{
+    {
+        // Loader jobs still queued on the pool return as soon as they run
+        std::unique_lock lock(loaderMutex);
+        stopLoaders = true;
+        loadersDone.wait(lock, [this] { return activeLoaders == 0; });
+    }
+
+    EndPendingLoads(tilesPending);
+
+    TextureResidencyManager& manager = GetTextureResidencyManager();
+    manager.removeTexture(this);
+    for (TileQuadtreeNode& root : tileTree)
+        evictTiles(root, manager.getFrame() + 1);
 }
 
 
@@ -176,6 +215,12 @@ VirtualTexture::getTile(int lod, int u, int v)
     Tile* tile = node->tile.get();
     unsigned int tileLOD = 0;
 
+    // Coarsest tile and finest resident tile covering the requested one
+    Tile* baseTile = tile;
+    unsigned int baseLOD = 0;
+    Tile* residentTile = tile != nullptr && tile->isResident() ? tile : nullptr;
+    unsigned int residentLOD = 0;
+
     for (int n = 0; n < lod; n++)
     {
         unsigned int mask = 1 << (lod - n - 1);
@@ -188,6 +233,16 @@ VirtualTexture::getTile(int lod, int u, int v)
         {
             tile = node->tile.get();
             tileLOD = n + 1;
+            if (baseTile == nullptr)
+            {
+                baseTile = tile;
+                baseLOD = tileLOD;
+            }
+            if (tile->isResident())
+            {
+                residentTile = tile;
+                residentLOD = tileLOD;
+            }
         }
     }
 
@@ -195,16 +250,32 @@ VirtualTexture::getTile(int lod, int u, int v)
     if (!tile)
         return TextureTile(0);
 
-    // Make the tile resident.
-    unsigned int tileU = u >> (lod - tileLOD);
-    unsigned int tileV = v >> (lod - tileLOD);
-    makeResident(tile, tileLOD, tileU, tileV);
+    // Have the tile decoded in the background.
+    tile->lastUsed = GetTextureResidencyManager().getFrame();
+    requestTile(tile, tileLOD, u >> (lod - tileLOD), v >> (lod - tileLOD));
+
+    // Until it arrives, use the best resident tile of a lower LOD. If there
+    // is none, load the coarsest tile right away rather than leave the
+    // surface blank.
+    if (!tile->isResident())
+    {
+        if (residentTile == nullptr)
+        {
+            makeResident(baseTile, baseLOD, u >> (lod - baseLOD), v >> (lod - baseLOD));
+            residentTile = baseTile;
+            residentLOD = baseLOD;
+        }
+
+        tile = residentTile;
+        tileLOD = residentLOD;
+        tile->lastUsed = GetTextureResidencyManager().getFrame();
+    }
 
     // It's possible that we failed to make the tile resident, either
     // because the texture file was bad, or there was an unresolvable
     // out of memory situation.  In that case there is nothing else to
     // do but return a texture tile with a null texture name.
-    if (!tile->tex)
+    if (!tile->isResident())
         return TextureTile(0);
 
     // Set up the texture subrect to be the entire texture
@@ -220,7 +291,14 @@ VirtualTexture::getTile(int lod, int u, int v)
     texU = (u & ((1 << lodDiff) - 1)) * texDU;
     texV = (v & ((1 << lodDiff) - 1)) * texDV;
 
-    return TextureTile(tile->tex->getName(), texU, texV, texDU, texDV);
+    if (tile->atlas == nullptr)
+        return TextureTile(tile->tex->getName(), texU, texV, texDU, texDV);
+
+    // Map the subsection into the tile's slot of the atlas
+    TextureTile slot = tile->atlas->getTile(tile->atlasSlot);
+    return TextureTile(slot.texID,
+                       slot.u + texU * slot.du, slot.v + texV * slot.dv,
+                       texDU * slot.du, texDV * slot.dv);
 }
 
 
@@ -258,6 +336,9 @@ VirtualTexture::beginUsage()
 {
     ticks++;
     tilesRequested = 0;
+
+    dropStaleRequests();
+    uploadDecodedTiles();
 }
 
 
@@ -267,9 +348,13 @@ VirtualTexture::endUsage()
 }
 
 
-std::unique_ptr<ImageTexture>
-VirtualTexture::loadTileTexture(unsigned int lod, unsigned int u, unsigned int v)
+// Safe to call from the loader threads, it only reads members that are
+// fixed at construction.
+std::unique_ptr<Image>
+VirtualTexture::loadTileImage(unsigned int lod, unsigned int u, unsigned int v) const
 {
+    celestia::util::TraceScope trace("VirtualTexture::loadTileImage");
+
     lod >>= baseSplit;
     assert(lod < (unsigned)MaxResolutionLevels);
 
@@ -280,35 +365,109 @@ VirtualTexture::loadTileTexture(unsigned int lod, unsigned int u, unsigned int v
                 fmt::format("level{:d}", lod) /
                 filename;
 
-    auto img = Image::load(path);
-    if (img == nullptr)
-        return nullptr;
+    return Image::load(path);
+}
+
 
-    std::unique_ptr<ImageTexture> tex = nullptr;
+void
+VirtualTexture::createTileTexture(Tile* tile, const Image& img, unsigned int lod)
+{
+    celestia::util::TraceScope trace("VirtualTexture::createTileTexture");
+
+    lod >>= baseSplit;
 
     // Only use mip maps for the LOD 0; for higher LODs, the function of mip
     // mapping is built into the texture.
     MipMapMode mipMapMode = lod == 0 ? DefaultMipMaps : NoMipMaps;
 
-    if (isPow2(img->getWidth()) && isPow2(img->getHeight()))
-        tex = std::make_unique<ImageTexture>(*img, EdgeClamp, mipMapMode);
+    if (isPow2(img.getWidth()) && isPow2(img.getHeight()))
+    {
+        if (mipMapMode == NoMipMaps && addToAtlas(tile, img))
+        {
+            tile->memorySize = static_cast<std::uint64_t>(img.getMipLevelSize(0));
+        }
+        else
+        {
+            tile->tex = std::make_unique<ImageTexture>(img, EdgeClamp, mipMapMode);
+
+            // Generated mip maps add a third to the base level
+            tile->memorySize = static_cast<std::uint64_t>(img.getSize());
+            if (mipMapMode == DefaultMipMaps && img.getMipLevelCount() == 1)
+                tile->memorySize += tile->memorySize / 3;
+        }
+    }
 
     // TODO: Virtual textures can have tiles in different formats, some
     // compressed and some not. The compression flag doesn't make much
     // sense for them.
-    compressed = img->isCompressed();
+    compressed = img.isCompressed();
+
+    if (tile->isResident())
+        GetTextureResidencyManager().tileLoaded(tile->memorySize);
+}
+
+
+bool
+VirtualTexture::addToAtlas(Tile* tile, const Image& img)
+{
+    if (!useAtlases)
+        return false;
+
+    auto it = std::find_if(atlases.begin(), atlases.end(),
+                           [&img](const auto& atlas) { return atlas->matches(img) && !atlas->isFull(); });
+    if (it == atlases.end())
+    {
+        auto atlas = TextureAtlas::create(img);
+        if (atlas == nullptr)
+        {
+            useAtlases = false;
+            return false;
+        }
+
+        atlases.push_back(std::move(atlas));
+        it = atlases.end() - 1;
+    }
+
+    tile->atlasSlot = (*it)->addTile(img);
+    tile->atlas = it->get();
+    return true;
+}
+
+
+void
+VirtualTexture::unloadTile(Tile* tile)
+{
+    if (TextureAtlas* atlas = tile->atlas; atlas != nullptr)
+    {
+        atlas->removeTile(tile->atlasSlot);
+        tile->atlas = nullptr;
+        tile->atlasSlot = -1;
+
+        // Keep one empty atlas around so that loading and evicting tiles
+        // doesn't keep recreating it
+        if (atlas->isEmpty() &&
+            std::count_if(atlases.begin(), atlases.end(), [](const auto& a) { return a->isEmpty(); }) > 1)
+        {
+            atlases.erase(std::find_if(atlases.begin(), atlases.end(),
+                                       [atlas](const auto& a) { return a.get() == atlas; }));
+        }
+    }
 
-    return tex;
+    tile->tex = nullptr;
+    GetTextureResidencyManager().tileUnloaded(tile->memorySize);
+    tile->memorySize = 0;
 }
 
 
 void VirtualTexture::makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v)
 {
-    if (tile->tex == nullptr && !tile->loadFailed)
+    if (!tile->isResident() && !tile->loadFailed)
     {
         // Potentially evict other tiles in order to make this one fit
-        tile->tex = loadTileTexture(lod, u, v);
-        if (tile->tex == nullptr)
+        if (auto img = loadTileImage(lod, u, v); img != nullptr)
+            createTileTexture(tile, *img, lod);
+
+        if (!tile->isResident())
         {
             tile->loadFailed = true;
         }
@@ -316,6 +475,246 @@ void VirtualTexture::makeResident(Tile* tile, unsigned int lod, unsigned int u,
 }
 
 
+void
+VirtualTexture::prefetchTile(int lod, int u, int v)
+{
+    lod += baseSplit;
+
+    if (lod < 0 || (unsigned int) lod >= nResolutionLevels ||
+        u < 0 || u >= (2 << lod) ||
+        v < 0 || v >= (1 << lod))
+    {
+        return;
+    }
+
+    // Find the finest tile covering the requested one, as getTile() does
+    const TileQuadtreeNode* node = &tileTree[u >> lod];
+    Tile* tile = node->tile.get();
+    unsigned int tileLOD = 0;
+
+    for (int n = 0; n < lod; n++)
+    {
+        unsigned int mask = 1 << (lod - n - 1);
+        unsigned int child = (((v & mask) << 1) | (u & mask)) >> (lod - n - 1);
+        if (!node->children[child])
+            break;
+
+        node = node->children[child].get();
+        if (node->tile != nullptr)
+        {
+            tile = node->tile.get();
+            tileLOD = n + 1;
+        }
+    }
+
+    if (tile == nullptr)
+        return;
+
+    // Keeps the request from being dropped as stale while it is predicted
+    tile->lastUsed = GetTextureResidencyManager().getFrame();
+    requestTile(tile, tileLOD, u >> (lod - tileLOD), v >> (lod - tileLOD), true);
+}
+
+
+void
+VirtualTexture::requestTile(Tile* tile, unsigned int lod, unsigned int u, unsigned int v, bool prefetch)
+{
+    if (tile->isResident() || tile->loadFailed)
+        return;
+
+    if (tile->loadPending)
+    {
+        // A prefetched tile that is now needed for drawing moves to the
+        // front of the line, unless a loader has picked it up already
+        if (!prefetch && tile->prefetched)
+        {
+            tile->prefetched = false;
+            std::scoped_lock lock(loaderMutex);
+            auto it = std::find_if(pendingRequests.begin(), pendingRequests.end(),
+                                   [tile](const TileRequest& request) { return request.tile == tile; });
+            if (it != pendingRequests.end())
+            {
+                TileRequest request = *it;
+                pendingRequests.erase(it);
+                pendingRequests.push_back(request);
+            }
+        }
+        return;
+    }
+
+    tile->loadPending = true;
+    tile->prefetched = prefetch;
+    BeginPendingLoads();
+    ++tilesPending;
+
+    bool startLoader;
+    {
+        std::scoped_lock lock(loaderMutex);
+        // Loaders take requests from the back of the queue
+        if (prefetch)
+            pendingRequests.push_front({ tile, lod, u, v });
+        else
+            pendingRequests.push_back({ tile, lod, u, v });
+
+        // Running loaders take the request otherwise
+        unsigned int workers = ThreadPool::shared().concurrency() - 1;
+        startLoader = activeLoaders < std::clamp(workers, 1U, MaxLoaders);
+        if (startLoader)
+            ++activeLoaders;
+    }
+
+    if (startLoader)
+        ThreadPool::shared().submit([this] { loaderMain(); });
+}
+
+
+void
+VirtualTexture::dropStaleRequests()
+{
+    std::uint32_t frame = GetTextureResidencyManager().getFrame();
+    std::scoped_lock lock(loaderMutex);
+    auto it = std::remove_if(pendingRequests.begin(), pendingRequests.end(),
+                             [frame](const TileRequest& request)
+                             {
+                                 if (frame - request.tile->lastUsed <= StaleRequestFrames)
+                                     return false;
+                                 request.tile->loadPending = false;
+                                 return true;
+                             });
+    auto dropped = static_cast<unsigned int>(pendingRequests.end() - it);
+    pendingRequests.erase(it, pendingRequests.end());
+    EndPendingLoads(dropped);
+    tilesPending -= dropped;
+}
+
+
+void
+VirtualTexture::uploadDecodedTiles()
+{
+    std::vector<DecodedTile> decoded;
+    {
+        std::scoped_lock lock(loaderMutex);
+        if (decodedTiles.empty())
+            return;
+        decoded.swap(decodedTiles);
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + UploadTimeBudget;
+    auto it = decoded.begin();
+    for (; it != decoded.end(); ++it)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            break;
+
+        Tile* tile = it->tile;
+        tile->loadPending = false;
+        EndPendingLoads();
+        --tilesPending;
+
+        // The tile may have been loaded synchronously in the meantime
+        if (tile->isResident())
+            continue;
+
+        if (it->image != nullptr)
+            createTileTexture(tile, *it->image, it->lod);
+        tile->loadFailed = !tile->isResident();
+    }
+
+    if (it == decoded.end())
+        return;
+
+    // Leave the rest for the next usage
+    std::scoped_lock lock(loaderMutex);
+    decodedTiles.insert(decodedTiles.begin(),
+                        std::make_move_iterator(it),
+                        std::make_move_iterator(decoded.end()));
+}
+
+
+// Decodes the pending requests until there are none left
+void
+VirtualTexture::loaderMain()
+{
+    std::unique_lock lock(loaderMutex);
+    while (!stopLoaders && !pendingRequests.empty())
+    {
+        // The most recent requests are for the tiles closest to what is
+        // on screen now
+        TileRequest request = pendingRequests.back();
+        pendingRequests.pop_back();
+
+        lock.unlock();
+        auto img = loadTileImage(request.lod, request.u, request.v);
+        lock.lock();
+
+        decodedTiles.push_back({ request.tile, request.lod, std::move(img) });
+    }
+
+    if (--activeLoaders == 0)
+        loadersDone.notify_all();
+}
+
+
+void
+VirtualTexture::getEvictableTiles(std::vector<TextureResidencyManager::ResidentTile>& tiles,
+                                  std::uint32_t usedBefore) const
+{
+    // The roots hold the coarsest tiles, which are kept
+    for (const TileQuadtreeNode& root : tileTree)
+    {
+        for (const auto& child : root.children)
+        {
+            if (child != nullptr)
+                getEvictableTiles(*child, tiles, usedBefore);
+        }
+    }
+}
+
+
+void
+VirtualTexture::getEvictableTiles(const TileQuadtreeNode& node,
+                                  std::vector<TextureResidencyManager::ResidentTile>& tiles,
+                                  std::uint32_t usedBefore)
+{
+    if (const Tile* tile = node.tile.get(); tile != nullptr && tile->isResident() && tile->lastUsed < usedBefore)
+        tiles.push_back({ tile->lastUsed, tile->memorySize });
+
+    for (const auto& child : node.children)
+    {
+        if (child != nullptr)
+            getEvictableTiles(*child, tiles, usedBefore);
+    }
+}
+
+
+void
+VirtualTexture::evictTiles(std::uint32_t usedBefore)
+{
+    for (TileQuadtreeNode& root : tileTree)
+    {
+        for (auto& child : root.children)
+        {
+            if (child != nullptr)
+                evictTiles(*child, usedBefore);
+        }
+    }
+}
+
+
+void
+VirtualTexture::evictTiles(TileQuadtreeNode& node, std::uint32_t usedBefore)
+{
+    if (Tile* tile = node.tile.get(); tile != nullptr && tile->isResident() && tile->lastUsed < usedBefore)
+        unloadTile(tile);
+
+    for (auto& child : node.children)
+    {
+        if (child != nullptr)
+            evictTiles(*child, usedBefore);
+    }
+}
+
+
 void VirtualTexture::populateTileTree()
 {
     // Count the number of resolution levels present
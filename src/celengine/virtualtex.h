@@ -10,11 +10,17 @@
 #pragma once
 
 #include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <celcompat/filesystem.h>
 #include <celengine/texture.h>
+#include <celengine/textureresidency.h>
 
 
 class VirtualTexture : public Texture
@@ -25,7 +31,7 @@ public:
                    unsigned int _tileSize,
                    const std::string& _tilePrefix,
                    const std::string& _tileType);
-    ~VirtualTexture() = default;
+    ~VirtualTexture();
 
     TextureTile getTile(int lod, int u, int v) override;
     void bind() override;
@@ -35,14 +41,35 @@ public:
     int getVTileCount(int lod) const override;
     void beginUsage() override;
     void endUsage() override;
+    void prefetchTile(int lod, int u, int v) override;
+
+    // Appends the resident tiles last used before the given frame, except
+    // the coarsest ones
+    void getEvictableTiles(std::vector<TextureResidencyManager::ResidentTile>& tiles,
+                           std::uint32_t usedBefore) const;
+    // Evicts all tiles returned by getEvictableTiles()
+    void evictTiles(std::uint32_t usedBefore);
 
 private:
     struct Tile
     {
         Tile() = default;
-        unsigned int lastUsed{ 0 };
+        // Frame number of the residency manager
+        std::uint32_t lastUsed{ 0 };
+        // Tiles without mip maps live in a slot of an atlas shared with
+        // other tiles, others have a texture of their own
         std::unique_ptr<ImageTexture> tex{ nullptr };
+        TextureAtlas* atlas{ nullptr };
+        int atlasSlot{ -1 };
+        // Estimated memory used by the texture
+        std::uint64_t memorySize{ 0 };
         bool loadFailed{ false };
+        // Queued for or being decoded by a loader thread
+        bool loadPending{ false };
+        // Queued at low priority by prefetchTile()
+        bool prefetched{ false };
+
+        bool isResident() const { return tex != nullptr || atlas != nullptr; }
     };
 
     struct TileQuadtreeNode
@@ -55,7 +82,19 @@ private:
     void populateTileTree();
     void addTileToTree(std::unique_ptr<Tile> tile, unsigned int lod, unsigned int u, unsigned int v);
     void makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v);
-    std::unique_ptr<ImageTexture> loadTileTexture(unsigned int lod, unsigned int u, unsigned int v);
+    // Prefetched tiles are decoded after all tiles requested for drawing
+    void requestTile(Tile* tile, unsigned int lod, unsigned int u, unsigned int v, bool prefetch = false);
+    void dropStaleRequests();
+    void uploadDecodedTiles();
+    std::unique_ptr<celestia::engine::Image> loadTileImage(unsigned int lod, unsigned int u, unsigned int v) const;
+    void createTileTexture(Tile* tile, const celestia::engine::Image& img, unsigned int lod);
+    static void getEvictableTiles(const TileQuadtreeNode& node,
+                                  std::vector<TextureResidencyManager::ResidentTile>& tiles,
+                                  std::uint32_t usedBefore);
+    void evictTiles(TileQuadtreeNode& node, std::uint32_t usedBefore);
+    bool addToAtlas(Tile* tile, const celestia::engine::Image& img);
+    void unloadTile(Tile* tile);
+    void loaderMain();
 
 private:
     fs::path tilePath;
@@ -64,6 +103,8 @@ private:
     unsigned int baseSplit{ 0 };
     unsigned int ticks{ 0 };
     unsigned int tilesRequested{ 0 };
+    // Tiles with loadPending set, reported to EndPendingLoads() once done
+    unsigned int tilesPending{ 0 };
     unsigned int nResolutionLevels{ 0 };
 
     enum
@@ -73,6 +114,37 @@ private:
     };
 
     std::array<TileQuadtreeNode, 2> tileTree{};
+
+    std::vector<std::unique_ptr<TextureAtlas>> atlases;
+    // Cleared when an atlas can't be made for the tiles of this texture
+    bool useAtlases{ true };
+
+    // Tiles are decoded by loader jobs on the shared thread pool and turned
+    // into textures on the render thread. Tile objects are only touched by
+    // the render thread; the loaders just pass the pointers along.
+    struct TileRequest
+    {
+        Tile* tile;
+        unsigned int lod;
+        unsigned int u;
+        unsigned int v;
+    };
+
+    struct DecodedTile
+    {
+        Tile* tile;
+        unsigned int lod;
+        std::unique_ptr<celestia::engine::Image> image;
+    };
+
+    // Guards the request and result queues, activeLoaders and stopLoaders
+    std::mutex loaderMutex;
+    std::condition_variable loadersDone;
+    std::deque<TileRequest> pendingRequests;
+    std::vector<DecodedTile> decodedTiles;
+    // Loader jobs queued or running on the shared pool
+    unsigned int activeLoaders{ 0 };
+    bool stopLoaders{ false };
 };
 
 
@@ -0,0 +1,92 @@
+// chebyshev.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Fitting and evaluation of Chebyshev series.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+#include <Eigen/Core>
+
+#include <celcompat/numbers.h>
+
+namespace celestia::ephem
+{
+
+//! Coefficients of a Chebyshev series of degree N - 1 with values in R^Dim
+template<int Dim, std::size_t N>
+using ChebyshevSeries = std::array<Eigen::Matrix<double, Dim, 1>, N>;
+
+//! Evaluate a Chebyshev series at x in [-1, 1] using Clenshaw's recurrence
+template<int Dim, std::size_t N>
+Eigen::Matrix<double, Dim, 1>
+EvaluateChebyshev(const ChebyshevSeries<Dim, N>& coeffs, double x)
+{
+    using Vector = Eigen::Matrix<double, Dim, 1>;
+    Vector b1 = Vector::Zero();
+    Vector b2 = Vector::Zero();
+    for (std::size_t i = N - 1; i > 0; --i)
+    {
+        Vector b0 = 2.0 * x * b1 - b2 + coeffs[i];
+        b2 = b1;
+        b1 = b0;
+    }
+
+    return coeffs[0] + x * b1 - b2;
+}
+
+/*! Fit a Chebyshev series to func(x) on [-1, 1] by interpolating it at the
+ *  N Chebyshev nodes.
+ */
+template<int Dim, std::size_t N, typename F>
+void
+FitChebyshev(ChebyshevSeries<Dim, N>& coeffs, F&& func)
+{
+    using Vector = Eigen::Matrix<double, Dim, 1>;
+    constexpr auto n = static_cast<double>(N);
+
+    std::array<Vector, N> values;
+    for (std::size_t k = 0; k < N; ++k)
+        values[k] = func(std::cos(celestia::numbers::pi * (static_cast<double>(k) + 0.5) / n));
+
+    for (std::size_t j = 0; j < N; ++j)
+    {
+        Vector c = Vector::Zero();
+        for (std::size_t k = 0; k < N; ++k)
+            c += values[k] * std::cos(celestia::numbers::pi * static_cast<double>(j) * (static_cast<double>(k) + 0.5) / n);
+        coeffs[j] = c * (2.0 / n);
+    }
+    coeffs[0] *= 0.5;
+}
+
+/*! Return the largest distance between a fitted series and func at every
+ *  other extremum of the first neglected polynomial, which include both
+ *  ends of the interval, shared with neighbouring fits.
+ */
+template<int Dim, std::size_t N, typename F>
+double
+ChebyshevFitError(const ChebyshevSeries<Dim, N>& coeffs, F&& func)
+{
+    constexpr auto n = static_cast<double>(N);
+
+    double error = 0.0;
+    for (std::size_t k = 0; k <= N; k += 2)
+    {
+        double x = std::cos(celestia::numbers::pi * static_cast<double>(k) / n);
+        error = std::max(error, (EvaluateChebyshev(coeffs, x) - func(x)).norm());
+    }
+
+    return error;
+}
+
+} // end namespace celestia::ephem
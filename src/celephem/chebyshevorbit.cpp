@@ -0,0 +1,193 @@
+// chebyshevorbit.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Piecewise Chebyshev approximation of expensive orbits.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "chebyshevorbit.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include "chebyshev.h"
+
+namespace celestia::ephem
+{
+
+namespace
+{
+
+// Segments per period before any subdivision
+constexpr double SegmentsPerPeriod = 16.0;
+
+// Give up halving segments after this many levels and keep the last fit
+constexpr int MaxLevel = 8;
+
+} // end unnamed namespace
+
+ChebyshevOrbit::ChebyshevOrbit(const std::shared_ptr<const Orbit>& _orbit, double _tolerance) :
+    orbit(_orbit),
+    tolerance(_tolerance),
+    baseLength(1.0),
+    lastMissTime(-1.0e30)
+{
+    assert(orbit != nullptr);
+    if (double period = orbit->getPeriod(); period > 0.0)
+        baseLength = period / SegmentsPerPeriod;
+    lastLength = baseLength;
+}
+
+
+Eigen::Vector3d ChebyshevOrbit::positionAtTime(double jd) const
+{
+    if (std::unique_lock<std::mutex> lock(segmentMutex, std::try_to_lock); lock.owns_lock())
+    {
+        if (const Segment* segment = getSegment(jd); segment != nullptr)
+            return EvaluateChebyshev(segment->position, (jd - segment->center) / segment->halfLength);
+    }
+
+    return orbit->positionAtTime(jd);
+}
+
+
+Eigen::Vector3d ChebyshevOrbit::velocityAtTime(double jd) const
+{
+    if (std::unique_lock<std::mutex> lock(segmentMutex, std::try_to_lock); lock.owns_lock())
+    {
+        if (const Segment* segment = getSegment(jd); segment != nullptr)
+            return EvaluateChebyshev(segment->velocity, (jd - segment->center) / segment->halfLength);
+    }
+
+    return orbit->velocityAtTime(jd);
+}
+
+
+double ChebyshevOrbit::getPeriod() const
+{
+    return orbit->getPeriod();
+}
+
+
+double ChebyshevOrbit::getBoundingRadius() const
+{
+    return orbit->getBoundingRadius();
+}
+
+
+void ChebyshevOrbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
+{
+    // Sampling a whole orbit would only flush the segments in use
+    orbit->sample(startTime, endTime, proc);
+}
+
+
+bool ChebyshevOrbit::isPeriodic() const
+{
+    return orbit->isPeriodic();
+}
+
+
+void ChebyshevOrbit::getValidRange(double& begin, double& end) const
+{
+    orbit->getValidRange(begin, end);
+}
+
+
+bool ChebyshevOrbit::isThreadSafe() const
+{
+    return orbit->isThreadSafe();
+}
+
+
+/*! Return the segment to evaluate at the specified time, fitting a new one
+ *  if needed, or nullptr if the orbit should be evaluated directly.
+ */
+const ChebyshevOrbit::Segment* ChebyshevOrbit::getSegment(double jd) const
+{
+    for (int i = 0; i < CacheSize; ++i)
+    {
+        int index = (lastSegment + i) % CacheSize;
+        const Segment& segment = segments[index];
+        if (std::abs(jd - segment.center) <= segment.halfLength)
+        {
+            lastSegment = index;
+            return &segment;
+        }
+    }
+
+    // A fit costs about 25 evaluations, only worth it if more requests
+    // are likely to follow in the same segment
+    bool isolated = std::abs(jd - lastMissTime) > lastLength;
+    lastMissTime = jd;
+    if (isolated)
+        return nullptr;
+
+    // Segments usually need the same subdivision as the last one; try one
+    // level coarser so that they can grow back where the orbit allows it.
+    // Stop halving once the error no longer drops, which means it is noise
+    // or a discontinuity in the orbit rather than the fit.
+    Segment& segment = segments[nextSegment];
+    double length = std::min(baseLength, lastLength * 2.0);
+    double lastError = std::numeric_limits<double>::infinity();
+    for (int level = 0;; ++level)
+    {
+        fitSegment(segment, std::floor(jd / length) * length, length);
+        double error = fitError(segment);
+        if (level == MaxLevel || error <= tolerance || error > 0.5 * lastError)
+            break;
+        lastError = error;
+        length *= 0.5;
+    }
+
+    lastLength = length;
+    lastSegment = nextSegment;
+    nextSegment = (nextSegment + 1) % CacheSize;
+    return &segment;
+}
+
+
+void ChebyshevOrbit::fitSegment(Segment& segment, double begin, double length) const
+{
+    segment.halfLength = 0.5 * length;
+    segment.center = begin + segment.halfLength;
+
+    FitChebyshev(segment.position, [this, &segment](double x)
+    {
+        return orbit->positionAtTime(segment.center + segment.halfLength * x);
+    });
+
+    // Differentiate the series, scaling from x to days
+    Eigen::Vector3d d1 = Eigen::Vector3d::Zero();
+    Eigen::Vector3d d2 = Eigen::Vector3d::Zero();
+    for (int j = Degree; j > 0; --j)
+    {
+        Eigen::Vector3d d0 = d2 + (2.0 * j) * segment.position[j];
+        segment.velocity[j - 1] = d0 / segment.halfLength;
+        d2 = d1;
+        d1 = d0;
+    }
+    segment.velocity[0] *= 0.5;
+}
+
+
+/*! Return the largest distance between the fit and the orbit at the
+ *  extrema of the first neglected polynomial, which include the ends
+ *  shared with neighbouring segments.
+ */
+double ChebyshevOrbit::fitError(const Segment& segment) const
+{
+    return ChebyshevFitError(segment.position, [this, &segment](double x)
+    {
+        return orbit->positionAtTime(segment.center + segment.halfLength * x);
+    });
+}
+
+} // end namespace celestia::ephem
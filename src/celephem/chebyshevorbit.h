@@ -0,0 +1,81 @@
+// chebyshevorbit.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Piecewise Chebyshev approximation of expensive orbits.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>
+
+#include <Eigen/Core>
+
+#include "orbit.h"
+
+namespace celestia::ephem
+{
+
+/*! Approximates another orbit by Chebyshev polynomials fitted on demand.
+ *  Time is divided into segments of 1/16 of the period; when a position is
+ *  requested near the previous request, the segment containing it is fitted
+ *  and kept, so that further positions and velocities in that segment only
+ *  cost a polynomial evaluation. Segments that don't reproduce the orbit
+ *  within the tolerance are halved until they do.
+ *
+ *  Times far apart from each other, as with a fast time rate, would need a
+ *  new fit every time, so isolated requests are passed on to the orbit, as
+ *  are requests from other threads while the segments are in use.
+ */
+class ChebyshevOrbit final : public Orbit
+{
+public:
+    //! tolerance is the largest position error accepted, in kilometers
+    ChebyshevOrbit(const std::shared_ptr<const Orbit>& orbit, double tolerance);
+    ~ChebyshevOrbit() override = default;
+
+    Eigen::Vector3d positionAtTime(double jd) const override;
+    Eigen::Vector3d velocityAtTime(double jd) const override;
+    double getPeriod() const override;
+    double getBoundingRadius() const override;
+    void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+    bool isPeriodic() const override;
+    void getValidRange(double& begin, double& end) const override;
+    bool isThreadSafe() const override;
+
+    static constexpr int Degree = 15;
+
+private:
+    static constexpr int CacheSize = 4;
+
+    struct Segment
+    {
+        double center{ 0.0 };
+        double halfLength{ 0.0 };
+        std::array<Eigen::Vector3d, Degree + 1> position;
+        std::array<Eigen::Vector3d, Degree> velocity;
+    };
+
+    const Segment* getSegment(double jd) const;
+    void fitSegment(Segment& segment, double begin, double length) const;
+    double fitError(const Segment& segment) const;
+
+    std::shared_ptr<const Orbit> orbit;
+    double tolerance;
+    double baseLength;
+
+    mutable std::mutex segmentMutex;
+    mutable std::array<Segment, CacheSize> segments{};
+    mutable int lastSegment{ 0 };
+    mutable int nextSegment{ 0 };
+    mutable double lastMissTime;
+    mutable double lastLength;
+};
+
+} // end namespace celestia::ephem
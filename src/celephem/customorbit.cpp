@@ -14,7 +14,6 @@
 #include <cstddef>
 #include <cstring>
 #include <cmath>
-#include <fstream>
 #include <map>
 #include <memory>
 #include <utility>
@@ -25,6 +24,7 @@
 #include <celmath/mathlib.h>
 #include <celmath/geomutil.h>
 #include <celutil/logger.h>
+#include "chebyshevorbit.h"
 #include "jpleph.h"
 #include "orbit.h"
 #include "vsop87.h"
@@ -57,6 +57,19 @@ constexpr double SaturnRadius = 60330.0;
 // the apocenter distance computed from the mean elements.
 constexpr double BoundingRadiusSlack = 1.2;
 
+// Position error allowed when fitting Chebyshev polynomials to the series.
+// It is far below the accuracy of the series, so fitted orbits only differ
+// from them by imperceptible steps where segments meet.
+constexpr double FitTolerance = 0.01; // km
+
+// Wrap a series orbit so that repeated evaluations reuse a Chebyshev fit
+template<typename T, typename... Args>
+std::shared_ptr<const Orbit>
+CreateFittedOrbit(Args&&... args)
+{
+    return std::make_shared<ChebyshevOrbit>(std::make_shared<T>(std::forward<Args>(args)...), FitTolerance);
+}
+
 using PlanetElements = std::array<double, 9>;
 using StaticElements = std::array<double, 23>;
 
@@ -311,18 +324,25 @@ EclipticToEquatorial(double fEclLat, double fEclLon,
     // Parameter t represents the Julian centuries elapsed since 1900.
     // In other words, t = (jd - 2415020.0) / 36525.0
 
-    double seps, ceps;    // sin and cos of mean obliquity
     double sx, cx, sy, cy, ty;
-    double eps;
-    double deps, dpsi;
-    double t;
 
-//    t = (astro::J2000 - 2415020.0) / 36525.0;
-    t = 0;
-    eps = Obliquity(t);        // mean obliquity for date
-    Nutation(t, deps, dpsi);
-    eps += deps;
-    math::sincos(eps, seps, ceps);
+    // The date is fixed, so the obliquity and nutation series are only
+    // evaluated once
+    static const std::array<double, 2> sinCosEps = []
+    {
+//        double t = (astro::J2000 - 2415020.0) / 36525.0;
+        double t = 0;
+        double eps = Obliquity(t);        // mean obliquity for date
+        double deps, dpsi;
+        Nutation(t, deps, dpsi);
+        eps += deps;
+
+        std::array<double, 2> result;
+        math::sincos(eps, result[0], result[1]);
+        return result;
+    }();
+    double seps = sinCosEps[0];    // sin and cos of mean obliquity
+    double ceps = sinCosEps[1];
 
     math::sincos(fEclLat, sy, cy /* always non-negative*/);
     if (std::fabs(cy)<1e-20)
@@ -2699,13 +2719,13 @@ CreateUranianSatelliteOrbit(int n)
     assert(n >= 1 && n <= 5);
     --n;
 
-    return std::make_shared<UranianSatelliteOrbit>(uran_a[n], uran_n[n],
-                                                   uran_L0[n], uran_L1[n],
-                                                   uran_L_k[n], uran_L_theta[n],
-                                                   uran_L_phi[n], uran_z_k[n],
-                                                   uran_z_theta[n], uran_z_phi[n],
-                                                   uran_zeta_k[n], uran_zeta_theta[n],
-                                                   uran_zeta_phi[n]);
+    return CreateFittedOrbit<UranianSatelliteOrbit>(uran_a[n], uran_n[n],
+                                                    uran_L0[n], uran_L1[n],
+                                                    uran_L_k[n], uran_L_theta[n],
+                                                    uran_L_phi[n], uran_z_k[n],
+                                                    uran_z_theta[n], uran_z_phi[n],
+                                                    uran_zeta_k[n], uran_zeta_theta[n],
+                                                    uran_zeta_phi[n]);
 }
 
 /*! Orbit of Triton, from Seidelmann, _Explanatory Supplement to the
@@ -3102,9 +3122,7 @@ CreateJPLEphOrbit(JPLEphemItem target,
     if (!jplephInitialized)
     {
         jplephInitialized = true;
-        std::ifstream in("data/jpleph.dat", std::ios::in | std::ios::binary);
-        if (in.good())
-            jpleph = JPLEphemeris::load(in);
+        jpleph = JPLEphemeris::load(fs::path("data/jpleph.dat"));
         if (jpleph != nullptr)
         {
             if (unsigned int deNumber = jpleph->getDENumber(); deNumber != 100)
@@ -3211,61 +3229,61 @@ enum class CustomOrbitType
 std::shared_ptr<const Orbit>
 CreateMercuryOrbit()
 {
-    return std::make_shared<MixedOrbit>(std::make_shared<MercuryOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_shared<MixedOrbit>(CreateFittedOrbit<MercuryOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 std::shared_ptr<const Orbit>
 CreateVenusOrbit()
 {
-    return std::make_shared<MixedOrbit>(std::make_shared<VenusOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_shared<MixedOrbit>(CreateFittedOrbit<VenusOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 std::shared_ptr<const Orbit>
 CreateEarthOrbit()
 {
-    return std::make_shared<MixedOrbit>(std::make_shared<EarthOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_shared<MixedOrbit>(CreateFittedOrbit<EarthOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 std::shared_ptr<const Orbit>
 CreateMoonOrbit()
 {
-    return std::make_shared<MixedOrbit>(std::make_shared<LunarOrbit>(), yearToJD(-2000), yearToJD(4000), astro::EarthMass + astro::LunarMass);
+    return std::make_shared<MixedOrbit>(CreateFittedOrbit<LunarOrbit>(), yearToJD(-2000), yearToJD(4000), astro::EarthMass + astro::LunarMass);
 }
 
 std::shared_ptr<const Orbit>
 CreateMarsOrbit()
 {
-    return std::make_shared<MixedOrbit>(std::make_shared<MarsOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_shared<MixedOrbit>(CreateFittedOrbit<MarsOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 std::shared_ptr<const Orbit>
 CreateJupiterOrbit()
 {
-    return std::make_shared<MixedOrbit>(std::make_shared<JupiterOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_shared<MixedOrbit>(CreateFittedOrbit<JupiterOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 std::shared_ptr<const Orbit>
 CreateSaturnOrbit()
 {
-    return std::make_shared<MixedOrbit>(std::make_shared<SaturnOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_shared<MixedOrbit>(CreateFittedOrbit<SaturnOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 std::shared_ptr<const Orbit>
 CreateUranusOrbit()
 {
-    return std::make_shared<MixedOrbit>(std::make_shared<UranusOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_shared<MixedOrbit>(CreateFittedOrbit<UranusOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 std::shared_ptr<const Orbit>
 CreateNeptuneOrbit()
 {
-    return std::make_shared<MixedOrbit>(std::make_shared<NeptuneOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_shared<MixedOrbit>(CreateFittedOrbit<NeptuneOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 std::shared_ptr<const Orbit>
 CreatePlutoOrbit()
 {
-    return std::make_shared<MixedOrbit>(std::make_shared<PlutoOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_shared<MixedOrbit>(CreateFittedOrbit<PlutoOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 // JPL ephemerides for planets (relative to the Sun)
@@ -3429,110 +3447,110 @@ CreateJplSunSsbOrbit()
 std::shared_ptr<const Orbit>
 CreateHeleneOrbit()
 {
-    return std::make_shared<HTC20Orbit>(24, HeleneTerms.data(), HeleneAmps.data(), HeleneAngles, 2.736915, 380000);
+    return CreateFittedOrbit<HTC20Orbit>(24, HeleneTerms.data(), HeleneAmps.data(), HeleneAngles, 2.736915, 380000);
 }
 
 std::shared_ptr<const Orbit>
 CreateTelestoOrbit()
 {
-    return std::make_shared<HTC20Orbit>(12, TelestoTerms.data(), TelestoAmps.data(), TelestoAngles, 1.887802, 300000);
+    return CreateFittedOrbit<HTC20Orbit>(12, TelestoTerms.data(), TelestoAmps.data(), TelestoAngles, 1.887802, 300000);
 }
 
 std::shared_ptr<const Orbit>
 CreateCalypsoOrbit()
 {
-    return std::make_shared<HTC20Orbit>(24, CalypsoTerms.data(), CalypsoAmps.data(), CalypsoAngles, 1.887803, 300000);
+    return CreateFittedOrbit<HTC20Orbit>(24, CalypsoTerms.data(), CalypsoAmps.data(), CalypsoAngles, 1.887803, 300000);
 }
 
 // various planetary satellite orbits
 std::shared_ptr<const Orbit>
 CreatePhobosOrbit()
 {
-    return std::make_shared<PhobosOrbit>();
+    return CreateFittedOrbit<PhobosOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateDeimosOrbit()
 {
-    return std::make_shared<DeimosOrbit>();
+    return CreateFittedOrbit<DeimosOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateIoOrbit()
 {
-    return std::make_shared<IoOrbit>();
+    return CreateFittedOrbit<IoOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateEuropaOrbit()
 {
-    return std::make_shared<EuropaOrbit>();
+    return CreateFittedOrbit<EuropaOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateGanymedeOrbit()
 {
-    return std::make_shared<GanymedeOrbit>();
+    return CreateFittedOrbit<GanymedeOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateCallistoOrbit()
 {
-    return std::make_shared<CallistoOrbit>();
+    return CreateFittedOrbit<CallistoOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateMimasOrbit()
 {
-    return std::make_shared<MimasOrbit>();
+    return CreateFittedOrbit<MimasOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateEnceladusOrbit()
 {
-    return std::make_shared<EnceladusOrbit>();
+    return CreateFittedOrbit<EnceladusOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateTethysOrbit()
 {
-    return std::make_shared<TethysOrbit>();
+    return CreateFittedOrbit<TethysOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateDioneOrbit()
 {
-    return std::make_shared<DioneOrbit>();
+    return CreateFittedOrbit<DioneOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateRheaOrbit()
 {
-    return std::make_shared<RheaOrbit>();
+    return CreateFittedOrbit<RheaOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateTitanOrbit()
 {
-    return std::make_shared<TitanOrbit>();
+    return CreateFittedOrbit<TitanOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateHyperionOrbit()
 {
-    return std::make_shared<HyperionOrbit>();
+    return CreateFittedOrbit<HyperionOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreateIapetusOrbit()
 {
-    return std::make_shared<IapetusOrbit>();
+    return CreateFittedOrbit<IapetusOrbit>();
 }
 
 std::shared_ptr<const Orbit>
 CreatePhoebeOrbit()
 {
-    return std::make_shared<PhoebeOrbit>();
+    return CreateFittedOrbit<PhoebeOrbit>();
 }
 
 std::shared_ptr<const Orbit>
@@ -3568,7 +3586,7 @@ CreateOberonOrbit()
 std::shared_ptr<const Orbit>
 CreateTritonOrbit()
 {
-    return std::make_shared<TritonOrbit>();
+    return CreateFittedOrbit<TritonOrbit>();
 }
 
 using CustomOrbitFactory = std::shared_ptr<const Orbit> (*)();
@@ -12,6 +12,7 @@
 
 #include "customrotation.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstring>
@@ -24,6 +25,7 @@
 #include <celastro/date.h>
 #include <celmath/geomutil.h>
 #include <celmath/mathlib.h>
+#include "chebyshev.h"
 #include "precession.h"
 #include "rotation.h"
 
@@ -52,6 +54,15 @@ constexpr double IAU_SECULAR_TERM_VALID_CENTURIES = 50.0;
 // that range, the polynomial terms produce absurd results.
 constexpr double P03LP_VALID_CENTURIES = 5000.0;
 
+// Batched evaluation of IAU rotation models fits the angles for up to 128
+// times with Chebyshev polynomials of degree 15, accepting fits within 1e-6
+// degrees, i.e. a few centimeters on the surface of the larger moons. A fit
+// evaluates the series 25 times, so shorter runs are evaluated directly.
+constexpr std::size_t IAU_FIT_NODE_COUNT = 16;
+constexpr double IAU_FIT_TOLERANCE = 1.0e-6;
+constexpr std::size_t IAU_FIT_BATCH_SIZE = 128;
+constexpr std::size_t IAU_MIN_FIT_COUNT = 32;
+
 /*! Base class for IAU rotation models. All IAU rotation models are in the
  *  J2000.0 Earth equatorial frame.
  */
@@ -73,10 +84,7 @@ public:
         // Time argument of IAU rotation models is actually day since J2000.0 TT, but
         // Celestia uses TDB. The difference should be so minute as to be irrelevant.
         t = t - astro::J2000;
-        if (flipped)
-            return math::YRotation( math::degToRad(180.0 + meridian(t)));
-        else
-            return math::YRotation(-math::degToRad(180.0 + meridian(t)));
+        return spinAt(meridian(t));
     }
 
     Eigen::Quaterniond computeEquatorOrientation(double t) const override
@@ -86,16 +94,19 @@ public:
 
         t = t - astro::J2000;
         pole(t, poleRA, poleDec);
-        double node = poleRA + 90.0;
-        double inclination = 90.0 - poleDec;
+        return equatorAt(poleRA, poleDec);
+    }
 
-        if (flipped)
-            return math::XRot180<double> *
-                   math::XRotation(math::degToRad(-inclination)) *
-                   math::YRotation(math::degToRad(-node));
-        else
-            return math::XRotation(math::degToRad(-inclination)) *
-                   math::YRotation(math::degToRad(-node));
+    /*! The series of most models have many periodic terms, so the pole and
+     *  meridian angles are fitted with Chebyshev polynomials over the
+     *  times, which then only need the series evaluated at the nodes.
+     *  Batches where the fit isn't accurate enough, as with steps close to
+     *  the periods of the terms, are evaluated directly.
+     */
+    void orientationsAtTimes(double startTime, double step,
+                             Eigen::Quaterniond* orientations, std::size_t count) const override
+    {
+        fitOrientations(startTime - astro::J2000, step, orientations, count);
     }
 
     // Return the RA and declination (in degrees) of the rotation axis
@@ -104,6 +115,14 @@ public:
     virtual double meridian(double t) const = 0;
 
 protected:
+    // Evaluate the orientations at d0 + i * step days from J2000 directly
+    void evaluateOrientations(double d0, double step,
+                              Eigen::Quaterniond* orientations, std::size_t count) const
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            orientations[i] = orientationAt(angles(d0 + static_cast<double>(i) * step));
+    }
+
     static void clamp_centuries(double& T)
     {
         if (T < -IAU_SECULAR_TERM_VALID_CENTURIES)
@@ -118,6 +137,79 @@ protected:
     }
 
 private:
+    // Pole RA, pole declination and meridian angle in degrees at d days
+    // from J2000
+    Eigen::Vector3d angles(double d) const
+    {
+        Eigen::Vector3d a;
+        pole(d, a.x(), a.y());
+        a.z() = meridian(d);
+        return a;
+    }
+
+    Eigen::Quaterniond spinAt(double W) const
+    {
+        if (flipped)
+            return math::YRotation( math::degToRad(180.0 + W));
+        else
+            return math::YRotation(-math::degToRad(180.0 + W));
+    }
+
+    Eigen::Quaterniond equatorAt(double poleRA, double poleDec) const
+    {
+        double node = poleRA + 90.0;
+        double inclination = 90.0 - poleDec;
+
+        if (flipped)
+            return math::XRot180<double> *
+                   math::XRotation(math::degToRad(-inclination)) *
+                   math::YRotation(math::degToRad(-node));
+        else
+            return math::XRotation(math::degToRad(-inclination)) *
+                   math::YRotation(math::degToRad(-node));
+    }
+
+    Eigen::Quaterniond orientationAt(const Eigen::Vector3d& a) const
+    {
+        return spinAt(a.z()) * equatorAt(a.x(), a.y());
+    }
+
+    void fitOrientations(double d0, double step,
+                         Eigen::Quaterniond* orientations, std::size_t count) const
+    {
+        // The batches of one call have the same step, so once a fit fails
+        // the others are unlikely to succeed either
+        bool fit = true;
+        for (std::size_t first = 0; first < count; first += IAU_FIT_BATCH_SIZE)
+        {
+            double d = d0 + static_cast<double>(first) * step;
+            std::size_t n = std::min(IAU_FIT_BATCH_SIZE, count - first);
+            fit = fit && n >= IAU_MIN_FIT_COUNT && fitBatch(d, step, orientations + first, n);
+            if (!fit)
+                evaluateOrientations(d, step, orientations + first, n);
+        }
+    }
+
+    // Returns false without computing the orientations if the fit isn't
+    // accurate enough
+    bool fitBatch(double d0, double step,
+                  Eigen::Quaterniond* orientations, std::size_t count) const
+    {
+        double halfLength = 0.5 * step * static_cast<double>(count - 1);
+        double center = d0 + halfLength;
+        auto func = [this, center, halfLength](double x) { return angles(center + halfLength * x); };
+
+        ChebyshevSeries<3, IAU_FIT_NODE_COUNT> series;
+        FitChebyshev(series, func);
+        if (ChebyshevFitError(series, func) > IAU_FIT_TOLERANCE)
+            return false;
+
+        double scale = 2.0 / static_cast<double>(count - 1);
+        for (std::size_t i = 0; i < count; ++i)
+            orientations[i] = orientationAt(EvaluateChebyshev(series, static_cast<double>(i) * scale - 1.0));
+        return true;
+    }
+
     double period;
     bool flipped;
 };
@@ -152,8 +244,8 @@ public:
         else if (T > P03LP_VALID_CENTURIES)
             T = P03LP_VALID_CENTURIES;
 
-        PrecessionAngles prec = PrecObliquity_P03LP(T);
-        EclipticPole pole = EclipticPrecession_P03LP(T);
+        PrecessionAngles prec = PrecObliquity_P03LP_Tabulated(T);
+        EclipticPole pole = EclipticPrecession_P03LP_Tabulated(T);
 
         double obliquity = math::degToRad(prec.epsA / 3600);
         double precession = math::degToRad(prec.pA / 3600);
@@ -236,6 +328,13 @@ public:
         return meridianAtEpoch + rotationRate * d;
     }
 
+    // The angles are linear in time, a fit would save nothing
+    void orientationsAtTimes(double startTime, double step,
+                             Eigen::Quaterniond* orientations, std::size_t count) const override
+    {
+        evaluateOrientations(startTime - astro::J2000, step, orientations, count);
+    }
+
 private:
     double poleRA;
     double poleRARate;
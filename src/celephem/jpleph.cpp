@@ -14,10 +14,13 @@
 #include <cassert>
 #include <cstddef>
 #include <cstring>
+#include <fstream>
 #include <istream>
 #include <type_traits>
+#include <utility>
 
 #include <celcompat/bit.h>
+#include <celutil/mappedfile.h>
 #include "jpleph.h"
 
 namespace celestia::ephem
@@ -62,14 +65,6 @@ constexpr unsigned int LabelSize = 84;
 constexpr unsigned int INPOP_DE_COMPATIBLE = 100;
 constexpr unsigned int DE200 = 200;
 
-// Read a big-endian or little endian 32-bit unsigned integer
-std::uint32_t readUint(std::istream& in, bool swap)
-{
-    std::uint32_t ret;
-    in.read((char*) &ret, sizeof(std::uint32_t));
-    return swap ? compat::byteswap(ret) : ret;
-}
-
 // Read a big-endian or little endian 64-bit IEEE double.
 // If the native double format isn't IEEE 754, there will be troubles.
 double readDouble(std::istream& in, bool swap)
@@ -131,9 +126,15 @@ struct JPLEFileHeader
 static_assert(std::is_standard_layout_v<JPLECoeff>);
 static_assert(std::is_standard_layout_v<JPLEFileHeader>);
 
+// INPOP files store the record size right after the header
+constexpr std::size_t HeaderSize = sizeof(JPLEFileHeader) + sizeof(std::uint32_t);
+
 } // end unnamed namespace
 
 
+JPLEphemeris::~JPLEphemeris() = default;
+
+
 unsigned int JPLEphemeris::getDENumber() const
 {
     return DENum;
@@ -192,9 +193,9 @@ Eigen::Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd)
     // recNo is always >= 0:
     auto recNo = (unsigned int) ((tjd - startDate) / daysPerInterval);
     // Make sure we don't go past the end of the array if t == endDate
-    if (recNo >= records.size())
-        recNo = records.size() - 1;
-    const JPLEphRecord* rec = &records[recNo];
+    if (recNo >= nRecords)
+        recNo = nRecords - 1;
+    double recStart = getRecordStart(recNo);
 
     auto planetIdx = static_cast<std::size_t>(planet);
 
@@ -203,30 +204,33 @@ Eigen::Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd)
     assert(coeffInfo[planetIdx].nCoeffs <= MaxChebyshevCoeffs);
 
     // u is the normalized time (in [-1, 1]) for interpolating
-    // coeffs is a pointer to the Chebyshev coefficients
+    // coeffOffset is the index of the Chebyshev coefficients in the record
     double u = 0.0;
-    const double* coeffs = nullptr;
+    std::uint32_t coeffOffset = 0;
 
     // nGranules is unsigned int so it will be compared against FFFFFFFF:
     if (coeffInfo[planetIdx].nGranules == (unsigned int) -1)
     {
-        coeffs = rec->coeffs.data() + coeffInfo[planetIdx].offset;
-        u = 2.0 * (tjd - rec->t0) / daysPerInterval - 1.0;
+        coeffOffset = coeffInfo[planetIdx].offset;
+        u = 2.0 * (tjd - recStart) / daysPerInterval - 1.0;
     }
     else
     {
         double daysPerGranule = daysPerInterval / coeffInfo[planetIdx].nGranules;
-        auto granule = (int) ((tjd - rec->t0) / daysPerGranule);
-        double granuleStartDate = rec->t0 + daysPerGranule * (double) granule;
-        coeffs = rec->coeffs.data() + coeffInfo[planetIdx].offset +
-                 granule * coeffInfo[planetIdx].nCoeffs * 3;
+        auto granule = (int) ((tjd - recStart) / daysPerGranule);
+        double granuleStartDate = recStart + daysPerGranule * (double) granule;
+        coeffOffset = coeffInfo[planetIdx].offset +
+                      granule * coeffInfo[planetIdx].nCoeffs * 3;
         u = 2.0 * (tjd - granuleStartDate) / daysPerGranule - 1.0;
     }
 
+    unsigned int nCoeffs = coeffInfo[planetIdx].nCoeffs;
+    std::array<double, MaxChebyshevCoeffs * 3> buffer;
+    const double* coeffs = getCoefficients(recNo, coeffOffset, nCoeffs * 3, buffer.data());
+
     // Evaluate the Chebyshev polynomials
     double sum[3];
     double cc[MaxChebyshevCoeffs];
-    unsigned int nCoeffs = coeffInfo[planetIdx].nCoeffs;
     for (int i = 0; i < 3; i++)
     {
         cc[0] = 1.0;
@@ -243,15 +247,48 @@ Eigen::Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd)
 }
 
 
-JPLEphemeris* JPLEphemeris::load(std::istream& in)
+double JPLEphemeris::getRecordStart(unsigned int recNo) const
 {
-    std::array<char, sizeof(JPLEFileHeader)> fh;
-    in.read(fh.data(), fh.size()); /* Flawfinder: ignore */
-    if (!in.good())
-        return nullptr;
+    if (file == nullptr)
+        return records[recNo].t0;
+
+    double t0;
+    getMaybeSwapDouble(t0, file->data() + recordsOffset + std::size_t(recNo) * recordSize * sizeof(double), swapBytes);
+    return t0;
+}
+
+
+// Return count coefficients starting at offset in the specified record.
+// Records of a mapped file are decoded into buffer.
+const double* JPLEphemeris::getCoefficients(unsigned int recNo,
+                                            std::uint32_t offset,
+                                            std::uint32_t count,
+                                            double* buffer) const
+{
+    if (file == nullptr)
+        return records[recNo].coeffs.data() + offset;
 
+    // Skip the start and end time of the record
+    const char* src = file->data() + recordsOffset +
+                      (std::size_t(recNo) * recordSize + 2 + offset) * sizeof(double);
+    if (swapBytes)
+    {
+        for (std::uint32_t i = 0; i < count; ++i)
+            getMaybeSwapDouble(buffer[i], src + i * sizeof(double), true);
+    }
+    else
+    {
+        std::memcpy(buffer, src, count * sizeof(double));
+    }
+
+    return buffer;
+}
+
+
+JPLEphemeris* JPLEphemeris::parseHeader(const char* fh)
+{
     decltype(JPLEFileHeader::deNum) deNum;
-    std::memcpy(&deNum, fh.data() + offsetof(JPLEFileHeader, deNum), sizeof(deNum));
+    std::memcpy(&deNum, fh + offsetof(JPLEFileHeader, deNum), sizeof(deNum));
     std::uint32_t deNum2 = compat::byteswap(deNum);
 
     bool swapBytes;
@@ -288,18 +325,18 @@ JPLEphemeris* JPLEphemeris::load(std::istream& in)
     eph->DENum = deNum;
 
     // Read the start time, end time, and time interval
-    getMaybeSwapDouble(eph->startDate,          fh.data() + offsetof(JPLEFileHeader, startDate),          swapBytes);
-    getMaybeSwapDouble(eph->endDate,            fh.data() + offsetof(JPLEFileHeader, endDate),            swapBytes);
-    getMaybeSwapDouble(eph->daysPerInterval,    fh.data() + offsetof(JPLEFileHeader, daysPerInterval),    swapBytes);
+    getMaybeSwapDouble(eph->startDate,          fh + offsetof(JPLEFileHeader, startDate),          swapBytes);
+    getMaybeSwapDouble(eph->endDate,            fh + offsetof(JPLEFileHeader, endDate),            swapBytes);
+    getMaybeSwapDouble(eph->daysPerInterval,    fh + offsetof(JPLEFileHeader, daysPerInterval),    swapBytes);
     // kilometers per astronomical unit
-    getMaybeSwapDouble(eph->au,                 fh.data() + offsetof(JPLEFileHeader, au),                 swapBytes);
-    getMaybeSwapDouble(eph->earthMoonMassRatio, fh.data() + offsetof(JPLEFileHeader, earthMoonMassRatio), swapBytes);
+    getMaybeSwapDouble(eph->au,                 fh + offsetof(JPLEFileHeader, au),                 swapBytes);
+    getMaybeSwapDouble(eph->earthMoonMassRatio, fh + offsetof(JPLEFileHeader, earthMoonMassRatio), swapBytes);
 
     // Read the coefficient information for each item in the ephemeris
     eph->recordSize = 0;
     for (unsigned int i = 0; i < JPLEph_NItems; i++)
     {
-        const char* coeffInfo = fh.data() + offsetof(JPLEFileHeader, coeffInfo) + i * sizeof(JPLECoeff);
+        const char* coeffInfo = fh + offsetof(JPLEFileHeader, coeffInfo) + i * sizeof(JPLECoeff);
         getMaybeSwapUint32(eph->coeffInfo[i].offset,    coeffInfo + offsetof(JPLECoeff, offset),    swapBytes);
         getMaybeSwapUint32(eph->coeffInfo[i].nCoeffs,   coeffInfo + offsetof(JPLECoeff, nCoeffs),   swapBytes);
         getMaybeSwapUint32(eph->coeffInfo[i].nGranules, coeffInfo + offsetof(JPLECoeff, nGranules), swapBytes);
@@ -309,7 +346,7 @@ JPLEphemeris* JPLEphemeris::load(std::istream& in)
         eph->recordSize += eph->coeffInfo[i].nCoeffs * eph->coeffInfo[i].nGranules * nRecords;
     }
 
-    const char* librationCoeffInfo = fh.data() + offsetof(JPLEFileHeader, librationCoeffInfo);
+    const char* librationCoeffInfo = fh + offsetof(JPLEFileHeader, librationCoeffInfo);
     getMaybeSwapUint32(eph->librationCoeffInfo.offset,    librationCoeffInfo + offsetof(JPLECoeff, offset),    swapBytes);
     getMaybeSwapUint32(eph->librationCoeffInfo.nCoeffs,   librationCoeffInfo + offsetof(JPLECoeff, nCoeffs),   swapBytes);
     getMaybeSwapUint32(eph->librationCoeffInfo.nGranules, librationCoeffInfo + offsetof(JPLECoeff, nGranules), swapBytes);
@@ -318,29 +355,39 @@ JPLEphemeris* JPLEphemeris::load(std::istream& in)
 
     // if INPOP ephemeris, read record size
     if (deNum == INPOP_DE_COMPATIBLE)
-    {
-       eph->recordSize = readUint(in, eph->swapBytes);
-       // Skip past the rest of the record
-       in.ignore(eph->recordSize * 8 - sizeof(JPLEFileHeader) - sizeof(uint32_t));
-    }
-    else
-    {
-        // Skip past the rest of the record
-        in.ignore(eph->recordSize * 8 - sizeof(JPLEFileHeader));
-    }
+        getMaybeSwapUint32(eph->recordSize, fh + sizeof(JPLEFileHeader), swapBytes);
 
-    // The next record contains constant values (which we don't need)
-    in.ignore(eph->recordSize * 8);
-    if (!in.good())
+    // The header must fit in the first record
+    if (eph->recordSize * sizeof(double) < HeaderSize)
     {
         delete eph;
         return nullptr;
     }
 
-    auto nRecords = (unsigned int) ((eph->endDate - eph->startDate) /
-                        eph->daysPerInterval);
-    eph->records.resize(nRecords);
-    for (unsigned int i = 0; i < nRecords; i++)
+    eph->nRecords = (unsigned int) ((eph->endDate - eph->startDate) / eph->daysPerInterval);
+    return eph;
+}
+
+
+JPLEphemeris* JPLEphemeris::load(std::istream& in)
+{
+    std::array<char, HeaderSize> fh;
+    in.read(fh.data(), fh.size()); /* Flawfinder: ignore */
+    if (!in.good())
+        return nullptr;
+
+    std::unique_ptr<JPLEphemeris> eph{ parseHeader(fh.data()) };
+    if (eph == nullptr)
+        return nullptr;
+
+    // Skip past the rest of the record; the next record contains constant
+    // values (which we don't need)
+    in.ignore(eph->recordSize * 8 * 2 - HeaderSize);
+    if (!in.good())
+        return nullptr;
+
+    eph->records.resize(eph->nRecords);
+    for (unsigned int i = 0; i < eph->nRecords; i++)
     {
         eph->records[i].t0 = readDouble(in, eph->swapBytes);
         eph->records[i].t1 = readDouble(in, eph->swapBytes);
@@ -353,13 +400,40 @@ JPLEphemeris* JPLEphemeris::load(std::istream& in)
 
         // Make sure that we read this record successfully
         if (!in.good())
-        {
-            delete eph;
             return nullptr;
-        }
     }
 
-    return eph;
+    return eph.release();
+}
+
+
+JPLEphemeris* JPLEphemeris::load(const fs::path& path)
+{
+    auto mappedFile = util::MappedFile::open(path);
+    if (mappedFile == nullptr)
+    {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        return in.good() ? load(in) : nullptr;
+    }
+
+    if (mappedFile->size() < HeaderSize)
+        return nullptr;
+
+    std::unique_ptr<JPLEphemeris> eph{ parseHeader(mappedFile->data()) };
+    if (eph == nullptr)
+        return nullptr;
+
+    // Records follow the header and the constants, one record each
+    eph->recordsOffset = std::size_t(eph->recordSize) * sizeof(double) * 2;
+    std::size_t recordsSize = std::size_t(eph->nRecords) * eph->recordSize * sizeof(double);
+    if (eph->nRecords == 0 || mappedFile->size() < eph->recordsOffset ||
+        mappedFile->size() - eph->recordsOffset < recordsSize)
+    {
+        return nullptr;
+    }
+
+    eph->file = std::move(mappedFile);
+    return eph.release();
 }
 
 } // end namespace celestia::ephem
@@ -16,10 +16,18 @@
 #include <cstddef>
 #include <cstdint>
 #include <iosfwd>
+#include <memory>
 #include <vector>
 
 #include <Eigen/Core>
 
+#include <celcompat/filesystem.h>
+
+namespace celestia::util
+{
+class MappedFile;
+}
+
 namespace celestia::ephem
 {
 
@@ -68,11 +76,17 @@ private:
 public:
     static constexpr std::size_t JPLEph_NItems = 12;
 
-    ~JPLEphemeris() = default;
+    ~JPLEphemeris();
 
     Eigen::Vector3d getPlanetPosition(JPLEphemItem, double t) const;
 
+    // Read all records into memory
     static JPLEphemeris* load(std::istream&);
+    // Map the file into memory and decode the coefficients as they are
+    // needed, so neither the time to load nor the memory used depend on
+    // the span of the ephemeris. Falls back to reading the file if it
+    // can't be mapped.
+    static JPLEphemeris* load(const fs::path&);
 
     unsigned int getDENumber() const;
     double getStartDate() const;
@@ -81,6 +95,11 @@ public:
     unsigned int getRecordSize() const;
 
 private:
+    static JPLEphemeris* parseHeader(const char* header);
+    double getRecordStart(unsigned int recNo) const;
+    const double* getCoefficients(unsigned int recNo, std::uint32_t offset,
+                                  std::uint32_t count, double* buffer) const;
+
     std::array<JPLEphCoeffInfo, JPLEph_NItems> coeffInfo;
     JPLEphCoeffInfo librationCoeffInfo;
 
@@ -95,7 +114,12 @@ private:
     unsigned int recordSize;  // number of doubles per record
     bool swapBytes;
 
+    unsigned int nRecords{ 0 };
     std::vector<JPLEphRecord> records;
+
+    // Records of a mapped file start at byte recordsOffset
+    std::unique_ptr<util::MappedFile> file;
+    std::size_t recordsOffset{ 0 };
 };
 
 } // end namespace celestia::ephem
@@ -138,13 +138,13 @@ CreateKeplerOrbit(const astro::KeplerElements& elements, double epoch)
   *
   * Subclasses of orbit should override this method as necessary. The default
   * implementation uses an adaptive sampling scheme with the following defaults:
-  *    tolerance: 1 km
+  *    tolerance: 1e-5 R, and at least 1 km
   *    start step: T / 1e5
   *    min step: T / 1e7
   *    max step: T / 100
   *
   * Where T is either the mean orbital period for periodic orbits or the valid
-  * time span for aperiodic trajectories.
+  * time span for aperiodic trajectories, and R is the bounding radius.
   */
 void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
 {
@@ -169,7 +169,9 @@ void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) cons
     }
 
     AdaptiveSamplingParameters samplingParams;
-    samplingParams.tolerance = 1.0; // kilometers
+    // Coarse enough for the whole orbit on screen, renderers refine the
+    // parts seen from closer
+    samplingParams.tolerance = std::max(1.0, getBoundingRadius() * 1.0e-5); // kilometers
     samplingParams.maxStep = span / 100.0;
     samplingParams.minStep = span / 1.0e7;
     samplingParams.startStep = span / 1.0e5;
@@ -178,6 +180,14 @@ void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) cons
 }
 
 
+void Orbit::positionsAtTimes(double startTime, double step,
+                             Eigen::Vector3d* positions, std::size_t count) const
+{
+    for (std::size_t i = 0; i < count; ++i)
+        positions[i] = positionAtTime(startTime + static_cast<double>(i) * step);
+}
+
+
 /** Adaptively sample the orbit over the range [ startTime, endTime ].
   */
 void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& proc, const AdaptiveSamplingParameters& samplingParams) const
@@ -382,6 +392,39 @@ double EllipticalOrbit::getBoundingRadius() const
 }
 
 
+bool EllipticalOrbit::getMaximumSpeed(double& speed) const
+{
+    // The speed is greatest at pericenter
+    double meanMotion = 2.0 * celestia::numbers::pi / std::abs(period);
+    speed = meanMotion * semiMajorAxis * std::sqrt((1.0 + eccentricity) / (1.0 - eccentricity));
+    return true;
+}
+
+
+bool EllipticalOrbit::getEllipsePath(double startTime, double endTime, EllipsePath& path) const
+{
+    // The iterations converge to the solution nearest the mean anomaly, so
+    // the anomalies increase along with time even over several revolutions
+    double meanMotion = 2.0 * celestia::numbers::pi / period;
+    double startAnomaly = eccentricAnomaly(meanAnomalyAtEpoch + (startTime - epoch) * meanMotion);
+    double endAnomaly = eccentricAnomaly(meanAnomalyAtEpoch + (endTime - epoch) * meanMotion);
+
+    // Keep the anomalies small for the benefit of single precision users
+    double revolutions = std::floor(startAnomaly / (2.0 * celestia::numbers::pi));
+    path.startAnomaly = startAnomaly - revolutions * 2.0 * celestia::numbers::pi;
+    path.endAnomaly = endAnomaly - revolutions * 2.0 * celestia::numbers::pi;
+    path.eccentricity = eccentricity;
+
+    // Same conversion to Celestia's coordinate system as positionAtE
+    auto toCelestia = [](const Eigen::Vector3d& v) { return Eigen::Vector3d(v.x(), v.z(), -v.y()); };
+    path.majorAxis = toCelestia(orbitPlaneRotation.col(0) * semiMajorAxis);
+    path.minorAxis = toCelestia(orbitPlaneRotation.col(1) * semiMinorAxis);
+    path.center = -eccentricity * path.majorAxis;
+
+    return true;
+}
+
+
 HyperbolicOrbit::HyperbolicOrbit(const astro::KeplerElements& _elements, double _epoch) :
     semiMajorAxis(_elements.semimajorAxis),
     eccentricity(_elements.eccentricity),
@@ -484,6 +527,14 @@ double HyperbolicOrbit::getBoundingRadius() const
 }
 
 
+bool HyperbolicOrbit::getMaximumSpeed(double& speed) const
+{
+    // The speed is greatest at pericenter
+    speed = std::abs(meanMotion * semiMajorAxis) * std::sqrt((eccentricity + 1.0) / (eccentricity - 1.0));
+    return true;
+}
+
+
 bool HyperbolicOrbit::isPeriodic() const
 {
     return false;
@@ -500,6 +551,10 @@ void HyperbolicOrbit::getValidRange(double& begin, double& end) const
 
 Eigen::Vector3d CachingOrbit::positionAtTime(double jd) const
 {
+    std::unique_lock<std::mutex> lock(cacheMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return computePosition(jd);
+
     if (jd != lastTime)
     {
         lastTime = jd;
@@ -519,6 +574,10 @@ Eigen::Vector3d CachingOrbit::positionAtTime(double jd) const
 
 Eigen::Vector3d CachingOrbit::velocityAtTime(double jd) const
 {
+    std::unique_lock<std::mutex> lock(cacheMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return computeVelocity(jd);
+
     if (jd != lastTime)
     {
         lastVelocity = computeVelocity(jd);
@@ -608,6 +667,37 @@ Eigen::Vector3d MixedOrbit::velocityAtTime(double jd) const
 }
 
 
+const Orbit* MixedOrbit::orbitAtTime(double jd) const
+{
+    if (jd < begin)
+        return beforeApprox.get();
+    else if (jd < end)
+        return primary.get();
+    else
+        return afterApprox.get();
+}
+
+
+void MixedOrbit::positionsAtTimes(double startTime, double step,
+                                  Eigen::Vector3d* positions, std::size_t count) const
+{
+    // Hand each run of times to the orbit positionAtTime() would use
+    std::size_t first = 0;
+    while (first < count)
+    {
+        double t = startTime + static_cast<double>(first) * step;
+        const Orbit* o = orbitAtTime(t);
+
+        std::size_t last = first + 1;
+        while (last < count && orbitAtTime(startTime + static_cast<double>(last) * step) == o)
+            ++last;
+
+        o->positionsAtTimes(t, step, positions + first, last - first);
+        first = last;
+    }
+}
+
+
 double MixedOrbit::getPeriod() const
 {
     return primary->getPeriod();
@@ -620,6 +710,13 @@ double MixedOrbit::getBoundingRadius() const
 }
 
 
+bool MixedOrbit::isThreadSafe() const
+{
+    // The approximations are elliptical orbits
+    return primary->isThreadSafe();
+}
+
+
 void MixedOrbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
 {
     const Orbit* o;
@@ -676,6 +773,14 @@ FixedOrbit::sample(double /* startTime */, double /* endTime */, OrbitSampleProc
 }
 
 
+bool
+FixedOrbit::getMaximumSpeed(double& speed) const
+{
+    speed = 0.0;
+    return true;
+}
+
+
 /*** SynchronousOrbit ***/
 // TODO: eliminate this class once body-fixed reference frames are implemented
 SynchronousOrbit::SynchronousOrbit(const Body& _body,
@@ -9,7 +9,9 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <mutex>
 
 #include <Eigen/Core>
 
@@ -22,6 +24,21 @@ namespace celestia::ephem
 
 class OrbitSampleProc;
 
+/*! Part of an elliptical path, given by the ellipse's center and semi-axes
+ *  in the orbit's reference frame: the position at eccentric anomaly E is
+ *  center + cos(E) * majorAxis + sin(E) * minorAxis. Kepler's equation
+ *  E - e sin(E) relates the anomaly to the time along the path.
+ */
+struct EllipsePath
+{
+    Eigen::Vector3d center;
+    Eigen::Vector3d majorAxis;
+    Eigen::Vector3d minorAxis;
+    double eccentricity;
+    double startAnomaly;
+    double endAnomaly;
+};
+
 class Orbit
 {
 public:
@@ -39,6 +56,13 @@ public:
      */
     virtual Eigen::Vector3d velocityAtTime(double) const;
 
+    /*! Compute the positions at the count evenly spaced times
+     * startTime + i * step. Orbits that can share work between nearby
+     * times override this; the default calls positionAtTime() for each.
+     */
+    virtual void positionsAtTimes(double startTime, double step,
+                                  Eigen::Vector3d* positions, std::size_t count) const;
+
     virtual double getPeriod() const = 0;
     virtual double getBoundingRadius() const = 0;
 
@@ -46,6 +70,22 @@ public:
 
     virtual bool isPeriodic() const { return true; };
 
+    // Describe the path between startTime and endTime as an ellipse, which
+    // lets it be drawn without sampling. Only Keplerian orbits return true.
+    virtual bool getEllipsePath(double /* startTime */, double /* endTime */, EllipsePath& /* path */) const
+    {
+        return false;
+    }
+
+    // Return true if positionAtTime may be called from several threads at
+    // once. Orbits that cache results or call into scripts or external
+    // libraries must be evaluated from one thread.
+    virtual bool isThreadSafe() const { return false; }
+
+    // Get an upper bound on the speed in the orbit's reference frame in
+    // kilometers per day. Returns false if there's no bound.
+    virtual bool getMaximumSpeed(double& /* speed */) const { return false; }
+
     // Return the time range over which the orbit is valid; if the orbit
     // is always valid, begin and end should be equal.
     virtual void getValidRange(double& begin, double& end) const
@@ -78,6 +118,9 @@ public:
     Eigen::Vector3d velocityAtTime(double) const override;
     double getPeriod() const override;
     double getBoundingRadius() const override;
+    bool getEllipsePath(double startTime, double endTime, EllipsePath& path) const override;
+    bool isThreadSafe() const override { return true; }
+    bool getMaximumSpeed(double& speed) const override;
 
 private:
     double eccentricAnomaly(double) const;
@@ -108,6 +151,8 @@ public:
     double getBoundingRadius() const override;
     bool isPeriodic() const override;
     void getValidRange(double& begin, double& end) const override;
+    bool isThreadSafe() const override { return true; }
+    bool getMaximumSpeed(double& speed) const override;
 
 private:
     double eccentricAnomaly(double) const;
@@ -143,6 +188,11 @@ public:
  * order to avoid redundant calculation, the CachingOrbit class saves the
  * result of the last calculation and uses it if the time matches the cached
  * time.
+ *
+ * The cache is locked while in use; a call made while another one holds it
+ * computes its result without the cache. CachingOrbits are thread safe as
+ * long as computePosition() and computeVelocity() are, subclasses with other
+ * state must override isThreadSafe().
  */
 class CachingOrbit : public Orbit
 {
@@ -155,8 +205,10 @@ class CachingOrbit : public Orbit
 
     Eigen::Vector3d positionAtTime(double jd) const override;
     Eigen::Vector3d velocityAtTime(double jd) const override;
+    bool isThreadSafe() const override { return true; }
 
  private:
+    mutable std::mutex cacheMutex;
     mutable Eigen::Vector3d lastPosition;
     mutable Eigen::Vector3d lastVelocity;
     mutable double lastTime{ -1.0e30 };
@@ -179,11 +231,16 @@ class MixedOrbit : public Orbit
 
     Eigen::Vector3d positionAtTime(double jd) const override;
     Eigen::Vector3d velocityAtTime(double jd) const override;
+    void positionsAtTimes(double startTime, double step,
+                          Eigen::Vector3d* positions, std::size_t count) const override;
     double getPeriod() const override;
     double getBoundingRadius() const override;
     void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+    bool isThreadSafe() const override;
 
  private:
+    const Orbit* orbitAtTime(double jd) const;
+
     std::shared_ptr<const Orbit> primary;
     std::shared_ptr<const Orbit> afterApprox;
     std::shared_ptr<const Orbit> beforeApprox;
@@ -231,6 +288,8 @@ class FixedOrbit : public Orbit
     bool isPeriodic() const override;
     double getBoundingRadius() const override;
     void sample(double, double, OrbitSampleProc&) const override;
+    bool isThreadSafe() const override { return true; }
+    bool getMaximumSpeed(double& speed) const override;
 
  private:
     Eigen::Vector3d position;
@@ -13,6 +13,9 @@
 #include "precession.h"
 
 #include <array>
+#include <cmath>
+#include <memory>
+#include <mutex>
 
 #include <celcompat/numbers.h>
 #include <celmath/mathlib.h>
@@ -75,6 +78,89 @@ constexpr std::array PrecessionTerms =
 // DE405 obliquity of the ecliptic
 constexpr double eps0 = 84381.40889;
 
+
+// Tables of the P03LP quantities cover its validity range of a million
+// years around J2000, with one entry per century. The shortest period of
+// the series is 204 centuries, so cubic interpolation between the entries
+// stays within 1e-4 arcseconds, and reproduces the cubic polynomial parts
+// exactly.
+constexpr int TableCenturies = 5000;
+constexpr int ChunkCenturies = 100;
+constexpr int ChunkCount = 2 * TableCenturies / ChunkCenturies;
+
+// PA, QA, pA and epsA
+using TableEntry = std::array<double, 4>;
+
+// Entries from one century before the start of the chunk to two after its
+// end, so that every interval has the neighbours needed for interpolation
+using TableChunk = std::array<TableEntry, ChunkCenturies + 3>;
+
+TableEntry
+ComputeEntry(double T)
+{
+    EclipticPole pole = EclipticPrecession_P03LP(T);
+    PrecessionAngles angles = PrecObliquity_P03LP(T);
+    return { pole.PA, pole.QA, angles.pA, angles.epsA };
+}
+
+class P03LPTable
+{
+public:
+    TableEntry interpolate(double T);
+
+private:
+    const TableChunk& getChunk(int index);
+
+    std::array<std::once_flag, ChunkCount> chunkFlags;
+    std::array<std::unique_ptr<TableChunk>, ChunkCount> chunks;
+};
+
+const TableChunk&
+P03LPTable::getChunk(int index)
+{
+    std::call_once(chunkFlags[index], [this, index]
+    {
+        auto chunk = std::make_unique<TableChunk>();
+        double start = static_cast<double>(index * ChunkCenturies - TableCenturies - 1);
+        for (std::size_t i = 0; i < chunk->size(); ++i)
+            (*chunk)[i] = ComputeEntry(start + static_cast<double>(i));
+        chunks[index] = std::move(chunk);
+    });
+
+    return *chunks[index];
+}
+
+TableEntry
+P03LPTable::interpolate(double T)
+{
+    double u = T + static_cast<double>(TableCenturies);
+    if (!(u >= 0.0 && u < static_cast<double>(2 * TableCenturies)))
+        return ComputeEntry(T);
+
+    auto century = static_cast<int>(u);
+    const TableChunk& chunk = getChunk(century / ChunkCenturies);
+    const TableEntry* p = chunk.data() + century % ChunkCenturies;
+
+    // Cubic Lagrange interpolation between p[1] and p[2]
+    double x = u - static_cast<double>(century);
+    double w0 = -x * (x - 1.0) * (x - 2.0) / 6.0;
+    double w1 = (x + 1.0) * (x - 1.0) * (x - 2.0) / 2.0;
+    double w2 = -(x + 1.0) * x * (x - 2.0) / 2.0;
+    double w3 = (x + 1.0) * x * (x - 1.0) / 6.0;
+
+    TableEntry result;
+    for (std::size_t i = 0; i < result.size(); ++i)
+        result[i] = w0 * p[0][i] + w1 * p[1][i] + w2 * p[2][i] + w3 * p[3][i];
+    return result;
+}
+
+P03LPTable&
+GetP03LPTable()
+{
+    static P03LPTable* const table = std::make_unique<P03LPTable>().release(); //NOSONAR
+    return *table;
+}
+
 } // end unnamed namespace
 
 
@@ -163,6 +249,22 @@ PrecObliquity_P03LP(double T)
 }
 
 
+EclipticPole
+EclipticPrecession_P03LP_Tabulated(double T)
+{
+    TableEntry entry = GetP03LPTable().interpolate(T);
+    return { entry[0], entry[1] };
+}
+
+
+PrecessionAngles
+PrecObliquity_P03LP_Tabulated(double T)
+{
+    TableEntry entry = GetP03LPTable().interpolate(T);
+    return { entry[2], entry[3] };
+}
+
+
 /*! Compute equatorial precession angles z, zeta, and theta using the P03
  *  precession model.
  */
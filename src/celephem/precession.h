@@ -61,6 +61,12 @@ struct EquatorialPrecessionAngles
 extern EclipticPole EclipticPrecession_P03LP(double T);
 extern PrecessionAngles PrecObliquity_P03LP(double T);
 
+// The same quantities interpolated from tables with an entry per century,
+// for callers that need them often. The tables are filled on first use,
+// a few thousand years at a time.
+extern EclipticPole EclipticPrecession_P03LP_Tabulated(double T);
+extern PrecessionAngles PrecObliquity_P03LP_Tabulated(double T);
+
 extern EclipticPole EclipticPrecession_P03(double T);
 extern EclipticAngles EclipticPrecessionAngles_P03(double T);
 extern PrecessionAngles PrecObliquity_P03(double T);
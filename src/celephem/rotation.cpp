@@ -58,6 +58,15 @@ RotationModel::angularVelocityAtTime(double tdb) const
 }
 
 
+void
+RotationModel::orientationsAtTimes(double startTime, double step,
+                                   Eigen::Quaterniond* orientations, std::size_t count) const
+{
+    for (std::size_t i = 0; i < count; ++i)
+        orientations[i] = orientationAtTime(startTime + static_cast<double>(i) * step);
+}
+
+
 /***** CachingRotationModel *****/
 
 CachingRotationModel::CachingRotationModel() :
@@ -72,6 +81,10 @@ CachingRotationModel::CachingRotationModel() :
 Eigen::Quaterniond
 CachingRotationModel::spin(double tjd) const
 {
+    std::unique_lock<std::mutex> lock(cacheMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return computeSpin(tjd);
+
     if (tjd != lastTime)
     {
         lastTime = tjd;
@@ -93,6 +106,10 @@ CachingRotationModel::spin(double tjd) const
 Eigen::Quaterniond
 CachingRotationModel::equatorOrientationAtTime(double tjd) const
 {
+    std::unique_lock<std::mutex> lock(cacheMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return computeEquatorOrientation(tjd);
+
     if (tjd != lastTime)
     {
         lastTime = tjd;
@@ -114,6 +131,10 @@ CachingRotationModel::equatorOrientationAtTime(double tjd) const
 Eigen::Vector3d
 CachingRotationModel::angularVelocityAtTime(double tjd) const
 {
+    std::unique_lock<std::mutex> lock(cacheMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return computeAngularVelocity(tjd);
+
     if (tjd != lastTime)
     {
         lastAngularVelocity = computeAngularVelocity(tjd);
@@ -10,7 +10,9 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <mutex>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -42,6 +44,14 @@ class RotationModel
 
     virtual Eigen::Vector3d angularVelocityAtTime(double tjd) const;
 
+    /*! Compute the orientations at the count evenly spaced times
+     *  startTime + i * step, as with Orbit::positionsAtTimes(). Models that
+     *  can share work between nearby times override this; the default
+     *  calls orientationAtTime() for each.
+     */
+    virtual void orientationsAtTimes(double startTime, double step,
+                                     Eigen::Quaterniond* orientations, std::size_t count) const;
+
     /*! Return the orientation of the equatorial plane (normal to the primary
      *  axis of rotation.) The overall orientation of the object is
      *  spin * equator. If there is no primary axis of rotation, equator = 1
@@ -62,6 +72,10 @@ class RotationModel
 
     virtual bool isPeriodic() const = 0;
 
+    // Return true if the orientation may be computed from several threads
+    // at once, as with Orbit::isThreadSafe().
+    virtual bool isThreadSafe() const { return false; }
+
     // Return the time range over which the orientation model is valid;
     // if the model is always valid, begin and end should be equal.
     virtual void getValidRange(double& begin, double& end) const
@@ -81,6 +95,10 @@ class RotationModel
  *  the instantaneous angular velocity. It may be overridden if there is some
  *  better means to calculate the angular velocity for a specific rotation
  *  model.
+ *
+ *  As with CachingOrbit, a call made while another thread holds the cache
+ *  bypasses it, and subclasses with other state must override
+ *  isThreadSafe().
  */
 class CachingRotationModel : public RotationModel
 {
@@ -97,8 +115,10 @@ class CachingRotationModel : public RotationModel
     virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
     double getPeriod() const override = 0;
     bool isPeriodic() const override = 0;
+    bool isThreadSafe() const override { return true; }
 
 private:
+    mutable std::mutex cacheMutex;
     mutable Eigen::Quaterniond lastSpin;
     mutable Eigen::Quaterniond lastEquator;
     mutable Eigen::Vector3d lastAngularVelocity;
@@ -124,6 +144,7 @@ class ConstantOrientation : public RotationModel
 
     double getPeriod() const override { return 0.0; }
     bool isPeriodic() const override { return false; }
+    bool isThreadSafe() const override { return true; }
 
     static std::shared_ptr<const RotationModel> identity();
 
@@ -150,6 +171,7 @@ class UniformRotationModel : public RotationModel
     Eigen::Quaterniond equatorOrientationAtTime(double tjd) const override;
     Eigen::Quaterniond spin(double tjd) const override;
     Eigen::Vector3d angularVelocityAtTime(double tjd) const override;
+    bool isThreadSafe() const override { return true; }
 
  private:
     double period;       // sidereal rotation period
@@ -178,6 +200,7 @@ class PrecessingRotationModel : public RotationModel
     double getPeriod() const override;
     Eigen::Quaterniond equatorOrientationAtTime(double tjd) const override;
     Eigen::Quaterniond spin(double tjd) const override;
+    bool isThreadSafe() const override { return true; }
 
  private:
     double period;       // sidereal rotation period (in Julian days)
@@ -15,7 +15,6 @@
 
 #include "sampfile.h"
 
-#include <algorithm>
 #include <cctype>
 
 #include <celutil/gettext.h>
@@ -116,23 +115,62 @@ bool skipComments(std::istream& in)
 
 } // end namespace celestia::ephem::detail
 
-// Do a binary search to find the samples that define the orientation
-// at the current time. Cache the previous sample used and avoid
-// the search if it covers the requested time.
+SampleTimeIndex::SampleTimeIndex(celestia::util::array_view<double> sampleTimes) :
+    SampleTimeIndex(static_cast<std::uint32_t>(sampleTimes.size()),
+                    [sampleTimes](std::uint32_t i) { return sampleTimes[i]; })
+{
+}
+
+
+namespace
+{
+
+// Fill the nodes of the subtree at node with keys in sorted order
+void
+fillEytzinger(const std::vector<double>& keys,
+              std::uint32_t& next,
+              std::uint32_t node,
+              std::vector<double>& tree,
+              std::vector<std::uint32_t>& blocks)
+{
+    if (node >= tree.size())
+        return;
+
+    fillEytzinger(keys, next, 2 * node, tree, blocks);
+    tree[node] = keys[next];
+    blocks[node] = next;
+    ++next;
+    fillEytzinger(keys, next, 2 * node + 1, tree, blocks);
+}
+
+} // end unnamed namespace
+
+
+void
+SampleTimeIndex::build(std::vector<double>&& keys)
+{
+    // Short files are searched directly
+    if (keys.size() < 2)
+        return;
+
+    tree.resize(keys.size() + 1);
+    blocks.resize(keys.size() + 1);
+    std::uint32_t next = 0;
+    fillEytzinger(keys, next, 1, tree, blocks);
+}
+
+
+// Find the samples that define the position or orientation at the current
+// time. Cache the previous sample used and avoid the search if it or the
+// following one covers the requested time.
 std::uint32_t
 GetSampleIndex(double jd,
                std::uint32_t& lastSample,
-               celestia::util::array_view<double> sampleTimes)
+               celestia::util::array_view<double> sampleTimes,
+               const SampleTimeIndex& index)
 {
-    std::uint32_t n = lastSample;
-    if (n < 1 || n >= sampleTimes.size() || jd < sampleTimes[n - 1] || jd > sampleTimes[n])
-    {
-        auto iter = std::lower_bound(sampleTimes.begin(), sampleTimes.end(), jd);
-        n = static_cast<std::uint32_t>(iter - sampleTimes.begin());
-        lastSample = n;
-    }
-
-    return n;
+    return detail::findSample(jd, lastSample, static_cast<std::uint32_t>(sampleTimes.size()), index,
+                              [sampleTimes](std::uint32_t i) { return sampleTimes[i]; });
 }
 
 } // end namespace celestia::ephem
@@ -15,6 +15,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <fstream>
 #include <istream>
@@ -46,9 +47,141 @@ bool skipComments(std::istream& in);
 }
 
 
+/*! Search structure over the times of a trajectory or orientation file.
+ *  Every BlockSize-th time is kept in Eytzinger (breadth-first) order, so
+ *  that the first levels of the search share cache lines, and the descent
+ *  has no unpredictable branches. A branch-free binary search within the
+ *  block found completes the lookup.
+ */
+class SampleTimeIndex
+{
+public:
+    SampleTimeIndex() = default;
+    explicit SampleTimeIndex(celestia::util::array_view<double> sampleTimes);
+
+    // time(i) returns the time of sample i
+    template<typename F>
+    SampleTimeIndex(std::uint32_t count, F time);
+
+    // Return the index of the first of count samples with a time not less
+    // than jd, or count if there is none.
+    template<typename F>
+    std::uint32_t lowerBound(double jd, std::uint32_t count, F time) const;
+
+    std::size_t memoryUsage() const
+    {
+        return tree.capacity() * sizeof(double) + blocks.capacity() * sizeof(std::uint32_t);
+    }
+
+private:
+    static constexpr std::uint32_t BlockSize = 16;
+
+    void build(std::vector<double>&& keys);
+
+    // Nodes are 1-based, entry 0 is unused
+    std::vector<double> tree;
+    std::vector<std::uint32_t> blocks;
+};
+
+
+template<typename F>
+SampleTimeIndex::SampleTimeIndex(std::uint32_t count, F time)
+{
+    std::vector<double> keys;
+    keys.reserve((count + BlockSize - 1) / BlockSize);
+    for (std::uint32_t i = 0; i < count; i += BlockSize)
+        keys.push_back(time(i));
+    build(std::move(keys));
+}
+
+
+template<typename F>
+std::uint32_t
+SampleTimeIndex::lowerBound(double jd, std::uint32_t count, F time) const
+{
+    std::uint32_t first = 0;
+    std::uint32_t n = count;
+    if (auto nNodes = static_cast<std::uint32_t>(tree.size()); nNodes > 1)
+    {
+        // Find the first block starting at or after jd
+        std::uint32_t node = 1;
+        std::uint32_t found = 0;
+        while (node < nNodes)
+        {
+            bool less = tree[node] < jd;
+            found = less ? found : node;
+            node = 2 * node + static_cast<std::uint32_t>(less);
+        }
+
+        if (found == 0)
+        {
+            // After the start of the last block
+            first = (nNodes - 2) * BlockSize + 1;
+            n = count - first;
+        }
+        else if (std::uint32_t block = blocks[found]; block == 0)
+        {
+            return 0;
+        }
+        else
+        {
+            // Between the starts of the previous block and this one
+            first = (block - 1) * BlockSize + 1;
+            n = BlockSize - 1;
+        }
+    }
+
+    if (n == 0)
+        return first;
+
+    while (n > 1)
+    {
+        std::uint32_t half = n / 2;
+        first = time(first + half) < jd ? first + half : first;
+        n -= half;
+    }
+
+    return first + static_cast<std::uint32_t>(time(first) < jd);
+}
+
+
+namespace detail
+{
+
+template<typename F>
+std::uint32_t
+findSample(double jd,
+           std::uint32_t& lastSample,
+           std::uint32_t count,
+           const SampleTimeIndex& index,
+           F time)
+{
+    // Time usually moves forward by less than one sample per frame, so try
+    // the next span before searching
+    std::uint32_t n = lastSample;
+    if (n >= 1 && n < count && jd >= time(n - 1))
+    {
+        if (jd <= time(n))
+            return n;
+        if (n + 1 < count && jd <= time(n + 1))
+        {
+            lastSample = n + 1;
+            return n + 1;
+        }
+    }
+
+    n = index.lowerBound(jd, count, time);
+    lastSample = n;
+    return n;
+}
+
+}
+
+
 std::uint32_t GetSampleIndex(double jd,
                              std::uint32_t& lastSample,
-                             celestia::util::array_view<double> sampleTimes);
+                             celestia::util::array_view<double> sampleTimes,
+                             const SampleTimeIndex& index);
 
 
 template<typename T, typename F>
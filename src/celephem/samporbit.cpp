@@ -14,11 +14,16 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <fstream>
 #include <istream>
+#include <limits>
+#include <mutex>
+#include <numeric>
 #include <string_view>
 #include <type_traits>
 #include <unordered_map>
@@ -34,6 +39,7 @@
 #include <celutil/fsutils.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/mappedfile.h>
 #include "orbit.h"
 #include "sampfile.h"
 #include "xyzvbinary.h"
@@ -60,12 +66,20 @@ struct Samples
 {
     Samples(std::vector<double>&& _times, std::vector<T>&& _samples) :
         times(std::move(_times)),
-        samples(std::move(_samples))
+        samples(std::move(_samples)),
+        index(times)
     {
     }
 
+    std::size_t memoryUsage() const
+    {
+        return sizeof(*this) + times.capacity() * sizeof(double) + samples.capacity() * sizeof(T) +
+               index.memoryUsage();
+    }
+
     std::vector<double> times;
     std::vector<T> samples;
+    SampleTimeIndex index;
 };
 
 struct InterpolationParameters
@@ -104,11 +118,252 @@ cubicInterpolateVelocity(const InterpolationParameters& params)
 template<typename T>
 using SampleXYZ = Eigen::Matrix<T, 3, 1>;
 
+// Accessors of samples loaded into memory for SampledOrbit
 template<typename T>
+class LoadedSamplesXYZ : public Samples<SampleXYZ<T>>
+{
+public:
+    using Samples<SampleXYZ<T>>::Samples;
+
+    static constexpr bool IsThreadSafe = true;
+
+    std::uint32_t size() const { return static_cast<std::uint32_t>(this->times.size()); }
+    double time(std::uint32_t i) const { return this->times[i]; }
+    Eigen::Vector3d position(std::uint32_t i) const { return this->samples[i].template cast<double>(); }
+
+    std::uint32_t findSample(double jd, std::uint32_t& lastSample) const
+    {
+        return GetSampleIndex(jd, lastSample, this->times, this->index);
+    }
+};
+
+// Times are quantized to the resolution of a double around JD 2451545
+constexpr double TimeQuantum = 1.0 / 2147483648.0;
+
+// Extrapolate the time of sample k of a block from the previous ones
+inline double
+predictTime(const double* times, std::uint32_t k)
+{
+    return k == 1 ? times[0] : times[k - 1] + (times[k - 1] - times[k - 2]);
+}
+
+// Extrapolate the position of sample k of a block with the polynomial
+// through up to four previous samples
+inline Eigen::Vector3d
+predictPosition(const double* times, const Eigen::Vector3d* positions, std::uint32_t k)
+{
+    constexpr std::uint32_t MaxPoints = 4;
+
+    std::uint32_t first = k > MaxPoints ? k - MaxPoints : 0;
+    Eigen::Vector3d predicted = Eigen::Vector3d::Zero();
+    for (std::uint32_t i = first; i < k; ++i)
+    {
+        double weight = 1.0;
+        for (std::uint32_t j = first; j < k; ++j)
+        {
+            if (j != i)
+                weight *= (times[k] - times[j]) / (times[i] - times[j]);
+        }
+
+        predicted += weight * positions[i];
+    }
+
+    return predicted;
+}
+
+// Round x to an integer, fails if it doesn't fit comfortably in 64 bits
+inline bool
+quantize(double x, std::int64_t& result)
+{
+    constexpr double Limit = 4.0e18;
+    if (!(std::abs(x) < Limit))
+        return false;
+
+    result = std::llround(x);
+    return true;
+}
+
+void
+writeVarint(std::vector<std::uint8_t>& data, std::int64_t value)
+{
+    // Zigzag coding keeps small negative values short
+    auto u = (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    while (u >= 0x80)
+    {
+        data.push_back(static_cast<std::uint8_t>(u | 0x80));
+        u >>= 7;
+    }
+    data.push_back(static_cast<std::uint8_t>(u));
+}
+
+std::int64_t
+readVarint(const std::uint8_t*& ptr)
+{
+    std::uint64_t u = 0;
+    for (int shift = 0;; shift += 7)
+    {
+        std::uint8_t b = *ptr++;
+        u |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+            break;
+    }
+
+    return static_cast<std::int64_t>(u >> 1) ^ -static_cast<std::int64_t>(u & 1);
+}
+
+// Positions of an xyz file coded in blocks. The first sample of a block is
+// stored as is, the others as the difference from their extrapolation from
+// the previous samples, quantized so that positions stay within tolerance
+// of the file. Times are coded the same way in units of TimeQuantum.
+//
+// Blocks are decoded on demand into a cache of two, enough for the four
+// samples used by cubic interpolation. Like the orbits using them, the
+// samples must only be used from one thread.
+class CompressedSamplesXYZ
+{
+public:
+    // Return nullptr if the samples can't be coded with this tolerance
+    static std::shared_ptr<const CompressedSamplesXYZ> create(const Samples<SampleXYZ<double>>&,
+                                                              double tolerance);
+
+    // The decoded blocks are cached
+    static constexpr bool IsThreadSafe = false;
+
+    std::uint32_t size() const { return count; }
+    std::size_t memoryUsage() const
+    {
+        return sizeof(*this) + blocks.capacity() * sizeof(Block) + data.capacity() + index.memoryUsage();
+    }
+    double getTolerance() const { return tolerance; }
+    double time(std::uint32_t i) const { return getBlock(i).times[i % BlockSize]; }
+    Eigen::Vector3d position(std::uint32_t i) const { return getBlock(i).positions[i % BlockSize]; }
+
+    std::uint32_t findSample(double jd, std::uint32_t& lastSample) const
+    {
+        return detail::findSample(jd, lastSample, count, index,
+                                  [this](std::uint32_t i) { return time(i); });
+    }
+
+private:
+    static constexpr std::uint32_t BlockSize = 32;
+
+    struct Block
+    {
+        double t0;
+        Eigen::Vector3d p0;
+        std::uint32_t offset;
+    };
+
+    struct DecodedBlock
+    {
+        std::uint32_t block{ std::numeric_limits<std::uint32_t>::max() };
+        std::array<double, BlockSize> times;
+        std::array<Eigen::Vector3d, BlockSize> positions;
+    };
+
+    CompressedSamplesXYZ() = default;
+
+    const DecodedBlock& getBlock(std::uint32_t i) const;
+
+    std::vector<Block> blocks;
+    std::vector<std::uint8_t> data;
+    SampleTimeIndex index;
+    std::uint32_t count{ 0 };
+    double tolerance{ 0.0 };
+    double quantum{ 0.0 };
+
+    mutable std::array<DecodedBlock, 2> cache;
+};
+
+std::shared_ptr<const CompressedSamplesXYZ>
+CompressedSamplesXYZ::create(const Samples<SampleXYZ<double>>& samples, double tolerance)
+{
+    std::size_t nSamples = samples.times.size();
+    if (nSamples == 0 || nSamples > std::numeric_limits<std::uint32_t>::max() || !(tolerance > 0.0))
+        return nullptr;
+
+    std::shared_ptr<CompressedSamplesXYZ> compressed{ new CompressedSamplesXYZ };
+    compressed->count = static_cast<std::uint32_t>(nSamples);
+    compressed->tolerance = tolerance;
+    // Rounding each coordinate to half a quantum keeps the distance within
+    // the tolerance
+    compressed->quantum = 2.0 * tolerance / std::sqrt(3.0);
+
+    compressed->blocks.reserve((nSamples + BlockSize - 1) / BlockSize);
+    std::array<double, BlockSize> times;
+    std::array<Eigen::Vector3d, BlockSize> positions;
+    for (std::size_t first = 0; first < nSamples; first += BlockSize)
+    {
+        times[0] = samples.times[first];
+        positions[0] = samples.samples[first];
+        auto offset = static_cast<std::uint32_t>(compressed->data.size());
+        compressed->blocks.push_back(Block{ times[0], positions[0], offset });
+
+        auto blockSize = static_cast<std::uint32_t>(std::min(std::size_t(BlockSize), nSamples - first));
+        for (std::uint32_t k = 1; k < blockSize; ++k)
+        {
+            // Code the values as they will be decoded, so that errors don't
+            // accumulate along the block
+            std::int64_t r;
+            double tPredicted = predictTime(times.data(), k);
+            if (!quantize((samples.times[first + k] - tPredicted) / TimeQuantum, r))
+                return nullptr;
+            times[k] = tPredicted + static_cast<double>(r) * TimeQuantum;
+            if (!(times[k] > times[k - 1]))
+                return nullptr;
+            writeVarint(compressed->data, r);
+
+            Eigen::Vector3d predicted = predictPosition(times.data(), positions.data(), k);
+            for (int c = 0; c < 3; ++c)
+            {
+                if (!quantize((samples.samples[first + k][c] - predicted[c]) / compressed->quantum, r))
+                    return nullptr;
+                positions[k][c] = predicted[c] + static_cast<double>(r) * compressed->quantum;
+                writeVarint(compressed->data, r);
+            }
+        }
+    }
+
+    compressed->data.shrink_to_fit();
+    compressed->index = SampleTimeIndex(compressed->count,
+                                        [&compressed](std::uint32_t i) { return compressed->time(i); });
+    return compressed;
+}
+
+const CompressedSamplesXYZ::DecodedBlock&
+CompressedSamplesXYZ::getBlock(std::uint32_t i) const
+{
+    std::uint32_t block = i / BlockSize;
+    // Neighbouring blocks go to different entries
+    DecodedBlock& decoded = cache[block & 1];
+    if (decoded.block == block)
+        return decoded;
+
+    const Block& header = blocks[block];
+    decoded.block = block;
+    decoded.times[0] = header.t0;
+    decoded.positions[0] = header.p0;
+
+    const std::uint8_t* ptr = data.data() + header.offset;
+    std::uint32_t blockSize = std::min(BlockSize, count - block * BlockSize);
+    for (std::uint32_t k = 1; k < blockSize; ++k)
+    {
+        decoded.times[k] = predictTime(decoded.times.data(), k) +
+                           static_cast<double>(readVarint(ptr)) * TimeQuantum;
+
+        Eigen::Vector3d predicted = predictPosition(decoded.times.data(), decoded.positions.data(), k);
+        for (int c = 0; c < 3; ++c)
+            decoded.positions[k][c] = predicted[c] + static_cast<double>(readVarint(ptr)) * quantum;
+    }
+
+    return decoded;
+}
+
+template<typename S>
 class SampledOrbit : public CachingOrbit
 {
 public:
-    SampledOrbit(TrajectoryInterpolation, const std::shared_ptr<const Samples<SampleXYZ<T>>>&);
+    SampledOrbit(TrajectoryInterpolation, const std::shared_ptr<const S>&);
     ~SampledOrbit() override = default;
 
     double getPeriod() const override;
@@ -120,13 +375,14 @@ public:
     void getValidRange(double& begin, double& end) const override;
 
     void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+    bool isThreadSafe() const override { return S::IsThreadSafe; }
 
 private:
-    std::shared_ptr<const Samples<SampleXYZ<T>>> samples;
-    util::array_view<double> sampleTimes;
-    util::array_view<SampleXYZ<T>> positions;
-    double boundingRadius;
-    mutable std::uint32_t lastSample{ 0 };
+    std::uint32_t findSample(double jd) const;
+
+    std::shared_ptr<const S> samples;
+    double boundingRadius{ 0.0 };
+    mutable std::atomic<std::uint32_t> lastSample{ 0 };
 
     TrajectoryInterpolation interpolation;
 
@@ -138,107 +394,118 @@ private:
     void initializeCubic(double, std::uint32_t, std::uint32_t, InterpolationParameters&) const;
 };
 
-template<typename T>
-SampledOrbit<T>::SampledOrbit(TrajectoryInterpolation _interpolation,
-                              const std::shared_ptr<const Samples<SampleXYZ<T>>>& _samples) :
+template<typename S>
+SampledOrbit<S>::SampledOrbit(TrajectoryInterpolation _interpolation,
+                              const std::shared_ptr<const S>& _samples) :
     samples(_samples),
-    sampleTimes(_samples->times),
-    positions(_samples->samples),
     interpolation(_interpolation)
 {
-    assert(!sampleTimes.empty() && sampleTimes.size() == positions.size());
+    assert(samples->size() > 0);
 
-    auto it = std::max_element(positions.begin(), positions.end(),
-                               [](const auto& a, const auto& b) { return a.squaredNorm() < b.squaredNorm(); });
-    boundingRadius = it->template cast<double>().norm();
+    double maxSquaredNorm = 0.0;
+    for (std::uint32_t i = 0; i < samples->size(); ++i)
+        maxSquaredNorm = std::max(maxSquaredNorm, samples->position(i).squaredNorm());
+    boundingRadius = std::sqrt(maxSquaredNorm);
 }
 
-template<typename T>
+// The last sample is only a hint for the search, so threads overwriting each
+// other's value only cost a longer search
+template<typename S>
+std::uint32_t
+SampledOrbit<S>::findSample(double jd) const
+{
+    std::uint32_t hint = lastSample.load(std::memory_order_relaxed);
+    std::uint32_t n = samples->findSample(jd, hint);
+    lastSample.store(hint, std::memory_order_relaxed);
+    return n;
+}
+
+template<typename S>
 double
-SampledOrbit<T>::getPeriod() const
+SampledOrbit<S>::getPeriod() const
 {
-    return sampleTimes.back() - sampleTimes.front();
+    return samples->time(samples->size() - 1) - samples->time(0);
 }
 
-template<typename T>
+template<typename S>
 bool
-SampledOrbit<T>::isPeriodic() const
+SampledOrbit<S>::isPeriodic() const
 {
     return false;
 }
 
-template<typename T>
+template<typename S>
 void
-SampledOrbit<T>::getValidRange(double& begin, double& end) const
+SampledOrbit<S>::getValidRange(double& begin, double& end) const
 {
-    begin = sampleTimes.front();
-    end = sampleTimes.back();
+    begin = samples->time(0);
+    end = samples->time(samples->size() - 1);
 }
 
-template<typename T>
+template<typename S>
 double
-SampledOrbit<T>::getBoundingRadius() const
+SampledOrbit<S>::getBoundingRadius() const
 {
     return boundingRadius;
 }
 
-template<typename T>
+template<typename S>
 Eigen::Vector3d
-SampledOrbit<T>::computePosition(double jd) const
+SampledOrbit<S>::computePosition(double jd) const
 {
-    if (sampleTimes.size() == 1)
-        return positions.front().template cast<double>();
+    if (samples->size() == 1)
+        return samples->position(0);
 
-    std::uint32_t n = GetSampleIndex(jd, lastSample, sampleTimes);
+    std::uint32_t n = findSample(jd);
     if (n == 0)
-        return positions.front().template cast<double>();
-    if (n == sampleTimes.size())
-        return positions.back().template cast<double>();
+        return samples->position(0);
+    if (n == samples->size())
+        return samples->position(samples->size() - 1);
 
     switch (interpolation)
     {
     case TrajectoryInterpolation::Linear:
         return computePositionLinear(jd, n);
     case TrajectoryInterpolation::Cubic:
-        return computePositionCubic(jd, n, static_cast<std::uint32_t>(sampleTimes.size() - 1));
+        return computePositionCubic(jd, n, static_cast<std::uint32_t>(samples->size() - 1));
     default: // Unknown interpolation type
         assert(0);
         return Eigen::Vector3d::Zero();
     }
 }
 
-template<typename T>
+template<typename S>
 Eigen::Vector3d
-SampledOrbit<T>::computePositionLinear(double jd, std::uint32_t n) const
+SampledOrbit<S>::computePositionLinear(double jd, std::uint32_t n) const
 {
     assert(n > 0);
-    double t = (jd - sampleTimes[n - 1]) / (sampleTimes[n] - sampleTimes[n - 1]);
+    double t = (jd - samples->time(n - 1)) / (samples->time(n) - samples->time(n - 1));
 
-    const Eigen::Matrix<T, 3, 1>& s0 = positions[n - 1];
-    const Eigen::Matrix<T, 3, 1>& s1 = positions[n];
-    return Eigen::Vector3d(math::lerp(t, static_cast<double>(s0.x()), static_cast<double>(s1.x())),
-                           math::lerp(t, static_cast<double>(s0.y()), static_cast<double>(s1.y())),
-                           math::lerp(t, static_cast<double>(s0.z()), static_cast<double>(s1.z())));
+    Eigen::Vector3d s0 = samples->position(n - 1);
+    Eigen::Vector3d s1 = samples->position(n);
+    return Eigen::Vector3d(math::lerp(t, s0.x(), s1.x()),
+                           math::lerp(t, s0.y(), s1.y()),
+                           math::lerp(t, s0.z(), s1.z()));
 }
 
-template<typename T>
+template<typename S>
 Eigen::Vector3d
-SampledOrbit<T>::computePositionCubic(double jd, std::uint32_t n2, std::uint32_t nMax) const
+SampledOrbit<S>::computePositionCubic(double jd, std::uint32_t n2, std::uint32_t nMax) const
 {
     InterpolationParameters params;
     initializeCubic(jd, n2, nMax, params);
     return cubicInterpolate(params);
 }
 
-template<typename T>
+template<typename S>
 Eigen::Vector3d
-SampledOrbit<T>::computeVelocity(double jd) const
+SampledOrbit<S>::computeVelocity(double jd) const
 {
-    if (sampleTimes.size() < 2)
+    if (samples->size() < 2)
         return Eigen::Vector3d::Zero();
 
-    std::uint32_t n = GetSampleIndex(jd, lastSample, sampleTimes);
-    if (n == 0 || n == sampleTimes.size())
+    std::uint32_t n = findSample(jd);
+    if (n == 0 || n == samples->size())
         return Eigen::Vector3d::Zero();
 
     switch (interpolation)
@@ -246,34 +513,34 @@ SampledOrbit<T>::computeVelocity(double jd) const
     case TrajectoryInterpolation::Linear:
         return computeVelocityLinear(n);
     case TrajectoryInterpolation::Cubic:
-        return computeVelocityCubic(jd, n, static_cast<std::uint32_t>(sampleTimes.size() - 1));
+        return computeVelocityCubic(jd, n, static_cast<std::uint32_t>(samples->size() - 1));
     default: // Unknown interpolation type
         assert(0);
         return Eigen::Vector3d::Zero();
     }
 }
 
-template<typename T>
+template<typename S>
 Eigen::Vector3d
-SampledOrbit<T>::computeVelocityLinear(std::uint32_t n) const
+SampledOrbit<S>::computeVelocityLinear(std::uint32_t n) const
 {
     assert(n > 0);
-    double dtRecip = 1.0 / (sampleTimes[n] - sampleTimes[n - 1]);
-    return (positions[n].template cast<double>() - positions[n - 1].template cast<double>()) * dtRecip;
+    double dtRecip = 1.0 / (samples->time(n) - samples->time(n - 1));
+    return (samples->position(n) - samples->position(n - 1)) * dtRecip;
 }
 
-template<typename T>
+template<typename S>
 Eigen::Vector3d
-SampledOrbit<T>::computeVelocityCubic(double jd, std::uint32_t n2, std::uint32_t nMax) const
+SampledOrbit<S>::computeVelocityCubic(double jd, std::uint32_t n2, std::uint32_t nMax) const
 {
     InterpolationParameters params;
     initializeCubic(jd, n2, nMax, params);
     return cubicInterpolateVelocity(params);
 }
 
-template<typename T>
+template<typename S>
 void
-SampledOrbit<T>::initializeCubic(double jd,
+SampledOrbit<S>::initializeCubic(double jd,
                                  std::uint32_t n2,
                                  std::uint32_t nMax,
                                  InterpolationParameters& params) const
@@ -283,60 +550,60 @@ SampledOrbit<T>::initializeCubic(double jd,
     std::uint32_t n1 = n2 - 1;
     std::uint32_t n3 = std::min(n2 + 1, nMax);
 
-    double h = sampleTimes[n2] - sampleTimes[n1];
+    double h = samples->time(n2) - samples->time(n1);
     params.ih = 1.0 / h;
-    params.t = (jd - sampleTimes[n1]) * params.ih;
-    params.p0 = positions[n1].template cast<double>();
-    params.p1 = positions[n2].template cast<double>();
+    params.t = (jd - samples->time(n1)) * params.ih;
+    params.p0 = samples->position(n1);
+    params.p1 = samples->position(n2);
 
-    Eigen::Vector3d v10 = params.p0 - positions[n0].template cast<double>();
+    Eigen::Vector3d v10 = params.p0 - samples->position(n0);
     Eigen::Vector3d v21 = params.p1 - params.p0;
-    Eigen::Vector3d v32 = positions[n3].template cast<double>() - params.p1;
+    Eigen::Vector3d v32 = samples->position(n3) - params.p1;
 
     // Estimate velocities by averaging the differences at adjacent spans
     // (except at the end spans, where we just use a single velocity.)
     params.v0 = n2 > 1
-        ? (v10 * (0.5 / (sampleTimes[n1] - sampleTimes[n0])) + v21 * (0.5 * params.ih)) * h
+        ? (v10 * (0.5 / (samples->time(n1) - samples->time(n0))) + v21 * (0.5 * params.ih)) * h
         : v21;
 
     params.v1 = n2 < nMax
-        ? (v21 * (0.5 * params.ih) + v32 * (0.5 / (sampleTimes[n3] - sampleTimes[n2]))) * h
+        ? (v21 * (0.5 * params.ih) + v32 * (0.5 / (samples->time(n3) - samples->time(n2)))) * h
         : v21;
 }
 
-template<typename T>
-void SampledOrbit<T>::sample(double /* startTime */, double /* endTime */,
+template<typename S>
+void SampledOrbit<S>::sample(double /* startTime */, double /* endTime */,
                              OrbitSampleProc& proc) const
 {
-    for (std::uint32_t i = 0; i < sampleTimes.size(); ++i)
+    for (std::uint32_t i = 0; i < samples->size(); ++i)
     {
         Eigen::Vector3d v;
-        Eigen::Vector3d p = positions[i].template cast<double>();
+        Eigen::Vector3d p = samples->position(i);
 
-        if (sampleTimes.size() == 1)
+        if (samples->size() == 1)
         {
             v = Eigen::Vector3d::Zero();
         }
         else if (i == 0)
         {
-            double dtRecip = 1.0 / (sampleTimes[i + 1] - sampleTimes[i]);
-            v = (positions[i + 1].template cast<double>() - p) * dtRecip;
+            double dtRecip = 1.0 / (samples->time(i + 1) - samples->time(i));
+            v = (samples->position(i + 1) - p) * dtRecip;
         }
-        else if (i == sampleTimes.size() - 1)
+        else if (i == samples->size() - 1)
         {
-            double dtRecip = 1.0 / (sampleTimes[i] - sampleTimes[i - 1]);
-            v = (p - positions[i - 1].template cast<double>()) * dtRecip;
+            double dtRecip = 1.0 / (samples->time(i) - samples->time(i - 1));
+            v = (p - samples->position(i - 1)) * dtRecip;
         }
         else
         {
-            double dt0Recip = 1.0 / (sampleTimes[i + 1] - sampleTimes[i]);
-            Eigen::Vector3d v0 = (positions[i + 1].template cast<double>() - p) * dt0Recip;
-            double dt1Recip = 1.0 / (sampleTimes[i] - sampleTimes[i - 1]);
-            Eigen::Vector3d v1 = (p - positions[i - 1].template cast<double>()) * dt1Recip;
+            double dt0Recip = 1.0 / (samples->time(i + 1) - samples->time(i));
+            Eigen::Vector3d v0 = (samples->position(i + 1) - p) * dt0Recip;
+            double dt1Recip = 1.0 / (samples->time(i) - samples->time(i - 1));
+            Eigen::Vector3d v1 = (p - samples->position(i - 1)) * dt1Recip;
             v = (v0 + v1) * 0.5;
         }
 
-        proc.sample(sampleTimes[i], p, v);
+        proc.sample(samples->time(i), p, v);
     }
 }
 
@@ -347,13 +614,108 @@ struct SampleXYZV
     Eigen::Matrix<T, 3, 1> velocity;
 };
 
-// Sampled orbit with positions and velocities
+// Accessors of samples loaded into memory for SampledOrbitXYZV
 template<typename T>
+class LoadedSamplesXYZV : public Samples<SampleXYZV<T>>
+{
+public:
+    using Samples<SampleXYZV<T>>::Samples;
+
+    std::uint32_t size() const { return static_cast<std::uint32_t>(this->times.size()); }
+    double time(std::uint32_t i) const { return this->times[i]; }
+    Eigen::Vector3d position(std::uint32_t i) const { return this->samples[i].position.template cast<double>(); }
+    Eigen::Vector3d velocity(std::uint32_t i) const { return this->samples[i].velocity.template cast<double>(); }
+
+    std::uint32_t findSample(double jd, std::uint32_t& lastSample) const
+    {
+        return GetSampleIndex(jd, lastSample, this->times, this->index);
+    }
+};
+
+// Samples of a binary xyzv file, used in place from a memory mapping. The
+// records keep the layout of XYZVBinaryData and are converted to Celestia
+// coordinates and units as they are read.
+class MappedSamplesXYZV
+{
+public:
+    static std::shared_ptr<const MappedSamplesXYZV> load(const fs::path&);
+
+    std::uint32_t size() const { return count; }
+    // The mapped records are not counted, the system pages them in and out
+    std::size_t memoryUsage() const
+    {
+        return sizeof(*this) + kept.capacity() * sizeof(std::uint32_t) + index.memoryUsage();
+    }
+    double time(std::uint32_t i) const;
+    Eigen::Vector3d position(std::uint32_t i) const;
+    Eigen::Vector3d velocity(std::uint32_t i) const;
+
+    std::uint32_t findSample(double jd, std::uint32_t& lastSample) const;
+
+private:
+    const char* record(std::uint32_t i) const;
+    Eigen::Vector3d readVector(std::uint32_t i, std::size_t offset) const;
+
+    std::unique_ptr<util::MappedFile> file;
+    const char* records{ nullptr };
+    std::uint32_t count{ 0 };
+    // Records left after skipping out-of-order samples, stays empty if the
+    // times in the file are strictly increasing
+    std::vector<std::uint32_t> kept;
+    SampleTimeIndex index;
+};
+
+inline const char*
+MappedSamplesXYZV::record(std::uint32_t i) const
+{
+    std::size_t n = kept.empty() ? i : kept[i];
+    return records + n * sizeof(XYZVBinaryData);
+}
+
+double
+MappedSamplesXYZV::time(std::uint32_t i) const
+{
+    double tdb;
+    std::memcpy(&tdb, record(i) + offsetof(XYZVBinaryData, tdb), sizeof(double));
+    return tdb;
+}
+
+Eigen::Vector3d
+MappedSamplesXYZV::readVector(std::uint32_t i, std::size_t offset) const
+{
+    Eigen::Vector3d v;
+    std::memcpy(v.data(), record(i) + offset, sizeof(double) * 3);
+    convertToCelestiaCoordinates(v);
+    return v;
+}
+
+Eigen::Vector3d
+MappedSamplesXYZV::position(std::uint32_t i) const
+{
+    return readVector(i, offsetof(XYZVBinaryData, position));
+}
+
+Eigen::Vector3d
+MappedSamplesXYZV::velocity(std::uint32_t i) const
+{
+    return readVector(i, offsetof(XYZVBinaryData, velocity)) * astro::daysToSecs(1.0);
+}
+
+std::uint32_t
+MappedSamplesXYZV::findSample(double jd, std::uint32_t& lastSample) const
+{
+    return detail::findSample(jd, lastSample, count, index,
+                              [this](std::uint32_t i) { return time(i); });
+}
+
+// Sampled orbit with positions and velocities, S is LoadedSamplesXYZV or
+// MappedSamplesXYZV
+template<typename S>
 class SampledOrbitXYZV : public CachingOrbit
 {
 public:
     SampledOrbitXYZV(TrajectoryInterpolation,
-                     const std::shared_ptr<const Samples<SampleXYZV<T>>>& samples);
+                     const std::shared_ptr<const S>& samples);
     ~SampledOrbitXYZV() override = default;
 
     double getPeriod() const override;
@@ -365,85 +727,92 @@ public:
     void getValidRange(double& begin, double& end) const override;
 
     void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+    bool isThreadSafe() const override { return true; }
 
 private:
+    std::uint32_t findSample(double jd) const;
     void initializeCubic(double, std::uint32_t, InterpolationParameters&) const;
 
-    std::shared_ptr<const Samples<SampleXYZV<T>>> samples;
-    util::array_view<double> sampleTimes;
-    util::array_view<SampleXYZV<T>> posvels;
-    double boundingRadius;
-    mutable std::uint32_t lastSample{ 0 };
+    std::shared_ptr<const S> samples;
+    double boundingRadius{ 0.0 };
+    mutable std::atomic<std::uint32_t> lastSample{ 0 };
 
     TrajectoryInterpolation interpolation;
 };
 
-template<typename T>
-SampledOrbitXYZV<T>::SampledOrbitXYZV(TrajectoryInterpolation _interpolation,
-                                      const std::shared_ptr<const Samples<SampleXYZV<T>>>& _samples) :
+template<typename S>
+SampledOrbitXYZV<S>::SampledOrbitXYZV(TrajectoryInterpolation _interpolation,
+                                      const std::shared_ptr<const S>& _samples) :
     samples(_samples),
-    sampleTimes(_samples->times),
-    posvels(_samples->samples),
     interpolation(_interpolation)
 {
-    assert(!sampleTimes.empty() && sampleTimes.size() == posvels.size());
+    assert(samples->size() > 0);
 
-    auto it = std::max_element(posvels.begin(), posvels.end(),
-                               [](const auto& a, const auto& b)
-                               {
-                                   return a.position.squaredNorm() < b.position.squaredNorm();
-                               });
-    boundingRadius = it->position.template cast<double>().norm();
+    double maxSquaredNorm = 0.0;
+    for (std::uint32_t i = 0; i < samples->size(); ++i)
+        maxSquaredNorm = std::max(maxSquaredNorm, samples->position(i).squaredNorm());
+    boundingRadius = std::sqrt(maxSquaredNorm);
 }
 
-template<typename T>
+template<typename S>
+std::uint32_t
+SampledOrbitXYZV<S>::findSample(double jd) const
+{
+    std::uint32_t hint = lastSample.load(std::memory_order_relaxed);
+    std::uint32_t n = samples->findSample(jd, hint);
+    lastSample.store(hint, std::memory_order_relaxed);
+    return n;
+}
+
+template<typename S>
 double
-SampledOrbitXYZV<T>::getPeriod() const
+SampledOrbitXYZV<S>::getPeriod() const
 {
-    return sampleTimes.back() - sampleTimes.front();
+    return samples->time(samples->size() - 1) - samples->time(0);
 }
 
-template<typename T>
+template<typename S>
 bool
-SampledOrbitXYZV<T>::isPeriodic() const
+SampledOrbitXYZV<S>::isPeriodic() const
 {
     return false;
 }
 
-template<typename T>
+template<typename S>
 void
-SampledOrbitXYZV<T>::getValidRange(double& begin, double& end) const
+SampledOrbitXYZV<S>::getValidRange(double& begin, double& end) const
 {
-    begin = sampleTimes.front();
-    end = sampleTimes.back();
+    begin = samples->time(0);
+    end = samples->time(samples->size() - 1);
 }
 
-template<typename T>
+template<typename S>
 double
-SampledOrbitXYZV<T>::getBoundingRadius() const
+SampledOrbitXYZV<S>::getBoundingRadius() const
 {
     return boundingRadius;
 }
 
-template<typename T>
+template<typename S>
 Eigen::Vector3d
-SampledOrbitXYZV<T>::computePosition(double jd) const
+SampledOrbitXYZV<S>::computePosition(double jd) const
 {
-    if (sampleTimes.size() == 1)
-        return posvels.front().position.template cast<double>();
+    std::uint32_t nSamples = samples->size();
+    if (nSamples == 1)
+        return samples->position(0);
 
-    std::uint32_t n = GetSampleIndex(jd, lastSample, sampleTimes);
+    std::uint32_t n = findSample(jd);
     if (n == 0)
-        return posvels.front().position.template cast<double>();
-    if (n == sampleTimes.size())
-        return posvels.back().position.template cast<double>();
+        return samples->position(0);
+    if (n == nSamples)
+        return samples->position(nSamples - 1);
 
     if (interpolation == TrajectoryInterpolation::Linear)
     {
-        double t = (jd - sampleTimes[n - 1]) / (sampleTimes[n] - sampleTimes[n - 1]);
+        double t = (jd - samples->time(n - 1)) / (samples->time(n) - samples->time(n - 1));
 
-        Eigen::Vector3d p0 = posvels[n - 1].position.template cast<double>();
-        Eigen::Vector3d p1 = posvels[n].position.template cast<double>();
+        Eigen::Vector3d p0 = samples->position(n - 1);
+        Eigen::Vector3d p1 = samples->position(n);
         return p0 + t * (p1 - p0);
     }
 
@@ -461,21 +830,22 @@ SampledOrbitXYZV<T>::computePosition(double jd) const
 
 // Velocity is computed as the derivative of the interpolating function
 // for position.
-template<typename T>
+template<typename S>
 Eigen::Vector3d
-SampledOrbitXYZV<T>::computeVelocity(double jd) const
+SampledOrbitXYZV<S>::computeVelocity(double jd) const
 {
-    if (sampleTimes.size() < 2)
+    std::uint32_t nSamples = samples->size();
+    if (nSamples < 2)
         return Eigen::Vector3d::Zero();
 
-    std::uint32_t n = GetSampleIndex(jd, lastSample, sampleTimes);
-    if (n == 0 || n == sampleTimes.size())
+    std::uint32_t n = findSample(jd);
+    if (n == 0 || n == nSamples)
         return Eigen::Vector3d::Zero();
 
     if (interpolation == TrajectoryInterpolation::Linear)
     {
-        double hRecip = 1.0 / (sampleTimes[n] - sampleTimes[n - 1]);
-        return (posvels[n].position.template cast<double>() - posvels[n - 1].position.template cast<double>()) *
+        double hRecip = 1.0 / (samples->time(n) - samples->time(n - 1));
+        return (samples->position(n) - samples->position(n - 1)) *
                 hRecip *
                 astro::daysToSecs(1.0);
     }
@@ -492,33 +862,30 @@ SampledOrbitXYZV<T>::computeVelocity(double jd) const
     return Eigen::Vector3d::Zero();
 }
 
-template<typename T>
+template<typename S>
 void
-SampledOrbitXYZV<T>::initializeCubic(double jd,
+SampledOrbitXYZV<S>::initializeCubic(double jd,
                                      std::uint32_t n,
                                      InterpolationParameters& params) const
 {
     assert(n > 0);
-    double h = sampleTimes[n] - sampleTimes[n - 1];
+    double t0 = samples->time(n - 1);
+    double h = samples->time(n) - t0;
     params.ih = 1.0 / h;
-    params.t = (jd - sampleTimes[n - 1]) * params.ih;
-    params.p0 = posvels[n - 1].position.template cast<double>();
-    params.v0 = posvels[n - 1].velocity.template cast<double>() * h;
-    params.p1 = posvels[n].position.template cast<double>();
-    params.v1 = posvels[n].velocity.template cast<double>() * h;
+    params.t = (jd - t0) * params.ih;
+    params.p0 = samples->position(n - 1);
+    params.v0 = samples->velocity(n - 1) * h;
+    params.p1 = samples->position(n);
+    params.v1 = samples->velocity(n) * h;
 }
 
-template<typename T>
+template<typename S>
 void
-SampledOrbitXYZV<T>::sample(double /* startTime */, double /* endTime */,
+SampledOrbitXYZV<S>::sample(double /* startTime */, double /* endTime */,
                             OrbitSampleProc& proc) const
 {
-    for (std::uint32_t i = 0; i < sampleTimes.size(); ++i)
-    {
-        proc.sample(sampleTimes[i],
-                    posvels[i].position.template cast<double>(),
-                    posvels[i].velocity.template cast<double>());
-    }
+    for (std::uint32_t i = 0; i < samples->size(); ++i)
+        proc.sample(samples->time(i), samples->position(i), samples->velocity(i));
 }
 
 template<typename T>
@@ -547,7 +914,7 @@ ReadAsciiSampleXYZ(std::istream& in, double& tdb, SampleXYZ<T>& sample)
 // with a #; data is read start fromt the first non-whitespace character outside
 // of a comment.
 template<typename T>
-std::shared_ptr<const Samples<SampleXYZ<T>>>
+std::shared_ptr<const LoadedSamplesXYZ<T>>
 LoadSamplesXYZAscii(const fs::path& filename)
 {
     std::vector<double> sampleTimes;
@@ -557,29 +924,20 @@ LoadSamplesXYZAscii(const fs::path& filename)
         return nullptr;
     }
 
-    return std::make_shared<Samples<SampleXYZ<T>>>(std::move(sampleTimes), std::move(samples));
+    return std::make_shared<LoadedSamplesXYZ<T>>(std::move(sampleTimes), std::move(samples));
 }
 
 bool
-ParseXYZVBinaryHeader(std::istream& in, const fs::path& filename)
+ParseXYZVBinaryHeader(const char* header, const fs::path& filename)
 {
-    std::array<char, sizeof(XYZVBinaryHeader)> header;
-
-    // Sonar detects this as being in a critical section for some reason
-    if (!in.read(header.data(), header.size())) /* Flawfinder: ignore */ //NOSONAR
-    {
-        GetLogger()->error(_("Error reading header of {}.\n"), filename);
-        return false;
-    }
-
-    if (std::string_view(header.data() + offsetof(XYZVBinaryHeader, magic), XYZV_MAGIC.size()) != XYZV_MAGIC)
+    if (std::string_view(header + offsetof(XYZVBinaryHeader, magic), XYZV_MAGIC.size()) != XYZV_MAGIC)
     {
         GetLogger()->error(_("Bad binary xyzv file {}.\n"), filename);
         return false;
     }
 
     decltype(XYZVBinaryHeader::byteOrder) byteOrder;
-    std::memcpy(&byteOrder, header.data() + offsetof(XYZVBinaryHeader, byteOrder), sizeof(byteOrder));
+    std::memcpy(&byteOrder, header + offsetof(XYZVBinaryHeader, byteOrder), sizeof(byteOrder));
     if (byteOrder != static_cast<decltype(byteOrder)>(celestia::compat::endian::native))
     {
         GetLogger()->error(_("Unsupported byte order {}, expected {} in {}.\n"),
@@ -588,7 +946,7 @@ ParseXYZVBinaryHeader(std::istream& in, const fs::path& filename)
     }
 
     decltype(XYZVBinaryHeader::digits) digits;
-    std::memcpy(&digits, header.data() + offsetof(XYZVBinaryHeader, digits), sizeof(digits));
+    std::memcpy(&digits, header + offsetof(XYZVBinaryHeader, digits), sizeof(digits));
     if (digits != std::numeric_limits<double>::digits)
     {
         GetLogger()->error(_("Unsupported digits number {}, expected {} in {}.\n"),
@@ -597,7 +955,7 @@ ParseXYZVBinaryHeader(std::istream& in, const fs::path& filename)
     }
 
     decltype(XYZVBinaryHeader::count) count;
-    std::memcpy(&count, header.data() + offsetof(XYZVBinaryHeader, count), sizeof(count));
+    std::memcpy(&count, header + offsetof(XYZVBinaryHeader, count), sizeof(count));
     if (count == 0)
     {
         GetLogger()->error(_("Invalid record count {} in {}.\n"), count, filename);
@@ -607,68 +965,73 @@ ParseXYZVBinaryHeader(std::istream& in, const fs::path& filename)
     return true;
 }
 
-template<typename T>
-bool
-ReadXYZVBinarySample(std::istream& in, double& tdb, SampleXYZV<T>& sample)
+/* Map a binary xyzv sampled trajectory file.
+ */
+std::shared_ptr<const MappedSamplesXYZV>
+MappedSamplesXYZV::load(const fs::path& filename)
 {
-    std::array<char, sizeof(XYZVBinaryData)> data;
-    if (!in.read(data.data(), data.size())) /* Flawfinder: ignore */
-        return false;
-
-    std::memcpy(&tdb, data.data() + offsetof(XYZVBinaryData, tdb), sizeof(double));
-
-    if constexpr (std::is_same_v<T, double>)
+    auto file = util::MappedFile::open(filename);
+    if (file == nullptr)
     {
-        std::memcpy(sample.position.data(), data.data() + offsetof(XYZVBinaryData, position), sizeof(double) * 3);
-        std::memcpy(sample.velocity.data(), data.data() + offsetof(XYZVBinaryData, velocity), sizeof(double) * 3);
-
-        sample.velocity *= astro::daysToSecs(1.0);
+        GetLogger()->error(_("Error opening binary sample file {}.\n"), filename);
+        return nullptr;
     }
-    else
-    {
-        Eigen::Vector3d position;
-        Eigen::Vector3d velocity;
 
-        std::memcpy(position.data(), data.data() + offsetof(XYZVBinaryData, position), sizeof(double) * 3);
-        std::memcpy(velocity.data(), data.data() + offsetof(XYZVBinaryData, velocity), sizeof(double) * 3);
-
-        sample.position = position.template cast<T>();
-        sample.velocity = (velocity * astro::daysToSecs(1.0)).template cast<T>();
+    if (file->size() < sizeof(XYZVBinaryHeader))
+    {
+        GetLogger()->error(_("Error reading header of {}.\n"), filename);
+        return nullptr;
     }
 
-    convertToCelestiaCoordinates(sample.position);
-    convertToCelestiaCoordinates(sample.velocity);
-
-    return true;
-}
-
-/* Load a binary xyzv sampled trajectory file.
- */
-template <typename T>
-std::shared_ptr<const Samples<SampleXYZV<T>>>
-LoadSamplesXYZVBinary(const fs::path& filename)
-{
-    std::vector<double> sampleTimes;
-    std::vector<SampleXYZV<T>> samples;
-
-    std::ifstream in(filename, std::ios::in | std::ios::binary);
-    if (!in.good())
+    if (!ParseXYZVBinaryHeader(file->data(), filename))
     {
-        GetLogger()->error(_("Error opening binary sample file {}.\n"), filename);
+        GetLogger()->error(_("Could not read XYZV binary file {}.\n"), filename);
         return nullptr;
     }
 
-    if (!ParseXYZVBinaryHeader(in, filename))
+    // Like the stream readers, use all complete records up to the end of
+    // the file rather than trusting the count in the header
+    std::size_t nRecords = (file->size() - sizeof(XYZVBinaryHeader)) / sizeof(XYZVBinaryData);
+    if (nRecords > std::numeric_limits<std::uint32_t>::max())
     {
-        GetLogger()->error(_("Could not read XYZV binary file {}.\n"), filename);
+        detail::logReadError(filename);
         return nullptr;
     }
 
-    if (!LoadSamples(in, filename, sampleTimes, samples, &ReadXYZVBinarySample<T>))
+    std::shared_ptr<MappedSamplesXYZV> samples{ new MappedSamplesXYZV };
+    samples->records = file->data() + sizeof(XYZVBinaryHeader);
+    samples->count = static_cast<std::uint32_t>(nRecords);
+
+    // Only index the records if some have to be skipped
+    double lastSampleTime = -std::numeric_limits<double>::infinity();
+    bool hasOutOfOrderSamples = false;
+    std::uint32_t nKept = 0;
+    for (std::uint32_t i = 0; i < samples->count; ++i)
+    {
+        double tdb;
+        std::memcpy(&tdb, samples->records + i * sizeof(XYZVBinaryData) + offsetof(XYZVBinaryData, tdb), sizeof(double));
+        if (!detail::checkSampleOrdering(tdb, lastSampleTime, hasOutOfOrderSamples, filename))
+            continue;
+
+        if (hasOutOfOrderSamples)
+        {
+            if (samples->kept.empty())
+            {
+                samples->kept.resize(nKept);
+                std::iota(samples->kept.begin(), samples->kept.end(), std::uint32_t(0));
+            }
+            samples->kept.push_back(i);
+        }
+        ++nKept;
+    }
+
+    if (!detail::logIfNoSamples(nKept > 0, filename))
         return nullptr;
 
-    return std::make_shared<Samples<SampleXYZV<T>>>(std::move(sampleTimes),
-                                                    std::move(samples));
+    samples->count = nKept;
+    samples->index = SampleTimeIndex(nKept, [&samples](std::uint32_t i) { return samples->time(i); });
+    samples->file = std::move(file);
+    return samples;
 }
 
 template<typename T>
@@ -706,31 +1069,23 @@ ReadAsciiSampleXYZV(std::istream& in, double& tdb, SampleXYZV<T>& sample)
 // of a comment.
 
 template<typename T>
-std::shared_ptr<const Samples<SampleXYZV<T>>>
+std::shared_ptr<const LoadedSamplesXYZV<T>>
 LoadSamplesXYZVAscii(const fs::path& filename)
 {
-    auto binname = filename;
-    binname += "bin";
-    if (fs::exists(binname))
-    {
-        if (auto binsamples = LoadSamplesXYZVBinary<T>(binname); binsamples != nullptr)
-            return binsamples;
-    }
-
     std::vector<double> sampleTimes;
     std::vector<SampleXYZV<T>> samples;
     if (!LoadAsciiSamples(filename, sampleTimes, samples, &ReadAsciiSampleXYZV<T>))
         return nullptr;
 
-    return std::make_shared<Samples<SampleXYZV<T>>>(std::move(sampleTimes), std::move(samples));
+    return std::make_shared<LoadedSamplesXYZV<T>>(std::move(sampleTimes), std::move(samples));
 }
 
-template<typename T>
-using SamplesMap = std::unordered_map<fs::path, std::weak_ptr<const Samples<T>>, util::PathHasher>;
+template<typename S>
+using SamplesMap = std::unordered_map<fs::path, std::weak_ptr<const S>, util::PathHasher>;
 
-template<typename T, typename F>
-std::shared_ptr<const Samples<T>>
-findSamples(SamplesMap<T>& cache, const fs::path& filename, F loader)
+template<typename S, typename F>
+std::shared_ptr<const S>
+findSamples(SamplesMap<S>& cache, const fs::path& filename, F loader)
 {
     auto it = cache.try_emplace(filename).first;
     if (auto cachedSamples = it->second.lock(); cachedSamples != nullptr)
@@ -747,6 +1102,20 @@ findSamples(SamplesMap<T>& cache, const fs::path& filename, F loader)
     return samples;
 }
 
+template<typename S>
+std::size_t
+samplesMemoryUsage(const SamplesMap<S>& cache)
+{
+    std::size_t size = 0;
+    for (const auto& [filename, weakSamples] : cache)
+    {
+        if (auto samples = weakSamples.lock(); samples != nullptr)
+            size += samples->memoryUsage();
+    }
+
+    return size;
+}
+
 class SamplesManager
 {
 public:
@@ -756,58 +1125,102 @@ public:
     SamplesManager(const SamplesManager&) = delete;
     SamplesManager& operator=(const SamplesManager&) = delete;
 
-    std::shared_ptr<const Samples<SampleXYZ<float>>> findXYZSingle(const fs::path&);
-    std::shared_ptr<const Samples<SampleXYZ<double>>> findXYZDouble(const fs::path&);
-    std::shared_ptr<const Samples<SampleXYZV<float>>> findXYZVSingle(const fs::path&);
-    std::shared_ptr<const Samples<SampleXYZV<double>>> findXYZVDouble(const fs::path&);
+    std::shared_ptr<const LoadedSamplesXYZ<float>> findXYZSingle(const fs::path&);
+    std::shared_ptr<const LoadedSamplesXYZ<double>> findXYZDouble(const fs::path&);
+    std::shared_ptr<const CompressedSamplesXYZ> findXYZCompressed(const fs::path&, double tolerance);
+    std::shared_ptr<const LoadedSamplesXYZV<float>> findXYZVSingle(const fs::path&);
+    std::shared_ptr<const LoadedSamplesXYZV<double>> findXYZVDouble(const fs::path&);
+    std::shared_ptr<const MappedSamplesXYZV> findXYZVBinary(const fs::path&);
+
+    // Memory taken by the samples still in use, in bytes
+    std::size_t getLoadedSize() const;
+
+    std::mutex& getMutex() const { return mutex; }
 
 private:
-    SamplesMap<SampleXYZ<float>> samplesXYZSingle;
-    SamplesMap<SampleXYZ<double>> samplesXYZDouble;
-    SamplesMap<SampleXYZV<float>> samplesXYZVSingle;
-    SamplesMap<SampleXYZV<double>> samplesXYZVDouble;
+    mutable std::mutex mutex;
+    SamplesMap<LoadedSamplesXYZ<float>> samplesXYZSingle;
+    SamplesMap<LoadedSamplesXYZ<double>> samplesXYZDouble;
+    SamplesMap<CompressedSamplesXYZ> samplesXYZCompressed;
+    SamplesMap<LoadedSamplesXYZV<float>> samplesXYZVSingle;
+    SamplesMap<LoadedSamplesXYZV<double>> samplesXYZVDouble;
+    SamplesMap<MappedSamplesXYZV> samplesXYZVBinary;
 };
 
-std::shared_ptr<const Samples<SampleXYZ<float>>>
+std::shared_ptr<const LoadedSamplesXYZ<float>>
 SamplesManager::findXYZSingle(const fs::path& filename)
 {
     return findSamples(samplesXYZSingle, filename, &LoadSamplesXYZAscii<float>);
 }
 
-std::shared_ptr<const Samples<SampleXYZ<double>>>
+std::shared_ptr<const LoadedSamplesXYZ<double>>
 SamplesManager::findXYZDouble(const fs::path& filename)
 {
     return findSamples(samplesXYZDouble, filename, &LoadSamplesXYZAscii<double>);
 }
 
-std::shared_ptr<const Samples<SampleXYZV<float>>>
-SamplesManager::findXYZVSingle(const fs::path& filename)
+std::shared_ptr<const CompressedSamplesXYZ>
+SamplesManager::findXYZCompressed(const fs::path& filename, double tolerance)
 {
-    switch (DetermineFileType(filename))
+    auto it = samplesXYZCompressed.try_emplace(filename).first;
+    if (auto cachedSamples = it->second.lock();
+        cachedSamples != nullptr && cachedSamples->getTolerance() == tolerance)
     {
-    case ContentType::CelestiaXYZVTrajectory:
-        return findSamples(samplesXYZVSingle, filename, &LoadSamplesXYZVAscii<float>);
-    case ContentType::CelestiaXYZVBinary:
-        return findSamples(samplesXYZVSingle, filename, &LoadSamplesXYZVBinary<float>);
-    default:
-        assert(0);
-        return nullptr;
+        return cachedSamples;
+    }
+
+    // The uncompressed samples are only kept while coding them
+    std::shared_ptr<const CompressedSamplesXYZ> samples;
+    if (auto loaded = LoadSamplesXYZAscii<double>(filename); loaded != nullptr)
+    {
+        samples = CompressedSamplesXYZ::create(*loaded, tolerance);
+        if (samples == nullptr)
+            GetLogger()->warn(_("Could not compress {}, storing it uncompressed.\n"), filename);
     }
+
+    if (samples != nullptr)
+        it->second = samples;
+    else if (it->second.expired())
+        samplesXYZCompressed.erase(it);
+
+    return samples;
+}
+
+std::shared_ptr<const LoadedSamplesXYZV<float>>
+SamplesManager::findXYZVSingle(const fs::path& filename)
+{
+    return findSamples(samplesXYZVSingle, filename, &LoadSamplesXYZVAscii<float>);
 }
 
-std::shared_ptr<const Samples<SampleXYZV<double>>>
+std::shared_ptr<const LoadedSamplesXYZV<double>>
 SamplesManager::findXYZVDouble(const fs::path& filename)
 {
-    switch (DetermineFileType(filename))
-    {
-    case ContentType::CelestiaXYZVTrajectory:
-        return findSamples(samplesXYZVDouble, filename, &LoadSamplesXYZVAscii<double>);
-    case ContentType::CelestiaXYZVBinary:
-        return findSamples(samplesXYZVDouble, filename, &LoadSamplesXYZVBinary<double>);
-    default:
-        assert(0);
-        return nullptr;
-    }
+    return findSamples(samplesXYZVDouble, filename, &LoadSamplesXYZVAscii<double>);
+}
+
+std::shared_ptr<const MappedSamplesXYZV>
+SamplesManager::findXYZVBinary(const fs::path& filename)
+{
+    return findSamples(samplesXYZVBinary, filename, &MappedSamplesXYZV::load);
+}
+
+std::size_t
+SamplesManager::getLoadedSize() const
+{
+    std::scoped_lock lock(mutex);
+    return samplesMemoryUsage(samplesXYZSingle) +
+           samplesMemoryUsage(samplesXYZDouble) +
+           samplesMemoryUsage(samplesXYZCompressed) +
+           samplesMemoryUsage(samplesXYZVSingle) +
+           samplesMemoryUsage(samplesXYZVDouble) +
+           samplesMemoryUsage(samplesXYZVBinary);
+}
+
+SamplesManager&
+GetSamplesManager()
+{
+    static SamplesManager samplesManager;
+    return samplesManager;
 }
 
 } // end unnamed namespace
@@ -817,21 +1230,29 @@ SamplesManager::findXYZVDouble(const fs::path& filename)
 std::shared_ptr<const Orbit>
 LoadSampledTrajectory(const fs::path& filename,
                       TrajectoryInterpolation interpolation,
-                      TrajectoryPrecision precision)
+                      TrajectoryPrecision precision,
+                      double tolerance)
 {
-    static SamplesManager samplesManager;
+    SamplesManager& samplesManager = GetSamplesManager();
+    std::scoped_lock lock(samplesManager.getMutex());
     switch (DetermineFileType(filename))
     {
     case ContentType::CelestiaXYZTrajectory:
+        if (tolerance > 0.0)
+        {
+            if (auto samples = samplesManager.findXYZCompressed(filename, tolerance); samples != nullptr)
+                return std::make_shared<SampledOrbit<CompressedSamplesXYZ>>(interpolation, samples);
+        }
+
         switch (precision)
         {
         case TrajectoryPrecision::Single:
             if (auto samples = samplesManager.findXYZSingle(filename); samples != nullptr)
-                return std::make_shared<SampledOrbit<float>>(interpolation, samples);
+                return std::make_shared<SampledOrbit<LoadedSamplesXYZ<float>>>(interpolation, samples);
             break;
         case TrajectoryPrecision::Double:
             if (auto samples = samplesManager.findXYZDouble(filename); samples != nullptr)
-                return std::make_shared<SampledOrbit<double>>(interpolation, samples);
+                return std::make_shared<SampledOrbit<LoadedSamplesXYZ<double>>>(interpolation, samples);
             break;
         default:
             assert(0);
@@ -840,16 +1261,22 @@ LoadSampledTrajectory(const fs::path& filename,
         return nullptr;
 
     case ContentType::CelestiaXYZVTrajectory:
-    case ContentType::CelestiaXYZVBinary:
+        // Use a binary version of the file if there is one
+        if (auto binname = fs::path(filename) += "bin"; fs::exists(binname))
+        {
+            if (auto samples = samplesManager.findXYZVBinary(binname); samples != nullptr)
+                return std::make_shared<SampledOrbitXYZV<MappedSamplesXYZV>>(interpolation, samples);
+        }
+
         switch (precision)
         {
         case TrajectoryPrecision::Single:
             if (auto samples = samplesManager.findXYZVSingle(filename); samples != nullptr)
-                return std::make_shared<SampledOrbitXYZV<float>>(interpolation, samples);
+                return std::make_shared<SampledOrbitXYZV<LoadedSamplesXYZV<float>>>(interpolation, samples);
             break;
         case TrajectoryPrecision::Double:
             if (auto samples = samplesManager.findXYZVDouble(filename); samples != nullptr)
-                return std::make_shared<SampledOrbitXYZV<double>>(interpolation, samples);
+                return std::make_shared<SampledOrbitXYZV<LoadedSamplesXYZV<double>>>(interpolation, samples);
             break;
         default:
             assert(0);
@@ -857,10 +1284,22 @@ LoadSampledTrajectory(const fs::path& filename,
         }
         return nullptr;
 
+    case ContentType::CelestiaXYZVBinary:
+        // Binary files are used in place, they are always double precision
+        if (auto samples = samplesManager.findXYZVBinary(filename); samples != nullptr)
+            return std::make_shared<SampledOrbitXYZV<MappedSamplesXYZV>>(interpolation, samples);
+        return nullptr;
+
     default:
         assert(0);
         return nullptr;
     }
 }
 
+std::size_t
+GetLoadedTrajectorySize()
+{
+    return GetSamplesManager().getLoadedSize();
+}
+
 } // end namespace celestia::ephem
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 
 #include <celcompat/filesystem.h>
@@ -30,8 +31,15 @@ enum class TrajectoryPrecision
     Double,
 };
 
+// With a positive tolerance, positions of xyz files are stored compressed
+// to within tolerance kilometers of the file, whatever the precision.
 std::shared_ptr<const Orbit> LoadSampledTrajectory(const fs::path&,
                                                    TrajectoryInterpolation,
-                                                   TrajectoryPrecision);
+                                                   TrajectoryPrecision,
+                                                   double tolerance = 0.0);
+
+// Memory taken by the samples of the trajectories in use, in bytes. Binary
+// files used in place through a memory mapping are not counted.
+std::size_t GetLoadedTrajectorySize();
 
 } // end namespace celestia::ephem
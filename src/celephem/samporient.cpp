@@ -13,6 +13,7 @@
 
 #include "samporient.h"
 
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <istream>
@@ -73,6 +74,7 @@ public:
     double getPeriod() const override;
 
     void getValidRange(double& begin, double& end) const override;
+    bool isThreadSafe() const override { return true; }
 
 private:
     Eigen::Quaternionf getOrientation(double tjd) const;
@@ -81,7 +83,9 @@ private:
     // the 16-byte alignment of Quaternionf
     std::vector<double> sampleTimes;
     std::vector<Eigen::Quaternionf> rotations;
-    mutable std::uint32_t lastSample{0};
+    SampleTimeIndex index;
+    // Only a hint for the search, threads may overwrite each other's value
+    mutable std::atomic<std::uint32_t> lastSample{0};
 };
 
 
@@ -93,6 +97,7 @@ SampledOrientation::SampledOrientation(std::vector<double>&& _sampleTimes,
     assert(!sampleTimes.empty() && sampleTimes.size() == rotations.size());
     sampleTimes.shrink_to_fit();
     rotations.shrink_to_fit();
+    index = SampleTimeIndex(sampleTimes);
 
     // Apply a 90-degree rotation around the x-axis to convert the orientation
     // to Celestia's coordinate system
@@ -139,7 +144,9 @@ SampledOrientation::getOrientation(double tjd) const
     if (sampleTimes.size() == 1)
         return rotations.front();
 
-    std::uint32_t n = GetSampleIndex(tjd, lastSample, sampleTimes);
+    std::uint32_t hint = lastSample.load(std::memory_order_relaxed);
+    std::uint32_t n = GetSampleIndex(tjd, hint, sampleTimes, index);
+    lastSample.store(hint, std::memory_order_relaxed);
     if (n == 0)
         return rotations.front();
     else if (n == sampleTimes.size())
@@ -30,11 +30,13 @@ class ScriptObjectState
 private:
     lua_State* context{ nullptr };
     unsigned int nameIndex{ 1 };
+    std::recursive_mutex mutex;
 
 public:
     lua_State* getContext() { return context; }
     void setContext(lua_State* luaState) { context = luaState; }
     unsigned int getNameIndex() { return nameIndex++; }
+    std::recursive_mutex& getMutex() { return mutex; }
 };
 
 // global script context for scripted orbits and rotations
@@ -105,6 +107,13 @@ GetScriptedObjectContext()
 }
 
 
+std::unique_lock<std::recursive_mutex>
+LockScriptedObjectContext()
+{
+    return std::unique_lock<std::recursive_mutex>(getCurrentObjectState()->getMutex());
+}
+
+
 /*! Generate a unique name for this script orbit object so that
  * we can refer to it later.
  */
@@ -15,6 +15,7 @@
 #define LUA_VER 0x050100
 #endif
 
+#include <mutex>
 #include <string>
 
 #include <lua.hpp>
@@ -28,6 +29,13 @@ void SetScriptedObjectContext(lua_State* l);
 
 lua_State* GetScriptedObjectContext();
 
+// Scripted orbits and rotations hold this lock while calling into the
+// context, so that they can be evaluated from several threads. It is
+// recursive since their scripts may evaluate other scripted objects. Lua
+// hooks sharing the context only run on the main thread, never while
+// objects are evaluated in parallel.
+std::unique_lock<std::recursive_mutex> LockScriptedObjectContext();
+
 std::string GenerateScriptObjectName();
 
 void GetLuaTableEntry(lua_State* state,
@@ -42,6 +42,7 @@ class ScriptedOrbit : public CachingOrbit
     double getPeriod() const override;
     double getBoundingRadius() const override;
     void getValidRange(double& begin, double& end) const override;
+    bool isThreadSafe() const override { return true; }
 
  private:
     lua_State* luaState{ nullptr };
@@ -72,6 +73,8 @@ ScriptedOrbit::ScriptedOrbit(lua_State* pLuaState,
 Eigen::Vector3d
 ScriptedOrbit::computePosition(double tjd) const
 {
+    auto lock = LockScriptedObjectContext();
+
     Eigen::Vector3d pos(Eigen::Vector3d::Zero());
     lua_getglobal(luaState, luaOrbitObjectName.c_str());
     if (lua_istable(luaState, -1))
@@ -185,6 +188,8 @@ CreateScriptedOrbit(const std::string* moduleName,
         return nullptr;
     }
 
+    auto lock = LockScriptedObjectContext();
+
     if (moduleName != nullptr && !moduleName->empty())
     {
         lua_getglobal(luaState, "require");
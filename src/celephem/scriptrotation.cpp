@@ -43,6 +43,7 @@ class ScriptedRotation : public RotationModel
     bool isPeriodic() const override;
     double getPeriod() const override;
     void getValidRange(double& begin, double& end) const override;
+    bool isThreadSafe() const override { return true; }
 
  private:
     lua_State* luaState{ nullptr };
@@ -51,7 +52,7 @@ class ScriptedRotation : public RotationModel
     double validRangeBegin{ 0.0 };
     double validRangeEnd{ 0.0 };
 
-    // Cached values
+    // Cached values, guarded by the scripted object lock
     mutable double lastTime{ -1.0e50 };
     mutable Eigen::Quaterniond lastOrientation{Eigen::Quaterniond::Identity()};
 
@@ -76,6 +77,7 @@ ScriptedRotation::ScriptedRotation(lua_State* pLuaState,
 Eigen::Quaterniond
 ScriptedRotation::spin(double tjd) const
 {
+    auto lock = LockScriptedObjectContext();
     if (tjd != lastTime || !cacheable)
     {
         lua_getglobal(luaState, luaRotationObjectName.c_str());
@@ -184,6 +186,8 @@ CreateScriptedRotation(const std::string* moduleName,
         return nullptr;
     }
 
+    auto lock = LockScriptedObjectContext();
+
     if (moduleName != nullptr && !moduleName->empty())
     {
         lua_getglobal(luaState, "require");
@@ -11,6 +11,7 @@
 
 #include "spiceinterface.h"
 
+#include <memory>
 #include <set>
 
 #include <SpiceUsr.h>
@@ -36,6 +37,13 @@ ResidentKernelsSet* getResidentKernelsSet()
     return residentKernelsSet;
 }
 
+std::recursive_mutex&
+getSpiceMutex()
+{
+    static std::recursive_mutex* const spiceMutex = std::make_unique<std::recursive_mutex>().release();
+    return *spiceMutex;
+}
+
 } // end unnamed namespace
 
 /*! Perform one-time initialization of SPICE.
@@ -43,6 +51,8 @@ ResidentKernelsSet* getResidentKernelsSet()
 bool
 InitializeSpice()
 {
+    auto lock = LockSpice();
+
     // Set the error behavior to the RETURN action, so that
     // Celestia do its own handling of SPICE errors.
     erract_c("SET", 0, (SpiceChar*)"RETURN");
@@ -51,6 +61,13 @@ InitializeSpice()
 }
 
 
+std::unique_lock<std::recursive_mutex>
+LockSpice()
+{
+    return std::unique_lock<std::recursive_mutex>(getSpiceMutex());
+}
+
+
 /*! Convert an object name to a NAIF integer ID. Return true if the name
  *  refers to a known object, false if not. Both names and numeric IDs are
  *  accepted in the string.
@@ -64,6 +81,7 @@ bool GetNaifId(const std::string& name, int* id)
     // an error if we do.
     if (!name.empty())
     {
+        auto lock = LockSpice();
         bodn2c_c(name.c_str(), &spiceID, &found);
         if (found)
         {
@@ -91,6 +109,8 @@ bool GetNaifId(const std::string& name, int* id)
  */
 bool LoadSpiceKernel(const fs::path& filepath)
 {
+    auto lock = LockSpice();
+
     // Only load the kernel if it is not already resident. Note that this detection
     // of duplicate kernels will not work if a file was originally loaded through
     // a metakernel.
@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include <mutex>
 #include <string>
 
 #include <celcompat/filesystem.h>
@@ -20,6 +21,11 @@ namespace celestia::ephem
 
 bool InitializeSpice();
 
+// CSPICE is not reentrant and keeps global state such as the kernel pool and
+// the error status, so every call into it must hold this lock. It is
+// recursive so that the helpers below can be called with the lock held.
+std::unique_lock<std::recursive_mutex> LockSpice();
+
 // SPICE utility functions
 
 bool GetNaifId(const std::string& name, int* id);
@@ -9,6 +9,8 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cmath>
 #include <utility>
 
 #include <SpiceUsr.h>
@@ -29,6 +31,45 @@ namespace
 
 constexpr double MILLISEC = astro::secsToDays(0.001);
 
+// Limits of the grid spacing of the state cache
+constexpr double MaxCacheStep = 4.0;
+constexpr double MinCacheStep = astro::secsToDays(1.0);
+
+// Log and clear the SPICE error state, return true if an error occurred
+bool
+checkSpiceError()
+{
+    if (!failed_c())
+        return false;
+
+    char errMsg[1024];
+    getmsg_c("long", sizeof(errMsg), errMsg);
+    GetLogger()->warn("{}\n", errMsg);
+    reset_c();
+    return true;
+}
+
+// Cubic Hermite interpolation at s in [0, 1] of an interval of length h
+Eigen::Vector3d
+hermitePosition(const Eigen::Vector3d& p0, const Eigen::Vector3d& v0,
+                const Eigen::Vector3d& p1, const Eigen::Vector3d& v1,
+                double h, double s)
+{
+    double s2 = s * s;
+    double s3 = s2 * s;
+    return (2.0 * s3 - 3.0 * s2 + 1.0) * p0 + (s3 - 2.0 * s2 + s) * h * v0 +
+           (3.0 * s2 - 2.0 * s3) * p1 + (s3 - s2) * h * v1;
+}
+
+Eigen::Vector3d
+hermiteVelocity(const Eigen::Vector3d& p0, const Eigen::Vector3d& v0,
+                const Eigen::Vector3d& p1, const Eigen::Vector3d& v1,
+                double h, double s)
+{
+    double s2 = s * s;
+    return (6.0 * (s2 - s) / h) * (p0 - p1) + (3.0 * s2 - 4.0 * s + 1.0) * v0 + (3.0 * s2 - 2.0 * s) * v1;
+}
+
 } // end unnamed namespace
 
 /*! Create a new SPICE orbit using with a valid interval specified
@@ -108,6 +149,8 @@ SpiceOrbit::loadRequiredKernel(const fs::path& path, const std::string& kernel)
 bool
 SpiceOrbit::init()
 {
+    auto lock = LockSpice();
+
     // Get the ID codes for the target
     if (!GetNaifId(targetBodyName, &targetID))
     {
@@ -234,6 +277,11 @@ SpiceOrbit::init()
         reset_c();
     }
 
+    // Start with a grid sized by the coverage, fillCache() refines it where
+    // needed
+    double span = isPeriodic() ? period : validIntervalEnd - validIntervalBegin;
+    cacheStep = std::clamp(span / 256.0, MinCacheStep, MaxCacheStep);
+
     return !spiceErr;
 }
 
@@ -247,39 +295,16 @@ SpiceOrbit::computePosition(double jd) const
         jd = validIntervalEnd;
 
     if (spiceErr)
-    {
         return Eigen::Vector3d::Zero();
-    }
-    else
-    {
-        // Input time for SPICE is seconds after J2000
-        double t = astro::daysToSecs(jd - astro::J2000);
-        double position[3];
-        double lt;          // One way light travel time
-
-        spkgps_c(targetID,
-                 t,
-                 "eclipj2000",
-                 originID,
-                 position,
-                 &lt);
-
-        // This shouldn't happen, since we've already computed the valid
-        // coverage interval.
-        if (failed_c())
-        {
-            // Print the error message
-            char errMsg[1024];
-            getmsg_c("long", sizeof(errMsg), errMsg);
-            GetLogger()->warn("{}\n", errMsg);
-
-            // Reset the error state
-            reset_c();
-        }
 
-        // Transform into Celestia's coordinate system
-        return Eigen::Vector3d(position[0], position[2], -position[1]);
+    Eigen::Vector3d position = Eigen::Vector3d::Zero();
+    if (!interpolate(jd, &position, nullptr))
+    {
+        auto lock = LockSpice();
+        computeSpicePosition(jd, position);
     }
+
+    return position;
 }
 
 
@@ -292,43 +317,173 @@ SpiceOrbit::computeVelocity(double jd) const
         jd = validIntervalEnd;
 
     if (spiceErr)
-    {
         return Eigen::Vector3d::Zero();
+
+    Eigen::Vector3d velocity = Eigen::Vector3d::Zero();
+    if (!interpolate(jd, nullptr, &velocity))
+    {
+        auto lock = LockSpice();
+        Eigen::Vector3d position;
+        computeState(jd, position, velocity);
     }
-    else
+
+    return velocity;
+}
+
+
+/*! Interpolate the position and/or velocity at jd from the state cache,
+ *  refilling it if jd is close to the cached span or to the previous miss.
+ *  Return false if the state must be computed by SPICE instead.
+ */
+bool
+SpiceOrbit::interpolate(double jd, Eigen::Vector3d* position, Eigen::Vector3d* velocity) const
+{
+    std::scoped_lock lock(cacheMutex);
+
+    double cacheEnd = cache.start + cache.step * static_cast<double>(cache.count - 1);
+    if (cache.count < 2 || jd < cache.start || jd > cacheEnd)
     {
-        // Input time for SPICE is seconds after J2000
-        double t = astro::daysToSecs(jd - astro::J2000);
-        double state[6];
-        double lt;          // One way light travel time
-
-        spkgeo_c(targetID,
-                 t,
-                 "eclipj2000",
-                 originID,
-                 state,
-                 &lt);
-
-        // This shouldn't happen, since we've already computed the valid
-        // coverage interval.
-        if (failed_c())
+        // Refilling costs CacheSize calls, only worth it if the following
+        // requests are likely to fall on the new grid
+        double margin = 2.0 * cacheStep;
+        bool nearCache = cache.count >= 2 && jd >= cache.start - margin && jd <= cacheEnd + margin;
+        bool nearMiss = std::abs(jd - lastMissTime) <= margin;
+        int direction = 0;
+        if (nearCache)
+            direction = jd > cacheEnd ? 1 : -1;
+        else if (nearMiss)
+            direction = jd > lastMissTime ? 1 : -1;
+
+        lastMissTime = jd;
+        if (direction == 0 || !fillCache(jd, direction))
+            return false;
+    }
+
+    double x = (jd - cache.start) / cache.step;
+    auto i = std::min(static_cast<std::uint32_t>(x), cache.count - 2);
+    double s = x - static_cast<double>(i);
+    if (position != nullptr)
+        *position = hermitePosition(cache.positions[i], cache.velocities[i],
+                                    cache.positions[i + 1], cache.velocities[i + 1],
+                                    cache.step, s);
+    if (velocity != nullptr)
+        *velocity = hermiteVelocity(cache.positions[i], cache.velocities[i],
+                                    cache.positions[i + 1], cache.velocities[i + 1],
+                                    cache.step, s);
+    return true;
+}
+
+
+/*! Compute the states of a grid from jd in one pass through SPICE, going
+ *  forward or backward in time following direction. The
+ *  grid spacing is halved until the splines look accurate enough, and
+ *  widened again for the next fill where they are much more accurate than
+ *  needed. The caller must hold cacheMutex.
+ */
+bool
+SpiceOrbit::fillCache(double jd, int direction) const
+{
+    auto lock = LockSpice();
+
+    double range = validIntervalEnd - validIntervalBegin;
+    cache.count = 0;
+    if (!(range > 0.0 && cacheStep > 0.0))
+        return false;
+
+    for (;;)
+    {
+        double step = cacheStep;
+        double start;
+        if (step * static_cast<double>(CacheSize - 1) >= range)
         {
-            // Print the error message
-            char errMsg[1024];
-            getmsg_c("long", sizeof(errMsg), errMsg);
-            GetLogger()->warn("{}\n", errMsg);
+            step = range / static_cast<double>(CacheSize - 1);
+            start = validIntervalBegin;
+        }
+        else
+        {
+            double length = step * static_cast<double>(CacheSize - 1);
+            start = direction > 0 ? jd - step : jd + step - length;
+            start = std::clamp(start, validIntervalBegin, validIntervalEnd - length);
+        }
 
-            // Reset the error state
-            reset_c();
+        for (std::uint32_t i = 0; i < CacheSize; ++i)
+        {
+            if (!computeState(start + step * static_cast<double>(i), cache.positions[i], cache.velocities[i]))
+                return false;
+        }
+
+        // Estimate the error without further calls: the error of a spline
+        // over two intervals at the skipped point is about 16 times that of
+        // the splines over single intervals.
+        double maxError = 0.0;
+        for (std::uint32_t i = 0; i + 2 < CacheSize; ++i)
+        {
+            Eigen::Vector3d interpolated = hermitePosition(cache.positions[i], cache.velocities[i],
+                                                           cache.positions[i + 2], cache.velocities[i + 2],
+                                                           2.0 * step, 0.5);
+            maxError = std::max(maxError, (interpolated - cache.positions[i + 1]).norm() / 16.0);
+        }
+
+        if (maxError > CacheTolerance && step > MinCacheStep)
+        {
+            cacheStep = std::max(step * 0.5, MinCacheStep);
+            continue;
         }
 
-        // Transform into Celestia's coordinate system, and from km/s to km/day
-        double d2s = astro::daysToSecs(1.0);
-        return Eigen::Vector3d(state[3] * d2s, state[5] * d2s, -state[4] * d2s);
+        // The error of cubic splines scales with the fourth power of the
+        // spacing
+        if (maxError < CacheTolerance / 32.0)
+            cacheStep = std::min(step * 2.0, MaxCacheStep);
+
+        cache.start = start;
+        cache.step = step;
+        cache.count = CacheSize;
+        return true;
     }
 }
 
 
+// The caller must hold the SPICE lock
+bool
+SpiceOrbit::computeState(double jd, Eigen::Vector3d& position, Eigen::Vector3d& velocity) const
+{
+    // Input time for SPICE is seconds after J2000
+    double t = astro::daysToSecs(jd - astro::J2000);
+    double state[6];
+    double lt;          // One way light travel time
+
+    spkgeo_c(targetID, t, "eclipj2000", originID, state, &lt);
+
+    // This shouldn't happen, since we've already computed the valid
+    // coverage interval.
+    if (checkSpiceError())
+        return false;
+
+    // Transform into Celestia's coordinate system, and from km/s to km/day
+    double d2s = astro::daysToSecs(1.0);
+    position = Eigen::Vector3d(state[0], state[2], -state[1]);
+    velocity = Eigen::Vector3d(state[3] * d2s, state[5] * d2s, -state[4] * d2s);
+    return true;
+}
+
+
+// The caller must hold the SPICE lock
+bool
+SpiceOrbit::computeSpicePosition(double jd, Eigen::Vector3d& position) const
+{
+    double t = astro::daysToSecs(jd - astro::J2000);
+    double p[3];
+    double lt;
+
+    spkgps_c(targetID, t, "eclipj2000", originID, p, &lt);
+    if (checkSpiceError())
+        return false;
+
+    position = Eigen::Vector3d(p[0], p[2], -p[1]);
+    return true;
+}
+
+
 void SpiceOrbit::getValidRange(double& begin, double& end) const
 {
     begin = validIntervalBegin;
@@ -11,6 +11,9 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <mutex>
 #include <string>
 
 #include <Eigen/Core>
@@ -21,6 +24,12 @@
 namespace celestia::ephem
 {
 
+/*! Positions from the SPICE toolkit. Calls into SPICE are expensive, so
+ *  states are computed in bulk on an evenly spaced grid and interpolated
+ *  with cubic Hermite splines. The grid is refined until the estimated
+ *  interpolation error is below CacheTolerance. Like ChebyshevOrbit,
+ *  isolated requests are computed directly.
+ */
 class SpiceOrbit : public CachingOrbit
 {
  public:
@@ -61,7 +70,26 @@ class SpiceOrbit : public CachingOrbit
 
     void getValidRange(double& begin, double& end) const override;
 
+    //! Largest interpolation error accepted, in kilometers
+    static constexpr double CacheTolerance = 0.001;
+
  private:
+    static constexpr std::uint32_t CacheSize = 32;
+
+    struct StateCache
+    {
+        double start{ 0.0 };
+        double step{ 0.0 };
+        std::uint32_t count{ 0 };
+        std::array<Eigen::Vector3d, CacheSize> positions;
+        std::array<Eigen::Vector3d, CacheSize> velocities;
+    };
+
+    bool interpolate(double jd, Eigen::Vector3d* position, Eigen::Vector3d* velocity) const;
+    bool fillCache(double jd, int direction) const;
+    bool computeState(double jd, Eigen::Vector3d& position, Eigen::Vector3d& velocity) const;
+    bool computeSpicePosition(double jd, Eigen::Vector3d& position) const;
+
     const std::string targetBodyName;
     const std::string originName;
     double period;
@@ -77,6 +105,11 @@ class SpiceOrbit : public CachingOrbit
 
     bool useDefaultTimeInterval;
 
+    mutable std::mutex cacheMutex;
+    mutable StateCache cache;
+    mutable double cacheStep{ 0.0 };
+    mutable double lastMissTime{ -1.0e30 };
+
     bool init();
     bool loadRequiredKernel(const fs::path&, const std::string&);
 };
@@ -120,6 +120,7 @@ SpiceRotation::init()
     // adequate data in the kernel.
     double beginning = astro::daysToSecs(m_validIntervalBegin - astro::J2000);
     double xform[3][3];
+    auto lock = LockSpice();
     pxform_c(m_frameName.c_str(), m_frameName.c_str(), beginning, xform);
     if (failed_c())
     {
@@ -154,6 +155,7 @@ SpiceRotation::computeSpin(double jd) const
         double t = astro::daysToSecs(jd - astro::J2000);
         double xform[3][3];
 
+        auto lock = LockSpice();
         pxform_c(m_frameName.c_str(), m_baseFrameName.c_str(), t, xform);
 
         if (failed_c())
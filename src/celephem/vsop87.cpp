@@ -14,11 +14,13 @@
 
 #include "vsop87.h"
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <cstddef>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <config.h>
 
@@ -11014,6 +11016,105 @@ SumSeries(const VSOPSeries& series, double t)
     return x;
 }
 
+// Number of times evaluated together by the batched functions
+constexpr std::size_t BatchSize = 64;
+
+// Time argument of the series: Julian millenia since J2000.0
+double
+toMillenia(double jd)
+{
+    return (jd - 2451545.0) / 365250.0;
+}
+
+// Adds the sums of a series at the n <= BatchSize times t0 + k * dt to
+// sums[k]. The cosine of each term is advanced from one time to the next
+// with the angle addition formulas, so only the first time of a batch needs
+// std::cos and std::sin; starting over each batch bounds the rounding
+// errors.
+void
+SumSeriesBatch(const VSOPSeries& series, double t0, double dt, std::size_t n, double* sums)
+{
+    for (std::size_t i = 0; i < series.nTerms; i++)
+    {
+        const VSOPTerm& term = series.terms[i];
+        double phase = term.B + term.C * t0;
+        double c = std::cos(phase);
+        double s = std::sin(phase);
+        double cosStep = std::cos(term.C * dt);
+        double sinStep = std::sin(term.C * dt);
+        for (std::size_t k = 0; k < n; k++)
+        {
+            sums[k] += term.A * c;
+            double next = c * cosStep - s * sinStep;
+            s = s * cosStep + c * sinStep;
+            c = next;
+        }
+    }
+}
+
+// Evaluates the polynomial in t with the series as coefficients for the
+// n <= BatchSize times t0 + k * dt.
+void
+EvaluateSeriesBatch(const VSOPSeries* series, std::size_t nSeries,
+                    double t0, double dt, std::size_t n, double* values)
+{
+    std::array<double, BatchSize> sums;
+    std::array<double, BatchSize> T;
+    std::fill_n(values, n, 0.0);
+    std::fill_n(T.begin(), n, 1.0);
+
+    for (std::size_t i = 0; i < nSeries; i++)
+    {
+        std::fill_n(sums.begin(), n, 0.0);
+        SumSeriesBatch(series[i], t0, dt, n, sums.data());
+        for (std::size_t k = 0; k < n; k++)
+        {
+            values[k] += sums[k] * T[k];
+            T[k] *= t0 + static_cast<double>(k) * dt;
+        }
+    }
+}
+
+// Calls func(t0, dt, first, n) for each batch of the count times
+// startTime + i * step, with the times converted to the series argument
+template<typename F>
+void
+ForEachBatch(double startTime, double step, std::size_t count, F func)
+{
+    for (std::size_t first = 0; first < count; first += BatchSize)
+    {
+        func(toMillenia(startTime + static_cast<double>(first) * step),
+             step / 365250.0,
+             first,
+             std::min(BatchSize, count - first));
+    }
+}
+
+// Convert heliocentric spherical coordinates to Celestia's internal
+// coordinate system
+Eigen::Vector3d
+SphericalToPosition(double l, double b, double r)
+{
+    r *= astro::KM_PER_AU<double>;
+
+    // Corrections for internal coordinate system
+    b -= celestia::numbers::pi / 2;
+    l += celestia::numbers::pi;
+
+    return Eigen::Vector3d(std::cos(l) * std::sin(b) * r,
+                           std::cos(b) * r,
+                           -std::sin(l) * std::sin(b) * r);
+}
+
+Eigen::Vector3d
+RectangularToPosition(double x, double y, double z)
+{
+    Eigen::Vector3d v = Eigen::Vector3d(x, y, z) * astro::KM_PER_AU<double>;
+
+    // Corrections for internal coordinate system
+    return Eigen::Vector3d(v.x(), v.z(), -v.y());
+}
+
 class VSOP87Orbit : public CachingOrbit
 {
  private:
@@ -11058,8 +11159,7 @@ class VSOP87Orbit : public CachingOrbit
     Eigen::Vector3d
     computePosition(double jd) const override
     {
-        // t is Julian millenia since J2000.0
-        double t = (jd - 2451545.0) / 365250.0;
+        double t = toMillenia(jd);
 
         // Heliocentric coordinates
         double l = 0.0; // longitude
@@ -11093,37 +11193,58 @@ class VSOP87Orbit : public CachingOrbit
             T = t * T;
         }
 
-        r *= astro::KM_PER_AU<double>;
-
-        // Corrections for internal coordinate system
-        b -= celestia::numbers::pi / 2;
-        l += celestia::numbers::pi;
+        return SphericalToPosition(l, b, r);
+    }
 
-        return Eigen::Vector3d(std::cos(l) * std::sin(b) * r,
-                               std::cos(b) * r,
-                               -std::sin(l) * std::sin(b) * r);
+    void
+    positionsAtTimes(double startTime, double step,
+                     Eigen::Vector3d* positions, std::size_t count) const override
+    {
+        ForEachBatch(startTime, step, count,
+                     [&](double t0, double dt, std::size_t first, std::size_t n)
+                     {
+                         std::array<double, BatchSize> l;
+                         std::array<double, BatchSize> b;
+                         std::array<double, BatchSize> r;
+                         EvaluateSeriesBatch(vsL, nL, t0, dt, n, l.data());
+                         EvaluateSeriesBatch(vsB, nB, t0, dt, n, b.data());
+                         EvaluateSeriesBatch(vsR, nR, t0, dt, n, r.data());
+                         for (std::size_t k = 0; k < n; k++)
+                             positions[first + k] = SphericalToPosition(l[k], b[k], r[k]);
+                     });
     }
 
 
     /** Custom implementation of sample() for VSOP87 orbits. The default
       * implementation runs too slowly and produces too many samples.
+      * Samples are evenly spaced, so positions are computed in batches;
+      * velocities are differentiated like computeVelocity() does.
       */
     void
     sample(double startTime, double endTime, OrbitSampleProc& proc) const override
     {
-        double span = getPeriod();
+        constexpr double velocityDelta = 1.0 / 1440.0;
+        double step = getPeriod() / 150.0;
 
-        AdaptiveSamplingParameters samplingParams{};
-        samplingParams.tolerance = 1.0; // kilometers
+        std::size_t count = 1;
+        while (startTime + static_cast<double>(count) * step < endTime)
+            ++count;
 
-        // startStep, minStep, and maxStep are all set to identical values,
-        // so the adaptive sampling function actuall behaves like uniform
-        // sampling.
-        samplingParams.startStep = span / 150.0;
-        samplingParams.minStep   = samplingParams.startStep;
-        samplingParams.maxStep   = samplingParams.startStep;
+        std::vector<Eigen::Vector3d> positions(count);
+        std::vector<Eigen::Vector3d> nextPositions(count);
+        positionsAtTimes(startTime, step, positions.data(), count);
+        positionsAtTimes(startTime + velocityDelta, step, nextPositions.data(), count);
 
-        adaptiveSample(startTime, endTime, proc, samplingParams);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            proc.sample(startTime + static_cast<double>(i) * step,
+                        positions[i],
+                        (nextPositions[i] - positions[i]) * (1.0 / velocityDelta));
+        }
+
+        // The last sample is at the end of the range
+        if (endTime > startTime)
+            proc.sample(endTime, positionAtTime(endTime), velocityAtTime(endTime));
     }
 };
 
@@ -11178,8 +11299,7 @@ class VSOP87OrbitRect : public CachingOrbit
     Eigen::Vector3d
     computePosition(double jd) const override
     {
-        // t is Julian millenia since J2000.0
-        double t = (jd - 2451545.0) / 365250.0;
+        double t = toMillenia(jd);
 
         Eigen::Vector3d v(Eigen::Vector3d::Zero());
 
@@ -11210,10 +11330,25 @@ class VSOP87OrbitRect : public CachingOrbit
             T = t * T;
         }
 
-        v *= astro::KM_PER_AU<double>;
+        return RectangularToPosition(v.x(), v.y(), v.z());
+    }
 
-        // Corrections for internal coordinate system
-        return Eigen::Vector3d(v.x(), v.z(), -v.y());
+    void
+    positionsAtTimes(double startTime, double step,
+                     Eigen::Vector3d* positions, std::size_t count) const override
+    {
+        ForEachBatch(startTime, step, count,
+                     [&](double t0, double dt, std::size_t first, std::size_t n)
+                     {
+                         std::array<double, BatchSize> x;
+                         std::array<double, BatchSize> y;
+                         std::array<double, BatchSize> z;
+                         EvaluateSeriesBatch(vsX, nX, t0, dt, n, x.data());
+                         EvaluateSeriesBatch(vsY, nY, t0, dt, n, y.data());
+                         EvaluateSeriesBatch(vsZ, nZ, t0, dt, n, z.data());
+                         for (std::size_t k = 0; k < n; k++)
+                             positions[first + k] = RectangularToPosition(x[k], y[k], z[k]);
+                     });
     }
 };
 
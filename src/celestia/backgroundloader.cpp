@@ -0,0 +1,144 @@
+// backgroundloader.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "backgroundloader.h"
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include <celengine/asterism.h>
+#include <celengine/boundaries.h>
+#include <celengine/dsodb.h>
+#include <celengine/stardb.h>
+#include <celengine/starname.h>
+#include <celengine/starpack.h>
+#include <celengine/universe.h>
+#include <celestia/configfile.h>
+#include <celestia/loaddso.h>
+#include <celestia/loadsso.h>
+#include <celestia/loadstars.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#include <celutil/threadpool.h>
+#include <celutil/timer.h>
+
+namespace celestia
+{
+
+BackgroundLoader::BackgroundLoader(Work&& work)
+{
+    // Started last, once the members it uses are constructed
+    m_thread = std::thread([this, work = std::move(work)]()
+    {
+        work([this](Step&& step) { post(std::move(step)); });
+
+        std::scoped_lock lock(m_mutex);
+        m_finished = true;
+    });
+}
+
+BackgroundLoader::~BackgroundLoader()
+{
+    m_thread.join();
+}
+
+void
+BackgroundLoader::post(Step&& step)
+{
+    std::scoped_lock lock(m_mutex);
+    m_steps.push_back(std::move(step));
+}
+
+bool
+BackgroundLoader::apply(double budget)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (;;)
+    {
+        Step step;
+        {
+            std::scoped_lock lock(m_mutex);
+            if (m_steps.empty())
+                return !m_finished;
+
+            step = std::move(m_steps.front());
+            m_steps.pop_front();
+        }
+
+        step();
+
+        if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= budget)
+        {
+            std::scoped_lock lock(m_mutex);
+            return !m_finished || !m_steps.empty();
+        }
+    }
+}
+
+std::unique_ptr<BackgroundLoader>
+loadCatalogsInBackground(const CelestiaConfig &config, Universe *universe)
+{
+    // Steps capture their data by shared pointer since std::function needs
+    // copyable targets
+    return std::make_unique<BackgroundLoader>([&config, universe](const BackgroundLoader::PostFunction& post)
+    {
+        Timer timer;
+        // The main thread's loops take over the shared pool while it draws
+        util::ThreadPool::setThreadPriority(util::ThreadPool::Priority::Background);
+        util::ThreadPool& pool = util::ThreadPool::shared();
+        std::unique_ptr<engine::StarDataPack> starDataPack = openStarDataPack(config);
+
+        const std::pair<StarCatalog, const fs::path*> crossIndexFiles[] =
+        {
+            { StarCatalog::HenryDraper, &config.paths.HDCrossIndexFile },
+            { StarCatalog::SAO,         &config.paths.SAOCrossIndexFile },
+        };
+        for (const auto& [catalog, path] : crossIndexFiles)
+        {
+            auto xindex = std::make_shared<StarNameDatabase::CrossIndex>();
+            if (!readCrossIndex(catalog, *path, *xindex, starDataPack.get()))
+                continue;
+
+            post([universe, catalog = catalog, xindex]()
+            {
+                universe->getStarCatalog()->getNameDatabase()->setCrossIndex(catalog, std::move(*xindex));
+            });
+        }
+
+        auto finishDSO = stageDSO(config, pool);
+        post([universe, finishDSO]() { universe->setDSOCatalog(finishDSO()); });
+
+        for (auto& commit : stageExtraSSO(config, universe, pool))
+            post(std::move(commit));
+
+        // The stars are looked up by the step, since the main thread is
+        // using the database
+        if (auto asterisms = std::make_shared<std::vector<AsterismDefinition>>();
+            readAsterisms(config.paths.asterismsFile, *asterisms, starDataPack.get()))
+        {
+            post([universe, asterisms]()
+            {
+                universe->setAsterisms(ResolveAsterismList(*asterisms, *universe->getStarCatalog()));
+            });
+        }
+
+        if (auto boundaries = std::make_shared<std::unique_ptr<ConstellationBoundaries>>(
+                readBoundaries(config.paths.boundariesFile, starDataPack.get()));
+            *boundaries != nullptr)
+        {
+            post([universe, boundaries]() { universe->setBoundaries(std::move(*boundaries)); });
+        }
+
+        double readTime = timer.getTime();
+        post([readTime]() { util::GetLogger()->info(_("Catalogs read in the background in {:.3f} s\n"), readTime); });
+    });
+}
+
+} // end namespace celestia
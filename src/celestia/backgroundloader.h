@@ -0,0 +1,67 @@
+// backgroundloader.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Loading of catalogs while the first frames are drawn.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class Universe;
+struct CelestiaConfig;
+
+namespace celestia
+{
+
+// Runs work on a thread of its own. The work must not touch anything that
+// is used elsewhere; it hands its results over as steps, which apply() runs
+// on the calling thread between frames in the order they were posted.
+class BackgroundLoader
+{
+public:
+    using Step = std::function<void()>;
+    using PostFunction = std::function<void(Step&&)>;
+    using Work = std::function<void(const PostFunction&)>;
+
+    explicit BackgroundLoader(Work&& work);
+    // Waits for the work to finish; steps that haven't been applied are
+    // dropped
+    ~BackgroundLoader();
+
+    BackgroundLoader(const BackgroundLoader&) = delete;
+    BackgroundLoader& operator=(const BackgroundLoader&) = delete;
+
+    // Runs the steps posted so far until budget seconds have passed, but at
+    // least one if there are any. Returns false once the work has finished
+    // and all of its steps have been run.
+    bool apply(double budget);
+
+private:
+    void post(Step&&);
+
+    std::mutex m_mutex;
+    std::deque<Step> m_steps;
+    bool m_finished{ false };
+    std::thread m_thread;
+};
+
+// Starts reading the catalogs that initSimulation leaves out when
+// BackgroundLoading is set: the star cross indices, the deep sky catalogs,
+// the solar systems of the extras directories, asterisms and constellation
+// boundaries. They are added to universe by the steps of the returned
+// loader, in this order, so that asterisms can refer to stars by their
+// cross index numbers. config must outlive the loader.
+std::unique_ptr<BackgroundLoader> loadCatalogsInBackground(const CelestiaConfig &config,
+                                                           Universe             *universe);
+
+} // end namespace celestia
@@ -10,22 +10,40 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
 #include <fstream>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include <celengine/stagedcatalog.h>
 #include <celestia/progressnotifier.h>
 #include <celutil/array_view.h>
 #include <celutil/filetype.h>
 #include <celutil/fsutils.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/threadpool.h>
+#include <celutil/trace.h>
 
 namespace celestia
 {
 
 template<class OBJDB> class CatalogLoader
 {
+public:
+    // A file read by stageFiles, to be added to the database by commit
+    struct StagedFile
+    {
+        fs::path path;
+        std::unique_ptr<engine::StagedCatalog> catalog;
+    };
+
+protected:
     OBJDB                     *m_objDB;
+
+private:
     std::string                m_typeDesc;
     ContentType                m_contentType;
     ProgressNotifier          *m_notifier;
@@ -45,38 +63,97 @@ public:
     {
     }
 
+    virtual ~CatalogLoader() = default;
+
     bool load(std::istream &in, const fs::path &dir)
     {
         return m_objDB->load(in, dir);
     }
 
+    virtual bool loadFile(const fs::path &filePath, const fs::path &dir)
+    {
+        std::ifstream catalogFile(filePath);
+        return catalogFile.good() && load(catalogFile, dir);
+    }
+
+    // Reads a file without changing the database; called from several
+    // threads at once. Returns nullptr if the file can't be opened.
+    virtual std::unique_ptr<engine::StagedCatalog> stageFile(const fs::path &filePath, const fs::path &dir)
+    {
+        std::ifstream catalogFile(filePath);
+        if (!catalogFile.good())
+            return nullptr;
+        return m_objDB->stage(catalogFile, dir);
+    }
+
     void process(const fs::path &filePath, const fs::path &parentPath)
     {
-        if (DetermineFileType(filePath) != m_contentType)
+        if (!accept(filePath))
             return;
 
-        if (std::find(std::begin(m_skipPaths), std::end(m_skipPaths), filePath)
-            != std::end(m_skipPaths))
-        {
-            util::GetLogger()->info(_("Skipping {} catalog: {}\n"), m_typeDesc, filePath);
-            return;
-        }
-        util::GetLogger()->info(_("Loading {} catalog: {}\n"), m_typeDesc, filePath);
-        if (m_notifier != nullptr)
-            m_notifier->update(filePath.filename().string());
+        report(filePath);
+        util::TraceScope trace("CatalogLoader::loadFile");
+        if (!loadFile(filePath, parentPath))
+            reportError(filePath);
+    }
+
+    void loadExtras(util::array_view<fs::path> dirs)
+    {
+        for (StagedFile &file : stageFiles({}, dirs, util::ThreadPool::shared()))
+            commit(file);
+    }
 
-        if (std::ifstream catalogFile(filePath);
-            !catalogFile.good() || !load(catalogFile, parentPath))
+    // Reads the files listed in files, then those in the extras directories
+    // dirs, without changing the database. The files are read on pool, and
+    // this may be called from any thread. Committing the result in order
+    // gives the same database as processing the files and then calling
+    // loadExtras.
+    std::vector<StagedFile> stageFiles(util::array_view<fs::path> files,
+                                       util::array_view<fs::path> dirs,
+                                       util::ThreadPool          &pool)
+    {
+        std::vector<StagedFile> staged;
+        for (const fs::path &file : files)
         {
-            util::GetLogger()->error(_("Error reading {} catalog file: {}\n"),
-                                     m_typeDesc,
-                                     filePath);
+            if (accept(file))
+                staged.push_back({ file, nullptr });
         }
+        std::size_t nListed = staged.size();
+
+        for (const fs::path &file : findExtras(dirs))
+            staged.push_back({ file, nullptr });
+
+        // Reading the files is independent of the database, so it is done
+        // on all threads. Their objects are then added in path order, which
+        // keeps overrides between add-ons the same as in a serial load.
+        pool.parallelFor(staged.size(),
+                         [&](std::size_t i, unsigned int /* worker */)
+                         {
+                             // Files listed individually are not relative to
+                             // their directory
+                             fs::path dir = i < nListed ? fs::path() : staged[i].path.parent_path();
+                             util::TraceScope trace("CatalogLoader::stageFile");
+                             staged[i].catalog = stageFile(staged[i].path, dir);
+                         });
+
+        return staged;
     }
 
-    void loadExtras(util::array_view<fs::path> dirs)
+    // Adds the objects of a staged file to the database and releases it
+    void commit(StagedFile &file)
+    {
+        report(file.path);
+        util::TraceScope trace("CatalogLoader::commit");
+        if (file.catalog == nullptr || !file.catalog->commit())
+            reportError(file.path);
+        file.catalog.reset();
+    }
+
+private:
+    std::vector<fs::path> findExtras(util::array_view<fs::path> dirs) const
     {
         std::vector<fs::path> entries;
+        std::vector<fs::path> files;
         std::error_code       ec;
         for (const auto &dir : dirs)
         {
@@ -96,9 +173,40 @@ public:
 
             std::sort(std::begin(entries), std::end(entries));
 
-            for (const auto &fn : entries)
-                process(fn, fn.parent_path());
+            std::copy_if(std::begin(entries), std::end(entries), std::back_inserter(files),
+                         [this](const fs::path &fn) { return accept(fn); });
+        }
+
+        return files;
+    }
+
+    bool accept(const fs::path &filePath) const
+    {
+        if (DetermineFileType(filePath) != m_contentType)
+            return false;
+
+        if (std::find(std::begin(m_skipPaths), std::end(m_skipPaths), filePath)
+            != std::end(m_skipPaths))
+        {
+            util::GetLogger()->info(_("Skipping {} catalog: {}\n"), m_typeDesc, filePath);
+            return false;
         }
+
+        return true;
+    }
+
+    void report(const fs::path &filePath) const
+    {
+        util::GetLogger()->info(_("Loading {} catalog: {}\n"), m_typeDesc, filePath);
+        if (m_notifier != nullptr)
+            m_notifier->update(filePath.filename().string());
+    }
+
+    void reportError(const fs::path &filePath) const
+    {
+        util::GetLogger()->error(_("Error reading {} catalog file: {}\n"),
+                                 m_typeDesc,
+                                 filePath);
     }
 };
 
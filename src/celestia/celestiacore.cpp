@@ -16,6 +16,7 @@
 #include "celestiacore.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <cstdlib>
 #include <cctype>
@@ -28,8 +29,10 @@
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <memory>
 #include <set>
+#include <thread>
 
 #include <Eigen/Geometry>
 #include <fmt/ostream.h>
@@ -47,27 +50,41 @@
 #include <celengine/boundaries.h>
 #include <celengine/console.h>
 #include <celengine/framebuffer.h>
+#include <celengine/fisheyecubemap.h>
 #include <celengine/fisheyeprojectionmode.h>
 #include <celengine/location.h>
 #include <celengine/mapmanager.h>
+#include <celengine/meshmanager.h>
 #include <celengine/multitexture.h>
 #include <celengine/overlay.h>
 #include <celengine/perspectiveprojectionmode.h>
+#include <celengine/pickbuffer.h>
 #include <celengine/planetgrid.h>
 #include <celengine/starname.h>
+#include <celengine/tiledprojectionmode.h>
+#include <celengine/starpack.h>
+#include <celengine/texmanager.h>
 #include <celengine/textlayout.h>
+#include <celengine/textureresidency.h>
 #include <celengine/rectangle.h>
 #include <celengine/visibleregion.h>
+#include <celestia/backgroundloader.h>
+#include <celestia/clustersync.h>
 #include <celestia/configfile.h>
 #include <celestia/favorites.h>
 #include <celestia/loaddso.h>
 #include <celestia/loadsso.h>
 #include <celestia/loadstars.h>
 #include <celestia/progressnotifier.h>
+#include <celestia/remotecontrol.h>
+#include <celestia/resolutionscaler.h>
+#include <celestia/startupprofile.h>
 #include <celestia/textprintposition.h>
 #include <celestia/viewmanager.h>
 #include <celestia/url.h>
+#include <celephem/samporbit.h>
 #include <celmath/geomutil.h>
+#include <celrender/gl/buffer.h>
 #include <celscript/legacy/execution.h>
 #include <celscript/legacy/cmdparser.h>
 #include <celttf/truetypefont.h>
@@ -76,6 +93,9 @@
 #include <celutil/fsutils.h>
 #include <celutil/logger.h>
 #include <celutil/gettext.h>
+#include <celutil/pendingloads.h>
+#include <celutil/threadpool.h>
+#include <celutil/trace.h>
 #include <celutil/utf8.h>
 
 #ifdef USE_MINIAUDIO
@@ -107,6 +127,15 @@ constexpr float RotationBraking = 10.0f;
 constexpr float RotationDecay = 2.0f;
 constexpr double MaximumTimeRate = 1.0e15;
 constexpr auto stdFOV = static_cast<float>(45.0_deg);
+// Time per frame spent adding catalogs loaded in the background, in seconds
+constexpr double BackgroundLoadFrameBudget = 0.005;
+// Time per frame spent finding the objects of favorites, in seconds
+constexpr double FavoritesResolveFrameBudget = 0.002;
+// Minimum time in seconds between traces written for slow frames. The first
+// interval after startup is also skipped since its frames are always slow.
+constexpr double TraceWriteInterval = 10.0;
+// Frames drawn after the id pass of a click before its result is waited for
+constexpr int MaxPickFrames = 3;
 static float KeyRotationAccel = 120.0_deg;
 static float MouseRotationSensitivity = 1.0_deg;
 
@@ -214,9 +243,16 @@ CelestiaCore::CelestiaCore() :
 
 CelestiaCore::~CelestiaCore()
 {
+    // The loading thread logs, so it has to finish before the logger goes
+    backgroundLoader = nullptr;
+    // Write out the queued messages while the log file is still open
+    GetLogger()->stopAsync();
+
     if (movieCapture != nullptr)
         recordEnd();
 
+    writeTrace();
+
     delete timer;
     delete renderer;
 
@@ -290,10 +326,31 @@ void CelestiaCore::activateFavorite(FavoritesEntry& fav)
     sim->setTime(fav.jd);
     sim->setObserverPosition(fav.position);
     sim->setObserverOrientation(fav.orientation);
-    sim->setSelection(sim->findObjectFromPath(fav.selectionName));
+    sim->setSelection(resolveFavorite(fav));
     sim->setFrame(fav.coordSys, sim->getSelection());
 }
 
+Selection CelestiaCore::resolveFavorite(FavoritesEntry& fav)
+{
+    if (!fav.selection.empty() || fav.isFolder || fav.selectionName.empty())
+        return fav.selection;
+
+    // Only names that don't depend on the current selection are kept;
+    // objects are never removed, but those of catalogs that are still
+    // being loaded may turn up later
+    fav.selection = universe->findPath(fav.selectionName, {});
+    if (!fav.selection.empty())
+        return fav.selection;
+
+    return sim->findObjectFromPath(fav.selectionName);
+}
+
+void CelestiaCore::resolveFavorites()
+{
+    if (favorites != nullptr && !favorites->empty())
+        favoriteToResolve = 0;
+}
+
 void CelestiaCore::addFavorite(const string &name, const string &parentFolder, FavoritesList::iterator* iter)
 {
     FavoritesList::iterator pos;
@@ -321,6 +378,7 @@ void CelestiaCore::addFavorite(const string &name, const string &parentFolder, F
     else
         return;
 
+    fav->selection = sel;
     fav->coordSys = sim->getFrame()->getCoordinateSystem();
 
     favorites->insert(pos, std::move(fav));
@@ -381,6 +439,24 @@ void CelestiaCore::cancelScript()
 }
 
 
+bool CelestiaCore::isScriptRunning() const
+{
+    return m_script != nullptr;
+}
+
+
+void CelestiaCore::setScriptTimeStepped(bool stepped)
+{
+    scriptTimeStepped = stepped;
+}
+
+
+bool CelestiaCore::getScriptTimeStepped() const
+{
+    return scriptTimeStepped;
+}
+
+
 void CelestiaCore::runScript(const fs::path& filename, bool i18n)
 {
     cancelScript();
@@ -442,6 +518,66 @@ void CelestiaCore::mouseButtonDown(float x, float y, int button)
         viewManager->tryStartResizing(metrics, x, y);
 }
 
+Selection CelestiaCore::pickObject(const Eigen::Vector3f& pickRay, float tolerance) const
+{
+    // The render list can be used when the last frame drawn was that of
+    // the active view; with several views it may belong to another one
+    util::array_view<RenderListEntry> rendered;
+    if (renderer->getRenderListObserver() == sim->getActiveObserver())
+        rendered = renderer->getRenderList();
+
+    return sim->pickObject(pickRay, renderer->getRenderFlags(), tolerance, rendered);
+}
+
+void CelestiaCore::applyPick(const Selection& sel, int button, float x, float y)
+{
+    if (button == LeftButton)
+    {
+        Selection oldSel = sim->getSelection();
+        addToHistory();
+        sim->setSelection(sel);
+        if (!oldSel.empty() && oldSel == sel)
+            sim->centerSelection();
+    }
+    else if (!sel.empty() && contextMenuHandler != nullptr)
+    {
+        contextMenuHandler->requestContextMenu(x, y, sel);
+    }
+}
+
+void CelestiaCore::updatePick()
+{
+    // The ids are drawn after the frame following the click and read back
+    // while the next frames are drawn
+    PendingPick& pick = *pendingPick;
+    std::optional<Selection> sel;
+    if (pick.frames == 0)
+    {
+        const Observer* observer = sim->getActiveObserver();
+        if (renderer->getRenderListObserver() != observer ||
+            !pickBuffer->render(*renderer, *observer, pick.direction, pick.pixelAngle))
+        {
+            sel = Selection();
+        }
+    }
+    else
+    {
+        sel = pickBuffer->takeResult(pick.frames >= MaxPickFrames);
+    }
+    ++pick.frames;
+
+    if (!sel.has_value())
+        return;
+
+    // Objects smaller than a pixel are usually missed by the id pass
+    if (sel->empty())
+        sel = pickObject(pick.pickRay, pick.tolerance);
+
+    PendingPick done = pick;
+    pendingPick = std::nullopt;
+    applyPick(*sel, done.button, done.x, done.y);
+}
+
 void CelestiaCore::mouseButtonUp(float x, float y, int button)
 {
     dragLocation = std::nullopt;
@@ -469,28 +605,26 @@ void CelestiaCore::mouseButtonUp(float x, float y, int button)
     // mouse was dragged and ignore the event.
     if (mouseMotion < DragThreshold)
     {
-        if (button == LeftButton)
+        if (button == LeftButton || button == RightButton)
         {
-            viewManager->pickView(sim, metrics, x, y);
+            if (button == LeftButton)
+                viewManager->pickView(sim, metrics, x, y);
 
             Vector3f pickRay = getPickRay(x, y, viewManager->activeView());
 
-            Selection oldSel = sim->getSelection();
-            Selection newSel = sim->pickObject(pickRay, renderer->getRenderFlags(), obsPickTolerance);
-            addToHistory();
-            sim->setSelection(newSel);
-            if (!oldSel.empty() && oldSel == newSel)
-                sim->centerSelection();
-        }
-        else if (button == RightButton)
-        {
-            Eigen::Vector3f pickRay = getPickRay(x, y, viewManager->activeView());
-
-            Selection sel = sim->pickObject(pickRay, renderer->getRenderFlags(), obsPickTolerance);
-            if (!sel.empty())
+            if (pickBuffer != nullptr && !pendingPick.has_value())
             {
-                if (contextMenuHandler != nullptr)
-                    contextMenuHandler->requestContextMenu(x, y, sel);
+                // Picked when the next frame is drawn
+                const Observer* observer = sim->getActiveObserver();
+                pendingPick = PendingPick{ pickRay,
+                                           observer->getOrientationf().conjugate() * pickRay,
+                                           obsPickTolerance,
+                                           observer->getFOV() / static_cast<float>(metrics.height),
+                                           x, y, button };
+            }
+            else
+            {
+                applyPick(pickObject(pickRay, obsPickTolerance), button, x, y);
             }
         }
         else if (button == MiddleButton)
@@ -1558,7 +1692,21 @@ void CelestiaCore::charEntered(const char *c_p, int modifiers)
         break;
 
     case '`':
-        hud->hudSettings().showFPSCounter = !hud->hudSettings().showFPSCounter;
+        // Cycle between no counter, the FPS counter, and the FPS counter
+        // with render pass times
+        if (!hud->hudSettings().showFPSCounter)
+        {
+            hud->hudSettings().showFPSCounter = true;
+        }
+        else if (!renderer->isProfilingEnabled())
+        {
+            renderer->setProfilingEnabled(true);
+        }
+        else
+        {
+            hud->hudSettings().showFPSCounter = false;
+            renderer->setProfilingEnabled(false);
+        }
         break;
 
     case '{':
@@ -1727,6 +1875,54 @@ void CelestiaCore::setStartURL(const string &url)
     }
 }
 
+// Adds the catalogs that are still being read in the background right away
+// instead of spreading them over the next frames
+void CelestiaCore::finishBackgroundLoading()
+{
+    while (backgroundLoader != nullptr)
+    {
+        if (!backgroundLoader->apply(std::numeric_limits<double>::infinity()))
+            backgroundLoader = nullptr;
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void CelestiaCore::setOfflineRendering(bool offline)
+{
+    offlineRendering = offline;
+    setScriptTimeStepped(offline);
+}
+
+bool CelestiaCore::getOfflineRendering() const
+{
+    return offlineRendering;
+}
+
+// Draws the views until none of the resources they use is still being
+// loaded in the background, so that nothing is left out of the frame or
+// drawn at a lower level of detail. Returns false if the loads didn't
+// finish within timeout seconds; the frame is drawn anyway.
+bool CelestiaCore::drawUntilLoaded(double timeout)
+{
+    finishBackgroundLoading();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+    for (;;)
+    {
+        draw();
+        if (celestia::util::GetPendingLoadCount() == 0)
+            return true;
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            GetLogger()->warn("Resources still loading after {} s, drawing the frame without them\n", timeout);
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+
 void CelestiaCore::tick()
 {
     tick(timer->getTime() - sysTime);
@@ -1734,6 +1930,52 @@ void CelestiaCore::tick()
 
 void CelestiaCore::tick(double dt)
 {
+    // The previous frame is still in the trace when the spike is noticed.
+    // Writing the trace takes a while, so don't write it for every frame
+    // of a slow stretch.
+    if (config != nullptr && config->traceSpikeThreshold > 0.0f
+        && dt * 1000.0 > config->traceSpikeThreshold
+        && sysTime - lastTraceWrite >= TraceWriteInterval
+        && writeTrace())
+    {
+        GetLogger()->info(_("Frame took {:.0f} ms, trace written to {}\n"), dt * 1000.0, config->paths.traceFile);
+        lastTraceWrite = sysTime;
+    }
+
+    if (config != nullptr && config->memoryReportInterval > 0.0f
+        && sysTime - lastMemoryReport >= config->memoryReportInterval)
+    {
+        getMemoryReport().log();
+        lastMemoryReport = sysTime;
+    }
+
+    TraceScope trace("CelestiaCore::tick");
+
+    // Catalogs read in the background are added between frames, taking up
+    // a few milliseconds of each
+    if (backgroundLoader != nullptr && !backgroundLoader->apply(BackgroundLoadFrameBudget))
+        backgroundLoader = nullptr;
+
+    // The same for the objects of favorites once they are shown in a menu
+    if (favoriteToResolve.has_value())
+    {
+        double resolveStart = timer->getTime();
+        do
+        {
+            if (*favoriteToResolve >= favorites->size())
+            {
+                favoriteToResolve = std::nullopt;
+                break;
+            }
+            resolveFavorite(*(*favorites)[(*favoriteToResolve)++]);
+        } while (timer->getTime() - resolveStart < FavoritesResolveFrameBudget);
+    }
+
+    // Commands of show control systems are handled before the simulation
+    // is updated, so that they take effect in this frame
+    if (remoteControl != nullptr)
+        remoteControl->poll(*this);
+
     sysTime += dt;
 
     // The time step is normally driven by the system clock; however, when
@@ -1907,16 +2149,21 @@ void CelestiaCore::tick(double dt)
     // If there's a script running, tick it
     if (m_script != nullptr)
     {
+        m_script->dispatchEvents();
         m_script->handleTickEvent(dt);
         if (scriptState == ScriptRunning)
         {
+            TraceScope scriptTrace("Script::tick");
             bool finished = m_script->tick(dt);
             if (finished)
                 cancelScript();
         }
     }
     if (m_scriptHook != nullptr)
+    {
+        m_scriptHook->dispatchEvents();
         m_scriptHook->call("tick", dt);
+    }
 
     sim->update(dt);
 }
@@ -1924,17 +2171,66 @@ void CelestiaCore::tick(double dt)
 
 void CelestiaCore::draw()
 {
-    if (!viewUpdateRequired())
+    if (!rendererInitialized || !viewUpdateRequired())
         return;
 
+    TraceScope trace("CelestiaCore::draw");
+
+    if (clusterSync != nullptr)
+    {
+        if (clusterSync->role() == ClusterSync::Role::Master)
+            sendClusterFrame();
+        else
+            receiveClusterFrame();
+    }
+
     // Render each view
+    bool adaptResolution = resolutionScaler != nullptr && !offlineRendering;
+    if (adaptResolution)
+        resolutionScaler->beginFrame();
+    // Offline frames are always drawn at full detail
+    renderer->setDetailReduction(adaptResolution ? resolutionScaler->getDetailReduction() : 0);
+
+    // With split views, find the visible stars of all of them at once on
+    // the worker threads, which leaves only drawing to the loop below. The
+    // viewport effects and the cube map fisheye change the view while it
+    // is drawn, so they get nothing from this.
+    bool precull = viewManager->views().size() > 1 &&
+                   viewportEffect == nullptr &&
+                   fisheyeCubeMap == nullptr &&
+                   sim->getUniverse()->getStarCatalog() != nullptr;
+    if (precull)
+    {
+        std::vector<Renderer::PrecullView> precullViews;
+        for (const auto view : viewManager->views())
+        {
+            if (view->type != View::ViewWindow)
+                continue;
+
+            const Observer* observer = view->isRootView() ? &sim->getObserver() : view->observer;
+            precullViews.push_back({ observer,
+                                     static_cast<int>(view->width * static_cast<float>(metrics.width)),
+                                     static_cast<int>(view->height * static_cast<float>(metrics.height)) });
+        }
+        renderer->precullStars(*sim->getUniverse()->getStarCatalog(), precullViews, sim->getFaintestVisible());
+    }
+
     for (const auto view : viewManager->views())
         draw(view);
 
+    if (precull)
+        renderer->discardPrecull();
+
+    if (adaptResolution)
+        resolutionScaler->endFrame();
+
     // Reset to render to the main window
     if (viewManager->views().size() > 1)
         renderer->setRenderRegion(0, 0, metrics.width, metrics.height, false);
 
+    if (pendingPick.has_value())
+        updatePick();
+
     bool toggleAA = renderer->isMSAAEnabled();
     if (toggleAA && (renderer->getRenderFlags() & Renderer::ShowCloudMaps))
         renderer->disableMSAA();
@@ -1956,6 +2252,11 @@ void CelestiaCore::draw()
     if (movieCapture != nullptr && recording)
         movieCapture->captureFrame();
 
+    // Hold the frame until every node has drawn it, so that the front end
+    // swaps the buffers of the whole wall together
+    if (clusterSync != nullptr)
+        clusterSync->swapBarrier();
+
     // Frame rate counter
     nFrames++;
     if (nFrames == 100 || sysTime - fpsCounterStartTime > 10.0)
@@ -1967,6 +2268,51 @@ void CelestiaCore::draw()
 }
 
 
+void CelestiaCore::sendClusterFrame()
+{
+    const Observer& observer = sim->getObserver();
+
+    ClusterFrame frame;
+    frame.time = sim->getTime();
+    frame.position = observer.getPosition();
+    frame.orientation = observer.getOrientation();
+    frame.fov = observer.getFOV();
+    frame.faintestVisible = sim->getFaintestVisible();
+    frame.renderFlags = renderer->getRenderFlags();
+    frame.labelMode = static_cast<std::int32_t>(renderer->getLabelMode());
+    frame.orbitMask = static_cast<std::uint32_t>(renderer->getOrbitMask());
+    frame.selection = sim->getSelection().id();
+    clusterSync->sendFrame(frame);
+}
+
+void CelestiaCore::receiveClusterFrame()
+{
+    ClusterFrame frame;
+    if (!clusterSync->receiveFrame(frame))
+        return;
+
+    sim->setTime(frame.time);
+    sim->setObserverPosition(frame.position);
+    Observer& observer = sim->getObserver();
+    observer.setOrientation(frame.orientation);
+    observer.setFOV(frame.fov);
+    setZoomFromFOV();
+
+    if (frame.faintestVisible != sim->getFaintestVisible())
+        setFaintest(frame.faintestVisible);
+    renderer->setRenderFlags(frame.renderFlags);
+    renderer->setLabelMode(static_cast<int>(frame.labelMode));
+    renderer->setOrbitMask(static_cast<BodyClassification>(frame.orbitMask));
+
+    // Only look up the selection when it changes
+    if (frame.selection != clusterSelection)
+    {
+        sim->setSelection(sim->getUniverse()->find(frame.selection));
+        clusterSelection = frame.selection;
+    }
+}
+
+
 void CelestiaCore::resize(GLsizei w, GLsizei h)
 {
     if (h == 0)
@@ -1993,29 +2339,72 @@ void CelestiaCore::draw(View* view)
 
     bool viewportEffectUsed = false;
 
+    auto x = static_cast<int>(view->x * static_cast<float>(metrics.width));
+    auto y = static_cast<int>(view->y * static_cast<float>(metrics.height));
+    auto viewWidth = static_cast<int>(view->width * static_cast<float>(metrics.width));
+    auto viewHeight = static_cast<int>(view->height * static_cast<float>(metrics.height));
+
+    auto renderScene = [this, view]
+    {
+        if (view->isRootView())
+            sim->render(*renderer);
+        else
+            sim->render(*renderer, *view->observer);
+    };
+
+    // Reduced resolution if adaptive resolution is on
+    float scale = resolutionScaler == nullptr || offlineRendering ? 1.0f : resolutionScaler->getScale();
+
+    // The viewport effect can sample the fisheye cube map directly, which
+    // saves resampling the fisheye into the FBO in a pass of its own
+    if (viewportEffect != nullptr && fisheyeCubeMap != nullptr)
+    {
+        if (fisheyeCubeMap->renderFaces(*renderer, static_cast<int>(static_cast<float>(viewHeight) * scale), renderScene))
+        {
+            renderer->setRenderRegion(x, y, viewWidth, viewHeight, !view->isRootView());
+            if (viewportEffect->renderCubeMap(renderer, *fisheyeCubeMap, viewWidth, viewHeight))
+                viewportEffectUsed = true;
+            else
+                GetLogger()->error("Unable to render viewport effect.\n");
+            isViewportEffectUsed = viewportEffectUsed;
+            return;
+        }
+
+        GetLogger()->error("Unable to render fisheye through a cube map.\n");
+        fisheyeCubeMap = nullptr;
+        renderer->getShaderManager().setFisheyeEnabled(true);
+    }
+
     FramebufferObject *fbo = nullptr;
     if (viewportEffect != nullptr)
     {
         // create/update FBO for viewport effect
-        view->updateFBO(metrics.width, metrics.height);
+        view->updateFBO(static_cast<int>(static_cast<float>(metrics.width) * scale),
+                        static_cast<int>(static_cast<float>(metrics.height) * scale));
         fbo = view->getFBO();
     }
     bool process = fbo != nullptr && viewportEffect->preprocess(renderer, fbo);
 
-    auto x = static_cast<int>(view->x * static_cast<float>(metrics.width));
-    auto y = static_cast<int>(view->y * static_cast<float>(metrics.height));
-    auto viewWidth = static_cast<int>(view->width * static_cast<float>(metrics.width));
-    auto viewHeight = static_cast<int>(view->height * static_cast<float>(metrics.height));
+    int renderWidth = process ? static_cast<int>(fbo->width()) : viewWidth;
+    int renderHeight = process ? static_cast<int>(fbo->height()) : viewHeight;
     // If we need to process, we draw to the FBO which starts at point zero
-    renderer->setRenderRegion(process ? 0 : x, process ? 0 : y, viewWidth, viewHeight, !view->isRootView());
+    renderer->setRenderRegion(process ? 0 : x, process ? 0 : y, renderWidth, renderHeight, !view->isRootView());
 
-    if (view->isRootView())
-        sim->render(*renderer);
-    else
-        sim->render(*renderer, *view->observer);
+    if (fisheyeCubeMap != nullptr &&
+        !fisheyeCubeMap->render(*renderer, process ? 0 : x, process ? 0 : y, renderWidth, renderHeight,
+                                !view->isRootView(), renderScene))
+    {
+        GetLogger()->error("Unable to render fisheye through a cube map.\n");
+        fisheyeCubeMap = nullptr;
+        renderer->getShaderManager().setFisheyeEnabled(true);
+    }
+
+    if (fisheyeCubeMap == nullptr)
+        renderScene();
 
     // Viewport need to be reset to start from (x,y) instead of point zero
-    if (process && (x != 0 || y != 0))
+    // and to cover the whole view, the effect stretches the FBO to fill it
+    if (process && (x != 0 || y != 0 || renderWidth != viewWidth || renderHeight != viewHeight))
         renderer->setRenderRegion(x, y, viewWidth, viewHeight);
 
     if (process && viewportEffect->prerender(renderer, fbo))
@@ -2192,6 +2581,11 @@ Renderer* CelestiaCore::getRenderer() const
     return renderer;
 }
 
+bool CelestiaCore::isRendererInitialized() const
+{
+    return rendererInitialized;
+}
+
 Simulation* CelestiaCore::getSimulation() const
 {
     return sim;
@@ -2230,7 +2624,7 @@ void CelestiaCore::renderOverlay()
     if (m_scriptHook != nullptr)
         m_scriptHook->call("renderoverlay");
 
-    hud->renderOverlay(metrics, sim, *viewManager, movieCapture, timeInfo, m_script != nullptr, editMode);
+    hud->renderOverlay(metrics, sim, *viewManager, movieCapture, renderer->getProfiler(), timeInfo, m_script != nullptr, editMode);
 }
 
 
@@ -2307,6 +2701,9 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
                                   const vector<fs::path>& extrasDirs,
                                   ProgressNotifier* progressNotifier)
 {
+    celestia::StartupProfile profile;
+    profile.beginPhase("configuration");
+
     config = std::make_unique<CelestiaConfig>();
     bool hasConfig = false;
     if (!configFileName.empty())
@@ -2336,10 +2733,19 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
         return false;
     }
 
+    if (!config->paths.traceFile.empty())
+        SetTracingEnabled(true);
+
     // Set the console log size; ignore any request to use less than 100 lines
     if (config->consoleLogRows > 100)
         console->setRowCount(config->consoleLogRows);
 
+    if (config->asyncLogging)
+        GetLogger()->startAsync();
+
+    if (config->workerThreads > 0)
+        util::ThreadPool::setSharedThreads(config->workerThreads);
+
     if (!config->paths.leapSecondsFile.empty())
         ReadLeapSecondsFile(config->paths.leapSecondsFile, leapSeconds);
 
@@ -2390,7 +2796,14 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
 
     StarDetails::SetStarTextures(config->starTextures);
 
-    std::unique_ptr<StarDatabase> starCatalog = loadStars(*config, progressNotifier);
+    // With background loading, only the stars and the solar systems of the
+    // configuration are loaded here, and the rest by backgroundLoader
+    std::unique_ptr<celestia::engine::StarDataPack> starDataPack = openStarDataPack(*config);
+    std::unique_ptr<StarDatabase> starCatalog = loadStars(*config,
+                                                          progressNotifier,
+                                                          &profile,
+                                                          !config->backgroundLoading,
+                                                          starDataPack.get());
     if (starCatalog == nullptr)
     {
         fatalError(_("Cannot read star database."), false);
@@ -2400,7 +2813,20 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
 
     /***** Load the deep sky catalogs *****/
 
-    std::unique_ptr<DSODatabase> dsoCatalog = loadDSO(*config, progressNotifier);
+    profile.beginPhase("deep sky catalogs");
+    std::unique_ptr<DSODatabase> dsoCatalog;
+    if (config->backgroundLoading)
+    {
+        // Stands in until the catalogs are read
+        dsoCatalog = std::make_unique<DSODatabase>();
+        dsoCatalog->setNameDatabase(std::make_unique<NameDatabase>());
+        dsoCatalog->finish();
+    }
+    else
+    {
+        dsoCatalog = loadDSO(*config, progressNotifier);
+    }
+
     if (dsoCatalog == nullptr)
     {
         fatalError(_("Cannot read DSO database."), false);
@@ -2410,27 +2836,33 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
 
     /***** Load the solar system catalogs *****/
 
-    loadSSO(*config, progressNotifier, universe);
-
-    // Load asterisms:
-    if (!config->paths.asterismsFile.empty())
-        loadAsterismsFile(config->paths.asterismsFile);
+    profile.beginPhase("solar system catalogs");
+    loadSSO(*config, progressNotifier, universe, !config->backgroundLoading);
 
-    if (!config->paths.boundariesFile.empty())
+    if (config->backgroundLoading)
     {
-        std::ifstream boundariesFile(config->paths.boundariesFile, ios::in);
-        if (!boundariesFile.good())
+        backgroundLoader = celestia::loadCatalogsInBackground(*config, universe);
+    }
+    else
+    {
+        // Load asterisms:
+        profile.beginPhase("asterisms");
+        if (std::vector<AsterismDefinition> asterisms;
+            readAsterisms(config->paths.asterismsFile, asterisms, starDataPack.get()))
         {
-            GetLogger()->error(_("Error opening constellation boundaries file {}.\n"),
-                               config->paths.boundariesFile);
+            universe->setAsterisms(ResolveAsterismList(asterisms, *universe->getStarCatalog()));
         }
-        else
+
+        profile.beginPhase("boundaries");
+        if (auto boundaries = readBoundaries(config->paths.boundariesFile, starDataPack.get());
+            boundaries != nullptr)
         {
-            universe->setBoundaries(ReadBoundaries(boundariesFile));
+            universe->setBoundaries(std::move(boundaries));
         }
     }
 
     // Load destinations list
+    profile.beginPhase("setup");
     if (!config->paths.destinationsFile.empty())
     {
         fs::path localeDestinationsFile = LocaleFilename(config->paths.destinationsFile);
@@ -2447,6 +2879,18 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
         projectionMode = std::make_shared<FisheyeProjectionMode>(static_cast<float>(metrics.width),
                                                                  static_cast<float>(metrics.height),
                                                                  metrics.screenDpi);
+        if (config->fisheyeCubeMap)
+            fisheyeCubeMap = std::make_unique<engine::FisheyeCubeMap>();
+    }
+    else if (compareIgnoringCase(config->cluster.mode, "node") == 0 && config->cluster.tile.size() == 4)
+    {
+        // The tile of the display wall drawn by this node
+        const auto& tile = config->cluster.tile;
+        projectionMode = std::make_shared<TiledProjectionMode>(static_cast<float>(metrics.width),
+                                                               static_cast<float>(metrics.height),
+                                                               distanceToScreen,
+                                                               metrics.screenDpi,
+                                                               engine::DisplayTile{ tile[0], tile[1], tile[2], tile[3] });
     }
     else
     {
@@ -2460,6 +2904,31 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
                                                                      metrics.screenDpi);
     }
     renderer->setProjectionMode(projectionMode);
+    // The cube map faces use the perspective projection
+    if (fisheyeCubeMap != nullptr)
+        renderer->getShaderManager().setFisheyeEnabled(false);
+
+    // The ids are drawn with the perspective projection
+    if (config->gpuPicking && (compareIgnoringCase(config->projectionMode, "fisheye") != 0 || fisheyeCubeMap != nullptr))
+        pickBuffer = std::make_unique<engine::PickBuffer>();
+
+    if (!config->cluster.mode.empty())
+    {
+        auto port = static_cast<std::uint16_t>(std::min(config->cluster.port, 65535U));
+        auto timeout = static_cast<int>(config->cluster.timeout);
+        if (compareIgnoringCase(config->cluster.mode, "master") == 0)
+            clusterSync = ClusterSync::createMaster(port, config->cluster.nodes, timeout);
+        else if (compareIgnoringCase(config->cluster.mode, "node") == 0)
+            clusterSync = ClusterSync::createNode(port, timeout);
+        else
+            GetLogger()->warn("Unknown cluster mode {}\n", config->cluster.mode);
+    }
+
+    if (config->remoteControl.port != 0)
+    {
+        auto port = static_cast<std::uint16_t>(std::min(config->remoteControl.port, 65535U));
+        remoteControl = RemoteControl::create(config->remoteControl.host, port);
+    }
 
     if (!config->viewportEffect.empty() && config->viewportEffect != "none")
     {
@@ -2487,6 +2956,19 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
         }
     }
 
+    if (config->renderDetails.targetFrameRate > 0.0f)
+    {
+        resolutionScaler = std::make_unique<celestia::ResolutionScaler>(config->renderDetails.targetFrameRate,
+                                                                        config->renderDetails.minResolutionScale,
+                                                                        config->renderDetails.maxResolutionScale,
+                                                                        std::min(config->renderDetails.maxDetailReduction,
+                                                                                 Renderer::MaxDetailReduction));
+        // Scaled views are rendered to an FBO, which needs an effect to
+        // draw it to the window
+        if (viewportEffect == nullptr)
+            viewportEffect = std::make_unique<PassthroughViewportEffect>();
+    }
+
     if (!config->measurementSystem.empty())
     {
         if (compareIgnoringCase(config->measurementSystem, "imperial") == 0)
@@ -2562,6 +3044,11 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
         cursorHandler->setCursorShape(defaultCursorShape);
     }
 
+    profile.endPhase();
+    profile.log();
+    if (!config->paths.startupReportFile.empty() && !profile.writeJson(config->paths.startupReportFile))
+        GetLogger()->error(_("Error writing startup report {}.\n"), config->paths.startupReportFile);
+
     return true;
 }
 
@@ -2592,10 +3079,30 @@ bool CelestiaCore::initRenderer([[maybe_unused]] bool useMesaPackInvert)
     detailOptions.orbitWindowEnd = config->renderDetails.orbitWindowEnd;
     detailOptions.orbitPeriodsShown = config->renderDetails.orbitPeriodsShown;
     detailOptions.linearFadeFraction = config->renderDetails.linearFadeFraction;
+    detailOptions.maxDSOsPerFrame = config->renderDetails.maxDSOsPerFrame;
+    detailOptions.dsoFrameTimeBudget = config->renderDetails.dsoFrameTimeBudget;
+    detailOptions.logarithmicDepth = config->renderDetails.logarithmicDepth;
+    detailOptions.virtualTextureMemory = config->renderDetails.virtualTextureMemory;
+    detailOptions.modelMemory = config->renderDetails.modelMemory;
+    detailOptions.textureMemory = config->renderDetails.textureMemory;
+    detailOptions.resourceIdleTime = config->renderDetails.resourceIdleTime;
+    detailOptions.labelDecluttering = config->renderDetails.labelDecluttering;
 #ifndef GL_ES
     detailOptions.useMesaPackInvert = useMesaPackInvert;
 #endif
 
+    fs::path shaderCachePath;
+    if (!config->paths.shaderCacheDirectory.empty())
+        shaderCachePath = config->paths.shaderCacheDirectory;
+    else
+        shaderCachePath = "shadercache";
+
+#ifndef PORTABLE_BUILD
+    if (shaderCachePath.is_relative())
+        shaderCachePath = WriteableDataPath() / shaderCachePath;
+#endif
+    renderer->getShaderManager().setCacheDirectory(shaderCachePath);
+
     // Prepare the scene for rendering.
     if (!renderer->init(metrics.width, metrics.height, detailOptions))
     {
@@ -2649,6 +3156,7 @@ bool CelestiaCore::initRenderer([[maybe_unused]] bool useMesaPackInvert)
 
     renderer->setFont(Renderer::FontLarge, hud->titleFont());
     renderer->setRTL(metrics.layoutDirection == LayoutDirection::RightToLeft);
+    rendererInitialized = true;
     return true;
 }
 
@@ -3163,7 +3671,7 @@ bool CelestiaCore::captureImage(std::uint8_t* buffer,
                                 const std::array<int, 4>& viewport,
                                 celestia::engine::PixelFormat format) const
 {
-    if (renderer->captureFrame(viewport[0], viewport[1],
+    if (rendererInitialized && renderer->captureFrame(viewport[0], viewport[1],
                                viewport[2], viewport[3],
                                format, buffer))
     {
@@ -3210,7 +3718,11 @@ bool CelestiaCore::isPlayingAudio(int channel) const
 
 bool CelestiaCore::playAudio(int channel, const fs::path &path, double startTime, float volume, float pan, bool loop, bool nopause)
 {
-    stopAudio(channel);
+    // The previous session is released once the new one has started, so
+    // that the audio engine they share isn't restarted in between
+    auto previousSession = getAudioSession(channel);
+    if (previousSession)
+        previousSession->stop();
     auto audioSession = make_shared<MiniAudioSession>(path, volume, pan, loop, nopause);
     audioSessions[channel] = audioSession;
     return audioSession->play(startTime);
@@ -3340,6 +3852,7 @@ void CelestiaCore::setLayoutDirection(celestia::LayoutDirection value)
 
 void CelestiaCore::setLogFile(const fs::path &fn)
 {
+    GetLogger()->flush();
     m_logfile = std::ofstream(fn);
     if (m_logfile.good())
     {
@@ -3353,6 +3866,57 @@ void CelestiaCore::setLogFile(const fs::path &fn)
     }
 }
 
+bool CelestiaCore::writeTrace() const
+{
+    if (config == nullptr || config->paths.traceFile.empty() || !IsTracingEnabled())
+        return false;
+
+    if (!WriteChromeTrace(config->paths.traceFile))
+    {
+        GetLogger()->error(_("Error writing trace file {}.\n"), config->paths.traceFile);
+        return false;
+    }
+
+    return true;
+}
+
+MemoryReport CelestiaCore::getMemoryReport() const
+{
+    MemoryReport report;
+
+    const Universe* u = sim->getUniverse();
+    if (const StarDatabase* stars = u->getStarCatalog(); stars != nullptr)
+    {
+        report.add("Stars", stars->getMemoryUsage());
+        if (const StarNameDatabase* names = stars->getNameDatabase(); names != nullptr)
+            report.add("Star names", names->getMemoryUsage());
+    }
+    if (const DSODatabase* dsos = u->getDSOCatalog(); dsos != nullptr)
+    {
+        report.add("Deep sky objects", dsos->getMemoryUsage());
+        if (const NameDatabase* names = dsos->getNameDatabase(); names != nullptr)
+            report.add("DSO names", names->getMemoryUsage());
+    }
+    if (const SolarSystemCatalog* solarSystems = u->getSolarSystemCatalog(); solarSystems != nullptr)
+        report.add("Solar systems", GetMemoryUsage(*solarSystems));
+
+    report.add("Trajectories", ephem::GetLoadedTrajectorySize());
+    report.add("Orbit paths", renderer->getOrbitCacheMemoryUsage());
+    report.add("Textures", GetTextureManager()->getLoadedSize());
+    report.add("Virtual textures", GetTextureResidencyManager().getResidentBytes());
+    report.add("Models", GetGeometryManager()->getLoadedSize());
+    report.add("GL buffers", gl::Buffer::totalSize());
+
+    std::size_t scriptMemory = 0;
+    if (m_script != nullptr)
+        scriptMemory += m_script->getMemoryUsage();
+    if (m_scriptHook != nullptr)
+        scriptMemory += m_scriptHook->getMemoryUsage();
+    report.add("Scripts", scriptMemory);
+
+    return report;
+}
+
 void CelestiaCore::loadAsterismsFile(const fs::path &path)
 {
     if (ifstream asterismsFile(path, ios::in); !asterismsFile.good())
@@ -35,6 +35,7 @@
 #include "favorites.h"
 #include "destination.h"
 #include "hud.h"
+#include "memoryreport.h"
 #include "moviecapture.h"
 #include "timeinfo.h"
 #include "view.h"
@@ -53,11 +54,21 @@ class ProgressNotifier;
 
 namespace celestia
 {
+class BackgroundLoader;
+class ClusterSync;
+class RemoteControl;
+class ResolutionScaler;
 class TextPrintPosition;
 class ViewManager;
 #ifdef USE_MINIAUDIO
 class AudioSession;
 #endif
+
+namespace engine
+{
+class FisheyeCubeMap;
+class PickBuffer;
+}
 }
 
 typedef Watcher<CelestiaCore> CelestiaWatcher;
@@ -199,6 +210,15 @@ public:
     bool initRenderer(bool useMesaPackInvert = true);
     void start(double t);
     void start();
+    void finishBackgroundLoading();
+    // Offline rendering makes every frame independent of how fast it is
+    // drawn: scripts are stepped by the time passed to tick() and the
+    // resolution isn't adapted to the frame time. Front ends step the
+    // simulation by a fixed time and call drawUntilLoaded() before
+    // capturing each frame.
+    void setOfflineRendering(bool);
+    bool getOfflineRendering() const;
+    bool drawUntilLoaded(double timeout);
     void getLightTravelDelay(double distanceKm, int&, int&, float&);
     void setLightTravelDelay(double distanceKm);
 
@@ -235,6 +255,9 @@ public:
 
     Simulation* getSimulation() const;
     Renderer* getRenderer() const;
+    // Whether initRenderer() succeeded; without a GL context nothing can be
+    // drawn or captured
+    bool isRendererInitialized() const;
     void showText(std::string_view s,
                   int horig = 0, int vorig = 0,
                   int hoff = 0, int voff = 0,
@@ -247,6 +270,8 @@ public:
     void readFavoritesFile();
     void writeFavoritesFile();
     void activateFavorite(FavoritesEntry&);
+    Selection resolveFavorite(FavoritesEntry&);
+    void resolveFavorites();
     void addFavorite(const std::string&, const std::string&, FavoritesList::iterator* iter=nullptr);
     void addFavoriteFolder(const std::string&, FavoritesList::iterator* iter=nullptr);
     FavoritesList* getFavorites();
@@ -271,6 +296,11 @@ public:
 
     void runScript(const fs::path& filename, bool i18n = true);
     void cancelScript();
+    bool isScriptRunning() const;
+    // Run script waits on the time passed to tick() rather than the system
+    // clock, so that a front end can step scripts faster than real time
+    void setScriptTimeStepped(bool);
+    bool getScriptTimeStepped() const;
 
     int getHudDetail();
     void setHudDetail(int);
@@ -380,6 +410,13 @@ public:
 
     void loadAsterismsFile(const fs::path &path);
 
+    // Writes the recorded trace to the TraceFile set in the configuration.
+    // Returns false if tracing isn't configured or the file can't be written.
+    bool writeTrace() const;
+
+    // Estimated memory used by the catalogs, resources and scripts
+    celestia::MemoryReport getMemoryReport() const;
+
 #ifdef USE_MINIAUDIO
     bool isPlayingAudio(int channel) const;
     bool playAudio(int channel, const fs::path& path, double startTime, float volume, float pan, bool loop, bool nopause);
@@ -411,7 +448,12 @@ private:
     void charEnteredAutoComplete(const char*);
     void updateSelectionFromInput();
     void renderOverlay();
+    void sendClusterFrame();
+    void receiveClusterFrame();
     Eigen::Vector3f getPickRay(float x, float y, const celestia::View *view);
+    Selection pickObject(const Eigen::Vector3f& pickRay, float tolerance) const;
+    void applyPick(const Selection& sel, int button, float x, float y);
+    void updatePick();
     void updateFOV(float fov, const std::optional<Eigen::Vector2f> &focus, const celestia::View *view);
 #ifdef CELX
     bool initLuaHook(ProgressNotifier*);
@@ -422,6 +464,8 @@ private:
     Universe* universe{ nullptr };
 
     std::unique_ptr<FavoritesList> favorites;
+    // The next favorite resolved between frames after resolveFavorites()
+    std::optional<std::size_t> favoriteToResolve;
     DestinationList* destinations{ nullptr };
 
     Simulation* sim{ nullptr };
@@ -458,6 +502,9 @@ private:
         ScriptPaused,
     };
     ScriptState scriptState{ ScriptCompleted };
+    bool scriptTimeStepped{ false };
+    bool offlineRendering{ false };
+    bool rendererInitialized{ false };
 
     std::string timeZoneName;      // Name of the current time zone
 
@@ -473,6 +520,8 @@ private:
     double zoomTime{ 0.0 };
 
     double sysTime{ 0.0 };
+    double lastTraceWrite{ 0.0 };
+    double lastMemoryReport{ 0.0 };
 
     Eigen::Vector3f joystickRotation{ Eigen::Vector3f::Zero() };
     bool joyButtonsPressed[JoyButtonCount];
@@ -513,6 +562,36 @@ private:
 
     std::unique_ptr<ViewportEffect> viewportEffect { nullptr };
     bool isViewportEffectUsed { false };
+    // Renders the fisheye projection through a cube map, see FisheyeCubeMap
+    // in the configuration
+    std::unique_ptr<celestia::engine::FisheyeCubeMap> fisheyeCubeMap;
+    // Picks objects by drawing their ids, see GPUPicking in the
+    // configuration
+    std::unique_ptr<celestia::engine::PickBuffer> pickBuffer;
+    // A click waiting for the ids drawn by pickBuffer
+    struct PendingPick
+    {
+        Eigen::Vector3f pickRay;
+        Eigen::Vector3f direction;
+        float tolerance;
+        float pixelAngle;
+        float x;
+        float y;
+        int button;
+        int frames{ 0 };
+    };
+    std::optional<PendingPick> pendingPick;
+    std::unique_ptr<celestia::ResolutionScaler> resolutionScaler;
+    // Adds the catalogs read in the background to the universe, see
+    // BackgroundLoading in the configuration
+    std::unique_ptr<celestia::BackgroundLoader> backgroundLoader;
+    // Keeps the nodes of a tiled display in step with the master, see
+    // ClusterMode in the configuration
+    std::unique_ptr<celestia::ClusterSync> clusterSync;
+    SelectionId clusterSelection;
+    // Answers show control systems, see RemoteControlPort in the
+    // configuration
+    std::unique_ptr<celestia::RemoteControl> remoteControl;
 
     ScriptSystemAccessPolicy scriptSystemAccessPolicy { ScriptSystemAccessPolicy::Ask };
 
@@ -0,0 +1,447 @@
+// clustersync.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "clustersync.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <string_view>
+#include <utility>
+
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/logger.h>
+#include <celutil/r128util.h>
+#include "socketutil.h"
+
+using celestia::util::GetLogger;
+
+namespace celestia
+{
+
+namespace
+{
+
+// "CELC" in little-endian order
+constexpr std::uint32_t Magic = 0x434c4543;
+constexpr std::size_t MaxMessageSize = 2048;
+
+enum class MessageType : std::uint8_t
+{
+    Frame = 1,
+    Ready = 2,
+    Swap  = 3,
+};
+
+struct Address
+{
+    sockaddr_storage addr{};
+    socklen_t length{ 0 };
+};
+
+void
+writeHeader(std::ostream& out, MessageType type, std::uint32_t frame)
+{
+    util::writeLE<std::uint32_t>(out, Magic);
+    util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(type));
+    util::writeLE<std::uint32_t>(out, frame);
+}
+
+bool
+readHeader(std::istream& in, MessageType& type, std::uint32_t& frame)
+{
+    std::uint32_t magic;
+    std::uint8_t typeValue;
+    if (!util::readLE<std::uint32_t>(in, magic) || magic != Magic ||
+        !util::readLE<std::uint8_t>(in, typeValue) ||
+        !util::readLE<std::uint32_t>(in, frame))
+    {
+        return false;
+    }
+
+    type = static_cast<MessageType>(typeValue);
+    return true;
+}
+
+std::string
+encodeFrame(const ClusterFrame& frame)
+{
+    std::ostringstream out;
+    writeHeader(out, MessageType::Frame, frame.frame);
+    util::writeLE<double>(out, frame.time);
+    util::writeR128(out, frame.position.x);
+    util::writeR128(out, frame.position.y);
+    util::writeR128(out, frame.position.z);
+    util::writeLE<double>(out, frame.orientation.w());
+    util::writeLE<double>(out, frame.orientation.x());
+    util::writeLE<double>(out, frame.orientation.y());
+    util::writeLE<double>(out, frame.orientation.z());
+    util::writeLE<float>(out, frame.fov);
+    util::writeLE<float>(out, frame.faintestVisible);
+    util::writeLE<std::uint64_t>(out, frame.renderFlags);
+    util::writeLE<std::int32_t>(out, frame.labelMode);
+    util::writeLE<std::uint32_t>(out, frame.orbitMask);
+    writeSelectionId(out, frame.selection);
+    return out.str();
+}
+
+// The header has already been read
+bool
+decodeFrame(std::istream& in, ClusterFrame& frame)
+{
+    double w;
+    double x;
+    double y;
+    double z;
+    if (!util::readLE<double>(in, frame.time) ||
+        !util::readR128(in, frame.position.x) ||
+        !util::readR128(in, frame.position.y) ||
+        !util::readR128(in, frame.position.z) ||
+        !util::readLE<double>(in, w) ||
+        !util::readLE<double>(in, x) ||
+        !util::readLE<double>(in, y) ||
+        !util::readLE<double>(in, z) ||
+        !util::readLE<float>(in, frame.fov) ||
+        !util::readLE<float>(in, frame.faintestVisible) ||
+        !util::readLE<std::uint64_t>(in, frame.renderFlags) ||
+        !util::readLE<std::int32_t>(in, frame.labelMode) ||
+        !util::readLE<std::uint32_t>(in, frame.orbitMask) ||
+        !readSelectionId(in, frame.selection))
+    {
+        return false;
+    }
+
+    frame.orientation = Eigen::Quaterniond(w, x, y, z);
+    return true;
+}
+
+std::string
+encodeMessage(MessageType type, std::uint32_t frame)
+{
+    std::ostringstream out;
+    writeHeader(out, type, frame);
+    return out.str();
+}
+
+} // end unnamed namespace
+
+class ClusterSync::Socket
+{
+public:
+    Socket() = default;
+    ~Socket();
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    bool open(std::uint16_t port);
+    bool addPeer(std::string_view node, std::uint16_t defaultPort);
+    void setPeer(const Address&);
+    std::size_t peerCount() const { return m_peers.size(); }
+
+    void sendToPeers(const std::string&) const;
+    // Waits up to timeoutMs for a datagram
+    bool receive(std::string&, Address&, int timeoutMs);
+    // Returns a datagram to be received again
+    void unread(std::string&&, const Address&);
+
+private:
+    SocketLibrary m_library;
+    SocketHandle m_handle{ InvalidSocket };
+    int m_family{ AF_INET6 };
+    std::vector<Address> m_peers;
+    std::string m_unread;
+    Address m_unreadFrom;
+};
+
+ClusterSync::Socket::~Socket()
+{
+    closeSocket(m_handle);
+}
+
+bool
+ClusterSync::Socket::open(std::uint16_t port)
+{
+    if (!m_library.isStarted())
+        return false;
+
+    addrinfo hints{};
+    hints.ai_family = AF_INET6;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    // Listen on IPv4 and IPv6 where possible
+    addrinfo* info = nullptr;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(nullptr, service.c_str(), &hints, &info) != 0)
+    {
+        hints.ai_family = AF_INET;
+        if (getaddrinfo(nullptr, service.c_str(), &hints, &info) != 0)
+            return false;
+    }
+
+    m_family = info->ai_family;
+    m_handle = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (m_handle != InvalidSocket && info->ai_family == AF_INET6)
+    {
+        int v6only = 0;
+        setsockopt(m_handle, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast<const char*>(&v6only), sizeof(v6only));
+    }
+
+    bool bound = m_handle != InvalidSocket &&
+                 bind(m_handle, info->ai_addr, static_cast<socklen_t>(info->ai_addrlen)) == 0;
+    freeaddrinfo(info);
+    return bound;
+}
+
+bool
+ClusterSync::Socket::addPeer(std::string_view node, std::uint16_t defaultPort)
+{
+    std::string host(node);
+    std::string service = std::to_string(defaultPort);
+    // host:port, but not a bare IPv6 address
+    if (auto colon = node.rfind(':'); colon != std::string_view::npos && node.find(':') == colon)
+    {
+        host = node.substr(0, colon);
+        service = node.substr(colon + 1);
+    }
+
+    // An IPv6 socket reaches IPv4 nodes through mapped addresses
+    addrinfo hints{};
+    hints.ai_family = m_family;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (m_family == AF_INET6)
+        hints.ai_flags = AI_V4MAPPED;
+
+    addrinfo* info = nullptr;
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &info) != 0)
+        return false;
+
+    Address address;
+    std::memcpy(&address.addr, info->ai_addr, info->ai_addrlen);
+    address.length = static_cast<socklen_t>(info->ai_addrlen);
+    m_peers.push_back(address);
+    freeaddrinfo(info);
+    return true;
+}
+
+void
+ClusterSync::Socket::setPeer(const Address& address)
+{
+    m_peers.assign(1, address);
+}
+
+void
+ClusterSync::Socket::sendToPeers(const std::string& data) const
+{
+    for (const Address& peer : m_peers)
+    {
+        sendto(m_handle, data.data(), static_cast<int>(data.size()), 0,
+               reinterpret_cast<const sockaddr*>(&peer.addr), peer.length);
+    }
+}
+
+bool
+ClusterSync::Socket::receive(std::string& data, Address& from, int timeoutMs)
+{
+    if (!m_unread.empty())
+    {
+        data = std::move(m_unread);
+        m_unread.clear();
+        from = m_unreadFrom;
+        return true;
+    }
+
+#ifdef _WIN32
+    WSAPOLLFD fd{ m_handle, POLLIN, 0 };
+    if (WSAPoll(&fd, 1, timeoutMs) <= 0)
+        return false;
+#else
+    pollfd fd{ m_handle, POLLIN, 0 };
+    if (poll(&fd, 1, timeoutMs) <= 0)
+        return false;
+#endif
+
+    std::array<char, MaxMessageSize> buffer;
+    from.length = sizeof(from.addr);
+    auto size = recvfrom(m_handle, buffer.data(), static_cast<int>(buffer.size()), 0,
+                         reinterpret_cast<sockaddr*>(&from.addr), &from.length);
+    if (size <= 0)
+        return false;
+
+    data.assign(buffer.data(), static_cast<std::size_t>(size));
+    return true;
+}
+
+void
+ClusterSync::Socket::unread(std::string&& data, const Address& from)
+{
+    m_unread = std::move(data);
+    m_unreadFrom = from;
+}
+
+ClusterSync::ClusterSync(Role role, std::unique_ptr<Socket>&& socket, int timeoutMs) :
+    m_role(role),
+    m_socket(std::move(socket)),
+    m_timeout(timeoutMs)
+{
+}
+
+ClusterSync::~ClusterSync() = default;
+
+std::unique_ptr<ClusterSync>
+ClusterSync::createMaster(std::uint16_t port,
+                          const std::vector<std::string>& nodes,
+                          int timeoutMs)
+{
+    auto socket = std::make_unique<Socket>();
+    if (!socket->open(port))
+    {
+        GetLogger()->error("Cannot open cluster port {}\n", port);
+        return nullptr;
+    }
+
+    for (const std::string& node : nodes)
+    {
+        if (!socket->addPeer(node, port))
+            GetLogger()->error("Cannot resolve cluster node {}\n", node);
+    }
+
+    if (socket->peerCount() == 0)
+    {
+        GetLogger()->error("No cluster nodes to send frames to\n");
+        return nullptr;
+    }
+
+    return std::unique_ptr<ClusterSync>(new ClusterSync(Role::Master, std::move(socket), timeoutMs));
+}
+
+std::unique_ptr<ClusterSync>
+ClusterSync::createNode(std::uint16_t port, int timeoutMs)
+{
+    auto socket = std::make_unique<Socket>();
+    if (!socket->open(port))
+    {
+        GetLogger()->error("Cannot open cluster port {}\n", port);
+        return nullptr;
+    }
+
+    return std::unique_ptr<ClusterSync>(new ClusterSync(Role::Node, std::move(socket), timeoutMs));
+}
+
+ClusterSync::Role
+ClusterSync::role() const
+{
+    return m_role;
+}
+
+void
+ClusterSync::sendFrame(ClusterFrame& frame)
+{
+    frame.frame = ++m_frame;
+    m_socket->sendToPeers(encodeFrame(frame));
+}
+
+bool
+ClusterSync::receiveFrame(ClusterFrame& frame)
+{
+    using clock = std::chrono::steady_clock;
+    auto deadline = clock::now() + std::chrono::milliseconds(m_timeout);
+
+    // Use the latest frame that has arrived, waiting for one if there is none
+    bool received = false;
+    std::string data;
+    Address from;
+    for (;;)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now()).count();
+        int wait = received ? 0 : static_cast<int>(std::max<decltype(remaining)>(remaining, 0));
+        if (!m_socket->receive(data, from, wait))
+            break;
+
+        std::istringstream in(data);
+        MessageType type;
+        std::uint32_t frameNumber;
+        if (!readHeader(in, type, frameNumber) || type != MessageType::Frame)
+            continue;
+
+        ClusterFrame next;
+        if (!decodeFrame(in, next))
+            continue;
+
+        next.frame = frameNumber;
+        frame = std::move(next);
+        m_frame = frameNumber;
+        // Replies go to wherever the frames come from
+        m_socket->setPeer(from);
+        received = true;
+    }
+
+    return received;
+}
+
+void
+ClusterSync::swapBarrier()
+{
+    using clock = std::chrono::steady_clock;
+    auto deadline = clock::now() + std::chrono::milliseconds(m_timeout);
+
+    MessageType expected;
+    std::size_t needed;
+    if (m_role == Role::Master)
+    {
+        expected = MessageType::Ready;
+        needed = m_socket->peerCount();
+    }
+    else
+    {
+        if (m_socket->peerCount() == 0)
+            return;
+        m_socket->sendToPeers(encodeMessage(MessageType::Ready, m_frame));
+        expected = MessageType::Swap;
+        needed = 1;
+    }
+
+    std::size_t count = 0;
+    std::string data;
+    Address from;
+    while (count < needed)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now()).count();
+        if (remaining <= 0 || !m_socket->receive(data, from, static_cast<int>(remaining)))
+            break;
+
+        std::istringstream in(data);
+        MessageType type;
+        std::uint32_t frameNumber;
+        if (!readHeader(in, type, frameNumber))
+            continue;
+
+        // Messages of earlier frames arrived too late and are dropped
+        if (type == expected && frameNumber == m_frame)
+        {
+            ++count;
+        }
+        else if (m_role == Role::Node && type == MessageType::Frame && frameNumber > m_frame)
+        {
+            // The master gave up waiting and went on; keep the frame for
+            // the next call to receiveFrame
+            m_socket->unread(std::move(data), from);
+            break;
+        }
+    }
+
+    if (m_role == Role::Master)
+        m_socket->sendToPeers(encodeMessage(MessageType::Swap, m_frame));
+}
+
+} // end namespace celestia
@@ -0,0 +1,92 @@
+// clustersync.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Frame synchronization of the processes of a rendering cluster.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include <celengine/selection.h>
+#include <celengine/univcoord.h>
+
+namespace celestia
+{
+
+// The part of the master's state that the render nodes of a cluster need
+// to draw the same frame
+struct ClusterFrame
+{
+    std::uint32_t frame{ 0 };
+    double time{ 0.0 };
+    UniversalCoord position;
+    Eigen::Quaterniond orientation{ Eigen::Quaterniond::Identity() };
+    float fov{ 0.0f };
+    float faintestVisible{ 0.0f };
+    std::uint64_t renderFlags{ 0 };
+    std::int32_t labelMode{ 0 };
+    std::uint32_t orbitMask{ 0 };
+    // ID of the selected object
+    SelectionId selection;
+};
+
+// Keeps the frames of the processes of a cluster in step over UDP. Before
+// drawing a frame the master sends its state to the nodes, which draw the
+// same frame from it. After drawing, the nodes report to the master and
+// wait until it releases them, once all nodes have reported or the timeout
+// has passed, so that all processes swap buffers at about the same time.
+class ClusterSync
+{
+public:
+    enum class Role
+    {
+        Master,
+        Node,
+    };
+
+    // The master sends to the nodes given as host or host:port, the nodes
+    // listen on the given port
+    static std::unique_ptr<ClusterSync> createMaster(std::uint16_t port,
+                                                     const std::vector<std::string>& nodes,
+                                                     int timeoutMs);
+    static std::unique_ptr<ClusterSync> createNode(std::uint16_t port, int timeoutMs);
+
+    ~ClusterSync();
+
+    ClusterSync(const ClusterSync&) = delete;
+    ClusterSync& operator=(const ClusterSync&) = delete;
+
+    Role role() const;
+
+    // Master: sends the state of the next frame to the nodes
+    void sendFrame(ClusterFrame&);
+    // Node: waits for the next frame of the master. Returns false if none
+    // arrived before the timeout.
+    bool receiveFrame(ClusterFrame&);
+    // Master: waits until the nodes have drawn the frame and releases them.
+    // Node: reports that the frame is drawn and waits to be released.
+    void swapBarrier();
+
+private:
+    class Socket;
+
+    ClusterSync(Role, std::unique_ptr<Socket>&&, int timeoutMs);
+
+    Role m_role;
+    std::unique_ptr<Socket> m_socket;
+    int m_timeout;
+    std::uint32_t m_frame{ 0 };
+};
+
+} // end namespace celestia
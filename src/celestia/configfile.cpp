@@ -149,6 +149,11 @@ applyPaths(CelestiaConfig::Paths& paths, const Hash& hash)
     applyPath(paths.SAOCrossIndexFile, hash, "SAOCrossIndex"sv);
     applyPath(paths.warpMeshFile, hash, "WarpMeshFile"sv);
     applyPath(paths.leapSecondsFile, hash, "LeapSecondsFile"sv);
+    applyPath(paths.shaderCacheDirectory, hash, "ShaderCacheDirectory"sv);
+    applyPath(paths.catalogCacheDirectory, hash, "CatalogCacheDirectory"sv);
+    applyPath(paths.startupReportFile, hash, "StartupReportFile"sv);
+    applyPath(paths.traceFile, hash, "TraceFile"sv);
+    applyPath(paths.starDataPackFile, hash, "StarDataPack"sv);
 #ifdef CELX
     applyPath(paths.scriptScreenshotDirectory, hash, "ScriptScreenshotDirectory"sv);
     applyPath(paths.luaHook, hash, "LuaHook"sv);
@@ -177,9 +182,58 @@ applyMouse(CelestiaConfig::Mouse& mouse, const Hash& hash)
 }
 
 
+// Sets the defaults of the render details for the named kind of
+// installation, which the individual keys can still override
+void
+applyPerformanceProfile(CelestiaConfig::RenderDetails& renderDetails, const Hash& hash)
+{
+    std::string profile;
+    applyString(profile, hash, "PerformanceProfile"sv);
+    if (profile.empty())
+        return;
+
+    if (profile == "low"sv)
+    {
+        // Kiosks and integrated graphics: hold 30 fps at any cost
+        renderDetails.targetFrameRate = 30.0f;
+        renderDetails.minResolutionScale = 0.5f;
+        renderDetails.maxDetailReduction = 3;
+        renderDetails.aaSamples = 1;
+        renderDetails.ShadowMapSize = 0;
+        renderDetails.textureMemory = 512;
+        renderDetails.labelDecluttering = true;
+    }
+    else if (profile == "desktop"sv)
+    {
+        renderDetails.targetFrameRate = 60.0f;
+        renderDetails.minResolutionScale = 0.75f;
+        renderDetails.maxDetailReduction = 1;
+        renderDetails.aaSamples = 4;
+        renderDetails.ShadowMapSize = 1024;
+        renderDetails.labelDecluttering = true;
+    }
+    else if (profile == "dome"sv)
+    {
+        // Large fisheye projections, where the resolution matters more
+        // than the faintest stars
+        renderDetails.targetFrameRate = 30.0f;
+        renderDetails.minResolutionScale = 0.75f;
+        renderDetails.maxDetailReduction = 2;
+        renderDetails.aaSamples = 1;
+        renderDetails.ShadowMapSize = 2048;
+        renderDetails.gpuStarRendering = true;
+    }
+    else
+    {
+        GetLogger()->error("Unknown performance profile '{}'.\n", profile);
+    }
+}
+
+
 void
 applyRenderDetails(CelestiaConfig::RenderDetails& renderDetails, const Hash& hash)
 {
+    applyPerformanceProfile(renderDetails, hash);
     applyNumber(renderDetails.orbitWindowEnd, hash, "OrbitWindowEnd"sv);
     applyNumber(renderDetails.orbitPeriodsShown, hash, "OrbitPeriodsShown"sv);
     applyNumber(renderDetails.linearFadeFraction, hash, "LinearFadeFraction"sv);
@@ -187,14 +241,68 @@ applyRenderDetails(CelestiaConfig::RenderDetails& renderDetails, const Hash& has
     applyNumber(renderDetails.shadowTextureSize, hash, "ShadowTextureSize"sv);
     applyNumber(renderDetails.eclipseTextureSize, hash, "EclipseTextureSize"sv);
     applyNumber(renderDetails.orbitPathSamplePoints, hash, "OrbitPathSamplePoints"sv);
+    applyNumber(renderDetails.maxDSOsPerFrame, hash, "MaxDeepSkyObjectsPerFrame"sv);
+    applyNumber(renderDetails.dsoFrameTimeBudget, hash, "DeepSkyFrameTimeBudget"sv);
     applyNumber(renderDetails.aaSamples, hash, "AntialiasingSamples"sv);
     applyNumber(renderDetails.SolarSystemMaxDistance, hash, "SolarSystemMaxDistance"sv);
     renderDetails.SolarSystemMaxDistance = std::clamp(renderDetails.SolarSystemMaxDistance, 1.0f, 10.0f);
     applyNumber(renderDetails.ShadowMapSize, hash, "ShadowMapSize"sv);
+    applyBoolean(renderDetails.gpuStarRendering, hash, "GPUStarRendering"sv);
+    applyBoolean(renderDetails.logarithmicDepth, hash, "LogarithmicDepthBuffer"sv);
+    applyNumber(renderDetails.targetFrameRate, hash, "TargetFrameRate"sv);
+    applyNumber(renderDetails.minResolutionScale, hash, "MinResolutionScale"sv);
+    applyNumber(renderDetails.maxResolutionScale, hash, "MaxResolutionScale"sv);
+    renderDetails.maxResolutionScale = std::clamp(renderDetails.maxResolutionScale, 0.25f, 1.0f);
+    renderDetails.minResolutionScale = std::clamp(renderDetails.minResolutionScale, 0.25f, renderDetails.maxResolutionScale);
+    applyNumber(renderDetails.maxDetailReduction, hash, "MaxDetailReduction"sv);
+    applyNumber(renderDetails.virtualTextureMemory, hash, "VirtualTextureMemory"sv);
+    applyNumber(renderDetails.modelMemory, hash, "ModelMemory"sv);
+    applyNumber(renderDetails.textureMemory, hash, "TextureMemory"sv);
+    applyNumber(renderDetails.resourceIdleTime, hash, "ResourceIdleTime"sv);
+    applyBoolean(renderDetails.labelDecluttering, hash, "DeclutterLabels"sv);
     applyStringArray(renderDetails.ignoreGLExtensions, hash, "IgnoreGLExtensions"sv);
 }
 
 
+void
+applyCluster(CelestiaConfig::Cluster& cluster, const Hash& hash)
+{
+    applyString(cluster.mode, hash, "ClusterMode"sv);
+    applyNumber(cluster.port, hash, "ClusterPort"sv);
+    applyStringArray(cluster.nodes, hash, "ClusterNodes"sv);
+    applyNumber(cluster.timeout, hash, "ClusterTimeout"sv);
+
+    auto value = hash.getValue("ClusterTile"sv);
+    if (value == nullptr)
+        return;
+
+    if (auto array = value->getArray(); array != nullptr && array->size() == 4)
+    {
+        for (const auto& item : *array)
+        {
+            auto number = item.getNumber();
+            if (!number.has_value())
+                break;
+            cluster.tile.push_back(static_cast<float>(*number));
+        }
+    }
+
+    if (cluster.tile.size() != 4)
+    {
+        GetLogger()->error("ClusterTile must be an array of four numbers.\n");
+        cluster.tile.clear();
+    }
+}
+
+
+void
+applyRemoteControl(CelestiaConfig::RemoteControl& remoteControl, const Hash& hash)
+{
+    applyString(remoteControl.host, hash, "RemoteControlHost"sv);
+    applyNumber(remoteControl.port, hash, "RemoteControlPort"sv);
+}
+
+
 void
 applyStarTextures(StarDetails::StarTextureSet& starTextures, const Hash& hash, std::string_view key)
 {
@@ -270,6 +378,8 @@ bool ReadCelestiaConfig(const fs::path& filename, CelestiaConfig& config)
     applyFonts(config.fonts, *configParams);
     applyMouse(config.mouse, *configParams);
     applyRenderDetails(config.renderDetails, *configParams);
+    applyCluster(config.cluster, *configParams);
+    applyRemoteControl(config.remoteControl, *configParams);
     applyStarTextures(config.starTextures, *configParams, "StarTextures"sv);
 
     applyString(config.projectionMode, *configParams, "ProjectionMode"sv);
@@ -280,8 +390,17 @@ bool ReadCelestiaConfig(const fs::path& filename, CelestiaConfig& config)
     applyString(config.temperatureScale, *configParams, "TemperatureScale"sv);
     applyString(config.layoutDirection, *configParams, "LayoutDirection"sv);
     applyString(config.scriptSystemAccessPolicy, *configParams, "ScriptSystemAccessPolicy"sv);
+    applyNumber(config.scriptFrameTimeBudget, *configParams, "ScriptFrameTimeBudget"sv);
+    applyNumber(config.traceSpikeThreshold, *configParams, "TraceSpikeThreshold"sv);
+    applyNumber(config.memoryReportInterval, *configParams, "MemoryReportInterval"sv);
+    applyNumber(config.workerThreads, *configParams, "WorkerThreads"sv);
 
     applyNumber(config.consoleLogRows, *configParams, "LogSize"sv);
+    applyBoolean(config.backgroundLoading, *configParams, "BackgroundLoading"sv);
+    applyBoolean(config.asyncLogging, *configParams, "AsyncLogging"sv);
+    applyBoolean(config.hardwareVideoEncoding, *configParams, "HardwareVideoEncoding"sv);
+    applyBoolean(config.fisheyeCubeMap, *configParams, "FisheyeCubeMap"sv);
+    applyBoolean(config.gpuPicking, *configParams, "GPUPicking"sv);
 
 #ifdef CELX
     // Move the value into the config object to retain ownership of the hash
@@ -40,6 +40,11 @@ struct CelestiaConfig
         fs::path SAOCrossIndexFile{ };
         fs::path warpMeshFile{ };
         fs::path leapSecondsFile{ };
+        fs::path shaderCacheDirectory{ };
+        fs::path catalogCacheDirectory{ };
+        fs::path startupReportFile{ };
+        fs::path traceFile{ };
+        fs::path starDataPackFile{ };
 #ifdef CELX
         fs::path scriptScreenshotDirectory{ };
         fs::path luaHook{ };
@@ -63,6 +68,23 @@ struct CelestiaConfig
         bool focusZooming{ false };
     };
 
+    // Frame synchronization of the processes of a video wall
+    struct Cluster
+    {
+        std::string mode{ };
+        unsigned int port{ 24601 };
+        std::vector<std::string> nodes{ };
+        std::vector<float> tile{ };
+        unsigned int timeout{ 100 };
+    };
+
+    // Network control of a running instance
+    struct RemoteControl
+    {
+        std::string host{ };
+        unsigned int port{ 0 };
+    };
+
     struct RenderDetails
     {
         double orbitWindowEnd{ 0.5 };
@@ -72,9 +94,22 @@ struct CelestiaConfig
         unsigned int shadowTextureSize{ 256 };
         unsigned int eclipseTextureSize{ 128 };
         unsigned int orbitPathSamplePoints{ 100 };
+        unsigned int maxDSOsPerFrame{ 0 };
+        float dsoFrameTimeBudget{ 0.0f };
         unsigned int aaSamples{ 1 };
         float SolarSystemMaxDistance{ 1.0f };
         unsigned int ShadowMapSize{ 0 };
+        bool gpuStarRendering{ false };
+        bool logarithmicDepth{ false };
+        float targetFrameRate{ 0.0f };
+        float minResolutionScale{ 0.5f };
+        float maxResolutionScale{ 1.0f };
+        unsigned int maxDetailReduction{ 0 };
+        unsigned int virtualTextureMemory{ 0 };
+        unsigned int modelMemory{ 0 };
+        unsigned int textureMemory{ 0 };
+        float resourceIdleTime{ 0.0f };
+        bool labelDecluttering{ false };
         std::vector<std::string> ignoreGLExtensions{ };
     };
 
@@ -89,19 +124,34 @@ struct CelestiaConfig
     Fonts fonts{ };
     Mouse mouse{ };
     RenderDetails renderDetails{ };
+    Cluster cluster{ };
+    RemoteControl remoteControl{ };
     StarDetails::StarTextureSet starTextures{ };
 
     std::string scriptSystemAccessPolicy{ };
+    float scriptFrameTimeBudget{ 0.0f };
+
+    // Frames longer than this many milliseconds dump the trace; 0 disables
+    float traceSpikeThreshold{ 0.0f };
+    // Seconds between memory use reports in the log; 0 disables them
+    float memoryReportInterval{ 0.0f };
+    unsigned int workerThreads{ 0 };
 
     unsigned int consoleLogRows{ 200 };
 
+    bool backgroundLoading{ false };
+    bool asyncLogging{ false };
+
     std::string projectionMode{ };
+    bool fisheyeCubeMap{ false };
+    bool gpuPicking{ false };
     std::string viewportEffect{ };
     std::string measurementSystem{ };
     std::string temperatureScale{ };
 
     std::string x264EncoderOptions{ };
     std::string ffvhEncoderOptions{ };
+    bool hardwareVideoEncoding{ false };
 
     std::string layoutDirection{ };
 
@@ -12,7 +12,11 @@
 
 #include "eclipsefinder.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -20,6 +24,7 @@
 #include <celengine/body.h>
 #include <celengine/star.h>
 #include <celmath/distance.h>
+#include <celmath/solve.h>
 
 namespace math = celestia::math;
 namespace util = celestia::util;
@@ -27,7 +32,6 @@ namespace util = celestia::util;
 namespace
 {
 
-constexpr double dT = 1.0 / (24.0 * 60.0);
 constexpr auto EclipseObjectMask = BodyClassification::Planet      |
                                    BodyClassification::Moon        |
                                    BodyClassification::MinorMoon   |
@@ -37,100 +41,253 @@ constexpr auto EclipseObjectMask = BodyClassification::Planet      |
 // TODO: share this constant and function with render.cpp
 constexpr float MinRelativeOccluderRadius = 0.005f;
 
+// Number of search steps whose positions are computed at once
+constexpr std::size_t SearchBatchSize = 48;
+
+// Samples of the shadow distance per synodic period of a pair of bodies.
+// It has two minima per period, at conjunction and at opposition, and
+// needs a few samples between them to bracket each one.
+constexpr double SamplesPerPeriod = 16.0;
+
+// Search step for bodies without a known orbital period
+constexpr double DefaultSearchStep = 1.0 / 24.0; // one hour
+
+// Precision of eclipse start and end times
+constexpr double DurationPrecision = 1.0 / (24.0 * 360.0); // ten seconds
+
+// Length of the part of the search between progress updates
+constexpr double ProgressInterval = 10.0; // days
+
+// Receivers are never in the shadow for longer than this many search steps
+constexpr int MaxEclipseSteps = 1000;
+
+// Whether caster can cast a shadow on receiver at all. Ignore situations
+// where the shadow casting body is much smaller than the receiver, as these
+// shadows aren't likely to be relevant.  Also, ignore eclipses where the
+// caster is not an ellipsoid, since we can't generate correct shadows in
+// this case.
 bool
-testEclipse(const Body& receiver, const Body& caster, double now)
+castsShadow(const Body& receiver, const Body& caster)
+{
+    return caster.getRadius() >= receiver.getRadius() * MinRelativeOccluderRadius &&
+           caster.isEllipsoid();
+}
+
+// Distance of the receiver's edge from the edge of the caster's shadow,
+// negative when the receiver is at least partly in the shadow.
+double
+shadowDistance(const Body& receiver, const Body& caster,
+               const Eigen::Vector3d& posReceiver, const Eigen::Vector3d& posCaster)
+{
+    // All of the eclipse related code assumes that both the caster
+    // and receiver are spherical.  Irregular receivers will work more
+    // or less correctly, but casters that are sufficiently non-spherical
+    // will produce obviously incorrect shadows.  Another assumption we
+    // make is that the distance between the caster and receiver is much
+    // less than the distance between the sun and the receiver.  This
+    // approximation works everywhere in the solar system, and likely
+    // works for any orbitally stable pair of objects orbiting a star.
+    const Star* sun = receiver.getSystem()->getStar();
+    assert(sun != nullptr);
+    double distToSun = posReceiver.norm();
+    float appSunRadius = (float) (sun->getRadius() / distToSun);
+
+    Eigen::Vector3d dir = posCaster - posReceiver;
+    double distToCaster = dir.norm() - receiver.getRadius();
+    float appOccluderRadius = (float) (caster.getRadius() / distToCaster);
+
+    // The shadow radius is the radius of the occluder plus some additional
+    // amount that depends upon the apparent radius of the sun.  For
+    // a sun that's distant/small and effectively a point, the shadow
+    // radius will be the same as the radius of the occluder.
+    float shadowRadius = (1 + appSunRadius / appOccluderRadius) *
+        caster.getRadius();
+
+    // Test whether a shadow is cast on the receiver.  We want to know
+    // if the receiver lies within the shadow volume of the caster.  Since
+    // we're assuming that everything is a sphere and the sun is far
+    // away relative to the caster, the shadow volume is a
+    // cylinder capped at one end.  Testing for the intersection of a
+    // singly capped cylinder is as simple as checking the distance
+    // from the center of the receiver to the axis of the shadow cylinder.
+    // If the distance is less than the sum of the caster's and receiver's
+    // radii, then we have an eclipse.
+    float R = receiver.getRadius() + shadowRadius;
+    double dist = math::distance(posReceiver, Eigen::ParametrizedLine<double, 3>(posCaster, posCaster));
+    return dist - R;
+}
+
+bool
+testEclipse(const Body& receiver, const Body& caster,
+            const Eigen::Vector3d& posReceiver, const Eigen::Vector3d& posCaster)
+{
+    // Ignore "eclipses" where the caster and receiver have intersecting
+    // bounding spheres.
+    return shadowDistance(receiver, caster, posReceiver, posCaster) < 0.0 &&
+           (posCaster - posReceiver).norm() - receiver.getRadius() > caster.getRadius();
+}
+
+// A receiver and caster whose eclipses are searched for. The shadow
+// distance is sampled at steps derived from their synodic period, each of
+// its minima is located by golden section search and, if the receiver is
+// in the shadow there, the start and end of the eclipse by bisection.
+class EclipseSearch
+{
+public:
+    EclipseSearch(const Body& receiver, const Body& caster, double step, double startDate) :
+        m_receiver(receiver), m_caster(caster), m_step(step), m_startDate(startDate)
+    {
+    }
+
+    // Samples up to, but not including, endTime and not past lastTime
+    void search(double endTime, double lastTime,
+                std::vector<Eigen::Vector3d>& receiverPositions,
+                std::vector<Eigen::Vector3d>& casterPositions);
+
+    bool isFinished(double lastTime) const { return sampleTime(m_nextSample) > lastTime; }
+
+    const std::vector<Eclipse>& eclipses() const { return m_eclipses; }
+
+private:
+    double sampleTime(std::size_t sample) const
+    {
+        return m_startDate + static_cast<double>(sample) * m_step;
+    }
+
+    double shadowDistanceAt(double t) const
+    {
+        return shadowDistance(m_receiver, m_caster,
+                              m_receiver.getAstrocentricPosition(t),
+                              m_caster.getAstrocentricPosition(t));
+    }
+
+    bool isEclipsed(double t) const
+    {
+        return testEclipse(m_receiver, m_caster,
+                           m_receiver.getAstrocentricPosition(t),
+                           m_caster.getAstrocentricPosition(t));
+    }
+
+    void findMinimum(double lower, double upper);
+    void addEclipse(double t);
+    double findEdge(double t, double dt) const;
+
+    const Body& m_receiver;
+    const Body& m_caster;
+    double m_step;
+    double m_startDate;
+    std::size_t m_nextSample{ 0 };
+
+    // The last two samples
+    double m_time[2]{ 0.0, 0.0 };
+    double m_distance[2]{ 0.0, 0.0 };
+
+    double m_lastEclipseEnd{ -std::numeric_limits<double>::infinity() };
+    std::vector<Eclipse> m_eclipses;
+};
+
+void
+EclipseSearch::search(double endTime, double lastTime,
+                      std::vector<Eigen::Vector3d>& receiverPositions,
+                      std::vector<Eigen::Vector3d>& casterPositions)
 {
-    // Ignore situations where the shadow casting body is much smaller than
-    // the receiver, as these shadows aren't likely to be relevant.  Also,
-    // ignore eclipses where the caster is not an ellipsoid, since we can't
-    // generate correct shadows in this case.
-    if (caster.getRadius() >= receiver.getRadius() * MinRelativeOccluderRadius &&
-        caster.isEllipsoid())
+    for (;;)
     {
-        // All of the eclipse related code assumes that both the caster
-        // and receiver are spherical.  Irregular receivers will work more
-        // or less correctly, but casters that are sufficiently non-spherical
-        // will produce obviously incorrect shadows.  Another assumption we
-        // make is that the distance between the caster and receiver is much
-        // less than the distance between the sun and the receiver.  This
-        // approximation works everywhere in the solar system, and likely
-        // works for any orbitally stable pair of objects orbiting a star.
-        Eigen::Vector3d posReceiver = receiver.getAstrocentricPosition(now);
-        Eigen::Vector3d posCaster = caster.getAstrocentricPosition(now);
-
-        const Star* sun = receiver.getSystem()->getStar();
-        assert(sun != nullptr);
-        double distToSun = posReceiver.norm();
-        float appSunRadius = (float) (sun->getRadius() / distToSun);
-
-        Eigen::Vector3d dir = posCaster - posReceiver;
-        double distToCaster = dir.norm() - receiver.getRadius();
-        float appOccluderRadius = (float) (caster.getRadius() / distToCaster);
-
-        // The shadow radius is the radius of the occluder plus some additional
-        // amount that depends upon the apparent radius of the sun.  For
-        // a sun that's distant/small and effectively a point, the shadow
-        // radius will be the same as the radius of the occluder.
-        float shadowRadius = (1 + appSunRadius / appOccluderRadius) *
-            caster.getRadius();
-
-        // Test whether a shadow is cast on the receiver.  We want to know
-        // if the receiver lies within the shadow volume of the caster.  Since
-        // we're assuming that everything is a sphere and the sun is far
-        // away relative to the caster, the shadow volume is a
-        // cylinder capped at one end.  Testing for the intersection of a
-        // singly capped cylinder is as simple as checking the distance
-        // from the center of the receiver to the axis of the shadow cylinder.
-        // If the distance is less than the sum of the caster's and receiver's
-        // radii, then we have an eclipse.
-        float R = receiver.getRadius() + shadowRadius;
-        double dist = math::distance(posReceiver, Eigen::ParametrizedLine<double, 3>(posCaster, posCaster));
-        if (dist < R)
+        std::size_t n = 0;
+        while (n < SearchBatchSize &&
+               sampleTime(m_nextSample + n) < endTime &&
+               sampleTime(m_nextSample + n) <= lastTime)
         {
-            // Ignore "eclipses" where the caster and receiver have
-            // intersecting bounding spheres.
-            if (distToCaster > caster.getRadius())
-                return true;
+            ++n;
+        }
+
+        if (n == 0)
+            return;
+
+        double batchStart = sampleTime(m_nextSample);
+        m_receiver.getAstrocentricPositions(batchStart, m_step, receiverPositions.data(), n);
+        m_caster.getAstrocentricPositions(batchStart, m_step, casterPositions.data(), n);
+
+        for (std::size_t k = 0; k < n; ++k, ++m_nextSample)
+        {
+            double t = sampleTime(m_nextSample);
+            double distance = shadowDistance(m_receiver, m_caster, receiverPositions[k], casterPositions[k]);
+
+            // Eclipse in progress at the start of the search
+            if (m_nextSample == 0 && testEclipse(m_receiver, m_caster, receiverPositions[k], casterPositions[k]))
+                addEclipse(t);
+
+            if (m_nextSample >= 2 && m_distance[1] <= m_distance[0] && m_distance[1] < distance)
+                findMinimum(m_time[0], t);
+
+            m_time[0] = m_time[1];
+            m_distance[0] = m_distance[1];
+            m_time[1] = t;
+            m_distance[1] = distance;
         }
     }
+}
 
-    return false;
+void
+EclipseSearch::findMinimum(double lower, double upper)
+{
+    auto [t, error] = math::minimize_golden([this](double x) { return shadowDistanceAt(x); },
+                                            lower, upper,
+                                            DurationPrecision);
+    if (t > m_lastEclipseEnd && isEclipsed(t))
+        addEclipse(t);
 }
 
+void
+EclipseSearch::addEclipse(double t)
+{
+    Eclipse eclipse;
+    eclipse.startTime = findEdge(t, -m_step);
+    eclipse.endTime = findEdge(t, m_step);
+    eclipse.receiver = const_cast<Body*>(&m_receiver);
+    eclipse.occulter = const_cast<Body*>(&m_caster);
+    m_eclipses.push_back(eclipse);
+
+    m_lastEclipseEnd = eclipse.endTime;
+}
+
+// Find the time the eclipse in progress at t starts (dt < 0) or ends (dt > 0)
 double
-findEclipseSpan(const Body& receiver, const Body& caster,
-                double now, double dt)
+EclipseSearch::findEdge(double t, double dt) const
 {
-    double t = now;
-    while (testEclipse(receiver, caster, t))
-        t += dt;
+    double inside = t;
+    double outside = t + dt;
+    for (int i = 0; i < MaxEclipseSteps && isEclipsed(outside); ++i)
+    {
+        inside = outside;
+        outside += dt;
+    }
 
-    return t;
+    // Negative before the edge
+    auto [edge, error] = math::solve_bisection([this, dt](double x) { return (isEclipsed(x) == (dt > 0.0)) ? -1.0 : 1.0; },
+                                               std::min(inside, outside), std::max(inside, outside),
+                                               DurationPrecision);
+    return edge;
 }
 
-void
-addEclipse(const Body& receiver, const Body& occulter,
-           double now,
-           double /*startStep*/, double /*minStep*/,
-           std::vector<Eclipse>& eclipses,
-           std::vector<double>& previousEclipseEndTimes, int i)
+// Search step for the eclipses of a satellite of body. As the direction of
+// the orbits is not known, the synodic period is taken to be the shorter
+// of the two candidates.
+double
+searchStep(const Body& body, const Body& satellite, double t)
 {
-    if (testEclipse(receiver, occulter, now))
+    double frequency = 0.0;
+    for (const Body* b : { &body, &satellite })
     {
-        Eclipse eclipse;
-#if 1
-        eclipse.startTime = findEclipseSpan(receiver, occulter, now, -dT);
-        eclipse.endTime = findEclipseSpan(receiver, occulter, now, dT);
-#else
-        eclipse.startTime = findEclipseStart(receiver, occulter, now, searchStep, minStep);
-        eclipse.endTime = findEclipseEnd(receiver, occulter, now, searchStep, minStep);
-#endif
-        eclipse.receiver = const_cast<Body*>(&receiver);
-        eclipse.occulter = const_cast<Body*>(&occulter);
-        eclipses.emplace_back(eclipse);
-
-        previousEclipseEndTimes[i] = eclipse.endTime;
+        if (const auto* orbit = b->getOrbit(t); orbit != nullptr)
+        {
+            double period = orbit->getPeriod();
+            if (period > 0.0 && std::isfinite(period))
+                frequency += 1.0 / period;
+        }
     }
+
+    return frequency > 0.0 ? 1.0 / (SamplesPerPeriod * frequency) : DefaultSearchStep;
 }
 
 } // end unnamed namespace
@@ -153,53 +310,61 @@ void EclipseFinder::findEclipses(double startDate,
     if (satellites == nullptr)
         return;
 
-    // For each body, we'll need to store the time when the last eclipse ended
-    std::vector<double> previousEclipseEndTimes;
-
     // Make a list of satellites that we'll actually test for eclipses; ignore
     // spacecraft and very small objects.
-    std::vector<Body*> testBodies;
+    std::vector<EclipseSearch> searches;
+    double maxStep = 0.0;
     for (int i = 0; i < satellites->getSystemSize(); i++)
     {
-        Body* obj = satellites->getBody(i);
-        if (util::is_set(obj->getClassification(), EclipseObjectMask) &&
-            obj->getRadius() >= body->getRadius() * MinRelativeOccluderRadius)
+        const Body* obj = satellites->getBody(i);
+        if (!util::is_set(obj->getClassification(), EclipseObjectMask) ||
+            obj->getRadius() < body->getRadius() * MinRelativeOccluderRadius)
         {
-            testBodies.push_back(obj);
-            previousEclipseEndTimes.push_back(startDate - 1.0);
+            continue;
         }
-    }
 
-    if (testBodies.empty())
-        return;
+        double step = searchStep(*body, *obj, startDate);
+        if ((eclipseTypeMask & Eclipse::Solar) != 0 && castsShadow(*body, *obj))
+            searches.emplace_back(*body, *obj, step, startDate);
+        if ((eclipseTypeMask & Eclipse::Lunar) != 0 && castsShadow(*obj, *body))
+            searches.emplace_back(*obj, *body, step, startDate);
+        maxStep = std::max(maxStep, step);
+    }
 
-    // TODO: Use a fixed step of one hour for now; we should use a binary
-    // search instead.
-    double searchStep = 1.0 / 24.0; // one hour
+    // Sample one step past the end to bracket the minima near it
+    double lastTime = endDate + maxStep;
 
-    // Precision of eclipse duration calculation
-    double durationPrecision = 1.0 / (24.0 * 360.0); // ten seconds
+    std::vector<Eigen::Vector3d> receiverPositions(SearchBatchSize);
+    std::vector<Eigen::Vector3d> casterPositions(SearchBatchSize);
 
-    for (double t = startDate; t <= endDate; t += searchStep)
+    bool finished = searches.empty();
+    for (double t = startDate; !finished; t += ProgressInterval)
     {
-        if (watcher != nullptr)
+        if (watcher != nullptr &&
+            watcher->eclipseFinderProgressUpdate(std::min(t, endDate)) == EclipseFinderWatcher::AbortOperation)
         {
-            if (watcher->eclipseFinderProgressUpdate(t) == EclipseFinderWatcher::AbortOperation)
-                return;
+            break;
         }
 
-        for (unsigned int i = 0; i < testBodies.size(); i++)
+        finished = true;
+        for (EclipseSearch& search : searches)
         {
-            // Only test for an eclipse if we're not in the middle of
-            // of previous one.
-            if (t <= previousEclipseEndTimes[i])
-                continue;
-
-            if (eclipseTypeMask & Eclipse::Solar)
-                addEclipse(*body, *testBodies[i], t, searchStep, durationPrecision, eclipses, previousEclipseEndTimes, i);
+            search.search(t + ProgressInterval, lastTime, receiverPositions, casterPositions);
+            finished = finished && search.isFinished(lastTime);
+        }
+    }
 
-            if (eclipseTypeMask & Eclipse::Lunar)
-                addEclipse(*testBodies[i], *body, t, searchStep, durationPrecision, eclipses, previousEclipseEndTimes, i);
+    // Report the eclipses found in order, also those found before an abort
+    auto first = static_cast<std::ptrdiff_t>(eclipses.size());
+    for (const EclipseSearch& search : searches)
+    {
+        for (const Eclipse& eclipse : search.eclipses())
+        {
+            if (eclipse.startTime <= endDate)
+                eclipses.push_back(eclipse);
         }
     }
+
+    std::stable_sort(eclipses.begin() + first, eclipses.end(),
+                     [](const Eclipse& e0, const Eclipse& e1) { return e0.startTime < e1.startTime; });
 }
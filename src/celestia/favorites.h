@@ -18,6 +18,7 @@
 #include <Eigen/Geometry>
 
 #include <celengine/observer.h>
+#include <celengine/selection.h>
 #include <celengine/univcoord.h>
 
 
@@ -33,6 +34,10 @@ struct FavoritesEntry
     std::string parentFolder;
 
     ObserverFrame::CoordinateSystem coordSys;
+
+    // The object named by selectionName once it has been found, see
+    // CelestiaCore::resolveFavorite
+    Selection selection;
 };
 
 using FavoritesList = std::vector<std::unique_ptr<FavoritesEntry>>;
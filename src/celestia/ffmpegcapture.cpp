@@ -6,6 +6,7 @@
 extern "C"
 {
 #include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
 #include <libavutil/timestamp.h>
 #include <libavutil/pixdesc.h>
 #include <libavutil/opt.h>
@@ -13,17 +14,67 @@ extern "C"
 #include <libswscale/swscale.h>
 }
 
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <fmt/format.h>
 
+#include <celengine/framereadback.h>
 #include <celengine/render.h>
 #include <celimage/pixelformat.h>
 
 using namespace std;
 using namespace celestia;
 
+namespace
+{
+// Frames read back but not encoded yet; rendering waits when the encoder
+// falls this far behind
+constexpr std::size_t MaxQueuedFrames = 4;
+
+struct HardwareEncoder
+{
+    AVCodecID       codec;
+    const char      *name;
+    AVHWDeviceType  deviceType;
+    AVPixelFormat   pixelFormat;
+};
+
+// hardware encoders tried in turn when hardware encoding is enabled; the
+// first one with a usable device is picked
+constexpr HardwareEncoder hardwareEncoders[] =
+{
+    { AV_CODEC_ID_H264, "h264_nvenc",        AV_HWDEVICE_TYPE_CUDA,         AV_PIX_FMT_CUDA         },
+    { AV_CODEC_ID_H264, "h264_vaapi",        AV_HWDEVICE_TYPE_VAAPI,        AV_PIX_FMT_VAAPI        },
+    { AV_CODEC_ID_H264, "h264_qsv",          AV_HWDEVICE_TYPE_QSV,          AV_PIX_FMT_QSV          },
+    { AV_CODEC_ID_H264, "h264_videotoolbox", AV_HWDEVICE_TYPE_VIDEOTOOLBOX, AV_PIX_FMT_VIDEOTOOLBOX },
+    { AV_CODEC_ID_HEVC, "hevc_nvenc",        AV_HWDEVICE_TYPE_CUDA,         AV_PIX_FMT_CUDA         },
+    { AV_CODEC_ID_HEVC, "hevc_vaapi",        AV_HWDEVICE_TYPE_VAAPI,        AV_PIX_FMT_VAAPI        },
+    { AV_CODEC_ID_HEVC, "hevc_qsv",          AV_HWDEVICE_TYPE_QSV,          AV_PIX_FMT_QSV          },
+    { AV_CODEC_ID_HEVC, "hevc_videotoolbox", AV_HWDEVICE_TYPE_VIDEOTOOLBOX, AV_PIX_FMT_VIDEOTOOLBOX },
+};
+
+// software format frames are converted to before the upload; all of the
+// encoders above accept it
+constexpr AVPixelFormat hardwareUploadFormat = AV_PIX_FMT_NV12;
+
+// frames allocated in advance, VAAPI can't grow its pool
+constexpr int hardwarePoolSize = 8;
+}
+
 // a wrapper around a single output AVStream
+//
+// Frames are read back through a ring of pixel pack buffers where
+// supported, so that the transfer of one frame overlaps rendering the next
+// ones. They are converted and encoded on a thread of their own.
 class FFMPEGCapturePrivate
 {
     FFMPEGCapturePrivate() = default;
@@ -32,23 +83,38 @@ class FFMPEGCapturePrivate
     bool init(const fs::path& fn);
     bool addStream(int w, int h, float fps);
     bool openVideo();
+    bool findHardwareEncoder(int width, int height);
     bool start();
-    bool writeVideoFrame(bool = false);
+    void startEncoder();
+    bool captureFrame();
     void finish();
     void setVideoCodec(int);
 
     bool isSupportedPixelFormat(enum AVPixelFormat) const;
 
+    // called on the render thread
+    bool takeFrame(bool wait);
+    std::vector<std::uint8_t> acquireBuffer();
+    void queueFrame(std::vector<std::uint8_t>&&);
+    void stopEncoder();
+
+    // called on the encoder thread
+    void runEncoder();
+    bool encodeFrame(const std::uint8_t*);
+    bool encode(AVFrame*);
     int writePacket();
 
     AVStream        *st       { nullptr };
     AVFrame         *frame    { nullptr };
-    AVFrame         *tmpfr    { nullptr };
     AVCodecContext  *enc      { nullptr };
     AVFormatContext *oc       { nullptr };
     const AVCodec   *vc       { nullptr };
     AVPacket        *pkt      { nullptr };
     SwsContext      *swsc     { nullptr };
+    // hardware encoding: the device and a frame for the upload of each
+    // converted frame
+    AVBufferRef     *hwDevice { nullptr };
+    AVFrame         *hwFrame  { nullptr };
 
     const Renderer  *renderer { nullptr };
 
@@ -59,6 +125,9 @@ class FFMPEGCapturePrivate
 
     AVCodecID       vc_id     { AV_CODEC_ID_FFVHUFF };
     AVPixelFormat   format    { AV_PIX_FMT_NONE     };
+    // format captured frames are converted to, in system memory
+    AVPixelFormat   swFormat  { AV_PIX_FMT_NONE     };
+    bool            useHardware { false };
     float           fps       { 0       };
     bool            capturing { false   };
     bool            hasAlpha  { false   };
@@ -66,6 +135,20 @@ class FFMPEGCapturePrivate
     fs::path        filename;
     std::string     vc_options;
 
+    std::unique_ptr<FrameReadback> readback;
+    std::size_t     rowStride { 0       };
+    // whether captured rows start at the bottom of the frame
+    bool            bottomUp  { false   };
+    int             frameCount{ 0       };
+
+    std::thread     encoder;
+    std::mutex      queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<std::vector<std::uint8_t>> queue;
+    std::vector<std::vector<std::uint8_t>> freeBuffers;
+    bool            stopping  { false   };
+    std::atomic<bool> failed  { false   };
+
  public:
 #if (LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 10, 100)) // ffmpeg < 4.0
     static bool     registered;
@@ -204,13 +287,73 @@ int FFMPEGCapturePrivate::writePacket()
     return av_interleaved_write_frame(oc, pkt);
 }
 
+// find a hardware encoder for the codec and create its device and frame
+// pool, return false if there is none
+bool FFMPEGCapturePrivate::findHardwareEncoder(int width, int height)
+{
+    for (const auto& candidate : hardwareEncoders)
+    {
+        if (candidate.codec != vc_id)
+            continue;
+
+        const AVCodec *codec = avcodec_find_encoder_by_name(candidate.name);
+        if (codec == nullptr)
+            continue;
+
+        AVBufferRef *device = nullptr;
+        if (av_hwdevice_ctx_create(&device, candidate.deviceType, nullptr, nullptr, 0) < 0)
+            continue;
+
+        AVBufferRef *frames = av_hwframe_ctx_alloc(device);
+        if (frames == nullptr)
+        {
+            av_buffer_unref(&device);
+            continue;
+        }
+
+        auto *framesContext = reinterpret_cast<AVHWFramesContext*>(frames->data);
+        framesContext->format            = candidate.pixelFormat;
+        framesContext->sw_format         = hardwareUploadFormat;
+        framesContext->width             = width;
+        framesContext->height            = height;
+        framesContext->initial_pool_size = hardwarePoolSize;
+        if (av_hwframe_ctx_init(frames) < 0)
+        {
+            av_buffer_unref(&frames);
+            av_buffer_unref(&device);
+            continue;
+        }
+
+        enc = avcodec_alloc_context3(codec);
+        if (enc == nullptr)
+        {
+            av_buffer_unref(&frames);
+            av_buffer_unref(&device);
+            return false;
+        }
+
+        vc            = codec;
+        hwDevice      = device;
+        // the codec context takes over the reference
+        enc->hw_frames_ctx = frames;
+        enc->pix_fmt  = candidate.pixelFormat;
+        swFormat      = hardwareUploadFormat;
+        fmt::print("Using hardware encoder {}\n", codec->name);
+        return true;
+    }
+
+    cout << "No hardware encoder available, falling back to software\n";
+    return false;
+}
+
 // add an output stream
 bool FFMPEGCapturePrivate::addStream(int width, int height, float fps)
 {
     this->fps = fps;
 
     // find the encoder
-    vc = avcodec_find_encoder(vc_id);
+    if (!useHardware || !findHardwareEncoder(width, height))
+        vc = avcodec_find_encoder(vc_id);
     if (vc == nullptr)
     {
         cout << "Video codec isn't found\n";
@@ -229,7 +372,8 @@ bool FFMPEGCapturePrivate::addStream(int width, int height, float fps)
     }
     st->id = oc->nb_streams - 1;
 
-    enc = avcodec_alloc_context3(vc);
+    if (enc == nullptr)
+        enc = avcodec_alloc_context3(vc);
     if (enc == nullptr)
     {
         cout << "Unable to alloc a new context\n";
@@ -262,16 +406,21 @@ bool FFMPEGCapturePrivate::addStream(int width, int height, float fps)
     enc->framerate = st->avg_frame_rate = { st->time_base.den, st->time_base.num };
     enc->gop_size  = 12; // emit one intra frame every twelve frames at most
 
-    // find a best pixel format to convert to from `format`
-    if (isSupportedPixelFormat(AV_PIX_FMT_YUV420P))
+    // find a best pixel format to convert to from `format`, hardware
+    // encoders had theirs set by findHardwareEncoder
+    if (hwDevice == nullptr)
     {
-        enc->pix_fmt = AV_PIX_FMT_YUV420P;
-    }
-    else
-    {
-        enc->pix_fmt = avcodec_find_best_pix_fmt_of_list(vc->pix_fmts, format, 0, nullptr);
-        if (enc->pix_fmt == AV_PIX_FMT_NONE)
-            avcodec_default_get_format(enc, &(enc->pix_fmt));
+        if (isSupportedPixelFormat(AV_PIX_FMT_YUV420P))
+        {
+            enc->pix_fmt = AV_PIX_FMT_YUV420P;
+        }
+        else
+        {
+            enc->pix_fmt = avcodec_find_best_pix_fmt_of_list(vc->pix_fmts, format, 0, nullptr);
+            if (enc->pix_fmt == AV_PIX_FMT_NONE)
+                avcodec_default_get_format(enc, &(enc->pix_fmt));
+        }
+        swFormat = enc->pix_fmt;
     }
 
     if (enc->codec_id == AV_CODEC_ID_MPEG1VIDEO)
@@ -353,7 +502,7 @@ bool FFMPEGCapturePrivate::openVideo()
         return false;
     }
 
-    frame->format = enc->pix_fmt;
+    frame->format = swFormat;
     frame->width  = enc->width;
     frame->height = enc->height;
 
@@ -364,36 +513,24 @@ bool FFMPEGCapturePrivate::openVideo()
         return false;
     }
 
-    if (enc->pix_fmt != format)
+    if (hwDevice != nullptr && (hwFrame = av_frame_alloc()) == nullptr)
+    {
+        cout << "Failed to allocate hardware frame\n";
+        return false;
+    }
+
+    if (swFormat != format)
     {
         // as we only grab a RGB24 picture, we must convert it
         // to the codec pixel format if needed
         swsc = sws_getContext(enc->width, enc->height, format,
-                              enc->width, enc->height, enc->pix_fmt,
+                              enc->width, enc->height, swFormat,
                               SWS_BITEXACT, nullptr, nullptr, nullptr);
         if (swsc == nullptr)
         {
             cout << "Failed to allocate SWS context\n";
             return false;
         }
-
-        // allocate and init a temporary frame
-        if((tmpfr = av_frame_alloc()) == nullptr)
-        {
-            cout << "Failed to allocate temp frame\n";
-            return false;
-        }
-
-        tmpfr->format = format;
-        tmpfr->width  = enc->width;
-        tmpfr->height = enc->height;
-
-        // allocate the buffers for the frame data
-        if (av_frame_get_buffer(tmpfr, 32) < 0)
-        {
-            cout << "Failed to allocate temp frame buffer\n";
-            return false;
-        }
     }
 
     // copy the stream parameters to the muxer
@@ -406,52 +543,195 @@ bool FFMPEGCapturePrivate::openVideo()
     return true;
 }
 
-static void captureImage(AVFrame *pict, int width, int height, const Renderer *r)
+void FFMPEGCapturePrivate::startEncoder()
+{
+    readback = FrameReadback::create(enc->width, enc->height, renderer->getPreferredCaptureFormat());
+    // Renderer::captureFrame flips the rows itself
+    bottomUp = readback != nullptr && !renderer->packsRowsInverted();
+    // glReadPixels pads rows to four bytes
+    rowStride = (static_cast<std::size_t>(enc->width) * (hasAlpha ? 4 : 3) + 3) & ~static_cast<std::size_t>(3);
+    encoder = std::thread(&FFMPEGCapturePrivate::runEncoder, this);
+}
+
+bool FFMPEGCapturePrivate::captureFrame()
 {
+    if (failed)
+        return false;
+
     int x, y, w, h;
-    r->getViewport(&x, &y, &w, &h);
+    renderer->getViewport(&x, &y, &w, &h);
+    x += (w - enc->width) / 2;
+    y += (h - enc->height) / 2;
 
-    x += (w - width) / 2;
-    y += (h - height) / 2;
-    r->captureFrame(x, y, width, height,
-                    r->getPreferredCaptureFormat(),
-                    pict->data[0]);
+    if (readback == nullptr)
+    {
+        auto buffer = acquireBuffer();
+        if (!renderer->captureFrame(x, y, enc->width, enc->height,
+                                    renderer->getPreferredCaptureFormat(),
+                                    buffer.data()))
+        {
+            return false;
+        }
+        queueFrame(std::move(buffer));
+    }
+    else
+    {
+        // with every buffer in use, wait for the oldest frame
+        if (!readback->read(x, y) && !(takeFrame(true) && readback->read(x, y)))
+            return false;
+
+        // hand over the frames the GPU is done with, without waiting for
+        // the one just read
+        while (readback->pendingCount() > 1 && takeFrame(false));
+    }
+
+    ++frameCount;
+    return true;
 }
 
-// encode one video frame and send it to the muxer
-// return 1 when encoding is finished, 0 otherwise
-bool FFMPEGCapturePrivate::writeVideoFrame(bool finalize)
+bool FFMPEGCapturePrivate::takeFrame(bool wait)
 {
-    AVFrame *frame = finalize ? nullptr : this->frame;
-    const int bytesPerPixel = hasAlpha ? 4 : 3;
+    auto buffer = acquireBuffer();
+    if (!readback->take(buffer.data(), wait))
+    {
+        std::scoped_lock lock(queueMutex);
+        freeBuffers.push_back(std::move(buffer));
+        return false;
+    }
 
-    // check if we want to generate more frames
-    if (!finalize)
+    queueFrame(std::move(buffer));
+    return true;
+}
+
+std::vector<std::uint8_t> FFMPEGCapturePrivate::acquireBuffer()
+{
     {
-        // when we pass a frame to the encoder, it may keep a reference to it
-        // internally; make sure we do not overwrite it here
-        if (av_frame_make_writable(frame) < 0)
+        std::scoped_lock lock(queueMutex);
+        if (!freeBuffers.empty())
         {
-            cout << "Failed to make the frame writable\n";
-            return false;
+            auto buffer = std::move(freeBuffers.back());
+            freeBuffers.pop_back();
+            return buffer;
         }
+    }
+
+    return std::vector<std::uint8_t>(rowStride * static_cast<std::size_t>(enc->height));
+}
 
-        if (enc->pix_fmt != format)
+void FFMPEGCapturePrivate::queueFrame(std::vector<std::uint8_t>&& buffer)
+{
+    {
+        std::unique_lock lock(queueMutex);
+        queueChanged.wait(lock, [this] { return queue.size() < MaxQueuedFrames; });
+        queue.push_back(std::move(buffer));
+    }
+    queueChanged.notify_all();
+}
+
+void FFMPEGCapturePrivate::stopEncoder()
+{
+    if (!encoder.joinable())
+        return;
+
+    {
+        std::scoped_lock lock(queueMutex);
+        stopping = true;
+    }
+    queueChanged.notify_all();
+    encoder.join();
+}
+
+void FFMPEGCapturePrivate::runEncoder()
+{
+    for (;;)
+    {
+        std::vector<std::uint8_t> buffer;
         {
-            captureImage(tmpfr, enc->width, enc->height, renderer);
-            // we need to compute the correct line width of our source data
-            const int linesize = bytesPerPixel * enc->width;
-            sws_scale(swsc, tmpfr->data, &linesize, 0, enc->height,
-                      frame->data, frame->linesize);
+            std::unique_lock lock(queueMutex);
+            queueChanged.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                break;
+
+            buffer = std::move(queue.front());
+            queue.pop_front();
         }
-        else
+        queueChanged.notify_all();
+
+        if (!failed && !encodeFrame(buffer.data()))
+            failed = true;
+
+        std::scoped_lock lock(queueMutex);
+        freeBuffers.push_back(std::move(buffer));
+    }
+
+    // flush the frames the encoder still holds
+    if (!failed)
+        encode(nullptr);
+}
+
+// convert one captured frame and encode it
+bool FFMPEGCapturePrivate::encodeFrame(const std::uint8_t* data)
+{
+    // when we pass a frame to the encoder, it may keep a reference to it
+    // internally; make sure we do not overwrite it here
+    if (av_frame_make_writable(frame) < 0)
+    {
+        cout << "Failed to make the frame writable\n";
+        return false;
+    }
+
+    // frames read bottom row first are flipped by walking the rows
+    // backwards
+    const std::uint8_t* src = data;
+    auto linesize = static_cast<int>(rowStride);
+    if (bottomUp)
+    {
+        src += rowStride * static_cast<std::size_t>(enc->height - 1);
+        linesize = -linesize;
+    }
+
+    if (swsc != nullptr)
+    {
+        sws_scale(swsc, &src, &linesize, 0, enc->height,
+                  frame->data, frame->linesize);
+    }
+    else
+    {
+        const std::size_t rowSize = static_cast<std::size_t>(enc->width) * (hasAlpha ? 4 : 3);
+        for (int row = 0; row < enc->height; ++row)
         {
-            captureImage(frame, enc->width, enc->height, renderer);
+            std::memcpy(frame->data[0] + static_cast<std::ptrdiff_t>(row) * frame->linesize[0],
+                        src + static_cast<std::ptrdiff_t>(row) * linesize,
+                        rowSize);
         }
+    }
 
+    if (hwFrame == nullptr)
+    {
         frame->pts = nextPts++;
+        return encode(frame);
+    }
+
+    // upload the converted frame to the device of the encoder, which
+    // keeps its own reference to it
+    if (av_hwframe_get_buffer(enc->hw_frames_ctx, hwFrame, 0) < 0 ||
+        av_hwframe_transfer_data(hwFrame, frame, 0) < 0)
+    {
+        cout << "Failed to upload the frame to the encoder device\n";
+        av_frame_unref(hwFrame);
+        return false;
     }
 
+    hwFrame->pts = nextPts++;
+    bool ok = encode(hwFrame);
+    av_frame_unref(hwFrame);
+    return ok;
+}
+
+// send a frame to the encoder, or nullptr to flush it, and pass the
+// packets it returns to the muxer
+bool FFMPEGCapturePrivate::encode(AVFrame *frame)
+{
 #if (LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 133, 100))
     av_init_packet(pkt);
 #endif
@@ -488,7 +768,13 @@ bool FFMPEGCapturePrivate::writeVideoFrame(bool finalize)
 
 void FFMPEGCapturePrivate::finish()
 {
-    writeVideoFrame(true);
+    if (readback != nullptr)
+    {
+        while (readback->pendingCount() > 0)
+            takeFrame(true);
+        readback = nullptr;
+    }
+    stopEncoder();
 
     // Write the trailer, if any. The trailer must be written before you
     // close the CodecContexts open when you wrote the header; otherwise
@@ -502,10 +788,12 @@ void FFMPEGCapturePrivate::finish()
 
 FFMPEGCapturePrivate::~FFMPEGCapturePrivate()
 {
+    stopEncoder();
+    sws_freeContext(swsc);
     avcodec_free_context(&enc);
     av_frame_free(&frame);
-    if (tmpfr != nullptr)
-        av_frame_free(&tmpfr);
+    av_frame_free(&hwFrame);
+    av_buffer_unref(&hwDevice);
     avformat_free_context(oc);
     av_packet_free(&pkt);
 }
@@ -526,7 +814,7 @@ FFMPEGCapture::~FFMPEGCapture()
 
 int FFMPEGCapture::getFrameCount() const
 {
-    return d->nextPts;
+    return d->frameCount;
 }
 
 int FFMPEGCapture::getWidth() const
@@ -554,6 +842,8 @@ bool FFMPEGCapture::start(const fs::path& filename, int width, int height, float
         return false;
     }
 
+    d->startEncoder();
+
     d->capturing = true; // XXX
 
     return true;
@@ -573,7 +863,7 @@ bool FFMPEGCapture::end()
 
 bool FFMPEGCapture::captureFrame()
 {
-    return d->capturing && d->writeVideoFrame();
+    return d->capturing && d->captureFrame();
 }
 
 void FFMPEGCapture::setVideoCodec(AVCodecID vc_id)
@@ -590,3 +880,8 @@ void FFMPEGCapture::setEncoderOptions(const std::string &s)
 {
     d->vc_options = s;
 }
+
+void FFMPEGCapture::setHardwareEncoding(bool enable)
+{
+    d->useHardware = enable;
+}
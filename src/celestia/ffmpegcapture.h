@@ -32,6 +32,8 @@ public:
     void setVideoCodec(AVCodecID);
     void setBitRate(int64_t);
     void setEncoderOptions(const std::string&);
+    // Use a hardware encoder for the codec when one is available
+    void setHardwareEncoding(bool);
 
 protected:
     void recordingStatusUpdated(bool) override { /* no action necessary */ };
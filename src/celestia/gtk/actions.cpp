@@ -106,6 +106,7 @@ captureMovie(const char* filename, const int resolution[], float fps,
         movieCapture->setEncoderOptions(app->core->getConfig()->x264EncoderOptions);
     else
         movieCapture->setEncoderOptions(app->core->getConfig()->ffvhEncoderOptions);
+    movieCapture->setHardwareEncoding(app->core->getConfig()->hardwareVideoEncoding);
 
     bool success = movieCapture->start(filename, resolution[0], resolution[1], fps);
     if (success)
@@ -395,6 +395,7 @@ int main(int argc, char* argv[])
 
     app->renderer->setSolarSystemMaxDistance(app->core->getConfig()->renderDetails.SolarSystemMaxDistance);
     app->renderer->setShadowMapSize(app->core->getConfig()->renderDetails.ShadowMapSize);
+    app->renderer->setGPUStarRendering(app->core->getConfig()->renderDetails.gpuStarRendering);
 
     /* Create the main window (GTK) */
     app->mainWindow = gtk_window_new(GTK_WINDOW_TOPLEVEL);
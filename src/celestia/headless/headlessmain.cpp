@@ -0,0 +1,434 @@
+// headlessmain.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <fmt/format.h>
+#include <celcompat/charconv.h>
+#include <celcompat/filesystem.h>
+#include <celengine/render.h>
+#include <celestia/celestiacore.h>
+#include <celrender/renderprofiler.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#ifdef HEADLESS_OFFSCREEN
+#include <celengine/glsupport.h>
+#include "offscreencontext.h"
+#endif
+
+using namespace std::string_view_literals;
+
+namespace celestia::headless
+{
+
+namespace
+{
+
+// Runs scripts without a window or GL context. Nothing is drawn, so scripts
+// that take screenshots can't be checked this way; everything else works as
+// in the other front ends, except that the simulation is stepped by a fixed
+// time step as fast as possible instead of following the system clock.
+//
+// Where EGL is available, the scripts can also be rendered to an offscreen
+// surface, which makes it possible to time the frames of a camera path:
+// with --benchmark, the frame times and the per-pass times of each script
+// are reported when it ends.
+
+constexpr double DefaultTimeStep = 1.0 / 30.0;
+constexpr double DefaultTimeout = 3600.0;
+constexpr int DefaultWidth = 1280;
+constexpr int DefaultHeight = 720;
+
+// Records the errors reported while a script runs; script errors are fatal
+// errors for the script, not for the application.
+class HeadlessAlerter : public CelestiaCore::Alerter
+{
+ public:
+    void fatalError(const std::string& msg) override
+    {
+        fmt::print(stderr, "{}\n", msg);
+        ++errors;
+    }
+
+    int errors{ 0 };
+};
+
+struct Options
+{
+    fs::path dataDir;
+    fs::path configFile;
+    std::vector<fs::path> extrasDirs;
+    std::vector<fs::path> scripts;
+    double timeStep{ DefaultTimeStep };
+    double timeout{ DefaultTimeout };
+    int width{ 0 };
+    int height{ 0 };
+    bool benchmark{ false };
+};
+
+constexpr std::size_t PassCount = static_cast<std::size_t>(render::RenderPass::Count);
+
+// Frame times of a script run, in milliseconds
+struct FrameStats
+{
+    std::vector<double> frameTimes;
+    std::array<double, PassCount> cpuTimes{};
+    std::array<double, PassCount> gpuTimes{};
+    bool hasGPUTimes{ false };
+};
+
+void
+PrintUsage()
+{
+    fmt::print(stderr,
+               "Usage: celestia-headless [options] script...\n"
+               "  --dir <path>        data directory\n"
+               "  --conf <file>       configuration file\n"
+               "  --extrasdir <path>  additional extras directory\n"
+               "  --step <seconds>    simulated time per tick (default {})\n"
+               "  --timeout <seconds> simulated time after which a script fails (default {})\n",
+               DefaultTimeStep, DefaultTimeout);
+#ifdef HEADLESS_OFFSCREEN
+    fmt::print(stderr,
+               "  --size <w>x<h>      render every tick to an offscreen surface of this size\n"
+               "  --benchmark         report the frame times of each script, rendering at\n"
+               "                      {}x{} unless --size is given\n",
+               DefaultWidth, DefaultHeight);
+#endif
+}
+
+bool
+ParseSeconds(std::string_view arg, double& value)
+{
+    auto result = compat::from_chars(arg.data(), arg.data() + arg.size(), value);
+    return result.ec == std::errc{} && result.ptr == arg.data() + arg.size() && value > 0.0;
+}
+
+#ifdef HEADLESS_OFFSCREEN
+bool
+ParseSize(std::string_view arg, int& width, int& height)
+{
+    auto x = arg.find('x');
+    if (x == std::string_view::npos)
+        return false;
+
+    auto result = compat::from_chars(arg.data(), arg.data() + x, width);
+    if (result.ec != std::errc{} || result.ptr != arg.data() + x || width <= 0)
+        return false;
+
+    result = compat::from_chars(arg.data() + x + 1, arg.data() + arg.size(), height);
+    return result.ec == std::errc{} && result.ptr == arg.data() + arg.size() && height > 0;
+}
+#endif
+
+bool
+ParseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if (arg.empty() || arg[0] != '-')
+        {
+            options.scripts.emplace_back(fs::absolute(fs::u8path(arg)));
+            continue;
+        }
+
+#ifdef HEADLESS_OFFSCREEN
+        if (arg == "--benchmark"sv)
+        {
+            options.benchmark = true;
+            continue;
+        }
+#endif
+
+        if (i + 1 == argc)
+        {
+            fmt::print(stderr, "Missing value for {}\n", arg);
+            return false;
+        }
+
+        std::string_view value = argv[++i];
+        if (arg == "--dir"sv)
+        {
+            options.dataDir = fs::u8path(value);
+        }
+        else if (arg == "--conf"sv)
+        {
+            options.configFile = fs::absolute(fs::u8path(value));
+        }
+        else if (arg == "--extrasdir"sv)
+        {
+            options.extrasDirs.emplace_back(fs::absolute(fs::u8path(value)));
+        }
+        else if (arg == "--step"sv)
+        {
+            if (!ParseSeconds(value, options.timeStep))
+            {
+                fmt::print(stderr, "Invalid time step {}\n", value);
+                return false;
+            }
+        }
+        else if (arg == "--timeout"sv)
+        {
+            if (!ParseSeconds(value, options.timeout))
+            {
+                fmt::print(stderr, "Invalid timeout {}\n", value);
+                return false;
+            }
+        }
+#ifdef HEADLESS_OFFSCREEN
+        else if (arg == "--size"sv)
+        {
+            if (!ParseSize(value, options.width, options.height))
+            {
+                fmt::print(stderr, "Invalid size {}\n", value);
+                return false;
+            }
+        }
+#endif
+        else
+        {
+            fmt::print(stderr, "Unknown option {}\n", arg);
+            return false;
+        }
+    }
+
+    if (options.benchmark && options.width == 0)
+    {
+        options.width = DefaultWidth;
+        options.height = DefaultHeight;
+    }
+
+    return !options.scripts.empty();
+}
+
+// Percentile of a sorted, non-empty list of frame times
+double
+Percentile(const std::vector<double>& sorted, double p)
+{
+    auto index = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+void
+PrintFrameStats(const fs::path& script, FrameStats& stats)
+{
+    if (stats.frameTimes.empty())
+        return;
+
+    auto frameCount = static_cast<double>(stats.frameTimes.size());
+    double total = 0.0;
+    for (double t : stats.frameTimes)
+        total += t;
+
+    std::sort(stats.frameTimes.begin(), stats.frameTimes.end());
+    fmt::print("{}: {} frames, mean {:.2f} ms, p50 {:.2f} ms, p90 {:.2f} ms, p99 {:.2f} ms, max {:.2f} ms\n",
+               script, stats.frameTimes.size(), total / frameCount,
+               Percentile(stats.frameTimes, 0.5),
+               Percentile(stats.frameTimes, 0.9),
+               Percentile(stats.frameTimes, 0.99),
+               stats.frameTimes.back());
+
+    // The profiler's times are already averages over a few frames, so the
+    // mean of them is only a little smoothed.
+    for (std::size_t i = 0; i < PassCount; ++i)
+    {
+        const char* name = render::RenderProfiler::getPassName(static_cast<render::RenderPass>(i));
+        if (stats.hasGPUTimes)
+            fmt::print("  {:<16} CPU {:7.3f} ms  GPU {:7.3f} ms\n",
+                       name, stats.cpuTimes[i] / frameCount, stats.gpuTimes[i] / frameCount);
+        else
+            fmt::print("  {:<16} CPU {:7.3f} ms\n", name, stats.cpuTimes[i] / frameCount);
+    }
+}
+
+#ifdef HEADLESS_OFFSCREEN
+// Draws a frame and waits for the GPU to finish it, so that the frame time
+// covers all of the rendering.
+void
+DrawFrame(CelestiaCore& appCore, const Options& options, FrameStats& stats)
+{
+    auto start = std::chrono::steady_clock::now();
+    appCore.draw();
+    glFinish();
+    auto end = std::chrono::steady_clock::now();
+
+    if (!options.benchmark)
+        return;
+
+    stats.frameTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+
+    const render::RenderProfiler* profiler = appCore.getRenderer()->getProfiler();
+    if (profiler == nullptr)
+        return;
+
+    stats.hasGPUTimes = profiler->hasGPUTimes();
+    for (std::size_t i = 0; i < PassCount; ++i)
+    {
+        auto pass = static_cast<render::RenderPass>(i);
+        stats.cpuTimes[i] += profiler->getCPUTime(pass);
+        stats.gpuTimes[i] += profiler->getGPUTime(pass);
+    }
+}
+#endif
+
+// Returns true if the script ran to its end before the timeout without
+// reporting an error.
+bool
+RunScript(CelestiaCore& appCore,
+          HeadlessAlerter& alerter,
+          const fs::path& script,
+          const Options& options)
+{
+    alerter.errors = 0;
+    appCore.runScript(script, false);
+
+    FrameStats stats;
+    double elapsed = 0.0;
+    while (appCore.isScriptRunning() && elapsed < options.timeout)
+    {
+        appCore.tick(options.timeStep);
+        elapsed += options.timeStep;
+#ifdef HEADLESS_OFFSCREEN
+        if (options.width > 0)
+            DrawFrame(appCore, options, stats);
+#endif
+    }
+
+    if (appCore.isScriptRunning())
+    {
+        appCore.cancelScript();
+        fmt::print(stderr, "{}: timed out after {} s\n", script, options.timeout);
+        return false;
+    }
+
+    if (alerter.errors > 0)
+    {
+        fmt::print(stderr, "{}: failed\n", script);
+        return false;
+    }
+
+    fmt::print("{}: ok ({} s)\n", script, elapsed);
+    PrintFrameStats(script, stats);
+    return true;
+}
+
+int
+headlessmain(int argc, char** argv)
+{
+    CelestiaCore::initLocale();
+
+#ifdef ENABLE_NLS
+    bindtextdomain("celestia", LOCALEDIR);
+    bind_textdomain_codeset("celestia", "UTF-8");
+    bindtextdomain("celestia-data", LOCALEDIR);
+    bind_textdomain_codeset("celestia-data", "UTF-8");
+    textdomain("celestia");
+#endif
+
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    if (options.dataDir.empty())
+    {
+        const char* dataDir = std::getenv("CELESTIA_DATA_DIR");
+        options.dataDir = fs::u8path(dataDir == nullptr ? CONFIG_DATA_DIR : dataDir);
+    }
+
+    std::error_code ec;
+    fs::current_path(options.dataDir, ec);
+    if (ec)
+    {
+        fmt::print(stderr, "Cannot chdir to {}, probably due to improper installation\n", options.dataDir);
+        return 3;
+    }
+
+    HeadlessAlerter alerter;
+    CelestiaCore appCore;
+    appCore.setAlerter(&alerter);
+    if (!appCore.initSimulation(options.configFile, options.extrasDirs))
+    {
+        fmt::print(stderr, "Could not initialize Celestia!\n");
+        return 3;
+    }
+
+#ifdef HEADLESS_OFFSCREEN
+    std::unique_ptr<OffscreenContext> context;
+    if (options.width > 0)
+    {
+        std::string error;
+        context = OffscreenContext::create(options.width, options.height, error);
+        if (context == nullptr)
+        {
+            fmt::print(stderr, "Could not create an offscreen context: {}\n", error);
+            return 4;
+        }
+
+        gl::init();
+#ifndef GL_ES
+        if (!gl::checkVersion(gl::GL_2_1))
+        {
+            fmt::print(stderr, "Celestia requires OpenGL 2.1!\n");
+            return 5;
+        }
+#endif
+
+        if (!appCore.initRenderer())
+        {
+            fmt::print(stderr, "Could not initialize the renderer!\n");
+            return 5;
+        }
+
+        appCore.getRenderer()->setProfilingEnabled(options.benchmark);
+        // Keep the resolution fixed, and the script in step with the ticks
+        appCore.setOfflineRendering(true);
+    }
+#endif
+
+    appCore.setScriptTimeStepped(true);
+    appCore.start();
+#ifdef HEADLESS_OFFSCREEN
+    if (context != nullptr)
+        appCore.resize(context->width(), context->height());
+#endif
+    // Scripts should see the same catalogs on every run
+    appCore.finishBackgroundLoading();
+
+    int failures = 0;
+    for (const fs::path& script : options.scripts)
+    {
+        if (!RunScript(appCore, alerter, script, options))
+            ++failures;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
+
+} // end unnamed namespace
+
+} // end namespace celestia::headless
+
+int
+main(int argc, char** argv)
+{
+    return celestia::headless::headlessmain(argc, argv);
+}
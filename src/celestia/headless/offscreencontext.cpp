@@ -0,0 +1,126 @@
+// offscreencontext.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// OpenGL context without a window for the headless front end.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "offscreencontext.h"
+
+#include <array>
+#include <utility>
+
+#include <EGL/egl.h>
+#include <fmt/format.h>
+
+namespace celestia::headless
+{
+
+struct OffscreenContext::EGLState
+{
+    ~EGLState();
+
+    EGLDisplay display{ EGL_NO_DISPLAY };
+    EGLSurface surface{ EGL_NO_SURFACE };
+    EGLContext context{ EGL_NO_CONTEXT };
+};
+
+OffscreenContext::EGLState::~EGLState()
+{
+    if (display == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+    eglTerminate(display);
+}
+
+OffscreenContext::OffscreenContext(std::unique_ptr<EGLState>&& egl, int width, int height) :
+    m_egl(std::move(egl)),
+    m_width(width),
+    m_height(height)
+{
+}
+
+OffscreenContext::~OffscreenContext() = default;
+
+std::unique_ptr<OffscreenContext>
+OffscreenContext::create(int width, int height, std::string& error)
+{
+    auto egl = std::make_unique<EGLState>();
+    egl->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (egl->display == EGL_NO_DISPLAY || !eglInitialize(egl->display, nullptr, nullptr))
+    {
+        egl->display = EGL_NO_DISPLAY;
+        error = "no EGL display";
+        return nullptr;
+    }
+
+#ifdef GL_ES
+    constexpr EGLenum api = EGL_OPENGL_ES_API;
+    constexpr EGLint renderableType = EGL_OPENGL_ES2_BIT;
+    const std::array<EGLint, 3> contextAttribs{ EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+#else
+    constexpr EGLenum api = EGL_OPENGL_API;
+    constexpr EGLint renderableType = EGL_OPENGL_BIT;
+    const std::array<EGLint, 1> contextAttribs{ EGL_NONE };
+#endif
+
+    if (!eglBindAPI(api))
+    {
+        error = "OpenGL is not supported by EGL";
+        return nullptr;
+    }
+
+    const std::array<EGLint, 15> configAttribs
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, renderableType,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_STENCIL_SIZE, 8,
+        EGL_NONE,
+    };
+
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(egl->display, configAttribs.data(), &config, 1, &configCount) || configCount == 0)
+    {
+        error = "no suitable EGL config";
+        return nullptr;
+    }
+
+    const std::array<EGLint, 5> surfaceAttribs{ EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    egl->surface = eglCreatePbufferSurface(egl->display, config, surfaceAttribs.data());
+    if (egl->surface == EGL_NO_SURFACE)
+    {
+        error = fmt::format("could not create a {}x{} pbuffer", width, height);
+        return nullptr;
+    }
+
+    egl->context = eglCreateContext(egl->display, config, EGL_NO_CONTEXT, contextAttribs.data());
+    if (egl->context == EGL_NO_CONTEXT)
+    {
+        error = "could not create an EGL context";
+        return nullptr;
+    }
+
+    if (!eglMakeCurrent(egl->display, egl->surface, egl->surface, egl->context))
+    {
+        error = "could not make the EGL context current";
+        return nullptr;
+    }
+
+    return std::unique_ptr<OffscreenContext>(new OffscreenContext(std::move(egl), width, height));
+}
+
+} // end namespace celestia::headless
@@ -0,0 +1,46 @@
+// offscreencontext.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// OpenGL context without a window for the headless front end.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace celestia::headless
+{
+
+// An EGL context rendering to a pbuffer surface of a fixed size. It is made
+// current on creation and stays current until it is destroyed.
+class OffscreenContext
+{
+public:
+    ~OffscreenContext();
+
+    OffscreenContext(const OffscreenContext&) = delete;
+    OffscreenContext& operator=(const OffscreenContext&) = delete;
+
+    // Returns nullptr and sets error if no context could be created
+    static std::unique_ptr<OffscreenContext> create(int width, int height, std::string& error);
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+private:
+    struct EGLState;
+
+    OffscreenContext(std::unique_ptr<EGLState>&&, int width, int height);
+
+    std::unique_ptr<EGLState> m_egl;
+    int m_width;
+    int m_height;
+};
+
+} // end namespace celestia::headless
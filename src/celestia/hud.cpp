@@ -21,6 +21,7 @@
 #include <Eigen/Geometry>
 
 #include <fmt/format.h>
+#include <fmt/printf.h>
 #if FMT_VERSION < 90000
 #include <fmt/locale.h>
 #endif
@@ -38,6 +39,7 @@
 #include <celengine/universe.h>
 #include <celmath/geomutil.h>
 #include <celmath/mathlib.h>
+#include <celrender/renderprofiler.h>
 #include <celutil/flag.h>
 #include <celutil/formatnum.h>
 #include <celutil/gettext.h>
@@ -66,6 +68,43 @@ constexpr double OneLbPerFt3InKgPerM3 = OneLbInKg / math::cube(OneFtInKm * 1000.
 
 constexpr util::NumberFormat SigDigitNum = util::NumberFormat::GroupThousands | util::NumberFormat::SignificantFigures;
 
+// Appends formatted text to a HUD text block, with the printing interface
+// of Overlay
+class TextWriter
+{
+public:
+    explicit TextWriter(std::string& text) : m_text(text) {}
+
+    void print(std::string_view s)
+    {
+        m_text.append(s);
+    }
+
+    template <typename... T>
+    void print(const std::locale& loc, std::string_view format, const T&... args)
+    {
+        static_assert(sizeof...(args) > 0);
+        print(fmt::format(loc, format, args...));
+    }
+
+    template <typename... T>
+    void print(std::string_view format, const T&... args)
+    {
+        static_assert(sizeof...(args) > 0);
+        print(fmt::format(format, args...));
+    }
+
+    template <typename... T>
+    void printf(std::string_view format, const T&... args)
+    {
+        static_assert(sizeof...(args) > 0);
+        print(fmt::sprintf(format, args...));
+    }
+
+private:
+    std::string& m_text;
+};
+
 constexpr float
 KelvinToCelsius(float kelvin)
 {
@@ -149,7 +188,7 @@ DistanceKmToStr(const util::NumberFormatter& formatter, double distance, int dig
 }
 
 void
-displayRotationPeriod(const util::NumberFormatter& formatter, Overlay& overlay, double days)
+displayRotationPeriod(const util::NumberFormatter& formatter, TextWriter& textOut, double days)
 {
     double unitValue;
     const char *unitStr;
@@ -175,31 +214,31 @@ displayRotationPeriod(const util::NumberFormatter& formatter, Overlay& overlay,
         unitStr = _("seconds");
     }
 
-    overlay.print(_("Rotation period: {} {}\n"), formatter.format(unitValue, 3), unitStr);
+    textOut.print(_("Rotation period: {} {}\n"), formatter.format(unitValue, 3), unitStr);
 }
 
 void
-displayMass(const util::NumberFormatter& formatter, Overlay& overlay, float mass, MeasurementSystem measurement)
+displayMass(const util::NumberFormatter& formatter, TextWriter& textOut, float mass, MeasurementSystem measurement)
 {
     if (mass < 0.001f)
     {
         if (measurement == MeasurementSystem::Imperial)
-            overlay.print(_("Mass: {} lb\n"),
+            textOut.print(_("Mass: {} lb\n"),
                           formatter.format(mass * astro::EarthMass / static_cast<float>(OneLbInKg), 4, SigDigitNum));
         else
-            overlay.print(_("Mass: {} kg\n"),
+            textOut.print(_("Mass: {} kg\n"),
                           formatter.format(mass * astro::EarthMass, 4, SigDigitNum));
     }
     else if (mass > 50.0f)
-        overlay.print(_("Mass: {} Mj\n"),
+        textOut.print(_("Mass: {} Mj\n"),
                       formatter.format(mass * astro::EarthMass / astro::JupiterMass, 4, SigDigitNum));
     else
-        overlay.print(_("Mass: {} Me\n"),
+        textOut.print(_("Mass: {} Me\n"),
                       formatter.format(mass, 4, SigDigitNum));
 }
 
 void
-displaySpeed(const util::NumberFormatter& formatter, Overlay& overlay, float speed, MeasurementSystem measurement)
+displaySpeed(const util::NumberFormatter& formatter, TextWriter& textOut, float speed, MeasurementSystem measurement)
 {
     float unitValue;
     const char *unitStr;
@@ -245,7 +284,7 @@ displaySpeed(const util::NumberFormatter& formatter, Overlay& overlay, float spe
             unitStr = _("m/s");
         }
     }
-    overlay.print(_("Speed: {} {}\n"), formatter.format(unitValue, 3, SigDigitNum), unitStr);
+    textOut.print(_("Speed: {} {}\n"), formatter.format(unitValue, 3, SigDigitNum), unitStr);
 }
 
 // Display a positive angle as degrees, minutes, and seconds. If the angle is less than one
@@ -274,7 +313,7 @@ angleToStr(double angle, const std::locale& loc)
 }
 
 void
-displayApparentDiameter(Overlay& overlay, double radius, double distance, const std::locale& loc)
+displayApparentDiameter(TextWriter& textOut, double radius, double distance, const std::locale& loc)
 {
     if (distance < radius)
         return;
@@ -284,36 +323,36 @@ displayApparentDiameter(Overlay& overlay, double radius, double distance, const
     // Only display the arc size if it's less than 160 degrees and greater
     // than one second--otherwise, it's probably not interesting data.
     if (arcSize < 160.0 && arcSize > 1.0 / 3600.0)
-        overlay.printf(_("Apparent diameter: %s\n"), angleToStr(arcSize, loc));
+        textOut.printf(_("Apparent diameter: %s\n"), angleToStr(arcSize, loc));
 }
 
 void
-displayDeclination(Overlay& overlay, double angle, const std::locale& loc)
+displayDeclination(TextWriter& textOut, double angle, const std::locale& loc)
 {
     int degrees;
     int minutes;
     double seconds;
     astro::decimalToDegMinSec(angle, degrees, minutes, seconds);
 
-    overlay.print(loc, _("Dec: {:+d}{} {:02d}' {:.1f}\"\n"),
+    textOut.print(loc, _("Dec: {:+d}{} {:02d}' {:.1f}\"\n"),
                   std::abs(degrees), UTF8_DEGREE_SIGN,
                   std::abs(minutes), std::abs(seconds));
 }
 
 void
-displayRightAscension(Overlay& overlay, double angle, const std::locale& loc)
+displayRightAscension(TextWriter& textOut, double angle, const std::locale& loc)
 {
     int hours;
     int minutes;
     double seconds;
     astro::decimalToHourMinSec(angle, hours, minutes, seconds);
 
-    overlay.print(loc, _("RA: {}h {:02}m {:.1f}s\n"),
+    textOut.print(loc, _("RA: {}h {:02}m {:.1f}s\n"),
                   hours, abs(minutes), abs(seconds));
 }
 
 void
-displayApparentMagnitude(Overlay& overlay,
+displayApparentMagnitude(TextWriter& textOut,
                          float absMag,
                          double distance,
                          const std::locale& loc)
@@ -321,16 +360,16 @@ displayApparentMagnitude(Overlay& overlay,
     if (distance > 32.6167)
     {
         float appMag = astro::absToAppMag(absMag, static_cast<float>(distance));
-        overlay.print(loc, _("Apparent magnitude: {:.1f}\n"), appMag);
+        textOut.print(loc, _("Apparent magnitude: {:.1f}\n"), appMag);
     }
     else
     {
-        overlay.print(loc, _("Absolute magnitude: {:.1f}\n"), absMag);
+        textOut.print(loc, _("Absolute magnitude: {:.1f}\n"), absMag);
     }
 }
 
 void
-displayRADec(Overlay& overlay, const Eigen::Vector3d& v, const std::locale& loc)
+displayRADec(TextWriter& textOut, const Eigen::Vector3d& v, const std::locale& loc)
 {
     double phi = std::atan2(v.x(), v.z()) - celestia::numbers::pi / 2;
     if (phi < 0.0)
@@ -343,8 +382,8 @@ displayRADec(Overlay& overlay, const Eigen::Vector3d& v, const std::locale& loc)
         theta = -celestia::numbers::pi * 0.5 - theta;
 
 
-    displayRightAscension(overlay, math::radToDeg(phi), loc);
-    displayDeclination(overlay, math::radToDeg(theta), loc);
+    displayRightAscension(textOut, math::radToDeg(phi), loc);
+    displayDeclination(textOut, math::radToDeg(theta), loc);
 }
 
 // Display nicely formatted planetocentric/planetographic coordinates.
@@ -352,7 +391,7 @@ displayRADec(Overlay& overlay, const Eigen::Vector3d& v, const std::locale& loc)
 // is in kilometers.
 void
 displayPlanetocentricCoords(const util::NumberFormatter& formatter,
-                            Overlay& overlay,
+                            TextWriter& textOut,
                             const Body& body,
                             double longitude,
                             double latitude,
@@ -404,14 +443,14 @@ displayPlanetocentricCoords(const util::NumberFormatter& formatter,
         lat = std::abs(math::radToDeg(latitude));
     }
 
-    overlay.print(loc, _("{:.6f}{} {:.6f}{} {}"),
+    textOut.print(loc, _("{:.6f}{} {:.6f}{} {}"),
                   lat, nsHemi, lon, ewHemi,
                   DistanceKmToStr(formatter, altitude, 5, measurement));
 }
 
 void
 displayStarInfo(const util::NumberFormatter& formatter,
-                Overlay& overlay,
+                TextWriter& textOut,
                 int detail,
                 const Star& star,
                 const Universe& universe,
@@ -419,21 +458,21 @@ displayStarInfo(const util::NumberFormatter& formatter,
                 const HudSettings& hudSettings,
                 const std::locale& loc)
 {
-    overlay.printf(_("Distance: %s\n"),
+    textOut.printf(_("Distance: %s\n"),
                    DistanceLyToStr(formatter, distance, 5, hudSettings.measurementSystem));
 
     if (!star.getVisibility())
     {
-        overlay.print(_("Star system barycenter\n"));
+        textOut.print(_("Star system barycenter\n"));
     }
     else
     {
-        overlay.print(loc, _("Abs (app) mag: {:.2f} ({:.2f})\n"),
+        textOut.print(loc, _("Abs (app) mag: {:.2f} ({:.2f})\n"),
                       star.getAbsoluteMagnitude(),
                       star.getApparentMagnitude(float(distance)));
 
         if (star.getLuminosity() > 1.0e-10f)
-            overlay.print(loc, _("Luminosity: {}x Sun\n"), formatter.format(star.getLuminosity(), 3, SigDigitNum));
+            textOut.print(loc, _("Luminosity: {}x Sun\n"), formatter.format(star.getLuminosity(), 3, SigDigitNum));
 
         const char* star_class;
         switch (star.getSpectralType()[0])
@@ -447,32 +486,32 @@ displayStarInfo(const util::NumberFormatter& formatter,
         default:
             star_class = star.getSpectralType();
         }
-        overlay.printf(_("Class: %s\n"), star_class);
+        textOut.printf(_("Class: %s\n"), star_class);
 
-        displayApparentDiameter(overlay, star.getRadius(),
+        displayApparentDiameter(textOut, star.getRadius(),
                                 astro::lightYearsToKilometers(distance), loc);
 
         if (detail > 1)
         {
-            overlay.printf(_("Surface temp: %s\n"),
+            textOut.printf(_("Surface temp: %s\n"),
                            KelvinToStr(formatter, star.getTemperature(), 3, hudSettings.temperatureScale));
 
             if (float solarRadii = star.getRadius() / 6.96e5f; solarRadii > 0.01f)
             {
-                overlay.print(_("Radius: {} Rsun  ({})\n"),
+                textOut.print(_("Radius: {} Rsun  ({})\n"),
                               formatter.format(star.getRadius() / 696000.0f, 2, SigDigitNum),
                               DistanceKmToStr(formatter, star.getRadius(), 3, hudSettings.measurementSystem));
             }
             else
             {
-                overlay.print(_("Radius: {}\n"),
+                textOut.print(_("Radius: {}\n"),
                               DistanceKmToStr(formatter, star.getRadius(), 3, hudSettings.measurementSystem));
             }
 
             if (star.getRotationModel()->isPeriodic())
             {
                 auto period = static_cast<float>(star.getRotationModel()->getPeriod());
-                displayRotationPeriod(formatter, overlay, period);
+                displayRotationPeriod(formatter, textOut, period);
             }
         }
     }
@@ -481,37 +520,37 @@ displayStarInfo(const util::NumberFormatter& formatter,
     {
         const SolarSystem* sys = universe.getSolarSystem(&star);
         if (sys != nullptr && sys->getPlanets()->getSystemSize() != 0)
-            overlay.print(_("Planetary companions present\n"));
+            textOut.print(_("Planetary companions present\n"));
     }
 }
 
 void displayDSOinfo(const util::NumberFormatter& formatter,
-                    Overlay& overlay,
+                    TextWriter& textOut,
                     const DeepSkyObject& dso,
                     double distance,
                     MeasurementSystem measurement,
                     const std::locale& loc)
 {
-    overlay.print(dso.getDescription());
-    overlay.print("\n");
+    textOut.print(dso.getDescription());
+    textOut.print("\n");
 
     if (distance >= 0.0)
     {
-        overlay.printf(_("Distance: %s\n"),
+        textOut.printf(_("Distance: %s\n"),
                      DistanceLyToStr(formatter, distance, 5, measurement));
     }
     else
     {
-        overlay.printf(_("Distance from center: %s\n"),
+        textOut.printf(_("Distance from center: %s\n"),
                      DistanceLyToStr(formatter, distance + dso.getRadius(), 5, measurement));
      }
-    overlay.printf(_("Radius: %s\n"),
+    textOut.printf(_("Radius: %s\n"),
                  DistanceLyToStr(formatter, dso.getRadius(), 5, measurement));
 
-    displayApparentDiameter(overlay, dso.getRadius(), distance, loc);
+    displayApparentDiameter(textOut, dso.getRadius(), distance, loc);
     if (dso.getAbsoluteMagnitude() > DSO_DEFAULT_ABS_MAGNITUDE)
     {
-        displayApparentMagnitude(overlay,
+        displayApparentMagnitude(textOut,
                                  dso.getAbsoluteMagnitude(),
                                  distance,
                                  loc);
@@ -520,7 +559,7 @@ void displayDSOinfo(const util::NumberFormatter& formatter,
 
 void
 displayPlanetInfo(const util::NumberFormatter& formatter,
-                  Overlay& overlay,
+                  TextWriter& textOut,
                   int detail,
                   const Body& body,
                   double t,
@@ -530,7 +569,7 @@ displayPlanetInfo(const util::NumberFormatter& formatter,
 {
     double distanceKm = viewVec.norm();
     double distance = distanceKm - body.getRadius();
-    overlay.printf(_("Distance: %s\n"),
+    textOut.printf(_("Distance: %s\n"),
                    DistanceKmToStr(formatter, distance, 5, hudSettings.measurementSystem));
 
     if (body.getClassification() == BodyClassification::Invisible)
@@ -544,7 +583,7 @@ displayPlanetInfo(const util::NumberFormatter& formatter,
         double axis0 = semiAxes.x();
         double axis1 = semiAxes.z();
         double axis2 = semiAxes.y(); // polar semi-axis
-        overlay.print(_("Radius: {} ({} " UTF8_MULTIPLICATION_SIGN " {} " UTF8_MULTIPLICATION_SIGN " {})\n"),
+        textOut.print(_("Radius: {} ({} " UTF8_MULTIPLICATION_SIGN " {} " UTF8_MULTIPLICATION_SIGN " {})\n"),
                       DistanceKmToStr(formatter, radiusMean, 5, hudSettings.measurementSystem),
                       DistanceKmToStr(formatter, axis0, 5, hudSettings.measurementSystem),
                       DistanceKmToStr(formatter, axis1, 5, hudSettings.measurementSystem),
@@ -552,11 +591,11 @@ displayPlanetInfo(const util::NumberFormatter& formatter,
     }
     else
     {
-        overlay.print(_("Radius: {}\n"),
+        textOut.print(_("Radius: {}\n"),
                       DistanceKmToStr(formatter, body.getRadius(), 5, hudSettings.measurementSystem));
     }
 
-    displayApparentDiameter(overlay, body.getRadius(), distanceKm, loc);
+    displayApparentDiameter(textOut, body.getRadius(), distanceKm, loc);
 
     // Display the phase angle
 
@@ -599,46 +638,46 @@ displayPlanetInfo(const util::NumberFormatter& formatter,
             sunVec.normalize();
             double cosPhaseAngle = std::clamp(sunVec.dot(viewVec.normalized()), -1.0, 1.0);
             double phaseAngle = acos(cosPhaseAngle);
-            overlay.print(loc, _("Phase angle: {:.1f}{}\n"), math::radToDeg(phaseAngle), UTF8_DEGREE_SIGN);
+            textOut.print(loc, _("Phase angle: {:.1f}{}\n"), math::radToDeg(phaseAngle), UTF8_DEGREE_SIGN);
         }
     }
 
     if (detail > 1)
     {
         if (body.getRotationModel(t)->isPeriodic())
-            displayRotationPeriod(formatter, overlay, body.getRotationModel(t)->getPeriod());
+            displayRotationPeriod(formatter, textOut, body.getRotationModel(t)->getPeriod());
 
         if (body.getMass() > 0)
-            displayMass(formatter, overlay, body.getMass(), hudSettings.measurementSystem);
+            displayMass(formatter, textOut, body.getMass(), hudSettings.measurementSystem);
 
         if (float density = body.getDensity(); density > 0)
         {
             if (hudSettings.measurementSystem == MeasurementSystem::Imperial)
             {
-                overlay.print(_("Density: {} lb/ft³\n"),
+                textOut.print(_("Density: {} lb/ft³\n"),
                               formatter.format(density / static_cast<float>(OneLbPerFt3InKgPerM3), 4, SigDigitNum));
             }
             else
             {
-                overlay.print(_("Density: {} kg/m³\n"), formatter.format(density, 4, SigDigitNum));
+                textOut.print(_("Density: {} kg/m³\n"), formatter.format(density, 4, SigDigitNum));
             }
         }
 
         float planetTemp = body.getTemperature(t);
         if (planetTemp > 0)
-            overlay.printf(_("Temperature: %s\n"), KelvinToStr(formatter, planetTemp, 3, hudSettings.temperatureScale));
+            textOut.printf(_("Temperature: %s\n"), KelvinToStr(formatter, planetTemp, 3, hudSettings.temperatureScale));
     }
 }
 
 void
 displayLocationInfo(const util::NumberFormatter& formatter,
-                    Overlay& overlay,
+                    TextWriter& textOut,
                     const Location& location,
                     double distanceKm,
                     MeasurementSystem measurement,
                     const std::locale& loc)
 {
-    overlay.printf(_("Distance: %s\n"), DistanceKmToStr(formatter, distanceKm, 5, measurement));
+    textOut.printf(_("Distance: %s\n"), DistanceKmToStr(formatter, distanceKm, 5, measurement));
 
     const Body* body = location.getParentBody();
     if (body == nullptr)
@@ -646,7 +685,7 @@ displayLocationInfo(const util::NumberFormatter& formatter,
 
     Eigen::Vector3f locPos = location.getPosition();
     Eigen::Vector3d lonLatAlt = body->cartesianToPlanetocentric(locPos.cast<double>());
-    displayPlanetocentricCoords(formatter, overlay, *body,
+    displayPlanetocentricCoords(formatter, textOut, *body,
                                 lonLatAlt.x(), lonLatAlt.y(), lonLatAlt.z(), measurement, loc);
 }
 
@@ -875,6 +914,7 @@ Hud::renderOverlay(const WindowMetrics& metrics,
                    const Simulation* sim,
                    const ViewManager& views,
                    const MovieCapture* movieCapture,
+                   const render::RenderProfiler* profiler,
                    const TimeInfo& timeInfo,
                    bool isScriptRunning,
                    bool editMode)
@@ -904,15 +944,22 @@ Hud::renderOverlay(const WindowMetrics& metrics,
                           metrics.getSafeAreaBottom(m_hudFonts.fontHeight() * 2 + static_cast<int>(static_cast<float>(metrics.screenDpi) / 25.4f * 1.3f)));
         m_overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
 
-        m_overlay->beginText();
-        m_overlay->print("\n");
-        if (m_hudSettings.showFPSCounter)
-            m_overlay->print(loc, _("FPS: {:.1f}\n"), timeInfo.fps);
-        else
-            m_overlay->print("\n");
+        auto speed = static_cast<float>(sim->getObserver().getVelocity().norm());
+        long fps = m_hudSettings.showFPSCounter ? std::lround(timeInfo.fps * 10.0) : -1L;
+        if (m_speedText.update({ fps, speed, m_hudSettings.measurementSystem }))
+        {
+            TextWriter textOut(m_speedText.text());
+            textOut.print("\n");
+            if (m_hudSettings.showFPSCounter)
+                textOut.print(loc, _("FPS: {:.1f}\n"), timeInfo.fps);
+            else
+                textOut.print("\n");
 
-        displaySpeed(*m_numberFormatter, *m_overlay, static_cast<float>(sim->getObserver().getVelocity().norm()), m_hudSettings.measurementSystem);
+            displaySpeed(*m_numberFormatter, textOut, speed, m_hudSettings.measurementSystem);
+        }
 
+        m_overlay->beginText();
+        m_overlay->print(m_speedText.text());
         m_overlay->endText();
         m_overlay->restorePos();
     }
@@ -936,6 +983,9 @@ Hud::renderOverlay(const WindowMetrics& metrics,
     if (movieCapture != nullptr)
         renderMovieCapture(metrics, *movieCapture);
 
+    if (profiler != nullptr && m_hudDetail > 0)
+        renderProfile(metrics, *profiler);
+
     if (editMode)
     {
         m_overlay->savePos();
@@ -965,8 +1015,15 @@ Hud::renderTimeInfo(const WindowMetrics& metrics, const Simulation* sim, const T
         lt = v.norm() / static_cast<double>(86400.0_c);
     }
 
+    // The date is shown to the second, so it only has to be formatted again
+    // once a second of UTC has passed
     double tdb = sim->getTime() + lt;
-    auto dateStr = m_dateFormatter->formatDate(tdb, timeInfo.timeZoneBias != 0, m_dateFormat);
+    double utcSeconds = std::floor(static_cast<double>(astro::TDBtoUTC(tdb)) * 86400.0);
+    bool local = timeInfo.timeZoneBias != 0;
+    if (m_dateText.update({ utcSeconds, local, m_dateFormat }))
+        m_dateText.text() = m_dateFormatter->formatDate(tdb, local, m_dateFormat);
+
+    const std::string& dateStr = m_dateText.text();
     auto fullDateStr = timeInfo.lightTravelFlag ? dateStr + _("  LT") : dateStr;
 
     m_dateStrWidth = std::max(m_dateStrWidth, engine::TextLayout::getTextWidth(fullDateStr, m_hudFonts.font().get()) + 2 * m_hudFonts.emWidth());
@@ -987,26 +1044,32 @@ Hud::renderTimeInfo(const WindowMetrics& metrics, const Simulation* sim, const T
     }
     m_overlay->print("\n");
 
-    if (std::abs(std::abs(sim->getTimeScale()) - 1.0) < 1e-6)
+    if (double timeScale = sim->getTimeScale(); m_timeRateText.update(timeScale))
     {
-        if (math::sign(sim->getTimeScale()) == 1)
-            m_overlay->print(_("Real time"));
+        TextWriter textOut(m_timeRateText.text());
+        if (std::abs(std::abs(timeScale) - 1.0) < 1e-6)
+        {
+            if (math::sign(timeScale) == 1)
+                textOut.print(_("Real time"));
+            else
+                textOut.print(_("-Real time"));
+        }
+        else if (std::abs(timeScale) < TimeInfo::MinimumTimeRate)
+        {
+            textOut.print(_("Time stopped"));
+        }
+        else if (std::abs(timeScale) > 1.0)
+        {
+            textOut.print(loc, _("{:.6g} x faster"), timeScale); // XXX: %'.12g
+        }
         else
-            m_overlay->print(_("-Real time"));
-    }
-    else if (std::abs(sim->getTimeScale()) < TimeInfo::MinimumTimeRate)
-    {
-        m_overlay->print(_("Time stopped"));
-    }
-    else if (std::abs(sim->getTimeScale()) > 1.0)
-    {
-        m_overlay->print(loc, _("{:.6g} x faster"), sim->getTimeScale()); // XXX: %'.12g
-    }
-    else
-    {
-        m_overlay->print(loc, _("{:.6g} x slower"), 1.0 / sim->getTimeScale()); // XXX: %'.12g
+        {
+            textOut.print(loc, _("{:.6g} x slower"), 1.0 / timeScale); // XXX: %'.12g
+        }
     }
 
+    m_overlay->print(m_timeRateText.text());
+
     if (sim->getPauseState() == true)
     {
         m_overlay->setColor(1.0f, 0.0f, 0.0f, 1.0f);
@@ -1025,62 +1088,74 @@ Hud::renderFrameInfo(const WindowMetrics& metrics, const Simulation* sim)
     m_overlay->moveBy(metrics.getSafeAreaEnd(m_hudFonts.emWidth() * 15),
                       metrics.getSafeAreaBottom(m_hudFonts.fontHeight() * 3 +
                           static_cast<int>(static_cast<float>(metrics.screenDpi) / 25.4f * 1.3f)));
-    m_overlay->beginText();
-    m_overlay->setColor(0.6f, 0.6f, 1.0f, 1);
+    const Observer* activeObserver = sim->getActiveObserver();
+    float fov = math::radToDeg(activeObserver->getFOV());
+    float zoom = activeObserver->getZoom();
 
+    long timeLeft = -1;
     if (sim->getObserverMode() == Observer::Travelling)
     {
-        double timeLeft = sim->getArrivalTime() - sim->getRealTime();
-        if (timeLeft >= 1)
-            m_overlay->print(_("Travelling ({})\n"), m_numberFormatter->format(timeLeft, 0));
-        else
-            m_overlay->print(_("Travelling\n"));
+        double travelTime = sim->getArrivalTime() - sim->getRealTime();
+        timeLeft = travelTime >= 1.0 ? std::lround(travelTime) : 0L;
     }
-    else
+
+    const ObserverFrame* frame = sim->getFrame().get();
+    Selection refObject = frame->getRefObject();
+    Selection targetObject = frame->getTargetObject();
+    if (m_frameText.update({ timeLeft, sim->getTrackedObject(), static_cast<int>(frame->getCoordinateSystem()),
+                              refObject, targetObject }))
     {
-        m_overlay->print("\n");
-    }
+        TextWriter textOut(m_frameText.text());
+        if (timeLeft >= 1)
+            textOut.print(_("Travelling ({})\n"), m_numberFormatter->format(static_cast<double>(timeLeft), 0));
+        else if (timeLeft == 0)
+            textOut.print(_("Travelling\n"));
+        else
+            textOut.print("\n");
 
-    const Universe& u = *sim->getUniverse();
+        const Universe& u = *sim->getUniverse();
 
-    if (!sim->getTrackedObject().empty())
-        m_overlay->printf(_("Track %s\n"), CX_("Track", getSelectionName(sim->getTrackedObject(), u)));
-    else
-        m_overlay->print("\n");
+        if (!sim->getTrackedObject().empty())
+            textOut.printf(_("Track %s\n"), CX_("Track", getSelectionName(sim->getTrackedObject(), u)));
+        else
+            textOut.print("\n");
 
-    Selection refObject = sim->getFrame()->getRefObject();
-    switch (sim->getFrame()->getCoordinateSystem())
-    {
-    case ObserverFrame::Ecliptical:
-        m_overlay->printf(_("Follow %s\n"),
-                          CX_("Follow", getSelectionName(refObject, u)));
-        break;
-    case ObserverFrame::BodyFixed:
-        m_overlay->printf(_("Sync Orbit %s\n"),
-                          CX_("Sync", getSelectionName(refObject, u)));
-        break;
-    case ObserverFrame::PhaseLock:
-        m_overlay->printf(_("Lock %s -> %s\n"),
-                          CX_("Lock", getSelectionName(refObject, u)),
-                          CX_("LockTo", getSelectionName(sim->getFrame()->getTargetObject(), u)));
-        break;
-
-    case ObserverFrame::Chase:
-        m_overlay->printf(_("Chase %s\n"),
-                          CX_("Chase", getSelectionName(refObject, u)));
-        break;
+        switch (frame->getCoordinateSystem())
+        {
+        case ObserverFrame::Ecliptical:
+            textOut.printf(_("Follow %s\n"),
+                           CX_("Follow", getSelectionName(refObject, u)));
+            break;
+        case ObserverFrame::BodyFixed:
+            textOut.printf(_("Sync Orbit %s\n"),
+                           CX_("Sync", getSelectionName(refObject, u)));
+            break;
+        case ObserverFrame::PhaseLock:
+            textOut.printf(_("Lock %s -> %s\n"),
+                           CX_("Lock", getSelectionName(refObject, u)),
+                           CX_("LockTo", getSelectionName(targetObject, u)));
+            break;
 
-    default:
-        m_overlay->print("\n");
-        break;
-    }
+        case ObserverFrame::Chase:
+            textOut.printf(_("Chase %s\n"),
+                           CX_("Chase", getSelectionName(refObject, u)));
+            break;
 
-    m_overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
+        default:
+            textOut.print("\n");
+            break;
+        }
+    }
 
     // Field of view
-    const Observer* activeObserver = sim->getActiveObserver();
-    float fov = math::radToDeg(activeObserver->getFOV());
-    m_overlay->print(loc, _("FOV: {} ({:.2f}x)\n"), angleToStr(fov, loc), activeObserver->getZoom());
+    if (m_fovText.update({ fov, zoom }))
+        m_fovText.text() = fmt::format(loc, _("FOV: {} ({:.2f}x)\n"), angleToStr(fov, loc), zoom);
+
+    m_overlay->beginText();
+    m_overlay->setColor(0.6f, 0.6f, 1.0f, 1);
+    m_overlay->print(m_frameText.text());
+    m_overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
+    m_overlay->print(m_fovText.text());
     m_overlay->endText();
     m_overlay->restorePos();
 }
@@ -1091,101 +1166,34 @@ Hud::renderSelectionInfo(const WindowMetrics& metrics,
                          Selection sel,
                          const Eigen::Vector3d& v)
 {
-    m_overlay->savePos();
-    m_overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
-    m_overlay->moveBy(metrics.getSafeAreaStart(), metrics.getSafeAreaTop(m_hudFonts.titleFontHeight()));
-
-    m_overlay->beginText();
-
-    switch (sel.getType())
+    if (sel != m_lastSelection)
     {
-    case SelectionType::Star:
-        {
-            if (sel != m_lastSelection)
-            {
-                m_lastSelection = sel;
-                m_selectionNames = sim->getUniverse()->getStarCatalog()->getStarNameList(*sel.star());
-            }
-
-            m_overlay->setFont(m_hudFonts.titleFont());
-            m_overlay->print(m_selectionNames);
-            m_overlay->setFont(m_hudFonts.font());
-            m_overlay->print("\n");
-            displayStarInfo(*m_numberFormatter,
-                            *m_overlay,
-                             m_hudDetail,
-                            *(sel.star()),
-                            *(sim->getUniverse()),
-                             astro::kilometersToLightYears(v.norm()),
-                             m_hudSettings,
-                             loc);
-        }
-        break;
-
-    case SelectionType::DeepSky:
-        {
-            if (sel != m_lastSelection)
-            {
-                m_lastSelection = sel;
-                m_selectionNames = sim->getUniverse()->getDSOCatalog()->getDSONameList(sel.deepsky());
-            }
-
-            m_overlay->setFont(m_hudFonts.titleFont());
-            m_overlay->print(m_selectionNames);
-            m_overlay->setFont(m_hudFonts.font());
-            m_overlay->print("\n");
-            displayDSOinfo(*m_numberFormatter,
-                           *m_overlay,
-                           *sel.deepsky(),
-                            astro::kilometersToLightYears(v.norm()) - sel.deepsky()->getRadius(),
-                            m_hudSettings.measurementSystem,
-                            loc);
-        }
-        break;
-
-    case SelectionType::Body:
+        m_lastSelection = sel;
+        switch (sel.getType())
         {
+        case SelectionType::Star:
+            m_selectionNames = sim->getUniverse()->getStarCatalog()->getStarNameList(*sel.star());
+            break;
+        case SelectionType::DeepSky:
+            m_selectionNames = sim->getUniverse()->getDSOCatalog()->getDSONameList(sel.deepsky());
+            break;
+        case SelectionType::Body:
             // Show all names for the body
-            if (sel != m_lastSelection)
-            {
-                m_lastSelection = sel;
-                m_selectionNames = getBodySelectionNames(*sel.body());
-            }
-
-            m_overlay->setFont(m_hudFonts.titleFont());
-            m_overlay->print(m_selectionNames);
-            m_overlay->setFont(m_hudFonts.font());
-            m_overlay->print("\n");
-            displayPlanetInfo(*m_numberFormatter,
-                              *m_overlay,
-                               m_hudDetail,
-                              *(sel.body()),
-                               sim->getTime(),
-                               v,
-                               m_hudSettings,
-                               loc);
+            m_selectionNames = getBodySelectionNames(*sel.body());
+            break;
+        case SelectionType::Location:
+            m_selectionNames = sel.location()->getName(true);
+            break;
+        default:
+            m_selectionNames.clear();
+            break;
         }
-        break;
-
-    case SelectionType::Location:
-        m_overlay->setFont(m_hudFonts.titleFont());
-        m_overlay->print(sel.location()->getName(true).c_str());
-        m_overlay->setFont(m_hudFonts.font());
-        m_overlay->print("\n");
-        displayLocationInfo(*m_numberFormatter,
-                            *m_overlay,
-                            *(sel.location()),
-                             v.norm(),
-                             m_hudSettings.measurementSystem,
-                             loc);
-        break;
-
-    default:
-        break;
     }
 
     // Display RA/Dec for the selection, but only when the observer is near
     // the Earth.
+    bool showRADec = false;
+    Eigen::Vector3d vEarth = Eigen::Vector3d::Zero();
     if (const Body* refObject = sim->getFrame()->getRefObject().body();
         refObject != nullptr && refObject->getName() == "Earth")
     {
@@ -1199,12 +1207,81 @@ Hud::renderSelectionInfo(const WindowMetrics& metrics,
             // Only show the coordinates for stars and deep sky objects, where
             // the geocentric values will match the apparent values for observers
             // near the Earth.
-            Eigen::Vector3d vEarth = sel.getPosition(sim->getTime()).offsetFromKm(refObject->getPosition(sim->getTime()));
+            vEarth = sel.getPosition(sim->getTime()).offsetFromKm(refObject->getPosition(sim->getTime()));
             vEarth = math::XRotation(astro::J2000Obliquity) * vEarth;
-            displayRADec(*m_overlay, vEarth, loc);
+            showRADec = true;
+        }
+    }
+
+    // Only the information shown for bodies depends on the time directly
+    double t = sel.getType() == SelectionType::Body ? sim->getTime() : 0.0;
+    if (m_selectionText.update({ sel, m_hudDetail, m_hudSettings.measurementSystem, m_hudSettings.temperatureScale,
+                                 v, t, showRADec, vEarth }))
+    {
+        TextWriter textOut(m_selectionText.text());
+        switch (sel.getType())
+        {
+        case SelectionType::Star:
+            displayStarInfo(*m_numberFormatter,
+                            textOut,
+                            m_hudDetail,
+                            *(sel.star()),
+                            *(sim->getUniverse()),
+                            astro::kilometersToLightYears(v.norm()),
+                            m_hudSettings,
+                            loc);
+            break;
+
+        case SelectionType::DeepSky:
+            displayDSOinfo(*m_numberFormatter,
+                           textOut,
+                           *sel.deepsky(),
+                           astro::kilometersToLightYears(v.norm()) - sel.deepsky()->getRadius(),
+                           m_hudSettings.measurementSystem,
+                           loc);
+            break;
+
+        case SelectionType::Body:
+            displayPlanetInfo(*m_numberFormatter,
+                              textOut,
+                              m_hudDetail,
+                              *(sel.body()),
+                              t,
+                              v,
+                              m_hudSettings,
+                              loc);
+            break;
+
+        case SelectionType::Location:
+            displayLocationInfo(*m_numberFormatter,
+                                textOut,
+                                *(sel.location()),
+                                v.norm(),
+                                m_hudSettings.measurementSystem,
+                                loc);
+            break;
+
+        default:
+            break;
         }
+
+        if (showRADec)
+            displayRADec(textOut, vEarth, loc);
     }
 
+    m_overlay->savePos();
+    m_overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
+    m_overlay->moveBy(metrics.getSafeAreaStart(), metrics.getSafeAreaTop(m_hudFonts.titleFontHeight()));
+
+    m_overlay->beginText();
+
+    m_overlay->setFont(m_hudFonts.titleFont());
+    m_overlay->print(m_selectionNames);
+    m_overlay->setFont(m_hudFonts.font());
+    m_overlay->print("\n");
+
+    m_overlay->print(m_selectionText.text());
+
     m_overlay->endText();
     m_overlay->restorePos();
 }
@@ -1235,6 +1312,49 @@ Hud::renderTextMessages(const WindowMetrics& metrics, double currentTime)
     m_overlay->setFont(m_hudFonts.font());
 }
 
+void
+Hud::renderProfile(const WindowMetrics& metrics, const render::RenderProfiler& profiler)
+{
+    // Pass times on the left side, above the speed and FPS counter
+    constexpr auto passCount = static_cast<unsigned int>(render::RenderPass::Count);
+
+    m_overlay->savePos();
+    m_overlay->moveBy(metrics.getSafeAreaStart(),
+                      metrics.getSafeAreaBottom(m_hudFonts.fontHeight() * static_cast<int>(passCount + 5)));
+    m_overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
+    m_overlay->beginText();
+
+    if (profiler.hasGPUTimes())
+        m_overlay->print(_("Pass times (CPU / GPU ms):\n"));
+    else
+        m_overlay->print(_("Pass times (CPU ms):\n"));
+
+    for (unsigned int i = 0; i < passCount; ++i)
+    {
+        auto pass = static_cast<render::RenderPass>(i);
+        if (profiler.hasGPUTimes())
+        {
+            m_overlay->print(loc, "{}: {:.2f} / {:.2f}\n",
+                             render::RenderProfiler::getPassName(pass),
+                             profiler.getCPUTime(pass),
+                             profiler.getGPUTime(pass));
+        }
+        else
+        {
+            m_overlay->print(loc, "{}: {:.2f}\n",
+                             render::RenderProfiler::getPassName(pass),
+                             profiler.getCPUTime(pass));
+        }
+    }
+
+    m_overlay->print(loc, _("State changes: {:.0f} ({:.0f} skipped)\n"),
+                     profiler.getStateChanges(),
+                     profiler.getSkippedStateChanges());
+
+    m_overlay->endText();
+    m_overlay->restorePos();
+}
+
 void
 Hud::renderMovieCapture(const WindowMetrics& metrics, const MovieCapture& movieCapture)
 {
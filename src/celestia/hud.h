@@ -49,6 +49,11 @@ namespace engine
 class DateFormatter;
 }
 
+namespace render
+{
+class RenderProfiler;
+}
+
 enum class MeasurementSystem
 {
     Metric      = 0,
@@ -113,6 +118,35 @@ struct HudSettings
     bool showMessage{ true };
 };
 
+// Formatted text of a HUD block, kept between frames. The text is only
+// rebuilt when the inputs it is formatted from, given as the key, change.
+template<typename K>
+class HudTextBlock
+{
+public:
+    // Returns true after clearing the text if it has to be rebuilt for key
+    bool update(const K& key)
+    {
+        if (m_valid && key == m_key)
+            return false;
+
+        m_key = key;
+        m_valid = true;
+        m_text.clear();
+        return true;
+    }
+
+    void invalidate() noexcept { m_valid = false; }
+
+    std::string& text() noexcept { return m_text; }
+    const std::string& text() const noexcept { return m_text; }
+
+private:
+    K m_key{};
+    std::string m_text;
+    bool m_valid{ false };
+};
+
 class Hud
 {
 public:
@@ -149,6 +183,7 @@ public:
                        const Simulation*,
                        const ViewManager&,
                        const MovieCapture*,
+                       const render::RenderProfiler*,
                        const TimeInfo&,
                        bool isScriptRunning,
                        bool editMode);
@@ -165,6 +200,7 @@ private:
     void renderSelectionInfo(const WindowMetrics&, const Simulation*, Selection, const Eigen::Vector3d&);
     void renderTextMessages(const WindowMetrics&, double);
     void renderMovieCapture(const WindowMetrics&, const MovieCapture&);
+    void renderProfile(const WindowMetrics&, const render::RenderProfiler&);
 
     HudSettings m_hudSettings;
     HudFonts m_hudFonts;
@@ -192,6 +228,23 @@ private:
 
     Selection m_lastSelection;
     std::string m_selectionNames;
+
+    // UTC time in whole seconds, local time and date format
+    HudTextBlock<std::tuple<double, bool, astro::Date::Format>> m_dateText;
+    // Time scale
+    HudTextBlock<double> m_timeRateText;
+    // FPS in tenths or -1 if not shown, observer speed and units
+    HudTextBlock<std::tuple<long, float, MeasurementSystem>> m_speedText;
+    // Travel time left in seconds or -1, tracked object, coordinate system,
+    // reference and target objects
+    HudTextBlock<std::tuple<long, Selection, int, Selection, Selection>> m_frameText;
+    // Field of view and zoom
+    HudTextBlock<std::tuple<float, float>> m_fovText;
+    // Selection, detail level, units, selection position relative to the
+    // observer, time for bodies, and selection position relative to the
+    // Earth if RA/Dec are shown
+    HudTextBlock<std::tuple<Selection, int, MeasurementSystem, TemperatureScale,
+                            Eigen::Vector3d, double, bool, Eigen::Vector3d>> m_selectionText;
 };
 
 ENUM_CLASS_BITWISE_OPS(Hud::TextEnterMode);
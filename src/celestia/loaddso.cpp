@@ -10,6 +10,8 @@
 #include "loaddso.h"
 
 #include <fstream>
+#include <utility>
+#include <vector>
 
 #include <celengine/dsodb.h>
 #include <celestia/catalogloader.h>
@@ -50,4 +52,31 @@ loadDSO(const CelestiaConfig &config, ProgressNotifier *progressNotifier)
     return dsoDB;
 }
 
+std::function<std::unique_ptr<DSODatabase>()>
+stageDSO(const CelestiaConfig &config, util::ThreadPool &pool)
+{
+    auto dsoDB = std::make_shared<std::unique_ptr<DSODatabase>>(std::make_unique<DSODatabase>());
+    (*dsoDB)->setNameDatabase(std::make_unique<NameDatabase>());
+
+    // TRANSLATORS: this is a part of phrases "Loading {} catalog", "Skipping {} catalog"
+    const char *typeDesc = C_("catalog", "deep sky");
+
+    auto loader = std::make_shared<DeepSkyLoader>(dsoDB->get(),
+                                                  typeDesc,
+                                                  ContentType::CelestiaDeepSkyCatalog,
+                                                  nullptr,
+                                                  config.paths.skipExtras);
+    auto staged = std::make_shared<std::vector<DeepSkyLoader::StagedFile>>(
+        loader->stageFiles(config.paths.dsoCatalogFiles, config.paths.extrasDirs, pool));
+
+    return [dsoDB, loader, staged]()
+    {
+        for (auto &file : *staged)
+            loader->commit(file);
+
+        (*dsoDB)->finish();
+        return std::move(*dsoDB);
+    };
+}
+
 } // namespace celestia
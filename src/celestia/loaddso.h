@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 
 class DSODatabase;
@@ -18,7 +19,20 @@ struct CelestiaConfig;
 namespace celestia
 {
 
+namespace util
+{
+class ThreadPool;
+}
+
 std::unique_ptr<DSODatabase> loadDSO(const CelestiaConfig &config,
                                      ProgressNotifier     *progressNotifier);
 
+// Reads the same catalogs as loadDSO on pool without adding their objects
+// to a database, so that it can run on another thread. The returned
+// function adds them to a new database, in the same order as loadDSO, and
+// finishes it. It has to be called on the main thread, since adding the
+// objects assigns their categories.
+std::function<std::unique_ptr<DSODatabase>()> stageDSO(const CelestiaConfig &config,
+                                                       util::ThreadPool     &pool);
+
 } // namespace celestia
@@ -12,25 +12,81 @@
 #include <fstream>
 #include <memory>
 
+#include <celengine/solarsys.h>
+#include <celengine/ssccache.h>
 #include <celengine/universe.h>
 #include <celestia/configfile.h>
 #include <celestia/progressnotifier.h>
 #include <celestia/catalogloader.h>
+#include <celutil/fsutils.h>
 #include <celutil/gettext.h>
 
 namespace celestia
 {
 
-using SolarSystemLoader = CatalogLoader<Universe>;
-
 template<> bool
 CatalogLoader<Universe>::load(std::istream &in, const fs::path &dir)
 {
     return LoadSolarSystemObjects(in, *m_objDB, dir);
 }
 
+template<> std::unique_ptr<engine::StagedCatalog>
+CatalogLoader<Universe>::stageFile(const fs::path &filePath, const fs::path &dir)
+{
+    return StageSolarSystemObjects(filePath, *m_objDB, dir, nullptr);
+}
+
+namespace
+{
+
+class SolarSystemLoader : public CatalogLoader<Universe>
+{
+public:
+    SolarSystemLoader(Universe                  *universe,
+                      const std::string         &typeDesc,
+                      ProgressNotifier          *notifier,
+                      util::array_view<fs::path> skipPaths,
+                      const engine::SolarSystemCache *cache) :
+        CatalogLoader<Universe>(universe, typeDesc, ContentType::CelestiaCatalog, notifier, skipPaths),
+        m_cache(cache)
+    {
+    }
+
+    bool loadFile(const fs::path &filePath, const fs::path &dir) override
+    {
+        return LoadSolarSystemObjects(filePath, *m_objDB, dir, m_cache);
+    }
+
+    std::unique_ptr<engine::StagedCatalog> stageFile(const fs::path &filePath, const fs::path &dir) override
+    {
+        return StageSolarSystemObjects(filePath, *m_objDB, dir, m_cache);
+    }
+
+private:
+    const engine::SolarSystemCache *m_cache;
+};
+
+fs::path
+getCatalogCachePath(const CelestiaConfig &config)
+{
+    fs::path cachePath = config.paths.catalogCacheDirectory.empty()
+        ? fs::path("catalogcache")
+        : config.paths.catalogCacheDirectory;
+
+#ifndef PORTABLE_BUILD
+    if (cachePath.is_relative())
+        cachePath = util::WriteableDataPath() / cachePath;
+#endif
+    return cachePath;
+}
+
+} // end unnamed namespace
+
 void
-loadSSO(const CelestiaConfig &config, ProgressNotifier *progressNotifier, Universe *universe)
+loadSSO(const CelestiaConfig &config,
+        ProgressNotifier     *progressNotifier,
+        Universe             *universe,
+        bool                  withExtras)
 {
     auto solarSystem = std::make_unique<SolarSystemCatalog>();
     universe->setSolarSystemCatalog(std::move(solarSystem));
@@ -38,11 +94,12 @@ loadSSO(const CelestiaConfig &config, ProgressNotifier *progressNotifier, Univer
     // TRANSLATORS: this is a part of phrases "Loading {} catalog", "Skipping {} catalog"
     const char *typeDesc = C_("catalog", "solar system");
 
+    engine::SolarSystemCache cache(getCatalogCachePath(config));
     SolarSystemLoader loader(universe,
                              typeDesc,
-                             ContentType::CelestiaCatalog,
                              progressNotifier,
-                             config.paths.skipExtras);
+                             config.paths.skipExtras,
+                             &cache);
 
     // First read the solar system files listed individually in the config file.
     fs::path empty;
@@ -50,7 +107,32 @@ loadSSO(const CelestiaConfig &config, ProgressNotifier *progressNotifier, Univer
         loader.process(file, empty);
 
     // Next, read all the solar system files in the extras directories
-    loader.loadExtras(config.paths.extrasDirs);
+    if (withExtras)
+        loader.loadExtras(config.paths.extrasDirs);
+}
+
+std::vector<std::function<void()>>
+stageExtraSSO(const CelestiaConfig &config, Universe *universe, util::ThreadPool &pool)
+{
+    // TRANSLATORS: this is a part of phrases "Loading {} catalog", "Skipping {} catalog"
+    const char *typeDesc = C_("catalog", "solar system");
+
+    // The cache is only used while reading the files
+    engine::SolarSystemCache cache(getCatalogCachePath(config));
+    auto loader = std::make_shared<SolarSystemLoader>(universe,
+                                                      typeDesc,
+                                                      nullptr,
+                                                      config.paths.skipExtras,
+                                                      &cache);
+
+    std::vector<std::function<void()>> commits;
+    for (auto &file : loader->stageFiles({}, config.paths.extrasDirs, pool))
+    {
+        auto staged = std::make_shared<SolarSystemLoader::StagedFile>(std::move(file));
+        commits.emplace_back([loader, staged]() { loader->commit(*staged); });
+    }
+
+    return commits;
 }
 
 } // namespace celestia
@@ -9,6 +9,9 @@
 
 #pragma once
 
+#include <functional>
+#include <vector>
+
 #include <celengine/solarsys.h>
 
 class ProgressNotifier;
@@ -18,6 +21,25 @@ struct CelestiaConfig;
 namespace celestia
 {
 
-void loadSSO(const CelestiaConfig &config, ProgressNotifier *progressNotifier, Universe *universe);
+namespace util
+{
+class ThreadPool;
+}
+
+// Creates the solar system catalog of universe and loads the files listed
+// in the configuration, then those of the extras directories unless
+// withExtras is false.
+void loadSSO(const CelestiaConfig &config,
+             ProgressNotifier     *progressNotifier,
+             Universe             *universe,
+             bool                  withExtras = true);
+
+// Reads the solar system catalogs of the extras directories on pool without
+// adding them to universe, so that it can run on another thread. Calling
+// the returned functions in order on the main thread adds the objects of
+// one file each, as loadSSO would have.
+std::vector<std::function<void()>> stageExtraSSO(const CelestiaConfig &config,
+                                                 Universe             *universe,
+                                                 util::ThreadPool     &pool);
 
 } // namespace celestia
@@ -10,15 +10,23 @@
 #include "loadstars.h"
 
 #include <fstream>
+#include <string_view>
+#include <utility>
 
 #include <celcompat/filesystem.h>
+#include <celengine/asterism.h>
+#include <celengine/boundaries.h>
 #include <celengine/stardb.h>
 #include <celengine/stardbbuilder.h>
+#include <celengine/starpack.h>
 #include <celestia/catalogloader.h>
 #include <celestia/configfile.h>
 #include <celestia/progressnotifier.h>
+#include <celestia/startupprofile.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/mappedfile.h>
+#include <celutil/trace.h>
 
 namespace celestia
 {
@@ -29,25 +37,145 @@ namespace
 {
 
 void
-loadCrossIndex(StarNameDatabase& starNamesDB, StarCatalog catalog, const fs::path &filename)
+loadCrossIndex(StarNameDatabase& starNamesDB,
+               StarCatalog catalog,
+               const fs::path &filename,
+               const engine::StarDataPack *pack)
 {
-    if (filename.empty())
-        return;
+    if (StarNameDatabase::CrossIndex xindex; readCrossIndex(catalog, filename, xindex, pack))
+        starNamesDB.setCrossIndex(catalog, std::move(xindex));
+}
 
-    if (std::ifstream xrefFile(filename, std::ios::binary); xrefFile.good())
+std::unique_ptr<StarNameDatabase>
+readNames(const fs::path &filename, const engine::StarDataPack *pack)
+{
+    if (pack != nullptr)
     {
-        if (!starNamesDB.loadCrossIndex(catalog, xrefFile))
-            util::GetLogger()->error(_("Error reading cross index {}\n"), filename);
-        else
-            util::GetLogger()->info(_("Loaded cross index {}\n"), filename);
+        if (auto starNameDB = pack->readNames(filename); starNameDB != nullptr)
+            return starNameDB;
+    }
+
+    std::unique_ptr<StarNameDatabase> starNameDB = nullptr;
+    if (std::ifstream starNamesFile(filename); starNamesFile.good())
+    {
+        starNameDB = StarNameDatabase::readNames(starNamesFile);
+        if (starNameDB == nullptr)
+            util::GetLogger()->error(_("Error reading star names file {}\n"), filename);
     }
+    else
+    {
+        util::GetLogger()->error(_("Error opening {}\n"), filename);
+    }
+
+    return starNameDB;
+}
+
+void
+beginPhase(StartupProfile *profile, std::string_view name)
+{
+    if (profile != nullptr)
+        profile->beginPhase(name);
 }
 
 } // namespace
 
+std::unique_ptr<engine::StarDataPack>
+openStarDataPack(const CelestiaConfig &config)
+{
+    const fs::path &path = config.paths.starDataPackFile;
+    if (path.empty())
+        return nullptr;
+
+    auto pack = engine::StarDataPack::open(path);
+    if (pack == nullptr)
+        util::GetLogger()->error(_("Error opening star data pack {}\n"), path);
+    return pack;
+}
+
+bool
+readCrossIndex(StarCatalog catalog,
+               const fs::path &filename,
+               StarNameDatabase::CrossIndex &xindex,
+               const engine::StarDataPack *pack)
+{
+    if (filename.empty())
+        return false;
+
+    if (pack != nullptr && pack->readCrossIndex(catalog, filename, xindex))
+    {
+        util::GetLogger()->info(_("Loaded cross index {}\n"), filename);
+        return true;
+    }
+
+    std::ifstream xrefFile(filename, std::ios::binary);
+    if (!xrefFile.good())
+        return false;
+
+    if (!StarNameDatabase::readCrossIndex(xrefFile, xindex))
+    {
+        util::GetLogger()->error(_("Error reading cross index {}\n"), filename);
+        return false;
+    }
+
+    util::GetLogger()->info(_("Loaded cross index {}\n"), filename);
+    return true;
+}
+
+bool
+readAsterisms(const fs::path &filename,
+              std::vector<AsterismDefinition> &definitions,
+              const engine::StarDataPack *pack)
+{
+    if (filename.empty())
+        return false;
+
+    if (pack != nullptr && pack->readAsterisms(filename, definitions))
+        return true;
+
+    std::ifstream asterismsFile(filename, std::ios::in);
+    if (!asterismsFile.good())
+    {
+        util::GetLogger()->error(_("Error opening asterisms file {}.\n"), filename);
+        return false;
+    }
+
+    // As before, the asterisms before a syntax error are kept
+    ParseAsterismList(asterismsFile, definitions);
+    return true;
+}
+
+std::unique_ptr<ConstellationBoundaries>
+readBoundaries(const fs::path &filename, const engine::StarDataPack *pack)
+{
+    if (filename.empty())
+        return nullptr;
+
+    if (pack != nullptr)
+    {
+        if (auto boundaries = pack->readBoundaries(filename); boundaries != nullptr)
+            return boundaries;
+    }
+
+    std::ifstream boundariesFile(filename, std::ios::in);
+    if (!boundariesFile.good())
+    {
+        util::GetLogger()->error(_("Error opening constellation boundaries file {}.\n"), filename);
+        return nullptr;
+    }
+
+    return ReadBoundaries(boundariesFile);
+}
+
 std::unique_ptr<StarDatabase>
-loadStars(const CelestiaConfig &config, ProgressNotifier *progressNotifier)
+loadStars(const CelestiaConfig       &config,
+          ProgressNotifier           *progressNotifier,
+          StartupProfile             *profile,
+          bool                        withCrossIndices,
+          const engine::StarDataPack *pack)
 {
+    util::TraceScope trace("loadStars");
+    beginPhase(profile, "star database");
+
     // First load the binary star database file. The majority of stars
     // will be defined here.
     StarDatabaseBuilder starDBBuilder;
@@ -56,7 +184,17 @@ loadStars(const CelestiaConfig &config, ProgressNotifier *progressNotifier)
         if (progressNotifier)
             progressNotifier->update(path.string());
 
-        if (std::ifstream starFile(path, std::ios::binary); starFile.good())
+        // Presorted databases are read straight from a file mapping
+        if (auto mappedFile = util::MappedFile::open(path);
+            mappedFile != nullptr && StarDatabaseBuilder::isSortedBinary(mappedFile->data(), mappedFile->size()))
+        {
+            if (!starDBBuilder.loadSortedBinary(mappedFile->data(), mappedFile->size()))
+            {
+                util::GetLogger()->error(_("Error reading stars file\n"));
+                return nullptr;
+            }
+        }
+        else if (std::ifstream starFile(path, std::ios::binary); starFile.good())
         {
             if (!starDBBuilder.loadBinary(starFile))
             {
@@ -72,24 +210,17 @@ loadStars(const CelestiaConfig &config, ProgressNotifier *progressNotifier)
     }
 
     // Load star names
-    std::unique_ptr<StarNameDatabase> starNameDB = nullptr;
-    if (std::ifstream starNamesFile(config.paths.starNamesFile); starNamesFile.good())
-    {
-        starNameDB = StarNameDatabase::readNames(starNamesFile);
-        if (starNameDB == nullptr)
-            util::GetLogger()->error(_("Error reading star names file {}\n"),
-                                     config.paths.starNamesFile);
-    }
-    else
-    {
-        util::GetLogger()->error(_("Error opening {}\n"), config.paths.starNamesFile);
-    }
-
+    beginPhase(profile, "star names");
+    std::unique_ptr<StarNameDatabase> starNameDB = readNames(config.paths.starNamesFile, pack);
     if (starNameDB == nullptr)
         starNameDB = std::make_unique<StarNameDatabase>();
 
-    loadCrossIndex(*starNameDB, StarCatalog::HenryDraper, config.paths.HDCrossIndexFile);
-    loadCrossIndex(*starNameDB, StarCatalog::SAO, config.paths.SAOCrossIndexFile);
+    if (withCrossIndices)
+    {
+        beginPhase(profile, "cross indices");
+        loadCrossIndex(*starNameDB, StarCatalog::HenryDraper, config.paths.HDCrossIndexFile, pack);
+        loadCrossIndex(*starNameDB, StarCatalog::SAO, config.paths.SAOCrossIndexFile, pack);
+    }
 
     starDBBuilder.setNameDatabase(std::move(starNameDB));
 
@@ -103,6 +234,7 @@ loadStars(const CelestiaConfig &config, ProgressNotifier *progressNotifier)
                       config.paths.skipExtras);
 
     // Next, read any ASCII star catalog files specified in the StarCatalogs list.
+    beginPhase(profile, "star catalogs");
     fs::path empty;
     for (const auto &file : config.paths.starCatalogFiles)
         loader.process(file, empty);
@@ -110,6 +242,7 @@ loadStars(const CelestiaConfig &config, ProgressNotifier *progressNotifier)
     // Now, read supplemental star files from the extras directories
     loader.loadExtras(config.paths.extrasDirs);
 
+    beginPhase(profile, "star octree");
     return starDBBuilder.finish();
 }
 
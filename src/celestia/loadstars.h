@@ -10,15 +10,51 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
+#include <celcompat/filesystem.h>
+#include <celengine/starname.h>
+
+class ConstellationBoundaries;
 class StarDatabase;
 class ProgressNotifier;
+struct AsterismDefinition;
 struct CelestiaConfig;
 
 namespace celestia
 {
 
-std::unique_ptr<StarDatabase> loadStars(const CelestiaConfig &config,
-                                        ProgressNotifier     *progressNotifier);
+namespace engine
+{
+class StarDataPack;
+}
+
+class StartupProfile;
+
+// Opens the star data pack of the configuration, if there is one
+std::unique_ptr<engine::StarDataPack> openStarDataPack(const CelestiaConfig &config);
+
+// The following read a file, or its copy in pack if pack is not null and
+// the copy is up to date, and log the outcome. They fail if the file is
+// missing or can't be read.
+bool readCrossIndex(StarCatalog                  catalog,
+                    const fs::path              &filename,
+                    StarNameDatabase::CrossIndex &xindex,
+                    const engine::StarDataPack  *pack = nullptr);
+bool readAsterisms(const fs::path                  &filename,
+                   std::vector<AsterismDefinition> &definitions,
+                   const engine::StarDataPack      *pack = nullptr);
+std::unique_ptr<ConstellationBoundaries> readBoundaries(const fs::path             &filename,
+                                                        const engine::StarDataPack *pack = nullptr);
+
+// If profile is not null, the star database, names, cross indices and text
+// catalogs are each recorded as a phase of it. The cross indices are left
+// out if withCrossIndices is false. Names and cross indices are taken from
+// pack where it is up to date.
+std::unique_ptr<StarDatabase> loadStars(const CelestiaConfig       &config,
+                                        ProgressNotifier           *progressNotifier,
+                                        StartupProfile             *profile = nullptr,
+                                        bool                        withCrossIndices = true,
+                                        const engine::StarDataPack *pack = nullptr);
 
 } // namespace celestia
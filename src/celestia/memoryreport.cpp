@@ -0,0 +1,58 @@
+// memoryreport.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "memoryreport.h"
+
+#include <iterator>
+
+#include <fmt/format.h>
+
+#include <celutil/logger.h>
+
+namespace celestia
+{
+
+namespace
+{
+
+constexpr double MiB = 1024.0 * 1024.0;
+
+} // end unnamed namespace
+
+void
+MemoryReport::add(std::string_view name, std::size_t bytes)
+{
+    m_entries.push_back({ std::string(name), bytes });
+}
+
+std::size_t
+MemoryReport::getTotal() const
+{
+    std::size_t total = 0;
+    for (const auto& entry : m_entries)
+        total += entry.bytes;
+    return total;
+}
+
+void
+MemoryReport::log() const
+{
+    std::string text = fmt::format("{:<20} {:>10}\n", "Memory use", "MiB");
+    for (const auto& entry : m_entries)
+    {
+        fmt::format_to(std::back_inserter(text), "{:<20} {:>10.1f}\n",
+                       entry.name, static_cast<double>(entry.bytes) / MiB);
+    }
+    fmt::format_to(std::back_inserter(text), "{:<20} {:>10.1f}\n",
+                   "total", static_cast<double>(getTotal()) / MiB);
+
+    util::GetLogger()->info("{}", text);
+}
+
+} // end namespace celestia
@@ -0,0 +1,47 @@
+// memoryreport.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Estimated memory use of each subsystem.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace celestia
+{
+
+// Bytes used by each subsystem, as estimated by the subsystems themselves.
+// The estimates count the containers and objects held in memory, not the
+// allocator overhead or memory mapped files, so the total is less than the
+// resident size of the process.
+class MemoryReport
+{
+public:
+    struct Entry
+    {
+        std::string name;
+        std::size_t bytes;
+    };
+
+    void add(std::string_view name, std::size_t bytes);
+
+    const std::vector<Entry>& getEntries() const { return m_entries; }
+    std::size_t getTotal() const;
+
+    // Writes a table of the entries to the log
+    void log() const;
+
+private:
+    std::vector<Entry> m_entries;
+};
+
+} // end namespace celestia
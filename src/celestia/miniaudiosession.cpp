@@ -9,6 +9,78 @@ using namespace celestia::util;
 namespace celestia
 {
 
+namespace
+{
+
+// The audio device and engine. Starting them can take a noticeable time,
+// so they are shared by all sessions and kept while any of them exists.
+class MiniAudioEngine
+{
+ public:
+    static std::shared_ptr<MiniAudioEngine> get();
+
+    MiniAudioEngine() = default;
+    ~MiniAudioEngine();
+
+    MiniAudioEngine(const MiniAudioEngine&) = delete;
+    MiniAudioEngine &operator=(const MiniAudioEngine&) = delete;
+
+    ma_engine *engine() { return &m_engine; }
+
+ private:
+    bool start();
+
+    ma_context m_context;
+    ma_engine m_engine;
+};
+
+std::shared_ptr<MiniAudioEngine> MiniAudioEngine::get()
+{
+    // Sessions are only used from the main thread
+    static std::weak_ptr<MiniAudioEngine> shared;
+
+    if (auto engine = shared.lock(); engine != nullptr)
+        return engine;
+
+    auto engine = std::make_shared<MiniAudioEngine>();
+    if (!engine->start())
+        return nullptr;
+
+    shared = engine;
+    return engine;
+}
+
+MiniAudioEngine::~MiniAudioEngine()
+{
+    ma_engine_uninit(&m_engine);
+    ma_context_uninit(&m_context);
+}
+
+bool MiniAudioEngine::start()
+{
+    auto config = ma_context_config_init();
+    // on iOS, explicitly set the correct category for correct routing
+    config.coreaudio.sessionCategory = ma_ios_session_category_playback;
+    ma_result result = ma_context_init(nullptr, 0, &config, &m_context);
+    if (result != MA_SUCCESS)
+    {
+        GetLogger()->error("Failed to init miniaudio context");
+        return false;
+    }
+    auto engineConfig = ma_engine_config_init();
+    engineConfig.pContext = &m_context;
+    result = ma_engine_init(&engineConfig, &m_engine);
+    if (result != MA_SUCCESS)
+    {
+        ma_context_uninit(&m_context);
+        GetLogger()->error("Failed to start miniaudio engine");
+        return false;
+    }
+    return true;
+}
+
+} // end unnamed namespace
+
 class MiniAudioSessionPrivate
 {
  public:
@@ -28,8 +100,7 @@ class MiniAudioSessionPrivate
     MiniAudioSessionPrivate &operator=(const MiniAudioSessionPrivate&) = delete;
     MiniAudioSessionPrivate &operator=(MiniAudioSessionPrivate&&) = delete;
 
-    ma_context context;
-    ma_engine engine;
+    std::shared_ptr<MiniAudioEngine> engine;
     ma_sound sound;
     State state         { State::NotInitialized };
 };
@@ -44,8 +115,6 @@ MiniAudioSessionPrivate::~MiniAudioSessionPrivate()
     case State::SoundInitialzied:
         ma_sound_uninit(&sound);
     case State::EngineStarted:
-        ma_engine_uninit(&engine);
-        ma_context_uninit(&context);
     case State::NotInitialized:
         break;
     }
@@ -71,8 +140,11 @@ bool MiniAudioSession::play(double startTime)
         p->state = MiniAudioSessionPrivate::State::EngineStarted;
 
     case MiniAudioSessionPrivate::State::EngineStarted:
-        // load sound file from disk
-        result = ma_sound_init_from_file(&p->engine, path().string().c_str(), MA_SOUND_FLAG_ASYNC, nullptr, nullptr, &p->sound);
+        // open the sound file and decode it in chunks as it plays, both on
+        // the job thread of the resource manager
+        result = ma_sound_init_from_file(p->engine->engine(), path().string().c_str(),
+                                         MA_SOUND_FLAG_STREAM | MA_SOUND_FLAG_ASYNC,
+                                         nullptr, nullptr, &p->sound);
         if (result != MA_SUCCESS)
         {
             GetLogger()->error("Failed to load sound file {}", path());
@@ -152,7 +224,7 @@ bool MiniAudioSession::seek(double seconds)
 {
     if (p->state >= MiniAudioSessionPrivate::State::SoundInitialzied)
     {
-        ma_result result = ma_sound_seek_to_pcm_frame(&p->sound, static_cast<ma_uint64>(seconds * ma_engine_get_sample_rate(&p->engine)));
+        ma_result result = ma_sound_seek_to_pcm_frame(&p->sound, static_cast<ma_uint64>(seconds * ma_engine_get_sample_rate(p->engine->engine())));
         if (result != MA_SUCCESS)
         {
             GetLogger()->error("Failed to seek to {}", seconds);
@@ -185,24 +257,10 @@ bool MiniAudioSession::startEngine()
     if (p->state >= MiniAudioSessionPrivate::State::EngineStarted)
         return true;
 
-    auto config = ma_context_config_init();
-    // on iOS, explicitly set the correct category for correct routing
-    config.coreaudio.sessionCategory = ma_ios_session_category_playback;
-    ma_result result = ma_context_init(nullptr, 0, &config, &p->context);
-    if (result != MA_SUCCESS)
-    {
-        GetLogger()->error("Failed to init miniaudio context");
+    p->engine = MiniAudioEngine::get();
+    if (p->engine == nullptr)
         return false;
-    }
-    auto engineConfig = ma_engine_config_init();
-    engineConfig.pContext = &p->context;
-    result = ma_engine_init(&engineConfig, &p->engine);
-    if (result != MA_SUCCESS)
-    {
-        ma_context_uninit(&p->context);
-        GetLogger()->error("Failed to start miniaudio engine");
-        return false;
-    }
+
     p->state = MiniAudioSessionPrivate::State::EngineStarted;
     return true;
 }
@@ -761,6 +761,7 @@ CelestiaAppWindow::slotCaptureVideo()
                 movieCapture->setEncoderOptions(m_appCore->getConfig()->x264EncoderOptions);
             else
                 movieCapture->setEncoderOptions(m_appCore->getConfig()->ffvhEncoderOptions);
+            movieCapture->setHardwareEncoding(m_appCore->getConfig()->hardwareVideoEncoding);
 
             bool ok = movieCapture->start(saveAsName.toStdString(),
                                           videoSize.width(), videoSize.height(),
@@ -351,7 +351,10 @@ CelestialBrowser::StarTableModel::populate(const UniversalCoord& _observerPos,
         starBrowser.setSpectralTypeFilter([regexp=filter.regexp](const char* sptype)
                                           {
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-                                              return regexp.exactMatch(sptype);
+                                              // QRegExp keeps the match state in the object, so
+                                              // each of the threads of the star browser needs its
+                                              // own copy
+                                              return QRegExp(regexp).exactMatch(sptype);
 #else
                                               return regexp.match(sptype).hasMatch();
 #endif
@@ -27,13 +27,16 @@
 #include <QAbstractTableModel>
 #include <QAction>
 #include <QApplication>
+#include <QCheckBox>
 #include <QComboBox>
 #include <QDate>
 #include <QDateEdit>
 #include <QDateTime>
+#include <QDoubleSpinBox>
 #include <QGroupBox>
 #include <QHBoxLayout>
 #include <QLatin1Char>
+#include <QLineEdit>
 #include <QMenu>
 #include <QMessageBox>
 #include <QModelIndex>
@@ -53,6 +56,7 @@
 #include <celengine/selection.h>
 #include <celengine/simulation.h>
 #include <celengine/univcoord.h>
+#include <celmath/mathlib.h>
 #include <celestia/celestiacore.h>
 #include <celmath/geomutil.h>
 #include <celmath/intersect.h>
@@ -107,6 +111,13 @@ findMaxEclipsePoint(const Eigen::Vector3d& toCasterDir,
     return maxEclipsePoint;
 }
 
+QString
+durationToQString(double startTime, double endTime)
+{
+    int minutes = (int) ((endTime - startTime) * 24 * 60);
+    return QString("%1:%2").arg(minutes / 60).arg(minutes % 60, 2, 10, QLatin1Char('0'));
+}
+
 } // end unnamed namespace
 
 class EventFinder::EventTableModel : public QAbstractTableModel
@@ -124,8 +135,12 @@ public:
     void sort(int column, Qt::SortOrder order) override;
 
     void setEclipses(const std::vector<Eclipse>& _eclipses);
+    void setSeparations(const std::vector<SeparationEvent>& _separations,
+                        const QString& _firstName,
+                        const QString& _secondName);
 
     const Eclipse* eclipseAtIndex(const QModelIndex& index) const;
+    const SeparationEvent* separationAtIndex(const QModelIndex& index) const;
 
     enum
     {
@@ -136,7 +151,11 @@ public:
     };
 
 private:
+    // Only one of them is filled, depending on the last search
     std::vector<Eclipse> eclipses;
+    std::vector<SeparationEvent> separations;
+    QString firstName;
+    QString secondName;
 };
 
 Qt::ItemFlags
@@ -148,7 +167,7 @@ EventFinder::EventTableModel::flags(const QModelIndex& /*unused*/) const
 QVariant
 EventFinder::EventTableModel::data(const QModelIndex& index, int role) const
 {
-    if (index.row() < 0 || index.row() >= (int) eclipses.size())
+    if (index.row() < 0 || index.row() >= rowCount(QModelIndex()))
     {
         // Out of range
         return QVariant();
@@ -159,6 +178,24 @@ EventFinder::EventTableModel::data(const QModelIndex& index, int role) const
         return QVariant();
     }
 
+    if (!separations.empty())
+    {
+        const SeparationEvent& separation = separations[index.row()];
+        switch (index.column())
+        {
+        case ReceiverColumn:
+            return firstName;
+        case OcculterColumn:
+            return secondName;
+        case StartTimeColumn:
+            return TDBToQString(separation.startTime);
+        case DurationColumn:
+            return durationToQString(separation.startTime, separation.endTime);
+        default:
+            return QVariant();
+        }
+    }
+
     const Eclipse& eclipse = eclipses[index.row()];
 
     switch (index.column())
@@ -170,10 +207,7 @@ EventFinder::EventTableModel::data(const QModelIndex& index, int role) const
     case StartTimeColumn:
         return TDBToQString(eclipse.startTime);
     case DurationColumn:
-    {
-        int minutes = (int) ((eclipse.endTime - eclipse.startTime) * 24 * 60);
-        return QString("%1:%2").arg(minutes / 60).arg(minutes % 60, 2, 10, QLatin1Char('0'));
-    }
+        return durationToQString(eclipse.startTime, eclipse.endTime);
     default:
         return QVariant();
     }
@@ -188,9 +222,9 @@ EventFinder::EventTableModel::headerData(int section, Qt::Orientation /*unused*/
     switch (section)
     {
     case 0:
-        return QString(_("Eclipsed body"));
+        return separations.empty() ? QString(_("Eclipsed body")) : QString(_("First object"));
     case 1:
-        return QString(_("Occulter"));
+        return separations.empty() ? QString(_("Occulter")) : QString(_("Second object"));
     case 2:
         return QString(_("Start time"));
     case 3:
@@ -203,7 +237,7 @@ EventFinder::EventTableModel::headerData(int section, Qt::Orientation /*unused*/
 int
 EventFinder::EventTableModel::rowCount(const QModelIndex& /*unused*/) const
 {
-    return (int) eclipses.size();
+    return (int) (separations.empty() ? eclipses.size() : separations.size());
 }
 
 int
@@ -215,6 +249,23 @@ EventFinder::EventTableModel::columnCount(const QModelIndex& /*unused*/) const
 void
 EventFinder::EventTableModel::sort(int column, Qt::SortOrder order)
 {
+    if (!separations.empty())
+    {
+        // The objects are the same in all rows
+        if (column == DurationColumn)
+            std::sort(separations.begin(), separations.end(),
+                      [](const SeparationEvent& e0, const SeparationEvent& e1) { return e0.endTime - e0.startTime < e1.endTime - e1.startTime; });
+        else
+            std::sort(separations.begin(), separations.end(),
+                      [](const SeparationEvent& e0, const SeparationEvent& e1) { return e0.startTime < e1.startTime; });
+
+        if (order == Qt::DescendingOrder)
+            std::reverse(separations.begin(), separations.end());
+
+        dataChanged(index(0, 0), index(separations.size() - 1, columnCount(QModelIndex())));
+        return;
+    }
+
     switch (column)
     {
     case ReceiverColumn:
@@ -246,7 +297,23 @@ EventFinder::EventTableModel::setEclipses(const std::vector<Eclipse>& _eclipses)
 {
     beginResetModel();
     eclipses = _eclipses;
+    separations.clear();
+    endResetModel();
+}
+
+void
+EventFinder::EventTableModel::setSeparations(const std::vector<SeparationEvent>& _separations,
+                                             const QString& _firstName,
+                                             const QString& _secondName)
+{
+    beginResetModel();
+    eclipses.clear();
+    separations = _separations;
+    firstName = _firstName;
+    secondName = _secondName;
     endResetModel();
+    // The headers depend on the kind of events
+    headerDataChanged(Qt::Horizontal, 0, columnCount(QModelIndex()) - 1);
 }
 
 const Eclipse*
@@ -259,6 +326,16 @@ EventFinder::EventTableModel::eclipseAtIndex(const QModelIndex& index) const
         return nullptr;
 }
 
+const SeparationEvent*
+EventFinder::EventTableModel::separationAtIndex(const QModelIndex& index) const
+{
+    int row = index.row();
+    if (row >= 0 && row < (int) separations.size())
+        return &separations[row];
+    else
+        return nullptr;
+}
+
 EventFinder::EventFinder(CelestiaCore* _appCore,
                          const QString& title,
                          QWidget* parent) :
@@ -324,6 +401,31 @@ EventFinder::EventFinder(CelestiaCore* _appCore,
     connect(findButton, SIGNAL(clicked()), this, SLOT(slotFindEclipses()));
     layout->addWidget(findButton);
 
+    // Conjunctions, occultations and transits as seen from the selected
+    // planet
+    QGroupBox* separationBox = new QGroupBox(_("Close approaches"));
+    QVBoxLayout* separationLayout = new QVBoxLayout();
+    firstObjectEdit = new QLineEdit(separationBox);
+    firstObjectEdit->setPlaceholderText(_("First object"));
+    secondObjectEdit = new QLineEdit(separationBox);
+    secondObjectEdit->setPlaceholderText(_("Second object"));
+    maxSeparationEdit = new QDoubleSpinBox(separationBox);
+    maxSeparationEdit->setRange(0.0, 180.0);
+    maxSeparationEdit->setDecimals(3);
+    maxSeparationEdit->setSuffix(QString::fromUtf8("\302\260"));
+    maxSeparationEdit->setValue(1.0);
+    limbsBox = new QCheckBox(_("Measure between limbs"), separationBox);
+    limbsBox->setToolTip(_("With a separation of zero this finds occultations and transits"));
+    separationLayout->addWidget(firstObjectEdit);
+    separationLayout->addWidget(secondObjectEdit);
+    separationLayout->addWidget(maxSeparationEdit);
+    separationLayout->addWidget(limbsBox);
+    QPushButton* findSeparationsButton = new QPushButton(_("Find close approaches"));
+    connect(findSeparationsButton, SIGNAL(clicked()), this, SLOT(slotFindSeparations()));
+    separationLayout->addWidget(findSeparationsButton);
+    separationBox->setLayout(separationLayout);
+    layout->addWidget(separationBox);
+
     finderWidget->setLayout(layout);
 
     // Set default values:
@@ -421,11 +523,87 @@ EventFinder::slotFindEclipses()
     eventTable->resizeColumnToContents(EventTableModel::StartTimeColumn);
 }
 
+void
+EventFinder::slotFindSeparations()
+{
+    std::string observerName = fmt::format("Sol/{}", planets[planetSelect->currentIndex()]);
+    Simulation* sim = appCore->getSimulation();
+    Selection observer = sim->findObjectFromPath(observerName);
+    Selection first = sim->findObjectFromPath(firstObjectEdit->text().toStdString(), true);
+    Selection second = sim->findObjectFromPath(secondObjectEdit->text().toStdString(), true);
+
+    for (const auto& [sel, name] : { std::make_pair(&observer, planetSelect->currentText()),
+                                     std::make_pair(&first, firstObjectEdit->text()),
+                                     std::make_pair(&second, secondObjectEdit->text()) })
+    {
+        if (sel->empty())
+        {
+            QString msg(_("%1 is not a valid object"));
+            QMessageBox::critical(this, _("Event Finder"), msg.arg(name));
+            return;
+        }
+    }
+
+    QDate startDate = startDateEdit->date();
+    QDate endDate = endDateEdit->date();
+
+    if (startDate > endDate)
+    {
+        QMessageBox::critical(this, _("Event Finder"),
+                              _("End date is earlier than start date."));
+        return;
+    }
+
+    SeparationFinder finder(observer, first, second, this);
+    searchTimer.start();
+
+    double startTimeTDB = QDateToTDB(startDate);
+    double endTimeTDB = QDateToTDB(endDate);
+
+    searchSpan = endTimeTDB - startTimeTDB;
+    lastProgressUpdate = startTimeTDB;
+
+    progress = new QProgressDialog(_("Finding close approaches..."), "Abort", (int) startTimeTDB, (int) endTimeTDB, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->show();
+
+    auto measure = limbsBox->isChecked() ? SeparationFinder::Measure::Limbs : SeparationFinder::Measure::Centers;
+    std::vector<SeparationEvent> separations;
+    finder.findEvents(startTimeTDB, endTimeTDB,
+                      math::degToRad(maxSeparationEdit->value()),
+                      measure,
+                      separations);
+
+    delete progress;
+    progress = nullptr;
+
+    model->setSeparations(separations, firstObjectEdit->text(), secondObjectEdit->text());
+
+    eventTable->resizeColumnToContents(EventTableModel::OcculterColumn);
+    eventTable->resizeColumnToContents(EventTableModel::ReceiverColumn);
+    eventTable->resizeColumnToContents(EventTableModel::StartTimeColumn);
+}
+
 void
 EventFinder::slotContextMenu(const QPoint& pos)
 {
     QModelIndex index = eventTable->indexAt(pos);
     activeEclipse = model->eclipseAtIndex(index);
+    activeSeparation = model->separationAtIndex(index);
+
+    if (activeSeparation != nullptr)
+    {
+        if (contextMenu == nullptr)
+            contextMenu = new QMenu(this);
+        contextMenu->clear();
+
+        QAction* setTimeAction = new QAction(_("Set time to closest approach"), contextMenu);
+        connect(setTimeAction, SIGNAL(triggered()), this, SLOT(slotSetClosestTime()));
+        contextMenu->addAction(setTimeAction);
+
+        contextMenu->popup(eventTable->mapToGlobal(pos), setTimeAction);
+        return;
+    }
 
     if (activeEclipse != nullptr)
     {
@@ -464,6 +642,12 @@ EventFinder::slotSetEclipseTime()
     appCore->getSimulation()->setTime(midEclipseTime);
 }
 
+void
+EventFinder::slotSetClosestTime()
+{
+    appCore->getSimulation()->setTime(activeSeparation->closestTime);
+}
+
 /*! Move the camera to a point 3 radii from the surface, aimed at the point of maximum eclipse.
  */
 void
@@ -16,9 +16,13 @@
 #include <QElapsedTimer>
 
 #include <celestia/eclipsefinder.h>
+#include <celestia/separationfinder.h>
 
+class QCheckBox;
 class QComboBox;
 class QDateEdit;
+class QDoubleSpinBox;
+class QLineEdit;
 class QMenu;
 class QPoint;
 class QProgressDialog;
@@ -44,9 +48,11 @@ public:
 
 public slots:
     void slotFindEclipses();
+    void slotFindSeparations();
     void slotContextMenu(const QPoint&);
 
     void slotSetEclipseTime();
+    void slotSetClosestTime();
     void slotViewNearEclipsed();
     void slotViewEclipsedSurface();
     void slotViewOccluderSurface();
@@ -66,6 +72,11 @@ private:
 
     QComboBox* planetSelect{ nullptr };
 
+    QLineEdit* firstObjectEdit{ nullptr };
+    QLineEdit* secondObjectEdit{ nullptr };
+    QDoubleSpinBox* maxSeparationEdit{ nullptr };
+    QCheckBox* limbsBox{ nullptr };
+
     EventTableModel* model{ nullptr };
     QTreeView* eventTable{ nullptr };
     QMenu* contextMenu{ nullptr };
@@ -77,6 +88,7 @@ private:
     QElapsedTimer searchTimer;
 
     const Eclipse* activeEclipse{ nullptr };
+    const SeparationEvent* activeSeparation{ nullptr };
 };
 
 } // end namespace celestia::qt
@@ -153,6 +153,7 @@ CelestiaGlWidget::initializeGL()
 
     appRenderer->setSolarSystemMaxDistance(appCore->getConfig()->renderDetails.SolarSystemMaxDistance);
     appRenderer->setShadowMapSize(appCore->getConfig()->renderDetails.ShadowMapSize);
+    appRenderer->setGPUStarRendering(appCore->getConfig()->renderDetails.gpuStarRendering);
 }
 
 void
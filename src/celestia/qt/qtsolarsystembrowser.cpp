@@ -12,7 +12,10 @@
 
 #include "qtsolarsystembrowser.h"
 
+#include <algorithm>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <Qt>
@@ -41,7 +44,6 @@
 #include <celengine/stardb.h>
 #include <celengine/universe.h>
 #include <celestia/celestiacore.h>
-#include <celutil/array_view.h>
 #include <celutil/gettext.h>
 #include <celutil/greek.h>
 #include "qtcolorswatchwidget.h"
@@ -141,6 +143,9 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
     int rowCount(const QModelIndex& index) const override;
     int columnCount(const QModelIndex& index) const override;
+    bool hasChildren(const QModelIndex& parent) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
     void sort(int column, Qt::SortOrder order) override;
     QModelIndex sibling(int row, int column, const QModelIndex &index) const override;
 
@@ -156,55 +161,54 @@ public:
     void buildModel(Star* star, bool _groupByClass, BodyClassification _bodyFilter);
 
 private:
+    // Number of rows added at a time by fetchMore()
+    static constexpr int FetchBatchSize = 500;
+
+    // A group of bodies of one classification, shown as a single child
+    // until it is expanded
+    struct Group
+    {
+        BodyClassification classification;
+        std::vector<Body*> members;
+    };
+
+    // Items are only created for the rows the view asks for. The children
+    // of an item are worked out when the view first needs to know whether
+    // it has any, and their items are created in batches by fetchMore():
+    // the objects first, then the groups.
     class TreeItem
     {
     public:
-        TreeItem() = default;
-        ~TreeItem();
-
         Selection obj;
         TreeItem* parent{nullptr};
-        TreeItem** children{nullptr};
-        int nChildren{0};
+        std::vector<std::unique_ptr<TreeItem>> children;
         int childIndex{0};
         BodyClassification classification{BodyClassification::EmptyMask};
+
+        std::vector<Selection> objects;
+        std::vector<Group> groups;
+        bool childrenListed{false};
+
+        int childCount() const { return static_cast<int>(objects.size() + groups.size()); }
     };
 
-    TreeItem* createTreeItem(Selection sel, TreeItem* parent, int childIndex);
-    void addTreeItemChildren(TreeItem* item,
-                             const PlanetarySystem* sys,
-                             util::array_view<Star*> orbitingStars);
-    void addTreeItemChildrenFiltered(TreeItem* item,
-                                     const PlanetarySystem* sys,
-                                     util::array_view<Star*> orbitingStars);
-    void addTreeItemChildrenGrouped(TreeItem* item,
-                                    const PlanetarySystem* sys,
-                                    util::array_view<Star*> orbitingStars,
-                                    Selection parent);
-    TreeItem* createGroupTreeItem(BodyClassification classification,
-                                  const std::vector<Body*>& objects,
-                                  TreeItem* parent,
-                                  int childIndex);
+    std::unique_ptr<TreeItem> createTreeItem(Selection sel, TreeItem* parent, int childIndex) const;
+    std::unique_ptr<TreeItem> createGroupTreeItem(Group&& group, TreeItem* parent, int childIndex) const;
+
+    void listChildren(TreeItem* item) const;
+    void listChildrenGrouped(TreeItem* item, const PlanetarySystem* sys, Selection parent) const;
 
     TreeItem* itemAtIndex(const QModelIndex& index) const;
 
 private:
     const Universe* universe{nullptr};
-    TreeItem* rootItem{nullptr};
+    std::unique_ptr<TreeItem> rootItem;
+    Star* rootStar{nullptr};
     bool groupByClass{false};
+    bool sortByName{false};
     BodyClassification bodyFilter{BodyClassification::EmptyMask};
 };
 
-SolarSystemBrowser::SolarSystemTreeModel::TreeItem::~TreeItem()
-{
-    if (children != nullptr)
-    {
-        for (int i = 0; i < nChildren; i++)
-            delete children[i];
-        delete[] children;
-    }
-}
-
 SolarSystemBrowser::SolarSystemTreeModel::SolarSystemTreeModel(const Universe* _universe) :
     universe(_universe)
 {
@@ -212,25 +216,21 @@ SolarSystemBrowser::SolarSystemTreeModel::SolarSystemTreeModel(const Universe* _
     buildModel(nullptr, false, BodyClassification::EmptyMask);
 }
 
-// Call createTreeItem() to build the parallel tree structure
 void
 SolarSystemBrowser::SolarSystemTreeModel::buildModel(Star* star, bool _groupByClass, BodyClassification _bodyFilter)
 {
     beginResetModel();
+    rootStar = star;
     groupByClass = _groupByClass;
     bodyFilter = _bodyFilter;
 
-    if (rootItem != nullptr)
-        delete rootItem;
-
-    rootItem = new TreeItem();
-    rootItem->obj = Selection();
+    rootItem = std::make_unique<TreeItem>();
+    rootItem->childrenListed = true;
 
     if (star != nullptr)
     {
-        rootItem->nChildren = 1;
-        rootItem->children = new TreeItem*[1];
-        rootItem->children[0] = createTreeItem(Selection(star), rootItem, 0);
+        rootItem->objects.emplace_back(star);
+        rootItem->children.push_back(createTreeItem(Selection(star), rootItem.get(), 0));
     }
 
     endResetModel();
@@ -238,24 +238,51 @@ SolarSystemBrowser::SolarSystemTreeModel::buildModel(Star* star, bool _groupByCl
 
 // Rather than directly use Celestia's solar system data structure for
 // the tree model, we'll build a parallel structure out of TreeItems.
-// The additional memory used for this structure is negligible, and
-// it gives us some freedom to structure the tree in a different
+// This gives us some freedom to structure the tree in a different
 // way than it's represented internally, e.g. to group objects by
 // their classification. It also simplifies the code because stars
 // and solar system bodies can be treated almost identically once
 // the new tree is built.
-SolarSystemBrowser::SolarSystemTreeModel::TreeItem*
+std::unique_ptr<SolarSystemBrowser::SolarSystemTreeModel::TreeItem>
 SolarSystemBrowser::SolarSystemTreeModel::createTreeItem(Selection sel,
                                                          TreeItem* parent,
-                                                         int childIndex)
+                                                         int childIndex) const
 {
-    auto* item = new TreeItem();
+    auto item = std::make_unique<TreeItem>();
     item->parent = parent;
     item->obj = sel;
     item->childIndex = childIndex;
+    return item;
+}
+
+std::unique_ptr<SolarSystemBrowser::SolarSystemTreeModel::TreeItem>
+SolarSystemBrowser::SolarSystemTreeModel::createGroupTreeItem(Group&& group,
+                                                              TreeItem* parent,
+                                                              int childIndex) const
+{
+    auto item = std::make_unique<TreeItem>();
+    item->parent = parent;
+    item->childIndex = childIndex;
+    item->classification = group.classification;
+
+    item->objects.reserve(group.members.size());
+    for (Body* body : group.members)
+        item->objects.emplace_back(body);
+    item->childrenListed = true;
+
+    // The members are not needed by the parent any more
+    group.members = std::vector<Body*>();
+    return item;
+}
 
-    util::array_view<Star*> orbitingStars;
+void
+SolarSystemBrowser::SolarSystemTreeModel::listChildren(TreeItem* item) const
+{
+    if (item->childrenListed)
+        return;
+    item->childrenListed = true;
 
+    const Selection& sel = item->obj;
     const PlanetarySystem* sys = nullptr;
     if (sel.body() != nullptr)
     {
@@ -271,104 +298,35 @@ SolarSystemBrowser::SolarSystemTreeModel::createTreeItem(Selection sel,
             sys = solarSys->getPlanets();
         }
 
-        orbitingStars = sel.star()->getOrbitingStars();
+        for (Star* star : sel.star()->getOrbitingStars())
+            item->objects.emplace_back(star);
     }
 
-    if (groupByClass && sys != nullptr)
-        addTreeItemChildrenGrouped(item, sys, orbitingStars, sel);
-    else if (bodyFilter != BodyClassification::EmptyMask && sys != nullptr)
-        addTreeItemChildrenFiltered(item, sys, orbitingStars);
-    else
-        addTreeItemChildren(item, sys, orbitingStars);
-
-    return item;
-}
-
-void
-SolarSystemBrowser::SolarSystemTreeModel::addTreeItemChildren(TreeItem* item,
-                                                              const PlanetarySystem* sys,
-                                                              util::array_view<Star*> orbitingStars)
-{
-    // Calculate the number of children: the number of orbiting stars plus
-    // the number of orbiting solar system bodies.
-    item->nChildren = static_cast<int>(orbitingStars.size());
-    if (sys != nullptr)
-        item->nChildren += sys->getSystemSize();
-
-    if (item->nChildren != 0)
-    {
-        int childIndex = 0;
-        item->children = new TreeItem*[item->nChildren];
-
-        // Add the stars
-        for (Star* star : orbitingStars)
-        {
-            item->children[childIndex] = createTreeItem(star, item, childIndex);
-            ++childIndex;
-        }
-
-        // Add the solar system bodies
-        if (sys != nullptr)
-        {
-            for (int i = 0; i < sys->getSystemSize(); i++)
-            {
-                Selection child(sys->getBody(i));
-                item->children[childIndex] = createTreeItem(child, item, childIndex);
-                childIndex++;
-            }
-        }
-    }
-}
-
-void
-SolarSystemBrowser::SolarSystemTreeModel::addTreeItemChildrenFiltered(TreeItem* item,
-                                                                      const PlanetarySystem* sys,
-                                                                      util::array_view<Star*> orbitingStars)
-{
-    std::vector<Body*> bodies;
-
-    for (int i = 0; i < sys->getSystemSize(); i++)
-    {
-        Body* body = sys->getBody(i);
-        if (util::is_set(body->getClassification(), bodyFilter))
-            bodies.push_back(body);
-    }
-
-    // Calculate the total number of children
-    // WARN: max(size_t) > max(int) so in theory it's possible to have a negative value
-    item->nChildren = static_cast<int>(bodies.size()) + static_cast<int>(orbitingStars.size());
-
-    if (item->nChildren == 0)
+    if (sys == nullptr)
         return;
 
-    item->children = new TreeItem*[item->nChildren];
-
-    // Add the orbiting stars
-    int childIndex = 0;
-    for (Star* star : orbitingStars)
+    if (groupByClass)
     {
-        item->children[childIndex] = createTreeItem(star, item, childIndex);
-        ++childIndex;
+        listChildrenGrouped(item, sys, sel);
+        return;
     }
 
-    // Add the direct children
-    for (Body* body : bodies)
-    {
-        item->children[childIndex] = createTreeItem(body, item, childIndex);
-        ++childIndex;
-    }
+    BodyClassification mask = bodyFilter == BodyClassification::EmptyMask
+        ? ~BodyClassification::EmptyMask
+        : bodyFilter;
+    for (Body* body : sys->getBodies(mask, sortByName))
+        item->objects.emplace_back(body);
 }
 
-// Add children to item, but group objects of certain classes
+// List the children of item, but group objects of certain classes
 // into subtrees to avoid clutter. Stars, planets, and moons
 // are shown as direct children of the parent. Small moons,
 // asteroids, and spacecraft a grouped together, as there tend to be
 // large collections of such objects.
 void
-SolarSystemBrowser::SolarSystemTreeModel::addTreeItemChildrenGrouped(TreeItem* item,
-                                                                     const PlanetarySystem* sys,
-                                                                     util::array_view<Star*> orbitingStars,
-                                                                     Selection parent)
+SolarSystemBrowser::SolarSystemTreeModel::listChildrenGrouped(TreeItem* item,
+                                                              const PlanetarySystem* sys,
+                                                              Selection parent) const
 {
     std::vector<Body*> asteroids;
     std::vector<Body*> spacecraft;
@@ -376,7 +334,6 @@ SolarSystemBrowser::SolarSystemTreeModel::addTreeItemChildrenGrouped(TreeItem* i
     std::vector<Body*> surfaceFeatures;
     std::vector<Body*> components;
     std::vector<Body*> other;
-    std::vector<Body*> normal;
 
     bool groupAsteroids = true;
     bool groupSpacecraft = true;
@@ -393,16 +350,15 @@ SolarSystemBrowser::SolarSystemTreeModel::addTreeItemChildrenGrouped(TreeItem* i
             groupSpacecraft = false;
     }
 
-    for (int i = 0; i < sys->getSystemSize(); i++)
+    for (Body* body : sys->getBodies(~BodyClassification::EmptyMask, sortByName))
     {
-        Body* body = sys->getBody(i);
         switch (body->getClassification())
         {
         case BodyClassification::Planet:
         case BodyClassification::DwarfPlanet:
         case BodyClassification::Invisible:
         case BodyClassification::Moon:
-            normal.push_back(body);
+            item->objects.emplace_back(body);
             break;
         case BodyClassification::MinorMoon:
             minorMoons.push_back(body);
@@ -412,25 +368,25 @@ SolarSystemBrowser::SolarSystemTreeModel::addTreeItemChildrenGrouped(TreeItem* i
             if (groupAsteroids)
                 asteroids.push_back(body);
             else
-                normal.push_back(body);
+                item->objects.emplace_back(body);
             break;
         case BodyClassification::Spacecraft:
             if (groupSpacecraft)
                 spacecraft.push_back(body);
             else
-                normal.push_back(body);
+                item->objects.emplace_back(body);
             break;
         case BodyClassification::Component:
             if (groupComponents)
                 components.push_back(body);
             else
-                normal.push_back(body);
+                item->objects.emplace_back(body);
             break;
         case BodyClassification::SurfaceFeature:
             if (groupSurfaceFeatures)
                 surfaceFeatures.push_back(body);
             else
-                normal.push_back(body);
+                item->objects.emplace_back(body);
             break;
         default:
             other.push_back(body);
@@ -438,123 +394,26 @@ SolarSystemBrowser::SolarSystemTreeModel::addTreeItemChildrenGrouped(TreeItem* i
         }
     }
 
-    // Calculate the total number of children
-    item->nChildren = static_cast<int>(orbitingStars.size());
-
-    item->nChildren += normal.size();
-    if (!asteroids.empty())
-        item->nChildren++;
-    if (!spacecraft.empty())
-        item->nChildren++;
-    if (!minorMoons.empty())
-        item->nChildren++;
-    if (!surfaceFeatures.empty())
-        item->nChildren++;
-    if (!components.empty())
-        item->nChildren++;
-    if (!other.empty())
-        item->nChildren++;
-
-    if (item->nChildren != 0)
-    {
-        int childIndex = 0;
-        item->children = new TreeItem*[item->nChildren];
-        {
-            // Add the stars
-            for (Star* star : orbitingStars)
-            {
-                item->children[childIndex] = createTreeItem(star, item, childIndex);
-                ++childIndex;
-            }
-
-            // Add the direct children
-            for (Body* body : normal)
-            {
-                item->children[childIndex] = createTreeItem(body, item, childIndex);
-                ++childIndex;
-            }
-
-            // Add the groups
-            if (!minorMoons.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(BodyClassification::MinorMoon,
-                                                                 minorMoons,
-                                                                 item, childIndex);
-                ++childIndex;
-            }
-
-            if (!asteroids.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(BodyClassification::Asteroid,
-                                                                 asteroids,
-                                                                 item, childIndex);
-                ++childIndex;
-            }
-
-            if (!spacecraft.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(BodyClassification::Spacecraft,
-                                                                 spacecraft,
-                                                                 item, childIndex);
-                ++childIndex;
-            }
-
-            if (!surfaceFeatures.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(BodyClassification::SurfaceFeature,
-                                                                 surfaceFeatures,
-                                                                 item, childIndex);
-                ++childIndex;
-            }
-
-            if (!components.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(BodyClassification::Component,
-                                                                 components,
-                                                                 item, childIndex);
-                ++childIndex;
-            }
-
-            if (!other.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(BodyClassification::Unknown,
-                                                                 other,
-                                                                 item, childIndex);
-                ++childIndex;
-            }
-        }
-    }
-}
-
-SolarSystemBrowser::SolarSystemTreeModel::TreeItem*
-SolarSystemBrowser::SolarSystemTreeModel::createGroupTreeItem(BodyClassification classification,
-                                                              const std::vector<Body*>& objects,
-                                                              TreeItem* parent,
-                                                              int childIndex)
-{
-    auto* item = new TreeItem();
-    item->parent = parent;
-    item->childIndex = childIndex;
-    item->classification = classification;
-
-    if (!objects.empty())
+    // Add the groups
+    auto addGroup = [item](BodyClassification classification, std::vector<Body*>& members)
     {
-        item->nChildren = (int) objects.size();
-        item->children = new TreeItem*[item->nChildren];
-        for (int i = 0; i < item->nChildren; i++)
-        {
-            item->children[i] = createTreeItem(Selection(objects[i]), item, i);
-        }
-    }
+        if (!members.empty())
+            item->groups.push_back({ classification, std::move(members) });
+    };
 
-    return item;
+    addGroup(BodyClassification::MinorMoon, minorMoons);
+    addGroup(BodyClassification::Asteroid, asteroids);
+    addGroup(BodyClassification::Spacecraft, spacecraft);
+    addGroup(BodyClassification::SurfaceFeature, surfaceFeatures);
+    addGroup(BodyClassification::Component, components);
+    addGroup(BodyClassification::Unknown, other);
 }
 
 SolarSystemBrowser::SolarSystemTreeModel::TreeItem*
 SolarSystemBrowser::SolarSystemTreeModel::itemAtIndex(const QModelIndex& index) const
 {
     if (!index.isValid())
-        return rootItem;
+        return rootItem.get();
 
     return static_cast<TreeItem*>(index.internalPointer());
 }
@@ -574,15 +433,9 @@ SolarSystemBrowser::SolarSystemTreeModel::index(int row, int column, const QMode
     if (!hasIndex(row, column, parent))
         return QModelIndex();
 
-    TreeItem* parentItem;
-
-    if (!parent.isValid())
-        parentItem = rootItem;
-    else
-        parentItem = static_cast<TreeItem*>(parent.internalPointer());
-
-    if (row < parentItem->nChildren)
-        return createIndex(row, column, parentItem->children[row]);
+    TreeItem* parentItem = itemAtIndex(parent);
+    if (row < static_cast<int>(parentItem->children.size()))
+        return createIndex(row, column, parentItem->children[row].get());
     else
         return QModelIndex();
 }
@@ -596,7 +449,7 @@ SolarSystemBrowser::SolarSystemTreeModel::parent(const QModelIndex& index) const
 
     TreeItem* child = static_cast<TreeItem*>(index.internalPointer());
 
-    if (child->parent == rootItem)
+    if (child->parent == rootItem.get())
         return QModelIndex();
     else
         return createIndex(child->parent->childIndex, 0, child->parent);
@@ -680,10 +533,55 @@ SolarSystemBrowser::SolarSystemTreeModel::rowCount(const QModelIndex& parent) co
     if (parent.column() > 0)
         return 0;
 
-    if (!parent.isValid())
-        return rootItem->nChildren;
+    return static_cast<int>(itemAtIndex(parent)->children.size());
+}
+
+// Override QAbstractDataModel::hasChildren()
+bool
+SolarSystemBrowser::SolarSystemTreeModel::hasChildren(const QModelIndex& parent) const
+{
+    if (parent.column() > 0)
+        return false;
 
-    return static_cast<TreeItem*>(parent.internalPointer())->nChildren;
+    TreeItem* item = itemAtIndex(parent);
+    listChildren(item);
+    return item->childCount() > 0;
+}
+
+// Override QAbstractDataModel::canFetchMore()
+bool
+SolarSystemBrowser::SolarSystemTreeModel::canFetchMore(const QModelIndex& parent) const
+{
+    if (parent.column() > 0)
+        return false;
+
+    TreeItem* item = itemAtIndex(parent);
+    listChildren(item);
+    return static_cast<int>(item->children.size()) < item->childCount();
+}
+
+// Override QAbstractDataModel::fetchMore()
+void
+SolarSystemBrowser::SolarSystemTreeModel::fetchMore(const QModelIndex& parent)
+{
+    TreeItem* item = itemAtIndex(parent);
+    listChildren(item);
+
+    auto first = static_cast<int>(item->children.size());
+    int last = std::min(first + FetchBatchSize, item->childCount()) - 1;
+    if (last < first)
+        return;
+
+    beginInsertRows(parent, first, last);
+    auto nObjects = static_cast<int>(item->objects.size());
+    for (int i = first; i <= last; ++i)
+    {
+        if (i < nObjects)
+            item->children.push_back(createTreeItem(item->objects[i], item, i));
+        else
+            item->children.push_back(createGroupTreeItem(std::move(item->groups[i - nObjects]), item, i));
+    }
+    endInsertRows();
 }
 
 // Override QAbstractDataModel::columnCount()
@@ -706,9 +604,18 @@ SolarSystemBrowser::SolarSystemTreeModel::sibling(int row, int column, const QMo
     return QAbstractItemModel::sibling(row, column, index);
 }
 
+// Sorting by name orders the bodies of each system and group by name;
+// otherwise they are in the order of the catalogs, e.g. planets by their
+// distance from the Sun.
 void
-SolarSystemBrowser::SolarSystemTreeModel::sort(int /* column */, Qt::SortOrder /* order */)
+SolarSystemBrowser::SolarSystemTreeModel::sort(int column, Qt::SortOrder /* order */)
 {
+    bool byName = column == NameColumn;
+    if (byName == sortByName)
+        return;
+
+    sortByName = byName;
+    buildModel(rootStar, groupByClass, bodyFilter);
 }
 
 Selection
@@ -898,6 +805,9 @@ SolarSystemBrowser::slotRefreshTree()
     if (primary.isValid() && solarSystemModel->objectAtIndex(primary).star() != nullptr)
     {
         treeView->setExpanded(primary, true);
+        // The view fetches the children of expanded items lazily
+        if (solarSystemModel->canFetchMore(primary))
+            solarSystemModel->fetchMore(primary);
         QModelIndex secondary = solarSystemModel->index(0, 0, primary);
         if (secondary.isValid() && solarSystemModel->objectAtIndex(secondary).star() != nullptr)
         {
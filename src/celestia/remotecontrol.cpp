@@ -0,0 +1,555 @@
+// remotecontrol.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "remotecontrol.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <utility>
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#include <Eigen/Core>
+
+#include <celengine/render.h>
+#include <celengine/renderlistentry.h>
+#include <celengine/selection.h>
+#include <celengine/simulation.h>
+#include <celestia/celestiacore.h>
+#include <celestia/statesnapshot.h>
+#include <celestia/url.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/logger.h>
+#include "socketutil.h"
+
+using celestia::util::GetLogger;
+
+namespace celestia
+{
+
+namespace
+{
+
+// Don't raise SIGPIPE when a client has gone away
+#ifdef MSG_NOSIGNAL
+constexpr int SendFlags = MSG_NOSIGNAL;
+#else
+constexpr int SendFlags = 0;
+#endif
+
+// "CELR" in little-endian order
+constexpr std::uint32_t Magic = 0x524c4543;
+// Large enough for a snapshot with many markers
+constexpr std::uint32_t MaxMessageSize = 1 << 20;
+constexpr std::size_t MaxClients = 8;
+constexpr std::size_t ReceiveBufferSize = 4096;
+
+enum class MessageType : std::uint8_t
+{
+    ApplySnapshot   = 1,
+    CaptureSnapshot = 2,
+    Goto            = 3,
+    Select          = 4,
+    QueryPosition   = 5,
+    QueryVisible    = 6,
+
+    Reply           = 128,
+    Error           = 129,
+};
+
+void
+writeString(std::ostream& out, std::string_view value)
+{
+    util::writeLE<std::uint16_t>(out, static_cast<std::uint16_t>(value.size()));
+    out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+bool
+readString(std::istream& in, std::string& value)
+{
+    std::uint16_t length;
+    if (!util::readLE<std::uint16_t>(in, length))
+        return false;
+
+    value.resize(length);
+    return length == 0 || in.read(value.data(), length).good();
+}
+
+std::string
+encodeMessage(MessageType type, std::uint32_t request, std::string_view body)
+{
+    std::ostringstream out;
+    util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(sizeof(std::uint32_t) + sizeof(std::uint8_t) +
+                                                                 sizeof(std::uint32_t) + body.size()));
+    util::writeLE<std::uint32_t>(out, Magic);
+    util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(type));
+    util::writeLE<std::uint32_t>(out, request);
+    out.write(body.data(), static_cast<std::streamsize>(body.size()));
+    return out.str();
+}
+
+std::string
+encodeError(std::uint32_t request, std::string_view message)
+{
+    std::ostringstream body;
+    writeString(body, message);
+    return encodeMessage(MessageType::Error, request, body.str());
+}
+
+std::string
+objectPath(const Selection& sel, const CelestiaCore& appCore)
+{
+    return Url::decodeString(Url::getEncodedObjectName(sel, &appCore));
+}
+
+// Reads an object reference and looks it up: a selection ID, or an empty
+// one followed by an object path
+std::optional<Selection>
+readObject(std::istream& in, const CelestiaCore& appCore, std::string& error)
+{
+    SelectionId id;
+    if (!readSelectionId(in, id))
+    {
+        error = "Invalid object reference";
+        return std::nullopt;
+    }
+
+    const Simulation* sim = appCore.getSimulation();
+    if (!id.empty())
+    {
+        Selection sel = sim->getUniverse()->find(id);
+        if (sel.empty())
+        {
+            error = "Object not found";
+            return std::nullopt;
+        }
+        return sel;
+    }
+
+    std::string path;
+    if (!readString(in, path))
+    {
+        error = "Missing object path";
+        return std::nullopt;
+    }
+
+    Selection sel = sim->findObjectFromPath(path);
+    if (sel.empty())
+    {
+        error = "Object not found: " + path;
+        return std::nullopt;
+    }
+
+    return sel;
+}
+
+bool
+applySnapshot(CelestiaCore& appCore, std::istream& in, std::string& error)
+{
+    auto snapshot = StateSnapshot::load(in, *appCore.getSimulation()->getUniverse());
+    if (!snapshot.has_value())
+    {
+        error = "Invalid snapshot";
+        return false;
+    }
+
+    snapshot->apply(appCore);
+    return true;
+}
+
+bool
+gotoObject(CelestiaCore& appCore, std::istream& in, std::string& error)
+{
+    auto sel = readObject(in, appCore, error);
+    if (!sel.has_value())
+        return false;
+
+    double duration;
+    double distance;
+    if (!util::readLE<double>(in, duration) || !util::readLE<double>(in, distance))
+    {
+        error = "Missing travel time or distance";
+        return false;
+    }
+
+    Simulation* sim = appCore.getSimulation();
+    sim->setSelection(*sel);
+    if (distance > 0.0)
+        sim->gotoSelection(duration, distance, Eigen::Vector3f::UnitY(), ObserverFrame::ObserverLocal);
+    else
+        sim->gotoSelection(duration, Eigen::Vector3f::UnitY(), ObserverFrame::ObserverLocal);
+    return true;
+}
+
+bool
+queryPosition(const CelestiaCore& appCore, std::istream& in, std::ostream& reply, std::string& error)
+{
+    auto sel = readObject(in, appCore, error);
+    if (!sel.has_value())
+        return false;
+
+    const Simulation* sim = appCore.getSimulation();
+    Eigen::Vector3d position = sel->getPosition(sim->getTime()).offsetFromKm(sim->getObserver().getPosition());
+    util::writeLE<double>(reply, position.x());
+    util::writeLE<double>(reply, position.y());
+    util::writeLE<double>(reply, position.z());
+    util::writeLE<double>(reply, sel->radius());
+    return true;
+}
+
+// The objects are those in the render list of the last frame, so the
+// query costs no more than writing them
+void
+queryVisible(const CelestiaCore& appCore, std::ostream& reply)
+{
+    std::ostringstream objects;
+    std::uint32_t count = 0;
+    for (const RenderListEntry& rle : appCore.getRenderer()->getRenderList())
+    {
+        Selection sel;
+        if (rle.renderableType == RenderListEntry::RenderableStar)
+            sel = Selection(const_cast<Star*>(rle.star)); //NOSONAR
+        else if (rle.renderableType == RenderListEntry::RenderableBody)
+            sel = Selection(rle.body);
+        else
+            continue;
+
+        writeString(objects, objectPath(sel, appCore));
+        writeSelectionId(objects, sel.id());
+        util::writeLE<float>(objects, rle.distance);
+        util::writeLE<float>(objects, rle.appMag);
+        util::writeLE<float>(objects, rle.discSizeInPixels);
+        ++count;
+    }
+
+    util::writeLE<std::uint32_t>(reply, count);
+    reply << objects.str();
+}
+
+// Handles one message and returns the encoded reply
+std::string
+handleRequest(CelestiaCore& appCore, std::istream& in)
+{
+    std::uint32_t magic;
+    std::uint8_t typeValue;
+    std::uint32_t request;
+    if (!util::readLE<std::uint32_t>(in, magic) || magic != Magic ||
+        !util::readLE<std::uint8_t>(in, typeValue) ||
+        !util::readLE<std::uint32_t>(in, request))
+    {
+        return encodeError(0, "Invalid message header");
+    }
+
+    std::ostringstream reply;
+    std::string error;
+    bool handled = true;
+    switch (static_cast<MessageType>(typeValue))
+    {
+    case MessageType::ApplySnapshot:
+        handled = applySnapshot(appCore, in, error);
+        break;
+    case MessageType::CaptureSnapshot:
+        StateSnapshot::capture(appCore).save(reply);
+        break;
+    case MessageType::Goto:
+        handled = gotoObject(appCore, in, error);
+        break;
+    case MessageType::Select:
+        if (auto sel = readObject(in, appCore, error); sel.has_value())
+            appCore.getSimulation()->setSelection(*sel);
+        else
+            handled = false;
+        break;
+    case MessageType::QueryPosition:
+        handled = queryPosition(appCore, in, reply, error);
+        break;
+    case MessageType::QueryVisible:
+        queryVisible(appCore, reply);
+        break;
+    default:
+        error = "Unknown message type";
+        handled = false;
+        break;
+    }
+
+    return handled ? encodeMessage(MessageType::Reply, request, reply.str())
+                   : encodeError(request, error);
+}
+
+} // end unnamed namespace
+
+class RemoteControl::Socket
+{
+public:
+    Socket() = default;
+    ~Socket();
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    bool open(const std::string& host, std::uint16_t port);
+    // Returns InvalidSocket if no connection is waiting
+    SocketHandle accept() const;
+    SocketHandle handle() const { return m_handle; }
+
+private:
+    SocketLibrary m_library;
+    SocketHandle m_handle{ InvalidSocket };
+};
+
+RemoteControl::Socket::~Socket()
+{
+    closeSocket(m_handle);
+}
+
+bool
+RemoteControl::Socket::open(const std::string& host, std::uint16_t port)
+{
+    if (!m_library.isStarted())
+        return false;
+
+    // Without a host getaddrinfo returns the loopback addresses, so that
+    // only local programs can connect unless another host is configured;
+    // "*" listens on all interfaces
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    const char* node = nullptr;
+    if (host == "*")
+        hints.ai_flags = AI_PASSIVE;
+    else if (!host.empty())
+        node = host.c_str();
+
+    addrinfo* info = nullptr;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(node, service.c_str(), &hints, &info) != 0)
+        return false;
+
+    for (const addrinfo* ai = info; ai != nullptr; ai = ai->ai_next)
+    {
+        m_handle = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (m_handle == InvalidSocket)
+            continue;
+
+        // Listen on IPv4 and IPv6 where possible
+        if (ai->ai_family == AF_INET6)
+        {
+            int v6only = 0;
+            setsockopt(m_handle, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast<const char*>(&v6only), sizeof(v6only));
+        }
+#ifndef _WIN32
+        // Allow restarting while connections of the last run linger
+        int reuse = 1;
+        setsockopt(m_handle, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
+        if (bind(m_handle, ai->ai_addr, static_cast<socklen_t>(ai->ai_addrlen)) == 0 &&
+            listen(m_handle, SOMAXCONN) == 0 &&
+            setNonBlocking(m_handle))
+        {
+            break;
+        }
+
+        closeSocket(m_handle);
+        m_handle = InvalidSocket;
+    }
+
+    freeaddrinfo(info);
+    return m_handle != InvalidSocket;
+}
+
+SocketHandle
+RemoteControl::Socket::accept() const
+{
+    SocketHandle client = ::accept(m_handle, nullptr, nullptr);
+    if (client == InvalidSocket)
+        return InvalidSocket;
+
+    // Replies are small and should go out at once
+    int noDelay = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    if (!setNonBlocking(client))
+    {
+        closeSocket(client);
+        return InvalidSocket;
+    }
+
+    return client;
+}
+
+struct RemoteControl::Client
+{
+    explicit Client(SocketHandle h) : handle(h) {}
+    ~Client() { closeSocket(handle); }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    // Both return false when the connection is closed
+    bool receive();
+    bool send();
+
+    SocketHandle handle;
+    std::string input;
+    std::string output;
+};
+
+bool
+RemoteControl::Client::receive()
+{
+    std::array<char, ReceiveBufferSize> buffer;
+    for (;;)
+    {
+        auto size = recv(handle, buffer.data(), static_cast<int>(buffer.size()), 0);
+        if (size > 0)
+            input.append(buffer.data(), static_cast<std::size_t>(size));
+        else
+            return size < 0 && wouldBlock();
+    }
+}
+
+bool
+RemoteControl::Client::send()
+{
+    std::size_t sent = 0;
+    while (sent < output.size())
+    {
+        auto size = ::send(handle, output.data() + sent, static_cast<int>(output.size() - sent), SendFlags);
+        if (size < 0)
+        {
+            if (!wouldBlock())
+                return false;
+            break;
+        }
+        sent += static_cast<std::size_t>(size);
+    }
+
+    // The rest is sent on the next poll
+    output.erase(0, sent);
+    return true;
+}
+
+RemoteControl::RemoteControl(std::unique_ptr<Socket>&& socket) :
+    m_socket(std::move(socket))
+{
+}
+
+RemoteControl::~RemoteControl() = default;
+
+std::unique_ptr<RemoteControl>
+RemoteControl::create(const std::string& host, std::uint16_t port)
+{
+    auto socket = std::make_unique<Socket>();
+    if (!socket->open(host, port))
+    {
+        GetLogger()->error("Cannot open remote control port {}\n", port);
+        return nullptr;
+    }
+
+    return std::unique_ptr<RemoteControl>(new RemoteControl(std::move(socket)));
+}
+
+void
+RemoteControl::poll(CelestiaCore& appCore)
+{
+#ifdef _WIN32
+    std::vector<WSAPOLLFD> fds;
+#else
+    std::vector<pollfd> fds;
+#endif
+    fds.reserve(m_clients.size() + 1);
+    fds.push_back({ m_socket->handle(), POLLIN, 0 });
+    for (const auto& client : m_clients)
+    {
+        auto events = static_cast<short>(client->output.empty() ? POLLIN : POLLIN | POLLOUT);
+        fds.push_back({ client->handle, events, 0 });
+    }
+
+#ifdef _WIN32
+    if (WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), 0) <= 0)
+        return;
+#else
+    if (::poll(fds.data(), static_cast<nfds_t>(fds.size()), 0) <= 0)
+        return;
+#endif
+
+    for (std::size_t i = 0; i < m_clients.size(); ++i)
+    {
+        Client& client = *m_clients[i];
+        short revents = fds[i + 1].revents;
+        bool open = true;
+        if ((revents & (POLLIN | POLLHUP | POLLERR)) != 0)
+        {
+            bool connected = client.receive();
+            open = handleMessages(appCore, client) && connected;
+        }
+        // Replies are still sent to clients that have stopped sending
+        if (!client.output.empty() && !client.send())
+            open = false;
+        if (!open)
+            m_clients[i] = nullptr;
+    }
+
+    m_clients.erase(std::remove(m_clients.begin(), m_clients.end(), nullptr), m_clients.end());
+
+    if ((fds[0].revents & POLLIN) == 0)
+        return;
+
+    for (;;)
+    {
+        SocketHandle handle = m_socket->accept();
+        if (handle == InvalidSocket)
+            break;
+
+        if (m_clients.size() >= MaxClients)
+        {
+            GetLogger()->warn("Too many remote control connections\n");
+            closeSocket(handle);
+            continue;
+        }
+
+        m_clients.push_back(std::make_unique<Client>(handle));
+    }
+}
+
+bool
+RemoteControl::handleMessages(CelestiaCore& appCore, Client& client)
+{
+    std::size_t offset = 0;
+    while (client.input.size() - offset >= sizeof(std::uint32_t))
+    {
+        auto length = util::fromMemoryLE<std::uint32_t>(client.input.data() + offset);
+        if (length > MaxMessageSize)
+        {
+            // The stream can't be resynchronized
+            client.output += encodeError(0, "Message too long");
+            return false;
+        }
+
+        if (client.input.size() - offset - sizeof(std::uint32_t) < length)
+            break;
+
+        std::istringstream in(client.input.substr(offset + sizeof(std::uint32_t), length));
+        offset += sizeof(std::uint32_t) + length;
+        client.output += handleRequest(appCore, in);
+    }
+
+    client.input.erase(0, offset);
+    return true;
+}
+
+} // end namespace celestia
@@ -0,0 +1,77 @@
+// remotecontrol.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Control of a running instance over a network connection.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class CelestiaCore;
+
+namespace celestia
+{
+
+// A server for show control systems, which connect over TCP and send
+// commands in a small binary protocol. Every message, in both directions,
+// is a 32-bit length followed by that many bytes: a magic number, the
+// message type, a request number and the body of the message. All numbers
+// are little-endian and strings are prefixed by a 16-bit length. Objects
+// are referred to by a selection ID as written by writeSelectionId, or by
+// an empty selection ID followed by an object path.
+//
+// Requests are handled on the main loop when poll() is called, which never
+// waits for the network, and each is answered with a Reply carrying the
+// same request number or with an Error carrying a message:
+//
+// ApplySnapshot    body: a StateSnapshot as written by StateSnapshot::save
+// CaptureSnapshot  reply: the current StateSnapshot
+// Goto             body: object, travel time in seconds and distance in
+//                  kilometers, or 0 for the default distance
+// Select           body: object
+// QueryPosition    body: object
+//                  reply: position relative to the observer in kilometers
+//                  as three doubles and the radius as a double
+// QueryVisible     reply: the number of objects drawn in the last frame,
+//                  and for each its path, its selection ID, and its
+//                  distance in kilometers, apparent magnitude and size in
+//                  pixels as floats
+class RemoteControl
+{
+public:
+    // Listens on the given port of host, or of the loopback interface if
+    // host is empty
+    static std::unique_ptr<RemoteControl> create(const std::string& host, std::uint16_t port);
+
+    ~RemoteControl();
+
+    RemoteControl(const RemoteControl&) = delete;
+    RemoteControl& operator=(const RemoteControl&) = delete;
+
+    // Accepts connections, handles the requests that have arrived and
+    // sends the replies, as far as possible without waiting
+    void poll(CelestiaCore&);
+
+private:
+    class Socket;
+    struct Client;
+
+    explicit RemoteControl(std::unique_ptr<Socket>&&);
+
+    // Returns false if the connection has to be closed
+    bool handleMessages(CelestiaCore&, Client&);
+
+    std::unique_ptr<Socket> m_socket;
+    std::vector<std::unique_ptr<Client>> m_clients;
+};
+
+} // end namespace celestia
@@ -0,0 +1,182 @@
+// resolutionscaler.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Adapts the resolution and the detail of the scene to the frame time.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "resolutionscaler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace celestia
+{
+
+namespace
+{
+
+// Weight of the newest frame in the running average
+constexpr float AverageWeight = 0.1f;
+
+// Frames measured before the scale may change again
+constexpr int AdjustInterval = 30;
+
+// The scale is a multiple of this, which bounds the number of distinct
+// framebuffer sizes
+constexpr float ScaleStep = 0.05f;
+
+// Largest increase of the scale in one adjustment
+constexpr float MaxScaleIncrease = 0.1f;
+
+// Fraction of the frame budget the scale aims for
+constexpr float TargetLoad = 0.85f;
+
+// Frames faster than this fraction of the budget raise the scale
+constexpr float RaiseThreshold = 0.7f;
+
+} // end unnamed namespace
+
+ResolutionScaler::ResolutionScaler(float targetFrameRate, float minScale, float maxScale,
+                                   unsigned int maxDetailReduction) :
+    m_targetTime(1000.0f / targetFrameRate),
+    m_minScale(minScale),
+    m_maxScale(maxScale),
+    m_scale(maxScale),
+    m_maxDetailReduction(maxDetailReduction)
+{
+#ifndef GL_ES
+    m_hasTimerQuery = gl::checkVersion(gl::GL_3_3) || gl::ARB_timer_query;
+    if (!m_hasTimerQuery)
+        return;
+
+    for (FrameQueries& frame : m_frames)
+        glGenQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+#endif
+}
+
+ResolutionScaler::~ResolutionScaler()
+{
+#ifndef GL_ES
+    if (!m_hasTimerQuery)
+        return;
+
+    for (FrameQueries& frame : m_frames)
+        glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+#endif
+}
+
+void
+ResolutionScaler::beginFrame()
+{
+    m_inFrame = true;
+    m_frameStart = clock::now();
+
+#ifndef GL_ES
+    if (!m_hasTimerQuery)
+        return;
+
+    // Reuse the queries of the oldest frame, picking up its result first
+    FrameQueries& frame = m_frames[m_frameIndex % FrameLatency];
+    if (frame.pending)
+        collectGPUTime(frame);
+
+    glQueryCounter(frame.queries[0], GL_TIMESTAMP);
+#endif
+}
+
+void
+ResolutionScaler::endFrame()
+{
+    if (!m_inFrame)
+        return;
+
+    m_inFrame = false;
+#ifndef GL_ES
+    if (m_hasTimerQuery)
+    {
+        FrameQueries& frame = m_frames[m_frameIndex % FrameLatency];
+        glQueryCounter(frame.queries[1], GL_TIMESTAMP);
+        frame.pending = true;
+        ++m_frameIndex;
+        return;
+    }
+#endif
+
+    addSample(std::chrono::duration<float, std::milli>(clock::now() - m_frameStart).count());
+}
+
+void
+ResolutionScaler::collectGPUTime([[maybe_unused]] FrameQueries& frame)
+{
+#ifndef GL_ES
+    frame.pending = false;
+
+    // Drop the frame rather than wait for its result
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(frame.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE)
+        return;
+
+    GLuint64 start = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(frame.queries[0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(frame.queries[1], GL_QUERY_RESULT, &end);
+    addSample(static_cast<float>(std::max(end, start) - start) * 1.0e-6f);
+#endif
+}
+
+void
+ResolutionScaler::addSample(float frameTime)
+{
+    if (m_averageTime < 0.0f)
+        m_averageTime = frameTime;
+    else
+        m_averageTime += (frameTime - m_averageTime) * AverageWeight;
+
+    if (++m_samples < AdjustInterval)
+        return;
+
+    m_samples = 0;
+    if (m_averageTime <= 0.0f)
+        return;
+
+    bool overBudget = m_averageTime > m_targetTime;
+    bool underBudget = m_averageTime < m_targetTime * RaiseThreshold;
+    if (!overBudget && !underBudget)
+        return;
+
+    if (overBudget && m_scale <= m_minScale && m_detailReduction < m_maxDetailReduction)
+    {
+        ++m_detailReduction;
+        m_averageTime = -1.0f;
+        return;
+    }
+
+    if (underBudget && m_detailReduction > 0)
+    {
+        --m_detailReduction;
+        m_averageTime = -1.0f;
+        return;
+    }
+
+    // The cost of a frame grows with the number of pixels, that is with the
+    // square of the scale
+    float scale = m_scale * std::sqrt(m_targetTime * TargetLoad / m_averageTime);
+    scale = std::min(scale, m_scale + MaxScaleIncrease);
+    // Round down so that a frame just over budget still lowers the scale
+    scale = std::floor(scale / ScaleStep + 0.001f) * ScaleStep;
+    scale = std::clamp(scale, m_minScale, m_maxScale);
+    if (scale == m_scale)
+        return;
+
+    m_scale = scale;
+    // Frames at the old scale say little about the new one
+    m_averageTime = -1.0f;
+}
+
+} // end namespace celestia
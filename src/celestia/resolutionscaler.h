@@ -0,0 +1,86 @@
+// resolutionscaler.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Adapts the resolution and the detail of the scene to the frame time.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+#include <celengine/glsupport.h>
+
+namespace celestia
+{
+
+// Picks the fraction of the window resolution that the views are rendered
+// at so that drawing them takes about the time allotted to a frame. The cost
+// of a frame is the GPU time between beginFrame() and endFrame() where timer
+// queries are available, and the CPU time spent between them otherwise.
+//
+// The scale is only changed every few frames and in fixed steps, since each
+// change reallocates the view framebuffers. It is lowered as soon as frames
+// run over budget, but only raised again when they are comfortably within
+// it, so that it doesn't flip between two steps.
+//
+// Frames that are over budget at the minimum scale reduce the detail by a
+// step, up to maxDetailReduction steps, and the detail is restored before
+// the scale is raised again.
+class ResolutionScaler
+{
+public:
+    ResolutionScaler(float targetFrameRate, float minScale, float maxScale,
+                     unsigned int maxDetailReduction = 0);
+    ~ResolutionScaler();
+
+    ResolutionScaler(const ResolutionScaler&) = delete;
+    ResolutionScaler& operator=(const ResolutionScaler&) = delete;
+
+    void beginFrame();
+    void endFrame();
+
+    float getScale() const { return m_scale; }
+    unsigned int getDetailReduction() const { return m_detailReduction; }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    // Number of frames that are in flight before their queries are read
+    static constexpr std::size_t FrameLatency = 3;
+
+    struct FrameQueries
+    {
+        std::array<GLuint, 2> queries{};
+        bool pending{ false };
+    };
+
+    void collectGPUTime(FrameQueries&);
+    void addSample(float frameTime);
+
+    float m_targetTime;
+    float m_minScale;
+    float m_maxScale;
+    float m_scale;
+    unsigned int m_maxDetailReduction;
+    unsigned int m_detailReduction{ 0 };
+
+    // Frame time in milliseconds averaged since the last adjustment, or
+    // negative if no frame has been measured yet
+    float m_averageTime{ -1.0f };
+    int m_samples{ 0 };
+
+    bool m_hasTimerQuery{ false };
+    bool m_inFrame{ false };
+    std::size_t m_frameIndex{ 0 };
+    std::array<FrameQueries, FrameLatency> m_frames;
+    clock::time_point m_frameStart;
+};
+
+} // end namespace celestia
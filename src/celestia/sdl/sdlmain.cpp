@@ -14,6 +14,7 @@
 #include <string_view>
 #include <system_error>
 #include <fmt/format.h>
+#include <celcompat/charconv.h>
 #include <celcompat/filesystem.h>
 #include <celengine/glsupport.h>
 #include <celestia/celestiacore.h>
@@ -21,6 +22,7 @@
 #include <celestia/url.h>
 #include <celutil/gettext.h>
 #include <celutil/localeutil.h>
+#include <celutil/logger.h>
 #include <celutil/tzutil.h>
 #include <SDL.h>
 #ifdef GL_ES
@@ -38,6 +40,27 @@ namespace celestia::sdl
 namespace
 {
 
+using namespace std::string_view_literals;
+
+// Longest time spent waiting for the resources of an offline frame
+constexpr double OfflineLoadTimeout = 60.0;
+
+// Renders a script frame by frame into numbered images instead of running
+// interactively. Frames are numbered from the start of the script, so
+// that a sequence can be split into ranges rendered by separate processes:
+// each one runs the script from its start but only draws its own frames.
+struct OfflineOptions
+{
+    fs::path script;
+    fs::path outputDir;
+    int width{ 1920 };
+    int height{ 1080 };
+    double frameRate{ 30.0 };
+    int firstFrame{ 0 };
+    // Number of frames to render, or all until the script ends if negative
+    int frameCount{ -1 };
+};
+
 class SDL_Alerter : public CelestiaCore::Alerter
 {
     SDL_Window* window { nullptr };
@@ -80,10 +103,13 @@ class SDL_Application
 
     static std::shared_ptr<SDL_Application> init(std::string_view, int, int);
 
-    bool createOpenGLWindow();
+    // Offline windows keep their size and aren't synchronized to the
+    // display
+    bool createOpenGLWindow(bool offline = false);
 
     bool initCelestiaCore();
     void run();
+    int runOffline(const OfflineOptions&);
     EventHandleResult handleEvent();
     RunLoopState update();
     std::string_view getError() const;
@@ -151,14 +177,18 @@ SDL_Application::~SDL_Application()
 }
 
 bool
-SDL_Application::createOpenGLWindow()
+SDL_Application::createOpenGLWindow(bool offline)
 {
+    Uint32 flags = SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN;
+    if (!offline)
+        flags |= SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI;
+
     m_mainWindow = SDL_CreateWindow(m_appName.c_str(),
                                     SDL_WINDOWPOS_CENTERED,
                                     SDL_WINDOWPOS_CENTERED,
                                     m_windowWidth,
                                     m_windowHeight,
-                                    SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
+                                    flags);
     if (m_mainWindow == nullptr)
         return false;
 
@@ -166,8 +196,11 @@ SDL_Application::createOpenGLWindow()
     if (m_glContext == nullptr)
         return false;
 
-    // First try to enable adaptive sync and then vsync
-    if (SDL_GL_SetSwapInterval(-1) == -1)
+    // Offline frames don't wait for the display; otherwise first try to
+    // enable adaptive sync and then vsync
+    if (offline)
+        SDL_GL_SetSwapInterval(0);
+    else if (SDL_GL_SetSwapInterval(-1) == -1)
         SDL_GL_SetSwapInterval(1);
     return true;
 }
@@ -211,6 +244,7 @@ SDL_Application::configure() const
 
     renderer->setRenderFlags(Renderer::DefaultRenderFlags);
     renderer->setShadowMapSize(config->renderDetails.ShadowMapSize);
+    renderer->setGPUStarRendering(config->renderDetails.gpuStarRendering);
     renderer->setSolarSystemMaxDistance(config->renderDetails.SolarSystemMaxDistance);
 }
 
@@ -290,6 +324,55 @@ SDL_Application::run()
 #endif
 }
 
+int
+SDL_Application::runOffline(const OfflineOptions& options)
+{
+    std::error_code ec;
+    fs::create_directories(options.outputDir, ec);
+    if (ec)
+    {
+        fmt::print(stderr, "Cannot create {}\n", options.outputDir);
+        return 6;
+    }
+
+    m_appCore->initRenderer();
+    configure();
+    m_appCore->setOfflineRendering(true);
+    m_appCore->start();
+
+    SDL_GL_GetDrawableSize(m_mainWindow, &m_windowWidth, &m_windowHeight);
+    m_appCore->resize(m_windowWidth, m_windowHeight);
+
+    // The script should see the same catalogs whichever frame a process
+    // starts at
+    m_appCore->finishBackgroundLoading();
+    m_appCore->runScript(options.script, false);
+
+    const double timeStep = 1.0 / options.frameRate;
+    int endFrame = options.frameCount < 0 ? -1 : options.firstFrame + options.frameCount;
+    for (int frame = 0; m_appCore->isScriptRunning() && frame != endFrame; ++frame)
+    {
+        // Keep the window responsive, but input doesn't steer the render
+        SDL_PumpEvents();
+
+        m_appCore->tick(timeStep);
+        if (frame < options.firstFrame)
+            continue;
+
+        m_appCore->drawUntilLoaded(OfflineLoadTimeout);
+        fs::path filename = options.outputDir / fmt::format("frame_{:06}.png", frame);
+        if (!m_appCore->saveScreenShot(filename))
+        {
+            fmt::print(stderr, "Failed to write {}\n", filename);
+            return 6;
+        }
+        SDL_GL_SwapWindow(m_mainWindow);
+    }
+
+    m_appCore->cancelScript();
+    return 0;
+}
+
 SDL_Application::RunLoopState
 SDL_Application::update()
 {
@@ -656,8 +739,79 @@ DumpGLInfo()
         fmt::print("GLSL Version: {}\n", s);
 }
 
+void
+PrintUsage()
+{
+    fmt::print(stderr,
+               "Usage: celestia-sdl [--render <directory> [options] script]\n"
+               "  --render <directory>  render the script into numbered images and exit\n"
+               "  --size <w>x<h>        frame size (default 1920x1080)\n"
+               "  --fps <rate>          frames per second of simulated time (default 30)\n"
+               "  --first <frame>       first frame to write (default 0)\n"
+               "  --frames <count>      number of frames to write (default: until the script ends)\n");
+}
+
+template<typename T>
+bool
+ParseNumber(std::string_view arg, T& value)
+{
+    auto result = compat::from_chars(arg.data(), arg.data() + arg.size(), value);
+    return result.ec == std::errc{} && result.ptr == arg.data() + arg.size();
+}
+
+bool
+ParseSize(std::string_view arg, int& width, int& height)
+{
+    auto pos = arg.find('x');
+    return pos != std::string_view::npos &&
+           ParseNumber(arg.substr(0, pos), width) &&
+           ParseNumber(arg.substr(pos + 1), height) &&
+           width > 0 && height > 0;
+}
+
+// Returns false on a usage error. Without --render the output directory is
+// left empty and the application runs interactively.
+bool
+ParseOptions(int argc, char** argv, OfflineOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if (arg.empty() || arg[0] != '-')
+        {
+            if (!options.script.empty())
+                return false;
+            options.script = fs::absolute(fs::u8path(arg));
+            continue;
+        }
+
+        if (i + 1 == argc)
+            return false;
+
+        std::string_view value = argv[++i];
+        bool valid = true;
+        if (arg == "--render"sv)
+            options.outputDir = fs::absolute(fs::u8path(value));
+        else if (arg == "--size"sv)
+            valid = ParseSize(value, options.width, options.height);
+        else if (arg == "--fps"sv)
+            valid = ParseNumber(value, options.frameRate) && options.frameRate > 0.0;
+        else if (arg == "--first"sv)
+            valid = ParseNumber(value, options.firstFrame) && options.firstFrame >= 0;
+        else if (arg == "--frames"sv)
+            valid = ParseNumber(value, options.frameCount) && options.frameCount >= 0;
+        else
+            valid = false;
+
+        if (!valid)
+            return false;
+    }
+
+    return options.outputDir.empty() == options.script.empty();
+}
+
 int
-sdlmain(int /* argc */, char ** /* argv */)
+sdlmain(int argc, char **argv)
 {
     CelestiaCore::initLocale();
 
@@ -669,6 +823,14 @@ sdlmain(int /* argc */, char ** /* argv */)
     textdomain("celestia");
 #endif
 
+    OfflineOptions offlineOptions;
+    if (!ParseOptions(argc, argv, offlineOptions))
+    {
+        PrintUsage();
+        return 1;
+    }
+    bool offline = !offlineOptions.outputDir.empty();
+
     const char *dataDir = getenv("CELESTIA_DATA_DIR");
     if (dataDir == nullptr)
         dataDir = CONFIG_DATA_DIR;
@@ -681,7 +843,9 @@ sdlmain(int /* argc */, char ** /* argv */)
         return 1;
     }
 
-    auto app = SDL_Application::init("Celestia", 640, 480);
+    auto app = offline
+        ? SDL_Application::init("Celestia", offlineOptions.width, offlineOptions.height)
+        : SDL_Application::init("Celestia", 640, 480);
     if (app == nullptr)
     {
         FatalError("Could not initialize SDL! Error: {}", SDL_GetError());
@@ -693,7 +857,7 @@ sdlmain(int /* argc */, char ** /* argv */)
         FatalError("Could not initialize Celestia!");
         return 3;
     }
-    if (!app->createOpenGLWindow())
+    if (!app->createOpenGLWindow(offline))
     {
         FatalError("Could not create a OpenGL window! Error: {}", app->getError());
         return 4;
@@ -710,6 +874,9 @@ sdlmain(int /* argc */, char ** /* argv */)
 
     DumpGLInfo();
 
+    if (offline)
+        return app->runOffline(offlineOptions);
+
     app->run();
 
     return 0;
@@ -0,0 +1,245 @@
+// separationfinder.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "separationfinder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celcompat/numbers.h>
+#include <celengine/body.h>
+#include <celengine/bodypositions.h>
+#include <celephem/orbit.h>
+#include <celmath/solve.h>
+
+namespace celestia
+{
+
+namespace
+{
+
+// Samples of the separation per period of the fastest combination of the
+// orbits involved
+constexpr double SamplesPerPeriod = 32.0;
+
+// Search step bounds; the default is used when no object has a known
+// orbital period
+constexpr double MinSearchStep = 1.0 / (24.0 * 60.0); // one minute
+constexpr double MaxSearchStep = 1.0;                 // one day
+constexpr double DefaultSearchStep = 1.0 / 24.0;      // one hour
+
+// Precision of event start and end times
+constexpr double DurationPrecision = 1.0 / (24.0 * 360.0); // ten seconds
+
+// Length of the part of the search between progress updates
+constexpr double ProgressInterval = 10.0; // days
+
+// Events never last longer than this many search steps
+constexpr int MaxEventSteps = 1000;
+
+void
+getPositions(const Selection& sel,
+             const std::vector<double>& times,
+             std::vector<UniversalCoord>& positions)
+{
+    if (const Body* body = sel.body(); body != nullptr)
+    {
+        engine::GetBodyPositions(*body, times, positions);
+        return;
+    }
+
+    positions.clear();
+    for (double t : times)
+        positions.push_back(sel.getPosition(t));
+}
+
+double
+angularRadius(double radius, double distance)
+{
+    return radius < distance ? std::asin(radius / distance) : celestia::numbers::pi * 0.5;
+}
+
+} // end unnamed namespace
+
+SeparationFinder::SeparationFinder(const Selection& observer,
+                                   const Selection& first,
+                                   const Selection& second,
+                                   EclipseFinderWatcher* watcher) :
+    m_observer(observer),
+    m_first(first),
+    m_second(second),
+    m_watcher(watcher)
+{
+}
+
+double
+SeparationFinder::separation(const UniversalCoord& observerPosition,
+                             const UniversalCoord& firstPosition,
+                             const UniversalCoord& secondPosition,
+                             Measure measure) const
+{
+    Eigen::Vector3d toFirst = firstPosition.offsetFromKm(observerPosition);
+    Eigen::Vector3d toSecond = secondPosition.offsetFromKm(observerPosition);
+    double angle = std::atan2(toFirst.cross(toSecond).norm(), toFirst.dot(toSecond));
+    if (measure == Measure::Limbs)
+    {
+        angle -= angularRadius(m_first.radius(), toFirst.norm()) +
+                 angularRadius(m_second.radius(), toSecond.norm());
+    }
+
+    return angle;
+}
+
+double
+SeparationFinder::getSeparation(double t, Measure measure) const
+{
+    return separation(m_observer.getPosition(t), m_first.getPosition(t), m_second.getPosition(t), measure);
+}
+
+// The separation changes fastest when all the orbits involved work
+// together, so the frequencies of all of them are added up. This includes
+// the orbits of the bodies they orbit, e.g. the Earth's orbit for the Moon.
+double
+SeparationFinder::searchStep(double t) const
+{
+    double frequency = 0.0;
+    for (const Selection* sel : { &m_observer, &m_first, &m_second })
+    {
+        for (const Body* body = sel->body(); body != nullptr;)
+        {
+            if (const auto* orbit = body->getOrbit(t); orbit != nullptr)
+            {
+                double period = orbit->getPeriod();
+                if (period > 0.0 && std::isfinite(period))
+                    frequency += 1.0 / period;
+            }
+
+            const PlanetarySystem* system = body->getSystem();
+            body = system == nullptr ? nullptr : system->getPrimaryBody();
+        }
+    }
+
+    if (frequency == 0.0)
+        return DefaultSearchStep;
+
+    return std::clamp(1.0 / (SamplesPerPeriod * frequency), MinSearchStep, MaxSearchStep);
+}
+
+// Find the time the event in progress at t starts (dt < 0) or ends (dt > 0)
+double
+SeparationFinder::findEdge(double t, double dt, double maxSeparation, Measure measure) const
+{
+    auto inEvent = [&](double x) { return getSeparation(x, measure) < maxSeparation; };
+
+    double inside = t;
+    double outside = t + dt;
+    for (int i = 0; i < MaxEventSteps && inEvent(outside); ++i)
+    {
+        inside = outside;
+        outside += dt;
+    }
+
+    // Negative before the edge
+    auto [edge, error] = math::solve_bisection([&](double x) { return (inEvent(x) == (dt > 0.0)) ? -1.0 : 1.0; },
+                                               std::min(inside, outside), std::max(inside, outside),
+                                               DurationPrecision);
+    return edge;
+}
+
+void
+SeparationFinder::findEvents(double startDate,
+                             double endDate,
+                             double maxSeparation,
+                             Measure measure,
+                             std::vector<SeparationEvent>& events) const
+{
+    if (m_observer.empty() || m_first.empty() || m_second.empty())
+        return;
+
+    double step = searchStep(startDate);
+    double lastEventEnd = -std::numeric_limits<double>::infinity();
+
+    auto addEvent = [&](double closestTime)
+    {
+        SeparationEvent event;
+        event.closestTime = closestTime;
+        event.minSeparation = getSeparation(closestTime, measure);
+        event.startTime = findEdge(closestTime, -step, maxSeparation, measure);
+        event.endTime = findEdge(closestTime, step, maxSeparation, measure);
+        lastEventEnd = event.endTime;
+        if (event.startTime <= endDate)
+            events.push_back(event);
+    };
+
+    // The last two samples
+    std::array<double, 2> times{ 0.0, 0.0 };
+    std::array<double, 2> separations{ 0.0, 0.0 };
+
+    std::vector<double> sampleTimes;
+    std::vector<UniversalCoord> observerPositions;
+    std::vector<UniversalCoord> firstPositions;
+    std::vector<UniversalCoord> secondPositions;
+
+    // Sample one step past the end to bracket the minima near it
+    double lastTime = endDate + step;
+    std::size_t sample = 0;
+    for (double chunkStart = startDate; chunkStart <= lastTime; chunkStart += ProgressInterval)
+    {
+        if (m_watcher != nullptr &&
+            m_watcher->eclipseFinderProgressUpdate(std::min(chunkStart, endDate)) == EclipseFinderWatcher::AbortOperation)
+        {
+            return;
+        }
+
+        sampleTimes.clear();
+        for (std::size_t i = sample;; ++i)
+        {
+            double t = startDate + static_cast<double>(i) * step;
+            if (t >= chunkStart + ProgressInterval || t > lastTime)
+                break;
+            sampleTimes.push_back(t);
+        }
+
+        getPositions(m_observer, sampleTimes, observerPositions);
+        getPositions(m_first, sampleTimes, firstPositions);
+        getPositions(m_second, sampleTimes, secondPositions);
+
+        for (std::size_t k = 0; k < sampleTimes.size(); ++k, ++sample)
+        {
+            double t = sampleTimes[k];
+            double s = separation(observerPositions[k], firstPositions[k], secondPositions[k], measure);
+
+            // Event in progress at the start of the search
+            if (sample == 0 && s < maxSeparation)
+                addEvent(t);
+
+            if (sample >= 2 && separations[1] <= separations[0] && separations[1] < s)
+            {
+                auto [closest, error] = math::minimize_golden([&](double x) { return getSeparation(x, measure); },
+                                                              times[0], t,
+                                                              DurationPrecision);
+                if (closest > lastEventEnd && getSeparation(closest, measure) < maxSeparation)
+                    addEvent(closest);
+            }
+
+            times[0] = times[1];
+            separations[0] = separations[1];
+            times[1] = t;
+            separations[1] = s;
+        }
+    }
+}
+
+} // end namespace celestia
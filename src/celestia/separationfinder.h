@@ -0,0 +1,77 @@
+// separationfinder.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Find conjunctions, occultations and transits.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <vector>
+
+#include <celengine/selection.h>
+#include <celengine/univcoord.h>
+#include "eclipsefinder.h"
+
+namespace celestia
+{
+
+// A time span during which two objects appear close together
+struct SeparationEvent
+{
+    double startTime{ 0.0 };
+    double endTime{ 0.0 };
+    // Time and value of the smallest separation, in radians
+    double closestTime{ 0.0 };
+    double minSeparation{ 0.0 };
+};
+
+// Finds the times when the angular separation of two objects as seen from
+// an observer is below a threshold. Measuring the separation between the
+// centers finds conjunctions; between the limbs it is negative as soon as
+// the disks overlap, so a threshold of zero finds occultations and
+// transits. The search works like the one of EclipseFinder: the separation
+// is sampled at steps derived from the orbital periods of the objects, the
+// minima are refined by golden section search and the edges of the events
+// by bisection.
+class SeparationFinder
+{
+public:
+    enum class Measure
+    {
+        Centers,
+        Limbs,
+    };
+
+    SeparationFinder(const Selection& observer,
+                     const Selection& first,
+                     const Selection& second,
+                     EclipseFinderWatcher* watcher = nullptr);
+
+    void findEvents(double startDate,
+                    double endDate,
+                    double maxSeparation,
+                    Measure measure,
+                    std::vector<SeparationEvent>& events) const;
+
+    double getSeparation(double t, Measure measure) const;
+
+private:
+    double searchStep(double t) const;
+    double separation(const UniversalCoord& observerPosition,
+                      const UniversalCoord& firstPosition,
+                      const UniversalCoord& secondPosition,
+                      Measure measure) const;
+    double findEdge(double t, double dt, double maxSeparation, Measure measure) const;
+
+    Selection m_observer;
+    Selection m_first;
+    Selection m_second;
+    EclipseFinderWatcher* m_watcher;
+};
+
+} // end namespace celestia
@@ -0,0 +1,75 @@
+// socketutil.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Portability helpers for the sockets of cluster sync and remote control.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "socketutil.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace celestia
+{
+
+SocketLibrary::SocketLibrary()
+{
+#ifdef _WIN32
+    WSADATA data;
+    m_started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+    m_started = true;
+#endif
+}
+
+SocketLibrary::~SocketLibrary()
+{
+#ifdef _WIN32
+    if (m_started)
+        WSACleanup();
+#endif
+}
+
+void
+closeSocket(SocketHandle handle)
+{
+    if (handle == InvalidSocket)
+        return;
+#ifdef _WIN32
+    closesocket(handle);
+#else
+    close(handle);
+#endif
+}
+
+bool
+setNonBlocking(SocketHandle handle)
+{
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(handle, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(handle, F_GETFL, 0);
+    return flags != -1 && fcntl(handle, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+bool
+wouldBlock()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+} // end namespace celestia
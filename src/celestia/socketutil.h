@@ -0,0 +1,61 @@
+// socketutil.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Portability helpers for the sockets of cluster sync and remote control.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#endif
+
+namespace celestia
+{
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+constexpr SocketHandle InvalidSocket = INVALID_SOCKET;
+#else
+using SocketHandle = int;
+constexpr SocketHandle InvalidSocket = -1;
+#endif
+
+// Keeps Winsock initialized while it exists; elsewhere there is nothing
+// to initialize
+class SocketLibrary
+{
+public:
+    SocketLibrary();
+    ~SocketLibrary();
+
+    SocketLibrary(const SocketLibrary&) = delete;
+    SocketLibrary& operator=(const SocketLibrary&) = delete;
+
+    bool isStarted() const { return m_started; }
+
+private:
+    bool m_started{ false };
+};
+
+// Does nothing for InvalidSocket
+void closeSocket(SocketHandle);
+
+bool setNonBlocking(SocketHandle);
+
+// Whether the last call on a non-blocking socket failed only because it
+// would have blocked
+bool wouldBlock();
+
+} // end namespace celestia
@@ -0,0 +1,144 @@
+// startupprofile.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "startupprofile.h"
+
+#include <fstream>
+#include <iterator>
+
+#include <fmt/format.h>
+
+#include <celutil/logger.h>
+
+namespace celestia
+{
+
+namespace
+{
+
+constexpr double MiB = 1024.0 * 1024.0;
+
+StartupProfile::Phase
+totals(const std::vector<StartupProfile::Phase>& phases)
+{
+    StartupProfile::Phase total{ "total", 0.0, 0.0, 0, 0 };
+    for (const auto& phase : phases)
+    {
+        total.wallTime += phase.wallTime;
+        total.cpuTime += phase.cpuTime;
+        total.bytesRead += phase.bytesRead;
+        total.peakResidentSizeIncrease += phase.peakResidentSizeIncrease;
+    }
+
+    return total;
+}
+
+void
+appendJsonString(std::string& out, std::string_view text)
+{
+    out.push_back('"');
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            out.push_back('\\');
+        if (static_cast<unsigned char>(c) < 0x20)
+            fmt::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<unsigned int>(c));
+        else
+            out.push_back(c);
+    }
+    out.push_back('"');
+}
+
+void
+appendJsonPhase(std::string& out, const StartupProfile::Phase& phase)
+{
+    out.append("{\"name\": ");
+    appendJsonString(out, phase.name);
+    fmt::format_to(std::back_inserter(out),
+                   ", \"wallTime\": {:.6f}, \"cpuTime\": {:.6f}, \"bytesRead\": {}, \"peakRssIncrease\": {}}}",
+                   phase.wallTime,
+                   phase.cpuTime,
+                   phase.bytesRead,
+                   phase.peakResidentSizeIncrease);
+}
+
+} // end unnamed namespace
+
+void
+StartupProfile::beginPhase(std::string_view name)
+{
+    endPhase();
+
+    m_phases.push_back({ std::string(name), 0.0, 0.0, 0, 0 });
+    m_inPhase = true;
+    m_phaseStartStats = util::GetProcessStats();
+    m_phaseStart = clock::now();
+}
+
+void
+StartupProfile::endPhase()
+{
+    if (!m_inPhase)
+        return;
+
+    auto end = clock::now();
+    util::ProcessStats stats = util::GetProcessStats();
+
+    Phase& phase = m_phases.back();
+    phase.wallTime = std::chrono::duration<double>(end - m_phaseStart).count();
+    phase.cpuTime = stats.cpuTime - m_phaseStartStats.cpuTime;
+    phase.bytesRead = stats.bytesRead - m_phaseStartStats.bytesRead;
+    phase.peakResidentSizeIncrease = stats.peakResidentSize - m_phaseStartStats.peakResidentSize;
+    m_inPhase = false;
+}
+
+void
+StartupProfile::log() const
+{
+    std::string text = fmt::format("{:<20} {:>9} {:>9} {:>11} {:>15}\n",
+                                   "Startup phase", "wall (s)", "CPU (s)", "read (MiB)", "peak RSS (MiB)");
+    auto appendRow = [&text](const Phase& phase)
+    {
+        fmt::format_to(std::back_inserter(text), "{:<20} {:>9.3f} {:>9.3f} {:>11.1f} {:>+15.1f}\n",
+                       phase.name,
+                       phase.wallTime,
+                       phase.cpuTime,
+                       static_cast<double>(phase.bytesRead) / MiB,
+                       static_cast<double>(phase.peakResidentSizeIncrease) / MiB);
+    };
+
+    for (const auto& phase : m_phases)
+        appendRow(phase);
+    appendRow(totals(m_phases));
+
+    util::GetLogger()->info("{}", text);
+}
+
+bool
+StartupProfile::writeJson(const fs::path& path) const
+{
+    std::string json = "{\n  \"phases\": [";
+    for (std::size_t i = 0; i < m_phases.size(); ++i)
+    {
+        json.append(i == 0 ? "\n    " : ",\n    ");
+        appendJsonPhase(json, m_phases[i]);
+    }
+    json.append("\n  ],\n  \"total\": ");
+    appendJsonPhase(json, totals(m_phases));
+    json.append("\n}\n");
+
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out.good())
+        return false;
+
+    out << json;
+    return out.good();
+}
+
+} // end namespace celestia
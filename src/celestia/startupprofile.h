@@ -0,0 +1,63 @@
+// startupprofile.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Timing of the phases of startup.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celutil/processstats.h>
+
+namespace celestia
+{
+
+// Records the wall clock time, CPU time, bytes read and growth of the peak
+// resident set size of consecutive phases of startup, so that regressions
+// in loading catalogs show up in the same numbers on every run. The CPU time
+// includes all threads, so it can exceed the wall clock time of phases that
+// load in parallel.
+class StartupProfile
+{
+public:
+    struct Phase
+    {
+        std::string name;
+        double wallTime;
+        double cpuTime;
+        std::uint64_t bytesRead;
+        std::uint64_t peakResidentSizeIncrease;
+    };
+
+    // Ends the current phase, if any, and starts a new one
+    void beginPhase(std::string_view name);
+    void endPhase();
+
+    const std::vector<Phase>& getPhases() const { return m_phases; }
+
+    // Writes a table of the phases to the log
+    void log() const;
+    // Writes the phases and their totals to a JSON file
+    bool writeJson(const fs::path& path) const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    std::vector<Phase> m_phases;
+    bool m_inPhase{ false };
+    clock::time_point m_phaseStart;
+    util::ProcessStats m_phaseStartStats;
+};
+
+} // end namespace celestia
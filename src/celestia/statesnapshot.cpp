@@ -0,0 +1,303 @@
+// statesnapshot.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Fast capture and restore of the simulation state.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "statesnapshot.h"
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include <celengine/render.h>
+#include <celengine/simulation.h>
+#include <celengine/universe.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/r128util.h>
+#include "celestiacore.h"
+
+namespace celestia
+{
+
+namespace
+{
+
+constexpr std::uint32_t Magic = 0x534c4543; // "CELS" read as little-endian
+constexpr std::uint16_t Version = 1;
+
+bool
+isValidCoordSys(std::uint8_t coordSys)
+{
+    switch (coordSys)
+    {
+    case ObserverFrame::Universal:
+    case ObserverFrame::Ecliptical:
+    case ObserverFrame::Equatorial:
+    case ObserverFrame::BodyFixed:
+    case ObserverFrame::PhaseLock:
+    case ObserverFrame::Chase:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool
+writeString(std::ostream &out, const std::string &s)
+{
+    return util::writeLE<std::uint16_t>(out, static_cast<std::uint16_t>(s.size())) &&
+           out.write(s.data(), static_cast<std::streamsize>(s.size())).good();
+}
+
+bool
+readString(std::istream &in, std::string &s)
+{
+    std::uint16_t length;
+    if (!util::readLE<std::uint16_t>(in, length))
+        return false;
+    s.resize(length);
+    return length == 0 || in.read(s.data(), length).good();
+}
+
+// Selections are written as their selection ID; a selection which has no
+// ID cannot be saved
+bool
+writeSelection(std::ostream &out, const Selection &sel)
+{
+    SelectionId id = sel.id();
+    if (id.empty() && !sel.empty())
+        return false;
+    return writeSelectionId(out, id);
+}
+
+// Objects which no longer exist are read as an empty selection; false is
+// only returned if the stream is malformed
+bool
+readSelection(std::istream &in, const Universe &universe, Selection &sel)
+{
+    SelectionId id;
+    if (!readSelectionId(in, id))
+        return false;
+    sel = universe.find(id);
+    return true;
+}
+
+} // end unnamed namespace
+
+StateSnapshot
+StateSnapshot::capture(const CelestiaCore &appCore)
+{
+    const Simulation *sim = appCore.getSimulation();
+    const Renderer *renderer = appCore.getRenderer();
+    const ObserverFrame::SharedConstPtr &frame = sim->getFrame();
+
+    StateSnapshot snapshot;
+    snapshot.m_coordSys = frame->getCoordinateSystem();
+    snapshot.m_refObject = frame->getRefObject();
+    snapshot.m_targetObject = frame->getTargetObject();
+
+    snapshot.m_tdb = sim->getTime();
+    snapshot.m_position = frame->convertFromUniversal(sim->getObserver().getPosition(), snapshot.m_tdb);
+    snapshot.m_orientation = frame->convertFromUniversal(sim->getObserver().getOrientation(), snapshot.m_tdb).cast<float>();
+    snapshot.m_fieldOfView = sim->getActiveObserver()->getFOV();
+
+    snapshot.m_timeScale = sim->getTimeScale();
+    snapshot.m_paused = sim->getPauseState();
+    snapshot.m_lightTimeDelay = appCore.getLightDelayActive();
+
+    snapshot.m_selection = sim->getSelection();
+    snapshot.m_trackedObject = sim->getTrackedObject();
+
+    snapshot.m_renderFlags = renderer->getRenderFlags();
+    snapshot.m_labelMode = renderer->getLabelMode();
+    snapshot.m_orbitMask = static_cast<std::uint32_t>(renderer->getOrbitMask());
+    snapshot.m_faintestVisible = sim->getFaintestVisible();
+
+    snapshot.m_markers = sim->getUniverse()->getMarkers();
+    return snapshot;
+}
+
+void
+StateSnapshot::apply(CelestiaCore &appCore) const
+{
+    Simulation *sim = appCore.getSimulation();
+    Renderer *renderer = appCore.getRenderer();
+
+    // Same order as Url::goTo
+    sim->update(0.0);
+    sim->setFrame(m_coordSys, m_refObject, m_targetObject);
+    sim->getActiveObserver()->setFOV(m_fieldOfView);
+    appCore.setZoomFromFOV();
+    sim->setTimeScale(m_timeScale);
+    sim->setPauseState(m_paused);
+    appCore.setLightDelayActive(m_lightTimeDelay);
+    sim->setSelection(m_selection);
+    if (sim->getTrackedObject() != m_trackedObject)
+        sim->setTrackedObject(m_trackedObject);
+
+    renderer->setRenderFlags(m_renderFlags);
+    renderer->setLabelMode(m_labelMode);
+    renderer->setOrbitMask(static_cast<BodyClassification>(m_orbitMask));
+    sim->setFaintestVisible(m_faintestVisible);
+
+    Universe *universe = sim->getUniverse();
+    universe->unmarkAll();
+    for (const Marker &marker : m_markers)
+    {
+        universe->markObject(marker.object(), marker.representation(), marker.priority(),
+                             marker.occludable(), marker.sizing());
+    }
+
+    sim->setTime(m_tdb);
+    const ObserverFrame::SharedConstPtr &frame = sim->getObserver().getFrame();
+    sim->setObserverPosition(frame->convertToUniversal(m_position, m_tdb));
+    sim->setObserverOrientation(frame->convertToUniversal(m_orientation.cast<double>(), m_tdb).cast<float>());
+}
+
+bool
+StateSnapshot::save(std::ostream &out) const
+{
+    util::writeLE<std::uint32_t>(out, Magic);
+    util::writeLE<std::uint16_t>(out, Version);
+
+    util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(m_coordSys));
+    if (!writeSelection(out, m_refObject) || !writeSelection(out, m_targetObject))
+        return false;
+    util::writeR128(out, m_position.x);
+    util::writeR128(out, m_position.y);
+    util::writeR128(out, m_position.z);
+    for (float c : m_orientation.coeffs())
+        util::writeLE<float>(out, c);
+    util::writeLE<float>(out, m_fieldOfView);
+
+    util::writeLE<double>(out, m_tdb);
+    util::writeLE<double>(out, m_timeScale);
+    util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>((m_paused ? 1 : 0) | (m_lightTimeDelay ? 2 : 0)));
+
+    if (!writeSelection(out, m_selection) || !writeSelection(out, m_trackedObject))
+        return false;
+
+    util::writeLE<std::uint64_t>(out, m_renderFlags);
+    util::writeLE<std::int32_t>(out, m_labelMode);
+    util::writeLE<std::uint32_t>(out, m_orbitMask);
+    util::writeLE<float>(out, m_faintestVisible);
+
+    util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(m_markers.size()));
+    for (const Marker &marker : m_markers)
+    {
+        const MarkerRepresentation &rep = marker.representation();
+        if (!writeSelection(out, marker.object()))
+            return false;
+        util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(rep.symbol()));
+        util::writeLE<float>(out, rep.size());
+        Color color = rep.color();
+        for (float c : { color.red(), color.green(), color.blue(), color.alpha() })
+            util::writeLE<float>(out, c);
+        writeString(out, rep.label());
+        util::writeLE<std::int32_t>(out, marker.priority());
+        util::writeLE<std::uint8_t>(out, marker.occludable() ? 1 : 0);
+        util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(marker.sizing()));
+    }
+
+    return out.good();
+}
+
+std::optional<StateSnapshot>
+StateSnapshot::load(std::istream &in, const Universe &universe)
+{
+    std::uint32_t magic;
+    std::uint16_t version;
+    if (!util::readLE<std::uint32_t>(in, magic) || magic != Magic ||
+        !util::readLE<std::uint16_t>(in, version) || version != Version)
+        return std::nullopt;
+
+    StateSnapshot snapshot;
+
+    std::uint8_t coordSys;
+    if (!util::readLE<std::uint8_t>(in, coordSys) ||
+        !isValidCoordSys(coordSys) ||
+        !readSelection(in, universe, snapshot.m_refObject) ||
+        !readSelection(in, universe, snapshot.m_targetObject) ||
+        !util::readR128(in, snapshot.m_position.x) ||
+        !util::readR128(in, snapshot.m_position.y) ||
+        !util::readR128(in, snapshot.m_position.z))
+        return std::nullopt;
+    snapshot.m_coordSys = static_cast<ObserverFrame::CoordinateSystem>(coordSys);
+
+    for (float &c : snapshot.m_orientation.coeffs())
+    {
+        if (!util::readLE<float>(in, c))
+            return std::nullopt;
+    }
+
+    std::uint8_t timeFlags;
+    std::int32_t labelMode;
+    if (!util::readLE<float>(in, snapshot.m_fieldOfView) ||
+        !util::readLE<double>(in, snapshot.m_tdb) ||
+        !util::readLE<double>(in, snapshot.m_timeScale) ||
+        !util::readLE<std::uint8_t>(in, timeFlags) ||
+        !readSelection(in, universe, snapshot.m_selection) ||
+        !readSelection(in, universe, snapshot.m_trackedObject) ||
+        !util::readLE<std::uint64_t>(in, snapshot.m_renderFlags) ||
+        !util::readLE<std::int32_t>(in, labelMode) ||
+        !util::readLE<std::uint32_t>(in, snapshot.m_orbitMask) ||
+        !util::readLE<float>(in, snapshot.m_faintestVisible))
+        return std::nullopt;
+    snapshot.m_paused = (timeFlags & 1) != 0;
+    snapshot.m_lightTimeDelay = (timeFlags & 2) != 0;
+    snapshot.m_labelMode = labelMode;
+
+    std::uint32_t markerCount;
+    if (!util::readLE<std::uint32_t>(in, markerCount))
+        return std::nullopt;
+    for (std::uint32_t i = 0; i < markerCount; ++i)
+    {
+        Selection object;
+        std::uint8_t symbol;
+        float size;
+        float rgba[4];
+        std::string label;
+        std::int32_t priority;
+        std::uint8_t occludable;
+        std::uint8_t sizing;
+        if (!readSelection(in, universe, object) ||
+            !util::readLE<std::uint8_t>(in, symbol) ||
+            symbol > static_cast<std::uint8_t>(MarkerRepresentation::Crosshair) ||
+            !util::readLE<float>(in, size) ||
+            !util::readLE<float>(in, rgba[0]) ||
+            !util::readLE<float>(in, rgba[1]) ||
+            !util::readLE<float>(in, rgba[2]) ||
+            !util::readLE<float>(in, rgba[3]) ||
+            !readString(in, label) ||
+            !util::readLE<std::int32_t>(in, priority) ||
+            !util::readLE<std::uint8_t>(in, occludable) ||
+            !util::readLE<std::uint8_t>(in, sizing) ||
+            sizing > static_cast<std::uint8_t>(DistanceBasedSize))
+            return std::nullopt;
+
+        // Markers of objects that no longer exist are dropped
+        if (object.empty())
+            continue;
+
+        Marker &marker = snapshot.m_markers.emplace_back(object);
+        marker.setRepresentation(MarkerRepresentation(static_cast<MarkerRepresentation::Symbol>(symbol),
+                                                      size,
+                                                      Color(rgba[0], rgba[1], rgba[2], rgba[3]),
+                                                      std::move(label)));
+        marker.setPriority(priority);
+        marker.setOccludable(occludable != 0);
+        marker.setSizing(static_cast<MarkerSizing>(sizing));
+    }
+
+    return snapshot;
+}
+
+} // end namespace celestia
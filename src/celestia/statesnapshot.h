@@ -0,0 +1,79 @@
+// statesnapshot.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Fast capture and restore of the simulation state.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+
+#include <Eigen/Geometry>
+
+#include <celengine/marker.h>
+#include <celengine/observer.h>
+#include <celengine/selection.h>
+#include <celengine/univcoord.h>
+
+class CelestiaCore;
+class Universe;
+
+namespace celestia
+{
+
+/*! A snapshot of the state that a show switches between: the observer
+ *  frame, position, orientation and field of view, the time and time rate,
+ *  the selected and tracked objects, the render, label and orbit flags,
+ *  the limiting magnitude and the markers.
+ *
+ *  Unlike CelestiaState, which is made to be written as a cel URL, objects
+ *  are held as Selections, so capturing and applying a snapshot resolves no
+ *  names. A snapshot can only be applied while the objects it refers to
+ *  exist. save() and load() convert it to a compact binary form, in which
+ *  objects are identified by catalog number, or for solar system objects
+ *  by the position in their planetary systems, so that it can be kept for
+ *  later sessions with the same catalogs.
+ */
+class StateSnapshot
+{
+public:
+    static StateSnapshot capture(const CelestiaCore &appCore);
+    void apply(CelestiaCore &appCore) const;
+
+    bool save(std::ostream &out) const;
+    static std::optional<StateSnapshot> load(std::istream &in, const Universe &universe);
+
+private:
+    // Observer frame, and the position and orientation of the observer
+    // within it
+    ObserverFrame::CoordinateSystem m_coordSys          { ObserverFrame::Universal };
+    Selection                       m_refObject;
+    Selection                       m_targetObject;
+    UniversalCoord                  m_position          { 0.0, 0.0, 0.0 };
+    Eigen::Quaternionf              m_orientation       { Eigen::Quaternionf::Identity() };
+    float                           m_fieldOfView       { 0.0f };
+
+    double                          m_tdb               { 0.0 };
+    double                          m_timeScale         { 1.0 };
+    bool                            m_paused            { false };
+    bool                            m_lightTimeDelay    { false };
+
+    Selection                       m_selection;
+    Selection                       m_trackedObject;
+
+    std::uint64_t                   m_renderFlags       { 0 };
+    int                             m_labelMode         { 0 };
+    std::uint32_t                   m_orbitMask         { 0 };
+    float                           m_faintestVisible   { 0.0f };
+
+    MarkerList                      m_markers;
+};
+
+} // end namespace celestia
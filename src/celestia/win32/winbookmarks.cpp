@@ -1539,6 +1539,10 @@ BuildFavoritesMenu(HMENU menuBar,
     if (favorites == nullptr)
         return;
 
+    // Find the objects of the menu items between the next frames, so that
+    // choosing one doesn't have to search for it
+    appCore->resolveFavorites();
+
     MENUITEMINFO menuInfo;
     menuInfo.cbSize = sizeof(MENUITEMINFO);
     menuInfo.fMask = MIIM_SUBMENU;
@@ -90,6 +90,7 @@ BeginMovieCapture(CelestiaCore* appCore,
         movieCapture->setEncoderOptions(appCore->getConfig()->x264EncoderOptions);
     else
         movieCapture->setEncoderOptions(appCore->getConfig()->ffvhEncoderOptions);
+    movieCapture->setHardwareEncoding(appCore->getConfig()->hardwareVideoEncoding);
 
     bool success = movieCapture->start(filename, width, height, framerate);
     if (success)
@@ -8,14 +8,18 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <array>
 #include <cassert>
 #include <cstring>
 #include <fstream>
 #include <algorithm>
 #include <memory>
+#include <vector>
 #include <celengine/glsupport.h>
+#include <celutil/binarywrite.h>
 #include <celutil/logger.h>
 #include <celutil/bytes.h>
+#include <celutil/threadpool.h>
 #include "dds_decompress.h"
 #include "image.h"
 
@@ -74,7 +78,20 @@ struct DDSurfaceDesc
     std::uint32_t textureStage;
 };
 
-constexpr std::size_t DDS_MAX_BLOCK_SIZE = 16;
+// Header flags written by SaveDDSImage
+constexpr std::uint32_t DDSD_CAPS        = 0x00000001;
+constexpr std::uint32_t DDSD_HEIGHT      = 0x00000002;
+constexpr std::uint32_t DDSD_WIDTH       = 0x00000004;
+constexpr std::uint32_t DDSD_PIXELFORMAT = 0x00001000;
+constexpr std::uint32_t DDSD_MIPMAPCOUNT = 0x00020000;
+constexpr std::uint32_t DDSD_LINEARSIZE  = 0x00080000;
+constexpr std::uint32_t DDPF_FOURCC      = 0x00000004;
+constexpr std::uint32_t DDSCAPS_COMPLEX  = 0x00000008;
+constexpr std::uint32_t DDSCAPS_TEXTURE  = 0x00001000;
+constexpr std::uint32_t DDSCAPS_MIPMAP   = 0x00400000;
+
+// Images with at least this many pixels are decompressed on several threads
+constexpr std::uint32_t ParallelDecompressThreshold = 1024 * 1024;
 
 constexpr std::uint32_t FourCC(const char *s)
 {
@@ -88,9 +105,7 @@ constexpr std::uint32_t FourCC(const char *s)
 std::unique_ptr<std::uint32_t[]>
 DecompressDXTc(std::uint32_t width, std::uint32_t height, PixelFormat format, bool transparent0, std::ifstream &in)
 {
-    // TODO: check with the size of the input data stream if the stream is in fact decompressed
-    // alloc memory
-    int blocksize = 0;
+    std::size_t blocksize = 0;
     switch (format)
     {
     case PixelFormat::DXT1:
@@ -104,39 +119,23 @@ DecompressDXTc(std::uint32_t width, std::uint32_t height, PixelFormat format, bo
         assert(0);
         return nullptr;
     }
-    auto pixels = std::make_unique<std::uint32_t[]>(((width + 3) & ~3) * ((height + 3) & ~3));
-    std::array<std::uint8_t, DDS_MAX_BLOCK_SIZE> block; // enough to hold DXT1/3/5 blocks
-    for (std::uint32_t y = 0; y < height; y += 4)
-    {
-        for (std::uint32_t x = 0; x < width; x += 4)
-        {
-            if (!in.good())
-                return nullptr;
 
-            in.read(reinterpret_cast<char*>(block.data()), blocksize); /* Flawfinder: ignore */
-            switch (format)
-            {
-            case PixelFormat::DXT1:
-                DecompressBlockDXT1(x, y, width, block.data(), transparent0, pixels.get());
-                break;
-            case PixelFormat::DXT3:
-                DecompressBlockDXT3(x, y, width, block.data(), transparent0, pixels.get());
-                break;
-            case PixelFormat::DXT5:
-                DecompressBlockDXT5(x, y, width, block.data(), transparent0, pixels.get());
-                break;
-            default:
-                assert(0);
-                return nullptr;
-            }
-        }
-    }
+    std::vector<std::uint8_t> blocks(static_cast<std::size_t>((width + 3) / 4) * ((height + 3) / 4) * blocksize);
+    if (!in.read(reinterpret_cast<char*>(blocks.data()), blocks.size()).good()) /* Flawfinder: ignore */
+        return nullptr;
+
+    util::ThreadPool* pool = width * height >= ParallelDecompressThreshold
+        ? &util::ThreadPool::shared()
+        : nullptr;
+
+    auto pixels = std::make_unique<std::uint32_t[]>(width * height);
+    DecompressImageDXTc(format, width, height, blocks.data(), transparent0, pixels.get(), pool);
     return pixels;
 }
 
 } // anonymous namespace
 
-Image* LoadDDSImage(const fs::path& filename)
+Image* LoadDDSImage(const fs::path& filename, PixelAllocator* allocator)
 {
     std::ifstream in(filename, std::ios::in | std::ios::binary);
     if (!in.good())
@@ -247,27 +246,10 @@ Image* LoadDDSImage(const fs::path& filename)
         if (!gl::EXT_texture_compression_s3tc)
         {
             // DXTc texture not supported, decompress DXTc to RGB/RGBA
-            std::unique_ptr<std::uint32_t[]>pixels = nullptr;
+            // Blocks on the edges of images with sizes that aren't
+            // multiples of 4 are cropped by the decompressor
             bool transparent0 = format == PixelFormat::DXT1;
-            if ((ddsd.width & 3) != 0 || (ddsd.height & 3) != 0)
-            {
-                std::uint32_t nw = std::max(ddsd.width, 4u);
-                std::uint32_t nh = std::max(ddsd.height, 4u);
-                auto tmp = DecompressDXTc(nw, nh, format, transparent0, in);
-                if (tmp != nullptr)
-                {
-                    pixels = std::make_unique<std::uint32_t[]>(ddsd.width * ddsd.height);
-                    // crop
-                    for (std::uint32_t y = 0; y < ddsd.height; y++)
-                    {
-                        std::memcpy(pixels.get() + y * ddsd.width, tmp.get() + y * nw, ddsd.width * 4);
-                    }
-                }
-            }
-            else
-            {
-                pixels = DecompressDXTc(ddsd.width, ddsd.height, format, transparent0, in);
-            }
+            auto pixels = DecompressDXTc(ddsd.width, ddsd.height, format, transparent0, in);
 
             if (pixels == nullptr)
             {
@@ -288,7 +270,7 @@ Image* LoadDDSImage(const fs::path& filename)
                 }
             }
 
-            Image *img = new Image(transparent0 ? PixelFormat::RGB : PixelFormat::RGBA, ddsd.width, ddsd.height);
+            Image *img = new Image(transparent0 ? PixelFormat::RGB : PixelFormat::RGBA, ddsd.width, ddsd.height, 1, allocator);
             std::memcpy(img->getPixels(), pixels.get(), (transparent0 ? 3 : 4) * ddsd.width * ddsd.height);
             return img;
         }
@@ -300,7 +282,8 @@ Image* LoadDDSImage(const fs::path& filename)
     Image* img = new Image(format,
                            static_cast<int>(ddsd.width),
                            static_cast<int>(ddsd.height),
-                           std::max(ddsd.mipMapLevels, 1u));
+                           std::max(ddsd.mipMapLevels, 1u),
+                           allocator);
     in.read(reinterpret_cast<char*>(img->getPixels()), img->getSize()); /* Flawfinder: ignore */
     if (!in.eof() && !in.good())
     {
@@ -312,4 +295,80 @@ Image* LoadDDSImage(const fs::path& filename)
     return img;
 }
 
+bool SaveDDSImage(const fs::path& filename, const Image& image)
+{
+    const char* fourCC = nullptr;
+    switch (image.getFormat())
+    {
+    case PixelFormat::DXT1:
+    case PixelFormat::DXT1_sRGBA:
+        fourCC = "DXT1";
+        break;
+    case PixelFormat::DXT3:
+    case PixelFormat::DXT3_sRGBA:
+        fourCC = "DXT3";
+        break;
+    case PixelFormat::DXT5:
+    case PixelFormat::DXT5_sRGBA:
+        fourCC = "DXT5";
+        break;
+    default:
+        util::GetLogger()->error("Can only save DXTc compressed images to DDS file {}.\n", filename);
+        return false;
+    }
+
+    std::ofstream out(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.good())
+    {
+        util::GetLogger()->error("Error opening DDS texture file {} for writing.\n", filename);
+        return false;
+    }
+
+    auto mipLevels = static_cast<std::uint32_t>(image.getMipLevelCount());
+    std::uint32_t flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+    std::uint32_t caps = DDSCAPS_TEXTURE;
+    if (mipLevels > 1)
+    {
+        flags |= DDSD_MIPMAPCOUNT;
+        caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+    }
+
+    // Fields in DDSurfaceDesc order; the color keys, the unused pixel
+    // format fields and the texture stage are left zero
+    const std::array<std::uint32_t, 31> header
+    {
+        sizeof(DDSurfaceDesc),
+        flags,
+        static_cast<std::uint32_t>(image.getHeight()),
+        static_cast<std::uint32_t>(image.getWidth()),
+        static_cast<std::uint32_t>(image.getMipLevelSize(0)),
+        0, // depth
+        mipLevels,
+        0, 0, 0, // alphaBitDepth, reserved, surface
+        0, 0, 0, 0, 0, 0, 0, 0, // color keys
+        sizeof(DDPixelFormat),
+        DDPF_FOURCC,
+        FourCC(fourCC),
+        0, 0, 0, 0, 0, // bpp and masks
+        caps,
+        0, 0, 0, // caps2-4
+        0, // textureStage
+    };
+    static_assert(sizeof(header) == sizeof(DDSurfaceDesc));
+
+    out.write("DDS ", 4);
+    for (std::uint32_t value : header)
+        util::writeLE<std::uint32_t>(out, value);
+    for (int mip = 0; mip < image.getMipLevelCount(); ++mip)
+        out.write(reinterpret_cast<const char*>(image.getMipLevel(mip)), image.getMipLevelSize(mip)); //NOSONAR
+
+    if (!out.flush().good())
+    {
+        util::GetLogger()->error("Error writing DDS texture file {}.\n", filename);
+        return false;
+    }
+
+    return true;
+}
+
 } // namespace celestia::engine
@@ -1,5 +1,16 @@
+#include <algorithm>
 #include <array>
+#include <cassert>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DXT_USE_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define DXT_USE_NEON
+#endif
+
+#include <celutil/threadpool.h>
 #include "dds_decompress.h"
 
 /*
@@ -174,6 +185,209 @@ void DecompressBlockDXT1Internal(const std::uint8_t* block,
     }
 }
 
+// Four pixels of a block row, one per lane
+#if defined(DXT_USE_SSE2)
+using Lanes = __m128i;
+
+inline Lanes splat(std::uint32_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+inline Lanes load(const std::uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline void store(std::uint32_t* p, Lanes v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+inline Lanes bitAnd(Lanes a, Lanes b) { return _mm_and_si128(a, b); }
+inline Lanes bitOr(Lanes a, Lanes b) { return _mm_or_si128(a, b); }
+// Lanes of v where mask is clear
+inline Lanes bitClear(Lanes v, Lanes mask) { return _mm_andnot_si128(mask, v); }
+inline Lanes equal(Lanes a, Lanes b) { return _mm_cmpeq_epi32(a, b); }
+#elif defined(DXT_USE_NEON)
+using Lanes = uint32x4_t;
+
+inline Lanes splat(std::uint32_t v) { return vdupq_n_u32(v); }
+inline Lanes load(const std::uint32_t* p) { return vld1q_u32(p); }
+inline void store(std::uint32_t* p, Lanes v) { vst1q_u32(p, v); }
+inline Lanes bitAnd(Lanes a, Lanes b) { return vandq_u32(a, b); }
+inline Lanes bitOr(Lanes a, Lanes b) { return vorrq_u32(a, b); }
+inline Lanes bitClear(Lanes v, Lanes mask) { return vbicq_u32(v, mask); }
+inline Lanes equal(Lanes a, Lanes b) { return vceqq_u32(a, b); }
+#else
+struct Lanes
+{
+    std::array<std::uint32_t, 4> v;
+};
+
+template<typename F>
+inline Lanes apply(Lanes a, Lanes b, F f)
+{
+    for (std::size_t i = 0; i < 4; ++i)
+        a.v[i] = f(a.v[i], b.v[i]);
+    return a;
+}
+
+inline Lanes splat(std::uint32_t v) { return Lanes{ { v, v, v, v } }; }
+inline Lanes load(const std::uint32_t* p) { return Lanes{ { p[0], p[1], p[2], p[3] } }; }
+inline void store(std::uint32_t* p, Lanes v) { std::copy(v.v.begin(), v.v.end(), p); }
+inline Lanes bitAnd(Lanes a, Lanes b) { return apply(a, b, [](auto x, auto y) { return x & y; }); }
+inline Lanes bitOr(Lanes a, Lanes b) { return apply(a, b, [](auto x, auto y) { return x | y; }); }
+inline Lanes bitClear(Lanes v, Lanes mask) { return apply(v, mask, [](auto x, auto y) { return x & ~y; }); }
+inline Lanes equal(Lanes a, Lanes b) { return apply(a, b, [](auto x, auto y) { return x == y ? ~0u : 0u; }); }
+#endif
+
+constexpr std::uint32_t TransparentBlack = PackRGBA(0, 0, 0, 0xff);
+
+inline std::uint16_t ReadLE16(const std::uint8_t* p)
+{
+    return static_cast<std::uint16_t>(p[0] | p[1] << 8);
+}
+
+inline std::uint32_t ReadLE32(const std::uint8_t* p)
+{
+    return static_cast<std::uint32_t>(ReadLE16(p)) | static_cast<std::uint32_t>(ReadLE16(p + 2)) << 16;
+}
+
+// Picks palette[index] for each lane, where the index for lane i is stored in
+// bits [i * Bits, (i + 1) * Bits) of indices. Comparing against the index
+// shifted into place avoids per lane shifts, which SSE2 lacks.
+template<unsigned int Bits>
+Lanes SelectLanes(std::uint32_t indices, const std::array<std::uint32_t, 1u << Bits>& palette)
+{
+    constexpr std::uint32_t mask = (1u << Bits) - 1;
+    const std::array<std::uint32_t, 4> laneMasks{ mask, mask << Bits, mask << (2 * Bits), mask << (3 * Bits) };
+
+    Lanes values = bitAnd(splat(indices), load(laneMasks.data()));
+    Lanes result = splat(0);
+    for (std::uint32_t k = 0; k <= mask; ++k)
+    {
+        const std::array<std::uint32_t, 4> keys{ k, k << Bits, k << (2 * Bits), k << (3 * Bits) };
+        result = bitOr(result, bitAnd(equal(values, load(keys.data())), splat(palette[k])));
+    }
+
+    return result;
+}
+
+// The four colors a block selects from, computed like DecompressBlockDXT1Internal.
+// DXT5 blocks always use four colors.
+std::array<std::uint32_t, 4> ColorPalette(const std::uint8_t* block, bool allowThreeColors, std::uint8_t alpha)
+{
+    std::uint16_t color0 = ReadLE16(block);
+    std::uint16_t color1 = ReadLE16(block + 2);
+
+    std::uint32_t temp = (color0 >> 11) * 255 + 16;
+    auto r0 = static_cast<std::uint8_t>((temp / 32 + temp) / 32);
+    temp = ((color0 & 0x07E0) >> 5) * 255 + 32;
+    auto g0 = static_cast<std::uint8_t>((temp / 64 + temp) / 64);
+    temp = (color0 & 0x001F) * 255 + 16;
+    auto b0 = static_cast<std::uint8_t>((temp / 32 + temp) / 32);
+
+    temp = (color1 >> 11) * 255 + 16;
+    auto r1 = static_cast<std::uint8_t>((temp / 32 + temp) / 32);
+    temp = ((color1 & 0x07E0) >> 5) * 255 + 32;
+    auto g1 = static_cast<std::uint8_t>((temp / 64 + temp) / 64);
+    temp = (color1 & 0x001F) * 255 + 16;
+    auto b1 = static_cast<std::uint8_t>((temp / 32 + temp) / 32);
+
+    std::array<std::uint32_t, 4> palette;
+    palette[0] = PackRGBA(r0, g0, b0, alpha);
+    palette[1] = PackRGBA(r1, g1, b1, alpha);
+    if (!allowThreeColors || color0 > color1)
+    {
+        palette[2] = PackRGBA((2 * r0 + r1) / 3, (2 * g0 + g1) / 3, (2 * b0 + b1) / 3, alpha);
+        palette[3] = PackRGBA((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3, (b0 + 2 * b1) / 3, alpha);
+    }
+    else
+    {
+        palette[2] = PackRGBA((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, alpha);
+        palette[3] = PackRGBA(0, 0, 0, alpha);
+    }
+
+    return palette;
+}
+
+// The eight alpha values of a DXT5 block, shifted into the alpha byte
+std::array<std::uint32_t, 8> AlphaPalette(std::uint8_t alpha0, std::uint8_t alpha1)
+{
+    std::array<std::uint32_t, 8> palette;
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    for (int code = 2; code < 8; ++code)
+    {
+        if (alpha0 > alpha1)
+            palette[code] = ((8 - code) * alpha0 + (code - 1) * alpha1) / 7;
+        else if (code < 6)
+            palette[code] = ((6 - code) * alpha0 + (code - 1) * alpha1) / 5;
+        else
+            palette[code] = code == 6 ? 0 : 255;
+    }
+
+    for (std::uint32_t& alpha : palette)
+        alpha <<= 24;
+    return palette;
+}
+
+// Decodes a block into the top left columns x rows pixels of output
+void DecodeBlock(PixelFormat format,
+                 const std::uint8_t* block,
+                 bool transparent0,
+                 std::uint32_t* output,
+                 std::uint32_t stride,
+                 std::uint32_t columns,
+                 std::uint32_t rows)
+{
+    const std::uint8_t* colorBlock = format == PixelFormat::DXT1 ? block : block + 8;
+    auto colors = ColorPalette(colorBlock,
+                               format != PixelFormat::DXT5,
+                               format == PixelFormat::DXT1 ? 0xff : 0);
+    std::uint32_t colorCodes = ReadLE32(colorBlock + 4);
+
+    std::array<std::uint32_t, 8> alphas{};
+    std::uint64_t alphaCodes = 0;
+    if (format == PixelFormat::DXT5)
+    {
+        alphas = AlphaPalette(block[0], block[1]);
+        alphaCodes = static_cast<std::uint64_t>(ReadLE16(block + 2)) |
+                     static_cast<std::uint64_t>(ReadLE32(block + 4)) << 16;
+    }
+
+    // The block decoders ignore transparent0 for DXT5
+    transparent0 = transparent0 && format != PixelFormat::DXT5;
+
+    for (std::uint32_t j = 0; j < rows; ++j)
+    {
+        Lanes pixels = SelectLanes<2>((colorCodes >> (8 * j)) & 0xff, colors);
+        if (format == PixelFormat::DXT3)
+        {
+            std::uint16_t row = ReadLE16(block + 2 * j);
+            const std::array<std::uint32_t, 4> rowAlphas
+            {
+                ((row >> 0) & 0xfu) * 17 << 24,
+                ((row >> 4) & 0xfu) * 17 << 24,
+                ((row >> 8) & 0xfu) * 17 << 24,
+                ((row >> 12) & 0xfu) * 17 << 24,
+            };
+            pixels = bitOr(pixels, load(rowAlphas.data()));
+        }
+        else if (format == PixelFormat::DXT5)
+        {
+            pixels = bitOr(pixels, SelectLanes<3>(static_cast<std::uint32_t>(alphaCodes >> (12 * j)) & 0xfff, alphas));
+        }
+
+        if (transparent0)
+            pixels = bitClear(pixels, equal(pixels, splat(TransparentBlack)));
+
+        if (columns == 4)
+        {
+            store(output + j * stride, pixels);
+        }
+        else
+        {
+            std::array<std::uint32_t, 4> row;
+            store(row.data(), pixels);
+            std::copy_n(row.begin(), columns, output + j * stride);
+        }
+    }
+}
+
+// Rows of blocks handed out to each thread, more than one so that threads
+// finishing early can pick up the remaining work
+constexpr std::size_t BandsPerThread = 4;
+
 } // namespace
 
 void DecompressBlockDXT1(std::uint32_t x,
@@ -336,4 +550,49 @@ void DecompressBlockDXT3(std::uint32_t x,
                                 alphaValues.data());
 }
 
+void DecompressImageDXTc(PixelFormat format,
+                         std::uint32_t width,
+                         std::uint32_t height,
+                         const std::uint8_t* blocks,
+                         bool transparent0,
+                         std::uint32_t* image,
+                         util::ThreadPool* pool)
+{
+    assert(format == PixelFormat::DXT1 || format == PixelFormat::DXT3 || format == PixelFormat::DXT5);
+
+    const std::size_t blockSize = format == PixelFormat::DXT1 ? 8 : 16;
+    const std::uint32_t blocksWide = (width + 3) / 4;
+    const std::uint32_t blockRows = (height + 3) / 4;
+
+    auto decodeRows = [&](std::uint32_t firstRow, std::uint32_t lastRow)
+    {
+        for (std::uint32_t by = firstRow; by < lastRow; ++by)
+        {
+            const std::uint8_t* block = blocks + static_cast<std::size_t>(by) * blocksWide * blockSize;
+            std::uint32_t y = by * 4;
+            std::uint32_t rows = std::min(height - y, 4u);
+            for (std::uint32_t x = 0; x < width; x += 4, block += blockSize)
+            {
+                DecodeBlock(format, block, transparent0,
+                            image + x + static_cast<std::size_t>(y) * width, width,
+                            std::min(width - x, 4u), rows);
+            }
+        }
+    };
+
+    if (pool == nullptr || pool->concurrency() == 1 || blockRows < 2)
+    {
+        decodeRows(0, blockRows);
+        return;
+    }
+
+    std::size_t bands = std::min<std::size_t>(blockRows, pool->concurrency() * BandsPerThread);
+    pool->parallelFor(bands,
+                      [&](std::size_t band, unsigned int /* worker */)
+                      {
+                          decodeRows(static_cast<std::uint32_t>(blockRows * band / bands),
+                                     static_cast<std::uint32_t>(blockRows * (band + 1) / bands));
+                      });
+}
+
 } // namespace celestia::engine
@@ -3,6 +3,13 @@
 #include <cstddef>
 #include <cstdint>
 
+#include "pixelformat.h"
+
+namespace celestia::util
+{
+class ThreadPool;
+}
+
 namespace celestia::engine
 {
 
@@ -48,4 +55,20 @@ void DecompressBlockDXT5(std::uint32_t x, std::uint32_t y, std::uint32_t width,
                          const std::uint8_t *blockStorage, bool transparent0,
                          std::uint32_t *image);
 
+/**
+ * @brief Decompresses a whole DXT1, DXT3 or DXT5 image.
+ * Produces the same pixels as the block functions above, but decodes each block row with SIMD instructions where
+ * available. Blocks extending past the right or bottom edge of the image are clipped.
+ *
+ * @param format - DXT1, DXT3 or DXT5.
+ * @param width - width of the texture being decompressed.
+ * @param height - height of the texture being decompressed.
+ * @param blocks - the ((width + 3) / 4) * ((height + 3) / 4) blocks of the texture in row order.
+ * @param image - pointer to width * height pixels where the decompressed pixel data should be stored.
+ * @param pool - if not null, rows of blocks are decompressed in parallel on this pool.
+*/
+void DecompressImageDXTc(PixelFormat format, std::uint32_t width, std::uint32_t height,
+                         const std::uint8_t *blocks, bool transparent0,
+                         std::uint32_t *image, util::ThreadPool *pool = nullptr);
+
 } // namespace celestia::engine
@@ -12,11 +12,14 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <tuple>
 
 #include <celutil/filetype.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/threadpool.h>
 #include "imageformats.h"
 
 namespace celestia::engine
@@ -24,6 +27,11 @@ namespace celestia::engine
 namespace
 {
 
+// Images with at least this many pixels are processed on several threads
+constexpr std::int64_t ParallelThreshold = 1024 * 1024;
+// Split the rows in more bands than threads to even out the load
+constexpr std::size_t BandsPerThread = 4;
+
 // All rows are padded to a size that's a multiple of 4 bytes
 int
 pad(int n)
@@ -55,11 +63,19 @@ formatComponents(PixelFormat fmt)
     // Compressed formats
     case PixelFormat::DXT1:
     case PixelFormat::DXT1_sRGBA:
+    case PixelFormat::ETC2_RGB8:
+    case PixelFormat::ETC2_sRGB8:
         return 3;
     case PixelFormat::DXT3:
     case PixelFormat::DXT3_sRGBA:
     case PixelFormat::DXT5:
     case PixelFormat::DXT5_sRGBA:
+    case PixelFormat::BC7:
+    case PixelFormat::BC7_sRGBA:
+    case PixelFormat::ETC2_RGBA8:
+    case PixelFormat::ETC2_sRGBA8:
+    case PixelFormat::ASTC_4x4:
+    case PixelFormat::ASTC_4x4_sRGBA:
         return 4;
 
     // Unknown format
@@ -78,12 +94,20 @@ calcMipLevelSize(PixelFormat fmt, int w, int h, int mip)
     {
     case PixelFormat::DXT1:
     case PixelFormat::DXT1_sRGBA:
+    case PixelFormat::ETC2_RGB8:
+    case PixelFormat::ETC2_sRGB8:
         // 4x4 blocks, 8 bytes per block
         return ((w + 3) / 4) * ((h + 3) / 4) * 8;
     case PixelFormat::DXT3:
     case PixelFormat::DXT3_sRGBA:
     case PixelFormat::DXT5:
     case PixelFormat::DXT5_sRGBA:
+    case PixelFormat::BC7:
+    case PixelFormat::BC7_sRGBA:
+    case PixelFormat::ETC2_RGBA8:
+    case PixelFormat::ETC2_sRGBA8:
+    case PixelFormat::ASTC_4x4:
+    case PixelFormat::ASTC_4x4_sRGBA:
         // 4x4 blocks, 16 bytes per block
         return ((w + 3) / 4) * ((h + 3) / 4) * 16;
     default:
@@ -124,6 +148,14 @@ getLinearFormat(PixelFormat format)
         return PixelFormat::DXT3;
     case PixelFormat::DXT5_sRGBA:
         return PixelFormat::DXT5;
+    case PixelFormat::BC7_sRGBA:
+        return PixelFormat::BC7;
+    case PixelFormat::ETC2_sRGB8:
+        return PixelFormat::ETC2_RGB8;
+    case PixelFormat::ETC2_sRGBA8:
+        return PixelFormat::ETC2_RGBA8;
+    case PixelFormat::ASTC_4x4_sRGBA:
+        return PixelFormat::ASTC_4x4;
     default:
         return format;
     }
@@ -140,9 +172,70 @@ handleEdge(int i, int size, bool wrap)
     return {1, 0};
 }
 
+// Calls func(firstRow, lastRow) for bands of rows covering [0, rows), on
+// the shared thread pool if the image is large
+template<typename F>
+void
+forEachRowBand(int rows, int width, const F& func)
+{
+    if (rows < 2 || static_cast<std::int64_t>(rows) * width < ParallelThreshold)
+    {
+        func(0, rows);
+        return;
+    }
+
+    util::ThreadPool& pool = util::ThreadPool::shared();
+    std::size_t bands = std::min(static_cast<std::size_t>(rows), pool.concurrency() * BandsPerThread);
+    pool.parallelFor(bands,
+                     [&](std::size_t band, unsigned int /* worker */)
+                     {
+                         func(static_cast<int>(rows * band / bands),
+                              static_cast<int>(rows * (band + 1) / bands));
+                     });
+}
+
+inline void
+writeNormal(std::uint8_t* n, int h00, int h10, int h01, float scale)
+{
+    auto dx = static_cast<float>(h10 - h00) * (1.0f / 255.0f) * scale;
+    auto dy = static_cast<float>(h01 - h00) * (1.0f / 255.0f) * scale;
+
+    float rmag = 1.0f / std::sqrt(dx * dx + dy * dy + 1.0f);
+
+    n[0] = static_cast<std::uint8_t>(128 + 127 * dx * rmag);
+    n[1] = static_cast<std::uint8_t>(128 + 127 * dy * rmag);
+    n[2] = static_cast<std::uint8_t>(128 + 127 * rmag);
+    n[3] = 255;
+}
+
+// Halves rows [firstRow, lastRow) of the destination with a box filter;
+// odd source sizes repeat the last row or column.
+void
+downsampleRows(const std::uint8_t* src, int srcWidth, int srcHeight, int srcPitch,
+               std::uint8_t* dst, int dstWidth, int dstPitch,
+               int components, int firstRow, int lastRow)
+{
+    for (int y = firstRow; y < lastRow; ++y)
+    {
+        const std::uint8_t* row0 = src + std::min(y * 2, srcHeight - 1) * srcPitch;
+        const std::uint8_t* row1 = src + std::min(y * 2 + 1, srcHeight - 1) * srcPitch;
+        std::uint8_t* out = dst + y * dstPitch;
+        for (int x = 0; x < dstWidth; ++x)
+        {
+            int x0 = std::min(x * 2, srcWidth - 1) * components;
+            int x1 = std::min(x * 2 + 1, srcWidth - 1) * components;
+            for (int c = 0; c < components; ++c)
+            {
+                int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                out[x * components + c] = static_cast<std::uint8_t>((sum + 2) / 4);
+            }
+        }
+    }
+}
+
 } // anonymous namespace
 
-Image::Image(PixelFormat fmt, int w, int h, int mip) :
+Image::Image(PixelFormat fmt, int w, int h, int mip, PixelAllocator* allocator) :
     width(w),
     height(h),
     mipLevels(mip),
@@ -153,7 +246,31 @@ Image::Image(PixelFormat fmt, int w, int h, int mip) :
     assert(components != 0);
 
     pitch = pad(w * components);
-    pixels = std::make_unique<std::uint8_t[]>(size);
+    if (allocator != nullptr)
+    {
+        // Memory from the allocator is left uninitialized, the loaders
+        // overwrite it anyway
+        if (std::uint8_t* p = allocator->allocate(static_cast<std::size_t>(size)); p != nullptr)
+            pixels = std::unique_ptr<std::uint8_t[], PixelDeleter>(p, PixelDeleter{ allocator });
+    }
+
+    if (pixels == nullptr)
+        pixels = std::unique_ptr<std::uint8_t[], PixelDeleter>(new std::uint8_t[size]());
+}
+
+void
+PixelDeleter::operator()(std::uint8_t* p) const
+{
+    if (allocator != nullptr)
+        allocator->release(p);
+    else
+        delete[] p;
+}
+
+PixelAllocator*
+Image::getAllocator() const
+{
+    return pixels.get_deleter().allocator;
 }
 
 bool
@@ -281,6 +398,14 @@ Image::isCompressed() const
     case PixelFormat::DXT1_sRGBA:
     case PixelFormat::DXT3_sRGBA:
     case PixelFormat::DXT5_sRGBA:
+    case PixelFormat::BC7:
+    case PixelFormat::BC7_sRGBA:
+    case PixelFormat::ETC2_RGB8:
+    case PixelFormat::ETC2_sRGB8:
+    case PixelFormat::ETC2_RGBA8:
+    case PixelFormat::ETC2_sRGBA8:
+    case PixelFormat::ASTC_4x4:
+    case PixelFormat::ASTC_4x4_sRGBA:
         return true;
     default:
         return false;
@@ -296,6 +421,12 @@ Image::hasAlpha() const
     case PixelFormat::DXT3_sRGBA:
     case PixelFormat::DXT5:
     case PixelFormat::DXT5_sRGBA:
+    case PixelFormat::BC7:
+    case PixelFormat::BC7_sRGBA:
+    case PixelFormat::ETC2_RGBA8:
+    case PixelFormat::ETC2_sRGBA8:
+    case PixelFormat::ASTC_4x4:
+    case PixelFormat::ASTC_4x4_sRGBA:
     case PixelFormat::RGBA:
     case PixelFormat::BGRA:
     case PixelFormat::LumAlpha:
@@ -326,33 +457,70 @@ Image::computeNormalMap(float scale, bool wrap) const
     std::uint8_t* nmPixels = normalMap->getPixels();
     int nmPitch = normalMap->getPitch();
 
-    // Compute normals using differences between adjacent texels.
-    for (int i = 0; i < height; i++)
+    // Compute normals using differences between adjacent texels. Only the
+    // first column needs edge handling, which keeps the inner loop free of
+    // branches so that the compiler can vectorize it.
+    forEachRowBand(height, width, [&](int firstRow, int lastRow)
     {
-        const auto rowBase = i * nmPitch;
-        const auto [i0, i1] = handleEdge(i, height, wrap);
-        for (int j = 0; j < width; j++)
+        const auto [j0, j1] = handleEdge(0, width, wrap);
+        for (int i = firstRow; i < lastRow; i++)
         {
-            const auto [j0, j1] = handleEdge(j, width, wrap);
+            const auto [i0, i1] = handleEdge(i, height, wrap);
+            const std::uint8_t* row0 = pixels.get() + i0 * pitch;
+            const std::uint8_t* row1 = pixels.get() + i1 * pitch;
+            std::uint8_t* out = nmPixels + i * nmPitch;
+
+            writeNormal(out, row0[j0 * components], row0[j1 * components], row1[j0 * components], scale);
+            for (int j = 1; j < width; j++)
+            {
+                writeNormal(out + j * 4,
+                            row0[j * components],
+                            row0[(j - 1) * components],
+                            row1[j * components],
+                            scale);
+            }
+        }
+    });
 
-            auto h00 = static_cast<int>(pixels[i0 * pitch + j0 * components]);
-            auto h10 = static_cast<int>(pixels[i0 * pitch + j1 * components]);
-            auto h01 = static_cast<int>(pixels[i1 * pitch + j0 * components]);
+    return normalMap;
+}
 
-            auto dx = static_cast<float>(h10 - h00) * (1.0f / 255.0f) * scale;
-            auto dy = static_cast<float>(h01 - h00) * (1.0f / 255.0f) * scale;
+/**
+ * Return a copy of the image with a complete set of mipmaps computed with a
+ * box filter, or nullptr for compressed images.  Large images are processed
+ * on several threads.
+ */
+std::unique_ptr<Image>
+Image::computeMipMaps() const
+{
+    if (isCompressed())
+        return nullptr;
 
-            float rmag = 1.0f / std::sqrt(dx * dx + dy * dy + 1.0f);
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+        ++levels;
 
-            int n = rowBase + j * 4;
-            nmPixels[n]     = static_cast<std::uint8_t>(128 + 127 * dx * rmag);
-            nmPixels[n + 1] = static_cast<std::uint8_t>(128 + 127 * dy * rmag);
-            nmPixels[n + 2] = static_cast<std::uint8_t>(128 + 127 * rmag);
-            nmPixels[n + 3] = 255;
-        }
+    auto mipmapped = std::make_unique<Image>(format, width, height, levels);
+    std::memcpy(mipmapped->getPixels(), pixels.get(), getMipLevelSize(0));
+
+    for (int mip = 1; mip < levels; ++mip)
+    {
+        int srcWidth = std::max(width >> (mip - 1), 1);
+        int srcHeight = std::max(height >> (mip - 1), 1);
+        int dstWidth = std::max(width >> mip, 1);
+        int dstHeight = std::max(height >> mip, 1);
+        const std::uint8_t* src = mipmapped->getMipLevel(mip - 1);
+        std::uint8_t* dst = mipmapped->getMipLevel(mip);
+
+        forEachRowBand(dstHeight, dstWidth, [&](int firstRow, int lastRow)
+        {
+            downsampleRows(src, srcWidth, srcHeight, pad(srcWidth * components),
+                           dst, dstWidth, pad(dstWidth * components),
+                           components, firstRow, lastRow);
+        });
     }
 
-    return normalMap;
+    return mipmapped;
 }
 
 void Image::forceLinear()
@@ -378,7 +546,7 @@ bool Image::save(const fs::path &path, ContentType type) const
     }
 }
 
-std::unique_ptr<Image> Image::load(const fs::path& filename)
+std::unique_ptr<Image> Image::load(const fs::path& filename, PixelAllocator* allocator)
 {
     ContentType type = DetermineFileType(filename);
 
@@ -388,13 +556,13 @@ std::unique_ptr<Image> Image::load(const fs::path& filename)
     switch (type)
     {
     case ContentType::JPEG:
-        img = LoadJPEGImage(filename);
+        img = LoadJPEGImage(filename, allocator);
         break;
     case ContentType::BMP:
         img = LoadBMPImage(filename);
         break;
     case ContentType::PNG:
-        img = LoadPNGImage(filename);
+        img = LoadPNGImage(filename, allocator);
         break;
 #ifdef USE_LIBAVIF
     case ContentType::AVIF:
@@ -403,7 +571,10 @@ std::unique_ptr<Image> Image::load(const fs::path& filename)
 #endif
     case ContentType::DDS:
     case ContentType::DXT5NormalMap:
-        img = LoadDDSImage(filename);
+        img = LoadDDSImage(filename, allocator);
+        break;
+    case ContentType::KTX2:
+        img = LoadKTX2Image(filename);
         break;
     default:
         util::GetLogger()->error(_("{}: unrecognized or unsupported image file type.\n"), filename);
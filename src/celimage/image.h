@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 
@@ -20,6 +21,29 @@
 namespace celestia::engine
 {
 
+/**
+ * Supplies the pixel memory of images that should not live on the heap,
+ * such as a mapped buffer that textures are uploaded from.  Both functions
+ * may be called from any thread.
+ */
+class PixelAllocator
+{
+public:
+    virtual ~PixelAllocator() = default;
+
+    // Returns size bytes of memory, or nullptr if there isn't enough left,
+    // in which case the image uses the heap.
+    virtual std::uint8_t* allocate(std::size_t size) = 0;
+    virtual void release(std::uint8_t* data) = 0;
+};
+
+// Returns image memory to the allocator it came from, or to the heap
+struct PixelDeleter
+{
+    PixelAllocator* allocator{ nullptr };
+    void operator()(std::uint8_t* p) const;
+};
+
 /**
  * The image class supports multiple GL formats, including compressed ones.
  * Mipmaps may be stored within an image as well.  The mipmaps are stored in
@@ -30,7 +54,7 @@ namespace celestia::engine
 class Image
 {
 public:
-    Image(PixelFormat format, int w, int h, int mip = 1);
+    Image(PixelFormat format, int w, int h, int mip = 1, PixelAllocator* allocator = nullptr);
     ~Image() = default;
     Image(Image&&) = default;
     Image(const Image&) = delete;
@@ -53,19 +77,25 @@ public:
     int getSize() const;
     int getMipLevelSize(int mip) const;
 
+    // Returns the allocator the pixels came from, or nullptr if they are on
+    // the heap
+    PixelAllocator* getAllocator() const;
+
     bool isCompressed() const;
     bool hasAlpha() const;
 
     std::unique_ptr<Image> computeNormalMap(float scale, bool wrap) const;
+    std::unique_ptr<Image> computeMipMaps() const;
 
     void forceLinear();
 
     static bool canSave(ContentType type);
     bool save(const fs::path &path, ContentType type) const;
 
-    static std::unique_ptr<Image> load(const fs::path& filename);
+    static std::unique_ptr<Image> load(const fs::path& filename, PixelAllocator* allocator = nullptr);
 
 private:
+
     int width;
     int height;
     int pitch;
@@ -73,7 +103,7 @@ private:
     int components;
     PixelFormat format;
     int size;
-    std::unique_ptr<std::uint8_t[]> pixels;
+    std::unique_ptr<std::uint8_t[], PixelDeleter> pixels;
 };
 
 } // namespace celestia::engine
@@ -16,15 +16,19 @@
 namespace celestia::engine
 {
 
-Image* LoadJPEGImage(const fs::path& filename);
+// The JPEG, PNG and DDS loaders decode into memory from the allocator when
+// one is passed and it has enough space left
+Image* LoadJPEGImage(const fs::path& filename, PixelAllocator* allocator = nullptr);
 Image* LoadBMPImage(const fs::path& filename);
-Image* LoadPNGImage(const fs::path& filename);
-Image* LoadDDSImage(const fs::path& filename);
+Image* LoadPNGImage(const fs::path& filename, PixelAllocator* allocator = nullptr);
+Image* LoadDDSImage(const fs::path& filename, PixelAllocator* allocator = nullptr);
+Image* LoadKTX2Image(const fs::path& filename);
 #ifdef USE_LIBAVIF
 Image* LoadAVIFImage(const fs::path& filename);
 #endif
 
 bool SaveJPEGImage(const fs::path& filename, const Image& image);
 bool SavePNGImage(const fs::path& filename, const Image& image);
+bool SaveDDSImage(const fs::path& filename, const Image& image);
 
 } // namespace celestia::engine
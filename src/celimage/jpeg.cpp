@@ -119,7 +119,7 @@ bool SaveJPEGImage(const fs::path& filename,
 
 } // anonymous namespace
 
-Image* LoadJPEGImage(const fs::path& filename)
+Image* LoadJPEGImage(const fs::path& filename, PixelAllocator* allocator)
 {
     Image* img = nullptr;
 
@@ -209,7 +209,7 @@ Image* LoadJPEGImage(const fs::path& filename)
     if (cinfo.output_components == 1)
         format = PixelFormat::Luminance;
 
-    img = new Image(format, cinfo.image_width, cinfo.image_height);
+    img = new Image(format, cinfo.image_width, cinfo.image_height, 1, allocator);
 
     // cont = cinfo.output_height - 1;
     int cont = 0;
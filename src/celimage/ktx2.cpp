@@ -0,0 +1,345 @@
+// ktx2.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Loader for 2D textures stored in KTX2 containers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <celengine/glsupport.h>
+#include <celutil/binaryread.h>
+#include <celutil/logger.h>
+#include <celutil/mappedfile.h>
+#include <celutil/threadpool.h>
+#include "dds_decompress.h"
+#include "image.h"
+
+using namespace std::string_view_literals;
+
+namespace celestia::engine
+{
+namespace
+{
+
+constexpr std::string_view KTX2Identifier = "\xABKTX 20\xBB\r\n\x1A\n"sv;
+
+// Offsets of the header fields used, see the KTX 2.0 specification
+constexpr std::size_t VkFormatOffset = 12;
+constexpr std::size_t PixelWidthOffset = 20;
+constexpr std::size_t PixelHeightOffset = 24;
+constexpr std::size_t PixelDepthOffset = 28;
+constexpr std::size_t LayerCountOffset = 32;
+constexpr std::size_t FaceCountOffset = 36;
+constexpr std::size_t LevelCountOffset = 40;
+constexpr std::size_t SupercompressionOffset = 44;
+constexpr std::size_t HeaderSize = 80;
+constexpr std::size_t LevelIndexEntrySize = 24;
+
+constexpr std::uint32_t SupercompressionNone = 0;
+constexpr std::uint32_t SupercompressionBasisLZ = 1;
+constexpr std::uint32_t SupercompressionZstd = 2;
+
+// Images with at least this many pixels are decompressed on several threads
+constexpr std::uint32_t ParallelDecompressThreshold = 1024 * 1024;
+
+struct LevelIndex
+{
+    std::uint64_t byteOffset;
+    std::uint64_t byteLength;
+    std::uint64_t uncompressedByteLength;
+};
+
+PixelFormat
+GetPixelFormat(std::uint32_t vkFormat)
+{
+    switch (vkFormat)
+    {
+    case 23: // VK_FORMAT_R8G8B8_UNORM
+        return PixelFormat::RGB;
+    case 29: // VK_FORMAT_R8G8B8_SRGB
+        return PixelFormat::sRGB;
+    case 37: // VK_FORMAT_R8G8B8A8_UNORM
+        return PixelFormat::RGBA;
+    case 43: // VK_FORMAT_R8G8B8A8_SRGB
+        return PixelFormat::sRGBA;
+    case 131: // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+    case 133: // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+        return PixelFormat::DXT1;
+    case 132: // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+    case 134: // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+        return PixelFormat::DXT1_sRGBA;
+    case 135: // VK_FORMAT_BC2_UNORM_BLOCK
+        return PixelFormat::DXT3;
+    case 136: // VK_FORMAT_BC2_SRGB_BLOCK
+        return PixelFormat::DXT3_sRGBA;
+    case 137: // VK_FORMAT_BC3_UNORM_BLOCK
+        return PixelFormat::DXT5;
+    case 138: // VK_FORMAT_BC3_SRGB_BLOCK
+        return PixelFormat::DXT5_sRGBA;
+    case 145: // VK_FORMAT_BC7_UNORM_BLOCK
+        return PixelFormat::BC7;
+    case 146: // VK_FORMAT_BC7_SRGB_BLOCK
+        return PixelFormat::BC7_sRGBA;
+    case 147: // VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK
+        return PixelFormat::ETC2_RGB8;
+    case 148: // VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK
+        return PixelFormat::ETC2_sRGB8;
+    case 151: // VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK
+        return PixelFormat::ETC2_RGBA8;
+    case 152: // VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK
+        return PixelFormat::ETC2_sRGBA8;
+    case 157: // VK_FORMAT_ASTC_4x4_UNORM_BLOCK
+        return PixelFormat::ASTC_4x4;
+    case 158: // VK_FORMAT_ASTC_4x4_SRGB_BLOCK
+        return PixelFormat::ASTC_4x4_sRGBA;
+    default:
+        return PixelFormat::Invalid;
+    }
+}
+
+// Returns the format the S3TC decompressor handles, Invalid for other formats
+PixelFormat
+GetS3TCFormat(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::DXT1:
+    case PixelFormat::DXT1_sRGBA:
+        return PixelFormat::DXT1;
+    case PixelFormat::DXT3:
+    case PixelFormat::DXT3_sRGBA:
+        return PixelFormat::DXT3;
+    case PixelFormat::DXT5:
+    case PixelFormat::DXT5_sRGBA:
+        return PixelFormat::DXT5;
+    default:
+        return PixelFormat::Invalid;
+    }
+}
+
+bool
+IsSupportedByDriver(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::DXT1:
+    case PixelFormat::DXT1_sRGBA:
+    case PixelFormat::DXT3:
+    case PixelFormat::DXT3_sRGBA:
+    case PixelFormat::DXT5:
+    case PixelFormat::DXT5_sRGBA:
+        return gl::EXT_texture_compression_s3tc;
+    case PixelFormat::BC7:
+    case PixelFormat::BC7_sRGBA:
+        return gl::hasBPTCCompression();
+    case PixelFormat::ETC2_RGB8:
+    case PixelFormat::ETC2_sRGB8:
+    case PixelFormat::ETC2_RGBA8:
+    case PixelFormat::ETC2_sRGBA8:
+        return gl::hasETC2Compression();
+    case PixelFormat::ASTC_4x4:
+    case PixelFormat::ASTC_4x4_sRGBA:
+        return gl::KHR_texture_compression_astc_ldr;
+    default:
+        return true;
+    }
+}
+
+// Copies the data of a level to dst, undoing supercompression
+bool
+ReadLevel(const char* src, const LevelIndex& level, std::uint32_t supercompression,
+          std::uint8_t* dst, std::size_t size)
+{
+    switch (supercompression)
+    {
+    case SupercompressionNone:
+        if (level.byteLength != size)
+            return false;
+        std::memcpy(dst, src, size);
+        return true;
+#ifdef USE_ZSTD
+    case SupercompressionZstd:
+        {
+            if (level.uncompressedByteLength != size)
+                return false;
+            std::size_t result = ZSTD_decompress(dst, size, src, static_cast<std::size_t>(level.byteLength));
+            return ZSTD_isError(result) == 0 && result == size;
+        }
+#endif
+    default:
+        return false;
+    }
+}
+
+} // anonymous namespace
+
+Image* LoadKTX2Image(const fs::path& filename)
+{
+    auto file = util::MappedFile::open(filename);
+    if (file == nullptr)
+    {
+        util::GetLogger()->error("Error opening KTX2 texture file {}.\n", filename);
+        return nullptr;
+    }
+
+    const char* data = file->data();
+    if (file->size() < HeaderSize ||
+        std::memcmp(data, KTX2Identifier.data(), KTX2Identifier.size()) != 0)
+    {
+        util::GetLogger()->error("KTX2 texture file {} has bad header.\n", filename);
+        return nullptr;
+    }
+
+    auto vkFormat = util::fromMemoryLE<std::uint32_t>(data + VkFormatOffset);
+    auto width = util::fromMemoryLE<std::uint32_t>(data + PixelWidthOffset);
+    auto height = util::fromMemoryLE<std::uint32_t>(data + PixelHeightOffset);
+    auto levelCount = std::max(util::fromMemoryLE<std::uint32_t>(data + LevelCountOffset), 1u);
+    auto supercompression = util::fromMemoryLE<std::uint32_t>(data + SupercompressionOffset);
+
+    if (width == 0 || height == 0 ||
+        util::fromMemoryLE<std::uint32_t>(data + PixelDepthOffset) != 0 ||
+        util::fromMemoryLE<std::uint32_t>(data + LayerCountOffset) > 1 ||
+        util::fromMemoryLE<std::uint32_t>(data + FaceCountOffset) != 1)
+    {
+        util::GetLogger()->error("KTX2 texture file {} is not a 2D texture.\n", filename);
+        return nullptr;
+    }
+
+    // Basis Universal data would have to be transcoded to a format supported
+    // by the driver first
+    if (vkFormat == 0 || supercompression == SupercompressionBasisLZ)
+    {
+        util::GetLogger()->error("Basis Universal texture file {} is not supported.\n", filename);
+        return nullptr;
+    }
+
+#ifdef USE_ZSTD
+    if (supercompression != SupercompressionNone && supercompression != SupercompressionZstd)
+#else
+    if (supercompression != SupercompressionNone)
+#endif
+    {
+        util::GetLogger()->error("Unsupported supercompression scheme in KTX2 texture file {}.\n", filename);
+        return nullptr;
+    }
+
+    PixelFormat format = GetPixelFormat(vkFormat);
+    if (format == PixelFormat::Invalid)
+    {
+        util::GetLogger()->error("Unsupported format {} for KTX2 texture file {}.\n", vkFormat, filename);
+        return nullptr;
+    }
+
+    // Level 0 is the full size image
+    levelCount = std::min(levelCount, 32u);
+    if (file->size() < HeaderSize + levelCount * LevelIndexEntrySize)
+    {
+        util::GetLogger()->error("KTX2 texture file {} has bad level index.\n", filename);
+        return nullptr;
+    }
+
+    std::vector<LevelIndex> levels(levelCount);
+    for (std::uint32_t i = 0; i < levelCount; ++i)
+    {
+        const char* entry = data + HeaderSize + i * LevelIndexEntrySize;
+        LevelIndex& level = levels[i];
+        level.byteOffset = util::fromMemoryLE<std::uint64_t>(entry);
+        level.byteLength = util::fromMemoryLE<std::uint64_t>(entry + 8);
+        level.uncompressedByteLength = util::fromMemoryLE<std::uint64_t>(entry + 16);
+        if (level.byteOffset > file->size() || level.byteLength > file->size() - level.byteOffset)
+        {
+            util::GetLogger()->error("KTX2 texture file {} has bad level index.\n", filename);
+            return nullptr;
+        }
+    }
+
+    if (!IsSupportedByDriver(format))
+    {
+        // S3TC can be decompressed to RGBA like DDS textures, other formats
+        // can't be used at all
+        PixelFormat s3tcFormat = GetS3TCFormat(format);
+        if (s3tcFormat == PixelFormat::Invalid)
+        {
+            util::GetLogger()->error("Texture format of KTX2 file {} is not supported by the graphics driver.\n",
+                                     filename);
+            return nullptr;
+        }
+
+        Image compressed(format, static_cast<int>(width), static_cast<int>(height));
+        if (!ReadLevel(data + levels[0].byteOffset, levels[0], supercompression,
+                       compressed.getPixels(), static_cast<std::size_t>(compressed.getMipLevelSize(0))))
+        {
+            util::GetLogger()->error("Failed reading data from KTX2 texture file {}.\n", filename);
+            return nullptr;
+        }
+
+        util::ThreadPool* pool = width * height >= ParallelDecompressThreshold
+            ? &util::ThreadPool::shared()
+            : nullptr;
+
+        bool isSRGB = format != s3tcFormat;
+        auto img = std::make_unique<Image>(isSRGB ? PixelFormat::sRGBA : PixelFormat::RGBA,
+                                           static_cast<int>(width), static_cast<int>(height));
+        DecompressImageDXTc(s3tcFormat, width, height, compressed.getPixels(), false,
+                            reinterpret_cast<std::uint32_t*>(img->getPixels()), pool); //NOSONAR
+        return img.release();
+    }
+
+    auto img = std::make_unique<Image>(format, static_cast<int>(width), static_cast<int>(height),
+                                       static_cast<int>(levelCount));
+    std::vector<std::uint8_t> rows;
+    for (std::uint32_t mip = 0; mip < levelCount; ++mip)
+    {
+        const char* src = data + levels[mip].byteOffset;
+        auto size = static_cast<std::size_t>(img->getMipLevelSize(mip));
+
+        // KTX2 rows are tightly packed while uncompressed Image rows are
+        // padded to 4 bytes
+        std::size_t rowSize = 0;
+        std::size_t rowCount = 0;
+        if (!img->isCompressed())
+        {
+            rowSize = static_cast<std::size_t>(std::max(width >> mip, 1u)) * img->getComponents();
+            rowCount = std::max(height >> mip, 1u);
+        }
+
+        bool ok = true;
+        if (rowSize == 0 || rowSize * rowCount == size)
+        {
+            ok = ReadLevel(src, levels[mip], supercompression, img->getMipLevel(mip), size);
+        }
+        else
+        {
+            rows.resize(rowSize * rowCount);
+            ok = ReadLevel(src, levels[mip], supercompression, rows.data(), rows.size());
+            auto pitch = size / rowCount;
+            for (std::size_t row = 0; ok && row < rowCount; ++row)
+                std::memcpy(img->getMipLevel(mip) + row * pitch, rows.data() + row * rowSize, rowSize);
+        }
+
+        if (!ok)
+        {
+            util::GetLogger()->error("Failed reading data from KTX2 texture file {}.\n", filename);
+            return nullptr;
+        }
+    }
+
+    return img.release();
+}
+
+} // namespace celestia::engine
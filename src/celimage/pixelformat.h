@@ -46,5 +46,14 @@ enum class PixelFormat
     DXT1_sRGBA  = 0x8C4D, // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
     DXT3_sRGBA  = 0x8C4E, // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT
     DXT5_sRGBA  = 0x8C4F, // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+    // other compressed formats, all with 4x4 blocks
+    BC7         = 0x8E8C, // GL_COMPRESSED_RGBA_BPTC_UNORM
+    BC7_sRGBA   = 0x8E8D, // GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+    ETC2_RGB8   = 0x9274, // GL_COMPRESSED_RGB8_ETC2
+    ETC2_sRGB8  = 0x9275, // GL_COMPRESSED_SRGB8_ETC2
+    ETC2_RGBA8  = 0x9278, // GL_COMPRESSED_RGBA8_ETC2_EAC
+    ETC2_sRGBA8 = 0x9279, // GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC
+    ASTC_4x4    = 0x93B0, // GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+    ASTC_4x4_sRGBA = 0x93D0, // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR
 };
 }
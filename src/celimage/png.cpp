@@ -133,7 +133,7 @@ bool SavePNGImage(const fs::path& filename,
 
 } // anonymous namespace
 
-Image* LoadPNGImage(const fs::path& filename)
+Image* LoadPNGImage(const fs::path& filename, PixelAllocator* allocator)
 {
     char header[8];
     png_structp png_ptr;
@@ -220,7 +220,7 @@ Image* LoadPNGImage(const fs::path& filename)
         break;
     }
 
-    img = new Image(format, width, height);
+    img = new Image(format, width, height, 1, allocator);
 
     // TODO: consider using paletted textures if they're available
     if (color_type == PNG_COLOR_TYPE_PALETTE)
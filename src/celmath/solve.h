@@ -85,4 +85,47 @@ std::pair<T, T> solve_iteration_fixed(F f,
     return std::make_pair(x2, x2 - x);
 }
 
+
+// Find a minimum of a function in the interval [lower, upper] using golden
+// section search; the function should have a single minimum in the
+// interval. Returns a pair with the position of the minimum as the first
+// element and the error as the second.
+template<class T, class F>
+std::pair<T, T> minimize_golden(F f,
+                                T lower, T upper,
+                                T err,
+                                int maxIter = 100)
+{
+    // 1 / phi and 1 / phi^2
+    const T invPhi = (std::sqrt(static_cast<T>(5)) - static_cast<T>(1)) * static_cast<T>(0.5);
+    const T invPhi2 = static_cast<T>(1) - invPhi;
+
+    T x1 = lower + invPhi2 * (upper - lower);
+    T x2 = lower + invPhi * (upper - lower);
+    T f1 = f(x1);
+    T f2 = f(x2);
+
+    for (int i = 0; i < maxIter && upper - lower >= 2 * err; i++)
+    {
+        if (f1 < f2)
+        {
+            upper = x2;
+            x2 = x1;
+            f2 = f1;
+            x1 = lower + invPhi2 * (upper - lower);
+            f1 = f(x1);
+        }
+        else
+        {
+            lower = x1;
+            x1 = x2;
+            f1 = f2;
+            x2 = lower + invPhi * (upper - lower);
+            f2 = f(x2);
+        }
+    }
+
+    return std::make_pair((lower + upper) * static_cast<T>(0.5), (upper - lower) / 2);
+}
+
 } // namespace celestia::math
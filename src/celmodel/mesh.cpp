@@ -10,6 +10,7 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstring>
 #include <iterator>
 #include <tuple>
@@ -21,6 +22,8 @@
 #endif
 
 #include "mesh.h"
+#include "meshbvh.h"
+#include "vertexcache.h"
 
 using celestia::util::GetLogger;
 
@@ -36,6 +39,61 @@ isOpaqueMaterial(const Material &material)
              material.blend != BlendMode::AdditiveBlend;
 }
 
+void
+mergePrimitiveGroups(std::vector<PrimitiveGroup>& groups)
+{
+    if (groups.size() < 2)
+        return;
+
+    std::vector<PrimitiveGroup> newGroups;
+    for (size_t i = 0; i < groups.size(); i++)
+    {
+        auto &g = groups[i];
+
+        if (g.prim == PrimitiveGroupType::TriStrip)
+        {
+            std::vector<Index32> newIndices;
+            newIndices.reserve(g.indices.size() * 2);
+            for (size_t j = 0, e = g.indices.size() - 2; j < e; j++)
+            {
+                auto x = g.indices[j + 0];
+                auto y = g.indices[j + 1];
+                auto z = g.indices[j + 2];
+                // skip degenerated triangles
+                if (x == y || y == z || z == x)
+                    continue;
+                if ((j & 1) != 0) // FIXME: CCW hardcoded
+                    std::swap(y, z);
+                newIndices.push_back(x);
+                newIndices.push_back(y);
+                newIndices.push_back(z);
+            }
+            g.indices = std::move(newIndices);
+            g.prim = PrimitiveGroupType::TriList;
+        }
+
+        if (i == 0 || g.prim != PrimitiveGroupType::TriList)
+        {
+            newGroups.push_back(std::move(g));
+        }
+        else
+        {
+            auto &p = newGroups.back();
+            if (p.prim != g.prim || p.materialIndex != g.materialIndex)
+            {
+                newGroups.push_back(std::move(g));
+            }
+            else
+            {
+                p.indices.reserve(p.indices.size() + g.indices.size());
+                p.indices.insert(p.indices.end(), g.indices.begin(), g.indices.end());
+            }
+        }
+    }
+    GetLogger()->info("Optimized mesh groups: had {} groups, now: {} of them.\n", groups.size(), newGroups.size());
+    groups = std::move(newGroups);
+}
+
 } // end unnamed namespace
 
 
@@ -130,6 +188,18 @@ PrimitiveGroup::clone() const
 }
 
 
+LevelOfDetail
+LevelOfDetail::clone() const
+{
+    LevelOfDetail newLevel;
+    newLevel.error = error;
+    newLevel.groups.reserve(groups.size());
+    std::transform(groups.cbegin(), groups.cend(), std::back_inserter(newLevel.groups),
+                   [](const PrimitiveGroup& group) { return group.clone(); });
+    return newLevel;
+}
+
+
 unsigned int
 PrimitiveGroup::getPrimitiveCount() const
 {
@@ -164,6 +234,9 @@ Mesh::clone() const
     newMesh.groups.reserve(groups.size());
     std::transform(groups.cbegin(), groups.cend(), std::back_inserter(newMesh.groups),
                    [](const PrimitiveGroup& group) { return group.clone(); });
+    newMesh.levels.reserve(levels.size());
+    std::transform(levels.cbegin(), levels.cend(), std::back_inserter(newMesh.levels),
+                   [](const LevelOfDetail& level) { return level.clone(); });
     newMesh.name = name;
     return newMesh;
 }
@@ -174,6 +247,7 @@ Mesh::setVertices(unsigned int _nVertices, std::vector<VWord>&& vertexData)
 {
     nVertices = _nVertices;
     vertices = std::move(vertexData);
+    bvh.reset();
 }
 
 
@@ -184,6 +258,7 @@ Mesh::setVertexDescription(VertexDescription&& desc)
         return false;
 
     vertexDesc = std::move(desc);
+    bvh.reset();
     return true;
 }
 
@@ -210,6 +285,8 @@ Mesh::getGroup(unsigned int index)
     if (index >= groups.size())
         return nullptr;
 
+    // The caller may change the group
+    bvh.reset();
     return &groups[index];
 }
 
@@ -218,6 +295,7 @@ unsigned int
 Mesh::addGroup(PrimitiveGroup&& group)
 {
     groups.push_back(std::move(group));
+    bvh.reset();
     return groups.size();
 }
 
@@ -247,6 +325,40 @@ void
 Mesh::clearGroups()
 {
     groups.clear();
+    levels.clear();
+    bvh.reset();
+}
+
+
+const LevelOfDetail*
+Mesh::getLevelOfDetail(unsigned int index) const
+{
+    if (index >= levels.size())
+        return nullptr;
+
+    return &levels[index];
+}
+
+
+unsigned int
+Mesh::addLevelOfDetail(LevelOfDetail&& level)
+{
+    levels.push_back(std::move(level));
+    return levels.size();
+}
+
+
+unsigned int
+Mesh::getLevelOfDetailCount() const
+{
+    return levels.size();
+}
+
+
+void
+Mesh::clearLevelsOfDetail()
+{
+    levels.clear();
 }
 
 
@@ -274,6 +386,15 @@ Mesh::remapIndices(const std::vector<Index32>& indexMap)
             index = indexMap[index];
         }
     }
+    for (auto& level : levels)
+    {
+        for (auto& group : level.groups)
+        {
+            for (auto& index : group.indices)
+                index = indexMap[index];
+        }
+    }
+    bvh.reset();
 }
 
 
@@ -282,92 +403,99 @@ Mesh::remapMaterials(const std::vector<unsigned int>& materialMap)
 {
     for (auto& group : groups)
         group.materialIndex = materialMap[group.materialIndex];
+    for (auto& level : levels)
+    {
+        for (auto& group : level.groups)
+            group.materialIndex = materialMap[group.materialIndex];
+    }
 }
 
 
 void
 Mesh::aggregateByMaterial()
 {
-    std::sort(groups.begin(), groups.end(),
-              [](const PrimitiveGroup& g0, const PrimitiveGroup& g1)
-              {
-                  return g0.materialIndex < g1.materialIndex;
-              });
-    mergePrimitiveGroups();
+    auto byMaterial = [](const PrimitiveGroup& g0, const PrimitiveGroup& g1)
+    {
+        return g0.materialIndex < g1.materialIndex;
+    };
+
+    std::sort(groups.begin(), groups.end(), byMaterial);
+    mergePrimitiveGroups(groups);
+    for (auto& level : levels)
+    {
+        std::sort(level.groups.begin(), level.groups.end(), byMaterial);
+        mergePrimitiveGroups(level.groups);
+    }
+    bvh.reset();
 }
 
 
 void
-Mesh::mergePrimitiveGroups()
+Mesh::optimize()
 {
-    if (groups.size() < 2)
-        return;
+    const VertexAttribute& position = vertexDesc.getAttribute(VertexAttributeSemantic::Position);
+    const VWord* positions = position.format == VertexAttributeFormat::Float3
+        ? vertices.data() + position.offsetWords
+        : nullptr;
+    unsigned int stride = getVertexStrideWords();
 
-    std::vector<PrimitiveGroup> newGroups;
-    for (size_t i = 0; i < groups.size(); i++)
+    auto optimizeGroup = [&](PrimitiveGroup& g)
     {
-        auto &g = groups[i];
+        if (g.prim != PrimitiveGroupType::TriList || g.indices.size() < 3)
+            return;
 
-        if (g.prim == PrimitiveGroupType::TriStrip)
-        {
-            std::vector<Index32> newIndices;
-            newIndices.reserve(g.indices.size() * 2);
-            for (size_t j = 0, e = g.indices.size() - 2; j < e; j++)
-            {
-                auto x = g.indices[j + 0];
-                auto y = g.indices[j + 1];
-                auto z = g.indices[j + 2];
-                // skip degenerated triangles
-                if (x == y || y == z || z == x)
-                    continue;
-                if ((j & 1) != 0) // FIXME: CCW hardcoded
-                    std::swap(y, z);
-                newIndices.push_back(x);
-                newIndices.push_back(y);
-                newIndices.push_back(z);
-            }
-            g.indices = std::move(newIndices);
-            g.prim = PrimitiveGroupType::TriList;
-        }
+#ifdef HAVE_MESHOPTIMIZER
+        g.indices.resize(g.indices.size() / 3 * 3);
+        meshopt_optimizeVertexCache(g.indices.data(), g.indices.data(), g.indices.size(), nVertices);
+        if (positions != nullptr)
+            meshopt_optimizeOverdraw(g.indices.data(), g.indices.data(), g.indices.size(), reinterpret_cast<const float*>(positions), nVertices, vertexDesc.strideBytes, 1.05f);
+#else
+        OptimizeVertexCache(g.indices, nVertices, positions, stride);
+#endif
+    };
 
-        if (i == 0 || g.prim != PrimitiveGroupType::TriList)
+    for (auto& g : groups)
+        optimizeGroup(g);
+    for (auto& level : levels)
+    {
+        for (auto& g : level.groups)
+            optimizeGroup(g);
+    }
+
+    // Store the vertices in the order they're first used so that fetching
+    // them walks forward through memory; unused vertices are dropped.
+    std::vector<Index32> vertexMap(nVertices, ~0u);
+    Index32 vertexCount = 0;
+    auto addVertices = [&](const PrimitiveGroup& g)
+    {
+        for (Index32 index : g.indices)
         {
-            newGroups.push_back(std::move(g));
+            if (vertexMap[index] == ~0u)
+                vertexMap[index] = vertexCount++;
         }
-        else
+    };
+
+    for (const auto& g : groups)
+        addVertices(g);
+    for (const auto& level : levels)
+    {
+        for (const auto& g : level.groups)
+            addVertices(g);
+    }
+
+    std::vector<VWord> newVertices(static_cast<std::size_t>(vertexCount) * stride);
+    for (unsigned int i = 0; i < nVertices; i++)
+    {
+        if (vertexMap[i] != ~0u)
         {
-            auto &p = newGroups.back();
-            if (p.prim != g.prim || p.materialIndex != g.materialIndex)
-            {
-                newGroups.push_back(std::move(g));
-            }
-            else
-            {
-                p.indices.reserve(p.indices.size() + g.indices.size());
-                p.indices.insert(p.indices.end(), g.indices.begin(), g.indices.end());
-            }
+            std::memcpy(newVertices.data() + static_cast<std::size_t>(vertexMap[i]) * stride,
+                        vertices.data() + static_cast<std::size_t>(i) * stride,
+                        vertexDesc.strideBytes);
         }
     }
-    GetLogger()->info("Optimized mesh groups: had {} groups, now: {} of them.\n", groups.size(), newGroups.size());
-    groups = std::move(newGroups);
-}
-
-void
-Mesh::optimize()
-{
-#ifdef HAVE_MESHOPTIMIZER
-    if (groups.size() != 1)
-        return;
-
-    auto &g = groups.front();
 
-    if (g.prim != PrimitiveGroupType::TriList)
-        return;
-
-    meshopt_optimizeVertexCache(g.indices.data(), g.indices.data(), g.indices.size(), nVertices);
-    meshopt_optimizeOverdraw(g.indices.data(), g.indices.data(), g.indices.size(), reinterpret_cast<float*>(vertices.data()), nVertices, vertexDesc.strideBytes, 1.05f);
-    meshopt_optimizeVertexFetch(vertices.data(), g.indices.data(), g.indices.size(), vertices.data(), nVertices, vertexDesc.strideBytes);
-#endif
+    setVertices(vertexCount, std::move(newVertices));
+    remapIndices(vertexMap);
 }
 
 void
@@ -380,147 +508,87 @@ Mesh::rebuildIndexMetadata()
         g.indicesCount = static_cast<int>(g.indices.size());
         offset += g.indicesCount;
     }
+    // The levels of detail follow the full groups in the same index buffer
+    for (auto &level : levels)
+    {
+        for (auto &g : level.groups)
+        {
+            g.indicesOffset = offset;
+            g.indicesCount = static_cast<int>(g.indices.size());
+            offset += g.indicesCount;
+        }
+    }
     nTotalIndices = offset;
 }
 
+void
+Mesh::discardNonPositionAttributes()
+{
+    const VertexAttribute& position = vertexDesc.getAttribute(VertexAttributeSemantic::Position);
+    if (position.format != VertexAttributeFormat::Float3)
+    {
+        // Nothing to pick
+        nVertices = 0;
+        vertices = {};
+        return;
+    }
+
+    unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
+    if (stride == 3)
+        return;
+
+    std::vector<VWord> positions(static_cast<std::size_t>(nVertices) * 3);
+    for (unsigned int i = 0; i < nVertices; i++)
+    {
+        std::memcpy(positions.data() + i * 3,
+                    vertices.data() + i * stride + position.offsetWords,
+                    sizeof(VWord) * 3);
+    }
+
+    std::vector<VertexAttribute> attributes;
+    attributes.emplace_back(VertexAttributeSemantic::Position, VertexAttributeFormat::Float3, 0);
+    vertexDesc = VertexDescription(std::move(attributes));
+    vertices = std::move(positions);
+
+    // The hierarchy keeps its own copy of the positions and stays valid
+}
+
+
 bool
 Mesh::pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection, PickResult* result) const
 {
-    double maxDistance = 1.0e30;
-    double closest = maxDistance;
-
     // Pick will automatically fail without vertex positions--no reasonable
     // mesh should lack these.
-    if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).semantic != VertexAttributeSemantic::Position ||
-        vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
-    {
+    auto tree = getBVH();
+    if (tree == nullptr)
         return false;
-    }
 
-    unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
-    unsigned int posOffset = vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
-    const VWord* vdata = vertices.data();
+    MeshBVH::Hit hit;
+    if (!tree->intersect(rayOrigin, rayDirection, hit))
+        return false;
 
-    // Iterate over all primitive groups in the mesh
-    for (const auto& group : groups)
+    if (result)
     {
-        PrimitiveGroupType primType = group.prim;
-        Index32 nIndices = group.indices.size();
-
-        // Only attempt to compute the intersection of the ray with triangle
-        // groups.
-        if ((primType == PrimitiveGroupType::TriList
-             || primType == PrimitiveGroupType::TriStrip
-             || primType == PrimitiveGroupType::TriFan) &&
-            (nIndices >= 3) &&
-            !(primType == PrimitiveGroupType::TriList && nIndices % 3 != 0))
-        {
-            unsigned int primitiveIndex = 0;
-            Index32 index = 0;
-            Index32 i0 = group.indices[0];
-            Index32 i1 = group.indices[1];
-            Index32 i2 = group.indices[2];
-
-            // 2nd triangle has indices [0,2,3], then [0,3,4], [0,4,5], so for 2nd we
-            // should update index by 3 (+2 here and +1 inside the loop) but for others by 1
-            if (primType == PrimitiveGroupType::TriFan)
-                index = 2;
-
-            // Iterate over the triangles in the primitive group
-            do
-            {
-                // Get the triangle vertices v0, v1, and v2
-                float fv[3];
-                std::memcpy(fv, vdata + i0 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v0 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-                std::memcpy(fv, vdata + i1 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v1 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-                std::memcpy(fv, vdata + i2 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v2 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-
-                // Compute the edge vectors e0 and e1, and the normal n
-                Eigen::Vector3d e0 = v1 - v0;
-                Eigen::Vector3d e1 = v2 - v0;
-                Eigen::Vector3d n = e0.cross(e1);
-
-                // c is the cosine of the angle between the ray and triangle normal
-                double c = n.dot(rayDirection);
-
-                // If the ray is parallel to the triangle, it either misses the
-                // triangle completely, or is contained in the triangle's plane.
-                // If it's contained in the plane, we'll still call it a miss.
-                if (c != 0.0)
-                {
-                    double t = (n.dot(v0 - rayOrigin)) / c;
-                    if (t < closest && t > 0.0)
-                    {
-                        double m00 = e0.dot(e0);
-                        double m01 = e0.dot(e1);
-                        double m10 = e1.dot(e0);
-                        double m11 = e1.dot(e1);
-                        double det = m00 * m11 - m01 * m10;
-                        if (det != 0.0)
-                        {
-                            Eigen::Vector3d p = rayOrigin + rayDirection * t;
-                            Eigen::Vector3d q = p - v0;
-                            double q0 = e0.dot(q);
-                            double q1 = e1.dot(q);
-                            double d = 1.0 / det;
-                            double s0 = (m11 * q0 - m01 * q1) * d;
-                            double s1 = (m00 * q1 - m10 * q0) * d;
-                            if (s0 >= 0.0 && s1 >= 0.0 && s0 + s1 <= 1.0)
-                            {
-                                closest = t;
-                                if (result)
-                                {
-                                    result->group = &group;
-                                    result->primitiveIndex = primitiveIndex;
-                                    result->distance = closest;
-                                }
-                            }
-                        }
-                    }
-                }
-
-                // Get the indices for the next triangle
-                if (primType == PrimitiveGroupType::TriList)
-                {
-                    index += 3;
-                    if (index < nIndices)
-                    {
-                        i0 = group.indices[index + 0];
-                        i1 = group.indices[index + 1];
-                        i2 = group.indices[index + 2];
-                    }
-                }
-                else if (primType == PrimitiveGroupType::TriStrip)
-                {
-                    index += 1;
-                    if (index < nIndices)
-                    {
-                        i0 = i1;
-                        i1 = i2;
-                        i2 = group.indices[index];
-                        // TODO: alternate orientation of triangles in a strip
-                    }
-                }
-                else // primType == TriFan
-                {
-                    index += 1;
-                    if (index < nIndices)
-                    {
-                        i1 = i2;
-                        i2 = group.indices[index];
-                    }
-                }
-
-                primitiveIndex++;
-
-            } while (index < nIndices);
-        }
+        result->group = &groups[hit.group];
+        result->primitiveIndex = hit.primitiveIndex;
+        result->distance = hit.distance;
     }
 
-    return closest != maxDistance;
+    return true;
+}
+
+
+std::shared_ptr<const MeshBVH>
+Mesh::getBVH() const
+{
+    // Concurrent first calls may each build a tree; all but one are dropped
+    if (auto tree = std::atomic_load(&bvh); tree != nullptr)
+        return tree;
+
+    std::shared_ptr<const MeshBVH> tree = MeshBVH::build(*this);
+    if (tree != nullptr)
+        std::atomic_store(&bvh, tree);
+    return tree;
 }
 
 
@@ -590,6 +658,8 @@ Mesh::transform(const Eigen::Vector3f& translation, float scale)
     if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
         return;
 
+    bvh.reset();
+
     VWord* vdata = vertices.data() + vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
     unsigned int i;
 
@@ -616,6 +686,9 @@ Mesh::transform(const Eigen::Vector3f& translation, float scale)
             std::memcpy(vdata, &f, sizeof(float));
         }
     }
+
+    for (auto& level : levels)
+        level.error *= std::abs(scale);
 }
 
 
@@ -630,39 +703,50 @@ Mesh::getPrimitiveCount() const
     return count;
 }
 
+// Append the vertices and primitive groups of another mesh, then combine
+// the groups by material so that the merged mesh needs a single draw per
+// material.
 void
 Mesh::merge(const Mesh &other)
 {
-    auto &ti = groups.front().indices;
-    const auto &oi = other.groups.front().indices;
-
-    ti.reserve(ti.size() + oi.size());
-    for (auto i : oi)
-        ti.push_back(i + nVertices);
+    groups.reserve(groups.size() + other.groups.size());
+    for (const auto &og : other.groups)
+    {
+        std::vector<Index32> indices;
+        indices.reserve(og.indices.size());
+        for (auto i : og.indices)
+            indices.push_back(i + nVertices);
+        addGroup(og.prim, og.materialIndex, std::move(indices));
+    }
 
     vertices.reserve(vertices.size() + other.vertices.size());
     vertices.insert(vertices.end(), other.vertices.begin(), other.vertices.end());
 
     nVertices += other.nVertices;
+    aggregateByMaterial();
 }
 
 bool
 Mesh::canMerge(const Mesh &other, const std::vector<Material> &materials) const
 {
-    if (getGroupCount() != 1 || other.getGroupCount() != 1)
+    if (groups.empty() || other.groups.empty())
         return false;
 
-    const auto &tg = groups.front();
-    const auto &og = other.groups.front();
-
-    if (tg.prim != PrimitiveGroupType::TriList)
+    // The levels of detail of the two meshes needn't correspond
+    if (!levels.empty() || !other.levels.empty())
         return false;
 
-    if (std::tie(tg.materialIndex, tg.prim, vertexDesc.strideBytes) !=
-        std::tie(og.materialIndex, og.prim, other.vertexDesc.strideBytes))
+    if (vertexDesc.strideBytes != other.vertexDesc.strideBytes)
         return false;
 
-    if (!isOpaqueMaterial(materials[tg.materialIndex]) || !isOpaqueMaterial(materials[og.materialIndex]))
+    // Merging reorders groups across the meshes, which only opaque ones
+    // tolerate
+    auto isOpaqueGroup = [&materials](const PrimitiveGroup &g)
+    {
+        return g.materialIndex < materials.size() && isOpaqueMaterial(materials[g.materialIndex]);
+    };
+    if (!std::all_of(groups.begin(), groups.end(), isOpaqueGroup) ||
+        !std::all_of(other.groups.begin(), other.groups.end(), isOpaqueGroup))
         return false;
 
     for (auto i = VertexAttributeSemantic::Position;
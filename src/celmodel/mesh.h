@@ -13,6 +13,7 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -24,6 +25,8 @@
 
 namespace cmod
 {
+class MeshBVH;
+
 // 32-bit index type
 using Index32 = std::uint32_t;
 
@@ -53,7 +56,10 @@ enum class VertexAttributeFormat : std::int16_t
     Float3    = 2,
     Float4    = 3,
     UByte4    = 4,
-    FormatMax = 5,
+    Half2     = 5, // two half floats
+    Short4    = 6, // four signed normalized 16-bit integers
+    Int1010102 = 7, // signed normalized 10-bit x, y, z and 2-bit w
+    FormatMax = 8,
     InvalidFormat = -1,
 };
 
@@ -96,8 +102,11 @@ struct VertexAttribute
         {
         case VertexAttributeFormat::Float1:
         case VertexAttributeFormat::UByte4:
+        case VertexAttributeFormat::Half2:
+        case VertexAttributeFormat::Int1010102:
             return 1;
         case VertexAttributeFormat::Float2:
+        case VertexAttributeFormat::Short4:
             return 2;
         case VertexAttributeFormat::Float3:
             return 3;
@@ -173,6 +182,28 @@ struct PrimitiveGroup
 };
 
 
+/*! A simplified version of the primitive groups of a mesh, drawn from the
+ *  same vertices in place of the full groups when the mesh covers few
+ *  pixels.
+ */
+struct LevelOfDetail
+{
+    LevelOfDetail() = default;
+    ~LevelOfDetail() = default;
+    LevelOfDetail(const LevelOfDetail&) = delete;
+    LevelOfDetail& operator=(const LevelOfDetail&) = delete;
+    LevelOfDetail(LevelOfDetail&&) = default;
+    LevelOfDetail& operator=(LevelOfDetail&&) = default;
+
+    LevelOfDetail clone() const;
+
+    // Upper bound of the distance between the simplified and the full
+    // surface, in model units
+    float error{ 0.0f };
+    std::vector<PrimitiveGroup> groups{ };
+};
+
+
 class Mesh
 {
  public:
@@ -212,6 +243,15 @@ class Mesh
 
     void remapMaterials(const std::vector<unsigned int>& materialMap);
 
+    /*! Levels of detail index the vertices of the mesh, so they are kept
+     *  by the operations that remap the vertices but discarded when the
+     *  primitive groups are cleared or the mesh is merged.
+     */
+    const LevelOfDetail* getLevelOfDetail(unsigned int index) const;
+    unsigned int addLevelOfDetail(LevelOfDetail&& level);
+    unsigned int getLevelOfDetailCount() const;
+    void clearLevelsOfDetail();
+
     /*! Reorder primitive groups so that groups with identical materials
      *  appear sequentially in the primitive group list. This will reduce
      *  the number of graphics state changes at render time.
@@ -224,6 +264,12 @@ class Mesh
     bool pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, PickResult* result) const;
     bool pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double& distance) const;
 
+    /*! Return the ray intersection hierarchy of the mesh, building it on
+     *  first use; nullptr if the mesh has no float3 positions. Changing
+     *  the vertices or the primitive groups discards it.
+     */
+    std::shared_ptr<const MeshBVH> getBVH() const;
+
     Eigen::AlignedBox<float, 3> getBoundingBox() const;
     void transform(const Eigen::Vector3f& translation, float scale);
 
@@ -234,15 +280,27 @@ class Mesh
 
     unsigned int getIndexCount() const { return nTotalIndices; }
 
+    /*! Append another mesh with the same vertex layout, combining its
+     *  primitive groups with ours by material. Only meshes without levels
+     *  of detail whose materials are all opaque can be merged, since the
+     *  draw order of the groups changes.
+     */
     void merge(const Mesh&);
     bool canMerge(const Mesh&, const std::vector<Material> &materials) const;
+    /*! Reorder the triangles of the triangle lists for the vertex cache
+     *  and to reduce overdraw, then the vertices in the order they're
+     *  used. Vertices that no primitive uses are dropped.
+     */
     void optimize();
 
     void rebuildIndexMetadata();
 
- private:
-    void mergePrimitiveGroups();
+    /*! Drop all vertex attributes but the positions, which are all that
+     *  picking needs, once the vertices have been copied for rendering.
+     */
+    void discardNonPositionAttributes();
 
+ private:
     VertexDescription vertexDesc{ };
 
     unsigned int nVertices{ 0 };
@@ -251,8 +309,11 @@ class Mesh
     unsigned int nTotalIndices{ 0 };
 
     std::vector<PrimitiveGroup> groups;
+    std::vector<LevelOfDetail> levels;
 
     std::string name;
+
+    mutable std::shared_ptr<const MeshBVH> bvh;
 };
 
 Mesh GenerateTangents(const Mesh& mesh);
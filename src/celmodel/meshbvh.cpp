@@ -0,0 +1,459 @@
+// meshbvh.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Bounding volume hierarchy over the triangles of a mesh.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "meshbvh.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include <Eigen/Geometry>
+
+#include "mesh.h"
+
+namespace cmod
+{
+namespace
+{
+
+// Candidate split planes per axis
+constexpr int SplitBins = 16;
+
+// Relative cost of visiting a node compared to testing a triangle
+constexpr float TraversalCost = 1.0f;
+
+// Leaves hold this many triangles unless splitting them would cost more
+constexpr unsigned int MinLeafTriangles = 2;
+constexpr unsigned int MaxLeafTriangles = 16;
+
+// Bounds the traversal stack
+constexpr int MaxDepth = 60;
+
+float
+surfaceArea(const Eigen::AlignedBox3f& box)
+{
+    if (box.isEmpty())
+        return 0.0f;
+    Eigen::Vector3f d = box.sizes();
+    return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+}
+
+Eigen::Vector3f
+getPosition(const VWord* vdata, unsigned int stride, Index32 index)
+{
+    float fv[3];
+    std::memcpy(fv, vdata + index * stride, sizeof(float) * 3);
+    return Eigen::Map<Eigen::Vector3f>(fv);
+}
+
+// Call f(i0, i1, i2, primitiveIndex) for each triangle of a group, in the
+// order Mesh::pick has always numbered them
+template<typename F>
+void
+forEachTriangle(const PrimitiveGroup& group, F f)
+{
+    auto nIndices = static_cast<Index32>(group.indices.size());
+    if (nIndices < 3)
+        return;
+
+    switch (group.prim)
+    {
+    case PrimitiveGroupType::TriList:
+        if (nIndices % 3 != 0)
+            return;
+        for (Index32 i = 0; i < nIndices; i += 3)
+            f(group.indices[i], group.indices[i + 1], group.indices[i + 2], i / 3);
+        break;
+    case PrimitiveGroupType::TriStrip:
+        for (Index32 i = 2; i < nIndices; ++i)
+            f(group.indices[i - 2], group.indices[i - 1], group.indices[i], i - 2);
+        break;
+    case PrimitiveGroupType::TriFan:
+        for (Index32 i = 2; i < nIndices; ++i)
+            f(group.indices[0], group.indices[i - 1], group.indices[i], i - 2);
+        break;
+    default:
+        break;
+    }
+}
+
+// Distance range over which the ray is inside the box, empty if it misses
+inline bool
+intersectBox(const Eigen::Vector3f& lower,
+             const Eigen::Vector3f& upper,
+             const Eigen::Vector3d& origin,
+             const Eigen::Vector3d& invDirection,
+             double maxDistance,
+             double& entry)
+{
+    double tmin = 0.0;
+    double tmax = maxDistance;
+    for (int i = 0; i < 3; ++i)
+    {
+        double t0 = (static_cast<double>(lower[i]) - origin[i]) * invDirection[i];
+        double t1 = (static_cast<double>(upper[i]) - origin[i]) * invDirection[i];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        // Written so that a NaN, from a ray lying in a slab plane, keeps
+        // the previous bound
+        tmin = t0 > tmin ? t0 : tmin;
+        tmax = t1 < tmax ? t1 : tmax;
+    }
+
+    entry = tmin;
+    return tmin <= tmax;
+}
+
+} // end unnamed namespace
+
+
+class MeshBVH::Builder
+{
+public:
+    Builder(MeshBVH& _bvh, std::vector<Triangle>&& _triangles);
+
+    void build();
+
+private:
+    struct Bin
+    {
+        Eigen::AlignedBox3f bounds;
+        unsigned int count{ 0 };
+    };
+
+    void buildNode(std::uint32_t nodeIndex, std::uint32_t begin, std::uint32_t end, int depth);
+    void makeLeaf(Node& node, std::uint32_t begin, std::uint32_t end) const;
+
+    MeshBVH& bvh;
+    std::vector<Triangle> triangles;
+    std::vector<Eigen::AlignedBox3f> bounds;
+    std::vector<Eigen::Vector3f> centroids;
+    std::vector<std::uint32_t> order;
+};
+
+
+MeshBVH::Builder::Builder(MeshBVH& _bvh, std::vector<Triangle>&& _triangles) :
+    bvh(_bvh),
+    triangles(std::move(_triangles))
+{
+    bounds.reserve(triangles.size());
+    centroids.reserve(triangles.size());
+    order.reserve(triangles.size());
+    for (const Triangle& tri : triangles)
+    {
+        Eigen::AlignedBox3f box(tri.v0);
+        box.extend(Eigen::Vector3f(tri.v0 + tri.e1));
+        box.extend(Eigen::Vector3f(tri.v0 + tri.e2));
+        centroids.push_back(box.center());
+        bounds.push_back(box);
+        order.push_back(static_cast<std::uint32_t>(order.size()));
+    }
+}
+
+
+void
+MeshBVH::Builder::build()
+{
+    bvh.nodes.reserve(triangles.size() / MinLeafTriangles * 2 + 1);
+    bvh.nodes.emplace_back();
+    buildNode(0, 0, static_cast<std::uint32_t>(triangles.size()), 0);
+
+    bvh.triangles.reserve(triangles.size());
+    for (std::uint32_t index : order)
+        bvh.triangles.push_back(triangles[index]);
+}
+
+
+void
+MeshBVH::Builder::makeLeaf(Node& node, std::uint32_t begin, std::uint32_t end) const
+{
+    node.offset = begin;
+    node.count = end - begin;
+}
+
+
+void
+MeshBVH::Builder::buildNode(std::uint32_t nodeIndex, std::uint32_t begin, std::uint32_t end, int depth)
+{
+    Eigen::AlignedBox3f nodeBounds;
+    Eigen::AlignedBox3f centroidBounds;
+    for (std::uint32_t i = begin; i < end; ++i)
+    {
+        nodeBounds.extend(bounds[order[i]]);
+        centroidBounds.extend(centroids[order[i]]);
+    }
+
+    {
+        Node& node = bvh.nodes[nodeIndex];
+        node.lower = nodeBounds.min();
+        node.upper = nodeBounds.max();
+    }
+
+    std::uint32_t count = end - begin;
+    if (count <= MinLeafTriangles || depth >= MaxDepth)
+    {
+        makeLeaf(bvh.nodes[nodeIndex], begin, end);
+        return;
+    }
+
+    // Evaluate the binned surface area heuristic along every axis
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = std::numeric_limits<float>::max();
+    Eigen::Vector3f extent = centroidBounds.sizes();
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (extent[axis] <= 0.0f)
+            continue;
+
+        std::array<Bin, SplitBins> bins;
+        float scale = static_cast<float>(SplitBins) / extent[axis];
+        for (std::uint32_t i = begin; i < end; ++i)
+        {
+            auto bin = static_cast<int>((centroids[order[i]][axis] - centroidBounds.min()[axis]) * scale);
+            bin = std::min(bin, SplitBins - 1);
+            bins[bin].bounds.extend(bounds[order[i]]);
+            ++bins[bin].count;
+        }
+
+        // Sweep from the right to get the cost of the right side of every
+        // split, then from the left
+        std::array<float, SplitBins> rightCost;
+        Eigen::AlignedBox3f rightBounds;
+        unsigned int rightCount = 0;
+        for (int i = SplitBins - 1; i > 0; --i)
+        {
+            rightBounds.extend(bins[i].bounds);
+            rightCount += bins[i].count;
+            rightCost[i] = surfaceArea(rightBounds) * static_cast<float>(rightCount);
+        }
+
+        Eigen::AlignedBox3f leftBounds;
+        unsigned int leftCount = 0;
+        for (int i = 0; i < SplitBins - 1; ++i)
+        {
+            leftBounds.extend(bins[i].bounds);
+            leftCount += bins[i].count;
+            float cost = surfaceArea(leftBounds) * static_cast<float>(leftCount) + rightCost[i + 1];
+            if (leftCount > 0 && leftCount < count && cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i + 1;
+            }
+        }
+    }
+
+    // All centroids coincide; nothing to split
+    if (bestAxis < 0)
+    {
+        makeLeaf(bvh.nodes[nodeIndex], begin, end);
+        return;
+    }
+
+    float area = surfaceArea(nodeBounds);
+    float leafCost = area * static_cast<float>(count);
+    if (count <= MaxLeafTriangles && leafCost <= bestCost + TraversalCost * area)
+    {
+        makeLeaf(bvh.nodes[nodeIndex], begin, end);
+        return;
+    }
+
+    float scale = static_cast<float>(SplitBins) / extent[bestAxis];
+    float centroidMin = centroidBounds.min()[bestAxis];
+    auto middle = std::partition(order.begin() + begin, order.begin() + end,
+                                 [&](std::uint32_t index)
+                                 {
+                                     auto bin = static_cast<int>((centroids[index][bestAxis] - centroidMin) * scale);
+                                     return std::min(bin, SplitBins - 1) < bestSplit;
+                                 });
+    auto split = static_cast<std::uint32_t>(middle - order.begin());
+
+    // The first child follows its parent; the second one follows the
+    // subtree of the first
+    bvh.nodes.emplace_back();
+    buildNode(nodeIndex + 1, begin, split, depth + 1);
+
+    auto secondIndex = static_cast<std::uint32_t>(bvh.nodes.size());
+    bvh.nodes.emplace_back();
+    buildNode(secondIndex, split, end, depth + 1);
+
+    Node& node = bvh.nodes[nodeIndex];
+    node.offset = secondIndex;
+    node.count = 0;
+}
+
+
+std::unique_ptr<MeshBVH>
+MeshBVH::build(const Mesh& mesh)
+{
+    const VertexAttribute& position = mesh.getVertexDescription().getAttribute(VertexAttributeSemantic::Position);
+    if (position.semantic != VertexAttributeSemantic::Position ||
+        position.format != VertexAttributeFormat::Float3)
+    {
+        return nullptr;
+    }
+
+    unsigned int stride = mesh.getVertexStrideWords();
+    const VWord* vdata = mesh.getVertexData() + position.offsetWords;
+
+    std::vector<Triangle> triangles;
+    for (unsigned int groupIndex = 0; groupIndex < mesh.getGroupCount(); ++groupIndex)
+    {
+        forEachTriangle(*mesh.getGroup(groupIndex),
+                        [&](Index32 i0, Index32 i1, Index32 i2, unsigned int primitiveIndex)
+                        {
+                            Triangle& tri = triangles.emplace_back();
+                            tri.v0 = getPosition(vdata, stride, i0);
+                            tri.e1 = getPosition(vdata, stride, i1) - tri.v0;
+                            tri.e2 = getPosition(vdata, stride, i2) - tri.v0;
+                            tri.group = groupIndex;
+                            tri.primitiveIndex = primitiveIndex;
+
+                            // Degenerate triangles can never be hit
+                            if (tri.e1.cross(tri.e2).squaredNorm() == 0.0f)
+                                triangles.pop_back();
+                        });
+    }
+
+    auto bvh = std::make_unique<MeshBVH>();
+    if (!triangles.empty())
+        Builder(*bvh, std::move(triangles)).build();
+    return bvh;
+}
+
+
+template<bool AnyHit>
+bool
+MeshBVH::traverse(const Eigen::Vector3d& origin,
+                  const Eigen::Vector3d& direction,
+                  Hit* hit,
+                  double maxDistance) const
+{
+    if (nodes.empty())
+        return false;
+
+    Eigen::Vector3d invDirection = direction.cwiseInverse();
+    double closest = maxDistance;
+    bool found = false;
+
+    // Nodes left for later, with the distance at which the ray enters them
+    std::array<std::pair<std::uint32_t, double>, MaxDepth + 1> stack;
+    int stackSize = 0;
+    std::uint32_t nodeIndex = 0;
+    double entry;
+    if (!intersectBox(nodes[0].lower, nodes[0].upper, origin, invDirection, closest, entry))
+        return false;
+
+    for (;;)
+    {
+        const Node& node = nodes[nodeIndex];
+        if (node.count > 0)
+        {
+            for (std::uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            {
+                // Möller-Trumbore, in double precision like the positions
+                // of the ray
+                const Triangle& tri = triangles[i];
+                Eigen::Vector3d e1 = tri.e1.cast<double>();
+                Eigen::Vector3d e2 = tri.e2.cast<double>();
+                Eigen::Vector3d p = direction.cross(e2);
+                double det = e1.dot(p);
+                if (det == 0.0)
+                    continue;
+
+                double invDet = 1.0 / det;
+                Eigen::Vector3d s = origin - tri.v0.cast<double>();
+                double u = s.dot(p) * invDet;
+                if (u < 0.0 || u > 1.0)
+                    continue;
+
+                Eigen::Vector3d q = s.cross(e1);
+                double v = direction.dot(q) * invDet;
+                if (v < 0.0 || u + v > 1.0)
+                    continue;
+
+                double t = e2.dot(q) * invDet;
+                if (t <= 0.0 || t >= closest)
+                    continue;
+
+                if constexpr (AnyHit)
+                    return true;
+
+                closest = t;
+                found = true;
+                hit->group = tri.group;
+                hit->primitiveIndex = tri.primitiveIndex;
+                hit->distance = t;
+            }
+        }
+        else
+        {
+            // Visit the nearer child first and keep the other for later
+            std::uint32_t first = nodeIndex + 1;
+            std::uint32_t second = node.offset;
+            double firstEntry;
+            double secondEntry;
+            bool hitFirst = intersectBox(nodes[first].lower, nodes[first].upper, origin, invDirection, closest, firstEntry);
+            bool hitSecond = intersectBox(nodes[second].lower, nodes[second].upper, origin, invDirection, closest, secondEntry);
+            if (hitFirst && hitSecond)
+            {
+                if (secondEntry < firstEntry)
+                {
+                    std::swap(first, second);
+                    std::swap(firstEntry, secondEntry);
+                }
+                stack[stackSize++] = { second, secondEntry };
+                nodeIndex = first;
+                continue;
+            }
+            if (hitFirst || hitSecond)
+            {
+                nodeIndex = hitFirst ? first : second;
+                continue;
+            }
+        }
+
+        // Skip the nodes entered beyond the closest hit found since
+        for (;;)
+        {
+            if (stackSize == 0)
+                return found;
+            --stackSize;
+            if (stack[stackSize].second < closest)
+                break;
+        }
+        nodeIndex = stack[stackSize].first;
+    }
+}
+
+
+bool
+MeshBVH::intersect(const Eigen::Vector3d& origin,
+                   const Eigen::Vector3d& direction,
+                   Hit& hit,
+                   double maxDistance) const
+{
+    return traverse<false>(origin, direction, &hit, maxDistance);
+}
+
+
+bool
+MeshBVH::occluded(const Eigen::Vector3d& origin,
+                  const Eigen::Vector3d& direction,
+                  double maxDistance) const
+{
+    return traverse<true>(origin, direction, nullptr, maxDistance);
+}
+
+} // namespace cmod
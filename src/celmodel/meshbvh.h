@@ -0,0 +1,96 @@
+// meshbvh.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Bounding volume hierarchy over the triangles of a mesh.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace cmod
+{
+
+class Mesh;
+
+/*! Bounding volume hierarchy used to intersect rays with the triangles of
+ *  a mesh without testing all of them. The tree is built with the surface
+ *  area heuristic and stored depth first: the first child of a node
+ *  immediately follows it, so traversal mostly walks forward through
+ *  memory. Triangles are copied into leaf order, with their edges
+ *  precomputed.
+ *
+ *  The hierarchy is immutable once built and may be shared by any number
+ *  of threads.
+ */
+class MeshBVH
+{
+public:
+    struct Hit
+    {
+        unsigned int group{ 0 };
+        unsigned int primitiveIndex{ 0 };
+        double distance{ 0.0 };
+    };
+
+    /*! Build the hierarchy over the triangle lists, strips and fans of a
+     *  mesh; returns nullptr if the mesh has no float3 positions.
+     */
+    static std::unique_ptr<MeshBVH> build(const Mesh& mesh);
+
+    /*! Find the closest intersection of the ray with a triangle, at a
+     *  distance below maxDistance. As for Mesh::pick, distances are in units
+     *  of the length of direction.
+     */
+    bool intersect(const Eigen::Vector3d& origin,
+                   const Eigen::Vector3d& direction,
+                   Hit& hit,
+                   double maxDistance = 1.0e30) const;
+
+    //! Check whether the ray hits any triangle closer than maxDistance
+    bool occluded(const Eigen::Vector3d& origin,
+                  const Eigen::Vector3d& direction,
+                  double maxDistance) const;
+
+    std::size_t getTriangleCount() const { return triangles.size(); }
+
+private:
+    struct Node
+    {
+        Eigen::Vector3f lower;
+        std::uint32_t offset; // first triangle of a leaf, second child of an interior node
+        Eigen::Vector3f upper;
+        std::uint32_t count;  // triangles in a leaf, zero for interior nodes
+    };
+
+    struct Triangle
+    {
+        Eigen::Vector3f v0;
+        Eigen::Vector3f e1;
+        Eigen::Vector3f e2;
+        std::uint32_t group;
+        std::uint32_t primitiveIndex;
+    };
+
+    class Builder;
+
+    template<bool AnyHit>
+    bool traverse(const Eigen::Vector3d& origin,
+                  const Eigen::Vector3d& direction,
+                  Hit* hit,
+                  double maxDistance) const;
+
+    std::vector<Node> nodes;
+    std::vector<Triangle> triangles;
+};
+
+} // namespace cmod
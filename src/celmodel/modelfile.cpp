@@ -13,6 +13,7 @@
 #include <cassert>
 #include <cstring>
 #include <istream>
+#include <limits>
 #include <optional>
 #include <ostream>
 #include <string>
@@ -22,6 +23,7 @@
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 
+#include <celcompat/bit.h>
 #include <celutil/binaryread.h>
 #include <celutil/binarywrite.h>
 #include <celutil/logger.h>
@@ -29,6 +31,7 @@
 #include "mesh.h"
 #include "model.h"
 #include "modelfile.h"
+#include "vertexformat.h"
 
 using namespace std::string_view_literals;
 
@@ -52,12 +55,16 @@ constexpr float DefaultSpecularPower = 1.0f;
 constexpr float DefaultOpacity = 1.0f;
 constexpr BlendMode DefaultBlend = BlendMode::NormalBlend;
 
+// Number of indices read from binary models at a time
+constexpr std::uint32_t IndexBlockSize = 65536;
+
 // Standard tokens for ASCII model loader
 constexpr std::string_view MeshToken = "mesh"sv;
 constexpr std::string_view EndMeshToken = "end_mesh"sv;
 constexpr std::string_view VertexDescToken = "vertexdesc"sv;
 constexpr std::string_view EndVertexDescToken = "end_vertexdesc"sv;
 constexpr std::string_view VerticesToken = "vertices"sv;
+constexpr std::string_view LevelOfDetailToken = "lod"sv;
 constexpr std::string_view MaterialToken = "material"sv;
 constexpr std::string_view EndMaterialToken = "end_material"sv;
 
@@ -78,6 +85,7 @@ enum class CmodToken
     Vertices      = 1013,
     Emissive      = 1014,
     Blend         = 1015,
+    LevelOfDetail = 1016,
 };
 
 enum class CmodType
@@ -185,7 +193,7 @@ defined here--they have the obvious definitions.
                           texcoord0 | texcoord1 | texcoord2 | texcoord3 |
                           pointsize
 
-<vertex_format>       ::= f1 | f2 | f3 | f4 | ub4
+<vertex_format>       ::= f1 | f2 | f3 | f4 | ub4 | h2 | s4 | i1010102
 
 <vertex_pool>         ::= vertices <count>
                           { <float> }
@@ -265,6 +273,12 @@ parseVertexAttributeFormat(std::string_view name)
         return VertexAttributeFormat::Float4;
     if (name == "ub4"sv)
         return VertexAttributeFormat::UByte4;
+    if (name == "h2"sv)
+        return VertexAttributeFormat::Half2;
+    if (name == "s4"sv)
+        return VertexAttributeFormat::Short4;
+    if (name == "i1010102"sv)
+        return VertexAttributeFormat::Int1010102;
     return VertexAttributeFormat::InvalidFormat;
 }
 
@@ -287,8 +301,15 @@ parseTextureSemantic(std::string_view name)
 bool
 hasTangents(const Mesh &mesh)
 {
-    const auto& desc = mesh.getVertexDescription();
-    return desc.getAttribute(VertexAttributeSemantic::Tangent).format == VertexAttributeFormat::Float3;
+    switch (mesh.getVertexDescription().getAttribute(VertexAttributeSemantic::Tangent).format)
+    {
+    case VertexAttributeFormat::Float3:
+    case VertexAttributeFormat::Short4:
+    case VertexAttributeFormat::Int1010102:
+        return true;
+    default:
+        return false;
+    }
 }
 
 class AsciiModelLoader : public ModelLoader
@@ -313,6 +334,8 @@ private:
                                     unsigned int& vertexCount);
     bool loadUByte4Attribute(const VertexAttribute& attr,
                              cmod::VWord* destination);
+    bool loadSnormAttribute(const VertexAttribute& attr,
+                            cmod::VWord* destination);
     bool loadFloatAttribute(const VertexAttribute& attr,
                             cmod::VWord* destination);
 
@@ -581,9 +604,20 @@ AsciiModelLoader::loadVertices(const VertexDescription& vertexDesc,
         assert(offset < vertexDataSize);
         for (const auto& attr : vertexDesc.attributes)
         {
-            bool status = attr.format == VertexAttributeFormat::UByte4
-                ? loadUByte4Attribute(attr, vertexData.data() + offset)
-                : loadFloatAttribute(attr, vertexData.data() + offset);
+            bool status;
+            switch (attr.format)
+            {
+            case VertexAttributeFormat::UByte4:
+                status = loadUByte4Attribute(attr, vertexData.data() + offset);
+                break;
+            case VertexAttributeFormat::Short4:
+            case VertexAttributeFormat::Int1010102:
+                status = loadSnormAttribute(attr, vertexData.data() + offset);
+                break;
+            default:
+                status = loadFloatAttribute(attr, vertexData.data() + offset);
+                break;
+            }
 
             if (!status)
             {
@@ -621,6 +655,48 @@ AsciiModelLoader::loadUByte4Attribute(const VertexAttribute& attr,
 }
 
 
+// Signed normalized attributes are written as the stored integers, which
+// keeps ASCII files lossless
+bool
+AsciiModelLoader::loadSnormAttribute(const VertexAttribute& attr,
+                                     cmod::VWord* destination)
+{
+    bool packed = attr.format == VertexAttributeFormat::Int1010102;
+    std::array<std::int32_t, 4> values;
+    for (int i = 0; i < 4; ++i)
+    {
+        std::int32_t maxValue = packed ? (i == 3 ? 1 : 511) : 32767;
+        tok.nextToken();
+        if (auto tokenValue = tok.getIntegerValue();
+            tokenValue.has_value() && *tokenValue >= -maxValue - 1 && *tokenValue <= maxValue)
+        {
+            values[i] = *tokenValue;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (packed)
+    {
+        std::uint32_t bits = (static_cast<std::uint32_t>(values[0]) & 0x3ffU)
+                           | (static_cast<std::uint32_t>(values[1]) & 0x3ffU) << 10
+                           | (static_cast<std::uint32_t>(values[2]) & 0x3ffU) << 20
+                           | (static_cast<std::uint32_t>(values[3]) & 0x3U) << 30;
+        std::memcpy(destination + attr.offsetWords, &bits, sizeof(bits));
+    }
+    else
+    {
+        std::array<std::int16_t, 4> shorts;
+        std::copy(values.begin(), values.end(), shorts.begin());
+        std::memcpy(destination + attr.offsetWords, shorts.data(), sizeof(shorts));
+    }
+
+    return true;
+}
+
+
 bool
 AsciiModelLoader::loadFloatAttribute(const VertexAttribute& attr,
                                      cmod::VWord* destination)
@@ -641,6 +717,9 @@ AsciiModelLoader::loadFloatAttribute(const VertexAttribute& attr,
     case VertexAttributeFormat::Float4:
         readCount = 4;
         break;
+    case VertexAttributeFormat::Half2:
+        readCount = 2;
+        break;
     default:
         return false;
     }
@@ -658,7 +737,10 @@ AsciiModelLoader::loadFloatAttribute(const VertexAttribute& attr,
         }
     }
 
-    std::memcpy(destination + attr.offsetWords, values.data(), sizeof(float) * readCount);
+    if (attr.format == VertexAttributeFormat::Half2)
+        PackVertexAttribute(attr.format, values.data(), 2, destination + attr.offsetWords);
+    else
+        std::memcpy(destination + attr.offsetWords, values.data(), sizeof(float) * readCount);
     return true;
 }
 
@@ -687,12 +769,28 @@ AsciiModelLoader::loadMesh(Mesh& mesh)
     mesh.setVertexDescription(std::move(vertexDesc));
     mesh.setVertices(vertexCount, std::move(vertexData));
 
+    // Primitive groups following a lod token belong to that level of detail
+    std::vector<LevelOfDetail> levels;
+
     for (;;)
     {
         tok.nextToken();
         PrimitiveGroupType type;
         if (auto tokenValue = tok.getNameValue();
-            tokenValue.has_value() && *tokenValue != EndMeshToken)
+            tokenValue.has_value() && *tokenValue == LevelOfDetailToken)
+        {
+            tok.nextToken();
+            auto error = tok.getNumberValue();
+            if (!error.has_value() || *error < 0.0)
+            {
+                reportError("Bad level of detail error");
+                return false;
+            }
+
+            levels.emplace_back().error = static_cast<float>(*error);
+            continue;
+        }
+        else if (tokenValue.has_value() && *tokenValue != EndMeshToken)
         {
             type = parsePrimitiveGroupType(*tokenValue);
             if (type == PrimitiveGroupType::InvalidPrimitiveGroupType)
@@ -762,9 +860,22 @@ AsciiModelLoader::loadMesh(Mesh& mesh)
             indices.push_back(index);
         }
 
-        mesh.addGroup(type, materialIndex, std::move(indices));
+        if (levels.empty())
+        {
+            mesh.addGroup(type, materialIndex, std::move(indices));
+        }
+        else
+        {
+            PrimitiveGroup& group = levels.back().groups.emplace_back();
+            group.prim = type;
+            group.materialIndex = materialIndex;
+            group.indices = std::move(indices);
+        }
     }
 
+    for (LevelOfDetail& level : levels)
+        mesh.addLevelOfDetail(std::move(level));
+
     return true;
 }
 
@@ -968,6 +1079,20 @@ AsciiModelWriter::writeMesh(const Mesh& mesh)
         if (!out->good()) { return false; }
     }
 
+    for (unsigned int levelIndex = 0; mesh.getLevelOfDetail(levelIndex) != nullptr; levelIndex++)
+    {
+        const LevelOfDetail* level = mesh.getLevelOfDetail(levelIndex);
+        fmt::print(*out, "lod {}\n", level->error);
+        if (!out->good()) { return false; }
+
+        for (const PrimitiveGroup& group : level->groups)
+        {
+            if (!writeGroup(group)) { return false; }
+            fmt::print(*out, "\n");
+            if (!out->good()) { return false; }
+        }
+    }
+
     fmt::print(*out, "end_mesh\n");
     return out->good();
 }
@@ -1036,6 +1161,29 @@ AsciiModelWriter::writeVertex(const cmod::VWord* vertexData,
         case VertexAttributeFormat::UByte4:
             fmt::print(*out, "{} {} {} {}", +databytes[0], +databytes[1], +databytes[2], +databytes[3]);
             break;
+        case VertexAttributeFormat::Half2:
+            // Printed floats read back to the same half floats
+            UnpackVertexAttribute(attr.format, data, fdata.data());
+            fmt::print(*out, "{} {}", fdata[0], fdata[1]);
+            break;
+        case VertexAttributeFormat::Short4:
+        {
+            std::array<std::int16_t, 4> sdata;
+            std::memcpy(sdata.data(), data, sizeof(sdata));
+            fmt::print(*out, "{} {} {} {}", sdata[0], sdata[1], sdata[2], sdata[3]);
+            break;
+        }
+        case VertexAttributeFormat::Int1010102:
+        {
+            std::uint32_t bits;
+            std::memcpy(&bits, data, sizeof(bits));
+            fmt::print(*out, "{} {} {} {}",
+                       static_cast<std::int32_t>(bits << 22) >> 22,
+                       static_cast<std::int32_t>(bits << 12) >> 22,
+                       static_cast<std::int32_t>(bits << 2) >> 22,
+                       static_cast<std::int32_t>(bits) >> 30);
+            break;
+        }
         default:
             assert(0);
             break;
@@ -1113,6 +1261,15 @@ AsciiModelWriter::writeVertexDescription(const VertexDescription& desc)
         case VertexAttributeFormat::UByte4:
             fmt::print(*out, "ub4\n");
             break;
+        case VertexAttributeFormat::Half2:
+            fmt::print(*out, "h2\n");
+            break;
+        case VertexAttributeFormat::Short4:
+            fmt::print(*out, "s4\n");
+            break;
+        case VertexAttributeFormat::Int1010102:
+            fmt::print(*out, "i1010102\n");
+            break;
         default:
             return false;
             break;
@@ -1647,6 +1804,9 @@ BinaryModelLoader::loadMesh(Mesh& mesh)
     mesh.setVertexDescription(std::move(vertexDesc));
     mesh.setVertices(vertexCount, std::move(vertexData));
 
+    // Primitive groups following a level of detail token belong to that level
+    std::vector<LevelOfDetail> levels;
+
     for (;;)
     {
         std::int16_t tok;
@@ -1660,6 +1820,18 @@ BinaryModelLoader::loadMesh(Mesh& mesh)
         {
             break;
         }
+        if (tok == static_cast<std::int16_t>(CmodToken::LevelOfDetail))
+        {
+            float error;
+            if (!readTypeFloat1(*in, error) || !(error >= 0.0f))
+            {
+                reportError("Bad level of detail error");
+                return false;
+            }
+
+            levels.emplace_back().error = error;
+            continue;
+        }
         if (tok < 0 || tok >= static_cast<std::int16_t>(PrimitiveGroupType::PrimitiveTypeMax))
         {
             reportError("Bad primitive group type");
@@ -1675,24 +1847,50 @@ BinaryModelLoader::loadMesh(Mesh& mesh)
             return false;
         }
 
+        // Read the indices in blocks so that a bogus count can't make us
+        // allocate more than the file holds
         std::vector<Index32> indices;
-        indices.reserve(indexCount);
-
-        for (unsigned int i = 0; i < indexCount; i++)
+        for (std::uint32_t remaining = indexCount; remaining > 0;)
         {
-            std::uint32_t index;
-            if (!util::readLE<std::uint32_t>(*in, index) || index >= vertexCount)
+            std::uint32_t blockSize = std::min(remaining, IndexBlockSize);
+            std::size_t first = indices.size();
+            indices.resize(first + blockSize);
+            if (!in->read(reinterpret_cast<char*>(indices.data() + first), /* Flawfinder: ignore */ //NOSONAR
+                          static_cast<std::streamsize>(blockSize) * sizeof(Index32)).good())
             {
-                reportError("Index out of range");
+                reportError("Could not read primitive indices");
                 return false;
             }
 
-            indices.push_back(index);
+            for (auto it = indices.begin() + first; it != indices.end(); ++it)
+            {
+                *it = util::fromMemoryLE<Index32>(&*it);
+                if (*it >= vertexCount)
+                {
+                    reportError("Index out of range");
+                    return false;
+                }
+            }
+
+            remaining -= blockSize;
         }
 
-        mesh.addGroup(type, materialIndex, std::move(indices));
+        if (levels.empty())
+        {
+            mesh.addGroup(type, materialIndex, std::move(indices));
+        }
+        else
+        {
+            PrimitiveGroup& group = levels.back().groups.emplace_back();
+            group.prim = type;
+            group.materialIndex = materialIndex;
+            group.indices = std::move(indices);
+        }
     }
 
+    for (LevelOfDetail& level : levels)
+        mesh.addLevelOfDetail(std::move(level));
+
     return true;
 }
 
@@ -1714,9 +1912,30 @@ BinaryModelLoader::loadVertices(const VertexDescription& vertexDesc,
     }
 
     unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
+    if (vertexCount > std::numeric_limits<unsigned int>::max() / stride)
+    {
+        reportError("Vertex count too large");
+        return {};
+    }
+
     unsigned int vertexDataSize = stride * vertexCount;
     std::vector<VWord> vertexData(vertexDataSize);
 
+    // Attributes are stored in the order of the vertex description with
+    // no padding, which is also their layout in memory; on little-endian
+    // machines the whole block can be read at once.
+    if constexpr (celestia::compat::endian::native == celestia::compat::endian::little)
+    {
+        if (!in->read(reinterpret_cast<char*>(vertexData.data()), /* Flawfinder: ignore */ //NOSONAR
+                      static_cast<std::streamsize>(vertexDataSize) * sizeof(VWord)).good())
+        {
+            reportError("Failed to load vertex attribute");
+            return {};
+        }
+
+        return vertexData;
+    }
+
     unsigned int offset = 0;
     for (unsigned int i = 0; i < vertexCount; i++, offset += stride)
     {
@@ -1740,9 +1959,32 @@ BinaryModelLoader::loadAttribute(const VertexAttribute& attr,
                                  cmod::VWord* destination)
 {
     destination += attr.offsetWords;
-    if (attr.format == VertexAttributeFormat::UByte4)
+    switch (attr.format)
     {
+    case VertexAttributeFormat::UByte4:
         return util::readNative<std::uint32_t>(*in, *destination);
+    case VertexAttributeFormat::Int1010102:
+        return util::readLE<std::uint32_t>(*in, *destination);
+    case VertexAttributeFormat::Half2:
+    {
+        std::array<std::uint16_t, 2> h;
+        if (!util::readLE<std::uint16_t>(*in, h[0]) || !util::readLE<std::uint16_t>(*in, h[1]))
+            return false;
+        std::memcpy(destination, h.data(), sizeof(h));
+        return true;
+    }
+    case VertexAttributeFormat::Short4:
+    {
+        std::array<std::int16_t, 4> s;
+        for (std::int16_t& value : s)
+        {
+            if (!util::readLE<std::int16_t>(*in, value)) { return false; }
+        }
+        std::memcpy(destination, s.data(), sizeof(s));
+        return true;
+    }
+    default:
+        break;
     }
 
     std::array<float, 4> f;
@@ -1895,6 +2137,18 @@ BinaryModelWriter::writeMesh(const Mesh& mesh)
         if (!writeGroup(*mesh.getGroup(groupIndex))) { return false; }
     }
 
+    for (unsigned int levelIndex = 0; mesh.getLevelOfDetail(levelIndex) != nullptr; levelIndex++)
+    {
+        const LevelOfDetail* level = mesh.getLevelOfDetail(levelIndex);
+        if (!writeToken(*out, CmodToken::LevelOfDetail) || !writeTypeFloat1(*out, level->error))
+            return false;
+
+        for (const PrimitiveGroup& group : level->groups)
+        {
+            if (!writeGroup(group)) { return false; }
+        }
+    }
+
     return writeToken(*out, CmodToken::EndMesh);
 }
 
@@ -1945,6 +2199,27 @@ BinaryModelWriter::writeVertices(const VWord* vertexData,
             case VertexAttributeFormat::UByte4:
                 result = util::writeNative<std::uint32_t>(*out, *cdata);
                 break;
+            case VertexAttributeFormat::Int1010102:
+                result = util::writeLE<std::uint32_t>(*out, *cdata);
+                break;
+            case VertexAttributeFormat::Half2:
+            {
+                std::array<std::uint16_t, 2> h;
+                std::memcpy(h.data(), cdata, sizeof(h));
+                result = util::writeLE<std::uint16_t>(*out, h[0])
+                    && util::writeLE<std::uint16_t>(*out, h[1]);
+                break;
+            }
+            case VertexAttributeFormat::Short4:
+            {
+                std::array<std::int16_t, 4> sdata;
+                std::memcpy(sdata.data(), cdata, sizeof(sdata));
+                result = util::writeLE<std::int16_t>(*out, sdata[0])
+                    && util::writeLE<std::int16_t>(*out, sdata[1])
+                    && util::writeLE<std::int16_t>(*out, sdata[2])
+                    && util::writeLE<std::int16_t>(*out, sdata[3]);
+                break;
+            }
             default:
                 assert(0);
                 result = false;
@@ -17,6 +17,7 @@
 #include <utility>
 #include <Eigen/Core>
 #include <celmodel/mesh.h>
+#include <celmodel/vertexformat.h>
 #include <celutil/array_view.h>
 #include <celutil/logger.h>
 
@@ -153,6 +154,15 @@ GenerateTangents(const Mesh& mesh)
         return {};
     }
 
+    // Tangents are computed from float normals and texture coordinates
+    if (IsQuantizedFormat(desc.getAttribute(VertexAttributeSemantic::Normal).format) ||
+        IsQuantizedFormat(desc.getAttribute(VertexAttributeSemantic::Texture0).format))
+    {
+        Mesh unpacked = mesh.clone();
+        UnpackVertexAttributes(unpacked);
+        return GenerateTangents(unpacked);
+    }
+
     if (desc.getAttribute(VertexAttributeSemantic::Normal).format != VertexAttributeFormat::Float3)
     {
         GetLogger()->error("float3 format vertex normal required\n");
@@ -0,0 +1,338 @@
+// vertexcache.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Triangle and vertex reordering for the GPU vertex caches.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "vertexcache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <numeric>
+
+#include <Eigen/Core>
+
+namespace cmod
+{
+
+namespace
+{
+
+// Size of the cache the triangle order is tuned for; typical GPUs have a
+// larger effective cache, which this order still uses well
+constexpr unsigned int CacheSize = 16;
+
+// Clusters are split where their cache miss ratio falls below this
+// multiple of the ratio of the whole list
+constexpr float ClusterThreshold = 1.05f;
+
+class Tipsify
+{
+public:
+    Tipsify(const std::vector<Index32>& _indices, unsigned int _vertexCount);
+
+    std::vector<Index32> run();
+
+    // Positions in the output where the cache is cold
+    const std::vector<std::size_t>& getDeadEnds() const { return deadEnds; }
+
+private:
+    Index32 skipDeadEnd();
+    Index32 getNextVertex(const std::vector<Index32>& candidates);
+
+    const std::vector<Index32>& indices;
+    unsigned int vertexCount;
+
+    // Triangles using each vertex, CSR layout
+    std::vector<std::size_t> adjacencyOffsets;
+    std::vector<std::size_t> adjacency;
+
+    std::vector<unsigned int> liveTriangles;
+    std::vector<unsigned int> cacheTime;
+    std::vector<bool> emitted;
+    std::vector<Index32> deadEndStack;
+    std::vector<std::size_t> deadEnds;
+    unsigned int timeStamp{ CacheSize + 1 };
+    Index32 cursor{ 0 };
+};
+
+
+Tipsify::Tipsify(const std::vector<Index32>& _indices, unsigned int _vertexCount) :
+    indices(_indices),
+    vertexCount(_vertexCount),
+    adjacencyOffsets(_vertexCount + 1, 0),
+    liveTriangles(_vertexCount, 0),
+    cacheTime(_vertexCount, 0),
+    emitted(_indices.size() / 3, false)
+{
+    std::size_t triangleCount = indices.size() / 3;
+    for (std::size_t i = 0; i < triangleCount * 3; i++)
+        liveTriangles[indices[i]]++;
+
+    for (unsigned int v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+    adjacency.resize(adjacencyOffsets.back());
+    std::vector<std::size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (std::size_t i = 0; i < triangleCount * 3; i++)
+        adjacency[fill[indices[i]]++] = i / 3;
+}
+
+
+Index32
+Tipsify::skipDeadEnd()
+{
+    while (!deadEndStack.empty())
+    {
+        Index32 v = deadEndStack.back();
+        deadEndStack.pop_back();
+        if (liveTriangles[v] > 0)
+            return v;
+    }
+
+    for (; cursor < vertexCount; cursor++)
+    {
+        if (liveTriangles[cursor] > 0)
+            return cursor;
+    }
+
+    return ~0u;
+}
+
+
+Index32
+Tipsify::getNextVertex(const std::vector<Index32>& candidates)
+{
+    // Prefer the candidate that entered the cache first, as long as all of
+    // its remaining triangles can be emitted before it leaves the cache
+    Index32 best = ~0u;
+    int bestPriority = -1;
+    for (Index32 v : candidates)
+    {
+        if (liveTriangles[v] == 0)
+            continue;
+
+        int priority = 0;
+        unsigned int age = timeStamp - cacheTime[v];
+        if (age + 2 * liveTriangles[v] <= CacheSize)
+            priority = static_cast<int>(age);
+        if (priority > bestPriority)
+        {
+            bestPriority = priority;
+            best = v;
+        }
+    }
+
+    return best;
+}
+
+
+std::vector<Index32>
+Tipsify::run()
+{
+    std::vector<Index32> output;
+    output.reserve(indices.size());
+
+    std::vector<Index32> candidates;
+    for (Index32 fan = skipDeadEnd(); fan != ~0u;)
+    {
+        candidates.clear();
+        for (std::size_t i = adjacencyOffsets[fan]; i < adjacencyOffsets[fan + 1]; i++)
+        {
+            std::size_t t = adjacency[i];
+            if (emitted[t])
+                continue;
+
+            for (std::size_t k = 0; k < 3; k++)
+            {
+                Index32 v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEndStack.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (timeStamp - cacheTime[v] > CacheSize)
+                    cacheTime[v] = timeStamp++;
+            }
+            emitted[t] = true;
+        }
+
+        fan = getNextVertex(candidates);
+        if (fan == ~0u)
+        {
+            deadEnds.push_back(output.size());
+            fan = skipDeadEnd();
+        }
+    }
+
+    return output;
+}
+
+
+// Split the triangles between dead ends further, where the cache miss ratio
+// of the cluster so far reaches that of the whole list.
+std::vector<std::size_t>
+findClusters(const std::vector<Index32>& indices,
+             const std::vector<std::size_t>& deadEnds,
+             unsigned int vertexCount)
+{
+    float threshold = ComputeACMR(indices, vertexCount, CacheSize) * ClusterThreshold;
+
+    std::vector<std::size_t> clusters;
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    unsigned int timeStamp = CacheSize + 1;
+    unsigned int misses = 0;
+    std::size_t clusterStart = 0;
+    auto nextDeadEnd = deadEnds.begin();
+
+    for (std::size_t i = 0; i < indices.size(); i += 3)
+    {
+        bool hardBoundary = false;
+        while (nextDeadEnd != deadEnds.end() && *nextDeadEnd <= i)
+        {
+            hardBoundary = *nextDeadEnd == i;
+            ++nextDeadEnd;
+        }
+
+        std::size_t triangles = (i - clusterStart) / 3;
+        if (i == 0 || hardBoundary ||
+            (triangles > 0 && static_cast<float>(misses) <= threshold * static_cast<float>(triangles)))
+        {
+            // Start the new cluster with a cold cache so that clusters can
+            // be reordered freely
+            clusters.push_back(i);
+            clusterStart = i;
+            misses = 0;
+            timeStamp += CacheSize + 1;
+        }
+
+        for (std::size_t k = 0; k < 3; k++)
+        {
+            Index32 v = indices[i + k];
+            if (timeStamp - cacheTime[v] > CacheSize)
+            {
+                cacheTime[v] = timeStamp++;
+                misses++;
+            }
+        }
+    }
+
+    return clusters;
+}
+
+
+void
+sortClusters(std::vector<Index32>& indices,
+             const std::vector<std::size_t>& clusters,
+             const VWord* positions,
+             unsigned int strideWords)
+{
+    auto position = [positions, strideWords](Index32 v)
+    {
+        Eigen::Vector3f p;
+        std::memcpy(p.data(), positions + static_cast<std::size_t>(v) * strideWords, sizeof(float) * 3);
+        return p;
+    };
+
+    // Area weighted centroids and normals of the clusters
+    std::vector<Eigen::Vector3f> centroids(clusters.size(), Eigen::Vector3f::Zero());
+    std::vector<Eigen::Vector3f> normals(clusters.size(), Eigen::Vector3f::Zero());
+    std::vector<float> areas(clusters.size(), 0.0f);
+    Eigen::Vector3f meshCentroid = Eigen::Vector3f::Zero();
+    float meshArea = 0.0f;
+
+    for (std::size_t c = 0; c < clusters.size(); c++)
+    {
+        std::size_t end = c + 1 < clusters.size() ? clusters[c + 1] : indices.size();
+        for (std::size_t i = clusters[c]; i < end; i += 3)
+        {
+            Eigen::Vector3f p0 = position(indices[i]);
+            Eigen::Vector3f p1 = position(indices[i + 1]);
+            Eigen::Vector3f p2 = position(indices[i + 2]);
+            Eigen::Vector3f normal = (p1 - p0).cross(p2 - p0);
+            float area = normal.norm();
+
+            centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+            normals[c] += normal;
+            areas[c] += area;
+        }
+
+        meshCentroid += centroids[c];
+        meshArea += areas[c];
+        if (areas[c] > 0.0f)
+            centroids[c] /= areas[c];
+    }
+
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Clusters facing away from the center are more likely to occlude the
+    // rest of the mesh than to be occluded
+    std::vector<float> potentials(clusters.size());
+    for (std::size_t c = 0; c < clusters.size(); c++)
+        potentials[c] = (centroids[c] - meshCentroid).dot(normals[c].normalized());
+
+    std::vector<std::size_t> order(clusters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&potentials](std::size_t a, std::size_t b) { return potentials[a] > potentials[b]; });
+
+    std::vector<Index32> sorted;
+    sorted.reserve(indices.size());
+    for (std::size_t c : order)
+    {
+        std::size_t end = c + 1 < clusters.size() ? clusters[c + 1] : indices.size();
+        sorted.insert(sorted.end(), indices.begin() + clusters[c], indices.begin() + end);
+    }
+
+    indices = std::move(sorted);
+}
+
+} // end unnamed namespace
+
+
+void
+OptimizeVertexCache(std::vector<Index32>& indices,
+                    unsigned int vertexCount,
+                    const VWord* positions,
+                    unsigned int strideWords)
+{
+    indices.resize(indices.size() / 3 * 3);
+    if (indices.empty())
+        return;
+
+    Tipsify tipsify(indices, vertexCount);
+    indices = tipsify.run();
+
+    if (positions != nullptr)
+        sortClusters(indices, findClusters(indices, tipsify.getDeadEnds(), vertexCount), positions, strideWords);
+}
+
+
+float
+ComputeACMR(const std::vector<Index32>& indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    unsigned int timeStamp = cacheSize + 1;
+    unsigned int misses = 0;
+    for (Index32 v : indices)
+    {
+        if (timeStamp - cacheTime[v] > cacheSize)
+        {
+            cacheTime[v] = timeStamp++;
+            misses++;
+        }
+    }
+
+    return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
+
+} // end namespace cmod
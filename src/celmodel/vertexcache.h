@@ -0,0 +1,38 @@
+// vertexcache.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Triangle and vertex reordering for the GPU vertex caches.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <vector>
+
+#include "mesh.h"
+
+namespace cmod
+{
+
+/*! Reorder the triangles of a triangle list so that consecutive triangles
+ *  share vertices in the post-transform cache, with the Tipsify algorithm
+ *  of Sander, Nehab and Barczak. If positions (float3, strideWords apart)
+ *  are given, the clusters of triangles that start with a cold cache are
+ *  then sorted so that those facing outwards from the center are drawn
+ *  first, which reduces overdraw without affecting the cache efficiency.
+ */
+void OptimizeVertexCache(std::vector<Index32>& indices,
+                         unsigned int vertexCount,
+                         const VWord* positions = nullptr,
+                         unsigned int strideWords = 0);
+
+/*! Return the average number of cache misses per triangle for a FIFO
+ *  post-transform cache of cacheSize entries.
+ */
+float ComputeACMR(const std::vector<Index32>& indices, unsigned int vertexCount, unsigned int cacheSize);
+
+} // end namespace cmod
@@ -0,0 +1,333 @@
+// vertexformat.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Conversion between float and quantized vertex attribute formats.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "vertexformat.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace cmod
+{
+
+namespace
+{
+
+constexpr float MaxShort = 32767.0f;
+constexpr float Max10Bit = 511.0f;
+
+// Signed normalized values use the conversion of OpenGL 4.2 and later,
+// which maps zero exactly; older drivers are off by half a step at most.
+std::int32_t
+toSnorm(float value, float maxValue)
+{
+    return static_cast<std::int32_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * maxValue));
+}
+
+float
+fromSnorm(std::int32_t value, float maxValue)
+{
+    return std::max(static_cast<float>(value) / maxValue, -1.0f);
+}
+
+// Sign extend the 10-bit component starting at bit shift
+std::int32_t
+extract10(std::uint32_t packed, int shift)
+{
+    return static_cast<std::int32_t>(packed << (22 - shift)) >> 22;
+}
+
+} // end unnamed namespace
+
+
+std::uint16_t
+FloatToHalf(float f)
+{
+    std::uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    auto sign = static_cast<std::uint16_t>((x >> 16) & 0x8000U);
+    x &= 0x7fffffffU;
+
+    // Infinity and NaN
+    if (x >= 0x7f800000U)
+        return static_cast<std::uint16_t>(sign | (x > 0x7f800000U ? 0x7e00U : 0x7c00U));
+
+    // Values from 65520 upwards round to infinity
+    if (x >= 0x477ff000U)
+        return static_cast<std::uint16_t>(sign | 0x7c00U);
+
+    std::uint32_t h;
+    std::uint32_t remainder;
+    std::uint32_t halfway;
+    if (x < 0x38800000U)
+    {
+        // Subnormal half, in units of 2^-24
+        if (x < 0x33000000U)
+            return sign;
+
+        std::uint32_t mantissa = (x & 0x7fffffU) | 0x800000U;
+        std::uint32_t shift = 126U - (x >> 23);
+        h = mantissa >> shift;
+        remainder = mantissa & ((1U << shift) - 1U);
+        halfway = 1U << (shift - 1U);
+    }
+    else
+    {
+        // Rebias the exponent from 127 to 15
+        h = (x - 0x38000000U) >> 13;
+        remainder = x & 0x1fffU;
+        halfway = 0x1000U;
+    }
+
+    // Round to nearest even; a carry into the exponent is still correct
+    if (remainder > halfway || (remainder == halfway && (h & 1U) != 0))
+        ++h;
+
+    return static_cast<std::uint16_t>(sign | h);
+}
+
+
+float
+HalfToFloat(std::uint16_t h)
+{
+    std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000U) << 16;
+    std::uint32_t exponent = (h >> 10) & 0x1fU;
+    std::uint32_t mantissa = h & 0x3ffU;
+
+    if (exponent == 0)
+    {
+        float f = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign != 0 ? -f : f;
+    }
+
+    std::uint32_t x = exponent == 0x1fU
+        ? sign | 0x7f800000U | (mantissa << 13)
+        : sign | ((exponent + 112U) << 23) | (mantissa << 13);
+
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+
+bool
+IsQuantizedFormat(VertexAttributeFormat format)
+{
+    switch (format)
+    {
+    case VertexAttributeFormat::Half2:
+    case VertexAttributeFormat::Short4:
+    case VertexAttributeFormat::Int1010102:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+unsigned int
+UnpackVertexAttribute(VertexAttributeFormat format, const VWord* data, float* values)
+{
+    switch (format)
+    {
+    case VertexAttributeFormat::Float1:
+    case VertexAttributeFormat::Float2:
+    case VertexAttributeFormat::Float3:
+    case VertexAttributeFormat::Float4:
+    {
+        unsigned int count = VertexAttribute::getFormatSizeWords(format);
+        std::memcpy(values, data, count * sizeof(float));
+        return count;
+    }
+
+    case VertexAttributeFormat::UByte4:
+    {
+        std::array<std::uint8_t, 4> bytes;
+        std::memcpy(bytes.data(), data, bytes.size());
+        for (std::size_t i = 0; i < bytes.size(); ++i)
+            values[i] = static_cast<float>(bytes[i]) / 255.0f;
+        return 4;
+    }
+
+    case VertexAttributeFormat::Half2:
+    {
+        std::array<std::uint16_t, 2> halves;
+        std::memcpy(halves.data(), data, sizeof(halves));
+        values[0] = HalfToFloat(halves[0]);
+        values[1] = HalfToFloat(halves[1]);
+        return 2;
+    }
+
+    case VertexAttributeFormat::Short4:
+    {
+        std::array<std::int16_t, 4> shorts;
+        std::memcpy(shorts.data(), data, sizeof(shorts));
+        for (std::size_t i = 0; i < shorts.size(); ++i)
+            values[i] = fromSnorm(shorts[i], MaxShort);
+        return 4;
+    }
+
+    case VertexAttributeFormat::Int1010102:
+    {
+        std::uint32_t packed;
+        std::memcpy(&packed, data, sizeof(packed));
+        values[0] = fromSnorm(extract10(packed, 0), Max10Bit);
+        values[1] = fromSnorm(extract10(packed, 10), Max10Bit);
+        values[2] = fromSnorm(extract10(packed, 20), Max10Bit);
+        values[3] = fromSnorm(static_cast<std::int32_t>(packed) >> 30, 1.0f);
+        return 4;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+
+void
+PackVertexAttribute(VertexAttributeFormat format, const float* values, unsigned int componentCount, VWord* data)
+{
+    std::array<float, 4> v{ 0.0f, 0.0f, 0.0f, 0.0f };
+    std::copy_n(values, std::min(componentCount, 4U), v.begin());
+
+    switch (format)
+    {
+    case VertexAttributeFormat::Float1:
+    case VertexAttributeFormat::Float2:
+    case VertexAttributeFormat::Float3:
+    case VertexAttributeFormat::Float4:
+        std::memcpy(data, v.data(), VertexAttribute::getFormatSizeWords(format) * sizeof(float));
+        break;
+
+    case VertexAttributeFormat::UByte4:
+    {
+        std::array<std::uint8_t, 4> bytes;
+        for (std::size_t i = 0; i < bytes.size(); ++i)
+            bytes[i] = static_cast<std::uint8_t>(std::lround(std::clamp(v[i], 0.0f, 1.0f) * 255.0f));
+        std::memcpy(data, bytes.data(), bytes.size());
+        break;
+    }
+
+    case VertexAttributeFormat::Half2:
+    {
+        std::array<std::uint16_t, 2> halves{ FloatToHalf(v[0]), FloatToHalf(v[1]) };
+        std::memcpy(data, halves.data(), sizeof(halves));
+        break;
+    }
+
+    case VertexAttributeFormat::Short4:
+    {
+        std::array<std::int16_t, 4> shorts;
+        for (std::size_t i = 0; i < shorts.size(); ++i)
+            shorts[i] = static_cast<std::int16_t>(toSnorm(v[i], MaxShort));
+        std::memcpy(data, shorts.data(), sizeof(shorts));
+        break;
+    }
+
+    case VertexAttributeFormat::Int1010102:
+    {
+        std::uint32_t packed = (static_cast<std::uint32_t>(toSnorm(v[0], Max10Bit)) & 0x3ffU)
+                             | (static_cast<std::uint32_t>(toSnorm(v[1], Max10Bit)) & 0x3ffU) << 10
+                             | (static_cast<std::uint32_t>(toSnorm(v[2], Max10Bit)) & 0x3ffU) << 20
+                             | (static_cast<std::uint32_t>(toSnorm(v[3], 1.0f)) & 0x3U) << 30;
+        std::memcpy(data, &packed, sizeof(packed));
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+
+bool
+ConvertVertexAttribute(Mesh& mesh, VertexAttributeSemantic semantic, VertexAttributeFormat format)
+{
+    const VertexDescription& desc = mesh.getVertexDescription();
+    const VertexAttribute& converted = desc.getAttribute(semantic);
+    if (converted.format == VertexAttributeFormat::InvalidFormat)
+        return false;
+    if (converted.format == format)
+        return true;
+
+    // Keep the order of the attributes, moving those after the converted one
+    std::vector<VertexAttribute> attributes;
+    attributes.reserve(desc.attributes.size());
+    unsigned int offset = 0;
+    for (const VertexAttribute& attr : desc.attributes)
+    {
+        VertexAttributeFormat newFormat = attr.semantic == semantic ? format : attr.format;
+        attributes.emplace_back(attr.semantic, newFormat, offset);
+        offset += VertexAttribute::getFormatSizeWords(newFormat);
+    }
+
+    VertexDescription newDesc(std::move(attributes));
+    unsigned int oldStride = mesh.getVertexStrideWords();
+    unsigned int newStride = newDesc.strideBytes / sizeof(VWord);
+    unsigned int vertexCount = mesh.getVertexCount();
+    const VWord* oldData = mesh.getVertexData();
+    std::vector<VWord> newData(static_cast<std::size_t>(vertexCount) * newStride);
+
+    for (unsigned int i = 0; i < vertexCount; ++i)
+    {
+        const VWord* src = oldData + static_cast<std::size_t>(i) * oldStride;
+        VWord* dst = newData.data() + static_cast<std::size_t>(i) * newStride;
+        for (std::size_t j = 0; j < desc.attributes.size(); ++j)
+        {
+            const VertexAttribute& oldAttr = desc.attributes[j];
+            const VertexAttribute& newAttr = newDesc.attributes[j];
+            if (oldAttr.format == newAttr.format)
+            {
+                std::memcpy(dst + newAttr.offsetWords, src + oldAttr.offsetWords,
+                            VertexAttribute::getFormatSizeWords(oldAttr.format) * sizeof(VWord));
+                continue;
+            }
+
+            std::array<float, 4> values;
+            unsigned int count = UnpackVertexAttribute(oldAttr.format, src + oldAttr.offsetWords, values.data());
+            PackVertexAttribute(newAttr.format, values.data(), count, dst + newAttr.offsetWords);
+        }
+    }
+
+    if (!mesh.setVertexDescription(std::move(newDesc)))
+        return false;
+    mesh.setVertices(vertexCount, std::move(newData));
+    return true;
+}
+
+
+void
+UnpackVertexAttributes(Mesh& mesh)
+{
+    // Copy the attributes since each conversion replaces the description
+    std::vector<VertexAttribute> attributes = mesh.getVertexDescription().attributes;
+    for (const VertexAttribute& attr : attributes)
+    {
+        switch (attr.format)
+        {
+        case VertexAttributeFormat::Half2:
+            ConvertVertexAttribute(mesh, attr.semantic, VertexAttributeFormat::Float2);
+            break;
+        case VertexAttributeFormat::Short4:
+        case VertexAttributeFormat::Int1010102:
+            ConvertVertexAttribute(mesh, attr.semantic, VertexAttributeFormat::Float3);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+} // end namespace cmod
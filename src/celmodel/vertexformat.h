@@ -0,0 +1,52 @@
+// vertexformat.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Conversion between float and quantized vertex attribute formats.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+
+#include "mesh.h"
+
+namespace cmod
+{
+
+std::uint16_t FloatToHalf(float f);
+float HalfToFloat(std::uint16_t h);
+
+//! True for the half float and snorm formats, which UnpackVertexAttributes
+//! converts to floats
+bool IsQuantizedFormat(VertexAttributeFormat format);
+
+/*! Read an attribute in any format into up to four floats and return the
+ *  number of components. Normalized formats are mapped to [0, 1] (UByte4)
+ *  or [-1, 1] (Short4, Int1010102).
+ */
+unsigned int UnpackVertexAttribute(VertexAttributeFormat format, const VWord* data, float* values);
+
+/*! Store componentCount floats as an attribute of the given format; missing
+ *  components are set to zero and extra ones are ignored. Values outside
+ *  the range of normalized formats are clamped.
+ */
+void PackVertexAttribute(VertexAttributeFormat format, const float* values, unsigned int componentCount, VWord* data);
+
+/*! Change the format of the attribute with the given semantic, converting
+ *  the vertices of the mesh. Returns false if the mesh has no such
+ *  attribute.
+ */
+bool ConvertVertexAttribute(Mesh& mesh, VertexAttributeSemantic semantic, VertexAttributeFormat format);
+
+/*! Convert all quantized attributes of the mesh to floats, for drivers
+ *  that can't read them. Short4 and Int1010102 attributes become Float3;
+ *  their fourth component isn't used by the renderer.
+ */
+void UnpackVertexAttributes(Mesh& mesh);
+
+} // end namespace cmod
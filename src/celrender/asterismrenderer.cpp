@@ -39,25 +39,40 @@ void AsterismRenderer::render(const Color &defaultColor, const Matrices &mvp)
         m_initialized = true;
     }
 
-    m_lineRenderer.render(mvp, defaultColor, m_totalLineCount * 2);
-
     assert(m_asterisms->size() == m_lineCount.size());
 
+    // Lines of consecutive asterisms sharing a color are drawn from the
+    // static buffer in a single call; hidden asterisms are skipped.
     int offset = 0;
+    int runOffset = 0;
+    int runCount = 0;
+    Color runColor = defaultColor;
     float opacity = defaultColor.alpha();
     for (std::size_t size = m_asterisms->size(), i = 0; i < size; i++)
     {
         const auto& ast = (*m_asterisms)[i];
-        if (!ast.getActive() || !ast.isColorOverridden())
+        if (ast.getActive())
         {
-            offset += m_lineCount[i];
-            continue;
+            Color color = ast.isColorOverridden() ? Color(ast.getOverrideColor(), opacity) : defaultColor;
+            if (runCount > 0 && (color != runColor || runOffset + runCount != offset))
+            {
+                m_lineRenderer.render(mvp, runColor, runCount * 2, runOffset * 2);
+                runCount = 0;
+            }
+
+            if (runCount == 0)
+            {
+                runOffset = offset;
+                runColor = color;
+            }
+            runCount += m_lineCount[i];
         }
-
-        Color color = {ast.getOverrideColor(), opacity};
-        m_lineRenderer.render(mvp, color, m_lineCount[i] * 2, offset * 2);
         offset += m_lineCount[i];
     }
+
+    if (runCount > 0)
+        m_lineRenderer.render(mvp, runColor, runCount * 2, runOffset * 2);
+
     m_lineRenderer.finish();
 }
 
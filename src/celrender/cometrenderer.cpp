@@ -12,6 +12,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <vector>
 
 #include <Eigen/Geometry>
 
@@ -40,17 +42,16 @@ namespace
 {
 constexpr int MaxCometTailPoints = 120;
 constexpr int MaxCometTailSlices = 48;
-constexpr int MaxVertices = MaxCometTailPoints*MaxCometTailSlices;
-constexpr int MaxIndices = IndexListCapacity(MaxCometTailSlices, MaxCometTailPoints);
+
+// Ratio of the dust tail radius to its length
+constexpr float CometTailRadiusRatio = 0.1f;
 
 // Distance from the Sun at which comet tails will start to fade out
 constexpr float CometTailAttenDistSol = astro::AUtoKilometers(5.0f);
 } // end unnamed namespace
 
 CometRenderer::CometRenderer(Renderer &renderer) :
-    m_renderer(renderer),
-    m_vertices(std::make_unique<CometTailVertex[]>(MaxVertices)),
-    m_indices(std::make_unique<ushort[]>(MaxIndices))
+    m_renderer(renderer)
 {
 }
 
@@ -68,12 +69,80 @@ CometRenderer::initGL()
 
     m_brightnessLoc = m_prog->attribIndex("in_Brightness");
 
-    m_vo = std::make_unique<gl::VertexObject>(gl::VertexObject::Primitive::TriangleStrip);
-    m_bo = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array);
-    m_io = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::ElementArray);
+    m_initialized = true;
+    return true;
+}
+
+void
+CometRenderer::deinitGL()
+{
+    m_initialized = false;
+    for (auto &mesh : m_meshes)
+    {
+        mesh.vo.reset();
+        mesh.io.reset();
+        mesh.bo.reset();
+    }
+}
+
+// Build the tail mesh for a level of detail. The tail is a paraboloid
+// along the x axis with unit length; the actual size and orientation of
+// each comet's tail are applied by the modelview matrix.
+void
+CometRenderer::initializeLOD(unsigned int level)
+{
+    float lod = static_cast<float>(level + 1) / static_cast<float>(nLODs);
+    auto nTailPoints = static_cast<int>(MaxCometTailPoints * lod);
+    auto nTailSlices = static_cast<int>(MaxCometTailSlices * lod);
 
-    m_vo->addVertexBuffer(
-            *m_bo,
+    std::vector<CometTailVertex> vertices;
+    vertices.reserve(static_cast<std::size_t>(nTailPoints * nTailSlices));
+
+    for (int i = 0; i < nTailPoints; i++)
+    {
+        float alpha = static_cast<float>(i) / static_cast<float>(nTailPoints);
+        float brightness = 1.0f - static_cast<float>(i) / static_cast<float>(nTailPoints - 1);
+        float w0, w1;
+        // Special case for the first vertex in the comet tail
+        if (i == 0)
+        {
+            w0 = 1.0f;
+            w1 = 0.0f;
+        }
+        else
+        {
+            float prevAlpha = static_cast<float>(i - 1) / static_cast<float>(nTailPoints);
+            float sectionLength = alpha * alpha - prevAlpha * prevAlpha;
+            float dr = CometTailRadiusRatio / static_cast<float>(nTailPoints) / sectionLength;
+            w0 = std::atan(dr);
+            float d = std::sqrt(1.0f + w0 * w0);
+            w1 = 1.0f / d;
+            w0 = w0 / d;
+        }
+
+        float radius = alpha * CometTailRadiusRatio;
+        for (int j = 0; j < nTailSlices; j++)
+        {
+            float theta = 2.0f * numbers::pi_v<float> * static_cast<float>(j) / static_cast<float>(nTailSlices);
+            float s, c;
+            math::sincos(theta, s, c);
+            CometTailVertex& vtx = vertices.emplace_back();
+            vtx.normal = Eigen::Vector3f(w0, s * w1, c * w1).normalized();
+            vtx.point = Eigen::Vector3f(alpha * alpha, s * radius, c * radius);
+            vtx.brightness = brightness;
+        }
+    }
+
+    std::vector<ushort> indices;
+    BuildIndexList(static_cast<ushort>(nTailPoints - 1), static_cast<ushort>(nTailSlices), indices);
+
+    TailMesh &mesh = m_meshes[level];
+    mesh.count = IndexListCapacity(nTailSlices, nTailPoints);
+    const auto &bo = mesh.bo.emplace(gl::Buffer::TargetHint::Array, vertices);
+    const auto &io = mesh.io.emplace(gl::Buffer::TargetHint::ElementArray, indices);
+    mesh.vo.emplace(gl::VertexObject::Primitive::TriangleStrip);
+    mesh.vo->addVertexBuffer(
+            bo,
             CelestiaGLProgram::VertexCoordAttributeIndex,
             3,
             gl::VertexObject::DataType::Float,
@@ -81,7 +150,7 @@ CometRenderer::initGL()
             sizeof(CometTailVertex),
             offsetof(CometTailVertex, point))
         .addVertexBuffer(
-            *m_bo,
+            bo,
             CelestiaGLProgram::NormalAttributeIndex,
             3,
             gl::VertexObject::DataType::Float,
@@ -89,26 +158,15 @@ CometRenderer::initGL()
             sizeof(CometTailVertex),
             offsetof(CometTailVertex, normal))
         .addVertexBuffer(
-            *m_bo,
+            bo,
             m_brightnessLoc,
             1,
             gl::VertexObject::DataType::Float,
             false,
             sizeof(CometTailVertex),
             offsetof(CometTailVertex, brightness))
-        .setIndexBuffer(*m_io, 0, gl::VertexObject::IndexType::UnsignedShort);
-
-    m_initialized = true;
-    return true;
-}
-
-void
-CometRenderer::deinitGL()
-{
-    m_initialized = false;
-    m_vo = nullptr;
-    m_bo = nullptr;
-    m_io = nullptr;
+        .setIndexBuffer(io, 0, gl::VertexObject::IndexType::UnsignedShort);
+    bo.unbind();
 }
 
 void
@@ -124,18 +182,10 @@ CometRenderer::render(const Body &body,
 
     double now = observer.getTime();
 
-    Eigen::Vector3f cometPoints[MaxCometTailPoints];
-#if 0
-    Eigen::Vector3d pos0 = body.getOrbit(now)->positionAtTime(now);
-    Eigen::Vector3d pos1 = body.getOrbit(now)->positionAtTime(now - 0.01);
-    Eigen::Vector3d vd = pos1 - pos0;
-#endif
-
     // Adjust the amount of triangles used for the comet tail based on
     // the screen size of the comet.
     float lod = std::clamp(discSizeInPixels / 1000.0f, 0.2f, 1.0f);
-    auto nTailPoints = static_cast<int>(MaxCometTailPoints * lod);
-    auto nTailSlices = static_cast<int>(MaxCometTailSlices * lod);
+    auto level = static_cast<unsigned int>(std::lround(lod * static_cast<float>(nLODs))) - 1U;
 
     float irradiance_max = 0.0f;
     // Find the sun with the largest irrradiance of light onto the comet
@@ -163,88 +213,25 @@ CometRenderer::render(const Body &body,
     // direction to sun with dominant light irradiance:
     Eigen::Vector3f sunDir = (pos.cast<double>() - sunPos).cast<float>().normalized();
 
-    float dustTailRadius = dustTailLength * 0.1f;
-
     Eigen::Vector3f origin = -sunDir * (body.getRadius() * 100);
 
-    for (int i = 0; i < nTailPoints; i++)
-    {
-        float alpha = static_cast<float>(i) / static_cast<float>(nTailPoints);
-        alpha = alpha * alpha;
-        cometPoints[i] = origin + sunDir * (dustTailLength * alpha);
-    }
-
     // We need three axes to define the coordinate system for rendering the
     // comet. The first axis is the sun-to-comet direction, and the other
     // two are chose orthogonal to each other and the primary axis.
-    Eigen::Vector3f v = (cometPoints[1] - cometPoints[0]).normalized();
-    Eigen::Quaternionf q = body.getEclipticToEquatorial(now).cast<float>();
-    Eigen::Vector3f u = v.unitOrthogonal();
-    Eigen::Vector3f w = u.cross(v);
-
-    for (int i = 0; i < nTailPoints; i++)
-    {
-        float brightness = 1.0f - static_cast<float>(i) / static_cast<float>(nTailPoints - 1);
-        Eigen::Vector3f v0, v1;
-        float w0, w1;
-        // Special case for the first vertex in the comet tail
-        if (i == 0)
-        {
-            v0 = cometPoints[1] - cometPoints[0];
-            v0.normalize();
-            v1 = v0;
-            w0 = 1.0f;
-            w1 = 0.0f;
-        }
-        else
-        {
-            v0 = cometPoints[i] - cometPoints[i - 1];
-            float sectionLength = v0.norm();
-            v0.normalize();
+    Eigen::Matrix3f axes;
+    axes.col(0) = sunDir;
+    axes.col(1) = sunDir.unitOrthogonal();
+    axes.col(2) = axes.col(1).cross(sunDir);
 
-            if (i == nTailPoints - 1)
-            {
-                v1 = v0;
-            }
-            else
-            {
-                v1 = (cometPoints[i + 1] - cometPoints[i]).normalized();
-                q.setFromTwoVectors(v0, v1);
-                Eigen::Matrix3f rot = q.toRotationMatrix();
-                u = rot * u;
-                v = rot * v;
-                w = rot * w;
-            }
-            float dr = dustTailRadius / static_cast<float>(nTailPoints) / sectionLength;
-            w0 = std::atan(dr);
-            float d = std::sqrt(1.0f + w0 * w0);
-            w1 = 1.0f / d;
-            w0 = w0 / d;
-        }
-
-        float radius = static_cast<float>(i) / static_cast<float>(nTailPoints) * dustTailRadius;
-        for (int j = 0; j < nTailSlices; j++)
-        {
-            float theta = 2.0f * numbers::pi_v<float> * static_cast<float>(j) / static_cast<float>(nTailSlices);
-            float s, c;
-            math::sincos(theta, s, c);
-            CometTailVertex& vtx = m_vertices[i * nTailSlices + j];
-            vtx.normal = u * (s * w1) + w * (c * w1) + v * w0;
-            vtx.normal.normalize();
-            s *= radius;
-            c *= radius;
-
-            vtx.point = cometPoints[i] + u * s + w * c;
-            vtx.brightness = brightness;
-        }
-    }
-
-    BuildIndexList(static_cast<ushort>(nTailPoints-1), static_cast<ushort>(nTailSlices), m_indices.get());
+    Eigen::Affine3f tailTransform = Eigen::Translation3f(pos + origin) * axes * Eigen::Scaling(dustTailLength);
 
     // If fadeDistFromSun = x/x0 >= 1.0, comet tail starts fading,
     // i.e. fadeFactor quickly transits from 1 to 0.
     float fadeFactor = 0.5f * (1.0f - std::tanh(fadeDistance - 1.0f / fadeDistance));
 
+    if (!m_meshes[level].vo.has_value())
+        initializeLOD(level);
+
     Renderer::PipelineState ps;
     ps.blending = true;
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
@@ -252,22 +239,14 @@ CometRenderer::render(const Body &body,
     m_renderer.setPipelineState(ps);
 
     m_prog->use();
-    m_prog->setMVPMatrices(*m.projection, (*m.modelview) * math::translate(pos));
+    m_prog->setMVPMatrices(*m.projection, (*m.modelview) * tailTransform.matrix());
     m_prog->vec3Param("color") = GetBodyFeaturesManager()->getCometTailColor(&body).toVector3();
-    m_prog->vec3Param("viewDir") = pos.normalized();
+    // Normals are in the tail frame
+    m_prog->vec3Param("viewDir") = axes.transpose() * pos.normalized();
     m_prog->floatParam("fadeFactor") = fadeFactor;
 
-    m_bo->invalidateData().setData(
-        util::array_view(m_vertices.get(), MaxVertices),
-        gl::Buffer::BufferUsage::StreamDraw);
-
-    m_io->invalidateData().setData(
-        util::array_view(m_indices.get(), MaxIndices),
-        gl::Buffer::BufferUsage::StreamDraw);
-
     glDisable(GL_CULL_FACE);
-    int count = IndexListCapacity(nTailSlices, nTailPoints);
-    m_vo->draw(count);
+    m_meshes[level].vo->draw(m_meshes[level].count);
     glEnable(GL_CULL_FACE);
 }
 
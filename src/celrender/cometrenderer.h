@@ -10,22 +10,20 @@
 
 #pragma once
 
-#include <memory>
+#include <array>
+#include <optional>
 
 #include <Eigen/Core>
 
+#include <celrender/gl/buffer.h>
+#include <celrender/gl/vertexobject.h>
+
 class Body;
 class Observer;
 class Renderer;
 class CelestiaGLProgram;
 struct Matrices;
 
-namespace celestia::gl
-{
-class Buffer;
-class VertexObject;
-}
-
 namespace celestia::render
 {
 
@@ -50,6 +48,7 @@ public:
     void deinitGL();
 
 private:
+    static constexpr unsigned int nLODs = 5;
 
     struct CometTailVertex
     {
@@ -58,15 +57,22 @@ private:
         float brightness;
     };
 
+    // Tail mesh of unit length in the tail frame, shared by all comets
+    struct TailMesh
+    {
+        std::optional<gl::Buffer>       bo;
+        std::optional<gl::Buffer>       io;
+        std::optional<gl::VertexObject> vo;
+        int                             count{ 0 };
+    };
+
+    void initializeLOD(unsigned int level);
+
     Renderer                          &m_renderer;
     CelestiaGLProgram                 *m_prog{ nullptr };
     int                                m_brightnessLoc{ -1 };
     bool                               m_initialized{ false };
-    std::unique_ptr<CometTailVertex[]> m_vertices;
-    std::unique_ptr<unsigned short[]>  m_indices;
-    std::unique_ptr<gl::Buffer>        m_bo;
-    std::unique_ptr<gl::Buffer>        m_io;
-    std::unique_ptr<gl::VertexObject>  m_vo;
+    std::array<TailMesh, nLODs>        m_meshes;
 };
 
 } // namespace celestia::render
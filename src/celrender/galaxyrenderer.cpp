@@ -8,9 +8,11 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cmath>
+#include <tuple>
 
 #include <celengine/galaxy.h>
 #include <celengine/galaxyform.h>
@@ -19,6 +21,7 @@
 #include <celengine/shadermanager.h>
 #include <celengine/texture.h>
 #include <celmath/geomutil.h>
+#include <celrender/gl/binder.h>
 #include <celrender/gl/buffer.h>
 #include <celrender/gl/vertexobject.h>
 #include "galaxyrenderer.h"
@@ -66,7 +69,7 @@ BindTextures()
                                             galaxyTextureEval).release();
     }
     assert(galaxyTex != nullptr);
-    glActiveTexture(GL_TEXTURE0);
+    gl::Binder::get().activeTexture(0);
     galaxyTex->bind();
 
     if (colorTex == nullptr)
@@ -77,7 +80,7 @@ BindTextures()
                                            Texture::NoMipMaps).release();
     }
     assert(colorTex != nullptr);
-    glActiveTexture(GL_TEXTURE1);
+    gl::Binder::get().activeTexture(1);
     colorTex->bind();
 }
 
@@ -191,6 +194,25 @@ struct GalaxyRenderer::RenderData
     }
     gl::Buffer       bo{ util::NoCreateT{} };
     gl::VertexObject vo{ util::NoCreateT{} };
+    // same points as vo with per instance attributes from m_instanceBuffer
+    gl::VertexObject instancedVo{ util::NoCreateT{} };
+};
+
+// Layout of the per instance attributes of the galaxyinst150 shader
+struct GalaxyRenderer::InstanceData
+{
+    Eigen::Vector4f modelRow0;
+    Eigen::Vector4f modelRow1;
+    Eigen::Vector4f modelRow2;
+    Eigen::Vector4f params; // size, brightness, minimumFeatureSize, nPoints
+};
+
+struct GalaxyRenderer::Instance
+{
+    int          formId;
+    int          bucket; // nPoints rounded up to a power of two, as exponent
+    int          nPoints;
+    InstanceData data;
 };
 
 void
@@ -236,7 +258,7 @@ GalaxyRenderer::renderGL2()
         m_renderData[obj.galaxy->getFormId()].vo.draw(nPoints * 6);
     }
 
-    glActiveTexture(GL_TEXTURE0);
+    gl::Binder::get().activeTexture(0);
 }
 
 void
@@ -355,14 +377,13 @@ GalaxyRenderer::renderGL3()
     if (prog == nullptr)
         return;
 
-    initializeGL3(prog);
+    CelestiaGLProgram *instancedProg = nullptr;
+    if (gl::hasInstancedArrays())
+        instancedProg = m_renderer.getShaderManager().getShaderGL3("galaxyinst150", &params);
 
-    BindTextures();
+    initializeGL3(prog, instancedProg);
 
-    prog->use();
-    prog->samplerParam("galaxyTex") = 0;
-    prog->samplerParam("colorTex") = 1;
-    prog->mat3Param("viewMat") = m_viewMat;
+    BindTextures();
 
     Renderer::PipelineState ps;
     ps.blending = true;
@@ -370,8 +391,21 @@ GalaxyRenderer::renderGL3()
     ps.smoothLines = true;
     m_renderer.setPipelineState(ps);
 
+    if (instancedProg != nullptr)
+        renderInstancedGL3(instancedProg);
+
+    prog->use();
+    prog->samplerParam("galaxyTex") = 0;
+    prog->samplerParam("colorTex") = 1;
+    prog->mat3Param("viewMat") = m_viewMat;
+
     for (const auto &obj : m_objects)
     {
+        // Already drawn by renderInstancedGL3
+        bool customProjection = obj.nearZ != 0.0f && obj.farZ != 0.0f;
+        if (instancedProg != nullptr && !customProjection)
+            continue;
+
         float brightness = 0.0f;
         float size = 0.0f;
         float minimumFeatureSize = 0.0f;
@@ -392,11 +426,83 @@ GalaxyRenderer::renderGL3()
         m_renderData[obj.galaxy->getFormId()].vo.draw(nPoints);
     }
 
-    glActiveTexture(GL_TEXTURE0);
+    gl::Binder::get().activeTexture(0);
+}
+
+// Draws the galaxies which use the default projection matrix. They are
+// grouped by form and by point count, rounded up to a power of two, and each
+// group is drawn with a single instanced draw call. Within a group the
+// vertex shader drops the points past the point count of each instance.
+void
+GalaxyRenderer::renderInstancedGL3(CelestiaGLProgram *prog)
+{
+    m_instances.clear();
+    for (const auto &obj : m_objects)
+    {
+        if (obj.nearZ != 0.0f && obj.farZ != 0.0f)
+            continue;
+
+        float brightness = 0.0f;
+        float size = 0.0f;
+        float minimumFeatureSize = 0.0f;
+        Eigen::Matrix4f m;
+        Eigen::Matrix4f pr;
+        int nPoints = 0;
+
+        if (!getRenderInfo(obj, brightness, size, minimumFeatureSize, m, pr, nPoints) || nPoints <= 0)
+            continue;
+
+        int bucket = 0;
+        while ((1 << bucket) < nPoints)
+            ++bucket;
+
+        auto &instance = m_instances.emplace_back();
+        instance.formId = obj.galaxy->getFormId();
+        instance.bucket = bucket;
+        instance.nPoints = nPoints;
+        instance.data.modelRow0 = m.row(0).transpose();
+        instance.data.modelRow1 = m.row(1).transpose();
+        instance.data.modelRow2 = m.row(2).transpose();
+        instance.data.params = Eigen::Vector4f(size, brightness, minimumFeatureSize, static_cast<float>(nPoints));
+    }
+
+    if (m_instances.empty())
+        return;
+
+    std::sort(m_instances.begin(), m_instances.end(),
+              [](const Instance &a, const Instance &b)
+              {
+                  return std::tie(a.formId, a.bucket) < std::tie(b.formId, b.bucket);
+              });
+
+    prog->use();
+    prog->samplerParam("galaxyTex") = 0;
+    prog->samplerParam("colorTex") = 1;
+    prog->mat3Param("viewMat") = m_viewMat;
+    prog->setMVPMatrices(m_renderer.getProjectionMatrix(), m_renderer.getModelViewMatrix());
+
+    for (auto first = m_instances.begin(); first != m_instances.end();)
+    {
+        int maxPoints = 0;
+        m_instanceData.clear();
+        auto last = first;
+        for (; last != m_instances.end() && last->formId == first->formId && last->bucket == first->bucket; ++last)
+        {
+            maxPoints = std::max(maxPoints, last->nPoints);
+            m_instanceData.push_back(last->data);
+        }
+
+        // Respecifying the whole buffer lets the driver orphan the old
+        // storage instead of waiting for the previous draw call.
+        m_instanceBuffer.setData(m_instanceData, gl::Buffer::BufferUsage::StreamDraw);
+        m_renderData[first->formId].instancedVo.drawInstanced(maxPoints, static_cast<int>(m_instanceData.size()));
+
+        first = last;
+    }
 }
 
 void
-GalaxyRenderer::initializeGL3(const CelestiaGLProgram *prog)
+GalaxyRenderer::initializeGL3(const CelestiaGLProgram *prog, const CelestiaGLProgram *instancedProg)
 {
     struct GalaxyVtx
     {
@@ -415,6 +521,45 @@ GalaxyRenderer::initializeGL3(const CelestiaGLProgram *prog)
     auto colorLoc = prog->attribIndex("in_ColorIndex");
     auto brightnessLoc = prog->attribIndex("in_Brightness");
 
+    // The instanced vertex objects read the same points and add the
+    // attributes of InstanceData, advancing once per instance.
+    auto createInstancedVertexObject = [this, instancedProg](const gl::Buffer &bo)
+    {
+        gl::VertexObject vo(gl::VertexObject::Primitive::Points);
+
+        vo.addVertexBuffer(
+            bo, CelestiaGLProgram::VertexCoordAttributeIndex,
+            3, gl::VertexObject::DataType::Short,
+            true, sizeof(GalaxyVtx), offsetof(GalaxyVtx, position));
+        vo.addVertexBuffer(
+            bo, instancedProg->attribIndex("in_Size"), 1, gl::VertexObject::DataType::UnsignedShort,
+            true, sizeof(GalaxyVtx), offsetof(GalaxyVtx, size));
+        vo.addVertexBuffer(
+            bo, instancedProg->attribIndex("in_ColorIndex"), 1, gl::VertexObject::DataType::UnsignedByte,
+            true, sizeof(GalaxyVtx), offsetof(GalaxyVtx, colorIndex));
+        vo.addVertexBuffer(
+            bo, instancedProg->attribIndex("in_Brightness"), 1, gl::VertexObject::DataType::UnsignedByte,
+            true, sizeof(GalaxyVtx), offsetof(GalaxyVtx, brightness));
+
+        vo.addVertexBuffer(
+            m_instanceBuffer, instancedProg->attribIndex("in_ModelRow0"), 4, gl::VertexObject::DataType::Float,
+            false, sizeof(InstanceData), offsetof(InstanceData, modelRow0), 1);
+        vo.addVertexBuffer(
+            m_instanceBuffer, instancedProg->attribIndex("in_ModelRow1"), 4, gl::VertexObject::DataType::Float,
+            false, sizeof(InstanceData), offsetof(InstanceData, modelRow1), 1);
+        vo.addVertexBuffer(
+            m_instanceBuffer, instancedProg->attribIndex("in_ModelRow2"), 4, gl::VertexObject::DataType::Float,
+            false, sizeof(InstanceData), offsetof(InstanceData, modelRow2), 1);
+        vo.addVertexBuffer(
+            m_instanceBuffer, instancedProg->attribIndex("in_Instance"), 4, gl::VertexObject::DataType::Float,
+            false, sizeof(InstanceData), offsetof(InstanceData, params), 1);
+
+        return vo;
+    };
+
+    if (instancedProg != nullptr)
+        m_instanceBuffer = gl::Buffer(gl::Buffer::TargetHint::Array);
+
     const auto *gm = GalacticFormManager::get();
     std::vector<GalaxyVtx> glVertices;
 
@@ -461,7 +606,9 @@ GalaxyRenderer::initializeGL3(const CelestiaGLProgram *prog)
                 bo, brightnessLoc, 1, gl::VertexObject::DataType::UnsignedByte,
                 true, sizeof(GalaxyVtx), offsetof(GalaxyVtx, brightness));
 
-            m_renderData.emplace_back(std::move(bo), std::move(vo));
+            auto &renderData = m_renderData.emplace_back(std::move(bo), std::move(vo));
+            if (instancedProg != nullptr)
+                renderData.instancedVo = createInstancedVertexObject(renderData.bo);
         }
         else
         {
@@ -16,6 +16,7 @@
 #include <Eigen/Geometry>
 
 #include <celengine/galaxyform.h>
+#include <celrender/gl/buffer.h>
 
 class CelestiaGLProgram;
 class Galaxy;
@@ -50,7 +51,15 @@ private:
     void initializeGL2(const CelestiaGLProgram *prog);
 
     void renderGL3();
-    void initializeGL3(const CelestiaGLProgram *prog);
+    void initializeGL3(const CelestiaGLProgram *prog, const CelestiaGLProgram *instancedProg);
+    void renderInstancedGL3(CelestiaGLProgram *prog);
+
+    // per-frame instance data of galaxies drawn with the default projection
+    struct Instance;
+    std::vector<Instance>   m_instances;
+    struct InstanceData;
+    std::vector<InstanceData> m_instanceData;
+    gl::Buffer              m_instanceBuffer{ util::NoCreateT{} };
 
     // global state
     std::vector<Object>     m_objects;
@@ -27,6 +27,12 @@ Binder::bind(const Buffer &bo)
     return bindVBO(bo.targetHint(), bo.id());
 }
 
+Binder&
+Binder::bind(Buffer::TargetHint target, GLuint id)
+{
+    return bindVBO(target, id);
+}
+
 Binder&
 Binder::unbind(const Buffer &bo)
 {
@@ -76,6 +82,106 @@ Binder::unbind<VertexObject>()
     return bindVAO(0u);
 }
 
+Binder&
+Binder::activeTexture(unsigned int unit)
+{
+    if (m_activeUnit != unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_activeUnit = unit;
+        ++m_stats.calls;
+    }
+    else
+    {
+        ++m_stats.skipped;
+    }
+    return *this;
+}
+
+Binder&
+Binder::bindTexture(GLenum target, GLuint id)
+{
+    GLuint *bound = nullptr;
+    if (m_activeUnit < MaxTextureUnits)
+    {
+        auto &textureUnit = m_textureUnits[m_activeUnit];
+        if (target == GL_TEXTURE_2D)
+            bound = &textureUnit.texture2D;
+        else if (target == GL_TEXTURE_CUBE_MAP)
+            bound = &textureUnit.textureCube;
+    }
+
+    if (bound == nullptr || *bound != id)
+    {
+        glBindTexture(target, id);
+        if (bound != nullptr)
+            *bound = id;
+        ++m_stats.calls;
+    }
+    else
+    {
+        ++m_stats.skipped;
+    }
+    return *this;
+}
+
+Binder&
+Binder::forgetTexture(GLuint id)
+{
+    for (auto &textureUnit : m_textureUnits)
+    {
+        if (textureUnit.texture2D == id)
+            textureUnit.texture2D = Unknown;
+        if (textureUnit.textureCube == id)
+            textureUnit.textureCube = Unknown;
+    }
+    return *this;
+}
+
+Binder&
+Binder::use(GLuint program)
+{
+    if (m_program != program)
+    {
+        glUseProgram(program);
+        m_program = program;
+        ++m_stats.calls;
+    }
+    else
+    {
+        ++m_stats.skipped;
+    }
+    return *this;
+}
+
+Binder&
+Binder::forget(GLuint program)
+{
+    if (m_program == program)
+        m_program = Unknown;
+    return *this;
+}
+
+Binder&
+Binder::invalidate()
+{
+    m_program = Unknown;
+    m_activeUnit = Unknown;
+    m_textureUnits.fill({});
+    m_boundVao = Unknown;
+    m_boundVbo = Unknown;
+    m_boundIbo = Unknown;
+    return *this;
+}
+
+Binder::Stats
+Binder::takeStats()
+{
+    Stats stats = m_stats;
+    m_stats = {};
+    return stats;
+}
+
 Binder&
 Binder::bindVAO(GLuint id)
 {
@@ -83,8 +189,13 @@ Binder::bindVAO(GLuint id)
     {
         glBindVertexArray(id);
         m_boundVao = id;
-        m_boundVbo = 0u;
-        m_boundIbo = 0u;
+        m_boundVbo = Unknown;
+        m_boundIbo = Unknown;
+        ++m_stats.calls;
+    }
+    else
+    {
+        ++m_stats.skipped;
     }
     return *this;
 }
@@ -92,25 +203,30 @@ Binder::bindVAO(GLuint id)
 Binder&
 Binder::bindVBO(Buffer::TargetHint target, GLuint id)
 {
-    glBindBuffer(static_cast<GLenum>(target), id);
+    GLuint *bound;
     switch (target)
     {
     case Buffer::TargetHint::Array:
-        if (m_boundVbo != id)
-        {
-            m_boundVbo = id;
-            glBindBuffer(GL_ARRAY_BUFFER, id);
-        }
+        bound = &m_boundVbo;
         break;
     case Buffer::TargetHint::ElementArray:
-        if (m_boundIbo != id)
-        {
-            m_boundIbo = id;
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, id);
-        }
+        bound = &m_boundIbo;
         break;
     default:
-        break;
+        glBindBuffer(static_cast<GLenum>(target), id);
+        ++m_stats.calls;
+        return *this;
+    }
+
+    if (*bound != id)
+    {
+        glBindBuffer(static_cast<GLenum>(target), id);
+        *bound = id;
+        ++m_stats.calls;
+    }
+    else
+    {
+        ++m_stats.skipped;
     }
     return *this;
 }
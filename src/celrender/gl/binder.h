@@ -11,6 +11,8 @@
 
 #pragma once
 
+#include <array>
+
 #include <celengine/glsupport.h>
 
 #include "buffer.h"
@@ -40,6 +42,18 @@ public:
      */
     Binder &bind(const Buffer &bo);
 
+    /**
+     * @brief Bind a buffer by its name.
+     *
+     * For buffers that are not wrapped in a Buffer. Binding them directly
+     * would leave the Binder with a stale idea of the current binding.
+     *
+     * @param target a target to bind the buffer to.
+     * @param id an OpenGL buffer name, or 0 for none.
+     * @return self
+     */
+    Binder &bind(Buffer::TargetHint target, GLuint id);
+
     /**
      * @brief Unbind the currently bound Buffer.
      *
@@ -81,6 +95,76 @@ public:
      */
     Binder &unbind(Buffer::TargetHint target);
 
+    /**
+     * @brief Select the texture unit that bindTexture() binds to.
+     *
+     * @param unit a texture unit index, starting at 0.
+     * @return self
+     */
+    Binder &activeTexture(unsigned int unit);
+
+    /**
+     * @brief Bind a texture to the active texture unit.
+     *
+     * Bindings to GL_TEXTURE_2D and GL_TEXTURE_CUBE_MAP on the first
+     * MaxTextureUnits units are tracked, others are always made.
+     *
+     * @param target a texture target, e.g. GL_TEXTURE_2D.
+     * @param id an OpenGL texture name, or 0 for none.
+     * @return self
+     */
+    Binder &bindTexture(GLenum target, GLuint id);
+
+    /**
+     * @brief Forget a texture that is about to be deleted.
+     *
+     * @param id an OpenGL texture name.
+     * @return self
+     */
+    Binder &forgetTexture(GLuint id);
+
+    /**
+     * @brief Make a program current.
+     *
+     * @param program an OpenGL program name, or 0 for none.
+     * @return self
+     */
+    Binder &use(GLuint program);
+
+    /**
+     * @brief Forget a deleted program.
+     *
+     * @param program an OpenGL program name.
+     * @return self
+     */
+    Binder &forget(GLuint program);
+
+    /**
+     * @brief Forget all bindings.
+     *
+     * Forget the current program and bindings, so that the next calls
+     * set them whatever they are. Used when other code may have changed
+     * them behind the Binder's back, e.g. between frames.
+     *
+     * @return self
+     */
+    Binder &invalidate();
+
+    //! Number of binding calls made to OpenGL and skipped as redundant.
+    struct Stats
+    {
+        unsigned int calls{ 0 };
+        unsigned int skipped{ 0 };
+    };
+
+    /**
+     * @brief Return the binding calls counted since the last call and
+     * restart counting.
+     *
+     * @return counts of the calls made and skipped
+     */
+    Stats takeStats();
+
     //! Destructor.
     ~Binder() = default;
 
@@ -102,9 +186,25 @@ private:
     Binder &bindVAO(GLuint id);
     Binder &bindVBO(Buffer::TargetHint target, GLuint id);
 
+    //! Binding that is not known, never equal to a name.
+    static constexpr GLuint Unknown = ~0u;
+
+    //! Number of texture units whose bindings are tracked.
+    static constexpr unsigned int MaxTextureUnits = 8;
+
+    struct TextureUnit
+    {
+        GLuint texture2D{ Unknown };
+        GLuint textureCube{ Unknown };
+    };
+
     GLuint m_boundVbo{ 0 };
     GLuint m_boundIbo{ 0 };
     GLuint m_boundVao{ 0 };
+    GLuint m_program{ Unknown };
+    unsigned int m_activeUnit{ Unknown };
+    std::array<TextureUnit, MaxTextureUnits> m_textureUnits;
+    Stats m_stats;
 };
 
 }
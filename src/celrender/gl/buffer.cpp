@@ -9,12 +9,22 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <cstddef>
+
 #include "binder.h"
 #include "buffer.h"
 
 namespace celestia::gl
 {
 
+namespace
+{
+
+// Size of the data of all buffers not wrapped
+std::size_t totalBufferSize = 0;
+
+} // end unnamed namespace
+
 Buffer::Buffer(util::NoCreateT)
 {
 }
@@ -67,8 +77,10 @@ Buffer::destroy() noexcept
     {
         unbind(); // bind operations for wrapped buffers are performed externally
         glDeleteBuffers(1, &m_id);
+        totalBufferSize -= static_cast<std::size_t>(m_bufferSize);
     }
     m_id = 0;
+    m_bufferSize = 0;
 }
 
 void
@@ -102,6 +114,8 @@ Buffer::unbind(Buffer::TargetHint target)
 Buffer&
 Buffer::setData(util::array_view<const void> data, Buffer::BufferUsage usage)
 {
+    if (!m_wrapped)
+        totalBufferSize += data.size() - static_cast<std::size_t>(m_bufferSize);
     m_bufferSize = data.size();
     m_usage = usage;
     Binder::get().bind(*this);
@@ -139,4 +153,10 @@ Buffer::wrap(GLuint id, Buffer::TargetHint targetHint)
     return bo;
 }
 
+std::size_t
+Buffer::totalSize()
+{
+    return totalBufferSize;
+}
+
 } // namespace celestia::gl
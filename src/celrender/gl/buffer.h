@@ -11,6 +11,8 @@
 
 #pragma once
 
+#include <cstddef>
+
 #include <celengine/glsupport.h>
 #include <celutil/array_view.h>
 #include <celutil/nocreate.h>
@@ -147,6 +149,9 @@ public:
     //! Wrap an existing OpenGL buffer. @see @ref TargetHint @ref Buffer(TargetHint)
     static Buffer wrap(GLuint id, TargetHint targetHint = TargetHint::Array);
 
+    //! Return the size in bytes of the data of all buffers, not including wrapped ones.
+    static std::size_t totalSize();
+
 private:
     //! Reset object to initial state
     void clear();
@@ -0,0 +1,38 @@
+// fence.cpp
+//
+// Copyright (C) 2024-present, Celestia Development Team.
+//
+// Bounded waits for sync objects.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "fence.h"
+
+namespace celestia::gl
+{
+
+#ifndef GL_ES
+namespace
+{
+
+constexpr GLuint64 FenceTimeout = 1000000;
+constexpr int MaxFenceWaits = 1000;
+
+} // namespace
+
+bool
+waitForFence(GLsync fence)
+{
+    for (int i = 0; i < MaxFenceWaits; ++i)
+    {
+        if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FenceTimeout) != GL_TIMEOUT_EXPIRED)
+            return true;
+    }
+    return false;
+}
+#endif
+
+} // namespace celestia::gl
@@ -0,0 +1,32 @@
+// fence.h
+//
+// Copyright (C) 2024-present, Celestia Development Team.
+//
+// Bounded waits for sync objects.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <celengine/glsupport.h>
+
+namespace celestia::gl
+{
+
+#ifndef GL_ES
+/**
+ * @brief Wait for a fence to be signaled.
+ *
+ * Flushes the commands before the fence and waits for them to complete, in
+ * steps of 1 ms so that a lost fence can't hang the renderer.
+ *
+ * @param fence the fence to wait for.
+ * @return false if the fence was still unsignaled after about a second.
+ */
+bool waitForFence(GLsync fence);
+#endif
+
+} // namespace celestia::gl
@@ -0,0 +1,115 @@
+// streambuffer.cpp
+//
+// Copyright (C) 2024-present, Celestia Development Team.
+//
+// Ring buffer for vertex data uploaded every frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "streambuffer.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "fence.h"
+
+namespace celestia::gl
+{
+
+namespace
+{
+
+#ifndef GL_ES
+constexpr GLbitfield PersistentMapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+#endif
+
+} // namespace
+
+StreamBuffer::StreamBuffer(GLsizeiptr sectionSize) :
+    m_sectionSize(sectionSize)
+{
+    GLsizeiptr size = m_sectionSize * SectionCount;
+    m_buffer.bind();
+#ifndef GL_ES
+    if (gl::hasBufferStorage())
+    {
+        glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, PersistentMapFlags);
+        m_mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, PersistentMapFlags);
+        if (m_mapped != nullptr)
+            return;
+
+        // Immutable storage can't be respecified, start over
+        m_buffer = Buffer();
+    }
+#endif
+    m_buffer.setData(util::array_view<const void>(nullptr, size), Buffer::BufferUsage::StreamDraw);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+#ifndef GL_ES
+    for (GLsync fence : m_fences)
+    {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+    }
+#endif
+    // Deleting the buffer also unmaps it
+}
+
+GLintptr
+StreamBuffer::write(util::array_view<const void> data, GLsizeiptr alignment)
+{
+    assert(alignment > 0 && alignment <= MaxAlignment);
+
+    auto size = static_cast<GLsizeiptr>(data.size());
+    if (size > maxWriteSize())
+        return -1;
+
+    GLintptr offset = (m_offset + alignment - 1) / alignment * alignment;
+    if (offset + size > (m_section + 1) * m_sectionSize)
+    {
+        nextSection();
+        offset = (m_offset + alignment - 1) / alignment * alignment;
+    }
+
+    m_buffer.bind();
+    if (m_mapped != nullptr)
+        std::memcpy(static_cast<std::uint8_t*>(m_mapped) + offset, data.data(), data.size());
+    else
+        m_buffer.setSubData(offset, data);
+
+    m_offset = offset + size;
+    return offset;
+}
+
+void
+StreamBuffer::nextSection()
+{
+#ifndef GL_ES
+    if (m_mapped != nullptr)
+        m_fences[m_section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+
+    m_section = (m_section + 1) % SectionCount;
+    m_offset = m_section * m_sectionSize;
+
+#ifndef GL_ES
+    if (GLsync fence = m_fences[m_section]; fence != nullptr)
+    {
+        waitForFence(fence);
+        glDeleteSync(fence);
+        m_fences[m_section] = nullptr;
+    }
+#endif
+
+    // Without fences, give the driver fresh memory once the ring wraps
+    if (m_mapped == nullptr && m_section == 0)
+        m_buffer.invalidateData();
+}
+
+} // namespace celestia::gl
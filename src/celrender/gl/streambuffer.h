@@ -0,0 +1,122 @@
+// streambuffer.h
+//
+// Copyright (C) 2024-present, Celestia Development Team.
+//
+// Ring buffer for vertex data uploaded every frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+
+#include <celengine/glsupport.h>
+#include <celutil/array_view.h>
+
+#include "buffer.h"
+
+namespace celestia::gl
+{
+
+/**
+ * @brief Streaming vertex buffer.
+ *
+ * A fixed size vertex buffer shared by renderers that upload new geometry
+ * every frame. Data is appended to one of three sections; when a section is
+ * full the next one is reused, so the driver never has to allocate new
+ * buffer memory.
+ *
+ * With GL_ARB_buffer_storage the buffer is persistently mapped and a fence
+ * placed when a section is left guards it against being overwritten while
+ * the GPU still reads from it. Otherwise data is uploaded with
+ * glBufferSubData and the buffer is orphaned each time the ring wraps.
+ *
+ * The id of the underlying buffer never changes, so vertex objects can be
+ * set up once with @ref buffer() and drawn with first vertex
+ * offset / stride, where offset is the value returned by @ref write().
+ */
+class StreamBuffer
+{
+public:
+    //! Largest alignment accepted by @ref write().
+    static constexpr GLsizeiptr MaxAlignment = 256;
+
+    /**
+     * @brief Construct a new StreamBuffer object.
+     *
+     * Create C++ and OpenGL objects.
+     *
+     * @param sectionSize Size of each of the three sections in bytes.
+     */
+    explicit StreamBuffer(GLsizeiptr sectionSize);
+
+    //! Copying is prohibited.
+    StreamBuffer(const StreamBuffer&) = delete;
+
+    //! Destructor.
+    ~StreamBuffer();
+
+    //! Copying is prohibited.
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    /**
+     * @brief Append data to the ring.
+     *
+     * The buffer is left bound to the array buffer target.
+     *
+     * @param data Data.
+     * @param alignment Alignment of the returned offset, usually the vertex
+     *                  stride. Must not exceed @ref MaxAlignment.
+     * @return Offset of the data in bytes, or -1 if the data is larger than
+     *         @ref maxWriteSize().
+     */
+    GLintptr write(util::array_view<const void> data, GLsizeiptr alignment);
+
+    //! Return the size of the largest block @ref write() accepts.
+    GLsizeiptr maxWriteSize() const;
+
+    //! Return the underlying buffer to set up vertex objects with.
+    const Buffer& buffer() const;
+
+    //! Return whether the buffer is persistently mapped.
+    bool isPersistent() const;
+
+private:
+    static constexpr int SectionCount = 3;
+
+    //! Move on to the next section, waiting until the GPU is done with it
+    void nextSection();
+
+    Buffer m_buffer;
+    GLsizeiptr m_sectionSize;
+    GLintptr m_offset{ 0 };
+    int m_section{ 0 };
+
+    //! Persistently mapped memory, nullptr with glBufferSubData uploads
+    void* m_mapped{ nullptr };
+    //! Fences placed when each section was last left
+    std::array<GLsync, SectionCount> m_fences{};
+};
+
+inline GLsizeiptr
+StreamBuffer::maxWriteSize() const
+{
+    return m_sectionSize - MaxAlignment;
+}
+
+inline const Buffer&
+StreamBuffer::buffer() const
+{
+    return m_buffer;
+}
+
+inline bool
+StreamBuffer::isPersistent() const
+{
+    return m_mapped != nullptr;
+}
+
+} // namespace celestia::gl
@@ -45,6 +45,7 @@ public:
         UnsignedInt     = GL_UNSIGNED_INT,
         Half            = GL_HALF_FLOAT,
         Float           = GL_FLOAT,
+        Int2101010Rev   = GL_INT_2_10_10_10_REV,
     };
 
     /**
@@ -152,6 +153,37 @@ public:
      */
     VertexObject& draw(Primitive primitive, int count, int first = 0);
 
+    /**
+     * @brief Render several instances of the VertexObject.
+     *
+     * Render VertexObject using a default primitive. Requires instanced
+     * arrays, see gl::hasInstancedArrays().
+     *
+     * @param count Number of vertices to draw per instance.
+     * @param instanceCount Number of instances to draw.
+     * @param first First vertex to draw.
+     * @return Reference to self.
+     *
+     * @see @ref addVertexBuffer()
+     */
+    VertexObject& drawInstanced(int count, int instanceCount, int first = 0);
+
+    /**
+     * @brief Render several instances of the VertexObject.
+     *
+     * Render VertexObject using a primitive provided. Requires instanced
+     * arrays, see gl::hasInstancedArrays().
+     *
+     * @param primitive Primitive.
+     * @param count Number of vertices to draw per instance.
+     * @param instanceCount Number of instances to draw.
+     * @param first First vertex to draw.
+     * @return Reference to self.
+     *
+     * @see @ref addVertexBuffer()
+     */
+    VertexObject& drawInstanced(Primitive primitive, int count, int instanceCount, int first = 0);
+
     /**
      * @brief Set the primitive.
      *
@@ -212,11 +244,13 @@ public:
      * @param stride Offset in bytes between consecutive generic vertex attributes. If stride is 0,
      * the generic vertex attributes are understood to be tightly packed in the array.
      * @param offset Offset of the first component of the first generic vertex attribute in the array.
+     * @param divisor Number of instances drawn with each attribute value, or 0 to advance the
+     * attribute per vertex. Nonzero values require instanced arrays.
      * @return Reference to self.
      *
-     * @see @ref DataType
+     * @see @ref DataType @ref drawInstanced()
      */
-    VertexObject& addVertexBuffer(const Buffer &buffer, int location, int elemSize, DataType type, bool normalized = false, int stride = 0, std::ptrdiff_t offset = 0);
+    VertexObject& addVertexBuffer(const Buffer &buffer, int location, int elemSize, DataType type, bool normalized = false, int stride = 0, std::ptrdiff_t offset = 0, int divisor = 0);
 
     /**
      * @brief Add index buffer. The buffer is not owned by VertexObject.
@@ -18,6 +18,7 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
+#include <celcompat/numbers.h>
 #include <celengine/globular.h>
 #include <celengine/glsupport.h>
 #include <celengine/render.h>
@@ -26,6 +27,7 @@
 #include <celimage/pixelformat.h>
 #include <celmath/geomutil.h>
 #include <celmath/randutils.h>
+#include <celrender/gl/binder.h>
 #include <celrender/gl/buffer.h>
 #include <celrender/gl/vertexobject.h>
 #include <celutil/color.h>
@@ -54,6 +56,17 @@ constexpr float P1 = 65.0f, P2 = 0.75f;
 
 constexpr float kSpriteScaleFactor = 1.0f/1.25f;
 
+// Level of detail: clusters smaller than kImpostorDiskSize pixels are drawn
+// with the central cloud sprite only, larger ones with a prefix of the star
+// template that grows in power of two tiers from kMinLodPoints with the
+// projected area, at roughly kLodPointsPerPixel stars per pixel.
+constexpr float kImpostorDiskSize = 4.0f;
+constexpr float kLodPointsPerPixel = 1.0f;
+constexpr unsigned int kMinLodPoints = 128u;
+
+// Each form occupies the tidal quad and its star template in the shared buffer
+constexpr unsigned int kFormVertices = 4u + kGlobularPoints;
+
 float RRatio, XI; // TODO: get rid of these global variables
 
 /// Globular Form
@@ -70,9 +83,6 @@ struct GlobularForm
     using BlobVector = std::vector<Blob>;
 
     std::vector<Blob> gblobs{ };
-    mutable gl::Buffer bo{ util::NoCreateT{} };
-    mutable gl::VertexObject vo{ util::NoCreateT{} };
-    mutable bool GLDataInitialized{ false };
 };
 
 /// GlobularForm Manager
@@ -86,6 +96,7 @@ public:
     }
 
     const GlobularForm* getForm(int) const;
+    gl::VertexObject& getVertexObject();
     Texture* getCenterTex(int);
     Texture* getGlobularTex();
     Texture* getColorTex();
@@ -96,6 +107,10 @@ private:
     void initializeForms();
 
     std::array<GlobularForm, Globular::GlobularBuckets> globularForms{ };
+    // All forms share one vertex buffer, form i starts at i * kFormVertices
+    gl::Buffer bo{ util::NoCreateT{} };
+    gl::VertexObject vo{ util::NoCreateT{} };
+    bool GLDataInitialized{ false };
     std::array<Texture*, Globular::GlobularBuckets> centerTex{ };
     std::unique_ptr<Texture> globularTex{ nullptr };
     std::unique_ptr<Texture> colorTex{ nullptr };
@@ -202,17 +217,18 @@ colorTextureEval(float u, float /*v*/, float /*w*/, std::uint8_t *pixel)
     }
 }
 
-void
-initGlobularData(gl::Buffer &bo, gl::VertexObject &vo, const GlobularForm::BlobVector &points)
+struct GlobularVtx
 {
-    struct GlobularVtx
-    {
-        Eigen::Matrix<short, 3, 1> position;
-        std::array<std::uint8_t, 3> texCoord; // reuse it for starSize, relStarDensity and colorIndex
-    };
+    Eigen::Matrix<short, 3, 1> position;
+    std::array<std::uint8_t, 3> texCoord; // reuse it for starSize, relStarDensity and colorIndex
+};
 
-    std::vector<GlobularVtx> globularVtx;
-    globularVtx.reserve(4 + points.size());
+void
+addGlobularVertices(std::vector<GlobularVtx> &globularVtx, const GlobularForm::BlobVector &points, float c)
+{
+    // relStarDensity depends on the form's concentration
+    RRatio = std::pow(10.0f, c);
+    XI = 1.0f / std::sqrt(1.0f + RRatio * RRatio);
 
     // Reuse the buffer for a tidal. Tidal uses color index 0.
     globularVtx.push_back({{-32767, -32767, 0}, {  0,   0, 0}});
@@ -259,6 +275,20 @@ initGlobularData(gl::Buffer &bo, gl::VertexObject &vo, const GlobularForm::BlobV
 
         globularVtx.push_back(vtx);
     }
+}
+
+void
+initGlobularData(gl::Buffer &bo, gl::VertexObject &vo, const std::array<GlobularForm, Globular::GlobularBuckets> &forms)
+{
+    std::vector<GlobularVtx> globularVtx;
+    globularVtx.reserve(forms.size() * kFormVertices);
+
+    for (unsigned int ic = 0; ic < forms.size(); ++ic)
+    {
+        assert(forms[ic].gblobs.size() == kGlobularPoints);
+        float cbin = Globular::MinC + (0.5f + static_cast<float>(ic)) * Globular::BinWidth;
+        addGlobularVertices(globularVtx, forms[ic].gblobs, cbin);
+    }
 
     bo = gl::Buffer(gl::Buffer::TargetHint::Array, globularVtx);
     vo = gl::VertexObject(gl::VertexObject::Primitive::Points);
@@ -397,6 +427,17 @@ GlobularFormManager::getForm(int form) const
         : nullptr;
 }
 
+gl::VertexObject&
+GlobularFormManager::getVertexObject()
+{
+    if (!GLDataInitialized)
+    {
+        initGlobularData(bo, vo, globularForms);
+        GLDataInitialized = true;
+    }
+    return vo;
+}
+
 Texture*
 GlobularFormManager::getCenterTex(int form)
 {
@@ -496,6 +537,19 @@ CalculateSpriteCount(const GlobularForm* form, float detail, float starSize, flo
     return nPoints;
 }
 
+int
+CalculateLodPointCount(float diskSizeInPixels)
+{
+    if (diskSizeInPixels < kImpostorDiskSize)
+        return 0;
+
+    float visiblePoints = celestia::numbers::pi_v<float> * diskSizeInPixels * diskSizeInPixels * kLodPointsPerPixel;
+    unsigned int nPoints = kMinLodPoints;
+    while (nPoints < kGlobularPoints && static_cast<float>(nPoints) < visiblePoints)
+        nPoints <<= 1;
+    return static_cast<int>(std::min(nPoints, kGlobularPoints));
+}
+
 } // anonymous namespace
 
 struct GlobularRenderer::Object
@@ -553,7 +607,7 @@ GlobularRenderer::render()
 
     GlobularFormManager* globularFormManager = GlobularFormManager::get();
 
-    glActiveTexture(GL_TEXTURE0);
+    gl::Binder::get().activeTexture(0);
     globularFormManager->getColorTex()->bind();
 
     Renderer::PipelineState ps;
@@ -575,7 +629,7 @@ GlobularRenderer::render()
     glDisable(GL_POINT_SPRITE);
     glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
 #endif
-    glActiveTexture(GL_TEXTURE0);
+    gl::Binder::get().activeTexture(0);
 }
 
 void
@@ -618,6 +672,10 @@ GlobularRenderer::renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *gl
      * center value of (ic+1)th c-bin
      */
 
+    // Building the shared vertex buffer changes RRatio and XI, so do it first
+    gl::VertexObject &vo = globularFormManager->getVertexObject();
+    auto baseVertex = static_cast<int>(static_cast<unsigned int>(globular->getFormId()) * kFormVertices);
+
     float cbin = Globular::MinC
            + (static_cast<float>(globular->getFormId()) + 0.5f) * Globular::BinWidth;
 
@@ -630,15 +688,7 @@ GlobularRenderer::renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *gl
      * distance from center or resolution increases sufficiently.
      */
 
-    gl::VertexObject &vo = form->vo;
-
-    if (!form->GLDataInitialized)
-    {
-        initGlobularData(form->bo, vo, form->gblobs);
-        form->GLDataInitialized = true;
-    }
-
-    glActiveTexture(GL_TEXTURE1);
+    gl::Binder::get().activeTexture(1);
     globularFormManager->getCenterTex(obj.globular->getFormId())->bind();
 
     Eigen::Matrix4f mv = math::translate(m_renderer.getModelViewMatrix(), obj.offset);
@@ -657,7 +707,12 @@ GlobularRenderer::renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *gl
     tidalProg->samplerParam("colorTex")  = 0;
     tidalProg->samplerParam("tidalTex")  = 1;
 
-    vo.draw(gl::VertexObject::Primitive::TriangleFan, 4);
+    vo.draw(gl::VertexObject::Primitive::TriangleFan, 4, baseVertex);
+
+    int nPoints = std::min(CalculateLodPointCount(diskSizeInPixels),
+                           CalculateSpriteCount(form, globular->getDetail(), obj.brightness, minimumFeatureSize));
+    if (nPoints == 0)
+        return;
 
     /*! Next, render globular cluster via distinct "star" sprites (globularTex)
      * for sufficiently large resolution and distance from center of globular.
@@ -665,7 +720,7 @@ GlobularRenderer::renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *gl
      * This RGBA texture fades away when resolution decreases (e.g. via automag!),
      * or when distance from globular center decreases.
      */
-    glActiveTexture(GL_TEXTURE2);
+    gl::Binder::get().activeTexture(2);
     GlobularFormManager::get()->getGlobularTex()->bind();
 
     Eigen::Matrix3f mx = obj.globular->getOrientation().conjugate().toRotationMatrix() * Eigen::Scaling(tidalSize);
@@ -684,7 +739,7 @@ GlobularRenderer::renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *gl
     globProg->samplerParam("colorTex")  = 0;
     globProg->samplerParam("starTex")   = 2;
 
-    vo.draw(gl::VertexObject::Primitive::Points, CalculateSpriteCount(form, globular->getDetail(), obj.brightness, minimumFeatureSize), 4);
+    vo.draw(gl::VertexObject::Primitive::Points, nPoints, baseVertex + 4);
 }
 
 } // namespace celestia::render
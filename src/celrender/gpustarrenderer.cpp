@@ -0,0 +1,162 @@
+// gpustarrenderer.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstddef>
+#include <vector>
+
+#include <celengine/glsupport.h>
+#include <celengine/render.h>
+#include <celengine/shadermanager.h>
+#include <celengine/star.h>
+#include <celengine/stardb.h>
+#include <celengine/texture.h>
+#include <celrender/gl/buffer.h>
+#include <celrender/gl/vertexobject.h>
+#include "gpustarrenderer.h"
+
+namespace celestia::render
+{
+namespace
+{
+
+struct StarVertex
+{
+    Eigen::Vector3f position;
+    float absMag;
+    float extinction;
+    unsigned char color[4];
+};
+
+std::vector<StarVertex>
+buildVertices(const StarDatabase &starDB, const ColorTemperatureTable &colorTemp, const StarOctree::ObjectRange &range)
+{
+    std::vector<StarVertex> vertices(range.count);
+    for (std::uint32_t i = 0; i < range.count; ++i)
+    {
+        const Star *star = starDB.getStar(range.first + i);
+        StarVertex &vertex = vertices[i];
+        vertex.position = star->getPosition();
+        vertex.absMag = star->getAbsoluteMagnitude();
+        vertex.extinction = star->getExtinction();
+        colorTemp.lookupColor(star->getTemperature()).get(vertex.color);
+    }
+
+    return vertices;
+}
+
+} // anonymous namespace
+
+GPUStarRenderer::GPUStarRenderer(Renderer &renderer) :
+    m_renderer(renderer)
+{
+}
+
+GPUStarRenderer::~GPUStarRenderer() = default;
+
+void
+GPUStarRenderer::upload(const CelestiaGLProgram *prog, const StarDatabase &starDB, const ColorTemperatureTable &colorTemp)
+{
+    if (m_bo != nullptr &&
+        m_starDB == &starDB &&
+        m_nStars == starDB.size() &&
+        m_colorTableType == colorTemp.type())
+    {
+        if (m_starMotionEpoch == starDB.getStarMotionEpoch())
+            return;
+
+        // Only the moving stars changed, copy just their range again
+        m_starMotionEpoch = starDB.getStarMotionEpoch();
+        auto range = starDB.getMovingStarRange();
+        if (range.count > 0)
+        {
+            auto vertices = buildVertices(starDB, colorTemp, range);
+            m_bo->bind().setSubData(static_cast<GLintptr>(range.first) * sizeof(StarVertex), vertices);
+        }
+        return;
+    }
+
+    m_starDB = &starDB;
+    m_nStars = starDB.size();
+    m_colorTableType = colorTemp.type();
+    m_starMotionEpoch = starDB.getStarMotionEpoch();
+
+    auto vertices = buildVertices(starDB, colorTemp, { 0, m_nStars });
+
+    if (m_bo == nullptr)
+    {
+        m_bo = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array, vertices);
+        m_vo = std::make_unique<gl::VertexObject>(gl::VertexObject::Primitive::Points);
+
+        m_vo->addVertexBuffer(
+            *m_bo, CelestiaGLProgram::VertexCoordAttributeIndex,
+            3, gl::VertexObject::DataType::Float,
+            false, sizeof(StarVertex), offsetof(StarVertex, position));
+        m_vo->addVertexBuffer(
+            *m_bo, CelestiaGLProgram::ColorAttributeIndex,
+            4, gl::VertexObject::DataType::UnsignedByte,
+            true, sizeof(StarVertex), offsetof(StarVertex, color));
+        m_vo->addVertexBuffer(
+            *m_bo, prog->attribIndex("in_AbsMag"),
+            1, gl::VertexObject::DataType::Float,
+            false, sizeof(StarVertex), offsetof(StarVertex, absMag));
+        m_vo->addVertexBuffer(
+            *m_bo, prog->attribIndex("in_Extinction"),
+            1, gl::VertexObject::DataType::Float,
+            false, sizeof(StarVertex), offsetof(StarVertex, extinction));
+    }
+    else
+    {
+        m_bo->invalidateData().setData(vertices);
+    }
+}
+
+bool
+GPUStarRenderer::render(const StarDatabase &starDB,
+                        const ColorTemperatureTable &colorTemp,
+                        util::array_view<StarOctree::ObjectRange> ranges,
+                        const Parameters &params,
+                        Texture *discTexture,
+                        Texture *glareTexture)
+{
+    auto *prog = m_renderer.getShaderManager().getShader("starcatalog");
+    if (prog == nullptr)
+        return false;
+
+    upload(prog, starDB, colorTemp);
+
+    prog->use();
+    prog->setMVPMatrices(m_renderer.getCurrentProjectionMatrix(), m_renderer.getCurrentModelViewMatrix());
+    prog->samplerParam("starTex") = 0;
+    prog->vec3Param("obsPos") = params.obsPosition;
+    prog->floatParam("faintestMag") = params.faintestMag;
+    prog->floatParam("limitingMag") = params.limitingMag;
+    prog->floatParam("brightnessScale") = params.brightnessScale;
+    prog->floatParam("brightnessBias") = params.brightnessBias;
+    prog->floatParam("satPoint") = params.saturationMag;
+    prog->floatParam("baseSize") = params.baseSize;
+    prog->floatParam("minDistance") = params.minDistance;
+    prog->floatParam("maxDistance") = params.maxDistance;
+    prog->intParam("scaledDiscs") = params.scaledDiscs ? 1 : 0;
+
+    // The glare pass only draws the stars bright enough to have a glare
+    for (int glare = 1; glare >= 0; --glare)
+    {
+        Texture *texture = glare != 0 ? glareTexture : discTexture;
+        if (texture != nullptr)
+            texture->bind();
+
+        prog->intParam("glare") = glare;
+        for (const auto &range : ranges)
+            m_vo->draw(static_cast<int>(range.count), static_cast<int>(range.first));
+    }
+
+    return true;
+}
+
+} // namespace celestia::render
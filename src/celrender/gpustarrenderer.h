@@ -0,0 +1,93 @@
+// gpustarrenderer.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Renders the distant stars of a star catalog from GPU buffers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <Eigen/Core>
+
+#include <celengine/starcolors.h>
+#include <celengine/staroctree.h>
+#include <celutil/array_view.h>
+
+class CelestiaGLProgram;
+class Renderer;
+class StarDatabase;
+class Texture;
+
+namespace celestia::gl
+{
+class Buffer;
+class VertexObject;
+} // namespace celestia::gl
+
+namespace celestia::render
+{
+
+// GPUStarRenderer keeps a copy of the positions, magnitudes and colors of a
+// star database in a vertex buffer, which is only uploaded again when the
+// database or the color table change; when the stars have moved, only the
+// range of moving stars is copied again. Each frame only the ranges of stars
+// left after octree node culling are drawn; the apparent magnitude, point
+// size and opacity of each star are computed in the vertex shader, using the
+// same rules as Renderer::calculatePointSize.
+class GPUStarRenderer
+{
+public:
+    struct Parameters
+    {
+        Eigen::Vector3f obsPosition;
+        float faintestMag;
+        float limitingMag;
+        float brightnessScale;
+        float brightnessBias;
+        float saturationMag;
+        float baseSize;
+        // Stars closer than minDistance or further than maxDistance are not
+        // drawn; the closest stars need more care than a point sprite.
+        float minDistance;
+        float maxDistance;
+        bool scaledDiscs;
+    };
+
+    explicit GPUStarRenderer(Renderer &renderer);
+    ~GPUStarRenderer();
+
+    GPUStarRenderer(const GPUStarRenderer&) = delete;
+    GPUStarRenderer& operator=(const GPUStarRenderer&) = delete;
+
+    // Returns false if the stars could not be drawn, e.g. because the shader
+    // is not available, in which case no GL state has been changed.
+    bool render(const StarDatabase &starDB,
+                const ColorTemperatureTable &colorTemp,
+                util::array_view<StarOctree::ObjectRange> ranges,
+                const Parameters &params,
+                Texture *discTexture,
+                Texture *glareTexture);
+
+private:
+    void upload(const CelestiaGLProgram *prog, const StarDatabase &starDB, const ColorTemperatureTable &colorTemp);
+
+    Renderer &m_renderer;
+
+    std::unique_ptr<gl::Buffer> m_bo;
+    std::unique_ptr<gl::VertexObject> m_vo;
+
+    // Identifies the uploaded data
+    const StarDatabase *m_starDB{ nullptr };
+    std::uint32_t m_nStars{ 0 };
+    ColorTableType m_colorTableType{ ColorTableType::Enhanced };
+    double m_starMotionEpoch{ 0.0 };
+};
+
+} // namespace celestia::render
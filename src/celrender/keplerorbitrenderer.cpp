@@ -0,0 +1,190 @@
+// keplerorbitrenderer.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Instanced rendering of elliptical orbit paths.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "keplerorbitrenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include <celengine/glsupport.h>
+#include <celengine/render.h>
+#include <celengine/shadermanager.h>
+#include <celephem/orbit.h>
+
+namespace celestia::render
+{
+namespace
+{
+
+// Same as the width of sampled orbit paths
+constexpr float OrbitThickness = 1.0f;
+
+// Rounding error of positions in camera space, relative to their size
+constexpr double FloatError = 2.0e-7;
+
+float
+lineWidth(const Renderer &renderer)
+{
+    float width = OrbitThickness * renderer.getScaleFactor();
+    if ((renderer.getRenderFlags() & Renderer::ShowSmoothLines) != 0)
+        width *= 1.5f;
+    return width;
+}
+
+} // namespace
+
+KeplerOrbitRenderer::KeplerOrbitRenderer(Renderer &renderer) :
+    m_renderer(renderer)
+{
+}
+
+KeplerOrbitRenderer::~KeplerOrbitRenderer() = default;
+
+bool
+KeplerOrbitRenderer::isSupported() const
+{
+#ifdef GL_ES
+    if (!gl::checkVersion(gl::GLES_3_2))
+        return false;
+#else
+    if (!gl::checkVersion(gl::GL_3_2) || !gl::hasInstancedArrays())
+        return false;
+#endif
+
+    // Lines too wide to rasterize are left to the line renderer, which
+    // turns them into triangles
+    return lineWidth(m_renderer) <= gl::maxLineWidth;
+}
+
+bool
+KeplerOrbitRenderer::add(const ephem::EllipsePath &path,
+                         const Eigen::Affine3d &modelview,
+                         double angularTolerance,
+                         const Eigen::Vector4f &color)
+{
+    Eigen::Vector3d center = modelview * path.center;
+    Eigen::Vector3d majorAxis = modelview.linear() * path.majorAxis;
+    Eigen::Vector3d minorAxis = modelview.linear() * path.minorAxis;
+
+    double a = majorAxis.norm();
+    double b = minorAxis.norm();
+    if (b <= 0.0)
+        return false;
+
+    // Lower bound of the distance from the camera to the ellipse: the
+    // distance to the orbit plane, combined with the distance within the
+    // plane, which is at least b times the distance to the unit circle
+    // after scaling the ellipse into it.
+    Eigen::Vector3d camera = -center;
+    Eigen::Vector3d normal = majorAxis.cross(minorAxis).normalized();
+    double planeDistance = std::abs(camera.dot(normal));
+    double x = camera.dot(majorAxis) / (a * a);
+    double y = camera.dot(minorAxis) / (b * b);
+    double inPlaneDistance = b * std::abs(std::hypot(x, y) - 1.0);
+    double distance = std::hypot(planeDistance, inPlaneDistance);
+
+    // The second derivative of the path with respect to the anomaly is at
+    // most a, which bounds how far a chord strays from the ellipse. The
+    // path is also off by the rounding of the camera space positions.
+    double step = (path.endAnomaly - path.startAnomaly) / static_cast<double>(PathPoints - 1);
+    double chordError = a * step * step / 8.0;
+    double roundingError = FloatError * (center.norm() + a);
+    if (std::max(chordError, roundingError) > angularTolerance * distance)
+        return false;
+
+    auto &instance = m_instances.emplace_back();
+    instance.center = center.cast<float>();
+    instance.majorAxis = majorAxis.cast<float>();
+    instance.minorAxis = minorAxis.cast<float>();
+    instance.anomaly = Eigen::Vector3d(path.startAnomaly, path.endAnomaly, path.eccentricity).cast<float>();
+    instance.color = color;
+
+    return true;
+}
+
+void
+KeplerOrbitRenderer::render(float fadeFraction)
+{
+    if (m_instances.empty())
+        return;
+
+    CelestiaGLProgram *prog = m_renderer.getShaderManager().getShaderGL3("keplerorbit150");
+    if (prog == nullptr)
+    {
+        m_instances.clear();
+        return;
+    }
+
+    initialize();
+
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
+    ps.depthTest = true;
+    ps.depthMask = false;
+    ps.smoothLines = true;
+    m_renderer.setPipelineState(ps);
+
+    glLineWidth(lineWidth(m_renderer));
+
+    // The instances are already in camera space
+    prog->use();
+    prog->setMVPMatrices(m_renderer.getCurrentProjectionMatrix(), Eigen::Matrix4f::Identity());
+    prog->floatParam("fadeFraction") = fadeFraction;
+
+    // Respecifying the whole buffer lets the driver orphan the old storage
+    // instead of waiting for the draw call of the previous depth interval.
+    m_instanceBuffer.setData(m_instances, gl::Buffer::BufferUsage::StreamDraw);
+    m_vo.drawInstanced(PathPoints, static_cast<int>(m_instances.size()));
+
+    m_instances.clear();
+}
+
+void
+KeplerOrbitRenderer::initialize()
+{
+    if (m_initialized)
+        return;
+
+    m_initialized = true;
+
+    const CelestiaGLProgram *prog = m_renderer.getShaderManager().getShaderGL3("keplerorbit150");
+
+    // Position along the path, from 0 at the start to 1 at the end
+    std::vector<float> parameters(PathPoints);
+    for (int i = 0; i < PathPoints; ++i)
+        parameters[i] = static_cast<float>(i) / static_cast<float>(PathPoints - 1);
+
+    m_parameterBuffer = gl::Buffer(gl::Buffer::TargetHint::Array, parameters);
+    m_instanceBuffer = gl::Buffer(gl::Buffer::TargetHint::Array);
+
+    m_vo = gl::VertexObject(gl::VertexObject::Primitive::LineStrip);
+    m_vo.addVertexBuffer(
+        m_parameterBuffer, CelestiaGLProgram::VertexCoordAttributeIndex, 1, gl::VertexObject::DataType::Float);
+    m_vo.addVertexBuffer(
+        m_instanceBuffer, prog->attribIndex("in_Center"), 3, gl::VertexObject::DataType::Float,
+        false, sizeof(Instance), offsetof(Instance, center), 1);
+    m_vo.addVertexBuffer(
+        m_instanceBuffer, prog->attribIndex("in_MajorAxis"), 3, gl::VertexObject::DataType::Float,
+        false, sizeof(Instance), offsetof(Instance, majorAxis), 1);
+    m_vo.addVertexBuffer(
+        m_instanceBuffer, prog->attribIndex("in_MinorAxis"), 3, gl::VertexObject::DataType::Float,
+        false, sizeof(Instance), offsetof(Instance, minorAxis), 1);
+    m_vo.addVertexBuffer(
+        m_instanceBuffer, prog->attribIndex("in_Anomaly"), 3, gl::VertexObject::DataType::Float,
+        false, sizeof(Instance), offsetof(Instance, anomaly), 1);
+    m_vo.addVertexBuffer(
+        m_instanceBuffer, prog->attribIndex("in_Color"), 4, gl::VertexObject::DataType::Float,
+        false, sizeof(Instance), offsetof(Instance, color), 1);
+}
+
+} // namespace celestia::render
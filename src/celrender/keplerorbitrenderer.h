@@ -0,0 +1,91 @@
+// keplerorbitrenderer.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Instanced rendering of elliptical orbit paths.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celrender/gl/buffer.h>
+#include <celrender/gl/vertexobject.h>
+
+class Renderer;
+
+namespace celestia::ephem
+{
+struct EllipsePath;
+}
+
+namespace celestia::render
+{
+
+/*! Draws elliptical orbit paths from their elements instead of from
+ *  sampled curves. Every path is drawn with the same fixed number of
+ *  points spaced evenly in eccentric anomaly, and only the ellipse of each
+ *  path is uploaded, so paths of any number of bodies take a single draw
+ *  call. The points are placed by the vertex shader, which also fades
+ *  their color by the time along the path.
+ *
+ *  Evenly spaced points only approximate the ellipse well when the camera
+ *  is far enough from it; add() rejects the paths that need the adaptive
+ *  sampling of a CurvePlot.
+ */
+class KeplerOrbitRenderer
+{
+public:
+    explicit KeplerOrbitRenderer(Renderer &renderer);
+    ~KeplerOrbitRenderer();
+
+    //! Check whether the GL implementation can draw the paths
+    bool isSupported() const;
+
+    /*! Queue a path for the next render() call. modelview transforms the
+     *  ellipse to camera space; angularTolerance is the largest error
+     *  accepted, in radians. Returns false, without queueing the path, when
+     *  it can't be drawn within the tolerance.
+     */
+    bool add(const ephem::EllipsePath &path,
+             const Eigen::Affine3d &modelview,
+             double angularTolerance,
+             const Eigen::Vector4f &color);
+
+    /*! Draw the queued paths with the current projection and clear them.
+     *  Paths fade in over fadeFraction of their length; pass zero to draw
+     *  them fully opaque.
+     */
+    void render(float fadeFraction);
+
+    //! Number of points each path is drawn with
+    static constexpr int PathPoints = 512;
+
+private:
+    struct Instance
+    {
+        Eigen::Vector3f center;
+        Eigen::Vector3f majorAxis;
+        Eigen::Vector3f minorAxis;
+        Eigen::Vector3f anomaly; // start and end eccentric anomaly, eccentricity
+        Eigen::Vector4f color;
+    };
+
+    void initialize();
+
+    Renderer               &m_renderer;
+    std::vector<Instance>   m_instances;
+    gl::Buffer              m_parameterBuffer{ util::NoCreateT{} };
+    gl::Buffer              m_instanceBuffer{ util::NoCreateT{} };
+    gl::VertexObject        m_vo{ util::NoCreateT{} };
+    bool                    m_initialized{ false };
+};
+
+} // namespace celestia::render
@@ -1,6 +1,12 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
 #include <celengine/glsupport.h>
 #include <celengine/render.h>
+#include <celengine/texture.h>
 #include <celrender/gl/buffer.h>
+#include <celrender/gl/streambuffer.h>
 #include <celrender/gl/vertexobject.h>
 #include <celutil/color.h>
 #include "largestarrenderer.h"
@@ -18,15 +24,46 @@ LargeStarRenderer::LargeStarRenderer(Renderer &renderer) :
 LargeStarRenderer::~LargeStarRenderer() = default;
 
 void
-LargeStarRenderer::render(
+LargeStarRenderer::addStar(
     const Eigen::Vector3f &position,
     const Color           &color,
-    float                  size,
-    const Matrices        &mvp)
+    float                  size)
+{
+    // Two triangles, whose corners the shader finds from the texture
+    // coordinates
+    static constexpr std::array<std::array<float, 2>, 6> corners = {{
+        { 0.0f, 0.0f },
+        { 0.0f, 1.0f },
+        { 1.0f, 1.0f },
+        { 0.0f, 0.0f },
+        { 1.0f, 1.0f },
+        { 1.0f, 0.0f },
+    }};
+
+    StarVertex vertex;
+    vertex.position = position;
+    vertex.size = size;
+    color.get(vertex.color);
+    for (const auto &corner : corners)
+    {
+        vertex.texCoord[0] = corner[0];
+        vertex.texCoord[1] = corner[1];
+        m_vertices.push_back(vertex);
+    }
+}
+
+void
+LargeStarRenderer::render(Texture *texture, const Matrices &mvp)
 {
+    if (m_vertices.empty())
+        return;
+
     auto *prog = m_renderer.getShaderManager().getShader("largestar");
     if (prog == nullptr)
+    {
+        m_vertices.clear();
         return;
+    }
 
     Renderer::PipelineState ps;
     ps.blending = true;
@@ -34,17 +71,27 @@ LargeStarRenderer::render(
     ps.depthTest = true;
     m_renderer.setPipelineState(ps);
 
-    // Draw billboard for large points
+    initialize();
+
     prog->use();
     prog->samplerParam("starTex") = 0;
     prog->setMVPMatrices(*mvp.projection, *mvp.modelview);
-    prog->vec4Param("color") = color.toVector4();
-    prog->vec3Param("center") = position;
-    prog->floatParam("pointWidth") = size / m_renderer.getWindowWidth() * 2.0f;
-    prog->floatParam("pointHeight") = size / m_renderer.getWindowHeight() * 2.0f;
+    prog->vec2Param("viewportScale") = Eigen::Vector2f(2.0f / static_cast<float>(m_renderer.getWindowWidth()),
+                                                       2.0f / static_cast<float>(m_renderer.getWindowHeight()));
+    if (texture != nullptr)
+        texture->bind();
 
-    initialize();
-    m_vo->draw();
+    // Whole billboards per draw if the queue exceeds the stream buffer
+    gl::StreamBuffer &stream = m_renderer.getStreamBuffer();
+    auto maxVertices = static_cast<std::size_t>(stream.maxWriteSize() / sizeof(StarVertex)) / 6 * 6;
+    for (std::size_t first = 0; first < m_vertices.size(); first += maxVertices)
+    {
+        std::size_t count = std::min(m_vertices.size() - first, maxVertices);
+        GLintptr offset = stream.write(util::array_view(m_vertices.data() + first, count),
+                                       sizeof(StarVertex));
+        m_vo->draw(static_cast<int>(count), static_cast<int>(offset / sizeof(StarVertex)));
+    }
+    m_vertices.clear();
 }
 
 void
@@ -55,36 +102,41 @@ LargeStarRenderer::initialize()
 
     m_initialized = true;
 
-    const std::array texCoords = {
-        // offset     // texCoords
-        -0.5f,  0.5f, 0.0f, 0.0f,
-        -0.5f, -0.5f, 0.0f, 1.0f,
-         0.5f, -0.5f, 1.0f, 1.0f,
-        -0.5f,  0.5f, 0.0f, 0.0f,
-         0.5f, -0.5f, 1.0f, 1.0f,
-         0.5f, 0.5f,  1.0f, 0.0f,
-    };
-
-    m_bo = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array, texCoords);
+    const gl::Buffer &bo = m_renderer.getStreamBuffer().buffer();
     m_vo = std::make_unique<gl::VertexObject>();
 
-    m_vo->setCount(6);
     m_vo->addVertexBuffer(
-        *m_bo,
+        bo,
         CelestiaGLProgram::VertexCoordAttributeIndex,
-        2,
+        3,
         gl::VertexObject::DataType::Float,
         false,
-        4 * sizeof(float),
-        0);
+        sizeof(StarVertex),
+        offsetof(StarVertex, position));
     m_vo->addVertexBuffer(
-        *m_bo,
+        bo,
         CelestiaGLProgram::TextureCoord0AttributeIndex,
         2,
         gl::VertexObject::DataType::Float,
         false,
-        4 * sizeof(float),
-        2 * sizeof(float));
+        sizeof(StarVertex),
+        offsetof(StarVertex, texCoord));
+    m_vo->addVertexBuffer(
+        bo,
+        CelestiaGLProgram::PointSizeAttributeIndex,
+        1,
+        gl::VertexObject::DataType::Float,
+        false,
+        sizeof(StarVertex),
+        offsetof(StarVertex, size));
+    m_vo->addVertexBuffer(
+        bo,
+        CelestiaGLProgram::ColorAttributeIndex,
+        4,
+        gl::VertexObject::DataType::UnsignedByte,
+        true,
+        sizeof(StarVertex),
+        offsetof(StarVertex, color));
 }
 
 } // namespace celestia::render
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+
 #include <Eigen/Core>
 
 class Color;
 class Renderer;
+class Texture;
 struct Matrices;
 
 namespace celestia::gl
@@ -19,21 +22,35 @@ class VertexObject;
 namespace celestia::render
 {
 
+// Draws the stars and glares which are too large for point sprites as
+// billboards. They are queued and drawn together, so that a cluster seen
+// from the inside takes one draw call rather than one per star.
 class LargeStarRenderer
 {
 public:
     explicit LargeStarRenderer(Renderer &renderer);
     ~LargeStarRenderer();
 
-    void render(const Eigen::Vector3f &position, const Color &color, float size, const Matrices &mvp);
+    // Queues a billboard of size pixels centered on position
+    void addStar(const Eigen::Vector3f &position, const Color &color, float size);
+    // Draws the queued billboards with texture
+    void render(Texture *texture, const Matrices &mvp);
 
 private:
+    struct StarVertex
+    {
+        Eigen::Vector3f position;
+        float texCoord[2];
+        float size;
+        unsigned char color[4];
+    };
+
     void initialize();
     bool m_initialized{ false };
 
     Renderer &m_renderer;
 
-    std::unique_ptr<gl::Buffer> m_bo;
+    std::vector<StarVertex> m_vertices;
     std::unique_ptr<gl::VertexObject> m_vo;
 };
 
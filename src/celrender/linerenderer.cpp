@@ -11,6 +11,7 @@
 
 #include "linerenderer.h"
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 
@@ -18,11 +19,29 @@
 #include <celengine/render.h>
 #include <celengine/shadermanager.h>
 #include <celrender/gl/buffer.h>
+#include <celrender/gl/streambuffer.h>
 #include <celrender/gl/vertexobject.h>
 
 namespace celestia::render
 {
 
+namespace
+{
+
+// Corners of a segment quad: the end of the segment (0 or 1) and the side.
+// The direction is reversed at the second end, so is the side.
+constexpr std::array<float, 12> QuadCorners
+{
+    0.0f, -0.5f,
+    0.0f,  0.5f,
+    1.0f, -0.5f,
+    1.0f, -0.5f,
+    1.0f,  0.5f,
+    0.0f, -0.5f,
+};
+
+} // end unnamed namespace
+
 LineRenderer::~LineRenderer() = default;
 
 /**
@@ -62,21 +81,93 @@ LineRenderer::color_type() const
 void
 LineRenderer::draw_triangles(int count, int offset) const
 {
-    m_trVO->draw(gl::VertexObject::Primitive::Triangles, count, offset);
+    if (m_streamFirst >= 0)
+        m_trStreamVO->draw(gl::VertexObject::Primitive::Triangles, count, m_streamFirst + offset);
+    else
+        m_trVO->draw(gl::VertexObject::Primitive::Triangles, count, offset);
 }
 
 //! Draw triangle strips.
 void
 LineRenderer::draw_triangle_strip(int count, int offset) const
 {
-    m_trVO->draw(gl::VertexObject::Primitive::TriangleStrip, count, offset);
+    if (m_streamFirst >= 0)
+        m_trStreamVO->draw(gl::VertexObject::Primitive::TriangleStrip, count, m_streamFirst + offset);
+    else
+        m_trVO->draw(gl::VertexObject::Primitive::TriangleStrip, count, offset);
+}
+
+//! Draw one instanced quad per segment.
+void
+LineRenderer::draw_quads(int count, int offset)
+{
+    int quadCount = m_primType == PrimType::Lines ? count / 2 : count - 1;
+    if (quadCount <= 0)
+        return;
+
+    int first = offset + std::max(m_streamFirst, 0);
+    auto &vo = m_quadVOs[first];
+    if (vo == nullptr)
+    {
+        if (m_cornerBO == nullptr)
+            m_cornerBO = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array, QuadCorners);
+
+        const gl::Buffer &bo = m_streamFirst >= 0 ? m_renderer.getStreamBuffer().buffer() : *m_lnBO;
+        int stride = static_cast<int>(sizeof(Vertex)) * (m_primType == PrimType::Lines ? 2 : 1);
+        auto base = static_cast<std::ptrdiff_t>(first) * static_cast<std::ptrdiff_t>(sizeof(Vertex));
+
+        vo = std::make_unique<gl::VertexObject>(gl::VertexObject::Primitive::Triangles);
+        vo->addVertexBuffer(
+            *m_cornerBO,
+            CelestiaGLProgram::LineCornerAttributeIndex,
+            2,
+            gl::VertexObject::DataType::Float)
+          .addVertexBuffer(
+            bo,
+            CelestiaGLProgram::VertexCoordAttributeIndex,
+            pos_count(),
+            gl::VertexObject::DataType::Float,
+            false,
+            stride,
+            base + offsetof(Vertex, pos),
+            1)
+          .addVertexBuffer(
+            bo,
+            CelestiaGLProgram::NextVCoordAttributeIndex,
+            pos_count(),
+            gl::VertexObject::DataType::Float,
+            false,
+            stride,
+            base + static_cast<std::ptrdiff_t>(sizeof(Vertex)) + offsetof(Vertex, pos),
+            1);
+
+        // Like triangulated segments, the quad takes the color of its first end
+        if (color_count() != 0)
+        {
+            vo->addVertexBuffer(
+                bo,
+                CelestiaGLProgram::ColorAttributeIndex,
+                color_count(),
+                color_type() == VF_UBYTE ? gl::VertexObject::DataType::UnsignedByte : gl::VertexObject::DataType::Float,
+                color_type() == VF_UBYTE,
+                stride,
+                base + offsetof(Vertex, color),
+                1);
+        }
+    }
+
+    vo->drawInstanced(6, quadCount);
 }
 
 //! Draw lines defained with segments.
 void
 LineRenderer::draw_lines(int count, int offset) const
 {
-    m_lnVO->draw(static_cast<gl::VertexObject::Primitive>(m_primType), count, offset);
+    auto primitive = static_cast<gl::VertexObject::Primitive>(m_primType);
+    if (m_streamFirst >= 0)
+        m_lnStreamVO->draw(primitive, count, m_streamFirst + offset);
+    else
+        m_lnVO->draw(primitive, count, offset);
 }
 
 //! Enable GPU shader and set it's uniform values. Set line width.
@@ -90,6 +181,8 @@ LineRenderer::setup_shader()
         props.lightModel = LightingModel::UnlitModel;
         if (m_useTriangles)
             props.texUsage |= TexUsage::LineAsTriangles;
+        if (m_useQuads)
+            props.texUsage |= TexUsage::LineQuadInstances;
         if ((m_hints & DISABLE_FISHEYE_TRANFORMATION) != 0)
             props.fishEyeOverride = FisheyeOverrideMode::Disabled;
         m_prog = m_renderer.getShaderManager().getShader(props);
@@ -110,17 +203,12 @@ LineRenderer::setup_shader()
     }
 }
 
-//! Allocate GPU memory for vertices and define its layout.
+//! Define the layout of vertices in a buffer.
 void
-LineRenderer::create_vbo_lines()
+LineRenderer::setup_line_attributes(gl::VertexObject &vo, const gl::Buffer &bo) const
 {
-    m_lnVO = std::make_unique<gl::VertexObject>();
-    m_lnBO = std::make_unique<gl::Buffer>();
-
-    m_lnBO->setData(m_vertices, static_cast<gl::Buffer::BufferUsage>(m_storageType));
-
-    m_lnVO->addVertexBuffer(
-        *m_lnBO,
+    vo.addVertexBuffer(
+        bo,
         CelestiaGLProgram::VertexCoordAttributeIndex,
         pos_count(),
         gl::VertexObject::DataType::Float,
@@ -130,8 +218,8 @@ LineRenderer::create_vbo_lines()
 
     if (color_count() != 0)
     {
-        m_lnVO->addVertexBuffer(
-            *m_lnBO,
+        vo.addVertexBuffer(
+            bo,
             CelestiaGLProgram::ColorAttributeIndex,
             color_count(),
             color_type() == VF_UBYTE ? gl::VertexObject::DataType::UnsignedByte : gl::VertexObject::DataType::Float,
@@ -141,10 +229,48 @@ LineRenderer::create_vbo_lines()
     }
 }
 
+//! Allocate GPU memory for vertices and define its layout.
+void
+LineRenderer::create_vbo_lines()
+{
+    m_lnVO = std::make_unique<gl::VertexObject>();
+    m_lnBO = std::make_unique<gl::Buffer>();
+
+    m_lnBO->setData(m_vertices, static_cast<gl::Buffer::BufferUsage>(m_storageType));
+    setup_line_attributes(*m_lnVO, *m_lnBO);
+}
+
+//! Copy vertices to the shared stream buffer, return false if they don't fit.
+bool
+LineRenderer::stream_vbo_lines()
+{
+    gl::StreamBuffer &stream = m_renderer.getStreamBuffer();
+    GLintptr offset = stream.write(m_vertices, sizeof(Vertex));
+    if (offset < 0)
+        return false;
+
+    if (m_lnStreamVO == nullptr)
+    {
+        m_lnStreamVO = std::make_unique<gl::VertexObject>();
+        setup_line_attributes(*m_lnStreamVO, stream.buffer());
+    }
+
+    m_streamFirst = static_cast<int>(offset / static_cast<GLintptr>(sizeof(Vertex)));
+    return true;
+}
+
 //! Update or create GPU memory for vertices.
 void
 LineRenderer::setup_vbo_lines()
 {
+    // The quads read the vertices at offsets which change with the data
+    if (m_storageType != StorageType::Static)
+        m_quadVOs.clear();
+
+    if (m_storageType != StorageType::Static && stream_vbo_lines())
+        return;
+
+    m_streamFirst = -1;
     if (m_lnVO != nullptr)
     {
         if (m_storageType != StorageType::Static)
@@ -158,18 +284,23 @@ LineRenderer::setup_vbo_lines()
     }
 }
 
-//! Allocate GPU memory for vertices and define its layout.
-void
-LineRenderer::create_vbo_triangles()
+//! Return the size of a triangle vertex.
+int
+LineRenderer::triangle_stride() const
 {
-    m_trVO = std::make_unique<gl::VertexObject>();
-    m_trBO = std::make_unique<gl::Buffer>();
+    if (m_primType == PrimType::Lines || (m_hints & PREFER_SIMPLE_TRIANGLES) != 0)
+        return static_cast<int>(sizeof(LineSegment));
+    return static_cast<int>(sizeof(LineVertex));
+}
 
-    GLsizei                    stride;
+//! Define the layout of triangle vertices in a buffer.
+void
+LineRenderer::setup_triangle_attributes(gl::VertexObject &vo, const gl::Buffer &bo) const
+{
+    GLsizei                    stride = triangle_stride();
     std::array<std::size_t, 4> offset;
     if (m_primType == PrimType::Lines || (m_hints & PREFER_SIMPLE_TRIANGLES) != 0)
     {
-        stride = static_cast<GLsizei>(sizeof(LineSegment));
         offset =
         {
             offsetof(LineSegment, point1),
@@ -177,13 +308,9 @@ LineRenderer::create_vbo_triangles()
             offsetof(LineSegment, scale),
             offsetof(LineSegment, point1) + offsetof(Vertex, color)
         };
-
-        m_trBO->setData(m_segments, static_cast<gl::Buffer::BufferUsage>(m_storageType));
-        m_segments.clear();
     }
     else
     {
-        stride = static_cast<GLsizei>(sizeof(LineVertex));
         offset =
         {
             offsetof(LineVertex, point),
@@ -191,28 +318,25 @@ LineRenderer::create_vbo_triangles()
             offsetof(LineVertex, scale),
             offsetof(LineVertex, point) + offsetof(Vertex, color)
         };
-
-        m_trBO->setData(m_verticesTr, static_cast<gl::Buffer::BufferUsage>(m_storageType));
-        m_verticesTr.clear();
     }
-    m_trVO->addVertexBuffer(
-        *m_trBO,
+    vo.addVertexBuffer(
+        bo,
         CelestiaGLProgram::VertexCoordAttributeIndex,
         pos_count(),
         gl::VertexObject::DataType::Float,
         false,
         stride,
         static_cast<GLsizeiptr>(offset[0]));
-    m_trVO->addVertexBuffer(
-        *m_trBO,
+    vo.addVertexBuffer(
+        bo,
         CelestiaGLProgram::NextVCoordAttributeIndex,
         pos_count(),
         gl::VertexObject::DataType::Float,
         false,
         stride,
         static_cast<GLsizeiptr>(offset[1]));
-    m_trVO->addVertexBuffer(
-        *m_trBO,
+    vo.addVertexBuffer(
+        bo,
         CelestiaGLProgram::ScaleFactorAttributeIndex,
         1,
         gl::VertexObject::DataType::Float,
@@ -221,8 +345,8 @@ LineRenderer::create_vbo_triangles()
         static_cast<GLsizeiptr>(offset[2]));
     if (color_count() != 0)
     {
-        m_trVO->addVertexBuffer(
-            *m_trBO,
+        vo.addVertexBuffer(
+            bo,
             CelestiaGLProgram::ColorAttributeIndex,
             color_count(),
             color_type() == VF_UBYTE ? gl::VertexObject::DataType::UnsignedByte : gl::VertexObject::DataType::Float,
@@ -232,10 +356,60 @@ LineRenderer::create_vbo_triangles()
     }
 }
 
+//! Allocate GPU memory for vertices and define its layout.
+void
+LineRenderer::create_vbo_triangles()
+{
+    m_trVO = std::make_unique<gl::VertexObject>();
+    m_trBO = std::make_unique<gl::Buffer>();
+
+    if (m_primType == PrimType::Lines || (m_hints & PREFER_SIMPLE_TRIANGLES) != 0)
+    {
+        m_trBO->setData(m_segments, static_cast<gl::Buffer::BufferUsage>(m_storageType));
+        m_segments.clear();
+    }
+    else
+    {
+        m_trBO->setData(m_verticesTr, static_cast<gl::Buffer::BufferUsage>(m_storageType));
+        m_verticesTr.clear();
+    }
+    setup_triangle_attributes(*m_trVO, *m_trBO);
+}
+
+//! Copy triangle vertices to the shared stream buffer, return false if they don't fit.
+bool
+LineRenderer::stream_vbo_triangles()
+{
+    gl::StreamBuffer &stream = m_renderer.getStreamBuffer();
+    int stride = triangle_stride();
+    GLintptr offset;
+    if (m_primType == PrimType::Lines || (m_hints & PREFER_SIMPLE_TRIANGLES) != 0)
+        offset = stream.write(m_segments, stride);
+    else
+        offset = stream.write(m_verticesTr, stride);
+    if (offset < 0)
+        return false;
+
+    // The stride differs between the simple and strip layouts
+    if (m_trStreamVO == nullptr || m_trStreamStride != stride)
+    {
+        m_trStreamVO = std::make_unique<gl::VertexObject>();
+        setup_triangle_attributes(*m_trStreamVO, stream.buffer());
+        m_trStreamStride = stride;
+    }
+
+    m_streamFirst = static_cast<int>(offset / stride);
+    return true;
+}
+
 //! Update or create GPU memory for vertices.
 void
 LineRenderer::setup_vbo_triangles()
 {
+    if (m_storageType != StorageType::Static && stream_vbo_triangles())
+        return;
+
+    m_streamFirst = -1;
     if (m_trVO != nullptr)
     {
         if (m_storageType != StorageType::Static)
@@ -262,7 +436,7 @@ LineRenderer::setup_vbo_triangles()
 void
 LineRenderer::setup_vbo()
 {
-    if (!m_useTriangles)
+    if (!m_useTriangles || m_useQuads)
         setup_vbo_lines();
     else
         setup_vbo_triangles();
@@ -388,6 +562,14 @@ LineRenderer::should_triangulate() const
     return rasterized_width() > celestia::gl::maxLineWidth;
 }
 
+//! Segments can be expanded into quads by the GPU. Line loops are left out
+//! because their closing segment would need a copy of the first vertex.
+bool
+LineRenderer::can_draw_quads() const
+{
+    return m_primType != PrimType::LineLoop && celestia::gl::hasInstancedArrays();
+}
+
 float
 LineRenderer::width_multiplyer() const
 {
@@ -415,7 +597,8 @@ LineRenderer::startUpdate()
     if (m_storageType != StorageType::Static)
     {
         m_useTriangles = should_triangulate();
-        m_verticesTriangulated = m_useTriangles && m_primType != PrimType::Lines && (m_hints & PREFER_SIMPLE_TRIANGLES) == 0;
+        m_useQuads = m_useTriangles && can_draw_quads();
+        m_verticesTriangulated = m_useTriangles && !m_useQuads && m_primType != PrimType::Lines && (m_hints & PREFER_SIMPLE_TRIANGLES) == 0;
     }
 }
 
@@ -448,6 +631,8 @@ LineRenderer::finish()
         m_lnBO->unbind();
     if (m_trBO != nullptr)
         m_trBO->unbind();
+    if (m_streamFirst >= 0)
+        m_renderer.getStreamBuffer().buffer().unbind();
     m_inUse = false;
     m_prog = nullptr;
 }
@@ -457,7 +642,14 @@ LineRenderer::prerender()
 {
     m_useTriangles = m_useTriangles || should_triangulate();
 
-    if (m_useTriangles)
+    // Quads are only used while no vertices have been triangulated yet
+    if (m_useTriangles && !m_useQuads && m_trVO == nullptr &&
+        m_segments.empty() && m_verticesTr.empty() && can_draw_quads())
+    {
+        m_useQuads = true;
+    }
+
+    if (m_useTriangles && !m_useQuads)
         triangulate_and_segment();
 
     setup_vbo();
@@ -474,7 +666,11 @@ LineRenderer::render(const Matrices &mvp, int count, int offset)
 
     m_prog->setMVPMatrices(*mvp.projection, *mvp.modelview);
 
-    if (m_useTriangles)
+    if (m_useQuads)
+    {
+        draw_quads(count, offset);
+    }
+    else if (m_useTriangles)
     {
         if ((m_hints & PREFER_SIMPLE_TRIANGLES) != 0 && m_primType != PrimType::Lines)
         {
@@ -571,7 +767,7 @@ LineRenderer::addVertex(float x, float y, float z)
 void
 LineRenderer::addSegment(const Eigen::Vector3f &pos1, const Eigen::Vector3f &pos2)
 {
-    if (!m_useTriangles)
+    if (!m_useTriangles || m_useQuads)
     {
         m_vertices.emplace_back(pos1);
         m_vertices.emplace_back(pos2);
@@ -587,9 +783,15 @@ LineRenderer::dropLast()
 {
     if ((m_hints & PREFER_SIMPLE_TRIANGLES) == 0 && m_primType != PrimType::Lines)
     {
-        m_vertices.pop_back();
-        m_verticesTr.pop_back();
-        m_verticesTr.pop_back();
+        if (!m_verticesTriangulated)
+        {
+            m_vertices.pop_back();
+        }
+        else
+        {
+            m_verticesTr.pop_back();
+            m_verticesTr.pop_back();
+        }
     }
 }
 
@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -40,9 +41,11 @@ namespace celestia::render
  * only if requested line is wider that maximal line width supported by the GL implementation. In
  * the most cases desktop OpenGL drivers support line wider than 1px, while OpenGL ES mobile drivers
  * support only 1px wide lines.
- * For lines which are not updated (static storage) conversation into triangles is performed before
- * the actual rendering is done. For lines with dynamic or stream storage conversation into
- * triangles is performed immediatelly when a new vertex or segment is added.
+ * When instanced arrays are available, line segments and strips are drawn as one instanced quad
+ * per segment and the vertex shader expands the quads, so no triangles are built on the CPU.
+ * Otherwise, for lines which are not updated (static storage) conversation into triangles is
+ * performed before the actual rendering is done, and for lines with dynamic or stream storage
+ * conversation into triangles is performed immediatelly when a new vertex or segment is added.
  *
  * Worflow:
  *   1. create lr
@@ -252,11 +255,17 @@ private:
     void draw_lines(int count, int offset) const;
     void draw_triangles(int count, int offset) const;
     void draw_triangle_strip(int count, int offset) const;
+    void draw_quads(int count, int offset);
     void setup_shader();
     void setup_vbo();
+    void setup_line_attributes(gl::VertexObject &vo, const gl::Buffer &bo) const;
     void create_vbo_lines();
+    bool stream_vbo_lines();
     void setup_vbo_lines();
+    int triangle_stride() const;
+    void setup_triangle_attributes(gl::VertexObject &vo, const gl::Buffer &bo) const;
     void create_vbo_triangles();
+    bool stream_vbo_triangles();
     void setup_vbo_triangles();
     void triangulate_and_segment();
     void triangulate_segments();
@@ -269,6 +278,7 @@ private:
     int color_count() const;
     int color_type() const;
     bool should_triangulate() const;
+    bool can_draw_quads() const;
     float width_multiplyer() const;
     float rasterized_width() const;
 
@@ -280,6 +290,16 @@ private:
     std::unique_ptr<gl::VertexObject>   m_trVO;
     std::unique_ptr<gl::Buffer>         m_lnBO;
     std::unique_ptr<gl::Buffer>         m_trBO;
+    //! Vertex objects reading from the renderer's stream buffer
+    std::unique_ptr<gl::VertexObject>   m_lnStreamVO;
+    std::unique_ptr<gl::VertexObject>   m_trStreamVO;
+    int                                 m_trStreamStride{ 0 };
+    //! First vertex of the data in the stream buffer, -1 when own buffers are used
+    int                                 m_streamFirst{ -1 };
+    //! Corners of the instanced quads
+    std::unique_ptr<gl::Buffer>         m_cornerBO;
+    //! Vertex objects of the instanced quads by first vertex
+    std::map<int, std::unique_ptr<gl::VertexObject>> m_quadVOs;
     const Renderer                     &m_renderer;
     float                               m_width;
     PrimType                            m_primType;
@@ -287,6 +307,7 @@ private:
     VertexFormat                        m_format;
     int                                 m_hints{ 0 };
     bool                                m_useTriangles{ false };
+    bool                                m_useQuads{ false };
     bool                                m_verticesTriangulated{ false };
     bool                                m_segmented{ false };
     bool                                m_loopDone{ false };
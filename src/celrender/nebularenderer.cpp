@@ -36,6 +36,7 @@ struct NebulaRenderer::Object
     float           nearZ;  // if nearZ != & farZ != then use custom projection matrix
     float           farZ;
     const Nebula   *nebula;
+    Geometry       *geometry{ nullptr };
 };
 
 NebulaRenderer::NebulaRenderer(Renderer &renderer) :
@@ -63,31 +64,55 @@ NebulaRenderer::add(const Nebula *nebula, const Eigen::Vector3f &offset, float /
 void
 NebulaRenderer::render()
 {
-    // draw more distant objects first
+    // Resolve the geometry once per object and drop those without one.
+    // Models that aren't loaded yet are queued for loading in the background
+    // and skipped until they are ready, so that flying into a new region
+    // doesn't stall on disk I/O.
+    auto *geometryManager = engine::GetGeometryManager();
+    for (auto &obj : m_objects)
+    {
+        if (auto geometry = obj.nebula->getGeometry(); geometry != InvalidResource)
+            obj.geometry = geometryManager->request(geometry);
+    }
+    m_objects.erase(std::remove_if(m_objects.begin(), m_objects.end(),
+                                   [](const auto &obj) { return obj.geometry == nullptr; }),
+                    m_objects.end());
+
+    // Draw more distant objects first. Nebulae are drawn without a depth
+    // test and each may have its own depth range, so this order is kept
+    // rather than grouping the draws by model.
     std::sort(m_objects.begin(), m_objects.end(),
         [](const auto &o1, const auto &o2){ return o1.offset.squaredNorm() > o2.offset.squaredNorm(); });
 
+    // Custom projection matrices are only rebuilt when the depth range changes
+    const Eigen::Matrix4f &defaultProjection = m_renderer.getProjectionMatrix();
+    Eigen::Matrix4f customProjection;
+    float customNearZ = 0.0f;
+    float customFarZ = 0.0f;
+
     for (const auto &obj : m_objects)
-        renderNebula(obj);
+    {
+        if (obj.nearZ == 0.0f || obj.farZ == 0.0f)
+        {
+            renderNebula(obj, defaultProjection);
+            continue;
+        }
+
+        if (obj.nearZ != customNearZ || obj.farZ != customFarZ)
+        {
+            m_renderer.buildProjectionMatrix(customProjection, obj.nearZ, obj.farZ, m_zoom);
+            customNearZ = obj.nearZ;
+            customFarZ = obj.farZ;
+        }
+        renderNebula(obj, customProjection);
+    }
 
     m_objects.clear();
 }
 
 void
-NebulaRenderer::renderNebula(const Object &obj) const
+NebulaRenderer::renderNebula(const Object &obj, const Eigen::Matrix4f &pr) const
 {
-    Geometry *g = nullptr;
-    if (auto geometry = obj.nebula->getGeometry(); geometry != InvalidResource)
-        g = engine::GetGeometryManager()->find(geometry);
-    if (g == nullptr)
-        return;
-
-    Eigen::Matrix4f pr;
-    if (obj.nearZ != 0.0f && obj.farZ != 0.0f)
-        m_renderer.buildProjectionMatrix(pr, obj.nearZ, obj.farZ, m_zoom);
-    else
-        pr = m_renderer.getProjectionMatrix();
-
     Renderer::PipelineState ps;
     ps.smoothLines = true;
     m_renderer.setPipelineState(ps);
@@ -100,7 +125,7 @@ NebulaRenderer::renderNebula(const Object &obj) const
 
     GLSLUnlit_RenderContext rc(&m_renderer, radius, &mv, &pr);
     rc.setPointScale(2.0f * radius / m_pixelSize);
-    g->render(rc);
+    obj.geometry->render(rc);
 }
 
 } // namespace celestia::render
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
@@ -35,7 +37,7 @@ public:
 private:
     struct Object;
 
-    void renderNebula(const Object &obj) const;
+    void renderNebula(const Object &obj, const Eigen::Matrix4f &pr) const;
 
     // global state
     std::vector<Object> m_objects;
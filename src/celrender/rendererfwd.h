@@ -9,10 +9,13 @@ class CometRenderer;
 class EclipticLineRenderer;
 class GalaxyRenderer;
 class GlobularRenderer;
+class GPUStarRenderer;
+class KeplerOrbitRenderer;
 class LargeStarRenderer;
 class LineRenderer;
 class NebulaRenderer;
 class OpenClusterRenderer;
+class RenderProfiler;
 class RingRenderer;
 class SkyGridRenderer;
 }
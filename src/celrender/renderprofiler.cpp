@@ -0,0 +1,213 @@
+// renderprofiler.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "renderprofiler.h"
+
+#include <algorithm>
+
+#include "gl/binder.h"
+
+namespace celestia::render
+{
+
+namespace
+{
+
+// Weight of the newest frame in the running averages
+constexpr float AverageWeight = 0.1f;
+
+void
+accumulate(float& average, float sample)
+{
+    average += (sample - average) * AverageWeight;
+}
+
+} // end unnamed namespace
+
+RenderProfiler::Scope::Scope(RenderProfiler* profiler, RenderPass pass) :
+    m_profiler(profiler),
+    m_pass(pass)
+{
+    if (m_profiler == nullptr)
+        return;
+
+    m_startQuery = m_profiler->startQuery();
+    m_start = clock::now();
+}
+
+RenderProfiler::Scope::~Scope()
+{
+    if (m_profiler != nullptr)
+        m_profiler->endScope(m_pass, clock::now() - m_start, m_startQuery);
+}
+
+RenderProfiler::RenderProfiler()
+{
+#ifndef GL_ES
+    m_hasTimerQuery = gl::checkVersion(gl::GL_3_3) || gl::ARB_timer_query;
+    if (!m_hasTimerQuery)
+        return;
+
+    for (FrameQueries& frame : m_frames)
+    {
+        frame.queries.resize(MaxQueriesPerFrame);
+        glGenQueries(static_cast<GLsizei>(MaxQueriesPerFrame), frame.queries.data());
+        frame.ranges.reserve(MaxQueriesPerFrame / 2);
+    }
+#endif
+}
+
+RenderProfiler::~RenderProfiler()
+{
+#ifndef GL_ES
+    if (!m_hasTimerQuery)
+        return;
+
+    for (FrameQueries& frame : m_frames)
+        glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+#endif
+}
+
+void
+RenderProfiler::beginFrame()
+{
+    m_inFrame = true;
+    m_frameCPUTimes.fill(clock::duration::zero());
+    gl::Binder::get().takeStats();
+
+    if (!m_hasTimerQuery)
+        return;
+
+    // Reuse the queries of the oldest frame, picking up its results first
+    FrameQueries& frame = m_frames[m_frameIndex % FrameLatency];
+    if (frame.pending)
+        collectGPUTimes(frame);
+
+    frame.used = 0;
+    frame.ranges.clear();
+}
+
+void
+RenderProfiler::endFrame()
+{
+    if (!m_inFrame)
+        return;
+
+    for (std::size_t i = 0; i < PassCount; ++i)
+        accumulate(m_cpuTimes[i], std::chrono::duration<float, std::milli>(m_frameCPUTimes[i]).count());
+
+    gl::Binder::Stats stats = gl::Binder::get().takeStats();
+    accumulate(m_stateChanges, static_cast<float>(stats.calls));
+    accumulate(m_skippedStateChanges, static_cast<float>(stats.skipped));
+
+    if (m_hasTimerQuery)
+    {
+        FrameQueries& frame = m_frames[m_frameIndex % FrameLatency];
+        frame.pending = !frame.ranges.empty();
+    }
+
+    m_inFrame = false;
+    ++m_frameIndex;
+}
+
+const char*
+RenderProfiler::getPassName(RenderPass pass)
+{
+    switch (pass)
+    {
+    case RenderPass::Stars:
+        return "Stars";
+    case RenderPass::DeepSkyObjects:
+        return "DeepSkyObjects";
+    case RenderPass::SolarSystem:
+        return "SolarSystem";
+    case RenderPass::Orbits:
+        return "Orbits";
+    case RenderPass::Annotations:
+        return "Annotations";
+    case RenderPass::Atmospheres:
+        return "Atmospheres";
+    case RenderPass::Rings:
+        return "Rings";
+    case RenderPass::Shadows:
+        return "Shadows";
+    default:
+        return "";
+    }
+}
+
+int
+RenderProfiler::startQuery()
+{
+#ifndef GL_ES
+    if (!m_inFrame || !m_hasTimerQuery)
+        return -1;
+
+    FrameQueries& frame = m_frames[m_frameIndex % FrameLatency];
+    if (frame.used + 2 > frame.queries.size())
+        return -1;
+
+    glQueryCounter(frame.queries[frame.used], GL_TIMESTAMP);
+    return static_cast<int>(frame.used++);
+#else
+    return -1;
+#endif
+}
+
+void
+RenderProfiler::endScope(RenderPass pass, clock::duration cpuTime, [[maybe_unused]] int startQuery)
+{
+    if (!m_inFrame)
+        return;
+
+    m_frameCPUTimes[static_cast<std::size_t>(pass)] += cpuTime;
+
+#ifndef GL_ES
+    if (startQuery < 0)
+        return;
+
+    // startQuery reserved room for the end query
+    FrameQueries& frame = m_frames[m_frameIndex % FrameLatency];
+    glQueryCounter(frame.queries[frame.used], GL_TIMESTAMP);
+    frame.ranges.push_back({ pass,
+                             static_cast<std::uint32_t>(startQuery),
+                             static_cast<std::uint32_t>(frame.used++) });
+#endif
+}
+
+void
+RenderProfiler::collectGPUTimes([[maybe_unused]] FrameQueries& frame)
+{
+#ifndef GL_ES
+    frame.pending = false;
+
+    // Timestamps complete in order, so the last one tells whether all of the
+    // frame's results are in. If they aren't, the frame is dropped rather
+    // than waited for.
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE)
+        return;
+
+    std::array<GLuint64, PassCount> times{};
+    for (const GPURange& range : frame.ranges)
+    {
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(frame.queries[range.startQuery], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(frame.queries[range.endQuery], GL_QUERY_RESULT, &end);
+        times[static_cast<std::size_t>(range.pass)] += std::max(end, start) - start;
+    }
+
+    for (std::size_t i = 0; i < PassCount; ++i)
+        accumulate(m_gpuTimes[i], static_cast<float>(times[i]) * 1.0e-6f);
+#endif
+}
+
+} // end namespace celestia::render
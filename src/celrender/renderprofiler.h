@@ -0,0 +1,130 @@
+// renderprofiler.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// CPU and GPU timing of the renderer's passes.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <celengine/glsupport.h>
+
+namespace celestia::render
+{
+
+enum class RenderPass : unsigned int
+{
+    Stars,
+    DeepSkyObjects,
+    SolarSystem,
+    Orbits,
+    Annotations,
+    Atmospheres,
+    Rings,
+    Shadows,
+    Count,
+};
+
+// Measures the time spent in each render pass. Passes may be entered several
+// times per frame and may be nested; the times of nested passes are also
+// included in the enclosing pass, so orbits, atmospheres, rings and shadows
+// are part of the solar system time.
+//
+// GPU times are measured with timestamp queries, which are read back a few
+// frames later so that the profiler never stalls the pipeline. They are only
+// available on desktop OpenGL 3.3 or with GL_ARB_timer_query.
+class RenderProfiler
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    class Scope
+    {
+    public:
+        // A null profiler makes the scope a no-op
+        Scope(RenderProfiler*, RenderPass);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        RenderProfiler* m_profiler;
+        RenderPass m_pass;
+        clock::time_point m_start;
+        int m_startQuery{ -1 };
+    };
+
+    RenderProfiler();
+    ~RenderProfiler();
+
+    RenderProfiler(const RenderProfiler&) = delete;
+    RenderProfiler& operator=(const RenderProfiler&) = delete;
+
+    void beginFrame();
+    void endFrame();
+
+    bool hasGPUTimes() const { return m_hasTimerQuery; }
+
+    // Times in milliseconds, averaged over recent frames
+    float getCPUTime(RenderPass pass) const { return m_cpuTimes[static_cast<std::size_t>(pass)]; }
+    float getGPUTime(RenderPass pass) const { return m_gpuTimes[static_cast<std::size_t>(pass)]; }
+
+    // Program and buffer bindings per frame, averaged over recent frames:
+    // those sent to OpenGL and those skipped because they were current
+    float getStateChanges() const { return m_stateChanges; }
+    float getSkippedStateChanges() const { return m_skippedStateChanges; }
+
+    static const char* getPassName(RenderPass);
+
+private:
+    static constexpr std::size_t PassCount = static_cast<std::size_t>(RenderPass::Count);
+
+    // Number of frames that are in flight before their queries are read
+    static constexpr std::size_t FrameLatency = 3;
+
+    // Scopes beyond this number in a frame only get CPU times
+    static constexpr std::size_t MaxQueriesPerFrame = 512;
+
+    struct GPURange
+    {
+        RenderPass pass;
+        std::uint32_t startQuery;
+        std::uint32_t endQuery;
+    };
+
+    struct FrameQueries
+    {
+        std::vector<GLuint> queries;
+        std::vector<GPURange> ranges;
+        std::size_t used{ 0 };
+        bool pending{ false };
+    };
+
+    int startQuery();
+    void endScope(RenderPass, clock::duration, int startQuery);
+    void collectGPUTimes(FrameQueries&);
+
+    bool m_hasTimerQuery{ false };
+    bool m_inFrame{ false };
+    std::size_t m_frameIndex{ 0 };
+    std::array<FrameQueries, FrameLatency> m_frames;
+
+    std::array<clock::duration, PassCount> m_frameCPUTimes{};
+    std::array<float, PassCount> m_cpuTimes{};
+    std::array<float, PassCount> m_gpuTimes{};
+    float m_stateChanges{ 0.0f };
+    float m_skippedStateChanges{ 0.0f };
+};
+
+} // end namespace celestia::render
@@ -445,9 +445,19 @@ SkyGridRenderer::RenderInfo::RenderInfo(double vfov, double viewAspectRatio,
 
 SkyGridRenderer::SkyGridRenderer(Renderer& renderer) :
     m_gridRenderer(std::make_unique<LineRenderer>(renderer, 1.0f, LineRenderer::PrimType::LineStrip, LineRenderer::StorageType::Stream)),
-    m_crossRenderer(std::make_unique<LineRenderer>(renderer, 1.0f, LineRenderer::PrimType::Lines, LineRenderer::StorageType::Stream)),
+    m_crossRenderer(std::make_unique<LineRenderer>(renderer, 1.0f, LineRenderer::PrimType::Lines, LineRenderer::StorageType::Static)),
     m_renderer(renderer)
 {
+    // Crosses indicating the north and south poles; they are scaled to the
+    // field of view when rendered.
+    m_crossRenderer->addVertex(-1.0f,  1.0f,  0.0f);
+    m_crossRenderer->addVertex( 1.0f,  1.0f,  0.0f);
+    m_crossRenderer->addVertex( 0.0f,  1.0f, -1.0f);
+    m_crossRenderer->addVertex( 0.0f,  1.0f,  1.0f);
+    m_crossRenderer->addVertex(-1.0f, -1.0f,  0.0f);
+    m_crossRenderer->addVertex( 1.0f, -1.0f,  0.0f);
+    m_crossRenderer->addVertex( 0.0f, -1.0f, -1.0f);
+    m_crossRenderer->addVertex( 0.0f, -1.0f,  1.0f);
 }
 
 SkyGridRenderer::~SkyGridRenderer() = default;
@@ -491,19 +501,10 @@ SkyGridRenderer::render(const engine::SkyGrid& grid, float zoom) const
     }
 
     // Draw crosses indicating the north and south poles
-    m_crossRenderer->startUpdate();
-    m_crossRenderer->addVertex(-renderInfo.polarCrossSize,  1.0f,  0.0f);
-    m_crossRenderer->addVertex( renderInfo.polarCrossSize,  1.0f,  0.0f);
-    m_crossRenderer->addVertex( 0.0f,                       1.0f, -renderInfo.polarCrossSize);
-    m_crossRenderer->addVertex( 0.0f,                       1.0f,  renderInfo.polarCrossSize);
-    m_crossRenderer->addVertex(-renderInfo.polarCrossSize, -1.0f,  0.0f);
-    m_crossRenderer->addVertex( renderInfo.polarCrossSize, -1.0f,  0.0f);
-    m_crossRenderer->addVertex( 0.0f,                      -1.0f, -renderInfo.polarCrossSize);
-    m_crossRenderer->addVertex( 0.0f,                      -1.0f,  renderInfo.polarCrossSize);
-    m_crossRenderer->render(matrices, grid.lineColor, 8);
+    Eigen::Matrix4f crossModelView = m * math::scale(Eigen::Vector3f(renderInfo.polarCrossSize, 1.0f, renderInfo.polarCrossSize));
+    m_crossRenderer->render({&m_renderer.getProjectionMatrix(), &crossModelView}, grid.lineColor, 8);
 
     m_gridRenderer->clear();
-    m_crossRenderer->clear();
     m_gridRenderer->finish();
     m_crossRenderer->finish();
 }
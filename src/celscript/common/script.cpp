@@ -32,4 +32,22 @@ bool IScript::handleTickEvent(double /*dt*/)
     return false;
 }
 
+void IScript::dispatchEvents()
+{
+}
+
+std::size_t IScript::getMemoryUsage() const
+{
+    return 0;
+}
+
+void IScriptHook::dispatchEvents() const
+{
+}
+
+std::size_t IScriptHook::getMemoryUsage() const
+{
+    return 0;
+}
+
 } // end namespace celestia::scripts
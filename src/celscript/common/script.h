@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 
 #include <celcompat/filesystem.h>
@@ -27,7 +28,10 @@ class IScript
     virtual bool charEntered(const char*);
     virtual bool handleKeyEvent(const char* key);
     virtual bool handleTickEvent(double dt);
+    virtual void dispatchEvents();
     virtual bool tick(double) = 0;
+    // Bytes of memory used by the script interpreter, if known
+    virtual std::size_t getMemoryUsage() const;
 };
 
 class IScriptPlugin
@@ -66,6 +70,8 @@ class IScriptHook
     virtual bool call(const char *method, float x, float y) const = 0;
     virtual bool call(const char *method, float x, float y, int b) const = 0;
     virtual bool call(const char *method, double dt) const = 0;
+    virtual void dispatchEvents() const;
+    virtual std::size_t getMemoryUsage() const;
 
     CelestiaCore *appCore() const { return m_appCore; }
 
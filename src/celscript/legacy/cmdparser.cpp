@@ -670,6 +670,33 @@ ParseResult parsePreloadTexCommand(const Hash& paramList, const ScriptMaps&)
 }
 
 
+ParseResult parsePreloadCommand(const Hash& paramList, const ScriptMaps&)
+{
+    std::vector<std::string> names;
+    if (const std::string* object = paramList.getString("object"); object != nullptr)
+        names.push_back(*object);
+
+    if (const Value* objects = paramList.getValue("objects"); objects != nullptr)
+    {
+        const ValueArray* array = objects->getArray();
+        if (array == nullptr)
+            return makeError("objects parameter to preload must be an array");
+
+        for (const Value& value : *array)
+        {
+            const std::string* name = value.getString();
+            if (name == nullptr)
+                return makeError("objects parameter to preload must be an array of names");
+            names.push_back(*name);
+        }
+    }
+
+    return names.empty()
+        ? makeError("Missing object or objects parameter to preload")
+        : std::make_unique<CommandPreload>(std::move(names));
+}
+
+
 ParseResult parseMarkCommand(const Hash& paramList, const ScriptMaps&)
 {
     const std::string* object = paramList.getString("object");
@@ -88,7 +88,7 @@ CommandSelect::CommandSelect(std::string _target) : target(std::move(_target))
 
 void CommandSelect::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(target);
+    Selection sel = env.findObjectFromPath(target);
     env.getSimulation()->setSelection(sel);
 }
 
@@ -245,10 +245,10 @@ CommandSetFrame::CommandSetFrame(ObserverFrame::CoordinateSystem _coordSys,
 
 void CommandSetFrame::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection ref = env.getSimulation()->findObjectFromPath(refObjectName);
+    Selection ref = env.findObjectFromPath(refObjectName);
     Selection target;
     if (coordSys == ObserverFrame::PhaseLock)
-        target = env.getSimulation()->findObjectFromPath(targetObjectName);
+        target = env.findObjectFromPath(targetObjectName);
     env.getSimulation()->setFrame(coordSys, ref, target);
 }
 
@@ -608,7 +608,7 @@ CommandMark::CommandMark(std::string _target,
 
 void CommandMark::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(target);
+    Selection sel = env.findObjectFromPath(target);
     if (sel.empty())
         return;
 
@@ -631,7 +631,7 @@ CommandUnmark::CommandUnmark(std::string _target) :
 
 void CommandUnmark::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(target);
+    Selection sel = env.findObjectFromPath(target);
     if (sel.empty())
         return;
 
@@ -661,7 +661,7 @@ CommandPreloadTextures::CommandPreloadTextures(std::string _name) :
 
 void CommandPreloadTextures::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection target = env.getSimulation()->findObjectFromPath(name);
+    Selection target = env.findObjectFromPath(name);
     if (target.body() == nullptr)
         return;
 
@@ -670,6 +670,28 @@ void CommandPreloadTextures::processInstantaneous(ExecutionEnvironment& env)
 }
 
 
+////////////////
+// Preload command: queue textures and models of several objects
+
+CommandPreload::CommandPreload(std::vector<std::string> _names) :
+    names(std::move(_names))
+{
+}
+
+void CommandPreload::processInstantaneous(ExecutionEnvironment& env)
+{
+    if (env.getRenderer() == nullptr)
+        return;
+
+    Renderer::PreloadProgress progress;
+    for (const std::string& name : names)
+    {
+        if (Body* body = env.findObjectFromPath(name).body(); body != nullptr)
+            env.getRenderer()->preload(body, progress);
+    }
+}
+
+
 ////////////////
 // Capture command
 
@@ -797,7 +819,7 @@ CommandSetRadius::CommandSetRadius(std::string _object, double _radius) :
 
 void CommandSetRadius::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(object);
+    Selection sel = env.findObjectFromPath(object);
     if (sel.body() == nullptr)
         return;
 
@@ -1091,7 +1113,7 @@ void CommandSetRingsTexture::processInstantaneous(ExecutionEnvironment& env)
     if (textureName.empty())
         return;
 
-    auto body = env.getSimulation()->findObjectFromPath(object).body();
+    auto body = env.findObjectFromPath(object).body();
     if (body == nullptr)
         return;
 
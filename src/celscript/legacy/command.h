@@ -565,6 +565,19 @@ class CommandPreloadTextures : public InstantaneousCommand
 };
 
 
+class CommandPreload : public InstantaneousCommand
+{
+ public:
+    CommandPreload(std::vector<std::string>);
+
+ protected:
+    void processInstantaneous(ExecutionEnvironment&) override;
+
+ private:
+    std::vector<std::string> names;
+};
+
+
 class CommandMark : public InstantaneousCommand
 {
  public:
@@ -11,6 +11,8 @@
 
 #include <string_view>
 
+#include <celengine/selection.h>
+
 class CelestiaCore;
 class Renderer;
 class Simulation;
@@ -32,6 +34,10 @@ class ExecutionEnvironment
     virtual CelestiaCore* getCelestiaCore() const = 0;
 
     virtual void showText(std::string_view, int, int, int, int, double) = 0;
+
+    // Finds an object as Simulation::findObjectFromPath() does, possibly
+    // from a cache of earlier lookups.
+    virtual Selection findObjectFromPath(std::string_view path) = 0;
 };
 
 }
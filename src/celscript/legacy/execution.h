@@ -10,6 +10,7 @@
 #pragma once
 
 #include <cstddef>
+#include <memory>
 
 #include "command.h"
 
@@ -22,11 +23,13 @@ class Execution
 {
  public:
     Execution(CommandSequence&&, ExecutionEnvironment&);
+    // The commands may be shared with other executions of the same script
+    Execution(std::shared_ptr<CommandSequence>, ExecutionEnvironment&);
 
     bool tick(double);
 
  private:
-    CommandSequence commandSequence;
+    std::shared_ptr<CommandSequence> commandSequence;
     std::size_t currentCommand{ 0 };
     ExecutionEnvironment& env;
     double commandTime{ -1.0 };
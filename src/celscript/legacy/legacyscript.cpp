@@ -9,9 +9,14 @@
 
 #include "legacyscript.h"
 
+#include <cstdint>
 #include <fstream>
 #include <istream>
+#include <string_view>
+#include <system_error>
+#include <utility>
 
+#include <celengine/simulation.h>
 #include <celestia/celestiacore.h>
 #include <celutil/gettext.h>
 #include "cmdparser.h"
@@ -23,6 +28,13 @@
 namespace celestia::scripts
 {
 
+struct LegacyScriptPlugin::CompiledScript
+{
+    std::uintmax_t fileSize;
+    fs::file_time_type modificationTime;
+    std::shared_ptr<CommandSequence> commands;
+};
+
 namespace
 {
 
@@ -34,7 +46,8 @@ private:
     CelestiaCore& core;
 
 public:
-    CoreExecutionEnvironment(CelestiaCore& _core) : core(_core)
+    CoreExecutionEnvironment(CelestiaCore& _core) :
+        core(_core)
     {
     }
 
@@ -58,8 +71,25 @@ public:
     {
         core.showText(s, horig, vorig, hoff, voff, duration);
     }
+
+    // Universe::findPath() caches the lookups
+    Selection findObjectFromPath(std::string_view path) override
+    {
+        return core.getSimulation()->findObjectFromPath(path);
+    }
 };
 
+bool
+getFileStatus(const fs::path& path, std::uintmax_t& size, fs::file_time_type& modificationTime)
+{
+    std::error_code ec;
+    size = fs::file_size(path, ec);
+    if (ec)
+        return false;
+    modificationTime = fs::last_write_time(path, ec);
+    return !ec;
+}
+
 } // end unnamed namespace
 
 LegacyScript::LegacyScript(CelestiaCore *core) :
@@ -68,6 +98,8 @@ LegacyScript::LegacyScript(CelestiaCore *core) :
 {
 }
 
+LegacyScript::~LegacyScript() = default;
+
 bool LegacyScript::load(std::istream &scriptfile, const fs::path &/*path*/, std::string &errorMsg)
 {
     CommandParser parser(scriptfile, m_appCore->scriptMaps());
@@ -88,6 +120,13 @@ bool LegacyScript::tick(double dt)
     return m_runningScript->tick(dt);
 }
 
+LegacyScriptPlugin::LegacyScriptPlugin(CelestiaCore *appCore) :
+    IScriptPlugin(appCore)
+{
+}
+
+LegacyScriptPlugin::~LegacyScriptPlugin() = default;
+
 bool LegacyScriptPlugin::isOurFile(const fs::path &p) const
 {
     return p.extension() == ".cel";
@@ -95,6 +134,23 @@ bool LegacyScriptPlugin::isOurFile(const fs::path &p) const
 
 std::unique_ptr<IScript> LegacyScriptPlugin::loadScript(const fs::path &path)
 {
+    auto script = std::make_unique<LegacyScript>(appCore());
+
+    std::uintmax_t fileSize;
+    fs::file_time_type modificationTime;
+    bool haveStatus = getFileStatus(path, fileSize, modificationTime);
+    if (haveStatus)
+    {
+        auto it = m_compiledScripts.find(path);
+        if (it != m_compiledScripts.end() &&
+            it->second->fileSize == fileSize &&
+            it->second->modificationTime == modificationTime)
+        {
+            script->m_runningScript = std::make_unique<Execution>(it->second->commands, *script->m_execEnv);
+            return script;
+        }
+    }
+
     std::ifstream scriptfile(path);
     if (!scriptfile.good())
     {
@@ -102,15 +158,20 @@ std::unique_ptr<IScript> LegacyScriptPlugin::loadScript(const fs::path &path)
         return nullptr;
     }
 
-    auto script = std::make_unique<LegacyScript>(appCore());
-    std::string errorMsg;
-    if (!script->load(scriptfile, path, errorMsg))
+    CommandParser parser(scriptfile, appCore()->scriptMaps());
+    auto commands = std::make_shared<CommandSequence>(parser.parse());
+    if (commands->empty())
     {
-        if (errorMsg.empty())
-            errorMsg = _("Unknown error loading script");
-        appCore()->fatalError(errorMsg);
+        auto errors = parser.getErrors();
+        appCore()->fatalError(errors.empty() ? _("Unknown error loading script") : errors[0]);
         return nullptr;
     }
+
+    // The commands don't change while they are executed and can be shared
+    if (haveStatus)
+        m_compiledScripts[path] = std::make_unique<CompiledScript>(CompiledScript{ fileSize, modificationTime, commands });
+
+    script->m_runningScript = std::make_unique<Execution>(std::move(commands), *script->m_execEnv);
     return script;
 }
 
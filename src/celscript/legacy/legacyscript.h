@@ -10,6 +10,7 @@
 #pragma once
 
 #include <iosfwd>
+#include <map>
 #include <memory>
 #include <string>
 
@@ -29,7 +30,7 @@ class LegacyScript : public IScript
 {
  public:
     LegacyScript(CelestiaCore*);
-    ~LegacyScript() override = default;
+    ~LegacyScript() override;
 
     bool load(std::istream&, const fs::path&, std::string&);
 
@@ -47,8 +48,8 @@ class LegacyScriptPlugin : public IScriptPlugin
 {
  public:
     LegacyScriptPlugin() = delete;
-    LegacyScriptPlugin(CelestiaCore *appCore) : IScriptPlugin(appCore) {};
-    ~LegacyScriptPlugin() override = default;
+    LegacyScriptPlugin(CelestiaCore *appCore);
+    ~LegacyScriptPlugin() override;
     LegacyScriptPlugin(const LegacyScriptPlugin&) = delete;
     LegacyScriptPlugin(LegacyScriptPlugin&&) = delete;
     LegacyScriptPlugin& operator=(const LegacyScriptPlugin&) = delete;
@@ -56,6 +57,13 @@ class LegacyScriptPlugin : public IScriptPlugin
 
     bool isOurFile(const fs::path&) const override;
     std::unique_ptr<IScript> loadScript(const fs::path&) override;
+
+ private:
+    struct CompiledScript;
+
+    // Scripts parsed before, reused while the file is unchanged, so that
+    // tours played in a loop are only parsed once
+    std::map<fs::path, std::unique_ptr<CompiledScript>> m_compiledScripts;
 };
 
 } // end namespace celestia::scripts
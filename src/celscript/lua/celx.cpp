@@ -12,10 +12,13 @@
 
 #include <config.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <ctime>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <sstream>
 #include <string_view>
@@ -46,6 +49,7 @@
 #include "celx_celestia.h"
 #include "celx_gl.h"
 #include "celx_category.h"
+#include "celx_worker.h"
 
 
 using namespace Eigen;
@@ -69,22 +73,29 @@ static constexpr std::array CelxClassNames
     "class_texture"sv,
     "class_phase"sv,
     "class_category"sv,
+    "class_worker"sv,
 };
 
 // Maximum timeslice a script may run without
 // returning control to celestia
 static const double MaxTimeslice = 5.0;
 
+// Number of functions logged when profiling is stopped
+constexpr std::size_t MaxProfileReportEntries = 20;
+
 // names of callback-functions in Lua:
 const char* KbdCallback = "celestia_keyboard_callback";
 const char* CleanupCallback = "celestia_cleanup_callback";
 
 const char* EventHandlers = "celestia_event_handlers";
+const char* ScheduledCallbacks = "celestia_scheduled_callbacks";
 
 const char* KeyHandler        = "key";
 const char* TickHandler       = "tick";
 const char* MouseDownHandler  = "mousedown";
 const char* MouseUpHandler    = "mouseup";
+const char* SelectionHandler  = "selection";
+const char* ObserverHandler   = "observermoved";
 
 
 #if LUA_VERSION_NUM < 503
@@ -119,10 +130,19 @@ void PushClass(lua_State* l, int id)
     lua_pushlstring(l, CelxClassNames[id].data(), CelxClassNames[id].size());
 }
 
+// Push the registry key of the metatable of a class. Looking up a light
+// userdata doesn't hash and intern a string as the class name does, which
+// matters as a metatable is looked up for every vector, rotation and
+// position a script computes.
+static void PushClassKey(lua_State* l, int id)
+{
+    lua_pushlightuserdata(l, const_cast<std::string_view*>(&CelxClassNames[id])); //NOSONAR
+}
+
 // Set the class (metatable) of the object on top of the stack
 void Celx_SetClass(lua_State* l, int id)
 {
-    PushClass(l, id);
+    PushClassKey(l, id);
     lua_rawget(l, LUA_REGISTRYINDEX);
     if (lua_type(l, -1) != LUA_TTABLE)
         cout << "Metatable for " << CelxClassNames[id] << " not found!\n";
@@ -141,6 +161,9 @@ void Celx_CreateClassMetatable(lua_State* l, int id)
     lua_pushvalue(l, -1);
     PushClass(l, id);
     lua_rawset(l, LUA_REGISTRYINDEX); // registry.metatable = name
+    PushClassKey(l, id);
+    lua_pushvalue(l, -2);
+    lua_rawset(l, LUA_REGISTRYINDEX); // registry[key] = metatable
 
     lua_pushliteral(l, "__index");
     lua_pushvalue(l, -2);
@@ -161,21 +184,14 @@ void Celx_RegisterMethod(lua_State* l, const char* name, lua_CFunction fn)
 // specified class
 bool Celx_istype(lua_State* l, int index, int id)
 {
-    // get registry[metatable]
     if (!lua_getmetatable(l, index))
         return false;
-    lua_rawget(l, LUA_REGISTRYINDEX);
 
-    if (lua_type(l, -1) != LUA_TSTRING)
-    {
-        cout << "Celx_istype failed!  Unregistered class.\n";
-        lua_pop(l, 1);
-        return false;
-    }
-
-    const char* classname = lua_tostring(l, -1);
-    bool result = classname != nullptr && CelxClassNames[id] == std::string_view(classname);
-    lua_pop(l, 1);
+    // compare with registry[key]
+    PushClassKey(l, id);
+    lua_rawget(l, LUA_REGISTRYINDEX);
+    bool result = lua_rawequal(l, -1, -2) != 0;
+    lua_pop(l, 2);
     return result;
 }
 
@@ -241,6 +257,25 @@ double LuaState::getTime() const
 }
 
 
+std::size_t LuaState::getMemoryUsage() const
+{
+    auto kbytes = static_cast<std::size_t>(lua_gc(state, LUA_GCCOUNT, 0));
+    return kbytes * 1024 + static_cast<std::size_t>(lua_gc(state, LUA_GCCOUNTB, 0));
+}
+
+
+double LuaState::getScriptTime() const
+{
+    return scriptTimeStepped ? steppedTime : getTime();
+}
+
+
+void LuaState::setScriptTimeStepped(bool stepped)
+{
+    scriptTimeStepped = stepped;
+}
+
+
 // Check if the running script has exceeded its allowed timeslice
 // and terminate it if it has:
 static void checkTimeslice(lua_State* l, lua_Debug* /*ar*/)
@@ -267,6 +302,17 @@ static void checkTimeslice(lua_State* l, lua_Debug* /*ar*/)
         lua_pushstring(l, errormsg);
         lua_error(l);
     }
+
+    if (luastate->isProfiling())
+        luastate->sampleProfile(l);
+
+#if LUA_VERSION_NUM >= 503
+    // Continue the script in the next frame when it has used up its share
+    // of this one. Only the main script can be suspended, event handlers
+    // are called through lua_pcall and run to completion.
+    if (luastate->frameBudgetExpired() && lua_isyieldable(l))
+        lua_yield(l, 0);
+#endif
 }
 
 
@@ -300,7 +346,7 @@ void LuaState::cleanup()
     if (lua_isnil(costate, -1))
         return;
 
-    timeout = getTime() + 1.0;
+    startTimeslice(1.0);
     if (lua_pcall(costate, 0, 0, 0) != 0)
     {
         GetLogger()->error("Error while executing cleanup-callback: {}\n",
@@ -340,6 +386,86 @@ string LuaState::getErrorMessage()
 }
 
 
+void LuaState::startTimeslice(double duration)
+{
+    timeout = getTime() + duration;
+    profileTime = getTime();
+}
+
+
+bool LuaState::frameBudgetExpired() const
+{
+    return budgetEnd < getTime();
+}
+
+
+bool LuaState::isProfiling() const
+{
+    return profiling;
+}
+
+
+void LuaState::setProfiling(bool enable)
+{
+    if (profiling && !enable)
+    {
+        auto entries = getProfile();
+        GetLogger()->info("Script profile ({} functions):\n", entries.size());
+        for (std::size_t i = 0; i < std::min(entries.size(), MaxProfileReportEntries); ++i)
+        {
+            GetLogger()->info("{:10.3f} ms {:8} samples  {}\n",
+                              entries[i].time * 1000.0, entries[i].samples, entries[i].function);
+        }
+    }
+    else if (enable && !profiling)
+    {
+        profile.clear();
+        profileTime = getTime();
+    }
+
+    profiling = enable;
+}
+
+
+// Charge the time since the previous sample, or since the script was
+// entered, to the function running now. Called from the instruction count
+// hook, so functions get time in proportion to how often they are running
+// when it fires.
+void LuaState::sampleProfile(lua_State* l)
+{
+    double now = getTime();
+    lua_Debug ar;
+    if (lua_getstack(l, 0, &ar) && lua_getinfo(l, "Sn", &ar))
+    {
+        std::string function = fmt::format("{} ({}:{})",
+                                           ar.name != nullptr ? ar.name : "?",
+                                           ar.short_src,
+                                           ar.linedefined);
+        ProfileEntry& entry = profile[function];
+        entry.time += now - profileTime;
+        ++entry.samples;
+    }
+
+    profileTime = now;
+}
+
+
+std::vector<LuaState::ProfileEntry> LuaState::getProfile() const
+{
+    std::vector<ProfileEntry> entries;
+    entries.reserve(profile.size());
+    for (const auto& [function, entry] : profile)
+    {
+        entries.push_back(entry);
+        entries.back().function = function;
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const ProfileEntry& a, const ProfileEntry& b) { return a.time > b.time; });
+    return entries;
+}
+
+
 bool LuaState::timesliceExpired()
 {
     if (timeout < getTime())
@@ -472,7 +598,7 @@ bool LuaState::charEntered(const char* c_p)
     bool result = true;
     lua_getglobal(costate, KbdCallback);
     lua_pushstring(costate, c_p);
-    timeout = getTime() + 1.0;
+    startTimeslice(1.0);
     if (lua_pcall(costate, 1, 1, 0) != 0)
     {
         GetLogger()->error("Error while executing keyboard-callback: {}\n",
@@ -519,7 +645,7 @@ bool LuaState::handleKeyEvent(const char* key)
         lua_pushstring(costate, key);   // the default key handler accepts the key name as an argument
         lua_settable(costate, -3);
 
-        timeout = getTime() + 1.0;
+        startTimeslice(1.0);
         if (lua_pcall(costate, 1, 1, 0) != 0)
         {
             GetLogger()->error("Error while executing keyboard callback: {}\n",
@@ -573,7 +699,7 @@ bool LuaState::handleMouseButtonEvent(float x, float y, int button, bool down)
         lua_pushnumber(costate, y);
         lua_settable(costate, -3);
 
-        timeout = getTime() + 1.0;
+        startTimeslice(1.0);
         if (lua_pcall(costate, 1, 1, 0) != 0)
         {
             GetLogger()->error("Error while executing keyboard callback: {}\n",
@@ -624,7 +750,7 @@ bool LuaState::handleTickEvent(double dt)
         lua_pushnumber(costate, dt);   // the default key handler accepts the key name as an argument
         lua_settable(costate, -3);
 
-        timeout = getTime() + 1.0;
+        startTimeslice(1.0);
         if (lua_pcall(costate, 1, 1, 0) != 0)
         {
             GetLogger()->error("Error while executing tick callback: {}\n",
@@ -645,6 +771,178 @@ bool LuaState::handleTickEvent(double dt)
 }
 
 
+int LuaState::scheduleCallback(lua_State* l, int fn, ScheduleClock clock, double time)
+{
+    lua_getfield(l, LUA_REGISTRYINDEX, ScheduledCallbacks);
+    if (!lua_istable(l, -1))
+    {
+        lua_pop(l, 1);
+        lua_newtable(l);
+        lua_pushvalue(l, -1);
+        lua_setfield(l, LUA_REGISTRYINDEX, ScheduledCallbacks);
+    }
+
+    int id = nextCallbackId++;
+    lua_pushvalue(l, fn);
+    lua_rawseti(l, -2, id);
+    lua_pop(l, 1);
+
+    if (clock == ScheduleClock::Script)
+        scriptTimeCallbacks.push(ScheduledCallback{ time, id });
+    else
+        simulationTimeCallbacks.push(ScheduledCallback{ time, id });
+    return id;
+}
+
+
+// The queue entry of a cancelled callback is left in place; it is dropped
+// when it comes due and its function is gone
+void LuaState::cancelCallback(lua_State* l, int id)
+{
+    lua_getfield(l, LUA_REGISTRYINDEX, ScheduledCallbacks);
+    if (lua_istable(l, -1))
+    {
+        lua_pushnil(l);
+        lua_rawseti(l, -2, id);
+    }
+    lua_pop(l, 1);
+}
+
+
+void LuaState::setEventHandlerRegistered(std::string_view handler, bool registered)
+{
+    if (handler == SelectionHandler)
+    {
+        watchSelection = registered;
+        lastSelection.reset();
+    }
+    else if (handler == ObserverHandler)
+    {
+        watchObserver = registered;
+        lastObserver = nullptr;
+    }
+}
+
+
+void LuaState::runScheduledCallback(int id)
+{
+    lua_getfield(costate, LUA_REGISTRYINDEX, ScheduledCallbacks);
+    if (!lua_istable(costate, -1))
+    {
+        lua_pop(costate, 1);
+        return;
+    }
+
+    lua_rawgeti(costate, -1, id);
+    // Callbacks run once
+    lua_pushnil(costate);
+    lua_rawseti(costate, -3, id);
+    lua_remove(costate, -2);
+    if (!lua_isfunction(costate, -1))
+    {
+        lua_pop(costate, 1);
+        return;
+    }
+
+    startTimeslice(1.0);
+    if (lua_pcall(costate, 0, 0, 0) != 0)
+    {
+        GetLogger()->error("Error while executing scheduled callback: {}\n",
+                           lua_tostring(costate, -1));
+        lua_pop(costate, 1);
+    }
+}
+
+
+// Calls the event handler with a table holding the value on the top of the
+// stack as field, and pops the value
+void LuaState::callEventHandler(const char* handler, const char* field)
+{
+    int value = lua_gettop(costate);
+    lua_getfield(costate, LUA_REGISTRYINDEX, EventHandlers);
+    if (lua_istable(costate, -1))
+    {
+        lua_getfield(costate, -1, handler);
+        if (lua_isfunction(costate, -1))
+        {
+            lua_newtable(costate);
+            lua_pushvalue(costate, value);
+            lua_setfield(costate, -2, field);
+
+            startTimeslice(1.0);
+            if (lua_pcall(costate, 1, 0, 0) != 0)
+            {
+                GetLogger()->error("Error while executing {} callback: {}\n",
+                                   handler, lua_tostring(costate, -1));
+            }
+        }
+    }
+    lua_settop(costate, value - 1);
+}
+
+
+void LuaState::dispatchEvents()
+{
+    if (costate == nullptr ||
+        (scriptTimeCallbacks.empty() && simulationTimeCallbacks.empty() && !watchSelection && !watchObserver))
+    {
+        return;
+    }
+
+    CelestiaCore* appCore = getAppCore(costate, NoErrors);
+    if (appCore == nullptr)
+        return;
+
+    Simulation* sim = appCore->getSimulation();
+    double now = getScriptTime();
+    // Callbacks may schedule others; those due right away run in this frame
+    while (!scriptTimeCallbacks.empty() && scriptTimeCallbacks.top().time <= now)
+    {
+        int id = scriptTimeCallbacks.top().id;
+        scriptTimeCallbacks.pop();
+        runScheduledCallback(id);
+    }
+
+    while (!simulationTimeCallbacks.empty() && simulationTimeCallbacks.top().time <= sim->getTime())
+    {
+        int id = simulationTimeCallbacks.top().id;
+        simulationTimeCallbacks.pop();
+        runScheduledCallback(id);
+    }
+
+    if (watchSelection)
+    {
+        // The first check only records the selection
+        if (Selection sel = sim->getSelection(); !lastSelection.has_value())
+        {
+            lastSelection = sel;
+        }
+        else if (sel != *lastSelection)
+        {
+            lastSelection = sel;
+            object_new(costate, sel);
+            callEventHandler(SelectionHandler, "object");
+        }
+    }
+
+    if (watchObserver)
+    {
+        Observer* observer = sim->getActiveObserver();
+        UniversalCoord position = observer->getPosition();
+        bool moved = lastObserver != nullptr &&
+                     (observer != lastObserver ||
+                      !position.offsetFromKm(lastObserverPosition).isZero(0.0));
+        lastObserver = observer;
+        lastObserverPosition = position;
+        if (moved)
+        {
+            observer_new(costate, observer);
+            callEventHandler(ObserverHandler, "observer");
+        }
+    }
+}
+
+
 int LuaState::loadScript(istream& in, const fs::path& streamname)
 {
     char buf[4096];
@@ -692,8 +990,11 @@ int LuaState::resume()
     if (co != costate)
         return 0;
 
-    timeout = getTime() + MaxTimeslice;
+    startTimeslice(MaxTimeslice);
+    if (frameBudget > 0.0)
+        budgetEnd = getTime() + frameBudget;
     int nArgs = resumeLuaThread(state, co, 0);
+    budgetEnd = std::numeric_limits<double>::infinity();
     if (nArgs < 0)
     {
         alive = false;
@@ -754,6 +1055,8 @@ bool LuaState::tick(double dt)
     if (!isAlive())
         return false;
 
+    steppedTime += dt;
+
     if (ioMode == IOMode::Asking)
     {
         CelestiaCore* appCore = getAppCore(costate, NoErrors);
@@ -800,7 +1103,7 @@ bool LuaState::tick(double dt)
         return false;
     }
 
-    if (dt == 0 || scriptAwakenTime > getTime())
+    if (dt == 0 || scriptAwakenTime > getScriptTime())
         return false;
 
     int nArgs = resume();
@@ -817,7 +1120,7 @@ bool LuaState::tick(double dt)
         delay = lua_tonumber(state, -1);
     else
         delay = 0.0;
-    scriptAwakenTime = getTime() + delay;
+    scriptAwakenTime = getScriptTime() + delay;
 
     // Clean up the stack
     lua_pop(state, nArgs);
@@ -1084,6 +1387,8 @@ bool LuaState::init(CelestiaCore* appCore)
     loadLuaLibs(state);
 
     // Create the celestia object
+    frameBudget = appCore->getConfig()->scriptFrameTimeBudget / 1000.0;
+
     celestia_new(state, appCore);
     lua_setglobal(state, "celestia");
     // add reference to appCore in the registry
@@ -1142,6 +1447,7 @@ static void loadLuaLibs(lua_State* state)
     CreateImageMetaTable(state);
     CreateTextureMetaTable(state);
     CreateCategoryMetaTable(state);
+    CreateWorkerMetaTable(state);
     ExtendCelestiaMetaTable(state);
     ExtendObjectMetaTable(state);
 
@@ -1201,7 +1507,7 @@ bool LuaState::callLuaHook(void* obj, const char* method)
         lua_pushvalue(costate, -2);          // push the Lua object the stack
         lua_remove(costate, -3);        // remove the Lua object from the stack
 
-        timeout = getTime() + 1.0;
+        startTimeslice(1.0);
         if (lua_pcall(costate, 1, 1, 0) != 0)
         {
             GetLogger()->error("Error while executing Lua Hook: {}\n",
@@ -1245,7 +1551,7 @@ bool LuaState::callLuaHook(void* obj, const char* method, const char* keyName)
 
         lua_pushstring(costate, keyName);    // push the char onto the stack
 
-        timeout = getTime() + 1.0;
+        startTimeslice(1.0);
         if (lua_pcall(costate, 2, 1, 0) != 0)
         {
             GetLogger()->error("Error while executing Lua Hook: {}\n",
@@ -1290,7 +1596,7 @@ bool LuaState::callLuaHook(void* obj, const char* method, float x, float y)
         lua_pushnumber(costate, x);          // push x onto the stack
         lua_pushnumber(costate, y);          // push y onto the stack
 
-        timeout = getTime() + 1.0;
+        startTimeslice(1.0);
         if (lua_pcall(costate, 3, 1, 0) != 0)
         {
             GetLogger()->error("Error while executing Lua Hook: {}\n",
@@ -1336,7 +1642,7 @@ bool LuaState::callLuaHook(void* obj, const char* method, float x, float y, int
         lua_pushnumber(costate, y);          // push y onto the stack
         lua_pushnumber(costate, b);          // push b onto the stack
 
-        timeout = getTime() + 1.0;
+        startTimeslice(1.0);
         if (lua_pcall(costate, 4, 1, 0) != 0)
         {
             GetLogger()->error("Error while executing Lua Hook: {}\n",
@@ -1379,7 +1685,7 @@ bool LuaState::callLuaHook(void* obj, const char* method, double dt)
         lua_remove(costate, -3);             // remove the Lua object from the stack
         lua_pushnumber(costate, dt);
 
-        timeout = getTime() + 1.0;
+        startTimeslice(1.0);
         if (lua_pcall(costate, 2, 1, 0) != 0)
         {
             GetLogger()->error("Error while executing Lua Hook: {}\n",
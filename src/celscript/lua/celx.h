@@ -11,8 +11,15 @@
 
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <iosfwd>
+#include <limits>
+#include <map>
+#include <optional>
+#include <queue>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <lua.hpp>
@@ -56,10 +63,31 @@ public:
     void cleanup();
     bool isAlive() const;
     bool timesliceExpired();
+    bool frameBudgetExpired() const;
+
+    // Sampling profiler driven by the timeslice hook
+    struct ProfileEntry
+    {
+        std::string function;
+        double time{ 0.0 };
+        unsigned int samples{ 0 };
+    };
+
+    bool isProfiling() const;
+    void setProfiling(bool);
+    void sampleProfile(lua_State*);
+    // Functions sorted by the time spent in them, longest first
+    std::vector<ProfileEntry> getProfile() const;
     void requestIO();
 
     bool charEntered(const char*);
     double getTime() const;
+    // Bytes of memory allocated by the interpreter
+    std::size_t getMemoryUsage() const;
+    // Time seen by the script: the system clock, or the sum of the time
+    // steps passed to tick() when the clock is stepped
+    double getScriptTime() const;
+    void setScriptTimeStepped(bool);
     int screenshotCount;
     double timeout;
 
@@ -68,6 +96,25 @@ public:
     bool handleMouseButtonEvent(float x, float y, int button, bool down);
     bool handleTickEvent(double dt);
 
+    // Callbacks run once the script time (in seconds) or the simulation
+    // time (a TDB Julian date) reaches a given value. Unlike tick handlers
+    // they cost nothing in the frames before that.
+    enum class ScheduleClock
+    {
+        Script,
+        Simulation,
+    };
+
+    // Schedules the function at the absolute index fn of the stack of l;
+    // returns an id for cancelCallback()
+    int scheduleCallback(lua_State* l, int fn, ScheduleClock clock, double time);
+    void cancelCallback(lua_State* l, int id);
+    // Selection and observer changes are only watched while handlers for
+    // them are registered
+    void setEventHandlerRegistered(std::string_view handler, bool registered);
+    // Runs the callbacks and change handlers that are due, once per frame
+    void dispatchEvents();
+
     // Lua hook handling
     void setLuaPath(const std::string& s);
     void allowSystemAccess();
@@ -88,13 +135,46 @@ public:
     };
 
 private:
+    void startTimeslice(double duration);
+    void runScheduledCallback(int id);
+    void callEventHandler(const char* handler, const char* field);
+
+    struct ScheduledCallback
+    {
+        double time;
+        int id;
+
+        bool operator>(const ScheduledCallback& other) const { return time > other.time; }
+    };
+
+    using CallbackQueue = std::priority_queue<ScheduledCallback,
+                                              std::vector<ScheduledCallback>,
+                                              std::greater<ScheduledCallback>>;
+
     lua_State* state;
     lua_State* costate{ nullptr }; // coroutine stack
     bool alive{ false };
     Timer* timer;
     double scriptAwakenTime{ 0.0 };
+    bool scriptTimeStepped{ false };
+    double steppedTime{ 0.0 };
     IOMode ioMode{ IOMode::NotDetermined };
     bool eventHandlerEnabled{ false };
+    // Seconds per frame the script may run before it is suspended until
+    // the next one, zero for no limit
+    double frameBudget{ 0.0 };
+    double budgetEnd{ std::numeric_limits<double>::infinity() };
+    bool profiling{ false };
+    double profileTime{ 0.0 };
+    std::map<std::string, ProfileEntry> profile;
+    CallbackQueue scriptTimeCallbacks;
+    CallbackQueue simulationTimeCallbacks;
+    int nextCallbackId{ 1 };
+    bool watchSelection{ false };
+    std::optional<Selection> lastSelection;
+    bool watchObserver{ false };
+    const Observer* lastObserver{ nullptr };
+    UniversalCoord lastObserverPosition;
 };
 
 celestia::View* getViewByObserver(const CelestiaCore*, const Observer*);
@@ -10,14 +10,26 @@
 // of the License, or (at your option) any later version.
 
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <limits>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 #include <fmt/format.h>
 
+#include <celastro/astro.h>
 #include <celcompat/filesystem.h>
+#include <celcompat/numbers.h>
 #include <celengine/category.h>
+#include <celengine/deepskyobj.h>
+#include <celengine/dsodb.h>
+#include <celengine/stardb.h>
 #include <celengine/texture.h>
 #include <celestia/audiosession.h>
 #include <celestia/configfile.h>
@@ -25,6 +37,8 @@
 #include <celestia/url.h>
 #include <celestia/celestiacore.h>
 #include <celestia/view.h>
+#include <celmath/mathlib.h>
+#include <celrender/renderprofiler.h>
 #include <celscript/common/scriptmaps.h>
 #include <celttf/truetypefont.h>
 #include <celutil/gettext.h>
@@ -40,6 +54,7 @@
 #include "celx_position.h"
 #include "celx_rotation.h"
 #include "celx_vector.h"
+#include "celx_worker.h"
 #include "celx_category.h"
 
 using namespace std;
@@ -1526,6 +1541,309 @@ static int celestia_dsos(lua_State* l)
     return 1;
 }
 
+
+// Parameters of celestia:findstars() and celestia:finddsos()
+struct SpatialQuery
+{
+    Vector3d center{ Vector3d::Zero() };
+    std::optional<double> radius;
+    std::optional<Vector3d> direction;
+    double angle{ 0.0 };
+    std::optional<float> maxAppMag;
+    std::optional<float> maxAbsMag;
+    std::string spectralType;
+    std::optional<DeepSkyObjectType> dsoType;
+    std::size_t limit{ std::numeric_limits<std::size_t>::max() };
+
+    bool accepts(const Vector3d& position, double& distance) const
+    {
+        Vector3d offset = position - center;
+        distance = offset.norm();
+        if (radius.has_value() && distance > *radius)
+            return false;
+        return !direction.has_value() || offset.dot(*direction) >= std::cos(angle) * distance;
+    }
+};
+
+static std::optional<DeepSkyObjectType> parseDSOType(std::string_view name)
+{
+    if (name == "galaxy"sv)
+        return DeepSkyObjectType::Galaxy;
+    if (name == "globular"sv)
+        return DeepSkyObjectType::Globular;
+    if (name == "nebula"sv)
+        return DeepSkyObjectType::Nebula;
+    if (name == "opencluster"sv)
+        return DeepSkyObjectType::OpenCluster;
+    return std::nullopt;
+}
+
+// Reads the table argument of a spatial query; returns false after raising
+// an error if it is invalid.
+static bool parseSpatialQuery(lua_State* l, const char* method, bool forStars, SpatialQuery& query)
+{
+    if (!lua_istable(l, 2))
+    {
+        Celx_DoError(l, fmt::format("Argument to celestia:{}() must be a table", method).c_str());
+        return false;
+    }
+
+    const CelestiaCore* appCore = this_celestia(l);
+    query.center = appCore->getSimulation()->getActiveObserver()->getPosition().toLy();
+
+    lua_pushnil(l);
+    while (lua_next(l, 2) != 0)
+    {
+        if (lua_type(l, -2) != LUA_TSTRING)
+        {
+            Celx_DoError(l, fmt::format("Keys in table-argument to celestia:{}() must be strings", method).c_str());
+            return false;
+        }
+
+        std::string_view key = lua_tostring(l, -2);
+        const char* badValue = nullptr;
+        if (key == "center"sv)
+        {
+            if (const UniversalCoord* center = to_position(l, -1); center != nullptr)
+                query.center = center->toLy();
+            else
+                badValue = "a position";
+        }
+        else if (key == "direction"sv)
+        {
+            if (const Vector3d* direction = to_vector(l, -1); direction != nullptr && !direction->isZero())
+                query.direction = direction->normalized();
+            else
+                badValue = "a non-zero vector";
+        }
+        else if (key == "spectraltype"sv && forStars)
+        {
+            if (lua_type(l, -1) == LUA_TSTRING)
+                query.spectralType = lua_tostring(l, -1);
+            else
+                badValue = "a string";
+        }
+        else if (key == "type"sv && !forStars)
+        {
+            if (lua_type(l, -1) == LUA_TSTRING)
+                query.dsoType = parseDSOType(lua_tostring(l, -1));
+            if (!query.dsoType.has_value())
+                badValue = "galaxy, globular, nebula or opencluster";
+        }
+        else if (lua_type(l, -1) != LUA_TNUMBER)
+        {
+            GetLogger()->warn("Unknown key: {}\n", key);
+        }
+        else
+        {
+            auto value = static_cast<double>(lua_tonumber(l, -1));
+            if (key == "radius"sv)
+                query.radius = value;
+            else if (key == "angle"sv)
+                query.angle = math::degToRad(value);
+            else if (key == "maxappmag"sv)
+                query.maxAppMag = static_cast<float>(value);
+            else if (key == "maxabsmag"sv)
+                query.maxAbsMag = static_cast<float>(value);
+            else if (key == "limit"sv)
+                query.limit = value > 0.0 ? static_cast<std::size_t>(value) : 0;
+            else
+                GetLogger()->warn("Unknown key: {}\n", key);
+        }
+
+        if (badValue != nullptr)
+        {
+            Celx_DoError(l, fmt::format("Value of {} in celestia:{}() must be {}", key, method, badValue).c_str());
+            return false;
+        }
+
+        lua_pop(l, 1);
+    }
+
+    if (query.direction.has_value() && (query.angle <= 0.0 || query.angle > celestia::numbers::pi))
+    {
+        Celx_DoError(l, fmt::format("A direction in celestia:{}() needs an angle between 0 and 180", method).c_str());
+        return false;
+    }
+
+    if (!query.radius.has_value() && !query.maxAppMag.has_value())
+    {
+        Celx_DoError(l, fmt::format("celestia:{}() needs a radius or maxappmag", method).c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Calls findClose(center, radius) when the query has a radius, otherwise
+// findVisible(center, orientation, fovY) for frustums covering the cone or
+// the whole sky, which may return an object more than once.
+template<typename FindClose, typename FindVisible>
+static void findSpatialCandidates(const SpatialQuery& query,
+                                  const FindClose& findClose,
+                                  const FindVisible& findVisible)
+{
+    if (query.radius.has_value())
+    {
+        findClose(query.center, static_cast<float>(*query.radius));
+        return;
+    }
+
+    // Widened a little so that objects on the frustum edges aren't lost
+    constexpr double margin = 0.01;
+    auto lookAlong = [](const Vector3d& direction)
+    {
+        return Quaterniond::FromTwoVectors(direction, -Vector3d::UnitZ()).cast<float>();
+    };
+
+    if (query.direction.has_value() && query.angle <= celestia::numbers::pi / 4.0)
+    {
+        // The square frustum contains the cone
+        findVisible(query.center,
+                    lookAlong(*query.direction),
+                    static_cast<float>(query.angle * 2.0 + margin));
+        return;
+    }
+
+    // The six faces of a cube
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (double sign : { 1.0, -1.0 })
+        {
+            findVisible(query.center,
+                        lookAlong(Vector3d::Unit(axis) * sign),
+                        static_cast<float>(celestia::numbers::pi / 2.0 + margin));
+        }
+    }
+}
+
+// Puts the objects nearest to the center first, drops duplicates and those
+// beyond the limit, and pushes them as a table.
+template<typename T>
+static void pushSpatialResults(lua_State* l,
+                               std::vector<std::pair<double, T*>>& results,
+                               std::size_t limit)
+{
+    std::sort(results.begin(), results.end());
+    results.erase(std::unique(results.begin(), results.end()), results.end());
+    if (results.size() > limit)
+        results.resize(limit);
+
+    lua_createtable(l, static_cast<int>(results.size()), 0);
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        object_new(l, Selection(results[i].second));
+        lua_rawseti(l, -2, static_cast<int>(i + 1));
+    }
+}
+
+class SpatialStarCollector : public StarHandler
+{
+public:
+    SpatialStarCollector(const SpatialQuery& _query) : query(_query) {}
+
+    void process(const Star& star, float /*distance*/, float /*appMag*/) override
+    {
+        double distance;
+        if (!query.accepts(star.getPosition().cast<double>(), distance))
+            return;
+        if (query.maxAbsMag.has_value() && star.getAbsoluteMagnitude() > *query.maxAbsMag)
+            return;
+        if (query.maxAppMag.has_value() &&
+            star.getApparentMagnitude(static_cast<float>(distance)) > *query.maxAppMag)
+            return;
+        if (!query.spectralType.empty() &&
+            std::string_view(star.getSpectralType()).substr(0, query.spectralType.size()) != query.spectralType)
+            return;
+
+        // The octree only gives const access, but the stars are owned by
+        // the mutable database
+        results.emplace_back(distance, const_cast<Star*>(&star));
+    }
+
+    std::vector<std::pair<double, Star*>> results;
+
+private:
+    const SpatialQuery& query;
+};
+
+class SpatialDSOCollector : public DSOHandler
+{
+public:
+    SpatialDSOCollector(const SpatialQuery& _query) : query(_query) {}
+
+    void process(DeepSkyObject* const& dso, double /*distance*/, float /*appMag*/) override
+    {
+        double distance;
+        if (!query.accepts(dso->getPosition(), distance))
+            return;
+        if (query.dsoType.has_value() && dso->getObjType() != *query.dsoType)
+            return;
+        if (query.maxAbsMag.has_value() && dso->getAbsoluteMagnitude() > *query.maxAbsMag)
+            return;
+        if (query.maxAppMag.has_value() &&
+            astro::absToAppMag(dso->getAbsoluteMagnitude(), static_cast<float>(distance)) > *query.maxAppMag)
+            return;
+
+        results.emplace_back(distance, dso);
+    }
+
+    std::vector<std::pair<double, DeepSkyObject*>> results;
+
+private:
+    const SpatialQuery& query;
+};
+
+static int celestia_findstars(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One table argument expected to function celestia:findstars");
+
+    SpatialQuery query;
+    if (!parseSpatialQuery(l, "findstars", true, query))
+        return 0;
+
+    const StarDatabase* starDB = this_celestia(l)->getSimulation()->getUniverse()->getStarCatalog();
+    SpatialStarCollector collector(query);
+    findSpatialCandidates(query,
+                          [&](const Vector3d& center, float radius)
+                          {
+                              starDB->findCloseStars(collector, center.cast<float>(), radius);
+                          },
+                          [&](const Vector3d& center, const Quaternionf& orientation, float fovY)
+                          {
+                              starDB->findVisibleStars(collector, center.cast<float>(), orientation,
+                                                       fovY, 1.0f, *query.maxAppMag);
+                          });
+
+    pushSpatialResults(l, collector.results, query.limit);
+    return 1;
+}
+
+static int celestia_finddsos(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One table argument expected to function celestia:finddsos");
+
+    SpatialQuery query;
+    if (!parseSpatialQuery(l, "finddsos", false, query))
+        return 0;
+
+    const DSODatabase* dsoDB = this_celestia(l)->getSimulation()->getUniverse()->getDSOCatalog();
+    SpatialDSOCollector collector(query);
+    findSpatialCandidates(query,
+                          [&](const Vector3d& center, float radius)
+                          {
+                              dsoDB->findCloseDSOs(collector, center, radius);
+                          },
+                          [&](const Vector3d& center, const Quaternionf& orientation, float fovY)
+                          {
+                              dsoDB->findVisibleDSOs(collector, center, orientation,
+                                                     fovY, 1.0f, *query.maxAppMag);
+                          });
+
+    pushSpatialResults(l, collector.results, query.limit);
+    return 1;
+}
+
 static int celestia_setambient(lua_State* l)
 {
     Celx_CheckArgs(l, 2, 2, "One argument expected in celestia:setambient");
@@ -1927,7 +2245,147 @@ static int celestia_getscripttime(lua_State* l)
     this_celestia(l);
 
     LuaState* luastate_ptr = getLuaStateObject(l);
-    lua_pushnumber(l, luastate_ptr->getTime());
+    lua_pushnumber(l, luastate_ptr->getScriptTime());
+    return 1;
+}
+
+/*! number, number celestia:preload(table objects)
+ *
+ * Queue the textures and models of objects for loading in the background
+ * and return how many of them are ready and how many there are in all.
+ * Scripts can call it again after wait() until both are equal.
+ */
+static int celestia_preload(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One table argument expected for celestia:preload");
+    CelestiaCore* appCore = this_celestia(l);
+    if (!lua_istable(l, 2))
+    {
+        Celx_DoError(l, "Argument to celestia:preload must be a table of objects");
+        return 0;
+    }
+
+    Renderer::PreloadProgress progress;
+    Renderer* renderer = appCore->getRenderer();
+    for (int i = 1;; ++i)
+    {
+        lua_rawgeti(l, 2, i);
+        if (lua_isnil(l, -1))
+        {
+            lua_pop(l, 1);
+            break;
+        }
+
+        const Selection* sel = to_object(l, -1);
+        if (sel == nullptr)
+        {
+            Celx_DoError(l, "Argument to celestia:preload must be a table of objects");
+            return 0;
+        }
+
+        if (sel->body() != nullptr && appCore->isRendererInitialized())
+            renderer->preload(sel->body(), progress);
+        lua_pop(l, 1);
+    }
+
+    lua_pushnumber(l, progress.ready);
+    lua_pushnumber(l, progress.total);
+    return 2;
+}
+
+/*! worker celestia:newworker(string source, table objects)
+ *
+ * Run Lua source on a background thread in a state of its own. The worker
+ * script can call post(...) to send messages, read by worker:receive(),
+ * and position(i, t) to compute the position of the i-th of objects.
+ * Returns nil and an error message if the source doesn't compile.
+ */
+static int celestia_newworker(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 3, "One or two arguments expected for celestia:newworker");
+    // for error checking only:
+    this_celestia(l);
+
+    std::string_view source = Celx_SafeGetString(l, 2, AllErrors, "First argument to celestia:newworker must be a string");
+    std::vector<Selection> objects;
+    if (lua_gettop(l) >= 3)
+    {
+        if (!lua_istable(l, 3))
+        {
+            Celx_DoError(l, "Second argument to celestia:newworker must be a table of objects");
+            return 0;
+        }
+
+        for (int i = 1;; ++i)
+        {
+            lua_rawgeti(l, 3, i);
+            if (lua_isnil(l, -1))
+            {
+                lua_pop(l, 1);
+                break;
+            }
+
+            const Selection* sel = to_object(l, -1);
+            if (sel == nullptr)
+            {
+                Celx_DoError(l, "Second argument to celestia:newworker must be a table of objects");
+                return 0;
+            }
+
+            objects.push_back(*sel);
+            lua_pop(l, 1);
+        }
+    }
+
+    return worker_new(l, source, std::move(objects));
+}
+
+static int celestia_setscriptprofiling(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One argument expected for celestia:setscriptprofiling");
+    // for error checking only:
+    this_celestia(l);
+
+    bool enable = Celx_SafeGetBoolean(l, 2, AllErrors, "Argument to celestia:setscriptprofiling must be a boolean");
+    getLuaStateObject(l)->setProfiling(enable);
+    return 0;
+}
+
+// Returns the functions sampled since profiling was enabled as a list of
+// tables with name, time (seconds) and samples, longest time first
+static int celestia_getscriptprofile(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for celestia:getscriptprofile");
+    // for error checking only:
+    this_celestia(l);
+
+    auto entries = getLuaStateObject(l)->getProfile();
+    lua_createtable(l, static_cast<int>(entries.size()), 0);
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        lua_createtable(l, 0, 3);
+        lua_pushstring(l, "name");
+        lua_pushstring(l, entries[i].function.c_str());
+        lua_settable(l, -3);
+        setTable(l, "time", entries[i].time);
+        setTable(l, "samples", static_cast<lua_Number>(entries[i].samples));
+        lua_rawseti(l, -2, static_cast<int>(i + 1));
+    }
+
+    return 1;
+}
+
+static int celestia_getpathcachestats(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for celestia:getpathcachestats");
+    CelestiaCore* appCore = this_celestia(l);
+
+    auto stats = appCore->getSimulation()->getUniverse()->getPathCacheStats();
+    lua_createtable(l, 0, 3);
+    setTable(l, "hits", static_cast<lua_Number>(stats.hits));
+    setTable(l, "misses", static_cast<lua_Number>(stats.misses));
+    setTable(l, "size", static_cast<lua_Number>(stats.size));
+
     return 1;
 }
 
@@ -2046,6 +2504,67 @@ static int celestia_registereventhandler(lua_State* l)
 
     lua_settable(l, -3);
 
+    getLuaStateObject(l)->setEventHandlerRegistered(lua_tostring(l, 2), lua_isfunction(l, 3));
+
+    return 0;
+}
+
+/*! number celestia:schedule(number delay, function callback)
+ *
+ * Call callback once, delay seconds of script time from now. Returns an id
+ * for celestia:unschedule().
+ */
+static int celestia_schedule(lua_State* l)
+{
+    Celx_CheckArgs(l, 3, 3, "Two arguments expected for celestia:schedule");
+    // for error checking only:
+    this_celestia(l);
+
+    double delay = Celx_SafeGetNumber(l, 2, AllErrors, "First argument to celestia:schedule must be a number");
+    if (!lua_isfunction(l, 3))
+    {
+        Celx_DoError(l, "Second argument to celestia:schedule must be a function");
+        return 0;
+    }
+
+    LuaState* luastate = getLuaStateObject(l);
+    int id = luastate->scheduleCallback(l, 3, LuaState::ScheduleClock::Script,
+                                        luastate->getScriptTime() + delay);
+    lua_pushnumber(l, id);
+    return 1;
+}
+
+/*! number celestia:scheduleat(number tdb, function callback)
+ *
+ * Call callback once when the simulation time reaches the TDB Julian date
+ * tdb. Returns an id for celestia:unschedule().
+ */
+static int celestia_scheduleat(lua_State* l)
+{
+    Celx_CheckArgs(l, 3, 3, "Two arguments expected for celestia:scheduleat");
+    // for error checking only:
+    this_celestia(l);
+
+    double tdb = Celx_SafeGetNumber(l, 2, AllErrors, "First argument to celestia:scheduleat must be a number");
+    if (!lua_isfunction(l, 3))
+    {
+        Celx_DoError(l, "Second argument to celestia:scheduleat must be a function");
+        return 0;
+    }
+
+    int id = getLuaStateObject(l)->scheduleCallback(l, 3, LuaState::ScheduleClock::Simulation, tdb);
+    lua_pushnumber(l, id);
+    return 1;
+}
+
+static int celestia_unschedule(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One argument expected for celestia:unschedule");
+    // for error checking only:
+    this_celestia(l);
+
+    auto id = static_cast<int>(Celx_SafeGetNumber(l, 2, AllErrors, "Argument to celestia:unschedule must be a number"));
+    getLuaStateObject(l)->cancelCallback(l, id);
     return 0;
 }
 
@@ -2608,6 +3127,11 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "newposition", celestia_newposition);
     Celx_RegisterMethod(l, "newrotation", celestia_newrotation);
     Celx_RegisterMethod(l, "getscripttime", celestia_getscripttime);
+    Celx_RegisterMethod(l, "preload", celestia_preload);
+    Celx_RegisterMethod(l, "newworker", celestia_newworker);
+    Celx_RegisterMethod(l, "setscriptprofiling", celestia_setscriptprofiling);
+    Celx_RegisterMethod(l, "getscriptprofile", celestia_getscriptprofile);
+    Celx_RegisterMethod(l, "getpathcachestats", celestia_getpathcachestats);
     Celx_RegisterMethod(l, "requestkeyboard", celestia_requestkeyboard);
     Celx_RegisterMethod(l, "takescreenshot", celestia_takescreenshot);
     Celx_RegisterMethod(l, "createcelscript", celestia_createcelscript);
@@ -2615,9 +3139,14 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "getscriptpath", celestia_getscriptpath);
     Celx_RegisterMethod(l, "runscript", celestia_runscript);
     Celx_RegisterMethod(l, "registereventhandler", celestia_registereventhandler);
+    Celx_RegisterMethod(l, "schedule", celestia_schedule);
+    Celx_RegisterMethod(l, "scheduleat", celestia_scheduleat);
+    Celx_RegisterMethod(l, "unschedule", celestia_unschedule);
     Celx_RegisterMethod(l, "geteventhandler", celestia_geteventhandler);
     Celx_RegisterMethod(l, "stars", celestia_stars);
     Celx_RegisterMethod(l, "dsos", celestia_dsos);
+    Celx_RegisterMethod(l, "findstars", celestia_findstars);
+    Celx_RegisterMethod(l, "finddsos", celestia_finddsos);
     Celx_RegisterMethod(l, "windowbordersvisible", celestia_windowbordersvisible);
     Celx_RegisterMethod(l, "setwindowbordersvisible", celestia_setwindowbordersvisible);
     Celx_RegisterMethod(l, "seturl", celestia_seturl);
@@ -2673,6 +3202,61 @@ static int celestia_getparamstring(lua_State* l)
     return 1;
 }
 
+static int celestia_setrenderprofiling(lua_State* l)
+{
+    CelxLua celx(l);
+
+    celx.checkArgs(2, 2, "One argument expected to celestia:setrenderprofiling()");
+    bool enable = celx.safeGetBoolean(2, AllErrors, "Argument to celestia:setrenderprofiling must be a boolean");
+    this_celestia(l)->getRenderer()->setProfilingEnabled(enable);
+    return 0;
+}
+
+// Returns the render pass times in milliseconds as a table like
+// { Stars = { cpu = 0.4, gpu = 1.2 }, ... }, or nil while profiling is off.
+// The times become available the frame after profiling is enabled.
+static int celestia_getrenderpasstimes(lua_State* l)
+{
+    CelxLua celx(l);
+
+    celx.checkArgs(1, 1, "No arguments expected to celestia:getrenderpasstimes()");
+    const auto* profiler = std::as_const(*this_celestia(l)->getRenderer()).getProfiler();
+    if (profiler == nullptr)
+    {
+        lua_pushnil(l);
+        return 1;
+    }
+
+    lua_newtable(l);
+    for (unsigned int i = 0; i < static_cast<unsigned int>(render::RenderPass::Count); ++i)
+    {
+        auto pass = static_cast<render::RenderPass>(i);
+        lua_pushstring(l, render::RenderProfiler::getPassName(pass));
+        lua_newtable(l);
+        celx.setTable("cpu", profiler->getCPUTime(pass));
+        if (profiler->hasGPUTimes())
+            celx.setTable("gpu", profiler->getGPUTime(pass));
+        lua_settable(l, -3);
+    }
+    return 1;
+}
+
+// Returns the estimated memory use in bytes of each subsystem as a table
+// like { ["Stars"] = 1.2e8, ["Textures"] = 3.4e7, ... }, plus a total.
+static int celestia_getmemoryusage(lua_State* l)
+{
+    CelxLua celx(l);
+
+    celx.checkArgs(1, 1, "No arguments expected to celestia:getmemoryusage()");
+    MemoryReport report = this_celestia(l)->getMemoryReport();
+
+    lua_createtable(l, 0, static_cast<int>(report.getEntries().size() + 1));
+    for (const auto& entry : report.getEntries())
+        celx.setTable(entry.name.c_str(), static_cast<lua_Number>(entry.bytes));
+    celx.setTable("total", static_cast<lua_Number>(report.getTotal()));
+    return 1;
+}
+
 static int celestia_loadtexture(lua_State* l)
 {
     CelxLua celx(l);
@@ -2928,6 +3512,9 @@ void ExtendCelestiaMetaTable(lua_State* l)
     celx.registerMethod("settimeslice", celestia_settimeslice);
     celx.registerMethod("setluahook", celestia_setluahook);
     celx.registerMethod("getparamstring", celestia_getparamstring);
+    celx.registerMethod("setrenderprofiling", celestia_setrenderprofiling);
+    celx.registerMethod("getrenderpasstimes", celestia_getrenderpasstimes);
+    celx.registerMethod("getmemoryusage", celestia_getmemoryusage);
     celx.registerMethod("getfont", celestia_getfont);
     celx.registerMethod("gettitlefont", celestia_gettitlefont);
     celx.registerMethod("loadtexture", celestia_loadtexture);
@@ -42,7 +42,8 @@ enum
     Celx_Image    = 10,
     Celx_Texture  = 11,
     Celx_Phase    = 12,
-    Celx_Category = 13
+    Celx_Category = 13,
+    Celx_Worker   = 14
 };
 
 template<typename T> int celxClassId(T)
@@ -91,6 +91,11 @@ class CelScriptWrapper : public ExecutionEnvironment
         core.showText(s, horig, vorig, hoff, voff, duration);
     }
 
+    Selection findObjectFromPath(std::string_view path) override
+    {
+        return core.getSimulation()->findObjectFromPath(path);
+    }
+
  private:
     std::unique_ptr<Execution> script{ nullptr };
     CelestiaCore& core;
@@ -155,7 +160,7 @@ static int celscript_tick(lua_State* l)
     CelxLua celx(l);
     auto script = *celx.getThis<CelScriptWrapper*>();
     LuaState* stateObject = celx.getLuaStateObject();
-    double t = stateObject->getTime();
+    double t = stateObject->getScriptTime();
     return celx.push(!(script->tick(t)));
 }
 
@@ -9,17 +9,25 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cstddef>
 #include <cstring>
 #include <iostream>
+#include <vector>
 
 #include <celengine/atmosphere.h>
 #include <celengine/body.h>
+#include <celengine/bodypositions.h>
+#include <celengine/frame.h>
+#include <celengine/timeline.h>
 #include <celengine/timelinephase.h>
 #include <celengine/axisarrow.h>
 #include <celengine/visibleregion.h>
 #include <celengine/planetgrid.h>
 #include <celengine/multitexture.h>
+#include <celephem/orbit.h>
 #include <celestia/celestiacore.h>
+#include <celestia/separationfinder.h>
 #include <celscript/common/scriptmaps.h>
 #include <celutil/logger.h>
 #include <celutil/stringutils.h>
@@ -839,6 +847,116 @@ static int object_getposition(lua_State* l)
     return 1;
 }
 
+// Returns the positions at n times evenly spaced from t0 to t1 as a flat
+// table x1, y1, z1, x2, ... with the coordinates of position:getx() etc.
+// Most positions object:getpositions returns at once, which bounds the
+// memory a single call can allocate
+constexpr double MaxPositionSamples = 1.0e6;
+
+static int object_getpositions(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(4, 4, "Expected three arguments to object:getpositions");
+
+    Selection* sel = this_object(l);
+    double t0 = celx.safeGetNumber(2, AllErrors, "First argument to object:getpositions must be a number");
+    double t1 = celx.safeGetNumber(3, AllErrors, "Second argument to object:getpositions must be a number");
+    double count = celx.safeGetNumber(4, AllErrors, "Third argument to object:getpositions must be a number");
+    if (!(count >= 1.0 && count <= MaxPositionSamples))
+    {
+        celx.doError("Third argument to object:getpositions must be a sample count between 1 and 1000000");
+        return 0;
+    }
+
+    auto n = static_cast<std::size_t>(count);
+    std::vector<double> times(n);
+    for (std::size_t i = 0; i < n; ++i)
+        times[i] = n > 1 ? t0 + (t1 - t0) * static_cast<double>(i) / static_cast<double>(n - 1) : t0;
+
+    std::vector<UniversalCoord> positions;
+    if (const Body* body = sel->body(); body != nullptr)
+    {
+        celestia::engine::GetBodyPositions(*body, times, positions);
+    }
+    else
+    {
+        positions.reserve(n);
+        for (double t : times)
+            positions.push_back(sel->getPosition(t));
+    }
+
+    lua_createtable(l, static_cast<int>(n * 3), 0);
+    int index = 1;
+    for (const UniversalCoord& position : positions)
+    {
+        lua_pushnumber(l, static_cast<double>(position.x));
+        lua_rawseti(l, -2, index++);
+        lua_pushnumber(l, static_cast<double>(position.y));
+        lua_rawseti(l, -2, index++);
+        lua_pushnumber(l, static_cast<double>(position.z));
+        lua_rawseti(l, -2, index++);
+    }
+
+    return 1;
+}
+
+// Returns the times at which first and second appear within maxseparation
+// radians of each other as seen from this object, as an array of tables
+// with the fields starttime, endtime, closesttime and separation. With
+// "limbs" as the last argument the separation is measured between the
+// edges of the disks, so that 0 finds occultations and transits.
+static int object_findseparations(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(6, 7, "Expected five or six arguments to object:findseparations");
+
+    Selection* sel = this_object(l);
+    Selection* first = to_object(l, 2);
+    Selection* second = to_object(l, 3);
+    if (first == nullptr || second == nullptr)
+    {
+        celx.doError("First and second arguments to object:findseparations must be objects");
+        return 0;
+    }
+
+    double t0 = celx.safeGetNumber(4, AllErrors, "Third argument to object:findseparations must be a number");
+    double t1 = celx.safeGetNumber(5, AllErrors, "Fourth argument to object:findseparations must be a number");
+    double maxSeparation = celx.safeGetNumber(6, AllErrors, "Fifth argument to object:findseparations must be a number");
+    const char* measureName = celx.safeGetString(7, WrongType, "Sixth argument to object:findseparations must be a string");
+
+    auto measure = celestia::SeparationFinder::Measure::Centers;
+    if (measureName != nullptr)
+    {
+        if (compareIgnoringCase(measureName, "limbs") == 0)
+        {
+            measure = celestia::SeparationFinder::Measure::Limbs;
+        }
+        else if (compareIgnoringCase(measureName, "centers") != 0)
+        {
+            celx.doError("Sixth argument to object:findseparations must be \"centers\" or \"limbs\"");
+            return 0;
+        }
+    }
+
+    std::vector<celestia::SeparationEvent> events;
+    celestia::SeparationFinder finder(*sel, *first, *second);
+    finder.findEvents(t0, t1, maxSeparation, measure, events);
+
+    lua_createtable(l, static_cast<int>(events.size()), 0);
+    int index = 1;
+    for (const celestia::SeparationEvent& event : events)
+    {
+        lua_createtable(l, 0, 4);
+        celx.setTable("starttime", event.startTime);
+        celx.setTable("endtime", event.endTime);
+        celx.setTable("closesttime", event.closestTime);
+        celx.setTable("separation", event.minSeparation);
+        lua_rawseti(l, -2, index++);
+    }
+
+    return 1;
+}
+
 static int object_getchildren(lua_State* l)
 {
     CelxLua celx(l);
@@ -1412,6 +1530,8 @@ void CreateObjectMetaTable(lua_State* l)
     celx.registerMethod("mark", object_mark);
     celx.registerMethod("unmark", object_unmark);
     celx.registerMethod("getposition", object_getposition);
+    celx.registerMethod("getpositions", object_getpositions);
+    celx.registerMethod("findseparations", object_findseparations);
     celx.registerMethod("getchildren", object_getchildren);
     celx.registerMethod("locations", object_locations);
     celx.registerMethod("bodyfixedframe", object_bodyfixedframe);
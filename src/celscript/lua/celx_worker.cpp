@@ -0,0 +1,559 @@
+// celx_worker.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <variant>
+
+#include <celengine/body.h>
+#include <celengine/deepskyobj.h>
+#include <celengine/frame.h>
+#include <celengine/star.h>
+#include <celengine/timeline.h>
+#include <celengine/timelinephase.h>
+#include <celephem/orbit.h>
+#include "celx.h"
+#include "celx_internal.h"
+#include "celx_worker.h"
+
+using namespace Eigen;
+
+namespace
+{
+
+constexpr const char* WorkerRegistryKey = "celestia-worker";
+
+// Instructions between checks for cancellation
+constexpr int CancelCheckInterval = 1000;
+
+using MessageValue = std::variant<std::monostate, bool, lua_Number, std::string>;
+using Message = std::vector<MessageValue>;
+
+bool
+isThreadSafe(const ReferenceFrame* frame)
+{
+    // Caching frames remember the last orientation computed, which the
+    // render thread may be doing at the same time
+    return dynamic_cast<const CachingFrame*>(frame) == nullptr;
+}
+
+// Computes the position of a star or body without touching state shared
+// with the main thread, as Star::getPosition() and Body::computePosition()
+// do. Returns false when that isn't possible because an orbit or frame
+// along the way isn't thread safe.
+bool
+getStarPosition(const Star* star, double t, UniversalCoord& position)
+{
+    const celestia::ephem::Orbit* orbit = star->getOrbit();
+    if (orbit == nullptr)
+    {
+        position = UniversalCoord::CreateLy(star->getPosition().cast<double>());
+        return true;
+    }
+
+    if (!orbit->isThreadSafe())
+        return false;
+
+    if (const Star* barycenter = star->getOrbitBarycenter(); barycenter != nullptr)
+    {
+        if (!getStarPosition(barycenter, t, position))
+            return false;
+    }
+    else
+    {
+        position = UniversalCoord::CreateLy(star->getPosition().cast<double>());
+    }
+
+    position = position.offsetKm(orbit->positionAtTime(t));
+    return true;
+}
+
+bool
+getBodyPosition(const Body* body, double t, UniversalCoord& position)
+{
+    Vector3d offset = Vector3d::Zero();
+    const ReferenceFrame* frame;
+    for (;;)
+    {
+        const TimelinePhase* phase = body->getTimeline()->findPhase(t).get();
+        frame = phase->orbitFrame().get();
+        if (!phase->orbit()->isThreadSafe() || !isThreadSafe(frame))
+            return false;
+
+        offset += frame->getOrientation(t).conjugate() * phase->orbit()->positionAtTime(t);
+        if (frame->getCenter().getType() != SelectionType::Body)
+            break;
+        body = frame->getCenter().body();
+    }
+
+    if (const Star* star = frame->getCenter().star(); star != nullptr)
+    {
+        if (!getStarPosition(star, t, position))
+            return false;
+    }
+    else if (const DeepSkyObject* dso = frame->getCenter().deepsky(); dso != nullptr)
+    {
+        position = UniversalCoord::CreateLy(dso->getPosition());
+    }
+    else
+    {
+        position = UniversalCoord::Zero();
+    }
+
+    position = position.offsetKm(offset);
+    return true;
+}
+
+} // end unnamed namespace
+
+// A script running on a thread of its own in a separate Lua state. It has
+// no access to the celestia object; it can only compute positions of the
+// objects it was given and post messages back to the main script.
+class CelxWorker
+{
+public:
+    CelxWorker(lua_State* state, std::vector<Selection>&& objects);
+    ~CelxWorker();
+
+    CelxWorker(const CelxWorker&) = delete;
+    CelxWorker& operator=(const CelxWorker&) = delete;
+
+    void start();
+    void cancel();
+    bool isRunning() const;
+    bool receive(Message& message);
+    bool getError(std::string& error) const;
+
+    // Called on the worker thread
+    void post(Message&& message);
+    bool isCancelled() const;
+    const std::vector<Selection>& getObjects() const;
+
+private:
+    void run();
+
+    lua_State* state;
+    std::vector<Selection> objects;
+    std::thread thread;
+    std::atomic<bool> cancelled{ false };
+    std::atomic<bool> running{ false };
+
+    mutable std::mutex mutex;
+    std::deque<Message> messages;
+    std::string error;
+};
+
+CelxWorker::CelxWorker(lua_State* _state, std::vector<Selection>&& _objects) :
+    state(_state),
+    objects(std::move(_objects))
+{
+}
+
+CelxWorker::~CelxWorker()
+{
+    cancel();
+    if (thread.joinable())
+        thread.join();
+    lua_close(state);
+}
+
+void
+CelxWorker::start()
+{
+    running = true;
+    thread = std::thread(&CelxWorker::run, this);
+}
+
+void
+CelxWorker::cancel()
+{
+    cancelled = true;
+}
+
+bool
+CelxWorker::isRunning() const
+{
+    return running;
+}
+
+bool
+CelxWorker::isCancelled() const
+{
+    return cancelled;
+}
+
+const std::vector<Selection>&
+CelxWorker::getObjects() const
+{
+    return objects;
+}
+
+void
+CelxWorker::post(Message&& message)
+{
+    std::scoped_lock lock(mutex);
+    messages.push_back(std::move(message));
+}
+
+bool
+CelxWorker::receive(Message& message)
+{
+    std::scoped_lock lock(mutex);
+    if (messages.empty())
+        return false;
+
+    message = std::move(messages.front());
+    messages.pop_front();
+    return true;
+}
+
+bool
+CelxWorker::getError(std::string& _error) const
+{
+    std::scoped_lock lock(mutex);
+    _error = error;
+    return !error.empty();
+}
+
+void
+CelxWorker::run()
+{
+    if (lua_pcall(state, 0, 0, 0) != 0)
+    {
+        const char* message = lua_tostring(state, -1);
+        std::scoped_lock lock(mutex);
+        error = message != nullptr ? message : "Unknown script error";
+    }
+
+    running = false;
+}
+
+namespace
+{
+
+CelxWorker*
+getWorker(lua_State* l)
+{
+    lua_pushstring(l, WorkerRegistryKey);
+    lua_rawget(l, LUA_REGISTRYINDEX);
+    auto worker = static_cast<CelxWorker*>(lua_touserdata(l, -1));
+    lua_pop(l, 1);
+    return worker;
+}
+
+void
+checkCancelled(lua_State* l, lua_Debug* /*ar*/)
+{
+    if (getWorker(l)->isCancelled())
+    {
+        lua_pushstring(l, "Worker cancelled");
+        lua_error(l);
+    }
+}
+
+// Functions available to the worker script
+
+/*! post(values...)
+ *
+ * Queue a message of nil, boolean, number or string values for the main
+ * script, which reads it with worker:receive().
+ */
+int
+worker_post(lua_State* l)
+{
+    int nArgs = lua_gettop(l);
+    if (nArgs == 0)
+        Celx_DoError(l, "At least one value expected for post()");
+
+    Message message;
+    message.reserve(static_cast<std::size_t>(nArgs));
+    for (int i = 1; i <= nArgs; ++i)
+    {
+        switch (lua_type(l, i))
+        {
+        case LUA_TNIL:
+            message.emplace_back();
+            break;
+        case LUA_TBOOLEAN:
+            message.emplace_back(lua_toboolean(l, i) != 0);
+            break;
+        case LUA_TNUMBER:
+            message.emplace_back(lua_tonumber(l, i));
+            break;
+        case LUA_TSTRING:
+            message.emplace_back(std::string(lua_tostring(l, i)));
+            break;
+        default:
+            Celx_DoError(l, "Only nil, booleans, numbers and strings can be posted");
+            return 0;
+        }
+    }
+
+    getWorker(l)->post(std::move(message));
+    return 0;
+}
+
+/*! number objectcount()
+ *
+ * Return the number of objects passed to celestia:newworker().
+ */
+int
+worker_objectcount(lua_State* l)
+{
+    lua_pushnumber(l, static_cast<lua_Number>(getWorker(l)->getObjects().size()));
+    return 1;
+}
+
+/*! x, y, z position(number index, number t)
+ *
+ * Return the position of an object passed to celestia:newworker() at time
+ * t, in the units of position:getx() etc., or nil if it can't be computed
+ * off the main thread.
+ */
+int
+worker_position(lua_State* l)
+{
+    const auto& objects = getWorker(l)->getObjects();
+    auto index = static_cast<std::size_t>(lua_tonumber(l, 1));
+    if (lua_type(l, 1) != LUA_TNUMBER || index < 1 || index > objects.size())
+        Celx_DoError(l, "First argument to position() must be an object index");
+    if (lua_type(l, 2) != LUA_TNUMBER)
+        Celx_DoError(l, "Second argument to position() must be a time");
+
+    double t = lua_tonumber(l, 2);
+    const Selection& sel = objects[index - 1];
+    UniversalCoord position;
+    bool valid;
+    switch (sel.getType())
+    {
+    case SelectionType::Star:
+        valid = getStarPosition(sel.star(), t, position);
+        break;
+    case SelectionType::Body:
+        valid = getBodyPosition(sel.body(), t, position);
+        break;
+    case SelectionType::DeepSky:
+        position = UniversalCoord::CreateLy(sel.deepsky()->getPosition());
+        valid = true;
+        break;
+    default:
+        valid = false;
+        break;
+    }
+
+    if (!valid)
+    {
+        lua_pushnil(l);
+        return 1;
+    }
+
+    lua_pushnumber(l, static_cast<lua_Number>(position.x));
+    lua_pushnumber(l, static_cast<lua_Number>(position.y));
+    lua_pushnumber(l, static_cast<lua_Number>(position.z));
+    return 3;
+}
+
+void
+openLibrary(lua_State* l, const char* name, lua_CFunction func)
+{
+#if LUA_VERSION_NUM >= 502
+    luaL_requiref(l, name, func, 1);
+    lua_pop(l, 1);
+#else
+    lua_pushcfunction(l, func);
+    lua_pushstring(l, name);
+    lua_call(l, 1, 0);
+#endif
+}
+
+// Methods of the worker object in the main script
+
+std::unique_ptr<CelxWorker>*
+to_worker(lua_State* l, int index)
+{
+    CelxLua celx(l);
+
+    return celx.safeGetClass<std::unique_ptr<CelxWorker>>(index);
+}
+
+CelxWorker*
+this_worker(lua_State* l)
+{
+    CelxLua celx(l);
+
+    auto worker = to_worker(l, 1);
+    if (worker == nullptr || *worker == nullptr)
+    {
+        celx.doError("Bad worker object!");
+        return nullptr;
+    }
+
+    return worker->get();
+}
+
+/*! values... worker:receive()
+ *
+ * Return the values of the oldest message posted by the worker, or
+ * nothing if there is none.
+ */
+int
+worker_receive(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(1, 1, "No arguments expected for worker:receive()");
+
+    Message message;
+    if (!this_worker(l)->receive(message))
+        return 0;
+
+    for (const MessageValue& value : message)
+    {
+        if (const auto* b = std::get_if<bool>(&value); b != nullptr)
+            lua_pushboolean(l, *b);
+        else if (const auto* n = std::get_if<lua_Number>(&value); n != nullptr)
+            lua_pushnumber(l, *n);
+        else if (const auto* s = std::get_if<std::string>(&value); s != nullptr)
+            lua_pushlstring(l, s->data(), s->size());
+        else
+            lua_pushnil(l);
+    }
+
+    return static_cast<int>(message.size());
+}
+
+/*! boolean worker:isrunning()
+ */
+int
+worker_isrunning(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(1, 1, "No arguments expected for worker:isrunning()");
+
+    lua_pushboolean(l, this_worker(l)->isRunning());
+    return 1;
+}
+
+/*! string worker:geterror()
+ *
+ * Return the error that stopped the worker script, or nil.
+ */
+int
+worker_geterror(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(1, 1, "No arguments expected for worker:geterror()");
+
+    std::string error;
+    if (this_worker(l)->getError(error))
+        lua_pushstring(l, error.c_str());
+    else
+        lua_pushnil(l);
+    return 1;
+}
+
+/*! worker:cancel()
+ *
+ * Stop the worker script; messages already posted can still be received.
+ */
+int
+worker_cancel(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(1, 1, "No arguments expected for worker:cancel()");
+
+    this_worker(l)->cancel();
+    return 0;
+}
+
+int
+worker_tostring(lua_State* l)
+{
+    lua_pushstring(l, "[Worker]");
+
+    return 1;
+}
+
+/*! __gc metamethod
+ * Cancels the worker and waits for its thread to finish.
+ */
+int
+worker_gc(lua_State* l)
+{
+    if (auto worker = to_worker(l, 1); worker != nullptr)
+        worker->~unique_ptr();
+
+    return 0;
+}
+
+} // end unnamed namespace
+
+int worker_new(lua_State* l, std::string_view source, std::vector<Selection>&& objects)
+{
+    CelxLua celx(l);
+
+    lua_State* state = luaL_newstate();
+    if (state == nullptr)
+    {
+        lua_pushnil(l);
+        lua_pushstring(l, "Could not create a Lua state for the worker");
+        return 2;
+    }
+
+    openLibrary(state, "_G", luaopen_base);
+    openLibrary(state, LUA_MATHLIBNAME, luaopen_math);
+    openLibrary(state, LUA_TABLIBNAME, luaopen_table);
+    openLibrary(state, LUA_STRLIBNAME, luaopen_string);
+
+    if (luaL_loadbuffer(state, source.data(), source.size(), "worker") != 0)
+    {
+        lua_pushnil(l);
+        lua_pushstring(l, lua_tostring(state, -1));
+        lua_close(state);
+        return 2;
+    }
+
+    auto worker = std::make_unique<CelxWorker>(state, std::move(objects));
+    lua_pushstring(state, WorkerRegistryKey);
+    lua_pushlightuserdata(state, worker.get());
+    lua_rawset(state, LUA_REGISTRYINDEX);
+    lua_register(state, "post", worker_post);
+    lua_register(state, "objectcount", worker_objectcount);
+    lua_register(state, "position", worker_position);
+    lua_sethook(state, checkCancelled, LUA_MASKCOUNT, CancelCheckInterval);
+
+    worker->start();
+
+    // Use placement new to put the worker reference in the userdata block.
+    void* block = lua_newuserdata(l, sizeof(std::unique_ptr<CelxWorker>));
+    new (block) std::unique_ptr<CelxWorker>(std::move(worker));
+    celx.setClass(Celx_Worker);
+
+    return 1;
+}
+
+void CreateWorkerMetaTable(lua_State* l)
+{
+    CelxLua celx(l);
+
+    celx.createClassMetatable(Celx_Worker);
+
+    celx.registerMethod("__tostring", worker_tostring);
+    celx.registerMethod("__gc", worker_gc);
+    celx.registerMethod("receive", worker_receive);
+    celx.registerMethod("isrunning", worker_isrunning);
+    celx.registerMethod("geterror", worker_geterror);
+    celx.registerMethod("cancel", worker_cancel);
+
+    lua_pop(l, 1); // remove metatable from stack
+}
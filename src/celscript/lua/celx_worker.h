@@ -0,0 +1,32 @@
+// celx_worker.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Lua script extensions for Celestia: background worker object
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <celengine/selection.h>
+
+struct lua_State;
+
+class CelxWorker;
+
+inline int celxClassId(const std::unique_ptr<CelxWorker>&)
+{
+    return Celx_Worker;
+}
+
+extern void CreateWorkerMetaTable(lua_State* l);
+// Pushes a worker running source in a state of its own, or nil and an
+// error message if source doesn't compile
+extern int worker_new(lua_State* l, std::string_view source, std::vector<Selection>&& objects);
@@ -72,11 +72,21 @@ bool LuaScript::handleTickEvent(double dt)
     return m_celxScript->handleTickEvent(dt);
 }
 
+void LuaScript::dispatchEvents()
+{
+    m_celxScript->dispatchEvents();
+}
+
 bool LuaScript::tick(double dt)
 {
     return m_celxScript->tick(dt);
 }
 
+std::size_t LuaScript::getMemoryUsage() const
+{
+    return m_celxScript->getMemoryUsage();
+}
+
 bool LuaScriptPlugin::isOurFile(const fs::path &p) const
 {
     auto ext = p.extension();
@@ -93,6 +103,7 @@ unique_ptr<IScript> LuaScriptPlugin::loadScript(const fs::path &path)
     }
 
     auto script = unique_ptr<LuaScript>(new LuaScript(appCore()));
+    script->m_celxScript->setScriptTimeStepped(appCore()->getScriptTimeStepped());
     string errMsg;
     if (!script->load(scriptfile, path, errMsg))
     {
@@ -137,6 +148,16 @@ bool LuaHook::call(const char *method, double dt) const
     return m_state->callLuaHook(appCore(), method, dt);
 }
 
+void LuaHook::dispatchEvents() const
+{
+    m_state->dispatchEvents();
+}
+
+std::size_t LuaHook::getMemoryUsage() const
+{
+    return m_state->getMemoryUsage();
+}
+
 class LuaPathFinder
 {
     set<fs::path> dirs;
@@ -32,7 +32,9 @@ class LuaScript : public IScript
     bool charEntered(const char*) override;
     bool handleKeyEvent(const char* key) override;
     bool handleTickEvent(double dt) override;
+    void dispatchEvents() override;
     bool tick(double) override;
+    std::size_t getMemoryUsage() const override;
 
  private:
     CelestiaCore *m_appCore;
@@ -72,6 +74,8 @@ class LuaHook : public IScriptHook
     bool call(const char *method, float x, float y) const override;
     bool call(const char *method, float x, float y, int b) const override;
     bool call(const char *method, double dt) const override;
+    void dispatchEvents() const override;
+    std::size_t getMemoryUsage() const override;
 
  private:
     std::unique_ptr<LuaState> m_state;
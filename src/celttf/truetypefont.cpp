@@ -13,6 +13,7 @@
 #include <array>
 #include <cstddef>
 #include <memory>
+#include <string>
 #include <system_error>
 #include <unordered_map>
 #include <vector>
@@ -22,8 +23,10 @@
 #include <celengine/render.h>
 #include <celengine/texture.h>
 #include <celimage/image.h>
+#include <celrender/gl/binder.h>
 #include <celrender/gl/buffer.h>
 #include <celrender/gl/vertexobject.h>
+#include <celutil/color.h>
 #include <celutil/logger.h>
 #include <celutil/utf8.h>
 #include <ft2build.h>
@@ -85,6 +88,32 @@ struct TextureFontPrivate
 
     static_assert(std::is_standard_layout_v<FontVertex>);
 
+    // Vertices of batched text, which carry the position and color of
+    // their label
+    struct BatchVertex
+    {
+        BatchVertex(float _x, float _y, float _z, float _u, float _v, const std::array<std::uint8_t, 4> &_color) :
+            x(_x), y(_y), z(_z), u(_u), v(_v), color(_color)
+        {
+        }
+        float x, y, z;
+        float u, v;
+        std::array<std::uint8_t, 4> color;
+    };
+
+    static_assert(std::is_standard_layout_v<BatchVertex>);
+
+    using GlyphQuad = TextLine::Quad;
+
+    // Quads of a line of text relative to its start, and the offset of the
+    // next glyph
+    struct GlyphRun
+    {
+        std::vector<GlyphQuad> quads;
+        float ax{ 0.0f };
+        float ay{ 0.0f };
+    };
+
     TextureFontPrivate(const Renderer *renderer);
     ~TextureFontPrivate();
     TextureFontPrivate() = delete;
@@ -94,7 +123,12 @@ struct TextureFontPrivate
     TextureFontPrivate &operator=(TextureFontPrivate &&) = default;
 
     std::pair<float, float> render(std::u16string_view line, float x, float y);
+    std::pair<float, float> render(TextLine &line, float x, float y);
+    void                    addQuads(const std::vector<GlyphQuad> &quads, float x, float y);
 
+    const GlyphRun &           getGlyphRun(std::u16string_view line);
+    void                       layout(std::u16string_view line, std::vector<GlyphQuad> &quads, float &ax, float &ay);
+    void                       initIndices();
     bool                       buildAtlas();
     void                       computeTextureSize();
     bool                       loadGlyphInfo(FT_ULong /*ch*/, Glyph & /*c*/) const;
@@ -132,15 +166,32 @@ struct TextureFontPrivate
     Eigen::Matrix4f m_modelView;
 
     std::vector<FontVertex> m_fontVertices;
+    std::vector<BatchVertex> m_batchVertices;
+
+    // Runs of the lines rendered recently, cleared when the atlas changes
+    std::unordered_map<std::u16string, GlyphRun> m_runs;
+    // Counts the changes of the atlas, which invalidate laid out TextLines
+    std::uint32_t m_atlasGeneration{ 1 };
 
     gl::VertexObject m_vao{ gl::VertexObject::Primitive::Triangles };
     gl::Buffer       m_vbo{ gl::Buffer::TargetHint::Array };
+    gl::VertexObject m_batchVao{ gl::VertexObject::Primitive::Triangles };
+    gl::Buffer       m_batchVbo{ gl::Buffer::TargetHint::Array };
+    // Indices of consecutive quads, shared by both vertex objects
     gl::Buffer       m_vio{ gl::Buffer::TargetHint::ElementArray };
+    bool             m_indicesReady{ false };
 
     bool m_shaderInUse{ false };
+    bool m_batching{ false };
+    Eigen::Vector3f m_batchOrigin{ Eigen::Vector3f::Zero() };
+    std::array<std::uint8_t, 4> m_batchColor{ 255, 255, 255, 255 };
 
     static constexpr std::size_t MaxVertices = 256; // This gives BO size 4kB, MUST be multiply of 4
-    static constexpr std::size_t MaxIndices = MaxVertices / 4 * 6;
+    // Batches hold the labels of a whole frame in as few draws as possible;
+    // must be a multiple of 4 and fit the 16 bit indices
+    static constexpr std::size_t MaxBatchVertices = 16384;
+    static constexpr std::size_t MaxIndices = MaxBatchVertices / 4 * 6;
+    static constexpr std::size_t MaxCachedRuns = 4096;
 };
 
 
@@ -166,6 +217,32 @@ TextureFontPrivate::TextureFontPrivate(const Renderer *renderer) : m_renderer(re
         sizeof(FontVertex),
         offsetof(FontVertex, u));
     m_vao.setIndexBuffer(m_vio, 0, gl::VertexObject::IndexType::UnsignedShort);
+
+    m_batchVao.addVertexBuffer(
+        m_batchVbo,
+        CelestiaGLProgram::VertexCoordAttributeIndex,
+        3,
+        gl::VertexObject::DataType::Float,
+        false,
+        sizeof(BatchVertex),
+        offsetof(BatchVertex, x));
+    m_batchVao.addVertexBuffer(
+        m_batchVbo,
+        CelestiaGLProgram::TextureCoord0AttributeIndex,
+        2,
+        gl::VertexObject::DataType::Float,
+        false,
+        sizeof(BatchVertex),
+        offsetof(BatchVertex, u));
+    m_batchVao.addVertexBuffer(
+        m_batchVbo,
+        CelestiaGLProgram::ColorAttributeIndex,
+        4,
+        gl::VertexObject::DataType::UnsignedByte,
+        true,
+        sizeof(BatchVertex),
+        offsetof(BatchVertex, color));
+    m_batchVao.setIndexBuffer(m_vio, 0, gl::VertexObject::IndexType::UnsignedShort);
 }
 
 TextureFontPrivate::~TextureFontPrivate()
@@ -297,6 +374,9 @@ TextureFontPrivate::buildAtlas()
     }
 
     m_tex = std::make_unique<ImageTexture>(*img, Texture::EdgeClamp, Texture::NoMipMaps);
+    // the texture coordinates of the cached runs are stale now
+    m_runs.clear();
+    ++m_atlasGeneration;
 
     return true;
 }
@@ -380,18 +460,32 @@ TextureFontPrivate::optimize()
 }
 
 /*
- * Render text using the currently loaded font and currently set font size.
- * Rendering starts at coordinates (x, y), z is always 0.
- * The pixel coordinates that the FreeType2 library uses are scaled by (sx, sy).
+ * Return the quads of a line of text, laid out from (0, 0).
  */
-std::pair<float, float>
-TextureFontPrivate::render(std::u16string_view line, float x, float y)
+const TextureFontPrivate::GlyphRun &
+TextureFontPrivate::getGlyphRun(std::u16string_view line)
 {
-    if (m_tex == nullptr)
-        return {0.0f, 0.0f};
+    if (auto it = m_runs.find(std::u16string(line)); it != m_runs.end())
+        return it->second;
 
-    // Use the texture containing the atlas
-    m_tex->bind();
+    GlyphRun run;
+    layout(line, run.quads, run.ax, run.ay);
+
+    if (m_runs.size() >= MaxCachedRuns)
+        m_runs.clear();
+
+    return m_runs[std::u16string(line)] = std::move(run);
+}
+
+/*
+ * Lay out a line of text from (0, 0), returning its quads and the offset of
+ * the next glyph.
+ */
+void
+TextureFontPrivate::layout(std::u16string_view line, std::vector<GlyphQuad> &quads, float &ax, float &ay)
+{
+    std::vector<std::int32_t> chars;
+    chars.reserve(line.size());
 
     std::u16string_view::size_type i = 0;
     while (i < line.size())
@@ -417,6 +511,20 @@ TextureFontPrivate::render(std::u16string_view line, float x, float y)
             ++i;
             continue;
         }
+
+        // Load the glyphs first, adding one to the atlas rebuilds it and
+        // moves the others
+        getGlyph(ch, u'?');
+        chars.push_back(ch);
+    }
+
+    quads.clear();
+    quads.reserve(chars.size());
+
+    float x = 0.0f;
+    float y = 0.0f;
+    for (std::int32_t ch : chars)
+    {
         auto &g = getGlyph(ch, u'?');
 
         // Calculate the vertex and texture coordinates
@@ -424,8 +532,6 @@ TextureFontPrivate::render(std::u16string_view line, float x, float y)
         const float y1 = y + g.bt - g.bh;
         const float w  = g.bw;
         const float h  = g.bh;
-        const float x2 = x1 + w;
-        const float y2 = y1 + h;
 
         // Advance the cursor to the start of the next character
         x += g.ax;
@@ -434,20 +540,82 @@ TextureFontPrivate::render(std::u16string_view line, float x, float y)
         // Skip glyphs that have no pixels
         if (g.bw == 0 || g.bh == 0) continue;
 
-        const float tx1 = g.tx;
-        const float ty1 = g.ty;
-        const float tx2 = tx1 + w / m_texWidth;
-        const float ty2 = ty1 + h / m_texHeight;
+        quads.push_back({ x1, y1, x1 + w, y1 + h,
+                          g.tx, g.ty, g.tx + w / m_texWidth, g.ty + h / m_texHeight });
+    }
+
+    ax = x;
+    ay = y;
+}
+
+/*
+ * Render text using the currently loaded font and currently set font size.
+ * Rendering starts at coordinates (x, y), z is always 0.
+ * The pixel coordinates that the FreeType2 library uses are scaled by (sx, sy).
+ */
+std::pair<float, float>
+TextureFontPrivate::render(std::u16string_view line, float x, float y)
+{
+    if (m_tex == nullptr)
+        return {0.0f, 0.0f};
+
+    // May rebuild the atlas
+    const GlyphRun &run = getGlyphRun(line);
+    addQuads(run.quads, x, y);
+    return {x + run.ax, y + run.ay};
+}
+
+std::pair<float, float>
+TextureFontPrivate::render(TextLine &line, float x, float y)
+{
+    if (m_tex == nullptr)
+        return {0.0f, 0.0f};
+
+    if (line.m_font != this || line.m_atlasGeneration != m_atlasGeneration)
+    {
+        // May rebuild the atlas, so the generation is taken afterwards
+        layout(line.m_text, line.m_quads, line.m_ax, line.m_ay);
+        line.m_font = this;
+        line.m_atlasGeneration = m_atlasGeneration;
+    }
+
+    addQuads(line.m_quads, x, y);
+    return {x + line.m_ax, y + line.m_ay};
+}
+
+void
+TextureFontPrivate::addQuads(const std::vector<GlyphQuad> &quads, float x, float y)
+{
+    // Use the texture containing the atlas
+    m_tex->bind();
 
-        m_fontVertices.emplace_back(x1, y1, tx1, ty2);
-        m_fontVertices.emplace_back(x2, y1, tx2, ty2);
-        m_fontVertices.emplace_back(x1, y2, tx1, ty1);
-        m_fontVertices.emplace_back(x2, y2, tx2, ty1);
+    if (m_batching)
+    {
+        const float ox = m_batchOrigin.x() + x;
+        const float oy = m_batchOrigin.y() + y;
+        const float z  = m_batchOrigin.z();
+        for (const auto &q : quads)
+        {
+            if (m_batchVertices.size() == MaxBatchVertices) flush();
 
-        if (m_fontVertices.size() == MaxVertices) flush();
+            m_batchVertices.emplace_back(ox + q.x1, oy + q.y1, z, q.tx1, q.ty2, m_batchColor);
+            m_batchVertices.emplace_back(ox + q.x2, oy + q.y1, z, q.tx2, q.ty2, m_batchColor);
+            m_batchVertices.emplace_back(ox + q.x1, oy + q.y2, z, q.tx1, q.ty1, m_batchColor);
+            m_batchVertices.emplace_back(ox + q.x2, oy + q.y2, z, q.tx2, q.ty1, m_batchColor);
+        }
     }
+    else
+    {
+        for (const auto &q : quads)
+        {
+            if (m_fontVertices.size() == MaxVertices) flush();
 
-    return {x, y};
+            m_fontVertices.emplace_back(x + q.x1, y + q.y1, q.tx1, q.ty2);
+            m_fontVertices.emplace_back(x + q.x2, y + q.y1, q.tx2, q.ty2);
+            m_fontVertices.emplace_back(x + q.x1, y + q.y2, q.tx1, q.ty1);
+            m_fontVertices.emplace_back(x + q.x2, y + q.y2, q.tx2, q.ty1);
+        }
+    }
 }
 
 CelestiaGLProgram *
@@ -459,28 +627,52 @@ TextureFontPrivate::getProgram()
 }
 
 void
-TextureFontPrivate::flush()
+TextureFontPrivate::initIndices()
 {
-    if (m_fontVertices.size() < 4)
+    if (m_indicesReady)
         return;
 
     std::vector<std::uint16_t> indexes;
     indexes.reserve(MaxIndices);
-    for (std::uint16_t index = 0; index < static_cast<std::uint16_t>(m_fontVertices.size()); index += 4)
+    for (std::size_t index = 0; index < MaxBatchVertices; index += 4)
     {
-        indexes.push_back(index + 0);
-        indexes.push_back(index + 1);
-        indexes.push_back(index + 2);
-        indexes.push_back(index + 1);
-        indexes.push_back(index + 3);
-        indexes.push_back(index + 2);
+        auto i = static_cast<std::uint16_t>(index);
+        indexes.push_back(i + 0);
+        indexes.push_back(i + 1);
+        indexes.push_back(i + 2);
+        indexes.push_back(i + 1);
+        indexes.push_back(i + 3);
+        indexes.push_back(i + 2);
     }
 
+    m_vio.setData(indexes, gl::Buffer::BufferUsage::StaticDraw);
+    m_vio.unbind();
+    m_indicesReady = true;
+}
+
+void
+TextureFontPrivate::flush()
+{
+    if (m_batching)
+    {
+        if (m_batchVertices.size() < 4)
+            return;
+
+        initIndices();
+        m_batchVbo.invalidateData().setData(m_batchVertices, gl::Buffer::BufferUsage::StreamDraw);
+        m_batchVao.draw(static_cast<int>(m_batchVertices.size() / 4 * 6));
+        m_batchVbo.unbind();
+        m_batchVertices.clear();
+        return;
+    }
+
+    if (m_fontVertices.size() < 4)
+        return;
+
+    initIndices();
     m_vbo.invalidateData().setData(m_fontVertices, gl::Buffer::BufferUsage::StreamDraw);
-    m_vio.invalidateData().setData(indexes, gl::Buffer::BufferUsage::StreamDraw);
-    m_vao.draw(static_cast<int>(indexes.size()));
+    m_vao.draw(static_cast<int>(m_fontVertices.size() / 4 * 6));
     m_vbo.unbind();
-    m_vio.unbind();
 
     m_fontVertices.clear();
 }
@@ -510,6 +702,33 @@ TextureFont::render(std::u16string_view line, float xoffset, float yoffset) cons
     return impl->render(line, xoffset, yoffset);
 }
 
+/**
+ * Render a line which keeps its layout with the specified offset
+ *
+ * @param line -- line to render, laid out if needed
+ * @param xoffset -- horizontal offset
+ * @param yoffset -- vertical offset
+ * @return the start position for the next glyph
+ */
+std::pair<float, float>
+TextureFont::render(TextLine &line, float xoffset, float yoffset) const
+{
+    return impl->render(line, xoffset, yoffset);
+}
+
+/**
+ * Set the text of the line, which has to be laid out again if it changed
+ */
+void
+TextLine::setText(std::u16string_view text)
+{
+    if (text == m_text)
+        return;
+
+    m_text = text;
+    m_font = nullptr;
+}
+
 /**
  * Calculate string width in pixels
  *
@@ -521,14 +740,7 @@ TextureFont::render(std::u16string_view line, float xoffset, float yoffset) cons
 int
 TextureFont::getWidth(std::u16string_view line) const
 {
-    int  width     = 0;
-    for (auto ch : line)
-    {
-        auto &g = impl->getGlyph(ch, u'?');
-        width += g.ax;
-    }
-
-    return width;
+    return static_cast<int>(impl->getGlyphRun(line).ax);
 }
 
 /**
@@ -596,7 +808,7 @@ TextureFont::bind()
     if (prog == nullptr || impl->m_tex == nullptr)
         return;
 
-    glActiveTexture(GL_TEXTURE0);
+    gl::Binder::get().activeTexture(0);
     impl->m_tex->bind();
     prog->use();
     prog->samplerParam("atlasTex") = 0;
@@ -615,7 +827,7 @@ TextureFont::setMVPMatrices(const Eigen::Matrix4f &p, const Eigen::Matrix4f &m)
     auto *prog         = impl->getProgram();
     if (prog != nullptr && impl->m_shaderInUse)
     {
-        flush();
+        impl->flush();
         prog->setMVPMatrices(p, m);
     }
 }
@@ -626,7 +838,7 @@ TextureFont::setMVPMatrices(const Eigen::Matrix4f &p, const Eigen::Matrix4f &m)
 void
 TextureFont::unbind()
 {
-    flush();
+    impl->flush();
     impl->m_shaderInUse = false;
 }
 
@@ -635,8 +847,39 @@ TextureFont::unbind()
  */
 void
 TextureFont::flush()
+{
+    if (!impl->m_batching)
+        impl->flush();
+}
+
+/**
+ * Start collecting text into a single batch.
+ */
+void
+TextureFont::beginBatch()
+{
+    impl->flush();
+    impl->m_batching = true;
+}
+
+/**
+ * Set where and in which color the following batched text is drawn.
+ */
+void
+TextureFont::setBatchOrigin(const Eigen::Vector3f &origin, const Color &color)
+{
+    impl->m_batchOrigin = origin;
+    color.get(impl->m_batchColor.data());
+}
+
+/**
+ * Draw the batched text and return to drawing as text is flushed.
+ */
+void
+TextureFont::endBatch()
 {
     impl->flush();
+    impl->m_batching = false;
 }
 
 namespace
@@ -9,14 +9,18 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include <Eigen/Core>
 
 #include <celcompat/filesystem.h>
 
 
+class Color;
 class Renderer;
 class TextureFont;
 
@@ -27,6 +31,36 @@ fs::path
 ParseFontName(const fs::path &, int &, int &);
 
 struct TextureFontPrivate;
+
+// A line of text which keeps its layout, for text that its owner draws
+// again and again, like the lines of the console. Unlike the lines passed
+// to TextureFont::render as strings it doesn't have to be looked up in
+// the cache of the font. It is laid out again when it is drawn with
+// another font or the glyph atlas of the font has changed.
+class TextLine
+{
+public:
+    void setText(std::u16string_view text);
+    const std::u16string &text() const { return m_text; }
+
+private:
+    struct Quad
+    {
+        float x1, y1, x2, y2;
+        float tx1, ty1, tx2, ty2;
+    };
+
+    std::u16string m_text;
+    std::vector<Quad> m_quads;
+    float m_ax{ 0.0f };
+    float m_ay{ 0.0f };
+    // The font and atlas the layout belongs to, none if it has to be done
+    const TextureFontPrivate *m_font{ nullptr };
+    std::uint32_t m_atlasGeneration{ 0 };
+
+    friend struct TextureFontPrivate;
+};
+
 class TextureFont
 {
 public:
@@ -44,6 +78,7 @@ public:
                         const Eigen::Matrix4f &m = Eigen::Matrix4f::Identity());
 
     std::pair<float, float> render(std::u16string_view line, float xoffset = 0.0f, float yoffset = 0.0f) const;
+    std::pair<float, float> render(TextLine &line, float xoffset = 0.0f, float yoffset = 0.0f) const;
 
     int getWidth(std::u16string_view) const;
     int getMaxWidth() const;
@@ -58,6 +93,14 @@ public:
     void unbind();
     void flush();
 
+    // Between beginBatch() and endBatch() flush() doesn't draw, so that the
+    // text of many labels is drawn together. Text rendered after
+    // setBatchOrigin() is offset by origin, whose z is its depth, and drawn
+    // in color instead of the current color attribute.
+    void beginBatch();
+    void setBatchOrigin(const Eigen::Vector3f &origin, const Color &color);
+    void endBatch();
+
 private:
     std::unique_ptr<TextureFontPrivate> impl;
 
@@ -38,6 +38,7 @@ enum class ContentType
 #ifdef USE_LIBAVIF
     AVIF                   = 23,
 #endif
+    KTX2                   = 24,
     Unknown                = -1,
 };
 
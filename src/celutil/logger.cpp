@@ -9,12 +9,18 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #ifdef _MSC_VER
 #include <windows.h>
 #endif
-#include <fmt/ostream.h>
 #include "logger.h"
 
 namespace celestia::util
@@ -42,6 +48,129 @@ Logger* CreateLogger(Level level, Logger::Stream &log, Logger::Stream &err)
 void DestroyLogger()
 {
     delete Logger::g_logger;
+    Logger::g_logger = nullptr;
+}
+
+// A fixed size ring of formatted messages, written out in batches by a
+// thread of its own. Producers only hold the lock to move a string in.
+class Logger::AsyncWriter
+{
+public:
+    AsyncWriter(const Logger &logger, std::size_t queueSize);
+    ~AsyncWriter();
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    void push(Level level, std::string &&text);
+    void flush();
+
+private:
+    struct Message
+    {
+        Level level;
+        std::string text;
+    };
+
+    void run();
+
+    const Logger &m_logger;
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::condition_variable m_written;
+    std::vector<Message> m_ring;
+    std::size_t m_head{ 0 };
+    std::size_t m_count{ 0 };
+    std::uint64_t m_pushed{ 0 };
+    std::uint64_t m_done{ 0 };
+    std::size_t m_dropped{ 0 };
+    bool m_stop{ false };
+    std::thread m_thread;
+};
+
+Logger::AsyncWriter::AsyncWriter(const Logger &logger, std::size_t queueSize) :
+    m_logger(logger),
+    m_ring(std::max(queueSize, std::size_t(1)))
+{
+    m_thread = std::thread(&AsyncWriter::run, this);
+}
+
+Logger::AsyncWriter::~AsyncWriter()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_notEmpty.notify_one();
+    m_thread.join();
+}
+
+void Logger::AsyncWriter::push(Level level, std::string &&text)
+{
+    {
+        std::unique_lock lock(m_mutex);
+        if (m_count == m_ring.size())
+        {
+            if (level > Level::Info)
+            {
+                ++m_dropped;
+                return;
+            }
+            m_notFull.wait(lock, [this] { return m_count < m_ring.size(); });
+        }
+
+        auto &message = m_ring[(m_head + m_count) % m_ring.size()];
+        message.level = level;
+        message.text = std::move(text);
+        ++m_count;
+        ++m_pushed;
+    }
+    m_notEmpty.notify_one();
+}
+
+void Logger::AsyncWriter::flush()
+{
+    std::unique_lock lock(m_mutex);
+    std::uint64_t target = m_pushed;
+    m_written.wait(lock, [this, target] { return m_done >= target; });
+}
+
+void Logger::AsyncWriter::run()
+{
+    std::vector<Message> batch;
+    for (;;)
+    {
+        std::size_t dropped;
+        {
+            std::unique_lock lock(m_mutex);
+            m_notEmpty.wait(lock, [this] { return m_count > 0 || m_stop; });
+            if (m_count == 0)
+                return;
+
+            for (; m_count > 0; --m_count)
+            {
+                batch.push_back(std::move(m_ring[m_head]));
+                m_head = (m_head + 1) % m_ring.size();
+            }
+            dropped = std::exchange(m_dropped, 0);
+        }
+        m_notFull.notify_all();
+
+        if (dropped > 0)
+            m_logger.write(Level::Warning, fmt::format("{} log messages dropped\n", dropped));
+        for (const Message &message : batch)
+            m_logger.write(message.level, message.text);
+        m_logger.m_log.flush();
+        m_logger.m_err.flush();
+
+        {
+            std::scoped_lock lock(m_mutex);
+            m_done += batch.size();
+        }
+        m_written.notify_all();
+        batch.clear();
+    }
 }
 
 Logger::Logger() :
@@ -50,18 +179,57 @@ Logger::Logger() :
 {
 }
 
+Logger::Logger(Level level, Stream &log, Stream &err) :
+    m_log(log),
+    m_err(err),
+    m_level(level)
+{
+}
+
+Logger::~Logger() = default;
+
+void Logger::startAsync(std::size_t queueSize)
+{
+    if (m_async == nullptr)
+        m_async = std::make_unique<AsyncWriter>(*this, queueSize);
+}
+
+void Logger::stopAsync()
+{
+    m_async = nullptr;
+}
+
+void Logger::flush() const
+{
+    if (m_async != nullptr)
+        m_async->flush();
+}
+
 void Logger::vlog(Level level, fmt::string_view format, fmt::format_args args) const
+{
+    if (m_async == nullptr)
+    {
+        write(level, fmt::vformat(format, args));
+        return;
+    }
+
+    m_async->push(level, fmt::vformat(format, args));
+    if (level == Level::Error)
+        m_async->flush();
+}
+
+void Logger::write(Level level, std::string_view message) const
 {
 #ifdef _MSC_VER
     if (level == Level::Debug && IsDebuggerPresent())
     {
-        OutputDebugStringA(fmt::vformat(format, args).c_str());
+        OutputDebugStringA(std::string(message).c_str());
         return;
     }
 #endif
 
     auto &stream = (level <= Level::Warning || level == Level::Debug) ? m_err : m_log;
-    fmt::vprint(stream, format, args);
+    stream.write(message.data(), static_cast<std::streamsize>(message.size()));
 }
 
 } // end namespace celestia::util
@@ -11,8 +11,11 @@
 
 #pragma once
 
+#include <cstddef>
 #include <iosfwd>
+#include <memory>
 #include <string>
+#include <string_view>
 
 #include <fmt/format.h>
 
@@ -45,18 +48,33 @@ class Logger
  public:
     using Stream = std::basic_ostream<char>;
 
+    static constexpr std::size_t DefaultQueueSize = 4096;
+
     Logger();
-    Logger(Level level, Stream &log, Stream &err) :
-        m_log(log),
-        m_err(err),
-        m_level(level)
-    {}
+    Logger(Level level, Stream &log, Stream &err);
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
 
     void setLevel(Level level)
     {
         m_level = level;
     }
 
+    // Formats messages on the calling thread but writes them to the streams
+    // on a thread of its own. At most queueSize messages wait to be written;
+    // when the queue is full, verbose and debug messages are dropped and the
+    // others wait for room. Errors are written before the call logging them
+    // returns. While this is on, the streams must only be written to from
+    // the logger.
+    void startAsync(std::size_t queueSize = DefaultQueueSize);
+    // Writes the queued messages, then goes back to writing on the calling
+    // thread
+    void stopAsync();
+    // Waits until the queued messages are written
+    void flush() const;
+
     template <typename... Args> inline void
     debug(const char *format, const Args&... args) const;
 
@@ -78,11 +96,15 @@ class Logger
     static Logger* g_logger;
 
  private:
+    class AsyncWriter;
+
     void vlog(Level level, fmt::string_view format, fmt::format_args args) const;
+    void write(Level level, std::string_view message) const;
 
     Stream &m_log;
     Stream &m_err;
     Level   m_level { Level::Info };
+    std::unique_ptr<AsyncWriter> m_async;
 };
 
 template <typename... Args> void
@@ -0,0 +1,102 @@
+// mappedfile.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace celestia::util
+{
+
+#ifdef _WIN32
+
+MappedFile::~MappedFile()
+{
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    if (m_mapping != nullptr)
+        CloseHandle(m_mapping);
+}
+
+std::unique_ptr<MappedFile>
+MappedFile::open(const fs::path& path)
+{
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    // The mapping keeps its own reference to the file
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+        return nullptr;
+
+    std::unique_ptr<MappedFile> mappedFile{ new MappedFile };
+    mappedFile->m_mapping = mapping;
+    mappedFile->m_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (mappedFile->m_data == nullptr)
+        return nullptr;
+
+    mappedFile->m_size = static_cast<std::size_t>(fileSize.QuadPart);
+    return mappedFile;
+}
+
+#else
+
+MappedFile::~MappedFile()
+{
+    if (m_data != nullptr)
+        munmap(const_cast<char*>(m_data), m_size); //NOSONAR
+}
+
+std::unique_ptr<MappedFile>
+MappedFile::open(const fs::path& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY); //NOSONAR
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    // The mapping stays valid after the file descriptor is closed
+    auto size = static_cast<std::size_t>(st.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    std::unique_ptr<MappedFile> mappedFile{ new MappedFile };
+    mappedFile->m_data = static_cast<const char*>(data);
+    mappedFile->m_size = size;
+    return mappedFile;
+}
+
+#endif
+
+} // end namespace celestia::util
@@ -0,0 +1,49 @@
+// mappedfile.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Read-only memory mapped files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include <celcompat/filesystem.h>
+
+namespace celestia::util
+{
+
+class MappedFile
+{
+public:
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    // Maps the whole file into memory, returns nullptr if the file cannot be
+    // opened or mapped. Empty files cannot be mapped.
+    static std::unique_ptr<MappedFile> open(const fs::path&);
+
+    const char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+private:
+    MappedFile() = default;
+
+    const char* m_data{ nullptr };
+    std::size_t m_size{ 0 };
+#ifdef _WIN32
+    void* m_mapping{ nullptr };
+#endif
+};
+
+} // end namespace celestia::util
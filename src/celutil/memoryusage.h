@@ -0,0 +1,36 @@
+// memoryusage.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Helpers for estimating the memory taken by containers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace celestia::util
+{
+
+// Heap memory held by a vector, not including what its elements point to
+template<typename T>
+std::size_t
+MemoryUsage(const std::vector<T>& v)
+{
+    return v.capacity() * sizeof(T);
+}
+
+// Heap memory held by a string; short strings are stored inline
+inline std::size_t
+MemoryUsage(const std::string& s)
+{
+    return s.capacity() > std::string().capacity() ? s.capacity() + 1 : 0;
+}
+
+} // end namespace celestia::util
@@ -0,0 +1,104 @@
+// objectpool.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Fixed size allocator for objects created in large numbers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace celestia::util
+{
+
+/*! Hands out memory for objects of type T from blocks of BLOCKSIZE slots,
+ *  so that many small objects don't each pay for the general purpose
+ *  allocator's bookkeeping and don't scatter across the heap. Freed slots
+ *  are reused before a new block is allocated; blocks are only released
+ *  with the pool. The pool only provides memory, constructing and
+ *  destroying the objects is up to the caller. It is safe to use from
+ *  several threads.
+ */
+template<typename T, std::size_t BLOCKSIZE = 256>
+class ObjectPool
+{
+public:
+    ObjectPool() = default;
+    ~ObjectPool() = default;
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+    ObjectPool(ObjectPool&&) = delete;
+    ObjectPool& operator=(ObjectPool&&) = delete;
+
+    void* allocate()
+    {
+        std::scoped_lock lock(m_mutex);
+        if (m_freeList == nullptr)
+        {
+            auto& block = m_blocks.emplace_back(std::make_unique<Slot[]>(BLOCKSIZE));
+            for (std::size_t i = BLOCKSIZE; i-- > 0;)
+            {
+                block[i].next = m_freeList;
+                m_freeList = &block[i];
+            }
+        }
+
+        Slot* slot = m_freeList;
+        m_freeList = slot->next;
+        ++m_count;
+        return slot->storage;
+    }
+
+    void deallocate(void* p) noexcept
+    {
+        if (p == nullptr)
+            return;
+
+        std::scoped_lock lock(m_mutex);
+        // storage is the first member, so the slot has the same address
+        auto* slot = static_cast<Slot*>(p);
+        slot->next = m_freeList;
+        m_freeList = slot;
+        --m_count;
+    }
+
+    // Number of objects allocated from the pool
+    std::size_t size() const
+    {
+        std::scoped_lock lock(m_mutex);
+        return m_count;
+    }
+
+    // Bytes of memory held by the pool, whether in use or not
+    std::size_t memoryUsage() const
+    {
+        std::scoped_lock lock(m_mutex);
+        return m_blocks.size() * BLOCKSIZE * sizeof(Slot) + m_blocks.capacity() * sizeof(m_blocks[0]);
+    }
+
+private:
+    union Slot
+    {
+        Slot() : next(nullptr) {}
+
+        alignas(T) std::byte storage[sizeof(T)];
+        Slot* next;
+    };
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Slot[]>> m_blocks;
+    Slot* m_freeList{ nullptr };
+    std::size_t m_count{ 0 };
+};
+
+} // end namespace celestia::util
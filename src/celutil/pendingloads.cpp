@@ -0,0 +1,42 @@
+// pendingloads.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "pendingloads.h"
+
+#include <atomic>
+
+namespace celestia::util
+{
+
+namespace
+{
+
+std::atomic<std::size_t> pendingLoads{ 0 };
+
+} // end unnamed namespace
+
+void
+BeginPendingLoads(std::size_t count)
+{
+    pendingLoads.fetch_add(count, std::memory_order_relaxed);
+}
+
+void
+EndPendingLoads(std::size_t count)
+{
+    pendingLoads.fetch_sub(count, std::memory_order_relaxed);
+}
+
+std::size_t
+GetPendingLoadCount()
+{
+    return pendingLoads.load(std::memory_order_relaxed);
+}
+
+} // end namespace celestia::util
@@ -0,0 +1,29 @@
+// pendingloads.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Count of resources being loaded in the background.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+
+namespace celestia::util
+{
+
+// Loaders that draw something cheaper while a resource is read on another
+// thread report each resource from the time it is queued until it can be
+// used, so that offline rendering can wait for a view to be complete
+// before capturing it. Safe to call from any thread.
+void BeginPendingLoads(std::size_t count = 1);
+void EndPendingLoads(std::size_t count = 1);
+
+// Returns the number of resources queued or being loaded by any loader
+std::size_t GetPendingLoadCount();
+
+} // end namespace celestia::util
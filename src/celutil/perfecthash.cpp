@@ -0,0 +1,148 @@
+// perfecthash.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "perfecthash.h"
+
+#include <algorithm>
+
+namespace celestia::util
+{
+
+namespace
+{
+
+// Seeds tried for a bucket before giving up
+constexpr std::uint32_t MaxSeed = UINT32_C(1) << 20;
+
+} // end unnamed namespace
+
+bool
+PerfectHashIndex::build(const std::vector<std::uint32_t>& keys)
+{
+    clear();
+    if (keys.empty())
+        return true;
+    if (keys.size() >= DirectSlot)
+        return false;
+
+    const std::size_t nBuckets = std::max(keys.size() / 2, std::size_t(1));
+
+    // Group the keys by bucket with a counting sort, which keeps them in
+    // their original order within each bucket
+    std::vector<std::uint32_t> bucketStart(nBuckets + 1, 0);
+    std::vector<std::uint32_t> keyBucket(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+        keyBucket[i] = reduce(hash(keys[i], 0), nBuckets);
+        ++bucketStart[keyBucket[i] + 1];
+    }
+    for (std::size_t b = 0; b < nBuckets; ++b)
+        bucketStart[b + 1] += bucketStart[b];
+
+    std::vector<Entry> grouped(keys.size());
+    {
+        std::vector<std::uint32_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+        for (std::size_t i = 0; i < keys.size(); ++i)
+            grouped[fill[keyBucket[i]]++] = { keys[i], static_cast<std::uint32_t>(i) };
+    }
+
+    // Drop repeated keys, keeping the first position of each
+    std::uint32_t nSlots = 0;
+    for (std::size_t b = 0; b < nBuckets; ++b)
+    {
+        const std::uint32_t first = nSlots;
+        for (std::uint32_t i = bucketStart[b]; i < bucketStart[b + 1]; ++i)
+        {
+            if (std::none_of(grouped.begin() + first, grouped.begin() + nSlots,
+                             [key = grouped[i].key](const Entry& e) { return e.key == key; }))
+                grouped[nSlots++] = grouped[i];
+        }
+        bucketStart[b] = first;
+    }
+    bucketStart[nBuckets] = nSlots;
+    grouped.resize(nSlots);
+
+    // Place the largest buckets first, while most slots are still free. The
+    // buckets are ordered by a counting sort on their size.
+    std::uint32_t maxCount = 0;
+    for (std::size_t b = 0; b < nBuckets; ++b)
+        maxCount = std::max(maxCount, bucketStart[b + 1] - bucketStart[b]);
+
+    std::vector<std::uint32_t> sizeStart(maxCount + 2, 0);
+    for (std::size_t b = 0; b < nBuckets; ++b)
+        ++sizeStart[maxCount - (bucketStart[b + 1] - bucketStart[b]) + 1];
+    for (std::uint32_t i = 0; i <= maxCount; ++i)
+        sizeStart[i + 1] += sizeStart[i];
+
+    std::vector<std::uint32_t> order(nBuckets);
+    for (std::size_t b = 0; b < nBuckets; ++b)
+        order[sizeStart[maxCount - (bucketStart[b + 1] - bucketStart[b])]++] = static_cast<std::uint32_t>(b);
+
+    std::vector<std::uint32_t> seeds(nBuckets, 0);
+    std::vector<Entry> table(nSlots);
+    std::vector<std::uint8_t> used(nSlots, 0);
+    std::vector<std::uint32_t> slots;
+    std::size_t nextFree = 0;
+    for (std::uint32_t bucket : order)
+    {
+        const std::uint32_t first = bucketStart[bucket];
+        const std::uint32_t count = bucketStart[bucket + 1] - first;
+        if (count == 0)
+            break;
+
+        if (count == 1)
+        {
+            while (used[nextFree] != 0)
+                ++nextFree;
+            used[nextFree] = 1;
+            table[nextFree] = grouped[first];
+            seeds[bucket] = DirectSlot | static_cast<std::uint32_t>(nextFree);
+            continue;
+        }
+
+        std::uint32_t seed = 1;
+        for (; seed < MaxSeed; ++seed)
+        {
+            slots.clear();
+            for (std::uint32_t i = first; i < first + count; ++i)
+            {
+                std::uint32_t slot = reduce(hash(grouped[i].key, seed), nSlots);
+                if (used[slot] != 0 || std::find(slots.begin(), slots.end(), slot) != slots.end())
+                    break;
+                slots.push_back(slot);
+            }
+
+            if (slots.size() == count)
+                break;
+        }
+
+        if (seed == MaxSeed)
+            return false;
+
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            used[slots[i]] = 1;
+            table[slots[i]] = grouped[first + i];
+        }
+        seeds[bucket] = seed;
+    }
+
+    m_seeds = std::move(seeds);
+    m_entries = std::move(table);
+    return true;
+}
+
+void
+PerfectHashIndex::clear()
+{
+    m_seeds = {};
+    m_entries = {};
+}
+
+} // end namespace celestia::util
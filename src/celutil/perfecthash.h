@@ -0,0 +1,88 @@
+// perfecthash.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Minimal perfect hash index of 32-bit keys.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace celestia::util
+{
+
+// Maps a fixed set of 32-bit keys to the positions they were listed at, with
+// a single probe per lookup. Keys are spread over buckets of two on average,
+// and each bucket stores the hash seed that moves all its keys to free slots
+// of a table with one slot per key; buckets with a single key store the slot
+// directly. Each slot keeps its key, so keys that weren't indexed are
+// rejected.
+class PerfectHashIndex
+{
+public:
+    static constexpr std::uint32_t NotFound = ~UINT32_C(0);
+
+    // Indexes keys[i] -> i. Where a key is listed more than once, the first
+    // position is kept. Returns false and leaves the index empty if no hash
+    // could be found, which shouldn't happen in practice.
+    bool build(const std::vector<std::uint32_t>& keys);
+    void clear();
+
+    bool empty() const { return m_entries.empty(); }
+    std::size_t size() const { return m_entries.size(); }
+    // Bytes of heap memory used by the index
+    std::size_t memoryUsage() const
+    {
+        return m_entries.capacity() * sizeof(Entry) + m_seeds.capacity() * sizeof(std::uint32_t);
+    }
+
+    // Returns the position of key, or NotFound.
+    std::uint32_t find(std::uint32_t key) const
+    {
+        if (m_entries.empty())
+            return NotFound;
+
+        std::uint32_t seed = m_seeds[reduce(hash(key, 0), m_seeds.size())];
+        std::uint32_t slot = (seed & DirectSlot) != 0
+            ? seed & ~DirectSlot
+            : reduce(hash(key, seed), m_entries.size());
+        const Entry& entry = m_entries[slot];
+        return entry.key == key ? entry.position : NotFound;
+    }
+
+private:
+    static constexpr std::uint32_t DirectSlot = UINT32_C(1) << 31;
+
+    struct Entry
+    {
+        std::uint32_t key;
+        std::uint32_t position;
+    };
+
+    static std::uint32_t hash(std::uint32_t key, std::uint32_t seed)
+    {
+        // splitmix64 finalizer
+        std::uint64_t x = (static_cast<std::uint64_t>(seed) << 32) | key;
+        x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+        x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+        return static_cast<std::uint32_t>((x ^ (x >> 31)) >> 32);
+    }
+
+    // Maps a hash to [0, n) without a division
+    static std::uint32_t reduce(std::uint32_t h, std::size_t n)
+    {
+        return static_cast<std::uint32_t>((static_cast<std::uint64_t>(h) * n) >> 32);
+    }
+
+    std::vector<std::uint32_t> m_seeds;
+    std::vector<Entry> m_entries;
+};
+
+} // end namespace celestia::util
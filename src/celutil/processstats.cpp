@@ -0,0 +1,107 @@
+// processstats.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "processstats.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#ifdef __linux__
+#include <cstdio>
+#endif
+#endif
+
+namespace celestia::util
+{
+
+#ifdef _WIN32
+
+namespace
+{
+
+double
+toSeconds(const FILETIME& time)
+{
+    ULARGE_INTEGER value;
+    value.LowPart = time.dwLowDateTime;
+    value.HighPart = time.dwHighDateTime;
+    // FILETIME counts 100 ns intervals
+    return static_cast<double>(value.QuadPart) * 1.0e-7;
+}
+
+} // end unnamed namespace
+
+ProcessStats
+GetProcessStats()
+{
+    ProcessStats stats;
+    HANDLE process = GetCurrentProcess();
+
+    FILETIME creationTime;
+    FILETIME exitTime;
+    FILETIME kernelTime;
+    FILETIME userTime;
+    if (GetProcessTimes(process, &creationTime, &exitTime, &kernelTime, &userTime))
+        stats.cpuTime = toSeconds(kernelTime) + toSeconds(userTime);
+
+    if (IO_COUNTERS counters; GetProcessIoCounters(process, &counters))
+        stats.bytesRead = counters.ReadTransferCount;
+
+    // The kernel32 entry point avoids linking psapi
+    PROCESS_MEMORY_COUNTERS memoryCounters;
+    if (K32GetProcessMemoryInfo(process, &memoryCounters, sizeof(memoryCounters)))
+        stats.peakResidentSize = memoryCounters.PeakWorkingSetSize;
+
+    return stats;
+}
+
+#else
+
+ProcessStats
+GetProcessStats()
+{
+    ProcessStats stats;
+
+    if (rusage usage; getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        stats.cpuTime = static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+                        static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1.0e-6;
+#ifdef __APPLE__
+        stats.peakResidentSize = static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+        // Reported in kilobytes everywhere else
+        stats.peakResidentSize = static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+    }
+
+#ifdef __linux__
+    if (std::FILE* io = std::fopen("/proc/self/io", "r"); io != nullptr)
+    {
+        char line[128];
+        unsigned long long value;
+        while (std::fgets(line, sizeof(line), io) != nullptr)
+        {
+            if (std::sscanf(line, "rchar: %llu", &value) == 1)
+            {
+                stats.bytesRead = value;
+                break;
+            }
+        }
+        std::fclose(io);
+    }
+#endif
+
+    return stats;
+}
+
+#endif
+
+} // end namespace celestia::util
@@ -0,0 +1,34 @@
+// processstats.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Resource usage of the running process.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+
+namespace celestia::util
+{
+
+struct ProcessStats
+{
+    // User and system time of all threads, in seconds
+    double cpuTime{ 0.0 };
+    // Bytes read through read calls, including those served from the page
+    // cache; pages of mapped files are not counted
+    std::uint64_t bytesRead{ 0 };
+    // Largest resident set size reached so far, in bytes
+    std::uint64_t peakResidentSize{ 0 };
+};
+
+// Returns the resources used by the process so far. Values which the
+// platform doesn't report are left at zero.
+ProcessStats GetProcessStats();
+
+} // end namespace celestia::util
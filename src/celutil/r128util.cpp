@@ -18,9 +18,13 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <istream>
+#include <ostream>
 
 #define R128_IMPLEMENTATION
 #include "r128util.h"
+#include "binaryread.h"
+#include "binarywrite.h"
 
 using namespace std::string_view_literals;
 
@@ -211,4 +215,21 @@ bool isOutOfBounds(const R128 &b)
     return (b.hi > hi_threshold && b.hi < lo_threshold);
 }
 
+bool writeR128(std::ostream &out, const R128 &value)
+{
+    return writeLE<std::uint64_t>(out, value.lo) &&
+           writeLE<std::uint64_t>(out, value.hi);
+}
+
+bool readR128(std::istream &in, R128 &value)
+{
+    std::uint64_t lo;
+    std::uint64_t hi;
+    if (!readLE<std::uint64_t>(in, lo) || !readLE<std::uint64_t>(in, hi))
+        return false;
+
+    value = R128(lo, hi);
+    return true;
+}
+
 } // end namespace celestia::util
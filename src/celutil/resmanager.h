@@ -9,27 +9,105 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <celcompat/filesystem.h>
+#include <celutil/pendingloads.h>
 #include <celutil/reshandle.h>
+#include <celutil/threadpool.h>
+#include <celutil/trace.h>
 
 
 enum class ResourceState {
     NotLoaded     = 0,
     Loaded        = 1,
     LoadingFailed = 2,
+    Loading       = 3,
 };
 
 
+namespace celestia::util::impl
+{
+
+// Resource types whose loading needs a GL context can still be requested in
+// the background by splitting it in two steps: T::prepare() does the work
+// that doesn't need the context (reading and decoding files) on the loader
+// thread and returns a T::PreparedType, T::create() turns it into the
+// resource on the thread calling find() or request().
+template<typename T, typename = void>
+struct StagedLoading
+{
+    struct PreparedType {};
+    static constexpr bool value = false;
+};
+
+template<typename T>
+struct StagedLoading<T, std::void_t<typename T::PreparedType>>
+{
+    using PreparedType = typename T::PreparedType;
+    static constexpr bool value = true;
+};
+
+template<typename T, typename = void>
+struct BackgroundLoading : std::false_type {};
+
+template<typename T>
+struct BackgroundLoading<T, std::void_t<decltype(T::BackgroundLoading)>> : std::bool_constant<T::BackgroundLoading> {};
+
+// Resource types that are safe to load concurrently may declare how many
+// loader jobs to run at once
+template<typename T, typename = void>
+struct LoaderThreads : std::integral_constant<unsigned int, 1> {};
+
+template<typename T>
+struct LoaderThreads<T, std::void_t<decltype(T::LoaderThreads)>> : std::integral_constant<unsigned int, T::LoaderThreads> {};
+
+// Resources report their size for the memory budget with getMemorySize()
+template<typename R, typename = void>
+struct MemorySize
+{
+    static std::size_t get(const R&) { return 0; }
+};
+
+template<typename R>
+struct MemorySize<R, std::void_t<decltype(std::declval<const R&>().getMemorySize())>>
+{
+    static std::size_t get(const R& resource) { return resource.getMemorySize(); }
+};
+
+} // end namespace celestia::util::impl
+
+
 template<class T> class ResourceManager
 {
  public:
     explicit ResourceManager(const fs::path& _baseDir) : baseDir(_baseDir) {};
-    ~ResourceManager() = default;
+    ~ResourceManager()
+    {
+        {
+            // Loader jobs still queued on the pool return as soon as they run
+            std::unique_lock lock(mutex);
+            stopLoader = true;
+            loadersDone.wait(lock, [this] { return activeLoaders == 0; });
+        }
+
+        for (const InfoType& info : resources)
+        {
+            if (info.requested)
+                celestia::util::EndPendingLoads();
+        }
+    }
 
     ResourceManager(const ResourceManager&) = delete;
     ResourceManager& operator=(const ResourceManager&) = delete;
@@ -37,9 +115,11 @@ template<class T> class ResourceManager
     ResourceManager& operator=(ResourceManager&&) = delete;
 
     using ResourceType = typename T::ResourceType;
+    using Clock = std::chrono::steady_clock;
 
     ResourceHandle getHandle(const T& info)
     {
+        std::scoped_lock lock(mutex);
         auto h = static_cast<ResourceHandle>(handles.size());
         if (auto [iter, inserted] = handles.try_emplace(info, h); inserted)
         {
@@ -52,44 +132,187 @@ template<class T> class ResourceManager
         }
     }
 
+    // Returns the resource, loading it first if needed. A resource queued
+    // for background loading is loaded right away instead; if it is being
+    // loaded already, waits for that to finish.
     ResourceType* find(ResourceHandle h)
     {
+        std::unique_lock lock(mutex);
         if (h < 0 || h >= static_cast<ResourceHandle>(handles.size()))
         {
             return nullptr;
         }
 
-        if (resources[h].state == ResourceState::NotLoaded)
+        if (auto it = std::find(pendingRequests.begin(), pendingRequests.end(), h); it != pendingRequests.end())
         {
-            loadResource(resources[h]);
+            pendingRequests.erase(it);
+            loadResource(lock, h);
+        }
+
+        loadedCondition.wait(lock, [&] { return resources[h].state != ResourceState::Loading || isPrepared(h); });
+        if (isPrepared(h))
+        {
+            createResource(lock, h);
+        }
+        else if (resources[h].state == ResourceState::NotLoaded)
+        {
+            loadResource(lock, h);
         }
 
         return resources[h].state == ResourceState::Loaded
-            ? resources[h].resource.get()
+            ? use(h)
             : nullptr;
     }
 
+    // Returns the resource if it is loaded. Otherwise returns nullptr and,
+    // unless loading it has failed, makes sure it is queued for loading on
+    // a background thread, so that the caller can draw something cheaper
+    // in the meantime. Loader jobs are queued on the shared thread pool on
+    // demand, up to the number the resource type allows. Only available
+    // for resource types that can be loaded without a GL context or that
+    // support staged loading; for the latter the resource is created on the
+    // calling thread once the loader job has prepared it.
+    ResourceType* request(ResourceHandle h)
+    {
+        static_assert(celestia::util::impl::BackgroundLoading<T>::value || IsStaged,
+                      "resource type must support loading in the background");
+
+        std::unique_lock lock(mutex);
+        if (h < 0 || h >= static_cast<ResourceHandle>(handles.size()))
+        {
+            return nullptr;
+        }
+
+        switch (resources[h].state)
+        {
+        case ResourceState::Loaded:
+            return use(h);
+        case ResourceState::NotLoaded:
+            resources[h].state = ResourceState::Loading;
+            resources[h].requested = true;
+            celestia::util::BeginPendingLoads();
+            pendingRequests.push_back(h);
+            if (activeLoaders < maxLoaders())
+            {
+                // Running loaders take the request otherwise
+                ++activeLoaders;
+                lock.unlock();
+                celestia::util::ThreadPool::shared().submit([this] { loaderMain(); });
+            }
+            return nullptr;
+        case ResourceState::Loading:
+            if (!isPrepared(h))
+                return nullptr;
+            createResource(lock, h);
+            return resources[h].state == ResourceState::Loaded ? use(h) : nullptr;
+        default:
+            return nullptr;
+        }
+    }
+
+    ResourceState getState(ResourceHandle h)
+    {
+        std::scoped_lock lock(mutex);
+        if (h < 0 || h >= static_cast<ResourceHandle>(handles.size()))
+            return ResourceState::LoadingFailed;
+        return resources[h].state;
+    }
+
+    // Unloads the resources that haven't been returned by find() or
+    // request() for maxIdle, then the least recently used ones while the
+    // loaded resources take more than budget bytes; zero disables either
+    // limit. Resources used in the last few seconds are always kept, so
+    // that a budget too small for a single view doesn't reload resources
+    // every frame. Unloaded resources are loaded again on their next use.
+    //
+    // Pointers returned by find() and request() are invalidated, so this
+    // must be called where no caller holds one, e.g. between frames.
+    // Returns the number of resources unloaded.
+    std::size_t unloadUnused(Clock::duration maxIdle, std::size_t budget)
+    {
+        std::scoped_lock lock(mutex);
+        Clock::time_point now = Clock::now();
+
+        std::vector<ResourceHandle> candidates;
+        std::size_t loadedSize = 0;
+        std::size_t unloaded = 0;
+        for (std::size_t i = 0; i < resources.size(); ++i)
+        {
+            InfoType& info = resources[i];
+            if (info.state != ResourceState::Loaded || info.resource == nullptr)
+                continue;
+
+            Clock::duration idle = now - info.lastUsed;
+            if (maxIdle > Clock::duration::zero() && idle > maxIdle)
+            {
+                unloadResource(info);
+                ++unloaded;
+            }
+            else
+            {
+                loadedSize += info.size;
+                if (idle > MinIdle)
+                    candidates.push_back(static_cast<ResourceHandle>(i));
+            }
+        }
+
+        if (budget == 0 || loadedSize <= budget)
+            return unloaded;
+
+        std::sort(candidates.begin(), candidates.end(), [this](ResourceHandle a, ResourceHandle b)
+        {
+            return resources[a].lastUsed < resources[b].lastUsed;
+        });
+        for (ResourceHandle h : candidates)
+        {
+            if (loadedSize <= budget)
+                break;
+            loadedSize -= resources[h].size;
+            unloadResource(resources[h]);
+            ++unloaded;
+        }
+
+        return unloaded;
+    }
+
+    // Estimated memory taken by the loaded resources, in bytes. Resources
+    // shared by several handles are counted for each of them.
+    std::size_t getLoadedSize()
+    {
+        std::scoped_lock lock(mutex);
+        std::size_t size = 0;
+        for (const InfoType& info : resources)
+        {
+            if (info.state == ResourceState::Loaded)
+                size += info.size;
+        }
+        return size;
+    }
+
  private:
     using KeyType = typename T::ResourceKey;
+    using PreparedType = typename celestia::util::impl::StagedLoading<T>::PreparedType;
+    static constexpr bool IsStaged = celestia::util::impl::StagedLoading<T>::value;
 
     struct InfoType
     {
         T info;
         ResourceState state{ ResourceState::NotLoaded };
         std::shared_ptr<ResourceType> resource{ nullptr };
+        // Set while a staged resource waits for create()
+        std::unique_ptr<PreparedType> prepared{ nullptr };
+        std::optional<KeyType> preparedKey{ };
+        // Last time the resource was returned, and its size once loaded
+        Clock::time_point lastUsed{ };
+        std::size_t size{ 0 };
+        // Counted as a pending load from request() until loaded or failed
+        bool requested{ false };
 
         explicit InfoType(T _info) : info(std::move(_info)) {}
         InfoType(const InfoType&) = delete;
         InfoType& operator=(const InfoType&) = delete;
         InfoType(InfoType&&) noexcept = default;
         InfoType& operator=(InfoType&&) noexcept = default;
-
-        KeyType resolve(const fs::path& _baseDir) { return info.resolve(_baseDir); }
-        bool load(const KeyType& resolvedKey)
-        {
-            resource = info.load(resolvedKey);
-            return resource != nullptr;
-        }
     };
 
     using ResourceTable = std::vector<InfoType>;
@@ -101,27 +324,163 @@ template<class T> class ResourceManager
     ResourceHandleMap handles{ };
     NameMap loadedResources{ };
 
-    void loadResource(InfoType& info)
+    // Guards all of the above; it is released while a resource is loaded,
+    // the resource is in the Loading state meanwhile.
+    std::mutex mutex;
+    std::condition_variable loadedCondition;
+    std::condition_variable loadersDone;
+    std::deque<ResourceHandle> pendingRequests;
+    // Loader jobs queued or running on the shared pool
+    unsigned int activeLoaders{ 0 };
+    bool stopLoader{ false };
+
+    static constexpr Clock::duration MinIdle = std::chrono::seconds(5);
+
+    static unsigned int maxLoaders()
     {
+        unsigned int workers = celestia::util::ThreadPool::shared().concurrency() - 1;
+        return std::clamp(workers, 1u, celestia::util::impl::LoaderThreads<T>::value);
+    }
+
+    bool isPrepared(ResourceHandle h) const
+    {
+        return resources[h].prepared != nullptr;
+    }
+
+    ResourceType* use(ResourceHandle h)
+    {
+        resources[h].lastUsed = Clock::now();
+        return resources[h].resource.get();
+    }
+
+    void setResource(ResourceHandle h, std::shared_ptr<ResourceType>&& resource)
+    {
+        InfoType& info = resources[h];
+        info.state = resource == nullptr ? ResourceState::LoadingFailed : ResourceState::Loaded;
+        info.size = resource == nullptr ? 0 : celestia::util::impl::MemorySize<ResourceType>::get(*resource);
+        info.lastUsed = Clock::now();
+        info.resource = std::move(resource);
+        if (info.requested)
+        {
+            info.requested = false;
+            celestia::util::EndPendingLoads();
+        }
+    }
+
+    // The resource stays alive while another handle shares it
+    static void unloadResource(InfoType& info)
+    {
+        info.state = ResourceState::NotLoaded;
+        info.resource.reset();
+        info.size = 0;
+    }
+
+    // Loads resource h, which must be in the NotLoaded or Loading state,
+    // with the lock held on entry and exit. On the loader thread staged
+    // resources are only prepared and stay in the Loading state.
+    void loadResource(std::unique_lock<std::mutex>& lock, ResourceHandle h, bool background = false)
+    {
+        resources[h].state = ResourceState::Loading;
+        T info = resources[h].info;
+        lock.unlock();
+
         KeyType resolvedKey = info.resolve(baseDir);
+
+        lock.lock();
         std::shared_ptr<ResourceType> resource = nullptr;
         if (auto iter = loadedResources.find(resolvedKey); iter != loadedResources.end())
             resource = iter->second.lock();
 
-        if (resource != nullptr)
+        bool prepareOnly = IsStaged && background;
+        if constexpr (IsStaged)
         {
-            info.resource = std::move(resource);
-            info.state = ResourceState::Loaded;
+            if (resource == nullptr && prepareOnly)
+            {
+                lock.unlock();
+                std::unique_ptr<PreparedType> prepared;
+                {
+                    celestia::util::TraceScope trace("ResourceManager::prepare");
+                    prepared = info.prepare(resolvedKey);
+                }
+                lock.lock();
+                if (prepared != nullptr)
+                {
+                    resources[h].preparedKey = std::move(resolvedKey);
+                    resources[h].prepared = std::move(prepared);
+                    loadedCondition.notify_all();
+                    return;
+                }
+            }
         }
-        else if (info.load(resolvedKey))
+
+        if (resource == nullptr && !prepareOnly)
         {
-            info.state = ResourceState::Loaded;
-            if (auto [iter, inserted] = loadedResources.try_emplace(std::move(resolvedKey), info.resource); !inserted)
-                iter->second = info.resource;
+            lock.unlock();
+            {
+                celestia::util::TraceScope trace("ResourceManager::load");
+                resource = info.load(resolvedKey);
+            }
+            lock.lock();
+            if (resource != nullptr)
+            {
+                if (auto [iter, inserted] = loadedResources.try_emplace(std::move(resolvedKey), resource); !inserted)
+                    iter->second = resource;
+            }
         }
-        else
+
+        setResource(h, std::move(resource));
+        loadedCondition.notify_all();
+    }
+
+    // Creates prepared resource h from its prepared data, with the lock held
+    // on entry and exit.
+    void createResource(std::unique_lock<std::mutex>& lock, ResourceHandle h)
+    {
+        if constexpr (IsStaged)
         {
-            info.state = ResourceState::LoadingFailed;
+            std::unique_ptr<PreparedType> prepared = std::move(resources[h].prepared);
+            KeyType resolvedKey = std::move(*resources[h].preparedKey);
+            resources[h].preparedKey.reset();
+            T info = resources[h].info;
+
+            // Another handle may have created the same resource meanwhile
+            std::shared_ptr<ResourceType> resource = nullptr;
+            if (auto iter = loadedResources.find(resolvedKey); iter != loadedResources.end())
+                resource = iter->second.lock();
+
+            if (resource == nullptr)
+            {
+                lock.unlock();
+                {
+                    celestia::util::TraceScope trace("ResourceManager::create");
+                    resource = info.create(resolvedKey, *prepared);
+                    prepared.reset();
+                }
+                lock.lock();
+                if (resource != nullptr)
+                {
+                    if (auto [iter, inserted] = loadedResources.try_emplace(std::move(resolvedKey), resource); !inserted)
+                        iter->second = resource;
+                }
+            }
+
+            setResource(h, std::move(resource));
+            loadedCondition.notify_all();
         }
     }
+
+    // Loads the pending requests until there are none left
+    void loaderMain()
+    {
+        std::unique_lock lock(mutex);
+        while (!stopLoader && !pendingRequests.empty())
+        {
+            ResourceHandle h = pendingRequests.front();
+            pendingRequests.pop_front();
+            loadResource(lock, h, true);
+        }
+
+        if (--activeLoaders == 0)
+            loadersDone.notify_all();
+    }
 };
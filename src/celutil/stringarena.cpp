@@ -0,0 +1,46 @@
+// stringarena.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "stringarena.h"
+
+#include <algorithm>
+
+namespace celestia::util
+{
+
+std::string_view
+StringArena::add(std::string_view str)
+{
+    std::size_t length = str.size() + 1;
+    char* dest;
+    if (length > MaxSharedLength)
+    {
+        dest = m_blocks.emplace_back(std::make_unique<char[]>(length)).get();
+        m_capacity += length;
+    }
+    else
+    {
+        if (length > m_remaining)
+        {
+            m_next = m_blocks.emplace_back(std::make_unique<char[]>(BlockSize)).get();
+            m_remaining = BlockSize;
+            m_capacity += BlockSize;
+        }
+
+        dest = m_next;
+        m_next += length;
+        m_remaining -= length;
+    }
+
+    std::copy(str.begin(), str.end(), dest);
+    dest[str.size()] = '\0';
+    return { dest, str.size() };
+}
+
+} // end namespace celestia::util
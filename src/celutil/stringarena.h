@@ -0,0 +1,45 @@
+// stringarena.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Append-only storage for large numbers of small strings.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace celestia::util
+{
+
+class StringArena
+{
+public:
+    // Copies str into the arena. The copy is null-terminated and stays at
+    // the same address until the arena is destroyed.
+    std::string_view add(std::string_view str);
+
+    // Number of bytes allocated for string storage
+    std::size_t capacity() const { return m_capacity; }
+
+private:
+    static constexpr std::size_t BlockSize = 64 * 1024;
+
+    // Strings longer than this get a block of their own, so that they don't
+    // waste the rest of the current block
+    static constexpr std::size_t MaxSharedLength = BlockSize / 16;
+
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    char* m_next{ nullptr };
+    std::size_t m_remaining{ 0 };
+    std::size_t m_capacity{ 0 };
+};
+
+} // end namespace celestia::util
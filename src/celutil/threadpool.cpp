@@ -0,0 +1,234 @@
+// threadpool.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace celestia::util
+{
+
+namespace
+{
+
+thread_local bool insideTask = false;
+thread_local ThreadPool::Priority threadPriority = ThreadPool::Priority::Interactive;
+
+std::atomic<unsigned int> sharedThreads{ 0 };
+
+} // end unnamed namespace
+
+ThreadPool::ThreadPool(unsigned int nThreads)
+{
+    if (nThreads == 0)
+    {
+        unsigned int hwThreads = std::thread::hardware_concurrency();
+        nThreads = hwThreads > 1 ? hwThreads - 1 : 0;
+    }
+
+    m_threads.reserve(nThreads);
+    for (unsigned int i = 0; i < nThreads; ++i)
+        m_threads.emplace_back(&ThreadPool::workerMain, this, i + 1);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for (std::thread& thread : m_threads)
+        thread.join();
+}
+
+void
+ThreadPool::parallelFor(std::size_t count, const TaskFunction& func)
+{
+    if (count == 0)
+        return;
+
+    if (m_threads.empty() || count == 1 || insideTask)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            func(i, 0);
+        return;
+    }
+
+    Loop loop{ &func, count, threadPriority };
+    {
+        std::scoped_lock lock(m_mutex);
+        m_loops.push_back(&loop);
+        m_activeLoops[static_cast<std::size_t>(loop.priority)].fetch_add(1, std::memory_order_relaxed);
+    }
+    m_wakeCondition.notify_all();
+
+    // The caller stays with its own loop whatever else is waiting
+    runTasks(loop, 0, false);
+
+    std::unique_lock lock(m_mutex);
+    m_loops.erase(std::find(m_loops.begin(), m_loops.end(), &loop));
+    m_doneCondition.wait(lock, [&loop] { return loop.busyWorkers == 0; });
+}
+
+void
+ThreadPool::submit(JobFunction job, Priority priority)
+{
+    if (m_threads.empty())
+    {
+        runJob(job, priority);
+        return;
+    }
+
+    {
+        std::scoped_lock lock(m_mutex);
+        m_jobs[static_cast<std::size_t>(priority)].push_back(std::move(job));
+    }
+    m_wakeCondition.notify_one();
+}
+
+void
+ThreadPool::setThreadPriority(Priority priority)
+{
+    threadPriority = priority;
+}
+
+void
+ThreadPool::setSharedThreads(unsigned int nThreads)
+{
+    sharedThreads.store(nThreads, std::memory_order_relaxed);
+}
+
+ThreadPool&
+ThreadPool::shared()
+{
+    // Never destroyed, so that it outlives background threads still using it
+    // at exit
+    static ThreadPool* const pool = std::make_unique<ThreadPool>(sharedThreads.load(std::memory_order_relaxed)).release(); //NOSONAR
+    return *pool;
+}
+
+void
+ThreadPool::workerMain(unsigned int worker)
+{
+    std::unique_lock lock(m_mutex);
+    for (;;)
+    {
+        Loop* loop = nullptr;
+        std::deque<JobFunction>* jobs = nullptr;
+        m_wakeCondition.wait(lock, [&] {
+            if (m_stop)
+                return true;
+            loop = findLoop();
+            jobs = findJobs(loop);
+            return loop != nullptr || jobs != nullptr;
+        });
+        if (m_stop)
+            return;
+
+        if (jobs != nullptr)
+        {
+            auto priority = static_cast<Priority>(jobs - m_jobs);
+            JobFunction job = std::move(jobs->front());
+            jobs->pop_front();
+            lock.unlock();
+
+            runJob(job, priority);
+
+            lock.lock();
+            continue;
+        }
+
+        ++loop->busyWorkers;
+        lock.unlock();
+
+        runTasks(*loop, worker, true);
+
+        lock.lock();
+        if (--loop->busyWorkers == 0)
+            m_doneCondition.notify_all();
+    }
+}
+
+ThreadPool::Loop*
+ThreadPool::findLoop() const
+{
+    Loop* found = nullptr;
+    for (Loop* loop : m_loops)
+    {
+        if (loop->nextTask.load(std::memory_order_relaxed) < loop->count &&
+            (found == nullptr || loop->priority < found->priority))
+        {
+            found = loop;
+        }
+    }
+
+    return found;
+}
+
+std::deque<ThreadPool::JobFunction>*
+ThreadPool::findJobs(const Loop* loop)
+{
+    // Loops are preferred at the same priority, as their callers wait
+    std::size_t end = loop == nullptr ? PriorityCount : static_cast<std::size_t>(loop->priority);
+    for (std::size_t i = 0; i < end; ++i)
+    {
+        if (!m_jobs[i].empty())
+            return &m_jobs[i];
+    }
+
+    return nullptr;
+}
+
+void
+ThreadPool::runJob(JobFunction& job, Priority priority)
+{
+    Priority previous = threadPriority;
+    threadPriority = priority;
+    job();
+    threadPriority = previous;
+}
+
+bool
+ThreadPool::hasLoopBefore(Priority priority) const
+{
+    for (std::size_t i = 0; i < static_cast<std::size_t>(priority); ++i)
+    {
+        if (m_activeLoops[i].load(std::memory_order_relaxed) > 0)
+            return true;
+    }
+
+    return false;
+}
+
+void
+ThreadPool::runTasks(Loop& loop, unsigned int worker, bool yield)
+{
+    insideTask = true;
+    for (;;)
+    {
+        if (yield && hasLoopBefore(loop.priority))
+            break;
+
+        std::size_t task = loop.nextTask.fetch_add(1, std::memory_order_relaxed);
+        if (task >= loop.count)
+        {
+            // Exactly one thread sees the first task past the end
+            if (task == loop.count)
+                m_activeLoops[static_cast<std::size_t>(loop.priority)].fetch_sub(1, std::memory_order_relaxed);
+            break;
+        }
+        (*loop.func)(task, worker);
+    }
+    insideTask = false;
+}
+
+} // end namespace celestia::util
@@ -0,0 +1,124 @@
+// threadpool.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// A fixed-size pool of worker threads for data-parallel loops and
+// background jobs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace celestia::util
+{
+
+class ThreadPool
+{
+public:
+    using TaskFunction = std::function<void(std::size_t /* task */, unsigned int /* worker */)>;
+    using JobFunction = std::function<void()>;
+
+    // Loops with a higher priority are run first. A worker that is running
+    // the tasks of a background loop switches to an interactive one as soon
+    // as its current task is done.
+    enum class Priority : unsigned int
+    {
+        Interactive = 0,
+        Background  = 1,
+    };
+
+    // Creates a pool with nThreads background threads; a value of zero
+    // selects one thread less than the number of hardware threads, as the
+    // calling thread takes part in the work too.
+    explicit ThreadPool(unsigned int nThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+
+    // Number of threads taking part in parallelFor, including the caller.
+    unsigned int concurrency() const { return static_cast<unsigned int>(m_threads.size()) + 1; }
+
+    // Calls func(task, worker) for each task in [0, count) and waits for all
+    // of them to finish. Tasks are handed out one at a time, so workers that
+    // finish early pick up the remaining ones. The worker index is in
+    // [0, concurrency()) and is unique among the threads running the tasks
+    // of one call, so it can be used to select per-thread scratch state; the
+    // calling thread is always worker 0. Nested calls from within a task run
+    // serially. Calls from several threads share the workers according to
+    // the priority set for the calling thread.
+    void parallelFor(std::size_t count, const TaskFunction& func);
+
+    // Queues job to be run on a worker, with the given priority for the
+    // loops it starts. A free worker takes a job only when no loop of the
+    // same or a higher priority has tasks left; jobs of one priority run in
+    // the order they were queued. Jobs may block on I/O, but they hold their
+    // worker until they return, so callers should keep only a few queued at
+    // a time. Without worker threads the job is run at once by the caller.
+    void submit(JobFunction job, Priority priority = Priority::Background);
+
+    // Sets the priority of the loops started by the calling thread, which
+    // is Interactive unless changed
+    static void setThreadPriority(Priority priority);
+
+    // Sets the number of threads of the shared pool, as for the constructor.
+    // Has no effect once the pool has been created.
+    static void setSharedThreads(unsigned int nThreads);
+
+    // Pool shared by the renderer, catalog loading, resource loading and
+    // image decoding. It is created on first use.
+    static ThreadPool& shared();
+
+private:
+    static constexpr std::size_t PriorityCount = 2;
+
+    struct Loop
+    {
+        const TaskFunction* func;
+        std::size_t count;
+        Priority priority;
+        std::atomic<std::size_t> nextTask{ 0 };
+        // Workers other than the caller running its tasks, guarded by m_mutex
+        unsigned int busyWorkers{ 0 };
+    };
+
+    void workerMain(unsigned int worker);
+    Loop* findLoop() const;
+    // Returns the queue of the most urgent jobs that may run before loop,
+    // or nullptr
+    std::deque<JobFunction>* findJobs(const Loop* loop);
+    void runJob(JobFunction& job, Priority priority);
+    bool hasLoopBefore(Priority priority) const;
+    // Runs tasks of loop until there are none left, or with yield set, until
+    // a loop of a higher priority is waiting
+    void runTasks(Loop& loop, unsigned int worker, bool yield);
+
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCondition;
+    std::condition_variable m_doneCondition;
+    // Loops that may have tasks left, guarded by m_mutex
+    std::vector<Loop*> m_loops;
+    // Number of loops with tasks left for each priority
+    std::atomic<unsigned int> m_activeLoops[PriorityCount]{};
+    // Queued jobs for each priority, guarded by m_mutex
+    std::deque<JobFunction> m_jobs[PriorityCount];
+    bool m_stop{ false };
+};
+
+} // end namespace celestia::util
@@ -9,8 +9,10 @@
 // of the License, or (at your option) any later version.
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <istream>
 #include <string>
@@ -30,30 +32,74 @@ namespace
 {
 constexpr inline std::string_view UTF8_BOM = "\357\273\277"sv;
 
+// Character classes, looked up in a table so that the scanning loops test
+// a single bit per character
+enum CharClass : std::uint8_t
+{
+    Whitespace  = 0x01,
+    Digit       = 0x02,
+    NameStart   = 0x04,
+    // ASCII characters copied as they are into strings
+    StringPlain = 0x08,
+};
+
+constexpr std::array<std::uint8_t, 256>
+createCharClasses()
+{
+    std::array<std::uint8_t, 256> classes{};
+    for (unsigned int c = 0; c < 0x80; ++c)
+    {
+        std::uint8_t cls = 0;
+        if (c == ' ' || c == '\t' || c == '\r')
+            cls |= Whitespace;
+        if (c >= '0' && c <= '9')
+            cls |= Digit;
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_')
+            cls |= NameStart;
+        if (c != '"' && c != '\\' && c != '\r' && c != '\n')
+            cls |= StringPlain;
+        classes[c] = cls;
+    }
+
+    return classes;
+}
+
+constexpr inline std::array<std::uint8_t, 256> charClasses = createCharClasses();
+
+constexpr bool
+hasClass(char ch, std::uint8_t cls)
+{
+    return (charClasses[static_cast<unsigned char>(ch)] & cls) != 0;
+}
+
 constexpr bool
 isWhitespace(char ch)
 {
-    return ch == ' ' || ch == '\t' || ch == '\r';
+    return hasClass(ch, Whitespace);
 }
 
 constexpr bool
 isAsciiDigit(char ch)
 {
-    return ch >= '0' && ch <= '9';
+    return hasClass(ch, Digit);
 }
 
 constexpr bool
 isStartName(char ch)
 {
-    return (ch >= 'A' && ch <= 'Z') ||
-           (ch >= 'a' && ch <= 'z') ||
-           (ch == '_');
+    return hasClass(ch, NameStart);
 }
 
 constexpr bool
 isName(char ch)
 {
-    return isStartName(ch) || isAsciiDigit(ch);
+    return hasClass(ch, NameStart | Digit);
+}
+
+constexpr bool
+isStringPlain(char ch)
+{
+    return hasClass(ch, StringPlain);
 }
 
 constexpr bool
@@ -261,21 +307,20 @@ TokenizerImpl::skipWhitespace()
             return *it;
         }
 
-        // skip comments
+        // skip comments, using memchr which the C library vectorizes
         for (;;)
         {
-            it = std::find(buffer.cbegin() + position, bufferEnd, '\n');
-            position = it - buffer.cbegin();
-            if (it != bufferEnd)
+            const void* newline = std::memchr(buffer.data() + position, '\n', length - position);
+            if (newline != nullptr)
             {
+                position = static_cast<const char*>(newline) - buffer.data() + 1;
                 ++lineNumber;
-                ++position;
                 break;
             }
 
+            position = length;
             if (isEnded) { return Tokenizer::TokenEnd; }
             if (!fillBuffer()) { return Tokenizer::TokenError; }
-            bufferEnd = buffer.cbegin() + length;
         }
     }
 }
@@ -566,6 +611,15 @@ TokenizerImpl::readString()
     StringState state;
     for (;;)
     {
+        // Take runs of ASCII characters without escapes at once, as long
+        // as they don't interrupt a multibyte sequence
+        if (state.validator.isInitial() && position + state.runEnd < length)
+        {
+            auto bufferEnd = buffer.cbegin() + length;
+            auto it = std::find_if_not(buffer.cbegin() + position + state.runEnd, bufferEnd, isStringPlain);
+            state.runEnd = static_cast<std::size_t>(it - buffer.cbegin()) - position;
+        }
+
         char ch;
         auto peekPos = position + state.runEnd;
         if (auto check = peekAt(peekPos); check.has_value())
@@ -0,0 +1,213 @@
+// trace.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Lightweight timeline tracing of the main loop, rendering and loading.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "trace.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace celestia::util
+{
+
+namespace
+{
+
+constexpr std::size_t EventsPerThread = 16384;
+
+// The fields are atomic since the writer may overwrite an event while the
+// buffer is being dumped; such events are detected by their index and
+// dropped, see ThreadBuffer::copy().
+struct Event
+{
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<std::int64_t> start{ 0 };
+    std::atomic<std::int64_t> end{ 0 };
+};
+
+struct EventCopy
+{
+    const char* name;
+    std::int64_t start;
+    std::int64_t end;
+};
+
+class ThreadBuffer
+{
+public:
+    explicit ThreadBuffer(unsigned int threadIndex) : m_threadIndex(threadIndex) {}
+
+    unsigned int threadIndex() const { return m_threadIndex; }
+
+    // Only called from the owning thread
+    void add(const char* name, std::int64_t start, std::int64_t end) noexcept
+    {
+        std::uint64_t index = m_count.load(std::memory_order_relaxed);
+        Event& event = m_events[index % EventsPerThread];
+        event.name.store(name, std::memory_order_relaxed);
+        event.start.store(start, std::memory_order_relaxed);
+        event.end.store(end, std::memory_order_relaxed);
+        m_count.store(index + 1, std::memory_order_release);
+    }
+
+    // May be called from any thread
+    void copy(std::vector<EventCopy>& events) const
+    {
+        std::uint64_t count = m_count.load(std::memory_order_acquire);
+        std::uint64_t first = count > EventsPerThread ? count - EventsPerThread : 0;
+
+        std::vector<EventCopy> copied;
+        copied.reserve(static_cast<std::size_t>(count - first));
+        for (std::uint64_t i = first; i < count; ++i)
+        {
+            const Event& event = m_events[i % EventsPerThread];
+            copied.push_back({ event.name.load(std::memory_order_relaxed),
+                               event.start.load(std::memory_order_relaxed),
+                               event.end.load(std::memory_order_relaxed) });
+        }
+
+        // The writer may have started reusing slots while they were copied;
+        // with countAfter events recorded, the slot of event countAfter is
+        // being written, so events before countAfter - EventsPerThread + 1
+        // can't be trusted.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        std::uint64_t countAfter = m_count.load(std::memory_order_relaxed);
+        std::uint64_t firstValid = countAfter + 1 > EventsPerThread ? countAfter + 1 - EventsPerThread : 0;
+        std::size_t skip = static_cast<std::size_t>(std::min(std::max(firstValid, first) - first,
+                                                             count - first));
+        events.insert(events.end(), copied.begin() + skip, copied.end());
+    }
+
+private:
+    unsigned int m_threadIndex;
+    std::atomic<std::uint64_t> m_count{ 0 };
+    std::array<Event, EventsPerThread> m_events;
+};
+
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+};
+
+Registry&
+GetRegistry()
+{
+    static Registry* registry = new Registry();
+    return *registry;
+}
+
+ThreadBuffer&
+GetThreadBuffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> buffer = []
+    {
+        Registry& registry = GetRegistry();
+        std::scoped_lock lock(registry.mutex);
+        auto threadIndex = static_cast<unsigned int>(registry.buffers.size() + 1);
+        return registry.buffers.emplace_back(std::make_shared<ThreadBuffer>(threadIndex));
+    }();
+
+    return *buffer;
+}
+
+void
+appendJsonString(std::string& out, const char* s)
+{
+    out.push_back('"');
+    for (; *s != '\0'; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+            out.push_back('\\');
+        out.push_back(*s);
+    }
+    out.push_back('"');
+}
+
+} // end unnamed namespace
+
+namespace detail
+{
+
+std::atomic<bool> tracingEnabled{ false };
+
+void
+recordTraceEvent(const char* name, std::int64_t start, std::int64_t end) noexcept
+{
+    GetThreadBuffer().add(name, start, end);
+}
+
+} // end namespace detail
+
+void
+SetTracingEnabled(bool enabled)
+{
+    detail::tracingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool
+IsTracingEnabled()
+{
+    return detail::tracingEnabled.load(std::memory_order_relaxed);
+}
+
+bool
+WriteChromeTrace(const fs::path& path)
+{
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        Registry& registry = GetRegistry();
+        std::scoped_lock lock(registry.mutex);
+        buffers = registry.buffers;
+    }
+
+    using period = TraceScope::clock::period;
+    constexpr double toMicroseconds = 1.0e6 * static_cast<double>(period::num) / static_cast<double>(period::den);
+
+    std::string json = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    std::vector<EventCopy> events;
+    for (const auto& buffer : buffers)
+    {
+        events.clear();
+        buffer->copy(events);
+        for (const EventCopy& event : events)
+        {
+            json.append(first ? "\n" : ",\n");
+            first = false;
+            json.append("{\"name\": ");
+            appendJsonString(json, event.name);
+            fmt::format_to(std::back_inserter(json),
+                           ", \"ph\": \"X\", \"pid\": 1, \"tid\": {}, \"ts\": {:.3f}, \"dur\": {:.3f}}}",
+                           buffer->threadIndex(),
+                           static_cast<double>(event.start) * toMicroseconds,
+                           static_cast<double>(event.end - event.start) * toMicroseconds);
+        }
+    }
+    json.append("\n]}\n");
+
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out.good())
+        return false;
+
+    out << json;
+    return out.good();
+}
+
+} // end namespace celestia::util
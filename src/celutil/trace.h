@@ -0,0 +1,73 @@
+// trace.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// Lightweight timeline tracing of the main loop, rendering and loading.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <celcompat/filesystem.h>
+
+namespace celestia::util
+{
+
+namespace detail
+{
+extern std::atomic<bool> tracingEnabled;
+
+void recordTraceEvent(const char* name, std::int64_t start, std::int64_t end) noexcept;
+}
+
+// Every thread records the scopes it leaves into its own ring buffer, which
+// holds the last few thousand of them; older ones are overwritten. Recording
+// takes no locks, so scopes can be placed in per-frame code. While tracing is
+// disabled a scope only checks a flag.
+//
+// The buffers are kept when their thread ends so that the trace also covers
+// short-lived loader threads.
+class TraceScope
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    // The name must be a string literal or otherwise outlive the trace
+    explicit TraceScope(const char* name) noexcept :
+        m_name(detail::tracingEnabled.load(std::memory_order_relaxed) ? name : nullptr)
+    {
+        if (m_name != nullptr)
+            m_start = clock::now();
+    }
+
+    ~TraceScope()
+    {
+        if (m_name != nullptr)
+            detail::recordTraceEvent(m_name, m_start.time_since_epoch().count(),
+                                     clock::now().time_since_epoch().count());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+    clock::time_point m_start;
+};
+
+void SetTracingEnabled(bool);
+bool IsTracingEnabled();
+
+// Writes the events in the buffers of all threads in the Chrome trace event
+// JSON format, which is read by chrome://tracing and the Perfetto UI. The
+// buffers are not cleared and recording continues while they are written.
+bool WriteChromeTrace(const fs::path& path);
+
+} // end namespace celestia::util
@@ -433,6 +433,28 @@ int UTF8StringCompare(std::string_view s0, std::string_view s1)
     }
 }
 
+//! Return the string with each character normalized as in UTF8StringCompare,
+//! so that strings comparing equal have the same normalized form, which can
+//! be used as a hash key. As in the comparison, the string ends at the first
+//! invalid sequence.
+std::string UTF8NormalizeString(std::string_view str)
+{
+    std::string normalized;
+    normalized.reserve(str.size());
+
+    auto length = static_cast<std::int32_t>(str.size());
+    std::int32_t pos = 0;
+    while (pos < length)
+    {
+        std::int32_t ch;
+        if (!UTF8Decode(str, pos, ch))
+            break;
+        UTF8Encode(static_cast<std::uint32_t>(UTF8Normalize(ch)), normalized);
+    }
+
+    return normalized;
+}
+
 bool UTF8StartsWith(std::string_view str, std::string_view prefix, bool ignoreCase)
 {
     auto len0 = static_cast<std::int32_t>(str.size());
@@ -448,15 +470,15 @@ bool UTF8StartsWith(std::string_view str, std::string_view prefix, bool ignoreCa
         if (i0 >= len0 || !UTF8Decode(str, i0, ch0) || !UTF8Decode(prefix, i1, ch1))
             return false;
 
-        ch0 = UTF8Normalize(ch0);
-        ch1 = UTF8Normalize(ch1);
-
         if (ignoreCase)
         {
-            if (ch0 >= 0 && ch0 <= WCHAR_MAX)
-                ch0 = static_cast<std::int32_t>(std::towlower(static_cast<std::wint_t>(ch0)));
-            if (ch1 >= 0 && ch1 <= WCHAR_MAX)
-                ch1 = static_cast<std::int32_t>(std::towlower(static_cast<std::wint_t>(ch1)));
+            ch0 = UTF8FoldCase(ch0);
+            ch1 = UTF8FoldCase(ch1);
+        }
+        else
+        {
+            ch0 = UTF8Normalize(ch0);
+            ch1 = UTF8Normalize(ch1);
         }
 
         if (ch0 != ch1)
@@ -464,6 +486,16 @@ bool UTF8StartsWith(std::string_view str, std::string_view prefix, bool ignoreCa
     }
 }
 
+//! Normalize a character and convert it to lower case, as in the
+//! case-insensitive comparison of UTF8StartsWith.
+std::int32_t UTF8FoldCase(std::int32_t ch)
+{
+    ch = UTF8Normalize(ch);
+    if (ch >= 0 && ch <= WCHAR_MAX)
+        ch = static_cast<std::int32_t>(std::towlower(static_cast<std::wint_t>(ch)));
+    return ch;
+}
+
 std::int32_t
 UTF8Validator::check(unsigned char c)
 {
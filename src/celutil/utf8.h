@@ -23,7 +23,9 @@ bool UTF8Decode(std::string_view str, std::int32_t &ch);
 bool UTF8Decode(std::string_view str, std::int32_t &pos, std::int32_t &ch);
 void UTF8Encode(std::uint32_t ch, std::string &dest);
 int  UTF8StringCompare(std::string_view s0, std::string_view s1);
+std::string UTF8NormalizeString(std::string_view str);
 bool UTF8StartsWith(std::string_view str, std::string_view prefix, bool ignoreCase = false);
+std::int32_t UTF8FoldCase(std::int32_t ch);
 
 class UTF8StringOrderingPredicate
 {
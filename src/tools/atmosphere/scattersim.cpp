@@ -14,7 +14,11 @@
 #include <cstdlib>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -57,11 +61,64 @@ enum LUTUsageType
 static LUTUsageType LUTUsage = NoLUT;
 static bool UseFisheyeCameras = false;
 static double CameraExposure = 0.0;
+static unsigned int WorkerThreadCount = 0;
 
 
 typedef map<string, double> ParameterSet;
 
 
+// Run func(0) ... func(count - 1) on a pool of worker threads. Each index is
+// an independent tile of work that writes only its own outputs, so the result
+// is identical to running the loop serially. Progress is reported in 10%
+// increments.
+template<typename F> void
+parallelFor(unsigned int count, F func)
+{
+    unsigned int nThreads = WorkerThreadCount;
+    if (nThreads == 0)
+        nThreads = max(1u, thread::hardware_concurrency());
+    nThreads = min(nThreads, count);
+    if (nThreads == 0)
+        return;
+
+    atomic<unsigned int> next{ 0 };
+    unsigned int completed = 0;
+    unsigned int reported = 0;
+    mutex progressMutex;
+
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            unsigned int index = next.fetch_add(1, memory_order_relaxed);
+            if (index >= count)
+                break;
+
+            func(index);
+
+            lock_guard<mutex> lock(progressMutex);
+            completed++;
+            unsigned int percent = completed * 10 / count * 10;
+            if (percent > reported)
+            {
+                reported = percent;
+                cout << percent << "% " << flush;
+            }
+        }
+    };
+
+    vector<thread> threads;
+    threads.reserve(nThreads - 1);
+    for (unsigned int i = 1; i < nThreads; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads)
+        t.join();
+
+    cout << endl;
+}
+
+
 struct Color
 {
     Color() = default;
@@ -383,6 +440,8 @@ void usage()
     cerr << "           set the number of integration steps for depth\n";
     cerr << "   --scattersteps <value> (or -s)\n";
     cerr << "           set the number of integration steps for scattering\n";
+    cerr << "   --threads <value> (or -t)\n";
+    cerr << "           set the number of worker threads (default is one per core)\n";
 }
 
 
@@ -1034,7 +1093,7 @@ buildExtinctionLUT(const Scene& scene)
     //Sphered planet = Sphered(scene.planet.radius);
     math::Sphered shell(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ExtinctionLUTHeightSteps; i++)
+    parallelFor(ExtinctionLUTHeightSteps, [&](unsigned int i)
     {
         double h = (double) i / (double) (ExtinctionLUTHeightSteps - 1) *
             scene.atmosphereShellHeight * 0.9999;
@@ -1061,7 +1120,7 @@ buildExtinctionLUT(const Scene& scene)
 
             lut->setValue(i, j, ext.cwiseMax(1.0e-18));
         }
-    }
+    });
 
     return lut;
 }
@@ -1094,7 +1153,7 @@ buildOpticalDepthLUT(const Scene& scene)
     //Sphered planet = Sphered(scene.planet.radius);
     math::Sphered shell(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ExtinctionLUTHeightSteps; i++)
+    parallelFor(ExtinctionLUTHeightSteps, [&](unsigned int i)
     {
         double h = (double) i / (double) (ExtinctionLUTHeightSteps - 1) *
             scene.atmosphereShellHeight;
@@ -1120,7 +1179,7 @@ buildOpticalDepthLUT(const Scene& scene)
 
             lut->setValue(i, j, Vector3d(depth.rayleigh, depth.mie, depth.absorption));
         }
-    }
+    });
 
     return lut;
 }
@@ -1311,48 +1370,49 @@ buildScatteringLUT(const Scene& scene)
 
     math::Sphered shell(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ScatteringLUTHeightSteps; i++)
+    // Each tile is one (height, view angle) row of light angles
+    parallelFor(ScatteringLUTHeightSteps * ScatteringLUTViewAngleSteps, [&](unsigned int tile)
     {
+        unsigned int i = tile / ScatteringLUTViewAngleSteps;
+        unsigned int j = tile % ScatteringLUTViewAngleSteps;
+
         double h = (double) i / (double) (ScatteringLUTHeightSteps - 1) *
             scene.atmosphereShellHeight * 0.9999;
         Vector3d atmStart = Vector3d::Zero() +
             Vector3d::UnitX() * (h + scene.planet.radius);
 
-        for (unsigned int j = 0; j < ScatteringLUTViewAngleSteps; j++)
-        {
-            double cosAngle = unpackSNorm((double) j / (ScatteringLUTViewAngleSteps - 1));
-            double sinAngle = sqrt(1.0 - min(1.0, cosAngle * cosAngle));
-            Vector3d viewDir(cosAngle, sinAngle, 0.0);
+        double cosAngle = unpackSNorm((double) j / (ScatteringLUTViewAngleSteps - 1));
+        double sinAngle = sqrt(1.0 - min(1.0, cosAngle * cosAngle));
+        Vector3d viewDir(cosAngle, sinAngle, 0.0);
 
-            Eigen::ParametrizedLine<double, 3> viewRay(atmStart, viewDir);
-            double dist = 0.0;
-            if (!testIntersection(viewRay, shell, dist))
-                dist = 0.0;
+        Eigen::ParametrizedLine<double, 3> viewRay(atmStart, viewDir);
+        double dist = 0.0;
+        if (!testIntersection(viewRay, shell, dist))
+            dist = 0.0;
 
-            Vector3d atmEnd = viewRay.pointAt(dist);
+        Vector3d atmEnd = viewRay.pointAt(dist);
 
-            for (unsigned int k = 0; k < ScatteringLUTLightAngleSteps; k++)
-            {
-                double cosLightAngle = unpackSNorm((double) k / (ScatteringLUTLightAngleSteps - 1));
-                double sinLightAngle = sqrt(1.0 - min(1.0, cosLightAngle * cosLightAngle));
-                Vector3d lightDir(cosLightAngle, sinLightAngle, 0.0);
+        for (unsigned int k = 0; k < ScatteringLUTLightAngleSteps; k++)
+        {
+            double cosLightAngle = unpackSNorm((double) k / (ScatteringLUTLightAngleSteps - 1));
+            double sinLightAngle = sqrt(1.0 - min(1.0, cosLightAngle * cosLightAngle));
+            Vector3d lightDir(cosLightAngle, sinLightAngle, 0.0);
 
 #if 0
-                Vector4d inscatter = integrateInscatteringFactors_LUT(scene,
-                                                                   atmStart,
-                                                                   atmEnd,
-                                                                   lightDir,
-                                                                   true);
-#else
-                Vector4d inscatter = integrateInscatteringFactors(scene,
+            Vector4d inscatter = integrateInscatteringFactors_LUT(scene,
                                                                atmStart,
                                                                atmEnd,
-                                                               lightDir);
+                                                               lightDir,
+                                                               true);
+#else
+            Vector4d inscatter = integrateInscatteringFactors(scene,
+                                                           atmStart,
+                                                           atmEnd,
+                                                           lightDir);
 #endif
-                lut->setValue(i, j, k, inscatter);
-            }
+            lut->setValue(i, j, k, inscatter);
         }
-    }
+    });
 
     return lut;
 }
@@ -1609,14 +1669,13 @@ void render(const Scene& scene,
     unsigned int bottom = min(image.height, viewport.y + viewport.height);
 
     cout << "Rendering " << viewport.width << "x" << viewport.height << " view" << endl;
-    for (unsigned int i = viewport.y; i < bottom; i++)
-    {
-        unsigned int row = i - viewport.y;
-        if (row % 50 == 49)
-            cout << row + 1 << endl;
-        else if (row % 10 == 0)
-            cout << ".";
+    if (bottom <= viewport.y)
+        return;
 
+    // Rows are independent, so they are handed out as tiles to the workers
+    parallelFor(bottom - viewport.y, [&](unsigned int row)
+    {
+        unsigned int i = viewport.y + row;
         for (unsigned int j = viewport.x; j < right; j++)
         {
             double viewportX = ((double) (j - viewport.x) / (double) (viewport.width - 1) - 0.5) * aspectRatio;
@@ -1635,8 +1694,8 @@ void render(const Scene& scene,
 
             image.setPixel(j, i, color);
         }
-    }
-    cout << endl << "Complete" << endl;
+    });
+    cout << "Complete" << endl;
 }
 
 
@@ -1863,6 +1922,15 @@ bool parseCommandLine(int argc, char* argv[])
                     return false;
                 i++;
             }
+            else if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--threads"))
+            {
+                if (i == argc - 1)
+                    return false;
+
+                if (sscanf(argv[i + 1], " %u", &WorkerThreadCount) != 1)
+                    return false;
+                i++;
+            }
             else if (!strcmp(argv[i], "-w") || !strcmp(argv[i], "--width"))
             {
                 if (i == argc - 1)
@@ -13,7 +13,6 @@
 #include <memory>
 #include <string>
 
-#include <cel3ds/3dsread.h>
 #include <celmath/mathlib.h>
 #include <celutil/logger.h>
 
@@ -43,18 +42,10 @@ int main(int argc, char* argv[])
     std::string inputFileName = argv[1];
 
     std::cerr << "Reading...\n";
-    std::unique_ptr<M3DScene> scene = Read3DSFile(inputFileName);
-    if (scene == nullptr)
-    {
-        std::cerr << "Error reading 3DS file '" << inputFileName << "'\n";
-        return 1;
-    }
-
-    std::cerr << "Converting...\n";
-    std::unique_ptr<cmod::Model> model = cmodtools::Convert3DSModel(*scene, cmodtools::GetPathManager()->getHandle);
+    std::unique_ptr<cmod::Model> model = cmodtools::Load3DSModel(inputFileName, cmodtools::GetPathManager()->getHandle);
     if (!model)
     {
-        std::cerr << "Error converting 3DS file to Celestia model\n";
+        std::cerr << "Error reading 3DS file '" << inputFileName << "'\n";
         return 1;
     }
 
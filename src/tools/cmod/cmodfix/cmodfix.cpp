@@ -9,15 +9,28 @@
 //
 // Perform various adjustments to a cmod file
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
 #include <utility>
+#include <vector>
 
+#include <fmt/ostream.h>
+
+#include <celcompat/filesystem.h>
 #include <celmath/mathlib.h>
 #include <celmodel/mesh.h>
 #include <celmodel/model.h>
@@ -39,8 +52,16 @@ bool genTangents = false;
 bool weldVertices = false;
 bool mergeMeshes = false;
 bool stripify = false;
+bool reorder = false;
+bool quantize = false;
 unsigned int vertexCacheSize = 16;
 float smoothAngle = 60.0f;
+unsigned int lodLevels = 0;
+bool batch = false;
+unsigned int jobCount = 0;
+
+// Each level of detail has about half the triangles of the previous one
+constexpr float LODReduction = 0.5f;
 
 
 void usage()
@@ -54,9 +75,15 @@ void usage()
     std::cerr << "   --smooth (or -s) <angle> : smoothing angle for normal generation\n";
     std::cerr << "   --weld (or -w)        : join identical vertices before normal generation\n";
     std::cerr << "   --merge (or -m)       : merge submeshes to improve rendering performance\n";
+    std::cerr << "   --reorder (or -r)     : reorder triangles and vertices for the vertex cache\n";
+    std::cerr << "   --lod (or -l) <count> : add up to count simplified levels of detail\n";
+    std::cerr << "   --quantize (or -q)    : store normals, tangents and texture coordinates compactly\n";
 #ifdef TRISTRIP
     std::cerr << "   --optimize (or -o)    : optimize by converting triangle lists to strips\n";
 #endif
+    std::cerr << "   --batch (or -B)       : fix every cmod file under the input directory and\n";
+    std::cerr << "                           write it to the same path under the output directory\n";
+    std::cerr << "   --jobs (or -j) <count> : number of models fixed at once in batch mode\n";
 }
 
 
@@ -97,10 +124,31 @@ bool parseCommandLine(int argc, char* argv[])
             {
                 mergeMeshes = true;
             }
+            else if (!std::strcmp(argv[i], "-r") || !std::strcmp(argv[i], "--reorder"))
+            {
+                reorder = true;
+            }
+            else if (!std::strcmp(argv[i], "-q") || !std::strcmp(argv[i], "--quantize"))
+            {
+                quantize = true;
+            }
             else if (!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--optimize"))
             {
                 stripify = true;
             }
+            else if (!std::strcmp(argv[i], "-B") || !std::strcmp(argv[i], "--batch"))
+            {
+                batch = true;
+            }
+            else if (!std::strcmp(argv[i], "-j") || !std::strcmp(argv[i], "--jobs"))
+            {
+                if (i == argc - 1)
+                    return false;
+
+                if (std::sscanf(argv[i + 1], " %u", &jobCount) != 1)
+                    return false;
+                i++;
+            }
             else if (!std::strcmp(argv[i], "-s") || !std::strcmp(argv[i], "--smooth"))
             {
                 if (i == argc - 1)
@@ -114,6 +162,19 @@ bool parseCommandLine(int argc, char* argv[])
                     i++;
                 }
             }
+            else if (!std::strcmp(argv[i], "-l") || !std::strcmp(argv[i], "--lod"))
+            {
+                if (i == argc - 1)
+                {
+                    return false;
+                }
+                else
+                {
+                    if (std::sscanf(argv[i + 1], " %u", &lodLevels) != 1)
+                        return false;
+                    i++;
+                }
+            }
             else
             {
                 return false;
@@ -143,40 +204,15 @@ bool parseCommandLine(int argc, char* argv[])
         }
     }
 
-    return true;
+    // Batch mode needs both directories
+    return !batch || fileCount == 2;
 }
 
 
-int main(int argc, char* argv[])
+// Apply the requested operations to a model. Returns false after printing
+// an error message if an operation fails.
+bool fixModel(std::unique_ptr<cmod::Model>& model)
 {
-    if (!parseCommandLine(argc, argv))
-    {
-        usage();
-        return 1;
-    }
-
-
-    CreateLogger();
-
-    std::unique_ptr<cmod::Model> model = nullptr;
-    if (!inputFilename.empty())
-    {
-        std::ifstream in(inputFilename, std::ios::in | std::ios::binary);
-        if (!in.good())
-        {
-            std::cerr << "Error opening " << inputFilename << "\n";
-            return 1;
-        }
-        model = cmod::LoadModel(in, cmodtools::GetPathManager()->getHandle);
-    }
-    else
-    {
-        model = cmod::LoadModel(std::cin, cmodtools::GetPathManager()->getHandle);
-    }
-
-    if (model == nullptr)
-        return 1;
-
     if (genNormals || genTangents)
     {
         auto newModel = std::make_unique<cmod::Model>();
@@ -201,7 +237,7 @@ int main(int argc, char* argv[])
                 if (newMesh.getVertexCount() == 0)
                 {
                     std::cerr << "Error generating normals!\n";
-                    return 1;
+                    return false;
                 }
 
                 mesh = std::move(newMesh);
@@ -213,7 +249,7 @@ int main(int argc, char* argv[])
                 if (newMesh.getVertexCount() == 0)
                 {
                     std::cerr << "Error generating tangents!\n";
-                    return 1;
+                    return false;
                 }
                 // TODO: clean up old mesh
                 mesh = std::move(newMesh);
@@ -251,12 +287,278 @@ int main(int argc, char* argv[])
     }
 #endif
 
+    if (lodLevels > 0)
+    {
+        for (std::uint32_t i = 0; model->getMesh(i) != nullptr; i++)
+        {
+            if (!cmodtools::GenerateLevelsOfDetail(*model->getMesh(i), lodLevels, LODReduction))
+                std::cerr << "Mesh " << i << " has no positions to simplify\n";
+        }
+    }
+
+    if (reorder)
+    {
+        for (std::uint32_t i = 0; model->getMesh(i) != nullptr; i++)
+            cmodtools::OptimizeVertexOrder(*model->getMesh(i));
+    }
+
+    // Last, since the other operations need float normals
+    if (quantize)
+    {
+        for (std::uint32_t i = 0; model->getMesh(i) != nullptr; i++)
+            cmodtools::QuantizeVertexAttributes(*model->getMesh(i));
+    }
+
+    return true;
+}
+
+
+void saveModel(const cmod::Model& model, std::ostream& out)
+{
+    if (outputBinary)
+        SaveModelBinary(&model, out, cmodtools::GetPathManager()->getSource);
+    else
+        SaveModelAscii(&model, out, cmodtools::GetPathManager()->getSource);
+}
+
+
+unsigned int triangleCount(const cmod::Model& model)
+{
+    unsigned int count = 0;
+    for (std::uint32_t i = 0; model.getMesh(i) != nullptr; i++)
+        count += model.getMesh(i)->getPrimitiveCount();
+    return count;
+}
+
+
+// 64-bit FNV-1a
+std::uint64_t hashBytes(std::string_view s, std::uint64_t hash = UINT64_C(0xcbf29ce484222325))
+{
+    for (char c : s)
+        hash = (hash ^ static_cast<std::uint8_t>(c)) * UINT64_C(0x100000001b3);
+    return hash;
+}
+
+
+// Hash of the options that change the output, so that changing them
+// invalidates the batch manifest
+std::uint64_t optionsHash()
+{
+    std::string options = fmt::format("{}{}{}{}{}{}{}{}{} {} {}",
+                                      outputBinary, uniquify, genNormals, genTangents,
+                                      weldVertices, mergeMeshes, stripify, reorder,
+                                      quantize, smoothAngle, lodLevels);
+    return hashBytes(options);
+}
+
+
+constexpr const char* ManifestName = "cmodfix.manifest";
+
+// The manifest in the output directory maps each relative model path to the
+// hash of the input it was built from and of the output written, combined
+// with the options hash.
+using Manifest = std::map<std::string, std::pair<std::uint64_t, std::uint64_t>>;
+
+Manifest readManifest(const fs::path& path)
+{
+    Manifest manifest;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::uint64_t inputHash;
+        std::uint64_t outputHash;
+        std::string relativePath;
+        fields >> std::hex >> inputHash >> outputHash >> std::ws;
+        if (fields && std::getline(fields, relativePath))
+            manifest[relativePath] = { inputHash, outputHash };
+    }
+
+    return manifest;
+}
+
+
+bool writeManifest(const fs::path& path, const Manifest& manifest)
+{
+    std::ofstream out(path);
+    for (const auto& [relativePath, hashes] : manifest)
+        fmt::print(out, "{:016x} {:016x} {}\n", hashes.first, hashes.second, relativePath);
+    return out.good();
+}
+
+
+bool readFile(const fs::path& path, std::string& contents)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return false;
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !in.bad();
+}
+
+
+// Fix every cmod file below the input directory on several threads. Only
+// the operations themselves run in parallel: loading and saving share the
+// global path manager, so they're serialized.
+int fixDirectory(const fs::path& inputDir, const fs::path& outputDir)
+{
+    std::vector<fs::path> files;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(inputDir, ec), end; !ec && it != end; it.increment(ec))
+    {
+        if (it->is_regular_file() && it->path().extension() == ".cmod")
+            files.push_back(it->path().lexically_relative(inputDir));
+    }
+
+    if (ec)
+    {
+        std::cerr << "Error reading directory " << inputDir.string() << "\n";
+        return 1;
+    }
+
+    std::sort(files.begin(), files.end());
+
+    fs::path manifestPath = outputDir / ManifestName;
+    Manifest manifest = readManifest(manifestPath);
+    std::uint64_t options = optionsHash();
+
+    std::mutex ioMutex;
+    std::atomic<std::size_t> next{ 0 };
+    std::atomic<unsigned int> failures{ 0 };
+    unsigned int skipped = 0;
+
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            std::size_t index = next.fetch_add(1, std::memory_order_relaxed);
+            if (index >= files.size())
+                break;
+
+            const fs::path& file = files[index];
+            std::string name = file.generic_string();
+            fs::path outputPath = outputDir / file;
+
+            std::string contents;
+            if (!readFile(inputDir / file, contents))
+            {
+                std::lock_guard<std::mutex> lock(ioMutex);
+                std::cerr << "Error opening " << name << "\n";
+                failures++;
+                continue;
+            }
+
+            std::uint64_t inputHash = hashBytes(contents, options);
+            std::unique_ptr<cmod::Model> model;
+            {
+                std::lock_guard<std::mutex> lock(ioMutex);
+                // An output written over its own input is up to date too
+                if (auto it = manifest.find(name);
+                    it != manifest.end() &&
+                    (it->second.first == inputHash || it->second.second == inputHash) &&
+                    fs::exists(outputPath))
+                {
+                    skipped++;
+                    continue;
+                }
+
+                std::istringstream in(contents);
+                model = cmod::LoadModel(in, cmodtools::GetPathManager()->getHandle);
+                if (model == nullptr)
+                {
+                    std::cerr << "Error loading " << name << "\n";
+                    failures++;
+                    continue;
+                }
+            }
+
+            unsigned int trianglesBefore = triangleCount(*model);
+            if (!fixModel(model))
+            {
+                std::lock_guard<std::mutex> lock(ioMutex);
+                std::cerr << "Error fixing " << name << "\n";
+                failures++;
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(ioMutex);
+            std::ostringstream out;
+            saveModel(*model, out);
+            std::string output = std::move(out).str();
+
+            fs::create_directories(outputPath.parent_path(), ec);
+            std::ofstream outputFile(outputPath, std::ios::out | std::ios::binary);
+            if (!outputFile.write(output.data(), output.size()))
+            {
+                std::cerr << "Error writing " << outputPath.string() << "\n";
+                failures++;
+                continue;
+            }
+
+            manifest[name] = { inputHash, hashBytes(output, options) };
+            fmt::print("{}: {} -> {} bytes, {} -> {} triangles\n",
+                       name, contents.size(), output.size(),
+                       trianglesBefore, triangleCount(*model));
+        }
+    };
+
+    unsigned int nThreads = jobCount > 0 ? jobCount : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < nThreads; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads)
+        t.join();
+
+    fmt::print("{} models, {} up to date, {} failed\n", files.size(), skipped, failures.load());
+
+    if (!writeManifest(manifestPath, manifest))
+        std::cerr << "Error writing " << manifestPath.string() << "\n";
+
+    return failures > 0 ? 1 : 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        usage();
+        return 1;
+    }
+
+
+    CreateLogger();
+
+    if (batch)
+        return fixDirectory(inputFilename, outputFilename);
+
+    std::unique_ptr<cmod::Model> model = nullptr;
+    if (!inputFilename.empty())
+    {
+        std::ifstream in(inputFilename, std::ios::in | std::ios::binary);
+        if (!in.good())
+        {
+            std::cerr << "Error opening " << inputFilename << "\n";
+            return 1;
+        }
+        model = cmod::LoadModel(in, cmodtools::GetPathManager()->getHandle);
+    }
+    else
+    {
+        model = cmod::LoadModel(std::cin, cmodtools::GetPathManager()->getHandle);
+    }
+
+    if (model == nullptr)
+        return 1;
+
+    if (!fixModel(model))
+        return 1;
+
     if (outputFilename.empty())
     {
-        if (outputBinary)
-            SaveModelBinary(model.get(), std::cout, cmodtools::GetPathManager()->getSource);
-        else
-            SaveModelAscii(model.get(), std::cout, cmodtools::GetPathManager()->getSource);
+        saveModel(*model, std::cout);
     }
     else
     {
@@ -274,10 +576,7 @@ int main(int argc, char* argv[])
             return 1;
         }
 
-        if (outputBinary)
-            SaveModelBinary(model.get(), out, cmodtools::GetPathManager()->getSource);
-        else
-            SaveModelAscii(model.get(), out, cmodtools::GetPathManager()->getSource);
+        saveModel(*model, out);
     }
 
     return 0;
@@ -37,8 +37,6 @@
 #include <QStatusBar>
 #include <QVBoxLayout>
 
-#include <cel3ds/3dsmodel.h>
-#include <cel3ds/3dsread.h>
 #include <celmath/mathlib.h>
 #include <celmodel/material.h>
 #include <celmodel/mesh.h>
@@ -350,17 +348,10 @@ MainWindow::openModel(const QString& fileName)
 
         if (info.suffix().toLower() == "3ds")
         {
-            std::unique_ptr<M3DScene> scene = Read3DSFile(fileNameStd);
-            if (scene == nullptr)
-            {
-                QMessageBox::warning(this, "Load error", tr("Error reading 3DS file %1").arg(fileName));
-                return;
-            }
-
-            auto model = cmodtools::Convert3DSModel(*scene, cmodtools::GetPathManager()->getHandle);
+            auto model = cmodtools::Load3DSModel(fileNameStd, cmodtools::GetPathManager()->getHandle);
             if (model == nullptr)
             {
-                QMessageBox::warning(this, "Load error", tr("Internal error converting 3DS file %1").arg(fileName));
+                QMessageBox::warning(this, "Load error", tr("Error reading 3DS file %1").arg(fileName));
                 return;
             }
 
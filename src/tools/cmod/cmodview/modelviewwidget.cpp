@@ -31,6 +31,7 @@
 #include <celmath/geomutil.h>
 #include <celmath/mathlib.h>
 #include <celmodel/model.h>
+#include <celrender/gl/binder.h>
 
 #include "pathmanager.h"
 #include "utils.h"
@@ -112,6 +113,9 @@ constexpr std::array<GLenum, VertexAttributeCount> GLComponentTypes
      GL_FLOAT,          // Float3
      GL_FLOAT,          // Float4,
      GL_UNSIGNED_BYTE,  // UByte4
+     GL_HALF_FLOAT,     // Half2
+     GL_SHORT,          // Short4
+     GL_INT_2_10_10_10_REV, // Int1010102
 };
 
 
@@ -122,6 +126,9 @@ constexpr std::array<int, VertexAttributeCount> GLComponentCounts
      3,  // Float3
      4,  // Float4,
      4,  // UByte4
+     2,  // Half2
+     4,  // Short4
+     4,  // Int1010102
 };
 
 
@@ -734,6 +741,9 @@ ModelViewWidget::initializeGL()
 void
 ModelViewWidget::paintGL()
 {
+    // Qt may have changed the bindings since the last frame
+    celestia::gl::Binder::get().invalidate();
+
     // Generate the shadow buffers for each light source
     if (m_shadowsEnabled && !m_shadowBuffers.empty())
     {
@@ -832,12 +842,12 @@ ModelViewWidget::paintGL()
             glMatrixMode(GL_MODELVIEW);
             glLoadIdentity();
             glDisable(GL_LIGHTING);
-            glUseProgram(0);
+            celestia::gl::Binder::get().use(0);
             glColor4f(1, 1, 1, 1);
 
-            glActiveTexture(GL_TEXTURE0);
+            celestia::gl::Binder::get().activeTexture(0);
             glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, shadowBuffer->depthTexture());
+            celestia::gl::Binder::get().bindTexture(GL_TEXTURE_2D, shadowBuffer->depthTexture());
 
             // Disable texture compare temporarily--we just want to see the
             // stored depth values.
@@ -969,7 +979,7 @@ ModelViewWidget::bindMaterial(const cmod::Material* material,
             GLuint diffuseMapId = m_materialLibrary->getTexture(
                 toQString(cmodtools::GetPathManager()->getSource(material->getMap(cmod::TextureSemantic::DiffuseMap)).c_str()));
             glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, diffuseMapId);
+            celestia::gl::Binder::get().bindTexture(GL_TEXTURE_2D, diffuseMapId);
             setSampler(*shader, "diffuseMap", 0);
         }
 
@@ -977,33 +987,33 @@ ModelViewWidget::bindMaterial(const cmod::Material* material,
         {
             GLuint normalMapId = m_materialLibrary->getTexture(
                 toQString(cmodtools::GetPathManager()->getSource(material->getMap(cmod::TextureSemantic::NormalMap)).c_str()));
-            glActiveTexture(GL_TEXTURE1);
+            celestia::gl::Binder::get().activeTexture(1);
             glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, normalMapId);
+            celestia::gl::Binder::get().bindTexture(GL_TEXTURE_2D, normalMapId);
             setSampler(*shader, "normalMap", 1);
-            glActiveTexture(GL_TEXTURE0);
+            celestia::gl::Binder::get().activeTexture(0);
         }
 
         if (shaderKey.hasSpecularMap())
         {
             GLuint specularMapId = m_materialLibrary->getTexture(
                 toQString(cmodtools::GetPathManager()->getSource(material->getMap(cmod::TextureSemantic::SpecularMap)).c_str()));
-            glActiveTexture(GL_TEXTURE2);
+            celestia::gl::Binder::get().activeTexture(2);
             glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, specularMapId);
+            celestia::gl::Binder::get().bindTexture(GL_TEXTURE_2D, specularMapId);
             setSampler(*shader, "specularMap", 2);
-            glActiveTexture(GL_TEXTURE0);
+            celestia::gl::Binder::get().activeTexture(0);
         }
 
         if (shaderKey.hasEmissiveMap())
         {
             GLuint emissiveMapId = m_materialLibrary->getTexture(
                 toQString(cmodtools::GetPathManager()->getSource(material->getMap(cmod::TextureSemantic::EmissiveMap)).c_str()));
-            glActiveTexture(GL_TEXTURE3);
+            celestia::gl::Binder::get().activeTexture(3);
             glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, emissiveMapId);
+            celestia::gl::Binder::get().bindTexture(GL_TEXTURE_2D, emissiveMapId);
             setSampler(*shader, "emissiveMap", 3);
-            glActiveTexture(GL_TEXTURE0);
+            celestia::gl::Binder::get().activeTexture(0);
         }
 
         unsigned int lightIndex = 0;
@@ -1052,12 +1062,12 @@ ModelViewWidget::bindMaterial(const cmod::Material* material,
                 char samplerName[64];
                 sprintf(samplerName, "shadowTexture%d", i);
 
-                glActiveTexture(GL_TEXTURE4 + i);
+                celestia::gl::Binder::get().activeTexture(4 + i);
                 glEnable(GL_TEXTURE_2D);
-                glBindTexture(GL_TEXTURE_2D, m_shadowBuffers[i]->depthTexture());
+                celestia::gl::Binder::get().bindTexture(GL_TEXTURE_2D, m_shadowBuffers[i]->depthTexture());
                 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
                 setSampler(*shader, samplerName, 4 + i);
-                glActiveTexture(GL_TEXTURE0);
+                celestia::gl::Binder::get().activeTexture(0);
             }
 
             Eigen::Matrix4f shadowMatrixes[MaxShadows];
@@ -1081,7 +1091,7 @@ ModelViewWidget::bindMaterial(const cmod::Material* material,
     }
     else
     {
-        glUseProgram(0);
+        celestia::gl::Binder::get().use(0);
 
         Eigen::Vector4f diffuse(material->diffuse.red(), material->diffuse.green(), material->diffuse.blue(), material->opacity);
         Eigen::Vector4f specular(material->specular.red(), material->specular.green(), material->specular.blue(), 1.0f);
@@ -1104,7 +1114,7 @@ ModelViewWidget::bindMaterial(const cmod::Material* material,
         if (baseTexId != 0)
         {
             glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, baseTexId);
+            celestia::gl::Binder::get().bindTexture(GL_TEXTURE_2D, baseTexId);
         }
         else
         {
@@ -1145,10 +1155,10 @@ ModelViewWidget::renderModel(cmod::Model* model)
     // Disable all texture units
     for (unsigned int i = 0; i < 8; ++i)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
+        celestia::gl::Binder::get().activeTexture(i);
         glDisable(GL_TEXTURE_2D);
     }
-    glActiveTexture(GL_TEXTURE0);
+    celestia::gl::Binder::get().activeTexture(0);
 
     enum {
         Opaque = 0,
@@ -1567,7 +1577,7 @@ ModelViewWidget::renderShadow(unsigned int lightIndex)
     shadowBuffer->bind();
     glViewport(0, 0, shadowBuffer->width(), shadowBuffer->height());
 
-    glUseProgram(0);
+    celestia::gl::Binder::get().use(0);
 
     // Write only to the depth buffer
     glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
@@ -14,13 +14,19 @@
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <functional>
 #include <iostream>
 #include <iterator>
 #include <numeric>
+#include <queue>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <celmodel/model.h>
+#include <celmodel/vertexformat.h>
 
 #include "cmodops.h"
 
@@ -30,6 +36,13 @@ namespace cmodtools
 
 namespace
 {
+// Collapses may turn triangles by at most about 75 degrees
+constexpr double MinCollapseNormalCos = 0.25;
+
+// Each level of detail has to remove at least this fraction of the
+// triangles of the previous one
+constexpr double MinLevelReduction = 0.2;
+
 struct Vertex
 {
     Vertex() :
@@ -86,117 +99,12 @@ private:
 };
 
 
-class PointOrderingPredicate : public VertexComparator
-{
-public:
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        std::array<float, 3> p0;
-        std::memcpy(p0.data(), a.attributes, sizeof(float) * 3);
-
-        std::array<float, 3> p1;
-        std::memcpy(p1.data(), b.attributes, sizeof(float) * 3);
-
-        return p0 < p1;
-    }
-};
-
-
-class PointTexCoordOrderingPredicate : public VertexComparator
-{
-public:
-    PointTexCoordOrderingPredicate(std::uint32_t _posOffset, std::uint32_t _texCoordOffset) :
-        posOffset(_posOffset),
-        texCoordOffset(_texCoordOffset)
-    {
-    }
-
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        std::array<float, 5> ptc0;
-        std::memcpy(ptc0.data(), a.attributes + posOffset, sizeof(float) * 3);
-        std::memcpy(ptc0.data() + 3, a.attributes + texCoordOffset, sizeof(float) * 2);
-
-        std::array<float, 5> ptc1;
-        std::memcpy(ptc1.data(), b.attributes + posOffset, sizeof(float) * 3);
-        std::memcpy(ptc1.data() + 3, b.attributes + texCoordOffset, sizeof(float) * 2);
-
-        return ptc0 < ptc1;
-    }
-
-private:
-    std::uint32_t posOffset;
-    std::uint32_t texCoordOffset;
-};
-
-
 bool approxEqual(float x, float y, float prec)
 {
     return std::abs(x - y) <= prec * std::min(std::abs(x), std::abs(y));
 }
 
 
-class PointEquivalencePredicate : public VertexComparator
-{
-public:
-    PointEquivalencePredicate(std::uint32_t _posOffset,
-                              float _tolerance) :
-        posOffset(_posOffset),
-        tolerance(_tolerance)
-    {
-    }
-
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        std::array<float, 3> p0;
-        std::memcpy(p0.data(), a.attributes + posOffset, sizeof(float) * 3);
-
-        std::array<float, 3> p1;
-        std::memcpy(p1.data(), b.attributes + posOffset, sizeof(float) * 3);
-
-        return std::equal(p0.cbegin(), p0.cend(), p1.cbegin(),
-                          [&](float f0, float f1) { return approxEqual(f0, f1, tolerance); });
-    }
-
-private:
-    std::uint32_t posOffset;
-    float tolerance;
-};
-
-
-class PointTexCoordEquivalencePredicate : public VertexComparator
-{
-public:
-    PointTexCoordEquivalencePredicate(std::uint32_t _posOffset,
-                                      std::uint32_t _texCoordOffset,
-                                      float _tolerance) :
-        posOffset(_posOffset),
-        texCoordOffset(_texCoordOffset),
-        tolerance(_tolerance)
-    {
-    }
-
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        std::array<float, 5> ptc0;
-        std::memcpy(ptc0.data(), a.attributes + posOffset, sizeof(float) * 3);
-        std::memcpy(ptc0.data() + 3, a.attributes + texCoordOffset, sizeof(float) * 2);
-
-        std::array<float, 5> ptc1;
-        std::memcpy(ptc1.data(), b.attributes + posOffset, sizeof(float) * 3);
-        std::memcpy(ptc1.data() + 3, b.attributes + texCoordOffset, sizeof(float) * 2);
-
-        return std::equal(ptc0.cbegin(), ptc0.cend(), ptc1.cbegin(),
-                          [&](float f0, float f1) { return approxEqual(f0, f1, tolerance); });
-    }
-
-private:
-    std::uint32_t posOffset;
-    std::uint32_t texCoordOffset;
-    float tolerance;
-};
-
-
 bool equal(const Vertex& a, const Vertex& b, std::uint32_t vertexSize)
 {
     return std::equal(a.attributes, a.attributes + vertexSize, b.attributes);
@@ -227,19 +135,53 @@ getTexCoord(const cmod::VWord* vertexData,
 }
 
 
+// Vertex to face adjacency in compressed row form: the faces that contain
+// point v are faceList[offsets[v]] up to faceList[offsets[v + 1]].
+struct VertexFaces
+{
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> faceList;
+};
+
+
+VertexFaces
+buildVertexFaces(const std::vector<Face>& faces, std::uint32_t nVertices)
+{
+    VertexFaces adjacency;
+    adjacency.offsets.assign(nVertices + 1, 0);
+    for (const Face& face : faces)
+    {
+        for (std::uint32_t j = 0; j < 3; j++)
+            adjacency.offsets[face.vi[j] + 1]++;
+    }
+
+    std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+
+    std::vector<std::uint32_t> next(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    adjacency.faceList.resize(faces.size() * 3);
+    for (std::uint32_t f = 0; f < faces.size(); f++)
+    {
+        for (std::uint32_t j = 0; j < 3; j++)
+            adjacency.faceList[next[faces[f].vi[j]]++] = f;
+    }
+
+    return adjacency;
+}
+
+
 Eigen::Vector3f
 averageFaceVectors(const std::vector<Face>& faces,
                    std::uint32_t thisFace,
-                   std::uint32_t* vertexFaces,
-                   std::uint32_t vertexFaceCount,
+                   const VertexFaces& adjacency,
+                   std::uint32_t vertex,
                    float cosSmoothingAngle)
 {
     const Face& face = faces[thisFace];
 
     Eigen::Vector3f v = Eigen::Vector3f::Zero();
-    for (std::uint32_t i = 0; i < vertexFaceCount; i++)
+    for (std::uint32_t i = adjacency.offsets[vertex]; i < adjacency.offsets[vertex + 1]; i++)
     {
-        std::uint32_t f = vertexFaces[i];
+        std::uint32_t f = adjacency.faceList[i];
         float cosAngle = face.normal.dot(faces[f].normal);
         if (f == thisFace || cosAngle > cosSmoothingAngle)
             v += faces[f].normal;
@@ -254,6 +196,32 @@ averageFaceVectors(const std::vector<Face>& faces,
 }
 
 
+// Call func(first, last) for contiguous ranges covering [0, count) on
+// several threads. Each index must only write its own outputs.
+template<typename F> void
+parallelFor(std::uint32_t count, F func)
+{
+    constexpr std::uint32_t MinRangeSize = 4096;
+
+    std::uint32_t nThreads = std::max(1u, std::thread::hardware_concurrency());
+    nThreads = std::min(nThreads, (count + MinRangeSize - 1) / MinRangeSize);
+    if (nThreads <= 1)
+    {
+        func(0u, count);
+        return;
+    }
+
+    std::uint32_t rangeSize = (count + nThreads - 1) / nThreads;
+    std::vector<std::thread> threads;
+    for (std::uint32_t first = rangeSize; first < count; first += rangeSize)
+        threads.emplace_back(func, first, std::min(count, first + rangeSize));
+    func(0u, rangeSize);
+
+    for (auto& t : threads)
+        t.join();
+}
+
+
 void
 copyVertex(cmod::VWord* newVertexData,
            const cmod::VertexDescription& newDesc,
@@ -332,62 +300,623 @@ addGroupWithOffset(cmod::Mesh& mesh,
 }
 
 
-template<typename T, typename U> void
-joinVertices(std::vector<Face>& faces,
-             const cmod::VWord* vertexData,
-             const cmod::VertexDescription& desc,
-             const T& orderingPredicate,
-             const U& equivalencePredicate)
+constexpr std::uint32_t NoTexCoord = ~0u;
+
+std::uint64_t
+hashWord(std::uint64_t hash, std::uint64_t word)
 {
-    // Don't do anything if we're given no data
-    if (faces.size() == 0)
-        return;
+    hash = (hash ^ word) * UINT64_C(0x9e3779b97f4a7c15);
+    return hash ^ (hash >> 32);
+}
 
-    // Must have a position
-    assert(desc.getAttribute(cmod::VertexAttributeSemantic::Position).format == cmod::VertexAttributeFormat::Float3);
 
-    std::uint32_t posOffset = desc.getAttribute(cmod::VertexAttributeSemantic::Position).offsetWords;
-    const cmod::VWord* vertexPoints = vertexData + posOffset;
-    std::uint32_t nVertices = faces.size() * 3;
+// Set the point indices of the faces so that vertices with positions, and
+// texture coordinates unless texCoordOffset is NoTexCoord, equal to within
+// the relative tolerance share a point. Vertices are hashed into grid cells
+// twice as large as the tolerance, so that each vertex only needs to be
+// compared with the points already found in its own cell and the seven
+// cells next to the nearest corner. With no tolerance, the hash is of the
+// exact values and only one cell is searched.
+void
+weldVertices(std::vector<Face>& faces,
+             const cmod::VWord* vertexData,
+             std::uint32_t nVertices,
+             std::uint32_t stride,
+             std::uint32_t posOffset,
+             std::uint32_t texCoordOffset,
+             float tolerance)
+{
+    constexpr std::uint32_t NoVertex = ~0u;
 
-    // Initialize the array of vertices
-    std::vector<Vertex> vertices(nVertices);
-    std::uint32_t f;
-    unsigned int stride = desc.strideBytes / sizeof(cmod::VWord);
-    for (f = 0; f < faces.size(); f++)
+    std::vector<bool> used(nVertices, false);
+    for (const Face& face : faces)
     {
         for (std::uint32_t j = 0; j < 3; j++)
+            used[face.i[j]] = true;
+    }
+
+    float maxCoord = 0.0f;
+    for (std::uint32_t i = 0; i < nVertices; i++)
+    {
+        if (used[i])
+            maxCoord = std::max(maxCoord, getVertex(vertexData, posOffset, stride, i).cwiseAbs().maxCoeff());
+    }
+
+    // approxEqual allows a difference of at most tolerance * maxCoord
+    float cellSize = 2.0f * tolerance * maxCoord;
+    bool exact = !(cellSize > 0.0f);
+
+    auto equivalent = [&](std::uint32_t a, std::uint32_t b)
+    {
+        Eigen::Vector3f pa = getVertex(vertexData, posOffset, stride, a);
+        Eigen::Vector3f pb = getVertex(vertexData, posOffset, stride, b);
+        for (int k = 0; k < 3; k++)
         {
-            std::uint32_t index = faces[f].i[j];
-            vertices[f * 3 + j] = Vertex(index, vertexPoints + stride * index);
+            if (!approxEqual(pa[k], pb[k], tolerance))
+                return false;
+        }
+
+        if (texCoordOffset == NoTexCoord)
+            return true;
 
+        Eigen::Vector2f ta = getTexCoord(vertexData, texCoordOffset, stride, a);
+        Eigen::Vector2f tb = getTexCoord(vertexData, texCoordOffset, stride, b);
+        return approxEqual(ta.x(), tb.x(), tolerance) && approxEqual(ta.y(), tb.y(), tolerance);
+    };
+
+    auto exactHash = [&](std::uint32_t vertex)
+    {
+        std::array<float, 5> values;
+        Eigen::Map<Eigen::Vector3f>(values.data()) = getVertex(vertexData, posOffset, stride, vertex);
+        std::size_t nValues = 3;
+        if (texCoordOffset != NoTexCoord)
+        {
+            Eigen::Map<Eigen::Vector2f>(values.data() + 3) = getTexCoord(vertexData, texCoordOffset, stride, vertex);
+            nValues = 5;
         }
-    }
 
-    // Sort the vertices so that identical ones will be ordered consecutively
-    std::sort(vertices.begin(), vertices.end(), orderingPredicate);
+        std::uint64_t hash = 0;
+        for (std::size_t k = 0; k < nValues; k++)
+        {
+            // Adding zero turns -0 into +0 so that they hash the same
+            float value = values[k] + 0.0f;
+            std::uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            hash = hashWord(hash, bits);
+        }
+
+        return hash;
+    };
+
+    auto cellHash = [](const std::array<std::int64_t, 3>& cell)
+    {
+        std::uint64_t hash = 0;
+        for (std::int64_t c : cell)
+            hash = hashWord(hash, static_cast<std::uint64_t>(c));
+        return hash;
+    };
+
+    // Points found so far, chained by cell hash
+    std::unordered_map<std::uint64_t, std::uint32_t> cellHeads;
+    cellHeads.reserve(nVertices);
+    std::vector<std::uint32_t> nextInCell(nVertices, NoVertex);
+    std::vector<std::uint32_t> mergeMap(nVertices, NoVertex);
+
+    auto findPoint = [&](std::uint32_t vertex, std::uint64_t hash)
+    {
+        auto it = cellHeads.find(hash);
+        if (it == cellHeads.end())
+            return NoVertex;
+
+        for (std::uint32_t point = it->second; point != NoVertex; point = nextInCell[point])
+        {
+            if (equivalent(vertex, point))
+                return point;
+        }
+
+        return NoVertex;
+    };
 
-    // Build the vertex merge map
-    std::vector<std::uint32_t> mergeMap(nVertices);
-    std::uint32_t lastUnique = 0;
     for (std::uint32_t i = 0; i < nVertices; i++)
     {
-        if (i == 0 || !equivalencePredicate(vertices[i - 1], vertices[i]))
+        if (!used[i])
+            continue;
+
+        std::uint64_t hash;
+        std::uint32_t point = NoVertex;
+        if (exact)
+        {
+            hash = exactHash(i);
+            point = findPoint(i, hash);
+        }
+        else
+        {
+            Eigen::Vector3f p = getVertex(vertexData, posOffset, stride, i) / cellSize;
+            std::array<std::int64_t, 3> cell;
+            std::array<std::int64_t, 3> nearest;
+            for (int k = 0; k < 3; k++)
+            {
+                float c = std::floor(p[k]);
+                cell[k] = static_cast<std::int64_t>(c);
+                nearest[k] = p[k] - c < 0.5f ? -1 : 1;
+            }
+
+            hash = cellHash(cell);
+            point = findPoint(i, hash);
+            for (unsigned int corner = 1; corner < 8 && point == NoVertex; corner++)
+            {
+                std::array<std::int64_t, 3> neighbor = cell;
+                for (int k = 0; k < 3; k++)
+                {
+                    if ((corner & (1u << k)) != 0)
+                        neighbor[k] += nearest[k];
+                }
+                point = findPoint(i, cellHash(neighbor));
+            }
+        }
+
+        if (point != NoVertex)
         {
-            lastUnique = i;
+            mergeMap[i] = point;
+            continue;
         }
 
-        mergeMap[vertices[i].index] = vertices[lastUnique].index;
+        mergeMap[i] = i;
+        auto [it, inserted] = cellHeads.try_emplace(hash, i);
+        if (!inserted)
+        {
+            nextInCell[i] = it->second;
+            it->second = i;
+        }
     }
 
     // Remap the vertex indices
-    for (f = 0; f < faces.size(); f++)
+    for (Face& face : faces)
+    {
+        for (std::uint32_t k = 0; k < 3; k++)
+            face.vi[k] = mergeMap[face.i[k]];
+    }
+}
+
+
+// Quadric of the sum of squared distances to a set of planes
+using Quadric = Eigen::Matrix4d;
+
+
+Quadric
+planeQuadric(const Eigen::Vector3d& normal, const Eigen::Vector3d& point)
+{
+    Eigen::Vector4d plane;
+    plane << normal, -normal.dot(point);
+    return plane * plane.transpose();
+}
+
+
+double
+quadricError(const Quadric& q, const Eigen::Vector3d& point)
+{
+    Eigen::Vector4d v = point.homogeneous();
+    return std::max(0.0, v.dot(q * v));
+}
+
+
+struct SimplifierTriangle
+{
+    std::array<cmod::Index32, 3> vertices;
+    unsigned int materialIndex;
+    bool removed{ false };
+};
+
+
+struct Collapse
+{
+    double cost;
+    std::uint32_t from;
+    std::uint32_t to;
+    unsigned int fromVersion;
+    unsigned int toVersion;
+
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+
+/* Quadric error edge collapse simplification (Garland & Heckbert.) Vertices
+ * with the same position are welded into points, and collapses move a point
+ * onto one of its neighbors, so that the simplified triangles only reference
+ * vertices of the original mesh. A point where several vertices meet, as
+ * along texture or normal seams, can only collapse along the seam, and the
+ * edges of seams and open borders add planes perpendicular to the surface
+ * to keep them in place.
+ */
+class MeshSimplifier
+{
+public:
+    explicit MeshSimplifier(const cmod::Mesh& _mesh) : mesh(_mesh) {}
+
+    bool build();
+    void simplify(unsigned int targetTriangleCount);
+    cmod::LevelOfDetail getLevelOfDetail() const;
+
+    unsigned int getTriangleCount() const { return liveTriangleCount; }
+
+private:
+    using VertexMap = std::vector<std::pair<cmod::Index32, cmod::Index32>>;
+
+    void addTriangle(cmod::Index32 v0, cmod::Index32 v1, cmod::Index32 v2, unsigned int materialIndex);
+    void getNeighbors(std::uint32_t point, std::vector<std::uint32_t>& neighbors) const;
+    int findCorner(const SimplifierTriangle& tri, std::uint32_t point) const;
+    void pushCollapse(std::uint32_t from, std::uint32_t to);
+    bool canCollapse(std::uint32_t from, std::uint32_t to, VertexMap& vertexMap) const;
+    void collapse(std::uint32_t from, std::uint32_t to, const VertexMap& vertexMap);
+
+    const cmod::Mesh& mesh;
+
+    std::vector<std::uint32_t> pointOf; // welded point of each vertex
+    std::vector<Eigen::Vector3d> points;
+    std::vector<Quadric> quadrics;
+    std::vector<unsigned int> versions;
+    std::vector<bool> collapsed;
+    std::vector<std::vector<std::uint32_t>> pointTriangles;
+
+    std::vector<SimplifierTriangle> triangles;
+    unsigned int liveTriangleCount{ 0 };
+    double maxError{ 0.0 };
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+};
+
+
+bool
+MeshSimplifier::build()
+{
+    const cmod::VertexDescription& desc = mesh.getVertexDescription();
+    const cmod::VertexAttribute& position = desc.getAttribute(cmod::VertexAttributeSemantic::Position);
+    if (position.format != cmod::VertexAttributeFormat::Float3)
+        return false;
+
+    // Weld the vertices by position
+    std::uint32_t nVertices = mesh.getVertexCount();
+    unsigned int stride = mesh.getVertexStrideWords();
+    std::vector<std::array<float, 3>> positions(nVertices);
+    for (std::uint32_t i = 0; i < nVertices; i++)
+        std::memcpy(positions[i].data(), mesh.getVertexData() + i * stride + position.offsetWords, sizeof(float) * 3);
+
+    std::vector<std::uint32_t> order(nVertices);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&positions](std::uint32_t a, std::uint32_t b) { return positions[a] < positions[b]; });
+
+    pointOf.resize(nVertices);
+    for (std::uint32_t i = 0; i < nVertices; i++)
+    {
+        if (i == 0 || positions[order[i]] != positions[order[i - 1]])
+            points.emplace_back(positions[order[i]][0], positions[order[i]][1], positions[order[i]][2]);
+        pointOf[order[i]] = static_cast<std::uint32_t>(points.size() - 1);
+    }
+
+    quadrics.resize(points.size(), Quadric::Zero());
+    versions.resize(points.size(), 0);
+    collapsed.resize(points.size(), false);
+    pointTriangles.resize(points.size());
+
+    for (unsigned int groupIndex = 0; groupIndex < mesh.getGroupCount(); groupIndex++)
+    {
+        const cmod::PrimitiveGroup* group = mesh.getGroup(groupIndex);
+        const std::vector<cmod::Index32>& indices = group->indices;
+        switch (group->prim)
+        {
+        case cmod::PrimitiveGroupType::TriList:
+            for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+                addTriangle(indices[i], indices[i + 1], indices[i + 2], group->materialIndex);
+            break;
+        case cmod::PrimitiveGroupType::TriStrip:
+            for (std::size_t i = 0; i + 2 < indices.size(); i++)
+            {
+                if ((i & 1) == 0)
+                    addTriangle(indices[i], indices[i + 1], indices[i + 2], group->materialIndex);
+                else
+                    addTriangle(indices[i], indices[i + 2], indices[i + 1], group->materialIndex);
+            }
+            break;
+        case cmod::PrimitiveGroupType::TriFan:
+            for (std::size_t i = 1; i + 1 < indices.size(); i++)
+                addTriangle(indices[0], indices[i], indices[i + 1], group->materialIndex);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Edges used by a single triangle are open borders or seams. Keep them
+    // in place with a plane through the edge, perpendicular to the triangle.
+    std::vector<std::tuple<cmod::Index32, cmod::Index32, std::uint32_t>> edges;
+    for (std::uint32_t t = 0; t < triangles.size(); t++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            cmod::Index32 a = triangles[t].vertices[k];
+            cmod::Index32 b = triangles[t].vertices[(k + 1) % 3];
+            edges.emplace_back(std::min(a, b), std::max(a, b), t);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for (std::size_t i = 0; i < edges.size();)
     {
-        for (std::uint32_t k= 0; k < 3; k++)
+        std::size_t j = i + 1;
+        while (j < edges.size() && std::get<0>(edges[j]) == std::get<0>(edges[i]) &&
+               std::get<1>(edges[j]) == std::get<1>(edges[i]))
         {
-            faces[f].vi[k] = mergeMap[faces[f].i[k]];
+            j++;
+        }
+
+        if (j == i + 1)
+        {
+            const SimplifierTriangle& tri = triangles[std::get<2>(edges[i])];
+            std::uint32_t a = pointOf[std::get<0>(edges[i])];
+            std::uint32_t b = pointOf[std::get<1>(edges[i])];
+            Eigen::Vector3d normal = (points[pointOf[tri.vertices[1]]] - points[pointOf[tri.vertices[0]]])
+                .cross(points[pointOf[tri.vertices[2]]] - points[pointOf[tri.vertices[0]]]);
+            Eigen::Vector3d borderNormal = (points[b] - points[a]).cross(normal);
+            if (borderNormal.squaredNorm() > 0.0)
+            {
+                Quadric q = planeQuadric(borderNormal.normalized(), points[a]);
+                quadrics[a] += q;
+                quadrics[b] += q;
+            }
         }
+
+        i = j;
     }
+
+    std::vector<std::uint32_t> neighbors;
+    for (std::uint32_t p = 0; p < points.size(); p++)
+    {
+        getNeighbors(p, neighbors);
+        for (std::uint32_t n : neighbors)
+            pushCollapse(p, n);
+    }
+
+    return true;
+}
+
+
+void
+MeshSimplifier::addTriangle(cmod::Index32 v0, cmod::Index32 v1, cmod::Index32 v2, unsigned int materialIndex)
+{
+    std::uint32_t p0 = pointOf[v0];
+    std::uint32_t p1 = pointOf[v1];
+    std::uint32_t p2 = pointOf[v2];
+    Eigen::Vector3d normal = (points[p1] - points[p0]).cross(points[p2] - points[p0]);
+
+    // Degenerate triangles are invisible, drop them
+    if (p0 == p1 || p1 == p2 || p2 == p0 || normal.squaredNorm() == 0.0)
+        return;
+
+    Quadric q = planeQuadric(normal.normalized(), points[p0]);
+    quadrics[p0] += q;
+    quadrics[p1] += q;
+    quadrics[p2] += q;
+
+    auto t = static_cast<std::uint32_t>(triangles.size());
+    triangles.push_back({ { v0, v1, v2 }, materialIndex });
+    pointTriangles[p0].push_back(t);
+    pointTriangles[p1].push_back(t);
+    pointTriangles[p2].push_back(t);
+    liveTriangleCount++;
+}
+
+
+void
+MeshSimplifier::getNeighbors(std::uint32_t point, std::vector<std::uint32_t>& neighbors) const
+{
+    neighbors.clear();
+    for (std::uint32_t t : pointTriangles[point])
+    {
+        if (triangles[t].removed)
+            continue;
+
+        for (cmod::Index32 v : triangles[t].vertices)
+        {
+            if (pointOf[v] != point)
+                neighbors.push_back(pointOf[v]);
+        }
+    }
+
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+}
+
+
+int
+MeshSimplifier::findCorner(const SimplifierTriangle& tri, std::uint32_t point) const
+{
+    for (int k = 0; k < 3; k++)
+    {
+        if (pointOf[tri.vertices[k]] == point)
+            return k;
+    }
+
+    return -1;
+}
+
+
+void
+MeshSimplifier::pushCollapse(std::uint32_t from, std::uint32_t to)
+{
+    double cost = quadricError(quadrics[from] + quadrics[to], points[to]);
+    queue.push({ cost, from, to, versions[from], versions[to] });
+}
+
+
+bool
+MeshSimplifier::canCollapse(std::uint32_t from, std::uint32_t to, VertexMap& vertexMap) const
+{
+    // Each vertex at the collapsed point has to share a triangle with
+    // exactly one vertex at the target point, which replaces it
+    vertexMap.clear();
+    unsigned int edgeTriangleCount = 0;
+    for (std::uint32_t t : pointTriangles[from])
+    {
+        const SimplifierTriangle& tri = triangles[t];
+        int toCorner = tri.removed ? -1 : findCorner(tri, to);
+        if (toCorner < 0)
+            continue;
+
+        edgeTriangleCount++;
+        cmod::Index32 v = tri.vertices[findCorner(tri, from)];
+        cmod::Index32 target = tri.vertices[toCorner];
+        auto it = std::find_if(vertexMap.begin(), vertexMap.end(),
+                               [v](const auto& entry) { return entry.first == v; });
+        if (it == vertexMap.end())
+            vertexMap.emplace_back(v, target);
+        else if (it->second != target)
+            return false;
+    }
+
+    if (edgeTriangleCount == 0)
+        return false;
+
+    // Reject collapses that would flip or fold triangles
+    for (std::uint32_t t : pointTriangles[from])
+    {
+        const SimplifierTriangle& tri = triangles[t];
+        if (tri.removed || findCorner(tri, to) >= 0)
+            continue;
+
+        int corner = findCorner(tri, from);
+        cmod::Index32 v = tri.vertices[corner];
+        if (std::none_of(vertexMap.begin(), vertexMap.end(),
+                         [v](const auto& entry) { return entry.first == v; }))
+        {
+            return false;
+        }
+
+        std::array<Eigen::Vector3d, 3> p;
+        for (int k = 0; k < 3; k++)
+            p[k] = points[pointOf[tri.vertices[k]]];
+        Eigen::Vector3d oldNormal = (p[1] - p[0]).cross(p[2] - p[0]);
+        p[corner] = points[to];
+        Eigen::Vector3d newNormal = (p[1] - p[0]).cross(p[2] - p[0]);
+        if (newNormal.dot(oldNormal) <= MinCollapseNormalCos * newNormal.norm() * oldNormal.norm())
+            return false;
+    }
+
+    // Points adjacent to both ends of the edge other than the opposite
+    // corners of its triangles would be pinched into a non-manifold edge
+    std::vector<std::uint32_t> fromNeighbors;
+    std::vector<std::uint32_t> toNeighbors;
+    getNeighbors(from, fromNeighbors);
+    getNeighbors(to, toNeighbors);
+    std::vector<std::uint32_t> common;
+    std::set_intersection(fromNeighbors.begin(), fromNeighbors.end(),
+                          toNeighbors.begin(), toNeighbors.end(),
+                          std::back_inserter(common));
+    return common.size() <= edgeTriangleCount;
+}
+
+
+void
+MeshSimplifier::collapse(std::uint32_t from, std::uint32_t to, const VertexMap& vertexMap)
+{
+    for (std::uint32_t t : pointTriangles[from])
+    {
+        SimplifierTriangle& tri = triangles[t];
+        if (tri.removed)
+            continue;
+
+        if (findCorner(tri, to) >= 0)
+        {
+            tri.removed = true;
+            liveTriangleCount--;
+            continue;
+        }
+
+        cmod::Index32& v = tri.vertices[findCorner(tri, from)];
+        v = std::find_if(vertexMap.begin(), vertexMap.end(),
+                         [&v](const auto& entry) { return entry.first == v; })->second;
+        pointTriangles[to].push_back(t);
+    }
+
+    pointTriangles[from].clear();
+    pointTriangles[from].shrink_to_fit();
+    auto& toTriangles = pointTriangles[to];
+    toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(),
+                                     [this](std::uint32_t t) { return triangles[t].removed; }),
+                      toTriangles.end());
+
+    quadrics[to] += quadrics[from];
+    collapsed[from] = true;
+    versions[to]++;
+
+    // The cost of all edges at the target point has changed
+    std::vector<std::uint32_t> neighbors;
+    getNeighbors(to, neighbors);
+    for (std::uint32_t n : neighbors)
+    {
+        pushCollapse(to, n);
+        pushCollapse(n, to);
+    }
+}
+
+
+void
+MeshSimplifier::simplify(unsigned int targetTriangleCount)
+{
+    VertexMap vertexMap;
+    while (liveTriangleCount > targetTriangleCount && !queue.empty())
+    {
+        Collapse c = queue.top();
+        queue.pop();
+
+        if (collapsed[c.from] || collapsed[c.to] ||
+            versions[c.from] != c.fromVersion || versions[c.to] != c.toVersion ||
+            !canCollapse(c.from, c.to, vertexMap))
+        {
+            continue;
+        }
+
+        collapse(c.from, c.to, vertexMap);
+        maxError = std::max(maxError, std::sqrt(c.cost));
+    }
+}
+
+
+cmod::LevelOfDetail
+MeshSimplifier::getLevelOfDetail() const
+{
+    cmod::LevelOfDetail level;
+    level.error = static_cast<float>(maxError);
+
+    for (const SimplifierTriangle& tri : triangles)
+    {
+        if (tri.removed)
+            continue;
+
+        auto it = std::find_if(level.groups.begin(), level.groups.end(),
+                               [&tri](const cmod::PrimitiveGroup& g) { return g.materialIndex == tri.materialIndex; });
+        if (it == level.groups.end())
+        {
+            it = level.groups.emplace(level.groups.end());
+            it->prim = cmod::PrimitiveGroupType::TriList;
+            it->materialIndex = tri.materialIndex;
+        }
+        it->indices.insert(it->indices.end(), tri.vertices.begin(), tri.vertices.end());
+    }
+
+    // Lines and points aren't simplified
+    for (unsigned int groupIndex = 0; groupIndex < mesh.getGroupCount(); groupIndex++)
+    {
+        const cmod::PrimitiveGroup* group = mesh.getGroup(groupIndex);
+        if (group->prim != cmod::PrimitiveGroupType::TriList &&
+            group->prim != cmod::PrimitiveGroupType::TriStrip &&
+            group->prim != cmod::PrimitiveGroupType::TriFan)
+        {
+            level.groups.push_back(group->clone());
+        }
+    }
+
+    return level;
 }
 
 
@@ -524,31 +1053,28 @@ GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weld
     const cmod::VWord* vertexData = mesh.getVertexData();
 
     // Compute normals for the faces
-    for (f = 0; f < nFaces; f++)
+    parallelFor(nFaces, [&](std::uint32_t first, std::uint32_t last)
     {
-        Face& face = faces[f];
-        Eigen::Vector3f p0 = getVertex(vertexData, posOffset, stride, face.i[0]);
-        Eigen::Vector3f p1 = getVertex(vertexData, posOffset, stride, face.i[1]);
-        Eigen::Vector3f p2 = getVertex(vertexData, posOffset, stride, face.i[2]);
-        face.normal = (p1 - p0).cross(p2 - p1);
-        if (face.normal.squaredNorm() > 0.0f)
+        for (std::uint32_t f = first; f < last; f++)
         {
-            face.normal.normalize();
+            Face& face = faces[f];
+            Eigen::Vector3f p0 = getVertex(vertexData, posOffset, stride, face.i[0]);
+            Eigen::Vector3f p1 = getVertex(vertexData, posOffset, stride, face.i[1]);
+            Eigen::Vector3f p2 = getVertex(vertexData, posOffset, stride, face.i[2]);
+            face.normal = (p1 - p0).cross(p2 - p1);
+            if (face.normal.squaredNorm() > 0.0f)
+            {
+                face.normal.normalize();
+            }
         }
-    }
-
-    // For each vertex, create a list of faces that contain it
-    std::vector<std::uint32_t> faceCounts(nVertices, 0);
-    std::vector<std::vector<std::uint32_t>> vertexFaces(nVertices);
+    });
 
     // If we're welding vertices before generating normals, find identical
     // points and merge them.  Otherwise, the point indices will be the same
     // as the attribute indices.
     if (weld)
     {
-        joinVertices(faces, vertexData, desc,
-                     PointOrderingPredicate(),
-                     PointEquivalencePredicate(0, weldTolerance));
+        weldVertices(faces, vertexData, nVertices, stride, posOffset, NoTexCoord, weldTolerance);
     }
     else
     {
@@ -560,48 +1086,22 @@ GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weld
         }
     }
 
-    // Count the number of faces in which each vertex appears
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        faceCounts[face.vi[0]]++;
-        faceCounts[face.vi[1]]++;
-        faceCounts[face.vi[2]]++;
-    }
-
-    // Allocate space for the per-vertex face lists
-    for (i = 0; i < nVertices; i++)
-    {
-        if (faceCounts[i] > 0)
-        {
-            vertexFaces[i].resize(faceCounts[i] + 1);
-            vertexFaces[i][0] = faceCounts[i];
-        }
-    }
-
-    // Fill in the vertex/face lists
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        vertexFaces[face.vi[0]][faceCounts[face.vi[0]]--] = f;
-        vertexFaces[face.vi[1]][faceCounts[face.vi[1]]--] = f;
-        vertexFaces[face.vi[2]][faceCounts[face.vi[2]]--] = f;
-    }
+    // For each vertex, create a list of faces that contain it
+    VertexFaces vertexFaces = buildVertexFaces(faces, nVertices);
 
     // Compute the vertex normals by averaging
     std::vector<Eigen::Vector3f> vertexNormals(nFaces * 3);
-    for (f = 0; f < nFaces; f++)
+    parallelFor(nFaces, [&](std::uint32_t first, std::uint32_t last)
     {
-        Face& face = faces[f];
-        for (std::uint32_t j = 0; j < 3; j++)
+        for (std::uint32_t f = first; f < last; f++)
         {
-            vertexNormals[f * 3 + j] =
-                averageFaceVectors(faces, f,
-                                   &vertexFaces[face.vi[j]][1],
-                                   vertexFaces[face.vi[j]][0],
-                                   cosSmoothAngle);
+            for (std::uint32_t j = 0; j < 3; j++)
+            {
+                vertexNormals[f * 3 + j] =
+                    averageFaceVectors(faces, f, vertexFaces, faces[f].vi[j], cosSmoothAngle);
+            }
         }
-    }
+    });
 
     // Finally, create a new mesh with normals included
 
@@ -783,45 +1283,35 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
     const cmod::VWord* vertexData = mesh.getVertexData();
 
     // Compute tangents for faces
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        Eigen::Vector3f p0 = getVertex(vertexData, posOffset, stride, face.i[0]);
-        Eigen::Vector3f p1 = getVertex(vertexData, posOffset, stride, face.i[1]);
-        Eigen::Vector3f p2 = getVertex(vertexData, posOffset, stride, face.i[2]);
-        Eigen::Vector2f tc0 = getTexCoord(vertexData, texCoordOffset, stride, face.i[0]);
-        Eigen::Vector2f tc1 = getTexCoord(vertexData, texCoordOffset, stride, face.i[1]);
-        Eigen::Vector2f tc2 = getTexCoord(vertexData, texCoordOffset, stride, face.i[2]);
-        float s1 = tc1.x() - tc0.x();
-        float s2 = tc2.x() - tc0.x();
-        float t1 = tc1.y() - tc0.y();
-        float t2 = tc2.y() - tc0.y();
-        float a = s1 * t2 - s2 * t1;
-        if (a != 0.0f)
-            face.normal = (t2 * (p1 - p0) - t1 * (p2 - p0)) * (1.0f / a);
-        else
-            face.normal = Eigen::Vector3f::Zero();
-    }
-
-    // For each vertex, create a list of faces that contain it
-    std::uint32_t* faceCounts = new std::uint32_t[nVertices];
-    std::uint32_t** vertexFaces = new std::uint32_t*[nVertices];
-
-    // Initialize the lists
-    for (i = 0; i < nVertices; i++)
+    parallelFor(nFaces, [&](std::uint32_t first, std::uint32_t last)
     {
-        faceCounts[i] = 0;
-        vertexFaces[i] = nullptr;
-    }
+        for (std::uint32_t f = first; f < last; f++)
+        {
+            Face& face = faces[f];
+            Eigen::Vector3f p0 = getVertex(vertexData, posOffset, stride, face.i[0]);
+            Eigen::Vector3f p1 = getVertex(vertexData, posOffset, stride, face.i[1]);
+            Eigen::Vector3f p2 = getVertex(vertexData, posOffset, stride, face.i[2]);
+            Eigen::Vector2f tc0 = getTexCoord(vertexData, texCoordOffset, stride, face.i[0]);
+            Eigen::Vector2f tc1 = getTexCoord(vertexData, texCoordOffset, stride, face.i[1]);
+            Eigen::Vector2f tc2 = getTexCoord(vertexData, texCoordOffset, stride, face.i[2]);
+            float s1 = tc1.x() - tc0.x();
+            float s2 = tc2.x() - tc0.x();
+            float t1 = tc1.y() - tc0.y();
+            float t2 = tc2.y() - tc0.y();
+            float a = s1 * t2 - s2 * t1;
+            if (a != 0.0f)
+                face.normal = (t2 * (p1 - p0) - t1 * (p2 - p0)) * (1.0f / a);
+            else
+                face.normal = Eigen::Vector3f::Zero();
+        }
+    });
 
     // If we're welding vertices before generating normals, find identical
     // points and merge them.  Otherwise, the point indices will be the same
     // as the attribute indices.
     if (weld)
     {
-        joinVertices(faces, vertexData, desc,
-                     PointTexCoordOrderingPredicate(posOffset, texCoordOffset),
-                     PointTexCoordEquivalencePredicate(posOffset, texCoordOffset, 1.0e-5f));
+        weldVertices(faces, vertexData, nVertices, stride, posOffset, texCoordOffset, 1.0e-5f);
     }
     else
     {
@@ -833,48 +1323,22 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
         }
     }
 
-    // Count the number of faces in which each vertex appears
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        faceCounts[face.vi[0]]++;
-        faceCounts[face.vi[1]]++;
-        faceCounts[face.vi[2]]++;
-    }
-
-    // Allocate space for the per-vertex face lists
-    for (i = 0; i < nVertices; i++)
-    {
-        if (faceCounts[i] > 0)
-        {
-            vertexFaces[i] = new std::uint32_t[faceCounts[i] + 1];
-            vertexFaces[i][0] = faceCounts[i];
-        }
-    }
-
-    // Fill in the vertex/face lists
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        vertexFaces[face.vi[0]][faceCounts[face.vi[0]]--] = f;
-        vertexFaces[face.vi[1]][faceCounts[face.vi[1]]--] = f;
-        vertexFaces[face.vi[2]][faceCounts[face.vi[2]]--] = f;
-    }
+    // For each vertex, create a list of faces that contain it
+    VertexFaces vertexFaces = buildVertexFaces(faces, nVertices);
 
     // Compute the vertex tangents by averaging
     std::vector<Eigen::Vector3f> vertexTangents(nFaces * 3);
-    for (f = 0; f < nFaces; f++)
+    parallelFor(nFaces, [&](std::uint32_t first, std::uint32_t last)
     {
-        Face& face = faces[f];
-        for (std::uint32_t j = 0; j < 3; j++)
+        for (std::uint32_t f = first; f < last; f++)
         {
-            vertexTangents[f * 3 + j] =
-                averageFaceVectors(faces, f,
-                                   &vertexFaces[face.vi[j]][1],
-                                   vertexFaces[face.vi[j]][0],
-                                   0.0f);
+            for (std::uint32_t j = 0; j < 3; j++)
+            {
+                vertexTangents[f * 3 + j] =
+                    averageFaceVectors(faces, f, vertexFaces, faces[f].vi[j], 0.0f);
+            }
         }
-    }
+    });
 
     // Create the new vertex description
     cmod::VertexDescription newDesc = desc.clone();
@@ -962,15 +1426,6 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
         firstIndex += faceCount * 3;
     }
 
-    // Clean up
-    delete[] faceCounts;
-    for (i = 0; i < nVertices; i++)
-    {
-        if (vertexFaces[i] != nullptr)
-            delete[] vertexFaces[i];
-    }
-    delete[] vertexFaces;
-
     return newMesh;
 }
 
@@ -1040,6 +1495,132 @@ UniquifyVertices(cmod::Mesh& mesh)
 }
 
 
+/** Convert the triangle strips and fans of a mesh to lists, then reorder
+  * the triangles for the vertex cache and to reduce overdraw, and the
+  * vertices for fetch locality.
+  */
+void
+OptimizeVertexOrder(cmod::Mesh& mesh)
+{
+    for (unsigned int groupIndex = 0; groupIndex < mesh.getGroupCount(); groupIndex++)
+    {
+        cmod::PrimitiveGroup* group = mesh.getGroup(groupIndex);
+        const std::vector<cmod::Index32>& indices = group->indices;
+        std::vector<cmod::Index32> triangles;
+
+        // Strips use degenerate triangles to join their pieces, drop them
+        auto addTriangle = [&triangles](cmod::Index32 v0, cmod::Index32 v1, cmod::Index32 v2)
+        {
+            if (v0 != v1 && v1 != v2 && v2 != v0)
+                triangles.insert(triangles.end(), { v0, v1, v2 });
+        };
+
+        if (group->prim == cmod::PrimitiveGroupType::TriStrip)
+        {
+            for (std::size_t i = 0; i + 2 < indices.size(); i++)
+            {
+                if ((i & 1) == 0)
+                    addTriangle(indices[i], indices[i + 1], indices[i + 2]);
+                else
+                    addTriangle(indices[i], indices[i + 2], indices[i + 1]);
+            }
+        }
+        else if (group->prim == cmod::PrimitiveGroupType::TriFan)
+        {
+            for (std::size_t i = 1; i + 1 < indices.size(); i++)
+                addTriangle(indices[0], indices[i], indices[i + 1]);
+        }
+        else
+        {
+            continue;
+        }
+
+        group->prim = cmod::PrimitiveGroupType::TriList;
+        group->indices = std::move(triangles);
+    }
+
+    mesh.optimize();
+}
+
+
+/** Add simplified versions of a mesh as its levels of detail, replacing
+  * any it has. Each level has no more than reduction times the triangles of
+  * the previous one; fewer levels are generated when the mesh can't be
+  * simplified further. Lines and points are copied to every level.
+  *
+  * @param mesh the mesh to generate the levels of detail for
+  * @param maxLevels the largest number of levels to generate
+  * @param reduction the target triangle count ratio between levels
+  * @return false if the mesh has no float3 positions
+  */
+bool
+GenerateLevelsOfDetail(cmod::Mesh& mesh, unsigned int maxLevels, float reduction)
+{
+    MeshSimplifier simplifier(mesh);
+    if (!simplifier.build())
+        return false;
+
+    mesh.clearLevelsOfDetail();
+
+    unsigned int previousCount = simplifier.getTriangleCount();
+    for (unsigned int i = 0; i < maxLevels; i++)
+    {
+        simplifier.simplify(static_cast<unsigned int>(previousCount * reduction));
+
+        unsigned int count = simplifier.getTriangleCount();
+        if (count == 0 || count > previousCount * (1.0 - MinLevelReduction))
+            break;
+
+        mesh.addLevelOfDetail(simplifier.getLevelOfDetail());
+        previousCount = count;
+    }
+
+    return true;
+}
+
+
+/** Store the normals and tangents of a mesh as 10-bit signed normalized
+  * values and its texture coordinates as half floats, which cuts the size
+  * of a typical vertex from 44 to 24 bytes. Texture coordinates outside
+  * [-1, 1] are kept as floats, since half floats lose too much precision
+  * there for large textures.
+  */
+void
+QuantizeVertexAttributes(cmod::Mesh& mesh)
+{
+    cmod::ConvertVertexAttribute(mesh, cmod::VertexAttributeSemantic::Normal, cmod::VertexAttributeFormat::Int1010102);
+    cmod::ConvertVertexAttribute(mesh, cmod::VertexAttributeSemantic::Tangent, cmod::VertexAttributeFormat::Int1010102);
+
+    constexpr std::array texCoordSemantics
+    {
+        cmod::VertexAttributeSemantic::Texture0,
+        cmod::VertexAttributeSemantic::Texture1,
+        cmod::VertexAttributeSemantic::Texture2,
+        cmod::VertexAttributeSemantic::Texture3,
+    };
+
+    for (cmod::VertexAttributeSemantic semantic : texCoordSemantics)
+    {
+        const cmod::VertexAttribute& texCoord = mesh.getVertexDescription().getAttribute(semantic);
+        if (texCoord.format != cmod::VertexAttributeFormat::Float2)
+            continue;
+
+        const cmod::VWord* vertexData = mesh.getVertexData();
+        unsigned int stride = mesh.getVertexStrideWords();
+        bool inRange = true;
+        for (unsigned int i = 0; i < mesh.getVertexCount() && inRange; i++)
+        {
+            std::array<float, 2> uv;
+            std::memcpy(uv.data(), vertexData + i * stride + texCoord.offsetWords, sizeof(uv));
+            inRange = std::abs(uv[0]) <= 1.0f && std::abs(uv[1]) <= 1.0f;
+        }
+
+        if (inRange)
+            cmod::ConvertVertexAttribute(mesh, semantic, cmod::VertexAttributeFormat::Half2);
+    }
+}
+
+
 // Merge all meshes that share the same vertex description
 std::unique_ptr<cmod::Model>
 MergeModelMeshes(const cmod::Model& model)
@@ -32,6 +32,9 @@ namespace cmodtools
 extern cmod::Mesh GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weldTolerance = 0.0f);
 extern cmod::Mesh GenerateTangents(const cmod::Mesh& mesh, bool weld);
 extern bool UniquifyVertices(cmod::Mesh& mesh);
+extern void OptimizeVertexOrder(cmod::Mesh& mesh);
+extern bool GenerateLevelsOfDetail(cmod::Mesh& mesh, unsigned int maxLevels, float reduction);
+extern void QuantizeVertexAttributes(cmod::Mesh& mesh);
 
 // Model operations
 extern std::unique_ptr<cmod::Model> MergeModelMeshes(const cmod::Model& model);
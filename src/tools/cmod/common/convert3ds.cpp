@@ -11,11 +11,17 @@
 
 #include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include <Eigen/Core>
 
+#include <cel3ds/3dsmodel.h>
+#include <cel3ds/3dsread.h>
 #include <celmodel/material.h>
 #include <celmodel/mesh.h>
 
@@ -28,7 +34,7 @@ namespace
 {
 
 cmod::Material
-convert3dsMaterial(const M3DMaterial* material3ds, cmod::HandleGetter& handleGetter)
+convert3dsMaterial(const M3DMaterial* material3ds, const cmod::HandleGetter& handleGetter)
 {
     cmod::Material newMaterial;
 
@@ -58,15 +64,106 @@ convert3dsMaterial(const M3DMaterial* material3ds, cmod::HandleGetter& handleGet
     return newMaterial;
 }
 
-} // end unnamed namespace
+
+// Converts the meshes of a 3DS file as they are read, so that the 3DS
+// meshes never need to be held in memory all together.
+class Model3DSBuilder : public M3DSceneHandler
+{
+ public:
+    explicit Model3DSBuilder(cmod::HandleGetter _handleGetter) :
+        handleGetter(std::move(_handleGetter))
+    {
+    }
+
+    bool material(M3DMaterial&& material3ds) override;
+    bool beginObject(std::string&& name) override;
+    bool triangleMesh(M3DTriangleMesh&& mesh3ds) override;
+
+    std::unique_ptr<cmod::Model> finish();
+
+ private:
+    unsigned int getMaterialIndex(const std::string& name);
+
+    cmod::HandleGetter handleGetter;
+    std::unique_ptr<cmod::Model> model{ std::make_unique<cmod::Model>() };
+    std::string objectName;
+    // Meshes may refer to materials that are defined later in the file, so
+    // the materials are only added to the model once the file is read.
+    std::vector<cmod::Material> materials;
+    std::vector<bool> materialDefined;
+    std::map<std::string, unsigned int, std::less<>> materialIndices;
+};
+
+
+unsigned int
+Model3DSBuilder::getMaterialIndex(const std::string& name)
+{
+    if (name.empty())
+        return ~0u;
+
+    if (auto it = materialIndices.find(name); it != materialIndices.end())
+        return it->second;
+
+    // Reserve the material until its definition is read; if it never is,
+    // the default material is used.
+    auto index = static_cast<unsigned int>(materials.size());
+    materialIndices.try_emplace(name, index);
+    materials.emplace_back();
+    materialDefined.push_back(false);
+    return index;
+}
+
+
+bool
+Model3DSBuilder::material(M3DMaterial&& material3ds)
+{
+    cmod::Material newMaterial = convert3dsMaterial(&material3ds, handleGetter);
+
+    // Meshes refer to the last material with their material's name
+    std::string name = material3ds.getName();
+    auto it = materialIndices.find(name);
+    if (it != materialIndices.end() && !materialDefined[it->second])
+    {
+        materials[it->second] = std::move(newMaterial);
+        materialDefined[it->second] = true;
+        return true;
+    }
+
+    auto index = static_cast<unsigned int>(materials.size());
+    if (it == materialIndices.end())
+        materialIndices.try_emplace(std::move(name), index);
+    else
+        it->second = index;
+    materials.push_back(std::move(newMaterial));
+    materialDefined.push_back(true);
+    return true;
+}
+
+
+bool
+Model3DSBuilder::beginObject(std::string&& name)
+{
+    objectName = std::move(name);
+    return true;
+}
+
+
+std::unique_ptr<cmod::Model>
+Model3DSBuilder::finish()
+{
+    for (auto& material : materials)
+        model->addMaterial(std::move(material));
+    materials.clear();
+    return std::move(model);
+}
 
 
-void
-Convert3DSMesh(cmod::Model& model,
-               const M3DTriangleMesh& mesh3ds,
-               const M3DScene& scene,
-               std::string&& meshName)
+bool
+Model3DSBuilder::triangleMesh(M3DTriangleMesh&& mesh3ds)
 {
+    if (mesh3ds.getFaceCount() == 0)
+        return true;
+
     int nVertices = mesh3ds.getVertexCount();
     int nTexCoords = mesh3ds.getTexCoordCount();
     bool hasTexCoords = (nTexCoords >= nVertices);
@@ -114,7 +211,7 @@ Convert3DSMesh(cmod::Model& model,
     mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes)));
     mesh.setVertices(nVertices, std::move(vertices));
 
-    mesh.setName(std::move(meshName));
+    mesh.setName(std::string(objectName));
 
     if (mesh3ds.getMeshMaterialGroupCount() == 0)
     {
@@ -157,60 +254,27 @@ Convert3DSMesh(cmod::Model& model,
                 indices.push_back(v2);
             }
 
-            // Get the material index
-            unsigned int materialIndex = ~0u;
-            std::string material3dsName = matGroup->materialName;
-            if (!material3dsName.empty())
-            {
-                for (unsigned int i = 0; i < scene.getMaterialCount(); i++)
-                {
-                    const M3DMaterial* material3ds = scene.getMaterial(i);
-                    if (material3dsName == material3ds->getName())
-                    {
-                        materialIndex = i;
-                    }
-                }
-            }
-
-            mesh.addGroup(cmod::PrimitiveGroupType::TriList, materialIndex, std::move(indices));
+            mesh.addGroup(cmod::PrimitiveGroupType::TriList,
+                          getMaterialIndex(matGroup->materialName),
+                          std::move(indices));
         }
     }
 
-    model.addMesh(std::move(mesh));
+    model->addMesh(std::move(mesh));
+    return true;
 }
 
+} // end unnamed namespace
+
 
 std::unique_ptr<cmod::Model>
-Convert3DSModel(const M3DScene& scene, cmod::HandleGetter handleGetter)
+Load3DSModel(const fs::path& filename, cmod::HandleGetter handleGetter)
 {
-    auto model = std::make_unique<cmod::Model>();
-
-    // Convert materials
-    for (unsigned int i = 0; i < scene.getMaterialCount(); i++)
-    {
-        const M3DMaterial* material = scene.getMaterial(i);
-        model->addMaterial(convert3dsMaterial(material, handleGetter));
-    }
-
-    // Convert meshes
-    for (unsigned int i = 0; i < scene.getModelCount(); i++)
-    {
-        const M3DModel* model3ds = scene.getModel(i);
-        if (model3ds != nullptr)
-        {
-            for (unsigned int j = 0; j < model3ds->getTriMeshCount(); j++)
-            {
-                const M3DTriangleMesh* mesh = model3ds->getTriMesh(j);
-
-                if (mesh != nullptr && mesh->getFaceCount() > 0)
-                {
-                    Convert3DSMesh(*model, *mesh, scene, model3ds->getName());
-                }
-            }
-        }
-    }
+    Model3DSBuilder builder(std::move(handleGetter));
+    if (!Read3DSFile(filename, builder))
+        return nullptr;
 
-    return model;
+    return builder.finish();
 }
 
 } // end namespace cmodtools
@@ -12,9 +12,8 @@
 #pragma once
 
 #include <memory>
-#include <string>
 
-#include <cel3ds/3dsmodel.h>
+#include <celcompat/filesystem.h>
 #include <celmodel/model.h>
 #include <celmodel/modelfile.h>
 
@@ -22,12 +21,8 @@
 namespace cmodtools
 {
 
-extern void Convert3DSMesh(cmod::Model& model,
-                           M3DTriangleMesh& mesh3ds,
-                           const M3DScene& scene,
-                           std::string&& meshName);
-
-extern std::unique_ptr<cmod::Model> Convert3DSModel(const M3DScene& scene,
-                                                    cmod::HandleGetter handleGetter);
+// Read a 3DS file, converting each of its meshes as soon as it is read
+extern std::unique_ptr<cmod::Model> Load3DSModel(const fs::path& filename,
+                                                 cmod::HandleGetter handleGetter);
 
 }
@@ -17,7 +17,14 @@
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <ctime>
+#include <limits>
+
+#include <celcompat/bit.h>
+#include <celephem/xyzvbinary.h>
 
 #ifndef min
 #define min(a, b) ((a) < (b) ? (a) : (b))
@@ -60,6 +67,11 @@ public:
     double minStepSize;
     double maxStepSize;
     double tolerance;
+
+    // The time span is split into segmentCount equal parts, and only
+    // part segmentIndex is sampled.
+    int segmentIndex{ 0 };
+    int segmentCount{ 1 };
 };
 
 
@@ -233,8 +245,61 @@ string etToString(double et)
 }
 
 
-void printRecord(ostream& out, double et, const StateVector& state)
+// Writes the sampled states either as ASCII xyzv records or directly in
+// the binary format read by Celestia. Records are written as they are
+// produced; only the binary record count is filled in at the end.
+class RecordWriter
+{
+public:
+    RecordWriter(ostream& _out, bool _binary) : out(_out), binary(_binary) {}
+
+    void writeHeader();
+    void write(double et, const StateVector& state);
+    bool finish();
+
+private:
+    ostream& out;
+    bool binary;
+    uint64_t count{ 0 };
+};
+
+
+void RecordWriter::writeHeader()
+{
+    if (!binary)
+        return;
+
+    using celestia::ephem::XYZVBinaryHeader;
+    using celestia::ephem::XYZV_MAGIC;
+
+    char header[sizeof(XYZVBinaryHeader)] = {};
+    auto byteOrder = static_cast<decltype(XYZVBinaryHeader::byteOrder)>(celestia::compat::endian::native);
+    auto digits = static_cast<decltype(XYZVBinaryHeader::digits)>(numeric_limits<double>::digits);
+    memcpy(header + offsetof(XYZVBinaryHeader, magic), XYZV_MAGIC.data(), XYZV_MAGIC.size());
+    memcpy(header + offsetof(XYZVBinaryHeader, byteOrder), &byteOrder, sizeof(byteOrder));
+    memcpy(header + offsetof(XYZVBinaryHeader, digits), &digits, sizeof(digits));
+
+    // The count is written by finish()
+    out.write(header, sizeof(header));
+}
+
+
+void RecordWriter::write(double et, const StateVector& state)
 {
+    count++;
+
+    if (binary)
+    {
+        const double values[7] =
+        {
+            et2jd(et),
+            state.position.x, state.position.y, state.position.z,
+            state.velocity.x, state.velocity.y, state.velocity.z,
+        };
+        out.write(reinterpret_cast<const char*>(values), sizeof(values));
+        return;
+    }
+
     // < 1 second error around J2000
     out << setprecision(12) << et2jd(et) << " ";
 
@@ -242,7 +307,22 @@ void printRecord(ostream& out, double et, const StateVector& state)
     out << setprecision(12) << state.position << " ";
 
     // < 0.1 mm/s error at 10 km/s
-    out << setprecision(8) << state.velocity << endl;
+    out << setprecision(8) << state.velocity << '\n';
+}
+
+
+bool RecordWriter::finish()
+{
+    if (binary)
+    {
+        using celestia::ephem::XYZVBinaryHeader;
+        out.seekp(offsetof(XYZVBinaryHeader, count));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.seekp(0, ios::end);
+    }
+
+    out.flush();
+    return out.good();
 }
 
 
@@ -339,7 +419,7 @@ void writeCommentHeader(const Configuration& config,
 
 
 bool convertSpkToXyzv(const Configuration& config,
-                      ostream& out)
+                      RecordWriter& out)
 {
     // Load the required SPICE kernels
     for (vector<string>::const_iterator iter = config.kernelList.begin();
@@ -355,6 +435,15 @@ bool convertSpkToXyzv(const Configuration& config,
     str2et_c(config.startDate.c_str(), &startET);
     str2et_c(config.endDate.c_str(),   &endET);
 
+    if (config.segmentCount > 1)
+    {
+        double span = (endET - startET) / config.segmentCount;
+        double segmentStart = startET + span * config.segmentIndex;
+        if (config.segmentIndex < config.segmentCount - 1)
+            endET = segmentStart + span;
+        startET = segmentStart;
+    }
+
     SpiceInt observerID = 0;
     SpiceInt targetID = 0;
     if (!bodyNameToId(config.observerName, &observerID))
@@ -379,7 +468,9 @@ bool convertSpkToXyzv(const Configuration& config,
     StateVector lastState = getStateVector(targetID, startET, config.frameName, observerID);
     double et = startET;
 
-    printRecord(out, et, lastState);
+    // The first state of a segment is the last state of the one before
+    if (config.segmentIndex == 0)
+        out.write(et, lastState);
 
     while (t < endET)
     {
@@ -422,34 +513,37 @@ bool convertSpkToXyzv(const Configuration& config,
         }
         else
         {
-            // Error is less than the tolerance; increase the step size until
-            // the tolerance is just exceeded.
-            while (positionError < tolerance && dt < maxStepSize)
+            // Error is less than the tolerance; increase the step size while
+            // the interpolation error stays within the tolerance.
+            while (dt < maxStepSize)
             {
-                dt *= stepFactor;
-                dt = min(maxStepSize, dt);
+                double nextDt = min(maxStepSize, dt * stepFactor);
 
-                s1 = getStateVector(targetID, t + dt, config.frameName, observerID);
+                StateVector next = getStateVector(targetID, t + nextDt, config.frameName, observerID);
 
-                tmid = t + dt / 2.0;
+                tmid = t + nextDt / 2.0;
                 Vec3d pTest = getStateVector(targetID, tmid, config.frameName, observerID).position;
                 pInterp = cubicInterpolate(lastState.position,
-                                           lastState.velocity * dt,
-                                           s1.position,
-                                           s1.velocity * dt,
+                                           lastState.velocity * nextDt,
+                                           next.position,
+                                           next.velocity * nextDt,
                                            0.5);
 
-                positionError = (pInterp - pTest).length();
+                if ((pInterp - pTest).length() > tolerance)
+                    break;
+
+                dt = nextDt;
+                s1 = next;
             }
         }
 
         t = t + dt;
         lastState = s1;
 
-        printRecord(out, t, lastState);
+        out.write(t, lastState);
     }
 
-    return true;
+    return out.finish();
 }
 
 
@@ -524,16 +618,66 @@ bool readConfig(istream& in, Configuration& config)
 }
 
 
+void usage()
+{
+    cerr << "Usage: spice2xyzv [options] <config filename> [output filename]\n";
+    cerr << "   --binary (or -b)       : write a binary xyzv file (requires an output filename)\n";
+    cerr << "   --segment <index>/<count> (or -s)\n";
+    cerr << "           sample only one of count equal parts of the time span\n";
+}
+
+
 int main(int argc, char* argv[])
 {
-    if (argc < 2)
+    const char* configFilename = nullptr;
+    const char* outputFilename = nullptr;
+    bool binary = false;
+    int segmentIndex = 0;
+    int segmentCount = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-b") || !strcmp(argv[i], "--binary"))
+        {
+            binary = true;
+        }
+        else if (!strcmp(argv[i], "-s") || !strcmp(argv[i], "--segment"))
+        {
+            if (i == argc - 1 ||
+                sscanf(argv[i + 1], "%d/%d", &segmentIndex, &segmentCount) != 2 ||
+                segmentCount < 1 || segmentIndex < 0 || segmentIndex >= segmentCount)
+            {
+                usage();
+                return 1;
+            }
+            i++;
+        }
+        else if (configFilename == nullptr)
+        {
+            configFilename = argv[i];
+        }
+        else if (outputFilename == nullptr)
+        {
+            outputFilename = argv[i];
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    // Binary files have a header with a record count, so they can't be
+    // streamed to standard output or concatenated from segments.
+    if (configFilename == nullptr ||
+        (binary && (outputFilename == nullptr || segmentCount > 1)))
     {
-        cerr << "Usage: spice2xyzv <config filename> [output filename]\n";
+        usage();
         return 1;
     }
 
 
-    ifstream configFile(argv[1]);
+    ifstream configFile(configFilename);
     if (!configFile)
     {
         cerr << "Error opening configuration file.\n";
@@ -548,6 +692,9 @@ int main(int argc, char* argv[])
         return 1;
     }
 
+    config.segmentIndex = segmentIndex;
+    config.segmentCount = segmentCount;
+
     // Check that all required parameters are present.
     if (config.startDate.empty())
     {
@@ -586,8 +733,30 @@ int main(int argc, char* argv[])
     furnsh_c(CONFIG_DATA_DIR "/" "naif0012.tls");
 #endif
 
-    writeCommentHeader(config, cout);
-    convertSpkToXyzv(config, cout);
+    ofstream outputFile;
+    if (outputFilename != nullptr)
+    {
+        outputFile.open(outputFilename, binary ? ios::out | ios::binary : ios::out);
+        if (!outputFile)
+        {
+            cerr << "Error opening output file " << outputFilename << ".\n";
+            return 1;
+        }
+    }
+
+    ostream& out = outputFilename != nullptr ? outputFile : cout;
+
+    // Later segments are appended to the first, so only it gets comments
+    if (!binary && segmentIndex == 0)
+        writeCommentHeader(config, out);
+
+    RecordWriter writer(out, binary);
+    writer.writeHeader();
+    if (!convertSpkToXyzv(config, writer))
+    {
+        cerr << "Error writing output.\n";
+        return 1;
+    }
 
     return 0;
 }
@@ -0,0 +1,657 @@
+// makegaiastardb.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Build a Celestia star database from a Gaia CSV export that is too large to
+// hold in memory. The input is read in chunks which are parsed on worker
+// threads, cross-matched to HIP and TYC catalog numbers, sorted and written
+// to temporary run files. The runs are then merged into the star database.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <celastro/astro.h>
+#include <celcompat/charconv.h>
+#include <celcompat/filesystem.h>
+#include <celengine/stardbbuilder.h>
+#include <celengine/starname.h>
+#include <celengine/stellarclass.h>
+#include <celutil/bytes.h>
+
+namespace astro = celestia::astro;
+namespace compat = celestia::compat;
+
+namespace
+{
+
+std::string inputFilename;
+std::string outputFilename;
+std::string hipFilename;
+std::string tycFilename;
+bool useMotion = false;
+bool writeSorted = false;
+std::size_t chunkRows = 1000000;
+unsigned int threadCount = 0;
+
+// Star record as stored in the temporary run files
+struct GaiaStar
+{
+    std::uint32_t catalogNumber;
+    float x;
+    float y;
+    float z;
+    float absMag;
+    std::uint16_t spectralType;
+    float pmRA;
+    float pmDec;
+    float radialVelocity;
+};
+
+// Runs are sorted by catalog number; of several Gaia sources matched to the
+// same star the brightest one is kept.
+bool
+operator<(const GaiaStar& a, const GaiaStar& b)
+{
+    return a.catalogNumber != b.catalogNumber
+        ? a.catalogNumber < b.catalogNumber
+        : a.absMag < b.absMag;
+}
+
+struct Columns
+{
+    int sourceId{ -1 };
+    int ra{ -1 };
+    int dec{ -1 };
+    int parallax{ -1 };
+    int gMag{ -1 };
+    int bpRp{ -1 };
+    int pmRA{ -1 };
+    int pmDec{ -1 };
+    int radialVelocity{ -1 };
+};
+
+using CrossIndex = std::unordered_map<std::uint64_t, std::uint32_t>;
+
+
+void
+Usage()
+{
+    fmt::print(stderr, "Usage: makegaiastardb [options] <Gaia CSV file> <output star database>\n"
+                       "  Options:\n"
+                       "    --hip <file> : CSV file of Gaia source_id,HIP number pairs\n"
+                       "    --tyc <file> : CSV file of Gaia source_id,TYC1-TYC2-TYC3 pairs\n"
+                       "    --motion (or -m) : store the proper motions and radial velocities\n"
+                       "    --sorted (or -s) : write the presorted version 2 format\n"
+                       "    --chunk <rows> : number of input rows sorted in memory at once\n"
+                       "    --threads <count> : number of parser threads (default is one per core)\n");
+}
+
+
+bool
+parseCommandLine(int argc, char* argv[])
+{
+    int fileCount = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] == '-')
+        {
+            if (!std::strcmp(argv[i], "--motion") || !std::strcmp(argv[i], "-m"))
+            {
+                useMotion = true;
+            }
+            else if (!std::strcmp(argv[i], "--sorted") || !std::strcmp(argv[i], "-s"))
+            {
+                writeSorted = true;
+            }
+            else if (i + 1 < argc && !std::strcmp(argv[i], "--hip"))
+            {
+                hipFilename = argv[++i];
+            }
+            else if (i + 1 < argc && !std::strcmp(argv[i], "--tyc"))
+            {
+                tycFilename = argv[++i];
+            }
+            else if (i + 1 < argc && !std::strcmp(argv[i], "--chunk"))
+            {
+                if (std::sscanf(argv[++i], " %zu", &chunkRows) != 1 || chunkRows == 0)
+                    return false;
+            }
+            else if (i + 1 < argc && !std::strcmp(argv[i], "--threads"))
+            {
+                if (std::sscanf(argv[++i], " %u", &threadCount) != 1)
+                    return false;
+            }
+            else
+            {
+                fmt::print(stderr, "Unknown command line switch: {}\n", argv[i]);
+                return false;
+            }
+        }
+        else if (fileCount == 0)
+        {
+            inputFilename = argv[i];
+            fileCount++;
+        }
+        else if (fileCount == 1)
+        {
+            outputFilename = argv[i];
+            fileCount++;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return fileCount == 2;
+}
+
+
+// Split a CSV line into fields; Gaia exports don't quote numeric columns.
+void
+splitFields(std::string_view line, std::vector<std::string_view>& fields)
+{
+    fields.clear();
+    for (;;)
+    {
+        auto pos = line.find(',');
+        fields.push_back(line.substr(0, pos));
+        if (pos == std::string_view::npos)
+            break;
+        line.remove_prefix(pos + 1);
+    }
+
+    if (!fields.empty() && !fields.back().empty() && fields.back().back() == '\r')
+        fields.back().remove_suffix(1);
+}
+
+
+template<typename T> std::optional<T>
+parseField(const std::vector<std::string_view>& fields, int column)
+{
+    if (column < 0 || static_cast<std::size_t>(column) >= fields.size())
+        return std::nullopt;
+
+    std::string_view field = fields[column];
+    T value;
+    if (field.empty() ||
+        compat::from_chars(field.data(), field.data() + field.size(), value).ec != std::errc{})
+    {
+        return std::nullopt;
+    }
+
+    return value;
+}
+
+
+// Map a TYC1-TYC2-TYC3 designation to a Celestia catalog number
+std::optional<std::uint32_t>
+parseTycho(std::string_view field)
+{
+    std::uint32_t tyc[3];
+    for (int i = 0; i < 3; i++)
+    {
+        auto result = compat::from_chars(field.data(), field.data() + field.size(), tyc[i]);
+        if (result.ec != std::errc{})
+            return std::nullopt;
+        field.remove_prefix(static_cast<std::size_t>(result.ptr - field.data()));
+        if (i < 2)
+        {
+            if (field.empty() || field.front() != '-')
+                return std::nullopt;
+            field.remove_prefix(1);
+        }
+    }
+
+    return tyc[0]
+         + tyc[1] * StarNameDatabase::TYC2_MULTIPLIER
+         + tyc[2] * StarNameDatabase::TYC3_MULTIPLIER;
+}
+
+
+// The cross indices hold one entry per HIP or TYC star, so unlike the Gaia
+// catalog itself they fit in memory.
+bool
+loadCrossIndex(const std::string& filename, bool tycho, CrossIndex& index)
+{
+    std::ifstream in(filename);
+    if (!in.good())
+    {
+        fmt::print(stderr, "Error opening cross index {}\n", filename);
+        return false;
+    }
+
+    std::string line;
+    std::vector<std::string_view> fields;
+    while (std::getline(in, line))
+    {
+        splitFields(line, fields);
+        auto sourceId = parseField<std::uint64_t>(fields, 0);
+        // Skip the header and malformed lines
+        if (!sourceId.has_value() || fields.size() < 2)
+            continue;
+
+        std::optional<std::uint32_t> catalogNumber = tycho
+            ? parseTycho(fields[1])
+            : parseField<std::uint32_t>(fields, 1);
+        if (catalogNumber.has_value())
+            index[*sourceId] = *catalogNumber;
+    }
+
+    return true;
+}
+
+
+bool
+parseHeader(const std::string& line, Columns& columns)
+{
+    std::vector<std::string_view> fields;
+    splitFields(line, fields);
+    for (std::size_t i = 0; i < fields.size(); i++)
+    {
+        auto column = static_cast<int>(i);
+        if (fields[i] == "source_id")
+            columns.sourceId = column;
+        else if (fields[i] == "ra")
+            columns.ra = column;
+        else if (fields[i] == "dec")
+            columns.dec = column;
+        else if (fields[i] == "parallax")
+            columns.parallax = column;
+        else if (fields[i] == "phot_g_mean_mag")
+            columns.gMag = column;
+        else if (fields[i] == "bp_rp")
+            columns.bpRp = column;
+        else if (fields[i] == "pmra")
+            columns.pmRA = column;
+        else if (fields[i] == "pmdec")
+            columns.pmDec = column;
+        else if (fields[i] == "radial_velocity")
+            columns.radialVelocity = column;
+    }
+
+    return columns.sourceId >= 0 && columns.ra >= 0 && columns.dec >= 0 &&
+           columns.parallax >= 0 && columns.gMag >= 0;
+}
+
+
+// Approximate main sequence spectral type from the BP-RP color index
+std::uint16_t
+spectralTypeFromColor(std::optional<float> bpRp)
+{
+    struct ColorClass
+    {
+        float maxBpRp;
+        const char* spectralType;
+    };
+
+    static const ColorClass colorClasses[] =
+    {
+        { -0.25f, "B0" }, { -0.10f, "B5" }, { 0.05f, "A0" }, { 0.25f, "A5" },
+        { 0.45f, "F0" },  { 0.65f, "F5" },  { 0.80f, "G0" }, { 0.95f, "G5" },
+        { 1.15f, "K0" },  { 1.60f, "K5" },  { 2.20f, "M0" },
+        { std::numeric_limits<float>::max(), "M5" },
+    };
+
+    if (!bpRp.has_value())
+        return StellarClass::parse("?").packV1();
+
+    auto it = std::find_if(std::begin(colorClasses), std::end(colorClasses),
+                           [&](const ColorClass& c) { return *bpRp < c.maxBpRp; });
+    return StellarClass::parse(it->spectralType).packV1();
+}
+
+
+std::optional<GaiaStar>
+parseStar(std::string_view line, const Columns& columns, const CrossIndex& crossIndex,
+          std::vector<std::string_view>& fields)
+{
+    splitFields(line, fields);
+
+    auto sourceId = parseField<std::uint64_t>(fields, columns.sourceId);
+    if (!sourceId.has_value())
+        return std::nullopt;
+
+    auto match = crossIndex.find(*sourceId);
+    if (match == crossIndex.end())
+        return std::nullopt;
+
+    auto ra = parseField<double>(fields, columns.ra);
+    auto dec = parseField<double>(fields, columns.dec);
+    auto parallax = parseField<double>(fields, columns.parallax);
+    auto gMag = parseField<float>(fields, columns.gMag);
+    if (!ra.has_value() || !dec.has_value() || !parallax.has_value() ||
+        !gMag.has_value() || *parallax <= 0.0)
+    {
+        return std::nullopt;
+    }
+
+    // Parallax is in milliarcseconds
+    double distance = astro::parsecsToLightYears(1000.0 / *parallax);
+    Eigen::Vector3d pos = astro::equatorialToCelestialCart(*ra * 24.0 / 360.0, *dec, distance);
+
+    GaiaStar star;
+    star.catalogNumber = match->second;
+    star.x = static_cast<float>(pos.x());
+    star.y = static_cast<float>(pos.y());
+    star.z = static_cast<float>(pos.z());
+    // The G band is close enough to V for display purposes
+    star.absMag = static_cast<float>(*gMag + 5.0 + 5.0 * std::log10(*parallax / 1000.0));
+    star.spectralType = spectralTypeFromColor(parseField<float>(fields, columns.bpRp));
+    star.pmRA = parseField<float>(fields, columns.pmRA).value_or(0.0f);
+    star.pmDec = parseField<float>(fields, columns.pmDec).value_or(0.0f);
+    star.radialVelocity = parseField<float>(fields, columns.radialVelocity).value_or(0.0f);
+
+    return star;
+}
+
+
+// Parse one chunk of lines on the worker threads, then sort the matched
+// stars and write them to a run file.
+bool
+writeRun(const std::vector<std::string>& lines,
+         const Columns& columns,
+         const CrossIndex& crossIndex,
+         unsigned int nThreads,
+         const fs::path& runPath,
+         std::vector<GaiaStar>& stars)
+{
+    std::vector<std::vector<GaiaStar>> parsed(nThreads);
+    std::atomic<std::size_t> next{ 0 };
+    constexpr std::size_t batchSize = 4096;
+
+    auto worker = [&](unsigned int threadIndex)
+    {
+        std::vector<std::string_view> fields;
+        for (;;)
+        {
+            std::size_t first = next.fetch_add(batchSize, std::memory_order_relaxed);
+            if (first >= lines.size())
+                break;
+
+            std::size_t last = std::min(first + batchSize, lines.size());
+            for (std::size_t i = first; i < last; i++)
+            {
+                if (auto star = parseStar(lines[i], columns, crossIndex, fields); star.has_value())
+                    parsed[threadIndex].push_back(*star);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < nThreads; i++)
+        threads.emplace_back(worker, i);
+    worker(0);
+    for (auto& t : threads)
+        t.join();
+
+    stars.clear();
+    for (const auto& p : parsed)
+        stars.insert(stars.end(), p.begin(), p.end());
+    std::sort(stars.begin(), stars.end());
+
+    std::ofstream out(runPath, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(stars.data()),
+              static_cast<std::streamsize>(stars.size() * sizeof(GaiaStar)));
+    return out.good();
+}
+
+
+void
+writeUint(std::ostream& out, std::uint32_t n)
+{
+    LE_TO_CPU_INT32(n, n);
+    out.write(reinterpret_cast<const char*>(&n), sizeof n);
+}
+
+void
+writeFloat(std::ostream& out, float f)
+{
+    LE_TO_CPU_FLOAT(f, f);
+    out.write(reinterpret_cast<const char*>(&f), sizeof f);
+}
+
+void
+writeShort(std::ostream& out, std::int16_t n)
+{
+    LE_TO_CPU_INT16(n, n);
+    out.write(reinterpret_cast<const char*>(&n), sizeof n);
+}
+
+void
+writeUshort(std::ostream& out, std::uint16_t n)
+{
+    LE_TO_CPU_INT16(n, n);
+    out.write(reinterpret_cast<const char*>(&n), sizeof n);
+}
+
+
+// Merge the sorted runs into a version 1 star database. Motions are spooled
+// to a separate file because they follow the star records.
+bool
+mergeRuns(const std::vector<fs::path>& runPaths,
+          const fs::path& motionPath,
+          std::ostream& out)
+{
+    struct RunReader
+    {
+        std::ifstream in;
+        GaiaStar star;
+
+        bool advance()
+        {
+            return static_cast<bool>(in.read(reinterpret_cast<char*>(&star), sizeof star));
+        }
+    };
+
+    std::vector<RunReader> readers(runPaths.size());
+    auto compare = [&](std::size_t a, std::size_t b) { return readers[b].star < readers[a].star; };
+    std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(compare)> heap(compare);
+
+    for (std::size_t i = 0; i < runPaths.size(); i++)
+    {
+        readers[i].in.open(runPaths[i], std::ios::binary);
+        if (readers[i].advance())
+            heap.push(i);
+    }
+
+    out.write("CELSTARS", 8);
+    writeShort(out, useMotion ? 0x0101 : 0x0100);
+    auto countPos = out.tellp();
+    writeUint(out, 0);
+
+    std::ofstream motionOut;
+    if (useMotion)
+        motionOut.open(motionPath, std::ios::binary);
+
+    std::uint32_t nStars = 0;
+    std::uint32_t nMotions = 0;
+    std::optional<std::uint32_t> lastCatalogNumber;
+    while (!heap.empty())
+    {
+        std::size_t i = heap.top();
+        heap.pop();
+
+        const GaiaStar& star = readers[i].star;
+        if (star.catalogNumber != lastCatalogNumber)
+        {
+            lastCatalogNumber = star.catalogNumber;
+            writeUint(out, star.catalogNumber);
+            writeFloat(out, star.x);
+            writeFloat(out, star.y);
+            writeFloat(out, star.z);
+            writeShort(out, static_cast<std::int16_t>(star.absMag * 256.0f));
+            writeUshort(out, star.spectralType);
+            nStars++;
+
+            if (useMotion && (star.pmRA != 0.0f || star.pmDec != 0.0f || star.radialVelocity != 0.0f))
+            {
+                writeUint(motionOut, star.catalogNumber);
+                writeFloat(motionOut, star.pmRA);
+                writeFloat(motionOut, star.pmDec);
+                writeFloat(motionOut, star.radialVelocity);
+                nMotions++;
+            }
+        }
+
+        if (readers[i].advance())
+            heap.push(i);
+    }
+
+    if (useMotion)
+    {
+        motionOut.close();
+        writeUint(out, nMotions);
+        std::ifstream motionIn(motionPath, std::ios::binary);
+        if (nMotions > 0)
+            out << motionIn.rdbuf();
+    }
+
+    out.seekp(countPos);
+    writeUint(out, nStars);
+    out.seekp(0, std::ios::end);
+
+    fmt::print(stderr, "Wrote {} stars, {} with motion\n", nStars, nMotions);
+    return out.good();
+}
+
+} // end unnamed namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    CrossIndex crossIndex;
+    // Load TYC first so that HIP numbers take precedence
+    if (!tycFilename.empty() && !loadCrossIndex(tycFilename, true, crossIndex))
+        return 1;
+    if (!hipFilename.empty() && !loadCrossIndex(hipFilename, false, crossIndex))
+        return 1;
+    if (crossIndex.empty())
+    {
+        fmt::print(stderr, "No HIP or TYC cross-matches; nothing to write\n");
+        return 1;
+    }
+
+    std::ifstream in(inputFilename);
+    if (!in.good())
+    {
+        fmt::print(stderr, "Error opening {}\n", inputFilename);
+        return 1;
+    }
+
+    std::string line;
+    Columns columns;
+    if (!std::getline(in, line) || !parseHeader(line, columns))
+    {
+        fmt::print(stderr, "{} lacks the source_id, ra, dec, parallax or phot_g_mean_mag column\n",
+                   inputFilename);
+        return 1;
+    }
+
+    unsigned int nThreads = threadCount > 0
+        ? threadCount
+        : std::max(1u, std::thread::hardware_concurrency());
+
+    fs::path outputPath(outputFilename);
+    auto tempPath = [&](std::string_view suffix)
+    {
+        fs::path path = outputPath;
+        path += suffix;
+        return path;
+    };
+
+    std::vector<fs::path> runPaths;
+    std::vector<std::string> lines;
+    std::vector<GaiaStar> stars;
+    std::uint64_t nRows = 0;
+    bool success = true;
+    for (bool eof = false; !eof && success;)
+    {
+        lines.clear();
+        while (lines.size() < chunkRows && std::getline(in, line))
+            lines.push_back(std::move(line));
+        eof = lines.size() < chunkRows;
+        if (lines.empty())
+            break;
+
+        nRows += lines.size();
+        fs::path runPath = tempPath(fmt::format(".run{}", runPaths.size()));
+        success = writeRun(lines, columns, crossIndex, nThreads, runPath, stars);
+        runPaths.push_back(runPath);
+        fmt::print(stderr, "Read {} rows\n", nRows);
+    }
+
+    // Free the chunk buffers before merging
+    std::vector<std::string>().swap(lines);
+    std::vector<GaiaStar>().swap(stars);
+
+    fs::path motionPath = tempPath(".motion");
+    if (success)
+    {
+        if (writeSorted)
+        {
+            // The presorted format is built in memory, but only from the
+            // cross-matched stars rather than the whole input.
+            fs::path unsortedPath = tempPath(".unsorted");
+            {
+                std::ofstream unsorted(unsortedPath, std::ios::binary);
+                success = mergeRuns(runPaths, motionPath, unsorted);
+            }
+
+            std::ifstream unsorted(unsortedPath, std::ios::binary);
+            std::ofstream out(outputPath, std::ios::binary);
+            success = success && StarDatabaseBuilder::writeSortedBinary(unsorted, out);
+            unsorted.close();
+
+            std::error_code ec;
+            fs::remove(unsortedPath, ec);
+        }
+        else
+        {
+            std::ofstream out(outputPath, std::ios::binary);
+            success = mergeRuns(runPaths, motionPath, out);
+        }
+    }
+
+    std::error_code ec;
+    for (const auto& runPath : runPaths)
+        fs::remove(runPath, ec);
+    fs::remove(motionPath, ec);
+
+    if (!success)
+    {
+        fmt::print(stderr, "Error writing star database {}\n", outputFilename);
+        return 1;
+    }
+
+    return 0;
+}
@@ -14,6 +14,7 @@
 #include <iomanip>
 #include <cctype>
 #include <cassert>
+#include <vector>
 #include <celastro/astro.h>
 #include <celutil/bytes.h>
 #include <celengine/star.h>
@@ -25,6 +26,7 @@ namespace astro = celestia::astro;
 static string inputFilename;
 static string outputFilename;
 static bool useSphericalCoords = false;
+static bool useMotion = false;
 
 
 void Usage()
@@ -32,6 +34,8 @@ void Usage()
     cerr << "Usage: makestardb [options] <input file> <output star database>\n";
     cerr << "  Options:\n";
     cerr << "    --spherical (or -s) : input file has spherical coords (RA/dec/distance\n";
+    cerr << "    --motion (or -m) : records end with the proper motion in RA and dec (mas/yr)\n";
+    cerr << "                       and the radial velocity (km/s)\n";
 }
 
 
@@ -48,6 +52,10 @@ bool parseCommandLine(int argc, char* argv[])
             {
                 useSphericalCoords = true;
             }
+            else if (!strcmp(argv[i], "--motion") || !strcmp(argv[i], "-m"))
+            {
+                useMotion = true;
+            }
             else
             {
                 cerr << "Unknown command line switch: " << argv[i] << '\n';
@@ -107,7 +115,16 @@ static void writeShort(ostream& out, int16_t n)
 }
 
 
-bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
+struct StarMotion
+{
+    uint32_t catalogNumber;
+    float pmRA;
+    float pmDec;
+    float radialVelocity;
+};
+
+
+bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords, bool motion)
 {
     unsigned int nStarsInFile = 0;
 
@@ -122,10 +139,12 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
     out.write("CELSTARS", 8);
 
     // Write the version
-    writeShort(out, 0x0100);
+    writeShort(out, motion ? 0x0101 : 0x0100);
 
     writeUint(out, nStarsInFile);
 
+    vector<StarMotion> motions;
+
     for (unsigned int record = 0; record < nStarsInFile; record++)
     {
         unsigned int catalogNumber;
@@ -134,7 +153,7 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
 
         in >> catalogNumber;
         if (in.eof())
-            return true;
+            break;
 
         if (!in.good())
         {
@@ -202,6 +221,20 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
         cout << scString << ' ' << details->getSpectralType() << '\n';
 #endif
 
+        if (motion)
+        {
+            StarMotion m{ catalogNumber, 0.0f, 0.0f, 0.0f };
+            in >> m.pmRA >> m.pmDec >> m.radialVelocity;
+            if (!in.good())
+            {
+                cerr << "Error parsing motion of star " << catalogNumber << '\n';
+                return false;
+            }
+
+            if (m.pmRA != 0.0f || m.pmDec != 0.0f || m.radialVelocity != 0.0f)
+                motions.push_back(m);
+        }
+
         writeUint(out, catalogNumber);
         writeFloat(out, x);
         writeFloat(out, y);
@@ -210,6 +243,19 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
         writeUshort(out, sc.packV1());
     }
 
+    // Stars without a motion record don't move
+    if (motion)
+    {
+        writeUint(out, (uint32_t) motions.size());
+        for (const StarMotion& m : motions)
+        {
+            writeUint(out, m.catalogNumber);
+            writeFloat(out, m.pmRA);
+            writeFloat(out, m.pmDec);
+            writeFloat(out, m.radialVelocity);
+        }
+    }
+
     return true;
 }
 
@@ -236,7 +282,7 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    bool success = WriteStarDatabase(inputFile, stardbFile, useSphericalCoords);
+    bool success = WriteStarDatabase(inputFile, stardbFile, useSphericalCoords, useMotion);
 
     return success ? 0 : 1;
 }
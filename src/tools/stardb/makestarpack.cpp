@@ -0,0 +1,91 @@
+// makestarpack.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Bundle the star names, cross indices, asterisms and constellation
+// boundaries into a star data pack, which Celestia reads without parsing.
+
+#include <cstdio>
+#include <string_view>
+
+#include <fmt/format.h>
+
+#include <celengine/starpack.h>
+#include <celutil/logger.h>
+
+using celestia::engine::StarDataPack;
+using celestia::util::CreateLogger;
+
+namespace
+{
+
+void
+usage(const char* program)
+{
+    fmt::print(stderr,
+               "Usage: {} [options] <output file>\n"
+               "  --names <file>       star names (starnames.dat)\n"
+               "  --hd <file>          HD cross index (hdxindex.dat)\n"
+               "  --sao <file>         SAO cross index (saoxindex.dat)\n"
+               "  --asterisms <file>   asterisms (asterisms.dat)\n"
+               "  --boundaries <file>  constellation boundaries (boundaries.dat)\n",
+               program);
+}
+
+} // end unnamed namespace
+
+int main(int argc, char* argv[])
+{
+    CreateLogger();
+
+    StarDataPack::Sources sources;
+    fs::path outputFile;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        fs::path* source = nullptr;
+        if (arg == "--names")
+            source = &sources.starNames;
+        else if (arg == "--hd")
+            source = &sources.hdCrossIndex;
+        else if (arg == "--sao")
+            source = &sources.saoCrossIndex;
+        else if (arg == "--asterisms")
+            source = &sources.asterisms;
+        else if (arg == "--boundaries")
+            source = &sources.boundaries;
+
+        if (source != nullptr && i + 1 < argc)
+        {
+            *source = argv[++i];
+        }
+        else if (source == nullptr && !arg.empty() && arg.front() != '-' && outputFile.empty())
+        {
+            outputFile = arg;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (outputFile.empty())
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!StarDataPack::write(outputFile, sources))
+    {
+        fmt::print(stderr, "Error writing {}\n", outputFile.string());
+        return 1;
+    }
+
+    return 0;
+}
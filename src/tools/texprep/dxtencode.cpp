@@ -0,0 +1,213 @@
+// dxtencode.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// DXT1/DXT5 block compression for texprep.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "dxtencode.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+#include <celutil/threadpool.h>
+
+namespace celestia::texprep
+{
+namespace
+{
+
+using Block = std::array<std::uint8_t, 64>;
+
+// Expands a 565 color the same way as the DXTc decoder
+std::array<int, 3>
+expand565(std::uint16_t color)
+{
+    int r = (color >> 11) * 255 + 16;
+    int g = ((color >> 5) & 0x3f) * 255 + 32;
+    int b = (color & 0x1f) * 255 + 16;
+    return { (r / 32 + r) / 32, (g / 64 + g) / 64, (b / 32 + b) / 32 };
+}
+
+std::uint16_t
+pack565(int r, int g, int b)
+{
+    return static_cast<std::uint16_t>(((r * 31 + 127) / 255) << 11 |
+                                      ((g * 63 + 127) / 255) << 5 |
+                                      ((b * 31 + 127) / 255));
+}
+
+void
+writeLE16(std::uint8_t* out, std::uint16_t value)
+{
+    out[0] = static_cast<std::uint8_t>(value);
+    out[1] = static_cast<std::uint8_t>(value >> 8);
+}
+
+// Uses the bounding box of the block's colors, inset by 1/16 of its size to
+// reduce the influence of outliers, as the endpoints.
+void
+compressColors(const Block& block, std::uint8_t* out)
+{
+    std::array<int, 3> lo{ 255, 255, 255 };
+    std::array<int, 3> hi{ 0, 0, 0 };
+    for (std::size_t i = 0; i < 16; ++i)
+    {
+        for (std::size_t c = 0; c < 3; ++c)
+        {
+            lo[c] = std::min(lo[c], static_cast<int>(block[i * 4 + c]));
+            hi[c] = std::max(hi[c], static_cast<int>(block[i * 4 + c]));
+        }
+    }
+
+    for (std::size_t c = 0; c < 3; ++c)
+    {
+        int inset = (hi[c] - lo[c]) >> 4;
+        lo[c] += inset;
+        hi[c] -= inset;
+    }
+
+    std::uint16_t color0 = pack565(hi[0], hi[1], hi[2]);
+    std::uint16_t color1 = pack565(lo[0], lo[1], lo[2]);
+
+    // Four color mode needs color0 > color1
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    writeLE16(out, color0);
+    writeLE16(out + 2, color1);
+
+    std::uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        auto c0 = expand565(color0);
+        auto c1 = expand565(color1);
+        std::array<std::array<int, 3>, 4> palette{ c0, c1, c0, c0 };
+        for (std::size_t c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2 * c0[c] + c1[c]) / 3;
+            palette[3][c] = (c0[c] + 2 * c1[c]) / 3;
+        }
+
+        for (std::uint32_t i = 0; i < 16; ++i)
+        {
+            std::uint32_t best = 0;
+            int bestDistance = std::numeric_limits<int>::max();
+            for (std::uint32_t k = 0; k < 4; ++k)
+            {
+                int distance = 0;
+                for (std::size_t c = 0; c < 3; ++c)
+                {
+                    int d = static_cast<int>(block[i * 4 + c]) - palette[k][c];
+                    distance += d * d;
+                }
+
+                if (distance < bestDistance)
+                {
+                    best = k;
+                    bestDistance = distance;
+                }
+            }
+
+            indices |= best << (2 * i);
+        }
+    }
+
+    for (std::size_t i = 0; i < 4; ++i)
+        out[4 + i] = static_cast<std::uint8_t>(indices >> (8 * i));
+}
+
+// Uses the eight value mode between the block's alpha range
+void
+compressAlpha(const Block& block, std::uint8_t* out)
+{
+    int lo = 255;
+    int hi = 0;
+    for (std::size_t i = 0; i < 16; ++i)
+    {
+        lo = std::min(lo, static_cast<int>(block[i * 4 + 3]));
+        hi = std::max(hi, static_cast<int>(block[i * 4 + 3]));
+    }
+
+    out[0] = static_cast<std::uint8_t>(hi);
+    out[1] = static_cast<std::uint8_t>(lo);
+
+    std::uint64_t indices = 0;
+    if (hi != lo)
+    {
+        std::array<int, 8> palette{ hi, lo };
+        for (int code = 2; code < 8; ++code)
+            palette[code] = ((8 - code) * hi + (code - 1) * lo) / 7;
+
+        for (std::uint32_t i = 0; i < 16; ++i)
+        {
+            std::uint64_t best = 0;
+            int bestDistance = std::numeric_limits<int>::max();
+            for (std::uint32_t k = 0; k < 8; ++k)
+            {
+                int distance = std::abs(static_cast<int>(block[i * 4 + 3]) - palette[k]);
+                if (distance < bestDistance)
+                {
+                    best = k;
+                    bestDistance = distance;
+                }
+            }
+
+            indices |= best << (3 * i);
+        }
+    }
+
+    for (std::size_t i = 0; i < 6; ++i)
+        out[2 + i] = static_cast<std::uint8_t>(indices >> (8 * i));
+}
+
+} // end unnamed namespace
+
+void
+CompressDXT(const std::uint8_t* rgba, int width, int height, bool withAlpha,
+            std::uint8_t* output, util::ThreadPool& pool)
+{
+    const std::size_t blockSize = withAlpha ? 16 : 8;
+    const int blocksWide = (width + 3) / 4;
+    const int blockRows = (height + 3) / 4;
+
+    pool.parallelFor(static_cast<std::size_t>(blockRows),
+                     [&](std::size_t by, unsigned int /* worker */)
+                     {
+        std::uint8_t* out = output + by * static_cast<std::size_t>(blocksWide) * blockSize;
+        for (int bx = 0; bx < blocksWide; ++bx, out += blockSize)
+        {
+            Block block;
+            for (int j = 0; j < 4; ++j)
+            {
+                int y = std::min(static_cast<int>(by) * 4 + j, height - 1);
+                for (int i = 0; i < 4; ++i)
+                {
+                    int x = std::min(bx * 4 + i, width - 1);
+                    const std::uint8_t* pixel = rgba + (static_cast<std::size_t>(y) * width + x) * 4;
+                    std::copy_n(pixel, 4, block.begin() + (j * 4 + i) * 4);
+                }
+            }
+
+            if (withAlpha)
+            {
+                compressAlpha(block, out);
+                compressColors(block, out + 8);
+            }
+            else
+            {
+                compressColors(block, out);
+            }
+        }
+    });
+}
+
+} // end namespace celestia::texprep
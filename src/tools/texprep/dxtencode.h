@@ -0,0 +1,32 @@
+// dxtencode.h
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// DXT1/DXT5 block compression for texprep.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+
+namespace celestia::util
+{
+class ThreadPool;
+}
+
+namespace celestia::texprep
+{
+
+// Compresses a width x height RGBA image with rows of width * 4 bytes to
+// DXT1, or DXT5 if withAlpha is set. Blocks on the right and bottom edges
+// of images with sizes that aren't multiples of 4 repeat the edge pixels.
+// The output must have room for ((width + 3) / 4) * ((height + 3) / 4)
+// blocks of 8 or 16 bytes.
+void CompressDXT(const std::uint8_t* rgba, int width, int height, bool withAlpha,
+                 std::uint8_t* output, util::ThreadPool& pool);
+
+} // end namespace celestia::texprep
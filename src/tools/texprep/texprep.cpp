@@ -0,0 +1,253 @@
+// texprep.cpp
+//
+// Copyright (C) 2024-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Write DXTc compressed, fully mipmapped DDS copies of the textures in a
+// directory tree, which Celestia loads instead of the sources.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celengine/texmanager.h>
+#include <celimage/image.h>
+#include <celimage/imageformats.h>
+#include <celutil/filetype.h>
+#include <celutil/logger.h>
+#include <celutil/threadpool.h>
+
+#include "dxtencode.h"
+
+using celestia::engine::Image;
+using celestia::engine::PixelFormat;
+using celestia::util::CreateLogger;
+
+namespace
+{
+
+std::vector<fs::path> directories;
+bool force = false;
+bool verbose = false;
+
+void
+usage()
+{
+    std::cerr << "Usage: texprep [options] <textures directory>...\n";
+    std::cerr << "   --force (or -f)   : rebuild copies that are up to date\n";
+    std::cerr << "   --verbose (or -v) : list the textures processed\n";
+}
+
+bool
+parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-')
+        {
+            if (!std::strcmp(argv[i], "-f") || !std::strcmp(argv[i], "--force"))
+            {
+                force = true;
+            }
+            else if (!std::strcmp(argv[i], "-v") || !std::strcmp(argv[i], "--verbose"))
+            {
+                verbose = true;
+            }
+            else
+            {
+                std::cerr << "Unknown command line switch: " << argv[i] << '\n';
+                return false;
+            }
+        }
+        else
+        {
+            directories.emplace_back(argv[i]);
+        }
+    }
+
+    return !directories.empty();
+}
+
+bool
+isSourceTexture(const fs::path& path)
+{
+    switch (DetermineFileType(path))
+    {
+    case ContentType::JPEG:
+    case ContentType::BMP:
+    case ContentType::PNG:
+#ifdef USE_LIBAVIF
+    case ContentType::AVIF:
+#endif
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool
+isUpToDate(const fs::path& source, const fs::path& copy)
+{
+    std::error_code ec;
+    auto copyTime = fs::last_write_time(copy, ec);
+    if (ec)
+        return false;
+
+    auto sourceTime = fs::last_write_time(source, ec);
+    return !ec && copyTime >= sourceTime;
+}
+
+// Converts an uncompressed image to RGBA, whose rows are never padded
+std::unique_ptr<Image>
+toRGBA(const Image& img)
+{
+    auto rgba = std::make_unique<Image>(PixelFormat::RGBA, img.getWidth(), img.getHeight());
+    int components = img.getComponents();
+    bool bgr = img.getFormat() == PixelFormat::BGR || img.getFormat() == PixelFormat::BGRA;
+
+    std::uint8_t* out = rgba->getPixels();
+    for (int y = 0; y < img.getHeight(); ++y)
+    {
+        const std::uint8_t* in = img.getPixels() + static_cast<std::size_t>(y) * img.getPitch();
+        for (int x = 0; x < img.getWidth(); ++x, in += components, out += 4)
+        {
+            switch (components)
+            {
+            case 1:
+                out[0] = out[1] = out[2] = in[0];
+                out[3] = 255;
+                break;
+            case 2:
+                out[0] = out[1] = out[2] = in[0];
+                out[3] = in[1];
+                break;
+            default:
+                out[0] = in[bgr ? 2 : 0];
+                out[1] = in[1];
+                out[2] = in[bgr ? 0 : 2];
+                out[3] = components == 4 ? in[3] : 255;
+                break;
+            }
+        }
+    }
+
+    return rgba;
+}
+
+int
+mipLevelCount(int width, int height)
+{
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+        ++levels;
+    return levels;
+}
+
+bool
+preprocess(const fs::path& source, celestia::util::ThreadPool& pool)
+{
+    std::unique_ptr<Image> img = Image::load(source);
+    if (img == nullptr || img->isCompressed())
+    {
+        std::cerr << "Error loading " << source.string() << '\n';
+        return false;
+    }
+
+    int width = img->getWidth();
+    int height = img->getHeight();
+    bool withAlpha = img->hasAlpha();
+    int levels = mipLevelCount(width, height);
+
+    Image compressed(withAlpha ? PixelFormat::DXT5 : PixelFormat::DXT1, width, height, levels);
+    std::unique_ptr<Image> rgba = toRGBA(*img)->computeMipMaps();
+    img.reset();
+
+    for (int mip = 0; mip < levels; ++mip)
+    {
+        int mipWidth = std::max(width >> mip, 1);
+        int mipHeight = std::max(height >> mip, 1);
+        celestia::texprep::CompressDXT(rgba->getMipLevel(mip), mipWidth, mipHeight, withAlpha,
+                                       compressed.getMipLevel(mip), pool);
+    }
+
+    fs::path copy = GetPreprocessedTexturePath(source);
+    fs::path temp = copy;
+    temp += ".tmp";
+
+    // Write to a temporary file first so that Celestia never loads a
+    // partial copy
+    std::error_code ec;
+    if (!celestia::engine::SaveDDSImage(temp, compressed))
+    {
+        fs::remove(temp, ec);
+        return false;
+    }
+
+    fs::rename(temp, copy, ec);
+    if (ec)
+    {
+        std::cerr << "Error writing " << copy.string() << '\n';
+        fs::remove(temp, ec);
+        return false;
+    }
+
+    if (verbose)
+        std::cout << source.string() << " -> " << copy.string() << '\n';
+    return true;
+}
+
+} // end unnamed namespace
+
+int
+main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        usage();
+        return 1;
+    }
+
+    CreateLogger();
+
+    // Image::load and Image::computeMipMaps share this pool too
+    celestia::util::ThreadPool& pool = celestia::util::ThreadPool::shared();
+    int processed = 0;
+    int failed = 0;
+    for (const fs::path& directory : directories)
+    {
+        std::error_code ec;
+        for (auto it = fs::recursive_directory_iterator(directory, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+        {
+            const fs::path& source = it->path();
+            if (!it->is_regular_file(ec) || !isSourceTexture(source))
+                continue;
+
+            if (!force && isUpToDate(source, GetPreprocessedTexturePath(source)))
+                continue;
+
+            if (preprocess(source, pool))
+                ++processed;
+            else
+                ++failed;
+        }
+
+        if (ec)
+        {
+            std::cerr << "Error reading directory " << directory.string() << '\n';
+            ++failed;
+        }
+    }
+
+    std::cout << processed << " textures preprocessed, " << failed << " failed\n";
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <celimage/image.h>
+
+#include <benchmark/benchmark.h>
+
+using celestia::engine::Image;
+using celestia::engine::PixelFormat;
+
+namespace
+{
+
+std::unique_ptr<Image>
+makeImage(PixelFormat format, int size)
+{
+    auto image = std::make_unique<Image>(format, size, size);
+    std::uint8_t* pixels = image->getPixels();
+    for (int i = 0; i < image->getSize(); ++i)
+        pixels[i] = static_cast<std::uint8_t>((i * 131) ^ (i >> 7));
+    return image;
+}
+
+void
+BM_ImageMipMaps(benchmark::State& state, PixelFormat format)
+{
+    auto image = makeImage(format, static_cast<int>(state.range(0)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(image->computeMipMaps());
+
+    state.SetBytesProcessed(state.iterations() * image->getSize());
+}
+
+void
+BM_ImageNormalMap(benchmark::State& state)
+{
+    auto image = makeImage(PixelFormat::Luminance, static_cast<int>(state.range(0)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(image->computeNormalMap(1.0f, true));
+
+    state.SetBytesProcessed(state.iterations() * image->getSize());
+}
+
+} // end unnamed namespace
+
+BENCHMARK_CAPTURE(BM_ImageMipMaps, RGBA, PixelFormat::RGBA)->Arg(1024)->Arg(4096);
+BENCHMARK_CAPTURE(BM_ImageMipMaps, RGB, PixelFormat::RGB)->Arg(1024)->Arg(4096);
+BENCHMARK_CAPTURE(BM_ImageMipMaps, sRGB, PixelFormat::sRGB)->Arg(1024);
+BENCHMARK(BM_ImageNormalMap)->Arg(1024);
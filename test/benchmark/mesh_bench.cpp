@@ -0,0 +1,94 @@
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celcompat/numbers.h>
+#include <celmodel/mesh.h>
+
+#include <benchmark/benchmark.h>
+
+using celestia::numbers::pi;
+
+namespace
+{
+
+// Indexed UV sphere of unit radius with (slices + 1)^2 vertices
+cmod::Mesh
+makeSphere(int slices)
+{
+    std::vector<float> positions;
+    for (int i = 0; i <= slices; ++i)
+    {
+        double theta = pi * i / slices;
+        for (int j = 0; j <= slices; ++j)
+        {
+            double phi = 2.0 * pi * j / slices;
+            positions.push_back(static_cast<float>(std::sin(theta) * std::cos(phi)));
+            positions.push_back(static_cast<float>(std::cos(theta)));
+            positions.push_back(static_cast<float>(std::sin(theta) * std::sin(phi)));
+        }
+    }
+
+    std::vector<cmod::Index32> indices;
+    for (int i = 0; i < slices; ++i)
+    {
+        for (int j = 0; j < slices; ++j)
+        {
+            auto v0 = static_cast<cmod::Index32>(i * (slices + 1) + j);
+            auto v1 = v0 + static_cast<cmod::Index32>(slices + 1);
+            indices.insert(indices.end(), { v0, v1, v1 + 1, v0, v1 + 1, v0 + 1 });
+        }
+    }
+
+    std::vector<cmod::VertexAttribute> attributes;
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0);
+
+    std::vector<cmod::VWord> vertexData(positions.size());
+    std::memcpy(vertexData.data(), positions.data(), positions.size() * sizeof(float));
+
+    cmod::Mesh mesh;
+    mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes)));
+    mesh.setVertices(static_cast<unsigned int>(positions.size() / 3), std::move(vertexData));
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, std::move(indices));
+    return mesh;
+}
+
+void
+BM_MeshPick(benchmark::State& state)
+{
+    cmod::Mesh mesh = makeSphere(static_cast<int>(state.range(0)));
+    Eigen::Vector3d origin(0.3, 0.2, -5.0);
+    Eigen::Vector3d direction = Eigen::Vector3d::UnitZ();
+
+    // The first pick builds the acceleration structure
+    double distance = 0.0;
+    mesh.pick(origin, direction, distance);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(mesh.pick(origin, direction, distance));
+        benchmark::DoNotOptimize(distance);
+    }
+}
+
+void
+BM_MeshPickMiss(benchmark::State& state)
+{
+    cmod::Mesh mesh = makeSphere(static_cast<int>(state.range(0)));
+    Eigen::Vector3d origin(2.0, 2.0, -5.0);
+    Eigen::Vector3d direction = Eigen::Vector3d::UnitZ();
+
+    double distance = 0.0;
+    mesh.pick(origin, direction, distance);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(mesh.pick(origin, direction, distance));
+}
+
+} // end unnamed namespace
+
+BENCHMARK(BM_MeshPick)->Arg(64)->Arg(512);
+BENCHMARK(BM_MeshPickMiss)->Arg(512);
@@ -0,0 +1,134 @@
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <fmt/ostream.h>
+
+#include <celcompat/filesystem.h>
+#include <celephem/customrotation.h>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
+#include <celephem/sampfile.h>
+#include <celephem/samporbit.h>
+#include <celephem/vsop87.h>
+
+#include <benchmark/benchmark.h>
+
+namespace ephem = celestia::ephem;
+
+namespace
+{
+
+constexpr double J2000 = 2451545.0;
+
+void
+BM_VSOP87Position(benchmark::State& state, std::shared_ptr<const ephem::Orbit> (*create)())
+{
+    auto orbit = create();
+    double jd = J2000;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(orbit->positionAtTime(jd));
+        jd += 0.37;
+    }
+}
+
+// Orientations at one-minute steps, one at a time or in batches of range(0)
+void
+BM_IAURotation(benchmark::State& state, const char* name)
+{
+    auto model = ephem::GetCustomRotationModel(name);
+    auto count = static_cast<std::size_t>(state.range(0));
+    std::vector<Eigen::Quaterniond> orientations(count);
+    double jd = J2000;
+    for (auto _ : state)
+    {
+        if (count == 1)
+            orientations[0] = model->orientationAtTime(jd);
+        else
+            model->orientationsAtTimes(jd, 1.0 / 1440.0, orientations.data(), count);
+        benchmark::DoNotOptimize(orientations.data());
+        jd += static_cast<double>(count) / 1440.0;
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(count));
+}
+
+// Writes an xyz trajectory of a circular orbit with the given number of
+// samples, one per day, and returns its path.
+fs::path
+writeTrajectory(int count)
+{
+    fs::path path = fs::temp_directory_path() / fmt::format("celestia-bench-{}.xyz", count);
+    std::ofstream out(path);
+    for (int i = 0; i < count; ++i)
+    {
+        double angle = i * 0.01;
+        fmt::print(out, "{:.6f} {:.6f} {:.6f} 0.0\n",
+                   J2000 + i, 1.5e8 * std::cos(angle), 1.5e8 * std::sin(angle));
+    }
+
+    return path;
+}
+
+void
+BM_SampledOrbitCubic(benchmark::State& state, bool sequential)
+{
+    auto count = static_cast<int>(state.range(0));
+    fs::path path = writeTrajectory(count);
+    auto orbit = ephem::LoadSampledTrajectory(path,
+                                              ephem::TrajectoryInterpolation::Cubic,
+                                              ephem::TrajectoryPrecision::Double);
+    fs::remove(path);
+    if (orbit == nullptr)
+    {
+        state.SkipWithError("Could not load trajectory");
+        return;
+    }
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> dist(J2000, J2000 + count - 1);
+    double jd = J2000;
+    for (auto _ : state)
+    {
+        jd = sequential ? J2000 + std::fmod(jd - J2000 + 0.1, count - 1.0) : dist(rng);
+        benchmark::DoNotOptimize(orbit->positionAtTime(jd));
+    }
+}
+
+void
+BM_GetSampleIndex(benchmark::State& state, bool sequential)
+{
+    auto count = static_cast<std::uint32_t>(state.range(0));
+    std::vector<double> times(count);
+    for (std::uint32_t i = 0; i < count; ++i)
+        times[i] = J2000 + i + 0.25 * std::sin(i * 0.1);
+
+    celestia::util::array_view<double> sampleTimes(times.data(), times.size());
+    ephem::SampleTimeIndex index(sampleTimes);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> dist(times.front(), times.back());
+    std::uint32_t lastSample = 0;
+    double jd = times.front();
+    for (auto _ : state)
+    {
+        jd = sequential ? (jd + 0.1 < times.back() ? jd + 0.1 : times.front()) : dist(rng);
+        benchmark::DoNotOptimize(ephem::GetSampleIndex(jd, lastSample, sampleTimes, index));
+    }
+}
+
+} // end unnamed namespace
+
+BENCHMARK_CAPTURE(BM_VSOP87Position, Earth, ephem::CreateVSOP87EarthOrbit);
+BENCHMARK_CAPTURE(BM_VSOP87Position, Jupiter, ephem::CreateVSOP87JupiterOrbit);
+BENCHMARK_CAPTURE(BM_VSOP87Position, Neptune, ephem::CreateVSOP87NeptuneOrbit);
+BENCHMARK_CAPTURE(BM_IAURotation, Moon, "iau-moon")->Arg(1)->Arg(1024);
+BENCHMARK_CAPTURE(BM_IAURotation, Europa, "iau-europa")->Arg(1)->Arg(1024);
+BENCHMARK_CAPTURE(BM_SampledOrbitCubic, Sequential, true)->Arg(100000);
+BENCHMARK_CAPTURE(BM_SampledOrbitCubic, Random, false)->Arg(100000);
+BENCHMARK_CAPTURE(BM_GetSampleIndex, Sequential, true)->Arg(1000)->Arg(1000000);
+BENCHMARK_CAPTURE(BM_GetSampleIndex, Random, false)->Arg(1000)->Arg(1000000);
@@ -0,0 +1,144 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celengine/star.h>
+#include <celengine/stardb.h>
+#include <celengine/stardbbuilder.h>
+#include <celengine/staroctreetraversal.h>
+#include <celengine/stellarclass.h>
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+
+template<typename T>
+void
+writeLE(std::ostream& out, T value)
+{
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+        out.put(static_cast<char>((static_cast<std::uint64_t>(value) >> (8 * i)) & 0xff));
+}
+
+void
+writeFloatLE(std::ostream& out, float value)
+{
+    std::uint32_t bits;
+    static_assert(sizeof(bits) == sizeof(value));
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeLE(out, bits);
+}
+
+// Generates a version 1 stars.dat with the given number of stars, spread
+// uniformly through a sphere of 10000 ly with a G2V spectral type and
+// absolute magnitudes between -5 and 15.
+std::string
+makeStarsDat(std::uint32_t count)
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    out.write("CELSTARS", 8);
+    writeLE(out, std::uint16_t(0x0100));
+    writeLE(out, count);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> mag(-5.0f, 15.0f);
+    std::uint16_t spectralType = StellarClass::parse("G2V").packV1();
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        Eigen::Vector3f pos;
+        do
+        {
+            pos = Eigen::Vector3f(coord(rng), coord(rng), coord(rng));
+        } while (pos.squaredNorm() > 1.0f);
+        pos *= 10000.0f;
+
+        writeLE(out, i + 1);
+        writeFloatLE(out, pos.x());
+        writeFloatLE(out, pos.y());
+        writeFloatLE(out, pos.z());
+        writeLE(out, static_cast<std::int16_t>(mag(rng) * 256.0f));
+        writeLE(out, spectralType);
+    }
+
+    return out.str();
+}
+
+// Building the larger databases takes a while, so they are shared between
+// the benchmarks.
+const StarDatabase*
+getStarDatabase(std::uint32_t count)
+{
+    static std::map<std::uint32_t, std::unique_ptr<StarDatabase>> databases;
+    auto& db = databases[count];
+    if (db == nullptr)
+    {
+        std::istringstream in(makeStarsDat(count), std::ios::in | std::ios::binary);
+        StarDatabaseBuilder builder;
+        if (builder.loadBinary(in))
+            db = builder.finish();
+    }
+
+    return db.get();
+}
+
+class CountingStarHandler final : public StarHandler
+{
+public:
+    void process(const Star&, float, float) override { ++count; }
+
+    std::uint64_t count{ 0 };
+};
+
+// With useVirtual, the handler is called through the StarHandler
+// interface, otherwise through the traversal instantiated for its class
+void
+BM_FindVisibleStars(benchmark::State& state, float limitingMag, bool useVirtual)
+{
+    const StarDatabase* starDB = getStarDatabase(static_cast<std::uint32_t>(state.range(0)));
+    if (starDB == nullptr)
+    {
+        state.SkipWithError("Could not build star database");
+        return;
+    }
+
+    Eigen::Vector3f obsPosition(10.0f, 20.0f, 30.0f);
+    Eigen::Quaternionf obsOrientation = Eigen::Quaternionf::Identity();
+    float angle = 0.0f;
+
+    CountingStarHandler handler;
+    for (auto _ : state)
+    {
+        // Turn the view a bit each iteration so the traversal isn't always
+        // hitting the same nodes
+        obsOrientation = Eigen::AngleAxisf(angle, Eigen::Vector3f::UnitY());
+        angle += 0.01f;
+        if (useVirtual)
+            starDB->findVisibleStars(handler, obsPosition, obsOrientation,
+                                     0.8f, 1.6f, limitingMag);
+        else
+            starDB->processVisibleStars(handler, nullptr, obsPosition, obsOrientation,
+                                        0.8f, 1.6f, limitingMag);
+    }
+
+    state.counters["stars"] = benchmark::Counter(static_cast<double>(handler.count),
+                                                 benchmark::Counter::kAvgIterations);
+}
+
+} // end unnamed namespace
+
+BENCHMARK_CAPTURE(BM_FindVisibleStars, Mag6, 6.0f, true)
+    ->Arg(1 << 20)->Arg(10000000)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_FindVisibleStars, Mag12, 12.0f, true)
+    ->Arg(1 << 20)->Arg(10000000)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_FindVisibleStars, Mag12Static, 12.0f, false)
+    ->Arg(1 << 20)->Arg(10000000)->Unit(benchmark::kMillisecond);
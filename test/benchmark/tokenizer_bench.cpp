@@ -0,0 +1,105 @@
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+#include <fmt/format.h>
+
+#include <celutil/tokenizer.h>
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+
+// Star catalog in the style of the stc files of the standard data set
+std::string
+makeStcSample(int count)
+{
+    std::string text;
+    for (int i = 0; i < count; ++i)
+    {
+        text += fmt::format("# Star {0}\n"
+                            "{0} \"STAR {0}:Synthetic {0}\"\n"
+                            "{{\n"
+                            "    RA {1:.6f}\n"
+                            "    Dec {2:.6f}\n"
+                            "    Distance {3:.3f}\n"
+                            "    SpectralType \"G2V\"\n"
+                            "    AppMag {4:.2f}\n"
+                            "}}\n\n",
+                            100000 + i, (i * 7.31) - 360.0 * (i * 7 / 360),
+                            (i % 180) - 89.5, 10.0 + i * 0.25, 4.0 + (i % 60) * 0.1);
+    }
+
+    return text;
+}
+
+// Body definitions in the style of the ssc files of the standard data set
+std::string
+makeSscSample(int count)
+{
+    std::string text;
+    for (int i = 0; i < count; ++i)
+    {
+        text += fmt::format("\"Asteroid {0}\" \"Sol\"\n"
+                            "{{\n"
+                            "    Class \"asteroid\"\n"
+                            "    Texture \"asteroid.jpg\"\n"
+                            "    Radius {1:.1f}\n"
+                            "    EllipticalOrbit {{\n"
+                            "        Epoch 2451545.0\n"
+                            "        Period {2:.4f}\n"
+                            "        SemiMajorAxis {3:.5f}\n"
+                            "        Eccentricity {4:.5f}\n"
+                            "        Inclination {5:.3f}\n"
+                            "        AscendingNode {6:.3f}\n"
+                            "        ArgOfPericenter {7:.3f}\n"
+                            "        MeanAnomaly {8:.3f}\n"
+                            "    }}\n"
+                            "    Albedo 0.15\n"
+                            "}}\n\n",
+                            i, 1.0 + i % 50, 3.0 + (i % 40) * 0.05, 2.1 + (i % 90) * 0.01,
+                            (i % 30) * 0.01, (i % 25) * 0.7, (i * 13) % 360,
+                            (i * 29) % 360, (i * 47) % 360);
+    }
+
+    return text;
+}
+
+void
+tokenize(benchmark::State& state, const std::string& text)
+{
+    for (auto _ : state)
+    {
+        std::istringstream in(text);
+        Tokenizer tokenizer(&in);
+        std::size_t tokens = 0;
+        for (;;)
+        {
+            auto type = tokenizer.nextToken();
+            if (type == Tokenizer::TokenEnd || type == Tokenizer::TokenError)
+                break;
+            ++tokens;
+        }
+        benchmark::DoNotOptimize(tokens);
+    }
+
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+void
+BM_TokenizeStc(benchmark::State& state)
+{
+    tokenize(state, makeStcSample(10000));
+}
+
+void
+BM_TokenizeSsc(benchmark::State& state)
+{
+    tokenize(state, makeSscSample(5000));
+}
+
+} // end unnamed namespace
+
+BENCHMARK(BM_TokenizeStc);
+BENCHMARK(BM_TokenizeSsc);
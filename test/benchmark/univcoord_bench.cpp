@@ -0,0 +1,73 @@
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/univcoord.h>
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+
+std::vector<UniversalCoord>
+makeCoords(std::size_t count)
+{
+    std::vector<UniversalCoord> coords;
+    coords.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto t = static_cast<double>(i);
+        coords.emplace_back(1.0e9 * t, -3.0e8 * t, 7.0e7 * t);
+    }
+
+    return coords;
+}
+
+void
+BM_UniversalCoordAdd(benchmark::State& state)
+{
+    auto coords = makeCoords(1024);
+    UniversalCoord offset(1.0e6, 2.0e6, 3.0e6);
+    for (auto _ : state)
+    {
+        for (const UniversalCoord& uc : coords)
+            benchmark::DoNotOptimize(uc + offset);
+    }
+
+    state.SetItemsProcessed(state.iterations() * coords.size());
+}
+
+void
+BM_UniversalCoordOffsetFromKm(benchmark::State& state)
+{
+    auto coords = makeCoords(1024);
+    UniversalCoord origin(5.0e8, 5.0e8, 5.0e8);
+    for (auto _ : state)
+    {
+        for (const UniversalCoord& uc : coords)
+            benchmark::DoNotOptimize(uc.offsetFromKm(origin));
+    }
+
+    state.SetItemsProcessed(state.iterations() * coords.size());
+}
+
+void
+BM_UniversalCoordOffsetKm(benchmark::State& state)
+{
+    auto coords = makeCoords(1024);
+    Eigen::Vector3d v(6378.0, -1000.0, 250.0);
+    for (auto _ : state)
+    {
+        for (const UniversalCoord& uc : coords)
+            benchmark::DoNotOptimize(uc.offsetKm(v));
+    }
+
+    state.SetItemsProcessed(state.iterations() * coords.size());
+}
+
+} // end unnamed namespace
+
+BENCHMARK(BM_UniversalCoordAdd);
+BENCHMARK(BM_UniversalCoordOffsetFromKm);
+BENCHMARK(BM_UniversalCoordOffsetKm);
@@ -1,5 +1,6 @@
 #include <cstdint>
 #include <memory>
+#include <string>
 
 #include <doctest.h>
 
@@ -38,4 +39,50 @@ TEST_CASE("Load a 3DS file")
     REQUIRE(vertexCount == 63);
 }
 
+namespace
+{
+
+class CountingHandler : public M3DSceneHandler
+{
+public:
+    bool material(M3DMaterial&&) override
+    {
+        ++materialCount;
+        return true;
+    }
+
+    bool beginObject(std::string&&) override
+    {
+        ++objectCount;
+        return true;
+    }
+
+    bool triangleMesh(M3DTriangleMesh&& mesh) override
+    {
+        ++meshCount;
+        faceCount += static_cast<std::uint32_t>(mesh.getFaceCount());
+        vertexCount += static_cast<std::uint32_t>(mesh.getVertexCount());
+        return true;
+    }
+
+    std::uint32_t materialCount{ 0 };
+    std::uint32_t objectCount{ 0 };
+    std::uint32_t meshCount{ 0 };
+    std::uint32_t faceCount{ 0 };
+    std::uint32_t vertexCount{ 0 };
+};
+
+} // end unnamed namespace
+
+TEST_CASE("Stream a 3DS file")
+{
+    CountingHandler handler;
+    REQUIRE(Read3DSFile("icosphere.3ds", handler));
+    REQUIRE(handler.materialCount == 1);
+    REQUIRE(handler.objectCount == 1);
+    REQUIRE(handler.meshCount == 1);
+    REQUIRE(handler.faceCount == 80);
+    REQUIRE(handler.vertexCount == 63);
+}
+
 TEST_SUITE_END();
@@ -0,0 +1,299 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <Eigen/Core>
+#include <fmt/format.h>
+
+#include <doctest.h>
+
+#include <celengine/body.h>
+#include <celengine/deepskyobj.h>
+#include <celengine/dsodb.h>
+#include <celengine/name.h>
+#include <celengine/solarsys.h>
+#include <celengine/star.h>
+#include <celengine/stardb.h>
+#include <celengine/stardbbuilder.h>
+#include <celengine/starname.h>
+#include <celengine/stellarclass.h>
+#include <celengine/universe.h>
+#include <celephem/orbit.h>
+
+// The loads are timed and the times reported with MESSAGE. Setting the
+// environment variable CELESTIA_LOAD_TIME_SCALE also fails the tests that
+// take longer than their budget times the given factor, e.g. 1 on a
+// release build of a recent desktop machine, more on slower machines or
+// debug builds.
+
+namespace
+{
+
+constexpr std::uint32_t BinaryStarCount = 200000;
+constexpr std::uint32_t StcStarCount = 5000;
+constexpr std::uint32_t GalaxyCount = 10000;
+constexpr std::uint32_t PlanetCount = 500;
+constexpr std::uint32_t MoonsPerPlanet = 4;
+
+constexpr AstroCatalog::IndexNumber FirstStcNumber = 1000000;
+
+class LoadTimer
+{
+public:
+    LoadTimer(const char* name, double budget) : m_name(name), m_budget(budget) {}
+
+    ~LoadTimer()
+    {
+        std::chrono::duration<double, std::milli> elapsed = clock::now() - m_start;
+        MESSAGE(fmt::format("{}: {:.1f} ms", m_name, elapsed.count()));
+        if (const char* scale = std::getenv("CELESTIA_LOAD_TIME_SCALE"); scale != nullptr)
+            CHECK(elapsed.count() <= m_budget * std::atof(scale));
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    const char* m_name;
+    double m_budget;
+    clock::time_point m_start{ clock::now() };
+};
+
+template<typename T>
+void
+writeLE(std::ostream& out, T value)
+{
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+        out.put(static_cast<char>((static_cast<std::uint64_t>(value) >> (8 * i)) & 0xff));
+}
+
+void
+writeFloatLE(std::ostream& out, float value)
+{
+    std::uint32_t bits;
+    static_assert(sizeof(bits) == sizeof(value));
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeLE(out, bits);
+}
+
+// Star i of the binary database is on a grid with a spacing of 10 ly
+Eigen::Vector3f
+binaryStarPosition(std::uint32_t i)
+{
+    return Eigen::Vector3f(static_cast<float>(i % 100),
+                           static_cast<float>((i / 100) % 100),
+                           static_cast<float>(i / 10000)) * 10.0f - Eigen::Vector3f::Constant(500.0f);
+}
+
+// Version 1 stars.dat with catalog numbers 1 to BinaryStarCount
+std::string
+makeStarsDat()
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    out.write("CELSTARS", 8);
+    writeLE(out, std::uint16_t(0x0100));
+    writeLE(out, BinaryStarCount);
+
+    std::uint16_t spectralType = StellarClass::parse("G2V").packV1();
+    for (std::uint32_t i = 0; i < BinaryStarCount; ++i)
+    {
+        Eigen::Vector3f pos = binaryStarPosition(i);
+        writeLE(out, i + 1);
+        writeFloatLE(out, pos.x());
+        writeFloatLE(out, pos.y());
+        writeFloatLE(out, pos.z());
+        writeLE(out, static_cast<std::int16_t>(static_cast<float>(i % 20) * 256.0f));
+        writeLE(out, spectralType);
+    }
+
+    return out.str();
+}
+
+double
+stcDistance(std::uint32_t i)
+{
+    return 10.0 + static_cast<double>(i);
+}
+
+std::string
+makeStc()
+{
+    std::string stc;
+    for (std::uint32_t i = 0; i < StcStarCount; ++i)
+    {
+        stc += fmt::format("{} \"Synthetic {}\"\n{{\n"
+                           "\tRA {}\n\tDec {}\n\tDistance {}\n"
+                           "\tSpectralType \"K1III\"\n\tAppMag {}\n}}\n\n",
+                           FirstStcNumber + i, i,
+                           static_cast<double>(i % 360),
+                           static_cast<double>(i % 180) - 89.5,
+                           stcDistance(i),
+                           static_cast<double>(i % 10));
+    }
+
+    return stc;
+}
+
+double
+dscDistance(std::uint32_t i)
+{
+    return 1.0e6 + static_cast<double>(i) * 1000.0;
+}
+
+std::string
+makeDsc()
+{
+    std::string dsc;
+    for (std::uint32_t i = 0; i < GalaxyCount; ++i)
+    {
+        dsc += fmt::format("Galaxy \"SynthGal {}\"\n{{\n"
+                           "\tType \"SBb\"\n\tRA {}\n\tDec {}\n\tDistance {}\n"
+                           "\tRadius {}\n\tAbsMag {}\n}}\n\n",
+                           i,
+                           static_cast<double>(i % 24),
+                           static_cast<double>(i % 180) - 89.5,
+                           dscDistance(i),
+                           1000.0 + static_cast<double>(i % 50) * 100.0,
+                           -20.0 + static_cast<double>(i % 5));
+    }
+
+    return dsc;
+}
+
+// Semi-major axis of moon j of each planet, in km
+double
+moonSemiMajorAxis(std::uint32_t j)
+{
+    return 100000.0 * static_cast<double>(j + 1);
+}
+
+std::string
+makeSsc()
+{
+    std::string ssc;
+    for (std::uint32_t i = 0; i < PlanetCount; ++i)
+    {
+        ssc += fmt::format("\"Planet {}\" \"Synthetic 0\"\n{{\n"
+                           "\tClass \"planet\"\n\tRadius 6000\n"
+                           "\tEllipticalOrbit {{ Period {} SemiMajorAxis {} }}\n}}\n\n",
+                           i, 1.0 + static_cast<double>(i), 1.0 + static_cast<double>(i) * 0.1);
+        for (std::uint32_t j = 0; j < MoonsPerPlanet; ++j)
+        {
+            ssc += fmt::format("\"Moon {}\" \"Synthetic 0/Planet {}\"\n{{\n"
+                               "\tClass \"moon\"\n\tRadius 500\n"
+                               "\tEllipticalOrbit {{ Period {} SemiMajorAxis {} }}\n}}\n\n",
+                               j, i, 10.0 + static_cast<double>(j), moonSemiMajorAxis(j));
+        }
+    }
+
+    return ssc;
+}
+
+std::unique_ptr<StarDatabase>
+loadStars()
+{
+    StarDatabaseBuilder builder;
+    {
+        LoadTimer timer("stars.dat", 200.0);
+        std::istringstream in(makeStarsDat(), std::ios::in | std::ios::binary);
+        if (!builder.loadBinary(in))
+            return nullptr;
+    }
+
+    builder.setNameDatabase(std::make_unique<StarNameDatabase>());
+    {
+        LoadTimer timer("stc", 300.0);
+        std::istringstream in(makeStc());
+        if (!builder.load(in))
+            return nullptr;
+    }
+
+    LoadTimer timer("star database", 300.0);
+    return builder.finish();
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("catalog load integration");
+
+TEST_CASE("Load a binary star database and an stc file")
+{
+    std::unique_ptr<StarDatabase> starDB = loadStars();
+    REQUIRE(starDB != nullptr);
+    REQUIRE(starDB->size() == BinaryStarCount + StcStarCount);
+
+    for (std::uint32_t i : { 0U, 1234U, 99999U, BinaryStarCount - 1 })
+    {
+        const Star* star = starDB->find(i + 1);
+        REQUIRE(star != nullptr);
+        CHECK((star->getPosition() - binaryStarPosition(i)).norm() < 1.0e-3f);
+        CHECK(star->getAbsoluteMagnitude() == doctest::Approx(static_cast<float>(i % 20)));
+    }
+
+    for (std::uint32_t i : { 0U, 17U, StcStarCount - 1 })
+    {
+        const Star* star = starDB->find(fmt::format("Synthetic {}", i), false);
+        REQUIRE(star != nullptr);
+        CHECK(star->getIndex() == FirstStcNumber + i);
+        CHECK(star->getPosition().norm() == doctest::Approx(stcDistance(i)).epsilon(1.0e-5));
+    }
+}
+
+TEST_CASE("Load a dsc file")
+{
+    DSODatabase dsoDB;
+    dsoDB.setNameDatabase(std::make_unique<NameDatabase>());
+    {
+        LoadTimer timer("dsc", 500.0);
+        std::istringstream in(makeDsc());
+        REQUIRE(dsoDB.load(in));
+        dsoDB.finish();
+    }
+
+    REQUIRE(dsoDB.size() == GalaxyCount);
+    for (std::uint32_t i : { 0U, 4321U, GalaxyCount - 1 })
+    {
+        const DeepSkyObject* dso = dsoDB.find(fmt::format("SynthGal {}", i), false);
+        REQUIRE(dso != nullptr);
+        CHECK(dso->getPosition().norm() == doctest::Approx(dscDistance(i)).epsilon(1.0e-9));
+    }
+}
+
+TEST_CASE("Load an ssc file")
+{
+    Universe universe;
+    universe.setStarCatalog(loadStars());
+    REQUIRE(universe.getStarCatalog() != nullptr);
+    universe.setSolarSystemCatalog(std::make_unique<SolarSystemCatalog>());
+
+    {
+        LoadTimer timer("ssc", 500.0);
+        std::istringstream in(makeSsc());
+        REQUIRE(LoadSolarSystemObjects(in, universe));
+    }
+
+    const Star* star = universe.getStarCatalog()->find("Synthetic 0", false);
+    REQUIRE(star != nullptr);
+    const SolarSystem* solarSystem = universe.getSolarSystem(star);
+    REQUIRE(solarSystem != nullptr);
+
+    const PlanetarySystem* planets = solarSystem->getPlanets();
+    REQUIRE(planets->getSystemSize() == static_cast<int>(PlanetCount));
+    for (int i = 0; i < planets->getSystemSize(); ++i)
+    {
+        const PlanetarySystem* moons = planets->getBody(i)->getSatellites();
+        REQUIRE(moons != nullptr);
+        REQUIRE(moons->getSystemSize() == static_cast<int>(MoonsPerPlanet));
+    }
+
+    const Body* moon = planets->find("Planet 123")->getSatellites()->find("Moon 2");
+    REQUIRE(moon != nullptr);
+    CHECK(moon->getOrbit(0.0)->positionAtTime(2451545.0).norm() ==
+          doctest::Approx(moonSemiMajorAxis(2)).epsilon(1.0e-9));
+}
+
+TEST_SUITE_END();
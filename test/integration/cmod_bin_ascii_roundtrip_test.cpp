@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <ios>
 #include <iterator>
@@ -11,6 +12,7 @@
 #include <celcompat/filesystem.h>
 #include <celmodel/model.h>
 #include <celmodel/modelfile.h>
+#include <celmodel/vertexformat.h>
 #include <celutil/reshandle.h>
 
 TEST_SUITE_BEGIN("CMOD integration");
@@ -58,4 +60,110 @@ TEST_CASE("CMOD binary to ASCII roundtrip")
                        std::istreambuf_iterator<char>(roundtrippedData), end));
 }
 
+TEST_CASE("CMOD levels of detail roundtrip")
+{
+    cmod::HandleGetter handleGetter = [](const fs::path&) { return InvalidResource; };
+    cmod::SourceGetter sourceGetter = [](ResourceHandle) { return fs::path(); };
+
+    std::vector<cmod::VertexAttribute> attributes;
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0);
+
+    std::vector<cmod::VWord> vertices(12);
+    const float positions[] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f };
+    std::memcpy(vertices.data(), positions, sizeof(positions));
+
+    cmod::Mesh mesh;
+    REQUIRE(mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes))));
+    mesh.setVertices(4, std::move(vertices));
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, { 0, 1, 2, 1, 3, 2 });
+
+    cmod::LevelOfDetail level;
+    level.error = 0.25f;
+    level.groups.emplace_back();
+    level.groups.back().prim = cmod::PrimitiveGroupType::TriList;
+    level.groups.back().indices = { 0, 1, 2 };
+    mesh.addLevelOfDetail(std::move(level));
+
+    cmod::Model model;
+    model.addMaterial(cmod::Material());
+    model.addMesh(std::move(mesh));
+
+    std::stringstream binaryData;
+    REQUIRE(cmod::SaveModelBinary(&model, binaryData, sourceGetter));
+    std::unique_ptr<cmod::Model> modelFromBinary = cmod::LoadModel(binaryData, handleGetter);
+    REQUIRE(modelFromBinary != nullptr);
+
+    std::stringstream asciiData;
+    REQUIRE(cmod::SaveModelAscii(modelFromBinary.get(), asciiData, sourceGetter));
+    std::unique_ptr<cmod::Model> modelFromAscii = cmod::LoadModel(asciiData, handleGetter);
+    REQUIRE(modelFromAscii != nullptr);
+
+    const cmod::Mesh* loaded = modelFromAscii->getMesh(0);
+    REQUIRE(loaded != nullptr);
+    REQUIRE(loaded->getGroupCount() == 1);
+    REQUIRE(loaded->getLevelOfDetailCount() == 1);
+    const cmod::LevelOfDetail* loadedLevel = loaded->getLevelOfDetail(0);
+    REQUIRE(loadedLevel->error == 0.25f);
+    REQUIRE(loadedLevel->groups.size() == 1);
+    REQUIRE(loadedLevel->groups[0].indices == std::vector<cmod::Index32>{ 0, 1, 2 });
+}
+
+TEST_CASE("CMOD quantized vertex formats roundtrip")
+{
+    cmod::HandleGetter handleGetter = [](const fs::path&) { return InvalidResource; };
+    cmod::SourceGetter sourceGetter = [](ResourceHandle) { return fs::path(); };
+
+    std::vector<cmod::VertexAttribute> attributes;
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0);
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Normal, cmod::VertexAttributeFormat::Int1010102, 3);
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Tangent, cmod::VertexAttributeFormat::Short4, 4);
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Texture0, cmod::VertexAttributeFormat::Half2, 6);
+
+    const float values[][4] =
+    {
+        { 0.0f, 0.0f, 1.0f, 0.0f },
+        { -0.6f, 0.8f, 0.0f, 1.0f },
+        { 0.25f, 0.75f, 0.0f, 0.0f },
+    };
+
+    std::vector<cmod::VWord> vertices(7);
+    std::memcpy(vertices.data(), values[0], sizeof(float) * 3);
+    cmod::PackVertexAttribute(cmod::VertexAttributeFormat::Int1010102, values[1], 4, vertices.data() + 3);
+    cmod::PackVertexAttribute(cmod::VertexAttributeFormat::Short4, values[1], 4, vertices.data() + 4);
+    cmod::PackVertexAttribute(cmod::VertexAttributeFormat::Half2, values[2], 2, vertices.data() + 6);
+
+    cmod::Mesh mesh;
+    REQUIRE(mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes))));
+    mesh.setVertices(1, std::vector<cmod::VWord>(vertices));
+    mesh.addGroup(cmod::PrimitiveGroupType::PointList, 0, { 0 });
+
+    cmod::Model model;
+    model.addMaterial(cmod::Material());
+    model.addMesh(std::move(mesh));
+
+    std::stringstream binaryData;
+    REQUIRE(cmod::SaveModelBinary(&model, binaryData, sourceGetter));
+    std::unique_ptr<cmod::Model> modelFromBinary = cmod::LoadModel(binaryData, handleGetter);
+    REQUIRE(modelFromBinary != nullptr);
+
+    std::stringstream asciiData;
+    REQUIRE(cmod::SaveModelAscii(modelFromBinary.get(), asciiData, sourceGetter));
+    std::unique_ptr<cmod::Model> modelFromAscii = cmod::LoadModel(asciiData, handleGetter);
+    REQUIRE(modelFromAscii != nullptr);
+
+    const cmod::Mesh* loaded = modelFromAscii->getMesh(0);
+    REQUIRE(loaded != nullptr);
+    REQUIRE(loaded->getVertexDescription().strideBytes == 28);
+    REQUIRE(std::equal(vertices.begin(), vertices.end(), loaded->getVertexData()));
+
+    float unpacked[4];
+    REQUIRE(cmod::UnpackVertexAttribute(cmod::VertexAttributeFormat::Int1010102, loaded->getVertexData() + 3, unpacked) == 4);
+    REQUIRE(unpacked[0] == doctest::Approx(-0.6f).epsilon(0.002));
+    REQUIRE(unpacked[1] == doctest::Approx(0.8f).epsilon(0.002));
+    REQUIRE(unpacked[3] == 1.0f);
+    REQUIRE(cmod::UnpackVertexAttribute(cmod::VertexAttributeFormat::Half2, loaded->getVertexData() + 6, unpacked) == 2);
+    REQUIRE(unpacked[0] == 0.25f);
+    REQUIRE(unpacked[1] == 0.75f);
+}
+
 TEST_SUITE_END();
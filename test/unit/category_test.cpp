@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <vector>
+
 #include <doctest.h>
 
 #include <celengine/category.h>
@@ -224,4 +227,55 @@ TEST_CASE("Objects in categories")
     }
 }
 
+TEST_CASE("Category set operations")
+{
+    UserCategoryManager manager;
+    auto fooId = manager.create("foo", UserCategoryId::Invalid, {});
+    auto barId = manager.create("bar", UserCategoryId::Invalid, {});
+    auto bazId = manager.create("baz", UserCategoryId::Invalid, {});
+
+    Star star1(1, StarDetails::GetBarycenterDetails());
+    Star star2(2, StarDetails::GetBarycenterDetails());
+    Star star3(3, StarDetails::GetBarycenterDetails());
+    Selection sel1{&star1};
+    Selection sel2{&star2};
+    Selection sel3{&star3};
+
+    REQUIRE(manager.addObject(sel1, fooId));
+    REQUIRE(manager.addObject(sel2, fooId));
+    REQUIRE(manager.addObject(sel2, barId));
+    REQUIRE(manager.addObject(sel3, barId));
+
+    SUBCASE("Objects in all categories")
+    {
+        auto objects = manager.objectsInAll(std::vector { fooId, barId });
+        REQUIRE(objects.size() == 1);
+        REQUIRE(objects.front() == sel2);
+
+        REQUIRE(manager.objectsInAll(std::vector { fooId, bazId }).empty());
+        REQUIRE(manager.objectsInAll(std::vector<UserCategoryId>()).empty());
+    }
+
+    SUBCASE("Objects in any category")
+    {
+        auto objects = manager.objectsInAny(std::vector { fooId, barId, bazId });
+        REQUIRE(objects.size() == 3);
+        for (const Selection& sel : { sel1, sel2, sel3 })
+            REQUIRE(std::find(objects.begin(), objects.end(), sel) != objects.end());
+    }
+
+    SUBCASE("Removed objects are not found")
+    {
+        manager.clearCategories(sel2);
+        REQUIRE(manager.objectsInAll(std::vector { fooId, barId }).empty());
+        REQUIRE(manager.objectsInAny(std::vector { fooId, barId }).size() == 2);
+
+        // Re-adding an object after its ID was released
+        REQUIRE(manager.addObject(sel2, barId));
+        REQUIRE(manager.isInCategory(sel2, barId));
+        REQUIRE(!manager.isInCategory(sel2, fooId));
+        REQUIRE(manager.get(barId)->members().size() == 2);
+    }
+}
+
 TEST_SUITE_END();
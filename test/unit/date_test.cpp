@@ -0,0 +1,94 @@
+#include <cmath>
+
+#include <celastro/astro.h>
+#include <celastro/date.h>
+
+#include <doctest.h>
+
+namespace astro = celestia::astro;
+
+namespace
+{
+
+// Difference between TAI and UTC in seconds at a UTC Julian date
+double
+leapSecondsAt(double jdutc)
+{
+    return astro::daysToSecs(astro::JDUTCtoTAI(jdutc) - jdutc);
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("Date");
+
+TEST_CASE("Leap seconds")
+{
+    SUBCASE("Offsets between insertions")
+    {
+        // Jumping back and forth checks that the cached record is not
+        // reused for other times
+        CHECK(leapSecondsAt(2457800.0) == doctest::Approx(37.0));
+        CHECK(leapSecondsAt(2441000.0) == doctest::Approx(10.0));
+        CHECK(leapSecondsAt(2451000.0) == doctest::Approx(31.0));
+        CHECK(leapSecondsAt(2457000.0) == doctest::Approx(35.0));
+        CHECK(leapSecondsAt(2453736.0) == doctest::Approx(32.0));
+        CHECK(leapSecondsAt(2453737.0) == doctest::Approx(33.0));
+    }
+
+    SUBCASE("Conversions to UTC Julian dates")
+    {
+        for (double jdutc : { 2441000.25, 2457800.25, 2444000.25, 2444001.25, 2456109.75 })
+        {
+            CHECK(astro::TAItoJDUTC(astro::JDUTCtoTAI(jdutc)) == doctest::Approx(jdutc).epsilon(1.0e-12));
+        }
+    }
+
+    SUBCASE("Dates within a leap second")
+    {
+        // 2016-12-31 23:59:60.5 UTC
+        double tai = 2457754.5 + astro::secsToDays(36.5);
+        astro::Date date = astro::TAItoUTC(tai);
+        CHECK(date.year == 2016);
+        CHECK(date.month == 12);
+        CHECK(date.day == 31);
+        CHECK(date.hour == 23);
+        CHECK(date.minute == 59);
+        CHECK(date.seconds == doctest::Approx(60.5).epsilon(1.0e-4));
+
+        // One second later it is 2017
+        date = astro::TAItoUTC(tai + astro::secsToDays(1.0));
+        CHECK(date.year == 2017);
+        CHECK(date.seconds == doctest::Approx(0.5).epsilon(1.0e-4));
+    }
+
+    SUBCASE("Round trip through dates")
+    {
+        for (double tai : { 2457000.3, 2442000.7, 2457754.2, 2450000.9 })
+        {
+            CHECK(astro::UTCtoTAI(astro::TAItoUTC(tai)) == doctest::Approx(tai).epsilon(1.0e-12));
+        }
+    }
+}
+
+TEST_CASE("TT and TDB")
+{
+    constexpr double K = 1.657e-3;
+    constexpr double EB = 1.671e-2;
+    constexpr double M0 = 6.239996;
+    constexpr double M1 = 1.99096871e-7;
+
+    // Julian dates near the present resolve about 40 microseconds
+    constexpr double tolerance = 1.0e-4;
+
+    for (double tt = astro::J2000 - 1000.0; tt < astro::J2000 + 1000.0; tt += 3.7)
+    {
+        double M = M0 + M1 * astro::daysToSecs(tt - astro::J2000);
+        double expected = tt + astro::secsToDays(K * std::sin(M + EB * std::sin(M)));
+
+        double tdb = astro::TTtoTDB(tt);
+        CHECK(std::abs(astro::daysToSecs(tdb - expected)) < tolerance);
+        CHECK(std::abs(astro::daysToSecs(astro::TDBtoTT(tdb) - tt)) < tolerance);
+    }
+}
+
+TEST_SUITE_END();
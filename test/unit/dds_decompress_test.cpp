@@ -0,0 +1,117 @@
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <celimage/dds_decompress.h>
+#include <celutil/threadpool.h>
+
+#include <doctest.h>
+
+using celestia::engine::DecompressBlockDXT1;
+using celestia::engine::DecompressBlockDXT3;
+using celestia::engine::DecompressBlockDXT5;
+using celestia::engine::DecompressImageDXTc;
+using celestia::engine::PixelFormat;
+
+namespace
+{
+
+std::size_t
+blockSize(PixelFormat format)
+{
+    return format == PixelFormat::DXT1 ? 8 : 16;
+}
+
+std::vector<std::uint8_t>
+randomBlocks(PixelFormat format, std::uint32_t width, std::uint32_t height, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> byteDist(0, 255);
+    std::vector<std::uint8_t> blocks(((width + 3) / 4) * ((height + 3) / 4) * blockSize(format));
+    for (auto& b : blocks)
+        b = static_cast<std::uint8_t>(byteDist(rng));
+
+    // Make sure both color and alpha modes and black pixels show up
+    for (std::size_t i = 0; i < blocks.size(); i += blockSize(format))
+    {
+        std::uint8_t* block = blocks.data() + i;
+        switch (i / blockSize(format) % 4)
+        {
+        case 0:
+            block[blockSize(format) - 8] = 0;
+            block[blockSize(format) - 7] = 0;
+            break;
+        case 1:
+            block[0] = block[1];
+            break;
+        default:
+            break;
+        }
+    }
+
+    return blocks;
+}
+
+// Reference decode using the block functions into an image padded to
+// multiples of 4, cropped afterwards
+std::vector<std::uint32_t>
+decodeBlocks(PixelFormat format, std::uint32_t width, std::uint32_t height,
+             const std::vector<std::uint8_t>& blocks, bool transparent0)
+{
+    std::uint32_t paddedWidth = (width + 3) & ~3u;
+    std::uint32_t paddedHeight = (height + 3) & ~3u;
+    std::vector<std::uint32_t> padded(paddedWidth * paddedHeight);
+    const std::uint8_t* block = blocks.data();
+    for (std::uint32_t y = 0; y < paddedHeight; y += 4)
+    {
+        for (std::uint32_t x = 0; x < paddedWidth; x += 4, block += blockSize(format))
+        {
+            if (format == PixelFormat::DXT1)
+                DecompressBlockDXT1(x, y, paddedWidth, block, transparent0, padded.data());
+            else if (format == PixelFormat::DXT3)
+                DecompressBlockDXT3(x, y, paddedWidth, block, transparent0, padded.data());
+            else
+                DecompressBlockDXT5(x, y, paddedWidth, block, transparent0, padded.data());
+        }
+    }
+
+    std::vector<std::uint32_t> image(width * height);
+    for (std::uint32_t y = 0; y < height; ++y)
+    {
+        for (std::uint32_t x = 0; x < width; ++x)
+            image[y * width + x] = padded[y * paddedWidth + x];
+    }
+
+    return image;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("DDS decompression");
+
+TEST_CASE("Image decompression matches the block decoders")
+{
+    celestia::util::ThreadPool pool(3);
+    for (PixelFormat format : { PixelFormat::DXT1, PixelFormat::DXT3, PixelFormat::DXT5 })
+    {
+        for (bool transparent0 : { false, true })
+        {
+            for (auto [width, height] : { std::pair(64u, 64u), std::pair(6u, 10u), std::pair(1u, 2u) })
+            {
+                auto blocks = randomBlocks(format, width, height, width * 31 + height);
+                auto expected = decodeBlocks(format, width, height, blocks, transparent0);
+
+                std::vector<std::uint32_t> serial(width * height);
+                DecompressImageDXTc(format, width, height, blocks.data(), transparent0, serial.data());
+                REQUIRE(serial == expected);
+
+                std::vector<std::uint32_t> parallel(width * height);
+                DecompressImageDXTc(format, width, height, blocks.data(), transparent0, parallel.data(), &pool);
+                REQUIRE(parallel == expected);
+            }
+        }
+    }
+}
+
+TEST_SUITE_END();
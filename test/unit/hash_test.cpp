@@ -1,5 +1,7 @@
 #include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include <celengine/hash.h>
 #include <celengine/value.h>
@@ -103,4 +105,25 @@ TEST_CASE("AssociativeArray")
     }
 }
 
+TEST_CASE("AssociativeArray keys")
+{
+    AssociativeArray h;
+    h.addValue("Radius", Value(10.0));
+    h.addValue("Albedo", Value(0.5));
+    h.addValue("Texture", Value("earth.png"));
+    h.addValue("Radius", Value(20.0));
+    h.addValue("Mass", Value(3.0));
+
+    REQUIRE(h.getNumber<double>("Radius") == 10.0);
+    REQUIRE(h.getNumber<double>("Albedo") == 0.5);
+    REQUIRE(h.getNumber<double>("Mass") == 3.0);
+    REQUIRE(*h.getString("Texture") == "earth.png");
+    REQUIRE(h.getValue("Orbit") == nullptr);
+    REQUIRE(h.getValue("") == nullptr);
+
+    std::vector<std::string> keys;
+    h.for_all([&keys](const std::string& key, const Value&) { keys.push_back(key); });
+    REQUIRE(keys == std::vector<std::string>{ "Albedo", "Mass", "Radius", "Texture" });
+}
+
 TEST_SUITE_END();
@@ -2,6 +2,7 @@
 
 #include <sstream>
 #include <iostream>
+#include <string>
 #include <celutil/logger.h>
 
 using celestia::util::Logger;
@@ -159,4 +160,40 @@ TEST_CASE("logger")
     }
 }
 
+TEST_CASE("async logger")
+{
+    std::ostringstream err, log;
+    Logger logger(Level::Debug, log, err);
+    logger.startAsync(8);
+
+    SUBCASE("Messages are written in order")
+    {
+        for (int i = 0; i < 100; ++i)
+            logger.info("{}\n", i);
+        logger.flush();
+
+        std::string expected;
+        for (int i = 0; i < 100; ++i)
+            expected += std::to_string(i) + "\n";
+        REQUIRE(log.str() == expected);
+    }
+
+    SUBCASE("Errors are written before returning")
+    {
+        logger.warn("warning\n");
+        logger.error("error\n");
+        REQUIRE(err.str() == "warning\nerror\n");
+    }
+
+    SUBCASE("Stopping writes queued messages")
+    {
+        logger.info("hello world\n");
+        logger.stopAsync();
+        REQUIRE(log.str() == "hello world\n");
+
+        logger.info("hi there\n");
+        REQUIRE(log.str() == "hello world\nhi there\n");
+    }
+}
+
 TEST_SUITE_END();
@@ -0,0 +1,91 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <celengine/name.h>
+
+#include <doctest.h>
+
+using namespace std::string_view_literals;
+
+namespace
+{
+
+std::vector<std::string_view>
+namesOf(const NameDatabase& db, AstroCatalog::IndexNumber catalogNumber)
+{
+    auto names = db.getNames(catalogNumber);
+    return { names.begin(), names.end() };
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("NameDatabase");
+
+TEST_CASE("Names are found ignoring case")
+{
+    NameDatabase db;
+    db.add(1, "Andromeda Galaxy");
+    db.add(1, "M 31");
+    db.add(2, "M 33");
+
+    REQUIRE(db.getCatalogNumberByName("andromeda galaxy", false) == 1);
+    REQUIRE(db.getCatalogNumberByName("m 33", false) == 2);
+    REQUIRE(db.getCatalogNumberByName("M 32", false) == AstroCatalog::InvalidIndex);
+
+    db.finish();
+    REQUIRE(db.getCatalogNumberByName("M 31", false) == 1);
+    REQUIRE(namesOf(db, 1) == std::vector{ "Andromeda Galaxy"sv, "M 31"sv });
+    REQUIRE(db.getNames(3).empty());
+}
+
+TEST_CASE("Lookups during loading see every name")
+{
+    NameDatabase db;
+    for (AstroCatalog::IndexNumber i = 0; i < 1000; ++i)
+    {
+        db.add(i, "Object " + std::to_string(i));
+        REQUIRE(db.getCatalogNumberByName("Object " + std::to_string(i / 2), false) == i / 2);
+    }
+
+    // A repeated name refers to the most recently added object
+    db.add(2000, "object 5");
+    REQUIRE(db.getCatalogNumberByName("Object 5", false) == 2000);
+    db.finish();
+    REQUIRE(db.getCatalogNumberByName("Object 5", false) == 2000);
+    REQUIRE(db.getCatalogNumberByName("Object 999", false) == 999);
+}
+
+TEST_CASE("Erased names are replaced")
+{
+    NameDatabase db;
+    db.add(5, "Old");
+    db.add(5, "Older");
+    db.add(6, "Other");
+    REQUIRE(namesOf(db, 5) == std::vector{ "Old"sv, "Older"sv });
+
+    db.erase(5);
+    db.add(5, "New");
+    db.add(4, "Before");
+    REQUIRE(namesOf(db, 5) == std::vector{ "New"sv });
+    REQUIRE(namesOf(db, 4) == std::vector{ "Before"sv });
+    REQUIRE(namesOf(db, 6) == std::vector{ "Other"sv });
+
+    db.erase(6);
+    db.finish();
+    REQUIRE(db.getNames(6).empty());
+}
+
+TEST_CASE("Completion lists matching names")
+{
+    NameDatabase db;
+    db.add(1, "Capella");
+    db.add(2, "Castor");
+    db.add(3, "Rigel");
+
+    std::vector<std::string> completion;
+    db.getCompletion(completion, "ca");
+    REQUIRE(completion == std::vector<std::string>{ "Capella", "Castor" });
+}
+
+TEST_SUITE_END();
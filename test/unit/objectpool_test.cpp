@@ -0,0 +1,77 @@
+#include <cstdint>
+#include <new>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <celutil/objectpool.h>
+
+#include <doctest.h>
+
+using celestia::util::ObjectPool;
+
+namespace
+{
+
+struct alignas(16) Item
+{
+    double values[3];
+};
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("ObjectPool");
+
+TEST_CASE("Allocations are distinct and aligned")
+{
+    ObjectPool<Item, 8> pool;
+    std::set<void*> allocated;
+    for (int i = 0; i < 100; ++i)
+    {
+        void* p = pool.allocate();
+        REQUIRE(reinterpret_cast<std::uintptr_t>(p) % alignof(Item) == 0);
+        REQUIRE(allocated.insert(p).second);
+        new (p) Item{ { 1.0, 2.0, 3.0 } };
+    }
+
+    REQUIRE(pool.size() == 100);
+    for (void* p : allocated)
+        pool.deallocate(p);
+    REQUIRE(pool.size() == 0);
+}
+
+TEST_CASE("Freed slots are reused")
+{
+    ObjectPool<Item, 8> pool;
+    void* first = pool.allocate();
+    std::size_t usage = pool.memoryUsage();
+    pool.deallocate(first);
+    REQUIRE(pool.allocate() == first);
+    REQUIRE(pool.memoryUsage() == usage);
+}
+
+TEST_CASE("Allocate from several threads")
+{
+    ObjectPool<Item, 16> pool;
+    constexpr int PerThread = 1000;
+    std::vector<std::vector<void*>> results(4);
+    std::vector<std::thread> threads;
+    for (auto& result : results)
+    {
+        threads.emplace_back([&pool, &result]
+        {
+            for (int i = 0; i < PerThread; ++i)
+                result.push_back(pool.allocate());
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    std::set<void*> allocated;
+    for (const auto& result : results)
+        allocated.insert(result.begin(), result.end());
+    REQUIRE(allocated.size() == results.size() * PerThread);
+    REQUIRE(pool.size() == results.size() * PerThread);
+}
+
+TEST_SUITE_END();
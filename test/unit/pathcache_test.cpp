@@ -0,0 +1,55 @@
+#include <array>
+
+#include <celengine/pathcache.h>
+#include <celengine/star.h>
+
+#include <doctest.h>
+
+using celestia::engine::PathCache;
+
+TEST_SUITE_BEGIN("PathCache");
+
+TEST_CASE("PathCache stores found selections")
+{
+    std::array<Star, 2> stars;
+    std::array<Selection, 1> contexts{ Selection(&stars[1]) };
+    PathCache cache;
+    Selection sel;
+
+    REQUIRE_FALSE(cache.find("Sol", contexts, false, sel));
+    cache.insert("Sol", contexts, false, Selection(&stars[0]));
+
+    REQUIRE(cache.find("Sol", contexts, false, sel));
+    REQUIRE(sel == Selection(&stars[0]));
+    REQUIRE_FALSE(cache.find("Sol", {}, false, sel));
+    REQUIRE_FALSE(cache.find("Sol", contexts, true, sel));
+
+    auto stats = cache.getStats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 3);
+    REQUIRE(stats.size == 1);
+
+    cache.clear();
+    REQUIRE_FALSE(cache.find("Sol", contexts, false, sel));
+    REQUIRE(cache.getStats().size == 0);
+}
+
+TEST_CASE("PathCache drops least recently used entries")
+{
+    std::array<Star, 3> stars;
+    PathCache cache(2);
+    Selection sel;
+
+    cache.insert("a", {}, false, Selection(&stars[0]));
+    cache.insert("b", {}, false, Selection(&stars[1]));
+    REQUIRE(cache.find("a", {}, false, sel));
+    cache.insert("c", {}, false, Selection(&stars[2]));
+
+    REQUIRE(cache.find("a", {}, false, sel));
+    REQUIRE(cache.find("c", {}, false, sel));
+    REQUIRE(sel == Selection(&stars[2]));
+    REQUIRE_FALSE(cache.find("b", {}, false, sel));
+    REQUIRE(cache.getStats().size == 2);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,48 @@
+#include <cstdint>
+#include <vector>
+
+#include <celutil/perfecthash.h>
+
+#include <doctest.h>
+
+using celestia::util::PerfectHashIndex;
+
+TEST_SUITE_BEGIN("PerfectHashIndex");
+
+TEST_CASE("Empty index finds nothing")
+{
+    PerfectHashIndex index;
+    REQUIRE(index.build({}));
+    REQUIRE(index.empty());
+    REQUIRE(index.find(0) == PerfectHashIndex::NotFound);
+}
+
+TEST_CASE("Every key is found at its position")
+{
+    std::vector<std::uint32_t> keys;
+    for (std::uint32_t i = 0; i < 10000; ++i)
+        keys.push_back(i * 7919U + 13U);
+
+    PerfectHashIndex index;
+    REQUIRE(index.build(keys));
+    REQUIRE(index.size() == keys.size());
+    for (std::uint32_t i = 0; i < keys.size(); ++i)
+        REQUIRE(index.find(keys[i]) == i);
+
+    REQUIRE(index.find(0) == PerfectHashIndex::NotFound);
+    REQUIRE(index.find(14) == PerfectHashIndex::NotFound);
+    REQUIRE(index.find(~UINT32_C(0)) == PerfectHashIndex::NotFound);
+}
+
+TEST_CASE("Repeated keys keep their first position")
+{
+    PerfectHashIndex index;
+    REQUIRE(index.build({ 5, 3, 5, 9, 3, 3 }));
+    REQUIRE(index.size() == 3);
+    REQUIRE(index.find(5) == 0);
+    REQUIRE(index.find(3) == 1);
+    REQUIRE(index.find(9) == 3);
+    REQUIRE(index.find(4) == PerfectHashIndex::NotFound);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,81 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <celutil/r128util.h>
+
+#include <doctest.h>
+
+namespace util = celestia::util;
+
+namespace
+{
+
+bool
+sameBits(const R128& a, const R128& b)
+{
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+bool
+sameBits(double a, double b)
+{
+    return a == b && std::signbit(a) == std::signbit(b);
+}
+
+std::vector<double>
+testValues()
+{
+    std::vector<double> values{ 0.0, -0.0, 1.0, -1.0, 0.5, -0.5, 1.0e-20, -1.0e-20,
+                                4.0e18, -4.0e18, 9223372036854775808.0, -9223372036854775808.0,
+                                1.0e300, -1.0e300 };
+    std::mt19937_64 rng(1234);
+    std::uniform_real_distribution<double> exponent(-30.0, 18.5);
+    std::uniform_int_distribution<int> sign(0, 1);
+    for (int i = 0; i < 1000; ++i)
+    {
+        double v = std::pow(10.0, exponent(rng));
+        values.push_back(sign(rng) == 0 ? v : -v);
+    }
+
+    return values;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("R128 utilities");
+
+TEST_CASE("fromDouble matches the R128 conversion")
+{
+    for (double v : testValues())
+        REQUIRE(sameBits(util::fromDouble(v), R128(v)));
+}
+
+TEST_CASE("toDouble matches the R128 conversion")
+{
+    for (double v : testValues())
+    {
+        R128 r(v);
+        REQUIRE(sameBits(util::toDouble(r), static_cast<double>(r)));
+    }
+
+    REQUIRE(sameBits(util::toDouble(R128_min), static_cast<double>(R128_min)));
+    REQUIRE(sameBits(util::toDouble(R128_max), static_cast<double>(R128_max)));
+}
+
+TEST_CASE("addR128 and subR128 match the R128 operators")
+{
+    std::vector<double> values = testValues();
+    for (std::size_t i = 0; i + 1 < values.size(); ++i)
+    {
+        R128 a(values[i]);
+        R128 b(values[i + 1]);
+        REQUIRE(sameBits(util::addR128(a, b), a + b));
+        REQUIRE(sameBits(util::subR128(a, b), a - b));
+    }
+
+    REQUIRE(sameBits(util::addR128(R128_max, R128(1.0)), R128_max + R128(1.0)));
+    REQUIRE(sameBits(util::subR128(R128_min, R128(1.0)), R128_min - R128(1.0)));
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,102 @@
+#include <functional>
+#include <sstream>
+#include <string>
+
+#include <celengine/body.h>
+#include <celengine/selection.h>
+#include <celengine/star.h>
+
+#include <doctest.h>
+
+TEST_SUITE_BEGIN("Selection");
+
+TEST_CASE("Selection hashes")
+{
+    SUBCASE("Hashes of different objects differ")
+    {
+        Star star0;
+        Star star1;
+        std::hash<Selection> hash;
+        CHECK(hash(Selection(&star0)) == hash(Selection(&star0)));
+        CHECK(hash(Selection(&star0)) != hash(Selection(&star1)));
+    }
+}
+
+TEST_CASE("Selection identifiers")
+{
+    SUBCASE("Empty selection")
+    {
+        CHECK(Selection().id().empty());
+    }
+
+    SUBCASE("Stars are identified by catalog number")
+    {
+        Star star0;
+        star0.setIndex(42);
+        Star star1;
+        star1.setIndex(42);
+        Star star2;
+        star2.setIndex(43);
+
+        SelectionId id = Selection(&star0).id();
+        CHECK(id.type == SelectionType::Star);
+        CHECK(id.catalogNumber == 42);
+        CHECK(id == Selection(&star1).id());
+        CHECK(id != Selection(&star2).id());
+    }
+
+    SUBCASE("Bodies are identified by their place in the planetary systems")
+    {
+        Star star0;
+        star0.setIndex(42);
+        PlanetarySystem system0(&star0);
+        system0.addBody("Other");
+        Body* planet0 = system0.addBody("Planet");
+
+        Star star1;
+        star1.setIndex(42);
+        PlanetarySystem system1(&star1);
+        system1.addBody("Other");
+        Body* planet1 = system1.addBody("Planet");
+
+        SelectionId id = Selection(planet0).id();
+        CHECK(id.type == SelectionType::Body);
+        CHECK(id.catalogNumber == 42);
+        REQUIRE(id.depth == 1);
+        CHECK(id.path[0] == 1);
+        CHECK(id == Selection(planet1).id());
+        CHECK(id != Selection(system0.getBody(0)).id());
+    }
+
+    SUBCASE("Binary form")
+    {
+        SelectionId id;
+        id.type = SelectionType::Location;
+        id.catalogNumber = 0;
+        id.depth = 2;
+        id.path[0] = 2;
+        id.path[1] = 0;
+        id.location = 7;
+
+        std::stringstream stream;
+        REQUIRE(writeSelectionId(stream, id));
+        REQUIRE(writeSelectionId(stream, SelectionId()));
+
+        SelectionId location;
+        SelectionId empty;
+        REQUIRE(readSelectionId(stream, location));
+        REQUIRE(readSelectionId(stream, empty));
+        CHECK(location == id);
+        CHECK(empty.empty());
+    }
+
+    SUBCASE("Malformed binary form")
+    {
+        std::string data{ static_cast<char>(SelectionType::Body), 0, 0, 0, 0, 0 };
+        std::istringstream stream(data);
+        SelectionId id;
+        CHECK(!readSelectionId(stream, id));
+    }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,31 @@
+#include <cmath>
+
+#include <celmath/solve.h>
+
+#include <doctest.h>
+
+namespace math = celestia::math;
+
+TEST_SUITE_BEGIN("solve");
+
+TEST_CASE("minimize_golden finds the minimum of a parabola")
+{
+    auto [x, err] = math::minimize_golden([](double t) { return (t - 1.25) * (t - 1.25) + 3.0; },
+                                          -2.0, 4.0, 1e-6);
+    REQUIRE(err < 1e-6);
+    REQUIRE(std::abs(x - 1.25) < 1e-5);
+}
+
+TEST_CASE("minimize_golden finds a minimum at the end of the interval")
+{
+    auto [x, err] = math::minimize_golden([](double t) { return t; }, 0.5, 2.0, 1e-6);
+    REQUIRE(std::abs(x - 0.5) < 1e-5);
+}
+
+TEST_CASE("minimize_golden finds the minimum of a cosine")
+{
+    auto [x, err] = math::minimize_golden([](double t) { return std::cos(t); }, 2.0, 5.0, 1e-8);
+    REQUIRE(std::abs(x - 3.14159265358979) < 1e-6);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,129 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <celutil/threadpool.h>
+
+#include <doctest.h>
+
+using celestia::util::ThreadPool;
+
+TEST_SUITE_BEGIN("ThreadPool");
+
+TEST_CASE("Every task runs exactly once")
+{
+    ThreadPool pool(3);
+    REQUIRE(pool.concurrency() == 4);
+
+    std::vector<std::atomic<int>> counts(1000);
+    std::atomic<int> badWorkers{ 0 };
+    for (int pass = 0; pass < 10; ++pass)
+    {
+        pool.parallelFor(counts.size(),
+                         [&](std::size_t task, unsigned int worker)
+                         {
+                             if (worker >= pool.concurrency())
+                                 ++badWorkers;
+                             ++counts[task];
+                         });
+    }
+
+    REQUIRE(badWorkers == 0);
+    for (const auto& count : counts)
+        REQUIRE(count == 10);
+}
+
+TEST_CASE("Per-worker state needs no synchronization")
+{
+    ThreadPool pool(2);
+    std::vector<std::size_t> sums(pool.concurrency(), 0);
+
+    pool.parallelFor(100,
+                     [&](std::size_t task, unsigned int worker) { sums[worker] += task; });
+
+    std::size_t total = 0;
+    for (std::size_t sum : sums)
+        total += sum;
+    REQUIRE(total == 4950);
+}
+
+TEST_CASE("Nested loops run on the calling worker")
+{
+    ThreadPool pool(2);
+    std::atomic<int> count{ 0 };
+
+    pool.parallelFor(4,
+                     [&](std::size_t, unsigned int)
+                     {
+                         pool.parallelFor(4, [&](std::size_t, unsigned int) { ++count; });
+                     });
+
+    REQUIRE(count == 16);
+}
+
+TEST_CASE("Loops from several threads share the workers")
+{
+    ThreadPool pool(3);
+    std::vector<std::atomic<int>> backgroundCounts(200);
+    std::vector<std::atomic<int>> interactiveCounts(200);
+
+    std::thread background([&]
+    {
+        ThreadPool::setThreadPriority(ThreadPool::Priority::Background);
+        pool.parallelFor(backgroundCounts.size(),
+                         [&](std::size_t task, unsigned int)
+                         {
+                             std::this_thread::sleep_for(std::chrono::microseconds(100));
+                             ++backgroundCounts[task];
+                         });
+    });
+
+    for (int pass = 0; pass < 10; ++pass)
+    {
+        pool.parallelFor(interactiveCounts.size(),
+                         [&](std::size_t task, unsigned int) { ++interactiveCounts[task]; });
+    }
+    background.join();
+
+    for (const auto& count : backgroundCounts)
+        REQUIRE(count == 1);
+    for (const auto& count : interactiveCounts)
+        REQUIRE(count == 10);
+}
+
+TEST_CASE("Jobs run on the workers")
+{
+    ThreadPool pool(2);
+    std::mutex mutex;
+    std::condition_variable done;
+    int remaining = 20;
+    std::atomic<int> onCaller{ 0 };
+    const auto caller = std::this_thread::get_id();
+
+    for (int i = 0; i < 20; ++i)
+    {
+        pool.submit([&]
+        {
+            if (std::this_thread::get_id() == caller)
+                ++onCaller;
+            std::scoped_lock lock(mutex);
+            if (--remaining == 0)
+                done.notify_all();
+        });
+    }
+
+    // Loops still run while jobs are queued
+    std::atomic<int> count{ 0 };
+    pool.parallelFor(100, [&](std::size_t, unsigned int) { ++count; });
+    REQUIRE(count == 100);
+
+    std::unique_lock lock(mutex);
+    REQUIRE(done.wait_for(lock, std::chrono::seconds(10), [&] { return remaining == 0; }));
+    REQUIRE(onCaller == 0);
+}
+
+TEST_SUITE_END();
@@ -518,4 +518,58 @@ TEST_CASE("Tokenizer skips comments")
     }
 }
 
+namespace
+{
+
+// Token type, line and value of each token, with a separator on each line
+std::string
+describeTokens(const std::string& source, std::size_t bufferSize)
+{
+    std::istringstream in(source);
+    Tokenizer tok(&in, bufferSize);
+    std::ostringstream out;
+    for (;;)
+    {
+        auto type = tok.nextToken();
+        out << type << ' ' << tok.getLineNumber() << ' ';
+        if (auto name = tok.getNameValue(); name.has_value())
+            out << *name;
+        else if (auto str = tok.getStringValue(); str.has_value())
+            out << *str;
+        else if (auto number = tok.getNumberValue(); number.has_value())
+            out << std::hexfloat << *number << ' ' << tok.getIntegerValue().has_value();
+        out << '\n';
+
+        if (type == Tokenizer::TokenEnd || type == Tokenizer::TokenError)
+            return out.str();
+    }
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Tokenizer results do not depend on the buffer size")
+{
+    // Within the buffer, whitespace, comments and runs of plain characters
+    // in strings are skipped in one go; across buffer refills they are read
+    // one character at a time.
+    const std::string source = "# comment \"with quotes\" and \303\274\n"
+                               "\"Earth:Terra\" \"Sol\" # trailing\n"
+                               "{\n"
+                               "\tTexture \"earth.*\"\n"
+                               "\tInfoURL \"a\\\"b\\\\c\\u00e9\\nd\"\n"
+                               "\tName \"\316\251\316\274 \342\230\203 \360\235\204\236\"\n"
+                               "\tBroken \"\303( \342\202 x\"\n"
+                               "\tRadius <km> 6378.140\n"
+                               "\tColor [ 0.85 0.85 1.0 ]\n"
+                               "\tValues -0 +.5 1e5 -2.5E-3 3e .5e+2 17\n"
+                               "\t\"multi\nline\" | = }\n";
+
+    const std::string expected = describeTokens(source, 4096);
+    for (std::size_t bufferSize = 24; bufferSize < 48; ++bufferSize)
+    {
+        INFO("buffer size ", bufferSize);
+        REQUIRE(describeTokens(source, bufferSize) == expected);
+    }
+}
+
 TEST_SUITE_END();
@@ -0,0 +1,85 @@
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <celcompat/filesystem.h>
+#include <celutil/trace.h>
+
+#include <doctest.h>
+
+using celestia::util::TraceScope;
+
+namespace
+{
+
+std::string
+writeTrace()
+{
+    fs::path path = fs::temp_directory_path() / "celestia_trace_test.json";
+    REQUIRE(celestia::util::WriteChromeTrace(path));
+
+    std::ifstream in(path);
+    std::string json(std::istreambuf_iterator<char>(in), {});
+    in.close();
+    fs::remove(path);
+    return json;
+}
+
+std::size_t
+countOccurrences(std::string_view text, std::string_view pattern)
+{
+    std::size_t count = 0;
+    for (auto pos = text.find(pattern); pos != std::string_view::npos; pos = text.find(pattern, pos + 1))
+        ++count;
+    return count;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("Trace");
+
+TEST_CASE("Scopes are only recorded while tracing is enabled")
+{
+    celestia::util::SetTracingEnabled(false);
+    {
+        TraceScope scope("disabledScope");
+    }
+
+    celestia::util::SetTracingEnabled(true);
+    {
+        TraceScope scope("enabledScope");
+    }
+    celestia::util::SetTracingEnabled(false);
+
+    std::string json = writeTrace();
+    REQUIRE(json.find("\"traceEvents\"") != std::string::npos);
+    REQUIRE(countOccurrences(json, "\"enabledScope\"") == 1);
+    REQUIRE(countOccurrences(json, "\"disabledScope\"") == 0);
+}
+
+TEST_CASE("Events of ended threads are kept and old events are overwritten")
+{
+    celestia::util::SetTracingEnabled(true);
+    std::thread thread([]
+    {
+        for (int i = 0; i < 20000; ++i)
+        {
+            TraceScope scope("threadScope");
+        }
+
+        TraceScope scope("lastThreadScope");
+    });
+    thread.join();
+    celestia::util::SetTracingEnabled(false);
+
+    std::string json = writeTrace();
+    REQUIRE(countOccurrences(json, "\"lastThreadScope\"") == 1);
+    std::size_t count = countOccurrences(json, "\"threadScope\"");
+    REQUIRE(count > 0);
+    REQUIRE(count < 20000);
+}
+
+TEST_SUITE_END();